@@ -0,0 +1,164 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cpuidle_psci.c
+ * @author agent (agent@local)
+ * @brief Host CPU idle states using PSCI CPU_SUSPEND
+ *
+ * Idle states are described by "arm,idle-state" compatible nodes under
+ * /cpus/idle-states of host device tree (same bindings as Linux) and
+ * are assumed to be common for all host CPUs. State zero is always WFI.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_devtree.h>
+#include <vmm_modules.h>
+#include <vmm_cpuidle.h>
+#include <arch_cpu_irq.h>
+#include <libs/stringlib.h>
+
+#include <psci.h>
+#include <smp_psci.h>
+
+#define MODULE_DESC			"PSCI CPU Idle Driver"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cpuidle_psci_init
+#define	MODULE_EXIT			cpuidle_psci_exit
+
+static int cpuidle_psci_enter_wfi(struct vmm_cpuidle_state *state)
+{
+	arch_cpu_wait_for_irq();
+
+	return VMM_OK;
+}
+
+static int cpuidle_psci_enter(struct vmm_cpuidle_state *state)
+{
+	/* Retention states return here without losing any context */
+	return psci_cpu_suspend((unsigned long)state->priv, 0);
+}
+
+static struct vmm_cpuidle_driver cpuidle_psci_drv = {
+	.name = "psci",
+	.state_count = 1,
+	.states = {
+		{
+			.name = "WFI",
+			.exit_latency_ns = 1000,
+			.target_residency_ns = 1000,
+			.enter = cpuidle_psci_enter_wfi,
+		},
+	},
+};
+
+static void cpuidle_psci_add_state(struct vmm_devtree_node *node)
+{
+	u32 i, param, entry_us, exit_us, residency_us;
+	struct vmm_cpuidle_state st, *states = cpuidle_psci_drv.states;
+
+	if (!vmm_devtree_is_compatible(node, "arm,idle-state") ||
+	    !vmm_devtree_is_available(node)) {
+		return;
+	}
+
+	if (vmm_devtree_read_u32(node, "arm,psci-suspend-param", &param) ||
+	    vmm_devtree_read_u32(node, "entry-latency-us", &entry_us) ||
+	    vmm_devtree_read_u32(node, "exit-latency-us", &exit_us) ||
+	    vmm_devtree_read_u32(node, "min-residency-us", &residency_us)) {
+		vmm_printf("%s: %s: missing idle state attributes\n",
+			   __func__, node->name);
+		return;
+	}
+
+	/* Power-down states lose CPU context and need a resume entry
+	 * point whereas states stopping local timer need a broadcast
+	 * timer so we only use retention states.
+	 */
+	if ((param & PSCI_0_2_POWER_STATE_TYPE_MASK) ||
+	    vmm_devtree_attrval(node, "local-timer-stop")) {
+		return;
+	}
+
+	if (VMM_CPUIDLE_MAX_STATES <= cpuidle_psci_drv.state_count) {
+		vmm_printf("%s: %s: too many idle states\n",
+			   __func__, node->name);
+		return;
+	}
+
+	memset(&st, 0, sizeof(st));
+	strncpy(st.name, node->name, sizeof(st.name));
+	st.name[sizeof(st.name) - 1] = '\0';
+	st.exit_latency_ns = ((u64)entry_us + exit_us) * 1000ULL;
+	st.target_residency_ns = (u64)residency_us * 1000ULL;
+	st.enter = cpuidle_psci_enter;
+	st.priv = (void *)(unsigned long)param;
+
+	/* Keep states ordered from shallowest to deepest */
+	i = cpuidle_psci_drv.state_count;
+	while ((1 < i) &&
+	       (st.target_residency_ns < states[i - 1].target_residency_ns)) {
+		states[i] = states[i - 1];
+		i--;
+	}
+	states[i] = st;
+	cpuidle_psci_drv.state_count++;
+}
+
+static int __init cpuidle_psci_init(void)
+{
+	struct vmm_devtree_node *node, *child;
+
+	if (!psci_cpu_suspend_avail()) {
+		return VMM_ENODEV;
+	}
+
+	node = vmm_devtree_getnode(VMM_DEVTREE_PATH_SEPARATOR_STRING
+				   VMM_DEVTREE_CPUS_NODE_NAME
+				   VMM_DEVTREE_PATH_SEPARATOR_STRING
+				   "idle-states");
+	if (!node) {
+		return VMM_ENODEV;
+	}
+
+	vmm_devtree_for_each_child(child, node) {
+		cpuidle_psci_add_state(child);
+	}
+
+	vmm_devtree_dref_node(node);
+
+	if (cpuidle_psci_drv.state_count < 2) {
+		return VMM_ENODEV;
+	}
+
+	return vmm_cpuidle_register_driver(&cpuidle_psci_drv);
+}
+
+static void __exit cpuidle_psci_exit(void)
+{
+	vmm_cpuidle_unregister_driver(&cpuidle_psci_drv);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
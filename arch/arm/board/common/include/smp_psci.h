@@ -0,0 +1,44 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file smp_psci.h
+ * @author agent (agent@local)
+ * @brief Host PSCI calls interface
+ */
+
+#ifndef __SMP_PSCI_H__
+#define __SMP_PSCI_H__
+
+#include <vmm_types.h>
+
+/** Check whether host PSCI CPU_SUSPEND is available */
+bool psci_cpu_suspend_avail(void);
+
+/** Suspend current host CPU using host PSCI CPU_SUSPEND */
+int psci_cpu_suspend(unsigned long power_state, unsigned long entry_point);
+
+/** Power-off current host CPU using host PSCI CPU_OFF */
+int psci_cpu_off(unsigned long power_state);
+
+/** Power-on given host CPU using host PSCI CPU_ON */
+int psci_cpu_on(unsigned long cpuid, unsigned long entry_point);
+
+/** Migrate trusted OS to given host CPU using host PSCI MIGRATE */
+int psci_migrate(unsigned long cpuid);
+
+#endif /* __SMP_PSCI_H__ */
@@ -35,6 +35,7 @@
 
 #include <psci.h>
 #include <smp_ops.h>
+#include <smp_psci.h>
 
 enum psci_function {
 	PSCI_FN_CPU_SUSPEND,
@@ -97,8 +98,17 @@ static int __noinline invoke_psci_fn_smc(unsigned long func,
 	return psci_to_xvisor_errno(ret);
 }
 
+bool psci_cpu_suspend_avail(void)
+{
+	return (psci_function_id[PSCI_FN_CPU_SUSPEND]) ? TRUE : FALSE;
+}
+
 int psci_cpu_suspend(unsigned long power_state, unsigned long entry_point)
 {
+	if (!psci_function_id[PSCI_FN_CPU_SUSPEND]) {
+		return VMM_ENOTAVAIL;
+	}
+
 	return invoke_psci_fn_smc(psci_function_id[PSCI_FN_CPU_SUSPEND],
 				  power_state, entry_point, 0);
 }
@@ -771,6 +771,12 @@ int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 	return VMM_OK;
 }
 
+int arch_guest_write_protect(struct vmm_guest *guest,
+			     physical_addr_t gphys, physical_size_t size)
+{
+	return VMM_ENOTSUPP;
+}
+
 int arch_vcpu_init(struct vmm_vcpu *vcpu)
 {
 	int rc;
@@ -1185,3 +1191,32 @@ void arch_vcpu_stat_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 {
 	/* For now no arch specific stats */
 }
+
+int arch_vcpu_state_save(struct vmm_vcpu *vcpu,
+			 struct vmm_snapshot_state *st)
+{
+	return VMM_ENOTSUPP;
+}
+
+int arch_vcpu_state_restore(struct vmm_vcpu *vcpu,
+			    struct vmm_snapshot_state *st)
+{
+	return VMM_ENOTSUPP;
+}
+
+bool arch_vcpu_sample_pc(struct vmm_vcpu *vcpu, arch_regs_t *regs,
+			 virtual_addr_t *host_pc, virtual_addr_t *guest_pc)
+{
+	/* Normal VCPUs run in USER mode irrespective of guest mode */
+	if (vcpu->is_normal &&
+	    ((arm_cpsr(regs) & CPSR_MODE_MASK) == CPSR_MODE_USER)) {
+		*host_pc = 0;
+		*guest_pc = arm_pc(regs);
+		return TRUE;
+	}
+
+	*host_pc = arm_pc(regs);
+	*guest_pc = 0;
+
+	return FALSE;
+}
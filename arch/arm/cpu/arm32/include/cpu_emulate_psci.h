@@ -81,4 +81,20 @@ static inline unsigned long emulate_psci_get_mpidr(struct vmm_vcpu *vcpu)
 	return arm_priv(vcpu)->cp15.c0_mpidr;
 }
 
+/* PV stolen time is not available without virtualization extensions */
+static inline bool emulate_psci_pvtime_base(struct vmm_vcpu *vcpu,
+					    physical_addr_t *base)
+{
+	return FALSE;
+}
+
+static inline bool emulate_psci_pvtime_enabled(struct vmm_vcpu *vcpu)
+{
+	return FALSE;
+}
+
+static inline void emulate_psci_pvtime_enable(struct vmm_vcpu *vcpu)
+{
+}
+
 #endif	/* __CPU_EMULATE_PSCI_H__ */
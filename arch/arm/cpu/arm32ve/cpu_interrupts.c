@@ -109,7 +109,8 @@ void do_data_abort(arch_regs_t *regs)
 void do_hyp_trap(arch_regs_t *regs)
 {
 	int rc = VMM_OK;
-	u32 hsr, ec, il, iss;
+	u32 hsr, ec, il, iss, exit_reason = VMM_VCPU_EXIT_OTHER;
+	u64 exit_tstamp, emulate_tstamp;
 	virtual_addr_t far;
 	physical_addr_t fipa = 0;
 	struct vmm_vcpu *vcpu;
@@ -137,8 +138,12 @@ void do_hyp_trap(arch_regs_t *regs)
 		vmm_panic("%s: please reboot ...\n", __func__);
 	}
 
+	exit_tstamp = vmm_manager_vcpu_exit_tstamp();
+
 	vmm_scheduler_irq_enter(regs, TRUE);
 
+	emulate_tstamp = vmm_manager_vcpu_exit_tstamp();
+
 	switch (ec) {
 	case EC_UNKNOWN:
 		/* We dont expect to get this trap so error */
@@ -146,30 +151,37 @@ void do_hyp_trap(arch_regs_t *regs)
 		break;
 	case EC_TRAP_WFI_WFE:
 		/* WFI emulation */
+		exit_reason = VMM_VCPU_EXIT_WFI;
 		rc = cpu_vcpu_emulate_wfi_wfe(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_MCR_MRC_CP15:
 		/* MCR/MRC CP15 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_mcr_mrc_cp15(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_MCRR_MRRC_CP15:
 		/* MCRR/MRRC CP15 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_mcrr_mrrc_cp15(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_MCR_MRC_CP14:
 		/* MCR/MRC CP14 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_mcr_mrc_cp14(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_LDC_STC_CP14:
 		/* LDC/STC CP14 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_ldc_stc_cp14(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_CP0_TO_CP13:
 		/* CP0 to CP13 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_cp0_cp13(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_VMRS:
 		/* MRC (or VMRS) to CP10 for MVFR0, MVFR1 or FPSID */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_vmrs(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_JAZELLE:
@@ -182,6 +194,7 @@ void do_hyp_trap(arch_regs_t *regs)
 		break;
 	case EC_TRAP_MRRC_CP14:
 		/* MRRC to CP14 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_mrrc_cp14(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_SVC:
@@ -190,14 +203,17 @@ void do_hyp_trap(arch_regs_t *regs)
 		break;
 	case EC_TRAP_HVC:
 		/* Hypercall or HVC emulation */
+		exit_reason = VMM_VCPU_EXIT_HYPCALL;
 		rc = cpu_vcpu_emulate_hvc(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_SMC:
 		/* System Monitor Call or SMC emulation */
+		exit_reason = VMM_VCPU_EXIT_HYPCALL;
 		rc = cpu_vcpu_emulate_smc(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_STAGE2_INST_ABORT:
 		/* Stage2 instruction abort */
+		exit_reason = VMM_VCPU_EXIT_MMIO;
 		far  = read_hifar();
 		fipa = (read_hpfar() & HPFAR_FIPA_MASK) >> HPFAR_FIPA_SHIFT;
 		fipa = fipa << HPFAR_FIPA_PAGE_SHIFT;
@@ -210,6 +226,7 @@ void do_hyp_trap(arch_regs_t *regs)
 		break;
 	case EC_TRAP_STAGE2_DATA_ABORT:
 		/* Stage2 data abort */
+		exit_reason = VMM_VCPU_EXIT_MMIO;
 		far  = read_hdfar();
 		fipa = (read_hpfar() & HPFAR_FIPA_MASK) >> HPFAR_FIPA_SHIFT;
 		fipa = fipa << HPFAR_FIPA_PAGE_SHIFT;
@@ -235,16 +252,37 @@ void do_hyp_trap(arch_regs_t *regs)
 		}
 	}
 
+	vmm_manager_vcpu_exit_account(vcpu, exit_reason,
+				      exit_tstamp, emulate_tstamp);
+
 	vmm_scheduler_irq_exit(regs);
+
+	vmm_manager_vcpu_exit_return(vcpu);
 }
 
 void do_irq(arch_regs_t *regs)
 {
+	u64 exit_tstamp = vmm_manager_vcpu_exit_tstamp();
+	u64 emulate_tstamp;
+	struct vmm_vcpu *vcpu = NULL;
+
 	vmm_scheduler_irq_enter(regs, FALSE);
 
+	/* IRQs taken outside HYP mode are VM exits of Normal VCPUs */
+	if ((regs->cpsr & CPSR_MODE_MASK) != CPSR_MODE_HYPERVISOR) {
+		vcpu = vmm_scheduler_current_vcpu();
+	}
+
+	emulate_tstamp = vmm_manager_vcpu_exit_tstamp();
+
 	vmm_host_active_irq_exec(CPU_EXTERNAL_IRQ);
 
+	vmm_manager_vcpu_exit_account(vcpu, VMM_VCPU_EXIT_IRQ,
+				      exit_tstamp, emulate_tstamp);
+
 	vmm_scheduler_irq_exit(regs);
+
+	vmm_manager_vcpu_exit_return(vcpu);
 }
 
 void do_fiq(arch_regs_t *regs)
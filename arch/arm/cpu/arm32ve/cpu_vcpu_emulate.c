@@ -159,9 +159,11 @@ int cpu_vcpu_emulate_wfi_wfe(struct vmm_vcpu *vcpu,
 		goto done;
 	}
 
-	/* If WFE trapped then only yield */
+	/* If WFE trapped then guest is likely spinning on a
+	 * contended lock so yield to the lock holder
+	 */
 	if (iss & ISS_WFI_WFE_TI_MASK) {
-		vmm_scheduler_yield();
+		vmm_scheduler_yield_spin();
 		goto done;
 	}
 
@@ -423,12 +425,104 @@ int cpu_vcpu_emulate_smc(struct vmm_vcpu *vcpu,
 	return do_psci_call(vcpu, regs, il, iss, TRUE);
 }
 
-static inline u32 arm_sign_extend(u32 imm, u32 len, u32 bits)
+static inline void cpu_vcpu_emulate_next(struct vmm_vcpu *vcpu,
+					 arch_regs_t *regs, u32 il)
 {
-	if (imm & (1 << (len - 1))) {
-		imm = imm | (~((1 << len) - 1));
+	/* Next instruction */
+	regs->pc += (il) ? 4 : 2;
+	/* Update ITSTATE for Thumb mode */
+	if (regs->cpsr & CPSR_THUMB_ENABLED) {
+		cpu_vcpu_update_itstate(vcpu, regs);
 	}
-	return imm & ((1 << bits) - 1);
+}
+
+/* Max guest accesses to data FIFO register completed in one trap */
+#define FIFO_BURST_MAX			8
+
+/* Unconditional ARM "ldr/str Rt, [Rn]" (word, zero offset, no writeback) */
+#define FIFO_INST_MASK			0xFF700FFF
+#define FIFO_INST_LDR			0xE5100000
+#define FIFO_INST_STR			0xE5000000
+
+/**
+ * Guests stream data FIFO registers using unrolled sequences of
+ * word load/store instructions with same base register (for e.g.
+ * readsl()/writesl() of Linux) so complete trapped access along with
+ * following accesses of such sequence in one go.
+ *
+ * Returns VMM_ENOTAVAIL if trapped access is not part of a sequence.
+ */
+static int cpu_vcpu_emulate_fifo(struct vmm_vcpu *vcpu,
+				 arch_regs_t *regs, bool is_store,
+				 u32 srt, physical_addr_t ipa)
+{
+	int rc;
+	u32 i, count, rn, match;
+	u32 inst[FIFO_BURST_MAX], rt[FIFO_BURST_MAX], data[FIFO_BURST_MAX];
+	physical_addr_t inst_pa;
+	enum vmm_devemu_endianness endian;
+
+	if ((regs->cpsr & CPSR_THUMB_ENABLED) ||
+	    !vmm_devemu_is_fifo(vcpu, ipa, sizeof(u32))) {
+		return VMM_ENOTAVAIL;
+	}
+
+	/* Read trapped and following instructions within same page */
+	count = (0x1000 - (regs->pc & 0x00000FFF)) / sizeof(u32);
+	if (count > FIFO_BURST_MAX) {
+		count = FIFO_BURST_MAX;
+	}
+	va2pa_ns_pr(regs->pc);
+	inst_pa = read_par64();
+	inst_pa &= PAR64_PA_MASK;
+	inst_pa |= (regs->pc & 0x00000FFF);
+	if (vmm_host_memory_read(inst_pa, inst, count * sizeof(u32),
+				 TRUE) != (count * sizeof(u32))) {
+		return VMM_ENOTAVAIL;
+	}
+
+	/* Find length of sequence starting with trapped instruction */
+	match = (is_store) ? FIFO_INST_STR : FIFO_INST_LDR;
+	if (((inst[0] & FIFO_INST_MASK) != match) ||
+	    (((inst[0] >> 12) & 0xF) != srt)) {
+		return VMM_ENOTAVAIL;
+	}
+	rn = (inst[0] >> 16) & 0xF;
+	for (i = 0; i < count; i++) {
+		rt[i] = (inst[i] >> 12) & 0xF;
+		if (((inst[i] & FIFO_INST_MASK) != match) ||
+		    (((inst[i] >> 16) & 0xF) != rn) ||
+		    (rt[i] == rn) || (rt[i] == 15)) {
+			break;
+		}
+	}
+	count = i;
+	if (count < 2) {
+		return VMM_ENOTAVAIL;
+	}
+
+	endian = (regs->cpsr & CPSR_BE_ENABLED) ?
+			VMM_DEVEMU_BIG_ENDIAN : VMM_DEVEMU_LITTLE_ENDIAN;
+	if (is_store) {
+		for (i = 0; i < count; i++) {
+			data[i] = cpu_vcpu_reg_read(vcpu, regs, rt[i]);
+		}
+		rc = vmm_devemu_emulate_fifo_write(vcpu, ipa, data,
+						   count, endian);
+	} else {
+		rc = vmm_devemu_emulate_fifo_read(vcpu, ipa, data,
+						  count, endian);
+		for (i = 0; !rc && (i < count); i++) {
+			cpu_vcpu_reg_write(vcpu, regs, rt[i], data[i]);
+		}
+	}
+	if (rc) {
+		return rc;
+	}
+
+	regs->pc += count * sizeof(u32);
+
+	return VMM_OK;
 }
 
 int cpu_vcpu_emulate_load(struct vmm_vcpu *vcpu, 
@@ -437,73 +531,42 @@ int cpu_vcpu_emulate_load(struct vmm_vcpu *vcpu,
 			  physical_addr_t ipa)
 {
 	int rc;
-	u8 data8;
-	u16 data16;
-	u32 data32, sas, sse, srt;
-	enum vmm_devemu_endianness data_endian;
+	u32 data = 0, len, bits, srt;
 
-	if (regs->cpsr & CPSR_BE_ENABLED) {
-		data_endian = VMM_DEVEMU_BIG_ENDIAN;
-	} else {
-		data_endian = VMM_DEVEMU_LITTLE_ENDIAN;
+	/* Access size is 1 << SAS bytes */
+	len = 1 << ((iss & ISS_ABORT_SAS_MASK) >> ISS_ABORT_SAS_SHIFT);
+	if (len > sizeof(data)) {
+		return VMM_EFAIL;
 	}
-
-	sas = (iss & ISS_ABORT_SAS_MASK) >> ISS_ABORT_SAS_SHIFT;
-	sse = (iss & ISS_ABORT_SSE_MASK) >> ISS_ABORT_SSE_SHIFT;
 	srt = (iss & ISS_ABORT_SRT_MASK) >> ISS_ABORT_SRT_SHIFT;
 
-	sse = (sas == 2) ? 0 : sse;
-
-	switch (sas) {
-	case 0:
-		rc = vmm_devemu_emulate_read(vcpu, ipa,
-					     &data8, sizeof(data8),
-					     data_endian);
-		if (!rc) {
-			if (sse) {
-				cpu_vcpu_reg_write(vcpu, regs, srt, 
-					arm_sign_extend(data8, 8, 32));
-			} else {
-				cpu_vcpu_reg_write(vcpu, regs, srt, data8);
-			}
+	if (len == sizeof(u32)) {
+		rc = cpu_vcpu_emulate_fifo(vcpu, regs, FALSE, srt, ipa);
+		if (rc != VMM_ENOTAVAIL) {
+			return rc;
 		}
-		break;
-	case 1:
-		rc = vmm_devemu_emulate_read(vcpu, ipa,
-					     &data16, sizeof(data16),
-					     data_endian);
-		if (!rc) {
-			if (sse) {
-				cpu_vcpu_reg_write(vcpu, regs, srt, 
-					arm_sign_extend(data16, 16, 32));
-			} else {
-				cpu_vcpu_reg_write(vcpu, regs, srt, data16);
-			}
-		}
-		break;
-	case 2:
-		rc = vmm_devemu_emulate_read(vcpu, ipa,
-					     &data32, sizeof(data32),
-					     data_endian);
-		if (!rc) {
-			cpu_vcpu_reg_write(vcpu, regs, srt, data32);
-		}
-		break;
-	default:
-		rc = VMM_EFAIL;
-		break;
-	};
+	}
 
-	if (!rc) {
-		/* Next instruction */
-		regs->pc += (il) ? 4 : 2;
-		/* Update ITSTATE for Thumb mode */
-		if (regs->cpsr & CPSR_THUMB_ENABLED) {
-			cpu_vcpu_update_itstate(vcpu, regs);
+	rc = vmm_devemu_emulate_read(vcpu, ipa, &data, len,
+				     (regs->cpsr & CPSR_BE_ENABLED) ?
+				     VMM_DEVEMU_BIG_ENDIAN :
+				     VMM_DEVEMU_LITTLE_ENDIAN);
+	if (rc) {
+		return rc;
+	}
+
+	if ((iss & ISS_ABORT_SSE_MASK) && (len < sizeof(data))) {
+		bits = len * 8;
+		if (data & (1UL << (bits - 1))) {
+			data |= ~0UL << bits;
 		}
 	}
 
-	return rc;
+	cpu_vcpu_reg_write(vcpu, regs, srt, data);
+
+	cpu_vcpu_emulate_next(vcpu, regs, il);
+
+	return VMM_OK;
 }
 
 int cpu_vcpu_emulate_store(struct vmm_vcpu *vcpu, 
@@ -512,53 +575,34 @@ int cpu_vcpu_emulate_store(struct vmm_vcpu *vcpu,
 			   physical_addr_t ipa)
 {
 	int rc;
-	u8 data8;
-	u16 data16;
-	u32 data32, sas, srt;
-	enum vmm_devemu_endianness data_endian;
+	u32 data, len, srt;
 
-	if (regs->cpsr & CPSR_BE_ENABLED) {
-		data_endian = VMM_DEVEMU_BIG_ENDIAN;
-	} else {
-		data_endian = VMM_DEVEMU_LITTLE_ENDIAN;
+	/* Access size is 1 << SAS bytes */
+	len = 1 << ((iss & ISS_ABORT_SAS_MASK) >> ISS_ABORT_SAS_SHIFT);
+	if (len > sizeof(data)) {
+		return VMM_EFAIL;
 	}
-
-	sas = (iss & ISS_ABORT_SAS_MASK) >> ISS_ABORT_SAS_SHIFT;
 	srt = (iss & ISS_ABORT_SRT_MASK) >> ISS_ABORT_SRT_SHIFT;
 
-	switch (sas) {
-	case 0:
-		data8 = cpu_vcpu_reg_read(vcpu, regs, srt);
-		rc = vmm_devemu_emulate_write(vcpu, ipa,
-					      &data8, sizeof(data8),
-					      data_endian);
-		break;
-	case 1:
-		data16 = cpu_vcpu_reg_read(vcpu, regs, srt);
-		rc = vmm_devemu_emulate_write(vcpu, ipa,
-					      &data16, sizeof(data16),
-					      data_endian);
-		break;
-	case 2:
-		data32 = cpu_vcpu_reg_read(vcpu, regs, srt);
-		rc = vmm_devemu_emulate_write(vcpu, ipa,
-					      &data32, sizeof(data32),
-					      data_endian);
-		break;
-	default:
-		rc = VMM_EFAIL;
-		break;
-	};
-
-	if (!rc) {
-		/* Next instruction */
-		regs->pc += (il) ? 4 : 2;
-		/* Update ITSTATE for Thumb mode */
-		if (regs->cpsr & CPSR_THUMB_ENABLED) {
-			cpu_vcpu_update_itstate(vcpu, regs);
+	if (len == sizeof(u32)) {
+		rc = cpu_vcpu_emulate_fifo(vcpu, regs, TRUE, srt, ipa);
+		if (rc != VMM_ENOTAVAIL) {
+			return rc;
 		}
 	}
 
-	return rc;
+	/* Lower len bytes of little-endian host value are written */
+	data = cpu_vcpu_reg_read(vcpu, regs, srt);
+	rc = vmm_devemu_emulate_write(vcpu, ipa, &data, len,
+				      (regs->cpsr & CPSR_BE_ENABLED) ?
+				      VMM_DEVEMU_BIG_ENDIAN :
+				      VMM_DEVEMU_LITTLE_ENDIAN);
+	if (rc) {
+		return rc;
+	}
+
+	cpu_vcpu_emulate_next(vcpu, regs, il);
+
+	return VMM_OK;
 }
 
@@ -35,18 +35,65 @@
 #include <emulate_arm.h>
 #include <emulate_thumb.h>
 
+static const physical_size_t stage2_block_sizes[] = {
+	TTBL_L1_BLOCK_SIZE,
+	TTBL_L2_BLOCK_SIZE,
+};
+
+static void cpu_vcpu_stage2_page_attr(struct cpu_page *pg, u32 reg_flags)
+{
+	if (reg_flags & VMM_REGION_VIRTUAL) {
+		pg->af = 0;
+		pg->ap = TTBL_HAP_NOACCESS;
+	} else if (reg_flags & VMM_REGION_READONLY) {
+		pg->af = 1;
+		pg->ap = TTBL_HAP_READONLY;
+	} else {
+		pg->af = 1;
+		pg->ap = TTBL_HAP_READWRITE;
+	}
+
+	if (reg_flags & VMM_REGION_CACHEABLE) {
+		if (reg_flags & VMM_REGION_BUFFERABLE) {
+			pg->memattr = 0xF;
+		} else {
+			pg->memattr = 0xA;
+		}
+	} else {
+		pg->memattr = 0x0;
+	}
+}
+
 static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 				arch_regs_t *regs,
 				physical_addr_t fipa)
 {
 	int rc, rc1;
-	u32 reg_flags = 0x0, pg_reg_flags = 0x0;
+	u32 i, reg_flags = 0x0;
 	struct cpu_page pg;
 	physical_addr_t inaddr, outaddr;
 	physical_size_t size, availsz;
 
+	vmm_manager_guest_boot_fault(vcpu->guest);
+
 	memset(&pg, 0, sizeof(pg));
 
+	/* Try L1 and L2 blocks first so that RAM/ROM faults usually
+	 * need only one region lookup.
+	 */
+	for (i = 0; i < array_size(stage2_block_sizes); i++) {
+		size = stage2_block_sizes[i];
+		inaddr = fipa & ~(size - 1);
+		rc = vmm_guest_physical_map(vcpu->guest, inaddr, size,
+				    &outaddr, &availsz, &reg_flags);
+		if (!rc && (availsz >= size) &&
+		    !(outaddr & (size - 1)) &&
+		    (reg_flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) &&
+		    !vmm_guest_dirty_log_wprot(vcpu->guest, inaddr, size)) {
+			goto map_page;
+		}
+	}
+
 	inaddr = fipa & TTBL_L3_MAP_MASK;
 	size = TTBL_L3_BLOCK_SIZE;
 
@@ -60,53 +107,16 @@ static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 		return VMM_EFAIL;
 	}
 
+map_page:
 	pg.ia = inaddr;
 	pg.sz = size;
 	pg.oa = outaddr;
-	pg_reg_flags = reg_flags;
-
-	if (reg_flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) {
-		inaddr = fipa & TTBL_L2_MAP_MASK;
-		size = TTBL_L2_BLOCK_SIZE;
-		rc = vmm_guest_physical_map(vcpu->guest, inaddr, size,
-				    &outaddr, &availsz, &reg_flags);
-		if (!rc && (availsz >= TTBL_L2_BLOCK_SIZE)) {
-			pg.ia = inaddr;
-			pg.sz = size;
-			pg.oa = outaddr;
-			pg_reg_flags = reg_flags;
-		}
-		inaddr = fipa & TTBL_L1_MAP_MASK;
-		size = TTBL_L1_BLOCK_SIZE;
-		rc = vmm_guest_physical_map(vcpu->guest, inaddr, size,
-				    &outaddr, &availsz, &reg_flags);
-		if (!rc && (availsz >= TTBL_L1_BLOCK_SIZE)) {
-			pg.ia = inaddr;
-			pg.sz = size;
-			pg.oa = outaddr;
-			pg_reg_flags = reg_flags;
-		}
-	}
+	cpu_vcpu_stage2_page_attr(&pg, reg_flags);
 
-	if (pg_reg_flags & VMM_REGION_VIRTUAL) {
-		pg.af = 0;
-		pg.ap = TTBL_HAP_NOACCESS;
-	} else if (pg_reg_flags & VMM_REGION_READONLY) {
-		pg.af = 1;
+	/* Clean pages of dirty logged range are mapped read-only */
+	if ((pg.ap == TTBL_HAP_READWRITE) &&
+	    vmm_guest_dirty_log_wprot(vcpu->guest, inaddr, size)) {
 		pg.ap = TTBL_HAP_READONLY;
-	} else {
-		pg.af = 1;
-		pg.ap = TTBL_HAP_READWRITE;
-	}
-
-	if (pg_reg_flags & VMM_REGION_CACHEABLE) {
-		if (pg_reg_flags & VMM_REGION_BUFFERABLE) {
-			pg.memattr = 0xF;
-		} else {
-			pg.memattr = 0xA;
-		}
-	} else {
-		pg.memattr = 0x0;
 	}
 
 	/* Try to map the page in Stage2 */
@@ -131,6 +141,122 @@ static int cpu_vcpu_stage2_map(struct vmm_vcpu *vcpu,
 	return rc;
 }
 
+static int cpu_vcpu_stage2_dirty(struct vmm_vcpu *vcpu,
+				 physical_addr_t fipa)
+{
+	int rc;
+	u32 reg_flags = 0x0;
+	struct cpu_page pg;
+	physical_addr_t outaddr;
+	physical_size_t availsz;
+	struct cpu_ttbl *ttbl = arm_guest_priv(vcpu->guest)->ttbl;
+
+	/* Only writable regions are write-protected for dirty logging */
+	rc = vmm_guest_physical_map(vcpu->guest, fipa & TTBL_L3_MAP_MASK,
+				    TTBL_L3_BLOCK_SIZE, &outaddr,
+				    &availsz, &reg_flags);
+	if (rc) {
+		return rc;
+	}
+	if (reg_flags & (VMM_REGION_READONLY | VMM_REGION_VIRTUAL)) {
+		return VMM_EFAIL;
+	}
+
+	memset(&pg, 0, sizeof(pg));
+	if (!mmu_lpae_get_page(ttbl, fipa, &pg) &&
+	    (pg.ap == TTBL_HAP_READONLY)) {
+		mmu_lpae_unmap_page(ttbl, &pg);
+		pg.ap = TTBL_HAP_READWRITE;
+		/* Failure means other VCPU already mapped it again */
+		mmu_lpae_map_page(ttbl, &pg);
+	}
+
+	/* Mark only after the page is writable so that a concurrent
+	 * vmm_guest_dirty_log_get() never misses this write.
+	 */
+	vmm_guest_dirty_log_mark(vcpu->guest, fipa);
+
+	return VMM_OK;
+}
+
+int cpu_vcpu_stage2_wprot(struct vmm_guest *guest,
+			  physical_addr_t gphys, physical_size_t size)
+{
+	struct cpu_page pg;
+	physical_addr_t ia, end;
+	struct cpu_ttbl *ttbl = arm_guest_priv(guest)->ttbl;
+
+	ia = gphys & TTBL_L3_MAP_MASK;
+	end = gphys + size;
+	while (ia < end) {
+		memset(&pg, 0, sizeof(pg));
+		if (mmu_lpae_get_page(ttbl, ia, &pg)) {
+			ia += TTBL_L3_BLOCK_SIZE;
+			continue;
+		}
+		if (pg.ap == TTBL_HAP_READWRITE) {
+			mmu_lpae_unmap_page(ttbl, &pg);
+			/* Blocks are mapped again as pages upon next fault */
+			if (pg.sz == TTBL_L3_BLOCK_SIZE) {
+				pg.ap = TTBL_HAP_READONLY;
+				mmu_lpae_map_page(ttbl, &pg);
+			}
+		}
+		ia = pg.ia + pg.sz;
+	}
+
+	return VMM_OK;
+}
+
+int cpu_vcpu_stage2_premap(struct vmm_guest *guest, struct vmm_region *reg)
+{
+	int rc;
+	struct cpu_page pg;
+	u32 availsz;
+	physical_addr_t ia, oa;
+	physical_size_t remain;
+
+	if (!(reg->flags & VMM_REGION_ISPREMAP) ||
+	    !(reg->flags & VMM_REGION_ISHOSTRAM) ||
+	    (reg->flags & (VMM_REGION_ALIAS | VMM_REGION_VIRTUAL))) {
+		return VMM_OK;
+	}
+
+	ia = reg->gphys_addr;
+	oa = reg->hphys_addr;
+	remain = reg->phys_size;
+	while (remain >= TTBL_L3_BLOCK_SIZE) {
+		memset(&pg, 0, sizeof(pg));
+		pg.ia = ia;
+		pg.oa = oa;
+		availsz = (remain < TTBL_L1_BLOCK_SIZE) ?
+					remain : TTBL_L1_BLOCK_SIZE;
+		pg.sz = mmu_lpae_best_page_size(ia, oa, availsz);
+		cpu_vcpu_stage2_page_attr(&pg, reg->flags);
+
+		rc = mmu_lpae_map_page(arm_guest_priv(guest)->ttbl, &pg);
+		if (rc) {
+			return rc;
+		}
+
+		ia += pg.sz;
+		oa += pg.sz;
+		remain -= pg.sz;
+	}
+
+	return VMM_OK;
+}
+
+int cpu_vcpu_stage2_unmap(struct vmm_guest *guest, struct vmm_region *reg)
+{
+	if (!(reg->flags & VMM_REGION_ISPREMAP)) {
+		return VMM_OK;
+	}
+
+	return mmu_lpae_unmap_range(arm_guest_priv(guest)->ttbl,
+				    reg->gphys_addr, reg->phys_size);
+}
+
 int cpu_vcpu_inst_abort(struct vmm_vcpu *vcpu,
 			arch_regs_t *regs,
 			u32 il, u32 iss,
@@ -163,36 +289,45 @@ int cpu_vcpu_data_abort(struct vmm_vcpu *vcpu,
 	case FSR_TRANS_FAULT_LEVEL2:
 	case FSR_TRANS_FAULT_LEVEL3:
 		return cpu_vcpu_stage2_map(vcpu, regs, fipa);
+	case FSR_PERM_FAULT_LEVEL1:
+	case FSR_PERM_FAULT_LEVEL2:
+	case FSR_PERM_FAULT_LEVEL3:
+		if (iss & ISS_ABORT_WNR_MASK) {
+			return cpu_vcpu_stage2_dirty(vcpu, fipa);
+		}
+		break;
 	case FSR_ACCESS_FAULT_LEVEL1:
 	case FSR_ACCESS_FAULT_LEVEL2:
 	case FSR_ACCESS_FAULT_LEVEL3:
-		if (!(iss & ISS_ABORT_ISV_MASK)) {
-			/* Determine instruction physical address */
-			va2pa_ns_pr(regs->pc);
-			inst_pa = read_par64();
-			inst_pa &= PAR64_PA_MASK;
-			inst_pa |= (regs->pc & 0x00000FFF);
-
-			/* Read the faulting instruction */
-			/* FIXME: Should this be cacheable memory access ? */
-			read_count = vmm_host_memory_read(inst_pa,
-						&inst, sizeof(inst), TRUE);
-			if (read_count != sizeof(inst)) {
-				return VMM_EFAIL;
-			}
-			if (regs->cpsr & CPSR_THUMB_ENABLED) {
-				return emulate_thumb_inst(vcpu, regs, inst);
-			} else {
-				return emulate_arm_inst(vcpu, regs, inst);
-			}
-		} else {
+		/* Syndrome valid MMIO access is the common case hence
+		 * it directly becomes a device emulator read/write.
+		 */
+		if (likely(iss & ISS_ABORT_ISV_MASK)) {
 			if (iss & ISS_ABORT_WNR_MASK) {
 				return cpu_vcpu_emulate_store(vcpu, regs,
 							      il, iss, fipa);
-			} else {
-				return cpu_vcpu_emulate_load(vcpu, regs,
-							     il, iss, fipa);
 			}
+			return cpu_vcpu_emulate_load(vcpu, regs,
+						     il, iss, fipa);
+		}
+
+		/* Determine instruction physical address */
+		va2pa_ns_pr(regs->pc);
+		inst_pa = read_par64();
+		inst_pa &= PAR64_PA_MASK;
+		inst_pa |= (regs->pc & 0x00000FFF);
+
+		/* Read the faulting instruction */
+		/* FIXME: Should this be cacheable memory access ? */
+		read_count = vmm_host_memory_read(inst_pa,
+					&inst, sizeof(inst), TRUE);
+		if (read_count != sizeof(inst)) {
+			return VMM_EFAIL;
+		}
+		if (regs->cpsr & CPSR_THUMB_ENABLED) {
+			return emulate_thumb_inst(vcpu, regs, inst);
+		} else {
+			return emulate_arm_inst(vcpu, regs, inst);
 		}
 	default:
 		break;
@@ -37,9 +37,12 @@
 #include <cpu_vcpu_cp15.h>
 #include <cpu_vcpu_switch.h>
 #include <cpu_vcpu_helper.h>
+#include <cpu_vcpu_excep.h>
 
+#include <emulate_psci.h>
 #include <generic_timer.h>
 #include <arm_features.h>
+#include <cpu_mmu_lpae.h>
 #include <mmu_lpae.h>
 
 void cpu_vcpu_halt(struct vmm_vcpu *vcpu, arch_regs_t *regs)
@@ -459,6 +462,11 @@ int arch_guest_init(struct vmm_guest *guest)
 			/* By default, assume PSCI v0.1 */
 			arm_guest_priv(guest)->psci_version = 1;
 		}
+
+		arm_guest_priv(guest)->pvtime_avail =
+			vmm_devtree_read_physaddr(guest->node, "pvtime_base",
+				&arm_guest_priv(guest)->pvtime_base) ?
+			FALSE : TRUE;
 	}
 
 	return VMM_OK;
@@ -481,12 +489,18 @@ int arch_guest_deinit(struct vmm_guest *guest)
 
 int arch_guest_add_region(struct vmm_guest *guest, struct vmm_region *region)
 {
-	return VMM_OK;
+	return cpu_vcpu_stage2_premap(guest, region);
 }
 
 int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 {
-	return VMM_OK;
+	return cpu_vcpu_stage2_unmap(guest, region);
+}
+
+int arch_guest_write_protect(struct vmm_guest *guest,
+			     physical_addr_t gphys, physical_size_t size)
+{
+	return cpu_vcpu_stage2_wprot(guest, gphys, size);
 }
 
 int arch_vcpu_init(struct vmm_vcpu *vcpu)
@@ -723,6 +737,9 @@ int arch_vcpu_init(struct vmm_vcpu *vcpu)
 	/* Set last host CPU to invalid value */
 	p->last_hcpu = 0xFFFFFFFF;
 
+	/* Guest has to request PV stolen time again after reset */
+	p->pvtime_enabled = FALSE;
+
 	/* Initialize VCPU VFP context */
 	rc = cpu_vcpu_vfp_init(vcpu);
 	if (rc) {
@@ -918,15 +935,16 @@ void arch_vcpu_switch(struct vmm_vcpu *tvcpu,
 		write_hcptr(arm_priv(vcpu)->hcptr);
 		write_hstr(arm_priv(vcpu)->hstr);
 		/* Update hypervisor Stage2 MMU context */
-		mmu_lpae_stage2_chttbl(vcpu->guest->id,
-			       arm_guest_priv(vcpu->guest)->ttbl);
+		mmu_lpae_stage2_chttbl(arm_guest_priv(vcpu->guest)->ttbl);
 		/* Flush TLB if moved to new host CPU */
 		if (arm_priv(vcpu)->last_hcpu != vmm_smp_processor_id()) {
 			/* Invalidate all guest TLB enteries because
 			 * we might have stale guest TLB enteries from
 			 * our previous run on new_hcpu host CPU
+			 * (only local TLB because other host CPUs
+			 * don't matter)
 			 */
-			inv_tlb_guest_allis();
+			cpu_invalid_vmid_local_guest_tlb();
 			/* Invalidate i-cache due always fetch fresh
 			 * code after moving to new_hcpu host CPU
 			 */
@@ -954,6 +972,9 @@ void arch_vcpu_post_switch(struct vmm_vcpu *vcpu,
 		generic_timer_vcpu_context_post_restore(vcpu,
 						arm_gentimer_context(vcpu));
 	}
+
+	/* Publish steal time accumulated while VCPU was not running */
+	emulate_psci_pvtime_update(vcpu);
 }
 
 void arch_vcpu_preempt_orphan(void)
@@ -1070,3 +1091,105 @@ void arch_vcpu_stat_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 {
 	/* For now no arch specific stats */
 }
+
+/* Note: Banked, VFP, CP14 and CP15 registers of a VCPU which is
+ * not running are always saved in arm_priv hence HW copy is not needed.
+ */
+int arch_vcpu_state_save(struct vmm_vcpu *vcpu,
+			 struct vmm_snapshot_state *st)
+{
+	int rc;
+	irq_flags_t flags;
+	u32 hcr;
+	struct arm_priv *p;
+
+	if (!vcpu->is_normal) {
+		return VMM_EINVALID;
+	}
+	p = arm_priv(vcpu);
+
+	vmm_spin_lock_irqsave(&p->hcr_lock, flags);
+	hcr = p->hcr;
+	vmm_spin_unlock_irqrestore(&p->hcr_lock, flags);
+
+	if ((rc = vmm_snapshot_put_var(st, p->cpuid)) ||
+	    (rc = vmm_snapshot_put_var(st, *arm_regs(vcpu))) ||
+	    (rc = vmm_snapshot_put_var(st, hcr)) ||
+	    (rc = vmm_snapshot_put_var(st, p->hcptr)) ||
+	    (rc = vmm_snapshot_put_var(st, p->hstr)) ||
+	    (rc = vmm_snapshot_put_var(st, p->bnk)) ||
+	    (rc = vmm_snapshot_put_var(st, p->vfp)) ||
+	    (rc = vmm_snapshot_put_var(st, p->cp14)) ||
+	    (rc = vmm_snapshot_put_var(st, p->cp15)) ||
+	    (rc = vmm_snapshot_put_var(st, p->pvtime_enabled))) {
+		return rc;
+	}
+
+	if (!arm_feature(vcpu, ARM_FEATURE_GENERIC_TIMER)) {
+		return VMM_OK;
+	}
+
+	return generic_timer_vcpu_context_state_save(vcpu,
+					arm_gentimer_context(vcpu), st);
+}
+
+int arch_vcpu_state_restore(struct vmm_vcpu *vcpu,
+			    struct vmm_snapshot_state *st)
+{
+	int rc;
+	u32 cpuid, hcr;
+	irq_flags_t flags;
+	struct arm_priv *p;
+
+	if (!vcpu->is_normal) {
+		return VMM_EINVALID;
+	}
+	p = arm_priv(vcpu);
+
+	if ((rc = vmm_snapshot_get_var(st, cpuid))) {
+		return rc;
+	}
+	if (cpuid != p->cpuid) {
+		return VMM_EINVALID;
+	}
+
+	if ((rc = vmm_snapshot_get_var(st, *arm_regs(vcpu))) ||
+	    (rc = vmm_snapshot_get_var(st, hcr)) ||
+	    (rc = vmm_snapshot_get_var(st, p->hcptr)) ||
+	    (rc = vmm_snapshot_get_var(st, p->hstr)) ||
+	    (rc = vmm_snapshot_get_var(st, p->bnk)) ||
+	    (rc = vmm_snapshot_get_var(st, p->vfp)) ||
+	    (rc = vmm_snapshot_get_var(st, p->cp14)) ||
+	    (rc = vmm_snapshot_get_var(st, p->cp15)) ||
+	    (rc = vmm_snapshot_get_var(st, p->pvtime_enabled))) {
+		return rc;
+	}
+
+	vmm_spin_lock_irqsave(&p->hcr_lock, flags);
+	p->hcr = hcr;
+	vmm_spin_unlock_irqrestore(&p->hcr_lock, flags);
+
+	if (!arm_feature(vcpu, ARM_FEATURE_GENERIC_TIMER)) {
+		return VMM_OK;
+	}
+
+	return generic_timer_vcpu_context_state_restore(vcpu,
+					arm_gentimer_context(vcpu), st);
+}
+
+bool arch_vcpu_sample_pc(struct vmm_vcpu *vcpu, arch_regs_t *regs,
+			 virtual_addr_t *host_pc, virtual_addr_t *guest_pc)
+{
+	/* Anything other than HYP mode is guest mode */
+	if (vcpu->is_normal &&
+	    ((arm_cpsr(regs) & CPSR_MODE_MASK) != CPSR_MODE_HYPERVISOR)) {
+		*host_pc = 0;
+		*guest_pc = arm_pc(regs);
+		return TRUE;
+	}
+
+	*host_pc = arm_pc(regs);
+	*guest_pc = 0;
+
+	return FALSE;
+}
@@ -25,8 +25,12 @@
 #define _ARCH_CONFIG_H__
 
 #define ARCH_HAS_MEMORY_READWRITE
+#define ARCH_HAS_MEMORY_ZERO
 
 #define ARCH_HAS_MEMCPY
 #define ARCH_HAS_MEMSET
 
+/* Generic counter can be read inline (see arch_clocksource.h) */
+#define ARCH_HAS_CLOCKSOURCE_FAST_READ
+
 #endif /* _ARCH_CONFIG_H__ */
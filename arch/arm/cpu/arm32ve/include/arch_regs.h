@@ -215,6 +215,8 @@ struct arm_priv {
 	vmm_cpumask_t dflush_needed;
 	/* Last host CPU on which this VCPU ran */
 	u32 last_hcpu;
+	/* PV stolen time structure requested by VCPU */
+	bool pvtime_enabled;
 	/* Generic timer context */
 	void *gentimer_priv;
 	/* VGIC context */
@@ -232,6 +234,9 @@ struct arm_guest_priv {
 	 * Bits[15:0] = Minor number
 	 */
 	u32 psci_version;
+	/* Guest physical base of PV stolen time structures */
+	bool pvtime_avail;
+	physical_addr_t pvtime_base;
 };
 
 #define arm_regs(vcpu)		(&((vcpu)->regs))
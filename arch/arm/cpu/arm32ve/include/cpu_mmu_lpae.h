@@ -30,10 +30,21 @@
 #define TTBL_FIRST_LEVEL		1
 #define TTBL_LAST_LEVEL			3
 
-#define cpu_invalid_ipa_guest_tlb(ipa)		inv_tlb_guest_allis()
 #define cpu_invalid_va_hypervisor_tlb(va)	inv_tlb_hyp_mvais((va))
 #define cpu_invalid_all_tlbs()			inv_utlb_all()
 
+/* ARMv7 has no VMID or IPA based stage2 TLB maintenance from Hyp
+ * mode so all guest TLB entries are invalidated instead.
+ */
+#define cpu_invalid_all_guest_tlbs()		inv_tlb_guest_allis()
+#define cpu_invalid_vmid_guest_tlb()		inv_tlb_guest_allis()
+#define cpu_invalid_vmid_local_guest_tlb()	inv_tlb_guest_all()
+#define cpu_invalid_ipa_guest_tlb(ipa)		inv_tlb_guest_allis()
+#define cpu_invalid_ipa_range_guest_tlb(ipa, size) inv_tlb_guest_allis()
+
+/* Only 8-bit VMIDs */
+#define cpu_stage2_vmid_init()			8
+
 #define cpu_stage2_ttbl_pa()				\
 		(read_vttbr() & VTTBR_BADDR_MASK)
 #define cpu_stage2_vmid()				\
@@ -40,4 +40,14 @@ int cpu_vcpu_data_abort(struct vmm_vcpu *vcpu,
 			virtual_addr_t dfar,
 			physical_addr_t fipa);
 
+/** Eagerly map pre-mapped guest region in stage2 */
+int cpu_vcpu_stage2_premap(struct vmm_guest *guest, struct vmm_region *reg);
+
+/** Unmap pre-mapped guest region from stage2 */
+int cpu_vcpu_stage2_unmap(struct vmm_guest *guest, struct vmm_region *reg);
+
+/** Write-protect stage2 pages of given guest physical range */
+int cpu_vcpu_stage2_wprot(struct vmm_guest *guest,
+			  physical_addr_t gphys, physical_size_t size);
+
 #endif /* _CPU_VCPU_EXCEP_H__ */
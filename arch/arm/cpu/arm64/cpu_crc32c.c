@@ -0,0 +1,61 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cpu_crc32c.c
+ * @author agent (agent@local)
+ * @brief ARM64 specific CRC32C using CRC32 instructions
+ */
+
+#include <vmm_types.h>
+#include <vmm_host_io.h>
+#include <cpu_inline_asm.h>
+#include <cpu_defines.h>
+#include <libs/hash.h>
+
+struct crc32c_una64 {
+	u64 v;
+} __packed;
+
+size_t arch_crc32c(u32 *crc, const u8 *data, size_t len)
+{
+	size_t done;
+	u32 c = *crc;
+
+	if (!((mrs(id_aa64isar0_el1) & ID_AA64ISAR0_CRC32_MASK) >>
+						ID_AA64ISAR0_CRC32_SHIFT)) {
+		return 0;
+	}
+
+	for (done = 0; (done + 8) <= len; done += 8) {
+		asm volatile(".arch_extension crc\n\t"
+			     "crc32cx %w0, %w0, %x1\n\t"
+			     : "+r"(c)
+			     : "r"(vmm_le64_to_cpu(
+				((const struct crc32c_una64 *)&data[done])->v)));
+	}
+	for ( ; done < len; done++) {
+		asm volatile(".arch_extension crc\n\t"
+			     "crc32cb %w0, %w0, %w1\n\t"
+			     : "+r"(c)
+			     : "r"((u32)data[done]));
+	}
+
+	*crc = c;
+
+	return done;
+}
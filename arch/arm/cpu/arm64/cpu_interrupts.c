@@ -62,8 +62,8 @@ void do_bad_mode(arch_regs_t *regs, unsigned long mode)
 void do_sync(arch_regs_t *regs, unsigned long mode)
 {
 	int rc = VMM_OK;
-	u32 ec, il, iss;
-	u64 esr, far, elr;
+	u32 ec, il, iss, exit_reason = VMM_VCPU_EXIT_OTHER;
+	u64 esr, far, elr, exit_tstamp, emulate_tstamp;
 	physical_addr_t fipa = 0;
 	struct vmm_vcpu *vcpu;
 
@@ -97,8 +97,12 @@ void do_sync(arch_regs_t *regs, unsigned long mode)
 		vmm_panic("%s: please reboot ...\n", __func__);
 	}
 
+	exit_tstamp = vmm_manager_vcpu_exit_tstamp();
+
 	vmm_scheduler_irq_enter(regs, TRUE);
 
+	emulate_tstamp = vmm_manager_vcpu_exit_tstamp();
+
 	switch (ec) {
 	case EC_UNKNOWN:
 		/* We dont expect to get this trap so error */
@@ -106,22 +110,27 @@ void do_sync(arch_regs_t *regs, unsigned long mode)
 		break;
 	case EC_TRAP_WFI_WFE:
 		/* WFI emulation */
+		exit_reason = VMM_VCPU_EXIT_WFI;
 		rc = cpu_vcpu_emulate_wfi_wfe(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_MCR_MRC_CP15_A32:
 		/* MCR/MRC CP15 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_mcr_mrc_cp15(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_MCRR_MRRC_CP15_A32:
 		/* MCRR/MRRC CP15 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_mcrr_mrrc_cp15(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_MCR_MRC_CP14_A32:
 		/* MCR/MRC CP14 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_mcr_mrc_cp14(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_LDC_STC_CP14_A32:
 		/* LDC/STC CP14 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_ldc_stc_cp14(vcpu, regs, il, iss);
 		break;
 	case EC_SIMD_FPU:
@@ -138,10 +147,12 @@ void do_sync(arch_regs_t *regs, unsigned long mode)
 		break;
 	case EC_TRAP_MRC_VMRS_CP10_A32:
 		/* MRC (or VMRS) to CP10 for MVFR0, MVFR1 or FPSID */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_vmrs(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_MCRR_MRRC_CP14_A32:
 		/* MRRC to CP14 emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_mcrr_mrrc_cp14(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_SVC_A32:
@@ -151,26 +162,32 @@ void do_sync(arch_regs_t *regs, unsigned long mode)
 		break;
 	case EC_TRAP_SMC_A32:
 		/* SMC emulation for A32 guest */
+		exit_reason = VMM_VCPU_EXIT_HYPCALL;
 		rc = cpu_vcpu_emulate_smc32(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_SMC_A64:
 		/* SMC emulation for A64 guest */
+		exit_reason = VMM_VCPU_EXIT_HYPCALL;
 		rc = cpu_vcpu_emulate_smc64(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_HVC_A32:
 		/* HVC emulation for A32 guest */
+		exit_reason = VMM_VCPU_EXIT_HYPCALL;
 		rc = cpu_vcpu_emulate_hvc32(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_HVC_A64:
 		/* HVC emulation for A64 guest */
+		exit_reason = VMM_VCPU_EXIT_HYPCALL;
 		rc = cpu_vcpu_emulate_hvc64(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_MSR_MRS_SYSTEM:
 		/* MSR/MRS/SystemRegs emulation */
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
 		rc = cpu_vcpu_emulate_msr_mrs_system(vcpu, regs, il, iss);
 		break;
 	case EC_TRAP_LWREL_INST_ABORT:
 		/* Stage2 instruction abort */
+		exit_reason = VMM_VCPU_EXIT_MMIO;
 		fipa = (mrs(hpfar_el2) & HPFAR_FIPA_MASK) >> HPFAR_FIPA_SHIFT;
 		fipa = fipa << HPFAR_FIPA_PAGE_SHIFT;
 		fipa = fipa | (mrs(far_el2) & HPFAR_FIPA_PAGE_MASK);
@@ -178,6 +195,7 @@ void do_sync(arch_regs_t *regs, unsigned long mode)
 		break;
 	case EC_TRAP_LWREL_DATA_ABORT:
 		/* Stage2 data abort */
+		exit_reason = VMM_VCPU_EXIT_MMIO;
 		fipa = (mrs(hpfar_el2) & HPFAR_FIPA_MASK) >> HPFAR_FIPA_SHIFT;
 		fipa = fipa << HPFAR_FIPA_PAGE_SHIFT;
 		fipa = fipa | (mrs(far_el2) & HPFAR_FIPA_PAGE_MASK);
@@ -213,16 +231,37 @@ void do_sync(arch_regs_t *regs, unsigned long mode)
 		}
 	}
 
+	vmm_manager_vcpu_exit_account(vcpu, exit_reason,
+				      exit_tstamp, emulate_tstamp);
+
 	vmm_scheduler_irq_exit(regs);
+
+	vmm_manager_vcpu_exit_return(vcpu);
 }
 
 void do_irq(arch_regs_t *regs)
 {
+	u64 exit_tstamp = vmm_manager_vcpu_exit_tstamp();
+	u64 emulate_tstamp;
+	struct vmm_vcpu *vcpu = NULL;
+
 	vmm_scheduler_irq_enter(regs, FALSE);
 
+	/* IRQs taken below EL2 are VM exits of Normal VCPUs */
+	if ((regs->pstate & PSR_EL_MASK) != PSR_EL_2) {
+		vcpu = vmm_scheduler_current_vcpu();
+	}
+
+	emulate_tstamp = vmm_manager_vcpu_exit_tstamp();
+
 	vmm_host_active_irq_exec(EXC_HYP_IRQ_SPx);
 
+	vmm_manager_vcpu_exit_account(vcpu, VMM_VCPU_EXIT_IRQ,
+				      exit_tstamp, emulate_tstamp);
+
 	vmm_scheduler_irq_exit(regs);
+
+	vmm_manager_vcpu_exit_return(vcpu);
 }
 
 void do_hyp_fiq(arch_regs_t *regs)
@@ -0,0 +1,71 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cpu_sha256.c
+ * @author agent (agent@local)
+ * @brief ARM64 specific SHA-256 block hashing
+ *
+ * SHA-256 blocks are hashed using ARMv8 Crypto Extensions when host
+ * CPU implements them. The SIMD registers used might be holding VFP
+ * state of some VCPU (restored lazily) so interrupts are disabled
+ * while hashing and the low-level routine saves/restores registers.
+ */
+
+#include <vmm_types.h>
+#include <arch_cpu_irq.h>
+#include <cpu_inline_asm.h>
+#include <cpu_defines.h>
+#include <libs/sha256.h>
+
+/* Upper bound on blocks hashed with interrupts disabled */
+#define SHA256_CE_BATCH_BLOCKS		64
+
+extern void __sha256_ce_transform(u32 *state, const u8 *data, u32 nblocks);
+
+u32 arch_sha256_blocks(u32 *state, const u8 *data, u32 nblocks)
+{
+	u32 done, batch;
+	u64 saved_cptr_el2;
+	irq_flags_t flags;
+
+	if (!((mrs(id_aa64isar0_el1) & ID_AA64ISAR0_SHA2_MASK) >>
+						ID_AA64ISAR0_SHA2_SHIFT)) {
+		return 0;
+	}
+
+	for (done = 0; done < nblocks; done += batch) {
+		batch = nblocks - done;
+		if (SHA256_CE_BATCH_BLOCKS < batch) {
+			batch = SHA256_CE_BATCH_BLOCKS;
+		}
+
+		arch_cpu_irq_save(flags);
+
+		/* SIMD access traps to EL2 when CPTR_EL2.TFP is set */
+		saved_cptr_el2 = mrs(cptr_el2);
+		msr_sync(cptr_el2, saved_cptr_el2 & ~CPTR_TFP_MASK);
+
+		__sha256_ce_transform(state, data + done * 64, batch);
+
+		msr_sync(cptr_el2, saved_cptr_el2);
+
+		arch_cpu_irq_restore(flags);
+	}
+
+	return done;
+}
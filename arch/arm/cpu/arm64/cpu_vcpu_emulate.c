@@ -159,9 +159,11 @@ int cpu_vcpu_emulate_wfi_wfe(struct vmm_vcpu *vcpu,
 		goto done;
 	}
 
-	/* If WFE trapped then only yield */
+	/* If WFE trapped then guest is likely spinning on a
+	 * contended lock so yield to the lock holder
+	 */
 	if (iss & ISS_WFI_WFE_TI_MASK) {
-		vmm_scheduler_yield();
+		vmm_scheduler_yield_spin();
 		goto done;
 	}
 
@@ -456,12 +458,29 @@ int cpu_vcpu_emulate_msr_mrs_system(struct vmm_vcpu *vcpu,
 	return rc;
 }
 
-static inline u32 arm_sign_extend(u32 imm, u32 len, u32 bits)
+static inline enum vmm_devemu_endianness cpu_vcpu_data_endian(
+					struct vmm_vcpu *vcpu,
+					arch_regs_t *regs)
 {
-	if (imm & (1 << (len - 1))) {
-		imm = imm | (~((1 << len) - 1));
+	if (regs->pstate & PSR_MODE32) { /* Aarch32 VCPU */
+		return (regs->pstate & CPSR_BE_ENABLED) ?
+			VMM_DEVEMU_BIG_ENDIAN : VMM_DEVEMU_LITTLE_ENDIAN;
+	}
+
+	/* Aarch64 VCPU */
+	return (arm_priv(vcpu)->sysregs.sctlr_el1 & SCTLR_EE_MASK) ?
+			VMM_DEVEMU_BIG_ENDIAN : VMM_DEVEMU_LITTLE_ENDIAN;
+}
+
+static inline void cpu_vcpu_emulate_next(struct vmm_vcpu *vcpu,
+					 arch_regs_t *regs, u32 il)
+{
+	/* Next instruction */
+	regs->pc += (il) ? 4 : 2;
+	/* Update ITSTATE for Thumb mode */
+	if (regs->pstate & PSR_THUMB_ENABLED) {
+		cpu_vcpu_update_itstate(vcpu, regs);
 	}
-	return imm & ((1 << bits) - 1);
 }
 
 int cpu_vcpu_emulate_load(struct vmm_vcpu *vcpu,
@@ -470,81 +489,35 @@ int cpu_vcpu_emulate_load(struct vmm_vcpu *vcpu,
 			  physical_addr_t ipa)
 {
 	int rc;
-	u8 data8;
-	u16 data16;
-	u32 data32, sas, sse, srt;
-	enum vmm_devemu_endianness data_endian;
+	u64 data = 0;
+	u32 len, bits, srt;
 
-	if (regs->pstate & PSR_MODE32) { /* Aarch32 VCPU */
-		if (regs->pstate & CPSR_BE_ENABLED) {
-			data_endian = VMM_DEVEMU_BIG_ENDIAN;
-		} else {
-			data_endian = VMM_DEVEMU_LITTLE_ENDIAN;
-		}
-	} else { /* Aarch64 VCPU */
-		if (arm_priv(vcpu)->sysregs.sctlr_el1 & SCTLR_EE_MASK) {
-			data_endian = VMM_DEVEMU_BIG_ENDIAN;
-		} else {
-			data_endian = VMM_DEVEMU_LITTLE_ENDIAN;
-		}
-	}
-
-	sas = (iss & ISS_ABORT_SAS_MASK) >> ISS_ABORT_SAS_SHIFT;
-	sse = (iss & ISS_ABORT_SSE_MASK) >> ISS_ABORT_SSE_SHIFT;
+	/* Access size is 1 << SAS bytes */
+	len = 1 << ((iss & ISS_ABORT_SAS_MASK) >> ISS_ABORT_SAS_SHIFT);
 	srt = (iss & ISS_ABORT_SRT_MASK) >> ISS_ABORT_SRT_SHIFT;
 
-	sse = (sas == 2) ? 0 : sse;
+	rc = vmm_devemu_emulate_read(vcpu, ipa, &data, len,
+				     cpu_vcpu_data_endian(vcpu, regs));
+	if (rc) {
+		return rc;
+	}
 
-	switch (sas) {
-	case 0:
-		rc = vmm_devemu_emulate_read(vcpu, ipa,
-					     &data8, sizeof(data8),
-					     data_endian);
-		if (!rc) {
-			if (sse) {
-				cpu_vcpu_reg64_write(vcpu, regs, srt, 
-					arm_sign_extend(data8, 8, 32));
-			} else {
-				cpu_vcpu_reg64_write(vcpu, regs, srt, data8);
-			}
-		}
-		break;
-	case 1:
-		rc = vmm_devemu_emulate_read(vcpu, ipa,
-					     &data16, sizeof(data16),
-					     data_endian);
-		if (!rc) {
-			if (sse) {
-				cpu_vcpu_reg64_write(vcpu, regs, srt, 
-					arm_sign_extend(data16, 16, 32));
-			} else {
-				cpu_vcpu_reg64_write(vcpu, regs, srt, data16);
-			}
-		}
-		break;
-	case 2:
-		rc = vmm_devemu_emulate_read(vcpu, ipa,
-					     &data32, sizeof(data32),
-					     data_endian);
-		if (!rc) {
-			cpu_vcpu_reg64_write(vcpu, regs, srt, data32);
+	/* Sign extend to 32-bit or 64-bit (SF) destination register */
+	if ((iss & ISS_ABORT_SSE_MASK) && (len < sizeof(data))) {
+		bits = len * 8;
+		if (data & (1ULL << (bits - 1))) {
+			data |= ~0ULL << bits;
 		}
-		break;
-	default:
-		rc = VMM_EFAIL;
-		break;
-	};
-
-	if (!rc) {
-		/* Next instruction */
-		regs->pc += (il) ? 4 : 2;
-		/* Update ITSTATE for Thumb mode */
-		if (regs->pstate & PSR_THUMB_ENABLED) {
-			cpu_vcpu_update_itstate(vcpu, regs);
+		if (!(iss & ISS_ABORT_SF_MASK)) {
+			data &= 0xFFFFFFFFULL;
 		}
 	}
 
-	return rc;
+	cpu_vcpu_reg64_write(vcpu, regs, srt, data);
+
+	cpu_vcpu_emulate_next(vcpu, regs, il);
+
+	return VMM_OK;
 }
 
 int cpu_vcpu_emulate_store(struct vmm_vcpu *vcpu,
@@ -553,61 +526,23 @@ int cpu_vcpu_emulate_store(struct vmm_vcpu *vcpu,
 			   physical_addr_t ipa)
 {
 	int rc;
-	u8 data8;
-	u16 data16;
-	u32 data32, sas, srt;
-	enum vmm_devemu_endianness data_endian;
-
-	if (regs->pstate & PSR_MODE32) { /* Aarch32 VCPU */
-		if (regs->pstate & CPSR_BE_ENABLED) {
-			data_endian = VMM_DEVEMU_BIG_ENDIAN;
-		} else {
-			data_endian = VMM_DEVEMU_LITTLE_ENDIAN;
-		}
-	} else { /* Aarch64 VCPU */
-		if (arm_priv(vcpu)->sysregs.sctlr_el1 & SCTLR_EE_MASK) {
-			data_endian = VMM_DEVEMU_BIG_ENDIAN;
-		} else {
-			data_endian = VMM_DEVEMU_LITTLE_ENDIAN;
-		}
-	}
+	u64 data;
+	u32 len, srt;
 
-	sas = (iss & ISS_ABORT_SAS_MASK) >> ISS_ABORT_SAS_SHIFT;
+	/* Access size is 1 << SAS bytes */
+	len = 1 << ((iss & ISS_ABORT_SAS_MASK) >> ISS_ABORT_SAS_SHIFT);
 	srt = (iss & ISS_ABORT_SRT_MASK) >> ISS_ABORT_SRT_SHIFT;
 
-	switch (sas) {
-	case 0:
-		data8 = cpu_vcpu_reg64_read(vcpu, regs, srt);
-		rc = vmm_devemu_emulate_write(vcpu, ipa,
-					      &data8, sizeof(data8),
-					      data_endian);
-		break;
-	case 1:
-		data16 = cpu_vcpu_reg64_read(vcpu, regs, srt);
-		rc = vmm_devemu_emulate_write(vcpu, ipa,
-					      &data16, sizeof(data16),
-					      data_endian);
-		break;
-	case 2:
-		data32 = cpu_vcpu_reg64_read(vcpu, regs, srt);
-		rc = vmm_devemu_emulate_write(vcpu, ipa,
-					      &data32, sizeof(data32),
-					      data_endian);
-		break;
-	default:
-		rc = VMM_EFAIL;
-		break;
-	};
-
-	if (!rc) {
-		/* Next instruction */
-		regs->pc += (il) ? 4 : 2;
-		/* Update ITSTATE for Thumb mode */
-		if (regs->pstate & PSR_THUMB_ENABLED) {
-			cpu_vcpu_update_itstate(vcpu, regs);
-		}
+	/* Lower len bytes of little-endian host value are written */
+	data = cpu_vcpu_reg64_read(vcpu, regs, srt);
+	rc = vmm_devemu_emulate_write(vcpu, ipa, &data, len,
+				      cpu_vcpu_data_endian(vcpu, regs));
+	if (rc) {
+		return rc;
 	}
 
-	return rc;
+	cpu_vcpu_emulate_next(vcpu, regs, il);
+
+	return VMM_OK;
 }
 
@@ -32,9 +32,12 @@
 #include <cpu_vcpu_sysregs.h>
 #include <cpu_vcpu_vfp.h>
 #include <cpu_vcpu_helper.h>
+#include <cpu_vcpu_excep.h>
 
+#include <emulate_psci.h>
 #include <generic_timer.h>
 #include <arm_features.h>
+#include <cpu_mmu_lpae.h>
 #include <mmu_lpae.h>
 
 void cpu_vcpu_halt(struct vmm_vcpu *vcpu, arch_regs_t *regs)
@@ -320,6 +323,11 @@ int arch_guest_init(struct vmm_guest *guest)
 			/* By default, assume PSCI v0.1 */
 			arm_guest_priv(guest)->psci_version = 1;
 		}
+
+		arm_guest_priv(guest)->pvtime_avail =
+			vmm_devtree_read_physaddr(guest->node, "pvtime_base",
+				&arm_guest_priv(guest)->pvtime_base) ?
+			FALSE : TRUE;
 	}
 
 	return VMM_OK;
@@ -341,12 +349,18 @@ int arch_guest_deinit(struct vmm_guest *guest)
 
 int arch_guest_add_region(struct vmm_guest *guest, struct vmm_region *region)
 {
-	return VMM_OK;
+	return cpu_vcpu_stage2_premap(guest, region);
 }
 
 int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 {
-	return VMM_OK;
+	return cpu_vcpu_stage2_unmap(guest, region);
+}
+
+int arch_guest_write_protect(struct vmm_guest *guest,
+			     physical_addr_t gphys, physical_size_t size)
+{
+	return cpu_vcpu_stage2_wprot(guest, gphys, size);
 }
 
 int arch_vcpu_init(struct vmm_vcpu *vcpu)
@@ -567,6 +581,9 @@ int arch_vcpu_init(struct vmm_vcpu *vcpu)
 	/* Set last host CPU to invalid value */
 	arm_priv(vcpu)->last_hcpu = 0xFFFFFFFF;
 
+	/* Guest has to request PV stolen time again after reset */
+	arm_priv(vcpu)->pvtime_enabled = FALSE;
+
 	/* Initialize sysregs context */
 	rc = cpu_vcpu_sysregs_init(vcpu, cpuid);
 	if (rc) {
@@ -742,18 +759,15 @@ void arch_vcpu_switch(struct vmm_vcpu *tvcpu,
 		msr(cptr_el2, arm_priv(vcpu)->cptr);
 		msr(hstr_el2, arm_priv(vcpu)->hstr);
 		/* Update hypervisor Stage2 MMU context */
-		mmu_lpae_stage2_chttbl(vcpu->guest->id,
-			       arm_guest_priv(vcpu->guest)->ttbl);
+		mmu_lpae_stage2_chttbl(arm_guest_priv(vcpu->guest)->ttbl);
 		/* Flush TLB if moved to new host CPU */
 		if (arm_priv(vcpu)->last_hcpu != vmm_smp_processor_id()) {
-			/* Invalidate all guest TLB enteries because
-			 * we might have stale guest TLB enteries from
-			 * our previous run on new_hcpu host CPU
+			/* Invalidate local guest TLB enteries of our
+			 * VMID because we might have stale guest TLB
+			 * enteries from our previous run on new_hcpu
+			 * host CPU (other VMIDs are not affected)
 			 */
-			inv_tlb_guest_allis();
-			/* Ensure changes are visible */
-			dsb();
-			isb();
+			cpu_invalid_vmid_local_guest_tlb();
 		}
 	}
 	/* Clear exclusive monitor */
@@ -773,6 +787,9 @@ void arch_vcpu_post_switch(struct vmm_vcpu *vcpu,
 		generic_timer_vcpu_context_post_restore(vcpu,
 						arm_gentimer_context(vcpu));
 	}
+
+	/* Publish steal time accumulated while VCPU was not running */
+	emulate_psci_pvtime_update(vcpu);
 }
 
 void arch_vcpu_preempt_orphan(void)
@@ -846,3 +863,105 @@ void arch_vcpu_stat_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 {
 	/* For now no arch specific stats */
 }
+
+/* Note: EL1/EL0 sysregs and VFP registers of a VCPU which is not
+ * running are always saved in arm_priv hence HW copy is not needed.
+ */
+int arch_vcpu_state_save(struct vmm_vcpu *vcpu,
+			 struct vmm_snapshot_state *st)
+{
+	int rc;
+	irq_flags_t flags;
+	u64 hcr;
+	struct arm_priv *p;
+
+	if (!vcpu->is_normal) {
+		return VMM_EINVALID;
+	}
+	p = arm_priv(vcpu);
+
+	vmm_spin_lock_irqsave(&p->hcr_lock, flags);
+	hcr = p->hcr;
+	vmm_spin_unlock_irqrestore(&p->hcr_lock, flags);
+
+	if ((rc = vmm_snapshot_put_var(st, p->cpuid)) ||
+	    (rc = vmm_snapshot_put_var(st, *arm_regs(vcpu))) ||
+	    (rc = vmm_snapshot_put_var(st, hcr)) ||
+	    (rc = vmm_snapshot_put_var(st, p->hstr)) ||
+	    (rc = vmm_snapshot_put_var(st, p->sysregs)) ||
+	    (rc = vmm_snapshot_put_var(st, p->vfp)) ||
+	    (rc = vmm_snapshot_put_var(st, p->pvtime_enabled))) {
+		return rc;
+	}
+
+	if (!arm_feature(vcpu, ARM_FEATURE_GENERIC_TIMER)) {
+		return VMM_OK;
+	}
+
+	return generic_timer_vcpu_context_state_save(vcpu,
+					arm_gentimer_context(vcpu), st);
+}
+
+int arch_vcpu_state_restore(struct vmm_vcpu *vcpu,
+			    struct vmm_snapshot_state *st)
+{
+	int rc;
+	u32 cpuid;
+	irq_flags_t flags;
+	u64 hcr;
+	struct arm_priv *p;
+
+	if (!vcpu->is_normal) {
+		return VMM_EINVALID;
+	}
+	p = arm_priv(vcpu);
+
+	if ((rc = vmm_snapshot_get_var(st, cpuid))) {
+		return rc;
+	}
+	if (cpuid != p->cpuid) {
+		return VMM_EINVALID;
+	}
+
+	if ((rc = vmm_snapshot_get_var(st, *arm_regs(vcpu))) ||
+	    (rc = vmm_snapshot_get_var(st, hcr)) ||
+	    (rc = vmm_snapshot_get_var(st, p->hstr)) ||
+	    (rc = vmm_snapshot_get_var(st, p->sysregs)) ||
+	    (rc = vmm_snapshot_get_var(st, p->vfp)) ||
+	    (rc = vmm_snapshot_get_var(st, p->pvtime_enabled))) {
+		return rc;
+	}
+
+	vmm_spin_lock_irqsave(&p->hcr_lock, flags);
+	p->hcr = hcr;
+	vmm_spin_unlock_irqrestore(&p->hcr_lock, flags);
+
+	/* Force sysregs and VFP registers restore on next VCPU switch */
+	p->sysregs_hcpu = CONFIG_CPU_COUNT;
+	p->vfp_live = FALSE;
+	p->vfp_hcpu = CONFIG_CPU_COUNT;
+
+	if (!arm_feature(vcpu, ARM_FEATURE_GENERIC_TIMER)) {
+		return VMM_OK;
+	}
+
+	return generic_timer_vcpu_context_state_restore(vcpu,
+					arm_gentimer_context(vcpu), st);
+}
+
+bool arch_vcpu_sample_pc(struct vmm_vcpu *vcpu, arch_regs_t *regs,
+			 virtual_addr_t *host_pc, virtual_addr_t *guest_pc)
+{
+	/* Anything below EL2 is guest mode */
+	if (vcpu->is_normal &&
+	    ((arm_cpsr(regs) & PSR_MODE_MASK) != PSR_MODE64_EL2h)) {
+		*host_pc = 0;
+		*guest_pc = arm_pc(regs);
+		return TRUE;
+	}
+
+	*host_pc = arm_pc(regs);
+	*guest_pc = 0;
+
+	return FALSE;
+}
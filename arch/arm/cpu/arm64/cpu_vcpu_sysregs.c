@@ -23,6 +23,7 @@
 
 #include <vmm_error.h>
 #include <vmm_smp.h>
+#include <vmm_percpu.h>
 #include <vmm_cache.h>
 #include <vmm_stdio.h>
 #include <libs/stringlib.h>
@@ -303,14 +304,43 @@ bad_reg:
 	return FALSE;
 }
 
+/* Last VCPU which loaded its EL1/EL0 sysregs in HW of a host CPU */
+static DEFINE_PER_CPU(struct vmm_vcpu *, sysregs_owner);
+
+/* 32bit only sysregs are used only when EL1 is in AArch32 mode */
+static inline bool cpu_vcpu_sysregs_have_regs32(struct vmm_vcpu *vcpu)
+{
+	return (arm_priv(vcpu)->hcr & HCR_RW_MASK) ? FALSE : TRUE;
+}
+
 void cpu_vcpu_sysregs_save(struct vmm_vcpu *vcpu)
 {
-	cpu_vcpu_sysregs_regs_save(&arm_priv(vcpu)->sysregs);
+	struct arm_priv *p = arm_priv(vcpu);
+
+	cpu_vcpu_sysregs_regs_save(&p->sysregs);
+	if (cpu_vcpu_sysregs_have_regs32(vcpu)) {
+		cpu_vcpu_sysregs_regs32_save(&p->sysregs);
+	}
 }
 
 void cpu_vcpu_sysregs_restore(struct vmm_vcpu *vcpu)
 {
-	cpu_vcpu_sysregs_regs_restore(&arm_priv(vcpu)->sysregs);
+	u32 cpu = vmm_smp_processor_id();
+	struct arm_priv *p = arm_priv(vcpu);
+
+	/* Nobody else touches EL1/EL0 sysregs in HW so we skip
+	 * restoring them if this VCPU was the last one to load
+	 * its sysregs on this host CPU.
+	 */
+	if ((this_cpu(sysregs_owner) != vcpu) ||
+	    (p->sysregs_hcpu != cpu)) {
+		cpu_vcpu_sysregs_regs_restore(&p->sysregs);
+		if (cpu_vcpu_sysregs_have_regs32(vcpu)) {
+			cpu_vcpu_sysregs_regs32_restore(&p->sysregs);
+		}
+		this_cpu(sysregs_owner) = vcpu;
+		p->sysregs_hcpu = cpu;
+	}
 
 	/* Check whether vcpu requires dcache to be flushed on
 	 * this host CPU. This is a consequence of doing dcache
@@ -383,6 +413,9 @@ int cpu_vcpu_sysregs_init(struct vmm_vcpu *vcpu, u32 cpuid)
 	/* Clear all sysregs */
 	memset(s, 0, sizeof(struct arm_priv_sysregs));
 
+	/* Force sysregs restore on next VCPU switch */
+	arm_priv(vcpu)->sysregs_hcpu = CONFIG_CPU_COUNT;
+
 	/* Initialize VCPU MIDR and MPIDR registers */
 	switch (cpuid) {
 	case ARM_CPUID_CORTEXA9:
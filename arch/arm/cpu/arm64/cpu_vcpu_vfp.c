@@ -23,6 +23,8 @@
  */
 
 #include <vmm_error.h>
+#include <vmm_smp.h>
+#include <vmm_percpu.h>
 #include <vmm_stdio.h>
 #include <arch_regs.h>
 #include <cpu_inline_asm.h>
@@ -31,6 +33,9 @@
 
 #include <arm_features.h>
 
+/* Last VCPU which loaded its VFP registers in HW of a host CPU */
+static DEFINE_PER_CPU(struct vmm_vcpu *, vfp_owner);
+
 void cpu_vcpu_vfp_save(struct vmm_vcpu *vcpu)
 {
 	struct arm_priv *p = arm_priv(vcpu);
@@ -38,19 +43,24 @@ void cpu_vcpu_vfp_save(struct vmm_vcpu *vcpu)
 
 	/* Do nothing if:
 	 * 1. VCPU does not have VFPv3 feature
+	 * 2. VCPU did not load VFP registers in HW for current run
 	 */
-	if (!arm_feature(vcpu, ARM_FEATURE_VFP3)) {
+	if (!arm_feature(vcpu, ARM_FEATURE_VFP3) || !p->vfp_live) {
 		return;
 	}
 
-	/* Low-level VFP register save */
+	/* Low-level VFP register save
+	 * Note: The HW copy stays valid till some other VCPU
+	 * loads its VFP registers on this host CPU.
+	 */
 	cpu_vcpu_vfp_regs_save(vfp);
+	p->vfp_live = FALSE;
 }
 
 void cpu_vcpu_vfp_restore(struct vmm_vcpu *vcpu)
 {
+	u32 cpu = vmm_smp_processor_id();
 	struct arm_priv *p = arm_priv(vcpu);
-	struct arm_priv_vfp *vfp = &p->vfp;
 
 	/* Do nothing if:
 	 * 1. VCPU does not have VFPv3 feature
@@ -59,16 +69,42 @@ void cpu_vcpu_vfp_restore(struct vmm_vcpu *vcpu)
 		return;
 	}
 
-	/* Low-level VFP register restore */
-	cpu_vcpu_vfp_regs_restore(vfp);
+	/* If HW of this host CPU still has our VFP registers
+	 * then allow VFP access right away otherwise trap the
+	 * first VFP access and restore VFP registers lazily.
+	 */
+	if ((per_cpu(vfp_owner, cpu) == vcpu) && (p->vfp_hcpu == cpu)) {
+		p->cptr &= ~CPTR_TFP_MASK;
+		p->vfp_live = TRUE;
+	} else {
+		p->cptr |= CPTR_TFP_MASK;
+		p->vfp_live = FALSE;
+	}
 }
 
 int cpu_vcpu_vfp_trap(struct vmm_vcpu *vcpu,
 		      arch_regs_t *regs,
 		      u32 il, u32 iss)
 {
-	/* For now we don't handle VFP trap so just return failure. */
-	return VMM_EFAIL;
+	u32 cpu = vmm_smp_processor_id();
+	struct arm_priv *p = arm_priv(vcpu);
+
+	/* Only lazy VFP restore traps are handled. */
+	if (!arm_feature(vcpu, ARM_FEATURE_VFP3) || p->vfp_live) {
+		return VMM_EFAIL;
+	}
+
+	/* Low-level VFP register restore */
+	cpu_vcpu_vfp_regs_restore(&p->vfp);
+	per_cpu(vfp_owner, cpu) = vcpu;
+	p->vfp_hcpu = cpu;
+	p->vfp_live = TRUE;
+
+	/* Allow VFP access and retry the trapped instruction */
+	p->cptr &= ~CPTR_TFP_MASK;
+	msr(cptr_el2, p->cptr);
+
+	return VMM_OK;
 }
 
 void cpu_vcpu_vfp_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
@@ -113,6 +149,8 @@ int cpu_vcpu_vfp_init(struct vmm_vcpu *vcpu)
 
 	/* Clear VCPU VFP context */
 	memset(vfp, 0, sizeof(struct arm_priv_vfp));
+	p->vfp_live = FALSE;
+	p->vfp_hcpu = CONFIG_CPU_COUNT;
 
 	/* If host HW does not have VFP (i.e. software VFP) then
 	 * clear all VFP feature flags so that VCPU always gets
@@ -124,10 +162,10 @@ int cpu_vcpu_vfp_init(struct vmm_vcpu *vcpu)
 
 	/* If Host HW does not support VFPv3 or higher then
 	 * don't allow VFP access to VCPU using CPTR_EL2
+	 * (Note: For VFPv3 or higher, CPTR_EL2 traps first
+	 * VFP access after VCPU switch for lazy restore)
 	 */
-	if (arm_feature(vcpu, ARM_FEATURE_VFP3)) {
-		p->cptr &= ~CPTR_TFP_MASK;
-	} else {
+	if (!arm_feature(vcpu, ARM_FEATURE_VFP3)) {
 		goto no_vfp_for_vcpu;
 	}
 
@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file arch_gicv3.h
+ * @author agent (agent@local)
+ * @brief GICv3 CPU interface system register access for ARM64
+ *
+ * System registers are named using generic encoding so that older
+ * assemblers which do not know GICv3 registers can still build.
+ */
+
+#ifndef __ARCH_GICV3_H__
+#define __ARCH_GICV3_H__
+
+#include <vmm_types.h>
+#include <arch_barrier.h>
+#include <cpu_inline_asm.h>
+
+/* Physical CPU interface registers */
+#define ICC_PMR_EL1			S3_0_C4_C6_0
+#define ICC_DIR_EL1			S3_0_C12_C11_1
+#define ICC_SGI1R_EL1			S3_0_C12_C11_5
+#define ICC_IAR1_EL1			S3_0_C12_C12_0
+#define ICC_EOIR1_EL1			S3_0_C12_C12_1
+#define ICC_BPR1_EL1			S3_0_C12_C12_3
+#define ICC_CTLR_EL1			S3_0_C12_C12_4
+#define ICC_SRE_EL1			S3_0_C12_C12_5
+#define ICC_IGRPEN1_EL1			S3_0_C12_C12_7
+#define ICC_SRE_EL2			S3_4_C12_C9_5
+
+#define ICC_SRE_EL2_SRE			(1 << 0)
+#define ICC_SRE_EL2_ENABLE		(1 << 3)
+#define ICC_SRE_EL1_SRE			(1 << 0)
+
+#define ICC_CTLR_EL1_EOIMODE_DROP	(1 << 1)
+
+#define ICC_IAR1_EL1_INTID_MASK		0xffffff
+
+#define ICC_SGI1R_TARGET_LIST_MASK	0xffff
+#define ICC_SGI1R_AFFINITY_1_SHIFT	16
+#define ICC_SGI1R_SGI_ID_SHIFT		24
+#define ICC_SGI1R_AFFINITY_2_SHIFT	32
+#define ICC_SGI1R_AFFINITY_3_SHIFT	48
+
+/* Virtual interface control registers */
+#define ICH_AP0R0_EL2			S3_4_C12_C8_0
+#define ICH_AP0R1_EL2			S3_4_C12_C8_1
+#define ICH_AP0R2_EL2			S3_4_C12_C8_2
+#define ICH_AP0R3_EL2			S3_4_C12_C8_3
+#define ICH_AP1R0_EL2			S3_4_C12_C9_0
+#define ICH_AP1R1_EL2			S3_4_C12_C9_1
+#define ICH_AP1R2_EL2			S3_4_C12_C9_2
+#define ICH_AP1R3_EL2			S3_4_C12_C9_3
+#define ICH_HCR_EL2			S3_4_C12_C11_0
+#define ICH_VTR_EL2			S3_4_C12_C11_1
+#define ICH_MISR_EL2			S3_4_C12_C11_2
+#define ICH_EISR_EL2			S3_4_C12_C11_3
+#define ICH_ELRSR_EL2			S3_4_C12_C11_5
+#define ICH_VMCR_EL2			S3_4_C12_C11_7
+
+#define gic_read_sysreg(reg)		mrs(reg)
+#define gic_write_sysreg(reg, val)	msr(reg, (u64)(val))
+
+static inline u32 gic_read_iar(void)
+{
+	u64 irqstat = gic_read_sysreg(ICC_IAR1_EL1);
+
+	dsb();
+
+	return irqstat & ICC_IAR1_EL1_INTID_MASK;
+}
+
+static inline void gic_write_eoir(u32 irq)
+{
+	gic_write_sysreg(ICC_EOIR1_EL1, irq);
+	isb();
+}
+
+static inline void gic_write_dir(u32 irq)
+{
+	gic_write_sysreg(ICC_DIR_EL1, irq);
+	isb();
+}
+
+static inline void gic_write_sgi1r(u64 val)
+{
+	gic_write_sysreg(ICC_SGI1R_EL1, val);
+}
+
+#define __ICH_LR_CASE(n, crm, op2, expr)	\
+	case n: expr(S3_4_C12_##crm##_##op2); break
+
+#define __ICH_LR_SWITCH(lr, expr)		\
+	switch (lr) {				\
+	__ICH_LR_CASE(0, C12, 0, expr);		\
+	__ICH_LR_CASE(1, C12, 1, expr);		\
+	__ICH_LR_CASE(2, C12, 2, expr);		\
+	__ICH_LR_CASE(3, C12, 3, expr);		\
+	__ICH_LR_CASE(4, C12, 4, expr);		\
+	__ICH_LR_CASE(5, C12, 5, expr);		\
+	__ICH_LR_CASE(6, C12, 6, expr);		\
+	__ICH_LR_CASE(7, C12, 7, expr);		\
+	__ICH_LR_CASE(8, C13, 0, expr);		\
+	__ICH_LR_CASE(9, C13, 1, expr);		\
+	__ICH_LR_CASE(10, C13, 2, expr);	\
+	__ICH_LR_CASE(11, C13, 3, expr);	\
+	__ICH_LR_CASE(12, C13, 4, expr);	\
+	__ICH_LR_CASE(13, C13, 5, expr);	\
+	__ICH_LR_CASE(14, C13, 6, expr);	\
+	__ICH_LR_CASE(15, C13, 7, expr);	\
+	default: break;				\
+	}
+
+/** Read ICH_LR<lr>_EL2 */
+static inline u64 gic_read_ich_lr(u32 lr)
+{
+	u64 val = 0;
+
+#define __ICH_LR_READ(reg)	val = mrs(reg)
+	__ICH_LR_SWITCH(lr, __ICH_LR_READ)
+#undef __ICH_LR_READ
+
+	return val;
+}
+
+/** Write ICH_LR<lr>_EL2 */
+static inline void gic_write_ich_lr(u32 lr, u64 val)
+{
+#define __ICH_LR_WRITE(reg)	msr(reg, val)
+	__ICH_LR_SWITCH(lr, __ICH_LR_WRITE)
+#undef __ICH_LR_WRITE
+}
+
+#endif /* __ARCH_GICV3_H__ */
@@ -128,11 +128,19 @@ struct arm_priv {
 	u64 hstr;	/* Hypervisor System Trap Register */
 	/* EL1/EL0 sysregs */
 	struct arm_priv_sysregs sysregs;
+	/* Host CPU whose HW last loaded EL1/EL0 sysregs */
+	u32 sysregs_hcpu;
 	vmm_cpumask_t dflush_needed;
 	/* VFP & SMID context */
 	struct arm_priv_vfp vfp;
+	/* VFP & SMID registers loaded in HW for current run */
+	bool vfp_live;
+	/* Host CPU whose HW last loaded VFP & SMID registers */
+	u32 vfp_hcpu;
 	/* Last host CPU on which this VCPU ran */
 	u32 last_hcpu;
+	/* PV stolen time structure requested by VCPU */
+	bool pvtime_enabled;
 	/* Generic timer context */
 	void *gentimer_priv;
 	/* VGIC context */
@@ -150,6 +158,9 @@ struct arm_guest_priv {
 	 * Bits[15:0] = Minor number
 	 */
 	u32 psci_version;
+	/* Guest physical base of PV stolen time structures */
+	bool pvtime_avail;
+	physical_addr_t pvtime_base;
 };
 
 #define arm_regs(vcpu)		(&((vcpu)->regs))
@@ -611,13 +611,15 @@
 
 /* VTTBR */
 #define VTTBR_INITVAL					0x0000000000000000ULL
-#define VTTBR_VMID_MASK					0x00FF000000000000ULL
+#define VTTBR_VMID_MASK					0xFFFF000000000000ULL
 #define VTTBR_VMID_SHIFT				48
 #define VTTBR_BADDR_MASK				0x000000FFFFFFF000ULL
 #define VTTBR_BADDR_SHIFT				12
 
 /* VTCR_EL2 */
 #define VTCR_INITVAL					0x80000000
+#define VTCR_VS_MASK					0x00080000
+#define VTCR_VS_SHIFT					19
 #define VTCR_PS_MASK					0x00070000
 #define VTCR_PS_SHIFT					16
 #define VTCR_TG0_MASK					0x00004000
@@ -772,6 +774,20 @@
 #define ID_AA64PFR0_EL0_MASK				0x0000000f
 #define ID_AA64PFR0_EL0_SHIFT				0
 
+/* ID_AA64MMFR1_EL1 */
+#define ID_AA64MMFR1_VMIDBITS_MASK			0x000000f0
+#define ID_AA64MMFR1_VMIDBITS_SHIFT			4
+#define ID_AA64MMFR1_VMIDBITS_16			0x2
+
+/* ID_AA64ISAR0_EL1 */
+#define ID_AA64ISAR0_TLB_MASK				0x0f00000000000000ULL
+#define ID_AA64ISAR0_TLB_SHIFT				56
+#define ID_AA64ISAR0_TLB_RANGE				0x2
+#define ID_AA64ISAR0_SHA2_MASK				0x000000000000f000ULL
+#define ID_AA64ISAR0_SHA2_SHIFT				12
+#define ID_AA64ISAR0_CRC32_MASK				0x00000000000f0000ULL
+#define ID_AA64ISAR0_CRC32_SHIFT			16
+
 /* Field offsets for struct arm_priv_sysregs */
 #define ARM_PRIV_SYSREGS_sp_el0				0x0
 #define ARM_PRIV_SYSREGS_sp_el1				0x8
@@ -91,4 +91,21 @@ static inline unsigned long emulate_psci_get_mpidr(struct vmm_vcpu *vcpu)
 	return arm_priv(vcpu)->sysregs.mpidr_el1;
 }
 
+static inline bool emulate_psci_pvtime_base(struct vmm_vcpu *vcpu,
+					    physical_addr_t *base)
+{
+	*base = arm_guest_priv(vcpu->guest)->pvtime_base;
+	return arm_guest_priv(vcpu->guest)->pvtime_avail;
+}
+
+static inline bool emulate_psci_pvtime_enabled(struct vmm_vcpu *vcpu)
+{
+	return arm_priv(vcpu)->pvtime_enabled;
+}
+
+static inline void emulate_psci_pvtime_enable(struct vmm_vcpu *vcpu)
+{
+	arm_priv(vcpu)->pvtime_enabled = TRUE;
+}
+
 #endif	/* __CPU_EMULATE_PSCI_H__ */
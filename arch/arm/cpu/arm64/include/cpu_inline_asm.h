@@ -73,6 +73,16 @@
 					     "isb\n\t" \
 					     ::: "memory", "cc")
 
+#define inv_tlb_guest_cur_local() asm volatile("tlbi vmalls12e1\n\t" \
+					     "dsb nsh\n\t" \
+					     "isb\n\t" \
+					     ::: "memory", "cc")
+
+#define inv_tlb_guest_stage1()	asm volatile("tlbi vmalle1is\n\t" \
+					     "dsb sy\n\t" \
+					     "isb\n\t" \
+					     ::: "memory", "cc")
+
 #define inv_tlb_hyp_vais(va)	asm volatile("tlbi vae2is, %0\n\t" \
 					     "dsb sy\n\t" \
 					     "isb\n\t" \
@@ -83,6 +93,17 @@
 					     "isb\n\t" \
 					     ::"r"((va)>>12): "memory", "cc")
 
+/* Only issue TLBI (caller has to do DSB) */
+#define inv_tlb_guest_ipa_nosync(va) asm volatile("tlbi ipas2e1is, %0\n\t" \
+					     ::"r"((va)>>12): "memory", "cc")
+
+/* TLBI RIPAS2E1IS (ARMv8.4) as SYS encoding for older assemblers.
+ * Only issue TLBI (caller has to do DSB).
+ */
+#define inv_tlb_guest_ipa_range_nosync(arg) \
+				asm volatile("sys #4, c8, c0, #2, %0\n\t" \
+					     ::"r"(arg): "memory", "cc")
+
 #define inv_tlb_guest_va(va)	asm volatile("tlbi vaae1is, %0\n\t" \
 					     "dsb sy\n\t" \
 					     "isb\n\t" \
@@ -30,10 +30,88 @@
 #define TTBL_FIRST_LEVEL		1
 #define TTBL_LAST_LEVEL			3
 
-#define cpu_invalid_ipa_guest_tlb(ipa)		inv_tlb_guest_allis()
 #define cpu_invalid_va_hypervisor_tlb(va)	inv_tlb_hyp_vais((va))
 #define cpu_invalid_all_tlbs()			inv_tlb_hyp_all()
 
+/* Guest TLB maintenance below (except cpu_invalid_all_guest_tlbs)
+ * only applies to the VMID programmed in VTTBR_EL2. Stage1 entries
+ * of the VMID are dropped too because combined stage1+stage2 entries
+ * cannot be found by IPA.
+ */
+#define cpu_invalid_all_guest_tlbs()		inv_tlb_guest_allis()
+#define cpu_invalid_vmid_guest_tlb()		inv_tlb_guest_cur()
+#define cpu_invalid_vmid_local_guest_tlb()	inv_tlb_guest_cur_local()
+
+#define cpu_invalid_ipa_guest_tlb(ipa)					\
+	do {								\
+		inv_tlb_guest_ipa_nosync(ipa);				\
+		dsb();							\
+		inv_tlb_guest_stage1();					\
+	} while (0)
+
+/* Upto these many pages are invalidated one page at a time when
+ * range TLBI is not available. Larger ranges invalidate the VMID.
+ */
+#define CPU_TLBI_MAX_PAGES			64
+
+/* Pages covered by one range TLBI with given NUM and SCALE */
+#define CPU_TLBI_RANGE_PAGES(num, scale)				\
+	((u64)((num) + 1) << (5 * (scale) + 1))
+#define CPU_TLBI_RANGE_MAX_PAGES		CPU_TLBI_RANGE_PAGES(31, 3)
+
+/* Range TLBI operand for 4K granule (TG = 1) */
+#define CPU_TLBI_RANGE_ARG(ipa, num, scale)				\
+	((((u64)(ipa) >> 12) & 0x1FFFFFFFFFULL) |			\
+	 ((u64)(num) << 39) | ((u64)(scale) << 44) | (1ULL << 46))
+
+static inline void cpu_invalid_ipa_range_guest_tlb(physical_addr_t ipa,
+						   physical_size_t size)
+{
+	int num;
+	u32 scale = 0;
+	u64 pages = size >> 12;
+
+	if (((mrs(id_aa64isar0_el1) & ID_AA64ISAR0_TLB_MASK) >>
+		ID_AA64ISAR0_TLB_SHIFT) < ID_AA64ISAR0_TLB_RANGE) {
+		if (CPU_TLBI_MAX_PAGES < pages) {
+			cpu_invalid_vmid_guest_tlb();
+			return;
+		}
+		while (pages--) {
+			inv_tlb_guest_ipa_nosync(ipa);
+			ipa += 0x1000;
+		}
+		dsb();
+		inv_tlb_guest_stage1();
+		return;
+	}
+
+	if (CPU_TLBI_RANGE_MAX_PAGES <= pages) {
+		cpu_invalid_vmid_guest_tlb();
+		return;
+	}
+
+	/* Odd page first and then increasing scale (same as Linux) */
+	while (pages) {
+		if (pages & 0x1) {
+			inv_tlb_guest_ipa_nosync(ipa);
+			ipa += 0x1000;
+			pages--;
+			continue;
+		}
+		num = (int)((pages >> (5 * scale + 1)) & 0x1F) - 1;
+		if (num >= 0) {
+			inv_tlb_guest_ipa_range_nosync(
+				CPU_TLBI_RANGE_ARG(ipa, num, scale));
+			ipa += CPU_TLBI_RANGE_PAGES(num, scale) << 12;
+			pages -= CPU_TLBI_RANGE_PAGES(num, scale);
+		}
+		scale++;
+	}
+	dsb();
+	inv_tlb_guest_stage1();
+}
+
 #define cpu_stage2_ttbl_pa()						\
 	(mrs(vttbr_el2) & VTTBR_BADDR_MASK)
 #define cpu_stage2_vmid()						\
@@ -46,6 +124,19 @@
 	msr(vttbr_el2, vttbr);						\
 	} while(0);
 
+/* Enable 16-bit VMIDs if available and return VMID width */
+static inline u32 cpu_stage2_vmid_init(void)
+{
+	if (((mrs(id_aa64mmfr1_el1) & ID_AA64MMFR1_VMIDBITS_MASK) >>
+		ID_AA64MMFR1_VMIDBITS_SHIFT) == ID_AA64MMFR1_VMIDBITS_16) {
+		msr(vtcr_el2, mrs(vtcr_el2) | VTCR_VS_MASK);
+		isb();
+		return 16;
+	}
+
+	return 8;
+}
+
 static inline void cpu_mmu_sync_tte(u64 *tte)
 {
 	isb();
@@ -31,6 +31,12 @@ void cpu_vcpu_sysregs_regs_save(struct arm_priv_sysregs *s);
 /** Restore sysregs for given VCPU */
 void cpu_vcpu_sysregs_regs_restore(struct arm_priv_sysregs *s);
 
+/** Save 32bit only sysregs for given VCPU */
+void cpu_vcpu_sysregs_regs32_save(struct arm_priv_sysregs *s);
+
+/** Restore 32bit only sysregs for given VCPU */
+void cpu_vcpu_sysregs_regs32_restore(struct arm_priv_sysregs *s);
+
 /** Save VFP registers for given VCPU */
 void cpu_vcpu_vfp_regs_save(struct arm_priv_vfp *vfp);
 
@@ -40,8 +40,11 @@ cpu-objs-y+= cpu_init.o
 cpu-objs-y+= cpu_delay.o
 cpu-objs-y+= cpu_memcpy.o
 cpu-objs-y+= cpu_memset.o
+cpu-objs-y+= cpu_crc32c.o
 cpu-objs-$(CONFIG_MODULES)+= cpu_elf.o
 cpu-objs-$(CONFIG_ARM64_STACKTRACE)+= cpu_stacktrace.o
+cpu-objs-$(CONFIG_CRYPTO_HASH_SHA256)+= cpu_sha256.o
+cpu-objs-$(CONFIG_CRYPTO_HASH_SHA256)+= cpu_sha256_ce.o
 cpu-objs-$(CONFIG_SMP)+= cpu_locks.o
 cpu-objs-y+= cpu_atomic.o
 cpu-objs-y+= cpu_atomic64.o
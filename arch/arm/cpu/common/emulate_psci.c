@@ -24,7 +24,12 @@
 #include <vmm_error.h>
 #include <vmm_stdio.h>
 #include <vmm_vcpu_irq.h>
+#include <vmm_host_io.h>
+#include <vmm_guest_aspace.h>
+#include <vmm_devemu.h>
+#include <vmm_macros.h>
 #include <arch_barrier.h>
+#include <libs/stringlib.h>
 
 #include <cpu_defines.h>
 #include <cpu_emulate_psci.h>
@@ -49,6 +54,8 @@ static unsigned long psci_affinity_mask(unsigned long affinity_level)
 static unsigned long psci_vcpu_suspend(struct vmm_vcpu *vcpu,
 				       arch_regs_t *regs)
 {
+	unsigned long power_state;
+
 	/*
 	 * NOTE: For simplicity, we make VCPU suspend emulation to be
 	 * same-as WFI (Wait-for-interrupt) emulation.
@@ -61,8 +68,14 @@ static unsigned long psci_vcpu_suspend(struct vmm_vcpu *vcpu,
 	 * stand-by request as-per section 5.4.2 clause 3 of PSCI v0.2
 	 * specification (ARM DEN 0022A). This means all suspend states
 	 * for Xvisor will preserve the register state.
+	 *
+	 * The only difference is that a power-down request tells us
+	 * the guest tolerates long wakeup latency hence the host CPU
+	 * is allowed to enter its deep idle states meanwhile.
 	 */
-	vmm_vcpu_irq_wait_timeout(vcpu, 0);
+	power_state = emulate_psci_get_reg(vcpu, regs, 1);
+	vmm_vcpu_irq_wait_suspend(vcpu, 0,
+		(power_state & PSCI_0_2_POWER_STATE_TYPE_MASK) ? TRUE : FALSE);
 
 	return PSCI_RET_SUCCESS;
 }
@@ -275,6 +288,159 @@ static int emulate_psci_0_2_call(struct vmm_vcpu *vcpu, arch_regs_t *regs)
 	return VMM_OK;
 }
 
+/* Stolen time structure shared with Guest VCPU (ARM DEN 0057A) */
+struct psci_pvtime_stolen {
+	u32 revision;
+	u32 attributes;
+	u64 stolen_time;
+	u8 pad[48];
+} __packed;
+
+static bool psci_pvtime_gpa(struct vmm_vcpu *vcpu, physical_addr_t *gpa)
+{
+	physical_addr_t base;
+
+	if (!emulate_psci_pvtime_base(vcpu, &base)) {
+		return FALSE;
+	}
+
+	*gpa = base + vcpu->subid * sizeof(struct psci_pvtime_stolen);
+
+	return TRUE;
+}
+
+static unsigned long psci_pvtime_st(struct vmm_vcpu *vcpu)
+{
+	physical_addr_t gpa;
+	struct psci_pvtime_stolen st;
+
+	if (!psci_pvtime_gpa(vcpu, &gpa)) {
+		return PSCI_RET_NOT_SUPPORTED;
+	}
+
+	memset(&st, 0, sizeof(st));
+	st.stolen_time = vmm_cpu_to_le64(vmm_manager_vcpu_steal_nsecs(vcpu));
+	if (vmm_guest_memory_write(vcpu->guest, gpa, &st, sizeof(st),
+				   TRUE) != sizeof(st)) {
+		return PSCI_RET_NOT_SUPPORTED;
+	}
+	emulate_psci_pvtime_enable(vcpu);
+
+	return gpa;
+}
+
+void emulate_psci_pvtime_update(struct vmm_vcpu *vcpu)
+{
+	u64 stolen;
+	physical_addr_t gpa;
+
+	if (!emulate_psci_pvtime_enabled(vcpu) ||
+	    !psci_pvtime_gpa(vcpu, &gpa)) {
+		return;
+	}
+
+	/* Single 64-bit write so guest never sees a torn value */
+	stolen = vmm_cpu_to_le64(vmm_manager_vcpu_steal_nsecs(vcpu));
+	vmm_guest_memory_write(vcpu->guest,
+		gpa + offsetof(struct psci_pvtime_stolen, stolen_time),
+		&stolen, sizeof(stolen), TRUE);
+}
+
+static unsigned long psci_doorbell(struct vmm_vcpu *vcpu, arch_regs_t *regs)
+{
+	int rc;
+	physical_addr_t gpa;
+
+	gpa = (u32)emulate_psci_get_reg(vcpu, regs, 2);
+	gpa = (gpa << 32) | (u32)emulate_psci_get_reg(vcpu, regs, 1);
+
+	rc = vmm_devemu_ring_doorbell(vcpu->guest, gpa,
+				(u32)emulate_psci_get_reg(vcpu, regs, 3));
+	if (rc == VMM_ENOTAVAIL) {
+		return PSCI_RET_INVALID_PARAMS;
+	}
+
+	return (rc) ? PSCI_RET_INTERNAL_FAILURE : PSCI_RET_SUCCESS;
+}
+
+static unsigned long psci_features(struct vmm_vcpu *vcpu, u32 fn)
+{
+	physical_addr_t gpa;
+
+	switch (fn) {
+	case PSCI_0_2_FN_PSCI_VERSION:
+	case PSCI_0_2_FN_CPU_SUSPEND:
+	case PSCI_0_2_FN64_CPU_SUSPEND:
+	case PSCI_0_2_FN_CPU_OFF:
+	case PSCI_0_2_FN_CPU_ON:
+	case PSCI_0_2_FN64_CPU_ON:
+	case PSCI_0_2_FN_AFFINITY_INFO:
+	case PSCI_0_2_FN64_AFFINITY_INFO:
+	case PSCI_0_2_FN_MIGRATE_INFO_TYPE:
+	case PSCI_0_2_FN_SYSTEM_OFF:
+	case PSCI_0_2_FN_SYSTEM_RESET:
+	case PSCI_1_0_FN_PSCI_FEATURES:
+	case ARM_SMCCC_VERSION_FUNC_ID:
+	case ARM_SMCCC_HV_DOORBELL_FUNC_ID:
+		return PSCI_RET_SUCCESS;
+	case ARM_SMCCC_HV_PV_TIME_FEATURES:
+	case ARM_SMCCC_HV_PV_TIME_ST:
+		return (psci_pvtime_gpa(vcpu, &gpa)) ?
+			PSCI_RET_SUCCESS : PSCI_RET_NOT_SUPPORTED;
+	default:
+		break;
+	};
+
+	return PSCI_RET_NOT_SUPPORTED;
+}
+
+static int emulate_psci_1_0_call(struct vmm_vcpu *vcpu, arch_regs_t *regs)
+{
+	unsigned long psci_fn =
+			emulate_psci_get_reg(vcpu, regs, 0) & ~((u32)0);
+	u32 arg = emulate_psci_get_reg(vcpu, regs, 1) & ~((u32)0);
+	unsigned long val;
+
+	switch (psci_fn) {
+	case PSCI_0_2_FN_PSCI_VERSION:
+		/*
+		 * Bits[31:16] = Major Version = 1
+		 * Bits[15:0] = Minor Version = 0
+		 */
+		val = 0x10000;
+		break;
+	case PSCI_1_0_FN_PSCI_FEATURES:
+		val = psci_features(vcpu, arg);
+		break;
+	case ARM_SMCCC_VERSION_FUNC_ID:
+		val = ARM_SMCCC_VERSION_1_1;
+		break;
+	case ARM_SMCCC_ARCH_FEATURES_FUNC_ID:
+		val = ((arg == ARM_SMCCC_HV_PV_TIME_FEATURES) ||
+		       (arg == ARM_SMCCC_HV_DOORBELL_FUNC_ID)) ?
+			psci_features(vcpu, arg) : PSCI_RET_NOT_SUPPORTED;
+		break;
+	case ARM_SMCCC_HV_PV_TIME_FEATURES:
+		val = ((arg == ARM_SMCCC_HV_PV_TIME_FEATURES) ||
+		       (arg == ARM_SMCCC_HV_PV_TIME_ST)) ?
+			psci_features(vcpu, arg) : PSCI_RET_NOT_SUPPORTED;
+		break;
+	case ARM_SMCCC_HV_PV_TIME_ST:
+		val = psci_pvtime_st(vcpu);
+		break;
+	case ARM_SMCCC_HV_DOORBELL_FUNC_ID:
+		val = psci_doorbell(vcpu, regs);
+		break;
+	default:
+		/* Remaining functions are same as PSCI v0.2 */
+		return emulate_psci_0_2_call(vcpu, regs);
+	}
+
+	emulate_psci_set_reg(vcpu, regs, 0, val);
+
+	return VMM_OK;
+}
+
 /* PSCI v0.1 function numbers */
 #define PSCI_FN_BASE		0x95c1ba5e
 #define PSCI_FN(n)		(PSCI_FN_BASE + (n))
@@ -321,6 +487,8 @@ int emulate_psci_call(struct vmm_vcpu *vcpu, arch_regs_t *regs, bool is_smc)
 		return emulate_psci_0_1_call(vcpu, regs);
 	case 2: /* PSCI v0.2 */
 		return emulate_psci_0_2_call(vcpu, regs);
+	case 3: /* PSCI v1.0 with SMCCC v1.1 and PV time */
+		return emulate_psci_1_0_call(vcpu, regs);
 	default:
 		break;
 	};
@@ -31,6 +31,7 @@
 #include <vmm_host_aspace.h>
 #include <vmm_scheduler.h>
 #include <vmm_smp.h>
+#include <vmm_percpu.h>
 #include <vmm_devemu.h>
 #include <generic_timer.h>
 #include <cpu_generic_timer.h>
@@ -54,6 +55,10 @@ enum gen_timer_type {
 static u32 generic_timer_hz = 0;
 static u32 generic_timer_mult = 0;
 static u32 generic_timer_shift = 0;
+static u32 generic_virt_timer_hirq = 0;
+
+/* Last timer context loaded in HW timer registers of a host CPU */
+static DEFINE_PER_CPU(struct generic_timer_context *, generic_timer_owner);
 
 static void generic_timer_get_freq(struct vmm_devtree_node *node)
 {
@@ -101,6 +106,9 @@ static int __init generic_timer_clocksource_init(struct vmm_devtree_node *node)
 	cs->name = "gen-timer";
 	cs->rating = 400;
 	cs->read = &generic_counter_read;
+#if defined(ARCH_HAS_CLOCKSOURCE_FAST_READ)
+	cs->arch_read = TRUE;
+#endif
 	cs->mask = VMM_CLOCKSOURCE_MASK(56);
 	vmm_clocks_calc_mult_shift(&cs->mult, &cs->shift,
 				   generic_timer_hz, VMM_NSEC_PER_SEC, 10);
@@ -275,10 +283,26 @@ static vmm_irq_return_t generic_virt_timer_handler(int irq, void *dev)
 		return VMM_IRQ_NONE;
 	}
 
+	vcpu = vmm_scheduler_current_vcpu();
+	cntx = (vcpu->is_normal) ? arm_gentimer_context(vcpu) : NULL;
+
+	/* For HW mapped virtual timer irq the timer is left unmasked
+	 * and host irq stays active until guest deactivates it using
+	 * VGIC HW bit so we don't see this irq again till then.
+	 */
+	if (cntx && cntx->virt_hwirq) {
+		generic_virt_irq_inject(vcpu, cntx);
+		return VMM_IRQ_HANDLED;
+	}
+
 	ctl |= GENERIC_TIMER_CTRL_IT_MASK;
 	generic_timer_reg_write(GENERIC_TIMER_REG_VIRT_CTRL, ctl);
 
-	vcpu = vmm_scheduler_current_vcpu();
+#ifdef CONFIG_ARM_GENERIC_TIMER_HWIRQ
+	/* Routed host irq is not deactivated by host irqchip */
+	vmm_host_irq_set_routed_state(irq, 0, VMM_ROUTED_IRQ_STATE_ACTIVE);
+#endif
+
 	if (!vcpu->is_normal) {
 		/* We accidently got an interrupt meant for normal VCPU
 		 * that was previously running on this host CPU.
@@ -288,7 +312,6 @@ static vmm_irq_return_t generic_virt_timer_handler(int irq, void *dev)
 		return VMM_IRQ_NONE;
 	}
 
-	cntx = arm_gentimer_context(vcpu);
 	if (!cntx) {
 		/* We accidently got an interrupt meant another normal VCPU */
 		DPRINTF("%s: Invalid normal context (current VCPU=%s)\n",
@@ -395,6 +418,10 @@ static int __cpuinit generic_timer_clockchip_init(struct vmm_devtree_node *node)
 		if (rc) {
 			goto fail_unreg_ptimer;
 		}
+		generic_virt_timer_hirq = irq[GENERIC_VIRTUAL_TIMER];
+#ifdef CONFIG_ARM_GENERIC_TIMER_HWIRQ
+		vmm_host_irq_mark_routed(generic_virt_timer_hirq);
+#endif
 	}
 
 	if (num_irqs > 1) {
@@ -480,6 +507,9 @@ int generic_timer_vcpu_context_init(void *vcpu_ptr,
 	cntx->cntvoff = 0;
 	cntx->phys_timer_irq = phys_irq;
 	cntx->virt_timer_irq = virt_irq;
+	cntx->hcpu = CONFIG_CPU_COUNT;
+	cntx->virt_hwirq = FALSE;
+	cntx->virt_hwstate = 0;
 
 	vmm_timer_event_stop(&cntx->phys_ev);
 	vmm_timer_event_stop(&cntx->virt_ev);
@@ -503,6 +533,11 @@ int generic_timer_vcpu_context_deinit(void *vcpu_ptr, void **context)
 	vmm_timer_event_stop(&cntx->phys_ev);
 	vmm_timer_event_stop(&cntx->virt_ev);
 
+	if (cntx->hcpu < CONFIG_CPU_COUNT &&
+	    per_cpu(generic_timer_owner, cntx->hcpu) == cntx) {
+		per_cpu(generic_timer_owner, cntx->hcpu) = NULL;
+	}
+
 	vmm_free(cntx);
 
 	return VMM_OK;
@@ -531,6 +566,20 @@ void generic_timer_vcpu_context_save(void *vcpu_ptr, void *context)
 				GENERIC_TIMER_CTRL_IT_MASK);
 #endif
 
+	/* Active state of HW mapped virtual timer irq belongs to
+	 * this VCPU hence move it out of host irqchip.
+	 */
+	cntx->virt_hwstate = 0;
+	if (cntx->virt_hwirq) {
+		vmm_host_irq_get_routed_state(generic_virt_timer_hirq,
+					      &cntx->virt_hwstate,
+					      VMM_ROUTED_IRQ_STATE_ACTIVE);
+		if (cntx->virt_hwstate) {
+			vmm_host_irq_set_routed_state(generic_virt_timer_hirq,
+					0, VMM_ROUTED_IRQ_STATE_ACTIVE);
+		}
+	}
+
 	if ((cntx->cntpctl & GENERIC_TIMER_CTRL_ENABLE) &&
 	    !(cntx->cntpctl & GENERIC_TIMER_CTRL_IT_MASK)) {
 		ev_nsecs = cntx->cntpcval - generic_timer_pcounter_read();
@@ -545,8 +594,12 @@ void generic_timer_vcpu_context_save(void *vcpu_ptr, void *context)
 		vmm_timer_event_start(&cntx->phys_ev, ev_nsecs);
 	}
 
+	/* No background timer needed when guest is yet to deactivate
+	 * already injected HW mapped virtual timer irq.
+	 */
 	if ((cntx->cntvctl & GENERIC_TIMER_CTRL_ENABLE) &&
-	    !(cntx->cntvctl & GENERIC_TIMER_CTRL_IT_MASK)) {
+	    !(cntx->cntvctl & GENERIC_TIMER_CTRL_IT_MASK) &&
+	    !cntx->virt_hwstate) {
 		ev_nsecs = cntx->cntvcval + cntx->cntvoff -
 					generic_timer_pcounter_read();
 		/* check if timer is expired while saving the context */
@@ -577,11 +630,85 @@ void generic_timer_vcpu_context_restore(void *vcpu_ptr, void *context)
 		cntx->cntvoff = vmm_manager_guest_reset_timestamp(vcpu->guest);
 		cntx->cntvoff = cntx->cntvoff * generic_timer_hz;
 		cntx->cntvoff = udiv64(cntx->cntvoff, 1000000000ULL);
+		cntx->hcpu = CONFIG_CPU_COUNT;
 	}
+
+#ifdef CONFIG_ARM_GENERIC_TIMER_HWIRQ
+	/* Guest VGIC is available only after its emulator is probed */
+	if (!cntx->virt_hwirq && arm_vgic_avail(vcpu) &&
+	    cntx->virt_timer_irq && generic_virt_timer_hirq) {
+		if (!vmm_devemu_map_host2guest_irq(vcpu->guest,
+						   cntx->virt_timer_irq,
+						   generic_virt_timer_hirq)) {
+			cntx->virt_hwirq = TRUE;
+		}
+	}
+#endif
+}
+
+/* Virtual counter is saved instead of cntvoff because physical
+ * counter of host restoring the snapshot is unrelated to the
+ * physical counter of host which saved it.
+ */
+int generic_timer_vcpu_context_state_save(void *vcpu_ptr, void *context,
+					  struct vmm_snapshot_state *st)
+{
+	int rc;
+	u64 cntvct;
+	struct generic_timer_context *cntx = context;
+
+	if (!cntx || !st) {
+		return VMM_EINVALID;
+	}
+
+	cntvct = generic_timer_pcounter_read() - cntx->cntvoff;
+	if ((rc = vmm_snapshot_put_var(st, cntvct)) ||
+	    (rc = vmm_snapshot_put_var(st, cntx->cntpcval)) ||
+	    (rc = vmm_snapshot_put_var(st, cntx->cntvcval)) ||
+	    (rc = vmm_snapshot_put_var(st, cntx->cntkctl)) ||
+	    (rc = vmm_snapshot_put_var(st, cntx->cntpctl)) ||
+	    (rc = vmm_snapshot_put_var(st, cntx->cntvctl))) {
+		return rc;
+	}
+
+	return VMM_OK;
+}
+
+int generic_timer_vcpu_context_state_restore(void *vcpu_ptr, void *context,
+					     struct vmm_snapshot_state *st)
+{
+	int rc;
+	u64 cntvct;
+	struct generic_timer_context *cntx = context;
+
+	if (!cntx || !st) {
+		return VMM_EINVALID;
+	}
+
+	if ((rc = vmm_snapshot_get_var(st, cntvct)) ||
+	    (rc = vmm_snapshot_get_var(st, cntx->cntpcval)) ||
+	    (rc = vmm_snapshot_get_var(st, cntx->cntvcval)) ||
+	    (rc = vmm_snapshot_get_var(st, cntx->cntkctl)) ||
+	    (rc = vmm_snapshot_get_var(st, cntx->cntpctl)) ||
+	    (rc = vmm_snapshot_get_var(st, cntx->cntvctl))) {
+		return rc;
+	}
+
+	vmm_timer_event_stop(&cntx->phys_ev);
+	vmm_timer_event_stop(&cntx->virt_ev);
+	cntx->cntvoff = generic_timer_pcounter_read() - cntvct;
+	/* Zero cntvoff is treated as not initialized upon VCPU restore */
+	if (!cntx->cntvoff) {
+		cntx->cntvoff = 1;
+	}
+	cntx->hcpu = CONFIG_CPU_COUNT;
+
+	return VMM_OK;
 }
 
 void generic_timer_vcpu_context_post_restore(void *vcpu_ptr, void *context)
 {
+	u32 cpu;
 	u64 pcnt;
 	struct vmm_vcpu *vcpu = vcpu_ptr;
 	struct generic_timer_context *cntx = context;
@@ -599,13 +726,36 @@ void generic_timer_vcpu_context_post_restore(void *vcpu_ptr, void *context)
 		generic_phys_irq_inject(vcpu, cntx);
 	}
 
-	if ((cntx->cntvctl & GENERIC_TIMER_CTRL_ENABLE) &&
+	/* Expired HW mapped virtual timer fires by itself once restored */
+	if (!cntx->virt_hwirq &&
+	    (cntx->cntvctl & GENERIC_TIMER_CTRL_ENABLE) &&
 	    !(cntx->cntvctl & GENERIC_TIMER_CTRL_IT_MASK) &&
 	     ((cntx->cntvoff + cntx->cntvcval) <= pcnt)) {
 		cntx->cntvctl |= GENERIC_TIMER_CTRL_IT_MASK;
 		generic_virt_irq_inject(vcpu, cntx);
 	}
 
+	if (cntx->virt_hwstate) {
+		vmm_host_irq_set_routed_state(generic_virt_timer_hirq,
+				VMM_ROUTED_IRQ_STATE_ACTIVE,
+				VMM_ROUTED_IRQ_STATE_ACTIVE);
+	}
+
+	/* Nobody else touches guest timer registers in HW so only
+	 * control registers (masked upon save) need to be restored
+	 * if this VCPU was the last one to load them on this host CPU.
+	 */
+	cpu = vmm_smp_processor_id();
+	if ((this_cpu(generic_timer_owner) == cntx) && (cntx->hcpu == cpu)) {
+		generic_timer_reg_write(GENERIC_TIMER_REG_PHYS_CTRL,
+					cntx->cntpctl);
+		generic_timer_reg_write(GENERIC_TIMER_REG_VIRT_CTRL,
+					cntx->cntvctl);
+		return;
+	}
+	this_cpu(generic_timer_owner) = cntx;
+	cntx->hcpu = cpu;
+
 #ifdef HAVE_GENERIC_TIMER_REGS_RESTORE
 	generic_timer_regs_restore(cntx);
 #else
@@ -0,0 +1,39 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file arch_clocksource.h
+ * @author agent (agent@local)
+ * @brief Inline clocksource read for ARM generic counter
+ */
+#ifndef _ARCH_CLOCKSOURCE_H__
+#define _ARCH_CLOCKSOURCE_H__
+
+#include <vmm_types.h>
+#include <generic_timer.h>
+#include <cpu_generic_timer.h>
+
+/** Read physical counter of generic timer
+ * Note: Used for timestamps instead of calling read() of
+ * clocksource having arch_read set.
+ */
+static inline u64 arch_clocksource_fast_read(void)
+{
+	return generic_timer_pcounter_read();
+}
+
+#endif
@@ -30,4 +30,7 @@
 /* Emulate PSCI call from Guest VCPU */
 int emulate_psci_call(struct vmm_vcpu *vcpu, arch_regs_t *regs, bool is_smc);
 
+/* Update PV stolen time of Guest VCPU (called when VCPU is switched in) */
+void emulate_psci_pvtime_update(struct vmm_vcpu *vcpu);
+
 #endif /* __EMULATE_ARM_PSCI_H__ */
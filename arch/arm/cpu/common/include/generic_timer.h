@@ -45,6 +45,7 @@
 #include <vmm_types.h>
 #include <vmm_compiler.h>
 #include <vmm_timer.h>
+#include <vmm_snapshot.h>
 
 enum {
 	GENERIC_TIMER_REG_FREQ,
@@ -73,6 +74,12 @@ struct generic_timer_context {
 	u32 cntvctl;
 	struct vmm_timer_event virt_ev;
 	struct vmm_timer_event phys_ev;
+	/* Host CPU whose HW timer registers hold this context */
+	u32 hcpu;
+	/* Virtual timer irq mapped to host irq using VGIC HW bit */
+	bool virt_hwirq;
+	/* Saved routed state of host virtual timer irq */
+	u32 virt_hwstate;
 }__packed;
 
 int generic_timer_vcpu_context_init(void *vcpu_ptr,
@@ -87,6 +94,12 @@ void generic_timer_vcpu_context_restore(void *vcpu_ptr, void *context);
 
 void generic_timer_vcpu_context_post_restore(void *vcpu_ptr, void *context);
 
+int generic_timer_vcpu_context_state_save(void *vcpu_ptr, void *context,
+					  struct vmm_snapshot_state *st);
+
+int generic_timer_vcpu_context_state_restore(void *vcpu_ptr, void *context,
+					     struct vmm_snapshot_state *st);
+
 #endif /* __ASSEMBLY__ */
 
 #endif /* __GENERIC_TIMER_H__ */
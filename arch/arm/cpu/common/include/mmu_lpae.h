@@ -65,6 +65,8 @@ struct cpu_ttbl {
 	u32 tte_cnt;
 	u32 child_cnt;
 	struct dlist child_list;
+	/* VMID generation and VMID (only for stage2 root table) */
+	atomic64_t vmid;
 };
 
 /** Estimate good page size */
@@ -80,6 +82,12 @@ int mmu_lpae_get_page(struct cpu_ttbl *ttbl,
 /** Unmap a page from given translation table */
 int mmu_lpae_unmap_page(struct cpu_ttbl *ttbl, struct cpu_page *pg);
 
+/** Unmap all pages of given range from stage2 translation table
+ *  Note: TLB entries are invalidated once for the whole range
+ */
+int mmu_lpae_unmap_range(struct cpu_ttbl *ttbl,
+			 physical_addr_t ia, physical_size_t sz);
+
 /** Map a page under a given translation table */
 int mmu_lpae_map_page(struct cpu_ttbl *ttbl, struct cpu_page *pg);
 
@@ -107,10 +115,13 @@ struct cpu_ttbl *mmu_lpae_ttbl_get_child(struct cpu_ttbl *parent,
 struct cpu_ttbl *mmu_lpae_stage2_curttbl(void);
 
 /** Get current stage2 VMID */
-u8 mmu_lpae_stage2_curvmid(void);
+u32 mmu_lpae_stage2_curvmid(void);
 
-/** Change translation table for stage2 */
-int mmu_lpae_stage2_chttbl(u8 vmid, struct cpu_ttbl *ttbl);
+/** Change translation table for stage2
+ *  Note: VMID of translation table is (re)allocated when required
+ *  Note: Must be called with interrupts disabled
+ */
+int mmu_lpae_stage2_chttbl(struct cpu_ttbl *ttbl);
 
 /* TTBL Generic */
 #define TTBL_INITIAL_TABLE_COUNT			8
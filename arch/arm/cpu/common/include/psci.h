@@ -72,6 +72,26 @@
 #define PSCI_0_2_FN64_MIGRATE			PSCI_0_2_FN64(5)
 #define PSCI_0_2_FN64_MIGRATE_INFO_UP_CPU	PSCI_0_2_FN64(7)
 
+/* PSCI v1.0 interface */
+#define PSCI_1_0_FN_PSCI_FEATURES		PSCI_0_2_FN(10)
+
+/* SMC calling convention (ARM DEN 0028) discovery functions */
+#define ARM_SMCCC_VERSION_FUNC_ID		0x80000000
+#define ARM_SMCCC_ARCH_FEATURES_FUNC_ID		0x80000001
+#define ARM_SMCCC_VERSION_1_1			0x10001
+
+/* Paravirtualized time (ARM DEN 0057A) functions */
+#define ARM_SMCCC_HV_PV_TIME_FEATURES		0xC5000020
+#define ARM_SMCCC_HV_PV_TIME_ST			0xC5000021
+
+/* Xvisor vendor specific hypervisor service (SMC32 fast call) to ring
+ * doorbell of emulated device (such as VirtIO queue notify) where
+ * a1 = Bits[31:0] of device base address
+ * a2 = Bits[63:32] of device base address
+ * a3 = doorbell value (such as VirtIO queue index)
+ */
+#define ARM_SMCCC_HV_DOORBELL_FUNC_ID		0x86000001
+
 /* PSCI v0.2 power state encoding for CPU_SUSPEND function */
 #define PSCI_0_2_POWER_STATE_ID_MASK		0xffff
 #define PSCI_0_2_POWER_STATE_ID_SHIFT		0
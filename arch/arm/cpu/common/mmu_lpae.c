@@ -27,9 +27,14 @@
 #include <vmm_smp.h>
 #include <vmm_stdio.h>
 #include <vmm_host_aspace.h>
+#include <vmm_cache.h>
+#include <vmm_cpumask.h>
 #include <arch_sections.h>
 #include <arch_barrier.h>
+#include <arch_atomic64.h>
+#include <arch_cpu_irq.h>
 #include <libs/stringlib.h>
+#include <libs/bitmap.h>
 #include <cpu_mmu_lpae.h>
 #include <mmu_lpae.h>
 
@@ -42,6 +47,20 @@
 #define TTBL_MAX_TABLE_SIZE	(TTBL_MAX_TABLE_COUNT * TTBL_TABLE_SIZE)
 #define TTBL_INITIAL_TABLE_SIZE (TTBL_INITIAL_TABLE_COUNT * TTBL_TABLE_SIZE)
 
+/* Stage2 faults of SMP guests allocate translation tables from many
+ * host CPUs at the same time hence each host CPU keeps a small cache
+ * of free tables which is refilled from (and spilled to) global free
+ * list in batches.
+ */
+#define TTBL_CACHE_BATCH	8
+#define TTBL_CACHE_MAX		(2 * TTBL_CACHE_BATCH)
+
+struct mmu_lpae_ttbl_cache {
+	vmm_spinlock_t lock;
+	u32 count;
+	struct dlist free_list;
+};
+
 struct mmu_lpae_ctrl {
 	struct cpu_ttbl *hyp_ttbl;
 	virtual_addr_t ttbl_base_va;
@@ -53,9 +72,20 @@ struct mmu_lpae_ctrl {
 	vmm_spinlock_t alloc_lock;
 	u32 ttbl_alloc_count;
 	struct dlist free_ttbl_list;
+	/* Per host CPU cache of free translation tables */
+	bool ttbl_cache_ready;
+	struct mmu_lpae_ttbl_cache ttbl_cache[CONFIG_CPU_COUNT];
 	/* Initialized by memory read/write init */
 	struct cpu_ttbl *mem_rw_ttbl[CONFIG_CPU_COUNT];
 	u64 *mem_rw_tte[CONFIG_CPU_COUNT];
+	/* VMID allocator */
+	vmm_spinlock_t vmid_lock;
+	u32 vmid_bits;
+	u32 vmid_next;
+	atomic64_t vmid_gen;
+	atomic64_t active_vmid[CONFIG_CPU_COUNT];
+	u64 reserved_vmid[CONFIG_CPU_COUNT];
+	DECLARE_BITMAP(vmid_map, 1 << 16);
 };
 
 static struct mmu_lpae_ctrl mmuctrl;
@@ -226,25 +256,79 @@ static int mmu_lpae_ttbl_deattach(struct cpu_ttbl *child)
 	return VMM_OK;
 }
 
+/* Pop a free translation table from global free list into cache.
+ * Called with cache lock held.
+ */
+static void mmu_lpae_ttbl_cache_refill(struct mmu_lpae_ttbl_cache *tc)
+{
+	u32 i;
+
+	vmm_spin_lock_lite(&mmuctrl.alloc_lock);
+	for (i = 0; (i < TTBL_CACHE_BATCH) &&
+		    !list_empty(&mmuctrl.free_ttbl_list); i++) {
+		list_add_tail(list_pop(&mmuctrl.free_ttbl_list),
+			      &tc->free_list);
+		tc->count++;
+		mmuctrl.ttbl_alloc_count++;
+	}
+	vmm_spin_unlock_lite(&mmuctrl.alloc_lock);
+}
+
+static struct cpu_ttbl *mmu_lpae_ttbl_cache_pop(u32 cpu, bool refill)
+{
+	struct dlist *l = NULL;
+	struct mmu_lpae_ttbl_cache *tc = &mmuctrl.ttbl_cache[cpu];
+
+	vmm_spin_lock_lite(&tc->lock);
+	if (!tc->count && refill) {
+		mmu_lpae_ttbl_cache_refill(tc);
+	}
+	if (tc->count) {
+		l = list_pop(&tc->free_list);
+		tc->count--;
+	}
+	vmm_spin_unlock_lite(&tc->lock);
+
+	return (l) ? list_entry(l, struct cpu_ttbl, head) : NULL;
+}
+
 struct cpu_ttbl *mmu_lpae_ttbl_alloc(int stage)
 {
+	u32 cpu, this_cpu;
 	irq_flags_t flags;
 	struct dlist *l;
-	struct cpu_ttbl *ttbl;
+	struct cpu_ttbl *ttbl = NULL;
+
+	if (mmuctrl.ttbl_cache_ready) {
+		arch_cpu_irq_save(flags);
+		this_cpu = vmm_smp_processor_id();
+		ttbl = mmu_lpae_ttbl_cache_pop(this_cpu, TRUE);
+		/* Global free list is empty so steal from other caches */
+		for (cpu = 0; !ttbl && (cpu < CONFIG_CPU_COUNT); cpu++) {
+			if (cpu != this_cpu) {
+				ttbl = mmu_lpae_ttbl_cache_pop(cpu, FALSE);
+			}
+		}
+		arch_cpu_irq_restore(flags);
+		if (!ttbl) {
+			return NULL;
+		}
+	} else {
+		vmm_spin_lock_irqsave_lite(&mmuctrl.alloc_lock, flags);
 
-	vmm_spin_lock_irqsave_lite(&mmuctrl.alloc_lock, flags);
+		if (list_empty(&mmuctrl.free_ttbl_list)) {
+			vmm_spin_unlock_irqrestore_lite(&mmuctrl.alloc_lock,
+							flags);
+			return NULL;
+		}
+
+		l = list_pop(&mmuctrl.free_ttbl_list);
+		ttbl = list_entry(l, struct cpu_ttbl, head);
+		mmuctrl.ttbl_alloc_count++;
 
-	if (list_empty(&mmuctrl.free_ttbl_list)) {
 		vmm_spin_unlock_irqrestore_lite(&mmuctrl.alloc_lock, flags);
-		return NULL;
 	}
 
-	l = list_pop(&mmuctrl.free_ttbl_list);
-	ttbl = list_entry(l, struct cpu_ttbl, head);
-	mmuctrl.ttbl_alloc_count++;
-
-	vmm_spin_unlock_irqrestore_lite(&mmuctrl.alloc_lock, flags);
-
 	ttbl->parent = NULL;
 	ttbl->stage = stage;
 	ttbl->level = TTBL_FIRST_LEVEL;
@@ -253,6 +337,7 @@ struct cpu_ttbl *mmu_lpae_ttbl_alloc(int stage)
 	ttbl->tte_cnt = 0;
 	ttbl->child_cnt = 0;
 	INIT_LIST_HEAD(&ttbl->child_list);
+	arch_atomic64_write(&ttbl->vmid, 0);
 
 	return ttbl;
 }
@@ -263,6 +348,7 @@ int mmu_lpae_ttbl_free(struct cpu_ttbl *ttbl)
 	irq_flags_t flags;
 	struct dlist *l;
 	struct cpu_ttbl *child;
+	struct mmu_lpae_ttbl_cache *tc;
 
 	if (!ttbl) {
 		return VMM_EFAIL;
@@ -293,10 +379,31 @@ int mmu_lpae_ttbl_free(struct cpu_ttbl *ttbl)
 	ttbl->level = TTBL_FIRST_LEVEL;
 	ttbl->map_ia = 0;
 
-	vmm_spin_lock_irqsave_lite(&mmuctrl.alloc_lock, flags);
-	list_add_tail(&ttbl->head, &mmuctrl.free_ttbl_list);
-	mmuctrl.ttbl_alloc_count--;
-	vmm_spin_unlock_irqrestore_lite(&mmuctrl.alloc_lock, flags);
+	if (mmuctrl.ttbl_cache_ready) {
+		arch_cpu_irq_save(flags);
+		tc = &mmuctrl.ttbl_cache[vmm_smp_processor_id()];
+		vmm_spin_lock_lite(&tc->lock);
+		list_add(&ttbl->head, &tc->free_list);
+		tc->count++;
+		/* Spill half of cache back to global free list */
+		if (TTBL_CACHE_MAX < tc->count) {
+			vmm_spin_lock_lite(&mmuctrl.alloc_lock);
+			while (TTBL_CACHE_BATCH < tc->count) {
+				list_add_tail(list_pop_tail(&tc->free_list),
+					      &mmuctrl.free_ttbl_list);
+				tc->count--;
+				mmuctrl.ttbl_alloc_count--;
+			}
+			vmm_spin_unlock_lite(&mmuctrl.alloc_lock);
+		}
+		vmm_spin_unlock_lite(&tc->lock);
+		arch_cpu_irq_restore(flags);
+	} else {
+		vmm_spin_lock_irqsave_lite(&mmuctrl.alloc_lock, flags);
+		list_add_tail(&ttbl->head, &mmuctrl.free_ttbl_list);
+		mmuctrl.ttbl_alloc_count--;
+		vmm_spin_unlock_irqrestore_lite(&mmuctrl.alloc_lock, flags);
+	}
 
 	return VMM_OK;
 }
@@ -343,7 +450,11 @@ struct cpu_ttbl *mmu_lpae_ttbl_get_child(struct cpu_ttbl *parent,
 	}
 
 	if ((rc = mmu_lpae_ttbl_attach(parent, map_ia, child))) {
+		/* Lost the race with another host CPU installing the
+		 * same entry so use whatever it installed.
+		 */
 		mmu_lpae_ttbl_free(child);
+		return mmu_lpae_ttbl_get_child(parent, map_ia, FALSE);
 	}
 
 	return child;
@@ -450,7 +561,177 @@ int mmu_lpae_get_page(struct cpu_ttbl *ttbl,
 	return VMM_OK;
 }
 
-int mmu_lpae_unmap_page(struct cpu_ttbl *ttbl, struct cpu_page *pg)
+/* VMIDs are allocated per stage2 translation table with a generation
+ * in upper bits (same as ARM64 ASID allocator of Linux). A host CPU
+ * keeps using its active VMID as long as the generation matches so
+ * guest switches never flush TLB. When VMIDs run out, the generation
+ * is bumped, VMIDs active on host CPUs are carried over as reserved
+ * and all guest TLB entries are invalidated once for all host CPUs.
+ */
+#define VMID_FIRST_GEN		(1ULL << mmuctrl.vmid_bits)
+#define VMID_IDX_MASK		(VMID_FIRST_GEN - 1)
+#define VMID_COUNT		((u32)VMID_FIRST_GEN)
+
+static inline bool mmu_lpae_vmid_gen_match(u64 vmid)
+{
+	return ((vmid ^ arch_atomic64_read(&mmuctrl.vmid_gen)) >>
+					mmuctrl.vmid_bits) ? FALSE : TRUE;
+}
+
+/* Called with vmid_lock held */
+static void mmu_lpae_vmid_rollover(void)
+{
+	u32 cpu;
+	u64 vmid;
+
+	bitmap_zero(mmuctrl.vmid_map, VMID_COUNT);
+	for_each_possible_cpu(cpu) {
+		do {
+			vmid = arch_atomic64_read(&mmuctrl.active_vmid[cpu]);
+		} while (arch_atomic64_cmpxchg(&mmuctrl.active_vmid[cpu],
+					       vmid, 0) != vmid);
+		/* Host CPU which already rolled-over keeps reserved VMID */
+		if (!vmid) {
+			vmid = mmuctrl.reserved_vmid[cpu];
+		}
+		bitmap_setbit(mmuctrl.vmid_map, vmid & VMID_IDX_MASK);
+		mmuctrl.reserved_vmid[cpu] = vmid;
+	}
+
+	cpu_invalid_all_guest_tlbs();
+}
+
+/* Called with vmid_lock held */
+static bool mmu_lpae_vmid_check_reserved(u64 vmid, u64 newvmid)
+{
+	u32 cpu;
+	bool hit = FALSE;
+
+	for_each_possible_cpu(cpu) {
+		if (mmuctrl.reserved_vmid[cpu] == vmid) {
+			hit = TRUE;
+			mmuctrl.reserved_vmid[cpu] = newvmid;
+		}
+	}
+
+	return hit;
+}
+
+/* Called with vmid_lock held */
+static u64 mmu_lpae_vmid_new(struct cpu_ttbl *ttbl)
+{
+	u32 idx;
+	u64 gen, vmid = arch_atomic64_read(&ttbl->vmid);
+
+	gen = arch_atomic64_read(&mmuctrl.vmid_gen);
+
+	/* Try to keep VMID of previous generation */
+	if (vmid) {
+		idx = vmid & VMID_IDX_MASK;
+		if (mmu_lpae_vmid_check_reserved(vmid, gen | idx)) {
+			return gen | idx;
+		}
+		if (!bitmap_isset(mmuctrl.vmid_map, idx)) {
+			bitmap_setbit(mmuctrl.vmid_map, idx);
+			return gen | idx;
+		}
+	}
+
+	/* VMID zero is never allocated */
+	idx = find_next_zero_bit(mmuctrl.vmid_map, VMID_COUNT,
+				 mmuctrl.vmid_next);
+	if (idx == VMID_COUNT) {
+		gen = arch_atomic64_add_return(&mmuctrl.vmid_gen,
+					       VMID_FIRST_GEN);
+		mmu_lpae_vmid_rollover();
+		/* More VMIDs than host CPUs so this always succeeds */
+		idx = find_next_zero_bit(mmuctrl.vmid_map, VMID_COUNT, 1);
+	}
+
+	bitmap_setbit(mmuctrl.vmid_map, idx);
+	mmuctrl.vmid_next = idx;
+
+	return gen | idx;
+}
+
+/* Get VMID of stage2 translation table for current host CPU.
+ * Called with interrupts disabled.
+ */
+static u32 mmu_lpae_vmid_update(struct cpu_ttbl *ttbl)
+{
+	u64 vmid, old;
+	atomic64_t *active = &mmuctrl.active_vmid[vmm_smp_processor_id()];
+
+	/* Fast path: generation matches and no rollover in-progress */
+	vmid = arch_atomic64_read(&ttbl->vmid);
+	old = arch_atomic64_read(active);
+	if (old && mmu_lpae_vmid_gen_match(vmid) &&
+	    (arch_atomic64_cmpxchg(active, old, vmid) == old)) {
+		return vmid & VMID_IDX_MASK;
+	}
+
+	vmm_spin_lock_lite(&mmuctrl.vmid_lock);
+
+	vmid = arch_atomic64_read(&ttbl->vmid);
+	if (!mmu_lpae_vmid_gen_match(vmid)) {
+		vmid = mmu_lpae_vmid_new(ttbl);
+		arch_atomic64_write(&ttbl->vmid, vmid);
+	}
+	arch_atomic64_write(active, vmid);
+
+	vmm_spin_unlock_lite(&mmuctrl.vmid_lock);
+
+	return vmid & VMID_IDX_MASK;
+}
+
+/* Invalidate guest TLB entries of IPA range [ia, ia + sz) tagged
+ * with VMID of given stage2 translation table. The VMID is loaded
+ * in VTTBR temporarily because guest TLB maintenance applies to
+ * current VMID.
+ */
+static void mmu_lpae_stage2_inv_range(struct cpu_ttbl *ttbl,
+				      physical_addr_t ia,
+				      physical_size_t sz)
+{
+	u32 vmid, old_vmid;
+	irq_flags_t flags;
+	physical_addr_t ttbl_pa;
+
+	while (ttbl->parent) {
+		ttbl = ttbl->parent;
+	}
+
+	/* No VMID means table was never used by any host CPU */
+	vmid = arch_atomic64_read(&ttbl->vmid) & VMID_IDX_MASK;
+	if (!vmid) {
+		return;
+	}
+
+	arch_cpu_irq_save(flags);
+
+	ttbl_pa = cpu_stage2_ttbl_pa();
+	old_vmid = cpu_stage2_vmid();
+	if (old_vmid != vmid) {
+		cpu_stage2_update(ttbl_pa, vmid);
+		isb();
+	}
+
+	if (sz <= TTBL_L3_BLOCK_SIZE) {
+		cpu_invalid_ipa_guest_tlb(ia);
+	} else {
+		cpu_invalid_ipa_range_guest_tlb(ia, sz);
+	}
+
+	if (old_vmid != vmid) {
+		cpu_stage2_update(ttbl_pa, old_vmid);
+		isb();
+	}
+
+	arch_cpu_irq_restore(flags);
+}
+
+static int __mmu_lpae_unmap_page(struct cpu_ttbl *ttbl,
+				 struct cpu_page *pg, bool inv)
 {
 	int index, rc;
 	bool free_ttbl;
@@ -477,7 +758,7 @@ int mmu_lpae_unmap_page(struct cpu_ttbl *ttbl, struct cpu_page *pg)
 		if (!child) {
 			return VMM_EFAIL;
 		}
-		rc = mmu_lpae_unmap_page(child, pg);
+		rc = __mmu_lpae_unmap_page(child, pg, inv);
 		if ((ttbl->tte_cnt == 0) &&
 		    (ttbl->level > TTBL_FIRST_LEVEL)) {
 			mmu_lpae_ttbl_free(ttbl);
@@ -504,7 +785,9 @@ int mmu_lpae_unmap_page(struct cpu_ttbl *ttbl, struct cpu_page *pg)
 	cpu_mmu_sync_tte(&tte[index]);
 
 	if (ttbl->stage == TTBL_STAGE2) {
-		cpu_invalid_ipa_guest_tlb((pg->ia));
+		if (inv) {
+			mmu_lpae_stage2_inv_range(ttbl, pg->ia, pg->sz);
+		}
 	} else {
 		cpu_invalid_va_hypervisor_tlb(((virtual_addr_t)pg->ia));
 	}
@@ -524,6 +807,49 @@ int mmu_lpae_unmap_page(struct cpu_ttbl *ttbl, struct cpu_page *pg)
 	return VMM_OK;
 }
 
+int mmu_lpae_unmap_page(struct cpu_ttbl *ttbl, struct cpu_page *pg)
+{
+	return __mmu_lpae_unmap_page(ttbl, pg, TRUE);
+}
+
+int mmu_lpae_unmap_range(struct cpu_ttbl *ttbl,
+			 physical_addr_t ia, physical_size_t sz)
+{
+	struct cpu_page pg;
+	physical_addr_t pos, end, inv_start, inv_end;
+
+	if (!ttbl || (ttbl->stage != TTBL_STAGE2)) {
+		return VMM_EINVALID;
+	}
+
+	pos = ia;
+	end = ia + sz;
+	inv_start = end;
+	inv_end = ia;
+	while (pos < end) {
+		if (mmu_lpae_get_page(ttbl, pos, &pg)) {
+			pos += TTBL_L3_BLOCK_SIZE;
+			continue;
+		}
+		if (!__mmu_lpae_unmap_page(ttbl, &pg, FALSE)) {
+			if (pg.ia < inv_start) {
+				inv_start = pg.ia;
+			}
+			if (inv_end < (pg.ia + pg.sz)) {
+				inv_end = pg.ia + pg.sz;
+			}
+		}
+		pos = pg.ia + pg.sz;
+	}
+
+	if (inv_start < inv_end) {
+		mmu_lpae_stage2_inv_range(ttbl, inv_start,
+					  inv_end - inv_start);
+	}
+
+	return VMM_OK;
+}
+
 int mmu_lpae_map_page(struct cpu_ttbl *ttbl, struct cpu_page *pg)
 {
 	int index;
@@ -611,9 +937,12 @@ int mmu_lpae_map_page(struct cpu_ttbl *ttbl, struct cpu_page *pg)
 
 	cpu_mmu_sync_tte(&tte[index]);
 
-	if (ttbl->stage == TTBL_STAGE2) {
-		cpu_invalid_ipa_guest_tlb((pg->ia));
-	} else {
+	/* Entries causing translation fault are never cached in guest
+	 * TLB so stage2 TLB maintenance is not needed when replacing
+	 * an invalid entry. This keeps TLB maintenance (and VTTBR
+	 * switching) out of table lock on stage2 fault path.
+	 */
+	if (ttbl->stage != TTBL_STAGE2) {
 		cpu_invalid_va_hypervisor_tlb(((virtual_addr_t)pg->ia));
 	}
 
@@ -644,14 +973,20 @@ struct cpu_ttbl *mmu_lpae_stage2_curttbl(void)
 	return mmu_lpae_ttbl_find(cpu_stage2_ttbl_pa());
 }
 
-u8 mmu_lpae_stage2_curvmid(void)
+u32 mmu_lpae_stage2_curvmid(void)
 {
 	return cpu_stage2_vmid();
 }
 
-int mmu_lpae_stage2_chttbl(u8 vmid, struct cpu_ttbl *ttbl)
+int mmu_lpae_stage2_chttbl(struct cpu_ttbl *ttbl)
 {
-	cpu_stage2_update(ttbl->tbl_pa, vmid);
+	u32 vmid = mmu_lpae_vmid_update(ttbl);
+
+	if ((cpu_stage2_ttbl_pa() != ttbl->tbl_pa) ||
+	    (cpu_stage2_vmid() != vmid)) {
+		cpu_stage2_update(ttbl->tbl_pa, vmid);
+	}
+
 	return VMM_OK;
 }
 
@@ -732,10 +1067,15 @@ int arch_cpu_aspace_memory_write(virtual_addr_t tmp_va,
 	u64 *tte = mmuctrl.mem_rw_tte[vmm_smp_processor_id()];
 	struct cpu_ttbl *ttbl = mmuctrl.mem_rw_ttbl[vmm_smp_processor_id()];
 	virtual_addr_t offset = (dst & VMM_PAGE_MASK);
+	/* Bulk non-cacheable writes are done through cacheable mapping
+	 * followed by one data cache flush of whole range because
+	 * memcpy() to strongly-ordered memory is very slow.
+	 */
+	bool bulk = (!cacheable && (VMM_CACHE_LINE_SIZE <= len));
 
 	old_tte_val = *tte;
 
-	if (cacheable) {
+	if (cacheable || bulk) {
 		*tte = PHYS_RW_TTE_CACHE;
 	} else {
 		*tte = PHYS_RW_TTE_NOCACHE;
@@ -764,6 +1104,44 @@ int arch_cpu_aspace_memory_write(virtual_addr_t tmp_va,
 		break;
 	};
 
+	if (bulk) {
+		vmm_flush_dcache_range(tmp_va + offset, tmp_va + offset + len);
+	}
+
+	*tte = old_tte_val;
+	cpu_mmu_sync_tte(tte);
+
+	return VMM_OK;
+}
+
+int arch_cpu_aspace_memory_zero(virtual_addr_t tmp_va,
+				physical_addr_t dst,
+				u32 len, bool cacheable)
+{
+	u64 old_tte_val;
+	u64 *tte = mmuctrl.mem_rw_tte[vmm_smp_processor_id()];
+	struct cpu_ttbl *ttbl = mmuctrl.mem_rw_ttbl[vmm_smp_processor_id()];
+	virtual_addr_t va = tmp_va + (dst & VMM_PAGE_MASK);
+
+	old_tte_val = *tte;
+
+	/* Always zero through a cacheable mapping so that memset()
+	 * can zero whole cache lines (DC ZVA on ARMv8) which is not
+	 * allowed on strongly-ordered memory. For non-cacheable users
+	 * the zeroed lines are cleaned to point of coherency.
+	 */
+	*tte = PHYS_RW_TTE_CACHE;
+	*tte |= dst &
+		(mmu_lpae_level_map_mask(ttbl->level) & TTBL_OUTADDR_MASK);
+
+	cpu_mmu_sync_tte(tte);
+	cpu_invalid_va_hypervisor_tlb(tmp_va);
+
+	memset((void *)va, 0, len);
+	if (!cacheable) {
+		vmm_flush_dcache_range(va, va + len);
+	}
+
 	*tte = old_tte_val;
 	cpu_mmu_sync_tte(tte);
 
@@ -979,6 +1357,19 @@ int __init arch_cpu_aspace_primary_init(physical_addr_t *core_resv_pa,
 	INIT_SPIN_LOCK(&mmuctrl.alloc_lock);
 	mmuctrl.ttbl_alloc_count = 0x0;
 	INIT_LIST_HEAD(&mmuctrl.free_ttbl_list);
+	mmuctrl.ttbl_cache_ready = FALSE;
+
+	/* Initialize VMID allocator (VMID zero is never allocated) */
+	INIT_SPIN_LOCK(&mmuctrl.vmid_lock);
+	mmuctrl.vmid_bits = cpu_stage2_vmid_init();
+	mmuctrl.vmid_next = 1;
+	arch_atomic64_write(&mmuctrl.vmid_gen, VMID_FIRST_GEN);
+	for (i = 0; i < CONFIG_CPU_COUNT; i++) {
+		arch_atomic64_write(&mmuctrl.active_vmid[i], 0);
+		mmuctrl.reserved_vmid[i] = 0;
+	}
+	bitmap_zero(mmuctrl.vmid_map, VMID_COUNT);
+	bitmap_setbit(mmuctrl.vmid_map, 0);
 	for (i = 1; i < TTBL_INITIAL_TABLE_COUNT; i++) {
 		if (def_ttbl_tree[i] != -1) {
 			continue;
@@ -1129,6 +1520,14 @@ int __init arch_cpu_aspace_primary_init(physical_addr_t *core_resv_pa,
 		memset((void *)ttbl->tbl_va, 0, TTBL_TABLE_SIZE);
 	}
 
+	/* Per host CPU caches only hold tables cleared above */
+	for (i = 0; i < CONFIG_CPU_COUNT; i++) {
+		INIT_SPIN_LOCK(&mmuctrl.ttbl_cache[i].lock);
+		mmuctrl.ttbl_cache[i].count = 0;
+		INIT_LIST_HEAD(&mmuctrl.ttbl_cache[i].free_list);
+	}
+	mmuctrl.ttbl_cache_ready = TRUE;
+
 	return VMM_OK;
 
 mmu_init_error:
@@ -1137,7 +1536,13 @@ mmu_init_error:
 
 int __cpuinit arch_cpu_aspace_secondary_init(void)
 {
-	/* Nothing to do here. */
+	/* All host CPUs are expected to have same VMID width
+	 * because VMIDs are allocated before guests are created.
+	 */
+	if (cpu_stage2_vmid_init() < mmuctrl.vmid_bits) {
+		return VMM_ENOTSUPP;
+	}
+
 	return VMM_OK;
 }
 
@@ -35,6 +35,7 @@
 #include <vmm_devemu.h>
 #include <vmm_modules.h>
 #include <arch_regs.h>
+#include <libs/bitops.h>
 #include <libs/bitmap.h>
 
 #include <vgic.h>
@@ -115,6 +116,8 @@ struct vgic_guest_state {
 	u32 priority1[32][VGIC_MAX_NCPU];
 	u32 priority2[VGIC_MAX_NIRQ - 32];
 	u32 irq_pending[VGIC_MAX_NCPU][VGIC_MAX_NIRQ / 32];
+	/* Bit N set if irq_pending[cpu][N] is non-zero */
+	u32 irq_pending_words[VGIC_MAX_NCPU];
 };
 
 /* Set interrupt pending
@@ -124,10 +127,12 @@ static void __vgic_set_pending(struct vgic_guest_state *s, u32 irq, u32 cm)
 {
 	u32 i;
 	s->irq_state[irq].pending |= cm;
-	for (i = 0; i < s->num_cpu; i++) {
-		if (!(cm & (1 << i)))
-			continue;
+	cm &= (1 << s->num_cpu) - 1;
+	while (cm) {
+		i = __ffs(cm);
+		cm &= cm - 1;
 		s->irq_pending[i][irq >> 5] |= (1 << (irq & 0x1f));
+		s->irq_pending_words[i] |= (1 << (irq >> 5));
 	}
 }
 
@@ -138,10 +143,14 @@ static void __vgic_clear_pending(struct vgic_guest_state *s, u32 irq, u32 cm)
 {
 	u32 i;
 	s->irq_state[irq].pending &= ~cm;
-	for (i = 0; i < s->num_cpu; i++) {
-		if (!(cm & (1 << i)))
-			continue;
+	cm &= (1 << s->num_cpu) - 1;
+	while (cm) {
+		i = __ffs(cm);
+		cm &= cm - 1;
 		s->irq_pending[i][irq >> 5] &= ~(1 << (irq & 0x1f));
+		if (!s->irq_pending[i][irq >> 5]) {
+			s->irq_pending_words[i] &= ~(1 << (irq >> 5));
+		}
 	}
 }
 
@@ -203,6 +212,22 @@ static void __vgic_clear_pending(struct vgic_guest_state *s, u32 irq, u32 cm)
 		(vs)->lr_used_count--;	\
 	} while (0)
 
+/* Find first free LR (returns lr_cnt when all LRs are used) */
+static inline u32 __vgic_find_free_lr(struct vgic_vcpu_state *vs)
+{
+	u32 i, lr;
+
+	for (i = 0; i < (VGIC_MAX_LRS / 32); i++) {
+		if (vs->lr_used[i] != 0xFFFFFFFF) {
+			lr = i * 32 + ffz(vs->lr_used[i]);
+			return (lr < vgich.params.lr_cnt) ?
+				lr : vgich.params.lr_cnt;
+		}
+	}
+
+	return vgich.params.lr_cnt;
+}
+
 #define VGIC_SET_LR_MAP(vs, irq, src_id, lr) ((vs)->irq_lr[irq][src_id] = (lr))
 #define VGIC_GET_LR_MAP(vs, irq, src_id) ((vs)->irq_lr[irq][src_id])
 
@@ -236,11 +261,7 @@ static bool __vgic_queue_irq(struct vgic_guest_state *s,
 	}
 
 	/* Try to use another LR for this interrupt */
-	for (lr = 0; lr < vgich.params.lr_cnt; lr++) {
-		if (!VGIC_TEST_LR_USED(vs, lr)) {
-			break;
-		}
-	}
+	lr = __vgic_find_free_lr(vs);
 	if (lr >= vgich.params.lr_cnt) {
 		vmm_printf("%s: LR overflow IRQ=%d SRC_ID=%d VCPU=%s\n",
 			   __func__, irq, src_id, vs->vcpu->name);
@@ -254,7 +275,8 @@ static bool __vgic_queue_irq(struct vgic_guest_state *s,
 
 	lrv.virtid = irq;
 	lrv.physid = 0;
-	lrv.prio = 0;
+	/* LR holds upper 5 bits of 8-bit priority */
+	lrv.prio = VGIC_GET_PRIORITY(s, irq, vs->vcpu->subid) >> 3;
 	lrv.cpuid = 0;
 	lrv.flags = VGIC_LR_STATE_PENDING;
 	hirq = VGIC_GET_HOST_IRQ(s, irq);
@@ -279,11 +301,11 @@ static bool __vgic_queue_sgi(struct vgic_guest_state *s,
 			     u32 irq)
 {
 	u32 c, source = s->sgi_source[vs->vcpu->subid][irq];
+	u32 bits = source & VGIC_ALL_CPU_MASK(s);
 
-	for (c = 0; c < VGIC_NUM_CPU(s); c++) {
-		if (!(source & (1 << c))) {
-			continue;
-		}
+	while (bits) {
+		c = __ffs(bits);
+		bits &= bits - 1;
 		if (__vgic_queue_irq(s, vs, c, irq)) {
 			source &= ~(1 << c);
 		}
@@ -327,6 +349,10 @@ static bool __vgic_queue_hwirq(struct vgic_guest_state *s,
 }
 
 /* Flush VGIC state to VGIC HW for given VCPU
+ * Pending interrupts are found by scanning set bits only and they are
+ * queued in priority order (lowest value first, then lowest number).
+ * Only as many candidates as free LRs are considered because rest of
+ * them will be flushed upon LR underflow.
  * Note: Must be called only when given VCPU is current VCPU
  * Note: Must be called with VGIC distributor lock held
  */
@@ -334,7 +360,9 @@ static void __vgic_flush_vcpu_hwstate(struct vgic_guest_state *s,
 				      struct vgic_vcpu_state *vs)
 {
 	bool overflow = FALSE;
-	u32 i, irq, irq_pending;
+	u16 key, cand[VGIC_MAX_LRS];
+	u32 w, words, bits, irq, i, j, n = 0, nmax;
+	u32 cpu = vs->vcpu->subid;
 
 	if (!s->enabled) {
 		return;
@@ -342,27 +370,52 @@ static void __vgic_flush_vcpu_hwstate(struct vgic_guest_state *s,
 
 	DPRINTF("%s: vcpu=%s\n", __func__, vs->vcpu->name);
 
-	for (i = 0; i < VGIC_MAX_NIRQ / 32; i++) {
-		irq_pending = s->irq_pending[vs->vcpu->subid][i];
-		if (!irq_pending) {
-			continue;
-		}
+	nmax = vgich.params.lr_cnt - vs->lr_used_count;
+	if (!nmax) {
+		/* All LRs in use so, nothing more can be queued */
+		overflow = (s->irq_pending_words[cpu]) ? TRUE : FALSE;
+		goto done;
+	}
 
-		for (irq = 0; irq < 32; irq++) {
-			if (!(irq_pending & (0x1 << irq))) {
-				continue;
+	/* Collect candidates sorted by (priority, irq) key */
+	words = s->irq_pending_words[cpu];
+	while (words) {
+		w = __ffs(words);
+		words &= ~(1 << w);
+		bits = s->irq_pending[cpu][w];
+		while (bits) {
+			irq = w * 32 + __ffs(bits);
+			bits &= bits - 1;
+
+			/* IRQ number fits 8 bits as VGIC_MAX_NIRQ is 256 */
+			key = VGIC_GET_PRIORITY(s, irq, cpu) & 0xFF;
+			key = (key << 8) | irq;
+			if (n == nmax) {
+				overflow = TRUE;
+				if (cand[n - 1] <= key) {
+					continue;
+				}
+				n--;
 			}
+			for (j = n; j && (key < cand[j - 1]); j--) {
+				cand[j] = cand[j - 1];
+			}
+			cand[j] = key;
+			n++;
+		}
+	}
 
-			if (i == 0 && irq < 16) {
-				if (!__vgic_queue_sgi(s, vs, i*32 + irq)) {
-					overflow = TRUE;
-					goto done;
-				}
-			} else {
-				if (!__vgic_queue_hwirq(s, vs, i*32 + irq)) {
-					overflow = TRUE;
-					goto done;
-				}
+	for (i = 0; i < n; i++) {
+		irq = cand[i] & 0xFF;
+		if (irq < 16) {
+			if (!__vgic_queue_sgi(s, vs, irq)) {
+				overflow = TRUE;
+				break;
+			}
+		} else {
+			if (!__vgic_queue_hwirq(s, vs, irq)) {
+				overflow = TRUE;
+				break;
 			}
 		}
 	}
@@ -404,9 +457,13 @@ static void __vgic_sync_vcpu_hwstate(struct vgic_guest_state *s,
 	/* Re-claim empty LR registers */
 	elrsr[0] &= vs->lr_used[0];
 	elrsr[1] &= vs->lr_used[1];
-	for (lr = 0; lr < vgich.params.lr_cnt; lr++) {
-		if (!VGIC_TEST_ELRSR(elrsr, lr)) {
-			continue;
+	while (elrsr[0] || elrsr[1]) {
+		if (elrsr[0]) {
+			lr = __ffs(elrsr[0]);
+			elrsr[0] &= elrsr[0] - 1;
+		} else {
+			lr = 32 + __ffs(elrsr[1]);
+			elrsr[1] &= elrsr[1] - 1;
 		}
 
 		/* Read and clear the LR register */
@@ -488,15 +545,11 @@ static void vgic_irq_handle(u32 irq, int cpu, int level, void *opaque)
 		/* In case of SGIs */
 		cm = VGIC_ALL_CPU_MASK(s);
 		target = VGIC_TARGET(s, irq);
-		for (cpu = 0; cpu < VGIC_NUM_CPU(s); cpu++) {
-			if (target & (1 << cpu)) {
-				break;
-			}
-		}
-		if (VGIC_NUM_CPU(s) <= cpu) {
+		if (!(target & VGIC_ALL_CPU_MASK(s))) {
 			vmm_spin_unlock_irqrestore_lite(&s->dist_lock, flags);
 			return;
 		}
+		cpu = __ffs(target & VGIC_ALL_CPU_MASK(s));
 	}
 
 	/* Find out VCPU pointer */
@@ -811,7 +864,7 @@ static int __vgic_dist_readb(struct vgic_guest_state *s, int cpu,
 static int __vgic_dist_writeb(struct vgic_guest_state *s, int cpu,
 			      u32 offset, u8 src)
 {
-	u32 done = 0, i, irq, mask, cm;
+	u32 done = 0, i, irq, mask, cm, bits;
 
 	if (!s) {
 		return VMM_EFAIL;
@@ -844,10 +897,10 @@ static int __vgic_dist_writeb(struct vgic_guest_state *s, int cpu,
 			if (irq < 16) {
 				src = 0xFF;
 			}
-			for (i = 0; i < 8; i++) {
-				if (!(src & (1 << i))) {
-					continue;
-				}
+			bits = src;
+			while (bits) {
+				i = __ffs(bits);
+				bits &= bits - 1;
 				mask = ((irq + i) < 32) ?
 					(1 << cpu) : VGIC_TARGET(s, (irq + i));
 				cm = ((irq + i) < 32) ?
@@ -865,10 +918,10 @@ static int __vgic_dist_writeb(struct vgic_guest_state *s, int cpu,
 			if (irq < 16) {
 				src = 0x00;
 			}
-			for (i = 0; i < 8; i++) {
-				if (!(src & (1 << i))) {
-					continue;
-				}
+			bits = src;
+			while (bits) {
+				i = __ffs(bits);
+				bits &= bits - 1;
 				cm = ((irq + i) < 32) ?
 					(1 << cpu) : VGIC_ALL_CPU_MASK(s);
 				VGIC_CLEAR_ENABLED(s, irq + i, cm);
@@ -885,10 +938,10 @@ static int __vgic_dist_writeb(struct vgic_guest_state *s, int cpu,
 			if (irq < 16) {
 				src = 0x00;
 			}
-			for (i = 0; i < 8; i++) {
-				if (!(src & (1 << i))) {
-					continue;
-				}
+			bits = src;
+			while (bits) {
+				i = __ffs(bits);
+				bits &= bits - 1;
 				mask = VGIC_TARGET(s, irq + i);
 				VGIC_SET_PENDING(s, irq + i, mask);
 			}
@@ -898,10 +951,10 @@ static int __vgic_dist_writeb(struct vgic_guest_state *s, int cpu,
 			 * unclear whether this is the corect behavior.
 			 */
 			mask = VGIC_ALL_CPU_MASK(s);
-			for (i = 0; i < 8; i++) {
-				if (!(src & (1 << i))) {
-					continue;
-				}
+			bits = src;
+			while (bits) {
+				i = __ffs(bits);
+				bits &= bits - 1;
 				VGIC_CLEAR_PENDING(s, irq + i, mask);
 			}
 		}
@@ -1450,6 +1503,15 @@ static void vgic_enable_maint_irq(void *arg0, void *arg1, void *arg3)
 	}
 }
 
+static void vgic_remove(void)
+{
+	if (vgich.params.type == VGIC_V3) {
+		vgic_v3_remove(&vgich.ops, &vgich.params);
+	} else {
+		vgic_v2_remove(&vgich.ops, &vgich.params);
+	}
+}
+
 static int __init vgic_emulator_init(void)
 {
 	int rc;
@@ -1457,13 +1519,16 @@ static int __init vgic_emulator_init(void)
 	vgich.avail = FALSE;
 
 	rc = vgic_v2_probe(&vgich.ops, &vgich.params);
+	if (rc == VMM_ENODEV) {
+		rc = vgic_v3_probe(&vgich.ops, &vgich.params);
+	}
 	if (rc == VMM_ENODEV) {
 		vmm_printf("vgic: GIC node not found\n");
 		rc = VMM_OK;
 		goto fail;
 	}
 	if (rc != VMM_OK) {
-		vmm_printf("vgic: vgic_v2_probe() return error %d\n", rc);
+		vmm_printf("vgic: vgic_probe() return error %d\n", rc);
 		goto fail;
 	}
 
@@ -1490,7 +1555,7 @@ static int __init vgic_emulator_init(void)
 fail_unreg_dist:
 	vmm_devemu_unregister_emulator(&vgic_dist_emulator);
 fail_unprobe:
-	vgic_v2_remove(&vgich.ops, &vgich.params);
+	vgic_remove();
 fail:
 	vmm_printf("vgic: emulator not available\n");
 	return rc;
@@ -1524,7 +1589,7 @@ static void __exit vgic_emulator_exit(void)
 
 	vmm_devemu_unregister_emulator(&vgic_dist_emulator);
 
-	vgic_v2_remove(&vgich.ops, &vgich.params);
+	vgic_remove();
 }
 
 VMM_DECLARE_MODULE(MODULE_DESC,
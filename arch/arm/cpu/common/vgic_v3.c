@@ -0,0 +1,332 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vgic_v3.c
+ * @author agent (agent@local)
+ * @brief GICv3 ops for Hardware assisted GICv2 emulator.
+ *
+ * The list registers and virtual interface control registers are
+ * accessed using ICH_xxx_EL2 system registers. The Guest sees GICv2
+ * CPU interface provided by the GICv2 compatible virtual CPU interface
+ * (GICV) so Guest ACK/EOI never trap.
+ */
+
+#include <vmm_error.h>
+#include <vmm_limits.h>
+#include <vmm_host_io.h>
+#include <vmm_host_aspace.h>
+#include <vmm_stdio.h>
+#include <vmm_devtree.h>
+#include <arch_regs.h>
+#include <arch_gicv3.h>
+
+#include <vgic.h>
+
+#undef DEBUG
+
+#ifdef DEBUG
+#define DPRINTF(msg...)			vmm_printf(msg)
+#else
+#define DPRINTF(msg...)
+#endif
+
+#define ICH_HCR_EN			(1 << 0)
+#define ICH_HCR_UIE			(1 << 1)
+
+#define ICH_VTR_LRCNT_MASK		0x1f
+#define ICH_VTR_PRIBITS_SHIFT		29
+#define ICH_VTR_PREBITS_SHIFT		26
+#define ICH_VTR_BITS_MASK		0x7
+
+#define ICH_MISR_EOI			(1 << 0)
+#define ICH_MISR_U			(1 << 1)
+
+#define ICH_LR_VIRTUALID		(0x3ffULL << 0)
+#define ICH_LR_CPUID_SHIFT		(10)
+#define ICH_LR_CPUID			(0x7ULL << ICH_LR_CPUID_SHIFT)
+#define ICH_LR_PHYSID_SHIFT		(32)
+#define ICH_LR_PHYSID			(0x3ffULL << ICH_LR_PHYSID_SHIFT)
+#define ICH_LR_EOI			(1ULL << 41)
+#define ICH_LR_PRIO_SHIFT		(48)
+#define ICH_LR_PRIO			(0xffULL << ICH_LR_PRIO_SHIFT)
+#define ICH_LR_HW			(1ULL << 61)
+#define ICH_LR_PENDING			(1ULL << 62)
+#define ICH_LR_ACTIVE			(1ULL << 63)
+
+struct vgic_v3_priv {
+	physical_addr_t vcpu_pa;
+	u32 maint_irq;
+	u32 lr_cnt;
+	u32 apr_cnt;
+};
+
+static struct vgic_v3_priv vgicp;
+
+static void vgic_v3_reset_state(struct vgic_hw_state *hw)
+{
+	u32 i;
+
+	hw->v3.hcr = ICH_HCR_EN;
+	hw->v3.vmcr = 0;
+	for (i = 0; i < 4; i++) {
+		hw->v3.ap0r[i] = 0;
+		hw->v3.ap1r[i] = 0;
+	}
+	for (i = 0; i < vgicp.lr_cnt; i++) {
+		hw->v3.lr[i] = 0x0;
+	}
+}
+
+static void vgic_v3_save_state(struct vgic_hw_state *hw)
+{
+	u32 i;
+
+	hw->v3.hcr = gic_read_sysreg(ICH_HCR_EL2);
+	hw->v3.vmcr = gic_read_sysreg(ICH_VMCR_EL2);
+	switch (vgicp.apr_cnt) {
+	case 4:
+		hw->v3.ap0r[3] = gic_read_sysreg(ICH_AP0R3_EL2);
+		hw->v3.ap1r[3] = gic_read_sysreg(ICH_AP1R3_EL2);
+		hw->v3.ap0r[2] = gic_read_sysreg(ICH_AP0R2_EL2);
+		hw->v3.ap1r[2] = gic_read_sysreg(ICH_AP1R2_EL2);
+		/* Fall through */
+	case 2:
+		hw->v3.ap0r[1] = gic_read_sysreg(ICH_AP0R1_EL2);
+		hw->v3.ap1r[1] = gic_read_sysreg(ICH_AP1R1_EL2);
+		/* Fall through */
+	default:
+		hw->v3.ap0r[0] = gic_read_sysreg(ICH_AP0R0_EL2);
+		hw->v3.ap1r[0] = gic_read_sysreg(ICH_AP1R0_EL2);
+	};
+	gic_write_sysreg(ICH_HCR_EL2, 0x0);
+	for (i = 0; i < vgicp.lr_cnt; i++) {
+		hw->v3.lr[i] = gic_read_ich_lr(i);
+	}
+	isb();
+}
+
+static void vgic_v3_restore_state(struct vgic_hw_state *hw)
+{
+	u32 i;
+
+	/* Guest uses memory-mapped GICv2 CPU interface */
+	gic_write_sysreg(ICC_SRE_EL1, 0x0);
+	isb();
+
+	gic_write_sysreg(ICH_VMCR_EL2, hw->v3.vmcr);
+	switch (vgicp.apr_cnt) {
+	case 4:
+		gic_write_sysreg(ICH_AP0R3_EL2, hw->v3.ap0r[3]);
+		gic_write_sysreg(ICH_AP1R3_EL2, hw->v3.ap1r[3]);
+		gic_write_sysreg(ICH_AP0R2_EL2, hw->v3.ap0r[2]);
+		gic_write_sysreg(ICH_AP1R2_EL2, hw->v3.ap1r[2]);
+		/* Fall through */
+	case 2:
+		gic_write_sysreg(ICH_AP0R1_EL2, hw->v3.ap0r[1]);
+		gic_write_sysreg(ICH_AP1R1_EL2, hw->v3.ap1r[1]);
+		/* Fall through */
+	default:
+		gic_write_sysreg(ICH_AP0R0_EL2, hw->v3.ap0r[0]);
+		gic_write_sysreg(ICH_AP1R0_EL2, hw->v3.ap1r[0]);
+	};
+	for (i = 0; i < vgicp.lr_cnt; i++) {
+		gic_write_ich_lr(i, hw->v3.lr[i]);
+	}
+	gic_write_sysreg(ICH_HCR_EL2, hw->v3.hcr);
+	isb();
+}
+
+static bool vgic_v3_check_underflow(void)
+{
+	u32 misr = gic_read_sysreg(ICH_MISR_EL2);
+	return (misr & ICH_MISR_U) ? TRUE : FALSE;
+}
+
+static void vgic_v3_enable_underflow(void)
+{
+	u32 hcr = gic_read_sysreg(ICH_HCR_EL2);
+	gic_write_sysreg(ICH_HCR_EL2, hcr | ICH_HCR_UIE);
+	isb();
+}
+
+static void vgic_v3_disable_underflow(void)
+{
+	u32 hcr = gic_read_sysreg(ICH_HCR_EL2);
+	gic_write_sysreg(ICH_HCR_EL2, hcr & ~ICH_HCR_UIE);
+	isb();
+}
+
+static void vgic_v3_read_elrsr(u32 *elrsr0, u32 *elrsr1)
+{
+	*elrsr0 = gic_read_sysreg(ICH_ELRSR_EL2);
+	*elrsr1 = 0x0;
+}
+
+static void vgic_v3_set_lr(u32 lr, struct vgic_lr *lrv)
+{
+	u64 lrval = lrv->virtid & ICH_LR_VIRTUALID;
+
+	/* LR priority is 8-bit whereas vgic_lr has upper 5 bits */
+	lrval |= ((u64)lrv->prio << (ICH_LR_PRIO_SHIFT + 3)) & ICH_LR_PRIO;
+
+	if (lrv->flags & VGIC_LR_STATE_PENDING) {
+		lrval |= ICH_LR_PENDING;
+	}
+	if (lrv->flags & VGIC_LR_STATE_ACTIVE) {
+		lrval |= ICH_LR_ACTIVE;
+	}
+	if (lrv->flags & VGIC_LR_HW) {
+		lrval |= ICH_LR_HW;
+		lrval |= ((u64)lrv->physid << ICH_LR_PHYSID_SHIFT) &
+							ICH_LR_PHYSID;
+	} else {
+		if (lrv->flags & VGIC_LR_EOI_INT) {
+			lrval |= ICH_LR_EOI;
+		}
+		lrval |= ((u64)lrv->cpuid << ICH_LR_CPUID_SHIFT) &
+							ICH_LR_CPUID;
+	}
+
+	DPRINTF("%s: LR%d = 0x%016llx\n", __func__, lr, lrval);
+
+	gic_write_ich_lr(lr, lrval);
+}
+
+static void vgic_v3_get_lr(u32 lr, struct vgic_lr *lrv)
+{
+	u64 lrval = gic_read_ich_lr(lr);
+
+	DPRINTF("%s: LR%d = 0x%016llx\n", __func__, lr, lrval);
+
+	lrv->virtid = lrval & ICH_LR_VIRTUALID;
+	lrv->physid = 0;
+	lrv->cpuid = 0;
+	lrv->prio = (lrval & ICH_LR_PRIO) >> (ICH_LR_PRIO_SHIFT + 3);
+	lrv->flags = 0;
+
+	if (lrval & ICH_LR_PENDING) {
+		lrv->flags |= VGIC_LR_STATE_PENDING;
+	}
+	if (lrval & ICH_LR_ACTIVE) {
+		lrv->flags |= VGIC_LR_STATE_ACTIVE;
+	}
+	if (lrval & ICH_LR_HW) {
+		lrv->flags |= VGIC_LR_HW;
+		lrv->physid = (lrval & ICH_LR_PHYSID) >> ICH_LR_PHYSID_SHIFT;
+	} else {
+		if (lrval & ICH_LR_EOI) {
+			lrv->flags |= VGIC_LR_EOI_INT;
+		}
+		lrv->cpuid = (lrval & ICH_LR_CPUID) >> ICH_LR_CPUID_SHIFT;
+	}
+}
+
+static void vgic_v3_clear_lr(u32 lr)
+{
+	DPRINTF("%s: LR%d\n", __func__, lr);
+
+	gic_write_ich_lr(lr, 0x0);
+}
+
+static const struct vmm_devtree_nodeid vgic_v3_host_match[] = {
+	{ .compatible	= "arm,gic-v3",	},
+	{},
+};
+
+int vgic_v3_probe(struct vgic_ops *ops, struct vgic_params *params)
+{
+	int rc;
+	u32 vtr, rdist_regions;
+	struct vmm_devtree_node *node;
+
+	node = vmm_devtree_find_matching(NULL, vgic_v3_host_match);
+	if (!node) {
+		rc = VMM_ENODEV;
+		goto fail;
+	}
+
+	/* Registers: GICD, GICR (one or more), GICC, GICH, and GICV */
+	if (vmm_devtree_read_u32(node, "#redistributor-regions",
+				 &rdist_regions)) {
+		rdist_regions = 1;
+	}
+
+	rc = vmm_devtree_regaddr(node, &vgicp.vcpu_pa, rdist_regions + 3);
+	if (rc) {
+		vmm_printf("vgic_v3: GICv2 compatible GICV not available\n");
+		rc = VMM_ENODEV;
+		goto fail_dref;
+	}
+
+	vgicp.maint_irq = vmm_devtree_irq_parse_map(node, 0);
+	if (!vgicp.maint_irq) {
+		rc = VMM_ENODEV;
+		goto fail_dref;
+	}
+
+	vtr = gic_read_sysreg(ICH_VTR_EL2);
+	vgicp.lr_cnt = (vtr & ICH_VTR_LRCNT_MASK) + 1;
+	if (VGIC_V3_MAX_LRS < vgicp.lr_cnt) {
+		vgicp.lr_cnt = VGIC_V3_MAX_LRS;
+	}
+	switch (((vtr >> ICH_VTR_PREBITS_SHIFT) & ICH_VTR_BITS_MASK) + 1) {
+	case 7:
+		vgicp.apr_cnt = 4;
+		break;
+	case 6:
+		vgicp.apr_cnt = 2;
+		break;
+	default:
+		vgicp.apr_cnt = 1;
+		break;
+	};
+
+	vmm_devtree_dref_node(node);
+
+	params->type = VGIC_V3;
+	params->vcpu_pa = vgicp.vcpu_pa;
+	params->maint_irq = vgicp.maint_irq;
+	params->lr_cnt = vgicp.lr_cnt;
+
+	ops->reset_state = vgic_v3_reset_state;
+	ops->save_state = vgic_v3_save_state;
+	ops->restore_state = vgic_v3_restore_state;
+	ops->check_underflow = vgic_v3_check_underflow;
+	ops->enable_underflow = vgic_v3_enable_underflow;
+	ops->disable_underflow = vgic_v3_disable_underflow;
+	ops->read_elrsr = vgic_v3_read_elrsr;
+	ops->set_lr = vgic_v3_set_lr;
+	ops->get_lr = vgic_v3_get_lr;
+	ops->clear_lr = vgic_v3_clear_lr;
+
+	vmm_printf("vgic_v3: vcpu=0x%lx\n", (unsigned long)vgicp.vcpu_pa);
+	vmm_printf("vgic_v3: lr_cnt=%d maint_irq=%d\n",
+		   vgicp.lr_cnt, vgicp.maint_irq);
+
+	return VMM_OK;
+
+fail_dref:
+	vmm_devtree_dref_node(node);
+fail:
+	return rc;
+}
+
+void vgic_v3_remove(struct vgic_ops *ops, struct vgic_params *params)
+{
+	/* Nothing to do because no registers were mapped */
+}
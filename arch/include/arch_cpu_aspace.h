@@ -44,6 +44,26 @@ int arch_cpu_aspace_map(virtual_addr_t page_va,
 /** Unmap given page based on its virtual address */
 int arch_cpu_aspace_unmap(virtual_addr_t page_va);
 
+/** Map given huge page virtual address to huge page physical address
+ *  NOTE: This arch function is optional.
+ *  NOTE: Both addresses are aligned to ARCH_HOST_HUGEPAGE_SHIFT and
+ *  arch can return error to fallback to normal page mappings.
+ *  NOTE: If arch implments this function then arch_config.h
+ *  will define ARCH_HAS_HOST_HUGEPAGE feature.
+ */
+int arch_cpu_aspace_hugepage_map(virtual_addr_t page_va,
+				 physical_addr_t page_pa,
+				 u32 mem_flags);
+
+/** Unmap given huge page based on its virtual address
+ *  NOTE: This arch function is optional.
+ *  NOTE: Returns VMM_ENOTAVAIL if given virtual address is
+ *  not mapped by a huge page.
+ *  NOTE: If arch implments this function then arch_config.h
+ *  will define ARCH_HAS_HOST_HUGEPAGE feature.
+ */
+int arch_cpu_aspace_hugepage_unmap(virtual_addr_t page_va);
+
 /** Find out physical address mapped by given virtual address */
 int arch_cpu_aspace_va2pa(virtual_addr_t va, 
 			  physical_addr_t *pa);
@@ -74,6 +94,20 @@ int arch_cpu_aspace_memory_write(virtual_addr_t tmp_va,
 				 physical_addr_t dst, 
 				 void *src, u32 len, bool cacheable);
 
+/** Zero-fill memory with given physical adress
+ *  NOTE: This arch function is optional.
+ *  NOTE: The tmp_va is per host CPU temporary virtual address which
+ *  can be optionally used to access the physical memory.
+ *  NOTE: The len field will be less than or equal to VMM_PAGE_SIZE.
+ *  NOTE: When cacheable is FALSE the zeroes must be visible to
+ *  non-cacheable accesses once this function returns.
+ *  NOTE: If arch implments this function then arch_config.h
+ *  will define ARCH_HAS_MEMORY_ZERO feature.
+ */
+int arch_cpu_aspace_memory_zero(virtual_addr_t tmp_va,
+				physical_addr_t dst,
+				u32 len, bool cacheable);
+
 /** Write data to memory with given physical adress
  *  NOTE: This arch function is optional.
  *  NOTE: The tmp_va is per host CPU temporary virtual address which
@@ -57,4 +57,19 @@ int arch_guest_add_region(struct vmm_guest *guest, struct vmm_region *region);
  */
 int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region);
 
+/** Architecture specific callback for write-protecting guest pages
+ *
+ * Make guest pages of given range read-only so that next guest write
+ * to any of them is reported via vmm_guest_dirty_log_mark(). This is
+ * used by core code for dirty page logging.
+ *
+ * @param guest Guest whose pages are write-protected.
+ * @param gphys Guest physical address of range.
+ * @param size Size of range.
+ * @return This function should return VMM_OK on success,
+ * VMM_ENOTSUPP if not supported or appropriate error code otherwise.
+ */
+int arch_guest_write_protect(struct vmm_guest *guest,
+			     physical_addr_t gphys, physical_size_t size);
+
 #endif
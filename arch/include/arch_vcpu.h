@@ -26,6 +26,7 @@
 #include <vmm_types.h>
 #include <vmm_chardev.h>
 #include <vmm_manager.h>
+#include <vmm_snapshot.h>
 
 /** Architecture specific VCPU Initialization */
 int arch_vcpu_init(struct vmm_vcpu *vcpu);
@@ -68,10 +69,32 @@ void arch_vcpu_regs_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu);
 /** Print architecture specific stats for a VCPU */
 void arch_vcpu_stat_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu);
 
+/** Save architecture specific state of a paused Normal VCPU
+ *  (Note: Return VMM_ENOTSUPP if not supported)
+ */
+int arch_vcpu_state_save(struct vmm_vcpu *vcpu,
+			 struct vmm_snapshot_state *st);
+
+/** Restore architecture specific state of a Normal VCPU in reset state
+ *  (Note: Return VMM_ENOTSUPP if not supported)
+ */
+int arch_vcpu_state_restore(struct vmm_vcpu *vcpu,
+			    struct vmm_snapshot_state *st);
+
+/** Get program counters for a profiler sample taken on interrupted
+ *  register context of given VCPU. The host_pc is set to zero and
+ *  TRUE is returned when interrupted context was guest mode.
+ */
+bool arch_vcpu_sample_pc(struct vmm_vcpu *vcpu, arch_regs_t *regs,
+			 virtual_addr_t *host_pc, virtual_addr_t *guest_pc);
+
 /** Get count of VCPU interrupts */
 u32 arch_vcpu_irq_count(struct vmm_vcpu *vcpu);
 
-/** Get priority for given VCPU interrupt number */
+/** Get priority for given VCPU interrupt number
+ *  NOTE: Priority of an interrupt must not change until VCPU reset
+ *  because pending interrupts are kept in priority order.
+ */
 u32 arch_vcpu_irq_priority(struct vmm_vcpu *vcpu, u32 irq_no);
 
 /** Assert VCPU interrupt
@@ -199,7 +199,7 @@ static inline void gather_intel_features(struct cpuinfo_x86 *cpu_info)
 
 void indentify_cpu(void)
 {
-	u32 tmp;
+	u32 tmp, a, b, c, d;
 
 	cpuid(CPUID_BASE_VENDORSTRING, (u32 *)&tmp,
 		(u32 *)&cpu_info.vendor_string[0],
@@ -224,4 +224,18 @@ void indentify_cpu(void)
 		gather_intel_features(&cpu_info);
 		break;
 	}
+
+	/* Enhanced REP MOVSB/STOSB used by memcpy() and memset() */
+	if (CPUID_BASE_FEAT_FLAGS <= tmp) {
+		cpuid_count(CPUID_BASE_FEAT_FLAGS, 0, &a, &b, &c, &d);
+		cpu_info.erms = (b >> CPUID_SEXT_FEAT_EBX_ERMS_BIT) & 1;
+		cpu_info.sha_ni = (b >> CPUID_SEXT_FEAT_EBX_SHA_BIT) & 1;
+	}
+
+	/* SHA-256 code also needs SSSE3 and SSE4.1 */
+	cpuid(CPUID_BASE_FEATURES, &a, &b, &c, &d);
+	cpu_info.crc32c = (c & CPUID_FEAT_ECX_SSE4_2) ? 1 : 0;
+	if (!(c & CPUID_FEAT_ECX_SSSE3) || !(c & CPUID_FEAT_ECX_SSE4_1)) {
+		cpu_info.sha_ni = 0;
+	}
 }
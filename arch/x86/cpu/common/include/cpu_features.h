@@ -37,6 +37,12 @@
 #define CPUID_FEAT_ECX_VMX_BIT          5
 #define CPUID_FEAT_ECX_MONITOR_BIT      3
 #define CPUID_FEAT_ECX_x2APIC_BIT       21
+#define CPUID_FEAT_ECX_TSC_DEADLINE_BIT 24
+#define CPUID_FEAT_ECX_HYPERVISOR_BIT   31
+
+/* Structured extended features (leaf 7, sub-leaf 0) */
+#define CPUID_SEXT_FEAT_EBX_ERMS_BIT    9
+#define CPUID_SEXT_FEAT_EBX_SHA_BIT     29
 
 enum {
 	CPUID_FEAT_EDX_FPU_BIT = 0,
@@ -149,6 +155,9 @@ enum cpuid_requests {
 	CPUID_BASE_FUNC_LIMIT,
 
 	CPUID_VM_CPUID_BASE=0x40000000,
+	CPUID_VM_CPUID_FEATURES,
+
+	CPUID_VM_FUNC_LIMIT,
 
 	CPUID_EXTENDED_BASE=0x80000000,
 	CPUID_EXTENDED_FEATURES,
@@ -167,6 +176,13 @@ enum cpuid_requests {
 	CPUID_EXTENDED_FUNC_LIMIT
 };
 
+/* KVM compatible hypervisor signature and feature bits */
+#define CPUID_VM_SIGNATURE_EBX		0x4b4d564b /* "KVMK" */
+#define CPUID_VM_SIGNATURE_ECX		0x564b4d56 /* "VMKV" */
+#define CPUID_VM_SIGNATURE_EDX		0x0000004d /* "M" */
+#define CPUID_VM_FEAT_CLOCKSOURCE2_BIT	3
+#define CPUID_VM_FEAT_STEAL_TIME_BIT	5
+
 #define APIC_BASE(__msr)	(__msr >> 12)
 #define APIC_ENABLED(__msr)	(__msr & (0x01UL << 11))
 
@@ -279,6 +295,9 @@ struct cpuinfo_x86 {
 	u8 hw_virt_available;
 	u8 hw_nested_paging;
 	u8 decode_assist;
+	u8 erms;
+	u8 sha_ni;
+	u8 crc32c;
 	u32 hw_nr_asids;
 }__aligned(ARCH_CACHE_LINE_SIZE);
 
@@ -294,6 +313,15 @@ static inline void cpuid(int code, u32 *a, u32 *b, u32 *c, u32* d)
 		:"0"(code));
 }
 
+/* Issue CPUID request which has sub-leaves (selected by ECX) */
+static inline void cpuid_count(int code, int count,
+			       u32 *a, u32 *b, u32 *c, u32 *d)
+{
+	asm volatile("cpuid\n\t"
+		:"=a"(*a), "=d"(*d), "=b"(*b), "=c"(*c)
+		:"0"(code), "3"(count));
+}
+
 static inline u8 cpu_has_msr(void)
 {
 	u32 a, b, c, d;
@@ -304,6 +332,16 @@ static inline u8 cpu_has_msr(void)
 	return (d & CPUID_FEAT_EDX_MSR);
 }
 
+static inline u64 cpu_rdtsc(void)
+{
+	u32 a, d;
+
+	asm volatile ("rdtsc\n\t"
+		      :"=a"(a),"=d"(d));
+
+	return (((u64)d << 32) | a);
+}
+
 static inline u64 cpu_read_msr(u32 msr)
 {
 	u32 a, d;
@@ -26,6 +26,11 @@
 
 #define X86_MAX_INST_LEN	14
 
+/* Number of decoded instructions cached per VCPU */
+#define X86_DECODE_CACHE_SIZE	8
+
+struct vcpu_hw_context;
+
 typedef unsigned char x86_inst[X86_MAX_INST_LEN];
 
 typedef enum {
@@ -126,6 +131,9 @@ typedef union mod_rm {
 typedef struct {
 	u64 inst_type;
 	u64 inst_size;
+	/* Memory source operand address was taken from a guest register */
+	u8 src_reg_based;
+	u8 src_base_reg;
 	union {
 		struct {
 			u32 op_size;  /* size of operation */
@@ -148,7 +156,26 @@ typedef struct {
 } x86_decoded_inst_t;
 
 
+struct x86_decode_cache_entry {
+	bool valid;
+	u64 rip;
+	u64 cr3;
+	x86_inst inst;
+	x86_decoded_inst_t dinst;
+};
+
 int x86_decode_inst(struct vcpu_hw_context *context, x86_inst inst,
 		    x86_decoded_inst_t *dinst);
 
+/*
+ * Decode instruction at given guest RIP and CR3 using per-VCPU decode
+ * cache. Only first inst_len bytes of inst are valid. A cached decode
+ * is used only if instruction bytes are unchanged so guest code writes
+ * never return stale decode. Returns VMM_ENOTAVAIL if instruction is
+ * longer than inst_len bytes.
+ */
+int x86_decode_inst_cached(struct vcpu_hw_context *context, u64 rip, u64 cr3,
+			   x86_inst inst, u32 inst_len,
+			   x86_decoded_inst_t *dinst);
+
 #endif /* __CPU_INST_DECODE_H_ */
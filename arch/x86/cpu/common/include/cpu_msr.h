@@ -301,6 +301,8 @@
 #define MSR_IA32_APICBASE_ENABLE	(1<<11)
 #define MSR_IA32_APICBASE_BASE		(0xfffff<<12)
 
+#define MSR_IA32_TSC_DEADLINE		0x000006e0
+
 #define MSR_IA32_UCODE_WRITE		0x00000079
 #define MSR_IA32_UCODE_REV		0x0000008b
 
@@ -463,4 +465,9 @@
 /* Geode defined MSRs */
 #define MSR_GEODE_BUSCONT_CONF0		0x00001900
 
+/* KVM compatible paravirtual clock MSRs */
+#define MSR_KVM_WALL_CLOCK_NEW		0x4b564d00
+#define MSR_KVM_SYSTEM_TIME_NEW		0x4b564d01
+#define MSR_KVM_STEAL_TIME		0x4b564d03
+
 #endif /* __MSR_INDEX_H__ */
@@ -7,6 +7,7 @@
 #include <cpu_features.h>
 #include <vmm_types.h>
 #include <cpu_pgtbl_helper.h>
+#include <cpu_inst_decode.h>
 #include <libs/bitmap.h>
 
 enum {
@@ -88,6 +89,29 @@ enum guest_regs {
  */
 #define NR_32BIT_PGLIST_PAGES	(0x1 << GUEST_PGLIST_ORDER)
 
+/**
+ * \define Number of shadow page table roots cached per VCPU.
+ *
+ * Each root shadows the page tables of one guest CR3. Roots of
+ * inactive guest CR3 stay cached and the guest page table pages
+ * they shadow are write protected so that any change to them
+ * drops the stale root.
+ */
+#define NR_SHADOW32_ROOTS		4
+#define NR_SHADOW32_ROOT_FRAMES		64
+#define NR_SHADOW32_WP_FRAMES		\
+	((NR_SHADOW32_ROOTS - 1) * NR_SHADOW32_ROOT_FRAMES)
+
+struct shadow32_root {
+	bool valid;
+	bool cacheable; /**< FALSE if guest page table pages did not fit in frames */
+	u64 g_cr3; /**< Guest CR3 shadowed by this root */
+	u64 last_used;
+	int pgt_index; /**< Page directory index in shadow32_pg_list */
+	u32 nr_frames;
+	physical_addr_t frames[NR_SHADOW32_ROOT_FRAMES]; /**< Host frames of shadowed guest page tables */
+};
+
 enum {
 	GUEST_PG_LVL_1,
 	GUEST_PG_LVL_2,
@@ -116,15 +140,37 @@ struct vcpu_hw_context {
 	u64 g_efer;
 	u64 g_cr8;
 
-	unsigned int asid;
+	unsigned int asid; /**< ASID (SVM) or VPID (VMX) tagging guest TLB entries */
+	u64 asid_generation; /**< Generation of host CPU ASID space asid belongs to */
+	u32 asid_hcpu; /**< Host CPU on which asid is valid */
+	bool asid_flush; /**< Flush guest TLB entries tagged with asid before next run */
 	unsigned long n_cr3;  /* [Note] When #VMEXIT occurs with
 			       * nested paging enabled, hCR3 is not
 			       * saved back into the VMCB (vol2 p. 409)???*/
-	struct page_table *shadow_pgt; /**< Shadow page table when EPT/NPT is not available in chip */
+	struct page_table *shadow_pgt; /**< Nested page table when NPT is enabled (shadow page table otherwise) */
+	bool nested_paging; /**< Guest physical to host physical translation is done by hardware using shadow_pgt */
 	union page32 *shadow32_pg_list; /**< Page list for 32-bit guest and paged real mode. */
-	union page32 *shadow32_pgt; /**<32-bit page table */
+	physical_addr_t shadow32_pg_list_pa;
+	union page32 *shadow32_pgt; /**<32-bit page table of current root */
 	DECLARE_BITMAP(shadow32_pg_map, NR_32BIT_PGLIST_PAGES);
-	u32 pgmap_free_cache;
+	struct shadow32_root shadow32_roots[NR_SHADOW32_ROOTS];
+	struct shadow32_root *shadow32_cur;
+	u64 shadow32_clock;
+	u32 shadow32_wp_count; /**< Sorted host frames write protected in current root */
+	physical_addr_t shadow32_wp_frames[NR_SHADOW32_WP_FRAMES];
+
+	/* KVM compatible paravirtual clock of VCPU */
+	u64 pvclock_msr; /**< Last value written to system time MSR */
+	physical_addr_t pvclock_gpa; /**< Guest physical address of time info */
+	u32 pvclock_version;
+	bool pvclock_update; /**< Refresh time info before next VM entry */
+	u64 steal_msr; /**< Last value written to steal time MSR */
+	u32 steal_version;
+
+	u64 exit_tstamp; /**< Timestamp of last VM exit (for exit statistics) */
+
+	/* Instructions decoded on MMIO exits, indexed by guest RIP */
+	struct x86_decode_cache_entry decode_cache[X86_DECODE_CACHE_SIZE];
 
 	struct vcpu_intercept_table icept_table;
 
@@ -172,8 +218,6 @@ struct cpuid_response {
 struct x86_vcpu_priv {
 	vmm_spinlock_t lock;
 	u64 capabilities;
-	struct cpuid_response extended_funcs[CPUID_EXTENDED_FUNC_LIMIT-CPUID_EXTENDED_BASE];
-	struct cpuid_response standard_funcs[CPUID_BASE_FUNC_LIMIT];
 	struct vcpu_hw_context *hw_context;
 	int int_pending; /* vector to be taken in guest */
 };
@@ -191,8 +235,13 @@ extern void cpu_disable_vcpu_intercept(struct vcpu_hw_context *context, int flag
 extern void cpu_enable_vcpu_intercept(struct vcpu_hw_context *context, int flags);
 extern void enable_ioport_intercept(struct vcpu_hw_context *context, u32 ioport);
 extern void disable_ioport_intercept(struct vcpu_hw_context *context, u32 ioport);
+extern void enable_msr_intercept(struct vcpu_hw_context *context, u32 msr);
+extern void disable_msr_intercept(struct vcpu_hw_context *context, u32 msr);
+extern void setup_vcpu_msr_intercepts(struct vcpu_hw_context *context);
 extern int cpu_init_vcpu_hw_context(struct cpuinfo_x86 *cpuinfo, struct vcpu_hw_context *context);
 extern void cpu_boot_vcpu(struct vcpu_hw_context *context);
+extern bool cpu_vcpu_asid_refresh(struct vcpu_hw_context *context, u32 max_asid);
+extern void cpu_vcpu_asid_flush(struct vcpu_hw_context *context);
 
 extern int cpu_enable_vm_extensions(struct cpuinfo_x86 *cpuinfo);
 
@@ -127,6 +127,8 @@ int x86_decode_inst(struct vcpu_hw_context *context, x86_inst inst,
 		dinst->inst.gen_mov.src_type = OP_TYPE_MEM;
 		dinst->inst.gen_mov.dst_type = OP_TYPE_REG;
 		dinst->inst.gen_mov.src_addr = context->g_regs[rm.f.src];
+		dinst->src_reg_based = 1;
+		dinst->src_base_reg = rm.f.src;
 		dinst->inst.gen_mov.dst_addr = rm.f.dst;
 		break;
 
@@ -151,3 +153,43 @@ int x86_decode_inst(struct vcpu_hw_context *context, x86_inst inst,
 
 	return VMM_OK;
 }
+
+static inline u32 x86_decode_cache_index(u64 rip)
+{
+	return (rip ^ (rip >> 4)) & (X86_DECODE_CACHE_SIZE - 1);
+}
+
+int x86_decode_inst_cached(struct vcpu_hw_context *context, u64 rip, u64 cr3,
+			   x86_inst inst, u32 inst_len,
+			   x86_decoded_inst_t *dinst)
+{
+	int rc;
+	struct x86_decode_cache_entry *e =
+		&context->decode_cache[x86_decode_cache_index(rip)];
+
+	if (e->valid && (e->rip == rip) && (e->cr3 == cr3) &&
+	    (e->dinst.inst_size <= inst_len) &&
+	    !memcmp(e->inst, inst, e->dinst.inst_size)) {
+		memcpy(dinst, &e->dinst, sizeof(x86_decoded_inst_t));
+		/* Register based operands are taken from current state */
+		if (dinst->src_reg_based)
+			dinst->inst.gen_mov.src_addr =
+				context->g_regs[dinst->src_base_reg];
+		return VMM_OK;
+	}
+
+	rc = x86_decode_inst(context, inst, dinst);
+	if (rc != VMM_OK)
+		return rc;
+
+	if (dinst->inst_size > inst_len)
+		return VMM_ENOTAVAIL;
+
+	e->valid = TRUE;
+	e->rip = rip;
+	e->cr3 = cr3;
+	memcpy(e->inst, inst, sizeof(x86_inst));
+	memcpy(&e->dinst, dinst, sizeof(x86_decoded_inst_t));
+
+	return VMM_OK;
+}
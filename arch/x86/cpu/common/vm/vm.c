@@ -25,6 +25,9 @@
 #include <vmm_host_aspace.h>
 #include <vmm_error.h>
 #include <vmm_manager.h>
+#include <vmm_smp.h>
+#include <vmm_percpu.h>
+#include <vmm_macros.h>
 #include <libs/stringlib.h>
 #include <cpu_mmu.h>
 #include <cpu_vm.h>
@@ -129,14 +132,170 @@ void disable_ioport_intercept(struct vcpu_hw_context *context, u32 ioport)
 	*iop_base &= ~(0x1 << port_offset);
 }
 
+/*
+ * Locate read intercept bit of an MSR in MSR permission bitmap.
+ * SVM keeps read and write bits of an MSR adjacent (2 bits per MSR)
+ * in three 2KB ranges whereas VMX has separate 1KB read and write
+ * bitmaps for low and high MSRs. Returns FALSE for MSRs which are
+ * always intercepted.
+ */
+static bool msr_intercept_bits(struct vcpu_hw_context *context, u32 msr,
+			       u32 *rd_bit, u32 *wr_bit)
+{
+	u32 base, off = msr & 0x1fff;
+
+	if (context->cpuinfo->vendor == x86_VENDOR_AMD) {
+		if (msr <= 0x1fff)
+			base = 0x0;
+		else if ((msr >= 0xc0000000) && (msr <= 0xc0001fff))
+			base = 0x800;
+		else if ((msr >= 0xc0010000) && (msr <= 0xc0011fff))
+			base = 0x1000;
+		else
+			return FALSE;
+		*rd_bit = (base * 8) + (off * 2);
+		*wr_bit = *rd_bit + 1;
+	} else {
+		if (msr <= 0x1fff)
+			base = 0x0;
+		else if ((msr >= 0xc0000000) && (msr <= 0xc0001fff))
+			base = 0x400;
+		else
+			return FALSE;
+		*rd_bit = (base * 8) + off;
+		*wr_bit = ((base + 0x800) * 8) + off;
+	}
+
+	return TRUE;
+}
+
+void enable_msr_intercept(struct vcpu_hw_context *context, u32 msr)
+{
+	u32 rd_bit, wr_bit;
+	u8 *msrp_base = (u8 *)context->icept_table.msr_table_virt;
+
+	if (!msr_intercept_bits(context, msr, &rd_bit, &wr_bit))
+		return;
+
+	msrp_base[rd_bit >> 3] |= (0x1 << (rd_bit & 0x7));
+	msrp_base[wr_bit >> 3] |= (0x1 << (wr_bit & 0x7));
+}
+
+void disable_msr_intercept(struct vcpu_hw_context *context, u32 msr)
+{
+	u32 rd_bit, wr_bit;
+	u8 *msrp_base = (u8 *)context->icept_table.msr_table_virt;
+
+	if (!msr_intercept_bits(context, msr, &rd_bit, &wr_bit))
+		return;
+
+	msrp_base[rd_bit >> 3] &= ~(0x1 << (rd_bit & 0x7));
+	msrp_base[wr_bit >> 3] &= ~(0x1 << (wr_bit & 0x7));
+}
+
+/*
+ * MSRs which are part of guest state switched by hardware on
+ * VM entry/exit (VMCB save area on SVM with VMLOAD/VMSAVE, guest
+ * state area of VMCS on VMX). These are touched often by guest
+ * on context switch and system calls so let guest access them
+ * without exits. Everything else is intercepted.
+ */
+static const u32 svm_passthrough_msrs[] = {
+	MSR_FS_BASE, MSR_GS_BASE, MSR_SHADOW_GS_BASE,
+	MSR_STAR, MSR_LSTAR, MSR_CSTAR, MSR_SYSCALL_MASK,
+	MSR_IA32_SYSENTER_CS, MSR_IA32_SYSENTER_ESP, MSR_IA32_SYSENTER_EIP,
+};
+
+static const u32 vmx_passthrough_msrs[] = {
+	MSR_FS_BASE, MSR_GS_BASE,
+	MSR_IA32_SYSENTER_CS, MSR_IA32_SYSENTER_ESP, MSR_IA32_SYSENTER_EIP,
+};
+
+void setup_vcpu_msr_intercepts(struct vcpu_hw_context *context)
+{
+	int i;
+
+	if (!context->icept_table.msr_table_virt)
+		return;
+
+	memset((void *)context->icept_table.msr_table_virt, 0xff,
+	       MSR_INTCPT_TBL_SZ);
+
+	if (context->cpuinfo->vendor == x86_VENDOR_AMD) {
+		for (i = 0; i < array_size(svm_passthrough_msrs); i++)
+			disable_msr_intercept(context, svm_passthrough_msrs[i]);
+	} else {
+		for (i = 0; i < array_size(vmx_passthrough_msrs); i++)
+			disable_msr_intercept(context, vmx_passthrough_msrs[i]);
+	}
+}
+
+struct cpu_asid_state {
+	u64 generation;
+	u32 next_asid;
+};
+
+static DEFINE_PER_CPU(struct cpu_asid_state, asid_state);
+
+/**
+ * Make sure the VCPU has a valid ASID (SVM) or VPID (VMX) on current
+ * host CPU. ASIDs are handed out per host CPU and once exhausted a
+ * new generation starts which invalidates all ASIDs handed out on
+ * this host CPU so far. Returns TRUE if the complete TLB of host CPU
+ * must be flushed before running the VCPU.
+ *
+ * Must be called with interrupts disabled just before VM entry.
+ */
+bool cpu_vcpu_asid_refresh(struct vcpu_hw_context *context, u32 max_asid)
+{
+	bool flush_all = FALSE;
+	u32 hcpu = vmm_smp_processor_id();
+	struct cpu_asid_state *st = &this_cpu(asid_state);
+
+	if ((context->asid_hcpu == hcpu) &&
+	    (context->asid_generation == st->generation)) {
+		return FALSE;
+	}
+
+	/* Zero next_asid means ASID space of host CPU is untouched */
+	if ((st->next_asid == 0) || (st->next_asid > max_asid)) {
+		st->generation++;
+		st->next_asid = 1;
+		flush_all = TRUE;
+	}
+
+	context->asid = st->next_asid++;
+	context->asid_generation = st->generation;
+	context->asid_hcpu = hcpu;
+
+	/* Fresh ASID has no stale entries in this generation */
+	context->asid_flush = FALSE;
+
+	return flush_all;
+}
+
+/**
+ * Request flush of all guest TLB entries tagged with VCPU ASID
+ * before next VM entry.
+ */
+void cpu_vcpu_asid_flush(struct vcpu_hw_context *context)
+{
+	context->asid_flush = TRUE;
+}
+
 int cpu_init_vcpu_hw_context(struct cpuinfo_x86 *cpuinfo,
 			     struct vcpu_hw_context *context)
 {
 	int ret = VMM_EFAIL;
-	int boffs;
 
 	context->cpuinfo = cpuinfo;
 
+	/* ASID is assigned on first run */
+	context->asid = 0;
+	context->asid_generation = 0;
+	context->asid_hcpu = CONFIG_CPU_COUNT;
+	context->asid_flush = FALSE;
+
 	context->shadow_pgt = mmu_pgtbl_alloc(&host_pgtbl_ctl, PGTBL_STAGE_2);
 	if (!context->shadow_pgt) {
 		VM_LOG(LVL_DEBUG, "ERROR: Failed to allocate shadow page table for vcpu.\n");
@@ -151,14 +310,10 @@ int cpu_init_vcpu_hw_context(struct cpuinfo_x86 *cpuinfo,
 		goto _error;
 	}
 
-	memset(context->shadow32_pg_list, 0, (NR_32BIT_PGLIST_PAGES*PAGE_SIZE));
-
-	/* Mark all pages in list free */
-	bitmap_zero(context->shadow32_pg_map, NR_32BIT_PGLIST_PAGES);
-	boffs = bitmap_find_free_region(context->shadow32_pg_map, NR_32BIT_PGLIST_PAGES, 0);
-	context->shadow32_pgt = context->shadow32_pg_list + boffs;
-	memset(context->shadow32_pgt, 0, PAGE_SIZE);
-	context->pgmap_free_cache = boffs+1;
+	if (setup_guest_shadow_pagetable(context) != VMM_OK) {
+		VM_LOG(LVL_ERR, "ERROR: Failed to setup shadow page table cache.\n");
+		goto _error;
+	}
 
 	context->icept_table.io_table_phys =
 		cpu_create_vcpu_intercept_table(IO_INTCPT_TBL_SZ,
@@ -176,6 +331,8 @@ int cpu_init_vcpu_hw_context(struct cpuinfo_x86 *cpuinfo,
 		goto _error;
 	}
 
+	setup_vcpu_msr_intercepts(context);
+
 	switch (cpuinfo->vendor) {
 	case x86_VENDOR_AMD:
 		if((ret = amd_setup_vm_control(context)) != VMM_OK) {
@@ -245,6 +402,8 @@ int cpu_enable_vm_extensions(struct cpuinfo_x86 *cpuinfo)
 void cpu_boot_vcpu(struct vcpu_hw_context *context)
 {
 	for(;;)	{
+		if (context->pvclock_update)
+			cpu_vcpu_pvclock_update(context);
 		context->vcpu_run(context);
 	}
 }
@@ -29,12 +29,127 @@
 #include <vmm_host_aspace.h>
 #include <vmm_macros.h>
 #include <cpu_mmu.h>
+#include <cpu_pgtbl_helper.h>
 #include <cpu_features.h>
 #include <cpu_vm.h>
 #include <vm/amd_svm.h>
 #include <libs/stringlib.h>
+#include <libs/bitops.h>
 #include <arch_guest_helper.h>
 
+static void guest_cpuid_filter_features(u32 *b, u32 *c, u32 *d)
+{
+	extern struct cpuinfo_x86 cpu_info;
+
+	/* NR cpus and apic id are per-VCPU */
+	*b &= 0x0000FFFF;
+
+	/* No VMX or x2APIC */
+	if (cpu_info.vendor == x86_VENDOR_INTEL) {
+		clear_bit(CPUID_FEAT_ECX_x2APIC_BIT, (volatile unsigned long *)c);
+		clear_bit(CPUID_FEAT_ECX_VMX_BIT, (volatile unsigned long *)c);
+	}
+	clear_bit(CPUID_FEAT_ECX_MONITOR_BIT, (volatile unsigned long *)c);
+
+	/* No PAE, MTRR, PGE, ACPI, PSE & MSR */
+	clear_bit(CPUID_FEAT_EDX_PAE_BIT, (volatile unsigned long *)d);
+	clear_bit(CPUID_FEAT_EDX_MTRR_BIT, (volatile unsigned long *)d);
+	clear_bit(CPUID_FEAT_EDX_PGE_BIT, (volatile unsigned long *)d);
+	clear_bit(CPUID_FEAT_EDX_ACPI_BIT, (volatile unsigned long *)d);
+	clear_bit(CPUID_FEAT_EDX_HTT_BIT, (volatile unsigned long *)d);
+	clear_bit(CPUID_FEAT_EDX_PSE_BIT, (volatile unsigned long *)d);
+	clear_bit(CPUID_FEAT_EDX_MSR_BIT, (volatile unsigned long *)d);
+}
+
+/*
+ * Compute CPUID responses of guest once. Leaves which are not
+ * listed here read as zero.
+ */
+static void guest_init_cpuid(struct x86_guest_priv *priv)
+{
+	extern struct cpuinfo_x86 cpu_info;
+	struct cpuid_response *r;
+	u32 func;
+
+	r = &priv->cpuid_std[CPUID_BASE_VENDORSTRING];
+	cpuid(CPUID_BASE_VENDORSTRING, &r->resp_eax, &r->resp_ebx,
+	      &r->resp_ecx, &r->resp_edx);
+	r->resp_eax = CPUID_BASE_FUNC_LIMIT;
+
+	r = &priv->cpuid_std[CPUID_BASE_FEATURES];
+	cpuid(CPUID_BASE_FEATURES, &r->resp_eax, &r->resp_ebx,
+	      &r->resp_ecx, &r->resp_edx);
+	guest_cpuid_filter_features(&r->resp_ebx, &r->resp_ecx,
+				    &r->resp_edx);
+	r->resp_ecx |= (1UL << CPUID_FEAT_ECX_HYPERVISOR_BIT);
+
+	/* KVM compatible leaves for discovering paravirtual clock */
+	r = &priv->cpuid_vm[0];
+	r->resp_eax = CPUID_VM_CPUID_FEATURES;
+	r->resp_ebx = CPUID_VM_SIGNATURE_EBX;
+	r->resp_ecx = CPUID_VM_SIGNATURE_ECX;
+	r->resp_edx = CPUID_VM_SIGNATURE_EDX;
+
+	r = &priv->cpuid_vm[CPUID_VM_CPUID_FEATURES - CPUID_VM_CPUID_BASE];
+	r->resp_eax = (1UL << CPUID_VM_FEAT_CLOCKSOURCE2_BIT) |
+		      (1UL << CPUID_VM_FEAT_STEAL_TIME_BIT);
+
+	r = &priv->cpuid_ext[0];
+	cpuid(CPUID_EXTENDED_BASE, &r->resp_eax, &r->resp_ebx,
+	      &r->resp_ecx, &r->resp_edx);
+	r->resp_eax = CPUID_EXTENDED_L2_CACHE_TLB_IDENTIFIER;
+
+	for (func = CPUID_EXTENDED_BRANDSTRING;
+	     func <= CPUID_EXTENDED_BRANDSTRINGEND; func++) {
+		r = &priv->cpuid_ext[func - CPUID_EXTENDED_BASE];
+		cpuid(func, &r->resp_eax, &r->resp_ebx,
+		      &r->resp_ecx, &r->resp_edx);
+	}
+
+	if (cpu_info.vendor == x86_VENDOR_AMD) {
+		func = AMD_CPUID_EXTENDED_L1_CACHE_TLB_IDENTIFIER;
+		r = &priv->cpuid_ext[func - CPUID_EXTENDED_BASE];
+		cpuid(func, &r->resp_eax, &r->resp_ebx,
+		      &r->resp_ecx, &r->resp_edx);
+
+		func = CPUID_EXTENDED_L2_CACHE_TLB_IDENTIFIER;
+		r = &priv->cpuid_ext[func - CPUID_EXTENDED_BASE];
+		cpuid(func, &r->resp_eax, &r->resp_ebx,
+		      &r->resp_ecx, &r->resp_edx);
+	}
+}
+
+/*!
+ * \fn void guest_cpuid(struct vmm_vcpu *vcpu, u32 func, struct cpuid_response *resp)
+ * \brief Get CPUID response for a VCPU from precomputed guest table.
+ *
+ * \param vcpu The VCPU executing CPUID.
+ * \param func The CPUID function (EAX) requested.
+ * \param resp Filled with the response.
+ */
+void guest_cpuid(struct vmm_vcpu *vcpu, u32 func, struct cpuid_response *resp)
+{
+	struct x86_guest_priv *priv = x86_guest_priv(vcpu->guest);
+
+	if (func < CPUID_BASE_FUNC_LIMIT) {
+		*resp = priv->cpuid_std[func];
+	} else if ((func >= CPUID_EXTENDED_BASE) &&
+		   (func < CPUID_EXTENDED_FUNC_LIMIT)) {
+		*resp = priv->cpuid_ext[func - CPUID_EXTENDED_BASE];
+	} else if ((func >= CPUID_VM_CPUID_BASE) &&
+		   (func < CPUID_VM_FUNC_LIMIT)) {
+		*resp = priv->cpuid_vm[func - CPUID_VM_CPUID_BASE];
+	} else {
+		VM_LOG(LVL_DEBUG, "Unknown CPUID function 0x%x\n", func);
+		memset(resp, 0, sizeof(*resp));
+		return;
+	}
+
+	if (func == CPUID_BASE_FEATURES)
+		resp->resp_ebx |= ((vcpu->subid << 24) |
+				   (vcpu->guest->vcpu_count << 16));
+}
+
 int arch_guest_init(struct vmm_guest * guest)
 {
 	struct x86_guest_priv *priv = vmm_zalloc(sizeof(struct x86_guest_priv));
@@ -46,38 +161,133 @@ int arch_guest_init(struct vmm_guest * guest)
 
 	guest->arch_priv = (void *)priv;
 
+	guest_init_cpuid(priv);
+
+	/* Guest TSC-deadline timer and paravirtual clock need TSC rate */
+	cpu_tsc_calibrate();
+
 	VM_LOG(LVL_VERBOSE, "Guest init successful!\n");
 	return VMM_OK;
 }
 
 int arch_guest_deinit(struct vmm_guest * guest)
 {
+	u32 i;
 	struct x86_guest_priv *priv = x86_guest_priv(guest);
 
 	if (priv) {
+		for (i = 0; i < GUEST_IOPORT_L1_COUNT; i++) {
+			if (priv->ioport_map[i])
+				vmm_free(priv->ioport_map[i]);
+		}
 		vmm_free(priv);
 	}
 
 	return VMM_OK;
 }
 
-int arch_guest_add_region(struct vmm_guest *guest, struct vmm_region *region)
+static int guest_ioport_map_update(struct vmm_guest *guest,
+				   struct vmm_region *region,
+				   struct vmm_region *val)
+{
+	u32 port, l1;
+	u32 reg_end = region->gphys_addr + region->phys_size;
+	struct x86_guest_priv *priv = x86_guest_priv(guest);
+
+	if (reg_end > GUEST_IOPORT_COUNT)
+		return VMM_EINVALID;
+
+	for (port = region->gphys_addr; port < reg_end; port++) {
+		l1 = port >> GUEST_IOPORT_L2_SHIFT;
+		if (!priv->ioport_map[l1]) {
+			if (!val)
+				continue;
+			priv->ioport_map[l1] = vmm_zalloc(GUEST_IOPORT_L2_COUNT *
+						sizeof(struct vmm_region *));
+			if (!priv->ioport_map[l1])
+				return VMM_ENOMEM;
+		}
+		priv->ioport_map[l1][port & (GUEST_IOPORT_L2_COUNT - 1)] = val;
+	}
+
+	return VMM_OK;
+}
+
+static void guest_ioport_intercept_update(struct vmm_guest *guest,
+					  struct vmm_region *region,
+					  bool intercept)
 {
 	struct vmm_vcpu *vcpu;
+	struct vcpu_hw_context *context;
 	u32 i, flags;
+	u32 reg_end = region->gphys_addr + region->phys_size;
 
-	if (region->flags & VMM_REGION_IO) {
-		u32 reg_end = region->gphys_addr + region->phys_size;
+	vmm_read_lock_irqsave_lite(&guest->vcpu_lock, flags);
 
+	list_for_each_entry(vcpu, &guest->vcpu_list, head) {
+		context = x86_vcpu_priv(vcpu)->hw_context;
+		if (!context)
+			continue;
 		for (i = region->gphys_addr; i < reg_end; i++) {
-			vmm_read_lock_irqsave_lite(&guest->vcpu_lock, flags);
+			if (intercept)
+				enable_ioport_intercept(context, i);
+			else
+				disable_ioport_intercept(context, i);
+		}
+	}
 
-			list_for_each_entry(vcpu, &guest->vcpu_list, head) {
-				enable_ioport_intercept(x86_vcpu_priv(vcpu)->hw_context, i);
-			}
+	vmm_read_unlock_irqrestore_lite(&guest->vcpu_lock, flags);
+}
+
+/*!
+ * \fn void setup_guest_ioport_intercepts(struct vmm_guest *guest, struct vcpu_hw_context *context)
+ * \brief Program IO permission bitmap of a new VCPU from guest IO regions.
+ *
+ * All IO ports are intercepted except the ones covered by real (pass
+ * through) IO regions. Ports without any IO region are handled by the
+ * intercept path as unassigned ports so that guest can never reach
+ * host IO ports which were not explicitly given to it.
+ *
+ * \param guest The guest owning the VCPU.
+ * \param context The VCPU hardware context with allocated IO bitmap.
+ */
+void setup_guest_ioport_intercepts(struct vmm_guest *guest,
+				   struct vcpu_hw_context *context)
+{
+	u32 port;
+	struct vmm_region *reg;
+
+	if (!context->icept_table.io_table_virt)
+		return;
 
-			vmm_read_unlock_irqrestore_lite(&guest->vcpu_lock, flags);
+	memset((void *)context->icept_table.io_table_virt, 0xff,
+	       GUEST_IOPORT_COUNT / 8);
+
+	for (port = 0; port < GUEST_IOPORT_COUNT; port++) {
+		if (!x86_guest_priv(guest)->ioport_map[port >> GUEST_IOPORT_L2_SHIFT]) {
+			port |= (GUEST_IOPORT_L2_COUNT - 1);
+			continue;
 		}
+		reg = guest_ioport_region(guest, port);
+		if (reg && (reg->flags & VMM_REGION_REAL))
+			disable_ioport_intercept(context, port);
+	}
+}
+
+int arch_guest_add_region(struct vmm_guest *guest, struct vmm_region *region)
+{
+	int rc;
+
+	if (region->flags & VMM_REGION_IO) {
+		rc = guest_ioport_map_update(guest, region, region);
+		if (rc) {
+			guest_ioport_map_update(guest, region, NULL);
+			return rc;
+		}
+
+		/* Only real IO regions are passed through to guest */
+		guest_ioport_intercept_update(guest, region,
+				(region->flags & VMM_REGION_REAL) ? FALSE : TRUE);
 	} else if ((region->flags & VMM_REGION_MEMORY)
 		   && (region->flags & VMM_REGION_REAL)
 		   && (region->flags & VMM_REGION_ISRAM)) {
@@ -92,21 +302,11 @@ int arch_guest_add_region(struct vmm_guest *guest, struct vmm_region *region)
 
 int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 {
-	struct vmm_vcpu *vcpu;
-	u32 i, flags;
-
 	if (region->flags & VMM_REGION_IO) {
-		u32 reg_end = region->gphys_addr + region->phys_size;
-
-		for (i = region->gphys_addr; i < reg_end; i++) {
-			vmm_read_lock_irqsave_lite(&guest->vcpu_lock, flags);
+		guest_ioport_map_update(guest, region, NULL);
 
-			list_for_each_entry(vcpu, &guest->vcpu_list, head) {
-				disable_ioport_intercept(x86_vcpu_priv(vcpu)->hw_context, i);
-			}
-
-			vmm_read_unlock_irqrestore_lite(&guest->vcpu_lock, flags);
-		}
+		/* Ports without IO region are trapped as unassigned */
+		guest_ioport_intercept_update(guest, region, TRUE);
 	} else if (region->flags & (VMM_REGION_REAL | VMM_REGION_MEMORY)) {
 		struct x86_guest_priv *priv = x86_guest_priv(guest);
 
@@ -118,6 +318,41 @@ int arch_guest_del_region(struct vmm_guest *guest, struct vmm_region *region)
 	return VMM_OK;
 }
 
+/*
+ * Dirty logging needs guest physical pages write-protected which is
+ * only possible with nested paging (EPT or NPT). Nested page tables
+ * are per-VCPU hence each of them is updated. Stale writeable TLB
+ * entries are flushed before next VM entry of each VCPU so a VCPU
+ * running on other host CPU can still write without fault until its
+ * next VM exit.
+ */
+int arch_guest_write_protect(struct vmm_guest *guest,
+			     physical_addr_t gphys, physical_size_t size)
+{
+	int rc = VMM_OK;
+	irq_flags_t flags;
+	struct vmm_vcpu *vcpu;
+	struct vcpu_hw_context *context;
+
+	vmm_read_lock_irqsave_lite(&guest->vcpu_lock, flags);
+
+	list_for_each_entry(vcpu, &guest->vcpu_list, head) {
+		context = x86_vcpu_priv(vcpu)->hw_context;
+		if (!context)
+			continue;
+		if (!context->nested_paging) {
+			rc = VMM_ENOTSUPP;
+			break;
+		}
+		write_protect_guest_nested_map(context, gphys, size);
+		cpu_vcpu_asid_flush(context);
+	}
+
+	vmm_read_unlock_irqrestore_lite(&guest->vcpu_lock, flags);
+
+	return rc;
+}
+
 static void guest_cmos_init(struct vmm_guest *guest)
 {
 	int val;
@@ -189,6 +424,50 @@ void arch_set_guest_master_pic(struct vmm_guest *guest, struct i8259_state *pic)
 	x86_guest_priv(guest)->master_pic = pic;
 }
 
+void arch_set_guest_lapic(struct vmm_guest *guest, void *opaque,
+			  apic_msr_read_t msr_read,
+			  apic_msr_write_t msr_write)
+{
+	struct x86_guest_priv *priv = x86_guest_priv(guest);
+	u32 *ecx = &priv->cpuid_std[CPUID_BASE_FEATURES].resp_ecx;
+
+	priv->lapic = opaque;
+	priv->lapic_msr_read = msr_read;
+	priv->lapic_msr_write = msr_write;
+
+	/* x2APIC and TSC-deadline timer are advertised only when
+	 * LAPIC MSRs are emulated */
+	if (msr_read && msr_write) {
+		set_bit(CPUID_FEAT_ECX_x2APIC_BIT, (volatile unsigned long *)ecx);
+		set_bit(CPUID_FEAT_ECX_TSC_DEADLINE_BIT,
+			(volatile unsigned long *)ecx);
+	} else {
+		clear_bit(CPUID_FEAT_ECX_x2APIC_BIT, (volatile unsigned long *)ecx);
+		clear_bit(CPUID_FEAT_ECX_TSC_DEADLINE_BIT,
+			  (volatile unsigned long *)ecx);
+	}
+}
+
+int guest_lapic_msr_read(struct vmm_vcpu *vcpu, u32 msr, u64 *val)
+{
+	struct x86_guest_priv *priv = x86_guest_priv(vcpu->guest);
+
+	if (!priv->lapic_msr_read)
+		return VMM_ENOTAVAIL;
+
+	return priv->lapic_msr_read(priv->lapic, vcpu, msr, val);
+}
+
+int guest_lapic_msr_write(struct vmm_vcpu *vcpu, u32 msr, u64 val)
+{
+	struct x86_guest_priv *priv = x86_guest_priv(vcpu->guest);
+
+	if (!priv->lapic_msr_write)
+		return VMM_ENOTAVAIL;
+
+	return priv->lapic_msr_write(priv->lapic, vcpu, msr, val);
+}
+
 /*---------------------------------*
  * Guest's vCPU's helper funstions *
  *---------------------------------*/
@@ -274,37 +553,491 @@ int gpa_to_hpa(struct vcpu_hw_context *context, physical_addr_t vaddr, physical_
 	return VMM_OK;
 }
 
-int purge_guest_shadow_pagetable(struct vcpu_hw_context *context)
+static inline virtual_addr_t shadow32_page_va(struct vcpu_hw_context *context,
+					      int index)
 {
-	bitmap_zero(context->shadow32_pg_map, NR_32BIT_PGLIST_PAGES);
+	return (virtual_addr_t)context->shadow32_pg_list + (index * PAGE_SIZE);
+}
+
+static inline int shadow32_page_index(struct vcpu_hw_context *context,
+				      physical_addr_t pa)
+{
+	return (pa - context->shadow32_pg_list_pa) >> PAGE_SHIFT;
+}
+
+/* Free all page tables of root and forget guest frames it shadows */
+static void shadow32_root_clear(struct vcpu_hw_context *context,
+				struct shadow32_root *root)
+{
+	int i, index;
+	union page32 *pd;
+
+	pd = (union page32 *)shadow32_page_va(context, root->pgt_index);
+	for (i = 0; i < (PAGE_SIZE / sizeof(union page32)); i++) {
+		if (!pd[i].present)
+			continue;
+		index = shadow32_page_index(context,
+				(physical_addr_t)pd[i].paddr << PAGE_SHIFT);
+		memset((void *)shadow32_page_va(context, index), 0, PAGE_SIZE);
+		bitmap_release_region(context->shadow32_pg_map, index, 0);
+		pd[i]._val = 0;
+	}
+
+	root->nr_frames = 0;
+	root->cacheable = TRUE;
+}
+
+static void shadow32_root_drop(struct vcpu_hw_context *context,
+			       struct shadow32_root *root)
+{
+	shadow32_root_clear(context, root);
+	bitmap_release_region(context->shadow32_pg_map, root->pgt_index, 0);
+	root->valid = FALSE;
+}
+
+static int shadow32_frame_cmp(physical_addr_t a, physical_addr_t b)
+{
+	return (a < b) ? -1 : ((a > b) ? 1 : 0);
+}
+
+/* Collect sorted frames of all cached roots other than current one */
+static void shadow32_rebuild_wp_frames(struct vcpu_hw_context *context)
+{
+	int r, i, j;
+	physical_addr_t f;
+	struct shadow32_root *root;
+
+	context->shadow32_wp_count = 0;
+	for (r = 0; r < NR_SHADOW32_ROOTS; r++) {
+		root = &context->shadow32_roots[r];
+		if (!root->valid || (root == context->shadow32_cur))
+			continue;
+		for (i = 0; i < root->nr_frames; i++) {
+			f = root->frames[i];
+			j = context->shadow32_wp_count;
+			while ((j > 0) && (shadow32_frame_cmp(
+				context->shadow32_wp_frames[j - 1], f) > 0)) {
+				context->shadow32_wp_frames[j] =
+					context->shadow32_wp_frames[j - 1];
+				j--;
+			}
+			context->shadow32_wp_frames[j] = f;
+			context->shadow32_wp_count++;
+		}
+	}
+}
+
+/*!
+ * \fn bool guest_shadow_frame_protected(struct vcpu_hw_context *context, physical_addr_t hframe)
+ * \brief Check if host frame holds a guest page table of cached root.
+ *
+ * \return TRUE if the frame must be mapped read-only in current root.
+ */
+bool guest_shadow_frame_protected(struct vcpu_hw_context *context,
+				  physical_addr_t hframe)
+{
+	int lo = 0, hi = (int)context->shadow32_wp_count - 1, mid, c;
+
+	hframe &= PAGE_MASK;
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		c = shadow32_frame_cmp(context->shadow32_wp_frames[mid], hframe);
+		if (!c)
+			return TRUE;
+		if (c < 0)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+
+	return FALSE;
+}
+
+/* Remove write access to frames of cached roots from current root */
+static void shadow32_root_protect(struct vcpu_hw_context *context,
+				  struct shadow32_root *root)
+{
+	int i, j, index;
+	union page32 *pd, *pt;
+
+	if (!context->shadow32_wp_count)
+		return;
+
+	pd = (union page32 *)shadow32_page_va(context, root->pgt_index);
+	for (i = 0; i < (PAGE_SIZE / sizeof(union page32)); i++) {
+		if (!pd[i].present)
+			continue;
+		index = shadow32_page_index(context,
+				(physical_addr_t)pd[i].paddr << PAGE_SHIFT);
+		pt = (union page32 *)shadow32_page_va(context, index);
+		for (j = 0; j < (PAGE_SIZE / sizeof(union page32)); j++) {
+			if (pt[j].present && pt[j].rw &&
+			    guest_shadow_frame_protected(context,
+				(physical_addr_t)pt[j].paddr << PAGE_SHIFT))
+				pt[j].rw = 0;
+		}
+	}
+}
+
+/*!
+ * \fn bool unprotect_guest_shadow_frame(struct vcpu_hw_context *context, physical_addr_t hframe)
+ * \brief Handle guest write to a write protected guest page table.
+ *
+ * Cached roots shadowing the written page table are stale after
+ * the write, so they are dropped.
+ *
+ * \return TRUE if the frame was write protected because of cached roots.
+ */
+bool unprotect_guest_shadow_frame(struct vcpu_hw_context *context,
+				  physical_addr_t hframe)
+{
+	int r, i;
+	struct shadow32_root *root;
+
+	if (!guest_shadow_frame_protected(context, hframe))
+		return FALSE;
+
+	hframe &= PAGE_MASK;
+	for (r = 0; r < NR_SHADOW32_ROOTS; r++) {
+		root = &context->shadow32_roots[r];
+		if (!root->valid || (root == context->shadow32_cur))
+			continue;
+		for (i = 0; i < root->nr_frames; i++) {
+			if (root->frames[i] == hframe) {
+				shadow32_root_drop(context, root);
+				break;
+			}
+		}
+	}
+
+	shadow32_rebuild_wp_frames(context);
+
+	return TRUE;
+}
+
+/*!
+ * \fn void track_guest_shadow_frame(struct vcpu_hw_context *context, physical_addr_t gframe)
+ * \brief Remember guest page table page shadowed by current root.
+ */
+void track_guest_shadow_frame(struct vcpu_hw_context *context,
+			      physical_addr_t gframe)
+{
+	int i;
+	physical_addr_t hframe;
+	struct vmm_region *reg;
+	struct shadow32_root *root = context->shadow32_cur;
+
+	gframe &= PAGE_MASK;
+	reg = vmm_guest_find_region(context->assoc_vcpu->guest, gframe,
+				    VMM_REGION_MEMORY, FALSE);
+	if (!reg || !(reg->flags & (VMM_REGION_REAL | VMM_REGION_ALIAS)))
+		return;
+
+	hframe = reg->hphys_addr + (gframe - reg->gphys_addr);
+	for (i = 0; i < root->nr_frames; i++) {
+		if (root->frames[i] == hframe)
+			return;
+	}
+
+	if (root->nr_frames < NR_SHADOW32_ROOT_FRAMES)
+		root->frames[root->nr_frames++] = hframe;
+	else
+		root->cacheable = FALSE;
+}
+
+/* Allocate a page from page list, reclaiming least recently used roots */
+static int alloc_shadow32_page(struct vcpu_hw_context *context)
+{
+	int r, boffs;
+	struct shadow32_root *root, *victim;
+
+	for (;;) {
+		boffs = bitmap_find_free_region(context->shadow32_pg_map,
+						NR_32BIT_PGLIST_PAGES, 0);
+		if (boffs >= 0) {
+			memset((void *)shadow32_page_va(context, boffs),
+			       0, PAGE_SIZE);
+			return boffs;
+		}
+
+		victim = NULL;
+		for (r = 0; r < NR_SHADOW32_ROOTS; r++) {
+			root = &context->shadow32_roots[r];
+			if (!root->valid || (root == context->shadow32_cur))
+				continue;
+			if (!victim || (root->last_used < victim->last_used))
+				victim = root;
+		}
+
+		if (!victim) {
+			vmm_printf("%s: No free pages to alloc for shadow "
+				   "table.\n", __func__);
+			return VMM_EFAIL;
+		}
+
+		shadow32_root_drop(context, victim);
+		shadow32_rebuild_wp_frames(context);
+	}
+}
+
+/*!
+ * \fn int setup_guest_shadow_pagetable(struct vcpu_hw_context *context)
+ * \brief Initialize shadow page table cache with an empty current root.
+ */
+int setup_guest_shadow_pagetable(struct vcpu_hw_context *context)
+{
+	int index;
+	struct shadow32_root *root = &context->shadow32_roots[0];
+
+	if (vmm_host_va2pa((virtual_addr_t)context->shadow32_pg_list,
+			   &context->shadow32_pg_list_pa) != VMM_OK)
+		return VMM_EFAIL;
+
 	memset(context->shadow32_pg_list, 0,
-	       NR_32BIT_PGLIST_PAGES * VMM_PAGE_SIZE);
-	context->pgmap_free_cache = 0;
+	       NR_32BIT_PGLIST_PAGES * PAGE_SIZE);
+	bitmap_zero(context->shadow32_pg_map, NR_32BIT_PGLIST_PAGES);
+	memset(context->shadow32_roots, 0, sizeof(context->shadow32_roots));
+	context->shadow32_clock = 0;
+	context->shadow32_wp_count = 0;
+	context->shadow32_cur = root;
+
+	index = alloc_shadow32_page(context);
+	if (index < 0)
+		return VMM_EFAIL;
+
+	root->valid = TRUE;
+	root->cacheable = TRUE;
+	root->pgt_index = index;
+	context->shadow32_pgt =
+		(union page32 *)shadow32_page_va(context, index);
 
 	return VMM_OK;
 }
 
-static inline int free_page_index_in_pglist(struct vcpu_hw_context *context)
+/*!
+ * \fn int purge_guest_shadow_pagetable(struct vcpu_hw_context *context)
+ * \brief Throw away all mappings of current shadow root.
+ *
+ * Current root is rekeyed to the current guest CR3.
+ */
+int purge_guest_shadow_pagetable(struct vcpu_hw_context *context)
 {
-	int boffs;
+	struct shadow32_root *root = context->shadow32_cur;
 
-	if (context->pgmap_free_cache) {
-		boffs = context->pgmap_free_cache;
-		context->pgmap_free_cache = 0;
-		return boffs;
+	shadow32_root_clear(context, root);
+	root->g_cr3 = context->g_cr3;
+	if (context->g_cr3)
+		track_guest_shadow_frame(context, context->g_cr3);
+
+	/* Stale translations are tagged with this VCPU's ASID only */
+	cpu_vcpu_asid_flush(context);
+
+	return VMM_OK;
+}
+
+/*!
+ * \fn int switch_guest_shadow_pagetable(struct vcpu_hw_context *context, u64 g_cr3, physical_addr_t *pgt_pa)
+ * \brief Make shadow root of given guest CR3 current.
+ *
+ * If a root for guest CR3 is cached it is reused as is, otherwise
+ * a free or least recently used root is taken. The root being
+ * switched out stays cached unless it shadows too many guest page
+ * table pages to be write protected.
+ *
+ *\param context The guest VCPU context.
+ *\param g_cr3 New guest CR3.
+ *\param pgt_pa Host physical address of shadow page directory to use.
+ *
+ * \return VMM_OK on success, error code otherwise.
+ */
+int switch_guest_shadow_pagetable(struct vcpu_hw_context *context,
+				  u64 g_cr3, physical_addr_t *pgt_pa)
+{
+	int r, index;
+	bool hit = FALSE;
+	struct shadow32_root *root, *prev = context->shadow32_cur;
+
+	for (r = 0; r < NR_SHADOW32_ROOTS; r++) {
+		root = &context->shadow32_roots[r];
+		if (root->valid && (root != prev) && (root->g_cr3 == g_cr3)) {
+			hit = TRUE;
+			break;
+		}
 	}
 
-	if ((boffs = bitmap_find_free_region(context->shadow32_pg_map,
-					     NR_32BIT_PGLIST_PAGES,
-					     1)) == VMM_ENOMEM) {
-		vmm_printf("%s: No free pages to alloc for shadow table.\n",
-			   __func__);
-		return VMM_EFAIL;
+	if (!hit) {
+		root = NULL;
+		for (r = 0; r < NR_SHADOW32_ROOTS; r++) {
+			if (!context->shadow32_roots[r].valid) {
+				root = &context->shadow32_roots[r];
+				break;
+			}
+		}
+		if (!root && !prev->cacheable) {
+			/* Reuse previous root in place */
+			shadow32_root_clear(context, prev);
+			root = prev;
+		}
+		if (!root) {
+			for (r = 0; r < NR_SHADOW32_ROOTS; r++) {
+				if (&context->shadow32_roots[r] == prev)
+					continue;
+				if (!root || (context->shadow32_roots[r].last_used
+					      < root->last_used))
+					root = &context->shadow32_roots[r];
+			}
+			shadow32_root_drop(context, root);
+		}
+
+		if (root != prev) {
+			index = alloc_shadow32_page(context);
+			if (index < 0)
+				return VMM_EFAIL;
+			root->pgt_index = index;
+		}
+
+		root->valid = TRUE;
+		root->cacheable = TRUE;
+		root->nr_frames = 0;
+	}
+
+	if ((root != prev) && !prev->cacheable)
+		shadow32_root_drop(context, prev);
+
+	root->g_cr3 = g_cr3;
+	root->last_used = ++context->shadow32_clock;
+	context->shadow32_cur = root;
+	context->shadow32_pgt =
+		(union page32 *)shadow32_page_va(context, root->pgt_index);
+	track_guest_shadow_frame(context, g_cr3);
+
+	shadow32_rebuild_wp_frames(context);
+	if (hit)
+		shadow32_root_protect(context, root);
+
+	*pgt_pa = context->shadow32_pg_list_pa + (root->pgt_index * PAGE_SIZE);
+
+	cpu_vcpu_asid_flush(context);
+
+	return VMM_OK;
+}
+
+/*!
+ * \fn void write_protect_guest_nested_map(struct vcpu_hw_context *context, physical_addr_t gphys, physical_size_t size)
+ * \brief Clear write permission of guest pages in nested page table.
+ *
+ * EPT and NPT entries share writeable bit position with regular
+ * page table entries hence both are handled here. Huge pages are
+ * unmapped and mapped again as read-only 4K pages upon next fault.
+ * Caller has to flush nested TLB entries of VCPU.
+ *
+ *\param context The guest VCPU context using nested paging.
+ *\param gphys Guest physical address.
+ *\param size Size of range in bytes.
+ */
+void write_protect_guest_nested_map(struct vcpu_hw_context *context,
+				    physical_addr_t gphys,
+				    physical_size_t size)
+{
+	union page pg;
+	physical_addr_t ia = gphys & PAGE_MASK;
+	physical_addr_t end = gphys + size;
+
+	for (; ia < end; ia += PAGE_SIZE) {
+		if (mmu_get_page(&host_pgtbl_ctl, context->shadow_pgt,
+				 ia, &pg) != VMM_OK)
+			continue;
+		if (!pg.bits.rw)
+			continue;
+
+		mmu_unmap_page(&host_pgtbl_ctl, context->shadow_pgt, ia);
+		if (pg.bits.pat)
+			continue;
+
+		pg.bits.rw = 0;
+		/* Failure means fault path already mapped it again */
+		mmu_map_page(&host_pgtbl_ctl, context->shadow_pgt, ia, &pg);
+	}
+}
+
+/*!
+ * \fn int dirty_guest_nested_map(struct vcpu_hw_context *context, physical_addr_t gphys)
+ * \brief Make write-protected guest page writeable and mark it dirty.
+ *
+ * Guest pages of writeable regions are mapped read-only in nested
+ * page table only for dirty logging, hence write fault on such page
+ * means guest dirtied it.
+ *
+ *\param context The guest VCPU context using nested paging.
+ *\param gphys Faulting guest physical address.
+ *
+ * \return VMM_OK if page was mapped, VMM_ENOENT if it has to be mapped.
+ */
+int dirty_guest_nested_map(struct vcpu_hw_context *context,
+			   physical_addr_t gphys)
+{
+	union page pg;
+	physical_addr_t ia = gphys & PAGE_MASK;
+
+	if (mmu_get_page(&host_pgtbl_ctl, context->shadow_pgt,
+			 ia, &pg) != VMM_OK)
+		return VMM_ENOENT;
+
+	if (!pg.bits.rw) {
+		mmu_unmap_page(&host_pgtbl_ctl, context->shadow_pgt, ia);
+		pg.bits.rw = 1;
+		/* Failure means other path already mapped it again */
+		mmu_map_page(&host_pgtbl_ctl, context->shadow_pgt, ia, &pg);
 	}
 
-	context->pgmap_free_cache = boffs+1;
+	/* Mark only after page is writeable so that a concurrent
+	 * vmm_guest_dirty_log_get() never misses this write.
+	 */
+	vmm_guest_dirty_log_mark(context->assoc_vcpu->guest, gphys);
 
-	return boffs;
+	return VMM_OK;
+}
+
+/*!
+ * \fn int create_guest_nested_map(struct vcpu_hw_context *context, physical_addr_t gphys, physical_addr_t hphys, size_t size, bool writeable)
+ * \brief Map guest physical to host physical in nested page table.
+ *
+ * Nested page table entries are walked by hardware as user
+ * accesses, hence user bit is set for each mapped page.
+ *
+ *\param context The guest VCPU context using nested paging.
+ *\param gphys Page aligned guest physical address.
+ *\param hphys Page aligned host physical address.
+ *\param size Size of mapping in bytes.
+ *\param writeable Whether guest is allowed to write the mapping.
+ *
+ * \return VMM_OK on success, error code otherwise.
+ */
+int create_guest_nested_map(struct vcpu_hw_context *context,
+			    physical_addr_t gphys, physical_addr_t hphys,
+			    size_t size, bool writeable)
+{
+	int rc;
+	union page pg;
+	physical_addr_t off;
+
+	if (!context->nested_paging || !context->shadow_pgt)
+		return VMM_EINVALID;
+
+	for (off = 0; off < size; off += PAGE_SIZE) {
+		pg._val = 0;
+		pg.bits.present = 1;
+		pg.bits.rw = (writeable) ? 1 : 0;
+		pg.bits.priviledge = 1;
+		pg.bits.paddr = ((hphys + off) & PAGE_MASK) >> PAGE_SHIFT;
+
+		rc = mmu_map_page(&host_pgtbl_ctl, context->shadow_pgt,
+				  gphys + off, &pg);
+		if (rc != VMM_OK)
+			return rc;
+	}
+
+	return VMM_OK;
 }
 
 int create_guest_shadow_map(struct vcpu_hw_context *context,
@@ -314,27 +1047,18 @@ int create_guest_shadow_map(struct vcpu_hw_context *context,
 	union page32 pde, pte;
 	union page32 *pde_addr, *temp;
 	physical_addr_t tpaddr, pte_addr;
-	virtual_addr_t tvaddr;
 	int index;
 
 	pde_addr = &context->shadow32_pgt[((vaddr >> 22) & 0x3ff)];
 	pde = *pde_addr;
 
 	if (!pde.present) {
-		index = free_page_index_in_pglist(context);
+		index = alloc_shadow32_page(context);
 
-		if (index == VMM_EFAIL)
+		if (index < 0)
 			return VMM_EFAIL;
 
-		tvaddr = (virtual_addr_t)
-			(((virtual_addr_t)context->shadow32_pg_list)
-			 + (index * PAGE_SIZE));
-
-		memset((void *)tvaddr, 0, PAGE_SIZE);
-
-		if (vmm_host_va2pa(tvaddr, &tpaddr) != VMM_OK)
-			vmm_panic("%s: Failed to map vaddr to paddr for pde.\n",
-				  __func__);
+		tpaddr = context->shadow32_pg_list_pa + (index * PAGE_SIZE);
 
 		pde_addr->paddr = (tpaddr >> PAGE_SHIFT);
 		SetPageProt(pde_addr, pdprot);
@@ -0,0 +1,58 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cpu_crc32c.c
+ * @author agent (agent@local)
+ * @brief x86_64 specific CRC32C using SSE4.2 instruction
+ *
+ * The SSE4.2 crc32 instruction works on general purpose registers
+ * hence no XMM state is touched here.
+ */
+
+#include <vmm_types.h>
+#include <cpu_features.h>
+#include <libs/hash.h>
+
+struct crc32c_una64 {
+	u64 v;
+} __packed;
+
+size_t arch_crc32c(u32 *crc, const u8 *data, size_t len)
+{
+	size_t done;
+	u64 c = *crc;
+
+	if (!cpu_info.crc32c) {
+		return 0;
+	}
+
+	for (done = 0; (done + 8) <= len; done += 8) {
+		asm volatile("crc32q %1, %0\n\t"
+			     : "+r"(c)
+			     : "rm"(((const struct crc32c_una64 *)&data[done])->v));
+	}
+	for ( ; done < len; done++) {
+		asm volatile("crc32b %1, %0\n\t"
+			     : "+r"(c)
+			     : "rm"(data[done]));
+	}
+
+	*crc = (u32)c;
+
+	return done;
+}
@@ -26,17 +26,24 @@
 #include <vmm_types.h>
 #include <vmm_stdio.h>
 #include <vmm_host_aspace.h>
+#include <arch_config.h>
 #include <arch_sections.h>
 #include <arch_cpu.h>
 #include <libs/stringlib.h>
 #include <cpu_mmu.h>
 #include <cpu_pgtbl_helper.h>
+#include <processor_flags.h>
+#include <control_reg_access.h>
 
 #define HOST_PGTBL_MAX_TABLE_COUNT		(CONFIG_VAPOOL_SIZE_MB << \
 						 (20 - 3 - PGTBL_TABLE_SIZE_SHIFT))
 #define HOST_PGTBL_MAX_TABLE_SIZE		(HOST_PGTBL_MAX_TABLE_COUNT * \
 						 PGTBL_TABLE_SIZE)
 
+/* Host huge pages are 2MB pages mapped by page directory entries */
+#define HOST_HUGEPAGE_LEVEL			(PGTBL_LAST_LEVEL - 1)
+#define HOST_HUGEPAGE_SIZE			(1ULL << ARCH_HOST_HUGEPAGE_SHIFT)
+
 unsigned long __force_order;
 
 struct pgtbl_ctrl host_pgtbl_ctl;
@@ -153,24 +160,61 @@ int __delete_bootstrap_pgtbl_entry(u64 va)
 	return VMM_OK;
 }
 
-/* mmu inline asm routines */
-int arch_cpu_aspace_map(virtual_addr_t page_va,
-			physical_addr_t page_pa,
-			u32 mem_flags)
+/*
+ * Mark bootstrap mappings of hypervisor code as global so that
+ * they are retained in TLB across address space switches.
+ */
+static void arch_code_set_global(void)
 {
-	union page pg;
+	int lvl;
+	u64 *tbl, *ent;
+	u64 va = arch_code_vaddr_start();
+	u64 end = va + arch_code_size();
+	u64 shift[] = { PML4_SHIFT, PGDP_SHIFT, PGDI_SHIFT, PGTI_SHIFT };
+
+	for (; va < end; va += PAGE_SIZE) {
+		tbl = __pml4;
+		for (lvl = 0; lvl <= PGTBL_LAST_LEVEL; lvl++) {
+			ent = &tbl[(va >> shift[lvl]) & 0x1ff];
+			if (!(*ent & 0x1))
+				break;
+			if ((lvl == PGTBL_LAST_LEVEL) ||
+			    mmu_level_is_huge((union page *)ent, lvl)) {
+				((union page *)ent)->bits.global = 1;
+				break;
+			}
+			tbl = (u64 *)(*ent & PAGE_MASK);
+		}
+	}
+}
 
+static void arch_host_page(union page *pg, physical_addr_t page_pa,
+			   u32 mem_flags)
+{
 	/* FIXME: more specific page attributes */
-	pg._val = 0x0;
-	pg.bits.paddr = (page_pa >> PAGE_SHIFT);
-	pg.bits.present = 1;
-	pg.bits.rw = 1;
+	pg->_val = 0x0;
+	pg->bits.paddr = (page_pa >> PAGE_SHIFT);
+	pg->bits.present = 1;
+	pg->bits.rw = 1;
+
+	/* Hypervisor has single address space shared by all CPUs */
+	pg->bits.global = 1;
 
 	if (!(mem_flags & VMM_MEMORY_CACHEABLE))
-		pg.bits.cache_disable = 1;
+		pg->bits.cache_disable = 1;
 
 	if (!(mem_flags & VMM_MEMORY_WRITEABLE))
-		pg.bits.rw = 0;
+		pg->bits.rw = 0;
+}
+
+/* mmu inline asm routines */
+int arch_cpu_aspace_map(virtual_addr_t page_va,
+			physical_addr_t page_pa,
+			u32 mem_flags)
+{
+	union page pg;
+
+	arch_host_page(&pg, page_pa, mem_flags);
 
 	return mmu_map_page(&host_pgtbl_ctl, host_pgtbl_ctl.base_pgtbl, page_va, &pg);
 }
@@ -180,6 +224,37 @@ int arch_cpu_aspace_unmap(virtual_addr_t page_va)
 	return mmu_unmap_page(&host_pgtbl_ctl, host_pgtbl_ctl.base_pgtbl, page_va);
 }
 
+int arch_cpu_aspace_hugepage_map(virtual_addr_t page_va,
+				 physical_addr_t page_pa,
+				 u32 mem_flags)
+{
+	union page pg;
+
+	arch_host_page(&pg, page_pa, mem_flags);
+
+	return mmu_map_hugepage(&host_pgtbl_ctl, host_pgtbl_ctl.base_pgtbl,
+				page_va, &pg, HOST_HUGEPAGE_LEVEL);
+}
+
+int arch_cpu_aspace_hugepage_unmap(virtual_addr_t page_va)
+{
+	int rc;
+	union page pg;
+
+	/* Host 4KB mappings never set PAT bit which is PS bit in PDE */
+	rc = mmu_get_page(&host_pgtbl_ctl, host_pgtbl_ctl.base_pgtbl,
+			  page_va, &pg);
+	if (rc) {
+		return rc;
+	}
+	if (!pg.bits.pat) {
+		return VMM_ENOTAVAIL;
+	}
+
+	return mmu_unmap_page(&host_pgtbl_ctl, host_pgtbl_ctl.base_pgtbl,
+			      page_va);
+}
+
 int arch_cpu_aspace_va2pa(virtual_addr_t va, physical_addr_t *pa)
 {
 	int rc;
@@ -192,7 +267,11 @@ int arch_cpu_aspace_va2pa(virtual_addr_t va, physical_addr_t *pa)
 	}
 
 	fpa = (pg.bits.paddr << PAGE_SHIFT);
-	fpa |= va & ~PAGE_MASK;
+	if (pg.bits.pat) {
+		fpa |= va & (HOST_HUGEPAGE_SIZE - 1);
+	} else {
+		fpa |= va & ~PAGE_MASK;
+	}
 
 	*pa = fpa;
 
@@ -382,11 +461,20 @@ int __init arch_cpu_aspace_primary_init(physical_addr_t *core_resv_pa,
 	va = resv_va;
 	sz = resv_sz;
 	while (sz) {
-		/* FIXME: more specific page attributes */
-		hyppg._val = 0x0;
-		hyppg.bits.paddr = (pa >> PAGE_SHIFT);
-		hyppg.bits.present = 1;
-		hyppg.bits.rw = 1;		
+		arch_host_page(&hyppg, pa, VMM_MEMORY_FLAGS_NORMAL);
+
+		/* Blocks already covered by bootstrap tables stay 4KB */
+		if (!(va & (HOST_HUGEPAGE_SIZE - 1)) &&
+		    !(pa & (HOST_HUGEPAGE_SIZE - 1)) &&
+		    (HOST_HUGEPAGE_SIZE <= sz) &&
+		    !mmu_map_hugepage(&host_pgtbl_ctl, host_pgtbl_ctl.base_pgtbl,
+				      va, &hyppg, HOST_HUGEPAGE_LEVEL)) {
+			sz -= HOST_HUGEPAGE_SIZE;
+			pa += HOST_HUGEPAGE_SIZE;
+			va += HOST_HUGEPAGE_SIZE;
+			continue;
+		}
+
 		if ((rc = mmu_map_page(&host_pgtbl_ctl, host_pgtbl_ctl.base_pgtbl, va, &hyppg))) {
 			goto mmu_init_error;
 		}
@@ -395,6 +483,10 @@ int __init arch_cpu_aspace_primary_init(physical_addr_t *core_resv_pa,
 		va += PAGE_SIZE;
 	}
 
+	/* Keep hypervisor mappings in TLB across CR3 reloads */
+	arch_code_set_global();
+	set_in_cr4(X86_CR4_PGE);
+
 	/* Clear memory of free translation tables. This cannot be done before
 	 * we map reserved space (core reserved + arch reserved).
 	 */
@@ -410,7 +502,8 @@ mmu_init_error:
 
 int __cpuinit arch_cpu_aspace_secondary_init(void)
 {
-	/* FIXME: For now nothing to do here. */
+	set_in_cr4(X86_CR4_PGE);
+
 	return VMM_OK;
 }
 
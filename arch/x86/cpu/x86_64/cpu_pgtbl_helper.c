@@ -39,6 +39,17 @@ static struct page_table *mmu_pgtbl_find(struct pgtbl_ctrl *ctrl, physical_addr_
 
 	tbl_pa &= ~(PGTBL_TABLE_SIZE - 1);
 
+	/* Check page table pool first because bootstrap
+	 * pgti spans multiple pages.
+	 */
+	if ((ctrl->pgtbl_base_pa <= tbl_pa) &&
+	    (tbl_pa < (ctrl->pgtbl_base_pa + ctrl->pgtbl_max_size))) {
+		index = (tbl_pa - ctrl->pgtbl_base_pa) >> PGTBL_TABLE_SIZE_SHIFT;
+		if (index < ctrl->pgtbl_max_count) {
+			return &ctrl->pgtbl_array[index];
+		}
+	}
+
 	if (tbl_pa == ctrl->pgtbl_pml4.tbl_pa) {
 		return &ctrl->pgtbl_pml4;
 	} else if (tbl_pa == ctrl->pgtbl_pgdp.tbl_pa) {
@@ -49,16 +60,27 @@ static struct page_table *mmu_pgtbl_find(struct pgtbl_ctrl *ctrl, physical_addr_
 		return &ctrl->pgtbl_pgti;
 	}
 
-	if ((ctrl->pgtbl_base_pa <= tbl_pa) &&
-	    (tbl_pa <= (ctrl->pgtbl_base_pa + ctrl->pgtbl_max_size))) {
-		tbl_pa = tbl_pa - ctrl->pgtbl_base_pa;
-		index = tbl_pa >> PGTBL_TABLE_SIZE_SHIFT;
-		if (index < ctrl->pgtbl_max_count) {
-			return &ctrl->pgtbl_array[index];
-		}
+	return NULL;
+}
+
+/* Get virtual address of last level table entries for given
+ * input address. The bootstrap pgti is a set of contiguous
+ * tables covering all entries of bootstrap pgdi whereas all
+ * other last level tables are single page.
+ */
+static virtual_addr_t mmu_pgtbl_last_level_va(struct pgtbl_ctrl *ctrl,
+					      struct page_table *pgtbl,
+					      physical_addr_t ia)
+{
+	int pre_index;
+
+	if (pgtbl != &ctrl->pgtbl_pgti) {
+		return pgtbl->tbl_va;
 	}
 
-	return NULL;
+	pre_index = mmu_level_index(ia, (pgtbl->level - 1));
+
+	return pgtbl->tbl_va + (pre_index * PAGE_SIZE);
 }
 
 static inline bool mmu_pgtbl_isattached(struct page_table *child)
@@ -98,6 +120,10 @@ static int mmu_pgtbl_attach(struct page_table *parent,
 	pg->bits.paddr = (child->tbl_pa & PAGE_MASK) >> PAGE_SHIFT;
 	pg->bits.present = 1;
 	pg->bits.rw = 1;
+	/* Nested page walks are always treated as user access */
+	if (child->stage == PGTBL_STAGE_2) {
+		pg->bits.priviledge = 1;
+	}
 
 	/* FIXME: flush cache */
 
@@ -247,6 +273,9 @@ struct page_table *mmu_pgtbl_get_child(struct pgtbl_ctrl *ctrl,
 	vmm_spin_unlock_irqrestore(&parent->tbl_lock, flags);
 
 	if (pgt.bits.present) {
+		if (mmu_level_is_huge(&pgt, parent->level)) {
+			return NULL;
+		}
 		tbl_pa = pgt._val & PAGE_MASK;
 		child = mmu_pgtbl_find(ctrl, tbl_pa);
 		if (child->parent == parent) {
@@ -266,6 +295,7 @@ struct page_table *mmu_pgtbl_get_child(struct pgtbl_ctrl *ctrl,
 
 	if ((rc = mmu_pgtbl_attach(parent, map_ia, child))) {
 		mmu_pgtbl_free(ctrl, child);
+		return NULL;
 	}
 
 	return child;
@@ -273,7 +303,7 @@ struct page_table *mmu_pgtbl_get_child(struct pgtbl_ctrl *ctrl,
 
 int mmu_get_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_addr_t ia, union page *pg)
 {
-	int index, pre_index;
+	int index;
 	irq_flags_t flags;
 	union page *pgt;
 	struct page_table *child;
@@ -284,10 +314,9 @@ int mmu_get_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_add
 	}
 
 	index = mmu_level_index(ia, pgtbl->level);
-	if (pgtbl->level == PGTBL_LAST_LEVEL) {
-		pre_index = mmu_level_index(ia, (pgtbl->level - 1));
-		pgt_va = pgtbl->tbl_va + (pre_index * PAGE_SIZE);
-	} else
+	if (pgtbl->level == PGTBL_LAST_LEVEL)
+		pgt_va = mmu_pgtbl_last_level_va(ctrl, pgtbl, ia);
+	else
 		pgt_va = pgtbl->tbl_va;
 
 	pgt = &((union page *)pgt_va)[index];
@@ -299,7 +328,8 @@ int mmu_get_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_add
 		return VMM_EFAIL;
 	}
 
-	if (pgtbl->level < PGTBL_LAST_LEVEL) {
+	if (pgtbl->level < PGTBL_LAST_LEVEL &&
+	    !mmu_level_is_huge(pgt, pgtbl->level)) {
 		vmm_spin_unlock_irqrestore(&pgtbl->tbl_lock, flags);
 		child = mmu_pgtbl_get_child(ctrl, pgtbl, ia, FALSE);
 		if (!child) {
@@ -317,7 +347,7 @@ int mmu_get_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_add
 
 int mmu_unmap_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_addr_t ia)
 {
-	int index, rc, pre_index;
+	int index, rc;
 	bool free_pgtbl;
 	union page *pgt;
 	irq_flags_t flags;
@@ -329,6 +359,27 @@ int mmu_unmap_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_a
 	}
 
 	if (pgtbl->level < PGTBL_LAST_LEVEL) {
+		index = mmu_level_index(ia, pgtbl->level);
+		pgt = &((union page *)pgtbl->tbl_va)[index];
+
+		vmm_spin_lock_irqsave(&pgtbl->tbl_lock, flags);
+		if (pgt->bits.present &&
+		    mmu_level_is_huge(pgt, pgtbl->level)) {
+			pgt->_val = 0x0;
+			if (pgtbl->stage == PGTBL_STAGE_1) {
+				invalidate_vaddr_tlb(ia);
+			}
+			pgtbl->pte_cnt--;
+			free_pgtbl = ((pgtbl->pte_cnt == 0) &&
+				      (pgtbl->level > PGTBL_FIRST_LEVEL));
+			vmm_spin_unlock_irqrestore(&pgtbl->tbl_lock, flags);
+			if (free_pgtbl) {
+				mmu_pgtbl_free(ctrl, pgtbl);
+			}
+			return VMM_OK;
+		}
+		vmm_spin_unlock_irqrestore(&pgtbl->tbl_lock, flags);
+
 		child = mmu_pgtbl_get_child(ctrl, pgtbl, ia, FALSE);
 		if (!child) {
 			return VMM_EFAIL;
@@ -342,8 +393,7 @@ int mmu_unmap_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_a
 	}
 
 	index = mmu_level_index(ia, pgtbl->level);
-	pre_index = mmu_level_index(ia, (pgtbl->level - 1));
-	pgt_va = pgtbl->tbl_va + (pre_index * PAGE_SIZE);
+	pgt_va = mmu_pgtbl_last_level_va(ctrl, pgtbl, ia);
 	pgt = &((union page *)pgt_va)[index];
 
 	vmm_spin_lock_irqsave(&pgtbl->tbl_lock, flags);
@@ -355,7 +405,10 @@ int mmu_unmap_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_a
 
 	pgt->_val = 0x0;
 
-	invalidate_vaddr_tlb(ia);
+	/* Nested TLB entries are flushed by the owner of table */
+	if (pgtbl->stage == PGTBL_STAGE_1) {
+		invalidate_vaddr_tlb(ia);
+	}
 
 	pgtbl->pte_cnt--;
 	free_pgtbl = FALSE;
@@ -374,7 +427,7 @@ int mmu_unmap_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_a
 
 int mmu_map_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_addr_t ia, union page *pg)
 {
-	int index, pre_index;
+	int index;
 	union page *pgt;
 	irq_flags_t flags;
 	struct page_table *child;
@@ -394,8 +447,7 @@ int mmu_map_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_add
 	}
 
 	index = mmu_level_index(ia, pgtbl->level);
-	pre_index = mmu_level_index(ia, (pgtbl->level - 1));
-	pgt_va = pgtbl->tbl_va + (pre_index * PAGE_SIZE);
+	pgt_va = mmu_pgtbl_last_level_va(ctrl, pgtbl, ia);
 	pgt = &((union page *)pgt_va)[index];
 
 	vmm_spin_lock_irqsave(&pgtbl->tbl_lock, flags);
@@ -416,3 +468,56 @@ int mmu_map_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_add
 
 	return VMM_OK;
 }
+
+int mmu_map_hugepage(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl,
+		     physical_addr_t ia, union page *pg, int level)
+{
+	int index;
+	union page *pgt;
+	irq_flags_t flags;
+	struct page_table *child;
+
+	if (!pgtbl || !pg) {
+		return VMM_EFAIL;
+	}
+
+	/* Only 1GB and 2MB leaf pages are possible */
+	if ((level <= PGTBL_FIRST_LEVEL) || (level >= PGTBL_LAST_LEVEL) ||
+	    (pgtbl->level > level)) {
+		return VMM_EINVALID;
+	}
+
+	if (ia & ~mmu_level_map_mask(level)) {
+		return VMM_EINVALID;
+	}
+
+	if (pgtbl->level < level) {
+		child = mmu_pgtbl_get_child(ctrl, pgtbl, ia, TRUE);
+		if (!child) {
+			return VMM_EFAIL;
+		}
+
+		return mmu_map_hugepage(ctrl, child, ia, pg, level);
+	}
+
+	index = mmu_level_index(ia, pgtbl->level);
+	pgt = &((union page *)pgtbl->tbl_va)[index];
+
+	vmm_spin_lock_irqsave(&pgtbl->tbl_lock, flags);
+
+	if (pgt->bits.present) {
+		vmm_spin_unlock_irqrestore(&pgtbl->tbl_lock, flags);
+		return VMM_EFAIL;
+	}
+
+	pgt->_val = pg->_val;
+	pgt->bits.pat = 1;
+
+	/* FIXME: flush cache */
+
+	pgtbl->pte_cnt++;
+
+	vmm_spin_unlock_irqrestore(&pgtbl->tbl_lock, flags);
+
+	return VMM_OK;
+}
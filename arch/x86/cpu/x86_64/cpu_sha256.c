@@ -0,0 +1,64 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cpu_sha256.c
+ * @author agent (agent@local)
+ * @brief x86_64 specific SHA-256 block hashing
+ *
+ * SHA-256 blocks are hashed using SHA extensions when host CPU
+ * implements them and SSE is usable in hypervisor (CR4.OSFXSR set
+ * and CR0.TS clear). Guest XMM registers stay live in hardware
+ * across guest exits so interrupts are disabled while hashing and
+ * the low-level routine saves/restores the registers it uses.
+ */
+
+#include <vmm_types.h>
+#include <arch_cpu_irq.h>
+#include <cpu_features.h>
+#include <control_reg_access.h>
+#include <processor_flags.h>
+#include <libs/sha256.h>
+
+/* Upper bound on blocks hashed with interrupts disabled */
+#define SHA256_NI_BATCH_BLOCKS		64
+
+extern void __sha256_ni_transform(u32 *state, const u8 *data, u32 nblocks);
+
+u32 arch_sha256_blocks(u32 *state, const u8 *data, u32 nblocks)
+{
+	u32 done, batch;
+	irq_flags_t flags;
+
+	if (!cpu_info.sha_ni ||
+	    !(read_cr4() & X86_CR4_OSFXSR) || (read_cr0() & X86_CR0_TS)) {
+		return 0;
+	}
+
+	for (done = 0; done < nblocks; done += batch) {
+		batch = nblocks - done;
+		if (SHA256_NI_BATCH_BLOCKS < batch) {
+			batch = SHA256_NI_BATCH_BLOCKS;
+		}
+
+		arch_cpu_irq_save(flags);
+		__sha256_ni_transform(state, data + done * 64, batch);
+		arch_cpu_irq_restore(flags);
+	}
+
+	return done;
+}
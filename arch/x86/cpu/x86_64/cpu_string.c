@@ -22,20 +22,166 @@
  */
 
 #include <vmm_types.h>
+#include <vmm_host_aspace.h>
+#include <cpu_features.h>
+
+/* Below this size overlapping moves beat start-up cost of rep string ops */
+#define STRING_SMALL_SIZE	32
+
+typedef u64 __attribute__((__may_alias__)) string_u64;
+typedef u32 __attribute__((__may_alias__)) string_u32;
+
+#define LD64(p)			(*(const string_u64 *)(p))
+#define ST64(p, v)		(*(string_u64 *)(p) = (v))
+
+/*
+ * Whole pages are typically guest pages being copied or zeroed which
+ * are not read back soon hence write them with non-temporal stores
+ * instead of evicting useful cache lines.
+ */
+static inline bool string_nt_ok(void *dest, size_t count)
+{
+	return (VMM_PAGE_SIZE <= count) &&
+	       !((unsigned long)dest & (VMM_PAGE_SIZE - 1)) &&
+	       !(count & (VMM_PAGE_SIZE - 1));
+}
+
+/* Copy upto STRING_SMALL_SIZE bytes using (overlapping) moves */
+static inline void string_copy_small(u8 *d, const u8 *s, size_t count)
+{
+	u64 a, b, c, e;
+
+	if (16 < count) {
+		a = LD64(s);
+		b = LD64(s + 8);
+		c = LD64(s + count - 16);
+		e = LD64(s + count - 8);
+		ST64(d, a);
+		ST64(d + 8, b);
+		ST64(d + count - 16, c);
+		ST64(d + count - 8, e);
+	} else if (8 <= count) {
+		a = LD64(s);
+		b = LD64(s + count - 8);
+		ST64(d, a);
+		ST64(d + count - 8, b);
+	} else if (4 <= count) {
+		a = *(const string_u32 *)s;
+		b = *(const string_u32 *)(s + count - 4);
+		*(string_u32 *)d = a;
+		*(string_u32 *)(d + count - 4) = b;
+	} else if (count) {
+		a = s[0];
+		b = s[count >> 1];
+		c = s[count - 1];
+		d[0] = a;
+		d[count >> 1] = b;
+		d[count - 1] = c;
+	}
+}
+
+/* Fill upto STRING_SMALL_SIZE bytes using (overlapping) stores */
+static inline void string_set_small(u8 *d, u64 v, size_t count)
+{
+	if (16 < count) {
+		ST64(d, v);
+		ST64(d + 8, v);
+		ST64(d + count - 16, v);
+		ST64(d + count - 8, v);
+	} else if (8 <= count) {
+		ST64(d, v);
+		ST64(d + count - 8, v);
+	} else if (4 <= count) {
+		*(string_u32 *)d = (u32)v;
+		*(string_u32 *)(d + count - 4) = (u32)v;
+	} else if (count) {
+		d[0] = (u8)v;
+		d[count >> 1] = (u8)v;
+		d[count - 1] = (u8)v;
+	}
+}
 
 void *memcpy(void *dest, const void *src, size_t count)
 {
-	int d0, d1, d2;
-
-	asm volatile("rep ; movsl\n\t"
-		     "movl %4, %%ecx\n\t"
-		     "andl $3, %%ecx\n\t"
-		     "jz 1f\n\t"
-		     "rep ; movsb\n\t"
-		     "1:"
-		     :"=&c"(d0), "=&D"(d1), "=&S"(d2)
-		     :""(count/4), "g"(count), "1"((long)dest), "2"((long)src)
-		     :"memory");
+	long d0, d1, d2;
+
+	if (count <= STRING_SMALL_SIZE) {
+		string_copy_small(dest, src, count);
+	} else if (string_nt_ok(dest, count)) {
+		asm volatile("1:\n\t"
+			     "movq (%1), %%r8\n\t"
+			     "movq 8(%1), %%r9\n\t"
+			     "movq 16(%1), %%r10\n\t"
+			     "movq 24(%1), %%r11\n\t"
+			     "movnti %%r8, (%0)\n\t"
+			     "movnti %%r9, 8(%0)\n\t"
+			     "movnti %%r10, 16(%0)\n\t"
+			     "movnti %%r11, 24(%0)\n\t"
+			     "addq $32, %0\n\t"
+			     "addq $32, %1\n\t"
+			     "subq $32, %2\n\t"
+			     "jnz 1b\n\t"
+			     "sfence"
+			     :"=&r"(d0), "=&r"(d1), "=&r"(d2)
+			     :"0"(dest), "1"(src), "2"(count)
+			     :"r8", "r9", "r10", "r11", "memory");
+	} else if (cpu_info.erms) {
+		/* Enhanced REP MOVSB is fastest for any medium/large size */
+		asm volatile("rep ; movsb"
+			     :"=&c"(d0), "=&D"(d1), "=&S"(d2)
+			     :"0"(count), "1"(dest), "2"(src)
+			     :"memory");
+	} else {
+		asm volatile("rep ; movsq\n\t"
+			     "movq %4, %%rcx\n\t"
+			     "andq $7, %%rcx\n\t"
+			     "jz 1f\n\t"
+			     "rep ; movsb\n\t"
+			     "1:"
+			     :"=&c"(d0), "=&D"(d1), "=&S"(d2)
+			     :"0"(count >> 3), "g"(count), "1"(dest), "2"(src)
+			     :"memory");
+	}
+
+	return dest;
+}
+
+void *memset(void *dest, int c, size_t count)
+{
+	long d0, d1;
+	u64 v = (u8)c * 0x0101010101010101ULL;
+
+	if (count <= STRING_SMALL_SIZE) {
+		string_set_small(dest, v, count);
+	} else if (string_nt_ok(dest, count)) {
+		asm volatile("1:\n\t"
+			     "movnti %2, (%0)\n\t"
+			     "movnti %2, 8(%0)\n\t"
+			     "movnti %2, 16(%0)\n\t"
+			     "movnti %2, 24(%0)\n\t"
+			     "addq $32, %0\n\t"
+			     "subq $32, %1\n\t"
+			     "jnz 1b\n\t"
+			     "sfence"
+			     :"=&r"(d0), "=&r"(d1)
+			     :"r"(v), "0"(dest), "1"(count)
+			     :"memory");
+	} else if (cpu_info.erms) {
+		asm volatile("rep ; stosb"
+			     :"=&c"(d0), "=&D"(d1)
+			     :"0"(count), "1"(dest), "a"(v)
+			     :"memory");
+	} else {
+		asm volatile("rep ; stosq\n\t"
+			     "movq %3, %%rcx\n\t"
+			     "andq $7, %%rcx\n\t"
+			     "jz 1f\n\t"
+			     "rep ; stosb\n\t"
+			     "1:"
+			     :"=&c"(d0), "=&D"(d1)
+			     :"0"(count >> 3), "g"(count), "1"(dest), "a"(v)
+			     :"memory");
+	}
 
 	return dest;
 }
@@ -0,0 +1,326 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cpu_vcpu_clock.c
+ * @author agent (agent@local)
+ * @brief Guest TSC and KVM compatible paravirtual clock.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_wallclock.h>
+#include <vmm_manager.h>
+#include <vmm_guest_aspace.h>
+#include <vmm_macros.h>
+#include <arch_barrier.h>
+#include <cpu_features.h>
+#include <cpu_vm.h>
+#include <arch_guest_helper.h>
+
+/* Time spent busy waiting for calibrating TSC against host timer */
+#define TSC_CALIBRATE_NSECS	10000000ULL
+
+#define PVCLOCK_SYSTEM_TIME_ENABLE	0x1ULL
+#define PVCLOCK_STEAL_TIME_ENABLE	0x1ULL
+#define PVCLOCK_STEAL_TIME_ALIGN	64
+
+/* Layout of paravirtual clock structures shared with guest */
+struct pvclock_vcpu_time_info {
+	u32 version;
+	u32 pad0;
+	u64 tsc_timestamp;
+	u64 system_time;
+	u32 tsc_to_system_mul;
+	s8 tsc_shift;
+	u8 flags;
+	u8 pad[2];
+} __packed;
+
+struct pvclock_wall_clock {
+	u32 version;
+	u32 sec;
+	u32 nsec;
+} __packed;
+
+struct pvclock_steal_time {
+	u64 steal;
+	u32 version;
+	u32 flags;
+	u8 preempted;
+	u8 pad0[3];
+	u32 pad[11];
+} __packed;
+
+static u64 tsc_khz;
+static u32 tsc_to_system_mul;
+static s8 tsc_shift;
+
+/*
+ * Compute multiplier and shift such that guest computes nanoseconds
+ * from TSC ticks as ((ticks << shift) * mul) >> 32, where negative
+ * shift means right shift.
+ */
+static void cpu_tsc_scale_init(u64 tsc_hz)
+{
+	u64 scaled = 1000000000ULL, tps = tsc_hz;
+	s8 shift = 0;
+	u32 tps32;
+
+	while ((tps > (scaled * 2)) || (tps & 0xFFFFFFFF00000000ULL)) {
+		tps >>= 1;
+		shift--;
+	}
+
+	tps32 = (u32)tps;
+	while ((tps32 <= scaled) || (scaled & 0xFFFFFFFF00000000ULL)) {
+		if ((scaled & 0xFFFFFFFF00000000ULL) || (tps32 & 0x80000000))
+			scaled >>= 1;
+		else
+			tps32 <<= 1;
+		shift++;
+	}
+
+	tsc_to_system_mul = (u32)((scaled << 32) / tps32);
+	tsc_shift = shift;
+}
+
+/*!
+ * \fn void cpu_tsc_calibrate(void)
+ * \brief Measure host TSC frequency against host timer.
+ *
+ * Calibration is done only once and it busy waits for few
+ * milliseconds hence it should be called from thread context.
+ */
+void cpu_tsc_calibrate(void)
+{
+	u64 tstamp, tsc;
+
+	if (tsc_khz)
+		return;
+
+	tstamp = vmm_timer_timestamp();
+	tsc = cpu_rdtsc();
+	while ((vmm_timer_timestamp() - tstamp) < TSC_CALIBRATE_NSECS)
+		;
+	tsc = cpu_rdtsc() - tsc;
+	tstamp = vmm_timer_timestamp() - tstamp;
+
+	tsc_khz = tsc * 1000000ULL / tstamp;
+	cpu_tsc_scale_init(tsc * 1000000000ULL / tstamp);
+
+	VM_LOG(LVL_INFO, "Host TSC running at %"PRIu64" kHz\n", tsc_khz);
+}
+
+u64 cpu_vcpu_guest_tsc(struct vcpu_hw_context *context)
+{
+	extern struct cpuinfo_x86 cpu_info;
+
+	/* TSC offsetting is only used by SVM guests */
+	if (cpu_info.vendor == x86_VENDOR_AMD)
+		return cpu_rdtsc() + context->vmcb->tsc_offset;
+
+	return cpu_rdtsc();
+}
+
+u64 arch_guest_tsc_read(struct vmm_vcpu *vcpu)
+{
+	return cpu_vcpu_guest_tsc(x86_vcpu_hw_context(vcpu));
+}
+
+u64 arch_guest_tsc_to_ns(u64 tsc)
+{
+	if (!tsc_khz)
+		return 0;
+
+	/* Split to avoid overflow for large TSC deltas */
+	return (tsc / tsc_khz) * 1000000ULL +
+		((tsc % tsc_khz) * 1000000ULL) / tsc_khz;
+}
+
+/*
+ * Publish time this VCPU spent ready but not running (steal time) to
+ * guest. As with pvclock time info, version is odd while update is
+ * in progress.
+ */
+static void cpu_vcpu_steal_time_update(struct vcpu_hw_context *context)
+{
+	struct vmm_vcpu *vcpu = context->assoc_vcpu;
+	physical_addr_t gpa;
+	u32 version;
+	u64 steal;
+
+	if (!(context->steal_msr & PVCLOCK_STEAL_TIME_ENABLE))
+		return;
+
+	gpa = context->steal_msr & ~((u64)PVCLOCK_STEAL_TIME_ALIGN - 1);
+	steal = vmm_manager_vcpu_steal_nsecs(vcpu);
+
+	version = ++context->steal_version;
+	if (vmm_guest_memory_write(vcpu->guest,
+			gpa + offsetof(struct pvclock_steal_time, version),
+			&version, sizeof(version), TRUE) != sizeof(version))
+		goto fail;
+	arch_wmb();
+
+	vmm_guest_memory_write(vcpu->guest,
+			gpa + offsetof(struct pvclock_steal_time, steal),
+			&steal, sizeof(steal), TRUE);
+	arch_wmb();
+
+	version = ++context->steal_version;
+	if (vmm_guest_memory_write(vcpu->guest,
+			gpa + offsetof(struct pvclock_steal_time, version),
+			&version, sizeof(version), TRUE) == sizeof(version))
+		return;
+
+ fail:
+	VM_LOG(LVL_ERR, "Steal time at 0x%"PRIPADDR" not in guest RAM\n",
+	       gpa);
+	context->steal_msr = 0;
+}
+
+/*!
+ * \fn void cpu_vcpu_pvclock_update(struct vcpu_hw_context *context)
+ * \brief Refresh paravirtual clock page of VCPU in guest memory.
+ *
+ * Guest computes current time from last host timestamp and TSC
+ * ticks elapsed since then, hence reading time needs no VM exits.
+ */
+void cpu_vcpu_pvclock_update(struct vcpu_hw_context *context)
+{
+	struct vmm_guest *guest = context->assoc_vcpu->guest;
+	struct pvclock_vcpu_time_info ti;
+
+	context->pvclock_update = FALSE;
+
+	cpu_vcpu_steal_time_update(context);
+
+	if (!(context->pvclock_msr & PVCLOCK_SYSTEM_TIME_ENABLE))
+		return;
+
+	/* Odd version tells guest that update is in progress */
+	ti.version = ++context->pvclock_version;
+	if (vmm_guest_memory_write(guest, context->pvclock_gpa,
+				   &ti.version, sizeof(ti.version),
+				   TRUE) != sizeof(ti.version))
+		goto fail;
+	arch_wmb();
+
+	ti.pad0 = 0;
+	ti.tsc_timestamp = cpu_vcpu_guest_tsc(context);
+	ti.system_time = vmm_timer_timestamp();
+	ti.tsc_to_system_mul = tsc_to_system_mul;
+	ti.tsc_shift = tsc_shift;
+	ti.flags = 0;
+	ti.pad[0] = ti.pad[1] = 0;
+	ti.version = ++context->pvclock_version;
+	if (vmm_guest_memory_write(guest, context->pvclock_gpa + sizeof(u32),
+				   (u8 *)&ti + sizeof(u32),
+				   sizeof(ti) - sizeof(u32),
+				   TRUE) != (sizeof(ti) - sizeof(u32)))
+		goto fail;
+	arch_wmb();
+
+	if (vmm_guest_memory_write(guest, context->pvclock_gpa,
+				   &ti.version, sizeof(ti.version),
+				   TRUE) == sizeof(ti.version))
+		return;
+
+ fail:
+	VM_LOG(LVL_ERR, "Paravirtual clock at 0x%"PRIPADDR" not in "
+	       "guest RAM\n", context->pvclock_gpa);
+	context->pvclock_msr = 0;
+}
+
+static void cpu_vcpu_pvclock_wallclock(struct vcpu_hw_context *context,
+				       physical_addr_t gpa)
+{
+	struct vmm_guest *guest = context->assoc_vcpu->guest;
+	struct pvclock_wall_clock wc;
+	struct vmm_timeval tv;
+	u64 boot_ns;
+
+	if (vmm_wallclock_get_timeofday(&tv, NULL) != VMM_OK)
+		return;
+
+	/* Wall clock time at which system_time of VCPUs was zero */
+	boot_ns = (u64)tv.tv_sec * 1000000000ULL + tv.tv_nsec -
+		  vmm_timer_timestamp();
+
+	wc.version = 0;
+	wc.sec = (u32)(boot_ns / 1000000000ULL);
+	wc.nsec = (u32)(boot_ns % 1000000000ULL);
+	vmm_guest_memory_write(guest, gpa, &wc, sizeof(wc), TRUE);
+}
+
+/*!
+ * \fn int cpu_vcpu_pvclock_msr_read(struct vcpu_hw_context *context, u32 msr, u64 *val)
+ * \brief Emulate read of KVM paravirtual clock MSRs.
+ *
+ * \return VMM_OK if MSR belongs to paravirtual clock.
+ */
+int cpu_vcpu_pvclock_msr_read(struct vcpu_hw_context *context,
+			      u32 msr, u64 *val)
+{
+	switch (msr) {
+	case MSR_KVM_SYSTEM_TIME_NEW:
+		*val = context->pvclock_msr;
+		break;
+	case MSR_KVM_WALL_CLOCK_NEW:
+		*val = 0;
+		break;
+	case MSR_KVM_STEAL_TIME:
+		*val = context->steal_msr;
+		break;
+	default:
+		return VMM_ENOTAVAIL;
+	}
+
+	return VMM_OK;
+}
+
+/*!
+ * \fn int cpu_vcpu_pvclock_msr_write(struct vcpu_hw_context *context, u32 msr, u64 val)
+ * \brief Emulate write of KVM paravirtual clock MSRs.
+ *
+ * \return VMM_OK if MSR belongs to paravirtual clock.
+ */
+int cpu_vcpu_pvclock_msr_write(struct vcpu_hw_context *context,
+			       u32 msr, u64 val)
+{
+	switch (msr) {
+	case MSR_KVM_SYSTEM_TIME_NEW:
+		context->pvclock_msr = val;
+		context->pvclock_gpa = val & ~PVCLOCK_SYSTEM_TIME_ENABLE;
+		cpu_vcpu_pvclock_update(context);
+		break;
+	case MSR_KVM_WALL_CLOCK_NEW:
+		cpu_vcpu_pvclock_wallclock(context, val);
+		break;
+	case MSR_KVM_STEAL_TIME:
+		context->steal_msr = val;
+		context->steal_version = 0;
+		cpu_vcpu_steal_time_update(context);
+		break;
+	default:
+		return VMM_ENOTAVAIL;
+	}
+
+	return VMM_OK;
+}
@@ -27,6 +27,7 @@
 #include <vmm_manager.h>
 #include <vmm_host_aspace.h>
 #include <vmm_guest_aspace.h>
+#include <vmm_snapshot.h>
 #include <cpu_mmu.h>
 #include <cpu_features.h>
 #include <cpu_vm.h>
@@ -38,158 +39,6 @@
 
 void arch_vcpu_emergency_shutdown(struct vcpu_hw_context *context);
 
-static void init_cpu_capabilities(struct vmm_vcpu *vcpu)
-{
-	u32 funcs, b, c, d;
-	struct x86_vcpu_priv *priv = x86_vcpu_priv(vcpu);
-	struct cpuid_response *func_response;
-	extern struct cpuinfo_x86 cpu_info;
-
-	for (funcs = CPUID_BASE_VENDORSTRING;
-	     funcs < CPUID_BASE_FUNC_LIMIT; funcs++) {
-		func_response =
-			(struct cpuid_response *)
-			&priv->standard_funcs[funcs];
-
-		switch (funcs) {
-		case CPUID_BASE_VENDORSTRING:
-			cpuid(CPUID_BASE_VENDORSTRING,
-			      &func_response->resp_eax,
-			      &func_response->resp_ebx,
-			      &func_response->resp_ecx,
-			      &func_response->resp_edx);
-
-			func_response->resp_eax = CPUID_BASE_FUNC_LIMIT;
-			break;
-
-		case CPUID_BASE_FEATURES:
-			cpuid(CPUID_BASE_FEATURES, &func_response->resp_eax,
-			      &b, &c, &d);
-
-			/* NR cpus and apic id */
-			clear_bits(16, 31, (volatile unsigned long *)&b);
-			b |= ((vcpu->subid << 24)
-			      | (vcpu->guest->vcpu_count << 16));
-			func_response->resp_ebx = b;
-
-			/* No VMX or x2APIC */
-			if (cpu_info.vendor == x86_VENDOR_INTEL) {
-				clear_bit(CPUID_FEAT_ECX_x2APIC_BIT, (volatile unsigned long *)&c);
-				clear_bit(CPUID_FEAT_ECX_VMX_BIT, (volatile unsigned long *)&c);
-			}
-			clear_bit(CPUID_FEAT_ECX_MONITOR_BIT, (volatile unsigned long *)&c);
-			func_response->resp_ecx = c;
-
-			/* No PAE, MTRR, PGE, ACPI, PSE & MSR */
-			clear_bit(CPUID_FEAT_EDX_PAE_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_MTRR_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_PGE_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_ACPI_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_HTT_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_PSE_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_MSR_BIT, (volatile unsigned long *)&d);
-
-			func_response->resp_edx = d;
-			break;
-
-		default:
-			func_response->resp_eax = 0;
-			func_response->resp_ebx = 0;
-			func_response->resp_ecx = 0;
-			func_response->resp_edx = 0;
-			break;
-		}
-	}
-
-	for (funcs = CPUID_EXTENDED_BASE;
-	     funcs < CPUID_EXTENDED_FUNC_LIMIT; funcs++) {
-		func_response =
-			(struct cpuid_response *)
-			&priv->extended_funcs[funcs - CPUID_EXTENDED_BASE];
-
-		switch (funcs) {
-		case CPUID_EXTENDED_BASE:
-			cpuid(CPUID_EXTENDED_FEATURES,
-			      &func_response->resp_eax,
-			      &func_response->resp_ebx,
-			      &func_response->resp_ecx,
-			      &func_response->resp_edx);
-
-			func_response->resp_eax =
-				CPUID_EXTENDED_L2_CACHE_TLB_IDENTIFIER
-				- CPUID_EXTENDED_BASE;
-			break;
-
-		case CPUID_EXTENDED_FEATURES: /* replica of base features */
-			cpuid(CPUID_EXTENDED_FEATURES, &func_response->resp_eax,
-			      &b, &c, &d);
-
-			/* NR cpus and apic id */
-			clear_bits(16, 31, (volatile unsigned long *)&b);
-			b |= ((vcpu->subid << 24)
-			      | (vcpu->guest->vcpu_count << 16));
-			func_response->resp_ebx = b;
-
-			/* No VMX or x2APIC */
-			if (cpu_info.vendor == x86_VENDOR_INTEL) {
-				clear_bit(CPUID_FEAT_ECX_x2APIC_BIT, (volatile unsigned long *)&c);
-				clear_bit(CPUID_FEAT_ECX_VMX_BIT, (volatile unsigned long *)&c);
-			}
-			clear_bit(CPUID_FEAT_ECX_MONITOR_BIT, (volatile unsigned long *)&c);
-			func_response->resp_ecx = c;
-
-			/* No PAE, MTRR, PGE, ACPI, PSE & MSR */
-			clear_bit(CPUID_FEAT_EDX_PAE_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_MTRR_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_PGE_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_ACPI_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_HTT_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_PSE_BIT, (volatile unsigned long *)&d);
-			clear_bit(CPUID_FEAT_EDX_MSR_BIT, (volatile unsigned long *)&d);
-
-			func_response->resp_edx = d;
-			break;
-		}
-	}
-
-	switch(cpu_info.vendor) {
-	case x86_VENDOR_AMD:
-		for (funcs = CPUID_EXTENDED_BASE;
-		     funcs < CPUID_EXTENDED_FUNC_LIMIT; funcs++) {
-			switch(funcs) {
-			case AMD_CPUID_EXTENDED_L1_CACHE_TLB_IDENTIFIER:
-				cpuid(AMD_CPUID_EXTENDED_L1_CACHE_TLB_IDENTIFIER,
-				      &func_response->resp_eax,
-				      &func_response->resp_ebx,
-				      &func_response->resp_ecx,
-				      &func_response->resp_edx);
-				break;
-
-			case CPUID_EXTENDED_L2_CACHE_TLB_IDENTIFIER:
-				cpuid(CPUID_EXTENDED_L2_CACHE_TLB_IDENTIFIER,
-				      &func_response->resp_eax,
-				      &func_response->resp_ebx,
-				      &func_response->resp_ecx,
-				      &func_response->resp_edx);
-				break;
-			}
-		}
-		break;
-
-	case x86_VENDOR_INTEL:
-		for (funcs = CPUID_BASE_VENDORSTRING;
-		     funcs < CPUID_BASE_FUNC_LIMIT; funcs++) {
-			func_response =
-				(struct cpuid_response *)
-				&priv->standard_funcs[funcs];
-
-			switch (funcs) {
-			}
-		}
-		break;
-	}
-}
-
 static void arch_guest_vcpu_trampoline(struct vmm_vcpu *vcpu)
 {
 	VM_LOG(LVL_DEBUG, "Running VCPU %s\n", vcpu->name);
@@ -221,13 +70,13 @@ int arch_vcpu_init(struct vmm_vcpu *vcpu)
 
 			INIT_SPIN_LOCK(&x86_vcpu_priv(vcpu)->lock);
 
-			init_cpu_capabilities(vcpu);
-
 			x86_vcpu_priv(vcpu)->hw_context = vmm_zalloc(sizeof(struct vcpu_hw_context));
 			x86_vcpu_priv(vcpu)->hw_context->assoc_vcpu = vcpu;
 
 			x86_vcpu_priv(vcpu)->hw_context->vcpu_emergency_shutdown = arch_vcpu_emergency_shutdown;
 			cpu_init_vcpu_hw_context(&cpu_info, x86_vcpu_priv(vcpu)->hw_context);
+			setup_guest_ioport_intercepts(vcpu->guest,
+						      x86_vcpu_priv(vcpu)->hw_context);
 
 			/*
 			 * This vcpu has to run VMM code before and after guest mode
@@ -262,6 +111,10 @@ void arch_vcpu_switch(struct vmm_vcpu *tvcpu,
 		memcpy(&tvcpu->regs, regs, sizeof(arch_regs_t));
 		memcpy(regs, &vcpu->regs, sizeof(arch_regs_t));
 	}
+
+	/* Host CPU or time may have changed since VCPU last ran */
+	if (vcpu->is_normal)
+		x86_vcpu_hw_context(vcpu)->pvclock_update = TRUE;
 }
 
 void arch_vcpu_post_switch(struct vmm_vcpu *vcpu,
@@ -305,6 +158,39 @@ void arch_vcpu_stat_dump(struct vmm_chardev *cdev, struct vmm_vcpu *vcpu)
 	/* For now no arch specific stats */
 }
 
+int arch_vcpu_state_save(struct vmm_vcpu *vcpu,
+			 struct vmm_snapshot_state *st)
+{
+	return VMM_ENOTSUPP;
+}
+
+int arch_vcpu_state_restore(struct vmm_vcpu *vcpu,
+			    struct vmm_snapshot_state *st)
+{
+	return VMM_ENOTSUPP;
+}
+
+bool arch_vcpu_sample_pc(struct vmm_vcpu *vcpu, arch_regs_t *regs,
+			 virtual_addr_t *host_pc, virtual_addr_t *guest_pc)
+{
+	struct vcpu_hw_context *context;
+
+	/*
+	 * Guest mode is always left through a VM exit before host
+	 * interrupts are taken, hence regs are always host context.
+	 */
+	*host_pc = regs->rip;
+	*guest_pc = 0;
+
+	if (vcpu->is_normal) {
+		context = x86_vcpu_hw_context(vcpu);
+		if (context && context->vmcb)
+			*guest_pc = context->vmcb->rip;
+	}
+
+	return FALSE;
+}
+
 static void dump_guest_vcpu_state(struct vcpu_hw_context *context)
 {
 	int i;
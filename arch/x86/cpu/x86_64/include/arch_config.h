@@ -28,5 +28,14 @@
 
 #define ARCH_HAS_EXTABLE
 #define ARCH_HAS_MEMCPY
+#define ARCH_HAS_MEMSET
+
+#define ARCH_HAS_HOST_HUGEPAGE
+#define ARCH_HOST_HUGEPAGE_SHIFT	21
+
+/* Hypervisor VA window (PML4 slot 2) for linear map of guest RAM */
+#define ARCH_HAS_GUEST_LINEAR_MAP
+#define ARCH_GUEST_LINEAR_MAP_START	0x0000010000000000ULL
+#define ARCH_GUEST_LINEAR_MAP_SIZE	0x0000008000000000ULL
 
 #endif /* _ARCH_CONFIG_H__ */
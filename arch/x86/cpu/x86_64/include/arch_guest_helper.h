@@ -26,11 +26,18 @@
 #include <cpu_vm.h>
 #include <emu/rtc/mc146818rtc.h>
 #include <emu/i8259.h>
+#include <emu/lapic.h>
 
 #define GUEST_HALT_SW_CODE	0x80
 /* When CPU exited from VM mode for VMM to handle */
 #define GUEST_VM_EXIT_SW_CODE	0x81
 
+/* Port to IO region table is split in two levels of 256 entries */
+#define GUEST_IOPORT_COUNT	0x10000
+#define GUEST_IOPORT_L2_SHIFT	8
+#define GUEST_IOPORT_L2_COUNT	(1 << GUEST_IOPORT_L2_SHIFT)
+#define GUEST_IOPORT_L1_COUNT	(GUEST_IOPORT_COUNT >> GUEST_IOPORT_L2_SHIFT)
+
 /*! \brief x86 Guest private information
  *
  * This contains the private information for x86
@@ -44,17 +51,77 @@ struct x86_guest_priv {
 	void *pic_list;
 	struct cmos_rtc_state *rtc_cmos;
 	struct i8259_state *master_pic;
+	/**< LAPIC emulator of guest and its MSR handlers */
+	void *lapic;
+	apic_msr_read_t lapic_msr_read;
+	apic_msr_write_t lapic_msr_write;
 	u64 tot_ram_sz;
+	/**< Direct indexed IO port to IO region table. Second level
+	 * tables are allocated when an IO region first covers them.
+	 */
+	struct vmm_region **ioport_map[GUEST_IOPORT_L1_COUNT];
+	/**< CPUID responses computed once at guest creation. Per-VCPU
+	 * fields (APIC ID and logical CPU count) are filled on exit.
+	 */
+	struct cpuid_response cpuid_std[CPUID_BASE_FUNC_LIMIT];
+	struct cpuid_response cpuid_ext[CPUID_EXTENDED_FUNC_LIMIT -
+					CPUID_EXTENDED_BASE];
+	struct cpuid_response cpuid_vm[CPUID_VM_FUNC_LIMIT -
+				       CPUID_VM_CPUID_BASE];
 };
 
 /*!def x86_guest_priv(guest) is to access guest private information */
 #define x86_guest_priv(guest) ((struct x86_guest_priv *)(guest->arch_priv))
 
+/*! \brief Find IO region of given guest covering given IO port */
+static inline struct vmm_region *guest_ioport_region(struct vmm_guest *guest,
+						     u32 port)
+{
+	struct vmm_region **l2;
+
+	if (port >= GUEST_IOPORT_COUNT)
+		return NULL;
+
+	l2 = x86_guest_priv(guest)->ioport_map[port >> GUEST_IOPORT_L2_SHIFT];
+
+	return (l2) ? l2[port & (GUEST_IOPORT_L2_COUNT - 1)] : NULL;
+}
+
+extern void cpu_tsc_calibrate(void);
+extern u64 cpu_vcpu_guest_tsc(struct vcpu_hw_context *context);
+extern void cpu_vcpu_pvclock_update(struct vcpu_hw_context *context);
+extern int cpu_vcpu_pvclock_msr_read(struct vcpu_hw_context *context,
+				     u32 msr, u64 *val);
+extern int cpu_vcpu_pvclock_msr_write(struct vcpu_hw_context *context,
+				      u32 msr, u64 val);
+extern int guest_lapic_msr_read(struct vmm_vcpu *vcpu, u32 msr, u64 *val);
+extern int guest_lapic_msr_write(struct vmm_vcpu *vcpu, u32 msr, u64 val);
+extern void guest_cpuid(struct vmm_vcpu *vcpu, u32 func,
+			struct cpuid_response *resp);
+extern void setup_guest_ioport_intercepts(struct vmm_guest *guest,
+					  struct vcpu_hw_context *context);
 extern int gva_to_gpa(struct vcpu_hw_context *context, virtual_addr_t vaddr,
 		      physical_addr_t *gpa);
 extern int gpa_to_hpa(struct vcpu_hw_context *context, physical_addr_t vaddr,
 		      physical_addr_t *hpa);
+extern int setup_guest_shadow_pagetable(struct vcpu_hw_context *context);
 extern int purge_guest_shadow_pagetable(struct vcpu_hw_context *context);
+extern int switch_guest_shadow_pagetable(struct vcpu_hw_context *context,
+					 u64 g_cr3, physical_addr_t *pgt_pa);
+extern void track_guest_shadow_frame(struct vcpu_hw_context *context,
+				     physical_addr_t gframe);
+extern bool guest_shadow_frame_protected(struct vcpu_hw_context *context,
+					 physical_addr_t hframe);
+extern bool unprotect_guest_shadow_frame(struct vcpu_hw_context *context,
+					 physical_addr_t hframe);
+extern int create_guest_nested_map(struct vcpu_hw_context *context,
+				   physical_addr_t gphys, physical_addr_t hphys,
+				   size_t size, bool writeable);
+extern void write_protect_guest_nested_map(struct vcpu_hw_context *context,
+					   physical_addr_t gphys,
+					   physical_size_t size);
+extern int dirty_guest_nested_map(struct vcpu_hw_context *context,
+				  physical_addr_t gphys);
 extern int create_guest_shadow_map(struct vcpu_hw_context *context,
 				   virtual_addr_t vaddr, physical_addr_t paddr,
 				   size_t size, u32 pdprot, u32 pgprot);
@@ -86,10 +86,23 @@ static inline int mmu_level_index(physical_addr_t ia, int level)
 	return (ia >> PGTI_SHIFT) & ~PGTREE_MASK;
 }
 
+/* Bit 7 of a non-leaf level entry marks a 1GB/2MB leaf page */
+static inline bool mmu_level_is_huge(union page *pg, int level)
+{
+	return ((level < PGTBL_LAST_LEVEL) && pg->bits.pat);
+}
+
+static inline physical_addr_t mmu_level_block_size(int level)
+{
+	return ~mmu_level_map_mask(level) + 1;
+}
+
 extern int mmu_get_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl,
 				physical_addr_t ia, union page *pg);
 extern int mmu_unmap_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_addr_t ia);
 extern int mmu_map_page(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl, physical_addr_t ia, union page *pg);
+extern int mmu_map_hugepage(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl,
+			    physical_addr_t ia, union page *pg, int level);
 extern struct page_table *mmu_pgtbl_alloc(struct pgtbl_ctrl *ctrl, int stage);
 extern int mmu_pgtbl_free(struct pgtbl_ctrl *ctrl, struct page_table *pgtbl);
 
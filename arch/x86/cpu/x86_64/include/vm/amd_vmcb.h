@@ -25,6 +25,11 @@
 
 #define VALID_CRN_TRAP	(1ULL << 63)
 
+/* VMCB TLB control values */
+#define TLB_CONTROL_DO_NOTHING		0
+#define TLB_CONTROL_FLUSH_ALL		1	/* Whole TLB, all ASIDs */
+#define TLB_CONTROL_FLUSH_ASID		3	/* Entries of guest ASID only */
+
 /* general 1 intercepts */
 enum generic_interrupt_1_bits {
 	GENERAL1_INTERCEPT_INTR		 = 1 << 0,
@@ -410,7 +415,9 @@ struct vmcb {
 	lbrctrl_t lbr_control;		/* offset 0xB8 */
 	u64 res09;			/* offset 0xC0 */
 	u64 nextrip;			/* offset 0xC8 */
-	u64 res10a[102];		/* offset 0xD0 pad to save area */
+	u8 insn_len;			/* offset 0xD0 */
+	u8 insn_bytes[15];		/* offset 0xD1 */
+	u64 res10a[100];		/* offset 0xE0 pad to save area */
 
 	struct seg_selector es;		/* offset 1024 */
 	struct seg_selector cs;
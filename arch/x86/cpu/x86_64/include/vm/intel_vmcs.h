@@ -47,7 +47,7 @@ struct vmx_msr_state {
 	unsigned long msrs[VMX_MSR_COUNT];
 };
 
-union {
+union vmx_ept_control {
 	struct {
 		u64 ept_mt :3,
 			ept_wl :3,
@@ -55,7 +55,7 @@ union {
 			asr    :52;
 	};
 	u64 eptp;
-} vmx_ept_control;
+};
 
 
 #define CPU_BASED_VIRTUAL_INTR_PENDING        0x00000004
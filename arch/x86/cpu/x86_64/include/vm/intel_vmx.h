@@ -162,6 +162,8 @@ extern u64 vmx_ept_vpid_cap;
 	(vmx_ept_vpid_cap & VMX_EPT_MEMORY_TYPE_WB)
 #define cpu_has_vmx_ept_2MB				\
 	(vmx_ept_vpid_cap & VMX_EPT_SUPERPAGE_2MB)
+#define cpu_has_vmx_ept_1GB				\
+	(vmx_ept_vpid_cap & VMX_EPT_SUPERPAGE_1GB)
 #define cpu_has_vmx_ept_invept_single_context		\
 	(vmx_ept_vpid_cap & VMX_EPT_INVEPT_SINGLE_CONTEXT)
 
@@ -259,7 +261,7 @@ static inline void __vm_clear_bit(unsigned long field, unsigned int bit)
 	__vmwrite(field, __vmread(field) & ~(1UL << bit));
 }
 
-static inline void __invept(int type, u64 eptp, u64 gpa)
+static inline void __invept(unsigned long type, u64 eptp, u64 gpa)
 {
 	struct {
 		u64 eptp, gpa;
@@ -273,15 +275,15 @@ static inline void __invept(int type, u64 eptp, u64 gpa)
 	     !cpu_has_vmx_ept_invept_single_context )
 		type = INVEPT_ALL_CONTEXT;
 
-	asm volatile ("invept %1, (%0)\n"
+	asm volatile ("invept %0, %1\n"
 		      /* CF==1 or ZF==1 --> crash (ud2) */
 		      "ja 1f ; ud2 ; 1:\n"
 		      :
-		      : "a"(&operand), "c"(type)
-		      : "memory" );
+		      : "m"(operand), "r"(type)
+		      : "memory", "cc" );
 }
 
-static inline void __invvpid(int type, u16 vpid, u64 gva)
+static inline void __invvpid(unsigned long type, u16 vpid, u64 gva)
 {
 	struct {
 		u64 vpid:16;
@@ -293,7 +295,7 @@ static inline void __invvpid(int type, u16 vpid, u64 gva)
 	type &= 0xfffffffful;
 
 	/* Fix up #UD exceptions which occur when TLBs are flushed before VMXON. */
-	asm volatile ("invvpid %1, %0\n"
+	asm volatile ("1: invvpid %0, %1\n"
 		      /* CF==1 or ZF==1 --> crash (ud2) */
 		       "ja 2f ; ud2 ; 2:\n"
 		       ".section __ex_table,\"a\"\n"
@@ -301,8 +303,8 @@ static inline void __invvpid(int type, u16 vpid, u64 gva)
 		       "    "__FIXUP_WORD" 1b,2b\n"
 		       ".previous"
 		       :
-		       : "a"(&operand), "c"(type)
-		       : "memory" );
+		       : "m"(operand), "r"(type)
+		       : "memory", "cc" );
 }
 
 static inline void ept_sync_all(void)
@@ -389,4 +391,12 @@ static inline int __vmxon(u64 addr)
 extern int __init intel_init(struct cpuinfo_x86 *cpuinfo);
 extern int intel_setup_vm_control(struct vcpu_hw_context *context);
 
+struct vmm_region;
+
+extern int intel_ept_init(struct vcpu_hw_context *context);
+extern u64 intel_ept_pointer(struct vcpu_hw_context *context);
+extern void intel_ept_flush(struct vcpu_hw_context *context);
+extern int intel_ept_map_fault(struct vcpu_hw_context *context,
+			       physical_addr_t gphys, struct vmm_region *reg);
+
 #endif /* __VMX_H__ */
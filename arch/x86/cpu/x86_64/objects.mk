@@ -38,10 +38,14 @@ cpu-objs-y+= cpu_atomic64.o
 cpu-objs-y+= cpu_main.o
 cpu-objs-y+= cpu_hacks.o
 cpu-objs-y+= cpu_string.o
+cpu-objs-y+= cpu_crc32c.o
+cpu-objs-$(CONFIG_CRYPTO_HASH_SHA256)+= cpu_sha256.o
+cpu-objs-$(CONFIG_CRYPTO_HASH_SHA256)+= cpu_sha256_ni.o
 cpu-objs-$(CONFIG_MODULES)+= cpu_elf.o
 cpu-objs-y+= cpu_interrupts.o
 cpu-objs-y+= cpu_vcpu_irq.o
 cpu-objs-y+= cpu_vcpu_helper.o
+cpu-objs-y+= cpu_vcpu_clock.o
 cpu-objs-y+= cpu_pgtbl_helper.o
 cpu-objs-y+= cpu_mmu.o
 cpu-objs-y+= dumpstack_64.o
@@ -51,5 +55,6 @@ cpu-objs-$(CONFIG_VEXT_AMD_SVM)+= vm/amd/amd_intercept.o
 cpu-objs-$(CONFIG_VEXT_AMD_SVM)+= vm/amd/amd_svm.o
 cpu-objs-$(CONFIG_VEXT_INTEL_VTX)+= vm/intel/intel_vmcs.o
 cpu-objs-$(CONFIG_VEXT_INTEL_VTX)+= vm/intel/intel_vmx.o
+cpu-objs-$(CONFIG_VEXT_INTEL_VTX)+= vm/intel/intel_ept.o
 cpu-objs-$(CONFIG_VEXT_INTEL_VTX)+= vm/intel/ivmx_helper.o
 cpu-objs-$(CONFIG_VEXT_INTEL_VTX)+= vm/intel/intel_intercept.o
@@ -36,6 +36,8 @@
 #include <vmm_devemu.h>
 #include <vmm_manager.h>
 #include <vmm_main.h>
+#include <vmm_macros.h>
+#include <libs/stringlib.h>
 
 static char *exception_names[] = {
 	"#DivError",	/* 0 */
@@ -121,6 +123,37 @@ static int guest_read_fault_inst(struct vcpu_hw_context *context,
 	return VMM_OK;
 }
 
+/*
+ * Decode faulting guest instruction. With decode assist the CPU
+ * already fetched instruction bytes into VMCB so guest page walk
+ * and memory read are not needed.
+ */
+static int guest_decode_fault_inst(struct vcpu_hw_context *context,
+				   x86_decoded_inst_t *dinst)
+{
+	int rc;
+	x86_inst ins;
+	u32 len = min((u32)context->vmcb->insn_len, (u32)X86_MAX_INST_LEN);
+
+	if (context->cpuinfo->decode_assist && len) {
+		memset(ins, 0, sizeof(x86_inst));
+		memcpy(ins, context->vmcb->insn_bytes, len);
+		rc = x86_decode_inst_cached(context, context->vmcb->rip,
+					    context->g_cr3, ins, len, dinst);
+		if (rc != VMM_ENOTAVAIL)
+			return rc;
+	}
+
+	if (guest_read_fault_inst(context, &ins)) {
+		VM_LOG(LVL_ERR, "Failed to read faulting guest instruction.\n");
+		return VMM_EFAIL;
+	}
+
+	return x86_decode_inst_cached(context, context->vmcb->rip,
+				      context->g_cr3, ins, X86_MAX_INST_LEN,
+				      dinst);
+}
+
 static inline void dump_guest_exception_insts(struct vcpu_hw_context *context)
 {
 	x86_inst ins;
@@ -188,6 +221,23 @@ void handle_guest_resident_page_fault(struct vcpu_hw_context *context)
 		goto guest_bad_fault;
 	}
 
+	/*
+	 * Guest wrote to its page table page which is shadowed by
+	 * a cached root. The cached roots are dropped, after which
+	 * the page need not be write protected anymore.
+	 */
+	if ((context->vmcb->exitinfo1 & 0x2) && pte.rw &&
+	    unprotect_guest_shadow_frame(context,
+				(physical_addr_t)pte1.paddr << PAGE_SHIFT)) {
+		if (update_guest_shadow_pgprot(context, fault_gphys,
+					       GUEST_PG_LVL_2,
+					       (pte._val & PGPROT_MASK))
+		    != VMM_OK)
+			goto guest_bad_fault;
+		invalidate_guest_tlb(context, fault_gphys);
+		return;
+	}
+
 	prot = (pte._val & PGPROT_MASK);
 	prot1 = (pte1._val & PGPROT_MASK);
 	pdprot = (pde._val & PGPROT_MASK);
@@ -353,15 +403,9 @@ static inline
 void handle_guest_mmio_fault(struct vcpu_hw_context *context,
 			     struct vmm_region *fault_reg)
 {
-	x86_inst ins;
 	x86_decoded_inst_t dinst;
 
-	if (guest_read_fault_inst(context, &ins)) {
-		VM_LOG(LVL_ERR, "Failed to read faulting guest instruction.\n");
-		goto guest_bad_fault;
-	}
-
-	if (x86_decode_inst(context, ins, &dinst) != VMM_OK) {
+	if (guest_decode_fault_inst(context, &dinst) != VMM_OK) {
 		VM_LOG(LVL_ERR, "Failed to decode guest instruction.\n");
 		goto guest_bad_fault;
 	}
@@ -428,6 +472,10 @@ void handle_guest_protected_mem_rw(struct vcpu_hw_context *context)
 	prot = (pte._val & PGPROT_MASK);
 	pdprot = (pde._val & PGPROT_MASK);
 
+	/* Guest page table page used for this translation */
+	track_guest_shadow_frame(context,
+				 (physical_addr_t)pde.paddr << PAGE_SHIFT);
+
 	/*
 	 * If page is present and marked readonly, page fault
 	 * needs to be delivered to guest. This is because
@@ -477,6 +525,11 @@ void handle_guest_protected_mem_rw(struct vcpu_hw_context *context)
 	 * Otherwise do emulate.
 	 */
 	if (g_reg->flags & (VMM_REGION_REAL | VMM_REGION_ALIAS)) {
+		/* Page tables of cached shadow roots are write protected */
+		if (guest_shadow_frame_protected(context,
+					g_reg->hphys_addr + fault_offset))
+			prot &= ~0x2;
+
 		if (create_guest_shadow_map(context, fault_gphys,
 					    (g_reg->hphys_addr + fault_offset),
 					    PAGE_SIZE, pdprot,
@@ -520,7 +573,63 @@ void __handle_vm_gdt_write(struct vcpu_hw_context *context)
 
 void __handle_vm_npf (struct vcpu_hw_context *context)
 {
-	VM_LOG(LVL_INFO, "Unhandled Intercept: nested page fault.\n");
+	struct vmm_guest *guest = context->assoc_vcpu->guest;
+	physical_addr_t fault_gphys = context->vmcb->exitinfo2;
+	physical_addr_t fault_offset;
+	struct vmm_region *g_reg;
+	bool writeable;
+
+	if (unlikely(!context->nested_paging)) {
+		VM_LOG(LVL_ERR, "Nested page fault without nested paging.\n");
+		goto guest_bad_fault;
+	}
+
+	vmm_manager_guest_boot_fault(guest);
+
+	g_reg = vmm_guest_find_region(guest, fault_gphys,
+				      VMM_REGION_MEMORY, FALSE);
+	if (!g_reg) {
+		VM_LOG(LVL_ERR, "ERROR: No region mapped to guest physical: "
+		       "0x%"PRIPADDR" (rIP: 0x%"PRIADDR")\n",
+		       fault_gphys, context->vmcb->rip);
+		goto guest_bad_fault;
+	}
+
+	/*
+	 * RAM backed addresses are mapped in nested page table on
+	 * first touch. Everything else is emulated.
+	 */
+	if (g_reg->flags & (VMM_REGION_REAL | VMM_REGION_ALIAS)) {
+		/* Write to present page is fault only for dirty logging */
+		if (((context->vmcb->exitinfo1 & 0x3) == 0x3) &&
+		    !(g_reg->flags & VMM_REGION_READONLY) &&
+		    (dirty_guest_nested_map(context, fault_gphys) == VMM_OK))
+			return;
+
+		/* Clean pages of dirty logged range are mapped read-only */
+		writeable = !(g_reg->flags & VMM_REGION_READONLY) &&
+			!vmm_guest_dirty_log_wprot(guest,
+						   fault_gphys & PAGE_MASK,
+						   PAGE_SIZE);
+		fault_offset = (fault_gphys & PAGE_MASK) - g_reg->gphys_addr;
+		if (create_guest_nested_map(context, fault_gphys & PAGE_MASK,
+					    g_reg->hphys_addr + fault_offset,
+					    PAGE_SIZE, writeable)
+		    != VMM_OK) {
+			VM_LOG(LVL_ERR, "ERROR: Failed to create map in "
+			       "guest's nested page table.\n"
+			       "Fault Gphys: 0x%"PRIPADDR" Host Phys: "
+			       "0x%"PRIPADDR"\n", fault_gphys,
+			       g_reg->hphys_addr + fault_offset);
+			goto guest_bad_fault;
+		}
+	} else {
+		handle_guest_mmio_fault(context, g_reg);
+	}
+
+	return;
+
+ guest_bad_fault:
 	if (context->vcpu_emergency_shutdown)
 		context->vcpu_emergency_shutdown(context);
 }
@@ -585,11 +694,75 @@ void __handle_vm_exception (struct vcpu_hw_context *context)
 		context->vcpu_emergency_shutdown(context);
 }
 
-void __handle_vm_wrmsr (struct vcpu_hw_context *context)
+/*
+ * Only MSRs not passed through in MSR permission bitmap reach here.
+ * Unknown MSRs read as zero and writes to them are ignored.
+ */
+void __handle_vm_msr(struct vcpu_hw_context *context)
 {
-	VM_LOG(LVL_INFO, "Unhandled Intercept: msr write.\n");
-	if (context->vcpu_emergency_shutdown)
-		context->vcpu_emergency_shutdown(context);
+	u32 msr = (u32)context->g_regs[GUEST_REGS_RCX];
+	u64 val;
+
+	if (context->vmcb->exitinfo1 == 0) {
+		switch (msr) {
+		case MSR_EFER:
+			val = context->vmcb->efer & ~EFER_SVME;
+			break;
+		case MSR_IA32_TSC:
+			val = cpu_read_msr(MSR_IA32_TSC) + context->vmcb->tsc_offset;
+			break;
+		case MSR_IA32_APICBASE:
+		case MSR_IA32_TSC_DEADLINE:
+		case APIC_X2APIC_MSR_BASE ... APIC_X2APIC_MSR_END:
+			if (guest_lapic_msr_read(context->assoc_vcpu, msr, &val))
+				val = 0;
+			break;
+		case MSR_KVM_WALL_CLOCK_NEW:
+		case MSR_KVM_SYSTEM_TIME_NEW:
+		case MSR_KVM_STEAL_TIME:
+			cpu_vcpu_pvclock_msr_read(context, msr, &val);
+			break;
+		default:
+			VM_LOG(LVL_DEBUG, "Guest read of MSR 0x%x\n", msr);
+			val = 0;
+			break;
+		}
+
+		context->vmcb->rax = (u32)val;
+		context->g_regs[GUEST_REGS_RAX] = (u32)val;
+		context->g_regs[GUEST_REGS_RDX] = (u32)(val >> 32);
+	} else {
+		val = ((u64)(u32)context->g_regs[GUEST_REGS_RDX] << 32) |
+			(u32)context->vmcb->rax;
+
+		switch (msr) {
+		case MSR_EFER:
+			/* SVM must stay enabled for guest */
+			context->vmcb->efer = val | EFER_SVME;
+			break;
+		case MSR_IA32_TSC:
+			context->vmcb->tsc_offset =
+				val - cpu_read_msr(MSR_IA32_TSC);
+			context->pvclock_update = TRUE;
+			break;
+		case MSR_IA32_APICBASE:
+		case MSR_IA32_TSC_DEADLINE:
+		case APIC_X2APIC_MSR_BASE ... APIC_X2APIC_MSR_END:
+			guest_lapic_msr_write(context->assoc_vcpu, msr, val);
+			break;
+		case MSR_KVM_WALL_CLOCK_NEW:
+		case MSR_KVM_SYSTEM_TIME_NEW:
+		case MSR_KVM_STEAL_TIME:
+			cpu_vcpu_pvclock_msr_write(context, msr, val);
+			break;
+		default:
+			VM_LOG(LVL_DEBUG, "Guest write 0x%"PRIx64" to MSR "
+			       "0x%x ignored\n", val, msr);
+			break;
+		}
+	}
+
+	context->vmcb->rip += 2;
 }
 
 void __handle_popf(struct vcpu_hw_context *context)
@@ -698,6 +871,7 @@ void __handle_crN_write(struct vcpu_hw_context *context)
 	u32 bits_set;
 	u64 htr;
 	u64 n_cr3;
+	physical_addr_t spgt_pa;
 
 	/* Check if host support instruction decode assistance */
 	if (context->cpuinfo->decode_assist) {
@@ -747,6 +921,12 @@ void __handle_crN_write(struct vcpu_hw_context *context)
 					context->vmcb->cr0 |= X86_CR0_PE;
 				}
 
+				/* Guest owns its CR0 with nested paging */
+				if (context->nested_paging) {
+					context->vmcb->cr0 = context->g_cr0;
+					break;
+				}
+
 				if (bits_set & X86_CR0_PG) {
 					context->vmcb->cr0 |= X86_CR0_PG;
 					VM_LOG(LVL_DEBUG,
@@ -819,13 +999,17 @@ void __handle_crN_write(struct vcpu_hw_context *context)
 					context->g_cr3 = n_cr3;
 
 					/* If the guest has paging enabled,
-					   flush the shadow pagetable */
-					if (likely(context->g_cr0
-						   & X86_CR0_PG)) {
+					   switch to shadow root of new CR3 */
+					if (likely(!context->nested_paging &&
+						   (context->g_cr0
+						    & X86_CR0_PG))) {
 						VM_LOG(LVL_DEBUG,
-						       "Purging guest shadow "
+						       "Switching guest shadow "
 						       "page table.\n");
-						purge_guest_shadow_pagetable(context);
+						if (switch_guest_shadow_pagetable(context,
+								n_cr3, &spgt_pa) != VMM_OK)
+							goto guest_bad_fault;
+						context->vmcb->cr3 = spgt_pa;
 					}
 				}
 				break;
@@ -837,6 +1021,8 @@ void __handle_crN_write(struct vcpu_hw_context *context)
 					sreg = dinst.inst.crn_mov.src_reg;
 					context->g_cr4 = context->g_regs[sreg];
 				}
+				if (context->nested_paging)
+					context->vmcb->cr4 = context->g_cr4;
 				VM_LOG(LVL_DEBUG, "Guest wrote 0x%lx to CR4\n",
 				       context->g_cr4);
 				break;
@@ -880,6 +1066,120 @@ void __handle_crN_write(struct vcpu_hw_context *context)
 	}
 }
 
+/* Max. string IO iterations handled in one exit before restarting */
+#define IOIO_STRING_BATCH	4096
+
+/*
+ * Dispatch one IO port access through guest port table. Ports not
+ * covered by a virtual IO region are unassigned: reads float high
+ * and writes are dropped just like on real hardware.
+ */
+static int __ioio_emulate(struct vcpu_hw_context *context, u32 io_port,
+			  bool in_inst, u32 *val, u32 len)
+{
+	struct vmm_vcpu *vcpu = context->assoc_vcpu;
+	struct vmm_region *reg = guest_ioport_region(vcpu->guest, io_port);
+
+	if (!reg || !(reg->flags & VMM_REGION_VIRTUAL)) {
+		if (in_inst)
+			*val = 0xFFFFFFFFUL >> (32 - (len * 8));
+		return VMM_OK;
+	}
+
+	if (in_inst)
+		return vmm_devemu_emulate_region_ioread(vcpu, reg, io_port,
+						val, len, VMM_DEVEMU_NATIVE_ENDIAN);
+
+	return vmm_devemu_emulate_region_iowrite(vcpu, reg, io_port,
+						 val, len, VMM_DEVEMU_NATIVE_ENDIAN);
+}
+
+static inline u64 __ioio_reg_update(u64 old, u64 new, u64 addr_mask)
+{
+	/* 16-bit address size preserves upper bits of register */
+	if (addr_mask == 0xFFFFULL)
+		return (old & ~addr_mask) | (new & addr_mask);
+
+	return new & addr_mask;
+}
+
+/*
+ * INS/OUTS with or without REP prefix. The whole repeat count (upto
+ * IOIO_STRING_BATCH iterations) is handled in a single exit. When more
+ * iterations remain, RIP is left on the instruction so that it restarts
+ * with updated count after pending interrupts are taken.
+ */
+static int __handle_ioio_string(struct vcpu_hw_context *context,
+				u32 io_port, bool in_inst, u32 len,
+				bool rep_access, u8 seg_num)
+{
+	struct vmm_guest *guest = context->assoc_vcpu->guest;
+	u64 exitinfo1 = context->vmcb->exitinfo1;
+	u64 addr_mask = (exitinfo1 & (0x1 << 9)) ? ~0ULL
+			: ((exitinfo1 & (0x1 << 8)) ? 0xFFFFFFFFULL
+			   : 0xFFFFULL);
+	u64 step = (context->vmcb->rflags & X86_EFLAGS_DF) ? -(u64)len : len;
+	u32 ireg = (in_inst) ? GUEST_REGS_RDI : GUEST_REGS_RSI;
+	struct seg_selector *seg;
+	u64 count, batch, i, linear;
+	physical_addr_t gpa;
+	u32 val;
+
+	/*
+	 * INS always writes to ES whereas OUTS may use segment override.
+	 * Segment encoding matches layout of segments in VMCB.
+	 */
+	seg = (in_inst) ? &context->vmcb->es : (&context->vmcb->es + seg_num);
+
+	count = (rep_access) ?
+		(context->g_regs[GUEST_REGS_RCX] & addr_mask) : 1;
+	batch = (count > IOIO_STRING_BATCH) ? IOIO_STRING_BATCH : count;
+
+	for (i = 0; i < batch; i++) {
+		linear = seg->base + (context->g_regs[ireg] & addr_mask);
+		if (context->g_cr0 & X86_CR0_PG) {
+			if (gva_to_gpa(context, linear, &gpa) != VMM_OK)
+				return VMM_EFAIL;
+		} else {
+			gpa = linear;
+		}
+
+		val = 0;
+		if (in_inst) {
+			if (__ioio_emulate(context, io_port, TRUE,
+					   &val, len) != VMM_OK)
+				return VMM_EFAIL;
+			if (vmm_guest_memory_write(guest, gpa, &val,
+						   len, TRUE) != len)
+				return VMM_EFAIL;
+		} else {
+			if (vmm_guest_memory_read(guest, gpa, &val,
+						  len, TRUE) != len)
+				return VMM_EFAIL;
+			if (__ioio_emulate(context, io_port, FALSE,
+					   &val, len) != VMM_OK)
+				return VMM_EFAIL;
+		}
+
+		context->g_regs[ireg] =
+			__ioio_reg_update(context->g_regs[ireg],
+					  context->g_regs[ireg] + step,
+					  addr_mask);
+	}
+
+	if (rep_access) {
+		context->g_regs[GUEST_REGS_RCX] =
+			__ioio_reg_update(context->g_regs[GUEST_REGS_RCX],
+					  count - batch, addr_mask);
+		if (count != batch)
+			return VMM_OK;
+	}
+
+	context->vmcb->rip = context->vmcb->exitinfo2;
+
+	return VMM_OK;
+}
+
 void __handle_ioio(struct vcpu_hw_context *context)
 {
 	u32 io_port = (context->vmcb->exitinfo1 >> 16);
@@ -901,29 +1201,43 @@ void __handle_ioio(struct vcpu_hw_context *context)
 	       io_port, (in_inst ? "in" : "out"), op_size,
 	       seg_num,(str_op ? "yes" : "no"),(rep_access ? "yes" : "no"));
 
+	if (str_op) {
+		if (__handle_ioio_string(context, io_port,
+					 (in_inst) ? TRUE : FALSE, op_size/8,
+					 (rep_access) ? TRUE : FALSE,
+					 seg_num) != VMM_OK) {
+			vmm_printf("Failed to emulate string IO instruction "
+				   "in guest.\n");
+			goto _fail;
+		}
+		return;
+	}
+
 	if (in_inst) {
-		if (vmm_devemu_emulate_ioread(context->assoc_vcpu, io_port,
-					      &guest_rd, op_size/8,
-					      VMM_DEVEMU_NATIVE_ENDIAN)
-		    != VMM_OK) {
+		if (__ioio_emulate(context, io_port, TRUE,
+				   &guest_rd, op_size/8) != VMM_OK) {
 			vmm_printf("Failed to emulate IO instruction in "
 				   "guest.\n");
 			goto _fail;
 		}
 
-		context->g_regs[GUEST_REGS_RAX] = guest_rd;
-		context->vmcb->rax = guest_rd;
+		/* IN with 8/16-bit operand leaves upper bits of RAX intact */
+		if (op_size == 32) {
+			context->vmcb->rax = guest_rd;
+		} else {
+			wval = (op_size == 8) ? 0xFF : 0xFFFF;
+			context->vmcb->rax = (context->vmcb->rax & ~(u64)wval) |
+					     (guest_rd & wval);
+		}
+		context->g_regs[GUEST_REGS_RAX] = context->vmcb->rax;
 	} else {
 		if (io_port == 0x80) {
 			VM_LOG(LVL_DEBUG, "(0x%"PRIx64") CBDW: 0x%"PRIx64"\n",
 			       context->vmcb->rip, context->vmcb->rax);
 		} else  {
 			wval = (u32)context->vmcb->rax;
-			if (vmm_devemu_emulate_iowrite(context->assoc_vcpu,
-						       io_port,
-						       &wval, op_size/8,
-						       VMM_DEVEMU_NATIVE_ENDIAN)
-			    != VMM_OK) {
+			if (__ioio_emulate(context, io_port, FALSE,
+					   &wval, op_size/8) != VMM_OK) {
 				vmm_printf("Failed to emulate IO instruction in"
 					   " guest.\n");
 				goto _fail;
@@ -943,66 +1257,16 @@ void __handle_ioio(struct vcpu_hw_context *context)
 
 void __handle_cpuid(struct vcpu_hw_context *context)
 {
-	struct x86_vcpu_priv *priv = x86_vcpu_priv(context->assoc_vcpu);
-	struct cpuid_response *func;
-
-	switch (context->vmcb->rax) {
-	case CPUID_BASE_VENDORSTRING:
-		func = &priv->standard_funcs[CPUID_BASE_VENDORSTRING];
-		context->vmcb->rax = func->resp_eax;
-		context->g_regs[GUEST_REGS_RBX] = func->resp_ebx;
-		context->g_regs[GUEST_REGS_RCX] = func->resp_ecx;
-		context->g_regs[GUEST_REGS_RDX] = func->resp_edx;
-		break;
-
-	case CPUID_BASE_FEATURES:
-		func = &priv->standard_funcs[CPUID_BASE_FEATURES];
-		context->vmcb->rax = func->resp_eax;
-		context->g_regs[GUEST_REGS_RBX] = func->resp_ebx;
-		context->g_regs[GUEST_REGS_RCX] = func->resp_ecx;
-		context->g_regs[GUEST_REGS_RDX] = func->resp_edx;
-		break;
-
-	case CPUID_EXTENDED_BASE:
-	case CPUID_EXTENDED_BRANDSTRING:
-	case CPUID_EXTENDED_BRANDSTRINGMORE:
-	case CPUID_EXTENDED_BRANDSTRINGEND:
-	case AMD_CPUID_EXTENDED_L1_CACHE_TLB_IDENTIFIER:
-	case CPUID_EXTENDED_L2_CACHE_TLB_IDENTIFIER:
-		func = &priv->extended_funcs[context->vmcb->rax
-					     - CPUID_EXTENDED_BASE];
-		context->vmcb->rax = func->resp_eax;
-		context->g_regs[GUEST_REGS_RBX] = func->resp_ebx;
-		context->g_regs[GUEST_REGS_RCX] = func->resp_ecx;
-		context->g_regs[GUEST_REGS_RDX] = func->resp_edx;
-		break;
+	struct cpuid_response resp;
 
-	case CPUID_BASE_FEAT_FLAGS:
-	case CPUID_EXTENDED_FEATURES:
-	case AMD_CPUID_EXTENDED_ADDR_NR_PROC:
-	case CPUID_EXTENDED_CAPABILITIES:
-	case CPUID_BASE_PWR_MNG:
-	case AMD_CPUID_EXTENDED_SVM_IDENTIFIER:
-		context->vmcb->rax = 0;
-		context->g_regs[GUEST_REGS_RBX] = 0;
-		context->g_regs[GUEST_REGS_RCX] = 0;
-		context->g_regs[GUEST_REGS_RDX] = 0;
-		break;
+	guest_cpuid(context->assoc_vcpu, (u32)context->vmcb->rax, &resp);
 
-	default:
-		VM_LOG(LVL_ERR, "GCPUID/R: Func: 0x%"PRIx64"\n",
-		       context->vmcb->rax);
-		goto _fail;
-	}
+	context->vmcb->rax = resp.resp_eax;
+	context->g_regs[GUEST_REGS_RBX] = resp.resp_ebx;
+	context->g_regs[GUEST_REGS_RCX] = resp.resp_ecx;
+	context->g_regs[GUEST_REGS_RDX] = resp.resp_edx;
 
 	context->vmcb->rip += 2;
-
-	return;
-
- _fail:
-	if (context->vcpu_emergency_shutdown){
-		context->vcpu_emergency_shutdown(context);
-	}
 }
 
 /**
@@ -1069,11 +1333,41 @@ void __handle_invalpg(struct vcpu_hw_context *context)
 		context->vcpu_emergency_shutdown(context);
 }
 
+static u32 vmexit_stats_reason(u64 exitcode)
+{
+	switch (exitcode) {
+	case VMEXIT_NPF:
+		return VMM_VCPU_EXIT_MMIO;
+	case VMEXIT_HLT:
+		return VMM_VCPU_EXIT_WFI;
+	case VMEXIT_VMMCALL:
+		return VMM_VCPU_EXIT_HYPCALL;
+	case VMEXIT_CR0_READ ... VMEXIT_CR15_WRITE:
+	case VMEXIT_MSR:
+	case VMEXIT_CPUID:
+		return VMM_VCPU_EXIT_SYSREG;
+	case VMEXIT_IOIO:
+		return VMM_VCPU_EXIT_IO;
+	case VMEXIT_INTR:
+	case VMEXIT_VINTR:
+		return VMM_VCPU_EXIT_IRQ;
+	default:
+		return VMM_VCPU_EXIT_OTHER;
+	}
+}
+
 void handle_vcpuexit(struct vcpu_hw_context *context)
 {
+	u64 emulate_tstamp = vmm_manager_vcpu_exit_tstamp();
+	u64 exitcode = context->vmcb->exitcode;
+
 	VM_LOG(LVL_VERBOSE, "**** #VMEXIT - exit code: %x\n",
 	       (u32) context->vmcb->exitcode);
 
+	/* CR3 is not intercepted with nested paging, keep our copy fresh */
+	if (context->nested_paging)
+		context->g_cr3 = context->vmcb->cr3;
+
 	switch (context->vmcb->exitcode) {
 	case VMEXIT_CR0_READ ... VMEXIT_CR15_READ:
 		__handle_crN_read(context);
@@ -1084,8 +1378,7 @@ void handle_vcpuexit(struct vcpu_hw_context *context)
 		break;
 
 	case VMEXIT_MSR:
-		if (context->vmcb->exitinfo1 == 1)
-			__handle_vm_wrmsr (context);
+		__handle_vm_msr(context);
 		break;
 
 	case VMEXIT_EXCEPTION_DE ... VMEXIT_EXCEPTION_XF:
@@ -1150,4 +1443,8 @@ void handle_vcpuexit(struct vcpu_hw_context *context)
 		if (context->vcpu_emergency_shutdown)
 			context->vcpu_emergency_shutdown(context);
 	}
+
+	vmm_manager_vcpu_exit_account(context->assoc_vcpu,
+				      vmexit_stats_reason(exitcode),
+				      context->exit_tstamp, emulate_tstamp);
 }
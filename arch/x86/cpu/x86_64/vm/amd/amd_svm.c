@@ -94,19 +94,36 @@ static void set_control_params (struct vcpu_hw_context *context)
 	struct vmcb *vmcb = context->vmcb;
 
 	/* Enable/disable nested paging (See AMD64 manual Vol. 2, p. 409) */
-	vmcb->np_enable = 0;
-	vmcb->tlb_control = 1; /* Flush all TLBs global/local/asid wide */
+	if (context->nested_paging) {
+		vmcb->np_enable = 1;
+		vmcb->n_cr3 = context->shadow_pgt->tbl_pa;
+		context->n_cr3 = vmcb->n_cr3;
+		vmcb->g_pat = 0x0007040600070406ULL;
+	} else {
+		vmcb->np_enable = 0;
+	}
+	/* ASID and TLB control are programmed before each VMRUN */
+	vmcb->tlb_control = TLB_CONTROL_DO_NOTHING;
 	vmcb->tsc_offset = 0;
-	vmcb->guest_asid = 1;
+	vmcb->guest_asid = 0;
 
 	/* enable EFLAGS.IF virtualization */
 	vmcb->vintr.fields.intr_masking = 1;
 
-	vmcb->cr_intercepts |= (INTRCPT_WRITE_CR3  | INTRCPT_READ_CR3 |
-				INTRCPT_WRITE_CR0  | INTRCPT_READ_CR0 |
-				INTRCPT_WRITE_CR2  | INTRCPT_READ_CR2 |
-				INTRCPT_WRITE_CR1  | INTRCPT_READ_CR1 |
-				INTRCPT_WRITE_CR4  | INTRCPT_READ_CR4);
+	if (context->nested_paging) {
+		/*
+		 * Guest owns CR2, CR3 and its page faults. Only CR0 and
+		 * CR4 writes are tracked to keep guest view in sync.
+		 */
+		vmcb->cr_intercepts |= (INTRCPT_WRITE_CR0 |
+					INTRCPT_WRITE_CR4);
+	} else {
+		vmcb->cr_intercepts |= (INTRCPT_WRITE_CR3  | INTRCPT_READ_CR3 |
+					INTRCPT_WRITE_CR0  | INTRCPT_READ_CR0 |
+					INTRCPT_WRITE_CR2  | INTRCPT_READ_CR2 |
+					INTRCPT_WRITE_CR1  | INTRCPT_READ_CR1 |
+					INTRCPT_WRITE_CR4  | INTRCPT_READ_CR4);
+	}
 
 	/* Intercept the VMRUN and VMMCALL instructions */
 	vmcb->general2_intercepts = (INTRCPT_VMRUN | INTRCPT_VMMCALL);
@@ -140,6 +157,12 @@ static void set_control_params (struct vcpu_hw_context *context)
 				       INTRCPT_EXC_PF);
 
 	vmcb->exception_intercepts = 0xffffffffUL;
+
+	if (context->nested_paging) {
+		vmcb->general1_intercepts &= ~(INTRCPT_INVLPG |
+					       INTRCPT_INVLPGA);
+		vmcb->exception_intercepts &= ~INTRCPT_EXC_PF;
+	}
 }
 
 static void set_vm_to_powerup_state(struct vcpu_hw_context *context)
@@ -150,22 +173,29 @@ static void set_vm_to_powerup_state(struct vcpu_hw_context *context)
 	context->g_cr0 = (X86_CR0_ET | X86_CR0_CD | X86_CR0_NW);
 	context->g_cr1 = context->g_cr2 = context->g_cr3 = 0;
 
-	/*
-	 * NOTE: X86_CR0_PG with disabled PE is a new mode in SVM. Its
-	 * called Paged Real Mode. It helps virtualization of the
-	 * Real mode boot. AMD PACIFICA SPEC Section 2.15.
-	 */
-	vmcb->cr0 = (X86_CR0_ET | X86_CR0_CD | X86_CR0_NW | X86_CR0_PG);
 	vmcb->cr2 = 0;
 	vmcb->cr4 = 0;
 	vmcb->rflags = 0x2;
 	vmcb->efer = EFER_SVME;
 
-	if (vmm_host_va2pa((virtual_addr_t)context->shadow32_pgt, &gcr3_pa) != VMM_OK)
-		vmm_panic("ERROR: Couldn't convert guest shadow table virtual address to physical!\n");
-
-	/* Since this VCPU is in power-up stage, two-fold 32-bit page table apply to it */
-	vmcb->cr3 = gcr3_pa;
+	if (context->nested_paging) {
+		/* Real mode guest physical is translated by nested table */
+		vmcb->cr0 = context->g_cr0;
+		vmcb->cr3 = 0;
+	} else {
+		/*
+		 * NOTE: X86_CR0_PG with disabled PE is a new mode in SVM. Its
+		 * called Paged Real Mode. It helps virtualization of the
+		 * Real mode boot. AMD PACIFICA SPEC Section 2.15.
+		 */
+		vmcb->cr0 = (X86_CR0_ET | X86_CR0_CD | X86_CR0_NW | X86_CR0_PG);
+
+		if (vmm_host_va2pa((virtual_addr_t)context->shadow32_pgt, &gcr3_pa) != VMM_OK)
+			vmm_panic("ERROR: Couldn't convert guest shadow table virtual address to physical!\n");
+
+		/* Since this VCPU is in power-up stage, two-fold 32-bit page table apply to it */
+		vmcb->cr3 = gcr3_pa;
+	}
 
 	/*
 	 * Make the CS.RIP point to 0xFFFF0. The reset vector. The Bios seems
@@ -301,9 +331,28 @@ static __unused void set_vm_to_mbr_start_state(struct vmcb* vmcb, enum svm_init_
 	}
 }
 
+static void svm_asid_refresh(struct vcpu_hw_context *context)
+{
+	struct vmcb *vmcb = context->vmcb;
+
+	vmcb->tlb_control = TLB_CONTROL_DO_NOTHING;
+
+	/* ASID 0 belongs to host */
+	if (cpu_vcpu_asid_refresh(context, context->cpuinfo->hw_nr_asids - 1))
+		vmcb->tlb_control = TLB_CONTROL_FLUSH_ALL;
+	else if (context->asid_flush)
+		vmcb->tlb_control = TLB_CONTROL_FLUSH_ASID;
+
+	context->asid_flush = FALSE;
+	vmcb->guest_asid = context->asid;
+}
+
 static void svm_run(struct vcpu_hw_context *context)
 {
+	vmm_manager_vcpu_exit_return(context->assoc_vcpu);
+
 	clgi();
+	svm_asid_refresh(context);
 	asm volatile ("push %%rbp \n\t"
 		      "mov %c[rbx](%[context]), %%rbx \n\t"
 		      "mov %c[rcx](%[context]), %%rcx \n\t"
@@ -366,6 +415,8 @@ static void svm_run(struct vcpu_hw_context *context)
 			, "r8", "r9", "r10", "r11" , "r12", "r13", "r14", "r15"
 		      );
 
+	context->exit_tstamp = vmm_manager_vcpu_exit_tstamp();
+
 	/* TR is not reloaded back the cpu after VM exit. */
 	reload_host_tss();
 
@@ -400,9 +451,12 @@ static int enable_svm (struct cpuinfo_x86 *c)
 		return VMM_EFAIL;
 	}
 
-	if (!c->hw_nested_paging)
+	if (!c->hw_nested_paging) {
 		VM_LOG(LVL_INFO, "Nested pagetables are not supported.\n"
 		       "Enabling software walking of page tables.\n");
+	} else {
+		VM_LOG(LVL_INFO, "Using nested pagetables for guests.\n");
+	}
 
 	/*
 	 * Before SVM instructions can be used, EFER.SVME must be set.
@@ -433,6 +487,9 @@ int amd_setup_vm_control(struct vcpu_hw_context *context)
 	if (vmm_host_va2pa((virtual_addr_t)context->vmcb, &context->vmcb_pa) != VMM_OK)
 		vmm_panic("Critical conversion of VMCB VA=>PA failed!\n");
 
+	/* Use nested paging whenever host supports it */
+	context->nested_paging = (context->cpuinfo->hw_nested_paging &&
+				  context->shadow_pgt) ? TRUE : FALSE;
 
 	/* Set control params for this VM */
 	set_control_params(context);
@@ -440,6 +497,9 @@ int amd_setup_vm_control(struct vcpu_hw_context *context)
 	if (context->icept_table.io_table_phys)
 		context->vmcb->iopm_base_pa = context->icept_table.io_table_phys;
 
+	if (context->icept_table.msr_table_phys)
+		context->vmcb->msrpm_base_pa = context->icept_table.msr_table_phys;
+
 	VM_LOG(LVL_INFO, "IOPM Base physical address: 0x%lx\n", context->vmcb->iopm_base_pa);
 
 	/*
@@ -0,0 +1,135 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.	 See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file intel_ept.c
+ * @author agent (agent@local)
+ * @brief Extended page table (EPT) management for VMX guests.
+ */
+
+#include <vmm_error.h>
+#include <vmm_types.h>
+#include <vmm_stdio.h>
+#include <vmm_manager.h>
+#include <vmm_guest_aspace.h>
+#include <cpu_mmu.h>
+#include <cpu_pgtbl_helper.h>
+#include <cpu_vm.h>
+#include <vm/intel_vmcs.h>
+#include <vm/intel_vmx.h>
+
+#define EPT_MT_UC		0
+#define EPT_MT_WB		6
+
+/*
+ * EPT entries share present (R), writeable (W) and user (X) bit
+ * positions with regular x86 page table entries, hence the generic
+ * page table helper is used to manage them with stage 2 tables.
+ */
+static void intel_ept_make_entry(union page *pg, physical_addr_t hphys,
+				 u32 reg_flags, bool huge)
+{
+	ept_entry_t e;
+
+	e.epte = 0;
+	e.r = 1;
+	e.w = (reg_flags & VMM_REGION_READONLY) ? 0 : 1;
+	e.x = 1;
+	e.emt = (reg_flags & VMM_REGION_CACHEABLE) ? EPT_MT_WB : EPT_MT_UC;
+	e.sp = (huge) ? 1 : 0;
+	e.mfn = (hphys & PAGE_MASK) >> PAGE_SHIFT;
+
+	pg->_val = e.epte;
+}
+
+u64 intel_ept_pointer(struct vcpu_hw_context *context)
+{
+	union vmx_ept_control ctl;
+
+	ctl.eptp = 0;
+	ctl.ept_mt = EPT_MT_WB;
+	ctl.ept_wl = PGTBL_LAST_LEVEL; /* Page-walk length - 1 */
+	ctl.asr = context->n_cr3 >> PAGE_SHIFT;
+
+	return ctl.eptp;
+}
+
+int intel_ept_init(struct vcpu_hw_context *context)
+{
+	if (!context->shadow_pgt) {
+		return VMM_EINVALID;
+	}
+
+	context->nested_paging = TRUE;
+	context->n_cr3 = context->shadow_pgt->tbl_pa;
+
+	return VMM_OK;
+}
+
+void intel_ept_flush(struct vcpu_hw_context *context)
+{
+	__invept(INVEPT_SINGLE_CONTEXT, intel_ept_pointer(context), 0);
+}
+
+/*
+ * Map the biggest block of guest RAM region around the faulting guest
+ * physical address which is aligned on both guest and host side.
+ * Clean pages of dirty logged range are mapped read-only as 4K pages.
+ */
+int intel_ept_map_fault(struct vcpu_hw_context *context,
+			physical_addr_t gphys, struct vmm_region *reg)
+{
+	int level, rc;
+	union page pg;
+	u32 reg_flags;
+	struct vmm_guest *guest = context->assoc_vcpu->guest;
+	physical_addr_t size, gbase, hbase;
+	physical_addr_t reg_end = reg->gphys_addr + reg->phys_size;
+
+	for (level = PGTBL_FIRST_LEVEL + 1; level < PGTBL_LAST_LEVEL; level++) {
+		if ((level == 1) && !cpu_has_vmx_ept_1GB)
+			continue;
+		if ((level == 2) && !cpu_has_vmx_ept_2MB)
+			continue;
+
+		size = mmu_level_block_size(level);
+		gbase = gphys & ~(size - 1);
+		hbase = reg->hphys_addr + (gbase - reg->gphys_addr);
+
+		if ((gbase < reg->gphys_addr) || ((gbase + size) > reg_end) ||
+		    (hbase & (size - 1)) ||
+		    vmm_guest_dirty_log_wprot(guest, gbase, size))
+			continue;
+
+		intel_ept_make_entry(&pg, hbase, reg->flags, TRUE);
+		rc = mmu_map_hugepage(&host_pgtbl_ctl, context->shadow_pgt,
+				      gbase, &pg, level);
+		if (rc == VMM_OK)
+			return VMM_OK;
+
+		/* Smaller mappings already exist in this block */
+	}
+
+	gbase = gphys & PAGE_MASK;
+	hbase = reg->hphys_addr + (gbase - reg->gphys_addr);
+	reg_flags = reg->flags;
+	if (vmm_guest_dirty_log_wprot(guest, gbase, PAGE_SIZE))
+		reg_flags |= VMM_REGION_READONLY;
+	intel_ept_make_entry(&pg, hbase, reg_flags, FALSE);
+
+	return mmu_map_page(&host_pgtbl_ctl, context->shadow_pgt, gbase, &pg);
+}
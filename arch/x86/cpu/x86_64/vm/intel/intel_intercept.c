@@ -33,10 +33,214 @@
 #include <arch_guest_helper.h>
 #include <vm/amd_intercept.h>
 #include <vm/amd_svm.h>
+#include <vm/intel_vmcs.h>
+#include <vm/intel_vmx.h>
 #include <vmm_devemu.h>
 #include <vmm_manager.h>
+#include <vmm_scheduler.h>
 #include <vmm_main.h>
 
+static int vmx_read_fault_inst(struct vcpu_hw_context *context,
+			       x86_inst *g_ins)
+{
+	physical_addr_t rip_phys;
+	struct vmm_guest *guest = context->assoc_vcpu->guest;
+	virtual_addr_t rip = __vmread(GUEST_CS_BASE) + __vmread(GUEST_RIP);
+
+	if (__vmread(GUEST_CR0) & X86_CR0_PG) {
+		if (lookup_guest_pagetable(context, rip, &rip_phys,
+					   NULL, NULL) != VMM_OK) {
+			VM_LOG(LVL_ERR, "Failed to convert guest virtual "
+			       "0x%"PRIADDR" to guest physical.\n", rip);
+			return VMM_EFAIL;
+		}
+	} else {
+		rip_phys = rip;
+	}
+
+	if (vmm_guest_memory_read(guest, rip_phys, g_ins, sizeof(x86_inst),
+				  TRUE) < sizeof(x86_inst)) {
+		VM_LOG(LVL_ERR, "Failed to read instruction at intercepted "
+		       "instruction pointer. (0x%"PRIPADDR")\n", rip_phys);
+		return VMM_EFAIL;
+	}
+
+	return VMM_OK;
+}
+
+static int vmx_emulate_mmio(struct vcpu_hw_context *context,
+			    physical_addr_t gphys)
+{
+	u64 data = 0;
+	x86_inst ins;
+	x86_decoded_inst_t dinst;
+	struct vmm_vcpu *vcpu = context->assoc_vcpu;
+
+	if (vmx_read_fault_inst(context, &ins) != VMM_OK)
+		return VMM_EFAIL;
+
+	if (x86_decode_inst_cached(context, __vmread(GUEST_RIP),
+				   __vmread(GUEST_CR3), ins, X86_MAX_INST_LEN,
+				   &dinst) != VMM_OK ||
+	    dinst.inst_type != INST_TYPE_MOV) {
+		VM_LOG(LVL_ERR, "Unsupported MMIO instruction at "
+		       "0x%lx.\n", __vmread(GUEST_RIP));
+		return VMM_EFAIL;
+	}
+
+	if (dinst.inst.gen_mov.src_type == OP_TYPE_MEM) {
+		if (dinst.inst.gen_mov.dst_addr >= RM_REG_MAX)
+			return VMM_EFAIL;
+		if (vmm_devemu_emulate_read(vcpu, gphys, &data,
+					    dinst.inst.gen_mov.op_size,
+					    VMM_DEVEMU_NATIVE_ENDIAN) != VMM_OK)
+			return VMM_EFAIL;
+		context->g_regs[dinst.inst.gen_mov.dst_addr] = data;
+	} else {
+		if (dinst.inst.gen_mov.src_type == OP_TYPE_IMM)
+			data = dinst.inst.gen_mov.src_addr;
+		else if (dinst.inst.gen_mov.src_addr < RM_REG_MAX)
+			data = context->g_regs[dinst.inst.gen_mov.src_addr];
+		else
+			return VMM_EFAIL;
+		if (vmm_devemu_emulate_write(vcpu, gphys, &data,
+					     dinst.inst.gen_mov.op_size,
+					     VMM_DEVEMU_NATIVE_ENDIAN) != VMM_OK)
+			return VMM_EFAIL;
+	}
+
+	__vmwrite(GUEST_RIP, __vmread(GUEST_RIP) +
+		  __vmread(VM_EXIT_INSTRUCTION_LEN));
+
+	return VMM_OK;
+}
+
+static void vmx_handle_ept_violation(struct vcpu_hw_context *context)
+{
+	struct vmm_region *g_reg;
+	struct vmm_guest *guest = context->assoc_vcpu->guest;
+	physical_addr_t gphys = __vmread(GUEST_PHYSICAL_ADDRESS);
+	unsigned long qual = __vmread(EXIT_QUALIFICATION);
+
+	vmm_manager_guest_boot_fault(guest);
+
+	g_reg = vmm_guest_find_region(guest, gphys, VMM_REGION_MEMORY, FALSE);
+	if (!g_reg) {
+		VM_LOG(LVL_ERR, "ERROR: No region mapped to guest physical: "
+		       "0x%"PRIPADDR"\n", gphys);
+		goto guest_bad_fault;
+	}
+
+	if (g_reg->flags & (VMM_REGION_REAL | VMM_REGION_ALIAS)) {
+		if ((qual & EPT_WRITE_VIOLATION) &&
+		    (g_reg->flags & VMM_REGION_READONLY)) {
+			VM_LOG(LVL_ERR, "ERROR: Write to read-only guest "
+			       "physical: 0x%"PRIPADDR"\n", gphys);
+			goto guest_bad_fault;
+		}
+
+		/* Present page faults on write only for dirty logging */
+		if ((qual & EPT_WRITE_VIOLATION) &&
+		    (dirty_guest_nested_map(context, gphys) == VMM_OK))
+			return;
+
+		if (intel_ept_map_fault(context, gphys, g_reg) != VMM_OK) {
+			VM_LOG(LVL_ERR, "ERROR: Failed to create EPT map for "
+			       "guest physical: 0x%"PRIPADDR"\n", gphys);
+			goto guest_bad_fault;
+		}
+	} else if (vmx_emulate_mmio(context, gphys) != VMM_OK) {
+		goto guest_bad_fault;
+	}
+
+	return;
+
+ guest_bad_fault:
+	if (context->vcpu_emergency_shutdown)
+		context->vcpu_emergency_shutdown(context);
+}
+
+/*
+ * Only MSRs not passed through in MSR bitmap reach here. Unknown
+ * MSRs read as zero and writes to them are ignored.
+ */
+static void vmx_handle_msr(struct vcpu_hw_context *context, bool write)
+{
+	u32 msr = (u32)context->g_regs[GUEST_REGS_RCX];
+	bool lapic_msr = ((msr == MSR_IA32_APICBASE) ||
+			  (msr == MSR_IA32_TSC_DEADLINE) ||
+			  ((msr >= APIC_X2APIC_MSR_BASE) &&
+			   (msr <= APIC_X2APIC_MSR_END))) ? TRUE : FALSE;
+	u64 val = 0;
+
+	if (write) {
+		val = ((u64)(u32)context->g_regs[GUEST_REGS_RDX] << 32) |
+			(u32)context->g_regs[GUEST_REGS_RAX];
+		if (lapic_msr ?
+		    guest_lapic_msr_write(context->assoc_vcpu, msr, val) :
+		    cpu_vcpu_pvclock_msr_write(context, msr, val))
+			VM_LOG(LVL_DEBUG, "Guest write to MSR 0x%x "
+			       "ignored\n", msr);
+	} else {
+		if (lapic_msr ?
+		    guest_lapic_msr_read(context->assoc_vcpu, msr, &val) :
+		    cpu_vcpu_pvclock_msr_read(context, msr, &val)) {
+			VM_LOG(LVL_DEBUG, "Guest read of MSR 0x%x\n", msr);
+			val = 0;
+		}
+		context->g_regs[GUEST_REGS_RAX] = (u32)val;
+		context->g_regs[GUEST_REGS_RDX] = (u32)(val >> 32);
+	}
+
+	__vmwrite(GUEST_RIP, __vmread(GUEST_RIP) +
+		  __vmread(VM_EXIT_INSTRUCTION_LEN));
+}
+
 void vmx_vcpu_exit(struct vcpu_hw_context *context)
 {
+	u64 exit_tstamp = vmm_manager_vcpu_exit_tstamp();
+	u32 reason = __vmread(VM_EXIT_REASON) & 0xffff;
+	u32 exit_reason = VMM_VCPU_EXIT_OTHER;
+
+	/* Guest owns its CR3 over EPT, keep our copy fresh */
+	context->g_cr3 = __vmread(GUEST_CR3);
+
+	switch (reason) {
+	case EXIT_REASON_EPT_VIOLATION:
+		exit_reason = VMM_VCPU_EXIT_MMIO;
+		vmx_handle_ept_violation(context);
+		break;
+
+	case EXIT_REASON_EPT_MISCONFIG:
+		VM_LOG(LVL_ERR, "EPT misconfiguration at guest physical: "
+		       "0x%lx\n", __vmread(GUEST_PHYSICAL_ADDRESS));
+		if (context->vcpu_emergency_shutdown)
+			context->vcpu_emergency_shutdown(context);
+		break;
+
+	case EXIT_REASON_MSR_READ:
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
+		vmx_handle_msr(context, FALSE);
+		break;
+
+	case EXIT_REASON_MSR_WRITE:
+		exit_reason = VMM_VCPU_EXIT_SYSREG;
+		vmx_handle_msr(context, TRUE);
+		break;
+
+	case EXIT_REASON_PAUSE_INSTRUCTION:
+		/* Pause-Loop Exiting: give up host CPU to a sibling */
+		exit_reason = VMM_VCPU_EXIT_WFI;
+		__vmwrite(GUEST_RIP, __vmread(GUEST_RIP) +
+			  __vmread(VM_EXIT_INSTRUCTION_LEN));
+		vmm_scheduler_yield_spin();
+		break;
+
+	default:
+		VM_LOG(LVL_DEBUG, "Unhandled VM exit reason: %d\n", reason);
+		break;
+	}
+
+	vmm_manager_vcpu_exit_account(context->assoc_vcpu, exit_reason,
+				      exit_tstamp, exit_tstamp);
 }
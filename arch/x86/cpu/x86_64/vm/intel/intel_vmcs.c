@@ -50,8 +50,8 @@ static int __unused __read_mostly opt_unrestricted_guest_enabled = 1;
  * Time is measured based on a counter that runs at the same rate as the TSC,
  * refer SDM volume 3b section 21.6.13 & 22.1.3.
  */
-static unsigned int __unused __read_mostly ple_gap = 41;
-static unsigned int __unused __read_mostly ple_window = 4096;
+static unsigned int __read_mostly ple_gap = 41;
+static unsigned int __read_mostly ple_window = 4096;
 
 static u32 vmx_basic_msr_low __read_mostly;
 static u32 vmx_basic_msr_high __read_mostly;
@@ -185,6 +185,7 @@ void vmx_detect_capability(void)
 		    & (SECONDARY_EXEC_ENABLE_EPT
 		       | SECONDARY_EXEC_ENABLE_VPID)) {
 			vmx_ept_vpid_cap = cpu_read_msr(MSR_IA32_VMX_EPT_VPID_CAP);
+			cpu_has_vmx_ept_2mb = !!cpu_has_vmx_ept_2MB;
 		}
 	}
 
@@ -316,42 +317,38 @@ void vmx_set_control_params(struct vcpu_hw_context *context)
 	/* IO bitmap */
 	vmx_cpu_based_exec_control |= CPU_BASED_ACTIVATE_IO_BITMAP;
 
-        /* A and B - 4K each */
-	context->icept_table.io_table_phys =
-		cpu_create_vcpu_intercept_table(VMM_SIZE_TO_PAGE(8 << 10),
-						&context->icept_table.io_table_virt);
+	/* A and B - 4K each, in common IO intercept table */
+	__vmwrite(IO_BITMAP_A, context->icept_table.io_table_phys);
+	__vmwrite(IO_BITMAP_B, context->icept_table.io_table_phys + VMM_PAGE_SIZE);
 
-	__vmwrite(IO_BITMAP_A, context->icept_table.io_table_virt);
-	__vmwrite(IO_BITMAP_B, context->icept_table.io_table_virt + VMM_PAGE_SIZE);
-
-	/* MSR bitmap */
+	/* MSR bitmap (4K) in common MSR intercept table */
 	vmx_cpu_based_exec_control |= CPU_BASED_ACTIVATE_MSR_BITMAP;
 
-	context->icept_table.msr_table_phys =
-		cpu_create_vcpu_intercept_table(VMM_SIZE_TO_PAGE(4 << 10),
-						&context->icept_table.msr_table_virt);
-
-	__vmwrite(MSR_BITMAP, context->icept_table.msr_table_virt);
+	__vmwrite(MSR_BITMAP, context->icept_table.msr_table_phys);
 
 	__vmwrite(CPU_BASED_VM_EXEC_CONTROL, vmx_cpu_based_exec_control);
 
-#if defined(CONFIG_SLAT_SUPPORT)
 	/* Enable Extended Page Table (nested paging) */
 	vmx_secondary_exec_control |= SECONDARY_EXEC_ENABLE_EPT;
 
-	// setup eptp
-	vmx_ept_control.ept_mt = 6; // Memory type WriteBack
-	vmx_ept_control.ept_wl = 3; // Page-walk length-1
-	vmx_ept_control.rsvd = 0; // reserved
-	vmx_ept_control.asr = context->n_cr3; // nested cr3
+	__vmwrite(EPT_POINTER, intel_ept_pointer(context));
 
-	__vmwrite(EPT_POINTER, vmx_ept_control.eptp);
-#endif
+	/* Let guest run real mode and unpaged protected mode over EPT */
+	vmx_secondary_exec_control |= SECONDARY_EXEC_UNRESTRICTED_GUEST;
 
 	/* Enable Virtual-Processor Identification (asid) */
 	vmx_secondary_exec_control |= SECONDARY_EXEC_ENABLE_VPID;
 
-	__vmwrite(VIRTUAL_PROCESSOR_ID, 1);
+	/* VPID is allocated per host CPU before each VM entry */
+	__vmwrite(VIRTUAL_PROCESSOR_ID, 0);
+
+	__vmwrite(SECONDARY_VM_EXEC_CONTROL, vmx_secondary_exec_control);
+
+	/* Detect guest spinning on a lock held by a preempted VCPU */
+	if (cpu_has_vmx_ple) {
+		__vmwrite(PLE_GAP, ple_gap);
+		__vmwrite(PLE_WINDOW, ple_window);
+	}
 
 	/* Initialize vm exit controls */
 	vmx_vmexit_control |= (VM_EXIT_IA32E_MODE | VM_EXIT_ACK_INTR_ON_EXIT);
@@ -411,9 +408,6 @@ void vmx_disable_intercept_for_msr(struct vcpu_hw_context *context, u32 msr)
 
 void vmx_set_vm_to_powerup_state(struct vcpu_hw_context *context)
 {
-	physical_addr_t gcr3_pa;
-	struct vmcb *vmcb = context->vmcb;
-
 	/* MSR intercepts. */
 	__vmwrite(VM_EXIT_MSR_LOAD_COUNT, 0);
 	__vmwrite(VM_EXIT_MSR_STORE_COUNT, 0);
@@ -497,7 +491,8 @@ void vmx_set_vm_to_powerup_state(struct vcpu_hw_context *context)
 	__vmwrite(EXCEPTION_BITMAP, 0);
 
 	/* Control registers */
-	__vmwrite(GUEST_CR0, (X86_CR0_ET | X86_CR0_CD | X86_CR0_NW | X86_CR0_PG));
+	/* Real mode guest physical is translated by EPT */
+	__vmwrite(GUEST_CR0, (X86_CR0_ET | X86_CR0_CD | X86_CR0_NW));
 	__vmwrite(GUEST_CR3, 0);
 	__vmwrite(GUEST_CR4, 0);
 
@@ -517,15 +512,6 @@ void vmx_set_vm_to_powerup_state(struct vcpu_hw_context *context)
 
 	context->g_cr0 = (X86_CR0_ET | X86_CR0_CD | X86_CR0_NW);
 	context->g_cr1 = context->g_cr2 = context->g_cr3 = 0;
-
-        /* Allocate shadow page table if we are not using SLAT */
-#if !defined(CONFIG_SLAT_SUPPORT)
-	if (vmm_host_va2pa((virtual_addr_t)context->shadow32_pgt, &gcr3_pa) != VMM_OK)
-		vmm_panic("ERROR: Couldn't convert guest shadow table virtual address to physical!\n");
-
-	/* Since this VCPU is in power-up stage, two-fold 32-bit page table apply to it */
-	vmcb->cr3 = gcr3_pa;
-#endif
 }
 
 void vmx_set_vm_to_mbr_start_state(struct vcpu_hw_context *context)
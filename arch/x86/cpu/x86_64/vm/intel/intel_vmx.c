@@ -21,6 +21,7 @@
 #include <vmm_types.h>
 #include <vmm_error.h>
 #include <vmm_host_aspace.h>
+#include <vmm_smp.h>
 #include <libs/bitops.h>
 #include <libs/stringlib.h>
 #include <cpu_features.h>
@@ -62,6 +63,12 @@ static int enable_vmx (struct cpuinfo_x86 *cpuinfo)
 		return VMM_EFAIL;
 	}
 
+	/* EPT tables are 4-level and write-back cacheable */
+	if (!cpu_has_vmx_ept_wl4_supported || !cpu_has_vmx_ept_mt_wb) {
+		vmm_printf("No 4-level write-back EPT support!\n");
+		return VMM_EFAIL;
+	}
+
 	/* Enable VMX operation */
 	set_in_cr4(X86_CR4_VMXE);
 
@@ -113,8 +120,32 @@ static int enable_vmx (struct cpuinfo_x86 *cpuinfo)
 	return VMM_OK;
 }
 
+static void vmx_vpid_refresh(struct vcpu_hw_context *context)
+{
+	if (cpu_vcpu_asid_refresh(context, (1UL << VMCS_VPID_WIDTH) - 1)) {
+		vpid_sync_all();
+	} else if (context->asid_flush) {
+		if (cpu_has_vmx_vpid_invvpid_single_context)
+			__invvpid(INVVPID_SINGLE_CONTEXT, context->asid, 0);
+		else
+			vpid_sync_all();
+	}
+
+	context->asid_flush = FALSE;
+	__vmwrite(VIRTUAL_PROCESSOR_ID, context->asid);
+}
+
 static void vmx_vcpu_run(struct vcpu_hw_context *context)
 {
+	/*
+	 * Guest physical mappings are tagged with EPTP and not VPID,
+	 * flush them upon request or when VCPU moved to this host CPU.
+	 */
+	if (context->asid_flush ||
+	    (context->asid_hcpu != vmm_smp_processor_id()))
+		intel_ept_flush(context);
+
+	vmx_vpid_refresh(context);
 }
 
 int intel_setup_vm_control(struct vcpu_hw_context *context)
@@ -163,6 +194,12 @@ int intel_setup_vm_control(struct vcpu_hw_context *context)
 	/* VMPTRLD: mark this vmcs active, current & clear */
 	__vmptrld(context->vmcs_pa);
 
+	/* Guest physical memory is translated by EPT */
+	if ((ret = intel_ept_init(context)) != VMM_OK) {
+		vmm_printf("Failed to setup EPT.\n");
+		goto _fail;
+	}
+
 	vmx_set_control_params(context);
 
 	vmx_set_vm_to_powerup_state(context);
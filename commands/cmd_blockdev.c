@@ -28,6 +28,7 @@
 #include <vmm_cmdmgr.h>
 #include <vmm_heap.h>
 #include <block/vmm_blockdev.h>
+#include <block/vmm_blockcache.h>
 #include <libs/stringlib.h>
 
 #define MODULE_DESC			"Command blockdev"
@@ -44,11 +45,15 @@ static void cmd_blockdev_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   blockdev list\n");
 	vmm_cprintf(cdev, "   blockdev info <name>\n");
 	vmm_cprintf(cdev, "   blockdev dump8 <name> [length] [offset]\n");
+	vmm_cprintf(cdev, "   blockdev cache <name> <size_kb> [wt|wb]\n");
+	vmm_cprintf(cdev, "   blockdev uncache <name>\n");
 }
 
 static int cmd_blockdev_info(struct vmm_chardev *cdev,
 			     struct vmm_blockdev *bdev)
 {
+	struct vmm_blockcache_stats stats;
+
 	vmm_cprintf(cdev, "Name       : %s\n", bdev->name);
 	vmm_cprintf(cdev, "Parent     : %s\n",
 				(bdev->parent) ? bdev->parent->name : "---");
@@ -59,9 +64,68 @@ static int cmd_blockdev_info(struct vmm_chardev *cdev,
 	vmm_cprintf(cdev, "Block Size : %"PRIu32"\n", bdev->block_size);
 	vmm_cprintf(cdev, "Block Count: %"PRIu64"\n", bdev->num_blocks);
 
+	if (vmm_blockcache_get_stats(bdev, &stats) == VMM_OK) {
+		vmm_cprintf(cdev, "Cache Mode : %s\n",
+			(stats.mode == VMM_BLOCKCACHE_WRITEBACK) ?
+			"Write-Back" : "Write-Through");
+		vmm_cprintf(cdev, "Cache Pages: %"PRIu32" used, %"PRIu32
+			    " dirty, %"PRIu32" total\n", stats.used_count,
+			    stats.dirty_count, stats.page_count);
+		vmm_cprintf(cdev, "Cache Stats: %"PRIu64" hits, %"PRIu64
+			    " misses\n", stats.hits, stats.misses);
+	}
+
 	return VMM_OK;
 }
 
+static int cmd_blockdev_cache(struct vmm_chardev *cdev,
+			      struct vmm_blockdev *bdev,
+			      int argc, char *argv[])
+{
+	int rc;
+	u32 size_kb;
+	enum vmm_blockcache_mode mode = VMM_BLOCKCACHE_WRITETHROUGH;
+
+	if (argc < 1) {
+		cmd_blockdev_usage(cdev);
+		return VMM_EFAIL;
+	}
+	size_kb = strtoul(argv[0], NULL, 10);
+
+	if (argc >= 2) {
+		if (strcmp(argv[1], "wb") == 0) {
+			mode = VMM_BLOCKCACHE_WRITEBACK;
+		} else if (strcmp(argv[1], "wt") != 0) {
+			cmd_blockdev_usage(cdev);
+			return VMM_EFAIL;
+		}
+	}
+
+	rc = vmm_blockcache_enable(bdev, size_kb, mode);
+	if (rc) {
+		vmm_cprintf(cdev, "Error: failed to enable cache (error %d)\n",
+			    rc);
+	}
+
+	return rc;
+}
+
+static int cmd_blockdev_uncache(struct vmm_chardev *cdev,
+				struct vmm_blockdev *bdev)
+{
+	int rc = vmm_blockcache_disable(bdev);
+
+	if (rc == VMM_EBUSY) {
+		vmm_cprintf(cdev, "Error: cache busy, writeback started "
+				  "so try again later\n");
+	} else if (rc) {
+		vmm_cprintf(cdev, "Error: failed to disable cache "
+				  "(error %d)\n", rc);
+	}
+
+	return rc;
+}
+
 static int cmd_blockdev_list_iter(struct vmm_blockdev *bdev, void *data)
 {
 	struct vmm_chardev *cdev = data;
@@ -167,6 +231,11 @@ static int cmd_blockdev_exec(struct vmm_chardev *cdev, int argc, char **argv)
 		} else if (strcmp(argv[1], "dump8") == 0) {
 			return cmd_blockdev_dump8(cdev, bdev,
 						 argc - 3, argv + 3);
+		} else if (strcmp(argv[1], "cache") == 0) {
+			return cmd_blockdev_cache(cdev, bdev,
+						  argc - 3, argv + 3);
+		} else if (strcmp(argv[1], "uncache") == 0) {
+			return cmd_blockdev_uncache(cdev, bdev);
 		}
 	}
 	cmd_blockdev_usage(cdev);
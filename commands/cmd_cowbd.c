@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_cowbd.c
+ * @author agent (agent@local)
+ * @brief Implementation of cowbd command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <libs/stringlib.h>
+#include <drv/cowbd.h>
+
+#define MODULE_DESC			"Command cowbd"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_cowbd_init
+#define	MODULE_EXIT			cmd_cowbd_exit
+
+static void cmd_cowbd_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   cowbd help\n");
+	vmm_cprintf(cdev, "   cowbd list\n");
+	vmm_cprintf(cdev, "   cowbd create <name> <base_blockdev_name>\n");
+	vmm_cprintf(cdev, "   cowbd reset <name>\n");
+	vmm_cprintf(cdev, "   cowbd destroy <name>\n");
+}
+
+static int cmd_cowbd_list(struct vmm_chardev *cdev)
+{
+	int num, count;
+	struct cowbd *d;
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " %-32s %-32s %-12s\n",
+			  "Name", "Base", "Overlay (KB)");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	count = cowbd_count();
+	for (num = 0; num < count; num++) {
+		d = cowbd_get(num);
+		vmm_cprintf(cdev, " %-32s %-32s %-12d\n",
+			    d->bdev->name,
+			    (d->base) ? d->base->name : "---",
+			    (int)(d->chunk_count * (COWBD_CHUNK_SIZE / 1024)));
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+
+	return VMM_OK;
+}
+
+static int cmd_cowbd_create(struct vmm_chardev *cdev, const char *name,
+			    const char *base_name)
+{
+	struct cowbd *d;
+
+	d = cowbd_create(name, base_name);
+	if (!d) {
+		vmm_cprintf(cdev, "Failed to create %s COWBD instance\n",
+			    name);
+		return VMM_EFAIL;
+	}
+
+	vmm_cprintf(cdev, "Created %s COWBD instance\n", name);
+
+	return VMM_OK;
+}
+
+static int cmd_cowbd_reset(struct vmm_chardev *cdev, const char *name)
+{
+	struct cowbd *d = cowbd_find(name);
+
+	if (!d) {
+		vmm_cprintf(cdev, "Failed to find %s COWBD instance\n", name);
+		return VMM_ENOTAVAIL;
+	}
+
+	cowbd_reset(d);
+
+	vmm_cprintf(cdev, "Reset %s COWBD instance\n", name);
+
+	return VMM_OK;
+}
+
+static int cmd_cowbd_destroy(struct vmm_chardev *cdev, const char *name)
+{
+	int rc;
+	struct cowbd *d = cowbd_find(name);
+
+	if (!d) {
+		vmm_cprintf(cdev, "Failed to find %s COWBD instance\n", name);
+		return VMM_ENOTAVAIL;
+	}
+
+	rc = cowbd_destroy(d);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to destroy %s COWBD instance "
+			    "(error %d)\n", name, rc);
+		return rc;
+	}
+
+	vmm_cprintf(cdev, "Destroyed %s COWBD instance\n", name);
+
+	return VMM_OK;
+}
+
+static int cmd_cowbd_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	if (argc <= 1) {
+		goto fail;
+	}
+
+	if (strcmp(argv[1], "help") == 0) {
+		cmd_cowbd_usage(cdev);
+		return VMM_OK;
+	} else if ((strcmp(argv[1], "list") == 0) && (argc == 2)) {
+		return cmd_cowbd_list(cdev);
+	} else if ((strcmp(argv[1], "create") == 0) && (argc == 4)) {
+		return cmd_cowbd_create(cdev, argv[2], argv[3]);
+	} else if ((strcmp(argv[1], "reset") == 0) && (argc == 3)) {
+		return cmd_cowbd_reset(cdev, argv[2]);
+	} else if ((strcmp(argv[1], "destroy") == 0) && (argc == 3)) {
+		return cmd_cowbd_destroy(cdev, argv[2]);
+	}
+
+fail:
+	cmd_cowbd_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_cowbd = {
+	.name = "cowbd",
+	.desc = "copy-on-write block device commands",
+	.usage = cmd_cowbd_usage,
+	.exec = cmd_cowbd_exec,
+};
+
+static int __init cmd_cowbd_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_cowbd);
+}
+
+static void __exit cmd_cowbd_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_cowbd);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -0,0 +1,194 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_ethtool.c
+ * @author agent (agent@local)
+ * @brief Implementation of ethtool command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <libs/stringlib.h>
+
+#include <linux/netdevice.h>
+#include <linux/ethtool.h>
+
+#define MODULE_DESC			"Command ethtool"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_ethtool_init
+#define	MODULE_EXIT			cmd_ethtool_exit
+
+struct cmd_ethtool_coalesce_param {
+	const char *name;
+	size_t offset;
+};
+
+#define COALESCE_PARAM(__name, __field)	\
+	{ __name, offsetof(struct ethtool_coalesce, __field) }
+
+static const struct cmd_ethtool_coalesce_param coalesce_params[] = {
+	COALESCE_PARAM("rx-usecs", rx_coalesce_usecs),
+	COALESCE_PARAM("rx-frames", rx_max_coalesced_frames),
+	COALESCE_PARAM("tx-usecs", tx_coalesce_usecs),
+	COALESCE_PARAM("tx-frames", tx_max_coalesced_frames),
+	COALESCE_PARAM("adaptive-rx", use_adaptive_rx_coalesce),
+	COALESCE_PARAM("pkt-rate-low", pkt_rate_low),
+	COALESCE_PARAM("rx-usecs-low", rx_coalesce_usecs_low),
+	COALESCE_PARAM("rx-frames-low", rx_max_coalesced_frames_low),
+	COALESCE_PARAM("pkt-rate-high", pkt_rate_high),
+	COALESCE_PARAM("rx-usecs-high", rx_coalesce_usecs_high),
+	COALESCE_PARAM("rx-frames-high", rx_max_coalesced_frames_high),
+	COALESCE_PARAM("sample-interval", rate_sample_interval),
+};
+
+static void cmd_ethtool_usage(struct vmm_chardev *cdev)
+{
+	u32 i;
+
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   ethtool help\n");
+	vmm_cprintf(cdev, "   ethtool coalesce <netdev>\n");
+	vmm_cprintf(cdev, "   ethtool coalesce <netdev> <param> <value> "
+			  "[<param> <value>] ...\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   Coalesce <param> can be:");
+	for (i = 0; i < array_size(coalesce_params); i++) {
+		if (!(i % 4)) {
+			vmm_cprintf(cdev, "\n     ");
+		}
+		vmm_cprintf(cdev, " %s", coalesce_params[i].name);
+	}
+	vmm_cprintf(cdev, "\n");
+	vmm_cprintf(cdev, "   Packet rates are in packets per second and "
+			  "sample-interval is in seconds\n");
+}
+
+static u32 *cmd_ethtool_coalesce_field(struct ethtool_coalesce *ec,
+					const char *name)
+{
+	u32 i;
+
+	for (i = 0; i < array_size(coalesce_params); i++) {
+		if (!strcmp(coalesce_params[i].name, name)) {
+			return (u32 *)((u8 *)ec + coalesce_params[i].offset);
+		}
+	}
+
+	return NULL;
+}
+
+static int cmd_ethtool_coalesce(struct vmm_chardev *cdev,
+				int argc, char **argv)
+{
+	int i, rc;
+	u32 *field;
+	struct net_device *ndev;
+	struct ethtool_coalesce ec;
+
+	ndev = ethtool_netdev_find(argv[2]);
+	if (!ndev) {
+		vmm_cprintf(cdev, "Failed to find netdev %s\n", argv[2]);
+		return VMM_ENOTAVAIL;
+	}
+
+	rc = ethtool_get_coalesce(ndev, &ec);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to get coalesce parameters "
+			    "of %s (error %d)\n", argv[2], rc);
+		return rc;
+	}
+
+	if (argc == 3) {
+		for (i = 0; i < array_size(coalesce_params); i++) {
+			field = cmd_ethtool_coalesce_field(&ec,
+						coalesce_params[i].name);
+			vmm_cprintf(cdev, "%-16s: %u\n",
+				    coalesce_params[i].name, *field);
+		}
+		return VMM_OK;
+	}
+
+	if (argc % 2) {
+		cmd_ethtool_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	for (i = 3; i < argc; i += 2) {
+		field = cmd_ethtool_coalesce_field(&ec, argv[i]);
+		if (!field) {
+			vmm_cprintf(cdev, "Unknown coalesce parameter %s\n",
+				    argv[i]);
+			return VMM_EINVALID;
+		}
+		*field = (u32)atoi(argv[i + 1]);
+	}
+
+	rc = ethtool_set_coalesce(ndev, &ec);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to set coalesce parameters "
+			    "of %s (error %d)\n", argv[2], rc);
+	}
+
+	return rc;
+}
+
+static int cmd_ethtool_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	if (argc < 2) {
+		goto fail;
+	}
+
+	if (strcmp(argv[1], "help") == 0) {
+		cmd_ethtool_usage(cdev);
+		return VMM_OK;
+	} else if ((strcmp(argv[1], "coalesce") == 0) && (argc >= 3)) {
+		return cmd_ethtool_coalesce(cdev, argc, argv);
+	}
+
+fail:
+	cmd_ethtool_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_ethtool = {
+	.name = "ethtool",
+	.desc = "query or control network device settings",
+	.usage = cmd_ethtool_usage,
+	.exec = cmd_ethtool_exec,
+};
+
+static int __init cmd_ethtool_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_ethtool);
+}
+
+static void __exit cmd_ethtool_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_ethtool);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
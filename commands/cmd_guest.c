@@ -30,7 +30,10 @@
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
 #include <vmm_devemu.h>
+#include <vmm_schedalgo.h>
+#include <vmm_heap.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 
 #define MODULE_DESC			"Command guest"
 #define MODULE_AUTHOR			"Anup Patel"
@@ -44,19 +47,33 @@ static void cmd_guest_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "Usage:\n");
 	vmm_cprintf(cdev, "   guest help\n");
 	vmm_cprintf(cdev, "   guest list\n");
-	vmm_cprintf(cdev, "   guest create  <guest_name>\n");
+	vmm_cprintf(cdev, "   guest create  <guest_name> ...\n");
+	vmm_cprintf(cdev, "   guest clone   <guest_name> <clone_name>\n");
 	vmm_cprintf(cdev, "   guest destroy <guest_name>\n");
-	vmm_cprintf(cdev, "   guest reset   <guest_name>\n");
-	vmm_cprintf(cdev, "   guest kick    <guest_name>\n");
+	vmm_cprintf(cdev, "   guest reset   <guest_name> ...\n");
+	vmm_cprintf(cdev, "   guest kick    <guest_name> ...\n");
 	vmm_cprintf(cdev, "   guest pause   <guest_name>\n");
 	vmm_cprintf(cdev, "   guest resume  <guest_name>\n");
 	vmm_cprintf(cdev, "   guest halt    <guest_name>\n");
 	vmm_cprintf(cdev, "   guest dumpmem <guest_name> <gphys_addr> "
 			  "[mem_sz]\n");
 	vmm_cprintf(cdev, "   guest region  <guest_name> <gphys_addr>\n");
+	vmm_cprintf(cdev, "   guest sched   <guest_name> [<weight> <cap>]\n");
+#ifdef CONFIG_GUEST_BOOT_STATS
+	vmm_cprintf(cdev, "   guest boottime <guest_name>\n");
+#endif
 	vmm_cprintf(cdev, "Note:\n");
 	vmm_cprintf(cdev, "   <guest_name> = node name under /guests "
 			  "device tree node\n");
+	vmm_cprintf(cdev, "   create, reset and kick accept multiple "
+			  "<guest_name> having '*' and '?' wildcards\n");
+	vmm_cprintf(cdev, "   <weight>     = scheduling weight "
+			  "(%d to %d, default %d)\n",
+			  VMM_GUEST_MIN_SCHED_WEIGHT,
+			  VMM_GUEST_MAX_SCHED_WEIGHT,
+			  VMM_GUEST_DEF_SCHED_WEIGHT);
+	vmm_cprintf(cdev, "   <cap>        = scheduling cap in percentage "
+			  "of one host CPU (0 = no cap)\n");
 }
 
 static int guest_list_iter(struct vmm_guest *guest, void *priv)
@@ -91,30 +108,124 @@ static void cmd_guest_list(struct vmm_chardev *cdev)
 			  "---------------------------------------\n");
 }
 
-static int cmd_guest_create(struct vmm_chardev *cdev, const char *name)
+/* Match name against pattern having '*' and '?' wildcards */
+static bool cmd_guest_match(const char *pat, const char *name)
 {
-	struct vmm_guest *guest = NULL;
+	while (*pat) {
+		if (*pat == '*') {
+			while (*pat == '*') {
+				pat++;
+			}
+			if (!*pat) {
+				return TRUE;
+			}
+			for (; *name; name++) {
+				if (cmd_guest_match(pat, name)) {
+					return TRUE;
+				}
+			}
+			return FALSE;
+		}
+		if (!*name || ((*pat != '?') && (*pat != *name))) {
+			return FALSE;
+		}
+		pat++;
+		name++;
+	}
+
+	return (*name) ? FALSE : TRUE;
+}
+
+static bool cmd_guest_match_any(int count, char **pats, const char *name)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (cmd_guest_match(pats[i], name)) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static int cmd_guest_create(struct vmm_chardev *cdev, int count, char **names)
+{
+	int ret = VMM_OK;
+	u32 i, found = 0, created;
+	struct vmm_guest **guests;
+	struct vmm_devtree_node **nodes;
 	struct vmm_devtree_node *pnode = NULL, *node = NULL;
 
+	nodes = vmm_zalloc(CONFIG_MAX_GUEST_COUNT * sizeof(*nodes));
+	guests = vmm_zalloc(CONFIG_MAX_GUEST_COUNT * sizeof(*guests));
+	if (!nodes || !guests) {
+		ret = VMM_ENOMEM;
+		goto done;
+	}
+
+	/* Find guest nodes which are not yet created */
 	pnode = vmm_devtree_getnode(VMM_DEVTREE_PATH_SEPARATOR_STRING
 					VMM_DEVTREE_GUESTINFO_NODE_NAME);
-	node = vmm_devtree_getchild(pnode, name);
+	vmm_devtree_for_each_child(node, pnode) {
+		if ((found < CONFIG_MAX_GUEST_COUNT) &&
+		    cmd_guest_match_any(count, names, node->name) &&
+		    !vmm_manager_guest_find(node->name)) {
+			vmm_devtree_ref_node(node);
+			nodes[found++] = node;
+		}
+	}
 	vmm_devtree_dref_node(pnode);
-	if (!node) {
-		vmm_cprintf(cdev, "Error: failed to find %s node under %s\n",
-				  name, VMM_DEVTREE_PATH_SEPARATOR_STRING
+	if (!found) {
+		vmm_cprintf(cdev, "Error: failed to find matching node "
+				  "(not yet created) under %s\n",
+				  VMM_DEVTREE_PATH_SEPARATOR_STRING
 					VMM_DEVTREE_GUESTINFO_NODE_NAME);
-		return VMM_EFAIL;
+		ret = VMM_EFAIL;
+		goto done;
+	}
+
+	created = vmm_manager_guest_create_batch(nodes, guests, found);
+	for (i = 0; i < found; i++) {
+		if (guests[i]) {
+			vmm_cprintf(cdev, "%s: Created\n", nodes[i]->name);
+		} else {
+			vmm_cprintf(cdev, "%s: Failed to create\n",
+				    nodes[i]->name);
+		}
+		vmm_devtree_dref_node(nodes[i]);
 	}
+	if (created < found) {
+		ret = VMM_EFAIL;
+	}
+
+done:
+	if (guests) {
+		vmm_free(guests);
+	}
+	if (nodes) {
+		vmm_free(nodes);
+	}
+	return ret;
+}
+
+static int cmd_guest_clone(struct vmm_chardev *cdev, const char *name,
+			   const char *clone_name)
+{
+	struct vmm_guest *guest = vmm_manager_guest_find(name);
 
-	guest = vmm_manager_guest_create(node);
-	vmm_devtree_dref_node(node);
 	if (!guest) {
-		vmm_cprintf(cdev, "%s: Failed to create\n", name);
+		vmm_cprintf(cdev, "Failed to find guest\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	if (!vmm_manager_guest_clone(guest, clone_name)) {
+		vmm_cprintf(cdev, "%s: Failed to clone %s\n",
+			    clone_name, name);
 		return VMM_EFAIL;
 	}
 
-	vmm_cprintf(cdev, "%s: Created\n", name);
+	vmm_cprintf(cdev, "%s: Cloned from %s\n", clone_name, name);
 
 	return VMM_OK;
 }
@@ -138,44 +249,76 @@ static int cmd_guest_destroy(struct vmm_chardev *cdev, const char *name)
 	return ret;
 }
 
-static int cmd_guest_reset(struct vmm_chardev *cdev, const char *name)
-{
-	int ret;
-	struct vmm_guest *guest = vmm_manager_guest_find(name);
+struct cmd_guest_collect {
+	int count;
+	char **names;
+	u32 found;
+	struct vmm_guest **guests;
+};
 
-	if (!guest) {
-		vmm_cprintf(cdev, "Failed to find guest\n");
-		return VMM_ENOTAVAIL;
-	}
+static int cmd_guest_collect_iter(struct vmm_guest *guest, void *priv)
+{
+	struct cmd_guest_collect *c = priv;
 
-	if ((ret = vmm_manager_guest_reset(guest))) {
-		vmm_cprintf(cdev, "%s: Failed to reset\n", name);
-	} else {
-		vmm_cprintf(cdev, "%s: Reset\n", name);
+	if ((c->found < CONFIG_MAX_GUEST_COUNT) &&
+	    cmd_guest_match_any(c->count, c->names, guest->name)) {
+		c->guests[c->found++] = guest;
 	}
 
-	return ret;
+	return VMM_OK;
 }
 
-static int cmd_guest_kick(struct vmm_chardev *cdev, const char *name)
+/* Apply operation on all matching guests outside manager lock */
+static int cmd_guest_foreach(struct vmm_chardev *cdev, int count, char **names,
+			     int (*func)(struct vmm_guest *),
+			     const char *done_msg, const char *fail_msg)
 {
-	int ret;
-	struct vmm_guest *guest = vmm_manager_guest_find(name);
+	u32 i;
+	int rc, ret = VMM_OK;
+	struct cmd_guest_collect c;
+
+	c.count = count;
+	c.names = names;
+	c.found = 0;
+	c.guests = vmm_zalloc(CONFIG_MAX_GUEST_COUNT * sizeof(*c.guests));
+	if (!c.guests) {
+		return VMM_ENOMEM;
+	}
 
-	if (!guest) {
+	vmm_manager_guest_iterate(cmd_guest_collect_iter, &c);
+	if (!c.found) {
 		vmm_cprintf(cdev, "Failed to find guest\n");
-		return VMM_ENOTAVAIL;
+		ret = VMM_ENOTAVAIL;
 	}
 
-	if ((ret = vmm_manager_guest_kick(guest))) {
-		vmm_cprintf(cdev, "%s: Failed to kick\n", name);
-	} else {
-		vmm_cprintf(cdev, "%s: Kicked\n", name);
+	for (i = 0; i < c.found; i++) {
+		if ((rc = func(c.guests[i]))) {
+			vmm_cprintf(cdev, "%s: %s\n",
+				    c.guests[i]->name, fail_msg);
+			ret = rc;
+		} else {
+			vmm_cprintf(cdev, "%s: %s\n",
+				    c.guests[i]->name, done_msg);
+		}
 	}
 
+	vmm_free(c.guests);
+
 	return ret;
 }
 
+static int cmd_guest_reset(struct vmm_chardev *cdev, int count, char **names)
+{
+	return cmd_guest_foreach(cdev, count, names, vmm_manager_guest_reset,
+				 "Reset", "Failed to reset");
+}
+
+static int cmd_guest_kick(struct vmm_chardev *cdev, int count, char **names)
+{
+	return cmd_guest_foreach(cdev, count, names, vmm_manager_guest_kick,
+				 "Kicked", "Failed to kick");
+}
+
 static int cmd_guest_pause(struct vmm_chardev *cdev, const char *name)
 {
 	int ret;
@@ -324,6 +467,118 @@ static int cmd_guest_region(struct vmm_chardev *cdev, const char *name,
 	return VMM_OK;
 }
 
+static int cmd_guest_sched(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int ret;
+	u32 weight, cap;
+	struct vmm_guest *guest = vmm_manager_guest_find(argv[2]);
+
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	if (argc == 5) {
+		weight = strtoul(argv[3], NULL, 0);
+		cap = strtoul(argv[4], NULL, 0);
+		ret = vmm_manager_guest_set_sched(guest, weight, cap);
+		if (ret) {
+			vmm_cprintf(cdev, "%s: Failed to update scheduling "
+				    "parameters (error %d)\n", argv[2], ret);
+			return ret;
+		}
+	} else if (argc != 3) {
+		cmd_guest_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	vmm_manager_guest_get_sched(guest, &weight, &cap);
+	vmm_cprintf(cdev, "Scheduling algorithm : %s\n", vmm_schedalgo_name());
+	vmm_cprintf(cdev, "Scheduling weight    : %d\n", weight);
+	vmm_cprintf(cdev, "Scheduling cap       : %d%%\n", cap);
+
+	return VMM_OK;
+}
+
+#ifdef CONFIG_GUEST_BOOT_STATS
+static void cmd_guest_boottime_nsecs(struct vmm_chardev *cdev, u64 nsecs)
+{
+	vmm_cprintf(cdev, " %8"PRIu64".%03"PRIu64" ms",
+		    udiv64(nsecs, 1000000ULL),
+		    udiv64(umod64(nsecs, 1000000ULL), 1000));
+}
+
+static int cmd_guest_boottime(struct vmm_chardev *cdev, const char *name)
+{
+	int rc;
+	u32 p, s, count;
+	u64 t, prev, slot_ns;
+	struct vmm_guest_boot_stats stats;
+	struct vmm_guest *guest = vmm_manager_guest_find(name);
+
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest\n");
+		return VMM_ENOTAVAIL;
+	}
+
+	rc = vmm_manager_guest_boot_stats(guest, &stats);
+	if (rc) {
+		vmm_cprintf(cdev, "%s: Failed to get boot stats (error %d)\n",
+			    name, rc);
+		return rc;
+	}
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------\n");
+	vmm_cprintf(cdev, " %-21s %15s %15s\n",
+			  "Phase", "Since Create", "Delta");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------\n");
+	prev = stats.tstamp[VMM_GUEST_BOOT_CREATE];
+	for (p = 0; p < VMM_GUEST_BOOT_MAX_PHASES; p++) {
+		t = stats.tstamp[p];
+		vmm_cprintf(cdev, " %-21s",
+			    vmm_manager_guest_boot_phase_name(p));
+		if (!t) {
+			vmm_cprintf(cdev, " %15s %15s\n", "-", "-");
+			continue;
+		}
+		cmd_guest_boottime_nsecs(cdev,
+				t - stats.tstamp[VMM_GUEST_BOOT_CREATE]);
+		cmd_guest_boottime_nsecs(cdev, (t > prev) ? (t - prev) : 0);
+		vmm_cprintf(cdev, "\n");
+		prev = t;
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "--------------\n");
+
+	count = arch_atomic_read(&stats.fault_count);
+	vmm_cprintf(cdev, " Stage2 faults after kick: %d\n", count);
+	if (!count) {
+		return VMM_OK;
+	}
+
+	slot_ns = vmm_manager_guest_boot_fault_slot_nsecs();
+	for (s = 0; s < VMM_GUEST_BOOT_FAULT_SLOTS; s++) {
+		count = arch_atomic_read(&stats.fault_slot[s]);
+		if (!count) {
+			continue;
+		}
+		vmm_cprintf(cdev, " ");
+		cmd_guest_boottime_nsecs(cdev, s * slot_ns);
+		if (s < (VMM_GUEST_BOOT_FAULT_SLOTS - 1)) {
+			vmm_cprintf(cdev, " -");
+			cmd_guest_boottime_nsecs(cdev, (s + 1) * slot_ns);
+		} else {
+			vmm_cprintf(cdev, " - %12s", "...");
+		}
+		vmm_cprintf(cdev, " : %d\n", count);
+	}
+
+	return VMM_OK;
+}
+#endif
+
 static int cmd_guest_param(struct vmm_chardev *cdev, int argc, char **argv,
 			   physical_addr_t *src_addr, u32 *size)
 {
@@ -361,13 +616,15 @@ static int cmd_guest_exec(struct vmm_chardev *cdev, int argc, char **argv)
 		return VMM_EFAIL;
 	}
 	if (strcmp(argv[1], "create") == 0) {
-		return cmd_guest_create(cdev, argv[2]);
+		return cmd_guest_create(cdev, argc - 2, &argv[2]);
+	} else if ((strcmp(argv[1], "clone") == 0) && (argc == 4)) {
+		return cmd_guest_clone(cdev, argv[2], argv[3]);
 	} else if (strcmp(argv[1], "destroy") == 0) {
 		return cmd_guest_destroy(cdev, argv[2]);
 	} else if (strcmp(argv[1], "reset") == 0) {
-		return cmd_guest_reset(cdev, argv[2]);
+		return cmd_guest_reset(cdev, argc - 2, &argv[2]);
 	} else if (strcmp(argv[1], "kick") == 0) {
-		return cmd_guest_kick(cdev, argv[2]);
+		return cmd_guest_kick(cdev, argc - 2, &argv[2]);
 	} else if (strcmp(argv[1], "pause") == 0) {
 		return cmd_guest_pause(cdev, argv[2]);
 	} else if (strcmp(argv[1], "resume") == 0) {
@@ -386,6 +643,12 @@ static int cmd_guest_exec(struct vmm_chardev *cdev, int argc, char **argv)
 			return ret;
 		}
 		return cmd_guest_region(cdev, argv[2], src_addr);
+	} else if (strcmp(argv[1], "sched") == 0) {
+		return cmd_guest_sched(cdev, argc, argv);
+#ifdef CONFIG_GUEST_BOOT_STATS
+	} else if ((strcmp(argv[1], "boottime") == 0) && (argc == 3)) {
+		return cmd_guest_boottime(cdev, argv[2]);
+#endif
 	} else {
 		cmd_guest_usage(cdev);
 		return VMM_EFAIL;
@@ -38,14 +38,23 @@
 #define	MODULE_INIT			cmd_heap_init
 #define	MODULE_EXIT			cmd_heap_exit
 
+#define CMD_HEAP_DEF_CALLSITES		32
+
 static void cmd_heap_usage(struct vmm_chardev *cdev)
 {
 	vmm_cprintf(cdev, "Usage:\n");
 	vmm_cprintf(cdev, "   heap help\n");
 	vmm_cprintf(cdev, "   heap info\n");
 	vmm_cprintf(cdev, "   heap state\n");
+	vmm_cprintf(cdev, "   heap cache_state\n");
+	vmm_cprintf(cdev, "   heap callsites [<max_entries>]\n");
 	vmm_cprintf(cdev, "   heap dma_info\n");
 	vmm_cprintf(cdev, "   heap dma_state\n");
+	vmm_cprintf(cdev, "   heap dma_callsites [<max_entries>]\n");
+	vmm_cprintf(cdev, "   heap peak_reset\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   callsites and dma_callsites need "
+			  "CONFIG_HEAP_CALLSITE\n");
 }
 
 static int heap_info(struct vmm_chardev *cdev,
@@ -112,6 +121,11 @@ static int cmd_heap_state(struct vmm_chardev *cdev)
 	return vmm_normal_heap_print_state(cdev);
 }
 
+static int cmd_heap_cache_state(struct vmm_chardev *cdev)
+{
+	return vmm_normal_heap_print_cache_state(cdev);
+}
+
 static int cmd_heap_dma_info(struct vmm_chardev *cdev)
 {
 	return heap_info(cdev, FALSE,
@@ -126,6 +140,23 @@ static int cmd_heap_dma_state(struct vmm_chardev *cdev)
 	return vmm_dma_heap_print_state(cdev);
 }
 
+static int cmd_heap_callsites(struct vmm_chardev *cdev, bool is_normal,
+			      u32 max_entries)
+{
+	int rc;
+
+	if (is_normal) {
+		rc = vmm_normal_heap_print_callsites(cdev, max_entries);
+	} else {
+		rc = vmm_dma_heap_print_callsites(cdev, max_entries);
+	}
+	if (rc == VMM_ENOTAVAIL) {
+		vmm_cprintf(cdev, "Call-site accounting not enabled\n");
+	}
+
+	return rc;
+}
+
 static int cmd_heap_exec(struct vmm_chardev *cdev, int argc, char **argv)
 {
 	if (argc == 2) {
@@ -136,10 +167,27 @@ static int cmd_heap_exec(struct vmm_chardev *cdev, int argc, char **argv)
 			return cmd_heap_info(cdev);
 		} else if (strcmp(argv[1], "state") == 0) {
 			return cmd_heap_state(cdev);
+		} else if (strcmp(argv[1], "cache_state") == 0) {
+			return cmd_heap_cache_state(cdev);
 		} else if (strcmp(argv[1], "dma_info") == 0) {
 			return cmd_heap_dma_info(cdev);
 		} else if (strcmp(argv[1], "dma_state") == 0) {
 			return cmd_heap_dma_state(cdev);
+		} else if (strcmp(argv[1], "callsites") == 0) {
+			return cmd_heap_callsites(cdev, TRUE,
+						  CMD_HEAP_DEF_CALLSITES);
+		} else if (strcmp(argv[1], "dma_callsites") == 0) {
+			return cmd_heap_callsites(cdev, FALSE,
+						  CMD_HEAP_DEF_CALLSITES);
+		} else if (strcmp(argv[1], "peak_reset") == 0) {
+			vmm_heap_reset_peak();
+			return VMM_OK;
+		}
+	} else if (argc == 3) {
+		if (strcmp(argv[1], "callsites") == 0) {
+			return cmd_heap_callsites(cdev, TRUE, atoi(argv[2]));
+		} else if (strcmp(argv[1], "dma_callsites") == 0) {
+			return cmd_heap_callsites(cdev, FALSE, atoi(argv[2]));
 		}
 	}
 	cmd_heap_usage(cdev);
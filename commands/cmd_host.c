@@ -23,6 +23,7 @@
 
 #include <vmm_error.h>
 #include <vmm_smp.h>
+#include <vmm_heap.h>
 #include <vmm_stdio.h>
 #include <vmm_cpumask.h>
 #include <vmm_resource.h>
@@ -57,6 +58,11 @@ static void cmd_host_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   host cpu info\n");
 	vmm_cprintf(cdev, "   host cpu stats\n");
 	vmm_cprintf(cdev, "   host irq stats\n");
+	vmm_cprintf(cdev, "   host irq rate [<msecs>]\n");
+#ifdef CONFIG_HOST_IRQ_STATS
+	vmm_cprintf(cdev, "   host irq latency\n");
+	vmm_cprintf(cdev, "   host irq latency_reset\n");
+#endif
 	vmm_cprintf(cdev, "   host irq set_affinity <hirq> <hcpu>\n");
 	vmm_cprintf(cdev, "   host extirq stats\n");
 	vmm_cprintf(cdev, "   host ram info\n");
@@ -220,6 +226,146 @@ static void cmd_host_irq_stats(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "\n");
 }
 
+static int cmd_host_irq_rate(struct vmm_chardev *cdev, u32 msecs)
+{
+	const char *irq_name;
+	u32 num, cpu, stats, count = vmm_host_irq_count();
+	u32 *prev;
+	struct vmm_host_irq *irq;
+
+	if (!msecs) {
+		vmm_cprintf(cdev, "%s: invalid sampling period\n", __func__);
+		return VMM_EINVALID;
+	}
+
+	prev = vmm_zalloc(sizeof(*prev) * count * CONFIG_CPU_COUNT);
+	if (!prev) {
+		return VMM_ENOMEM;
+	}
+
+	for (num = 0; num < count; num++) {
+		irq = vmm_host_irq_get(num);
+		for_each_online_cpu(cpu) {
+			prev[num * CONFIG_CPU_COUNT + cpu] =
+					vmm_host_irq_get_count(irq, cpu);
+		}
+	}
+
+	vmm_msleep(msecs);
+
+	vmm_cprintf(cdev, "----------------------------------------");
+	for_each_online_cpu(cpu) {
+		vmm_cprintf(cdev, "------------");
+	}
+	vmm_cprintf(cdev, "\n");
+	vmm_cprintf(cdev, " %-5s %-33s", "IRQ#", "Name");
+	for_each_online_cpu(cpu) {
+		vmm_cprintf(cdev, " CPU%-3d/sec ", cpu);
+	}
+	vmm_cprintf(cdev, "\n");
+	vmm_cprintf(cdev, "----------------------------------------");
+	for_each_online_cpu(cpu) {
+		vmm_cprintf(cdev, "------------");
+	}
+	vmm_cprintf(cdev, "\n");
+	for (num = 0; num < count; num++) {
+		irq = vmm_host_irq_get(num);
+		irq_name = vmm_host_irq_get_name(irq);
+		if (vmm_host_irq_is_disabled(irq) || !irq_name) {
+			continue;
+		}
+		vmm_cprintf(cdev, " %-5d %-33s", num, irq_name);
+		for_each_online_cpu(cpu) {
+			stats = vmm_host_irq_get_count(irq, cpu) -
+				prev[num * CONFIG_CPU_COUNT + cpu];
+			stats = udiv64((u64)stats * 1000, msecs);
+			vmm_cprintf(cdev, " %-10d", stats);
+		}
+		vmm_cprintf(cdev, "\n");
+	}
+	vmm_cprintf(cdev, "----------------------------------------");
+	for_each_online_cpu(cpu) {
+		vmm_cprintf(cdev, "------------");
+	}
+	vmm_cprintf(cdev, "\n");
+
+	vmm_free(prev);
+
+	return VMM_OK;
+}
+
+#ifdef CONFIG_HOST_IRQ_STATS
+static void cmd_host_irq_latency(struct vmm_chardev *cdev)
+{
+	const char *irq_name;
+	u32 num, cpu, b, runs, count = vmm_host_irq_count();
+	u64 total_ns, max_ns;
+	u32 hist[VMM_HOST_IRQ_HIST_BUCKETS];
+	struct vmm_host_irq *irq;
+	struct vmm_host_irq_stats *st;
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " %-5s %-20s %-10s %-10s %-10s %-10s\n",
+			  "IRQ#", "Name", "Count", "Total(us)",
+			  "Avg(ns)", "Max(ns)");
+	vmm_cprintf(cdev, " %-5s %-20s", "", "Histogram");
+	for (b = 0; b < VMM_HOST_IRQ_HIST_BUCKETS; b++) {
+		if (b < (VMM_HOST_IRQ_HIST_BUCKETS - 1)) {
+			vmm_cprintf(cdev, " <%-4dus", 1 << b);
+		} else {
+			vmm_cprintf(cdev, " >=%-3dus", 1 << (b - 1));
+		}
+	}
+	vmm_cprintf(cdev, "\n");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	for (num = 0; num < count; num++) {
+		irq = vmm_host_irq_get(num);
+		irq_name = vmm_host_irq_get_name(irq);
+		if (vmm_host_irq_is_disabled(irq) || !irq_name) {
+			continue;
+		}
+
+		runs = 0;
+		total_ns = max_ns = 0;
+		memset(hist, 0, sizeof(hist));
+		for_each_online_cpu(cpu) {
+			runs += vmm_host_irq_get_count(irq, cpu);
+			st = vmm_host_irq_get_stats(irq, cpu);
+			total_ns += st->total_ns;
+			if (max_ns < st->max_ns) {
+				max_ns = st->max_ns;
+			}
+			for (b = 0; b < VMM_HOST_IRQ_HIST_BUCKETS; b++) {
+				hist[b] += st->hist[b];
+			}
+		}
+
+		vmm_cprintf(cdev, " %-5d %-20s %-10d %-10"PRIu64" %-10"PRIu64
+			    " %-10"PRIu64"\n",
+			    num, irq_name, runs, udiv64(total_ns, 1000),
+			    (runs) ? udiv64(total_ns, runs) : 0, max_ns);
+		vmm_cprintf(cdev, " %-5s %-20s", "", "");
+		for (b = 0; b < VMM_HOST_IRQ_HIST_BUCKETS; b++) {
+			vmm_cprintf(cdev, " %-7d", hist[b]);
+		}
+		vmm_cprintf(cdev, "\n");
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+}
+
+static void cmd_host_irq_latency_reset(struct vmm_chardev *cdev)
+{
+	u32 num, count = vmm_host_irq_count();
+
+	for (num = 0; num < count; num++) {
+		vmm_host_irq_reset_stats(vmm_host_irq_get(num));
+	}
+}
+#endif
+
 static int cmd_host_irq_set_affinity(struct vmm_chardev *cdev, u32 hirq, u32 hcpu)
 {
 	if (CONFIG_CPU_COUNT <= hcpu) {
@@ -521,6 +667,17 @@ static int cmd_host_exec(struct vmm_chardev *cdev, int argc, char **argv)
 		if (strcmp(argv[2], "stats") == 0) {
 			cmd_host_irq_stats(cdev);
 			return VMM_OK;
+		} else if (strcmp(argv[2], "rate") == 0) {
+			return cmd_host_irq_rate(cdev,
+					(3 < argc) ? atoi(argv[3]) : 1000);
+#ifdef CONFIG_HOST_IRQ_STATS
+		} else if (strcmp(argv[2], "latency") == 0) {
+			cmd_host_irq_latency(cdev);
+			return VMM_OK;
+		} else if (strcmp(argv[2], "latency_reset") == 0) {
+			cmd_host_irq_latency_reset(cdev);
+			return VMM_OK;
+#endif
 		} else if ((strcmp(argv[2], "set_affinity") == 0) && (4 < argc)) {
 			hirq = atoi(argv[3]);
 			hcpu = atoi(argv[4]);
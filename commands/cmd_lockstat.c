@@ -0,0 +1,234 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_lockstat.c
+ * @author agent (agent@local)
+ * @brief Implementation of lockstat command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_heap.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <vmm_lockstat.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+#include <libs/kallsyms.h>
+#include <libs/libsort.h>
+
+#define MODULE_DESC			"Command lockstat"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_lockstat_init
+#define	MODULE_EXIT			cmd_lockstat_exit
+
+#define CMD_LOCKSTAT_DEF_ENTRIES	32
+
+static void cmd_lockstat_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   lockstat help\n");
+	vmm_cprintf(cdev, "   lockstat list [<max_entries>]\n");
+	vmm_cprintf(cdev, "   lockstat reset\n");
+}
+
+struct cmd_lockstat_entry {
+	struct vmm_lockstat_class *cls;
+	struct vmm_lockstat_counters cnt;
+};
+
+struct cmd_lockstat_collect {
+	u32 count;
+	u32 max;
+	struct cmd_lockstat_entry *ent;
+};
+
+static int cmd_lockstat_count_iter(struct vmm_lockstat_class *cls,
+				   void *priv)
+{
+	(*(u32 *)priv)++;
+
+	return VMM_OK;
+}
+
+static int cmd_lockstat_collect_iter(struct vmm_lockstat_class *cls,
+				     void *priv)
+{
+	struct cmd_lockstat_collect *c = priv;
+
+	/* Lock classes registered after counting are skipped */
+	if (c->count >= c->max) {
+		return VMM_OK;
+	}
+
+	c->ent[c->count].cls = cls;
+	vmm_lockstat_get(cls, &c->ent[c->count].cnt);
+	c->count++;
+
+	return VMM_OK;
+}
+
+/* Most contended lock classes first, then most waited */
+static int cmd_lockstat_cmp(void *m, size_t a, size_t b)
+{
+	struct cmd_lockstat_entry *ent = m;
+
+	if (ent[a].cnt.contended != ent[b].cnt.contended) {
+		return (ent[a].cnt.contended < ent[b].cnt.contended) ? 1 : 0;
+	}
+
+	return (ent[a].cnt.wait_total_ns < ent[b].cnt.wait_total_ns) ? 1 : 0;
+}
+
+static void cmd_lockstat_swap(void *m, size_t a, size_t b)
+{
+	struct cmd_lockstat_entry tmp, *ent = m;
+
+	tmp = ent[a];
+	ent[a] = ent[b];
+	ent[b] = tmp;
+}
+
+static void cmd_lockstat_name(struct vmm_lockstat_class *cls,
+			      char *name, u32 name_len)
+{
+	unsigned long pos, off = 0;
+	char sym[KSYM_NAME_LEN];
+
+	if (cls->name) {
+		strncpy(name, cls->name, name_len);
+		name[name_len - 1] = '\0';
+		return;
+	}
+
+	/* Statically initialized locks are named by their symbol */
+	sym[0] = sym[KSYM_NAME_LEN - 1] = '\0';
+	pos = kallsyms_get_symbol_pos((unsigned long)cls->addr, NULL, &off);
+	kallsyms_expand_symbol(kallsyms_get_symbol_offset(pos), sym);
+	if (off) {
+		vmm_snprintf(name, name_len, "%s+0x%lx", sym, off);
+	} else {
+		vmm_snprintf(name, name_len, "%s", sym);
+	}
+}
+
+static int cmd_lockstat_list(struct vmm_chardev *cdev, u32 max_entries)
+{
+	u32 i, count = 0;
+	char name[64];
+	struct cmd_lockstat_entry *e;
+	struct cmd_lockstat_collect c;
+
+	vmm_lockstat_iterate(cmd_lockstat_count_iter, &count);
+	if (!count) {
+		vmm_cprintf(cdev, "No lock acquired yet\n");
+		return VMM_OK;
+	}
+
+	c.count = 0;
+	c.max = count;
+	c.ent = vmm_zalloc(count * sizeof(*c.ent));
+	if (!c.ent) {
+		return VMM_ENOMEM;
+	}
+	vmm_lockstat_iterate(cmd_lockstat_collect_iter, &c);
+
+	libsort_smoothsort(c.ent, 0, c.count, cmd_lockstat_cmp,
+			   cmd_lockstat_swap);
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " %-36s %-8s %-11s %-11s\n",
+			  "Lock Class", "Type", "Acquired", "Contended");
+	vmm_cprintf(cdev, " %-36s %-10s %-10s %-10s %-10s\n",
+			  "", "WaitAvg", "WaitMax", "HoldAvg", "HoldMax");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	for (i = 0; (i < c.count) && (i < max_entries); i++) {
+		e = &c.ent[i];
+		if (!e->cnt.acquired) {
+			continue;
+		}
+		cmd_lockstat_name(e->cls, name, sizeof(name));
+		vmm_cprintf(cdev, " %-36s %-8s %-11"PRIu64" %-11"PRIu64"\n",
+			    name, vmm_lockstat_type_name(e->cls->type),
+			    e->cnt.acquired, e->cnt.contended);
+		vmm_cprintf(cdev, " %-36s %-10"PRIu64" %-10"PRIu64
+			    " %-10"PRIu64" %-10"PRIu64"\n", "",
+			    (e->cnt.contended) ?
+			    udiv64(e->cnt.wait_total_ns, e->cnt.contended) : 0,
+			    e->cnt.wait_max_ns,
+			    udiv64(e->cnt.hold_total_ns, e->cnt.acquired),
+			    e->cnt.hold_max_ns);
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " Times are in nanoseconds\n");
+
+	vmm_free(c.ent);
+
+	return VMM_OK;
+}
+
+static int cmd_lockstat_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	if (argc == 2) {
+		if (strcmp(argv[1], "help") == 0) {
+			cmd_lockstat_usage(cdev);
+			return VMM_OK;
+		} else if (strcmp(argv[1], "list") == 0) {
+			return cmd_lockstat_list(cdev,
+						 CMD_LOCKSTAT_DEF_ENTRIES);
+		} else if (strcmp(argv[1], "reset") == 0) {
+			vmm_lockstat_reset();
+			return VMM_OK;
+		}
+	} else if ((argc == 3) && (strcmp(argv[1], "list") == 0)) {
+		return cmd_lockstat_list(cdev, atoi(argv[2]));
+	}
+
+	cmd_lockstat_usage(cdev);
+
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_lockstat = {
+	.name = "lockstat",
+	.desc = "lock contention statistics",
+	.usage = cmd_lockstat_usage,
+	.exec = cmd_lockstat_exec,
+};
+
+static int __init cmd_lockstat_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_lockstat);
+}
+
+static void __exit cmd_lockstat_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_lockstat);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
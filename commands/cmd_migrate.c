@@ -0,0 +1,267 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_migrate.c
+ * @author agent (agent@local)
+ * @brief Implementation of migrate command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <vmm_manager.h>
+#include <vmm_snapshot.h>
+#include <libs/netstack.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+
+#define MODULE_DESC			"Command migrate"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(NETSTACK_IPRIORITY + 1)
+#define	MODULE_INIT			cmd_migrate_init
+#define	MODULE_EXIT			cmd_migrate_exit
+
+#define CMD_MIGRATE_DEF_ROUNDS		30
+#define CMD_MIGRATE_DEF_DOWNTIME_MS	300
+#define CMD_MIGRATE_WRITE_SIZE		0x8000
+
+static void cmd_migrate_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   migrate help\n");
+	vmm_cprintf(cdev, "   migrate send <guest_name> <ipaddr> <port> "
+			  "[<max_rounds>] [<downtime_ms>]\n");
+	vmm_cprintf(cdev, "   migrate receive <guest_name> <port>\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   Receiving guest must be created from same "
+			  "device tree and must be reset\n");
+	vmm_cprintf(cdev, "   Sending guest remains paused after "
+			  "successful migration\n");
+	vmm_cprintf(cdev, "   Default max_rounds is %d and default "
+			  "downtime_ms is %d\n", CMD_MIGRATE_DEF_ROUNDS,
+			  CMD_MIGRATE_DEF_DOWNTIME_MS);
+}
+
+struct cmd_migrate_sock {
+	struct netstack_socket *sk;
+};
+
+static size_t cmd_migrate_write(void *priv, const void *buf, size_t len)
+{
+	u16 wlen;
+	size_t done = 0;
+	struct cmd_migrate_sock *ms = priv;
+
+	while (done < len) {
+		wlen = ((len - done) < CMD_MIGRATE_WRITE_SIZE) ?
+					(len - done) : CMD_MIGRATE_WRITE_SIZE;
+		if (netstack_socket_write(ms->sk,
+					  (u8 *)buf + done, wlen)) {
+			break;
+		}
+		done += wlen;
+	}
+
+	return done;
+}
+
+static size_t cmd_migrate_read(void *priv, void *buf, size_t len)
+{
+	int rc;
+	size_t done = 0;
+	struct cmd_migrate_sock *ms = priv;
+
+	while (done < len) {
+		rc = netstack_socket_recv_into(ms->sk, (u8 *)buf + done,
+					       len - done, -1);
+		if (rc <= 0) {
+			break;
+		}
+		done += rc;
+	}
+
+	return done;
+}
+
+static int cmd_migrate_send(struct vmm_chardev *cdev,
+			    struct vmm_guest *guest,
+			    const char *ipstr, u16 port,
+			    u32 max_rounds, u32 downtime_ms)
+{
+	int rc;
+	u8 ipaddr[4];
+	struct cmd_migrate_sock ms;
+	struct vmm_snapshot_stream stream;
+	struct vmm_snapshot_live live;
+
+	str2ipaddr(ipaddr, ipstr);
+
+	memset(&ms, 0, sizeof(ms));
+	ms.sk = netstack_socket_alloc(NETSTACK_SOCKET_TCP);
+	if (!ms.sk) {
+		return VMM_ENOMEM;
+	}
+
+	rc = netstack_socket_connect(ms.sk, ipaddr, port);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to connect %s:%d (error %d)\n",
+			    ipstr, port, rc);
+		goto done;
+	}
+
+	stream.priv = &ms;
+	stream.read = NULL;
+	stream.write = cmd_migrate_write;
+	memset(&live, 0, sizeof(live));
+	live.max_rounds = max_rounds;
+	live.downtime_ms = downtime_ms;
+
+	rc = vmm_snapshot_guest_save_live(guest, &stream, &live);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to migrate guest %s (error %d)\n",
+			    guest->name, rc);
+	} else {
+		vmm_cprintf(cdev, "Migrated guest %s after %d rounds with "
+			    "%"PRIu64" ms downtime\n", guest->name,
+			    live.rounds, udiv64(live.downtime_ns, 1000000));
+	}
+
+	netstack_socket_disconnect(ms.sk);
+done:
+	netstack_socket_free(ms.sk);
+	return rc;
+}
+
+static int cmd_migrate_receive(struct vmm_chardev *cdev,
+			       struct vmm_guest *guest, u16 port)
+{
+	int rc;
+	struct netstack_socket *sk;
+	struct cmd_migrate_sock ms;
+	struct vmm_snapshot_stream stream;
+
+	sk = netstack_socket_alloc(NETSTACK_SOCKET_TCP);
+	if (!sk) {
+		return VMM_ENOMEM;
+	}
+
+	rc = netstack_socket_bind(sk, NULL, port);
+	if (rc) {
+		goto free_sk;
+	}
+	rc = netstack_socket_listen(sk);
+	if (rc) {
+		goto free_sk;
+	}
+
+	vmm_cprintf(cdev, "Waiting for guest %s on port %d\n",
+		    guest->name, port);
+
+	memset(&ms, 0, sizeof(ms));
+	rc = netstack_socket_accept(sk, &ms.sk);
+	if (rc) {
+		goto close_sk;
+	}
+
+	stream.priv = &ms;
+	stream.read = cmd_migrate_read;
+	stream.write = NULL;
+
+	rc = vmm_snapshot_guest_restore(guest, &stream);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to receive guest %s (error %d)\n",
+			    guest->name, rc);
+		/* Partially restored guest is not usable */
+		vmm_manager_guest_reset(guest);
+	} else {
+		vmm_cprintf(cdev, "Received guest %s\n", guest->name);
+	}
+
+	netstack_socket_close(ms.sk);
+	netstack_socket_free(ms.sk);
+close_sk:
+	netstack_socket_close(sk);
+free_sk:
+	netstack_socket_free(sk);
+	return rc;
+}
+
+static int cmd_migrate_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	struct vmm_guest *guest;
+	u32 max_rounds = CMD_MIGRATE_DEF_ROUNDS;
+	u32 downtime_ms = CMD_MIGRATE_DEF_DOWNTIME_MS;
+
+	if ((argc == 2) && (strcmp(argv[1], "help") == 0)) {
+		cmd_migrate_usage(cdev);
+		return VMM_OK;
+	}
+	if (argc < 4) {
+		goto fail;
+	}
+
+	guest = vmm_manager_guest_find(argv[2]);
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest %s\n", argv[2]);
+		return VMM_ENOTAVAIL;
+	}
+
+	if ((strcmp(argv[1], "send") == 0) &&
+	    (5 <= argc) && (argc <= 7)) {
+		if (6 <= argc) {
+			max_rounds = atoi(argv[5]);
+		}
+		if (7 <= argc) {
+			downtime_ms = atoi(argv[6]);
+		}
+		return cmd_migrate_send(cdev, guest, argv[3], atoi(argv[4]),
+					max_rounds, downtime_ms);
+	} else if ((strcmp(argv[1], "receive") == 0) && (argc == 4)) {
+		return cmd_migrate_receive(cdev, guest, atoi(argv[3]));
+	}
+
+fail:
+	cmd_migrate_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_migrate = {
+	.name = "migrate",
+	.desc = "live migrate guest between hosts",
+	.usage = cmd_migrate_usage,
+	.exec = cmd_migrate_exec,
+};
+
+static int __init cmd_migrate_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_migrate);
+}
+
+static void __exit cmd_migrate_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_migrate);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
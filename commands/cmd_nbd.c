@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_nbd.c
+ * @author agent (agent@local)
+ * @brief Implementation of nbd command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <libs/stringlib.h>
+#include <drv/nbd.h>
+
+#define MODULE_DESC			"Command nbd"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_nbd_init
+#define	MODULE_EXIT			cmd_nbd_exit
+
+static void cmd_nbd_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   nbd help\n");
+	vmm_cprintf(cdev, "   nbd list\n");
+	vmm_cprintf(cdev, "   nbd connect <name> <server_ipaddr> <port> "
+			  "[<export_name>] [<cache_size_kb>]\n");
+	vmm_cprintf(cdev, "   nbd disconnect <name>\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   Use \"\" as export_name for default export\n");
+}
+
+static int cmd_nbd_list(struct vmm_chardev *cdev)
+{
+	int num, count;
+	char addr[24];
+	struct nbd *d;
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " %-16s %-22s %-16s %-10s %-10s\n",
+			  "Name", "Server", "Export", "Size (MB)", "In-flight");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	count = nbd_count();
+	for (num = 0; num < count; num++) {
+		d = nbd_get(num);
+		vmm_snprintf(addr, sizeof(addr), "%d.%d.%d.%d:%d",
+			     d->ipaddr[0], d->ipaddr[1], d->ipaddr[2],
+			     d->ipaddr[3], d->port);
+		vmm_cprintf(cdev, " %-16s %-22s %-16s %-10d %-10d%s\n",
+			    d->bdev->name, addr,
+			    (d->export_name[0]) ? d->export_name : "---",
+			    (int)(vmm_blockdev_total_size(d->bdev) >> 20),
+			    d->inflight_count,
+			    (d->connected) ? "" : " (lost)");
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+
+	return VMM_OK;
+}
+
+static int cmd_nbd_connect(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	u8 ipaddr[4];
+	u32 cache_kb = 0;
+	const char *export_name = NULL;
+	struct nbd *d;
+
+	str2ipaddr(ipaddr, argv[3]);
+	if (argc > 5) {
+		export_name = argv[5];
+	}
+	if (argc > 6) {
+		cache_kb = atoi(argv[6]);
+	}
+
+	d = nbd_create(argv[2], ipaddr, atoi(argv[4]), export_name, cache_kb);
+	if (!d) {
+		vmm_cprintf(cdev, "Failed to create %s NBD instance\n",
+			    argv[2]);
+		return VMM_EFAIL;
+	}
+
+	vmm_cprintf(cdev, "Created %s NBD instance\n", argv[2]);
+
+	return VMM_OK;
+}
+
+static int cmd_nbd_disconnect(struct vmm_chardev *cdev, const char *name)
+{
+	int rc;
+	struct nbd *d = nbd_find(name);
+
+	if (!d) {
+		vmm_cprintf(cdev, "Failed to find %s NBD instance\n", name);
+		return VMM_ENOTAVAIL;
+	}
+
+	rc = nbd_destroy(d);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to destroy %s NBD instance "
+			    "(error %d)\n", name, rc);
+		return rc;
+	}
+
+	vmm_cprintf(cdev, "Destroyed %s NBD instance\n", name);
+
+	return VMM_OK;
+}
+
+static int cmd_nbd_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	if (argc <= 1) {
+		goto fail;
+	}
+
+	if (strcmp(argv[1], "help") == 0) {
+		cmd_nbd_usage(cdev);
+		return VMM_OK;
+	} else if ((strcmp(argv[1], "list") == 0) && (argc == 2)) {
+		return cmd_nbd_list(cdev);
+	} else if ((strcmp(argv[1], "connect") == 0) &&
+		   (5 <= argc) && (argc <= 7)) {
+		return cmd_nbd_connect(cdev, argc, argv);
+	} else if ((strcmp(argv[1], "disconnect") == 0) && (argc == 3)) {
+		return cmd_nbd_disconnect(cdev, argv[2]);
+	}
+
+fail:
+	cmd_nbd_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_nbd = {
+	.name = "nbd",
+	.desc = "network block device client commands",
+	.usage = cmd_nbd_usage,
+	.exec = cmd_nbd_exec,
+};
+
+static int __init cmd_nbd_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_nbd);
+}
+
+static void __exit cmd_nbd_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_nbd);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -28,9 +28,15 @@
 #include <vmm_host_aspace.h>
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
+#if defined(CONFIG_VFS)
+/* Must come before vmm_mbuf.h which defines m_flags macro */
+#include <libs/vfs.h>
+#endif
+#include <net/vmm_mbuf.h>
 #include <net/vmm_netport.h>
 #include <net/vmm_netswitch.h>
 #include <net/vmm_protocol.h>
+#include <net/vmm_netcapture.h>
 #include <libs/stringlib.h>
 
 #define MODULE_DESC			"Command net"
@@ -45,7 +51,17 @@ static void cmd_net_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "Usage:\n");
 	vmm_cprintf(cdev, "   net help\n");
 	vmm_cprintf(cdev, "   net ports\n");
+	vmm_cprintf(cdev, "   net port_info <port_name>\n");
 	vmm_cprintf(cdev, "   net switches\n");
+	vmm_cprintf(cdev, "   net switch_info <switch_name>\n");
+	vmm_cprintf(cdev, "   net mbufs\n");
+	vmm_cprintf(cdev, "   net capture_start <port_name> [<snaplen>] "
+			  "[<count>] [in|out|both]\n");
+	vmm_cprintf(cdev, "   net capture_stop <port_name>\n");
+	vmm_cprintf(cdev, "   net capture_info <port_name>\n");
+#if defined(CONFIG_VFS)
+	vmm_cprintf(cdev, "   net capture_save <port_name> <pcap_file_path>\n");
+#endif
 }
 
 struct cmd_net_list_priv {
@@ -98,6 +114,50 @@ static int cmd_net_port_list(struct vmm_chardev *cdev,
 	return VMM_OK;
 }
 
+static int cmd_net_port_info(struct vmm_chardev *cdev,
+			     int argc, char **argv)
+{
+	char hwaddr[20];
+	struct vmm_netport *port;
+
+	if (argc != 3) {
+		cmd_net_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	port = vmm_netport_find(argv[2]);
+	if (!port) {
+		vmm_cprintf(cdev, "Failed to find netport %s\n", argv[2]);
+		return VMM_ENOTAVAIL;
+	}
+
+	vmm_cprintf(cdev, "Name              : %s\n", port->name);
+	vmm_cprintf(cdev, "Switch            : %s\n",
+		    (port->nsw) ? port->nsw->name : "--");
+	vmm_cprintf(cdev, "Link              : %s\n",
+		    (port->flags & VMM_NETPORT_LINK_UP) ? "UP" : "DOWN");
+	vmm_cprintf(cdev, "HW-Address        : %s\n",
+		    ethaddr_to_str(hwaddr, port->macaddr));
+	vmm_cprintf(cdev, "MTU               : %d\n", port->mtu);
+	vmm_cprintf(cdev, "QoS Priority      : %d\n", port->qos_prio);
+	if (port->qos_rate) {
+		vmm_cprintf(cdev, "QoS Rate          : %"PRIu64" kbps\n",
+			    (port->qos_rate * 8) / 1000);
+		vmm_cprintf(cdev, "QoS Burst         : %"PRIu64" bytes\n",
+			    port->qos_burst);
+	} else {
+		vmm_cprintf(cdev, "QoS Rate          : unlimited\n");
+	}
+	vmm_cprintf(cdev, "Ingress Packets   : %"PRIu64"\n",
+		    vmm_percpu_counter_read(&port->stat_ingress_pkts));
+	vmm_cprintf(cdev, "Ingress Bytes     : %"PRIu64"\n",
+		    vmm_percpu_counter_read(&port->stat_ingress_bytes));
+	vmm_cprintf(cdev, "Ingress Drops     : %"PRIu64"\n",
+		    vmm_percpu_counter_read(&port->stat_ingress_drops));
+
+	return VMM_OK;
+}
+
 static int cmd_net_switch_list_iter(struct vmm_netswitch *nsw, void *data)
 {
 	u32 pos = 0;
@@ -148,6 +208,225 @@ done:
 	return VMM_OK;
 }
 
+static int cmd_net_switch_info(struct vmm_chardev *cdev,
+			       int argc, char **argv)
+{
+	struct vmm_netswitch *nsw;
+
+	if (argc != 3) {
+		cmd_net_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	nsw = vmm_netswitch_find(argv[2]);
+	if (!nsw) {
+		vmm_cprintf(cdev, "Failed to find netswitch %s\n", argv[2]);
+		return VMM_ENOTAVAIL;
+	}
+
+	vmm_cprintf(cdev, "Name              : %s\n", nsw->name);
+	if (nsw->show) {
+		nsw->show(nsw, cdev);
+	}
+
+	return VMM_OK;
+}
+
+static void cmd_net_mbuf_slab_show(struct vmm_chardev *cdev, const char *name,
+				   struct vmm_mbufpool_slab_stats *st)
+{
+	vmm_cprintf(cdev, " %-6s %-6d %-6d %-6d %-12"PRIu64" %-12"PRIu64
+		    " %-12"PRIu64"\n", name, st->buf_size, st->buf_count,
+		    st->buf_free, st->allocs, st->cache_hits, st->pool_misses);
+}
+
+static int cmd_net_mbuf_stats(struct vmm_chardev *cdev,
+			      int argc, char **argv)
+{
+	int rc;
+	u32 i;
+	char name[8];
+	struct vmm_mbufpool_stats stats;
+
+	if (argc != 2) {
+		cmd_net_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	rc = vmm_mbufpool_get_stats(&stats);
+	if (rc) {
+		return rc;
+	}
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "------------------------------\n");
+	vmm_cprintf(cdev, " %-6s %-6s %-6s %-6s %-12s %-12s %-12s\n",
+		    "Pool", "Size", "Count", "Free", "Allocs",
+		    "CacheHits", "PoolMisses");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "------------------------------\n");
+	cmd_net_mbuf_slab_show(cdev, "mbuf", &stats.mbuf);
+	for (i = 0; i < VMM_MBUF_EXT_SLAB_COUNT; i++) {
+		vmm_snprintf(name, sizeof(name), "ext%d", i);
+		cmd_net_mbuf_slab_show(cdev, name, &stats.ext[i]);
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "------------------------------\n");
+	vmm_cprintf(cdev, " Heap fallback allocs: %"PRIu64"\n",
+		    stats.ext_heap_allocs);
+	vmm_cprintf(cdev, " DMA allocs          : %"PRIu64"\n",
+		    stats.ext_dma_allocs);
+
+	return VMM_OK;
+}
+
+static int cmd_net_capture_start(struct vmm_chardev *cdev,
+				 int argc, char **argv)
+{
+	int rc;
+	u32 snaplen = 0, count = 0, dirs = VMM_NETCAPTURE_DIR_BOTH;
+	struct vmm_netport *port;
+
+	if ((argc < 3) || (6 < argc)) {
+		cmd_net_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	port = vmm_netport_find(argv[2]);
+	if (!port) {
+		vmm_cprintf(cdev, "Failed to find netport %s\n", argv[2]);
+		return VMM_ENOTAVAIL;
+	}
+
+	if (argc > 3) {
+		snaplen = strtoul(argv[3], NULL, 0);
+	}
+	if (argc > 4) {
+		count = strtoul(argv[4], NULL, 0);
+	}
+	if (argc > 5) {
+		if (strcmp(argv[5], "in") == 0) {
+			dirs = VMM_NETCAPTURE_DIR_IN;
+		} else if (strcmp(argv[5], "out") == 0) {
+			dirs = VMM_NETCAPTURE_DIR_OUT;
+		} else if (strcmp(argv[5], "both") != 0) {
+			cmd_net_usage(cdev);
+			return VMM_EFAIL;
+		}
+	}
+
+	rc = vmm_netcapture_start(port, snaplen, count, dirs);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to start capture on %s (error %d)\n",
+			    port->name, rc);
+	}
+
+	return rc;
+}
+
+static int cmd_net_capture_stop(struct vmm_chardev *cdev,
+				int argc, char **argv)
+{
+	int rc;
+	struct vmm_netport *port;
+
+	if (argc != 3) {
+		cmd_net_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	port = vmm_netport_find(argv[2]);
+	if (!port) {
+		vmm_cprintf(cdev, "Failed to find netport %s\n", argv[2]);
+		return VMM_ENOTAVAIL;
+	}
+
+	rc = vmm_netcapture_stop(port);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to stop capture on %s (error %d)\n",
+			    port->name, rc);
+	}
+
+	return rc;
+}
+
+static int cmd_net_capture_info(struct vmm_chardev *cdev,
+				int argc, char **argv)
+{
+	int rc;
+	struct vmm_netport *port;
+	struct vmm_netcapture_stats stats;
+
+	if (argc != 3) {
+		cmd_net_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	port = vmm_netport_find(argv[2]);
+	if (!port) {
+		vmm_cprintf(cdev, "Failed to find netport %s\n", argv[2]);
+		return VMM_ENOTAVAIL;
+	}
+
+	rc = vmm_netcapture_get_stats(port, &stats);
+	if (rc) {
+		vmm_cprintf(cdev, "No capture running on %s\n", port->name);
+		return rc;
+	}
+
+	vmm_cprintf(cdev, "Port              : %s\n", port->name);
+	vmm_cprintf(cdev, "Direction         : %s%s\n",
+		    (stats.dirs & VMM_NETCAPTURE_DIR_IN) ? "in " : "",
+		    (stats.dirs & VMM_NETCAPTURE_DIR_OUT) ? "out" : "");
+	vmm_cprintf(cdev, "Snap Length       : %d bytes\n", stats.snaplen);
+	vmm_cprintf(cdev, "Ring Slots        : %d\n", stats.count);
+	vmm_cprintf(cdev, "Packets           : %"PRIu64"\n", stats.packets);
+	vmm_cprintf(cdev, "Overwritten       : %"PRIu64"\n", stats.overwritten);
+
+	return VMM_OK;
+}
+
+#if defined(CONFIG_VFS)
+static size_t cmd_net_capture_write(void *priv, void *buf, size_t len)
+{
+	return vfs_write(*((int *)priv), buf, len);
+}
+
+static int cmd_net_capture_save(struct vmm_chardev *cdev,
+				int argc, char **argv)
+{
+	int fd, rc;
+	struct vmm_netport *port;
+
+	if (argc != 4) {
+		cmd_net_usage(cdev);
+		return VMM_EFAIL;
+	}
+
+	port = vmm_netport_find(argv[2]);
+	if (!port) {
+		vmm_cprintf(cdev, "Failed to find netport %s\n", argv[2]);
+		return VMM_ENOTAVAIL;
+	}
+
+	fd = vfs_open(argv[3], O_WRONLY | O_CREAT | O_TRUNC, 0);
+	if (fd < 0) {
+		vmm_cprintf(cdev, "Failed to open %s\n", argv[3]);
+		return fd;
+	}
+
+	rc = vmm_netcapture_read(port, &fd, cmd_net_capture_write);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to save capture of %s (error %d)\n",
+			    port->name, rc);
+	}
+
+	vfs_close(fd);
+
+	return rc;
+}
+#endif
+
 static int cmd_net_exec(struct vmm_chardev *cdev, int argc, char **argv)
 {
 	if (argc <= 1) {
@@ -159,8 +438,24 @@ static int cmd_net_exec(struct vmm_chardev *cdev, int argc, char **argv)
 		return VMM_OK;
 	} else if (strcmp(argv[1], "ports") == 0) {
 		return cmd_net_port_list(cdev, argc, argv);
+	} else if (strcmp(argv[1], "port_info") == 0) {
+		return cmd_net_port_info(cdev, argc, argv);
 	} else if (strcmp(argv[1], "switches") == 0) {
 		return cmd_net_switch_list(cdev, argc, argv);
+	} else if (strcmp(argv[1], "switch_info") == 0) {
+		return cmd_net_switch_info(cdev, argc, argv);
+	} else if (strcmp(argv[1], "mbufs") == 0) {
+		return cmd_net_mbuf_stats(cdev, argc, argv);
+	} else if (strcmp(argv[1], "capture_start") == 0) {
+		return cmd_net_capture_start(cdev, argc, argv);
+	} else if (strcmp(argv[1], "capture_stop") == 0) {
+		return cmd_net_capture_stop(cdev, argc, argv);
+	} else if (strcmp(argv[1], "capture_info") == 0) {
+		return cmd_net_capture_info(cdev, argc, argv);
+#if defined(CONFIG_VFS)
+	} else if (strcmp(argv[1], "capture_save") == 0) {
+		return cmd_net_capture_save(cdev, argc, argv);
+#endif
 	}
 
 fail:
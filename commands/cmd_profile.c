@@ -27,6 +27,8 @@
 #include <vmm_cmdmgr.h>
 #include <vmm_heap.h>
 #include <vmm_timer.h>
+#include <vmm_cpumask.h>
+#include <vmm_manager.h>
 #include <vmm_profiler.h>
 #include <arch_atomic.h>
 #include <arch_atomic64.h>
@@ -53,6 +55,9 @@ static void cmd_profile_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   profile status\n");
 	vmm_cprintf(cdev,
 		    "   profile dump [name|count|total_time|single_time]\n");
+	vmm_cprintf(cdev, "   profile sample_start [<frequency_hz>]\n");
+	vmm_cprintf(cdev, "   profile sample_stop\n");
+	vmm_cprintf(cdev, "   profile sample_dump [<max_symbols>]\n");
 }
 
 static int cmd_profile_help(struct vmm_chardev *cdev, char *dummy)
@@ -70,6 +75,12 @@ static int cmd_profile_status(struct vmm_chardev *cdev, char *dummy)
 		vmm_cprintf(cdev, "profile function is not running\n");
 	}
 
+	if (vmm_profiler_sample_isactive()) {
+		vmm_cprintf(cdev, "profile sampling is running\n");
+	} else {
+		vmm_cprintf(cdev, "profile sampling is not running\n");
+	}
+
 	return VMM_OK;
 }
 
@@ -334,6 +345,150 @@ static int cmd_profile_stop(struct vmm_chardev *cdev, char *dummy)
 	return vmm_profiler_stop();
 }
 
+static int cmd_profile_sample_start(struct vmm_chardev *cdev, char *freq)
+{
+	return vmm_profiler_sample_start((freq) ? atoi(freq) : 0);
+}
+
+static int cmd_profile_sample_stop(struct vmm_chardev *cdev, char *dummy)
+{
+	return vmm_profiler_sample_stop();
+}
+
+struct cmd_profile_hit {
+	u32 pos;
+	u32 count;
+};
+
+static int cmd_profile_hit_cmp(void *m, size_t a, size_t b)
+{
+	struct cmd_profile_hit *hit = m;
+
+	return (hit[a].count < hit[b].count) ? 1 : 0;
+}
+
+static void cmd_profile_hit_swap(void *m, size_t a, size_t b)
+{
+	struct cmd_profile_hit tmp, *hit = m;
+
+	tmp = hit[a];
+	hit[a] = hit[b];
+	hit[b] = tmp;
+}
+
+static const char *const sample_context_names[VMM_PROFILE_CTX_MAX] = {
+	[VMM_PROFILE_CTX_IRQ] = "irq",
+	[VMM_PROFILE_CTX_ORPHAN] = "orphan",
+	[VMM_PROFILE_CTX_NORMAL] = "normal",
+	[VMM_PROFILE_CTX_GUEST] = "guest",
+};
+
+/*
+ * Samples only carry raw program counters so symbol lookup is
+ * done here, after sampling, for host program counters only.
+ */
+static int cmd_profile_sample_dump(struct vmm_chardev *cdev, char *max)
+{
+	int rc = VMM_OK;
+	struct vmm_vcpu *vcpu;
+	struct vmm_profiler_sample *smp;
+	struct cmd_profile_hit *hit = NULL;
+	u32 *vcpu_hits = NULL;
+	u32 cpu, i, count, lost, total = 0, hit_count = 0;
+	u32 ctx_hits[VMM_PROFILE_CTX_MAX] = { 0 };
+	u32 max_syms = (max) ? atoi(max) : 20;
+	u32 vcpu_count = vmm_manager_max_vcpu_count();
+	char name[KSYM_NAME_LEN];
+
+	if (vmm_profiler_sample_isactive()) {
+		vmm_cprintf(cdev, "Can't dump while sampling is active\n");
+		return VMM_EFAIL;
+	}
+
+	smp = vmm_malloc(CONFIG_PROFILE_SAMPLE_COUNT * sizeof(*smp));
+	hit = vmm_zalloc(kallsyms_num_syms * sizeof(*hit));
+	vcpu_hits = vmm_zalloc(vcpu_count * sizeof(*vcpu_hits));
+	if (!smp || !hit || !vcpu_hits) {
+		rc = VMM_ENOMEM;
+		goto done;
+	}
+
+	for (i = 0; i < kallsyms_num_syms; i++) {
+		hit[i].pos = i;
+	}
+
+	for_each_online_cpu(cpu) {
+		count = vmm_profiler_sample_read(cpu, smp,
+					CONFIG_PROFILE_SAMPLE_COUNT, &lost);
+		vmm_cprintf(cdev, "CPU%u: %u samples (%u overwritten)\n",
+			    cpu, count, lost);
+		for (i = 0; i < count; i++) {
+			ctx_hits[smp[i].context]++;
+			if (smp[i].vcpu_id < vcpu_count) {
+				vcpu_hits[smp[i].vcpu_id]++;
+			}
+			if (smp[i].host_pc) {
+				hit[kallsyms_get_symbol_pos(smp[i].host_pc,
+							NULL, NULL)].count++;
+				hit_count++;
+			}
+		}
+		total += count;
+	}
+
+	if (!total) {
+		goto done;
+	}
+
+	vmm_cprintf(cdev, "\n");
+	for (i = 0; i < VMM_PROFILE_CTX_MAX; i++) {
+		vmm_cprintf(cdev, "%-8s %10u (%u%%)\n", sample_context_names[i],
+			    ctx_hits[i], udiv32(ctx_hits[i] * 100, total));
+	}
+
+	vmm_cprintf(cdev, "\n%-30s %10s\n", "VCPU", "Samples");
+	for (i = 0; i < vcpu_count; i++) {
+		if (!vcpu_hits[i]) {
+			continue;
+		}
+		vcpu = vmm_manager_vcpu(i);
+		vmm_cprintf(cdev, "%-30s %10u\n",
+			    (vcpu) ? vcpu->name : "(destroyed)", vcpu_hits[i]);
+	}
+
+	if (!hit_count) {
+		goto done;
+	}
+
+	libsort_smoothsort(hit, 0, kallsyms_num_syms, cmd_profile_hit_cmp,
+			   cmd_profile_hit_swap);
+
+	vmm_cprintf(cdev, "\n%-40s %10s\n", "Host Function", "Samples");
+	for (i = 0; (i < max_syms) && (i < kallsyms_num_syms); i++) {
+		if (!hit[i].count) {
+			break;
+		}
+		name[0] = name[KSYM_NAME_LEN - 1] = 0;
+		kallsyms_expand_symbol(kallsyms_get_symbol_offset(hit[i].pos),
+				       name);
+		vmm_cprintf(cdev, "%-40s %10u (%u%%)\n", name, hit[i].count,
+			    udiv32(hit[i].count * 100, hit_count));
+	}
+
+done:
+	if (vcpu_hits) {
+		vmm_free(vcpu_hits);
+	}
+	if (hit) {
+		vmm_free(hit);
+	}
+	if (smp) {
+		vmm_free(smp);
+	}
+
+	return rc;
+}
+
 static const struct {
 	char *name;
 	int (*function) (struct vmm_chardev *, char *);
@@ -343,6 +498,9 @@ static const struct {
 	{"stop", cmd_profile_stop},
 	{"status", cmd_profile_status},
 	{"dump", cmd_profile_dump},
+	{"sample_start", cmd_profile_sample_start},
+	{"sample_stop", cmd_profile_sample_stop},
+	{"sample_dump", cmd_profile_sample_dump},
 	{NULL, NULL},
 };
 
@@ -0,0 +1,222 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_snapshot.c
+ * @author agent (agent@local)
+ * @brief Implementation of snapshot command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <vmm_manager.h>
+#include <vmm_snapshot.h>
+#include <libs/stringlib.h>
+#if defined(CONFIG_VFS)
+#include <libs/vfs.h>
+#endif
+#if defined(CONFIG_BLOCK)
+#include <block/vmm_blockdev.h>
+#endif
+
+#define MODULE_DESC			"Command snapshot"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_snapshot_init
+#define	MODULE_EXIT			cmd_snapshot_exit
+
+static void cmd_snapshot_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   snapshot help\n");
+#if defined(CONFIG_VFS)
+	vmm_cprintf(cdev, "   snapshot save <guest_name> file <path>\n");
+	vmm_cprintf(cdev, "   snapshot restore <guest_name> file <path>\n");
+#endif
+#if defined(CONFIG_BLOCK)
+	vmm_cprintf(cdev, "   snapshot save <guest_name> bdev <bdev_name>\n");
+	vmm_cprintf(cdev, "   snapshot restore <guest_name> bdev <bdev_name>\n");
+#endif
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   Guest must be paused before save\n");
+	vmm_cprintf(cdev, "   Guest must be reset before restore\n");
+}
+
+#if defined(CONFIG_VFS)
+static size_t cmd_snapshot_file_read(void *priv, void *buf, size_t len)
+{
+	return vfs_read(*((int *)priv), buf, len);
+}
+
+static size_t cmd_snapshot_file_write(void *priv, const void *buf, size_t len)
+{
+	return vfs_write(*((int *)priv), (void *)buf, len);
+}
+#endif
+
+#if defined(CONFIG_BLOCK)
+struct cmd_snapshot_bdev {
+	struct vmm_blockdev *bdev;
+	u64 off;
+};
+
+static size_t cmd_snapshot_bdev_read(void *priv, void *buf, size_t len)
+{
+	u64 ret;
+	struct cmd_snapshot_bdev *sb = priv;
+
+	ret = vmm_blockdev_read(sb->bdev, buf, sb->off, len);
+	sb->off += ret;
+
+	return ret;
+}
+
+static size_t cmd_snapshot_bdev_write(void *priv, const void *buf, size_t len)
+{
+	u64 ret;
+	struct cmd_snapshot_bdev *sb = priv;
+
+	ret = vmm_blockdev_write(sb->bdev, (u8 *)buf, sb->off, len);
+	sb->off += ret;
+
+	return ret;
+}
+#endif
+
+static int cmd_snapshot_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int rc;
+	bool save;
+	struct vmm_guest *guest;
+	struct vmm_snapshot_stream stream;
+#if defined(CONFIG_VFS)
+	int fd = -1;
+#endif
+#if defined(CONFIG_BLOCK)
+	struct cmd_snapshot_bdev sb;
+#endif
+
+	if ((argc == 2) && (strcmp(argv[1], "help") == 0)) {
+		cmd_snapshot_usage(cdev);
+		return VMM_OK;
+	}
+	if (argc != 5) {
+		goto fail;
+	}
+	if (strcmp(argv[1], "save") == 0) {
+		save = TRUE;
+	} else if (strcmp(argv[1], "restore") == 0) {
+		save = FALSE;
+	} else {
+		goto fail;
+	}
+
+	guest = vmm_manager_guest_find(argv[2]);
+	if (!guest) {
+		vmm_cprintf(cdev, "Failed to find guest %s\n", argv[2]);
+		return VMM_ENOTAVAIL;
+	}
+
+	memset(&stream, 0, sizeof(stream));
+	if (0) {
+#if defined(CONFIG_VFS)
+	} else if (strcmp(argv[3], "file") == 0) {
+		if (save) {
+			fd = vfs_open(argv[4], O_WRONLY | O_CREAT | O_TRUNC, 0);
+		} else {
+			fd = vfs_open(argv[4], O_RDONLY, 0);
+		}
+		if (fd < 0) {
+			vmm_cprintf(cdev, "Failed to open %s\n", argv[4]);
+			return fd;
+		}
+		stream.priv = &fd;
+		stream.read = cmd_snapshot_file_read;
+		stream.write = cmd_snapshot_file_write;
+#endif
+#if defined(CONFIG_BLOCK)
+	} else if (strcmp(argv[3], "bdev") == 0) {
+		sb.bdev = vmm_blockdev_find(argv[4]);
+		if (!sb.bdev) {
+			vmm_cprintf(cdev, "Failed to find block device %s\n",
+				    argv[4]);
+			return VMM_ENOTAVAIL;
+		}
+		sb.off = 0;
+		stream.priv = &sb;
+		stream.read = cmd_snapshot_bdev_read;
+		stream.write = cmd_snapshot_bdev_write;
+#endif
+	} else {
+		goto fail;
+	}
+
+	if (save) {
+		rc = vmm_snapshot_guest_save(guest, &stream);
+		if (rc) {
+			vmm_cprintf(cdev, "Failed to save guest %s "
+				    "(error %d)\n", guest->name, rc);
+		}
+	} else {
+		rc = vmm_snapshot_guest_restore(guest, &stream);
+		if (rc) {
+			vmm_cprintf(cdev, "Failed to restore guest %s "
+				    "(error %d)\n", guest->name, rc);
+			/* Partially restored guest is not usable */
+			vmm_manager_guest_reset(guest);
+		}
+	}
+
+#if defined(CONFIG_VFS)
+	if (fd >= 0) {
+		vfs_close(fd);
+	}
+#endif
+
+	return rc;
+
+fail:
+	cmd_snapshot_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_snapshot = {
+	.name = "snapshot",
+	.desc = "save or restore guest snapshot",
+	.usage = cmd_snapshot_usage,
+	.exec = cmd_snapshot_exec,
+};
+
+static int __init cmd_snapshot_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_snapshot);
+}
+
+static void __exit cmd_snapshot_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_snapshot);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
@@ -0,0 +1,173 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_trace.c
+ * @author agent (agent@local)
+ * @brief Implementation of trace command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <vmm_trace.h>
+#include <libs/stringlib.h>
+#if defined(CONFIG_VFS)
+#include <libs/vfs.h>
+#endif
+
+#define MODULE_DESC			"Command trace"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_trace_init
+#define	MODULE_EXIT			cmd_trace_exit
+
+static void cmd_trace_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   trace help\n");
+	vmm_cprintf(cdev, "   trace events\n");
+	vmm_cprintf(cdev, "   trace start [<event_name>] ...\n");
+	vmm_cprintf(cdev, "   trace stop\n");
+#if defined(CONFIG_VFS)
+	vmm_cprintf(cdev, "   trace save <path>\n");
+#endif
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   All events are traced when no event name "
+			  "is given to start\n");
+	vmm_cprintf(cdev, "   Saved trace is in ftrace text format\n");
+}
+
+static int cmd_trace_events(struct vmm_chardev *cdev)
+{
+	u32 e;
+
+	for (e = 0; e < VMM_TRACE_MAX_EVENTS; e++) {
+		vmm_cprintf(cdev, "%s\n", vmm_trace_event_name(e));
+	}
+
+	return VMM_OK;
+}
+
+static int cmd_trace_start(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int i, e, rc;
+	u64 mask = 0;
+
+	if (argc <= 2) {
+		mask = VMM_TRACE_ALL_EVENTS;
+	}
+	for (i = 2; i < argc; i++) {
+		e = vmm_trace_event_find(argv[i]);
+		if (e < 0) {
+			vmm_cprintf(cdev, "Unknown trace event %s\n", argv[i]);
+			return e;
+		}
+		mask |= (1ULL << e);
+	}
+
+	rc = vmm_trace_start(mask);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to start tracing (error %d)\n", rc);
+	}
+
+	return rc;
+}
+
+#if defined(CONFIG_VFS)
+static size_t cmd_trace_write(void *priv, void *buf, size_t len)
+{
+	return vfs_write(*((int *)priv), buf, len);
+}
+
+static int cmd_trace_save(struct vmm_chardev *cdev, const char *path)
+{
+	int fd, rc;
+
+	if (vmm_trace_isactive()) {
+		vmm_cprintf(cdev, "Tracing must be stopped before save\n");
+		return VMM_EBUSY;
+	}
+
+	fd = vfs_open(path, O_WRONLY | O_CREAT | O_TRUNC, 0);
+	if (fd < 0) {
+		vmm_cprintf(cdev, "Failed to open %s\n", path);
+		return fd;
+	}
+
+	rc = vmm_trace_format(&fd, cmd_trace_write);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to save trace (error %d)\n", rc);
+	}
+
+	vfs_close(fd);
+
+	return rc;
+}
+#endif
+
+static int cmd_trace_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	if (argc < 2) {
+		goto fail;
+	}
+
+	if (strcmp(argv[1], "help") == 0) {
+		cmd_trace_usage(cdev);
+		return VMM_OK;
+	} else if (strcmp(argv[1], "events") == 0) {
+		return cmd_trace_events(cdev);
+	} else if (strcmp(argv[1], "start") == 0) {
+		return cmd_trace_start(cdev, argc, argv);
+	} else if (strcmp(argv[1], "stop") == 0) {
+		return vmm_trace_stop();
+#if defined(CONFIG_VFS)
+	} else if ((strcmp(argv[1], "save") == 0) && (argc == 3)) {
+		return cmd_trace_save(cdev, argv[2]);
+#endif
+	}
+
+fail:
+	cmd_trace_usage(cdev);
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_trace = {
+	.name = "trace",
+	.desc = "static tracepoint control",
+	.usage = cmd_trace_usage,
+	.exec = cmd_trace_exec,
+};
+
+static int __init cmd_trace_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_trace);
+}
+
+static void __exit cmd_trace_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_trace);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
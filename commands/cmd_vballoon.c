@@ -0,0 +1,174 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_vballoon.c
+ * @author agent (agent@local)
+ * @brief Implementation of vballoon command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <libs/stringlib.h>
+#include <emu/virtio_balloon.h>
+
+#define MODULE_DESC			"Command vballoon"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_vballoon_init
+#define	MODULE_EXIT			cmd_vballoon_exit
+
+/* Balloon pages are always 4KB */
+#define VBALLOON_PAGES_PER_MB		256
+
+static const char *const cmd_vballoon_stat_names[VIRTIO_BALLOON_S_NR] = {
+	[VIRTIO_BALLOON_S_SWAP_IN] = "swap_in",
+	[VIRTIO_BALLOON_S_SWAP_OUT] = "swap_out",
+	[VIRTIO_BALLOON_S_MAJFLT] = "major_faults",
+	[VIRTIO_BALLOON_S_MINFLT] = "minor_faults",
+	[VIRTIO_BALLOON_S_MEMFREE] = "free_memory",
+	[VIRTIO_BALLOON_S_MEMTOT] = "total_memory",
+	[VIRTIO_BALLOON_S_AVAIL] = "available_memory",
+	[VIRTIO_BALLOON_S_CACHES] = "disk_caches",
+	[VIRTIO_BALLOON_S_HTLB_PGALLOC] = "hugetlb_allocations",
+	[VIRTIO_BALLOON_S_HTLB_PGFAIL] = "hugetlb_failures",
+};
+
+static void cmd_vballoon_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   vballoon help\n");
+	vmm_cprintf(cdev, "   vballoon info <guest_name>/<dev_name>\n");
+	vmm_cprintf(cdev, "   vballoon target <guest_name>/<dev_name> "
+			  "<size_in_MB>\n");
+	vmm_cprintf(cdev, "   vballoon stats <guest_name>/<dev_name>\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   Target is the memory guest should give up\n");
+	vmm_cprintf(cdev, "   Stats asks guest to refresh its statistics "
+			  "and shows the last ones received\n");
+}
+
+static int cmd_vballoon_info(struct vmm_chardev *cdev, const char *name)
+{
+	int rc;
+	struct virtio_balloon_info info;
+
+	if ((rc = virtio_balloon_get_info(name, &info))) {
+		vmm_cprintf(cdev, "Failed to find balloon device %s\n", name);
+		return rc;
+	}
+
+	vmm_cprintf(cdev, "Target         : %d MB (%d pages)\n",
+		    info.target_pages / VBALLOON_PAGES_PER_MB,
+		    info.target_pages);
+	vmm_cprintf(cdev, "Actual         : %d MB (%d pages)\n",
+		    info.actual_pages / VBALLOON_PAGES_PER_MB,
+		    info.actual_pages);
+	vmm_cprintf(cdev, "Inflated       : %d MB (%d pages)\n",
+		    info.inflated_pages / VBALLOON_PAGES_PER_MB,
+		    info.inflated_pages);
+	vmm_cprintf(cdev, "Reported free  : %"PRIu64" MB\n",
+		    info.reported_bytes >> 20);
+
+	return VMM_OK;
+}
+
+static int cmd_vballoon_target(struct vmm_chardev *cdev,
+			       const char *name, const char *size)
+{
+	int rc;
+	u32 mb = (u32)atoi(size);
+
+	if ((rc = virtio_balloon_set_target(name,
+					    mb * VBALLOON_PAGES_PER_MB))) {
+		vmm_cprintf(cdev, "Failed to set target of %s (error %d)\n",
+			    name, rc);
+	}
+
+	return rc;
+}
+
+static int cmd_vballoon_stats(struct vmm_chardev *cdev, const char *name)
+{
+	int rc;
+	u32 i;
+	struct virtio_balloon_info info;
+
+	if ((rc = virtio_balloon_get_info(name, &info))) {
+		vmm_cprintf(cdev, "Failed to find balloon device %s\n", name);
+		return rc;
+	}
+	if (!info.stats_tstamp) {
+		vmm_cprintf(cdev, "No statistics received from guest\n");
+		return VMM_OK;
+	}
+
+	for (i = 0; i < VIRTIO_BALLOON_S_NR; i++) {
+		vmm_cprintf(cdev, "%-20s: %"PRIu64"\n",
+			    cmd_vballoon_stat_names[i], info.stats[i]);
+	}
+
+	/* Refreshed statistics show up on next invocation */
+	virtio_balloon_request_stats(name);
+
+	return VMM_OK;
+}
+
+static int cmd_vballoon_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	if ((argc == 2) && (strcmp(argv[1], "help") == 0)) {
+		cmd_vballoon_usage(cdev);
+		return VMM_OK;
+	} else if ((argc == 3) && (strcmp(argv[1], "info") == 0)) {
+		return cmd_vballoon_info(cdev, argv[2]);
+	} else if ((argc == 4) && (strcmp(argv[1], "target") == 0)) {
+		return cmd_vballoon_target(cdev, argv[2], argv[3]);
+	} else if ((argc == 3) && (strcmp(argv[1], "stats") == 0)) {
+		return cmd_vballoon_stats(cdev, argv[2]);
+	}
+
+	cmd_vballoon_usage(cdev);
+
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_vballoon = {
+	.name = "vballoon",
+	.desc = "virtio memory balloon control",
+	.usage = cmd_vballoon_usage,
+	.exec = cmd_vballoon_exec,
+};
+
+static int __init cmd_vballoon_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_vballoon);
+}
+
+static void __exit cmd_vballoon_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_vballoon);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
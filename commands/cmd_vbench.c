@@ -0,0 +1,172 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_vbench.c
+ * @author agent (agent@local)
+ * @brief Implementation of vbench command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+#include <emu/virtio_bench.h>
+
+#define MODULE_DESC			"Command vbench"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_vbench_init
+#define	MODULE_EXIT			cmd_vbench_exit
+
+static void cmd_vbench_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   vbench help\n");
+	vmm_cprintf(cdev, "   vbench blk <guest_name>/<dev_name> <read|write> "
+			  "<qdepth> <bsize> <count>\n");
+	vmm_cprintf(cdev, "   vbench net <guest_name>/<dev_name> <qdepth> "
+			  "<pkt_size> <count> [<peer_guest>/<peer_dev>]\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   Guest owning device must be stopped or reset\n");
+	vmm_cprintf(cdev, "   Guest RAM is overwritten so reset Guest after "
+			  "benchmark\n");
+	vmm_cprintf(cdev, "   Maximum qdepth is %d\n", VIRTIO_BENCH_MAX_QDEPTH);
+}
+
+static void cmd_vbench_report(struct vmm_chardev *cdev, const char *title,
+			      struct virtio_bench_stats *s)
+{
+	u64 iops = 0, kbps = 0;
+
+	if (s->nsecs) {
+		iops = udiv64((u64)s->done * 1000000000ULL, s->nsecs);
+		kbps = udiv64(s->bytes * 1000000ULL, s->nsecs);
+	}
+
+	vmm_cprintf(cdev, "%s:\n", title);
+	vmm_cprintf(cdev, "   done=%d errors=%d time=%"PRIu64" ns\n",
+		    s->done, s->errors, s->nsecs);
+	vmm_cprintf(cdev, "   ops/sec=%"PRIu64" throughput=%"PRIu64" KB/s\n",
+		    iops, kbps);
+	vmm_cprintf(cdev, "   latency (ns): min=%"PRIu64" avg=%"PRIu64
+		    " max=%"PRIu64"\n", s->lat_min, s->lat_avg, s->lat_max);
+	vmm_cprintf(cdev, "   latency (ns): p50=%"PRIu64" p90=%"PRIu64
+		    " p99=%"PRIu64" p99.9=%"PRIu64"\n",
+		    s->lat_p50, s->lat_p90, s->lat_p99, s->lat_p999);
+}
+
+static int cmd_vbench_blk(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int rc;
+	struct virtio_bench_params p;
+	struct virtio_bench_stats s;
+
+	if (strcmp(argv[3], "write") == 0) {
+		p.write = TRUE;
+	} else if (strcmp(argv[3], "read") == 0) {
+		p.write = FALSE;
+	} else {
+		cmd_vbench_usage(cdev);
+		return VMM_EINVALID;
+	}
+	p.qdepth = atoi(argv[4]);
+	p.size = atoi(argv[5]);
+	p.count = atoi(argv[6]);
+
+	rc = virtio_bench_blk(argv[2], &p, &s);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to benchmark %s (error %d)\n",
+			    argv[2], rc);
+		return rc;
+	}
+
+	cmd_vbench_report(cdev, (p.write) ? "Write" : "Read", &s);
+
+	return VMM_OK;
+}
+
+static int cmd_vbench_net(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	int rc;
+	const char *peer = (argc == 7) ? argv[6] : NULL;
+	struct virtio_bench_params p;
+	struct virtio_bench_stats tx, rx;
+
+	p.qdepth = atoi(argv[3]);
+	p.size = atoi(argv[4]);
+	p.count = atoi(argv[5]);
+	p.write = TRUE;
+
+	rc = virtio_bench_net(argv[2], peer, &p, &tx, &rx);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to benchmark %s (error %d)\n",
+			    argv[2], rc);
+		return rc;
+	}
+
+	cmd_vbench_report(cdev, "Transmit", &tx);
+	if (peer) {
+		cmd_vbench_report(cdev, "Receive (end-to-end)", &rx);
+	}
+
+	return VMM_OK;
+}
+
+static int cmd_vbench_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	if ((argc == 2) && (strcmp(argv[1], "help") == 0)) {
+		cmd_vbench_usage(cdev);
+		return VMM_OK;
+	} else if ((argc == 7) && (strcmp(argv[1], "blk") == 0)) {
+		return cmd_vbench_blk(cdev, argc, argv);
+	} else if (((argc == 6) || (argc == 7)) &&
+		   (strcmp(argv[1], "net") == 0)) {
+		return cmd_vbench_net(cdev, argc, argv);
+	}
+
+	cmd_vbench_usage(cdev);
+
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_vbench = {
+	.name = "vbench",
+	.desc = "virtio block and network benchmark",
+	.usage = cmd_vbench_usage,
+	.exec = cmd_vbench_exec,
+};
+
+static int __init cmd_vbench_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_vbench);
+}
+
+static void __exit cmd_vbench_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_vbench);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
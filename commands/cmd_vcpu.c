@@ -24,9 +24,11 @@
 #include <vmm_error.h>
 #include <vmm_stdio.h>
 #include <vmm_delay.h>
+#include <vmm_heap.h>
 #include <vmm_devtree.h>
 #include <vmm_manager.h>
 #include <vmm_scheduler.h>
+#include <vmm_vcpu_irq.h>
 #include <vmm_host_ram.h>
 #include <vmm_host_vapool.h>
 #include <vmm_host_aspace.h>
@@ -58,6 +60,15 @@ static void cmd_vcpu_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   vcpu halt    <vcpu_id>\n");
 	vmm_cprintf(cdev, "   vcpu dumpreg <vcpu_id>\n");
 	vmm_cprintf(cdev, "   vcpu dumpstat <vcpu_id>\n");
+#ifdef CONFIG_VCPU_EXIT_STATS
+	vmm_cprintf(cdev, "   vcpu exits <vcpu_id>\n");
+	vmm_cprintf(cdev, "   vcpu exits_reset <vcpu_id>\n");
+#endif
+#ifdef CONFIG_SCHED_LATENCY
+	vmm_cprintf(cdev, "   vcpu latency <vcpu_id>\n");
+	vmm_cprintf(cdev, "   vcpu latency_reset <vcpu_id>\n");
+	vmm_cprintf(cdev, "   vcpu sched_trace <hcpu>\n");
+#endif
 }
 
 static int cmd_vcpu_help(struct vmm_chardev *cdev,
@@ -452,6 +463,7 @@ static int cmd_vcpu_dumpstat(struct vmm_chardev *cdev,
 	u32 state, hcpu, reset_count;
 	u64 last_reset_nsecs, total_nsecs;
 	u64 ready_nsecs, running_nsecs, paused_nsecs, halted_nsecs;
+	u64 poll_ns, poll_success, poll_fail;
 	struct vmm_vcpu *vcpu;
 
 	if (!argc) {
@@ -534,12 +546,263 @@ static int cmd_vcpu_dumpstat(struct vmm_chardev *cdev,
 			  h, m, s, ms);
 	vmm_cprintf(cdev, "\n");
 
+	/* Halt polling statistics */
+	if (!vmm_vcpu_irq_wait_poll_stats(vcpu, &poll_ns,
+					  &poll_success, &poll_fail)) {
+		vmm_cprintf(cdev, "Halt Poll Window : %"PRIu64" ns\n",
+				  poll_ns);
+		vmm_cprintf(cdev, "Halt Poll Hits   : %"PRIu64"\n",
+				  poll_success);
+		vmm_cprintf(cdev, "Halt Poll Misses : %"PRIu64"\n",
+				  poll_fail);
+		vmm_cprintf(cdev, "\n");
+	}
+
 	/* Architecture specific dumpstat */
 	arch_vcpu_stat_dump(cdev, vcpu);
 
 	return ret;
 }
 
+#ifdef CONFIG_VCPU_EXIT_STATS
+static int cmd_vcpu_exits(struct vmm_chardev *cdev,
+			  int argc, char **argv)
+{
+	int id;
+	bool last;
+	u32 r, b, p, limit;
+	struct vmm_vcpu *vcpu;
+	struct vmm_vcpu_exit_stats st;
+
+	if (!argc) {
+		vmm_cprintf(cdev, "Must provide vcpu ID\n");
+		return VMM_EINVALID;
+	}
+	id = atoi(argv[0]);
+
+	vcpu = vmm_manager_vcpu(id);
+	if (!vcpu) {
+		vmm_cprintf(cdev, "Failed to find vcpu\n");
+		return VMM_EFAIL;
+	}
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " %-10s %-12s %-12s %-10s %-10s\n",
+			  "Reason", "Count", "Total(us)", "Avg(ns)", "Max(ns)");
+	vmm_cprintf(cdev, " %-10s", "Histogram");
+	for (b = 0; b < VMM_VCPU_EXIT_HIST_BUCKETS; b++) {
+		last = (b == (VMM_VCPU_EXIT_HIST_BUCKETS - 1)) ? TRUE : FALSE;
+		limit = 256 << ((last) ? (b - 1) : b);
+		if (limit < 1024) {
+			vmm_cprintf(cdev, " %s%dns", (last) ? ">=" : "<", limit);
+		} else {
+			vmm_cprintf(cdev, " %s%dus", (last) ? ">=" : "<",
+				    limit >> 10);
+		}
+	}
+	vmm_cprintf(cdev, "\n");
+	vmm_cprintf(cdev, " %-10s", "Avg(ns)");
+	for (p = 0; p < VMM_VCPU_EXIT_PHASE_MAX; p++) {
+		vmm_cprintf(cdev, " %-10s", vmm_manager_vcpu_exit_phase_name(p));
+	}
+	vmm_cprintf(cdev, "\n");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	for (r = 0; r < VMM_VCPU_EXIT_MAX; r++) {
+		if (vmm_manager_vcpu_exit_stats(vcpu, r, &st) ||
+		    !st.count) {
+			continue;
+		}
+
+		vmm_cprintf(cdev, " %-10s %-12"PRIu64" %-12"PRIu64" "
+			    "%-10"PRIu64" %-10"PRIu64"\n",
+			    vmm_manager_vcpu_exit_name(r), st.count,
+			    udiv64(st.total_ns, 1000),
+			    udiv64(st.total_ns, st.count), st.max_ns);
+		vmm_cprintf(cdev, " %-10s", "");
+		for (b = 0; b < VMM_VCPU_EXIT_HIST_BUCKETS; b++) {
+			vmm_cprintf(cdev, " %-6d", st.hist[b]);
+		}
+		vmm_cprintf(cdev, "\n");
+		vmm_cprintf(cdev, " %-10s", "");
+		for (p = 0; p < VMM_VCPU_EXIT_PHASE_MAX; p++) {
+			vmm_cprintf(cdev, " %-10"PRIu64,
+				    udiv64(st.phase_ns[p], st.count));
+		}
+		vmm_cprintf(cdev, "\n");
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+
+	return VMM_OK;
+}
+
+static int cmd_vcpu_exits_reset(struct vmm_chardev *cdev,
+				int argc, char **argv)
+{
+	if (!argc) {
+		vmm_cprintf(cdev, "Must provide vcpu ID\n");
+		return VMM_EINVALID;
+	}
+
+	return vmm_manager_vcpu_exit_stats_reset(
+					vmm_manager_vcpu(atoi(argv[0])));
+}
+#endif
+
+#ifdef CONFIG_SCHED_LATENCY
+static int cmd_vcpu_latency(struct vmm_chardev *cdev,
+			    int argc, char **argv)
+{
+	int id;
+	bool last;
+	u32 t, b, limit;
+	struct vmm_vcpu *vcpu;
+	struct vmm_vcpu_sched_latency lat[VMM_VCPU_SCHED_MAX];
+
+	if (!argc) {
+		vmm_cprintf(cdev, "Must provide vcpu ID\n");
+		return VMM_EINVALID;
+	}
+	id = atoi(argv[0]);
+
+	vcpu = vmm_manager_vcpu(id);
+	if (!vcpu) {
+		vmm_cprintf(cdev, "Failed to find vcpu\n");
+		return VMM_EFAIL;
+	}
+
+	for (t = 0; t < VMM_VCPU_SCHED_MAX; t++) {
+		vmm_manager_vcpu_sched_latency(vcpu, t, &lat[t]);
+	}
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " %-12s", "Latency");
+	for (t = 0; t < VMM_VCPU_SCHED_MAX; t++) {
+		vmm_cprintf(cdev, " %-14s",
+			    vmm_manager_vcpu_sched_latency_name(t));
+	}
+	vmm_cprintf(cdev, "\n");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " %-12s", "Count");
+	for (t = 0; t < VMM_VCPU_SCHED_MAX; t++) {
+		vmm_cprintf(cdev, " %-14"PRIu64, lat[t].count);
+	}
+	vmm_cprintf(cdev, "\n %-12s", "Avg(ns)");
+	for (t = 0; t < VMM_VCPU_SCHED_MAX; t++) {
+		vmm_cprintf(cdev, " %-14"PRIu64, (lat[t].count) ?
+			    udiv64(lat[t].total_ns, lat[t].count) : 0);
+	}
+	vmm_cprintf(cdev, "\n %-12s", "Max(ns)");
+	for (t = 0; t < VMM_VCPU_SCHED_MAX; t++) {
+		vmm_cprintf(cdev, " %-14"PRIu64, lat[t].max_ns);
+	}
+	vmm_cprintf(cdev, "\n");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	for (b = 0; b < VMM_VCPU_SCHED_HIST_BUCKETS; b++) {
+		last = (b == (VMM_VCPU_SCHED_HIST_BUCKETS - 1)) ? TRUE : FALSE;
+		limit = 1 << ((last) ? (b - 1) : b);
+		vmm_cprintf(cdev, " %s%-8dus", (last) ? ">=" : "< ", limit);
+		for (t = 0; t < VMM_VCPU_SCHED_MAX; t++) {
+			vmm_cprintf(cdev, " %-14d", lat[t].hist[b]);
+		}
+		vmm_cprintf(cdev, "\n");
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+
+	return VMM_OK;
+}
+
+static int cmd_vcpu_latency_reset(struct vmm_chardev *cdev,
+				  int argc, char **argv)
+{
+	if (!argc) {
+		vmm_cprintf(cdev, "Must provide vcpu ID\n");
+		return VMM_EINVALID;
+	}
+
+	return vmm_manager_vcpu_sched_latency_reset(
+					vmm_manager_vcpu(atoi(argv[0])));
+}
+
+static const char *cmd_vcpu_state_name(u32 state)
+{
+	switch (state) {
+	case VMM_VCPU_STATE_RESET:
+		return "Reset";
+	case VMM_VCPU_STATE_READY:
+		return "Ready";
+	case VMM_VCPU_STATE_RUNNING:
+		return "Running";
+	case VMM_VCPU_STATE_PAUSED:
+		return "Paused";
+	case VMM_VCPU_STATE_HALTED:
+		return "Halted";
+	default:
+		break;
+	};
+
+	return "-";
+}
+
+static int cmd_vcpu_sched_trace(struct vmm_chardev *cdev,
+				int argc, char **argv)
+{
+	u32 i, count, lost = 0, hcpu;
+	struct vmm_scheduler_trace *buf, *tr;
+
+	if (!argc) {
+		vmm_cprintf(cdev, "Must provide host CPU\n");
+		return VMM_EINVALID;
+	}
+	hcpu = atoi(argv[0]);
+	if (CONFIG_CPU_COUNT <= hcpu) {
+		vmm_cprintf(cdev, "Invalid host CPU\n");
+		return VMM_EINVALID;
+	}
+
+	buf = vmm_malloc(CONFIG_SCHED_TRACE_COUNT * sizeof(*buf));
+	if (!buf) {
+		return VMM_ENOMEM;
+	}
+	count = vmm_scheduler_trace_read(hcpu, buf,
+					 CONFIG_SCHED_TRACE_COUNT, &lost);
+
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " %-16s %-10s %-10s %-10s %-10s %-10s\n",
+			  "Timestamp(ns)", "Delta(ns)", "Prev", "PrevState",
+			  "Next", "NextPrio");
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	for (i = 0; i < count; i++) {
+		tr = &buf[i];
+		vmm_cprintf(cdev, " %-16"PRIu64" %-10"PRIu64, tr->tstamp,
+			    (i) ? tr->tstamp - buf[i - 1].tstamp : 0);
+		if (tr->prev_id == VMM_SCHEDULER_TRACE_NO_VCPU) {
+			vmm_cprintf(cdev, " %-10s", "-");
+		} else {
+			vmm_cprintf(cdev, " %-10d", tr->prev_id);
+		}
+		vmm_cprintf(cdev, " %-10s %-10d %-10d\n",
+			    cmd_vcpu_state_name(tr->prev_state),
+			    tr->next_id, tr->next_priority);
+	}
+	vmm_cprintf(cdev, "----------------------------------------"
+			  "----------------------------------------\n");
+	vmm_cprintf(cdev, " Records: %d (%d overwritten)\n", count, lost);
+
+	vmm_free(buf);
+
+	return VMM_OK;
+}
+#endif
+
 static const struct {
 	char *name;
 	int (*function) (struct vmm_chardev *, int, char **);
@@ -556,6 +819,15 @@ static const struct {
 	{"halt", cmd_vcpu_halt},
 	{"dumpreg", cmd_vcpu_dumpreg},
 	{"dumpstat", cmd_vcpu_dumpstat},
+#ifdef CONFIG_VCPU_EXIT_STATS
+	{"exits", cmd_vcpu_exits},
+	{"exits_reset", cmd_vcpu_exits_reset},
+#endif
+#ifdef CONFIG_SCHED_LATENCY
+	{"latency", cmd_vcpu_latency},
+	{"latency_reset", cmd_vcpu_latency_reset},
+	{"sched_trace", cmd_vcpu_sched_trace},
+#endif
 	{NULL, NULL},
 };
 	
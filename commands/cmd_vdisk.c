@@ -23,6 +23,7 @@
 
 #include <vmm_error.h>
 #include <vmm_stdio.h>
+#include <vmm_heap.h>
 #include <vmm_devtree.h>
 #include <vmm_modules.h>
 #include <vmm_cmdmgr.h>
@@ -87,9 +88,12 @@ static int cmd_vdisk_info(struct vmm_chardev *cdev,
 		"Block Size  : %"PRIu32"\n"
 		"Block Factor: %"PRIu32"\n"
 		"Capacity    : %"PRIu64"\n"
+		"Queue Depth : %"PRIu32"\n"
+		"Bounce Free : %"PRIu64"\n"
 		"Block Device: %s\n",
 		vmm_vdisk_name(vdisk), vmm_vdisk_block_size(vdisk),
 		vdisk->blk_factor, vmm_vdisk_capacity(vdisk),
+		vdisk->queue_depth, (u64)vmm_arena_free_size(vdisk->pool),
 		vdisk->blk ? vdisk->blk->name : "NONE");
 
 	return VMM_OK;
@@ -28,6 +28,7 @@
 #include <vmm_devtree.h>
 #include <vmm_wallclock.h>
 #include <vmm_manager.h>
+#include <vmm_host_ram.h>
 #include <vmm_host_aspace.h>
 #include <vmm_guest_aspace.h>
 #include <vmm_modules.h>
@@ -45,6 +46,10 @@
 #include <libs/sha256.h>
 #endif
 
+#if CONFIG_LZ4
+#include <libs/lz4.h>
+#endif
+
 #define MODULE_DESC			"Command vfs"
 #define MODULE_AUTHOR			"Anup Patel"
 #define MODULE_LICENSE			"GPL"
@@ -55,6 +60,7 @@
 #define VFS_MAX_MODULE_SZ		(256 * 1024)
 #define VFS_MAX_FDT_SZ			(32 * 1024)
 #define VFS_LOAD_BUF_SZ			(4 * 1024)
+#define VFS_LOAD_LZ4_BUF_SZ		(64 * 1024)
 
 static void cmd_vfs_usage(struct vmm_chardev *cdev)
 {
@@ -64,6 +70,9 @@ static void cmd_vfs_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   vfs mplist\n");
 	vmm_cprintf(cdev, "   vfs mount <bdev_name> <path_to_mount> "
 			  "[wait_sec]\n");
+	vmm_cprintf(cdev, "   vfs mount_bg <bdev_name> <path_to_mount> "
+			  "[wait_sec]\n");
+	vmm_cprintf(cdev, "   vfs mount_wait\n");
 	vmm_cprintf(cdev, "   vfs umount <path_to_unmount>\n");
 	vmm_cprintf(cdev, "   vfs ls <path_to_dir>\n");
 	vmm_cprintf(cdev, "   vfs cat <path_to_file>\n");
@@ -86,11 +95,27 @@ static void cmd_vfs_usage(struct vmm_chardev *cdev)
 	vmm_cprintf(cdev, "   vfs host_load <host_phys_addr> "
 			  "<path_to_file> [<file_offset>] [<byte_count>]\n");
 	vmm_cprintf(cdev, "   vfs host_load_list <path_to_list_file>\n");
+#if CONFIG_CRYPTO_HASH_SHA256
+	vmm_cprintf(cdev, "   vfs host_load_verify <host_phys_addr> "
+			  "<path_to_file> <sha256_hex> [<file_offset>] "
+			  "[<byte_count>]\n");
+#endif
 	vmm_cprintf(cdev, "   vfs guest_load <guest_name> <guest_phys_addr> "
 			  "<path_to_file> [<file_offset>] [<byte_count>]\n");
 	vmm_cprintf(cdev, "   vfs guest_load_list <guest_name> "
 			  "<path_to_list_file>\n");
+#if CONFIG_CRYPTO_HASH_SHA256
+	vmm_cprintf(cdev, "   vfs guest_load_verify <guest_name> "
+			  "<guest_phys_addr> <path_to_file> <sha256_hex> "
+			  "[<file_offset>] [<byte_count>]\n");
+#endif
+	vmm_cprintf(cdev, "   vfs guest_map <guest_name> <guest_phys_addr> "
+			  "<path_to_file> [<file_offset>] [<byte_count>]\n");
 	vmm_cprintf(cdev, "Note:\n");
+#if CONFIG_LZ4
+	vmm_cprintf(cdev, "   Files ending with .lz4 (LZ4 frames) are "
+			  "decompressed while loading\n");
+#endif
 	vmm_cprintf(cdev, "   <attr_type> = unknown|string|bytes|"
 					   "uint32|uint64|"
 			  		   "physaddr|physsize|"
@@ -995,16 +1020,173 @@ fail:
 	return rc;
 }
 
+/* Only host RAM can be filled through cacheable mapping */
+static bool cmd_vfs_is_host_ram(physical_addr_t pa, u32 len)
+{
+	u32 b;
+	physical_addr_t start;
+
+	for (b = 0; b < vmm_host_ram_bank_count(); b++) {
+		start = vmm_host_ram_bank_start(b);
+		if ((start <= pa) &&
+		    ((pa + len) <= (start + vmm_host_ram_bank_size(b)))) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+#if CONFIG_CRYPTO_HASH_SHA256
+static void cmd_vfs_load_hash(void *priv, const void *buf, size_t len)
+{
+	sha256_update(priv, (u8 *)buf, len);
+}
+
+static int cmd_vfs_parse_sha256(const char *str, sha256_digest_t digest)
+{
+	int i, j;
+	char c;
+
+	if (strlen(str) != (2 * SHA256_DIGEST_LEN)) {
+		return VMM_EINVALID;
+	}
+
+	for (i = 0; i < SHA256_DIGEST_LEN; i++) {
+		digest[i] = 0;
+		for (j = 0; j < 2; j++) {
+			c = str[2 * i + j];
+			if ('0' <= c && c <= '9') {
+				c = c - '0';
+			} else if ('a' <= c && c <= 'f') {
+				c = c - 'a' + 10;
+			} else if ('A' <= c && c <= 'F') {
+				c = c - 'A' + 10;
+			} else {
+				return VMM_EINVALID;
+			}
+			digest[i] = (digest[i] << 4) | c;
+		}
+	}
+
+	return VMM_OK;
+}
+#endif
+
+#if CONFIG_LZ4
+struct cmd_vfs_lz4_dest {
+	struct vmm_guest *guest;
+	physical_addr_t pa;
+	size_t count;
+};
+
+static bool cmd_vfs_is_lz4(const char *path)
+{
+	size_t plen = strlen(path);
+
+	return (plen > 4) && !strcmp(&path[plen - 4], ".lz4");
+}
+
+static int cmd_vfs_lz4_write(void *priv, const u8 *buf, size_t len)
+{
+	u32 wr;
+	struct cmd_vfs_lz4_dest *d = priv;
+
+	if (d->guest) {
+		wr = vmm_guest_memory_write(d->guest, d->pa,
+					    (void *)buf, len, FALSE);
+	} else {
+		wr = vmm_host_memory_write(d->pa, (void *)buf, len, FALSE);
+	}
+	d->pa += wr;
+	d->count += wr;
+
+	return (wr == len) ? VMM_OK : VMM_EIO;
+}
+
+/* Decompress len bytes of LZ4 frames from file while reading them */
+static int cmd_vfs_load_lz4(struct vmm_chardev *cdev,
+			    struct vmm_guest *guest,
+			    physical_addr_t pa, int fd, u32 len,
+			    void (*observe)(void *, const void *, size_t),
+			    void *observe_priv, size_t *wr_count)
+{
+	int rc = VMM_OK, rc1;
+	size_t buf_rd, buf_count;
+	char *buf;
+	struct lz4_stream s;
+	struct cmd_vfs_lz4_dest d;
+
+	if (NULL == (buf = vmm_malloc(VFS_LOAD_LZ4_BUF_SZ))) {
+		vmm_cprintf(cdev, "Failed to allocate buffer\n");
+		return VMM_ENOMEM;
+	}
+
+	d.guest = guest;
+	d.pa = pa;
+	d.count = 0;
+	lz4_stream_init(&s, cmd_vfs_lz4_write, &d);
+
+	while (len) {
+		buf_rd = (len < VFS_LOAD_LZ4_BUF_SZ) ?
+					len : VFS_LOAD_LZ4_BUF_SZ;
+		buf_count = vfs_read(fd, buf, buf_rd);
+		if (buf_count < 1) {
+			break;
+		}
+		if (observe) {
+			observe(observe_priv, buf, buf_count);
+		}
+		rc = lz4_stream_decompress(&s, buf, buf_count);
+		if (rc) {
+			break;
+		}
+		len -= buf_count;
+	}
+
+	rc1 = lz4_stream_end(&s);
+	rc = (rc) ? rc : rc1;
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to decompress @ 0x%"PRIPADDR
+				  " (error %d)\n", d.pa, rc);
+	}
+	*wr_count = d.count;
+
+	vmm_free(buf);
+
+	return rc;
+}
+#endif
+
 static int cmd_vfs_load(struct vmm_chardev *cdev,
 			struct vmm_guest *guest,
 			physical_addr_t pa,
-			const char *path, u32 off, u32 len)
+			const char *path, u32 off, u32 len,
+			const char *sha256)
 {
-	int fd, rc;
+	int fd, rc, load_rc = VMM_OK;
 	loff_t rd_off;
 	physical_addr_t wr_pa;
 	size_t buf_wr, buf_rd, buf_count, wr_count;
 	char *buf = NULL;
+	void (*observe)(void *, const void *, size_t) = NULL;
+	void *observe_priv = NULL;
+#if CONFIG_CRYPTO_HASH_SHA256
+	struct sha256_context sha256c;
+	sha256_digest_t digest, expected;
+
+	/* Image is hashed while it is being loaded */
+	if (sha256) {
+		if (cmd_vfs_parse_sha256(sha256, expected)) {
+			vmm_cprintf(cdev, "Invalid SHA-256 digest %s\n",
+				    sha256);
+			return VMM_EINVALID;
+		}
+		sha256_init(&sha256c);
+		observe = cmd_vfs_load_hash;
+		observe_priv = &sha256c;
+	}
+#endif
 
 	rc = cmd_vfs_file_open_read(cdev, path, &fd, &len);
 	if (VMM_OK != rc) {
@@ -1017,17 +1199,52 @@ static int cmd_vfs_load(struct vmm_chardev *cdev,
 		return VMM_EINVALID;
 	}
 
-	if (NULL == (buf = vmm_malloc(VFS_LOAD_BUF_SZ))) {
-		vmm_cprintf(cdev, "Failed to allocate buffer\n");
+	len = ((len - off) < len) ? (len - off) : len;
+
+	if (off && (vfs_lseek(fd, off, SEEK_SET) != off)) {
 		vfs_close(fd);
-		return VMM_ENOMEM;
+		vmm_cprintf(cdev, "Failed to seek %s\n", path);
+		return VMM_EIO;
 	}
 
-	len = ((len - off) < len) ? (len - off) : len;
-
-	rd_off = 0;
+	rd_off = off;
 	wr_count = 0;
 	wr_pa = pa;
+
+#if CONFIG_LZ4
+	/* Compressed images are unpacked straight into destination */
+	if (cmd_vfs_is_lz4(path)) {
+		load_rc = cmd_vfs_load_lz4(cdev, guest, pa, fd, len,
+					   observe, observe_priv, &wr_count);
+		len = 0;
+	} else
+#endif
+	/* Guest and host memory is filled directly without bounce buffer */
+	if (guest) {
+		wr_count = vfs_read_into_guest(fd, guest, pa, len,
+					       observe, observe_priv);
+		if (wr_count != len) {
+			vmm_cprintf(cdev, "Failed to load %zu bytes "
+					  "@ 0x%"PRIPADDR" (%s)\n",
+					  len - wr_count, pa + wr_count,
+					  guest->name);
+		}
+		len = 0;
+	} else if (cmd_vfs_is_host_ram(pa, len)) {
+		wr_count = vfs_read_into_host(fd, pa, len,
+					      observe, observe_priv);
+		if (wr_count != len) {
+			vmm_cprintf(cdev, "Failed to load %zu bytes "
+					  "@ 0x%"PRIPADDR" (host)\n",
+					  len - wr_count, pa + wr_count);
+		}
+		len = 0;
+	} else if (NULL == (buf = vmm_malloc(VFS_LOAD_BUF_SZ))) {
+		vmm_cprintf(cdev, "Failed to allocate buffer\n");
+		vfs_close(fd);
+		return VMM_ENOMEM;
+	}
+
 	while (len) {
 		buf_rd = (len < VFS_LOAD_BUF_SZ) ? len : VFS_LOAD_BUF_SZ;
 		buf_count = vfs_read(fd, buf, buf_rd);
@@ -1038,18 +1255,14 @@ static int cmd_vfs_load(struct vmm_chardev *cdev,
 			break;
 		}
 		rd_off += buf_count;
-		if (guest) {
-			buf_wr = vmm_guest_memory_write(guest, wr_pa,
-							buf, buf_count, FALSE);
-		} else {
-			buf_wr = vmm_host_memory_write(wr_pa,
-						       buf, buf_count, FALSE);
+		if (observe) {
+			observe(observe_priv, buf, buf_count);
 		}
+		buf_wr = vmm_host_memory_write(wr_pa, buf, buf_count, FALSE);
 		if (buf_wr != buf_count) {
 			vmm_cprintf(cdev, "Failed to write "
-					  "%zu bytes @ 0x%"PRIPADDR" (%s)\n",
-					  buf_count, wr_pa,
-					  (guest) ? (guest->name) : "host");
+					  "%zu bytes @ 0x%"PRIPADDR" (host)\n",
+					  buf_count, wr_pa);
 			break;
 		}
 		len -= buf_wr;
@@ -1061,12 +1274,33 @@ static int cmd_vfs_load(struct vmm_chardev *cdev,
 			  (guest) ? (guest->name) : "host",
 			  pa, wr_count);
 
-	vmm_free(buf);
+	if (buf) {
+		vmm_free(buf);
+	}
 	rc = vfs_close(fd);
 	if (rc) {
 		vmm_cprintf(cdev, "Failed to close %s\n", path);
 		return rc;
 	}
+	if (load_rc) {
+		return load_rc;
+	}
+
+#if CONFIG_CRYPTO_HASH_SHA256
+	if (observe) {
+		sha256_final(digest, &sha256c);
+		if (memcmp(digest, expected, SHA256_DIGEST_LEN)) {
+			vmm_cprintf(cdev, "%s: SHA-256 digest mismatch\n",
+				    path);
+			return VMM_EFAIL;
+		}
+		vmm_cprintf(cdev, "%s: SHA-256 digest verified\n", path);
+	}
+#endif
+
+	if (guest) {
+		vmm_manager_guest_boot_mark(guest, VMM_GUEST_BOOT_IMAGE_LOADED);
+	}
 
 	return VMM_OK;
 }
@@ -1165,7 +1399,7 @@ static int cmd_vfs_load_list(struct vmm_chardev *cdev,
 			    (guest) ? (guest->name) : "host",
 			    pa, token);
 
-		rc = cmd_vfs_load(cdev, guest, pa, token, 0, 0xFFFFFFFF);
+		rc = cmd_vfs_load(cdev, guest, pa, token, 0, 0xFFFFFFFF, NULL);
 		if (rc) {
 			vmm_cprintf(cdev, "error %d\n", rc);
 			break;
@@ -1182,6 +1416,65 @@ static int cmd_vfs_load_list(struct vmm_chardev *cdev,
 	return VMM_OK;
 }
 
+static int cmd_vfs_map(struct vmm_chardev *cdev,
+		       struct vmm_guest *guest,
+		       physical_addr_t pa,
+		       const char *path, u32 off, u32 len)
+{
+	int fd, rc;
+	u32 flen;
+	char name[32];
+	physical_addr_t hpa;
+
+	rc = cmd_vfs_file_open_read(cdev, path, &fd, &flen);
+	if (VMM_OK != rc) {
+		return rc;
+	}
+
+	if (off >= flen) {
+		vfs_close(fd);
+		vmm_cprintf(cdev, "Offset greater than file size\n");
+		return VMM_EINVALID;
+	}
+
+	if ((flen - off) < len) {
+		len = flen - off;
+	}
+
+	/* File pages are mapped into guest without any copy */
+	rc = vfs_mmap(fd, off, len, &hpa);
+	vfs_close(fd);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to map %s (error %d)\n", path, rc);
+		return rc;
+	}
+
+	if ((hpa & VMM_PAGE_MASK) || (pa & VMM_PAGE_MASK)) {
+		vmm_cprintf(cdev, "Host address 0x%"PRIPADDR" or guest "
+				  "address 0x%"PRIPADDR" not page aligned\n",
+				  hpa, pa);
+		return VMM_EINVALID;
+	}
+
+	vmm_snprintf(name, sizeof(name), "vfsmap_%"PRIPADDR, pa);
+	rc = vmm_guest_add_region(guest, guest->aspace.node, name,
+				  VMM_DEVTREE_DEVICE_TYPE_VAL_ROM,
+				  VMM_DEVTREE_MANIFEST_TYPE_VAL_REAL,
+				  VMM_DEVTREE_ADDRESS_TYPE_VAL_MEMORY,
+				  NULL, 0, pa, hpa,
+				  VMM_ROUNDUP2_PAGE_SIZE(len), 0, NULL);
+	if (rc) {
+		vmm_cprintf(cdev, "Failed to add region %s (error %d)\n",
+			    name, rc);
+		return rc;
+	}
+
+	vmm_cprintf(cdev, "%s: Mapped 0x%"PRIPADDR" to 0x%"PRIPADDR
+			  " with %u bytes\n", guest->name, pa, hpa, len);
+
+	return VMM_OK;
+}
+
 static int cmd_vfs_exec(struct vmm_chardev *cdev, int argc, char **argv)
 {
 	u32 off, len;
@@ -1205,6 +1498,12 @@ static int cmd_vfs_exec(struct vmm_chardev *cdev, int argc, char **argv)
 			long wait = strtol(argv[4], NULL, 10);
 			return cmd_vfs_mount(cdev, argv[2], argv[3], &wait);
 		}
+	} else if ((strcmp(argv[1], "mount_bg") == 0) &&
+		   ((argc == 4) || (argc == 5))) {
+		len = (argc == 5) ? strtoul(argv[4], NULL, 10) : 0;
+		return vfs_mount_async(argv[3], NULL, argv[2], MOUNT_RW, len);
+	} else if ((strcmp(argv[1], "mount_wait") == 0) && (argc == 2)) {
+		return vfs_mount_async_wait();
 	} else if ((strcmp(argv[1], "umount") == 0) && (argc == 3)) {
 		return cmd_vfs_umount(cdev, argv[2]);
 	} else if ((strcmp(argv[1], "ls") == 0) && (argc == 3)) {
@@ -1238,9 +1537,16 @@ static int cmd_vfs_exec(struct vmm_chardev *cdev, int argc, char **argv)
 		pa = (physical_addr_t)strtoull(argv[2], NULL, 0);
 		off = (argc > 4) ? strtoul(argv[4], NULL, 0) : 0;
 		len = (argc > 5) ? strtoul(argv[5], NULL, 0) : 0xFFFFFFFF;
-		return cmd_vfs_load(cdev, NULL, pa, argv[3], off, len);
+		return cmd_vfs_load(cdev, NULL, pa, argv[3], off, len, NULL);
 	} else if ((strcmp(argv[1], "host_load_list") == 0) && (argc == 3)) {
 		return cmd_vfs_load_list(cdev, NULL, argv[2]);
+#if CONFIG_CRYPTO_HASH_SHA256
+	} else if ((strcmp(argv[1], "host_load_verify") == 0) && (argc > 4)) {
+		pa = (physical_addr_t)strtoull(argv[2], NULL, 0);
+		off = (argc > 5) ? strtoul(argv[5], NULL, 0) : 0;
+		len = (argc > 6) ? strtoul(argv[6], NULL, 0) : 0xFFFFFFFF;
+		return cmd_vfs_load(cdev, NULL, pa, argv[3], off, len, argv[4]);
+#endif
 	} else if ((strcmp(argv[1], "guest_load") == 0) && (argc > 4)) {
 		guest = vmm_manager_guest_find(argv[2]);
 		if (!guest) {
@@ -1251,7 +1557,21 @@ static int cmd_vfs_exec(struct vmm_chardev *cdev, int argc, char **argv)
 		pa = (physical_addr_t)strtoull(argv[3], NULL, 0);
 		off = (argc > 5) ? strtoul(argv[5], NULL, 0) : 0;
 		len = (argc > 6) ? strtoul(argv[6], NULL, 0) : 0xFFFFFFFF;
-		return cmd_vfs_load(cdev, guest, pa, argv[4], off, len);
+		return cmd_vfs_load(cdev, guest, pa, argv[4], off, len, NULL);
+#if CONFIG_CRYPTO_HASH_SHA256
+	} else if ((strcmp(argv[1], "guest_load_verify") == 0) && (argc > 5)) {
+		guest = vmm_manager_guest_find(argv[2]);
+		if (!guest) {
+			vmm_cprintf(cdev, "Failed to find guest %s\n",
+				    argv[2]);
+			return VMM_ENOTAVAIL;
+		}
+		pa = (physical_addr_t)strtoull(argv[3], NULL, 0);
+		off = (argc > 6) ? strtoul(argv[6], NULL, 0) : 0;
+		len = (argc > 7) ? strtoul(argv[7], NULL, 0) : 0xFFFFFFFF;
+		return cmd_vfs_load(cdev, guest, pa, argv[4], off, len,
+				    argv[5]);
+#endif
 	} else if ((strcmp(argv[1], "guest_load_list") == 0) && (argc == 4)) {
 		guest = vmm_manager_guest_find(argv[2]);
 		if (!guest) {
@@ -1260,6 +1580,17 @@ static int cmd_vfs_exec(struct vmm_chardev *cdev, int argc, char **argv)
 			return VMM_ENOTAVAIL;
 		}
 		return cmd_vfs_load_list(cdev, guest, argv[3]);
+	} else if ((strcmp(argv[1], "guest_map") == 0) && (argc > 4)) {
+		guest = vmm_manager_guest_find(argv[2]);
+		if (!guest) {
+			vmm_cprintf(cdev, "Failed to find guest %s\n",
+				    argv[2]);
+			return VMM_ENOTAVAIL;
+		}
+		pa = (physical_addr_t)strtoull(argv[3], NULL, 0);
+		off = (argc > 5) ? strtoul(argv[5], NULL, 0) : 0;
+		len = (argc > 6) ? strtoul(argv[6], NULL, 0) : 0xFFFFFFFF;
+		return cmd_vfs_map(cdev, guest, pa, argv[4], off, len);
 	}
 	cmd_vfs_usage(cdev);
 	return VMM_EFAIL;
@@ -109,20 +109,22 @@ static int cmd_vinput_keyboard_event(struct vmm_chardev *cdev,
 	for (k = 0; k < keyc; k++) {
 		keycode = strtoul(keyv[k], NULL, 0);
 		if (keycode & SCANCODE_GREY) {
-			vmm_vkeyboard_event(vk, SCANCODE_EMUL0);
+			vmm_vkeyboard_report(vk, SCANCODE_EMUL0);
 		}
-		vmm_vkeyboard_event(vk, keycode & SCANCODE_KEYCODEMASK);
+		vmm_vkeyboard_report(vk, keycode & SCANCODE_KEYCODEMASK);
 	}
+	vmm_vkeyboard_sync(vk);
 
 
 	/* Release the Keys (or Key Up) */
 	for (k = keyc - 1; 0 <= k; k--) {
 		keycode = strtoul(keyv[k], NULL, 0);
 		if (keycode & SCANCODE_GREY) {
-			vmm_vkeyboard_event(vk, SCANCODE_EMUL0);
+			vmm_vkeyboard_report(vk, SCANCODE_EMUL0);
 		}
-		vmm_vkeyboard_event(vk, keycode | SCANCODE_UP);
+		vmm_vkeyboard_report(vk, keycode | SCANCODE_UP);
 	}
+	vmm_vkeyboard_sync(vk);
 
 	return VMM_OK;
 }
@@ -0,0 +1,128 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cmd_vmem.c
+ * @author agent (agent@local)
+ * @brief Implementation of vmem command
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <libs/stringlib.h>
+#include <emu/virtio_mem.h>
+
+#define MODULE_DESC			"Command vmem"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			cmd_vmem_init
+#define	MODULE_EXIT			cmd_vmem_exit
+
+static void cmd_vmem_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   vmem help\n");
+	vmm_cprintf(cdev, "   vmem info <guest_name>/<dev_name>\n");
+	vmm_cprintf(cdev, "   vmem target <guest_name>/<dev_name> "
+			  "<size_in_MB>\n");
+	vmm_cprintf(cdev, "Note:\n");
+	vmm_cprintf(cdev, "   Target is the memory guest should have "
+			  "plugged (rounded up to block size)\n");
+}
+
+static int cmd_vmem_info(struct vmm_chardev *cdev, const char *name)
+{
+	int rc;
+	struct virtio_mem_info info;
+
+	if ((rc = virtio_mem_get_info(name, &info))) {
+		vmm_cprintf(cdev, "Failed to find mem device %s\n", name);
+		return rc;
+	}
+
+	vmm_cprintf(cdev, "Region         : 0x%"PRIx64" - 0x%"PRIx64"\n",
+		    info.addr, info.addr + info.region_size);
+	vmm_cprintf(cdev, "Block size     : %"PRIu64" KB\n",
+		    info.block_size >> 10);
+	vmm_cprintf(cdev, "Target         : %"PRIu64" MB\n",
+		    info.requested_size >> 20);
+	vmm_cprintf(cdev, "Plugged        : %"PRIu64" MB\n",
+		    info.plugged_size >> 20);
+	vmm_cprintf(cdev, "Plug requests  : %"PRIu64"\n", info.plug_count);
+	vmm_cprintf(cdev, "Unplug requests: %"PRIu64"\n", info.unplug_count);
+	vmm_cprintf(cdev, "Nacked requests: %"PRIu64"\n", info.nack_count);
+	vmm_cprintf(cdev, "Failed requests: %"PRIu64"\n", info.error_count);
+
+	return VMM_OK;
+}
+
+static int cmd_vmem_target(struct vmm_chardev *cdev,
+			   const char *name, const char *size)
+{
+	int rc;
+	u64 mb = (u64)atoi(size);
+
+	if ((rc = virtio_mem_set_requested(name, mb << 20))) {
+		vmm_cprintf(cdev, "Failed to set target of %s (error %d)\n",
+			    name, rc);
+	}
+
+	return rc;
+}
+
+static int cmd_vmem_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	if ((argc == 2) && (strcmp(argv[1], "help") == 0)) {
+		cmd_vmem_usage(cdev);
+		return VMM_OK;
+	} else if ((argc == 3) && (strcmp(argv[1], "info") == 0)) {
+		return cmd_vmem_info(cdev, argv[2]);
+	} else if ((argc == 4) && (strcmp(argv[1], "target") == 0)) {
+		return cmd_vmem_target(cdev, argv[2], argv[3]);
+	}
+
+	cmd_vmem_usage(cdev);
+
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_vmem = {
+	.name = "vmem",
+	.desc = "virtio memory device control",
+	.usage = cmd_vmem_usage,
+	.exec = cmd_vmem_exec,
+};
+
+static int __init cmd_vmem_init(void)
+{
+	return vmm_cmdmgr_register_cmd(&cmd_vmem);
+}
+
+static void __exit cmd_vmem_exit(void)
+{
+	vmm_cmdmgr_unregister_cmd(&cmd_vmem);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+		   MODULE_AUTHOR,
+		   MODULE_LICENSE,
+		   MODULE_IPRIORITY,
+		   MODULE_INIT,
+		   MODULE_EXIT);
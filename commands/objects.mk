@@ -38,12 +38,18 @@ commands-objs-$(CONFIG_CMD_HEAP)+= cmd_heap.o
 commands-objs-$(CONFIG_CMD_WALLCLOCK)+= cmd_wallclock.o
 commands-objs-$(CONFIG_CMD_MODULE)+= cmd_module.o
 commands-objs-$(CONFIG_CMD_PROFILE)+= cmd_profile.o
+commands-objs-$(CONFIG_CMD_LOCKSTAT)+= cmd_lockstat.o
+commands-objs-$(CONFIG_CMD_TRACE)+= cmd_trace.o
+commands-objs-$(CONFIG_CMD_SNAPSHOT)+= cmd_snapshot.o
 
 commands-objs-$(CONFIG_CMD_VSERIAL)+= cmd_vserial.o
 commands-objs-$(CONFIG_CMD_VDISK)+= cmd_vdisk.o
 commands-objs-$(CONFIG_CMD_VDISPLAY)+= cmd_vdisplay.o
 commands-objs-$(CONFIG_CMD_VINPUT)+= cmd_vinput.o
 commands-objs-$(CONFIG_CMD_VSCREEN)+= cmd_vscreen.o
+commands-objs-$(CONFIG_CMD_VBENCH)+= cmd_vbench.o
+commands-objs-$(CONFIG_CMD_VBALLOON)+= cmd_vballoon.o
+commands-objs-$(CONFIG_CMD_VMEM)+= cmd_vmem.o
 
 commands-objs-$(CONFIG_CMD_RTCDEV)+= cmd_rtcdev.o
 commands-objs-$(CONFIG_CMD_INPUT)+= cmd_input.o
@@ -51,13 +57,17 @@ commands-objs-$(CONFIG_CMD_FB)+= cmd_fb.o
 commands-objs-$(CONFIG_CMD_FB_BACKLIGHT)+= cmd_backlight.o
 commands-objs-$(CONFIG_CMD_BLOCKDEV)+= cmd_blockdev.o
 commands-objs-$(CONFIG_CMD_RBD)+= cmd_rbd.o
+commands-objs-$(CONFIG_CMD_COWBD)+= cmd_cowbd.o
+commands-objs-$(CONFIG_CMD_NBD)+= cmd_nbd.o
 commands-objs-$(CONFIG_CMD_FLASH)+= cmd_flash.o
 commands-objs-$(CONFIG_CMD_I2C)+= cmd_i2c.o
 
 commands-objs-$(CONFIG_CMD_NET)+= cmd_net.o
 commands-objs-$(CONFIG_CMD_IPCONFIG)+= cmd_ipconfig.o
 commands-objs-$(CONFIG_CMD_PING)+= cmd_ping.o
+commands-objs-$(CONFIG_CMD_MIGRATE)+= cmd_migrate.o
 commands-objs-$(CONFIG_CMD_MII)+= cmd_mii.o
+commands-objs-$(CONFIG_CMD_ETHTOOL)+= cmd_ethtool.o
 
 commands-objs-$(CONFIG_CMD_VSDAEMON)+= cmd_vsdaemon.o
 commands-objs-$(CONFIG_CMD_VFS)+= cmd_vfs.o
@@ -25,6 +25,7 @@ core-objs-$(CONFIG_BLOCK)+= block/vmm_blockdev_mod.o
 
 vmm_blockdev_mod-y += vmm_blockdev.o
 vmm_blockdev_mod-y += vmm_blockrq_nop.o
+vmm_blockdev_mod-$(CONFIG_BLOCK_CACHE) += vmm_blockcache.o
 
 %/vmm_blockdev_mod.o: $(foreach obj,$(vmm_blockdev_mod-y),%/$(obj))
 	$(call merge_objs,$@,$^)
@@ -34,4 +35,4 @@ vmm_blockdev_mod-y += vmm_blockrq_nop.o
 
 core-objs-$(CONFIG_BLOCKPART)+= block/vmm_blockpart.o
 core-objs-$(CONFIG_BLOCKPART_DOS)+= block/vmm_blockpart_dos.o
-
+core-objs-$(CONFIG_BLOCKPART_GPT)+= block/vmm_blockpart_gpt.o
@@ -0,0 +1,558 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_blockcache.c
+ * @author agent (agent@local)
+ * @brief Block device page cache implementation
+ *
+ * Each cache page holds VMM_PAGE_SIZE bytes of block device contents.
+ * Pages are only filled from reads which cover them completely and
+ * a fill is dropped if any write was submitted while the read was
+ * in-flight, so that a stale read never overwrites newer data.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_spinlocks.h>
+#include <vmm_modules.h>
+#include <vmm_host_aspace.h>
+#include <block/vmm_blockcache.h>
+#include <libs/log2.h>
+#include <libs/stringlib.h>
+
+#define BLOCKCACHE_PAGE_DIRTY		0x1
+#define BLOCKCACHE_PAGE_WRITEBACK	0x2
+
+struct blockcache_page {
+	struct dlist head; /* LRU list or free list */
+	struct dlist hash_head;
+	u64 index;
+	u32 flags;
+	void *data;
+};
+
+struct blockcache_wb {
+	struct vmm_request r;
+	struct vmm_blockcache *cache;
+	struct blockcache_page *page;
+	u8 data[VMM_PAGE_SIZE];
+};
+
+struct vmm_blockcache {
+	vmm_spinlock_t lock;
+	struct vmm_blockdev *bdev;
+	enum vmm_blockcache_mode mode;
+	u32 block_size;
+	u32 page_shift; /* log2 of blocks per cache page */
+	u32 seq; /* Incremented upon every write */
+	u32 inflight; /* Reads and writebacks in-flight */
+	u64 hits;
+	u64 misses;
+	u32 page_count;
+	u32 used_count;
+	u32 dirty_count;
+	struct blockcache_page *pages;
+	virtual_addr_t data_va;
+	struct dlist free_list;
+	struct dlist lru_list; /* Most recently used first */
+	u32 hash_mask;
+	struct dlist *hash;
+};
+
+static struct blockcache_page *blockcache_find(struct vmm_blockcache *cache,
+					       u64 index)
+{
+	struct blockcache_page *p;
+	struct dlist *bucket = &cache->hash[(u32)index & cache->hash_mask];
+
+	list_for_each_entry(p, bucket, hash_head) {
+		if (p->index == index) {
+			return p;
+		}
+	}
+
+	return NULL;
+}
+
+static void blockcache_touch(struct vmm_blockcache *cache,
+			     struct blockcache_page *p)
+{
+	list_del(&p->head);
+	list_add(&p->head, &cache->lru_list);
+}
+
+/* Get unused page or evict least recently used clean page */
+static struct blockcache_page *blockcache_alloc(struct vmm_blockcache *cache,
+						u64 index)
+{
+	struct blockcache_page *p = NULL, *t;
+
+	if (!list_empty(&cache->free_list)) {
+		p = list_first_entry(&cache->free_list,
+				     struct blockcache_page, head);
+		cache->used_count++;
+	} else {
+		list_for_each_entry_reverse(t, &cache->lru_list, head) {
+			if (!(t->flags & (BLOCKCACHE_PAGE_DIRTY |
+					  BLOCKCACHE_PAGE_WRITEBACK))) {
+				p = t;
+				break;
+			}
+		}
+		if (!p) {
+			return NULL;
+		}
+		list_del(&p->hash_head);
+	}
+
+	list_del(&p->head);
+	list_add(&p->head, &cache->lru_list);
+	p->index = index;
+	p->flags = 0;
+	list_add(&p->hash_head,
+		 &cache->hash[(u32)index & cache->hash_mask]);
+
+	return p;
+}
+
+/* Compute byte range of request overlapping with given cache page */
+static void blockcache_overlap(struct vmm_blockcache *cache,
+			       struct vmm_request *r, u64 index,
+			       u32 *page_off, u32 *req_off, u32 *len)
+{
+	u64 pstart = index << cache->page_shift;
+	u64 pend = pstart + (1ULL << cache->page_shift);
+	u64 start = (r->lba < pstart) ? pstart : r->lba;
+	u64 end = ((r->lba + r->bcnt) < pend) ? (r->lba + r->bcnt) : pend;
+
+	*page_off = (u32)(start - pstart) * cache->block_size;
+	*req_off = (u32)(start - r->lba) * cache->block_size;
+	*len = (u32)(end - start) * cache->block_size;
+}
+
+bool vmm_blockcache_read(struct vmm_blockcache *cache,
+			 struct vmm_request *r)
+{
+	u64 i, first, last;
+	u32 page_off, req_off, len;
+	irq_flags_t flags;
+	struct blockcache_page *p;
+
+	if (!cache || !r || !r->data || !r->bcnt) {
+		return FALSE;
+	}
+
+	first = r->lba >> cache->page_shift;
+	last = (r->lba + r->bcnt - 1) >> cache->page_shift;
+
+	vmm_spin_lock_irqsave_lite(&cache->lock, flags);
+
+	for (i = first; i <= last; i++) {
+		if (!blockcache_find(cache, i)) {
+			cache->misses++;
+			vmm_spin_unlock_irqrestore_lite(&cache->lock, flags);
+			return FALSE;
+		}
+	}
+
+	for (i = first; i <= last; i++) {
+		p = blockcache_find(cache, i);
+		blockcache_overlap(cache, r, i, &page_off, &req_off, &len);
+		memcpy(r->data + req_off, p->data + page_off, len);
+		blockcache_touch(cache, p);
+	}
+	cache->hits++;
+
+	vmm_spin_unlock_irqrestore_lite(&cache->lock, flags);
+
+	return TRUE;
+}
+
+bool vmm_blockcache_write(struct vmm_blockcache *cache,
+			  struct vmm_request *r)
+{
+	bool absorb;
+	u64 i, first, last;
+	u32 page_off, req_off, len;
+	irq_flags_t flags;
+	struct blockcache_page *p;
+
+	if (!cache || !r || !r->data || !r->bcnt) {
+		return FALSE;
+	}
+
+	first = r->lba >> cache->page_shift;
+	last = (r->lba + r->bcnt - 1) >> cache->page_shift;
+
+	vmm_spin_lock_irqsave_lite(&cache->lock, flags);
+
+	cache->seq++;
+
+	/* Write-back cache can only absorb write if every page touched
+	 * is either cached or completely overwritten.
+	 */
+	absorb = (cache->mode == VMM_BLOCKCACHE_WRITEBACK) ? TRUE : FALSE;
+	for (i = first; absorb && (i <= last); i++) {
+		blockcache_overlap(cache, r, i, &page_off, &req_off, &len);
+		if ((len != VMM_PAGE_SIZE) && !blockcache_find(cache, i)) {
+			absorb = FALSE;
+		}
+	}
+
+	for (i = first; i <= last; i++) {
+		blockcache_overlap(cache, r, i, &page_off, &req_off, &len);
+		p = blockcache_find(cache, i);
+		if (!p && absorb) {
+			p = blockcache_alloc(cache, i);
+			if (!p) {
+				absorb = FALSE;
+			}
+		}
+		if (!p) {
+			continue;
+		}
+		memcpy(p->data + page_off, r->data + req_off, len);
+		blockcache_touch(cache, p);
+	}
+
+	for (i = first; absorb && (i <= last); i++) {
+		p = blockcache_find(cache, i);
+		if (!(p->flags & BLOCKCACHE_PAGE_DIRTY)) {
+			p->flags |= BLOCKCACHE_PAGE_DIRTY;
+			cache->dirty_count++;
+		}
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&cache->lock, flags);
+
+	return absorb;
+}
+
+u32 vmm_blockcache_get(struct vmm_blockcache *cache)
+{
+	u32 ret;
+	irq_flags_t flags;
+
+	if (!cache) {
+		return 0;
+	}
+
+	vmm_spin_lock_irqsave_lite(&cache->lock, flags);
+	cache->inflight++;
+	ret = cache->seq;
+	vmm_spin_unlock_irqrestore_lite(&cache->lock, flags);
+
+	return ret;
+}
+
+void vmm_blockcache_fill(struct vmm_blockcache *cache, u32 cookie,
+			 struct vmm_request *r, bool failed)
+{
+	u64 i, first, last;
+	u32 page_off, req_off, len;
+	irq_flags_t flags;
+	struct blockcache_page *p;
+
+	if (!cache || !r) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&cache->lock, flags);
+
+	cache->inflight--;
+
+	if (failed || (cookie != cache->seq) ||
+	    (r->type != VMM_REQUEST_READ) || !r->data || !r->bcnt) {
+		goto done;
+	}
+
+	first = r->lba >> cache->page_shift;
+	last = (r->lba + r->bcnt - 1) >> cache->page_shift;
+	for (i = first; i <= last; i++) {
+		blockcache_overlap(cache, r, i, &page_off, &req_off, &len);
+		if ((len != VMM_PAGE_SIZE) || blockcache_find(cache, i)) {
+			continue;
+		}
+		p = blockcache_alloc(cache, i);
+		if (!p) {
+			break;
+		}
+		memcpy(p->data, r->data + req_off, len);
+	}
+
+done:
+	vmm_spin_unlock_irqrestore_lite(&cache->lock, flags);
+}
+
+static void blockcache_wb_done(struct vmm_request *r, bool failed)
+{
+	irq_flags_t flags;
+	struct blockcache_wb *wb = r->priv;
+	struct vmm_blockcache *cache = wb->cache;
+	struct blockcache_page *p = wb->page;
+
+	vmm_spin_lock_irqsave_lite(&cache->lock, flags);
+	p->flags &= ~BLOCKCACHE_PAGE_WRITEBACK;
+	if (failed && !(p->flags & BLOCKCACHE_PAGE_DIRTY)) {
+		p->flags |= BLOCKCACHE_PAGE_DIRTY;
+		cache->dirty_count++;
+	}
+	cache->inflight--;
+	vmm_spin_unlock_irqrestore_lite(&cache->lock, flags);
+
+	vmm_free(wb);
+}
+
+static void blockcache_wb_completed(struct vmm_request *r)
+{
+	blockcache_wb_done(r, FALSE);
+}
+
+static void blockcache_wb_failed(struct vmm_request *r)
+{
+	blockcache_wb_done(r, TRUE);
+}
+
+void vmm_blockcache_writeback(struct vmm_blockcache *cache, bool all,
+			      struct dlist *reqs)
+{
+	irq_flags_t flags;
+	struct blockcache_wb *wb;
+	struct blockcache_page *p;
+
+	if (!cache || !reqs) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&cache->lock, flags);
+
+	if (!all && (cache->dirty_count <= (cache->page_count / 2))) {
+		goto done;
+	}
+
+	list_for_each_entry(p, &cache->lru_list, head) {
+		if (!(p->flags & BLOCKCACHE_PAGE_DIRTY) ||
+		    (p->flags & BLOCKCACHE_PAGE_WRITEBACK)) {
+			continue;
+		}
+
+		wb = vmm_malloc(sizeof(*wb));
+		if (!wb) {
+			break;
+		}
+		memcpy(wb->data, p->data, VMM_PAGE_SIZE);
+		wb->cache = cache;
+		wb->page = p;
+		p->flags &= ~BLOCKCACHE_PAGE_DIRTY;
+		p->flags |= BLOCKCACHE_PAGE_WRITEBACK;
+		cache->dirty_count--;
+		cache->inflight++;
+
+		wb->r.bdev = cache->bdev;
+		wb->r.type = VMM_REQUEST_WRITE;
+		wb->r.lba = p->index << cache->page_shift;
+		wb->r.bcnt = 1 << cache->page_shift;
+		wb->r.data = wb->data;
+		wb->r.sg = NULL;
+		wb->r.sg_count = 0;
+		wb->r.bounce = NULL;
+		wb->r.merged = NULL;
+		wb->r.completed = blockcache_wb_completed;
+		wb->r.failed = blockcache_wb_failed;
+		wb->r.priv = wb;
+		list_add_tail(&wb->r.head, reqs);
+	}
+
+done:
+	vmm_spin_unlock_irqrestore_lite(&cache->lock, flags);
+}
+
+static struct vmm_blockdev *blockcache_root(struct vmm_blockdev *bdev)
+{
+	while (bdev && bdev->parent) {
+		bdev = bdev->parent;
+	}
+
+	return bdev;
+}
+
+static void blockcache_free(struct vmm_blockcache *cache)
+{
+	if (cache->data_va) {
+		vmm_host_free_pages(cache->data_va, cache->page_count);
+	}
+	if (cache->hash) {
+		vmm_free(cache->hash);
+	}
+	if (cache->pages) {
+		vmm_free(cache->pages);
+	}
+	vmm_free(cache);
+}
+
+int vmm_blockcache_enable(struct vmm_blockdev *bdev, u32 size_kb,
+			  enum vmm_blockcache_mode mode)
+{
+	u32 i, page_count, hash_size;
+	irq_flags_t flags;
+	struct vmm_blockcache *cache;
+
+	bdev = blockcache_root(bdev);
+	if (!bdev || !bdev->rq) {
+		return VMM_EINVALID;
+	}
+	if (!bdev->block_size || (VMM_PAGE_SIZE < bdev->block_size) ||
+	    !is_power_of_2(bdev->block_size)) {
+		return VMM_ENOTSUPP;
+	}
+	if ((mode != VMM_BLOCKCACHE_WRITETHROUGH) &&
+	    (mode != VMM_BLOCKCACHE_WRITEBACK)) {
+		return VMM_EINVALID;
+	}
+	if ((mode == VMM_BLOCKCACHE_WRITEBACK) &&
+	    !(bdev->flags & VMM_BLOCKDEV_RW)) {
+		return VMM_EINVALID;
+	}
+
+	page_count = VMM_SIZE_TO_PAGE(size_kb * 1024);
+	if (!page_count) {
+		return VMM_EINVALID;
+	}
+
+	cache = vmm_zalloc(sizeof(*cache));
+	if (!cache) {
+		return VMM_ENOMEM;
+	}
+	INIT_SPIN_LOCK(&cache->lock);
+	cache->bdev = bdev;
+	cache->mode = mode;
+	cache->block_size = bdev->block_size;
+	cache->page_shift = ilog2(VMM_PAGE_SIZE / bdev->block_size);
+	cache->page_count = page_count;
+	INIT_LIST_HEAD(&cache->free_list);
+	INIT_LIST_HEAD(&cache->lru_list);
+
+	hash_size = roundup_pow_of_two((page_count / 2) ? page_count / 2 : 1);
+	cache->hash_mask = hash_size - 1;
+	cache->hash = vmm_malloc(hash_size * sizeof(*cache->hash));
+	cache->pages = vmm_zalloc(page_count * sizeof(*cache->pages));
+	cache->data_va = vmm_host_alloc_pages(page_count,
+					      VMM_MEMORY_FLAGS_NORMAL);
+	if (!cache->hash || !cache->pages || !cache->data_va) {
+		blockcache_free(cache);
+		return VMM_ENOMEM;
+	}
+
+	for (i = 0; i < hash_size; i++) {
+		INIT_LIST_HEAD(&cache->hash[i]);
+	}
+	for (i = 0; i < page_count; i++) {
+		INIT_LIST_HEAD(&cache->pages[i].hash_head);
+		cache->pages[i].data =
+			(void *)(cache->data_va + i * VMM_PAGE_SIZE);
+		list_add_tail(&cache->pages[i].head, &cache->free_list);
+	}
+
+	vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
+	if (bdev->rq->cache) {
+		vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+		blockcache_free(cache);
+		return VMM_EEXIST;
+	}
+	bdev->rq->cache = cache;
+	vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_blockcache_enable);
+
+int vmm_blockcache_disable(struct vmm_blockdev *bdev)
+{
+	bool busy;
+	irq_flags_t flags, cflags;
+	struct vmm_blockcache *cache;
+
+	bdev = blockcache_root(bdev);
+	if (!bdev || !bdev->rq) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
+
+	cache = bdev->rq->cache;
+	if (!cache) {
+		vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+		return VMM_ENOTAVAIL;
+	}
+
+	vmm_spin_lock_irqsave_lite(&cache->lock, cflags);
+	busy = (cache->dirty_count || cache->inflight) ? TRUE : FALSE;
+	vmm_spin_unlock_irqrestore_lite(&cache->lock, cflags);
+
+	if (!busy) {
+		bdev->rq->cache = NULL;
+	}
+
+	vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+
+	if (busy) {
+		/* Flush starts writeback of dirty pages */
+		vmm_blockdev_flush_cache(bdev);
+		return VMM_EBUSY;
+	}
+
+	blockcache_free(cache);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_blockcache_disable);
+
+int vmm_blockcache_get_stats(struct vmm_blockdev *bdev,
+			     struct vmm_blockcache_stats *stats)
+{
+	irq_flags_t flags, cflags;
+	struct vmm_blockcache *cache;
+
+	bdev = blockcache_root(bdev);
+	if (!bdev || !bdev->rq || !stats) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
+
+	cache = bdev->rq->cache;
+	if (!cache) {
+		vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+		return VMM_ENOTAVAIL;
+	}
+
+	vmm_spin_lock_irqsave_lite(&cache->lock, cflags);
+	stats->mode = cache->mode;
+	stats->page_count = cache->page_count;
+	stats->used_count = cache->used_count;
+	stats->dirty_count = cache->dirty_count;
+	stats->hits = cache->hits;
+	stats->misses = cache->misses;
+	vmm_spin_unlock_irqrestore_lite(&cache->lock, cflags);
+
+	vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_blockcache_get_stats);
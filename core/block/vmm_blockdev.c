@@ -27,8 +27,11 @@
 #include <vmm_modules.h>
 #include <vmm_scheduler.h>
 #include <vmm_devdrv.h>
+#include <vmm_host_aspace.h>
 #include <vmm_completion.h>
+#include <vmm_trace.h>
 #include <block/vmm_blockdev.h>
+#include <block/vmm_blockcache.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
 
@@ -53,16 +56,81 @@ int vmm_blockdev_unregister_client(struct vmm_notifier_block *nb)
 }
 VMM_EXPORT_SYMBOL(vmm_blockdev_unregister_client);
 
+u32 vmm_blockdev_sg_copy(struct vmm_request *r, void *buf, u32 len,
+			 bool to_sg)
+{
+	u32 i, pos = 0, l;
+
+	if (!r || !buf) {
+		return 0;
+	}
+
+	for (i = 0; (i < r->sg_count) && (pos < len); i++) {
+		l = ((len - pos) < r->sg[i].len) ? (len - pos) : r->sg[i].len;
+		if (to_sg) {
+			l = vmm_host_memory_write(r->sg[i].addr,
+						  buf + pos, l, TRUE);
+		} else {
+			l = vmm_host_memory_read(r->sg[i].addr,
+						 buf + pos, l, TRUE);
+		}
+		if (!l) {
+			break;
+		}
+		pos += l;
+	}
+
+	return pos;
+}
+VMM_EXPORT_SYMBOL(vmm_blockdev_sg_copy);
+
+static int blockdev_bounce_alloc(struct vmm_blockdev *bdev,
+				 struct vmm_request *r)
+{
+	u32 len = r->bcnt * bdev->block_size;
+
+	r->bounce = vmm_malloc(len);
+	if (!r->bounce) {
+		return VMM_ENOMEM;
+	}
+
+	if (r->type == VMM_REQUEST_WRITE) {
+		vmm_blockdev_sg_copy(r, r->bounce, len, FALSE);
+	}
+	r->data = r->bounce;
+
+	return VMM_OK;
+}
+
+static void blockdev_bounce_free(struct vmm_request *r, bool copy)
+{
+	if (!r->bounce) {
+		return;
+	}
+
+	if (copy && r->bdev && (r->type == VMM_REQUEST_READ)) {
+		vmm_blockdev_sg_copy(r, r->bounce,
+				     r->bcnt * r->bdev->block_size, TRUE);
+	}
+
+	vmm_free(r->bounce);
+	r->bounce = NULL;
+	r->data = NULL;
+}
+
 int vmm_blockdev_complete_request(struct vmm_request *r)
 {
 	if (!r) {
 		return VMM_EFAIL;
 	}
 
+	vmm_trace(BLOCKDEV_COMPLETE, (virtual_addr_t)r, 0, 0, 0);
+	blockdev_bounce_free(r, TRUE);
+
+	r->bdev = NULL;
 	if (r->completed) {
 		r->completed(r);
 	}
-	r->bdev = NULL;
 
 	return VMM_OK;
 }
@@ -74,22 +142,372 @@ int vmm_blockdev_fail_request(struct vmm_request *r)
 		return VMM_EFAIL;
 	}
 
+	vmm_trace(BLOCKDEV_COMPLETE, (virtual_addr_t)r, 1, 0, 0);
+	if (r->bdev) {
+		vmm_percpu_counter_inc(&r->bdev->stat_failed_reqs);
+	}
+	blockdev_bounce_free(r, FALSE);
+
+	r->bdev = NULL;
 	if (r->failed) {
 		r->failed(r);
 	}
-	r->bdev = NULL;
 
 	return VMM_OK;
 }
 VMM_EXPORT_SYMBOL(vmm_blockdev_fail_request);
 
+/* Request carrying one or more other requests. It is either a merge of
+ * adjacent plugged requests with its own data buffer or a page cache
+ * miss sharing data buffer of the carried request.
+ */
+struct blockdev_merge {
+	struct vmm_request r;
+	struct vmm_request_queue *rq;
+	struct dlist reqs;
+	bool own_data;
+	struct vmm_blockcache *cache;
+	u32 cache_cookie;
+};
+
+static void blockdev_merge_done(struct vmm_request *r, bool failed)
+{
+	u32 off;
+	irq_flags_t flags;
+	struct vmm_request *cr;
+	struct blockdev_merge *m = r->priv;
+
+	if (m->cache) {
+		/* Data buffer is only valid while carried request
+		 * is not aborted.
+		 */
+		vmm_spin_lock_irqsave(&m->rq->merge_lock, flags);
+		vmm_blockcache_fill(m->cache, m->cache_cookie, r,
+				    failed || list_empty(&m->reqs));
+		vmm_spin_unlock_irqrestore(&m->rq->merge_lock, flags);
+	}
+
+	while (1) {
+		/* Detach next merged request which is not aborted */
+		vmm_spin_lock_irqsave(&m->rq->merge_lock, flags);
+		if (list_empty(&m->reqs)) {
+			vmm_spin_unlock_irqrestore(&m->rq->merge_lock, flags);
+			break;
+		}
+		cr = list_first_entry(&m->reqs, struct vmm_request, head);
+		list_del_init(&cr->head);
+		cr->merged = NULL;
+		vmm_spin_unlock_irqrestore(&m->rq->merge_lock, flags);
+
+		if (failed) {
+			vmm_blockdev_fail_request(cr);
+			continue;
+		}
+		if (m->own_data && (cr->type == VMM_REQUEST_READ)) {
+			off = (cr->lba - r->lba) * cr->bdev->block_size;
+			memcpy(cr->data, r->data + off,
+			       cr->bcnt * cr->bdev->block_size);
+		}
+		vmm_blockdev_complete_request(cr);
+	}
+
+	if (m->own_data) {
+		vmm_free(r->data);
+	}
+	vmm_free(m);
+}
+
+static void blockdev_merge_completed(struct vmm_request *r)
+{
+	blockdev_merge_done(r, FALSE);
+}
+
+static void blockdev_merge_failed(struct vmm_request *r)
+{
+	blockdev_merge_done(r, TRUE);
+}
+
+/* Merge plugged requests from first up to last (inclusive) into
+ * one request. Returns NULL if merged request cannot be allocated.
+ * Note: Must be called with request queue lock held.
+ */
+static struct vmm_request *blockdev_merge_alloc(struct vmm_request_queue *rq,
+						struct vmm_request *first,
+						struct vmm_request *last)
+{
+	u32 off = 0, len;
+	struct blockdev_merge *m;
+	struct vmm_request *cr, *ncr;
+
+	m = vmm_zalloc(sizeof(*m));
+	if (!m) {
+		return NULL;
+	}
+
+	len = (last->lba + last->bcnt - first->lba) * first->bdev->block_size;
+	m->r.data = vmm_malloc(len);
+	if (!m->r.data) {
+		vmm_free(m);
+		return NULL;
+	}
+
+	m->rq = rq;
+	INIT_LIST_HEAD(&m->reqs);
+	m->own_data = TRUE;
+	m->cache = NULL;
+	m->r.bdev = first->bdev;
+	m->r.type = first->type;
+	m->r.lba = first->lba;
+	m->r.bcnt = last->lba + last->bcnt - first->lba;
+	m->r.sg = NULL;
+	m->r.sg_count = 0;
+	m->r.bounce = NULL;
+	INIT_LIST_HEAD(&m->r.head);
+	m->r.merged = NULL;
+	m->r.completed = blockdev_merge_completed;
+	m->r.failed = blockdev_merge_failed;
+	m->r.priv = m;
+
+	cr = first;
+	while (1) {
+		ncr = list_entry(cr->head.next, struct vmm_request, head);
+		len = cr->bcnt * cr->bdev->block_size;
+		if (cr->type == VMM_REQUEST_WRITE) {
+			memcpy(m->r.data + off, cr->data, len);
+		}
+		off += len;
+		list_del(&cr->head);
+		cr->merged = &m->r;
+		list_add_tail(&cr->head, &m->reqs);
+		if (cr == last) {
+			break;
+		}
+		cr = ncr;
+	}
+
+	return &m->r;
+}
+
+/* Allocate request carrying read request which missed page cache
+ * Note: Must be called with request queue lock held.
+ */
+static struct blockdev_merge *blockdev_carrier_alloc(
+					struct vmm_request_queue *rq,
+					struct vmm_request *r)
+{
+	struct blockdev_merge *m;
+
+	m = vmm_zalloc(sizeof(*m));
+	if (!m) {
+		return NULL;
+	}
+
+	m->rq = rq;
+	INIT_LIST_HEAD(&m->reqs);
+	m->own_data = FALSE;
+	m->cache = rq->cache;
+	m->cache_cookie = vmm_blockcache_get(rq->cache);
+	m->r.bdev = r->bdev;
+	m->r.type = r->type;
+	m->r.lba = r->lba;
+	m->r.bcnt = r->bcnt;
+	m->r.data = r->data;
+	m->r.sg = NULL;
+	m->r.sg_count = 0;
+	m->r.bounce = NULL;
+	INIT_LIST_HEAD(&m->r.head);
+	m->r.merged = NULL;
+	m->r.completed = blockdev_merge_completed;
+	m->r.failed = blockdev_merge_failed;
+	m->r.priv = m;
+
+	r->merged = &m->r;
+	list_add_tail(&r->head, &m->reqs);
+
+	return m;
+}
+
+/* Dispatch plugged requests to request queue in submission order
+ * while merging runs of adjacent requests of same type.
+ * Note: Must be called with request queue lock held.
+ */
+static void blockdev_dispatch_plugged(struct vmm_request_queue *rq)
+{
+	int rc;
+	u32 len, bsize;
+	struct vmm_request *first, *last, *next, *r;
+
+	while (!list_empty(&rq->plug_list)) {
+		first = list_first_entry(&rq->plug_list,
+					 struct vmm_request, head);
+		last = first;
+		bsize = first->bdev->block_size;
+		len = first->bcnt * bsize;
+
+		while ((rq->flags & VMM_REQUEST_QUEUE_MERGE) &&
+		       (last->head.next != &rq->plug_list)) {
+			next = list_entry(last->head.next,
+					  struct vmm_request, head);
+			if ((next->type != first->type) ||
+			    (next->lba != (last->lba + last->bcnt)) ||
+			    (next->bdev->block_size != bsize) ||
+			    (VMM_REQUEST_MERGE_MAX_SIZE <
+					(len + next->bcnt * bsize))) {
+				break;
+			}
+			len += next->bcnt * bsize;
+			last = next;
+		}
+
+		r = NULL;
+		if (first != last) {
+			r = blockdev_merge_alloc(rq, first, last);
+		}
+		if (!r) {
+			list_del_init(&first->head);
+			r = first;
+		}
+
+		rc = rq->make_request(rq, r);
+		if (rc) {
+			vmm_blockdev_fail_request(r);
+		}
+	}
+}
+
+/* Plug or dispatch request
+ * Note: Must be called with request queue lock held.
+ */
+static int blockdev_queue_request(struct vmm_request_queue *rq,
+				  struct vmm_request *r)
+{
+	if (rq->plug_count) {
+		list_add_tail(&r->head, &rq->plug_list);
+		return VMM_OK;
+	}
+
+	return rq->make_request(rq, r);
+}
+
+/* Plug or dispatch list of page cache writeback requests
+ * Note: Must be called with request queue lock held.
+ */
+static void blockdev_queue_list(struct vmm_request_queue *rq,
+				struct dlist *reqs)
+{
+	struct vmm_request *r;
+
+	while (!list_empty(reqs)) {
+		r = list_first_entry(reqs, struct vmm_request, head);
+		list_del_init(&r->head);
+		if (blockdev_queue_request(rq, r)) {
+			vmm_blockdev_fail_request(r);
+		}
+	}
+}
+
+/* Serve request from page cache or carry it to block device
+ * Note: Must be called with request queue lock held.
+ */
+static int blockdev_cache_request(struct vmm_request_queue *rq,
+				  struct vmm_request *r)
+{
+	int rc;
+	struct dlist wbreqs;
+	struct blockdev_merge *m;
+
+	if (r->sg_count && !r->data) {
+		rc = blockdev_bounce_alloc(r->bdev, r);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	if (r->type == VMM_REQUEST_READ) {
+		if (vmm_blockcache_read(rq->cache, r)) {
+			vmm_blockdev_complete_request(r);
+			return VMM_OK;
+		}
+
+		m = blockdev_carrier_alloc(rq, r);
+		if (!m) {
+			return blockdev_queue_request(rq, r);
+		}
+
+		rc = blockdev_queue_request(rq, &m->r);
+		if (rc) {
+			list_del_init(&r->head);
+			r->merged = NULL;
+			vmm_blockcache_fill(m->cache, m->cache_cookie,
+					    &m->r, TRUE);
+			vmm_free(m);
+		}
+
+		return rc;
+	}
+
+	if (vmm_blockcache_write(rq->cache, r)) {
+		vmm_blockdev_complete_request(r);
+		INIT_LIST_HEAD(&wbreqs);
+		vmm_blockcache_writeback(rq->cache, FALSE, &wbreqs);
+		blockdev_queue_list(rq, &wbreqs);
+		return VMM_OK;
+	}
+
+	return blockdev_queue_request(rq, r);
+}
+
+int vmm_blockdev_plug(struct vmm_blockdev *bdev)
+{
+	irq_flags_t flags;
+
+	if (!bdev || !bdev->rq) {
+		return VMM_EFAIL;
+	}
+
+	vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
+	bdev->rq->plug_count++;
+	vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_blockdev_plug);
+
+int vmm_blockdev_unplug(struct vmm_blockdev *bdev)
+{
+	irq_flags_t flags;
+
+	if (!bdev || !bdev->rq) {
+		return VMM_EFAIL;
+	}
+
+	vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
+	if (bdev->rq->plug_count) {
+		bdev->rq->plug_count--;
+		if (!bdev->rq->plug_count) {
+			blockdev_dispatch_plugged(bdev->rq);
+		}
+	}
+	vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_blockdev_unplug);
+
 int vmm_blockdev_submit_request(struct vmm_blockdev *bdev,
 				struct vmm_request *r)
 {
 	int rc;
 	irq_flags_t flags;
 
-	if (!bdev || !r || !bdev->rq) {
+	if (!r) {
+		return VMM_EFAIL;
+	}
+	r->bounce = NULL;
+	INIT_LIST_HEAD(&r->head);
+	r->merged = NULL;
+
+	if (!bdev || !bdev->rq) {
 		rc = VMM_EFAIL;
 		goto failed;
 	}
@@ -114,12 +532,34 @@ int vmm_blockdev_submit_request(struct vmm_blockdev *bdev,
 		goto failed;
 	}
 
+	vmm_trace(BLOCKDEV_SUBMIT, (virtual_addr_t)r,
+		  (r->type == VMM_REQUEST_WRITE) ? 1 : 0, r->lba, r->bcnt);
+	if (r->type == VMM_REQUEST_WRITE) {
+		vmm_percpu_counter_inc(&bdev->stat_write_reqs);
+		vmm_percpu_counter_add(&bdev->stat_write_blocks, r->bcnt);
+	} else {
+		vmm_percpu_counter_inc(&bdev->stat_read_reqs);
+		vmm_percpu_counter_add(&bdev->stat_read_blocks, r->bcnt);
+	}
+
+	if (r->sg_count && !(bdev->rq->flags & VMM_REQUEST_QUEUE_SG)) {
+		rc = blockdev_bounce_alloc(bdev, r);
+		if (rc) {
+			goto failed;
+		}
+	}
+
 	if (bdev->rq->make_request) {
 		r->bdev = bdev;
 		vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
-		rc = bdev->rq->make_request(bdev->rq, r);
+		if (bdev->rq->cache) {
+			rc = blockdev_cache_request(bdev->rq, r);
+		} else {
+			rc = blockdev_queue_request(bdev->rq, r);
+		}
 		vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
 		if (rc) {
+			blockdev_bounce_free(r, FALSE);
 			r->bdev = NULL;
 			return rc;
 		}
@@ -131,6 +571,9 @@ int vmm_blockdev_submit_request(struct vmm_blockdev *bdev,
 	return VMM_OK;
 
 failed:
+	if (bdev) {
+		vmm_percpu_counter_inc(&bdev->stat_failed_reqs);
+	}
 	vmm_blockdev_fail_request(r);
 	return rc;
 }
@@ -139,7 +582,8 @@ VMM_EXPORT_SYMBOL(vmm_blockdev_submit_request);
 int vmm_blockdev_abort_request(struct vmm_request *r)
 {
 	int rc;
-	irq_flags_t flags;
+	bool found = FALSE;
+	irq_flags_t flags, mflags;
 	struct vmm_blockdev *bdev;
 
 	if (!r || !r->bdev || !r->bdev->rq) {
@@ -147,6 +591,20 @@ int vmm_blockdev_abort_request(struct vmm_request *r)
 	}
 	bdev = r->bdev;
 
+	/* Request still plugged or carried by merged request */
+	vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
+	vmm_spin_lock_irqsave(&bdev->rq->merge_lock, mflags);
+	if (!list_empty(&r->head)) {
+		list_del_init(&r->head);
+		r->merged = NULL;
+		found = TRUE;
+	}
+	vmm_spin_unlock_irqrestore(&bdev->rq->merge_lock, mflags);
+	vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+	if (found) {
+		return vmm_blockdev_fail_request(r);
+	}
+
 	if (bdev->rq->abort_request) {
 		vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
 		rc = bdev->rq->abort_request(bdev->rq, r);
@@ -162,23 +620,31 @@ VMM_EXPORT_SYMBOL(vmm_blockdev_abort_request);
 
 int vmm_blockdev_flush_cache(struct vmm_blockdev *bdev)
 {
-	int rc;
+	int rc = VMM_OK;
 	irq_flags_t flags;
+	struct dlist wbreqs;
 
 	if (!bdev || !bdev->rq) {
 		return VMM_EFAIL;
 	}
 
+	vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
+
+	/* Dirty pages of page cache and plugged requests go before flush */
+	if (bdev->rq->cache) {
+		INIT_LIST_HEAD(&wbreqs);
+		vmm_blockcache_writeback(bdev->rq->cache, TRUE, &wbreqs);
+		blockdev_queue_list(bdev->rq, &wbreqs);
+	}
+	blockdev_dispatch_plugged(bdev->rq);
+
 	if (bdev->rq->flush_cache) {
-		vmm_spin_lock_irqsave(&bdev->rq->lock, flags);
 		rc = bdev->rq->flush_cache(bdev->rq);
-		vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
-		if (rc) {
-			return rc;
-		}
 	}
 
-	return VMM_OK;
+	vmm_spin_unlock_irqrestore(&bdev->rq->lock, flags);
+
+	return rc;
 }
 VMM_EXPORT_SYMBOL(vmm_blockdev_flush_cache);
 
@@ -224,6 +690,9 @@ static int blockdev_rw_blocks(struct vmm_blockdev *bdev,
 	rw.req.lba = bdev->start_lba + lba;
 	rw.req.bcnt = bcnt;
 	rw.req.data = buf;
+	rw.req.sg = NULL;
+	rw.req.sg_count = 0;
+	rw.req.bounce = NULL;
 	rw.req.priv = &rw;
 	rw.req.completed = blockdev_rw_completed;
 	rw.req.failed = blockdev_rw_failed;
@@ -364,6 +833,113 @@ done:
 }
 VMM_EXPORT_SYMBOL(vmm_blockdev_rw);
 
+int vmm_blockdev_direct_access(struct vmm_blockdev *bdev,
+			       u64 off, u64 len, physical_addr_t *pa)
+{
+	int rc;
+	u64 lba, bcnt;
+	physical_addr_t bpa;
+
+	if (!bdev || !bdev->rq || !len || !pa) {
+		return VMM_EFAIL;
+	}
+
+	if (!bdev->rq->direct_access) {
+		return VMM_ENOTAVAIL;
+	}
+
+	lba = udiv64(off, bdev->block_size);
+	bcnt = udiv64(off + len + bdev->block_size - 1,
+		      bdev->block_size) - lba;
+	if (bdev->num_blocks < (lba + bcnt)) {
+		return VMM_ERANGE;
+	}
+
+	/* Dirty pages of page cache must reach block device first */
+	if (bdev->rq->cache) {
+		rc = vmm_blockdev_flush_cache(bdev);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	rc = bdev->rq->direct_access(bdev->rq, bdev->start_lba + lba,
+				     bcnt, &bpa);
+	if (rc) {
+		return rc;
+	}
+
+	*pa = bpa + (off - lba * bdev->block_size);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_blockdev_direct_access);
+
+static void blockdev_readahead_done(struct vmm_request *r)
+{
+	vmm_free(r->data);
+	vmm_free(r);
+}
+
+int vmm_blockdev_readahead(struct vmm_blockdev *bdev, u64 off, u64 len)
+{
+	int rc;
+	u64 lba, end, bcnt, max_bcnt;
+	struct vmm_request *r;
+
+	if (!bdev || !bdev->rq || !len) {
+		return VMM_EFAIL;
+	}
+
+	/* Data read ahead is only kept by page cache */
+	if (!bdev->rq->cache || !bdev->rq->make_request) {
+		return VMM_ENOTAVAIL;
+	}
+
+	lba = udiv64(off, bdev->block_size);
+	end = udiv64(off + len + bdev->block_size - 1, bdev->block_size);
+	if (bdev->num_blocks < end) {
+		end = bdev->num_blocks;
+	}
+	max_bcnt = udiv32(VMM_REQUEST_MERGE_MAX_SIZE, bdev->block_size);
+	if (!max_bcnt) {
+		max_bcnt = 1;
+	}
+
+	while (lba < end) {
+		bcnt = ((end - lba) < max_bcnt) ? (end - lba) : max_bcnt;
+
+		r = vmm_zalloc(sizeof(*r));
+		if (!r) {
+			return VMM_ENOMEM;
+		}
+		r->data = vmm_malloc(bcnt * bdev->block_size);
+		if (!r->data) {
+			vmm_free(r);
+			return VMM_ENOMEM;
+		}
+		r->type = VMM_REQUEST_READ;
+		r->lba = bdev->start_lba + lba;
+		r->bcnt = bcnt;
+		r->completed = blockdev_readahead_done;
+		r->failed = blockdev_readahead_done;
+
+		/* Request is already validated so submit_request()
+		 * only fails without calling failed() callback.
+		 */
+		rc = vmm_blockdev_submit_request(bdev, r);
+		if (rc) {
+			blockdev_readahead_done(r);
+			return rc;
+		}
+
+		lba += bcnt;
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_blockdev_readahead);
+
 struct vmm_blockdev *vmm_blockdev_alloc(void)
 {
 	struct vmm_blockdev *bdev;
@@ -378,6 +954,11 @@ struct vmm_blockdev *vmm_blockdev_alloc(void)
 	bdev->child_count = 0;
 	INIT_LIST_HEAD(&bdev->child_list);
 	bdev->rq = NULL;
+	vmm_percpu_counter_init(&bdev->stat_read_reqs);
+	vmm_percpu_counter_init(&bdev->stat_read_blocks);
+	vmm_percpu_counter_init(&bdev->stat_write_reqs);
+	vmm_percpu_counter_init(&bdev->stat_write_blocks);
+	vmm_percpu_counter_init(&bdev->stat_failed_reqs);
 
 	return bdev;
 }
@@ -385,6 +966,15 @@ VMM_EXPORT_SYMBOL(vmm_blockdev_alloc);
 
 void vmm_blockdev_free(struct vmm_blockdev *bdev)
 {
+	if (!bdev) {
+		return;
+	}
+
+	vmm_percpu_counter_destroy(&bdev->stat_read_reqs);
+	vmm_percpu_counter_destroy(&bdev->stat_read_blocks);
+	vmm_percpu_counter_destroy(&bdev->stat_write_reqs);
+	vmm_percpu_counter_destroy(&bdev->stat_write_blocks);
+	vmm_percpu_counter_destroy(&bdev->stat_failed_reqs);
 	vmm_free(bdev);
 }
 VMM_EXPORT_SYMBOL(vmm_blockdev_free);
@@ -23,6 +23,7 @@
 
 #include <vmm_error.h>
 #include <vmm_heap.h>
+#include <vmm_stdio.h>
 #include <vmm_threads.h>
 #include <vmm_completion.h>
 #include <vmm_modules.h>
@@ -36,6 +37,8 @@
 #define	MODULE_INIT			vmm_blockpart_init
 #define	MODULE_EXIT			vmm_blockpart_exit
 
+#define BLOCKPART_WORKERS		CONFIG_BLOCKPART_WORKERS
+
 enum blockpart_work_type {
 	BLOCKPART_WORK_UNKNOWN=0,
 	BLOCKPART_WORK_PARSE=1,
@@ -52,26 +55,15 @@ struct blockpart_ctrl {
 	struct dlist mngr_list;
 	vmm_spinlock_t work_list_lock;
 	struct dlist work_list;
+	struct dlist busy_list;
 	struct vmm_completion work_avail;
 	u32 work_count;
-	struct vmm_thread *work_thread;
+	struct vmm_thread *work_thread[BLOCKPART_WORKERS];
 	struct vmm_notifier_block client;
 };
 
 static struct blockpart_ctrl bpctrl;
 
-static u32 blockpart_count_work(void)
-{
-	u32 ret = 0;
-	irq_flags_t flags;
-
-	vmm_spin_lock_irqsave(&bpctrl.work_list_lock, flags);
-	ret = bpctrl.work_count;
-	vmm_spin_unlock_irqrestore(&bpctrl.work_list_lock, flags);
-
-	return ret;
-}
-
 static struct blockpart_work *blockpart_pop_work(void)
 {
 	irq_flags_t flags;
@@ -84,6 +76,7 @@ static struct blockpart_work *blockpart_pop_work(void)
 				     struct blockpart_work, head);
 		list_del(&w->head);
 		bpctrl.work_count--;
+		list_add_tail(&w->head, &bpctrl.busy_list);
 	}
 
 	vmm_spin_unlock_irqrestore(&bpctrl.work_list_lock, flags);
@@ -91,6 +84,26 @@ static struct blockpart_work *blockpart_pop_work(void)
 	return w;
 }
 
+static void blockpart_done_work(struct blockpart_work *w, bool requeue)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&bpctrl.work_list_lock, flags);
+
+	list_del(&w->head);
+	if (requeue && w->bdev) {
+		list_add_tail(&w->head, &bpctrl.work_list);
+		bpctrl.work_count++;
+		w = NULL;
+	}
+
+	vmm_spin_unlock_irqrestore(&bpctrl.work_list_lock, flags);
+
+	if (w) {
+		vmm_free(w);
+	}
+}
+
 static void blockpart_add_work(enum blockpart_work_type type,
 				struct vmm_blockdev *bdev)
 {
@@ -104,6 +117,7 @@ static void blockpart_add_work(enum blockpart_work_type type,
 
 	vmm_spin_lock_irqsave(&bpctrl.work_list_lock, flags);
 
+	/* Work being processed by some worker is also a duplicate */
 	found = FALSE;
 	list_for_each_entry(w, &bpctrl.work_list, head) {
 		if ((w->type == type) && (w->bdev == bdev)) {
@@ -111,6 +125,12 @@ static void blockpart_add_work(enum blockpart_work_type type,
 			break;
 		}
 	}
+	list_for_each_entry(w, &bpctrl.busy_list, head) {
+		if ((w->type == type) && (w->bdev == bdev)) {
+			found = TRUE;
+			break;
+		}
+	}
 	if (!found) {
 		w = vmm_zalloc(sizeof(struct blockpart_work));
 		if (w) {
@@ -146,53 +166,66 @@ static void blockpart_del_work(enum blockpart_work_type type,
 		}
 	}
 
+	/* Work being processed is not requeued upon completion */
+	list_for_each_entry(w, &bpctrl.busy_list, head) {
+		if ((w->type == type) && (w->bdev == bdev)) {
+			w->bdev = NULL;
+			break;
+		}
+	}
+
 	vmm_spin_unlock_irqrestore(&bpctrl.work_list_lock, flags);
 }
 
+static bool blockpart_parse(struct vmm_blockdev *bdev)
+{
+	int rc, j, cnt;
+	struct vmm_blockpart_manager *m;
+
+	cnt = vmm_blockpart_manager_count();
+	for (j = 0; j < cnt; j++) {
+		m = vmm_blockpart_manager_get(j);
+		if (!m || !m->parse_part) {
+			continue;
+		}
+		rc = m->parse_part(bdev);
+		if (rc) {
+			continue;
+		}
+		bdev->part_manager_sign = m->sign;
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+/* Each worker takes one work per wakeup so that partition tables
+ * of different block devices are parsed concurrently. Unparsed block
+ * devices are requeued and retried when a new manager registers.
+ */
 static int blockpart_thread_main(void *udata)
 {
 	bool parsed;
-	int rc, i, j, cnt, wcnt;
 	struct blockpart_work *w;
-	struct vmm_blockpart_manager *m;
 
 	while (1) {
 		vmm_completion_wait(&bpctrl.work_avail);
 
-		wcnt = blockpart_count_work();
-		for (i = 0; i < wcnt; i++) {
-			w = blockpart_pop_work();
-			if (!w) {
-				continue;
-			}
+		w = blockpart_pop_work();
+		if (!w) {
+			continue;
+		}
 
-			switch(w->type) {
-			case BLOCKPART_WORK_PARSE:
-				parsed = FALSE;
-				cnt = vmm_blockpart_manager_count();
-				for (j = 0; j < cnt; j++) {
-					m = vmm_blockpart_manager_get(j);
-					if (!m || !m->parse_part) {
-						continue;
-					}
-					rc = m->parse_part(w->bdev);
-					if (rc) {
-						continue;
-					}
-					parsed = TRUE;
-					w->bdev->part_manager_sign = m->sign;
-					break;
-				}
-				if (!parsed) {
-					blockpart_add_work(w->type, w->bdev);
-				}
-				break;
-			default:
-				break;
-			};
+		switch(w->type) {
+		case BLOCKPART_WORK_PARSE:
+			parsed = blockpart_parse(w->bdev);
+			break;
+		default:
+			parsed = TRUE;
+			break;
+		};
 
-			vmm_free(w);
-		}
+		blockpart_done_work(w, !parsed);
 	};
 
 	return VMM_OK;
@@ -401,9 +434,25 @@ done:
 	return VMM_OK;
 }
 
+static void blockpart_destroy_workers(void)
+{
+	u32 i;
+
+	for (i = 0; i < BLOCKPART_WORKERS; i++) {
+		if (!bpctrl.work_thread[i]) {
+			continue;
+		}
+		vmm_threads_stop(bpctrl.work_thread[i]);
+		vmm_threads_destroy(bpctrl.work_thread[i]);
+		bpctrl.work_thread[i] = NULL;
+	}
+}
+
 static int __init vmm_blockpart_init(void)
 {
 	int rc;
+	u32 i;
+	char name[VMM_FIELD_NAME_SIZE];
 
 	/* Initialize manager list lock */
 	INIT_SPIN_LOCK(&bpctrl.mngr_list_lock);
@@ -417,6 +466,9 @@ static int __init vmm_blockpart_init(void)
 	/* Initialize work list */
 	INIT_LIST_HEAD(&bpctrl.work_list);
 
+	/* Initialize busy list */
+	INIT_LIST_HEAD(&bpctrl.busy_list);
+
 	/* Initialize work available completion */
 	INIT_COMPLETION(&bpctrl.work_avail);
 
@@ -431,14 +483,18 @@ static int __init vmm_blockpart_init(void)
 		return rc;
 	}
 
-	/* Create blockpart work thread */
-	bpctrl.work_thread = vmm_threads_create("partd",
+	/* Create blockpart work threads */
+	for (i = 0; i < BLOCKPART_WORKERS; i++) {
+		vmm_snprintf(name, sizeof(name), "partd/%d", i);
+		bpctrl.work_thread[i] = vmm_threads_create(name,
 						blockpart_thread_main, NULL,
 						VMM_THREAD_DEF_PRIORITY,
 						VMM_THREAD_DEF_TIME_SLICE);
-	if (!bpctrl.work_thread) {
-		vmm_blockdev_unregister_client(&bpctrl.client);
-		return VMM_EFAIL;
+		if (!bpctrl.work_thread[i]) {
+			blockpart_destroy_workers();
+			vmm_blockdev_unregister_client(&bpctrl.client);
+			return VMM_EFAIL;
+		}
 	}
 
 	/* We may have block device already created so we add
@@ -446,24 +502,23 @@ static int __init vmm_blockpart_init(void)
 	 */
 	rc = vmm_blockdev_iterate(NULL, NULL, blockpart_init_iter);
 	if (rc) {
-		vmm_threads_destroy(bpctrl.work_thread);
+		blockpart_destroy_workers();
 		vmm_blockdev_unregister_client(&bpctrl.client);
 		return rc;
 	}
 
-	/* Start blockpart work thread */
-	vmm_threads_start(bpctrl.work_thread);
+	/* Start blockpart work threads */
+	for (i = 0; i < BLOCKPART_WORKERS; i++) {
+		vmm_threads_start(bpctrl.work_thread[i]);
+	}
 
 	return VMM_OK;
 }
 
 static void __exit vmm_blockpart_exit(void)
 {
-	/* Start blockpart workerthread */
-	vmm_threads_stop(bpctrl.work_thread);
-
-	/* Destroy blockpart work thread */
-	vmm_threads_destroy(bpctrl.work_thread);
+	/* Stop and destroy blockpart work threads */
+	blockpart_destroy_workers();
 
 	/* Unregister client for block device notifications */
 	vmm_blockdev_unregister_client(&bpctrl.client);
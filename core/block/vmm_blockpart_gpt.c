@@ -0,0 +1,305 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_blockpart_gpt.c
+ * @author agent (agent@local)
+ * @brief source file for GUID partition table (GPT) partitions
+ *
+ * The protective MBR, primary GPT header and partition entry array
+ * are fetched using a single block device read of the table area.
+ */
+
+#include <vmm_error.h>
+#include <vmm_compiler.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_host_io.h>
+#include <vmm_modules.h>
+#include <block/vmm_blockpart.h>
+#include <libs/stringlib.h>
+
+#define MODULE_DESC			"GUID Partition Table"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(VMM_BLOCKPART_IPRIORITY+1)
+#define	MODULE_INIT			vmm_blockpart_gpt_init
+#define	MODULE_EXIT			vmm_blockpart_gpt_exit
+
+#undef GPT_DEBUG
+
+#ifdef GPT_DEBUG
+#define debug(x...)			vmm_printf(x)
+#else
+#define debug(x...)
+#endif
+
+#define GPT_MBR_SIGN_OFFSET		0x1FE
+#define GPT_MBR_SIGN_VALUE		0xAA55
+#define GPT_MBR_PARTTBL_OFFSET		0x1BE
+#define GPT_MBR_PARTITION_EFI_GPT	0xEE
+
+#define GPT_HEADER_SIGNATURE		0x5452415020494645ULL
+#define GPT_HEADER_LBA			1
+#define GPT_ENTRY_MIN_SIZE		128
+#define GPT_ENTRY_MAX_COUNT		128
+
+/* Size of table area read in one go (upto 128 entries of 128 bytes) */
+#define GPT_TABLE_AREA_SIZE		(GPT_ENTRY_MAX_COUNT * GPT_ENTRY_MIN_SIZE)
+
+/* Primary GPT header */
+struct gpt_header {
+	u64 signature;
+	u32 revision;
+	u32 header_size;
+	u32 header_crc32;
+	u32 reserved;
+	u64 my_lba;
+	u64 alternate_lba;
+	u64 first_usable_lba;
+	u64 last_usable_lba;
+	u8 disk_guid[16];
+	u64 entries_lba;
+	u32 num_entries;
+	u32 entry_size;
+	u32 entries_crc32;
+} __packed;
+
+/* GPT partition entry */
+struct gpt_entry {
+	u8 type_guid[16];
+	u8 unique_guid[16];
+	u64 starting_lba;
+	u64 ending_lba;
+	u64 attributes;
+	u16 name[36];
+} __packed;
+
+/* CRC32 (IEEE 802.3) as mandated by UEFI specification */
+static u32 gpt_crc32(u32 crc, const u8 *data, u32 len)
+{
+	u32 i;
+
+	crc = ~crc;
+	while (len--) {
+		crc ^= *data++;
+		for (i = 0; i < 8; i++) {
+			crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 0x1));
+		}
+	}
+
+	return ~crc;
+}
+
+static bool gpt_is_protective_mbr(const u8 *mbr)
+{
+	u16 i, sign;
+
+	sign = vmm_le16_to_cpu(*(const u16 *)&mbr[GPT_MBR_SIGN_OFFSET]);
+	if (sign != GPT_MBR_SIGN_VALUE) {
+		return FALSE;
+	}
+
+	/* Partition type is at offset 4 of each 16 byte MBR entry */
+	for (i = 0; i < 4; i++) {
+		if (mbr[GPT_MBR_PARTTBL_OFFSET + i * 16 + 4] ==
+						GPT_MBR_PARTITION_EFI_GPT) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static int gpt_check_header(struct vmm_blockdev *bdev,
+			    struct gpt_header *hdr)
+{
+	u32 crc, hdr_size;
+
+	if (vmm_le64_to_cpu(hdr->signature) != GPT_HEADER_SIGNATURE) {
+		return VMM_ENOSYS;
+	}
+
+	hdr_size = vmm_le32_to_cpu(hdr->header_size);
+	if ((hdr_size < sizeof(*hdr)) || (bdev->block_size < hdr_size)) {
+		return VMM_EINVALID;
+	}
+
+	crc = vmm_le32_to_cpu(hdr->header_crc32);
+	hdr->header_crc32 = 0;
+	if (gpt_crc32(0, (u8 *)hdr, hdr_size) != crc) {
+		vmm_printf("%s: GPT header CRC mismatch\n", bdev->name);
+		return VMM_EINVALID;
+	}
+
+	if (vmm_le64_to_cpu(hdr->my_lba) != GPT_HEADER_LBA) {
+		return VMM_EINVALID;
+	}
+
+	if ((vmm_le32_to_cpu(hdr->entry_size) < GPT_ENTRY_MIN_SIZE) ||
+	    !vmm_le32_to_cpu(hdr->num_entries)) {
+		return VMM_EINVALID;
+	}
+
+	return VMM_OK;
+}
+
+static int gpt_parse_part(struct vmm_blockdev *bdev)
+{
+	int rc;
+	u8 *buf, *ents;
+	u64 read, len, first, last, start, end, ents_off, ents_len;
+	u32 i, esize, ecount, process_count;
+	struct gpt_header *hdr;
+	struct gpt_entry *e;
+	static const u8 unused_guid[16] = { 0 };
+
+	if (!bdev->block_size || (bdev->block_size < sizeof(*hdr)) ||
+	    (bdev->num_blocks <= (GPT_HEADER_LBA + 1))) {
+		return VMM_ENOSYS;
+	}
+
+	/* Protective MBR, GPT header and usual entry array in one read */
+	len = (GPT_HEADER_LBA + 1) * bdev->block_size + GPT_TABLE_AREA_SIZE;
+	if ((bdev->num_blocks * bdev->block_size) < len) {
+		len = bdev->num_blocks * bdev->block_size;
+	}
+	buf = vmm_malloc(len);
+	if (!buf) {
+		return VMM_ENOMEM;
+	}
+	read = vmm_blockdev_read(bdev, buf, 0, len);
+	if (read != len) {
+		rc = VMM_EIO;
+		goto done;
+	}
+
+	if (!gpt_is_protective_mbr(buf)) {
+		rc = VMM_ENOSYS;
+		goto done;
+	}
+
+	hdr = (struct gpt_header *)&buf[GPT_HEADER_LBA * bdev->block_size];
+	rc = gpt_check_header(bdev, hdr);
+	if (rc) {
+		goto done;
+	}
+
+	first = vmm_le64_to_cpu(hdr->first_usable_lba);
+	last = vmm_le64_to_cpu(hdr->last_usable_lba);
+	esize = vmm_le32_to_cpu(hdr->entry_size);
+	ecount = vmm_le32_to_cpu(hdr->num_entries);
+	ents_off = vmm_le64_to_cpu(hdr->entries_lba) * bdev->block_size;
+	ents_len = (u64)esize * ecount;
+	if ((last < first) || (bdev->num_blocks <= last)) {
+		rc = VMM_EINVALID;
+		goto done;
+	}
+
+	/* Entry array is read separately only when it is not
+	 * within the table area read above
+	 */
+	if ((ents_off + ents_len) <= len) {
+		ents = &buf[ents_off];
+	} else {
+		if (((bdev->num_blocks * bdev->block_size) < ents_off) ||
+		    (GPT_TABLE_AREA_SIZE * 8 < ents_len)) {
+			rc = VMM_EINVALID;
+			goto done;
+		}
+		ents = vmm_malloc(ents_len);
+		if (!ents) {
+			rc = VMM_ENOMEM;
+			goto done;
+		}
+		read = vmm_blockdev_read(bdev, ents, ents_off, ents_len);
+		if (read != ents_len) {
+			vmm_free(ents);
+			rc = VMM_EIO;
+			goto done;
+		}
+	}
+
+	if (gpt_crc32(0, ents, ents_len) !=
+				vmm_le32_to_cpu(hdr->entries_crc32)) {
+		vmm_printf("%s: GPT entries CRC mismatch\n", bdev->name);
+		rc = VMM_EINVALID;
+		goto done_ents;
+	}
+
+	/* Process each used entry of partition entry array */
+	process_count = 0;
+	for (i = 0; i < ecount; i++) {
+		e = (struct gpt_entry *)&ents[i * esize];
+		if (!memcmp(e->type_guid, unused_guid, sizeof(unused_guid))) {
+			continue;
+		}
+
+		start = vmm_le64_to_cpu(e->starting_lba);
+		end = vmm_le64_to_cpu(e->ending_lba);
+		debug("%s: entry=%d start_lba=0x%"PRIx64" end_lba=0x%"PRIx64"\n",
+		      bdev->name, i, start, end);
+		if ((start < first) || (end < start) || (last < end)) {
+			vmm_printf("%s: skipping invalid GPT entry %d\n",
+				   bdev->name, i);
+			continue;
+		}
+
+		rc = vmm_blockdev_add_child(bdev, start, end - start + 1);
+		if (rc) {
+			vmm_printf("%s: failed to add GPT partition "
+				   "(error %d)\n", bdev->name, rc);
+			continue;
+		}
+
+		process_count++;
+	}
+
+	/* Failure if we did not process any GPT entry */
+	rc = (process_count) ? VMM_OK : VMM_ENOENT;
+
+done_ents:
+	if (ents != &buf[ents_off]) {
+		vmm_free(ents);
+	}
+done:
+	vmm_free(buf);
+	return rc;
+}
+
+static struct vmm_blockpart_manager gpt = {
+	.sign = 0x2,
+	.name = "GPT Partitions",
+	.parse_part = gpt_parse_part,
+};
+
+static int __init vmm_blockpart_gpt_init(void)
+{
+	return vmm_blockpart_manager_register(&gpt);
+}
+
+static void __exit vmm_blockpart_gpt_exit(void)
+{
+	vmm_blockpart_manager_unregister(&gpt);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -26,17 +26,38 @@
 #include <vmm_heap.h>
 #include <vmm_stdio.h>
 #include <vmm_modules.h>
+#include <vmm_smp.h>
+#include <vmm_cpumask.h>
+#include <vmm_threads.h>
 #include <vmm_host_aspace.h>
 #include <block/vmm_blockrq_nop.h>
+#include <libs/stringlib.h>
 
 struct blockrq_nop_work {
 	struct vmm_blockrq_nop *rqnop;
 	struct dlist head;
 	struct vmm_work work;
 	struct vmm_request *r;
+	u32 hcpu;
 	bool is_free;
 };
 
+/* Find worker bound to current host CPU */
+static struct vmm_workqueue *blockrq_nop_current_wq(
+					struct vmm_blockrq_nop *rqnop,
+					u32 hcpu)
+{
+	u32 i;
+
+	for (i = 0; i < rqnop->wq_count; i++) {
+		if (rqnop->wq_hcpu[i] == hcpu) {
+			return rqnop->wq[i];
+		}
+	}
+
+	return rqnop->wq[hcpu % rqnop->wq_count];
+}
+
 static int blockrq_nop_queue_work(struct vmm_blockrq_nop *rqnop,
 				  struct vmm_request *r)
 {
@@ -55,10 +76,13 @@ static int blockrq_nop_queue_work(struct vmm_blockrq_nop *rqnop,
 				   struct blockrq_nop_work, head);
 	list_del(&nopwork->head);
 	nopwork->r = r;
+	nopwork->hcpu = vmm_smp_processor_id();
 	nopwork->is_free = FALSE;
 	list_add_tail(&nopwork->head, &rqnop->wq_pending_list);
 
-	vmm_workqueue_schedule_work(rqnop->wq, &nopwork->work);
+	vmm_workqueue_schedule_work(
+			blockrq_nop_current_wq(rqnop, nopwork->hcpu),
+			&nopwork->work);
 
 done:
 	vmm_spin_unlock_irqrestore(&rqnop->wq_lock, flags);
@@ -115,6 +139,17 @@ static int blockrq_nop_abort_work(struct vmm_blockrq_nop *rqnop,
 	return VMM_OK;
 }
 
+static void blockrq_nop_done(void *rptr, void *rcptr, void *dummy)
+{
+	struct vmm_request *r = rptr;
+
+	if ((long)rcptr) {
+		vmm_blockdev_fail_request(r);
+	} else {
+		vmm_blockdev_complete_request(r);
+	}
+}
+
 static void blockrq_nop_work_func(struct vmm_work *work)
 {
 	int rc;
@@ -144,10 +179,14 @@ static void blockrq_nop_work_func(struct vmm_work *work)
 			rc = VMM_EINVALID;
 			break;
 		};
-		if (rc) {
-			vmm_blockdev_fail_request(nopwork->r);
+		if ((rqnop->wq_count > 1) &&
+		    (nopwork->hcpu != vmm_smp_processor_id())) {
+			/* Complete on host CPU which submitted request */
+			vmm_smp_ipi_async_call(vmm_cpumask_of(nopwork->hcpu),
+					       blockrq_nop_done, nopwork->r,
+					       (void *)(long)rc, NULL);
 		} else {
-			vmm_blockdev_complete_request(nopwork->r);
+			blockrq_nop_done(nopwork->r, (void *)(long)rc, NULL);
 		}
 	} else {
 		if (rqnop->flush) {
@@ -178,36 +217,48 @@ static int blockrq_nop_flush_cache(struct vmm_request_queue *rq)
 int vmm_blockrq_nop_destroy(struct vmm_blockrq_nop *rqnop)
 {
 	int rc;
+	u32 i;
 
 	if (!rqnop) {
 		return VMM_EINVALID;
 	}
 
-	rc = vmm_workqueue_destroy(rqnop->wq);
-	if (rc) {
-		return rc;
+	for (i = 0; i < rqnop->wq_count; i++) {
+		if (!rqnop->wq[i]) {
+			continue;
+		}
+		rc = vmm_workqueue_destroy(rqnop->wq[i]);
+		if (rc) {
+			return rc;
+		}
+		rqnop->wq[i] = NULL;
 	}
 
 	vmm_host_free_pages(rqnop->wq_page_va, rqnop->wq_page_count);
 
+	vmm_free(rqnop->wq_hcpu);
+	vmm_free(rqnop->wq);
+
 	vmm_free(rqnop);
 
 	return VMM_OK;
 }
 VMM_EXPORT_SYMBOL(vmm_blockrq_nop_destroy);
 
-struct vmm_blockrq_nop *vmm_blockrq_nop_create(
-	const char *name, u32 max_pending,
+struct vmm_blockrq_nop *vmm_blockrq_nop_create_mt(
+	const char *name, u32 max_pending, u32 worker_count,
 	int (*read)(struct vmm_blockrq_nop *,struct vmm_request *, void *),
 	int (*write)(struct vmm_blockrq_nop *,struct vmm_request *, void *),
 	void (*flush)(struct vmm_blockrq_nop *,void *),
 	void *priv)
 {
-	u32 i;
+	u32 i, cpu;
+	struct vmm_thread *thread;
 	struct vmm_blockrq_nop *rqnop;
 	struct blockrq_nop_work *nopwork;
+	char wq_name[VMM_FIELD_NAME_SIZE];
 
-	if (!name || (max_pending==0)) {
+	if (!name || (max_pending==0) || (worker_count==0)) {
 		goto fail;
 	}
 
@@ -245,12 +296,43 @@ struct vmm_blockrq_nop *vmm_blockrq_nop_create(
 		list_add_tail(&nopwork->head, &rqnop->wq_free_list);
 	}
 
-	rqnop->wq = vmm_workqueue_create(name, VMM_THREAD_DEF_PRIORITY);
-	if (!rqnop->wq) {
-		goto fail_free_pages;
+	rqnop->wq_count = worker_count;
+	rqnop->wq = vmm_zalloc(worker_count * sizeof(*rqnop->wq));
+	rqnop->wq_hcpu = vmm_zalloc(worker_count * sizeof(*rqnop->wq_hcpu));
+	if (!rqnop->wq || !rqnop->wq_hcpu) {
+		goto fail_free_wq;
+	}
+
+	if (worker_count == 1) {
+		rqnop->wq[0] = vmm_workqueue_create(name,
+						    VMM_THREAD_DEF_PRIORITY);
+		if (!rqnop->wq[0]) {
+			goto fail_destroy_wq;
+		}
+	}
+
+	/* Bind multiple workers round-robin to online host CPUs */
+	cpu = vmm_cpumask_first(cpu_online_mask);
+	for (i = 0; (worker_count > 1) && (i < worker_count); i++) {
+		rqnop->wq_hcpu[i] = cpu;
+
+		vmm_snprintf(wq_name, sizeof(wq_name), "%s/%d", name, i);
+		rqnop->wq[i] = vmm_workqueue_create(wq_name,
+						    VMM_THREAD_DEF_PRIORITY);
+		if (!rqnop->wq[i]) {
+			goto fail_destroy_wq;
+		}
+		thread = vmm_workqueue_get_thread(rqnop->wq[i]);
+		vmm_threads_set_affinity(thread, vmm_cpumask_of(cpu));
+
+		cpu = vmm_cpumask_next(cpu, cpu_online_mask);
+		if (vmm_cpu_count <= cpu) {
+			cpu = vmm_cpumask_first(cpu_online_mask);
+		}
 	}
 
 	INIT_REQUEST_QUEUE(&rqnop->rq);
+	rqnop->rq.flags = VMM_REQUEST_QUEUE_MERGE;
 	rqnop->rq.make_request = blockrq_nop_make_request;
 	rqnop->rq.abort_request = blockrq_nop_abort_request;
 	rqnop->rq.flush_cache = blockrq_nop_flush_cache;
@@ -258,12 +340,24 @@ struct vmm_blockrq_nop *vmm_blockrq_nop_create(
 
 	return rqnop;
 
-fail_free_pages:
+fail_destroy_wq:
+	for (i = 0; i < worker_count; i++) {
+		if (rqnop->wq[i]) {
+			vmm_workqueue_destroy(rqnop->wq[i]);
+		}
+	}
+fail_free_wq:
+	if (rqnop->wq_hcpu) {
+		vmm_free(rqnop->wq_hcpu);
+	}
+	if (rqnop->wq) {
+		vmm_free(rqnop->wq);
+	}
 	vmm_host_free_pages(rqnop->wq_page_va, rqnop->wq_page_count);
 fail_free_rqnop:
 	vmm_free(rqnop);
 fail:
 	return NULL;
 }
-VMM_EXPORT_SYMBOL(vmm_blockrq_nop_create);
+VMM_EXPORT_SYMBOL(vmm_blockrq_nop_create_mt);
 
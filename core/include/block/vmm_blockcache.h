@@ -0,0 +1,156 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_blockcache.h
+ * @author agent (agent@local)
+ * @brief Block device page cache interface
+ *
+ * The page cache is attached to request queue of a block device hence
+ * it is shared by all partitions of the block device and by all Guests
+ * using them. Cache pages are kept in LRU order and only clean pages
+ * are evicted.
+ */
+
+#ifndef __VMM_BLOCKCACHE_H_
+#define __VMM_BLOCKCACHE_H_
+
+#include <vmm_types.h>
+#include <vmm_error.h>
+#include <block/vmm_blockdev.h>
+#include <libs/list.h>
+
+/** Block cache write policy */
+enum vmm_blockcache_mode {
+	VMM_BLOCKCACHE_WRITETHROUGH=0,
+	VMM_BLOCKCACHE_WRITEBACK=1
+};
+
+/** Block cache statistics */
+struct vmm_blockcache_stats {
+	enum vmm_blockcache_mode mode;
+	u32 page_count;
+	u32 used_count;
+	u32 dirty_count;
+	u64 hits;
+	u64 misses;
+};
+
+struct vmm_blockcache;
+
+#if defined(CONFIG_BLOCK_CACHE)
+
+/** Enable page cache of given size (in KB) for block device
+ *  Note: The page cache is attached to root block device.
+ *  Note: This function should be called from Orphan (or Thread) context.
+ */
+int vmm_blockcache_enable(struct vmm_blockdev *bdev, u32 size_kb,
+			  enum vmm_blockcache_mode mode);
+
+/** Disable page cache of block device
+ *  Note: Returns VMM_EBUSY (after starting writeback) if page cache
+ *  has dirty pages or in-flight requests.
+ *  Note: This function should be called from Orphan (or Thread) context.
+ */
+int vmm_blockcache_disable(struct vmm_blockdev *bdev);
+
+/** Retrive page cache statistics of block device */
+int vmm_blockcache_get_stats(struct vmm_blockdev *bdev,
+			     struct vmm_blockcache_stats *stats);
+
+/* ===== Internal interface used by block device framework ===== */
+
+/** Serve read request from page cache
+ *  Returns TRUE if all blocks of request were copied from page cache.
+ */
+bool vmm_blockcache_read(struct vmm_blockcache *cache,
+			 struct vmm_request *r);
+
+/** Update page cache for write request
+ *  Returns TRUE if write request was absorbed by write-back cache.
+ */
+bool vmm_blockcache_write(struct vmm_blockcache *cache,
+			  struct vmm_request *r);
+
+/** Start tracking read request going to block device
+ *  Returns cookie to be passed to vmm_blockcache_fill()
+ */
+u32 vmm_blockcache_get(struct vmm_blockcache *cache);
+
+/** Fill page cache from completed read request */
+void vmm_blockcache_fill(struct vmm_blockcache *cache, u32 cookie,
+			 struct vmm_request *r, bool failed);
+
+/** Prepare write requests for dirty pages
+ *  Note: If all is FALSE then requests are only prepared when too
+ *  many pages are dirty. Prepared requests are added to reqs list
+ *  and must be submitted to request queue by the caller.
+ */
+void vmm_blockcache_writeback(struct vmm_blockcache *cache, bool all,
+			      struct dlist *reqs);
+
+#else
+
+static inline int vmm_blockcache_enable(struct vmm_blockdev *bdev,
+					u32 size_kb,
+					enum vmm_blockcache_mode mode)
+{
+	return VMM_ENOTSUPP;
+}
+
+static inline int vmm_blockcache_disable(struct vmm_blockdev *bdev)
+{
+	return VMM_ENOTSUPP;
+}
+
+static inline int vmm_blockcache_get_stats(struct vmm_blockdev *bdev,
+					struct vmm_blockcache_stats *stats)
+{
+	return VMM_ENOTSUPP;
+}
+
+static inline bool vmm_blockcache_read(struct vmm_blockcache *cache,
+				       struct vmm_request *r)
+{
+	return FALSE;
+}
+
+static inline bool vmm_blockcache_write(struct vmm_blockcache *cache,
+					struct vmm_request *r)
+{
+	return FALSE;
+}
+
+static inline u32 vmm_blockcache_get(struct vmm_blockcache *cache)
+{
+	return 0;
+}
+
+static inline void vmm_blockcache_fill(struct vmm_blockcache *cache,
+				       u32 cookie, struct vmm_request *r,
+				       bool failed)
+{
+}
+
+static inline void vmm_blockcache_writeback(struct vmm_blockcache *cache,
+					    bool all, struct dlist *reqs)
+{
+}
+
+#endif
+
+#endif /* __VMM_BLOCKCACHE_H_ */
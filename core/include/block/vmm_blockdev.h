@@ -29,7 +29,9 @@
 #include <vmm_devdrv.h>
 #include <vmm_spinlocks.h>
 #include <vmm_mutex.h>
+#include <vmm_percpu.h>
 #include <vmm_notifier.h>
+#include <libs/list.h>
 
 #define VMM_BLOCKDEV_CLASS_NAME				"block"
 #define VMM_BLOCKDEV_CLASS_IPRIORITY			1
@@ -41,6 +43,12 @@ enum vmm_request_type {
 	VMM_REQUEST_WRITE=2
 };
 
+/** Scatter-gather element of block IO request */
+struct vmm_request_sg {
+	physical_addr_t addr; /* Host physical address */
+	u32 len;
+};
+
 /** Representation of a block IO request */
 struct vmm_request {
 	struct vmm_blockdev *bdev; /* No need to set this field. 
@@ -52,16 +60,54 @@ struct vmm_request {
 	u32 bcnt;
 	void *data;
 
+	/* Note: If sg_count is non-zero then request buffer is
+	 * described by sg list instead of data pointer. For request
+	 * queues without VMM_REQUEST_QUEUE_SG flag, submit_request()
+	 * will bounce sg list through a temporary data buffer.
+	 */
+	struct vmm_request_sg *sg;
+	u32 sg_count;
+	void *bounce; /* No need to set this field. */
+
+	/* Note: Used by request plugging and merging.
+	 * No need to set these fields.
+	 */
+	struct dlist head;
+	struct vmm_request *merged;
+
 	void (*completed)(struct vmm_request *);
 	void (*failed)(struct vmm_request *);
 	void *priv;
 };
 
+/* Request queue flags */
+#define VMM_REQUEST_QUEUE_SG				0x00000001
+#define VMM_REQUEST_QUEUE_MERGE				0x00000002
+
+/* Maximum size of merged block IO request */
+#define VMM_REQUEST_MERGE_MAX_SIZE			(128 * 1024)
+
+struct vmm_blockcache;
+
 /** Representation of a block IO request queue */
 struct vmm_request_queue {
 	/* Lock to protect the request queue operations */
 	vmm_spinlock_t lock;
 
+	/* Request queue flags */
+	u32 flags;
+
+	/* Requests held back while request queue is plugged.
+	 * Adjacent requests are merged upon unplug if request
+	 * queue has VMM_REQUEST_QUEUE_MERGE flag.
+	 */
+	u32 plug_count;
+	struct dlist plug_list;
+	vmm_spinlock_t merge_lock;
+
+	/* Optional page cache (see block/vmm_blockcache.h) */
+	struct vmm_blockcache *cache;
+
 	/* Note: make_request must ensure that it calls
 	 *
 	 * vmm_blockdev_complete_request()
@@ -84,15 +130,27 @@ struct vmm_request_queue {
 	 */
 	int (*flush_cache)(struct vmm_request_queue *rq);
 
+	/* Note: This is an optional callback only required
+	 * if blocks are directly addressable host memory
+	 */
+	int (*direct_access)(struct vmm_request_queue *rq,
+			     u64 lba, u64 bcnt, physical_addr_t *pa);
+
 	void *priv;
 };
 
 #define INIT_REQUEST_QUEUE(rq) \
 		do { \
 			INIT_SPIN_LOCK(&(rq)->lock); \
+			(rq)->flags = 0; \
+			(rq)->plug_count = 0; \
+			INIT_LIST_HEAD(&(rq)->plug_list); \
+			INIT_SPIN_LOCK(&(rq)->merge_lock); \
+			(rq)->cache = NULL; \
 			(rq)->make_request = NULL; \
 			(rq)->abort_request = NULL; \
 			(rq)->flush_cache = NULL; \
+			(rq)->direct_access = NULL; \
 			(rq)->priv = NULL; \
 		} while (0)
 
@@ -120,6 +178,13 @@ struct vmm_blockdev {
 
 	struct vmm_request_queue *rq;
 
+	/* Request statistics */
+	struct vmm_percpu_counter stat_read_reqs;
+	struct vmm_percpu_counter stat_read_blocks;
+	struct vmm_percpu_counter stat_write_reqs;
+	struct vmm_percpu_counter stat_write_blocks;
+	struct vmm_percpu_counter stat_failed_reqs;
+
 	/* NOTE: partition managment uses part_manager_sign and
 	 * part_manager_priv for its own use.
 	 * NOTE: part_manager_sign will be unique to partition style
@@ -153,6 +218,12 @@ static inline u64 vmm_blockdev_total_size(struct vmm_blockdev *bdev)
 	return (bdev) ? bdev->num_blocks * bdev->block_size : 0;
 }
 
+/** Copy between scatter-gather list of block IO request and buffer
+ *  Note: to_sg=TRUE copies from buffer to scatter-gather list
+ */
+u32 vmm_blockdev_sg_copy(struct vmm_request *r, void *buf, u32 len,
+			 bool to_sg);
+
 /** Generic block IO complete request */
 int vmm_blockdev_complete_request(struct vmm_request *r);
 
@@ -166,6 +237,15 @@ int vmm_blockdev_submit_request(struct vmm_blockdev *bdev,
 /** Generic block IO abort request */
 int vmm_blockdev_abort_request(struct vmm_request *r);
 
+/** Plug request queue of block device
+ *  Note: Requests submitted while plugged are only dispatched to
+ *  request queue upon last vmm_blockdev_unplug(). Plugging nests.
+ */
+int vmm_blockdev_plug(struct vmm_blockdev *bdev);
+
+/** Unplug request queue of block device */
+int vmm_blockdev_unplug(struct vmm_blockdev *bdev);
+
 /** Generic block IO flush cached data 
  *  Note: block device request queue might cache blocks for 
  *  better performance. This API is a hint to request queue
@@ -189,6 +269,20 @@ u64 vmm_blockdev_rw(struct vmm_blockdev *bdev,
 #define vmm_blockdev_write(bdev, src, off, len) \
 	vmm_blockdev_rw((bdev), VMM_REQUEST_WRITE, (src), (off), (len))
 
+/** Get host physical address of given byte range of block device
+ *  Note: Returns VMM_ENOTAVAIL if blocks of block device are not
+ *  directly addressable host memory. The byte range is contiguous
+ *  in host physical address space upon success.
+ */
+int vmm_blockdev_direct_access(struct vmm_blockdev *bdev,
+			       u64 off, u64 len, physical_addr_t *pa);
+
+/** Asynchronously read blocks covering given byte range into page cache
+ *  Note: This is a hint which returns VMM_ENOTAVAIL if page cache
+ *  is not enabled for block device (see block/vmm_blockcache.h)
+ */
+int vmm_blockdev_readahead(struct vmm_blockdev *bdev, u64 off, u64 len);
+
 /** Allocate block device */
 struct vmm_blockdev *vmm_blockdev_alloc(void);
 
@@ -49,7 +49,9 @@ struct vmm_blockrq_nop {
 	struct dlist wq_free_list;
 	struct dlist wq_pending_list;
 
-	struct vmm_workqueue *wq;
+	u32 wq_count;
+	struct vmm_workqueue **wq;
+	u32 *wq_hcpu;
 
 	struct vmm_request_queue rq;
 };
@@ -73,14 +75,34 @@ static inline struct vmm_request_queue *vmm_blockrq_nop_to_rq(
  */
 int vmm_blockrq_nop_destroy(struct vmm_blockrq_nop *rqnop);
 
+/** Create NOP strategy based request queue with multiple workers
+ *  Note: Each worker thread is bound to one online host CPU and
+ *  requests are processed by worker of submitting host CPU. With
+ *  more than one worker, requests complete out-of-order and their
+ *  completed()/failed() callbacks are called on submitting host CPU.
+ *  Note: read() and write() callbacks must be re-entrant if
+ *  worker_count is more than one.
+ *  Note: This function should be called from Orphan (or Thread) context.
+ */
+struct vmm_blockrq_nop *vmm_blockrq_nop_create_mt(
+	const char *name, u32 max_pending, u32 worker_count,
+	int (*read)(struct vmm_blockrq_nop *,struct vmm_request *, void *),
+	int (*write)(struct vmm_blockrq_nop *,struct vmm_request *, void *),
+	void (*flush)(struct vmm_blockrq_nop *,void *),
+	void *priv);
+
 /** Create NOP strategy based request queue
  *  Note: This function should be called from Orphan (or Thread) context.
  */
-struct vmm_blockrq_nop *vmm_blockrq_nop_create(
+static inline struct vmm_blockrq_nop *vmm_blockrq_nop_create(
 	const char *name, u32 max_pending,
 	int (*read)(struct vmm_blockrq_nop *,struct vmm_request *, void *),
 	int (*write)(struct vmm_blockrq_nop *,struct vmm_request *, void *),
 	void (*flush)(struct vmm_blockrq_nop *,void *),
-	void *priv);
+	void *priv)
+{
+	return vmm_blockrq_nop_create_mt(name, max_pending, 1,
+					 read, write, flush, priv);
+}
 
 #endif
@@ -91,13 +91,14 @@
 #include <vmm_macros.h>
 #include <vmm_stdio.h>
 #include <vmm_heap.h>
+#include <arch_atomic.h>
 #include <libs/list.h>
 
 struct vmm_mbuf;
 
 /* header at beginning of each mbuf: */
 struct m_hdr {
-	u32 mh_refcnt;
+	atomic_t mh_refcnt;		/* reference count */
 	struct vmm_mbuf *mh_next;	/* next buffer in chain */
 	char *mh_data;			/* location of data */
 	void (*mh_freefn)(struct vmm_mbuf *);
@@ -111,10 +112,24 @@ struct m_hdr {
  */
 struct m_pkthdr {
 	int	len;			/* total packet length */
+	u16	csum_start;		/* checksumming starts here */
+	u16	csum_offset;		/* checksum offset from csum_start */
+	u16	gso_size;		/* segment payload size */
+	u8	gso_type;		/* segmentation type; see below */
+	u8	csum_flags;		/* checksum state; see below */
 };
 
+/* m_pkthdr csum_flags */
+#define M_CSUM_PARTIAL	0x01	/* checksum from csum_start to be filled */
+#define M_CSUM_VALID	0x02	/* checksum already verified */
+
+/* m_pkthdr gso_type */
+#define M_GSO_NONE	0
+#define M_GSO_TCPV4	1
+#define M_GSO_TCPV6	2
+
 struct m_ext {
-	u32 ext_refcnt;			/* reference count */
+	atomic_t ext_refcnt;		/* reference count */
 	char *ext_buf;			/* start of buffer */
 	u32 ext_size;			/* size of buffer, for ext_free */
 	void (*ext_free)		/* free routine if not the usual */
@@ -178,7 +193,7 @@ struct vmm_mbuf {
 #define	MGET(m, how, flags)	m = m_get((how), (flags))
 #define	MGETHDR(m, how, flags)	m = m_get((how), (flags | M_PKTHDR))
 
-#define	MCLINITREFERENCE(m)	m->m_ext.ext_refcnt = 1
+#define	MCLINITREFERENCE(m)	arch_atomic_write(&(m)->m_ext.ext_refcnt, 1)
 
 /*
  * Macros for mbuf external storage.
@@ -227,8 +242,12 @@ do {									\
 	m_ext_free(m);							\
 } while (/* CONSTCOND */ 0)
 
-#define MCLADDREFERENCE(o)		o->m_extref++
-#define MADDREFERENCE(o)		o->m_ref++
+/*
+ * Reference counts are atomic because mbufs (and their external
+ * storage) can be released by different threads at the same time.
+ */
+#define MCLADDREFERENCE(o)		arch_atomic_add(&(o)->m_extref, 1)
+#define MADDREFERENCE(o)		arch_atomic_add(&(o)->m_ref, 1)
 
 /*
  * Determine if an mbuf's data area is read-only.  This is true
@@ -237,7 +256,7 @@ do {									\
  */
 #define	M_READONLY(m)							\
 	  (((m)->m_flags & (M_EXT_ROMAP|M_EXT_RW)) != M_EXT_RW ||	\
-	  ((m)->m_extref > 1))
+	  (arch_atomic_read(&(m)->m_extref) > 1))
 
 #define	M_UNWRITABLE(__m, __len)					\
 	((__m)->m_len < (__len) || M_READONLY((__m)))
@@ -291,6 +310,29 @@ void m_freem(struct vmm_mbuf *m);
 void m_ext_free(struct vmm_mbuf *m);
 void m_dump(struct vmm_mbuf *m);
 
+/*
+ * mbuf pool statistics.
+ */
+#define VMM_MBUF_EXT_SLAB_COUNT		7
+
+struct vmm_mbufpool_slab_stats {
+	u32 buf_size;
+	u32 buf_count;
+	u32 buf_free;
+	u64 allocs;
+	u64 cache_hits;
+	u64 pool_misses;
+};
+
+struct vmm_mbufpool_stats {
+	struct vmm_mbufpool_slab_stats mbuf;
+	struct vmm_mbufpool_slab_stats ext[VMM_MBUF_EXT_SLAB_COUNT];
+	u64 ext_heap_allocs;
+	u64 ext_dma_allocs;
+};
+
+int vmm_mbufpool_get_stats(struct vmm_mbufpool_stats *stats);
+
 /*
  * mbuf pool initializaton and exit.
  */
@@ -0,0 +1,136 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_netcapture.h
+ * @author agent (agent@local)
+ * @brief Per-port packet capture ring interface
+ *
+ * Capture is started at runtime for a netport and records first few
+ * bytes (snaplen) of each packet with a timestamp into a fixed size
+ * ring of slots. Writers never take locks and when capture is not
+ * running the only cost is a NULL check on the netport. The ring is
+ * read back as a pcap stream.
+ */
+
+#ifndef __VMM_NETCAPTURE_H_
+#define __VMM_NETCAPTURE_H_
+
+#include <vmm_types.h>
+#include <vmm_error.h>
+#include <vmm_compiler.h>
+#include <net/vmm_netport.h>
+
+/** Capture directions (should be defined as bits) */
+#define VMM_NETCAPTURE_DIR_IN		0x1	/* Port to switch */
+#define VMM_NETCAPTURE_DIR_OUT		0x2	/* Switch to port */
+#define VMM_NETCAPTURE_DIR_BOTH		(VMM_NETCAPTURE_DIR_IN | \
+					 VMM_NETCAPTURE_DIR_OUT)
+
+/** Default capture parameters */
+#define VMM_NETCAPTURE_DEF_SNAPLEN	128
+#define VMM_NETCAPTURE_MAX_SNAPLEN	2048
+#define VMM_NETCAPTURE_DEF_COUNT	1024
+#define VMM_NETCAPTURE_MAX_COUNT	65536
+
+/** Capture statistics */
+struct vmm_netcapture_stats {
+	u32 snaplen;
+	u32 count;
+	u32 dirs;
+	u64 packets;		/* Packets recorded since start */
+	u64 overwritten;	/* Packets lost due to ring wrap-around */
+};
+
+struct vmm_mbuf;
+struct vmm_netcapture;
+
+#if defined(CONFIG_NET_CAPTURE)
+
+/** Start packet capture on netport
+ *  @snaplen max bytes recorded per packet (0 means default)
+ *  @count number of ring slots, rounded up to power of 2 (0 means default)
+ *  @dirs mask of VMM_NETCAPTURE_DIR_xxx
+ *  Note: This function should be called from Orphan (or Thread) context.
+ */
+int vmm_netcapture_start(struct vmm_netport *port,
+			 u32 snaplen, u32 count, u32 dirs);
+
+/** Stop packet capture on netport and free capture ring
+ *  Note: This function should be called from Orphan (or Thread) context.
+ */
+int vmm_netcapture_stop(struct vmm_netport *port);
+
+/** Retrive capture statistics of netport */
+int vmm_netcapture_get_stats(struct vmm_netport *port,
+			     struct vmm_netcapture_stats *stats);
+
+/** Read capture ring of netport as pcap stream
+ *  The write() callback is called for pcap file header followed by
+ *  each recorded packet (oldest first) and must return number of
+ *  bytes consumed. Capture continues while the ring is being read.
+ *  Note: This function should be called from Orphan (or Thread) context.
+ */
+int vmm_netcapture_read(struct vmm_netport *port, void *priv,
+			size_t (*write)(void *priv, void *buf, size_t len));
+
+/** Record packet into capture ring (internal, use vmm_netcapture_record) */
+void __vmm_netcapture_record(struct vmm_netport *port,
+			     struct vmm_mbuf *mbuf, u32 dir);
+
+/** Record packet if capture is running on netport */
+static inline void vmm_netcapture_record(struct vmm_netport *port,
+					 struct vmm_mbuf *mbuf, u32 dir)
+{
+	if (unlikely(port->capture)) {
+		__vmm_netcapture_record(port, mbuf, dir);
+	}
+}
+
+#else
+
+static inline int vmm_netcapture_start(struct vmm_netport *port,
+					u32 snaplen, u32 count, u32 dirs)
+{
+	return VMM_ENOTSUPP;
+}
+
+static inline int vmm_netcapture_stop(struct vmm_netport *port)
+{
+	return VMM_ENOTSUPP;
+}
+
+static inline int vmm_netcapture_get_stats(struct vmm_netport *port,
+					struct vmm_netcapture_stats *stats)
+{
+	return VMM_ENOTSUPP;
+}
+
+static inline int vmm_netcapture_read(struct vmm_netport *port, void *priv,
+			size_t (*write)(void *priv, void *buf, size_t len))
+{
+	return VMM_ENOTSUPP;
+}
+
+static inline void vmm_netcapture_record(struct vmm_netport *port,
+					 struct vmm_mbuf *mbuf, u32 dir)
+{
+}
+
+#endif
+
+#endif /* __VMM_NETCAPTURE_H_ */
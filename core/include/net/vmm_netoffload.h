@@ -0,0 +1,43 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_netoffload.h
+ * @author agent (agent@local)
+ * @brief Software fallback for checksum and segmentation offloads.
+ */
+
+#ifndef __VMM_NETOFFLOAD_H_
+#define __VMM_NETOFFLOAD_H_
+
+#include <vmm_types.h>
+
+struct vmm_netport;
+struct vmm_mbuf;
+
+/** Check whether mbuf needs offloads which destination port lacks */
+bool vmm_netoffload_required(struct vmm_netport *dst,
+			     struct vmm_mbuf *mbuf);
+
+/** Compute checksum and/or segment mbuf in software and pass
+ *  resulting packets to switch2port_xfer() of destination port.
+ *  Note: The original mbuf is not modified and not consumed.
+ *  Note: Must be called with switch2port_xfer_lock of port held.
+ */
+int vmm_netoffload_xfer(struct vmm_netport *dst, struct vmm_mbuf *mbuf);
+
+#endif /* __VMM_NETOFFLOAD_H_ */
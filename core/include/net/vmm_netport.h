@@ -28,12 +28,17 @@
 #include <vmm_types.h>
 #include <vmm_devdrv.h>
 #include <vmm_spinlocks.h>
+#include <vmm_devtree.h>
+#include <vmm_percpu.h>
 #include <libs/list.h>
 
 #define VMM_NETPORT_CLASS_NAME		"netport"
 
 /* Port Flags (should be defined as bits) */
 #define VMM_NETPORT_LINK_UP		1	/* If this bit is set link is up */
+#define VMM_NETPORT_OFFLOAD_CSUM	2	/* Port takes partial checksum */
+#define VMM_NETPORT_OFFLOAD_TSO4	4	/* Port takes TCPv4 GSO packets */
+#define VMM_NETPORT_OFFLOAD_TSO6	8	/* Port takes TCPv6 GSO packets */
 
 /* Default per-port queue size */
 #define VMM_NETPORT_MAX_QUEUE_SIZE	256
@@ -41,9 +46,17 @@
 /* Default per-port queue size */
 #define VMM_NETPORT_DEF_QUEUE_SIZE	(VMM_NETPORT_MAX_QUEUE_SIZE / 4)
 
+/* Port priorities used by netswitch bottom-half (0 is highest)
+ * Priority 0 is served strictly before others whereas remaining
+ * priorities are served in weighted round-robin fashion.
+ */
+#define VMM_NETPORT_PRIO_COUNT		4
+#define VMM_NETPORT_DEF_PRIO		2
+
 struct vmm_netswitch;
 struct vmm_netport;
 struct vmm_mbuf;
+struct vmm_netcapture;
 
 enum vmm_netport_xfer_type {
 	VMM_NETPORT_XFER_UNKNOWN,
@@ -80,6 +93,22 @@ struct vmm_netport {
 	vmm_spinlock_t free_list_lock;
 	struct vmm_netport_xfer xfer_pool[VMM_NETPORT_MAX_QUEUE_SIZE];
 
+	/* Ingress (port to switch) QoS
+	 * Rate is limited using token bucket when qos_rate is non-zero.
+	 */
+	u32 qos_prio;
+	u64 qos_rate;			/* bytes per second */
+	u64 qos_burst;			/* bytes */
+	u64 qos_tokens;
+	u64 qos_tstamp;
+	vmm_spinlock_t qos_lock;
+	struct vmm_percpu_counter stat_ingress_pkts;
+	struct vmm_percpu_counter stat_ingress_bytes;
+	struct vmm_percpu_counter stat_ingress_drops;
+
+	/* Packet capture ring (NULL when capture is not running) */
+	struct vmm_netcapture *capture;
+
 	/* Link status changed */
 	void (*link_changed) (struct vmm_netport *);
 	/* Callback to determine if the port can RX */
@@ -100,6 +129,25 @@ struct vmm_netport_xfer *vmm_netport_alloc_xfer(struct vmm_netport *port);
 void vmm_netport_free_xfer(struct vmm_netport *port,
 			   struct vmm_netport_xfer *xfer);
 
+/** Configure ingress QoS of netport
+ *  @prio priority (0 to VMM_NETPORT_PRIO_COUNT - 1, 0 is highest)
+ *  @rate_kbps rate limit in kilobits per second (0 means unlimited)
+ *  @burst_kb token bucket size in kilobytes (0 means rate per 10ms)
+ */
+int vmm_netport_qos_set(struct vmm_netport *port, u32 prio,
+			u32 rate_kbps, u32 burst_kb);
+
+/** Configure ingress QoS of netport using device tree node attributes
+ *  "qos_priority", "qos_rate_kbps" and "qos_burst_kb" (all optional)
+ */
+int vmm_netport_qos_setup(struct vmm_netport *port,
+			  struct vmm_devtree_node *node);
+
+/** Account packet going from netport to switch
+ *  Returns FALSE if packet exceeds rate limit and must be dropped.
+ */
+bool vmm_netport_qos_admit(struct vmm_netport *port, u32 len);
+
 /** Allocate new netport */
 struct vmm_netport *vmm_netport_alloc(char *name, u32 queue_size);
 
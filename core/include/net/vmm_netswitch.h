@@ -36,6 +36,7 @@
 struct vmm_netswitch;
 struct vmm_netport;
 struct vmm_mbuf;
+struct vmm_chardev;
 
 struct vmm_netswitch {
 	char name[VMM_FIELD_NAME_SIZE];
@@ -55,6 +56,9 @@ struct vmm_netswitch {
 	/* Handle disabling of a port */
 	int (*port_remove) (struct vmm_netswitch *,
 			    struct vmm_netport *);
+	/* Print switch specific info and stats (optional) */
+	void (*show) (struct vmm_netswitch *,
+		      struct vmm_chardev *);
 	/* Switch private data */
 	void *priv;
 };
@@ -63,11 +67,30 @@ struct vmm_netswitch {
 int vmm_port2switch_xfer_mbuf(struct vmm_netport *src,
 			      struct vmm_mbuf *mbuf);
 
+/** Transfer batch of packets (linked using m_list) from port to switch
+ *  Note: All packets are queued to bottom-half in one go and list is
+ *  empty upon return.
+ */
+int vmm_port2switch_xfer_mbuf_list(struct vmm_netport *src,
+				   struct dlist *mbufs);
+
 /** Lazy transfer from port to switch */
 int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
 			 void (*lazy_xfer)(struct vmm_netport *, void *, int),
 			 void *lazy_arg, int lazy_budget);
 
+/** Lazy transfer from port to switch using bottom-half of CPU
+ *  selected by hash (flow hash, queue number, etc)
+ */
+int vmm_port2switch_xfer_lazy_hash(struct vmm_netport *src, u32 hash,
+			 void (*lazy_xfer)(struct vmm_netport *, void *, int),
+			 void *lazy_arg, int lazy_budget);
+
+/** Compute flow hash of packet based on IPv4 addresses and ports
+ *  (or MAC addresses for non-IPv4 packets)
+ */
+u32 vmm_netswitch_flow_hash(struct vmm_mbuf *mbuf);
+
 /** Transfer packets from switch to port */
 int vmm_switch2port_xfer_mbuf(struct vmm_netswitch *nsw,
 			      struct vmm_netport *dst,
@@ -29,6 +29,8 @@
 #ifndef __VMM_PIXEL_OPS_H_
 #define __VMM_PIXEL_OPS_H_
 
+#include <vmm_types.h>
+
 static inline unsigned int rgb_to_pixel8(unsigned int r, unsigned int g,
 						unsigned int b)
 {
@@ -83,4 +85,24 @@ static inline unsigned int rgb_to_pixel32bgr(unsigned int r, unsigned int g,
 	return (b << 16) | (g << 8) | r;
 }
 
+/* Word at a time converters for line conversion fast paths. Input
+ * pixel is RGB565 with red in MSBs and output matches rgb_to_pixel32()
+ * or rgb_to_pixel32bgr() of the expanded components.
+ */
+static inline u32 rgb565_to_pixel32(u32 p)
+{
+	return ((p & 0xf800) << 8) | ((p & 0x07e0) << 5) | ((p & 0x001f) << 3);
+}
+
+static inline u32 rgb565_to_pixel32bgr(u32 p)
+{
+	return ((p & 0x001f) << 19) | ((p & 0x07e0) << 5) | ((p & 0xf800) >> 8);
+}
+
+/* Swap red and blue of 32bit pixel and clear upper byte */
+static inline u32 pixel32_swap_rb(u32 p)
+{
+	return ((p & 0xff) << 16) | (p & 0xff00) | ((p >> 16) & 0xff);
+}
+
 #endif /* __VMM_PIXEL_OPS_H_ */
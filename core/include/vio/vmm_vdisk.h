@@ -37,6 +37,11 @@
  * vmm_vdisk_submit_request() will automatically fill it. If
  * the emulators still need access to individual properties of
  * vmm_vdisk_request then they will have to use vmm_vdisk APIs.
+ *
+ * Each virtual disk has a private pool for bounce buffers which
+ * is preallocated at creation time based on the queue depth hence
+ * memory used by a virtual disk is known upfront and IO path does
+ * not allocate from the Normal heap.
  */
 
 #ifndef _VMM_VDISK_H__
@@ -80,6 +85,10 @@ struct vmm_vdisk {
 	vmm_spinlock_t blk_lock; /* Protect blk pointer */
 	struct vmm_blockdev *blk;
 	u32 blk_factor;
+	u32 plug_count;
+
+	u32 queue_depth;
+	struct vmm_arena *pool; /* Bounce buffers */
 
 	void *priv;
 };
@@ -177,13 +186,41 @@ int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
 			     enum vmm_vdisk_request_type type,
 			     u64 lba, void *data, u32 data_len);
 
+/** Submit IO request to virtual disk where data buffer is described
+ *  by scatter-gather list of host physical address ranges
+ */
+int vmm_vdisk_submit_request_sg(struct vmm_vdisk *vdisk,
+				struct vmm_vdisk_request *vreq,
+				enum vmm_vdisk_request_type type,
+				u64 lba, struct vmm_request_sg *sg,
+				u32 sg_count, u32 data_len);
+
 /* Abort IO request from virtual disk */
 int vmm_vdisk_abort_request(struct vmm_vdisk *vdisk,
 			    struct vmm_vdisk_request *vreq);
 
+/** Plug virtual disk so that submitted requests are batched
+ *  and merged until last vmm_vdisk_unplug()
+ */
+void vmm_vdisk_plug(struct vmm_vdisk *vdisk);
+
+/** Unplug virtual disk and dispatch batched requests */
+void vmm_vdisk_unplug(struct vmm_vdisk *vdisk);
+
 /** Flush cached IO from virtual disk */
 int vmm_vdisk_flush_cache(struct vmm_vdisk *vdisk);
 
+/** Allocate bounce buffer from private pool of virtual disk
+ *  (Note: Returns NULL when the pool is exhausted)
+ */
+void *vmm_vdisk_alloc_buf(struct vmm_vdisk *vdisk, u32 len);
+
+/** Check if given buffer belongs to private pool of virtual disk */
+bool vmm_vdisk_owns_buf(struct vmm_vdisk *vdisk, const void *buf);
+
+/** Free bounce buffer to private pool of virtual disk */
+void vmm_vdisk_free_buf(struct vmm_vdisk *vdisk, void *buf);
+
 /** Name of virtual disk */
 static inline const char *vmm_vdisk_name(struct vmm_vdisk *vdisk)
 {
@@ -210,8 +247,12 @@ void vmm_vdisk_attach_block_device(struct vmm_vdisk *vdisk,
 /** Detach block device from virtual disk */
 void vmm_vdisk_detach_block_device(struct vmm_vdisk *vdisk);
 
-/** Create a virtual disk */
+/** Create a virtual disk with bounce buffer pool sized for
+ *  queue_depth outstanding requests (Note: queue_depth can be
+ *  zero if bounce buffers are not required)
+ */
 struct vmm_vdisk *vmm_vdisk_create(const char *name, u32 block_size,
+	u32 queue_depth,
 	void (*attached)(struct vmm_vdisk *),
 	void (*detached)(struct vmm_vdisk *),
 	void (*completed)(struct vmm_vdisk *, struct vmm_vdisk_request *),
@@ -97,8 +97,8 @@ struct vmm_surface_ops {
 	u8   (*read8)(struct vmm_surface *s, u8 *src);
 	void (*write16)(struct vmm_surface *s, u16 *dst, u16 val);
 	u16  (*read16)(struct vmm_surface *s, u16 *src);
-	void (*write32)(struct vmm_surface *s, u32 *dst, u16 val);
-	u16  (*read32)(struct vmm_surface *s, u32 *src);
+	void (*write32)(struct vmm_surface *s, u32 *dst, u32 val);
+	u32  (*read32)(struct vmm_surface *s, u32 *src);
 
 	void (*refresh)(struct vmm_surface *s);
 
@@ -184,7 +184,7 @@ static inline u16 vmm_surface_read16(struct vmm_surface *s, u16 *src)
 }
 
 /** Write 32bit to surface data */
-static inline void vmm_surface_write32(struct vmm_surface *s, u32 *dst, u16 v)
+static inline void vmm_surface_write32(struct vmm_surface *s, u32 *dst, u32 v)
 {
 	if (s && s->ops && s->ops->write32) {
 		s->ops->write32(s, dst, v);
@@ -203,6 +203,15 @@ static inline u32 vmm_surface_read32(struct vmm_surface *s, u32 *src)
 	}
 }
 
+/** Check whether surface data can be written directly
+ *  (i.e. surface has no write callbacks)
+ */
+static inline bool vmm_surface_direct_write(struct vmm_surface *s)
+{
+	return (s && (!s->ops || (!s->ops->write8 && !s->ops->write16 &&
+				  !s->ops->write32))) ? TRUE : FALSE;
+}
+
 /** Update surface data from guest memory */
 void vmm_surface_update(struct vmm_surface *s,
 			struct vmm_guest *guest,
@@ -219,6 +228,28 @@ void vmm_surface_update(struct vmm_surface *s,
 			int *first_row, /* Input and output. */
 			int *last_row); /* Output only. */
 
+/** Update surface data from guest memory only for rows overlapping
+ *  dirty source pages. Bit N of dirty bitmap represents Nth page
+ *  starting from the page containing gphys. The first and last
+ *  updated rows are returned via first_row and last_row whereas
+ *  first_row is set to -1 when no row is updated.
+ */
+void vmm_surface_update_dirty(struct vmm_surface *s,
+			      struct vmm_guest *guest,
+			      physical_addr_t gphys,
+			      int cols,
+			      int rows,
+			      int src_width,
+			      int dest_row_pitch,
+			      int dest_col_pitch,
+			      void (*fn)(struct vmm_surface *s,
+					 void *priv, u8 *dst, const u8 *src,
+					 int width, int deststep),
+			      void *fn_priv,
+			      const unsigned long *dirty,
+			      int *first_row, /* Input and output. */
+			      int *last_row); /* Output only. */
+
 /** Initialize a surface */
 int vmm_surface_init(struct vmm_surface *s,
 		     const char *name,
@@ -75,6 +75,7 @@ struct vmm_vkeyboard {
 	int ledstate;
 	struct dlist led_handler_list;
 	void (*kbd_event) (struct vmm_vkeyboard *vkbd, int keycode);
+	void (*kbd_sync) (struct vmm_vkeyboard *vkbd);
 	void *priv;
 };
 
@@ -92,7 +93,22 @@ static inline void *vmm_vkeyboard_priv(struct vmm_vkeyboard *vkbd)
 	return (vkbd) ? vkbd->priv : NULL;
 }
 
-/** Trigger virtual keyboard event */
+/** Set report sync callback of virtual keyboard
+ *  Note: An emulator having sync callback can update its state for
+ *  each reported event and inject guest interrupt only upon sync.
+ */
+void vmm_vkeyboard_set_sync(struct vmm_vkeyboard *vkbd,
+			    void (*kbd_sync) (struct vmm_vkeyboard *));
+
+/** Report virtual keyboard event without ending the report
+ *  Note: vmm_vkeyboard_sync() must be called after last event.
+ */
+int vmm_vkeyboard_report(struct vmm_vkeyboard *vkbd, int keycode);
+
+/** End current report of virtual keyboard events */
+int vmm_vkeyboard_sync(struct vmm_vkeyboard *vkbd);
+
+/** Trigger virtual keyboard event (i.e. report followed by sync) */
 int vmm_vkeyboard_event(struct vmm_vkeyboard *vkbd, int keycode);
 
 /** Add led handler to a virtual keyboard */
@@ -136,6 +152,7 @@ struct vmm_vmouse {
 	u32 graphics_rotation;
 	void (*mouse_event) (struct vmm_vmouse *vmou, 
 			   int dx, int dy, int dz, int buttons_state);
+	void (*mouse_sync) (struct vmm_vmouse *vmou);
 	void *priv;
 };
 
@@ -157,7 +174,23 @@ static inline void *vmm_vmouse_priv(struct vmm_vmouse *vmou)
 	return (vmou) ? vmou->priv : NULL;
 }
 
-/** Trigger virtual mouse event */
+/** Set report sync callback of virtual mouse
+ *  Note: An emulator having sync callback can update its state for
+ *  each reported event and inject guest interrupt only upon sync.
+ */
+void vmm_vmouse_set_sync(struct vmm_vmouse *vmou,
+			 void (*mouse_sync) (struct vmm_vmouse *));
+
+/** Report virtual mouse event without ending the report
+ *  Note: vmm_vmouse_sync() must be called after last event.
+ */
+int vmm_vmouse_report(struct vmm_vmouse *vmou,
+		      int dx, int dy, int dz, int buttons_state);
+
+/** End current report of virtual mouse events */
+int vmm_vmouse_sync(struct vmm_vmouse *vmou);
+
+/** Trigger virtual mouse event (i.e. report followed by sync) */
 int vmm_vmouse_event(struct vmm_vmouse *vmou,
 		     int dx, int dy, int dz, int buttons_state);
 
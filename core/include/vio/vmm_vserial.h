@@ -37,10 +37,13 @@ struct vmm_vserial;
 /** Representation of a virtual serial port recevier 
  *  Note: receive callback can be called in any context hence
  *  hence we cannot sleep in receive callback.
+ *  Note: Only one of recv or recv_buf is set.
  */
 struct vmm_vserial_receiver {
 	struct dlist head;
 	void (*recv) (struct vmm_vserial *vser, void *priv, u8 data);
+	void (*recv_buf) (struct vmm_vserial *vser, void *priv,
+			  u8 *buf, u32 len);
 	void *priv;
 };
 
@@ -51,6 +54,8 @@ struct vmm_vserial {
 
 	bool (*can_send) (struct vmm_vserial *vser);
 	int (*send) (struct vmm_vserial *vser, u8 data);
+	/* Optional: Send upto len bytes and return bytes sent */
+	u32 (*send_buf) (struct vmm_vserial *vser, u8 *src, u32 len);
 
 	vmm_spinlock_t receiver_list_lock;
 	struct dlist receiver_list;
@@ -95,10 +100,25 @@ int vmm_vserial_register_receiver(struct vmm_vserial *vser,
 int vmm_vserial_unregister_receiver(struct vmm_vserial *vser,
 		void (*recv) (struct vmm_vserial *, void *, u8), void *priv);
 
-/** Create a virtual serial port */
+/** Register buffer receiver to a virtual serial port */
+int vmm_vserial_register_receiver_buf(struct vmm_vserial *vser,
+		void (*recv_buf) (struct vmm_vserial *, void *, u8 *, u32),
+		void *priv);
+
+/** Unregister buffer receiver of a virtual serial port */
+int vmm_vserial_unregister_receiver_buf(struct vmm_vserial *vser,
+		void (*recv_buf) (struct vmm_vserial *, void *, u8 *, u32),
+		void *priv);
+
+/** Create a virtual serial port
+ *  Note: send_buf is optional and when available it is used
+ *  instead of can_send and send for sending bytes.
+ */
 struct vmm_vserial *vmm_vserial_create(const char *name,
 				       bool (*can_send) (struct vmm_vserial *),
 				       int (*send) (struct vmm_vserial *, u8),
+				       u32 (*send_buf) (struct vmm_vserial *,
+							u8 *, u32),
 				       u32 receive_fifo_size, void *priv);
 
 /** Destroy a virtual serial port */
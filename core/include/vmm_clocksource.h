@@ -24,9 +24,15 @@
 #define _VMM_CLOCKSOURCE_H__
 
 #include <vmm_types.h>
+#include <vmm_compiler.h>
 #include <vmm_devtree.h>
+#include <arch_config.h>
+#include <arch_barrier.h>
 #include <libs/mathlib.h>
 #include <libs/list.h>
+#if defined(ARCH_HAS_CLOCKSOURCE_FAST_READ)
+#include <arch_clocksource.h>
+#endif
 
 struct vmm_clocksource;
 
@@ -59,6 +65,8 @@ struct vmm_clocksource;
  *			subtraction of non 64 bit counters
  * @mult:		cycle to nanosecond multiplier
  * @shift:		cycle to nanosecond divisor (power of two)
+ * @arch_read:		read() returns same value as inline
+ *			arch_clocksource_fast_read()
  * @suspend:		suspend function for the clocksource, if necessary
  * @resume:		resume function for the clocksource, if necessary
  */
@@ -69,6 +77,7 @@ struct vmm_clocksource {
 	u64 mask;
 	u32 mult;
 	u32 shift;
+	bool arch_read;
 	u64 (*read) (struct vmm_clocksource *cs);
 	int (*enable) (struct vmm_clocksource *cs);
 	void (*disable) (struct vmm_clocksource *cs);
@@ -97,15 +106,35 @@ VMM_DEVTREE_NIDTBL_ENTRY(name, "clocksource", "", "", compat, fn)
  * than the clocksource wraps around. The nanosecond counter will only 
  * wrap around after ~585 years.
  *
+ * Only vmm_timecounter_read() updates the nanosecond counter and it
+ * must be called by one CPU with interrupts disabled. Other readers
+ * can use vmm_timecounter_read_lockless() from any context which
+ * retries when it races with an update (seqcount) and fails when
+ * the counter was not updated for too long.
+ *
  * @cs:			the cycle counter used by this instance
+ * @seq:		sequence count (odd while update in-progress)
  * @cycles_last:	most recent cycle counter value seen by
  *			vmm_timecounter_read()
  * @nsec:		continuously increasing count
+ * @frac:		sub-nanosecond remainder of nsec (scaled by shift)
+ * @mask:		copy of cs->mask
+ * @mult:		copy of cs->mult
+ * @shift:		copy of cs->shift
+ * @max_delta:		maximum cycles for lockless read without overflow
+ * @read:		copy of cs->read
  */
 struct vmm_timecounter {
 	struct vmm_clocksource *cs;
+	u32 seq;
 	u64 cycles_last;
 	u64 nsec;
+	u64 frac;
+	u64 mask;
+	u32 mult;
+	u32 shift;
+	u64 max_delta;
+	u64 (*read) (struct vmm_clocksource *cs);
 };
 
 /** Convert kHz clocksource to clocksource mult */
@@ -130,10 +159,55 @@ static inline u32 vmm_clocksource_hz2mult(u32 hz, u32 shift)
 #define vmm_clocksource_delta2nsecs(cycles, mult, shift) \
 		(((cycles) * (mult)) >> (shift)) 
 
+/** Read cycle counter of timecounter */
+static inline u64 vmm_timecounter_cycles(struct vmm_timecounter *tc)
+{
+#if defined(ARCH_HAS_CLOCKSOURCE_FAST_READ)
+	if (likely(tc->cs->arch_read)) {
+		return arch_clocksource_fast_read();
+	}
+#endif
+	return tc->read(tc->cs);
+}
+
+/** Get current value from nanosecond counter without updating it.
+ *  Returns FALSE when vmm_timecounter_read() must be used instead.
+ */
+static inline bool vmm_timecounter_read_lockless(struct vmm_timecounter *tc,
+						 u64 *nsec)
+{
+	u32 seq;
+	u64 cycles_last, ns, frac, delta;
+
+	if (unlikely(!tc->cs)) {
+		*nsec = 0;
+		return TRUE;
+	}
+
+	do {
+		seq = *(volatile u32 *)&tc->seq;
+		arch_smp_rmb();
+		cycles_last = tc->cycles_last;
+		ns = tc->nsec;
+		frac = tc->frac;
+		arch_smp_rmb();
+	} while ((seq & 1) || (seq != *(volatile u32 *)&tc->seq));
+
+	delta = (vmm_timecounter_cycles(tc) - cycles_last) & tc->mask;
+	if (unlikely(tc->max_delta < delta)) {
+		return FALSE;
+	}
+
+	*nsec = ns + ((delta * tc->mult + frac) >> tc->shift);
+
+	return TRUE;
+}
+
 /** Get current value from nanosecond counter (nanoseconds elapsed) */
 u64 vmm_timecounter_read(struct vmm_timecounter *tc);
 
-#if defined(CONFIG_PROFILE)
+#if defined(CONFIG_PROFILE) || defined(CONFIG_HOST_IRQ_STATS) || \
+    defined(CONFIG_VCPU_EXIT_STATS) || defined(CONFIG_LOCKSTAT)
 /** Special version for profile */
 u64 vmm_timecounter_read_for_profile(struct vmm_timecounter *tc);
 #endif
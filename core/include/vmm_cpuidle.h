@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_cpuidle.h
+ * @author agent (agent@local)
+ * @brief Host CPU idle states interface
+ *
+ * A cpuidle driver (usually from board or arch code) registers idle
+ * states of host CPUs ordered from shallowest to deepest. The idle
+ * VCPU of each host CPU enters deepest idle state whose target
+ * residency fits in the time left till next timer event and whose
+ * exit latency is tolerated by VCPUs waiting on that host CPU.
+ */
+
+#ifndef __VMM_CPUIDLE_H__
+#define __VMM_CPUIDLE_H__
+
+#include <vmm_types.h>
+#include <arch_cpu_irq.h>
+
+#define VMM_CPUIDLE_MAX_STATES		8
+
+/** Host CPU idle state */
+struct vmm_cpuidle_state {
+	char name[16];
+	/* Time taken to wakeup from this idle state */
+	u64 exit_latency_ns;
+	/* Minimum time to stay in this idle state for it to be useful */
+	u64 target_residency_ns;
+	/* Enter this idle state on current host CPU and return after
+	 * wakeup (called with interrupts enabled like WFI)
+	 */
+	int (*enter)(struct vmm_cpuidle_state *state);
+	void *priv;
+};
+
+/** Host CPU idle driver */
+struct vmm_cpuidle_driver {
+	const char *name;
+	u32 state_count;
+	struct vmm_cpuidle_state states[VMM_CPUIDLE_MAX_STATES];
+};
+
+#ifdef CONFIG_CPUIDLE
+
+/** Enter suitable idle state on current host CPU
+ *  (Note: only for idle VCPU of scheduler)
+ */
+void vmm_cpuidle_enter(void);
+
+/** Mark that a VCPU waiting on given host CPU needs quick wakeup
+ *  hence deep idle states are not allowed on that host CPU
+ */
+void vmm_cpuidle_latency_get(u32 cpu);
+
+/** Release quick wakeup requirement taken by vmm_cpuidle_latency_get() */
+void vmm_cpuidle_latency_put(u32 cpu);
+
+/** Register cpuidle driver (only one driver is allowed) */
+int vmm_cpuidle_register_driver(struct vmm_cpuidle_driver *drv);
+
+/** Unregister cpuidle driver */
+int vmm_cpuidle_unregister_driver(struct vmm_cpuidle_driver *drv);
+
+/** Retrive current cpuidle driver */
+struct vmm_cpuidle_driver *vmm_cpuidle_get_driver(void);
+
+/** Retrive usage count and time spent in an idle state of host CPU */
+int vmm_cpuidle_get_stats(u32 cpu, u32 state, u64 *usage, u64 *time_ns);
+
+#else
+
+static inline void vmm_cpuidle_enter(void)
+{
+	arch_cpu_wait_for_irq();
+}
+
+static inline void vmm_cpuidle_latency_get(u32 cpu) { }
+static inline void vmm_cpuidle_latency_put(u32 cpu) { }
+
+#endif
+
+#endif /* __VMM_CPUIDLE_H__ */
@@ -199,6 +199,14 @@ extern const struct vmm_cpumask *const cpu_online_mask;
 extern const struct vmm_cpumask *const cpu_present_mask;
 extern const struct vmm_cpumask *const cpu_active_mask;
 
+/*
+ * Isolated CPUs (given by "isolcpus=" boot parameter) are dedicated
+ * to VCPUs explicitly pinned to them. Housekeeping CPUs are online
+ * CPUs which are not isolated and they run all hypervisor threads.
+ */
+extern const struct vmm_cpumask *const cpu_isolated_mask;
+extern const struct vmm_cpumask *const cpu_housekeeping_mask;
+
 #if CONFIG_CPU_COUNT > 1
 #define vmm_num_online_cpus()	vmm_cpumask_weight(cpu_online_mask)
 #define vmm_num_possible_cpus()	vmm_cpumask_weight(cpu_possible_mask)
@@ -208,6 +216,11 @@ extern const struct vmm_cpumask *const cpu_active_mask;
 #define vmm_cpu_possible(cpu)	vmm_cpumask_test_cpu((cpu), cpu_possible_mask)
 #define vmm_cpu_present(cpu)	vmm_cpumask_test_cpu((cpu), cpu_present_mask)
 #define vmm_cpu_active(cpu)	vmm_cpumask_test_cpu((cpu), cpu_active_mask)
+#define vmm_num_housekeeping_cpus()	\
+			vmm_cpumask_weight(cpu_housekeeping_mask)
+#define vmm_cpu_isolated(cpu)	vmm_cpumask_test_cpu((cpu), cpu_isolated_mask)
+#define vmm_cpu_housekeeping(cpu)	\
+			vmm_cpumask_test_cpu((cpu), cpu_housekeeping_mask)
 #else
 #define vmm_num_online_cpus()	1U
 #define vmm_num_possible_cpus()	1U
@@ -217,6 +230,9 @@ extern const struct vmm_cpumask *const cpu_active_mask;
 #define vmm_cpu_possible(cpu)	((cpu) == 0)
 #define vmm_cpu_present(cpu)	((cpu) == 0)
 #define vmm_cpu_active(cpu)	((cpu) == 0)
+#define vmm_num_housekeeping_cpus()	1U
+#define vmm_cpu_isolated(cpu)	0
+#define vmm_cpu_housekeeping(cpu)	((cpu) == 0)
 #endif
 
 /* verify cpu argument to vmm_cpumask_* operators */
@@ -631,12 +647,15 @@ extern const DECLARE_BITMAP(cpu_all_bits, CONFIG_CPU_COUNT);
 #define for_each_possible_cpu(cpu) for_each_cpu((cpu), cpu_possible_mask)
 #define for_each_online_cpu(cpu)   for_each_cpu((cpu), cpu_online_mask)
 #define for_each_present_cpu(cpu)  for_each_cpu((cpu), cpu_present_mask)
+#define for_each_housekeeping_cpu(cpu)	\
+			for_each_cpu((cpu), cpu_housekeeping_mask)
 
 /* Wrappers for arch boot code to manipulate normally-constant masks */
 void vmm_set_cpu_possible(unsigned int cpu, bool possible);
 void vmm_set_cpu_present(unsigned int cpu, bool present);
 void vmm_set_cpu_online(unsigned int cpu, bool online);
 void vmm_set_cpu_active(unsigned int cpu, bool active);
+void vmm_set_cpu_isolated(unsigned int cpu, bool isolated);
 void vmm_init_cpu_present(const struct vmm_cpumask *src);
 void vmm_init_cpu_possible(const struct vmm_cpumask *src);
 void vmm_init_cpu_online(const struct vmm_cpumask *src);
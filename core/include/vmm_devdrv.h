@@ -86,6 +86,7 @@ struct vmm_device {
 	vmm_spinlock_t devres_lock;
 	struct dlist devres_head;
 	struct dlist deferred_head;
+	bool async_probe_pending;
 	/* Public fields */
 	char name[VMM_FIELD_NAME_SIZE];
 	bool autoprobe_disabled;
@@ -109,6 +110,7 @@ struct vmm_driver {
 	char name[VMM_FIELD_NAME_SIZE];
 	struct vmm_bus *bus;
 	const struct vmm_devtree_nodeid *match_table;
+	bool async_probe;
 	int (*probe) (struct vmm_device *, const struct vmm_devtree_nodeid *);
 	int (*suspend) (struct vmm_device *, u32);
 	int (*resume) (struct vmm_device *);
@@ -160,6 +162,15 @@ int vmm_devdrv_pinctrl_bind(struct vmm_device *dev);
 /** Probe device instances under a given device tree node */
 int vmm_devdrv_probe(struct vmm_devtree_node *node);
 
+/** Wait for all pending asynchronous device probes to finish
+ *  Note: Drivers opt-in for asynchronous probing by setting
+ *  async_probe in struct vmm_driver. Such drivers must not rely
+ *  on probe order of other drivers and should return
+ *  VMM_EPROBE_DEFER when a required resource is not yet available.
+ *  Note: This can only be called from Orphan (or Thread) context
+ */
+void vmm_devdrv_async_probe_sync(void);
+
 /** Register class */
 int vmm_devdrv_register_class(struct vmm_class *cls);
 
@@ -27,9 +27,11 @@
 #include <vmm_spinlocks.h>
 #include <vmm_devtree.h>
 #include <vmm_manager.h>
+#include <vmm_snapshot.h>
 
 struct vmm_emudev;
 struct vmm_emulator;
+struct vmm_devemu_coalesce;
 
 enum vmm_devemu_endianness {
 	VMM_DEVEMU_UNKNOWN_ENDIAN=0,
@@ -39,6 +41,23 @@ enum vmm_devemu_endianness {
 	VMM_DEVEMU_MAX_ENDIAN=4,
 };
 
+/** Number of access sizes (1, 2, 4 and 8 bytes) */
+#define VMM_DEVEMU_MAX_ACCESS		4
+
+/** Max data FIFO register ranges of an emulated device */
+#define VMM_DEVEMU_MAX_FIFO_RANGES	2
+
+/** Pre-resolved access handlers where data is in guest endianness */
+typedef int (*vmm_devemu_read_t) (struct vmm_emudev *edev,
+				  physical_addr_t offset,
+				  void *dst);
+typedef int (*vmm_devemu_write_t) (struct vmm_emudev *edev,
+				   physical_addr_t offset,
+				   void *src);
+
+/** Doorbell handler of emulated device rung directly by guest hypercall */
+typedef int (*vmm_devemu_doorbell_t) (struct vmm_emudev *edev, u32 val);
+
 struct vmm_emulator {
 	struct dlist head;
 	char name[VMM_FIELD_NAME_SIZE];
@@ -49,6 +68,10 @@ struct vmm_emulator {
 		      const struct vmm_devtree_nodeid *nodeid);
 	int (*remove) (struct vmm_emudev *edev);
 	int (*reset) (struct vmm_emudev *edev);
+	int (*save) (struct vmm_emudev *edev,
+		     struct vmm_snapshot_state *st);
+	int (*restore) (struct vmm_emudev *edev,
+			struct vmm_snapshot_state *st);
 	int (*read8) (struct vmm_emudev *edev,
 		      physical_addr_t offset,
 		      u8 *dst);
@@ -129,6 +152,12 @@ struct vmm_emudev {
 	struct vmm_devtree_node *node;
 	struct vmm_region *reg;
 	struct vmm_emulator *emu;
+	struct vmm_devemu_coalesce *coalesce;
+	u32 fifo_count;
+	physical_addr_t fifo_start[VMM_DEVEMU_MAX_FIFO_RANGES];
+	physical_addr_t fifo_end[VMM_DEVEMU_MAX_FIFO_RANGES];
+	vmm_devemu_read_t read[VMM_DEVEMU_MAX_ACCESS][VMM_DEVEMU_MAX_ENDIAN];
+	vmm_devemu_write_t write[VMM_DEVEMU_MAX_ACCESS][VMM_DEVEMU_MAX_ENDIAN];
 	void *priv;
 #ifdef CONFIG_DEVEMU_DEBUG
 	u32 debug_info;
@@ -166,6 +195,108 @@ int vmm_devemu_emulate_iowrite(struct vmm_vcpu *vcpu,
 			       void *src, u32 src_len,
 			       enum vmm_devemu_endianness src_endian);
 
+/** Check whether given guest physical address is a data FIFO register
+ *  of emulated device (see vmm_devemu_add_fifo_range())
+ */
+bool vmm_devemu_is_fifo(struct vmm_vcpu *vcpu,
+			physical_addr_t gphys_addr, u32 len);
+
+/** Emulate count 32-bit reads from same data FIFO register for given VCPU
+ *  Note: This is for architectures which complete a burst of guest
+ *  accesses to data FIFO register in a single trap.
+ */
+int vmm_devemu_emulate_fifo_read(struct vmm_vcpu *vcpu,
+				 physical_addr_t gphys_addr,
+				 u32 *dst, u32 count,
+				 enum vmm_devemu_endianness dst_endian);
+
+/** Emulate count 32-bit writes to same data FIFO register for given VCPU
+ *  Note: This is for architectures which complete a burst of guest
+ *  accesses to data FIFO register in a single trap.
+ */
+int vmm_devemu_emulate_fifo_write(struct vmm_vcpu *vcpu,
+				  physical_addr_t gphys_addr,
+				  u32 *src, u32 count,
+				  enum vmm_devemu_endianness src_endian);
+
+/** Emulate IO read to given virtual IO region for given VCPU
+ *  Note: This is for architectures which resolve the IO region
+ *  on their own (e.g. using a port indexed table).
+ */
+int vmm_devemu_emulate_region_ioread(struct vmm_vcpu *vcpu,
+				     struct vmm_region *reg,
+				     physical_addr_t gphys_addr,
+				     void *dst, u32 dst_len,
+				     enum vmm_devemu_endianness dst_endian);
+
+/** Emulate IO write to given virtual IO region for given VCPU
+ *  Note: This is for architectures which resolve the IO region
+ *  on their own (e.g. using a port indexed table).
+ */
+int vmm_devemu_emulate_region_iowrite(struct vmm_vcpu *vcpu,
+				      struct vmm_region *reg,
+				      physical_addr_t gphys_addr,
+				      void *src, u32 src_len,
+				      enum vmm_devemu_endianness src_endian);
+
+/** Override pre-resolved read handler of emulated device for given
+ *  access length and guest endianness
+ *  Note: This should be called from emulator probe().
+ */
+int vmm_devemu_set_read_handler(struct vmm_emudev *edev, u32 len,
+				enum vmm_devemu_endianness endian,
+				vmm_devemu_read_t handler);
+
+/** Override pre-resolved write handler of emulated device for given
+ *  access length and guest endianness
+ *  Note: This should be called from emulator probe().
+ */
+int vmm_devemu_set_write_handler(struct vmm_emudev *edev, u32 len,
+				 enum vmm_devemu_endianness endian,
+				 vmm_devemu_write_t handler);
+
+/** Mark register range of emulated device as coalescible
+ *  Note: Writes to coalescible range are buffered and replayed in-order
+ *  to the emulator later hence it should only be used for write-only
+ *  registers whose side effects can be deferred (e.g. doorbells).
+ *  Note: Buffered writes are always replayed before any other read or
+ *  write to the emulated device.
+ *  Note: This should be called from emulator probe().
+ */
+int vmm_devemu_add_coalesce_range(struct vmm_emudev *edev,
+				  physical_addr_t offset,
+				  physical_size_t size);
+
+/** Mark register range of emulated device as data FIFO
+ *  Note: Guests stream packet data through data FIFO registers one
+ *  access at a time so architecture code may complete consecutive
+ *  guest accesses to the same data FIFO register in a single trap.
+ *  The accesses are still passed to the emulator one by one in-order.
+ *  Note: This should be called from emulator probe().
+ */
+int vmm_devemu_add_fifo_range(struct vmm_emudev *edev,
+			      physical_addr_t offset,
+			      physical_size_t size);
+
+/** Replay buffered writes of emulated device */
+int vmm_devemu_flush_coalesced(struct vmm_emudev *edev);
+
+/** Set doorbell handler of emulated device
+ *  Note: The doorbell is identified by guest physical base address of
+ *  the device region so guest can ring it using a hypercall instead of
+ *  trapping MMIO write.
+ *  Note: This should be called from emulator probe() and the doorbell
+ *  is removed automatically when device region is removed.
+ */
+int vmm_devemu_set_doorbell(struct vmm_emudev *edev,
+			    vmm_devemu_doorbell_t handler);
+
+/** Ring doorbell of emulated device at given guest physical base address
+ *  Note: Returns VMM_ENOTAVAIL if there is no such doorbell
+ */
+int vmm_devemu_ring_doorbell(struct vmm_guest *guest,
+			     physical_addr_t gphys_addr, u32 val);
+
 /** Internal function to emulate irq (should not be called directly) */
 extern int __vmm_devemu_emulate_irq(struct vmm_guest *guest, 
 				    u32 irq, int cpu, int level);
@@ -227,6 +358,19 @@ int vmm_devemu_reset_context(struct vmm_guest *guest);
 /** Reset emulators for given region */
 int vmm_devemu_reset_region(struct vmm_guest *guest, struct vmm_region *reg);
 
+/** Save state of emulator for given region
+ *  (Note: Returns VMM_ENOTSUPP if emulator has no save operation)
+ */
+int vmm_devemu_save_region(struct vmm_guest *guest, struct vmm_region *reg,
+			   struct vmm_snapshot_state *st);
+
+/** Restore state of emulator for given region
+ *  (Note: Returns VMM_ENOTSUPP if emulator has no restore operation)
+ */
+int vmm_devemu_restore_region(struct vmm_guest *guest,
+			      struct vmm_region *reg,
+			      struct vmm_snapshot_state *st);
+
 /** Probe emulators for given region */
 int vmm_devemu_probe_region(struct vmm_guest *guest, struct vmm_region *reg);
 
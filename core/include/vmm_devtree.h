@@ -90,6 +90,10 @@
 #define VMM_DEVTREE_TIME_SLICE_ATTR_NAME	"time_slice"
 #define VMM_DEVTREE_DEADLINE_ATTR_NAME		"deadline"
 #define VMM_DEVTREE_PERIODICITY_ATTR_NAME	"periodicity"
+#define VMM_DEVTREE_SCHED_WEIGHT_ATTR_NAME	"sched_weight"
+#define VMM_DEVTREE_SCHED_CAP_ATTR_NAME		"sched_cap"
+#define VMM_DEVTREE_SCHED_DEADLINE_ATTR_NAME	"sched_deadline"
+#define VMM_DEVTREE_TEMPLATE_ATTR_NAME		"template"
 #define VMM_DEVTREE_ADDRSPACE_NODE_NAME		"aspace"
 #define VMM_DEVTREE_GUESTIRQCNT_ATTR_NAME	"guest_irq_count"
 #define VMM_DEVTREE_MANIFEST_TYPE_ATTR_NAME	"manifest_type"
@@ -104,6 +108,9 @@
 #define VMM_DEVTREE_ALIAS_PHYS_ATTR_NAME	"alias_physical_addr"
 #define VMM_DEVTREE_PHYS_SIZE_ATTR_NAME		"physical_size"
 #define VMM_DEVTREE_ALIGN_ORDER_ATTR_NAME	"align_order"
+#define VMM_DEVTREE_PREMAP_ATTR_NAME		"premap"
+#define VMM_DEVTREE_LAZY_ATTR_NAME		"lazy"
+#define VMM_DEVTREE_WALLCLOCK_ATTR_NAME		"wallclock_page"
 #define VMM_DEVTREE_SWITCH_ATTR_NAME		"switch"
 #define VMM_DEVTREE_BLKDEV_ATTR_NAME		"blkdev"
 #define VMM_DEVTREE_VCPU_AFFINITY_ATTR_NAME	"affinity"
@@ -167,6 +174,8 @@ __nidtbl struct vmm_devtree_nidtbl_entry __##nid = { \
 
 #endif
 
+struct vmm_devtree_compat_entry;
+
 struct vmm_devtree_node {
 	/* Private fields */
 	struct dlist head;
@@ -175,6 +184,11 @@ struct vmm_devtree_node {
 	vmm_rwlock_t child_lock;
 	struct dlist child_list;
 	atomic_t ref_count;
+	u32 seq;
+	u32 phandle;
+	struct dlist phandle_head;
+	u32 compat_count;
+	struct vmm_devtree_compat_entry *compat_entries;
 	/* Public fields */
 	char name[VMM_FIELD_SHORT_NAME_SIZE];
 	struct vmm_devtree_node *parent;
@@ -469,6 +483,7 @@ bool vmm_devtree_is_compatible(const struct vmm_devtree_node *node,
 
 /** Find a node with given phandle value
  *  NOTE: This is based on 'phandle' attributes of device tree node
+ *  NOTE: Lookup uses phandle index hence it does not walk the tree
  *  NOTE: The returned node will have increased refrence count
  */
 struct vmm_devtree_node *vmm_devtree_find_node_by_phandle(u32 phandle);
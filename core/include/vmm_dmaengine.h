@@ -0,0 +1,180 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_dmaengine.h
+ * @author agent (agent@local)
+ * @brief DMA engine framework interface
+ *
+ * A DMA engine driver registers a DMA device with a set of channels
+ * and only needs to program one contiguous chunk (upto max_len bytes)
+ * at a time. The framework queues transactions per channel, splits
+ * scatter-gather lists into chunks and invokes completion callbacks.
+ *
+ * All addresses are host physical addresses and the caller is
+ * responsible for cache maintenance of memory used for DMA.
+ */
+
+#ifndef __VMM_DMAENGINE_H__
+#define __VMM_DMAENGINE_H__
+
+#include <vmm_types.h>
+#include <vmm_spinlocks.h>
+#include <libs/list.h>
+
+#define VMM_DMAENGINE_IPRIORITY		1
+
+/** DMA device capabilities */
+#define VMM_DMA_CAP_MEMCPY		(1 << 0)
+#define VMM_DMA_CAP_MEMSET		(1 << 1)
+/** DMA device can only do memset with zero value */
+#define VMM_DMA_CAP_MEMZERO		(1 << 2)
+
+/** DMA transaction types */
+enum vmm_dma_tx_types {
+	VMM_DMA_MEMCPY=0,
+	VMM_DMA_MEMSET=1,
+};
+
+struct vmm_device;
+struct vmm_dma_chan;
+
+/** DMA scatter-gather segment (src is ignored for memset) */
+struct vmm_dma_seg {
+	physical_addr_t dst;
+	physical_addr_t src;
+	physical_size_t len;
+};
+
+/** DMA transaction */
+struct vmm_dma_tx {
+	struct dlist head;
+	struct vmm_dma_chan *chan;
+	u32 type;
+	u32 value;
+	bool busy;
+	u32 seg_count;
+	u32 seg_pos;
+	physical_size_t seg_off;
+	physical_size_t xfer_len;
+	struct vmm_dma_seg *segs;
+	void (*callback)(void *param, int error);
+	void *param;
+	struct vmm_dma_seg seg;
+};
+
+/** DMA channel */
+struct vmm_dma_chan {
+	struct vmm_dma_device *ddev;
+	u32 id;
+	vmm_spinlock_t lock;
+	bool in_use;
+	struct dlist pending;
+	struct vmm_dma_tx *active;
+	void *priv;
+};
+
+/** DMA device (Note: chans array is provided by driver) */
+struct vmm_dma_device {
+	struct dlist head;
+	const char *name;
+	struct vmm_device *dev;
+	u32 caps;
+	/* Required alignment of addresses and lengths */
+	u32 align;
+	/* Maximum bytes per chunk (zero means no limit) */
+	physical_size_t max_len;
+	u32 chan_count;
+	struct vmm_dma_chan *chans;
+	/* Start one chunk on an idle channel. Once the chunk is done
+	 * the driver must call vmm_dma_chan_done().
+	 */
+	int (*xfer)(struct vmm_dma_chan *chan, u32 type,
+		    physical_addr_t dst, physical_addr_t src,
+		    u32 value, physical_size_t len);
+	/* Abort the chunk in-progress on a channel */
+	void (*terminate)(struct vmm_dma_chan *chan);
+	void *priv;
+};
+
+/** Register DMA device (Note: chans[] is initialized here) */
+int vmm_dma_register_device(struct vmm_dma_device *ddev);
+
+/** Unregister DMA device */
+int vmm_dma_unregister_device(struct vmm_dma_device *ddev);
+
+/** Notify completion of chunk started by xfer() of DMA device
+ *  (Note: usually called from DMA device interrupt handler)
+ */
+void vmm_dma_chan_done(struct vmm_dma_chan *chan, int error);
+
+/** Count of registered DMA devices */
+u32 vmm_dma_device_count(void);
+
+/** Get exclusive access to a free DMA channel having given caps */
+struct vmm_dma_chan *vmm_dma_chan_request(u32 caps);
+
+/** Abort all transactions of DMA channel (Note: callbacks of
+ *  aborted transactions are invoked with VMM_ESHUTDOWN error)
+ */
+void vmm_dma_chan_terminate(struct vmm_dma_chan *chan);
+
+/** Release DMA channel obtained using vmm_dma_chan_request() */
+void vmm_dma_chan_release(struct vmm_dma_chan *chan);
+
+/** Prepare memcpy transaction */
+struct vmm_dma_tx *vmm_dma_prep_memcpy(struct vmm_dma_chan *chan,
+				physical_addr_t dst, physical_addr_t src,
+				physical_size_t len,
+				void (*callback)(void *, int), void *param);
+
+/** Prepare memset transaction */
+struct vmm_dma_tx *vmm_dma_prep_memset(struct vmm_dma_chan *chan,
+				physical_addr_t dst, u8 value,
+				physical_size_t len,
+				void (*callback)(void *, int), void *param);
+
+/** Prepare scatter-gather memcpy transaction
+ *  (Note: segments are copied so caller can free them after this)
+ */
+struct vmm_dma_tx *vmm_dma_prep_sg(struct vmm_dma_chan *chan,
+				struct vmm_dma_seg *segs, u32 seg_count,
+				void (*callback)(void *, int), void *param);
+
+/** Free transaction which was prepared but never submitted */
+void vmm_dma_tx_free(struct vmm_dma_tx *tx);
+
+/** Submit prepared transaction to its channel. The transaction is
+ *  freed by framework after its callback returns.
+ */
+int vmm_dma_submit(struct vmm_dma_tx *tx);
+
+/** Do memcpy using DMA channel and wait for completion
+ *  (Note: must be called from Orphan VCPU or Thread context)
+ */
+int vmm_dma_memcpy_sync(struct vmm_dma_chan *chan,
+			physical_addr_t dst, physical_addr_t src,
+			physical_size_t len);
+
+/** Do memset using DMA channel and wait for completion
+ *  (Note: must be called from Orphan VCPU or Thread context)
+ */
+int vmm_dma_memset_sync(struct vmm_dma_chan *chan,
+			physical_addr_t dst, u8 value,
+			physical_size_t len);
+
+#endif /* __VMM_DMAENGINE_H__ */
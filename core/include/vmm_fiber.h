@@ -0,0 +1,201 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_fiber.h
+ * @author agent (agent@local)
+ * @brief Lightweight cooperative fiber interface
+ *
+ * Fibers are stackless cooperative tasks which are multiplexed over one
+ * host thread (a fiber group) so many light hypervisor services can run
+ * without a VCPU, stack and scheduler switch of their own. A fiber
+ * function is re-entered from the start each time it is scheduled and
+ * resumes from its last wait point using the VMM_FIBER_xxx() macros.
+ * Local variables are not preserved across wait points hence fiber
+ * state must live in the structure embedding the fiber. Fibers must
+ * never block the host thread (no sleeping APIs) instead they wait on
+ * waitqueues, completions or timeouts using the VMM_FIBER_xxx() macros.
+ */
+
+#ifndef __VMM_FIBER_H__
+#define __VMM_FIBER_H__
+
+#include <vmm_types.h>
+#include <vmm_limits.h>
+#include <vmm_spinlocks.h>
+#include <vmm_timer.h>
+#include <vmm_waitqueue.h>
+#include <vmm_completion.h>
+#include <vmm_threads.h>
+#include <libs/list.h>
+
+/** Return values of fiber function */
+enum vmm_fiber_return {
+	VMM_FIBER_YIELDED=0,
+	VMM_FIBER_WAITING=1,
+	VMM_FIBER_EXITED=2,
+};
+
+/** Fiber states */
+enum vmm_fiber_states {
+	VMM_FIBER_STATE_IDLE=0,
+	VMM_FIBER_STATE_READY=1,
+	VMM_FIBER_STATE_RUNNING=2,
+	VMM_FIBER_STATE_WAITING=3,
+	VMM_FIBER_STATE_EXITED=4,
+};
+
+struct vmm_fiber_group;
+
+/** Fiber structure (embedded in structure of fiber owner) */
+struct vmm_fiber {
+	struct dlist head;
+	struct dlist rq_head;
+	struct dlist wq_head;
+	struct vmm_waitqueue *wq;
+	struct vmm_fiber_group *grp;
+	char name[VMM_FIELD_NAME_SIZE];
+	u32 state;
+	bool wake_pending;
+	u32 resume_point;
+	struct vmm_timer_event ev;
+	int (*func)(struct vmm_fiber *f);
+	void *priv;
+};
+
+/** Fiber group structure (one host thread running many fibers) */
+struct vmm_fiber_group {
+	char name[VMM_FIELD_NAME_SIZE];
+	vmm_spinlock_t lock;
+	struct dlist fiber_list;
+	u32 fiber_count;
+	struct dlist run_list;
+	struct vmm_completion run_avail;
+	struct vmm_thread *thread;
+};
+
+/** Start of fiber function body */
+#define VMM_FIBER_BEGIN(f)						\
+	switch ((f)->resume_point) {					\
+	case 0:
+
+/** End of fiber function body (fiber exits when it gets here) */
+#define VMM_FIBER_END(f)						\
+	}								\
+	(f)->resume_point = 0;						\
+	return VMM_FIBER_EXITED
+
+/** Exit fiber */
+#define VMM_FIBER_EXIT(f)						\
+do {									\
+	(f)->resume_point = 0;						\
+	return VMM_FIBER_EXITED;					\
+} while (0)
+
+/** Let other fibers of the fiber group run */
+#define VMM_FIBER_YIELD(f)						\
+do {									\
+	(f)->resume_point = __LINE__;					\
+	return VMM_FIBER_YIELDED;					\
+	case __LINE__:;							\
+} while (0)
+
+/** Wait until condition gets true (re-checked when waitqueue is woken) */
+#define VMM_FIBER_WAIT_EVENT(f, wq, condition)				\
+do {									\
+	(f)->resume_point = __LINE__;					\
+	case __LINE__:							\
+	if (!(condition)) {						\
+		vmm_fiber_prepare_wait((f), (wq));			\
+		if (!(condition)) {					\
+			return VMM_FIBER_WAITING;			\
+		}							\
+	}								\
+	vmm_fiber_finish_wait(f);					\
+} while (0)
+
+/** Wait for completion */
+#define VMM_FIBER_WAIT_COMPLETION(f, cmpl)				\
+do {									\
+	(f)->resume_point = __LINE__;					\
+	case __LINE__:							\
+	if (!vmm_fiber_completion_try((f), (cmpl))) {			\
+		return VMM_FIBER_WAITING;				\
+	}								\
+} while (0)
+
+/** Sleep for given nano-seconds */
+#define VMM_FIBER_SLEEP(f, nsecs)					\
+do {									\
+	vmm_fiber_sleep_start((f), (nsecs));				\
+	(f)->resume_point = __LINE__;					\
+	case __LINE__:							\
+	if (vmm_timer_event_pending(&(f)->ev)) {			\
+		return VMM_FIBER_WAITING;				\
+	}								\
+} while (0)
+
+/** Prepare fiber for waiting on waitqueue (Note: only for macros) */
+void vmm_fiber_prepare_wait(struct vmm_fiber *f, struct vmm_waitqueue *wq);
+
+/** Remove fiber from waitqueue if still there (Note: only for macros) */
+void vmm_fiber_finish_wait(struct vmm_fiber *f);
+
+/** Consume completion or wait for it (Note: only for macros) */
+bool vmm_fiber_completion_try(struct vmm_fiber *f,
+			      struct vmm_completion *cmpl);
+
+/** Start sleep timeout of fiber (Note: only for macros) */
+void vmm_fiber_sleep_start(struct vmm_fiber *f, u64 nsecs);
+
+/** Lowlevel wakeup of fiber waiting on waitqueue.
+ *  Note: This function should only be called with wq->lock held
+ *  Note: This function can be called from any context
+ */
+int __vmm_fiber_waitqueue_wake(struct vmm_fiber *f);
+
+/** Wakeup fiber
+ *  Note: This function can be called from any context
+ */
+int vmm_fiber_wake(struct vmm_fiber *f);
+
+/** Initialize fiber */
+void vmm_fiber_init(struct vmm_fiber *f, const char *name,
+		    int (*func)(struct vmm_fiber *f), void *priv);
+
+/** Start fiber in given fiber group */
+int vmm_fiber_start(struct vmm_fiber_group *grp, struct vmm_fiber *f);
+
+/** Retrive fiber state */
+static inline u32 vmm_fiber_state(struct vmm_fiber *f)
+{
+	return (f) ? f->state : VMM_FIBER_STATE_IDLE;
+}
+
+/** Number of fibers (not yet exited) in fiber group */
+u32 vmm_fiber_group_count(struct vmm_fiber_group *grp);
+
+/** Create fiber group with its host thread */
+struct vmm_fiber_group *vmm_fiber_group_create(const char *name,
+						u8 priority);
+
+/** Destroy fiber group
+ *  Note: All fibers of the fiber group must have exited
+ */
+int vmm_fiber_group_destroy(struct vmm_fiber_group *grp);
+
+#endif /* __VMM_FIBER_H__ */
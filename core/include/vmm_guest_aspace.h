@@ -25,6 +25,7 @@
 
 #include <vmm_manager.h>
 #include <vmm_notifier.h>
+#include <vmm_spinlocks.h>
 
 /* Notifier event when guest aspace is initialized */
 #define VMM_GUEST_ASPACE_EVENT_INIT		0x01
@@ -32,6 +33,14 @@
 #define VMM_GUEST_ASPACE_EVENT_DEINIT		0x02
 /* Notifier event when guest aspace is reset */
 #define VMM_GUEST_ASPACE_EVENT_RESET		0x03
+/* Change type of region added dynamically */
+#define VMM_GUEST_ASPACE_EVENT_ADD_REGION	0x04
+/* Change type of region about to be deleted */
+#define VMM_GUEST_ASPACE_EVENT_DEL_REGION	0x05
+/* Notifier event when batch of region changes is committed
+ * (data = struct vmm_guest_aspace_batch)
+ */
+#define VMM_GUEST_ASPACE_EVENT_BATCH		0x06
 
 /** Representation of block device notifier event */
 struct vmm_guest_aspace_event {
@@ -39,12 +48,46 @@ struct vmm_guest_aspace_event {
 	void *data;
 };
 
+/** One region change of guest address space batch */
+struct vmm_guest_aspace_change {
+	struct dlist head;
+	unsigned long type;
+	struct vmm_region *reg;
+	bool del_node;
+};
+
+/** Region changes of guest address space batch in the order they
+ *  were done. Regions being deleted are still valid when listeners
+ *  get the batch and are deleted only after all of them returned.
+ */
+struct vmm_guest_aspace_batch {
+	u32 add_count;
+	u32 del_count;
+	struct dlist *changes;
+};
+
+/** Iterate over region changes of guest address space batch */
+#define vmm_guest_aspace_for_each_change(c, batch)	\
+	list_for_each_entry(c, (batch)->changes, head)
+
 /** Register a guest address space state change notifier handler */
 int vmm_guest_aspace_register_client(struct vmm_notifier_block *nb);
 
 /** Unregister guest address space state change notifier */
 int vmm_guest_aspace_unregister_client(struct vmm_notifier_block *nb);
 
+/** Begin batch of dynamic region changes of a guest. Regions added
+ *  or deleted till matching vmm_guest_aspace_batch_commit() are passed
+ *  to listeners as one VMM_GUEST_ASPACE_EVENT_BATCH notification.
+ *  Batches can be nested and only the outermost commit notifies.
+ *  (Note: A region being deleted stays in address space till commit
+ *  hence new region must not overlap it in the same batch)
+ */
+int vmm_guest_aspace_batch_begin(struct vmm_guest *guest);
+
+/** Commit batch of dynamic region changes of a guest */
+int vmm_guest_aspace_batch_commit(struct vmm_guest *guest);
+
 /** Find region corresponding to a guest physical address and also
  *  resolve aliased regions to real or virtual regions if required.
  */
@@ -52,6 +95,12 @@ struct vmm_region *vmm_guest_find_region(struct vmm_guest *guest,
 					 physical_addr_t gphys_addr,
 					 u32 reg_flags, bool resolve_alias);
 
+/** Allocate host RAM of lazily allocated guest region if not done
+ *  (Note: vmm_guest_find_region() does this for regions it returns)
+ */
+int vmm_guest_populate_region(struct vmm_guest *guest,
+			      struct vmm_region *reg);
+
 /** Read from guest memory regions (i.e. RAM or ROM regions) */
 u32 vmm_guest_memory_read(struct vmm_guest *guest, 
 			  physical_addr_t gphys_addr, 
@@ -62,6 +111,71 @@ u32 vmm_guest_memory_write(struct vmm_guest *guest,
 			   physical_addr_t gphys_addr, 
 			   void *src, u32 len, bool cacheable);
 
+#define VMM_GUEST_MAPCACHE_WINDOW_SHIFT		15
+#define VMM_GUEST_MAPCACHE_WINDOW_SIZE		\
+				(1UL << VMM_GUEST_MAPCACHE_WINDOW_SHIFT)
+#define VMM_GUEST_MAPCACHE_WINDOW_COUNT		8
+
+/** Window of guest RAM mapped by guest map cache */
+struct vmm_guest_mapcache_window {
+	physical_addr_t gphys_addr;
+	u32 ref_count;
+	bool valid;
+	bool mapped;
+};
+
+/** Guest map cache keeps recently accessed guest RAM windows mapped
+ *  in hypervisor VA space so that repeated accesses to same guest
+ *  buffers (such as virtio rings or packet headers) become memcpy.
+ */
+struct vmm_guest_mapcache {
+	struct vmm_guest *guest;
+	vmm_spinlock_t lock;
+	u32 reg_gen;
+	u32 victim;
+	virtual_addr_t va;
+	struct vmm_guest_mapcache_window win[VMM_GUEST_MAPCACHE_WINDOW_COUNT];
+};
+
+/** Initialize guest map cache
+ *  Note: Reserves VMM_GUEST_MAPCACHE_WINDOW_COUNT windows of
+ *  hypervisor VA space.
+ */
+int vmm_guest_mapcache_init(struct vmm_guest_mapcache *mc,
+			    struct vmm_guest *guest);
+
+/** Unmap all windows and free VA space of guest map cache */
+void vmm_guest_mapcache_exit(struct vmm_guest_mapcache *mc);
+
+/** Get hypervisor virtual address of guest RAM buffer through
+ *  guest map cache. The buffer stays mapped until the cookie is
+ *  released using vmm_guest_mapcache_put().
+ *  Note: Fails with VMM_ENOTAVAIL if buffer crosses a window or
+ *  cannot be cached.
+ */
+int vmm_guest_mapcache_get(struct vmm_guest_mapcache *mc,
+			   physical_addr_t gphys_addr, u32 len,
+			   virtual_addr_t *va, u32 *cookie);
+
+/** Release guest RAM buffer mapping returned by vmm_guest_mapcache_get() */
+void vmm_guest_mapcache_put(struct vmm_guest_mapcache *mc, u32 cookie);
+
+/** Read from guest RAM through guest map cache
+ *  Note: Falls back to vmm_guest_memory_read() for accesses
+ *  which cannot be cached.
+ */
+u32 vmm_guest_mapcache_read(struct vmm_guest_mapcache *mc,
+			    physical_addr_t gphys_addr,
+			    void *dst, u32 len);
+
+/** Write to guest RAM through guest map cache
+ *  Note: Falls back to vmm_guest_memory_write() for accesses
+ *  which cannot be cached.
+ */
+u32 vmm_guest_mapcache_write(struct vmm_guest_mapcache *mc,
+			     physical_addr_t gphys_addr,
+			     void *src, u32 len);
+
 /** Map guest physical address to some host physical address */
 int vmm_guest_physical_map(struct vmm_guest *guest,
 			   physical_addr_t gphys_addr,
@@ -95,6 +209,16 @@ int vmm_guest_add_region(struct vmm_guest *guest,
 			 u32 align_order,
 			 void *rpriv);
 
+/** Hotplug RAM into guest address space as new region. Host RAM of
+ *  the region is allocated and mapped in stage2 only when guest (or
+ *  a device emulator) touches it for the first time.
+ */
+int vmm_guest_hotplug_ram(struct vmm_guest *guest,
+			  const char *name,
+			  physical_addr_t gphys_addr,
+			  physical_size_t phys_size,
+			  struct vmm_region **out_reg);
+
 /** Get private pointer of guest region */
 static inline void *vmm_guest_get_region_priv(struct vmm_region *reg)
 {
@@ -115,9 +239,64 @@ int vmm_guest_del_region(struct vmm_guest *guest,
 			 struct vmm_region *reg,
 			 bool del_node);
 
+/** Unplug RAM region added by vmm_guest_hotplug_ram() and give its
+ *  host RAM back to host (Note: Guest must not be using the RAM)
+ */
+int vmm_guest_unplug_ram(struct vmm_guest *guest,
+			 struct vmm_region *reg);
+
 /** Reset guest address space */
 int vmm_guest_aspace_reset(struct vmm_guest *guest);
 
+/** Iterate over guest memory regions having all given region flags
+ *  (Note: Regions lock is not held while calling iter callback)
+ */
+int vmm_guest_iterate_mem_regions(struct vmm_guest *guest, u32 reg_flags,
+			int (*iter)(struct vmm_guest *, struct vmm_region *, void *),
+			void *priv);
+
+/** Iterate over guest io regions having all given region flags
+ *  (Note: Regions lock is not held while calling iter callback)
+ */
+int vmm_guest_iterate_io_regions(struct vmm_guest *guest, u32 reg_flags,
+			int (*iter)(struct vmm_guest *, struct vmm_region *, void *),
+			void *priv);
+
+/** Start dirty page logging for given guest physical address range
+ *  (Note: Bit N of dirty bitmap represents Nth page starting from
+ *  the page containing gphys)
+ *  (Note: All pages are reported dirty by first dirty log get)
+ */
+int vmm_guest_dirty_log_start(struct vmm_guest *guest,
+			      physical_addr_t gphys,
+			      physical_size_t size);
+
+/** Stop dirty page logging of range containing given guest address */
+int vmm_guest_dirty_log_stop(struct vmm_guest *guest,
+			     physical_addr_t gphys);
+
+/** Get and clear dirty bitmap of range containing given guest address
+ *  (Note: nbits must cover all pages of the range)
+ *  (Note: Caller must serialize start, stop and get of a range)
+ */
+int vmm_guest_dirty_log_get(struct vmm_guest *guest,
+			    physical_addr_t gphys,
+			    unsigned long *bitmap, u32 nbits);
+
+/** Check whether any page of given range has to be mapped read-only
+ *  because it is dirty logged and clean (Note: only for arch code)
+ */
+bool vmm_guest_dirty_log_wprot(struct vmm_guest *guest,
+			       physical_addr_t gphys,
+			       physical_size_t size);
+
+/** Mark page containing given guest address as dirty
+ *  (Note: only for arch code, must be called after the page
+ *  is made writable again)
+ */
+void vmm_guest_dirty_log_mark(struct vmm_guest *guest,
+			      physical_addr_t gphys);
+
 /** Initialize guest address space */
 int vmm_guest_aspace_init(struct vmm_guest *guest);
 
@@ -63,6 +63,15 @@ virtual_size_t vmm_normal_heap_free_size(void);
 /** Print Normal heap state */
 int vmm_normal_heap_print_state(struct vmm_chardev *cdev);
 
+/** Print biggest users of Normal heap by allocation call-site
+ *  (Note: Only available with CONFIG_HEAP_CALLSITE)
+ */
+int vmm_normal_heap_print_callsites(struct vmm_chardev *cdev,
+				    u32 max_entries);
+
+/** Print Normal heap per-CPU cache state */
+int vmm_normal_heap_print_cache_state(struct vmm_chardev *cdev);
+
 /** Possible DMA directions */
 enum vmm_dma_direction {
 	DMA_BIDIRECTIONAL = 0,
@@ -126,6 +135,40 @@ virtual_size_t vmm_dma_heap_free_size(void);
 /** Print DMA heap state */
 int vmm_dma_heap_print_state(struct vmm_chardev *cdev);
 
+/** Print biggest users of DMA heap by allocation call-site
+ *  (Note: Only available with CONFIG_HEAP_CALLSITE)
+ */
+int vmm_dma_heap_print_callsites(struct vmm_chardev *cdev, u32 max_entries);
+
+struct vmm_arena;
+
+/** Create private arena of given size carved from Normal heap
+ *  (Note: Arena alloc and free take bounded time hence arenas are
+ *  suitable for allocations in latency sensitive paths)
+ */
+struct vmm_arena *vmm_arena_create(virtual_size_t size);
+
+/** Allocate memory from arena */
+void *vmm_arena_malloc(struct vmm_arena *a, virtual_size_t size);
+
+/** Allocate memory from arena and zero set */
+void *vmm_arena_zalloc(struct vmm_arena *a, virtual_size_t size);
+
+/** Check if given memory belongs to arena */
+bool vmm_arena_contains(struct vmm_arena *a, const void *ptr);
+
+/** Free memory to arena */
+void vmm_arena_free(struct vmm_arena *a, void *ptr);
+
+/** Size of arena free space */
+virtual_size_t vmm_arena_free_size(struct vmm_arena *a);
+
+/** Destroy arena (Note: All arena memory is released) */
+void vmm_arena_destroy(struct vmm_arena *a);
+
+/** Reset peak usage of Normal and DMA heaps to current usage */
+void vmm_heap_reset_peak(void);
+
 /** Initialization function for head managment */
 int vmm_heap_init(void);
 
@@ -151,6 +151,12 @@ u32 vmm_host_memory_read(physical_addr_t hpa,
 u32 vmm_host_memory_write(physical_addr_t hpa,
 			  void *src, u32 len, bool cacheable);
 
+/** Zero-fill host memory
+ *  Note: We assume non-IO (or non-device) physical address
+ *  Note: Whole pages are zeroed with the fastest method of arch
+ */
+u32 vmm_host_memory_zero(physical_addr_t hpa, u32 len, bool cacheable);
+
 /** Write a byte pattern to host memory
  *  Note: We assume non-IO (or non-device) physical address
  */
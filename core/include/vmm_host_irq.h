@@ -27,6 +27,7 @@
 #include <vmm_cpumask.h>
 #include <vmm_spinlocks.h>
 #include <vmm_devtree.h>
+#include <vmm_workqueue.h>
 #include <libs/list.h>
 
 /**
@@ -90,10 +91,12 @@ enum vmm_routed_irq_states {
  * enum vmm_irq_return
  * @VMM_IRQ_NONE		interrupt was not from this device
  * @VMM_IRQ_HANDLED		interrupt was handled by this device
+ * @VMM_IRQ_WAKE_THREAD		handler requests to run thread function
  */
 enum vmm_irq_return {
 	VMM_IRQ_NONE		= (0 << 0),
 	VMM_IRQ_HANDLED		= (1 << 0),
+	VMM_IRQ_WAKE_THREAD	= (1 << 1),
 };
 
 struct vmm_host_irq;
@@ -107,6 +110,11 @@ struct vmm_host_irq_action {
 	struct dlist head;
 	vmm_host_irq_function_t func;
 	void *dev;
+	u32 hirq;
+	vmm_host_irq_function_t thread_func;
+	struct vmm_workqueue *thread_wq;
+	struct vmm_work thread_work;
+	bool thread_unmask;
 };
 
 /** Host IRQ Chip Abstraction
@@ -141,6 +149,19 @@ struct vmm_host_irq_chip {
 				     u32 val, u32 mask);
 };
 
+/** Number of buckets in host IRQ handler time histogram
+ *  (Note: Bucket N counts handler runs taking less than 2^N
+ *  microseconds whereas last bucket counts all longer runs)
+ */
+#define VMM_HOST_IRQ_HIST_BUCKETS	8
+
+/** Host IRQ handler execution time statistics */
+struct vmm_host_irq_stats {
+	u64 total_ns;
+	u64 max_ns;
+	u32 hist[VMM_HOST_IRQ_HIST_BUCKETS];
+};
+
 /** Host IRQ Abstraction */
 struct vmm_host_irq {
 	u32 num;
@@ -149,6 +170,9 @@ struct vmm_host_irq {
 	u32 state;
 	u32 count[CONFIG_CPU_COUNT];
 	bool in_progress[CONFIG_CPU_COUNT];
+#ifdef CONFIG_HOST_IRQ_STATS
+	struct vmm_host_irq_stats stats[CONFIG_CPU_COUNT];
+#endif
 	void *chip_data;
 	struct vmm_host_irq_chip *chip;
 	vmm_host_irq_handler_t handler;
@@ -330,6 +354,21 @@ static inline u32 vmm_host_irq_get_count(struct vmm_host_irq *irq, u32 cpu)
 	return 0;
 }
 
+#ifdef CONFIG_HOST_IRQ_STATS
+/** Get handler execution time statistics of host irq for given cpu */
+static inline struct vmm_host_irq_stats *vmm_host_irq_get_stats(
+					struct vmm_host_irq *irq, u32 cpu)
+{
+	if (cpu < CONFIG_CPU_COUNT) {
+		return (irq) ? &irq->stats[cpu] : NULL;
+	}
+	return NULL;
+}
+
+/** Reset handler execution time statistics of host irq */
+void vmm_host_irq_reset_stats(struct vmm_host_irq *irq);
+#endif
+
 /** Set cpu affinity of given host irq */
 int vmm_host_irq_set_affinity(u32 hirq,
 			      const struct vmm_cpumask *dest,
@@ -387,6 +426,22 @@ int vmm_host_irq_register(u32 hirq,
 			  vmm_host_irq_function_t func,
 			  void *dev);
 
+/** Register threaded function callbacks for given irq
+ *  The func is called in interrupt context and can return
+ *  VMM_IRQ_WAKE_THREAD to have thread_func called later in
+ *  context of workqueue thread. Level triggered irq is kept
+ *  masked until thread_func returns.
+ *  Note: If func is NULL then thread_func is always woken.
+ *  Note: If wq is NULL then per-CPU system workqueue is used
+ *  otherwise priority of wq thread decides thread_func priority.
+ */
+int vmm_host_irq_register_threaded(u32 hirq,
+				   const char *name,
+				   vmm_host_irq_function_t func,
+				   vmm_host_irq_function_t thread_func,
+				   struct vmm_workqueue *wq,
+				   void *dev);
+
 /** Unregister function callback for given irq */
 int vmm_host_irq_unregister(u32 hirq,
 			    void *dev);
@@ -31,6 +31,14 @@ physical_size_t vmm_host_ram_alloc(physical_addr_t *pa,
 				   physical_size_t sz,
 				   u32 align_order);
 
+/** Allocate zero-filled physical space from RAM
+ *  Note: Frames pre-zeroed in background are not zeroed again
+ */
+physical_size_t vmm_host_ram_alloc_zeroed(physical_addr_t *pa,
+					  physical_size_t sz,
+					  u32 align_order,
+					  bool cacheable);
+
 /** Reserve a portion of RAM forcefully */
 int vmm_host_ram_reserve(physical_addr_t pa, physical_size_t sz);
 
@@ -43,6 +51,9 @@ bool vmm_host_ram_frame_isfree(physical_addr_t pa);
 /** Total free frames of all RAM banks */
 u32 vmm_host_ram_total_free_frames(void);
 
+/** Total free frames of all RAM banks which are already zero */
+u32 vmm_host_ram_total_zeroed_frames(void);
+
 /** Total frame count of all RAM banks */
 u32 vmm_host_ram_total_frame_count(void);
 
@@ -67,6 +78,9 @@ u32 vmm_host_ram_bank_free_frames(u32 bank);
 /** Estimate House-keeping size of RAM */
 virtual_size_t vmm_host_ram_estimate_hksize(void);
 
+/** Start background pre-zeroing of free RAM frames */
+int vmm_host_ram_prezero_init(void);
+
 /* Initialize RAM managment */
 int vmm_host_ram_init(virtual_addr_t hkbase);
 
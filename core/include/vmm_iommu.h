@@ -33,6 +33,7 @@
 
 #include <vmm_error.h>
 #include <vmm_types.h>
+#include <vmm_notifier.h>
 
 #define VMM_IOMMU_IPRIORITY	1
 
@@ -46,7 +47,7 @@ struct vmm_iommu_group;
 struct vmm_bus;
 struct vmm_device;
 struct vmm_iommu_domain;
-struct vmm_notifier_block;
+struct vmm_guest;
 
 /* iommu fault flags */
 #define VMM_IOMMU_FAULT_READ	0x0
@@ -67,6 +68,10 @@ struct vmm_iommu_domain {
 	vmm_iommu_fault_handler_t handler;
 	void *handler_token;
 	struct vmm_iommu_domain_geometry geometry;
+	/* Guest synchronized with domain (see vmm_iommu_guest_sync()) */
+	struct vmm_guest *guest;
+	int guest_prot;
+	struct vmm_notifier_block guest_nb;
 };
 
 #define VMM_IOMMU_CAP_CACHE_COHERENCY	0x1
@@ -102,6 +107,8 @@ enum vmm_iommu_attr {
  * @detach_dev: detach device from an iommu domain
  * @map: map a physically contiguous memory region to an iommu domain
  * @unmap: unmap a physically contiguous memory region from an iommu domain
+ * @iotlb_range_add: add a range of unmapped iova to pending IOTLB flush
+ * @iotlb_sync: flush all pending IOTLB invalidations of an iommu domain
  * @iova_to_phys: translate iova to physical address
  * @domain_has_cap: domain capabilities query
  * @add_device: add device to iommu grouping
@@ -121,6 +128,9 @@ struct vmm_iommu_ops {
 		   physical_addr_t paddr, size_t size, int prot);
 	size_t (*unmap)(struct vmm_iommu_domain *domain, unsigned long iova,
 			size_t size);
+	void (*iotlb_range_add)(struct vmm_iommu_domain *domain,
+				unsigned long iova, size_t size);
+	void (*iotlb_sync)(struct vmm_iommu_domain *domain);
 	physical_addr_t (*iova_to_phys)(struct vmm_iommu_domain *domain,
 					dma_addr_t iova);
 	int (*domain_has_cap)(struct vmm_iommu_domain *domain,
@@ -183,6 +193,26 @@ int vmm_iommu_map(struct vmm_iommu_domain *domain, unsigned long iova,
 size_t vmm_iommu_unmap(struct vmm_iommu_domain *domain, unsigned long iova,
 		       size_t size);
 
+/** Unmap IO virtual address for given IOMMU domain without flushing
+ *  IOTLB. The caller must call vmm_iommu_iotlb_sync() after a batch
+ *  of such unmaps and before the unmapped memory is reused.
+ */
+size_t vmm_iommu_unmap_fast(struct vmm_iommu_domain *domain,
+			    unsigned long iova, size_t size);
+
+/** Flush pending IOTLB invalidations of given IOMMU domain */
+void vmm_iommu_iotlb_sync(struct vmm_iommu_domain *domain);
+
+/** Map all RAM regions of a guest at guest physical addresses in
+ *  given IOMMU domain and keep the domain in-sync with RAM regions
+ *  added or deleted later.
+ */
+int vmm_iommu_guest_sync(struct vmm_iommu_domain *domain,
+			 struct vmm_guest *guest, int prot);
+
+/** Unmap guest RAM regions mapped by vmm_iommu_guest_sync() */
+void vmm_iommu_guest_unsync(struct vmm_iommu_domain *domain);
+
 /** Get IO virtual addres mapping for given IOMMU domain */
 physical_addr_t vmm_iommu_iova_to_phys(struct vmm_iommu_domain *domain,
 				       dma_addr_t iova);
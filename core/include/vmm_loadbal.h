@@ -38,6 +38,7 @@ struct vmm_loadbal_algo {
 	int  (*start) (struct vmm_loadbal_algo *);
 	u32  (*good_hcpu) (struct vmm_loadbal_algo *, u8 priority);
 	void (*balance) (struct vmm_loadbal_algo *);
+	void (*idle_pull) (struct vmm_loadbal_algo *, u32 hcpu);
 	void (*stop) (struct vmm_loadbal_algo *);
 	void *priv;
 };
@@ -64,6 +65,17 @@ u32 vmm_loadbal_good_hcpu(u8 priority);
 #define vmm_loadbal_good_hcpu(priority)		vmm_smp_processor_id()
 #endif
 
+/** Notify load balancer that current host CPU is entering idle
+ *  so that load balancing algo can pull work to it
+ *  Note: This function can be called from any context and is rate
+ *  limited per host CPU
+ */
+#ifdef CONFIG_SMP
+void vmm_loadbal_idle_notify(void);
+#else
+#define vmm_loadbal_idle_notify()
+#endif
+
 /** Current (or best rated) load balancing algo instance
  *  Note: This function must be called from Orphan (or Thread) Context
  */
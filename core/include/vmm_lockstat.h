@@ -0,0 +1,98 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_lockstat.h
+ * @author agent (agent@local)
+ * @brief Lock contention statistics interface
+ *
+ * Locks initialized at runtime belong to the lock class of their
+ * INIT_xxx() call site whereas statically initialized locks get a
+ * lock class of their own when they are acquired for first time.
+ */
+
+#ifndef __VMM_LOCKSTAT_H__
+#define __VMM_LOCKSTAT_H__
+
+#include <vmm_types.h>
+
+enum vmm_lockstat_types {
+	VMM_LOCKSTAT_SPINLOCK = 0,
+	VMM_LOCKSTAT_RWLOCK,
+	VMM_LOCKSTAT_MUTEX,
+	VMM_LOCKSTAT_MAX_TYPES
+};
+
+/** Lock statistics of one host CPU */
+struct vmm_lockstat_counters {
+	u64 acquired;
+	u64 contended;
+	u64 wait_total_ns;
+	u64 wait_max_ns;
+	u64 hold_total_ns;
+	u64 hold_max_ns;
+};
+
+/** Lock class */
+struct vmm_lockstat_class {
+	/* Name of lock class (NULL for statically initialized lock) */
+	const char *name;
+	/* Address of statically initialized lock */
+	const void *addr;
+	u32 type;
+	bool registered;
+	struct vmm_lockstat_class *next;
+	struct vmm_lockstat_counters cpu[CONFIG_CPU_COUNT];
+};
+
+#define VMM_LOCKSTAT_CLASS_INITIALIZER(__name, __type) \
+	{ .name = (__name), .addr = NULL, .type = (__type), \
+	  .registered = FALSE, .next = NULL, }
+
+/** Get lock class of a lock (Note: only for lock implementations) */
+struct vmm_lockstat_class *vmm_lockstat_class_get(
+					struct vmm_lockstat_class **clsp,
+					const void *lock, u32 type);
+
+/** Current timestamp for lock statistics */
+u64 vmm_lockstat_tstamp(void);
+
+/** Account lock acquisition and return timestamp of acquisition
+ *  (Note: only for lock implementations)
+ */
+u64 vmm_lockstat_acquired(struct vmm_lockstat_class *cls,
+			  bool contended, u64 wait_tstamp);
+
+/** Account lock release (Note: only for lock implementations) */
+void vmm_lockstat_released(struct vmm_lockstat_class *cls,
+			   u64 hold_tstamp);
+
+/** Name of lock type */
+const char *vmm_lockstat_type_name(u32 type);
+
+/** Iterate over all lock classes which were acquired at least once */
+int vmm_lockstat_iterate(int (*iter)(struct vmm_lockstat_class *, void *),
+			 void *priv);
+
+/** Sum statistics of all host CPUs for given lock class */
+void vmm_lockstat_get(struct vmm_lockstat_class *cls,
+		      struct vmm_lockstat_counters *cnt);
+
+/** Reset statistics of all lock classes */
+void vmm_lockstat_reset(void);
+
+#endif /* __VMM_LOCKSTAT_H__ */
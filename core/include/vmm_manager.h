@@ -50,6 +50,9 @@ enum vmm_region_flags {
 	VMM_REGION_ISRESERVED=0x00001000,
 	VMM_REGION_ISALLOCED=0x00002000,
 	VMM_REGION_ISDYNAMIC=0x00004000,
+	VMM_REGION_ISPREMAP=0x00008000,
+	VMM_REGION_ISSHARED=0x00010000,
+	VMM_REGION_ISLAZY=0x00020000,
 };
 
 #define VMM_REGION_MANIFEST_MASK	(VMM_REGION_REAL | \
@@ -70,6 +73,7 @@ struct vmm_region {
 	physical_addr_t gphys_addr;
 	physical_addr_t hphys_addr;
 	physical_size_t phys_size;
+	virtual_addr_t linear_va;
 	u32 align_order;
 	u32 flags;
 	void *devemu_priv;
@@ -95,6 +99,12 @@ struct vmm_guest_aspace {
 	vmm_rwlock_t reg_memtree_lock;
 	struct rb_root reg_memtree;
 	struct dlist reg_memprobe_list;
+	atomic_t reg_gen;
+	vmm_spinlock_t dirty_log_lock;
+	struct dlist dirty_log_list;
+	vmm_spinlock_t lazy_lock;
+	u32 batch_depth;
+	struct dlist batch_list;
 	void *devemu_priv;
 };
 
@@ -107,22 +117,61 @@ struct vmm_guest_request {
 struct vmm_vcpu_irq {
 	atomic_t assert;
 	u64 reason;
+	u32 prio;
+	u32 slot;
 };
 
 struct vmm_vcpu_irqs {
 	u32 irq_count;
 	struct vmm_vcpu_irq *irq;
+	/* Asserted irqs as bitmap of slots where slots are
+	 * sorted by decreasing priority and then irq number
+	 */
+	unsigned long *pending;
+	u32 *slot_irq;
 	atomic_t execute_pending;
 	atomic64_t assert_count;
 	atomic64_t execute_count;
 	atomic64_t deassert_count;
 	struct {
 		vmm_spinlock_t lock;
-		bool state;
+		atomic_t state;
 		void *priv;
+		u64 start_tstamp;
+		u64 poll_ns;
+		u64 poll_success;
+		u64 poll_fail;
+		u32 idle_cpu;
 	} wfi;
 };
 
+/** Guest boot phases (in usual order of occurrence) */
+enum vmm_guest_boot_phases {
+	VMM_GUEST_BOOT_CREATE=0,
+	VMM_GUEST_BOOT_VCPUS_CREATED,
+	VMM_GUEST_BOOT_ASPACE_INIT,
+	VMM_GUEST_BOOT_CREATE_DONE,
+	VMM_GUEST_BOOT_IMAGE_LOADED,
+	VMM_GUEST_BOOT_KICK,
+	VMM_GUEST_BOOT_FIRST_VCPU_ENTRY,
+	VMM_GUEST_BOOT_FIRST_MMIO,
+	VMM_GUEST_BOOT_FIRST_VIRTIO_NOTIFY,
+	VMM_GUEST_BOOT_MAX_PHASES
+};
+
+#define VMM_GUEST_BOOT_FAULT_SLOTS	32
+
+/** Guest boot-time breakdown
+ *  (Note: Phase timestamps are zero until the phase is reached and
+ *  stage2 faults are counted in fixed width time slots from kick
+ *  where the last slot also counts all later faults)
+ */
+struct vmm_guest_boot_stats {
+	u64 tstamp[VMM_GUEST_BOOT_MAX_PHASES];
+	atomic_t fault_count;
+	atomic_t fault_slot[VMM_GUEST_BOOT_FAULT_SLOTS];
+};
+
 struct vmm_guest {
 	struct dlist head;
 
@@ -134,6 +183,16 @@ struct vmm_guest {
 	u32 reset_count;
 	u64 reset_tstamp;
 
+	/* Scheduling parameters shared by all VCPUs */
+	u32 sched_weight;
+	u32 sched_cap;
+
+	/* Template guest and number of clones (Note: Protected by
+	 * manager lock)
+	 */
+	struct vmm_guest *tmpl;
+	u32 clone_count;
+
 	/* Request queue */
 	vmm_spinlock_t req_lock;
 	struct dlist req_list;
@@ -146,6 +205,11 @@ struct vmm_guest {
 	/* Guest address space */
 	struct vmm_guest_aspace aspace;
 
+#ifdef CONFIG_GUEST_BOOT_STATS
+	/* Boot-time breakdown */
+	struct vmm_guest_boot_stats boot;
+#endif
+
 	/* Architecture specific context */
 	void *arch_priv;
 };
@@ -176,6 +240,80 @@ enum vmm_vcpu_states {
 #define VMM_VCPU_DEF_DEADLINE		(VMM_VCPU_DEF_TIME_SLICE * 10)
 #define VMM_VCPU_DEF_PERIODICITY	(VMM_VCPU_DEF_DEADLINE * 10)
 
+#define VMM_GUEST_MIN_SCHED_WEIGHT	1
+#define VMM_GUEST_MAX_SCHED_WEIGHT	65535
+#define VMM_GUEST_DEF_SCHED_WEIGHT	256
+#define VMM_GUEST_MAX_SCHED_CAP		100
+
+#define VMM_VCPU_REGION_CACHE_SIZE	4
+
+/** VM exit reasons accounted in VCPU exit statistics */
+enum vmm_vcpu_exit_reasons {
+	VMM_VCPU_EXIT_MMIO = 0,
+	VMM_VCPU_EXIT_WFI,
+	VMM_VCPU_EXIT_HYPCALL,
+	VMM_VCPU_EXIT_SYSREG,
+	VMM_VCPU_EXIT_IO,
+	VMM_VCPU_EXIT_IRQ,
+	VMM_VCPU_EXIT_OTHER,
+	VMM_VCPU_EXIT_MAX
+};
+
+/** Number of log2 buckets in VM exit handling time histogram
+ *  (bucket N counts exits handled in less than 256 << N nanoseconds
+ *  whereas last bucket counts all longer exits)
+ */
+#define VMM_VCPU_EXIT_HIST_BUCKETS	10
+
+/** Phases of VM exit handling accounted in VCPU exit statistics
+ *  (Note: Hardware trap and register save/restore done in assembly
+ *  are not covered so their cost is the round-trip time seen by Guest
+ *  minus sum of all phases)
+ */
+enum vmm_vcpu_exit_phases {
+	/* From VM exit upto start of emulation */
+	VMM_VCPU_EXIT_PHASE_DISPATCH = 0,
+	/* Emulation */
+	VMM_VCPU_EXIT_PHASE_EMULATE,
+	/* From end of emulation upto VM entry */
+	VMM_VCPU_EXIT_PHASE_RESTORE,
+	VMM_VCPU_EXIT_PHASE_MAX
+};
+
+/** VM exit statistics of a VCPU for one exit reason */
+struct vmm_vcpu_exit_stats {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+	u32 hist[VMM_VCPU_EXIT_HIST_BUCKETS];
+	u64 phase_ns[VMM_VCPU_EXIT_PHASE_MAX];
+};
+
+/** Types of scheduler latency tracked for a VCPU */
+enum vmm_vcpu_sched_latency_types {
+	/* Wakeup (RESET or PAUSED to READY) till RUNNING */
+	VMM_VCPU_SCHED_WAKEUP = 0,
+	/* Any READY till RUNNING, including preempted VCPUs */
+	VMM_VCPU_SCHED_RQWAIT,
+	/* RUNNING till switched out (i.e. time slice usage) */
+	VMM_VCPU_SCHED_SLICE,
+	VMM_VCPU_SCHED_MAX
+};
+
+/** Number of log2 buckets in scheduler latency histogram
+ *  (bucket N counts latencies less than 1024 << N nanoseconds
+ *  whereas last bucket counts all longer latencies)
+ */
+#define VMM_VCPU_SCHED_HIST_BUCKETS	16
+
+/** Scheduler latency statistics of a VCPU for one latency type */
+struct vmm_vcpu_sched_latency {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+	u32 hist[VMM_VCPU_SCHED_HIST_BUCKETS];
+};
+
 struct vmm_vcpu_resource {
 	struct dlist head;
 	const char *name;
@@ -213,13 +351,18 @@ struct vmm_vcpu {
 	u64 reset_tstamp;
 	u32 preempt_count;
 	bool resumed;
+	bool spinning;
+	u64 preempt_tstamp;
 	void *sched_priv;
 
 	/* Scheduler static context */
 	u8 priority;
+	u8 base_priority;
 	u64 time_slice;
 	u64 deadline;
 	u64 periodicity;
+	bool is_deadline;
+	u64 deadline_bw;
 
 	/* Architecture specific context */
 	arch_regs_t regs;
@@ -228,6 +371,11 @@ struct vmm_vcpu {
 	/* Virtual IRQ context */
 	struct vmm_vcpu_irqs irqs;
 
+	/* Guest region lookup cache */
+	u32 reg_cache_gen;
+	u32 reg_cache_next;
+	struct vmm_region *reg_cache[VMM_VCPU_REGION_CACHE_SIZE];
+
 	/* Resources acquired */
 	vmm_spinlock_t res_lock;
 	struct dlist res_head;
@@ -236,6 +384,19 @@ struct vmm_vcpu {
 	struct dlist wq_head;
 	vmm_spinlock_t *wq_lock;
 	void *wq_priv;
+
+#ifdef CONFIG_VCPU_EXIT_STATS
+	/* VM exit statistics */
+	struct vmm_vcpu_exit_stats exit_stats[VMM_VCPU_EXIT_MAX];
+	u32 exit_last_reason;
+	u64 exit_done_tstamp;
+#endif
+
+#ifdef CONFIG_SCHED_LATENCY
+	/* Scheduler latency statistics (updated with sched_lock held) */
+	bool sched_woken;
+	struct vmm_vcpu_sched_latency sched_latency[VMM_VCPU_SCHED_MAX];
+#endif
 };
 
 /** Acquire manager lock */
@@ -271,6 +432,76 @@ int vmm_manager_vcpu_stats(struct vmm_vcpu *vcpu,
 			   u64 *paused_nsecs,
 			   u64 *halted_nsecs);
 
+/** Steal time of a VCPU (i.e. time spent in READY state waiting for
+ *  a host CPU) in nanoseconds since last reset
+ *  (Note: Only consistent for current VCPU of calling host CPU)
+ */
+static inline u64 vmm_manager_vcpu_steal_nsecs(struct vmm_vcpu *vcpu)
+{
+	return vcpu->state_ready_nsecs;
+}
+
+#ifdef CONFIG_VCPU_EXIT_STATS
+/** Timestamp to be passed to vmm_manager_vcpu_exit_account()
+ *  (Note: To be called from architecture specific code on VM exit)
+ */
+u64 vmm_manager_vcpu_exit_tstamp(void);
+
+/** Account a VM exit of a VCPU which was entered at given timestamp
+ *  and whose emulation was started at given emulate timestamp
+ *  (Note: To be called from architecture specific code when VM exit
+ *  emulation is done)
+ */
+void vmm_manager_vcpu_exit_account(struct vmm_vcpu *vcpu, u32 reason,
+				   u64 tstamp, u64 emulate_tstamp);
+
+/** Account restore phase of last VM exit accounted for a VCPU
+ *  (Note: To be called from architecture specific code just before
+ *  VM entry)
+ */
+void vmm_manager_vcpu_exit_return(struct vmm_vcpu *vcpu);
+
+/** Name of VM exit reason */
+const char *vmm_manager_vcpu_exit_name(u32 reason);
+
+/** Name of VM exit phase */
+const char *vmm_manager_vcpu_exit_phase_name(u32 phase);
+
+/** Retrive VM exit statistics of a VCPU for given exit reason */
+int vmm_manager_vcpu_exit_stats(struct vmm_vcpu *vcpu, u32 reason,
+				struct vmm_vcpu_exit_stats *stats);
+
+/** Reset VM exit statistics of a VCPU */
+int vmm_manager_vcpu_exit_stats_reset(struct vmm_vcpu *vcpu);
+#else
+static inline u64 vmm_manager_vcpu_exit_tstamp(void)
+{
+	return 0;
+}
+
+static inline void vmm_manager_vcpu_exit_account(struct vmm_vcpu *vcpu,
+						 u32 reason, u64 tstamp,
+						 u64 emulate_tstamp)
+{
+}
+
+static inline void vmm_manager_vcpu_exit_return(struct vmm_vcpu *vcpu)
+{
+}
+#endif
+
+#ifdef CONFIG_SCHED_LATENCY
+/** Name of scheduler latency type */
+const char *vmm_manager_vcpu_sched_latency_name(u32 type);
+
+/** Retrive scheduler latency statistics of a VCPU for given type */
+int vmm_manager_vcpu_sched_latency(struct vmm_vcpu *vcpu, u32 type,
+				   struct vmm_vcpu_sched_latency *lat);
+
+/** Reset scheduler latency statistics of a VCPU */
+int vmm_manager_vcpu_sched_latency_reset(struct vmm_vcpu *vcpu);
+#endif
+
 /** Retriver VCPU state */
 u32 vmm_manager_vcpu_get_state(struct vmm_vcpu *vcpu);
 
@@ -334,14 +565,18 @@ int vmm_manager_vcpu_resource_add(struct vmm_vcpu *vcpu,
 int vmm_manager_vcpu_resource_remove(struct vmm_vcpu *vcpu,
 				     struct vmm_vcpu_resource *res);
 
-/** Create an orphan VCPU */
+/** Create an orphan VCPU
+ *  Note: Deadline class VCPU gets time_slice nsecs every periodicity
+ *  nsecs and it is only created if this bandwidth can be admitted
+ */
 struct vmm_vcpu *vmm_manager_vcpu_orphan_create(const char *name,
 					    virtual_addr_t start_pc,
 					    virtual_size_t stack_sz,
 					    u8 priority,
 					    u64 time_slice_nsecs,
 					    u64 deadline,
-					    u64 periodicity);
+					    u64 periodicity,
+					    bool is_deadline);
 
 /** Destroy an orphan VCPU */
 int vmm_manager_vcpu_orphan_destroy(struct vmm_vcpu *vcpu);
@@ -392,6 +627,60 @@ int vmm_manager_guest_reset(struct vmm_guest *guest);
 /** Last Reset timestamp of a Guest */
 u64 vmm_manager_guest_reset_timestamp(struct vmm_guest *guest);
 
+#ifdef CONFIG_GUEST_BOOT_STATS
+/** Record timestamp of given boot phase of a Guest
+ *  (Note: Only to be called via vmm_manager_guest_boot_mark())
+ */
+void __vmm_manager_guest_boot_mark(struct vmm_guest *guest, u32 phase);
+
+/** Record timestamp of given boot phase of a Guest if not yet reached
+ *  (Note: VMM_GUEST_BOOT_IMAGE_LOADED is recorded every time so that
+ *  it gives completion of last image load)
+ */
+static inline void vmm_manager_guest_boot_mark(struct vmm_guest *guest,
+					       u32 phase)
+{
+	if (guest && ((phase == VMM_GUEST_BOOT_IMAGE_LOADED) ||
+		      unlikely(!guest->boot.tstamp[phase]))) {
+		__vmm_manager_guest_boot_mark(guest, phase);
+	}
+}
+
+/** Account a stage2 (nested page table) fault of a Guest
+ *  (Note: To be called from architecture specific code)
+ */
+void vmm_manager_guest_boot_fault(struct vmm_guest *guest);
+
+/** Width of stage2 fault time slot in nanoseconds */
+u64 vmm_manager_guest_boot_fault_slot_nsecs(void);
+
+/** Name of Guest boot phase */
+const char *vmm_manager_guest_boot_phase_name(u32 phase);
+
+/** Retrive boot-time breakdown of a Guest */
+int vmm_manager_guest_boot_stats(struct vmm_guest *guest,
+				 struct vmm_guest_boot_stats *stats);
+#else
+static inline void vmm_manager_guest_boot_mark(struct vmm_guest *guest,
+					       u32 phase)
+{
+}
+
+static inline void vmm_manager_guest_boot_fault(struct vmm_guest *guest)
+{
+}
+#endif
+
+/** Retrive scheduling weight and cap (percentage of one host CPU,
+ *  zero means no cap) of a Guest
+ */
+int vmm_manager_guest_get_sched(struct vmm_guest *guest,
+				u32 *weight, u32 *cap);
+
+/** Update scheduling weight and cap of a Guest */
+int vmm_manager_guest_set_sched(struct vmm_guest *guest,
+				u32 weight, u32 cap);
+
 /** Kick a Guest out of reset state */
 int vmm_manager_guest_kick(struct vmm_guest *guest);
 
@@ -429,6 +718,24 @@ int vmm_manager_guest_shutdown_request(struct vmm_guest *guest);
 /** Create a Guest based on device tree configuration */
 struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode);
 
+/** Create multiple Guests concurrently on system workqueues and
+ *  wait for all of them. The guests array (if not NULL) gets created
+ *  Guest or NULL for each Guest node. Guests having a template are
+ *  created after other Guests of the batch.
+ *  @returns number of Guests created
+ */
+u32 vmm_manager_guest_create_batch(struct vmm_devtree_node **gnodes,
+				   struct vmm_guest **guests, u32 count);
+
+/** Create a clone of template Guest with given name
+ *  Alloced ROM regions of the clone share host RAM of the template
+ *  whereas alloced RAM regions are copied from the template hence all
+ *  VCPUs of the template must be in reset, paused or halted state.
+ *  (Note: Template Guest cannot be destroyed while it has clones)
+ */
+struct vmm_guest *vmm_manager_guest_clone(struct vmm_guest *tmpl,
+					  const char *name);
+
 /** Destroy a Guest */
 int vmm_manager_guest_destroy(struct vmm_guest *guest);
 
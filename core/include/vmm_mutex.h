@@ -26,6 +26,9 @@
 
 #include <vmm_types.h>
 #include <vmm_waitqueue.h>
+#ifdef CONFIG_LOCKSTAT
+#include <vmm_lockstat.h>
+#endif
 
 /** Mutex lock structure */
 struct vmm_mutex {
@@ -33,6 +36,10 @@ struct vmm_mutex {
 	struct vmm_vcpu_resource res;
 	struct vmm_vcpu *owner;
 	struct vmm_waitqueue wq;
+#ifdef CONFIG_LOCKSTAT
+	struct vmm_lockstat_class *__class;
+	u64 __hold_tstamp;
+#endif
 };
 
 /** Cleanup callback for mutex when VCPU is destroyed
@@ -41,6 +48,17 @@ struct vmm_mutex {
 void __vmm_mutex_cleanup(struct vmm_vcpu *vcpu,
 			 struct vmm_vcpu_resource *vcpu_res);
 
+#ifdef CONFIG_LOCKSTAT
+#define __INIT_MUTEX_LOCKSTAT(__mut)	\
+do { \
+	static struct vmm_lockstat_class __lsc = \
+		VMM_LOCKSTAT_CLASS_INITIALIZER(#__mut, VMM_LOCKSTAT_MUTEX); \
+	(__mut)->__class = &__lsc; \
+} while (0)
+#else
+#define __INIT_MUTEX_LOCKSTAT(__mut)	do { } while (0)
+#endif
+
 /** Initialize mutex lock */
 #define INIT_MUTEX(__mut)	\
 do { \
@@ -49,6 +67,7 @@ do { \
 	(__mut)->res.cleanup = __vmm_mutex_cleanup; \
 	(__mut)->owner = NULL; \
 	INIT_WAITQUEUE(&(__mut)->wq, (__mut)); \
+	__INIT_MUTEX_LOCKSTAT(__mut); \
 } while (0)
 
 #define __MUTEX_INITIALIZER(__mut) \
@@ -59,6 +59,37 @@ extern virtual_addr_t __percpu_offset[CONFIG_CPU_COUNT];
 
 #define put_cpu_var(var)
 
+/** Per-cpu counter
+ *  Each host CPU updates its own slot of the counter without locks or
+ *  atomics whereas reading the counter adds up slots of all host CPUs.
+ */
+struct vmm_percpu_counter {
+	u32 slot;
+};
+
+/** Initialize (allocate) per-cpu counter with zero value
+ *  Note: Upon failure, per-cpu counter is usable but never counts
+ */
+int vmm_percpu_counter_init(struct vmm_percpu_counter *pcc);
+
+/** Destroy (free) per-cpu counter */
+void vmm_percpu_counter_destroy(struct vmm_percpu_counter *pcc);
+
+/** Add to per-cpu counter (Note: Can be called from any context) */
+void vmm_percpu_counter_add(struct vmm_percpu_counter *pcc, u64 val);
+
+/** Increment per-cpu counter (Note: Can be called from any context) */
+static inline void vmm_percpu_counter_inc(struct vmm_percpu_counter *pcc)
+{
+	vmm_percpu_counter_add(pcc, 1);
+}
+
+/** Read per-cpu counter by adding up slots of all host CPUs */
+u64 vmm_percpu_counter_read(struct vmm_percpu_counter *pcc);
+
+/** Reset per-cpu counter to zero */
+void vmm_percpu_counter_reset(struct vmm_percpu_counter *pcc);
+
 /** Retrive per-cpu offset of current cpu */
 virtual_addr_t vmm_percpu_current_offset(void);
 
@@ -42,6 +42,25 @@ struct vmm_profiler_stat {
         struct vmm_profiler_counter counter[VMM_PROFILE_ARRAY_SIZE];
 };
 
+/** Context of host CPU when a profiler sample was taken */
+enum vmm_profiler_sample_context {
+	VMM_PROFILE_CTX_IRQ=0,
+	VMM_PROFILE_CTX_ORPHAN,
+	VMM_PROFILE_CTX_NORMAL,
+	VMM_PROFILE_CTX_GUEST,
+	VMM_PROFILE_CTX_MAX
+};
+
+#define VMM_PROFILE_NO_VCPU		0xffffffff
+
+struct vmm_profiler_sample {
+	u64 tstamp;
+	virtual_addr_t host_pc;
+	virtual_addr_t guest_pc;
+	u32 vcpu_id;
+	u32 context;
+};
+
 /**
  * Check status of function level profiling.
  * Called from somewhere (usually cmd_profile).
@@ -65,6 +84,32 @@ int vmm_profiler_stop(void);
  */
 struct vmm_profiler_stat *vmm_profiler_get_stat_array(void);
 
+/**
+ * Check status of statistical sampling.
+ */
+bool vmm_profiler_sample_isactive(void);
+
+/**
+ * Start statistical sampling on all online host CPUs.
+ * Samples are taken freq_hz times per second on each host CPU
+ * (CONFIG_PROFILE_SAMPLE_HZ if freq_hz is zero).
+ */
+int vmm_profiler_sample_start(u32 freq_hz);
+
+/**
+ * Stop statistical sampling. Samples are kept till next start.
+ */
+int vmm_profiler_sample_stop(void);
+
+/**
+ * Copy upto max samples of given host CPU (oldest first) into
+ * buffer and return number of samples copied. The number of
+ * samples overwritten due to ring buffer overflow is returned
+ * in lost (if not NULL).
+ */
+u32 vmm_profiler_sample_read(u32 cpu, struct vmm_profiler_sample *buf,
+			     u32 max, u32 *lost);
+
 /**
  * Initialize Profiler. 
  * Called from vmm_init() 
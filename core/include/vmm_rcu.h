@@ -0,0 +1,109 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_rcu.h
+ * @author agent (agent@local)
+ * @brief Read-copy-update (RCU) interface
+ *
+ * Readers only disable preemption hence they are wait-free and never
+ * write shared memory. A host CPU passes through a quiescent state
+ * whenever scheduler runs on it with preemption enabled so once every
+ * online host CPU passed through a quiescent state all readers which
+ * existed before are done. Readers must not sleep.
+ */
+
+#ifndef __VMM_RCU_H__
+#define __VMM_RCU_H__
+
+#include <vmm_types.h>
+#include <vmm_scheduler.h>
+#include <arch_barrier.h>
+#include <libs/list.h>
+
+/** RCU callback head (embedded in RCU protected object) */
+struct vmm_rcu_head {
+	struct dlist head;
+	void (*func)(struct vmm_rcu_head *rhead);
+};
+
+/** Start RCU read-side critical section */
+static inline void vmm_rcu_read_lock(void)
+{
+	vmm_scheduler_preempt_disable();
+}
+
+/** End RCU read-side critical section */
+static inline void vmm_rcu_read_unlock(void)
+{
+	vmm_scheduler_preempt_enable();
+}
+
+/** Fetch RCU protected pointer (Note: only for readers) */
+#define vmm_rcu_dereference(p)		(*(typeof(p) volatile *)&(p))
+
+/** Publish RCU protected pointer (Note: only for updaters) */
+#define vmm_rcu_assign_pointer(p, v)	\
+do {					\
+	arch_smp_wmb();			\
+	(p) = (v);			\
+} while (0)
+
+/** Add list entry before given list node for RCU readers */
+static inline void list_add_tail_rcu(struct dlist *new, struct dlist *tnode)
+{
+	new->prev = tnode->prev;
+	new->next = tnode;
+	arch_smp_wmb();
+	tnode->prev->next = new;
+	tnode->prev = new;
+}
+
+/** Delete list entry while RCU readers might still be walking over it
+ *  Note: The entry can only be freed after a grace period.
+ */
+static inline void list_del_rcu(struct dlist *entry)
+{
+	__list_del(entry->prev, entry->next);
+	entry->prev = (void *)LIST_POISON_PREV;
+}
+
+/** Iterate over RCU protected list (Note: only for readers) */
+#define list_for_each_entry_rcu(pos, head, member)			\
+	for (pos = list_entry(vmm_rcu_dereference((head)->next),	\
+			      typeof(*pos), member);			\
+	     &pos->member != (head);					\
+	     pos = list_entry(vmm_rcu_dereference(pos->member.next),	\
+			      typeof(*pos), member))
+
+/** Note quiescent state of current host CPU
+ *  Note: This function should only be called by scheduler.
+ */
+void vmm_rcu_quiescent_state(void);
+
+/** Wait for all existing RCU readers to finish (i.e. grace period)
+ *  Note: This can only be called from Orphan (or Thread) context.
+ */
+void vmm_rcu_synchronize(void);
+
+/** Call given function on RCU callback head after a grace period
+ *  Note: This can be called from any context.
+ */
+void vmm_rcu_call(struct vmm_rcu_head *rhead,
+		  void (*func)(struct vmm_rcu_head *rhead));
+
+#endif /* __VMM_RCU_H__ */
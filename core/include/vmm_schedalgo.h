@@ -26,6 +26,50 @@
 #include <vmm_types.h>
 #include <vmm_manager.h>
 
+/** Scheduling algorithm instance */
+struct vmm_schedalgo {
+	const char *name;
+	int (*vcpu_setup) (struct vmm_vcpu *vcpu);
+	int (*vcpu_cleanup) (struct vmm_vcpu *vcpu);
+	int (*rq_enqueue) (void *rq, struct vmm_vcpu *vcpu);
+	int (*rq_dequeue) (void *rq,
+			   struct vmm_vcpu **next,
+			   u64 *next_time_slice);
+	int (*rq_detach) (void *rq, struct vmm_vcpu *vcpu);
+	bool (*rq_prempt_needed) (void *rq, struct vmm_vcpu *current);
+	void *(*rq_create) (void);
+	int (*rq_destroy) (void *rq);
+	int (*rq_length) (void *rq, u8 priority);
+};
+
+#ifdef CONFIG_SCHEDALGO_PRR
+extern const struct vmm_schedalgo vmm_schedalgo_prr;
+#endif
+#ifdef CONFIG_SCHEDALGO_PRM
+extern const struct vmm_schedalgo vmm_schedalgo_prm;
+#endif
+#ifdef CONFIG_SCHEDALGO_FAIR
+extern const struct vmm_schedalgo vmm_schedalgo_fair;
+#endif
+#ifdef CONFIG_SCHEDALGO_EDF
+extern const struct vmm_schedalgo vmm_schedalgo_edf;
+#endif
+
+/** Name of scheduling algorithm in use */
+const char *vmm_schedalgo_name(void);
+
+/** Number of available scheduling algorithms */
+u32 vmm_schedalgo_count(void);
+
+/** Name of available scheduling algorithm at given index */
+const char *vmm_schedalgo_get_name(u32 index);
+
+/** Select scheduling algorithm by name
+ *  Note: This can only be done before scheduler is initialized
+ *  (i.e. using "schedalgo=" early boot parameter).
+ */
+int vmm_schedalgo_select(const char *name);
+
 /** Setup newly created VCPU for scheduling algorithm */
 int vmm_schedalgo_vcpu_setup(struct vmm_vcpu *vcpu);
 
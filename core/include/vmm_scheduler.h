@@ -53,6 +53,11 @@ bool vmm_scheduler_check_current_hcpu(struct vmm_vcpu *vcpu);
 /** Update host CPU assigned to given VCPU */
 int vmm_scheduler_set_hcpu(struct vmm_vcpu *vcpu, u32 hcpu);
 
+/** Change current priority of a VCPU
+ *  Note: This does not change base priority of VCPU
+ */
+int vmm_scheduler_set_priority(struct vmm_vcpu *vcpu, u8 priority);
+
 /** Enter IRQ Context (Must be called from somewhere) */
 void vmm_scheduler_irq_enter(arch_regs_t *regs, bool vcpu_context);
 
@@ -62,6 +67,11 @@ void vmm_scheduler_irq_exit(arch_regs_t *regs);
 /** Check whether we are in IRQ context */
 bool vmm_scheduler_irq_context(void);
 
+/** Get registers saved on entry to current IRQ context
+ *  (NULL if we are not in IRQ context)
+ */
+arch_regs_t *vmm_scheduler_irq_regs(void);
+
 /** Check whether we are in Orphan VCPU context */
 bool vmm_scheduler_orphan_context(void);
 
@@ -95,9 +105,44 @@ u8 vmm_scheduler_current_priority(void);
 /** Retrive current guest */
 struct vmm_guest *vmm_scheduler_current_guest(void);
 
-/** Yield current vcpu (Should not be called in IRQ context) */
+#ifdef CONFIG_SCHED_LATENCY
+/** VCPU ID recorded in context switch trace when there is no VCPU */
+#define VMM_SCHEDULER_TRACE_NO_VCPU	0xFFFFFFFF
+
+/** Context switch trace record */
+struct vmm_scheduler_trace {
+	u64 tstamp;
+	u32 prev_id;
+	u32 prev_state;
+	u32 next_id;
+	u32 next_priority;
+};
+
+/** Copy upto max context switch trace records of given host CPU
+ *  (oldest first) into buffer and return number of records copied.
+ *  The number of records overwritten due to ring buffer overflow
+ *  is returned via lost (if not NULL).
+ */
+u32 vmm_scheduler_trace_read(u32 hcpu, struct vmm_scheduler_trace *buf,
+			     u32 max, u32 *lost);
+
+/** Clear context switch trace of given host CPU */
+void vmm_scheduler_trace_clear(u32 hcpu);
+#endif
+
+/** Yield current vcpu (Should not be called in IRQ context)
+ *  Note: With CONFIG_SCHED_DIRECTED_YIELD a Guest VCPU yields to
+ *  a preempted sibling VCPU of the same Guest (if any)
+ */
 void vmm_scheduler_yield(void);
 
+/** Yield current Guest VCPU which is spinning on a contended lock
+ *  (i.e. WFE trap or Pause-Loop exit). The VCPU is not picked as
+ *  directed yield target by its siblings until it runs again.
+ *  (Should not be called in IRQ context)
+ */
+void vmm_scheduler_yield_spin(void);
+
 /** Initialize scheduler */
 int vmm_scheduler_init(void);
 
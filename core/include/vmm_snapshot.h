@@ -0,0 +1,148 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_snapshot.h
+ * @author agent (agent@local)
+ * @brief Guest snapshot interface
+ *
+ * A guest snapshot is a sequence of records (VCPU state, emulated
+ * device state and guest RAM) written to and read from a stream.
+ * Guest RAM pages which are all zeros are not saved. Snapshots are
+ * only meant to be restored by same hypervisor build into a guest
+ * created from same device tree configuration.
+ */
+
+#ifndef __VMM_SNAPSHOT_H__
+#define __VMM_SNAPSHOT_H__
+
+#include <vmm_limits.h>
+#include <vmm_types.h>
+
+#define VMM_SNAPSHOT_MAGIC		0x504E5358 /* "XSNP" */
+#define VMM_SNAPSHOT_VERSION		1
+
+enum vmm_snapshot_record_types {
+	VMM_SNAPSHOT_RECORD_END=0,
+	VMM_SNAPSHOT_RECORD_VCPU=1,
+	VMM_SNAPSHOT_RECORD_EMUDEV=2,
+	VMM_SNAPSHOT_RECORD_RAM=3,
+};
+
+/** Snapshot header (first bytes of stream) */
+struct vmm_snapshot_header {
+	u32 magic;
+	u32 version;
+	u32 vcpu_count;
+	u32 reserved;
+	char guest_name[VMM_FIELD_NAME_SIZE];
+} __packed;
+
+/** Snapshot record header (followed by len bytes of record data)
+ *  (Note: addr is VCPU subid for VCPU records and guest physical
+ *  address for emulated device and RAM records)
+ *  (Note: flags is VMM_REGION_MEMORY or VMM_REGION_IO for emulated
+ *  device records)
+ */
+struct vmm_snapshot_record {
+	u32 type;
+	u32 flags;
+	u64 addr;
+	u64 len;
+} __packed;
+
+/** Snapshot stream
+ *  (Note: write is used for save and read is used for restore.
+ *  Both return number of bytes transferred.)
+ */
+struct vmm_snapshot_stream {
+	void *priv;
+	size_t (*read) (void *priv, void *buf, size_t len);
+	size_t (*write) (void *priv, const void *buf, size_t len);
+};
+
+/** In-memory state of one VCPU or emulated device
+ *  (Note: Filled using vmm_snapshot_put() while saving and
+ *  consumed using vmm_snapshot_get() while restoring)
+ */
+struct vmm_snapshot_state {
+	u8 *buf;
+	size_t len;
+	size_t pos;
+	size_t size;
+};
+
+/** Append data to snapshot state */
+int vmm_snapshot_put(struct vmm_snapshot_state *st,
+		     const void *data, size_t len);
+
+/** Consume data from snapshot state
+ *  (Note: Returns VMM_EINVALID if state does not have enough data)
+ */
+int vmm_snapshot_get(struct vmm_snapshot_state *st,
+		     void *data, size_t len);
+
+/** Append a variable to snapshot state */
+#define vmm_snapshot_put_var(__st, __var)	\
+		vmm_snapshot_put((__st), &(__var), sizeof(__var))
+
+/** Consume a variable from snapshot state */
+#define vmm_snapshot_get_var(__st, __var)	\
+		vmm_snapshot_get((__st), &(__var), sizeof(__var))
+
+/** Live save parameters and results */
+struct vmm_snapshot_live {
+	/* Maximum pre-copy rounds (0 means stop-and-copy only) */
+	u32 max_rounds;
+	/* Pre-copy stops once remaining dirty pages can be sent
+	 * within this many milliseconds at last measured rate
+	 */
+	u32 downtime_ms;
+	/* Number of pre-copy rounds done (filled by live save) */
+	u32 rounds;
+	/* Time for which Guest was paused (filled by live save) */
+	u64 downtime_ns;
+};
+
+struct vmm_guest;
+
+/** Save snapshot of a Guest to given stream
+ *  (Note: All VCPUs of Guest must be paused, halted or in reset state)
+ *  (Note: Emulated devices without save operation are skipped and
+ *  will be in reset state after restore)
+ */
+int vmm_snapshot_guest_save(struct vmm_guest *guest,
+			    struct vmm_snapshot_stream *stream);
+
+/** Save snapshot of a running Guest to given stream using pre-copy
+ *  of dirty logged Guest RAM. The Guest is paused only for the final
+ *  stop-and-copy round and remains paused after successful save.
+ *  (Note: Stream is restored using vmm_snapshot_guest_restore())
+ */
+int vmm_snapshot_guest_save_live(struct vmm_guest *guest,
+				 struct vmm_snapshot_stream *stream,
+				 struct vmm_snapshot_live *live);
+
+/** Restore snapshot of a Guest from given stream
+ *  (Note: All VCPUs of Guest must be in reset state)
+ *  (Note: VCPUs which were not in reset state when snapshot was
+ *  saved are kicked after successful restore)
+ */
+int vmm_snapshot_guest_restore(struct vmm_guest *guest,
+			       struct vmm_snapshot_stream *stream);
+
+#endif /* __VMM_SNAPSHOT_H__ */
@@ -29,7 +29,43 @@
 #include <arch_locks.h>
 #include <vmm_types.h>
 
-#if defined(CONFIG_SMP)
+#if defined(CONFIG_SMP) && defined(CONFIG_LOCKSTAT)
+
+#include <vmm_lockstat.h>
+
+struct vmm_spinlock {
+	arch_spinlock_t __tlock;
+	struct vmm_lockstat_class *__class;
+	u64 __hold_tstamp;
+};
+
+#define INIT_SPIN_LOCK(_lptr)		do { \
+		static struct vmm_lockstat_class __lsc = \
+			VMM_LOCKSTAT_CLASS_INITIALIZER(#_lptr, \
+						VMM_LOCKSTAT_SPINLOCK); \
+		ARCH_SPIN_LOCK_INIT(&((_lptr)->__tlock)); \
+		(_lptr)->__class = &__lsc; \
+		} while (0)
+#define __SPINLOCK_INITIALIZER(_lock) 	\
+		{ .__tlock = ARCH_SPIN_LOCK_INITIALIZER, .__class = NULL, }
+
+struct vmm_rwlock {
+	arch_rwlock_t __tlock;
+	struct vmm_lockstat_class *__class;
+	u64 __hold_tstamp;
+};
+
+#define INIT_RW_LOCK(_lptr)		do { \
+		static struct vmm_lockstat_class __lsc = \
+			VMM_LOCKSTAT_CLASS_INITIALIZER(#_lptr, \
+						VMM_LOCKSTAT_RWLOCK); \
+		ARCH_RW_LOCK_INIT(&((_lptr)->__tlock)); \
+		(_lptr)->__class = &__lsc; \
+		} while (0)
+#define __RWLOCK_INITIALIZER(_lock) 	\
+		{ .__tlock = ARCH_RW_LOCK_INITIALIZER, .__class = NULL, }
+
+#elif defined(CONFIG_SMP)
 
 /*
  * FIXME: With SMP should rather be holding
@@ -85,6 +121,42 @@ typedef struct vmm_rwlock vmm_rwlock_t;
 extern void vmm_scheduler_preempt_disable(void);
 extern void vmm_scheduler_preempt_enable(void);
 
+/*
+ * With CONFIG_LOCKSTAT all lock operations on SMP go through lock
+ * statistics accounting whereas otherwise they map to arch locks.
+ */
+#if defined(CONFIG_SMP) && defined(CONFIG_LOCKSTAT)
+void __vmm_lockstat_spin_lock(vmm_spinlock_t *lock);
+int __vmm_lockstat_spin_trylock(vmm_spinlock_t *lock);
+void __vmm_lockstat_spin_unlock(vmm_spinlock_t *lock);
+void __vmm_lockstat_write_lock(vmm_rwlock_t *lock);
+int __vmm_lockstat_write_trylock(vmm_rwlock_t *lock);
+void __vmm_lockstat_write_unlock(vmm_rwlock_t *lock);
+void __vmm_lockstat_read_lock(vmm_rwlock_t *lock);
+int __vmm_lockstat_read_trylock(vmm_rwlock_t *lock);
+void __vmm_lockstat_read_unlock(vmm_rwlock_t *lock);
+
+#define __vmm_spin_acquire(lock)	__vmm_lockstat_spin_lock(lock)
+#define __vmm_spin_tryacquire(lock)	__vmm_lockstat_spin_trylock(lock)
+#define __vmm_spin_release(lock)	__vmm_lockstat_spin_unlock(lock)
+#define __vmm_write_acquire(lock)	__vmm_lockstat_write_lock(lock)
+#define __vmm_write_tryacquire(lock)	__vmm_lockstat_write_trylock(lock)
+#define __vmm_write_release(lock)	__vmm_lockstat_write_unlock(lock)
+#define __vmm_read_acquire(lock)	__vmm_lockstat_read_lock(lock)
+#define __vmm_read_tryacquire(lock)	__vmm_lockstat_read_trylock(lock)
+#define __vmm_read_release(lock)	__vmm_lockstat_read_unlock(lock)
+#elif defined(CONFIG_SMP)
+#define __vmm_spin_acquire(lock)	arch_spin_lock(&(lock)->__tlock)
+#define __vmm_spin_tryacquire(lock)	arch_spin_trylock(&(lock)->__tlock)
+#define __vmm_spin_release(lock)	arch_spin_unlock(&(lock)->__tlock)
+#define __vmm_write_acquire(lock)	arch_write_lock(&(lock)->__tlock)
+#define __vmm_write_tryacquire(lock)	arch_write_trylock(&(lock)->__tlock)
+#define __vmm_write_release(lock)	arch_write_unlock(&(lock)->__tlock)
+#define __vmm_read_acquire(lock)	arch_read_lock(&(lock)->__tlock)
+#define __vmm_read_tryacquire(lock)	arch_read_trylock(&(lock)->__tlock)
+#define __vmm_read_release(lock)	arch_read_unlock(&(lock)->__tlock)
+#endif
+
 /** Check status of spinlock (TRUE: Locked, FALSE: Unlocked)
  *  PROTOTYPE: bool vmm_spin_lock_check(vmm_spinlock_t *lock)
  */
@@ -104,15 +176,15 @@ extern void vmm_scheduler_preempt_enable(void);
 #if defined(CONFIG_SMP)
 #define vmm_spin_lock(lock)		do { \
 					vmm_scheduler_preempt_disable(); \
-					arch_spin_lock(&(lock)->__tlock); \
+					__vmm_spin_acquire(lock); \
 					} while (0)
 #define vmm_write_lock(lock)		do { \
 					vmm_scheduler_preempt_disable(); \
-					arch_write_lock(&(lock)->__tlock); \
+					__vmm_write_acquire(lock); \
 					} while (0)
 #define vmm_read_lock(lock)		do { \
 					vmm_scheduler_preempt_disable(); \
-					arch_read_lock(&(lock)->__tlock); \
+					__vmm_read_acquire(lock); \
 					} while (0)
 #else
 #define vmm_spin_lock(lock)		do { \
@@ -130,7 +202,7 @@ extern void vmm_scheduler_preempt_enable(void);
 #define vmm_spin_trylock(lock)		({ \
 					int ret; \
 					vmm_scheduler_preempt_disable(); \
-					ret = arch_spin_trylock(&(lock)->__tlock); \
+					ret = __vmm_spin_tryacquire(lock); \
 					if (!ret) { \
 						vmm_scheduler_preempt_enable(); \
 					} \
@@ -139,7 +211,7 @@ extern void vmm_scheduler_preempt_enable(void);
 #define vmm_write_trylock(lock)		({ \
 					int ret; \
 					vmm_scheduler_preempt_disable(); \
-					ret = arch_write_trylock(&(lock)->__tlock); \
+					ret = __vmm_write_tryacquire(lock); \
 					if (!ret) { \
 						vmm_scheduler_preempt_enable(); \
 					} \
@@ -148,7 +220,7 @@ extern void vmm_scheduler_preempt_enable(void);
 #define vmm_read_trylock(lock)		({ \
 					int ret; \
 					vmm_scheduler_preempt_disable(); \
-					ret = arch_read_trylock(&(lock)->__tlock); \
+					ret = __vmm_read_tryacquire(lock); \
 					if (!ret) { \
 						vmm_scheduler_preempt_enable(); \
 					} \
@@ -176,15 +248,15 @@ extern void vmm_scheduler_preempt_enable(void);
  */
 #if defined(CONFIG_SMP)
 #define vmm_spin_unlock(lock)		do { \
-					arch_spin_unlock(&(lock)->__tlock); \
+					__vmm_spin_release(lock); \
 					vmm_scheduler_preempt_enable(); \
 					} while (0)
 #define vmm_write_unlock(lock)		do { \
-					arch_write_unlock(&(lock)->__tlock); \
+					__vmm_write_release(lock); \
 					vmm_scheduler_preempt_enable(); \
 					} while (0)
 #define vmm_read_unlock(lock)		do { \
-					arch_read_unlock(&(lock)->__tlock); \
+					__vmm_read_release(lock); \
 					vmm_scheduler_preempt_enable(); \
 					} while (0)
 #else
@@ -201,13 +273,13 @@ extern void vmm_scheduler_preempt_enable(void);
  */
 #if defined(CONFIG_SMP)
 #define vmm_spin_lock_lite(lock)	do { \
-					arch_spin_lock(&(lock)->__tlock); \
+					__vmm_spin_acquire(lock); \
 					} while (0)
 #define vmm_write_lock_lite(lock)	do { \
-					arch_write_lock(&(lock)->__tlock); \
+					__vmm_write_acquire(lock); \
 					} while (0)
 #define vmm_read_lock_lite(lock)	do { \
-					arch_read_lock(&(lock)->__tlock); \
+					__vmm_read_acquire(lock); \
 					} while (0)
 #else
 #define vmm_spin_lock_lite(lock)	do { \
@@ -222,13 +294,13 @@ extern void vmm_scheduler_preempt_enable(void);
  */
 #if defined(CONFIG_SMP)
 #define vmm_spin_unlock_lite(lock)	do { \
-					arch_spin_unlock(&(lock)->__tlock); \
+					__vmm_spin_release(lock); \
 					} while (0)
 #define vmm_write_unlock_lite(lock)	do { \
-					arch_write_unlock(&(lock)->__tlock); \
+					__vmm_write_release(lock); \
 					} while (0)
 #define vmm_read_unlock_lite(lock)	do { \
-					arch_read_unlock(&(lock)->__tlock); \
+					__vmm_read_release(lock); \
 					} while (0)
 #else
 #define vmm_spin_unlock_lite(lock)	do { \
@@ -245,17 +317,17 @@ extern void vmm_scheduler_preempt_enable(void);
 #define vmm_spin_lock_irq(lock) 	do { \
 					arch_cpu_irq_disable(); \
 					vmm_scheduler_preempt_disable(); \
-					arch_spin_lock(&(lock)->__tlock); \
+					__vmm_spin_acquire(lock); \
 					} while (0)
 #define vmm_write_lock_irq(lock) 	do { \
 					arch_cpu_irq_disable(); \
 					vmm_scheduler_preempt_disable(); \
-					arch_write_lock(&(lock)->__tlock); \
+					__vmm_write_acquire(lock); \
 					} while (0)
 #define vmm_read_lock_irq(lock) 	do { \
 					arch_cpu_irq_disable(); \
 					vmm_scheduler_preempt_disable(); \
-					arch_read_lock(&(lock)->__tlock); \
+					__vmm_read_acquire(lock); \
 					} while (0)
 #else
 #define vmm_spin_lock_irq(lock) 	do { \
@@ -272,17 +344,17 @@ extern void vmm_scheduler_preempt_enable(void);
  */
 #if defined(CONFIG_SMP)
 #define vmm_spin_unlock_irq(lock)	do { \
-					arch_spin_unlock(&(lock)->__tlock); \
+					__vmm_spin_release(lock); \
 					vmm_scheduler_preempt_enable(); \
 					arch_cpu_irq_enable(); \
 					} while (0)
 #define vmm_write_unlock_irq(lock)	do { \
-					arch_write_unlock(&(lock)->__tlock); \
+					__vmm_write_release(lock); \
 					vmm_scheduler_preempt_enable(); \
 					arch_cpu_irq_enable(); \
 					} while (0)
 #define vmm_read_unlock_irq(lock)	do { \
-					arch_read_unlock(&(lock)->__tlock); \
+					__vmm_read_release(lock); \
 					vmm_scheduler_preempt_enable(); \
 					arch_cpu_irq_enable(); \
 					} while (0)
@@ -306,7 +378,7 @@ extern void vmm_scheduler_preempt_enable(void);
 					int ret; \
 					arch_cpu_irq_save((flags)); \
 					vmm_scheduler_preempt_disable(); \
-					ret = arch_spin_trylock(&(lock)->__tlock); \
+					ret = __vmm_spin_tryacquire(lock); \
 					if (!ret) { \
 						vmm_scheduler_preempt_enable(); \
 						arch_cpu_irq_restore(flags); \
@@ -318,7 +390,7 @@ extern void vmm_scheduler_preempt_enable(void);
 					int ret; \
 					arch_cpu_irq_save((flags)); \
 					vmm_scheduler_preempt_disable(); \
-					ret = arch_write_trylock(&(lock)->__tlock); \
+					ret = __vmm_write_tryacquire(lock); \
 					if (!ret) { \
 						vmm_scheduler_preempt_enable(); \
 						arch_cpu_irq_restore(flags); \
@@ -330,7 +402,7 @@ extern void vmm_scheduler_preempt_enable(void);
 					int ret; \
 					arch_cpu_irq_save((flags)); \
 					vmm_scheduler_preempt_disable(); \
-					ret = arch_read_trylock(&(lock)->__tlock); \
+					ret = __vmm_read_tryacquire(lock); \
 					if (!ret) { \
 						vmm_scheduler_preempt_enable(); \
 						arch_cpu_irq_restore(flags); \
@@ -368,19 +440,19 @@ extern void vmm_scheduler_preempt_enable(void);
 					do { \
 					arch_cpu_irq_save((flags)); \
 					vmm_scheduler_preempt_disable(); \
-					arch_spin_lock(&(lock)->__tlock); \
+					__vmm_spin_acquire(lock); \
 					} while (0)
 #define vmm_write_lock_irqsave(lock, flags) \
 					do { \
 					arch_cpu_irq_save((flags)); \
 					vmm_scheduler_preempt_disable(); \
-					arch_write_lock(&(lock)->__tlock); \
+					__vmm_write_acquire(lock); \
 					} while (0)
 #define vmm_read_lock_irqsave(lock, flags) \
 					do { \
 					arch_cpu_irq_save((flags)); \
 					vmm_scheduler_preempt_disable(); \
-					arch_read_lock(&(lock)->__tlock); \
+					__vmm_read_acquire(lock); \
 					} while (0)
 #else
 #define vmm_spin_lock_irqsave(lock, flags) \
@@ -400,19 +472,19 @@ extern void vmm_scheduler_preempt_enable(void);
 #if defined(CONFIG_SMP)
 #define vmm_spin_unlock_irqrestore(lock, flags)	\
 					do { \
-					arch_spin_unlock(&(lock)->__tlock); \
+					__vmm_spin_release(lock); \
 					vmm_scheduler_preempt_enable(); \
 					arch_cpu_irq_restore(flags); \
 					} while (0)
 #define vmm_write_unlock_irqrestore(lock, flags)	\
 					do { \
-					arch_write_unlock(&(lock)->__tlock); \
+					__vmm_write_release(lock); \
 					vmm_scheduler_preempt_enable(); \
 					arch_cpu_irq_restore(flags); \
 					} while (0)
 #define vmm_read_unlock_irqrestore(lock, flags)	\
 					do { \
-					arch_read_unlock(&(lock)->__tlock); \
+					__vmm_read_release(lock); \
 					vmm_scheduler_preempt_enable(); \
 					arch_cpu_irq_restore(flags); \
 					} while (0)
@@ -434,17 +506,17 @@ extern void vmm_scheduler_preempt_enable(void);
 #define vmm_spin_lock_irqsave_lite(lock, flags) \
 					do { \
 					arch_cpu_irq_save((flags)); \
-					arch_spin_lock(&(lock)->__tlock); \
+					__vmm_spin_acquire(lock); \
 					} while (0)
 #define vmm_write_lock_irqsave_lite(lock, flags) \
 					do { \
 					arch_cpu_irq_save((flags)); \
-					arch_write_lock(&(lock)->__tlock); \
+					__vmm_write_acquire(lock); \
 					} while (0)
 #define vmm_read_lock_irqsave_lite(lock, flags) \
 					do { \
 					arch_cpu_irq_save((flags)); \
-					arch_read_lock(&(lock)->__tlock); \
+					__vmm_read_acquire(lock); \
 					} while (0)
 #else
 #define vmm_spin_lock_irqsave_lite(lock, flags) \
@@ -463,17 +535,17 @@ extern void vmm_scheduler_preempt_enable(void);
 #if defined(CONFIG_SMP)
 #define vmm_spin_unlock_irqrestore_lite(lock, flags)	\
 					do { \
-					arch_spin_unlock(&(lock)->__tlock); \
+					__vmm_spin_release(lock); \
 					arch_cpu_irq_restore(flags); \
 					} while (0)
 #define vmm_write_unlock_irqrestore_lite(lock, flags)	\
 					do { \
-					arch_write_unlock(&(lock)->__tlock); \
+					__vmm_write_release(lock); \
 					arch_cpu_irq_restore(flags); \
 					} while (0)
 #define vmm_read_unlock_irqrestore_lite(lock, flags)	\
 					do { \
-					arch_read_unlock(&(lock)->__tlock); \
+					__vmm_read_release(lock); \
 					arch_cpu_irq_restore(flags); \
 					} while (0)
 #else
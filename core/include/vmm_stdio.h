@@ -219,4 +219,10 @@ void vmm_stdio_change_loglevel(long loglevel);
 /** Initialize standerd IO library */
 int vmm_stdio_init(void);
 
+/** Start asynchronous printing on default device
+ *  (Note: Only effective with CONFIG_LOG_ASYNC and must be called
+ *  after threading is available)
+ */
+int vmm_stdio_async_init(void);
+
 #endif
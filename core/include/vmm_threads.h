@@ -112,6 +112,19 @@ struct vmm_thread *vmm_threads_create_rt(const char *thread_name,
 					 u64 thread_deadline,
 					 u64 thread_periodicity);
 
+/** Create a new deadline class thread which gets thread_budget nsecs
+ *  of host CPU every thread_periodicity nsecs to be consumed within
+ *  thread_deadline nsecs from start of period. Returns NULL if the
+ *  bandwidth cannot be admitted.
+ */
+struct vmm_thread *vmm_threads_create_deadline(const char *thread_name,
+					int (*thread_fn) (void *udata),
+					void *thread_data,
+					u8 thread_priority,
+					u64 thread_budget,
+					u64 thread_deadline,
+					u64 thread_periodicity);
+
 /** Create a new thread */
 static inline struct vmm_thread *vmm_threads_create(
 					const char *thread_name,
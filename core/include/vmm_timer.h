@@ -26,19 +26,27 @@
 #include <vmm_types.h>
 #include <vmm_spinlocks.h>
 #include <libs/list.h>
+#include <libs/rbtree.h>
 
 struct vmm_timer_event;
 
+/** Timer slack suitable for timer events of emulated guest timers */
+#define VMM_TIMER_GUEST_SLACK_NSECS	\
+			((u64)CONFIG_TIMER_GUEST_SLACK_USECS * 1000ULL)
+
 struct vmm_timer_event {
 	/* Publically accessible info */
 	u64 expiry_tstamp;
 	u64 duration_nsecs;
+	u64 period_nsecs;
+	u64 slack_nsecs;	/* Allowed expiry delay for coalescing */
 	void (*handler) (struct vmm_timer_event *);
 	void *priv;
 	/* Internal house-keeping info */
 	vmm_spinlock_t active_lock;
 	bool active_state;
 	struct dlist active_head;
+	struct rb_node active_rb;
 	u32 active_hcpu;
 };
 
@@ -46,10 +54,13 @@ struct vmm_timer_event {
 				do { \
 					(ev)->expiry_tstamp = 0; \
 					(ev)->duration_nsecs = 0; \
+					(ev)->period_nsecs = 0; \
+					(ev)->slack_nsecs = 0; \
 					(ev)->handler = _hndl; \
 					(ev)->priv = _priv; \
 					INIT_SPIN_LOCK(&(ev)->active_lock); \
 					INIT_LIST_HEAD(&(ev)->active_head); \
+					RB_CLEAR_NODE(&(ev)->active_rb); \
 					(ev)->active_state = FALSE; \
 					(ev)->active_hcpu = 0; \
 				} while (0)
@@ -58,6 +69,8 @@ struct vmm_timer_event {
 	{ \
 		.expiry_tstamp = 0,					\
 		.duration_nsecs = 0,					\
+		.period_nsecs = 0,					\
+		.slack_nsecs = 0,					\
 		.handler = _hndl,					\
 		.priv = _priv,						\
 		.active_lock = __SPINLOCK_INITIALIZER((ev).active_lock),\
@@ -78,7 +91,14 @@ u64 vmm_timer_event_expiry_time(struct vmm_timer_event *ev);
 /** Start a timer event */
 int vmm_timer_event_start(struct vmm_timer_event *ev, u64 duration_nsecs);
 
-/** Restart a timer event */
+/** Start a periodic timer event which first expires after duration
+ *  and then every period till stopped. The timer subsystem re-arms
+ *  the event itself before calling its handler.
+ */
+int vmm_timer_event_start_periodic(struct vmm_timer_event *ev,
+				   u64 duration_nsecs, u64 period_nsecs);
+
+/** Restart a timer event (Note: periodic event stays periodic) */
 int vmm_timer_event_restart(struct vmm_timer_event *ev);
 
 /** Stop a timer event */
@@ -87,11 +107,17 @@ int vmm_timer_event_stop(struct vmm_timer_event *ev);
 /** Current global timestamp (nanoseconds elapsed) */
 u64 vmm_timer_timestamp(void);
 
-#if defined(CONFIG_PROFILE)
+#if defined(CONFIG_PROFILE) || defined(CONFIG_HOST_IRQ_STATS) || \
+    defined(CONFIG_VCPU_EXIT_STATS) || defined(CONFIG_LOCKSTAT)
 /** Special version for profile */
 u64 vmm_timer_timestamp_for_profile(void);
 #endif
 
+/** Nanoseconds till first pending timer event of current host CPU
+ *  (zero if already expired and ~0ULL if no timer event is pending)
+ */
+u64 vmm_timer_next_event_delta(void);
+
 /** Check if timer subsystem is running on current host CPU */
 bool vmm_timer_started(void);
 
@@ -0,0 +1,133 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_trace.h
+ * @author agent (agent@local)
+ * @brief Static tracepoint interface
+ *
+ * Each tracepoint event is defined once in VMM_TRACE_EVENT_LIST with
+ * its name and the format of its (upto four) arguments. A disabled
+ * tracepoint costs one load and one not-taken branch whereas without
+ * CONFIG_TRACE tracepoints are compiled out completely.
+ */
+
+#ifndef __VMM_TRACE_H__
+#define __VMM_TRACE_H__
+
+#include <vmm_types.h>
+#include <vmm_compiler.h>
+
+/* __ev(ID, name, format of arg0..arg3) */
+#define VMM_TRACE_EVENT_LIST(__ev)					\
+	__ev(SCHED_SWITCH, "sched_switch",				\
+	     "prev_pid=%"PRIu64" prev_state=%"PRIu64			\
+	     " ==> next_pid=%"PRIu64" next_prio=%"PRIu64)		\
+	__ev(TIMER_EXPIRE, "timer_expire",				\
+	     "timer=0x%"PRIx64" function=0x%"PRIx64" expires=%"PRIu64)	\
+	__ev(IRQ_ENTRY, "irq_handler_entry", "irq=%"PRIu64)		\
+	__ev(IRQ_EXIT, "irq_handler_exit", "irq=%"PRIu64)		\
+	__ev(DEVEMU_READ, "devemu_read",				\
+	     "gphys=0x%"PRIx64" len=%"PRIu64" ret=%"PRId64)		\
+	__ev(DEVEMU_WRITE, "devemu_write",				\
+	     "gphys=0x%"PRIx64" len=%"PRIu64" ret=%"PRId64)		\
+	__ev(VIRTQ_NOTIFY, "virtqueue_notify",				\
+	     "dev=0x%"PRIx64" vq=%"PRIu64)				\
+	__ev(NETSWITCH_XFER, "netswitch_xfer",				\
+	     "port=0x%"PRIx64" len=%"PRIu64" to_port=%"PRIu64)		\
+	__ev(BLOCKDEV_SUBMIT, "blockdev_submit",			\
+	     "req=0x%"PRIx64" write=%"PRIu64" lba=%"PRIu64" bcnt=%"PRIu64) \
+	__ev(BLOCKDEV_COMPLETE, "blockdev_complete",			\
+	     "req=0x%"PRIx64" failed=%"PRIu64)
+
+#define __VMM_TRACE_EVENT_ID(__id, __name, __fmt)	VMM_TRACE_##__id,
+
+enum vmm_trace_events {
+	VMM_TRACE_EVENT_LIST(__VMM_TRACE_EVENT_ID)
+	VMM_TRACE_MAX_EVENTS
+};
+
+/** Mask for enabling all tracepoint events */
+#define VMM_TRACE_ALL_EVENTS	((1ULL << VMM_TRACE_MAX_EVENTS) - 1)
+
+/** VCPU ID recorded for trace record taken without current VCPU */
+#define VMM_TRACE_NO_VCPU	0xFFFFFFFF
+
+/** Trace record */
+struct vmm_trace_record {
+	u64 tstamp;
+	u32 event;
+	u32 vcpu_id;
+	u64 arg[4];
+};
+
+#ifdef CONFIG_TRACE
+
+/** Mask of enabled tracepoint events (Note: only for vmm_trace()) */
+extern u64 vmm_trace_mask;
+
+/** Record trace event (Note: only for vmm_trace()) */
+void __vmm_trace(u32 event, u64 a0, u64 a1, u64 a2, u64 a3);
+
+/** Record trace event if it is enabled */
+#define vmm_trace(__id, __a0, __a1, __a2, __a3)			\
+do {									\
+	if (unlikely(vmm_trace_mask & (1ULL << VMM_TRACE_##__id))) {	\
+		__vmm_trace(VMM_TRACE_##__id, (u64)(__a0), (u64)(__a1),	\
+			    (u64)(__a2), (u64)(__a3));			\
+	}								\
+} while (0)
+
+#else
+
+#define vmm_trace(__id, __a0, __a1, __a2, __a3)	do { } while (0)
+
+#endif
+
+/** Name of tracepoint event */
+const char *vmm_trace_event_name(u32 event);
+
+/** Find tracepoint event by name */
+int vmm_trace_event_find(const char *name);
+
+/** Check whether tracing is active */
+bool vmm_trace_isactive(void);
+
+/** Start recording given mask of tracepoint events
+ *  (Note: Existing trace records are cleared)
+ */
+int vmm_trace_start(u64 mask);
+
+/** Stop recording tracepoint events */
+int vmm_trace_stop(void);
+
+/** Copy upto max trace records of given host CPU (oldest first) into
+ *  buffer and return number of records copied. The number of records
+ *  overwritten due to ring buffer overflow is returned via lost
+ *  (if not NULL). Records are only consistent when tracing is stopped.
+ */
+u32 vmm_trace_read(u32 cpu, struct vmm_trace_record *buf,
+		   u32 max, u32 *lost);
+
+/** Format trace records of all host CPUs in ftrace text format
+ *  (readable by standard trace viewers) and pass them to write
+ *  callback. Tracing must be stopped before calling this.
+ */
+int vmm_trace_format(void *priv,
+		     size_t (*write)(void *priv, void *buf, size_t len));
+
+#endif /* __VMM_TRACE_H__ */
@@ -41,8 +41,15 @@ void vmm_vcpu_irq_deassert(struct vmm_vcpu *vcpu, u32 irq_no);
 /** Forcefully resume given VCPU if waiting for irq */
 int vmm_vcpu_irq_wait_resume(struct vmm_vcpu *vcpu, bool use_async_ipi);
 
+/** Wait for irq on given vcpu with some timeout where deep wait allows
+ *  host CPU to enter idle states with high exit latency meanwhile
+ *  (Note: deep wait is for guest power-down suspend only)
+ */
+int vmm_vcpu_irq_wait_suspend(struct vmm_vcpu *vcpu, u64 nsecs, bool deep);
+
 /** Wait for irq on given vcpu with some timeout */
-int vmm_vcpu_irq_wait_timeout(struct vmm_vcpu *vcpu, u64 nsecs);
+#define vmm_vcpu_irq_wait_timeout(vcpu, nsecs)	\
+		vmm_vcpu_irq_wait_suspend(vcpu, nsecs, FALSE)
 
 /** Wait for irq on given vcpu indefinetly (no timeout) */
 #define vmm_vcpu_irq_wait(vcpu)	vmm_vcpu_irq_wait_timeout(vcpu, 0)
@@ -50,6 +57,10 @@ int vmm_vcpu_irq_wait_timeout(struct vmm_vcpu *vcpu, u64 nsecs);
 /** Current state of Wait for irq on given vcpu */
 bool vmm_vcpu_irq_wait_state(struct vmm_vcpu *vcpu);
 
+/** Halt polling statistics of Wait for irq on given vcpu */
+int vmm_vcpu_irq_wait_poll_stats(struct vmm_vcpu *vcpu, u64 *poll_ns,
+				 u64 *poll_success, u64 *poll_fail);
+
 /** Initialize interrupts for given vcpu */
 int vmm_vcpu_irq_init(struct vmm_vcpu *vcpu);
 
@@ -34,6 +34,7 @@ struct vmm_waitqueue {
 	vmm_spinlock_t lock;
 	struct dlist vcpu_list;
 	u32 vcpu_count;
+	struct dlist fiber_list;
 	void *priv;
 };
 
@@ -42,6 +43,7 @@ do { \
 	INIT_SPIN_LOCK(&((__wq)->lock)); \
 	INIT_LIST_HEAD(&((__wq)->vcpu_list)); \
 	(__wq)->vcpu_count = 0; \
+	INIT_LIST_HEAD(&((__wq)->fiber_list)); \
 	(__wq)->priv = (__p); \
 } while (0);
 
@@ -50,6 +52,7 @@ do { \
 	.lock = __SPINLOCK_INITIALIZER((__wq).lock), \
 	.vcpu_list = { &(__wq).vcpu_list, &(__wq).vcpu_list }, \
 	.vcpu_count = 0, \
+	.fiber_list = { &(__wq).fiber_list, &(__wq).fiber_list }, \
 	.priv = (__p), \
 }
 
@@ -63,14 +66,14 @@ struct vmm_waitqueue __n = __WAITQUEUE_INITIALIZER(__n, __p)
  */
 int __vmm_waitqueue_sleep(struct vmm_waitqueue *wq, u64 *timeout_nsecs);
 
-/** Lowlevel waitqueue wakeup first VCPU.
+/** Lowlevel waitqueue wakeup first VCPU (or first fiber if no VCPU).
  *  Note: This function should only be called with wq->lock held using
  *  any vmm_spin_lock_xxx() API except lite APIs
  *  Note: This function can be called from any context
  */
 int __vmm_waitqueue_wakefirst(struct vmm_waitqueue *wq);
 
-/** Lowlevel waitqueue wakeup all VCPUs.
+/** Lowlevel waitqueue wakeup all VCPUs and fibers.
  *  Note: This function should only be called with wq->lock held using
  *  any vmm_spin_lock_xxx() API except lite APIs
  *  Note: This function can be called from any context
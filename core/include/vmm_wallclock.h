@@ -35,6 +35,25 @@ struct vmm_timezone {
 	int	tz_dsttime;	/* type of dst correction */
 };
 
+/** Version of struct vmm_wallclock_page layout */
+#define VMM_WALLCLOCK_PAGE_VERSION	1
+
+/** Wallclock page (one host page, mapped read-only into guests)
+ *  Wall time is tv_sec:tv_nsec at hypervisor timestamp tstamp and is
+ *  refreshed every period_nsecs. A reader copies the fields between
+ *  two reads of seq and retries if seq was odd or has changed.
+ */
+struct vmm_wallclock_page {
+	u32	seq;		/* odd while update in-progress */
+	u32	version;	/* VMM_WALLCLOCK_PAGE_VERSION */
+	s64	tv_sec;		/* seconds */
+	s64	tv_nsec;	/* nanoseconds */
+	u64	tstamp;		/* timestamp of last update (nanoseconds) */
+	s32	tz_minuteswest;	/* minutes west of Greenwich */
+	s32	tz_dsttime;	/* type of dst correction */
+	u64	period_nsecs;	/* update period (nanoseconds) */
+};
+
 struct vmm_timeinfo {
 	/*
 	 * the number of seconds after the minute, normally in the range
@@ -130,6 +149,11 @@ int vmm_wallclock_set_local_time(struct vmm_timeval *tv);
 /** Get local time */
 int vmm_wallclock_get_local_time(struct vmm_timeval *tv);
 
+/** Get local time as of last wallclock page update (lockless and
+ *  without reading timestamp, accurate to CONFIG_WALLCLOCK_PAGE_PERIOD_MS)
+ */
+int vmm_wallclock_get_local_time_coarse(struct vmm_timeval *tv);
+
 /** Set current timezone */
 int vmm_wallclock_set_timezone(struct vmm_timezone *tz);
 
@@ -144,6 +168,9 @@ int vmm_wallclock_set_timeofday(struct vmm_timeval *tv,
 int vmm_wallclock_get_timeofday(struct vmm_timeval *tv, 
 				struct vmm_timezone *tz);
 
+/** Host physical address of wallclock page */
+physical_addr_t vmm_wallclock_page_hphys(void);
+
 /** Initialize wall-clock subsystem */
 int vmm_wallclock_init(void);
 
@@ -138,6 +138,12 @@ u32 vmm_workqueue_count(void);
 /** Destroy workqueue */
 int vmm_workqueue_destroy(struct vmm_workqueue *wq);
 
+/** Retrive unbound system workqueue
+ *  Note: Long-running or blocking work should be scheduled on this
+ *  workqueue instead of per-CPU system workqueues.
+ */
+struct vmm_workqueue *vmm_workqueue_unbound(void);
+
 /** Create workqueue with given name and thread priority */
 struct vmm_workqueue *vmm_workqueue_create(const char *name, u8 priority);
 
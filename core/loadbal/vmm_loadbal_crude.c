@@ -101,7 +101,7 @@ static void crude_analyze_idle(struct crude_control *crude)
 	memset(crude->idle_period_ns, 0, sizeof(crude->idle_period_ns));
 	memset(crude->idle_percent, 0, sizeof(crude->idle_percent));
 
-	for_each_online_cpu(hcpu) {
+	for_each_housekeeping_cpu(hcpu) {
 		crude->idle_ns[hcpu] = vmm_scheduler_idle_time(hcpu);
 		crude->idle_period_ns[hcpu] =
 				vmm_scheduler_get_sample_period(hcpu);
@@ -117,7 +117,7 @@ static u32 crude_best_count_hcpu(struct crude_control *crude, u8 priority)
 	best_hcpu = vmm_smp_processor_id();
 	best_hcpu_count = crude->alive_count[best_hcpu][priority];
 
-	for_each_online_cpu(hcpu) {
+	for_each_housekeeping_cpu(hcpu) {
 		if (crude->alive_count[hcpu][priority] < best_hcpu_count) {
 			best_hcpu = hcpu;
 			best_hcpu_count = crude->alive_count[hcpu][priority];
@@ -139,7 +139,7 @@ static u32 crude_best_idle_hcpu(struct crude_control *crude)
 	best_hcpu = vmm_smp_processor_id();
 	best_hcpu_idle = crude->idle_percent[best_hcpu];
 
-	for_each_online_cpu(hcpu) {
+	for_each_housekeeping_cpu(hcpu) {
 		idle = crude->idle_percent[hcpu];
 		if (idle > best_hcpu_idle) {
 			best_hcpu = hcpu;
@@ -171,7 +171,7 @@ static u32 crude_worst_idle_hcpu(struct crude_control *crude)
 	}
 	worst_hcpu_count = count;
 
-	for_each_online_cpu(hcpu) {
+	for_each_housekeeping_cpu(hcpu) {
 		idle = crude->idle_percent[hcpu];
 		count = 1;
 		for (p = VMM_VCPU_MIN_PRIORITY;
@@ -0,0 +1,771 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_loadbal_topo.c
+ * @author agent (agent@local)
+ * @brief source file for topology aware load balancing algo
+ *
+ * This load balancer tracks the load of each VCPU as exponentially
+ * weighted moving average (EWMA) of its running time over balancing
+ * periods. The load of a host CPU is the sum of loads of its READY
+ * and RUNNING VCPUs.
+ *
+ * Clusters are discovered from "/cpus/cpu-map" node of the device tree
+ * and in absence of it host CPUs sharing the same "next-level-cache"
+ * are treated as one cluster. The relative capacity of host CPUs
+ * (e.g. big.LITTLE) is taken from "capacity-dmips-mhz" attribute.
+ *
+ * Balancing is done in two levels. First host CPUs of each cluster are
+ * balanced among themselves, then clusters are balanced by their
+ * capacity weighted load and VCPUs outgrowing a low capacity host CPU
+ * are moved to a higher capacity one. Moving a VCPU across clusters
+ * requires a larger load imbalance and recently migrated VCPUs are not
+ * moved again for some time which avoids needless VCPU ping-pong.
+ *
+ * New VCPUs are placed on the lowest capacity host CPU which still has
+ * room for them (saves energy) else on host CPU with most spare capacity.
+ *
+ * Idle host CPUs pull READY VCPUs from busy host CPUs (preferring
+ * busy host CPUs of same cluster) as soon as they enter idle instead
+ * of waiting for next balancing period.
+ */
+
+#include <vmm_error.h>
+#include <vmm_limits.h>
+#include <vmm_heap.h>
+#include <vmm_timer.h>
+#include <vmm_stdio.h>
+#include <vmm_devtree.h>
+#include <vmm_manager.h>
+#include <vmm_scheduler.h>
+#include <vmm_modules.h>
+#include <vmm_loadbal.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+
+#undef DEBUG
+
+#ifdef DEBUG
+#define DPRINTF(msg...)			vmm_printf(msg)
+#else
+#define DPRINTF(msg...)
+#endif
+
+#define MODULE_DESC			"Topology Aware Load Balancer"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			topo_init
+#define	MODULE_EXIT			topo_exit
+
+/* Load is expressed in per-mille of one host CPU */
+#define TOPO_LOAD_FULL			1000
+/* Weight of new sample in EWMA is 1/(2^TOPO_EWMA_SHIFT) */
+#define TOPO_EWMA_SHIFT			2
+/* Minimum load imbalance for migration within cluster */
+#define TOPO_IMBALANCE			200
+/* Additional load imbalance for migration across clusters */
+#define TOPO_CLUSTER_PENALTY		300
+/* Time after migration for which VCPU is not migrated again */
+#define TOPO_MIGRATE_HOLDOFF_NS		(2 * CONFIG_LOADBAL_PERIOD_SECS * \
+					 1000000000ULL)
+/* Capacity of highest capacity host CPU */
+#define TOPO_CAPACITY_SCALE		1024
+/* Load upto which a host CPU (or a VCPU on it) is considered to fit */
+#define TOPO_CAPACITY_MARGIN		800
+/* Load assumed for new VCPU while placing it */
+#define TOPO_NEW_VCPU_LOAD		250
+
+struct topo_vcpu {
+	u64 last_running_ns;
+	u64 last_tstamp;
+	u64 migrate_tstamp;
+	u32 load;
+};
+
+struct topo_control {
+	u32 cluster_count;
+	u32 cluster[CONFIG_CPU_COUNT];
+	u32 capacity[CONFIG_CPU_COUNT];
+	u32 hcpu_load[CONFIG_CPU_COUNT];
+	u32 alive_count[CONFIG_CPU_COUNT][VMM_VCPU_MAX_PRIORITY+1];
+	struct topo_vcpu vcpu[CONFIG_MAX_VCPU_COUNT];
+};
+
+/* Logical host CPU numbers follow order of "cpus" child nodes having "reg" */
+static int topo_cpu_index(struct vmm_devtree_node *cpus,
+			  struct vmm_devtree_node *node)
+{
+	int cpu = 0;
+	struct vmm_devtree_node *dn;
+
+	dn = NULL;
+	vmm_devtree_for_each_child(dn, cpus) {
+		if (!vmm_devtree_getattr(dn, VMM_DEVTREE_REG_ATTR_NAME)) {
+			continue;
+		}
+		if (dn == node) {
+			vmm_devtree_dref_node(dn);
+			return (cpu < CONFIG_CPU_COUNT) ? cpu : VMM_ENOTAVAIL;
+		}
+		cpu++;
+	}
+
+	return VMM_ENOTAVAIL;
+}
+
+/* Assign cluster id to host CPUs of given core (or thread) node */
+static void topo_parse_core(struct vmm_devtree_node *cpus,
+			    struct vmm_devtree_node *core,
+			    u32 *ids, u32 id)
+{
+	int cpu;
+	struct vmm_devtree_node *dn;
+
+	dn = vmm_devtree_parse_phandle(core, "cpu", 0);
+	if (dn) {
+		cpu = topo_cpu_index(cpus, dn);
+		if (0 <= cpu) {
+			ids[cpu] = id;
+		}
+		vmm_devtree_dref_node(dn);
+		return;
+	}
+
+	dn = NULL;
+	vmm_devtree_for_each_child(dn, core) {
+		if (!strncmp(dn->name, "thread", 6)) {
+			topo_parse_core(cpus, dn, ids, id);
+		}
+	}
+}
+
+static void topo_parse_cluster(struct vmm_devtree_node *cpus,
+			       struct vmm_devtree_node *cluster,
+			       u32 *ids, u32 *next_id)
+{
+	u32 id = (*next_id)++;
+	struct vmm_devtree_node *dn;
+
+	dn = NULL;
+	vmm_devtree_for_each_child(dn, cluster) {
+		if (!strncmp(dn->name, "cluster", 7)) {
+			topo_parse_cluster(cpus, dn, ids, next_id);
+		} else if (!strncmp(dn->name, "core", 4)) {
+			topo_parse_core(cpus, dn, ids, id);
+		}
+	}
+}
+
+static void topo_analyze_topology(struct topo_control *topo)
+{
+	u32 cpu, c, val, next_id = 0;
+	u32 ids[CONFIG_CPU_COUNT], dmips[CONFIG_CPU_COUNT], max_dmips = 0;
+	struct vmm_devtree_node *dn, *cpus, *map;
+
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		ids[cpu] = 0;
+		dmips[cpu] = 0;
+	}
+
+	cpus = vmm_devtree_getnode(VMM_DEVTREE_PATH_SEPARATOR_STRING "cpus");
+	if (!cpus) {
+		goto done;
+	}
+
+	cpu = 0;
+	dn = NULL;
+	vmm_devtree_for_each_child(dn, cpus) {
+		if (CONFIG_CPU_COUNT <= cpu) {
+			vmm_devtree_dref_node(dn);
+			break;
+		}
+		if (!vmm_devtree_getattr(dn, VMM_DEVTREE_REG_ATTR_NAME)) {
+			continue;
+		}
+		if (vmm_devtree_read_u32(dn, "next-level-cache", &val)) {
+			val = 0;
+		}
+		ids[cpu] = val;
+		if (!vmm_devtree_read_u32(dn, "capacity-dmips-mhz", &val)) {
+			dmips[cpu] = val;
+			if (max_dmips < val) {
+				max_dmips = val;
+			}
+		}
+		cpu++;
+	}
+
+	map = vmm_devtree_getchild(cpus, "cpu-map");
+	if (map) {
+		/* Host CPUs not described by cpu-map share one cluster */
+		for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+			ids[cpu] = 0xFFFFFFFF;
+		}
+		dn = NULL;
+		vmm_devtree_for_each_child(dn, map) {
+			if (!strncmp(dn->name, "cluster", 7)) {
+				topo_parse_cluster(cpus, dn, ids, &next_id);
+			}
+		}
+		vmm_devtree_dref_node(map);
+	}
+
+	vmm_devtree_dref_node(cpus);
+
+done:
+	/* Convert cluster ids into cluster numbers */
+	topo->cluster_count = 0;
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		for (c = 0; c < cpu; c++) {
+			if (ids[c] == ids[cpu]) {
+				break;
+			}
+		}
+		topo->cluster[cpu] = (c < cpu) ?
+				     topo->cluster[c] : topo->cluster_count++;
+	}
+
+	/* Host CPUs without capacity are assumed to be highest capacity */
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		topo->capacity[cpu] = (max_dmips && dmips[cpu]) ?
+			udiv32(dmips[cpu] * TOPO_CAPACITY_SCALE, max_dmips) :
+			TOPO_CAPACITY_SCALE;
+		if (!topo->capacity[cpu]) {
+			topo->capacity[cpu] = 1;
+		}
+		DPRINTF("%s: hcpu=%d cluster=%d capacity=%d\n", __func__,
+			cpu, topo->cluster[cpu], topo->capacity[cpu]);
+	}
+}
+
+static inline bool topo_same_cluster(struct topo_control *topo,
+				     u32 hcpu0, u32 hcpu1)
+{
+	return (topo->cluster[hcpu0] == topo->cluster[hcpu1]) ? TRUE : FALSE;
+}
+
+static bool topo_is_idle_vcpu(struct vmm_vcpu *vcpu, u32 hcpu)
+{
+	return (vmm_scheduler_idle_vcpu(hcpu) == vcpu) ? TRUE : FALSE;
+}
+
+static int topo_analyze_load_iter(struct vmm_vcpu *vcpu, void *priv)
+{
+	u64 tstamp, delta_ns, running_ns;
+	u32 hcpu, state, sample;
+	struct topo_vcpu *tv;
+	struct topo_control *topo = priv;
+
+	if (CONFIG_MAX_VCPU_COUNT <= vcpu->id) {
+		return VMM_OK;
+	}
+	tv = &topo->vcpu[vcpu->id];
+
+	vmm_manager_vcpu_stats(vcpu, &state, NULL, &hcpu,
+			       NULL, NULL, NULL, &running_ns, NULL, NULL);
+	tstamp = vmm_timer_timestamp();
+
+	if (!tv->last_tstamp || (running_ns < tv->last_running_ns)) {
+		/* New or reset VCPU */
+		tv->load = 0;
+	} else if (tv->last_tstamp < tstamp) {
+		delta_ns = tstamp - tv->last_tstamp;
+		sample = udiv64((running_ns - tv->last_running_ns) *
+				TOPO_LOAD_FULL, delta_ns);
+		if (TOPO_LOAD_FULL < sample) {
+			sample = TOPO_LOAD_FULL;
+		}
+		tv->load = tv->load - (tv->load >> TOPO_EWMA_SHIFT) +
+			   (sample >> TOPO_EWMA_SHIFT);
+	}
+	tv->last_running_ns = running_ns;
+	tv->last_tstamp = tstamp;
+
+	if ((state != VMM_VCPU_STATE_READY) &&
+	    (state != VMM_VCPU_STATE_RUNNING) &&
+	    (state != VMM_VCPU_STATE_PAUSED)) {
+		return VMM_OK;
+	}
+
+	topo->alive_count[hcpu][vcpu->priority]++;
+
+	if ((state != VMM_VCPU_STATE_PAUSED) &&
+	    !topo_is_idle_vcpu(vcpu, hcpu)) {
+		topo->hcpu_load[hcpu] += tv->load;
+	}
+
+	return VMM_OK;
+}
+
+static void topo_analyze_load(struct topo_control *topo)
+{
+	memset(topo->hcpu_load, 0, sizeof(topo->hcpu_load));
+	memset(topo->alive_count, 0, sizeof(topo->alive_count));
+
+	vmm_manager_vcpu_iterate(topo_analyze_load_iter, topo);
+}
+
+struct topo_migrate {
+	struct topo_control *topo;
+	u32 old_hcpu;
+	u32 new_hcpu;
+	u32 min_load;
+	u32 max_load;
+	bool check_holdoff;
+	u64 tstamp;
+	struct vmm_vcpu *best;
+	u32 best_load;
+	u8 best_prio;
+};
+
+static int topo_migrate_iter(struct vmm_vcpu *vcpu, void *priv)
+{
+	u32 hcpu;
+	struct topo_vcpu *tv;
+	const struct vmm_cpumask *aff;
+	struct topo_migrate *tm = priv;
+
+	if (CONFIG_MAX_VCPU_COUNT <= vcpu->id) {
+		return VMM_OK;
+	}
+	tv = &tm->topo->vcpu[vcpu->id];
+
+	vmm_manager_vcpu_get_hcpu(vcpu, &hcpu);
+	if (hcpu != tm->old_hcpu) {
+		return VMM_OK;
+	}
+
+	if (vmm_manager_vcpu_get_state(vcpu) != VMM_VCPU_STATE_READY) {
+		return VMM_OK;
+	}
+
+	aff = vmm_manager_vcpu_get_affinity(vcpu);
+	if ((vmm_cpumask_weight(aff) < 2) ||
+	    !vmm_cpumask_test_cpu(tm->new_hcpu, aff)) {
+		return VMM_OK;
+	}
+
+	if (tm->check_holdoff && tv->migrate_tstamp &&
+	    (tm->tstamp < (tv->migrate_tstamp + TOPO_MIGRATE_HOLDOFF_NS))) {
+		return VMM_OK;
+	}
+
+	if ((tv->load < tm->min_load) ||
+	    (tm->max_load && (tm->max_load < tv->load))) {
+		return VMM_OK;
+	}
+
+	/* Prefer higher priority and then heavier VCPU */
+	if (!tm->best ||
+	    (tm->best_prio < vcpu->priority) ||
+	    ((tm->best_prio == vcpu->priority) &&
+	     (tm->best_load < tv->load))) {
+		tm->best = vcpu;
+		tm->best_load = tv->load;
+		tm->best_prio = vcpu->priority;
+	}
+
+	return VMM_OK;
+}
+
+static bool topo_migrate(struct topo_control *topo,
+			 u32 old_hcpu, u32 new_hcpu,
+			 u32 min_load, u32 max_load, bool check_holdoff)
+{
+	u32 new_load;
+	struct topo_migrate tm;
+
+	memset(&tm, 0, sizeof(tm));
+	tm.topo = topo;
+	tm.old_hcpu = old_hcpu;
+	tm.new_hcpu = new_hcpu;
+	tm.min_load = min_load;
+	tm.max_load = max_load;
+	tm.check_holdoff = check_holdoff;
+	tm.tstamp = vmm_timer_timestamp();
+
+	vmm_manager_vcpu_iterate(topo_migrate_iter, &tm);
+	if (!tm.best) {
+		return FALSE;
+	}
+
+	DPRINTF("%s: vcpu=%s load=%d old_hcpu=%d new_hcpu=%d\n",
+		__func__, tm.best->name, tm.best_load, old_hcpu, new_hcpu);
+
+	if (vmm_manager_vcpu_set_hcpu(tm.best, new_hcpu)) {
+		return FALSE;
+	}
+
+	if (tm.best->id < CONFIG_MAX_VCPU_COUNT) {
+		topo->vcpu[tm.best->id].migrate_tstamp = tm.tstamp;
+	}
+	topo->hcpu_load[old_hcpu] -= (topo->hcpu_load[old_hcpu] < tm.best_load) ?
+				     topo->hcpu_load[old_hcpu] : tm.best_load;
+	/* Same work takes longer on lower capacity host CPU */
+	new_load = udiv32(tm.best_load * topo->capacity[old_hcpu],
+			  topo->capacity[new_hcpu]);
+	topo->hcpu_load[new_hcpu] += new_load;
+	if (tm.best->id < CONFIG_MAX_VCPU_COUNT) {
+		topo->vcpu[tm.best->id].load = (TOPO_LOAD_FULL < new_load) ?
+						TOPO_LOAD_FULL : new_load;
+	}
+
+	return TRUE;
+}
+
+/* Spare capacity of host CPU relative to highest capacity host CPU */
+static inline u32 topo_spare(struct topo_control *topo, u32 hcpu)
+{
+	u32 load = topo->hcpu_load[hcpu];
+
+	if (TOPO_LOAD_FULL <= load) {
+		return 0;
+	}
+
+	return (TOPO_LOAD_FULL - load) * topo->capacity[hcpu];
+}
+
+static bool topo_better_hcpu(struct topo_control *topo, u8 priority,
+			     u32 hcpu, u32 best_hcpu)
+{
+	bool fit, best_fit;
+	u32 count = topo->alive_count[hcpu][priority];
+	u32 best_count = topo->alive_count[best_hcpu][priority];
+
+	fit = ((topo->hcpu_load[hcpu] + TOPO_NEW_VCPU_LOAD) <=
+				TOPO_CAPACITY_MARGIN) ? TRUE : FALSE;
+	best_fit = ((topo->hcpu_load[best_hcpu] + TOPO_NEW_VCPU_LOAD) <=
+				TOPO_CAPACITY_MARGIN) ? TRUE : FALSE;
+	if (fit != best_fit) {
+		return fit;
+	}
+
+	/* Among host CPUs with room, lower capacity ones use less energy */
+	if (fit && (topo->capacity[hcpu] != topo->capacity[best_hcpu])) {
+		return (topo->capacity[hcpu] < topo->capacity[best_hcpu]) ?
+								TRUE : FALSE;
+	}
+
+	if (count != best_count) {
+		return (count < best_count) ? TRUE : FALSE;
+	}
+
+	return (topo_spare(topo, best_hcpu) < topo_spare(topo, hcpu)) ?
+								TRUE : FALSE;
+}
+
+static u32 topo_good_hcpu(struct vmm_loadbal_algo *algo, u8 priority)
+{
+	u32 hcpu, best_hcpu;
+	struct topo_control *topo = vmm_loadbal_get_algo_priv(algo);
+
+	if (!topo ||
+	    (VMM_VCPU_MAX_PRIORITY < priority)) {
+		return vmm_smp_processor_id();
+	}
+
+	topo_analyze_load(topo);
+
+	best_hcpu = CONFIG_CPU_COUNT;
+	for_each_housekeeping_cpu(hcpu) {
+		if ((best_hcpu == CONFIG_CPU_COUNT) ||
+		    topo_better_hcpu(topo, priority, hcpu, best_hcpu)) {
+			best_hcpu = hcpu;
+		}
+	}
+	if (best_hcpu == CONFIG_CPU_COUNT) {
+		best_hcpu = vmm_smp_processor_id();
+	}
+
+	DPRINTF("%s: good_hcpu=%d priority=%d\n",
+		__func__, best_hcpu, priority);
+
+	return best_hcpu;
+}
+
+/* Find busiest and least busy host CPUs of given cluster */
+static bool topo_cluster_extremes(struct topo_control *topo, u32 cluster,
+				  u32 *busy_hcpu, u32 *idle_hcpu)
+{
+	u32 hcpu, busy = CONFIG_CPU_COUNT, idle = CONFIG_CPU_COUNT;
+
+	for_each_housekeeping_cpu(hcpu) {
+		if (topo->cluster[hcpu] != cluster) {
+			continue;
+		}
+		if ((busy == CONFIG_CPU_COUNT) ||
+		    (topo->hcpu_load[busy] < topo->hcpu_load[hcpu])) {
+			busy = hcpu;
+		}
+		if ((idle == CONFIG_CPU_COUNT) ||
+		    (topo->hcpu_load[hcpu] < topo->hcpu_load[idle])) {
+			idle = hcpu;
+		}
+	}
+
+	*busy_hcpu = busy;
+	*idle_hcpu = idle;
+
+	return (busy != CONFIG_CPU_COUNT) ? TRUE : FALSE;
+}
+
+/* Lower level: balance host CPUs within a cluster */
+static void topo_balance_cluster(struct topo_control *topo, u32 cluster)
+{
+	u32 busy_hcpu, dest_hcpu, diff;
+
+	if (!topo_cluster_extremes(topo, cluster, &busy_hcpu, &dest_hcpu) ||
+	    (busy_hcpu == dest_hcpu)) {
+		return;
+	}
+
+	diff = topo->hcpu_load[busy_hcpu] - topo->hcpu_load[dest_hcpu];
+	if (diff < TOPO_IMBALANCE) {
+		return;
+	}
+
+	DPRINTF("%s: cluster=%d busy_hcpu=%d (load %d) dest_hcpu=%d "
+		"(load %d)\n", __func__, cluster,
+		busy_hcpu, topo->hcpu_load[busy_hcpu],
+		dest_hcpu, topo->hcpu_load[dest_hcpu]);
+
+	/* Only move VCPU which reduces the imbalance */
+	topo_migrate(topo, busy_hcpu, dest_hcpu, 0, diff / 2, TRUE);
+}
+
+/* Upper level: move VCPUs outgrowing low capacity host CPUs */
+static void topo_balance_misfit(struct topo_control *topo)
+{
+	u32 hcpu, src_hcpu, dest_hcpu;
+
+	for_each_housekeeping_cpu(src_hcpu) {
+		if ((TOPO_CAPACITY_SCALE <= topo->capacity[src_hcpu]) ||
+		    (topo->hcpu_load[src_hcpu] < TOPO_CAPACITY_MARGIN)) {
+			continue;
+		}
+
+		dest_hcpu = CONFIG_CPU_COUNT;
+		for_each_housekeeping_cpu(hcpu) {
+			if (topo->capacity[hcpu] <= topo->capacity[src_hcpu]) {
+				continue;
+			}
+			if ((dest_hcpu == CONFIG_CPU_COUNT) ||
+			    (topo->hcpu_load[hcpu] <
+					topo->hcpu_load[dest_hcpu])) {
+				dest_hcpu = hcpu;
+			}
+		}
+		if ((dest_hcpu == CONFIG_CPU_COUNT) ||
+		    (TOPO_CAPACITY_MARGIN <= topo->hcpu_load[dest_hcpu])) {
+			continue;
+		}
+
+		DPRINTF("%s: src_hcpu=%d (capacity %d) dest_hcpu=%d "
+			"(capacity %d)\n", __func__,
+			src_hcpu, topo->capacity[src_hcpu],
+			dest_hcpu, topo->capacity[dest_hcpu]);
+
+		topo_migrate(topo, src_hcpu, dest_hcpu,
+			     TOPO_CAPACITY_MARGIN, 0, TRUE);
+	}
+}
+
+/* Upper level: balance clusters by capacity weighted load */
+static void topo_balance_clusters(struct topo_control *topo)
+{
+	u32 hcpu, c, busy_c, idle_c, busy_hcpu, dest_hcpu, tmp;
+	u32 load[CONFIG_CPU_COUNT];
+	u64 sum_load[CONFIG_CPU_COUNT], sum_cap[CONFIG_CPU_COUNT];
+
+	for (c = 0; c < topo->cluster_count; c++) {
+		sum_load[c] = sum_cap[c] = 0;
+	}
+	for_each_housekeeping_cpu(hcpu) {
+		c = topo->cluster[hcpu];
+		sum_load[c] += (u64)topo->hcpu_load[hcpu] *
+						topo->capacity[hcpu];
+		sum_cap[c] += topo->capacity[hcpu];
+	}
+
+	busy_c = idle_c = topo->cluster_count;
+	for (c = 0; c < topo->cluster_count; c++) {
+		if (!sum_cap[c]) {
+			continue;
+		}
+		load[c] = udiv64(sum_load[c], sum_cap[c]);
+		if ((busy_c == topo->cluster_count) ||
+		    (load[busy_c] < load[c])) {
+			busy_c = c;
+		}
+		if ((idle_c == topo->cluster_count) ||
+		    (load[c] < load[idle_c])) {
+			idle_c = c;
+		}
+	}
+	if ((busy_c == topo->cluster_count) || (busy_c == idle_c) ||
+	    ((load[busy_c] - load[idle_c]) <
+			(TOPO_IMBALANCE + TOPO_CLUSTER_PENALTY))) {
+		return;
+	}
+
+	topo_cluster_extremes(topo, busy_c, &busy_hcpu, &tmp);
+	topo_cluster_extremes(topo, idle_c, &tmp, &dest_hcpu);
+	if (topo->hcpu_load[busy_hcpu] <= topo->hcpu_load[dest_hcpu]) {
+		return;
+	}
+
+	DPRINTF("%s: busy_cluster=%d (load %d) idle_cluster=%d (load %d)\n",
+		__func__, busy_c, load[busy_c], idle_c, load[idle_c]);
+
+	topo_migrate(topo, busy_hcpu, dest_hcpu, 0,
+		     (topo->hcpu_load[busy_hcpu] -
+		      topo->hcpu_load[dest_hcpu]) / 2, TRUE);
+}
+
+static void topo_balance(struct vmm_loadbal_algo *algo)
+{
+	u32 c;
+	struct topo_control *topo = vmm_loadbal_get_algo_priv(algo);
+
+	if (!topo) {
+		return;
+	}
+
+	topo_analyze_load(topo);
+
+	for (c = 0; c < topo->cluster_count; c++) {
+		topo_balance_cluster(topo, c);
+	}
+
+	if (topo->cluster_count < 2) {
+		return;
+	}
+
+	topo_balance_misfit(topo);
+	topo_balance_clusters(topo);
+}
+
+static u32 topo_ready_count(u32 hcpu)
+{
+	u8 prio;
+	u32 count = 0;
+
+	/* Skip lowest priority because of idle VCPU */
+	for (prio = VMM_VCPU_MIN_PRIORITY + 1;
+	     prio <= VMM_VCPU_MAX_PRIORITY; prio++) {
+		count += vmm_scheduler_ready_count(hcpu, prio);
+	}
+
+	return count;
+}
+
+static void topo_idle_pull(struct vmm_loadbal_algo *algo, u32 idle_hcpu)
+{
+	u32 hcpu, src_hcpu, src_count, count, pass;
+	struct topo_control *topo = vmm_loadbal_get_algo_priv(algo);
+
+	if (!topo || !vmm_cpu_housekeeping(idle_hcpu)) {
+		return;
+	}
+
+	/* First pass looks within cluster and second pass across clusters */
+	for (pass = 0; pass < 2; pass++) {
+		src_hcpu = idle_hcpu;
+		src_count = 0;
+		for_each_housekeeping_cpu(hcpu) {
+			if ((hcpu == idle_hcpu) ||
+			    (topo_same_cluster(topo, idle_hcpu, hcpu) !=
+							(pass == 0))) {
+				continue;
+			}
+			count = topo_ready_count(hcpu);
+			if (src_count < count) {
+				src_hcpu = hcpu;
+				src_count = count;
+			}
+		}
+		if (src_hcpu == idle_hcpu) {
+			continue;
+		}
+
+		DPRINTF("%s: idle_hcpu=%d src_hcpu=%d ready=%d\n",
+			__func__, idle_hcpu, src_hcpu, src_count);
+
+		/* Migration holdoff only applies across clusters */
+		if (topo_migrate(topo, src_hcpu, idle_hcpu, 0, 0,
+				 (pass == 0) ? FALSE : TRUE)) {
+			break;
+		}
+	}
+}
+
+static int topo_start(struct vmm_loadbal_algo *algo)
+{
+	struct topo_control *topo;
+
+	topo = vmm_zalloc(sizeof(*topo));
+	if (!topo) {
+		return VMM_ENOMEM;
+	}
+
+	topo_analyze_topology(topo);
+
+	vmm_loadbal_set_algo_priv(algo, topo);
+
+	return VMM_OK;
+}
+
+static void topo_stop(struct vmm_loadbal_algo *algo)
+{
+	struct topo_control *topo = vmm_loadbal_get_algo_priv(algo);
+
+	if (!topo) {
+		return;
+	}
+
+	vmm_loadbal_set_algo_priv(algo, NULL);
+	vmm_free(topo);
+}
+
+static struct vmm_loadbal_algo topo = {
+	.name = "Topology Aware Load Balancer",
+	.rating = 2,
+	.good_hcpu = topo_good_hcpu,
+	.balance = topo_balance,
+	.idle_pull = topo_idle_pull,
+	.start = topo_start,
+	.stop = topo_stop,
+};
+
+static int __init topo_init(void)
+{
+	return vmm_loadbal_register_algo(&topo);
+}
+
+static void __exit topo_exit(void)
+{
+	vmm_loadbal_unregister_algo(&topo);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
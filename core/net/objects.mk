@@ -27,6 +27,8 @@ vmm_netcore-y += vmm_mbuf.o
 vmm_netcore-y += vmm_net.o
 vmm_netcore-y += vmm_netswitch.o
 vmm_netcore-y += vmm_netport.o
+vmm_netcore-y += vmm_netoffload.o
+vmm_netcore-$(CONFIG_NET_CAPTURE) += vmm_netcapture.o
 vmm_netcore-y += vmm_hub.o
 vmm_netcore-y += vmm_bridge.o
 
@@ -26,11 +26,15 @@
 #include <vmm_stdio.h>
 #include <vmm_timer.h>
 #include <vmm_devdrv.h>
+#include <vmm_devtree.h>
+#include <vmm_rcu.h>
+#include <vmm_percpu.h>
 #include <net/vmm_protocol.h>
 #include <net/vmm_mbuf.h>
 #include <net/vmm_netswitch.h>
 #include <net/vmm_netport.h>
 #include <libs/stringlib.h>
+#include <libs/hash.h>
 
 #undef DEBUG_BRIDGE
 
@@ -41,39 +45,194 @@
 #define DPRINTF(fmt, ...) do {} while(0)
 #endif
 
-#define BRIDGE_MAC_TABLE_SZ	32
-#define BRIDGE_MAC_EXPIRY	30000000000LLU
+#define BRIDGE_MAC_TABLE_SZ		1024
+#define BRIDGE_MAC_BUCKETS_MIN		16
+#define BRIDGE_MAC_EXPIRY_SECS		30
 
-/* We maintain a table of learned mac addresses 
- * (please note that the mac of the immediate netports are not 
+/* We maintain a hash table of learned mac addresses
+ * (please note that the mac of the immediate netports are not
  * kept in this table) */
 struct bridge_mac_entry {
+	struct dlist head;
 	struct vmm_netport *port;
 	u8 macaddr[6];
-	u64 timestamp;
+	bool active;
+	struct vmm_rcu_head rcu;
 };
 
+/* Hash buckets of mac table. These are replaced as a whole
+ * (along with copies of all mac entries) when mac table grows */
+struct bridge_mac_hash {
+	u32 buckets_count;
+	struct dlist *buckets;
+	struct vmm_rcu_head rcu;
+};
+
+/* Mac table lookups in rx path are RCU readers whereas updates
+ * are serialized using mac_table_lock and free memory only after
+ * a RCU grace period. */
 struct bridge_ctrl {
 	struct vmm_netswitch *nsw;
 	struct vmm_timer_event ev;
-	vmm_rwlock_t mac_table_lock;
+	u64 mac_expiry;
+	vmm_spinlock_t mac_table_lock;
 	u32 mac_table_sz;
-	struct bridge_mac_entry *mac_table;
+	u32 mac_table_count;
+	struct bridge_mac_hash *mac_hash;
+	struct vmm_percpu_counter stat_hits;
+	struct vmm_percpu_counter stat_misses;
+	struct vmm_percpu_counter stat_learned;
+	struct vmm_percpu_counter stat_evicted;
+	struct vmm_percpu_counter stat_expired;
 };
 
+static inline u32 bridge_mac_hash(const u8 *mac, u32 buckets_count)
+{
+	return hash32(mac, 6, 0) & (buckets_count - 1);
+}
+
+static struct bridge_mac_hash *bridge_mac_hash_alloc(u32 buckets_count)
+{
+	u32 i;
+	struct bridge_mac_hash *h;
+
+	h = vmm_malloc(sizeof(*h) + sizeof(*h->buckets) * buckets_count);
+	if (!h) {
+		return NULL;
+	}
+
+	h->buckets_count = buckets_count;
+	h->buckets = (struct dlist *)(h + 1);
+	for (i = 0; i < buckets_count; i++) {
+		INIT_LIST_HEAD(&h->buckets[i]);
+	}
+
+	return h;
+}
+
+static void bridge_mac_hash_free(struct vmm_rcu_head *rhead)
+{
+	vmm_free(container_of(rhead, struct bridge_mac_hash, rcu));
+}
+
+static void bridge_mac_entry_free(struct vmm_rcu_head *rhead)
+{
+	vmm_free(container_of(rhead, struct bridge_mac_entry, rcu));
+}
+
+/* Note: Must be called with mac_table_lock held for writing */
+static void bridge_mac_entry_del(struct bridge_ctrl *br,
+				 struct bridge_mac_entry *m)
+{
+	list_del_rcu(&m->head);
+	br->mac_table_count--;
+	vmm_rcu_call(&m->rcu, bridge_mac_entry_free);
+}
+
+/* Note: Must be called in RCU read-side critical section
+ * or with mac_table_lock held */
+static struct bridge_mac_entry *bridge_mactable_find(
+						struct bridge_mac_hash *h,
+						const u8 *mac)
+{
+	struct bridge_mac_entry *m;
+	struct dlist *b = &h->buckets[bridge_mac_hash(mac, h->buckets_count)];
+
+	list_for_each_entry_rcu(m, b, head) {
+		if (!compare_ether_addr(m->macaddr, mac)) {
+			return m;
+		}
+	}
+
+	return NULL;
+}
+
+/* Note: Must be called with mac_table_lock held for writing */
+static void bridge_mactable_rehash(struct bridge_ctrl *br,
+				   struct bridge_mac_hash *nh)
+{
+	u32 i;
+	struct bridge_mac_hash *oh = br->mac_hash;
+	struct bridge_mac_entry *m, *nm;
+
+	/* RCU readers might be walking old buckets hence
+	 * populate new buckets with copies of mac entries */
+	for (i = 0; i < oh->buckets_count; i++) {
+		list_for_each_entry(m, &oh->buckets[i], head) {
+			nm = vmm_malloc(sizeof(*nm));
+			if (!nm) {
+				goto fail;
+			}
+			memcpy(nm, m, sizeof(*nm));
+			list_add_tail(&nm->head, &nh->buckets[
+				bridge_mac_hash(nm->macaddr, nh->buckets_count)]);
+		}
+	}
+
+	vmm_rcu_assign_pointer(br->mac_hash, nh);
+
+	for (i = 0; i < oh->buckets_count; i++) {
+		list_for_each_entry(m, &oh->buckets[i], head) {
+			vmm_rcu_call(&m->rcu, bridge_mac_entry_free);
+		}
+	}
+	vmm_rcu_call(&oh->rcu, bridge_mac_hash_free);
+
+	return;
+
+fail:
+	for (i = 0; i < nh->buckets_count; i++) {
+		while (!list_empty(&nh->buckets[i])) {
+			vmm_free(list_entry(list_pop(&nh->buckets[i]),
+					    struct bridge_mac_entry, head));
+		}
+	}
+	vmm_free(nh);
+}
+
+/* Note: Must be called with mac_table_lock held for writing */
+static void bridge_mactable_evict(struct bridge_ctrl *br)
+{
+	u32 i;
+	struct bridge_mac_hash *h = br->mac_hash;
+	struct bridge_mac_entry *m, *victim = NULL;
+
+	/* Prefer an entry which was not used since last aging */
+	for (i = 0; i < h->buckets_count; i++) {
+		list_for_each_entry(m, &h->buckets[i], head) {
+			victim = m;
+			if (!m->active) {
+				goto done;
+			}
+		}
+	}
+
+done:
+	if (victim) {
+		bridge_mac_entry_del(br, victim);
+		vmm_percpu_counter_inc(&br->stat_evicted);
+	}
+}
+
+/* Note: Removes all entries when port is NULL */
 static void bridge_mactable_cleanup_port(struct bridge_ctrl *br,
 					 struct vmm_netport *port)
 {
-	u32 m;
+	u32 i;
 	irq_flags_t f;
-
-	vmm_write_lock_irqsave_lite(&br->mac_table_lock, f);
-	for (m = 0; m < br->mac_table_sz; m++) {
-		if (br->mac_table[m].port == port) {
-			br->mac_table[m].port = NULL;
+	struct bridge_mac_hash *h;
+	struct bridge_mac_entry *m, *nm;
+
+	vmm_spin_lock_irqsave_lite(&br->mac_table_lock, f);
+	h = br->mac_hash;
+	for (i = 0; i < h->buckets_count; i++) {
+		list_for_each_entry_safe(m, nm, &h->buckets[i], head) {
+			if (!port || (m->port == port)) {
+				bridge_mac_entry_del(br, m);
+			}
 		}
 	}
-	vmm_write_unlock_irqrestore_lite(&br->mac_table_lock, f);
+	vmm_spin_unlock_irqrestore_lite(&br->mac_table_lock, f);
 }
 
 static struct vmm_netport *bridge_mactable_learn_find(struct bridge_ctrl *br,
@@ -81,93 +240,95 @@ static struct vmm_netport *bridge_mactable_learn_find(struct bridge_ctrl *br,
 						      const u8 *srcmac,
 						      struct vmm_netport *src)
 {
-	u32 i;
-	u64 tstamp;
+	bool learn;
 	irq_flags_t f;
-	bool learn, update, found;
-	struct vmm_netport *dst;
-	struct bridge_mac_entry *m;
+	u32 buckets_count = 0;
+	struct bridge_mac_hash *h, *nh = NULL;
+	struct vmm_netport *dst = NULL;
+	struct bridge_mac_entry *m, *new_m = NULL;
 
-	/* Acquire read lock */
-	vmm_read_lock_irqsave_lite(&br->mac_table_lock, f);
+	/* Enter RCU read-side critical section */
+	vmm_rcu_read_lock();
 
-	/* Check for for dstmac and whether we need
-	 * to Learn (srcmac, src) mapping ??
+	/* Find destination port and check whether
+	 * we need to learn (srcmac, src) mapping
 	 */
-	learn = TRUE;
-	dst = NULL;
-	for (i = 0; i < br->mac_table_sz; i++) {
-		m = &br->mac_table[i];
-		/* If mac table entry is unused then continue */
-		if (!m->port) {
-			continue;
-		}
-		/* Match (srcmac, srcport) */
-		if (learn &&
-		    !compare_ether_addr(m->macaddr, srcmac) &&
-		    (m->port == src)) {
-			learn = FALSE;
-		}
-		/* Match (dstmac) */
-		if (!dst &&
-		    !compare_ether_addr(m->macaddr, dstmac)) {
-			dst = m->port;
-		}
-		/* If no need to learn and found
-		 * destination port then break
-		 */
-		if (!learn && dst) {
-			break;
-		}
+	h = vmm_rcu_dereference(br->mac_hash);
+	m = bridge_mactable_find(h, dstmac);
+	if (m) {
+		dst = m->port;
+		m->active = TRUE;
+	}
+	m = bridge_mactable_find(h, srcmac);
+	learn = (!m || (m->port != src)) ? TRUE : FALSE;
+	if (m && !learn) {
+		m->active = TRUE;
+	}
+	if (learn && !m &&
+	    (br->mac_table_count >= (h->buckets_count * 2)) &&
+	    (h->buckets_count < br->mac_table_sz)) {
+		buckets_count = h->buckets_count * 2;
 	}
 
-	/* Release read lock */
-	vmm_read_unlock_irqrestore_lite(&br->mac_table_lock, f);
-
-	/* If leaning required then update mac table */
-	if (learn) {
-		/* Retrive current timestamp */
-		tstamp = vmm_timer_timestamp();
-
-		/* Acquire write lock */
-		vmm_write_lock_irqsave_lite(&br->mac_table_lock, f);
-
-		/* If mac entry already exist then
-		 * update only port and timestamp
-		 */
-		update = TRUE;
-		for (i = 0; i < br->mac_table_sz; i++) {
-			m = &br->mac_table[i];
-			if (!compare_ether_addr(m->macaddr, srcmac)) {
-				m->port = src;
-				m->timestamp = tstamp;
-				update = FALSE;
-				break;
-			}
-		}
+	/* Leave RCU read-side critical section */
+	vmm_rcu_read_unlock();
 
-		/* If mac entry does not exist then
-		 * save (mac, port, timestamp) in a
-		 * free mac table entry.
-		 */
-		if (update) {
-			found = FALSE;
-			for (i = 0; i < br->mac_table_sz; i++) {
-				m = &br->mac_table[i];
-				if (m->port == NULL) {
-					found = TRUE;
-					break;
-				}
-			}
-			if (found) {
-				m->port = src;
-				memcpy(m->macaddr, srcmac, 6);
-				m->timestamp = tstamp;
-			}
+	if (dst) {
+		vmm_percpu_counter_inc(&br->stat_hits);
+	} else {
+		vmm_percpu_counter_inc(&br->stat_misses);
+	}
+
+	if (!learn) {
+		return dst;
+	}
+
+	/* Allocate memory before taking write lock */
+	new_m = vmm_zalloc(sizeof(*new_m));
+	if (buckets_count) {
+		nh = bridge_mac_hash_alloc(buckets_count);
+	}
+
+	/* Acquire write lock */
+	vmm_spin_lock_irqsave_lite(&br->mac_table_lock, f);
+
+	/* Grow hash table if it is still too small */
+	if (nh && (nh->buckets_count > br->mac_hash->buckets_count)) {
+		bridge_mactable_rehash(br, nh);
+		nh = NULL;
+	}
+	h = br->mac_hash;
+
+	/* If mac entry already exist then update only port
+	 * otherwise save (mac, port) in a new mac table entry.
+	 */
+	m = bridge_mactable_find(h, srcmac);
+	if (!m && new_m) {
+		if (br->mac_table_count >= br->mac_table_sz) {
+			bridge_mactable_evict(br);
 		}
+		m = new_m;
+		new_m = NULL;
+		memcpy(m->macaddr, srcmac, 6);
+		m->port = src;
+		m->active = TRUE;
+		list_add_tail_rcu(&m->head, &h->buckets[
+			bridge_mac_hash(srcmac, h->buckets_count)]);
+		br->mac_table_count++;
+		vmm_percpu_counter_inc(&br->stat_learned);
+	} else if (m) {
+		m->port = src;
+		m->active = TRUE;
+	}
 
-		/* Release write lock */
-		vmm_write_unlock_irqrestore_lite(&br->mac_table_lock, f);
+	/* Release write lock */
+	vmm_spin_unlock_irqrestore_lite(&br->mac_table_lock, f);
+
+	if (new_m) {
+		vmm_free(new_m);
+	}
+	if (nh) {
+		vmm_free(nh);
 	}
 
 	return dst;
@@ -176,38 +337,64 @@ static struct vmm_netport *bridge_mactable_learn_find(struct bridge_ctrl *br,
 static void bridge_timer_event(struct vmm_timer_event *ev)
 {
 	u32 i;
-	u64 tstamp;
 	irq_flags_t f;
 	struct bridge_ctrl *br = ev->priv;
-	struct bridge_mac_entry *m;
+	struct bridge_mac_hash *h;
+	struct bridge_mac_entry *m, *nm;
 
 	DPRINTF("%s: bridge expiry event nsw=%s\n",
 		__func__, br->nsw->name);
 
-	/* Retrive current timestamp */
-	tstamp = vmm_timer_timestamp();
-
 	/* Acquire write lock */
-	vmm_write_lock_irqsave_lite(&br->mac_table_lock, f);
-
-	/* Purge old enteries */
-	for (i = 0; i < br->mac_table_sz; i++) {
-		m = &br->mac_table[i];
-		if (m->port &&
-		    ((m->timestamp - tstamp) > BRIDGE_MAC_EXPIRY)) {
+	vmm_spin_lock_irqsave_lite(&br->mac_table_lock, f);
+
+	/* Purge enteries not used since last expiry event */
+	h = br->mac_hash;
+	for (i = 0; i < h->buckets_count; i++) {
+		list_for_each_entry_safe(m, nm, &h->buckets[i], head) {
+			if (m->active) {
+				m->active = FALSE;
+				continue;
+			}
 			DPRINTF("%s: purge port=%s\n",
 				__func__, m->port->name);
-			m->port = NULL;
-			memset(m->macaddr, 0, 6);
-			m->timestamp = 0;
+			bridge_mac_entry_del(br, m);
+			vmm_percpu_counter_inc(&br->stat_expired);
 		}
 	}
 
 	/* Release write lock */
-	vmm_write_unlock_irqrestore_lite(&br->mac_table_lock, f);
+	vmm_spin_unlock_irqrestore_lite(&br->mac_table_lock, f);
 
 	/* Again start the bridge timer event */
-	vmm_timer_event_start(&br->ev, BRIDGE_MAC_EXPIRY);
+	vmm_timer_event_start(&br->ev, br->mac_expiry);
+}
+
+static void bridge_show(struct vmm_netswitch *nsw, struct vmm_chardev *cdev)
+{
+	u32 count, buckets_count;
+	struct bridge_ctrl *br = nsw->priv;
+
+	vmm_rcu_read_lock();
+	count = br->mac_table_count;
+	buckets_count = vmm_rcu_dereference(br->mac_hash)->buckets_count;
+	vmm_rcu_read_unlock();
+
+	vmm_cprintf(cdev, "MAC Table Entries : %d/%d\n",
+		    count, br->mac_table_sz);
+	vmm_cprintf(cdev, "MAC Table Buckets : %d\n", buckets_count);
+	vmm_cprintf(cdev, "MAC Table Expiry  : %"PRIu64" secs\n",
+		    (u64)(br->mac_expiry / 1000000000ULL));
+	vmm_cprintf(cdev, "Unicast Hits      : %"PRIu64"\n",
+		    vmm_percpu_counter_read(&br->stat_hits));
+	vmm_cprintf(cdev, "Unknown/Broadcast : %"PRIu64"\n",
+		    vmm_percpu_counter_read(&br->stat_misses));
+	vmm_cprintf(cdev, "Learned           : %"PRIu64"\n",
+		    vmm_percpu_counter_read(&br->stat_learned));
+	vmm_cprintf(cdev, "Evicted           : %"PRIu64"\n",
+		    vmm_percpu_counter_read(&br->stat_evicted));
+	vmm_cprintf(cdev, "Expired           : %"PRIu64"\n",
+		    vmm_percpu_counter_read(&br->stat_expired));
 }
 
 /**
@@ -284,9 +471,29 @@ static int bridge_port_remove(struct vmm_netswitch *nsw,
 	return VMM_OK;
 }
 
+static void bridge_stats_init(struct bridge_ctrl *br)
+{
+	/* Statistics are optional hence ignore failures */
+	vmm_percpu_counter_init(&br->stat_hits);
+	vmm_percpu_counter_init(&br->stat_misses);
+	vmm_percpu_counter_init(&br->stat_learned);
+	vmm_percpu_counter_init(&br->stat_evicted);
+	vmm_percpu_counter_init(&br->stat_expired);
+}
+
+static void bridge_stats_destroy(struct bridge_ctrl *br)
+{
+	vmm_percpu_counter_destroy(&br->stat_hits);
+	vmm_percpu_counter_destroy(&br->stat_misses);
+	vmm_percpu_counter_destroy(&br->stat_learned);
+	vmm_percpu_counter_destroy(&br->stat_evicted);
+	vmm_percpu_counter_destroy(&br->stat_expired);
+}
+
 static int bridge_probe(struct vmm_device *dev,
 			const struct vmm_devtree_nodeid *nid)
 {
+	u32 expiry_secs;
 	int rc = VMM_OK;
 	struct bridge_ctrl *br;
 	struct vmm_netswitch *nsw = NULL;
@@ -299,6 +506,7 @@ static int bridge_probe(struct vmm_device *dev,
 	nsw->port2switch_xfer = bridge_rx_handler;
 	nsw->port_add = bridge_port_add;
 	nsw->port_remove = bridge_port_remove;
+	nsw->show = bridge_show;
 
 	dev->priv = nsw;
 
@@ -310,11 +518,21 @@ static int bridge_probe(struct vmm_device *dev,
 
 	br->nsw = nsw;
 	INIT_TIMER_EVENT(&br->ev, bridge_timer_event, br);
-	INIT_RW_LOCK(&br->mac_table_lock);
-	br->mac_table_sz = BRIDGE_MAC_TABLE_SZ;
-	br->mac_table = vmm_zalloc(sizeof(struct bridge_mac_entry) *
-				   br->mac_table_sz);
-	if (!br->mac_table) {
+	INIT_SPIN_LOCK(&br->mac_table_lock);
+	bridge_stats_init(br);
+
+	if (vmm_devtree_read_u32(dev->of_node, "mac_table_size",
+				 &br->mac_table_sz) || !br->mac_table_sz) {
+		br->mac_table_sz = BRIDGE_MAC_TABLE_SZ;
+	}
+	if (vmm_devtree_read_u32(dev->of_node, "mac_expiry_secs",
+				 &expiry_secs) || !expiry_secs) {
+		expiry_secs = BRIDGE_MAC_EXPIRY_SECS;
+	}
+	br->mac_expiry = (u64)expiry_secs * 1000000000ULL;
+
+	br->mac_hash = bridge_mac_hash_alloc(BRIDGE_MAC_BUCKETS_MIN);
+	if (!br->mac_hash) {
 		rc = VMM_ENOMEM;
 		goto bridge_alloc_mac_table_fail;
 	}
@@ -324,12 +542,14 @@ static int bridge_probe(struct vmm_device *dev,
 		goto bridge_netswitch_register_fail;
 	}
 
-	vmm_timer_event_start(&br->ev, BRIDGE_MAC_EXPIRY);
+	vmm_timer_event_start(&br->ev, br->mac_expiry);
 
 	return VMM_OK;
 
 bridge_netswitch_register_fail:
+	vmm_free(br->mac_hash);
 bridge_alloc_mac_table_fail:
+	bridge_stats_destroy(br);
 	vmm_free(br);
 bridge_alloc_failed:
 	vmm_netswitch_free(nsw);
@@ -351,7 +571,10 @@ static int bridge_remove(struct vmm_device *dev)
 
 	vmm_netswitch_unregister(nsw);
 
-	vmm_free(br->mac_table);
+	bridge_mactable_cleanup_port(br, NULL);
+	vmm_rcu_synchronize();
+	vmm_free(br->mac_hash);
+	bridge_stats_destroy(br);
 	vmm_free(br);
 
 	vmm_netswitch_free(nsw);
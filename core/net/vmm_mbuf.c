@@ -91,6 +91,9 @@
 #include <vmm_heap.h>
 #include <vmm_host_aspace.h>
 #include <vmm_modules.h>
+#include <vmm_percpu.h>
+#include <vmm_cpumask.h>
+#include <arch_cpu_irq.h>
 #include <net/vmm_mbuf.h>
 #include <libs/list.h>
 #include <libs/stringlib.h>
@@ -102,14 +105,38 @@
  * Mbuffer pool.
  */
 
-#define EPOOL_SLAB_COUNT		4
+#define EPOOL_SLAB_COUNT		VMM_MBUF_EXT_SLAB_COUNT
+#define MBUF_CPU_CACHE_SIZE		CONFIG_NET_MBUF_CPU_CACHE_SIZE
+
+/* Pool of fixed size buffers with per-CPU caches in front */
+struct vmm_mbufpool_slab {
+	struct mempool *mp;
+	u32 buf_size;
+	u32 buf_count;
+	u32 index;
+};
+
+struct vmm_mbufpool_cache {
+	u32 count;
+	void *objs[MBUF_CPU_CACHE_SIZE];
+};
+
+struct vmm_mbufpool_cpu {
+	struct vmm_mbufpool_cache cache[EPOOL_SLAB_COUNT + 1];
+	struct vmm_mbufpool_slab_stats stats[EPOOL_SLAB_COUNT + 1];
+	u64 ext_heap_allocs;
+	u64 ext_dma_allocs;
+};
 
 struct vmm_mbufpool_ctrl {
-	struct mempool *mpool;
-	struct mempool *epool_slabs[EPOOL_SLAB_COUNT];
+	/* Slab index EPOOL_SLAB_COUNT is the mbuf pool */
+	struct vmm_mbufpool_slab slabs[EPOOL_SLAB_COUNT + 1];
 };
 
+#define MBUF_SLAB			(&mbpctrl.slabs[EPOOL_SLAB_COUNT])
+
 static struct vmm_mbufpool_ctrl mbpctrl;
+static DEFINE_PER_CPU(struct vmm_mbufpool_cpu, mbpcpu);
 
 static u32 epool_slab_buf_size(u32 slab)
 {
@@ -122,6 +149,12 @@ static u32 epool_slab_buf_size(u32 slab)
 		return 1536;
 	case 3:
 		return 2048;
+	case 4:
+		return 4096;
+	case 5:
+		return 9216;
+	case 6:
+		return 16384;
 	default:
 		break;
 	};
@@ -129,7 +162,7 @@ static u32 epool_slab_buf_size(u32 slab)
 	return 0;
 }
 
-static u32 epool_slab_buf_count(u32 pool_sz, u32 slab)
+static u32 epool_slab_buf_count(u32 pool_sz, u32 jumbo_pool_sz, u32 slab)
 {
 	u32 slab_size, buf_size, weight, total_weight;
 
@@ -146,10 +179,26 @@ static u32 epool_slab_buf_count(u32 pool_sz, u32 slab)
 	case 3:
 		weight = 2;
 		break;
+	case 4:
+		weight = 2;
+		break;
+	case 5:
+		weight = 1;
+		break;
+	case 6:
+		weight = 1;
+		break;
 	default:
 		return 0;
 	};
-	total_weight = 8;
+
+	/* Jumbo slabs are carved out of separate pool size */
+	if (slab < 4) {
+		total_weight = 8;
+	} else {
+		total_weight = 4;
+		pool_sz = jumbo_pool_sz;
+	}
 
 	buf_size = epool_slab_buf_size(slab);
 	if (!buf_size) {
@@ -164,35 +213,136 @@ static u32 epool_slab_buf_count(u32 pool_sz, u32 slab)
 	return udiv32(slab_size, buf_size);
 }
 
+static void *mbufpool_slab_alloc(struct vmm_mbufpool_slab *s)
+{
+	void *obj;
+	irq_flags_t flags;
+	struct vmm_mbufpool_cpu *pc;
+	struct vmm_mbufpool_cache *c;
+
+	arch_cpu_irq_save(flags);
+
+	pc = &this_cpu(mbpcpu);
+	c = &pc->cache[s->index];
+	pc->stats[s->index].allocs++;
+
+	if (c->count) {
+		obj = c->objs[--c->count];
+		pc->stats[s->index].cache_hits++;
+	} else {
+		/* Refill half of cache from pool in one go */
+		c->count = (s->mp) ? mempool_malloc_bulk(s->mp, c->objs,
+					MBUF_CPU_CACHE_SIZE / 2) : 0;
+		if (c->count) {
+			obj = c->objs[--c->count];
+		} else {
+			obj = NULL;
+			pc->stats[s->index].pool_misses++;
+		}
+	}
+
+	arch_cpu_irq_restore(flags);
+
+	return obj;
+}
+
+static void mbufpool_slab_free(struct vmm_mbufpool_slab *s, void *obj)
+{
+	irq_flags_t flags;
+	struct vmm_mbufpool_cache *c;
+
+	arch_cpu_irq_save(flags);
+
+	c = &this_cpu(mbpcpu).cache[s->index];
+
+	/* Return half of cache to pool when cache is full */
+	if (c->count == MBUF_CPU_CACHE_SIZE) {
+		c->count -= MBUF_CPU_CACHE_SIZE / 2;
+		mempool_free_bulk(s->mp, &c->objs[c->count],
+				  MBUF_CPU_CACHE_SIZE / 2);
+	}
+	c->objs[c->count++] = obj;
+
+	arch_cpu_irq_restore(flags);
+}
+
+int vmm_mbufpool_get_stats(struct vmm_mbufpool_stats *stats)
+{
+	u32 c, slab;
+	struct vmm_mbufpool_cpu *pc;
+	struct vmm_mbufpool_slab_stats *st;
+
+	if (!stats) {
+		return VMM_EINVALID;
+	}
+
+	memset(stats, 0, sizeof(*stats));
+	for (slab = 0; slab <= EPOOL_SLAB_COUNT; slab++) {
+		st = (slab < EPOOL_SLAB_COUNT) ?
+			&stats->ext[slab] : &stats->mbuf;
+		st->buf_size = mbpctrl.slabs[slab].buf_size;
+		st->buf_count = mbpctrl.slabs[slab].buf_count;
+		if (mbpctrl.slabs[slab].mp) {
+			st->buf_free = mempool_free_entities(
+						mbpctrl.slabs[slab].mp);
+		}
+		for_each_online_cpu(c) {
+			pc = &per_cpu(mbpcpu, c);
+			st->buf_free += pc->cache[slab].count;
+			st->allocs += pc->stats[slab].allocs;
+			st->cache_hits += pc->stats[slab].cache_hits;
+			st->pool_misses += pc->stats[slab].pool_misses;
+		}
+	}
+	for_each_online_cpu(c) {
+		pc = &per_cpu(mbpcpu, c);
+		stats->ext_heap_allocs += pc->ext_heap_allocs;
+		stats->ext_dma_allocs += pc->ext_dma_allocs;
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_mbufpool_get_stats);
+
+static struct mempool *mbufpool_create(u32 b_size, u32 b_count)
+{
+	if (!b_size || !b_count) {
+		return NULL;
+	}
+
+	return mempool_ram_create(b_size,
+				  VMM_SIZE_TO_PAGE(b_size * b_count),
+				  VMM_MEMORY_FLAGS_NORMAL);
+}
+
 int __init vmm_mbufpool_init(void)
 {
-	u32 slab, b_size, b_count, epool_sz;
+	u32 slab, epool_sz, jumbo_sz;
+	struct vmm_mbufpool_slab *s;
 
 	memset(&mbpctrl, 0, sizeof(mbpctrl));
 
 	/* Create mbuf pool */
-	b_size = sizeof(struct vmm_mbuf);
-	b_count = CONFIG_NET_MBUF_POOL_SIZE;
-	mbpctrl.mpool = mempool_ram_create(b_size,
-					VMM_SIZE_TO_PAGE(b_size * b_count),
-					VMM_MEMORY_FLAGS_NORMAL);
-	if (!mbpctrl.mpool) {
+	s = MBUF_SLAB;
+	s->index = EPOOL_SLAB_COUNT;
+	s->buf_size = sizeof(struct vmm_mbuf);
+	s->buf_count = CONFIG_NET_MBUF_POOL_SIZE;
+	s->mp = mbufpool_create(s->buf_size, s->buf_count);
+	if (!s->mp) {
 		return VMM_ENOMEM;
 	}
+	s->buf_count = mempool_total_entities(s->mp);
 
 	/* Create ext slab pools */
 	epool_sz = (CONFIG_NET_MBUF_EXT_POOL_SIZE_KB * 1024);
+	jumbo_sz = (CONFIG_NET_MBUF_JUMBO_POOL_SIZE_KB * 1024);
 	for (slab = 0; slab < EPOOL_SLAB_COUNT; slab++) {
-		b_size = epool_slab_buf_size(slab);
-		b_count = epool_slab_buf_count(epool_sz, slab);
-		if (b_count && b_size) {
-			mbpctrl.epool_slabs[slab] = 
-				mempool_ram_create(b_size,
-					VMM_SIZE_TO_PAGE(b_size * b_count),
-					VMM_MEMORY_FLAGS_NORMAL);
-		} else {
-			mbpctrl.epool_slabs[slab] = NULL;
-		}
+		s = &mbpctrl.slabs[slab];
+		s->index = slab;
+		s->buf_size = epool_slab_buf_size(slab);
+		s->buf_count = epool_slab_buf_count(epool_sz, jumbo_sz, slab);
+		s->mp = mbufpool_create(s->buf_size, s->buf_count);
+		s->buf_count = (s->mp) ? mempool_total_entities(s->mp) : 0;
 	}
 
 	return VMM_OK;
@@ -200,18 +350,26 @@ int __init vmm_mbufpool_init(void)
 
 void __exit vmm_mbufpool_exit(void)
 {
-	u32 slab;
-
-	/* Destroy mbuf pool */
-	if (mbpctrl.mpool) {
-		mempool_destroy(mbpctrl.mpool);
-	}
+	u32 c, slab;
+	struct vmm_mbufpool_slab *s;
+	struct vmm_mbufpool_cache *cache;
+
+	for (slab = 0; slab <= EPOOL_SLAB_COUNT; slab++) {
+		s = &mbpctrl.slabs[slab];
+		if (!s->mp) {
+			continue;
+		}
 
-	/* Destroy ext slab pools */
-	for (slab = 0; slab < EPOOL_SLAB_COUNT; slab++) {
-		if (mbpctrl.epool_slabs[slab]) {
-			mempool_destroy(mbpctrl.epool_slabs[slab]);
+		/* Drain per-CPU caches */
+		for_each_online_cpu(c) {
+			cache = &per_cpu(mbpcpu, c).cache[slab];
+			mempool_free_bulk(s->mp, cache->objs, cache->count);
+			cache->count = 0;
 		}
+
+		/* Destroy pool */
+		mempool_destroy(s->mp);
+		s->mp = NULL;
 	}
 }
 
@@ -253,7 +411,7 @@ VMM_EXPORT_SYMBOL(m_copydata);
 
 static void mbuf_pool_free(struct vmm_mbuf *m)
 {
-	mempool_free(mbpctrl.mpool, m);
+	mbufpool_slab_free(MBUF_SLAB, m);
 }
 
 static void mbuf_heap_free(struct vmm_mbuf *m)
@@ -272,8 +430,9 @@ struct vmm_mbuf *m_get(int nowait, int flags)
 
 	/* TODO: implement non-blocking variant */
 
-	m = mempool_zalloc(mbpctrl.mpool);
+	m = mbufpool_slab_alloc(MBUF_SLAB);
 	if (m) {
+		memset(m, 0, sizeof(*m));
 		m->m_freefn = mbuf_pool_free;
 	} else if (NULL != (m = vmm_zalloc(sizeof(struct vmm_mbuf)))) {
 		m->m_freefn = mbuf_heap_free;
@@ -289,7 +448,7 @@ struct vmm_mbuf *m_get(int nowait, int flags)
 	if (flags & M_PKTHDR) {
 		m->m_pktlen = 0;
 	}
-	m->m_ref = 1;
+	arch_atomic_write(&m->m_ref, 1);
 
 	return m;
 }
@@ -297,9 +456,7 @@ VMM_EXPORT_SYMBOL(m_get);
 
 static void ext_pool_free(struct vmm_mbuf *m, void *ptr, u32 size, void *arg)
 {
-	struct mempool *mp = arg;
-
-	mempool_free(mp, ptr);
+	mbufpool_slab_free(arg, ptr);
 }
 
 static void ext_heap_free(struct vmm_mbuf *m, void *ptr, u32 size, void *arg)
@@ -314,29 +471,36 @@ static void ext_dma_free(struct vmm_mbuf *m, void *ptr, u32 size, void *arg)
 
 void *m_ext_get(struct vmm_mbuf *m, u32 size, enum vmm_mbuf_alloc_types how)
 {
-	void *buf;
+	void *buf = NULL;
 	u32 slab;
-	struct mempool *mp = NULL;
+	irq_flags_t flags;
+	struct vmm_mbufpool_slab *s = NULL;
 
 	if (VMM_MBUF_ALLOC_DMA == how) {
 		buf = vmm_dma_malloc(size);
 		if (!buf) {
 			return NULL;
 		}
+		arch_cpu_irq_save(flags);
+		this_cpu(mbpcpu).ext_dma_allocs++;
+		arch_cpu_irq_restore(flags);
 		m->m_flags |= M_EXT_DMA;
 		MEXTADD(m, buf, size, ext_dma_free, NULL);
 	} else {
 		for (slab = 0; slab < EPOOL_SLAB_COUNT; slab++) {
 			if (size <= epool_slab_buf_size(slab)) {
-				mp = mbpctrl.epool_slabs[slab];
+				s = &mbpctrl.slabs[slab];
 				break;
 			}
 		}
 
-		if (mp && (buf = mempool_malloc(mp))) {
+		if (s && (buf = mbufpool_slab_alloc(s))) {
 			m->m_flags |= M_EXT_POOL;
-			MEXTADD(m, buf, size, ext_pool_free, mp);
+			MEXTADD(m, buf, size, ext_pool_free, s);
 		} else if ((buf = vmm_malloc(size))) {
+			arch_cpu_irq_save(flags);
+			this_cpu(mbpcpu).ext_heap_allocs++;
+			arch_cpu_irq_restore(flags);
 			m->m_flags |= M_EXT_HEAP;
 			MEXTADD(m, buf, size, ext_heap_free, NULL);
 		} else {
@@ -377,7 +541,8 @@ void m_ext_dma_ensure(struct vmm_mbuf *m)
 
 void m_ext_free(struct vmm_mbuf *m)
 {
-	if (!(--(m->m_extref)) && !(m->m_flags & M_EXT_DONTFREE)) {
+	if (!arch_atomic_sub_return(&m->m_extref, 1) &&
+	    !(m->m_flags & M_EXT_DONTFREE)) {
 		/* dropping the last reference */
 		if (m->m_extfree) {
 			(*m->m_extfree)(m, m->m_extbuf, m->m_extlen, m->m_extarg);
@@ -385,7 +550,7 @@ void m_ext_free(struct vmm_mbuf *m)
 			BUG_ON(1);
 		}
 	}
-	if (!(--(m->m_ref))) {
+	if (!arch_atomic_sub_return(&m->m_ref, 1)) {
 		if (m->m_freefn) {
 			m->m_freefn(m);
 		} else {
@@ -437,7 +602,7 @@ static void mbuf_data_dump(char *buf, unsigned int buflen)
 void m_dump(struct vmm_mbuf *m)
 {
 	vmm_printf("MBuf header\n");
-	vmm_printf("  MBuf ref:      %d\n", m->m_ref);
+	vmm_printf("  MBuf ref:      %ld\n", arch_atomic_read(&m->m_ref));
 	vmm_printf("  MBuf data:     %p\n", m->m_data);
 	vmm_printf("  MBuf free fct: %p\n", m->m_freefn);
 	vmm_printf("  MBuf len:      %d\n", m->m_len);
@@ -447,7 +612,7 @@ void m_dump(struct vmm_mbuf *m)
 	vmm_printf("MBuf ext\n");
 	vmm_printf("  MBuf buf:      %p\n", m->m_extbuf);
 	vmm_printf("  MBuf len:      %d\n", m->m_extlen);
-	vmm_printf("  MBuf ref cnt:  %d\n", m->m_extref);
+	vmm_printf("  MBuf ref cnt:  %ld\n", arch_atomic_read(&m->m_extref));
 	vmm_printf("  MBuf free:     %p\n", m->m_extfree);
 	vmm_printf("  MBuf free arg: %p\n", m->m_extarg);
 	vmm_printf("\nMBuf data dump (%d):\n", m->m_len);
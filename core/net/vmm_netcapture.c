@@ -0,0 +1,343 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_netcapture.c
+ * @author agent (agent@local)
+ * @brief Per-port packet capture ring implementation
+ *
+ * Writers claim a ring slot by atomically incrementing the ring head
+ * and publish it by storing slot sequence number after the slot data.
+ * The reader only copies out slots whose sequence number is same before
+ * and after the copy so a slot being overwritten is simply skipped.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_wallclock.h>
+#include <vmm_delay.h>
+#include <vmm_mutex.h>
+#include <vmm_modules.h>
+#include <arch_atomic.h>
+#include <arch_barrier.h>
+#include <net/vmm_mbuf.h>
+#include <net/vmm_netport.h>
+#include <net/vmm_netcapture.h>
+#include <libs/log2.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+
+/* pcap file format with nanosecond timestamps */
+#define NETCAPTURE_PCAP_MAGIC		0xa1b23c4d
+#define NETCAPTURE_PCAP_VER_MAJOR	2
+#define NETCAPTURE_PCAP_VER_MINOR	4
+#define NETCAPTURE_PCAP_LINKTYPE_ETH	1
+
+struct netcapture_pcap_hdr {
+	u32 magic;
+	u16 version_major;
+	u16 version_minor;
+	s32 thiszone;
+	u32 sigfigs;
+	u32 snaplen;
+	u32 linktype;
+} __packed;
+
+struct netcapture_pcap_rec {
+	u32 ts_sec;
+	u32 ts_nsec;
+	u32 incl_len;
+	u32 orig_len;
+} __packed;
+
+struct netcapture_slot {
+	u32 seq;		/* Ring index + 1 when slot is valid */
+	u32 dir;
+	u32 len;
+	u32 caplen;
+	u64 tstamp;
+	u8 data[0];
+};
+
+struct vmm_netcapture {
+	u32 snaplen;
+	u32 count;
+	u32 dirs;
+	u32 slot_size;
+	atomic_t head;
+	u64 start_tstamp;
+	struct vmm_timeval start_tv;
+	void *slots;
+};
+
+/* Number of writers which may be looking at some capture ring */
+static atomic_t netcapture_users = ARCH_ATOMIC_INITIALIZER(0);
+
+/* Serializes start, stop and read of capture rings */
+static DEFINE_MUTEX(netcapture_lock);
+
+static inline struct netcapture_slot *netcapture_slot(
+					struct vmm_netcapture *cap, u32 idx)
+{
+	return cap->slots + (idx & (cap->count - 1)) * cap->slot_size;
+}
+
+void __vmm_netcapture_record(struct vmm_netport *port,
+			     struct vmm_mbuf *mbuf, u32 dir)
+{
+	u32 idx;
+	struct netcapture_slot *s;
+	struct vmm_netcapture *cap;
+
+	arch_atomic_add(&netcapture_users, 1);
+	arch_smp_mb();
+
+	cap = port->capture;
+	if (!cap || !(cap->dirs & dir) || !mbuf) {
+		goto done;
+	}
+
+	idx = arch_atomic_add_return(&cap->head, 1) - 1;
+	s = netcapture_slot(cap, idx);
+
+	s->seq = 0;
+	arch_smp_wmb();
+
+	s->dir = dir;
+	s->len = mbuf->m_pktlen;
+	s->caplen = (s->len < cap->snaplen) ? s->len : cap->snaplen;
+	s->tstamp = vmm_timer_timestamp();
+	m_copydata(mbuf, 0, s->caplen, s->data);
+
+	arch_smp_wmb();
+	s->seq = idx + 1;
+
+done:
+	arch_atomic_sub(&netcapture_users, 1);
+}
+VMM_EXPORT_SYMBOL(__vmm_netcapture_record);
+
+int vmm_netcapture_start(struct vmm_netport *port,
+			 u32 snaplen, u32 count, u32 dirs)
+{
+	int rc = VMM_OK;
+	struct vmm_netcapture *cap;
+
+	if (!port || !(dirs & VMM_NETCAPTURE_DIR_BOTH)) {
+		return VMM_EINVALID;
+	}
+
+	snaplen = (snaplen) ? snaplen : VMM_NETCAPTURE_DEF_SNAPLEN;
+	count = (count) ? count : VMM_NETCAPTURE_DEF_COUNT;
+	if ((VMM_NETCAPTURE_MAX_SNAPLEN < snaplen) ||
+	    (VMM_NETCAPTURE_MAX_COUNT < count)) {
+		return VMM_EINVALID;
+	}
+
+	cap = vmm_zalloc(sizeof(*cap));
+	if (!cap) {
+		return VMM_ENOMEM;
+	}
+	cap->snaplen = snaplen;
+	cap->count = roundup_pow_of_two(count);
+	cap->dirs = dirs & VMM_NETCAPTURE_DIR_BOTH;
+	cap->slot_size = align(sizeof(struct netcapture_slot) + snaplen, 8);
+	ARCH_ATOMIC_INIT(&cap->head, 0);
+	cap->slots = vmm_zalloc(cap->count * cap->slot_size);
+	if (!cap->slots) {
+		vmm_free(cap);
+		return VMM_ENOMEM;
+	}
+	vmm_wallclock_get_local_time(&cap->start_tv);
+	cap->start_tstamp = vmm_timer_timestamp();
+
+	vmm_mutex_lock(&netcapture_lock);
+
+	if (port->capture) {
+		rc = VMM_EEXIST;
+	} else {
+		arch_smp_wmb();
+		port->capture = cap;
+	}
+
+	vmm_mutex_unlock(&netcapture_lock);
+
+	if (rc) {
+		vmm_free(cap->slots);
+		vmm_free(cap);
+	}
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vmm_netcapture_start);
+
+int vmm_netcapture_stop(struct vmm_netport *port)
+{
+	struct vmm_netcapture *cap;
+
+	if (!port) {
+		return VMM_EINVALID;
+	}
+
+	vmm_mutex_lock(&netcapture_lock);
+
+	cap = port->capture;
+	if (!cap) {
+		vmm_mutex_unlock(&netcapture_lock);
+		return VMM_ENOTAVAIL;
+	}
+	port->capture = NULL;
+	arch_smp_mb();
+
+	/* Wait for writers which might have seen old pointer */
+	while (arch_atomic_read(&netcapture_users)) {
+		vmm_udelay(10);
+	}
+
+	vmm_mutex_unlock(&netcapture_lock);
+
+	vmm_free(cap->slots);
+	vmm_free(cap);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_netcapture_stop);
+
+int vmm_netcapture_get_stats(struct vmm_netport *port,
+			     struct vmm_netcapture_stats *stats)
+{
+	int rc = VMM_OK;
+	u32 head;
+	struct vmm_netcapture *cap;
+
+	if (!port || !stats) {
+		return VMM_EINVALID;
+	}
+
+	vmm_mutex_lock(&netcapture_lock);
+
+	cap = port->capture;
+	if (cap) {
+		head = arch_atomic_read(&cap->head);
+		stats->snaplen = cap->snaplen;
+		stats->count = cap->count;
+		stats->dirs = cap->dirs;
+		stats->packets = head;
+		stats->overwritten = (head > cap->count) ?
+					(head - cap->count) : 0;
+	} else {
+		rc = VMM_ENOTAVAIL;
+	}
+
+	vmm_mutex_unlock(&netcapture_lock);
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vmm_netcapture_get_stats);
+
+static void netcapture_timeval(struct vmm_netcapture *cap, u64 tstamp,
+			       struct netcapture_pcap_rec *rec)
+{
+	u64 ns;
+
+	ns = cap->start_tv.tv_nsec;
+	if (tstamp > cap->start_tstamp) {
+		ns += tstamp - cap->start_tstamp;
+	}
+
+	rec->ts_sec = cap->start_tv.tv_sec + udiv64(ns, 1000000000ULL);
+	rec->ts_nsec = umod64(ns, 1000000000ULL);
+}
+
+int vmm_netcapture_read(struct vmm_netport *port, void *priv,
+			size_t (*write)(void *priv, void *buf, size_t len))
+{
+	int rc = VMM_OK;
+	u32 i, seq, head, tail, len;
+	struct netcapture_slot *s, *copy;
+	struct netcapture_pcap_hdr hdr;
+	struct netcapture_pcap_rec rec;
+	struct vmm_netcapture *cap;
+
+	if (!port || !write) {
+		return VMM_EINVALID;
+	}
+
+	vmm_mutex_lock(&netcapture_lock);
+
+	cap = port->capture;
+	if (!cap) {
+		rc = VMM_ENOTAVAIL;
+		goto done;
+	}
+
+	copy = vmm_malloc(cap->slot_size);
+	if (!copy) {
+		rc = VMM_ENOMEM;
+		goto done;
+	}
+
+	hdr.magic = NETCAPTURE_PCAP_MAGIC;
+	hdr.version_major = NETCAPTURE_PCAP_VER_MAJOR;
+	hdr.version_minor = NETCAPTURE_PCAP_VER_MINOR;
+	hdr.thiszone = 0;
+	hdr.sigfigs = 0;
+	hdr.snaplen = cap->snaplen;
+	hdr.linktype = NETCAPTURE_PCAP_LINKTYPE_ETH;
+	if (write(priv, &hdr, sizeof(hdr)) != sizeof(hdr)) {
+		rc = VMM_EIO;
+		goto done_free;
+	}
+
+	head = arch_atomic_read(&cap->head);
+	tail = (head > cap->count) ? (head - cap->count) : 0;
+	for (i = tail; i != head; i++) {
+		s = netcapture_slot(cap, i);
+
+		/* Copy slot and drop it if written meanwhile */
+		seq = s->seq;
+		if (seq != (i + 1)) {
+			continue;
+		}
+		arch_smp_rmb();
+		len = (s->caplen < cap->snaplen) ? s->caplen : cap->snaplen;
+		memcpy(copy, s, sizeof(*copy) + len);
+		arch_smp_rmb();
+		if (s->seq != seq) {
+			continue;
+		}
+
+		netcapture_timeval(cap, copy->tstamp, &rec);
+		rec.incl_len = len;
+		rec.orig_len = copy->len;
+		if ((write(priv, &rec, sizeof(rec)) != sizeof(rec)) ||
+		    (write(priv, copy->data, len) != len)) {
+			rc = VMM_EIO;
+			break;
+		}
+	}
+
+done_free:
+	vmm_free(copy);
+done:
+	vmm_mutex_unlock(&netcapture_lock);
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vmm_netcapture_read);
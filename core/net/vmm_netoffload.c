@@ -0,0 +1,305 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_netoffload.c
+ * @author agent (agent@local)
+ * @brief Software fallback for checksum and segmentation offloads.
+ *
+ * Packets carrying offload metadata (partial checksum or GSO) are
+ * passed as-is between ports which support the offloads. When such
+ * packet leaves through a port which cannot offload then checksum
+ * and segmentation is done here, lazily, only for that port.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <net/vmm_mbuf.h>
+#include <net/vmm_protocol.h>
+#include <net/vmm_netport.h>
+#include <net/vmm_netoffload.h>
+#include <libs/stringlib.h>
+
+#define ETHER_TYPE_VLAN		0x8100
+#define IPV6_HLEN		40
+#define IP_PROTO_TCP		6
+#define TCP_FLAG_FIN		0x01
+#define TCP_FLAG_PSH		0x08
+#define TCP_FLAG_CWR		0x80
+
+static u32 netoffload_csum_add(const u8 *buf, u32 len, u32 sum)
+{
+	while (len > 1) {
+		sum += ((u32)buf[0] << 8) | buf[1];
+		buf += 2;
+		len -= 2;
+	}
+	if (len) {
+		sum += (u32)buf[0] << 8;
+	}
+
+	return sum;
+}
+
+static u16 netoffload_csum_fold(u32 sum)
+{
+	while (sum >> 16) {
+		sum = (sum & 0xFFFF) + (sum >> 16);
+	}
+
+	return (u16)~sum;
+}
+
+static inline void netoffload_put_be16(u8 *p, u16 val)
+{
+	p[0] = val >> 8;
+	p[1] = val & 0xFF;
+}
+
+static inline u16 netoffload_get_be16(const u8 *p)
+{
+	return ((u16)p[0] << 8) | p[1];
+}
+
+static inline u32 netoffload_get_be32(const u8 *p)
+{
+	return ((u32)p[0] << 24) | ((u32)p[1] << 16) |
+	       ((u32)p[2] << 8) | p[3];
+}
+
+static inline void netoffload_put_be32(u8 *p, u32 val)
+{
+	p[0] = val >> 24;
+	p[1] = (val >> 16) & 0xFF;
+	p[2] = (val >> 8) & 0xFF;
+	p[3] = val & 0xFF;
+}
+
+/* Allocate new mbuf with copy of first len bytes of given mbuf */
+static struct vmm_mbuf *netoffload_copy(struct vmm_mbuf *m, u32 len,
+					u32 size)
+{
+	struct vmm_mbuf *n;
+
+	MGETHDR(n, 0, 0);
+	if (!n) {
+		return NULL;
+	}
+	MEXTMALLOC(n, size, 0);
+	if (!n->m_extbuf) {
+		m_freem(n);
+		return NULL;
+	}
+	if (len) {
+		m_copydata(m, 0, len, mtod(n, u8 *));
+	}
+	n->m_len = n->m_pktlen = len;
+
+	return n;
+}
+
+bool vmm_netoffload_required(struct vmm_netport *dst,
+			     struct vmm_mbuf *mbuf)
+{
+	if (!dst || !mbuf || !(mbuf->m_flags & M_PKTHDR)) {
+		return FALSE;
+	}
+
+	switch (mbuf->m_pkthdr.gso_type) {
+	case M_GSO_TCPV4:
+		if (!(dst->flags & VMM_NETPORT_OFFLOAD_TSO4) ||
+		    !(dst->flags & VMM_NETPORT_OFFLOAD_CSUM)) {
+			return TRUE;
+		}
+		break;
+	case M_GSO_TCPV6:
+		if (!(dst->flags & VMM_NETPORT_OFFLOAD_TSO6) ||
+		    !(dst->flags & VMM_NETPORT_OFFLOAD_CSUM)) {
+			return TRUE;
+		}
+		break;
+	default:
+		break;
+	};
+
+	if ((mbuf->m_pkthdr.csum_flags & M_CSUM_PARTIAL) &&
+	    !(dst->flags & VMM_NETPORT_OFFLOAD_CSUM)) {
+		return TRUE;
+	}
+
+	return FALSE;
+}
+VMM_EXPORT_SYMBOL(vmm_netoffload_required);
+
+static int netoffload_csum_xfer(struct vmm_netport *dst,
+				struct vmm_mbuf *mbuf)
+{
+	u8 *buf;
+	u32 start, off, len = mbuf->m_pktlen;
+	struct vmm_mbuf *n;
+
+	start = mbuf->m_pkthdr.csum_start;
+	off = start + mbuf->m_pkthdr.csum_offset;
+	if (len < (off + 2)) {
+		return VMM_EINVALID;
+	}
+
+	n = netoffload_copy(mbuf, len, len);
+	if (!n) {
+		return VMM_ENOMEM;
+	}
+	buf = mtod(n, u8 *);
+
+	/* Checksum field already holds pseudo-header sum */
+	netoffload_put_be16(&buf[off], netoffload_csum_fold(
+			netoffload_csum_add(&buf[start], len - start, 0)));
+	n->m_pkthdr.csum_flags = M_CSUM_VALID;
+
+	return dst->switch2port_xfer(dst, n);
+}
+
+static int netoffload_tso_xfer(struct vmm_netport *dst,
+			       struct vmm_mbuf *mbuf)
+{
+	int rc;
+	u8 *hdr, *buf, *ip, *tcp, flags;
+	u32 l3off, thoff, tcphlen, hlen, len, payload, pos, seg, seq;
+	u32 sum, i, mss = mbuf->m_pkthdr.gso_size;
+	u16 ipid, l4len;
+	bool v4 = (mbuf->m_pkthdr.gso_type == M_GSO_TCPV4);
+	struct vmm_mbuf *h, *n;
+
+	len = mbuf->m_pktlen;
+	thoff = mbuf->m_pkthdr.csum_start;
+	if (!mss || (len < (thoff + TCP_HLEN))) {
+		return VMM_EINVALID;
+	}
+
+	/* Linear copy of headers */
+	h = netoffload_copy(mbuf, thoff + TCP_HLEN, thoff + 60);
+	if (!h) {
+		return VMM_ENOMEM;
+	}
+	hdr = mtod(h, u8 *);
+	l3off = ETHER_HLEN;
+	if (netoffload_get_be16(&hdr[12]) == ETHER_TYPE_VLAN) {
+		l3off += 4;
+	}
+	tcphlen = (hdr[thoff + 12] >> 4) * 4;
+	hlen = thoff + tcphlen;
+	if ((tcphlen < TCP_HLEN) || (len < hlen) ||
+	    (thoff < (l3off + (v4 ? IP4_HLEN : IPV6_HLEN)))) {
+		m_freem(h);
+		return VMM_EINVALID;
+	}
+	m_copydata(mbuf, 0, hlen, hdr);
+	payload = len - hlen;
+	ip = &hdr[l3off];
+	tcp = &hdr[thoff];
+	seq = netoffload_get_be32(&tcp[4]);
+	flags = tcp[13];
+	ipid = netoffload_get_be16(&ip[4]);
+
+	for (pos = 0, i = 0, rc = VMM_OK; pos < payload; pos += seg, i++) {
+		seg = ((payload - pos) < mss) ? (payload - pos) : mss;
+
+		n = netoffload_copy(h, hlen, hlen + seg);
+		if (!n) {
+			rc = VMM_ENOMEM;
+			break;
+		}
+		buf = mtod(n, u8 *);
+		m_copydata(mbuf, hlen + pos, seg, &buf[hlen]);
+		n->m_len = n->m_pktlen = hlen + seg;
+
+		ip = &buf[l3off];
+		tcp = &buf[thoff];
+		l4len = tcphlen + seg;
+
+		/* Fix up IP header */
+		if (v4) {
+			netoffload_put_be16(&ip[2], (thoff - l3off) + l4len);
+			netoffload_put_be16(&ip[4], ipid + i);
+			netoffload_put_be16(&ip[10], 0);
+			netoffload_put_be16(&ip[10], netoffload_csum_fold(
+				netoffload_csum_add(ip, (ip[0] & 0xF) * 4, 0)));
+		} else {
+			netoffload_put_be16(&ip[4],
+				(thoff - l3off - IPV6_HLEN) + l4len);
+		}
+
+		/* Fix up TCP header */
+		netoffload_put_be32(&tcp[4], seq + pos);
+		tcp[13] = flags;
+		if ((pos + seg) < payload) {
+			tcp[13] &= ~(TCP_FLAG_FIN | TCP_FLAG_PSH);
+		}
+		if (i) {
+			tcp[13] &= ~TCP_FLAG_CWR;
+		}
+
+		/* Compute full TCP checksum */
+		if (v4) {
+			sum = netoffload_csum_add(&ip[12], 8, 0);
+		} else {
+			sum = netoffload_csum_add(&ip[8], 32, 0);
+		}
+		sum += IP_PROTO_TCP + l4len;
+		netoffload_put_be16(&tcp[16], 0);
+		netoffload_put_be16(&tcp[16], netoffload_csum_fold(
+				netoffload_csum_add(tcp, l4len, sum)));
+		n->m_pkthdr.csum_flags = M_CSUM_VALID;
+
+		rc = dst->switch2port_xfer(dst, n);
+		if (rc) {
+			break;
+		}
+	}
+
+	m_freem(h);
+
+	return rc;
+}
+
+int vmm_netoffload_xfer(struct vmm_netport *dst, struct vmm_mbuf *mbuf)
+{
+	if (!dst || !mbuf || !dst->switch2port_xfer) {
+		return VMM_EINVALID;
+	}
+
+	/* Segment unless port takes both GSO and partial checksum */
+	switch (mbuf->m_pkthdr.gso_type) {
+	case M_GSO_TCPV4:
+		if (!(dst->flags & VMM_NETPORT_OFFLOAD_TSO4) ||
+		    !(dst->flags & VMM_NETPORT_OFFLOAD_CSUM)) {
+			return netoffload_tso_xfer(dst, mbuf);
+		}
+		break;
+	case M_GSO_TCPV6:
+		if (!(dst->flags & VMM_NETPORT_OFFLOAD_TSO6) ||
+		    !(dst->flags & VMM_NETPORT_OFFLOAD_CSUM)) {
+			return netoffload_tso_xfer(dst, mbuf);
+		}
+		break;
+	default:
+		break;
+	};
+
+	return netoffload_csum_xfer(dst, mbuf);
+}
+VMM_EXPORT_SYMBOL(vmm_netoffload_xfer);
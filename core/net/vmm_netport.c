@@ -26,10 +26,13 @@
 #include <vmm_stdio.h>
 #include <vmm_modules.h>
 #include <vmm_devdrv.h>
+#include <vmm_timer.h>
 #include <net/vmm_protocol.h>
 #include <net/vmm_netswitch.h>
 #include <net/vmm_netport.h>
+#include <net/vmm_netcapture.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 
 struct vmm_netport_xfer *vmm_netport_alloc_xfer(struct vmm_netport *port)
 {
@@ -71,6 +74,96 @@ void vmm_netport_free_xfer(struct vmm_netport *port,
 }
 VMM_EXPORT_SYMBOL(vmm_netport_free_xfer);
 
+int vmm_netport_qos_set(struct vmm_netport *port, u32 prio,
+			u32 rate_kbps, u32 burst_kb)
+{
+	irq_flags_t flags;
+
+	if (!port || (prio >= VMM_NETPORT_PRIO_COUNT)) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave_lite(&port->qos_lock, flags);
+	port->qos_prio = prio;
+	port->qos_rate = (u64)rate_kbps * 1000 / 8;
+	if (burst_kb) {
+		port->qos_burst = (u64)burst_kb * 1024;
+	} else {
+		port->qos_burst = udiv64(port->qos_rate, 100);
+	}
+	/* Bucket must hold at least one full sized frame */
+	if (port->qos_burst < (port->mtu + 18)) {
+		port->qos_burst = port->mtu + 18;
+	}
+	port->qos_tokens = port->qos_burst;
+	port->qos_tstamp = vmm_timer_timestamp();
+	vmm_spin_unlock_irqrestore_lite(&port->qos_lock, flags);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_netport_qos_set);
+
+int vmm_netport_qos_setup(struct vmm_netport *port,
+			  struct vmm_devtree_node *node)
+{
+	u32 prio = VMM_NETPORT_DEF_PRIO, rate_kbps = 0, burst_kb = 0;
+
+	if (!port || !node) {
+		return VMM_EINVALID;
+	}
+
+	vmm_devtree_read_u32(node, "qos_priority", &prio);
+	vmm_devtree_read_u32(node, "qos_rate_kbps", &rate_kbps);
+	vmm_devtree_read_u32(node, "qos_burst_kb", &burst_kb);
+
+	return vmm_netport_qos_set(port, prio, rate_kbps, burst_kb);
+}
+VMM_EXPORT_SYMBOL(vmm_netport_qos_setup);
+
+bool vmm_netport_qos_admit(struct vmm_netport *port, u32 len)
+{
+	bool ret = TRUE;
+	u64 now, elapsed_us;
+	irq_flags_t flags;
+
+	if (port->qos_rate) {
+		vmm_spin_lock_irqsave_lite(&port->qos_lock, flags);
+
+		/* Refill tokens (in micro-second steps) */
+		now = vmm_timer_timestamp();
+		elapsed_us = udiv64(now - port->qos_tstamp, 1000);
+		if (elapsed_us >= 1000000) {
+			port->qos_tokens = port->qos_burst;
+			port->qos_tstamp = now;
+		} else if (elapsed_us) {
+			port->qos_tokens += udiv64(elapsed_us * port->qos_rate,
+						   1000000);
+			if (port->qos_tokens > port->qos_burst) {
+				port->qos_tokens = port->qos_burst;
+			}
+			port->qos_tstamp += elapsed_us * 1000;
+		}
+
+		if (port->qos_tokens < len) {
+			ret = FALSE;
+		} else {
+			port->qos_tokens -= len;
+		}
+
+		vmm_spin_unlock_irqrestore_lite(&port->qos_lock, flags);
+	}
+
+	if (ret) {
+		vmm_percpu_counter_inc(&port->stat_ingress_pkts);
+		vmm_percpu_counter_add(&port->stat_ingress_bytes, len);
+	} else {
+		vmm_percpu_counter_inc(&port->stat_ingress_drops);
+	}
+
+	return ret;
+}
+VMM_EXPORT_SYMBOL(vmm_netport_qos_admit);
+
 struct vmm_netport *vmm_netport_alloc(char *name, u32 queue_size)
 {
 	u32 i;
@@ -104,6 +197,14 @@ struct vmm_netport *vmm_netport_alloc(char *name, u32 queue_size)
 
 	INIT_SPIN_LOCK(&port->switch2port_xfer_lock);
 
+	port->qos_prio = VMM_NETPORT_DEF_PRIO;
+	INIT_SPIN_LOCK(&port->qos_lock);
+
+	/* Statistics are optional hence ignore failures */
+	vmm_percpu_counter_init(&port->stat_ingress_pkts);
+	vmm_percpu_counter_init(&port->stat_ingress_bytes);
+	vmm_percpu_counter_init(&port->stat_ingress_drops);
+
 	return port;
 }
 VMM_EXPORT_SYMBOL(vmm_netport_alloc);
@@ -114,6 +215,9 @@ int vmm_netport_free(struct vmm_netport *port)
 		return VMM_EFAIL;
 	}
 
+	vmm_percpu_counter_destroy(&port->stat_ingress_pkts);
+	vmm_percpu_counter_destroy(&port->stat_ingress_bytes);
+	vmm_percpu_counter_destroy(&port->stat_ingress_drops);
 	vmm_free(port);
 
 	return VMM_OK;
@@ -172,6 +276,8 @@ int vmm_netport_unregister(struct vmm_netport *port)
 		return rc;
 	}
 
+	vmm_netcapture_stop(port);
+
 	return vmm_devdrv_unregister_device(&port->dev);
 }
 VMM_EXPORT_SYMBOL(vmm_netport_unregister);
@@ -33,10 +33,13 @@
 #include <vmm_modules.h>
 #include <vmm_threads.h>
 #include <vmm_completion.h>
+#include <vmm_trace.h>
 #include <net/vmm_mbuf.h>
 #include <net/vmm_protocol.h>
 #include <net/vmm_netswitch.h>
 #include <net/vmm_netport.h>
+#include <net/vmm_netoffload.h>
+#include <net/vmm_netcapture.h>
 #include <libs/list.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
@@ -127,73 +130,159 @@ if (ether_type(mtod(mbuf, u8 *)) == 0x0806	/* ARP */) {		\
 #define DUMP_NETSWITCH_PKT(mbuf)
 #endif
 
+/* Weighted round-robin quantum of non-strict priorities */
+#define NETSWITCH_PRIO_WEIGHT(prio)	(1 << (VMM_NETPORT_PRIO_COUNT - 1 - (prio)))
+
 struct vmm_netswitch_bh_ctrl {
 	struct vmm_thread *thread;
 	struct vmm_completion xfer_cmpl;
 	vmm_spinlock_t xfer_list_lock;
-	struct dlist xfer_list;
+	u32 xfer_count;
+	struct dlist xfer_list[VMM_NETPORT_PRIO_COUNT];
 };
 
 static DEFINE_PER_CPU(struct vmm_netswitch_bh_ctrl, nbctrl);
 
 static void __init netswitch_bh_init(struct vmm_netswitch_bh_ctrl *nbp)
 {
+	u32 prio;
+
 	INIT_COMPLETION(&nbp->xfer_cmpl);
 	INIT_SPIN_LOCK(&nbp->xfer_list_lock);
-	INIT_LIST_HEAD(&nbp->xfer_list);
+	nbp->xfer_count = 0;
+	for (prio = 0; prio < VMM_NETPORT_PRIO_COUNT; prio++) {
+		INIT_LIST_HEAD(&nbp->xfer_list[prio]);
+	}
+}
+
+/* Bottom-half of current host CPU (Note: isolated host CPUs have no
+ * bottom-half thread so their transfers go to first housekeeping CPU)
+ */
+static inline struct vmm_netswitch_bh_ctrl *netswitch_bh_local(void)
+{
+	struct vmm_netswitch_bh_ctrl *nbp = &this_cpu(nbctrl);
+
+	if (nbp->thread) {
+		return nbp;
+	}
+
+	return &per_cpu(nbctrl, vmm_cpumask_first(cpu_housekeeping_mask));
 }
 
 static int netswitch_bh_enqueue(struct vmm_netswitch_bh_ctrl *nbp,
 				     struct vmm_netport_xfer *xfer)
 {
+	bool wakeup;
 	irq_flags_t flags;
 
 	vmm_spin_lock_irqsave_lite(&nbp->xfer_list_lock, flags);
-	list_add_tail(&xfer->head, &nbp->xfer_list);
+	wakeup = !nbp->xfer_count;
+	list_add_tail(&xfer->head, &nbp->xfer_list[xfer->port->qos_prio]);
+	nbp->xfer_count++;
 	vmm_spin_unlock_irqrestore_lite(&nbp->xfer_list_lock, flags);
 
-	vmm_completion_complete_once(&nbp->xfer_cmpl);
+	/* Bottom-half only sleeps on empty list so wakeup is
+	 * required only when list was empty.
+	 */
+	if (wakeup) {
+		vmm_completion_complete_once(&nbp->xfer_cmpl);
+	}
 
 	return VMM_OK;
 }
 
-static struct vmm_netport_xfer *netswitch_bh_dequeue(
-				struct vmm_netswitch_bh_ctrl *nbp)
+static void netswitch_bh_enqueue_list(struct vmm_netswitch_bh_ctrl *nbp,
+				      struct vmm_netport *port,
+				      struct dlist *xfers)
 {
+	bool wakeup;
 	irq_flags_t flags;
-	struct vmm_netport_xfer *xfer;
+
+	if (list_empty(xfers)) {
+		return;
+	}
 
 	vmm_spin_lock_irqsave_lite(&nbp->xfer_list_lock, flags);
+	wakeup = !nbp->xfer_count;
+	while (!list_empty(xfers)) {
+		list_add_tail(list_pop(xfers),
+			      &nbp->xfer_list[port->qos_prio]);
+		nbp->xfer_count++;
+	}
+	vmm_spin_unlock_irqrestore_lite(&nbp->xfer_list_lock, flags);
+
+	if (wakeup) {
+		vmm_completion_complete_once(&nbp->xfer_cmpl);
+	}
+}
+
+static u32 netswitch_bh_move(struct dlist *xfers, struct dlist *batch,
+			     u32 max)
+{
+	u32 count = 0;
+
+	while (!list_empty(xfers) && (count < max)) {
+		list_add_tail(list_pop(xfers), batch);
+		count++;
+	}
+
+	return count;
+}
+
+static u32 netswitch_bh_dequeue_batch(struct vmm_netswitch_bh_ctrl *nbp,
+				      struct dlist *batch, u32 budget)
+{
+	u32 prio, count = 0;
+	irq_flags_t flags;
 
-	while (list_empty(&nbp->xfer_list)) {
+	vmm_spin_lock_irqsave_lite(&nbp->xfer_list_lock, flags);
+
+	while (!nbp->xfer_count) {
 		vmm_spin_unlock_irqrestore_lite(&nbp->xfer_list_lock, flags);
 		vmm_completion_wait(&nbp->xfer_cmpl);
 		vmm_spin_lock_irqsave_lite(&nbp->xfer_list_lock, flags);
 	}
 
-	xfer = list_entry(list_pop(&nbp->xfer_list),
-			  struct vmm_netport_xfer, head);
+	/* Highest priority is served strictly first */
+	count = netswitch_bh_move(&nbp->xfer_list[0], batch, budget);
+
+	/* Remaining priorities are served in weighted round-robin */
+	while ((count < budget) && (count < nbp->xfer_count)) {
+		for (prio = 1;
+		     (prio < VMM_NETPORT_PRIO_COUNT) && (count < budget);
+		     prio++) {
+			count += netswitch_bh_move(&nbp->xfer_list[prio], batch,
+				min((u32)NETSWITCH_PRIO_WEIGHT(prio),
+				    budget - count));
+		}
+	}
+	nbp->xfer_count -= count;
 
 	vmm_spin_unlock_irqrestore_lite(&nbp->xfer_list_lock, flags);
 
-	return xfer;
+	return count;
 }
 
 static void netswitch_bh_port_flush(struct vmm_netswitch_bh_ctrl *nbp,
 					 struct vmm_netport *port)
 {
+	u32 prio;
 	irq_flags_t flags;
 	struct vmm_netport_xfer *xfer, *nxfer;
 
 	vmm_spin_lock_irqsave_lite(&nbp->xfer_list_lock, flags);
 
-	list_for_each_entry_safe(xfer, nxfer, &nbp->xfer_list, head) {
-		if (xfer->port == port) {
-			list_del(&xfer->head);
-			if (xfer->mbuf) {
-				m_freem(xfer->mbuf);
+	for (prio = 0; prio < VMM_NETPORT_PRIO_COUNT; prio++) {
+		list_for_each_entry_safe(xfer, nxfer,
+					 &nbp->xfer_list[prio], head) {
+			if (xfer->port == port) {
+				list_del(&xfer->head);
+				nbp->xfer_count--;
+				if (xfer->mbuf) {
+					m_freem(xfer->mbuf);
+				}
+				vmm_netport_free_xfer(xfer->port, xfer);
 			}
-			vmm_netport_free_xfer(xfer->port, xfer);
 		}
 	}
 
@@ -211,13 +300,19 @@ static int netswitch_bh_main(void *param)
 	void (*xfer_lazy_xfer)(struct vmm_netport *, void *, int);
 	struct vmm_netport_xfer *xfer;
 	struct vmm_netswitch_bh_ctrl *nbp = param;
+	struct dlist batch;
+
+	INIT_LIST_HEAD(&batch);
 
 	while (1) {
-		/* Try to get xfer request from xfer ring */
-		xfer = netswitch_bh_dequeue(nbp);
-		if (!xfer) {
+		/* Get batch of xfer requests when current batch is done */
+		if (list_empty(&batch) &&
+		    !netswitch_bh_dequeue_batch(nbp, &batch,
+					CONFIG_NET_BH_BUDGET)) {
 			continue;
 		}
+		xfer = list_entry(list_pop(&batch),
+				  struct vmm_netport_xfer, head);
 
 		/* Extract info from xfer request */
 		xfer_port = xfer->port;
@@ -287,10 +382,19 @@ int vmm_port2switch_xfer_mbuf(struct vmm_netport *src, struct vmm_mbuf *mbuf)
 		return VMM_EFAIL;
 	}
 	nsw = src->nsw;
-	nbp = &this_cpu(nbctrl);
+	nbp = netswitch_bh_local();
 
 	/* Print debug info */
 	DPRINTF("%s: nsw=%s src=%s\n", __func__, nsw->name, src->name);
+	vmm_trace(NETSWITCH_XFER, (virtual_addr_t)src, mbuf->m_pktlen, 0, 0);
+
+	/* Drop packet exceeding rate limit of source port */
+	if (!vmm_netport_qos_admit(src, mbuf->m_pktlen)) {
+		m_freem(mbuf);
+		return VMM_OK;
+	}
+
+	vmm_netcapture_record(src, mbuf, VMM_NETCAPTURE_DIR_IN);
 
 	/* Alloc netport xfer request */
 	xfer = vmm_netport_alloc_xfer(src);
@@ -318,14 +422,75 @@ int vmm_port2switch_xfer_mbuf(struct vmm_netport *src, struct vmm_mbuf *mbuf)
 }
 VMM_EXPORT_SYMBOL(vmm_port2switch_xfer_mbuf);
 
-int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
+int vmm_port2switch_xfer_mbuf_list(struct vmm_netport *src,
+				   struct dlist *mbufs)
+{
+	int rc = VMM_OK;
+	struct dlist xfers;
+	struct vmm_mbuf *mbuf;
+	struct vmm_netport_xfer *xfer;
+
+	if (!mbufs) {
+		return VMM_EFAIL;
+	}
+	if (!src || !src->nsw) {
+		vmm_printf("%s: invalid source port.\n", __func__);
+		rc = VMM_EFAIL;
+		goto free_mbufs;
+	}
+
+	/* Print debug info */
+	DPRINTF("%s: nsw=%s src=%s\n", __func__, src->nsw->name, src->name);
+
+	INIT_LIST_HEAD(&xfers);
+	while (!list_empty(mbufs)) {
+		mbuf = m_list_entry(list_pop(mbufs));
+
+		/* Drop packet exceeding rate limit of source port */
+		if (!vmm_netport_qos_admit(src, mbuf->m_pktlen)) {
+			m_freem(mbuf);
+			continue;
+		}
+
+		vmm_netcapture_record(src, mbuf, VMM_NETCAPTURE_DIR_IN);
+
+		/* Alloc netport xfer request */
+		xfer = vmm_netport_alloc_xfer(src);
+		if (!xfer) {
+			vmm_printf("%s: nsw=%s src=%s xfer alloc failed.\n",
+				   __func__, src->nsw->name, src->name);
+			m_freem(mbuf);
+			rc = VMM_ENOMEM;
+			break;
+		}
+
+		/* Fill-up xfer request */
+		xfer->port = src;
+		xfer->type = VMM_NETPORT_XFER_MBUF;
+		xfer->mbuf = mbuf;
+		list_add_tail(&xfer->head, &xfers);
+	}
+
+	/* Add all xfer requests to xfer ring under one lock hold */
+	netswitch_bh_enqueue_list(netswitch_bh_local(), src, &xfers);
+
+free_mbufs:
+	while (!list_empty(mbufs)) {
+		m_freem(m_list_entry(list_pop(mbufs)));
+	}
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vmm_port2switch_xfer_mbuf_list);
+
+static int __port2switch_xfer_lazy(struct vmm_netswitch_bh_ctrl *nbp,
+			 struct vmm_netport *src,
 			 void (*lazy_xfer)(struct vmm_netport *, void *, int),
 			 void *lazy_arg, int lazy_budget)
 {
 	int rc;
 	struct vmm_netport_xfer *xfer;
 	struct vmm_netswitch *nsw;
-	struct vmm_netswitch_bh_ctrl *nbp;
 
 	if (!lazy_xfer || !src || !src->nsw) {
 		vmm_printf("%s: invalid source port or xfer callback.\n",
@@ -333,7 +498,6 @@ int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
 		return VMM_EFAIL;
 	}
 	nsw = src->nsw;
-	nbp = &this_cpu(nbctrl);
 
 	/* Print debug info */
 	DPRINTF("%s: nsw=%s src=%s\n", __func__, nsw->name, src->name);
@@ -363,8 +527,79 @@ int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
 
 	return rc;
 }
+
+int vmm_port2switch_xfer_lazy(struct vmm_netport *src,
+			 void (*lazy_xfer)(struct vmm_netport *, void *, int),
+			 void *lazy_arg, int lazy_budget)
+{
+	return __port2switch_xfer_lazy(netswitch_bh_local(), src,
+				       lazy_xfer, lazy_arg, lazy_budget);
+}
 VMM_EXPORT_SYMBOL(vmm_port2switch_xfer_lazy);
 
+int vmm_port2switch_xfer_lazy_hash(struct vmm_netport *src, u32 hash,
+			 void (*lazy_xfer)(struct vmm_netport *, void *, int),
+			 void *lazy_arg, int lazy_budget)
+{
+	u32 c, n = hash % vmm_num_housekeeping_cpus();
+	struct vmm_netswitch_bh_ctrl *nbp = netswitch_bh_local();
+
+	/* Pick n-th housekeeping CPU having a netswitch bottom-half thread */
+	for_each_housekeeping_cpu(c) {
+		if (!n--) {
+			if (per_cpu(nbctrl, c).thread) {
+				nbp = &per_cpu(nbctrl, c);
+			}
+			break;
+		}
+	}
+
+	return __port2switch_xfer_lazy(nbp, src,
+				       lazy_xfer, lazy_arg, lazy_budget);
+}
+VMM_EXPORT_SYMBOL(vmm_port2switch_xfer_lazy_hash);
+
+u32 vmm_netswitch_flow_hash(struct vmm_mbuf *mbuf)
+{
+	u32 i, hash = 0;
+	u8 *frame, *ip_frame, *l4_frame;
+
+	if (!mbuf || (mbuf->m_len < ETHER_HLEN)) {
+		return 0;
+	}
+	frame = mtod(mbuf, u8 *);
+
+	if ((ether_type(frame) != 0x0800 /* IPv4 */) ||
+	    (mbuf->m_len < (ETHER_HLEN + IP4_HLEN))) {
+		for (i = 0; i < 6; i++) {
+			hash = (hash * 31) + ether_srcmac(frame)[i];
+			hash = (hash * 31) + ether_dstmac(frame)[i];
+		}
+		return hash;
+	}
+
+	ip_frame = ether_payload(frame);
+	for (i = 0; i < 4; i++) {
+		hash = (hash * 31) + ip_srcaddr(ip_frame)[i];
+		hash = (hash * 31) + ip_dstaddr(ip_frame)[i];
+	}
+	hash = (hash * 31) + ip_protocol(ip_frame);
+
+	/* Add ports for unfragmented TCP/UDP packets */
+	l4_frame = ip_frame + ((ip_frame[0] & 0xF) * 4);
+	if (((ip_protocol(ip_frame) == 0x06 /* TCP */) ||
+	     (ip_protocol(ip_frame) == 0x11 /* UDP */)) &&
+	    !(vmm_be16_to_cpu(((struct ip_header *)ip_frame)->ipoffset) &
+	      0x3FFF) &&
+	    ((l4_frame + 4) <= (frame + mbuf->m_len))) {
+		hash = (hash * 31) + tcp_srcport(l4_frame);
+		hash = (hash * 31) + tcp_dstport(l4_frame);
+	}
+
+	return hash ^ (hash >> 16);
+}
+VMM_EXPORT_SYMBOL(vmm_netswitch_flow_hash);
+
 int vmm_switch2port_xfer_mbuf(struct vmm_netswitch *nsw,
 			      struct vmm_netport *dst,
 			      struct vmm_mbuf *mbuf)
@@ -378,11 +613,22 @@ int vmm_switch2port_xfer_mbuf(struct vmm_netswitch *nsw,
 
 	/* Print debug info */
 	DPRINTF("%s: nsw=%s dst=%s\n", __func__, nsw->name, dst->name);
+	vmm_trace(NETSWITCH_XFER, (virtual_addr_t)dst, mbuf->m_pktlen, 1, 0);
 
 	if (dst->can_receive && !dst->can_receive(dst)) {
 		return VMM_OK;
 	}
 
+	vmm_netcapture_record(dst, mbuf, VMM_NETCAPTURE_DIR_OUT);
+
+	/* Offloads not supported by port are done in software */
+	if (vmm_netoffload_required(dst, mbuf)) {
+		vmm_spin_lock_irqsave_lite(&dst->switch2port_xfer_lock, f);
+		rc = vmm_netoffload_xfer(dst, mbuf);
+		vmm_spin_unlock_irqrestore_lite(&dst->switch2port_xfer_lock, f);
+		return rc;
+	}
+
 	MADDREFERENCE(mbuf);
 	MCLADDREFERENCE(mbuf);
 
@@ -666,6 +912,14 @@ static void __init vmm_netswitch_percpu_init(void *a1, void *a2, void *a3)
 	u32 cpu = vmm_smp_processor_id();
 	struct vmm_netswitch_bh_ctrl *nbp = &per_cpu(nbctrl, cpu);
 
+	netswitch_bh_init(nbp);
+
+	/* No housekeeping threads on isolated host CPU */
+	if (vmm_cpu_isolated(cpu)) {
+		nbp->thread = NULL;
+		return;
+	}
+
 	vmm_snprintf(name, sizeof(name), "%s/%d",
 		     VMM_NETSWITCH_CLASS_NAME, cpu);
 
@@ -682,11 +936,10 @@ static void __init vmm_netswitch_percpu_init(void *a1, void *a2, void *a3)
 		vmm_printf("%s: CPU%d: Failed to set thread affinity\n",
 			   __func__, cpu);
 		vmm_threads_destroy(nbp->thread);
+		nbp->thread = NULL;
 		return;
 	}
 
-	netswitch_bh_init(nbp);
-
 	vmm_threads_start(nbp->thread);
 }
 
@@ -714,6 +967,10 @@ static void __exit vmm_netswitch_percpu_exit(void *a1, void *a2, void *a3)
 {
 	struct vmm_netswitch_bh_ctrl *nbp = &this_cpu(nbctrl);
 
+	if (!nbp->thread) {
+		return;
+	}
+
 	vmm_threads_stop(nbp->thread);
 
 	vmm_threads_destroy(nbp->thread);
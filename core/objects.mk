@@ -31,6 +31,7 @@ core-objs-y+= vmm_devtree_reg.o
 core-objs-y+= vmm_devres.o
 core-objs-y+= vmm_devdrv.o
 core-objs-y+= vmm_devemu.o
+core-objs-y+= vmm_snapshot.o
 core-objs-y+= vmm_resource.o
 core-objs-y+= vmm_host_irq.o
 core-objs-y+= vmm_host_irqext.o
@@ -56,11 +57,17 @@ core-objs-y+= vmm_semaphore.o
 core-objs-y+= vmm_mutex.o
 core-objs-y+= vmm_notifier.o
 core-objs-y+= vmm_workqueue.o
+core-objs-y+= vmm_rcu.o
+core-objs-y+= vmm_fiber.o
 core-objs-y+= vmm_cmdmgr.o
 core-objs-y+= vmm_wallclock.o
 core-objs-y+= vmm_chardev.o
 core-objs-y+= vmm_modules.o
 core-objs-y+= vmm_params.o
 core-objs-$(CONFIG_PROFILE)+= vmm_profiler.o
+core-objs-$(CONFIG_LOCKSTAT)+= vmm_lockstat.o
+core-objs-$(CONFIG_TRACE)+= vmm_trace.o
+core-objs-$(CONFIG_CPUIDLE)+= vmm_cpuidle.o
 core-objs-$(CONFIG_IOMMU)+= vmm_iommu.o
+core-objs-$(CONFIG_DMAENGINE)+= vmm_dmaengine.o
 core-objs-y+= vmm_extable.o
@@ -21,6 +21,8 @@
 # @brief list of schedalgo objects to be build
 # */
 
+core-objs-y += schedalgo/vmm_schedalgo.o
 core-objs-$(CONFIG_SCHEDALGO_PRR) += schedalgo/vmm_schedalgo_prr.o
 core-objs-$(CONFIG_SCHEDALGO_PRM) += schedalgo/vmm_schedalgo_prm.o
-
+core-objs-$(CONFIG_SCHEDALGO_FAIR) += schedalgo/vmm_schedalgo_fair.o
+core-objs-$(CONFIG_SCHEDALGO_EDF) += schedalgo/vmm_schedalgo_edf.o
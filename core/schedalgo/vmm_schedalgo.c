@@ -0,0 +1,175 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_schedalgo.c
+ * @author agent (agent@local)
+ * @brief scheduling algorithm selection and dispatch
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_params.h>
+#include <vmm_schedalgo.h>
+#include <libs/stringlib.h>
+
+static const struct vmm_schedalgo *schedalgo_list[] = {
+#ifdef CONFIG_SCHEDALGO_PRR
+	&vmm_schedalgo_prr,
+#endif
+#ifdef CONFIG_SCHEDALGO_PRM
+	&vmm_schedalgo_prm,
+#endif
+#ifdef CONFIG_SCHEDALGO_FAIR
+	&vmm_schedalgo_fair,
+#endif
+#ifdef CONFIG_SCHEDALGO_EDF
+	&vmm_schedalgo_edf,
+#endif
+};
+
+static const struct vmm_schedalgo *schedalgo;
+static bool schedalgo_inuse;
+
+static const struct vmm_schedalgo *schedalgo_find(const char *name)
+{
+	u32 i;
+
+	for (i = 0; i < array_size(schedalgo_list); i++) {
+		if (!strcmp(schedalgo_list[i]->name, name)) {
+			return schedalgo_list[i];
+		}
+	}
+
+	return NULL;
+}
+
+static const struct vmm_schedalgo *schedalgo_current(void)
+{
+	if (!schedalgo) {
+		schedalgo = schedalgo_find(CONFIG_SCHEDALGO_DEFAULT);
+		if (!schedalgo) {
+			schedalgo = schedalgo_list[0];
+		}
+	}
+
+	return schedalgo;
+}
+
+const char *vmm_schedalgo_name(void)
+{
+	return schedalgo_current()->name;
+}
+
+u32 vmm_schedalgo_count(void)
+{
+	return array_size(schedalgo_list);
+}
+
+const char *vmm_schedalgo_get_name(u32 index)
+{
+	if (array_size(schedalgo_list) <= index) {
+		return NULL;
+	}
+
+	return schedalgo_list[index]->name;
+}
+
+int vmm_schedalgo_select(const char *name)
+{
+	const struct vmm_schedalgo *algo;
+
+	if (!name) {
+		return VMM_EINVALID;
+	}
+
+	algo = schedalgo_find(name);
+	if (!algo) {
+		return VMM_ENOTAVAIL;
+	}
+
+	if (schedalgo_inuse) {
+		return (algo == schedalgo) ? VMM_OK : VMM_EBUSY;
+	}
+
+	schedalgo = algo;
+
+	return VMM_OK;
+}
+
+static int __init schedalgo_early_setup(char *str)
+{
+	if (vmm_schedalgo_select(str)) {
+		vmm_printf("%s: invalid scheduling algorithm %s\n",
+			   __func__, str);
+	}
+
+	return 0;
+}
+vmm_early_param("schedalgo=", schedalgo_early_setup);
+
+int vmm_schedalgo_vcpu_setup(struct vmm_vcpu *vcpu)
+{
+	return schedalgo_current()->vcpu_setup(vcpu);
+}
+
+int vmm_schedalgo_vcpu_cleanup(struct vmm_vcpu *vcpu)
+{
+	return schedalgo_current()->vcpu_cleanup(vcpu);
+}
+
+int vmm_schedalgo_rq_enqueue(void *rq, struct vmm_vcpu *vcpu)
+{
+	return schedalgo->rq_enqueue(rq, vcpu);
+}
+
+int vmm_schedalgo_rq_dequeue(void *rq,
+			     struct vmm_vcpu **next,
+			     u64 *next_time_slice)
+{
+	return schedalgo->rq_dequeue(rq, next, next_time_slice);
+}
+
+int vmm_schedalgo_rq_detach(void *rq, struct vmm_vcpu *vcpu)
+{
+	return schedalgo->rq_detach(rq, vcpu);
+}
+
+bool vmm_schedalgo_rq_prempt_needed(void *rq, struct vmm_vcpu *current)
+{
+	return schedalgo->rq_prempt_needed(rq, current);
+}
+
+void *vmm_schedalgo_rq_create(void)
+{
+	const struct vmm_schedalgo *algo = schedalgo_current();
+
+	/* Scheduling algorithm cannot change once ready queues exist */
+	schedalgo_inuse = TRUE;
+
+	return algo->rq_create();
+}
+
+int vmm_schedalgo_rq_destroy(void *rq)
+{
+	return schedalgo->rq_destroy(rq);
+}
+
+int vmm_schedalgo_rq_length(void *rq, u8 priority)
+{
+	return schedalgo->rq_length(rq, priority);
+}
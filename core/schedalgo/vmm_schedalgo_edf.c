@@ -0,0 +1,332 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_schedalgo_edf.c
+ * @author agent (agent@local)
+ * @brief implementation of deadline (EDF/CBS) scheduling algorithm
+ *
+ * Deadline class VCPUs (vcpu->is_deadline) are served before all other
+ * VCPUs in earliest deadline first order. Each deadline class VCPU is a
+ * constant bandwidth server with a budget of "time_slice" nsecs every
+ * "periodicity" nsecs. When the budget is exhausted its deadline is
+ * postponed by one period and budget is recharged so that an overrunning
+ * VCPU cannot steal bandwidth of other deadline class VCPUs. A waking
+ * VCPU gets fresh deadline ("deadline" nsecs from now) only when its
+ * remaining budget would exceed its bandwidth till current deadline.
+ *
+ * Remaining (best-effort) VCPUs are scheduled in priority round robin
+ * order whenever no deadline class VCPU is READY. Admission control of
+ * deadline class bandwidth is done by VCPU manager.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_timer.h>
+#include <vmm_schedalgo.h>
+#include <libs/list.h>
+#include <libs/rbtree.h>
+
+struct vmm_schedalgo_rq_entry {
+	struct rb_node rb;
+	struct dlist head;
+	struct vmm_vcpu *vcpu;
+	u8 priority;
+	u64 abs_deadline;
+	s64 runtime;
+	u64 last_running_nsecs;
+};
+
+struct vmm_schedalgo_rq {
+	u32 count[VMM_VCPU_MAX_PRIORITY+1];
+	u32 dl_count;
+	struct rb_root dl_root;
+	struct dlist list[VMM_VCPU_MAX_PRIORITY+1];
+};
+
+/* Charge running time of deadline class VCPU since last dequeue and
+ * apply constant bandwidth server rules.
+ */
+static void edf_update(struct vmm_schedalgo_rq_entry *rq_entry, u64 tstamp)
+{
+	u64 delta;
+	struct vmm_vcpu *vcpu = rq_entry->vcpu;
+
+	/* Running time is cleared when VCPU is reset */
+	if (vcpu->state_running_nsecs < rq_entry->last_running_nsecs) {
+		rq_entry->last_running_nsecs = 0;
+	}
+	delta = vcpu->state_running_nsecs - rq_entry->last_running_nsecs;
+	rq_entry->last_running_nsecs = vcpu->state_running_nsecs;
+	rq_entry->runtime -= (s64)delta;
+
+	/* Budget exhausted hence postpone deadline and recharge */
+	while (rq_entry->runtime <= 0) {
+		rq_entry->abs_deadline += vcpu->periodicity;
+		rq_entry->runtime += (s64)vcpu->time_slice;
+	}
+
+	/* Remaining budget exceeds bandwidth till current deadline
+	 * (or deadline passed) hence start afresh.
+	 */
+	if ((rq_entry->abs_deadline <= tstamp) ||
+	    (((u64)rq_entry->runtime * vcpu->periodicity) >
+	     ((rq_entry->abs_deadline - tstamp) * vcpu->time_slice))) {
+		rq_entry->abs_deadline = tstamp + vcpu->deadline;
+		rq_entry->runtime = (s64)vcpu->time_slice;
+	}
+}
+
+static int edf_vcpu_setup(struct vmm_vcpu *vcpu)
+{
+	struct vmm_schedalgo_rq_entry *rq_entry;
+
+	if (!vcpu) {
+		return VMM_EFAIL;
+	}
+
+	rq_entry = vmm_zalloc(sizeof(struct vmm_schedalgo_rq_entry));
+	if (!rq_entry) {
+		return VMM_EFAIL;
+	}
+
+	RB_CLEAR_NODE(&rq_entry->rb);
+	INIT_LIST_HEAD(&rq_entry->head);
+	rq_entry->vcpu = vcpu;
+	vcpu->sched_priv = rq_entry;
+
+	return VMM_OK;
+}
+
+static int edf_vcpu_cleanup(struct vmm_vcpu *vcpu)
+{
+	if (!vcpu) {
+		return VMM_EFAIL;
+	}
+
+	if (vcpu->sched_priv) {
+		vmm_free(vcpu->sched_priv);
+		vcpu->sched_priv = NULL;
+	}
+
+	return VMM_OK;
+}
+
+static int edf_rq_length(void *rq, u8 priority)
+{
+	struct vmm_schedalgo_rq *rqi = rq;
+
+	if (!rqi) {
+		return -1;
+	}
+
+	return rqi->count[priority];
+}
+
+static int edf_rq_enqueue(void *rq, struct vmm_vcpu *vcpu)
+{
+	struct vmm_schedalgo_rq_entry *rq_entry, *parent_e;
+	struct vmm_schedalgo_rq *rqi = rq;
+	struct rb_node **new = NULL, *parent = NULL;
+
+	if (!rqi || !vcpu) {
+		return VMM_EFAIL;
+	}
+
+	rq_entry = vcpu->sched_priv;
+	if (!rq_entry) {
+		return VMM_EFAIL;
+	}
+	rq_entry->priority = vcpu->priority;
+
+	if (!vcpu->is_deadline) {
+		list_add_tail(&rq_entry->head, &rqi->list[rq_entry->priority]);
+		rqi->count[rq_entry->priority]++;
+		return VMM_OK;
+	}
+
+	edf_update(rq_entry, vmm_timer_timestamp());
+
+	new = &rqi->dl_root.rb_node;
+	while (*new) {
+		parent = *new;
+		parent_e = rb_entry(parent, struct vmm_schedalgo_rq_entry, rb);
+		if (rq_entry->abs_deadline < parent_e->abs_deadline) {
+			new = &parent->rb_left;
+		} else {
+			new = &parent->rb_right;
+		}
+	}
+	rb_link_node(&rq_entry->rb, parent, new);
+	rb_insert_color(&rq_entry->rb, &rqi->dl_root);
+	rqi->dl_count++;
+	rqi->count[rq_entry->priority]++;
+
+	return VMM_OK;
+}
+
+static int edf_rq_dequeue(void *rq,
+			  struct vmm_vcpu **next,
+			  u64 *next_time_slice)
+{
+	int p;
+	u64 time_slice;
+	struct rb_node *n;
+	struct vmm_schedalgo_rq_entry *rq_entry;
+	struct vmm_schedalgo_rq *rqi = rq;
+
+	if (!rqi) {
+		return VMM_EFAIL;
+	}
+
+	if (rqi->dl_count) {
+		/* Earliest deadline first with remaining budget */
+		n = rb_first(&rqi->dl_root);
+		rq_entry = rb_entry(n, struct vmm_schedalgo_rq_entry, rb);
+		rb_erase(&rq_entry->rb, &rqi->dl_root);
+		RB_CLEAR_NODE(&rq_entry->rb);
+		rqi->dl_count--;
+		time_slice = (u64)rq_entry->runtime;
+	} else {
+		for (p = VMM_VCPU_MAX_PRIORITY; p >= VMM_VCPU_MIN_PRIORITY; p--) {
+			if (!list_empty(&rqi->list[p])) {
+				break;
+			}
+		}
+		if (p < VMM_VCPU_MIN_PRIORITY) {
+			return VMM_ENOTAVAIL;
+		}
+		rq_entry = list_first_entry(&rqi->list[p],
+					    struct vmm_schedalgo_rq_entry, head);
+		list_del_init(&rq_entry->head);
+		time_slice = rq_entry->vcpu->time_slice;
+	}
+	rqi->count[rq_entry->priority]--;
+
+	if (next) {
+		*next = rq_entry->vcpu;
+	}
+	if (next_time_slice) {
+		*next_time_slice = time_slice;
+	}
+
+	return VMM_OK;
+}
+
+static int edf_rq_detach(void *rq, struct vmm_vcpu *vcpu)
+{
+	struct vmm_schedalgo_rq_entry *rq_entry;
+	struct vmm_schedalgo_rq *rqi = rq;
+
+	if (!vcpu || !rqi) {
+		return VMM_EFAIL;
+	}
+
+	rq_entry = vcpu->sched_priv;
+	if (!rq_entry) {
+		return VMM_EFAIL;
+	}
+
+	if (!RB_EMPTY_NODE(&rq_entry->rb)) {
+		rb_erase(&rq_entry->rb, &rqi->dl_root);
+		RB_CLEAR_NODE(&rq_entry->rb);
+		rqi->dl_count--;
+	} else {
+		list_del_init(&rq_entry->head);
+	}
+	rqi->count[rq_entry->priority]--;
+
+	return VMM_OK;
+}
+
+static bool edf_rq_prempt_needed(void *rq, struct vmm_vcpu *current)
+{
+	int p;
+	struct rb_node *n;
+	struct vmm_schedalgo_rq *rqi = rq;
+	struct vmm_schedalgo_rq_entry *rq_entry, *cur_entry;
+
+	if (!rqi || !current) {
+		return FALSE;
+	}
+
+	if (rqi->dl_count) {
+		cur_entry = current->sched_priv;
+		if (!current->is_deadline || !cur_entry) {
+			return TRUE;
+		}
+		n = rb_first(&rqi->dl_root);
+		rq_entry = rb_entry(n, struct vmm_schedalgo_rq_entry, rb);
+		return (rq_entry->abs_deadline < cur_entry->abs_deadline) ?
+			TRUE : FALSE;
+	}
+
+	if (current->is_deadline) {
+		return FALSE;
+	}
+
+	for (p = VMM_VCPU_MAX_PRIORITY; p > current->priority; p--) {
+		if (!list_empty(&rqi->list[p])) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static void *edf_rq_create(void)
+{
+	int p;
+	struct vmm_schedalgo_rq *rq =
+			vmm_zalloc(sizeof(struct vmm_schedalgo_rq));
+
+	if (!rq) {
+		return NULL;
+	}
+
+	for (p = 0; p <= VMM_VCPU_MAX_PRIORITY; p++) {
+		rq->count[p] = 0;
+		INIT_LIST_HEAD(&rq->list[p]);
+	}
+	rq->dl_count = 0;
+	rq->dl_root = RB_ROOT;
+
+	return rq;
+}
+
+static int edf_rq_destroy(void *rq)
+{
+	if (!rq) {
+		return VMM_EFAIL;
+	}
+
+	vmm_free(rq);
+	return VMM_OK;
+}
+
+const struct vmm_schedalgo vmm_schedalgo_edf = {
+	.name = "edf",
+	.vcpu_setup = edf_vcpu_setup,
+	.vcpu_cleanup = edf_vcpu_cleanup,
+	.rq_enqueue = edf_rq_enqueue,
+	.rq_dequeue = edf_rq_dequeue,
+	.rq_detach = edf_rq_detach,
+	.rq_prempt_needed = edf_rq_prempt_needed,
+	.rq_create = edf_rq_create,
+	.rq_destroy = edf_rq_destroy,
+	.rq_length = edf_rq_length,
+};
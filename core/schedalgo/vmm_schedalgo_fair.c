@@ -0,0 +1,379 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_schedalgo_fair.c
+ * @author agent (agent@local)
+ * @brief implementation of weighted fair-share scheduling algorithm
+ *
+ * Within each priority level, READY VCPUs are ordered by virtual runtime
+ * in a red-black tree. The virtual runtime of a VCPU advances with actual
+ * running time scaled inversely by the scheduling weight of its Guest so
+ * that VCPUs of equal priority share a host CPU in ratio of their weights.
+ *
+ * A Guest can also have a scheduling cap (percentage of one host CPU)
+ * which limits the running time of each of its VCPUs in every cap period
+ * even if the host CPU would otherwise be idle.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_timer.h>
+#include <vmm_schedalgo.h>
+#include <libs/mathlib.h>
+#include <libs/rbtree.h>
+
+#define FAIR_CAP_PERIOD_NSECS		(VMM_VCPU_DEF_TIME_SLICE * 10)
+
+struct vmm_schedalgo_rq_entry {
+	struct rb_node rb;
+	struct vmm_vcpu *vcpu;
+	u64 vruntime;
+	u64 last_running_nsecs;
+	u64 cap_period_tstamp;
+	u64 cap_period_nsecs;
+};
+
+struct vmm_schedalgo_rq {
+	u32 count[VMM_VCPU_MAX_PRIORITY+1];
+	u64 min_vruntime[VMM_VCPU_MAX_PRIORITY+1];
+	struct rb_root root[VMM_VCPU_MAX_PRIORITY+1];
+};
+
+static inline u32 fair_weight(struct vmm_vcpu *vcpu)
+{
+	return (vcpu->guest) ? vcpu->guest->sched_weight :
+				VMM_GUEST_DEF_SCHED_WEIGHT;
+}
+
+static inline u64 fair_cap_nsecs(struct vmm_vcpu *vcpu)
+{
+	if (!vcpu->guest || !vcpu->guest->sched_cap) {
+		return 0;
+	}
+
+	return udiv64(FAIR_CAP_PERIOD_NSECS * vcpu->guest->sched_cap,
+		      VMM_GUEST_MAX_SCHED_CAP);
+}
+
+/* Account running time of VCPU since it was last dequeued */
+static void fair_account(struct vmm_schedalgo_rq_entry *rq_entry,
+			 u64 tstamp)
+{
+	u64 delta;
+	u32 weight;
+	struct vmm_vcpu *vcpu = rq_entry->vcpu;
+
+	/* Running time is cleared when VCPU is reset */
+	if (vcpu->state_running_nsecs < rq_entry->last_running_nsecs) {
+		rq_entry->last_running_nsecs = 0;
+	}
+	delta = vcpu->state_running_nsecs - rq_entry->last_running_nsecs;
+	rq_entry->last_running_nsecs = vcpu->state_running_nsecs;
+
+	weight = fair_weight(vcpu);
+	if (weight == VMM_GUEST_DEF_SCHED_WEIGHT) {
+		rq_entry->vruntime += delta;
+	} else {
+		rq_entry->vruntime +=
+			udiv64(delta * VMM_GUEST_DEF_SCHED_WEIGHT, weight);
+	}
+
+	if ((rq_entry->cap_period_tstamp + FAIR_CAP_PERIOD_NSECS) <= tstamp) {
+		rq_entry->cap_period_tstamp = tstamp;
+		rq_entry->cap_period_nsecs = 0;
+	}
+	rq_entry->cap_period_nsecs += delta;
+}
+
+/* Check whether VCPU exhausted its cap in current cap period.
+ * If yes then return time remaining in current cap period.
+ */
+static u64 fair_throttled(struct vmm_schedalgo_rq_entry *rq_entry,
+			  u64 tstamp)
+{
+	u64 cap_nsecs = fair_cap_nsecs(rq_entry->vcpu);
+	u64 period_end = rq_entry->cap_period_tstamp + FAIR_CAP_PERIOD_NSECS;
+
+	if (!cap_nsecs ||
+	    (period_end <= tstamp) ||
+	    (rq_entry->cap_period_nsecs < cap_nsecs)) {
+		return 0;
+	}
+
+	return period_end - tstamp;
+}
+
+static int fair_vcpu_setup(struct vmm_vcpu *vcpu)
+{
+	struct vmm_schedalgo_rq_entry *rq_entry;
+
+	if (!vcpu) {
+		return VMM_EFAIL;
+	}
+
+	rq_entry = vmm_zalloc(sizeof(struct vmm_schedalgo_rq_entry));
+	if (!rq_entry) {
+		return VMM_EFAIL;
+	}
+
+	RB_CLEAR_NODE(&rq_entry->rb);
+	rq_entry->vcpu = vcpu;
+	vcpu->sched_priv = rq_entry;
+
+	return VMM_OK;
+}
+
+static int fair_vcpu_cleanup(struct vmm_vcpu *vcpu)
+{
+	if (!vcpu) {
+		return VMM_EFAIL;
+	}
+
+	if (vcpu->sched_priv) {
+		vmm_free(vcpu->sched_priv);
+		vcpu->sched_priv = NULL;
+	}
+
+	return VMM_OK;
+}
+
+static int fair_rq_length(void *rq, u8 priority)
+{
+	struct vmm_schedalgo_rq *rqi = rq;
+
+	if (!rqi) {
+		return -1;
+	}
+
+	return rqi->count[priority];
+}
+
+static int fair_rq_enqueue(void *rq, struct vmm_vcpu *vcpu)
+{
+	u8 p;
+	struct vmm_schedalgo_rq_entry *rq_entry, *parent_e;
+	struct vmm_schedalgo_rq *rqi = rq;
+	struct rb_node **new = NULL, *parent = NULL;
+
+	if (!rqi || !vcpu) {
+		return VMM_EFAIL;
+	}
+
+	rq_entry = vcpu->sched_priv;
+	if (!rq_entry) {
+		return VMM_EFAIL;
+	}
+	p = vcpu->priority;
+
+	fair_account(rq_entry, vmm_timer_timestamp());
+
+	/* VCPUs which were not READY for long don't get to
+	 * build up credit against VCPUs already in ready queue.
+	 */
+	if (rq_entry->vruntime < rqi->min_vruntime[p]) {
+		rq_entry->vruntime = rqi->min_vruntime[p];
+	}
+
+	new = &(rqi->root[p].rb_node);
+	while (*new) {
+		parent = *new;
+		parent_e = rb_entry(parent, struct vmm_schedalgo_rq_entry, rb);
+		if (rq_entry->vruntime < parent_e->vruntime) {
+			new = &parent->rb_left;
+		} else {
+			new = &parent->rb_right;
+		}
+	}
+	rb_link_node(&rq_entry->rb, parent, new);
+	rb_insert_color(&rq_entry->rb, &rqi->root[p]);
+	rqi->count[p]++;
+
+	return VMM_OK;
+}
+
+static int fair_rq_dequeue(void *rq,
+			   struct vmm_vcpu **next,
+			   u64 *next_time_slice)
+{
+	int p;
+	u64 tstamp, throttle, min_throttle = 0, time_slice, cap_nsecs;
+	struct rb_node *n;
+	struct vmm_schedalgo_rq_entry *rq_entry = NULL;
+	struct vmm_schedalgo_rq *rqi = rq;
+
+	if (!rqi) {
+		return VMM_EFAIL;
+	}
+
+	tstamp = vmm_timer_timestamp();
+
+	/* Find VCPU with lowest virtual runtime at highest
+	 * priority which has not exhausted its cap.
+	 */
+	for (p = VMM_VCPU_MAX_PRIORITY; p >= VMM_VCPU_MIN_PRIORITY; p--) {
+		if (!rqi->count[p]) {
+			continue;
+		}
+		for (n = rb_first(&rqi->root[p]); n; n = rb_next(n)) {
+			rq_entry = rb_entry(n,
+					struct vmm_schedalgo_rq_entry, rb);
+			throttle = fair_throttled(rq_entry, tstamp);
+			if (!throttle) {
+				break;
+			}
+			if (!min_throttle || (throttle < min_throttle)) {
+				min_throttle = throttle;
+			}
+			rq_entry = NULL;
+		}
+		if (rq_entry) {
+			break;
+		}
+	}
+
+	/* All VCPUs are throttled hence pick the highest priority one */
+	if (!rq_entry) {
+		for (p = VMM_VCPU_MAX_PRIORITY; p >= 0; p--) {
+			if (rqi->count[p]) {
+				break;
+			}
+		}
+		if (p < 0) {
+			return VMM_ENOTAVAIL;
+		}
+		n = rb_first(&rqi->root[p]);
+		rq_entry = rb_entry(n, struct vmm_schedalgo_rq_entry, rb);
+		min_throttle = 0;
+	}
+
+	rb_erase(&rq_entry->rb, &rqi->root[p]);
+	RB_CLEAR_NODE(&rq_entry->rb);
+	rqi->count[p]--;
+	if (rqi->min_vruntime[p] < rq_entry->vruntime) {
+		rqi->min_vruntime[p] = rq_entry->vruntime;
+	}
+
+	/* Limit time slice to remaining cap of picked VCPU and
+	 * to the earliest end of throttling of skipped VCPUs.
+	 */
+	time_slice = rq_entry->vcpu->time_slice;
+	cap_nsecs = fair_cap_nsecs(rq_entry->vcpu);
+	if (cap_nsecs && (rq_entry->cap_period_nsecs < cap_nsecs) &&
+	    ((cap_nsecs - rq_entry->cap_period_nsecs) < time_slice)) {
+		time_slice = cap_nsecs - rq_entry->cap_period_nsecs;
+	}
+	if (min_throttle && (min_throttle < time_slice)) {
+		time_slice = min_throttle;
+	}
+
+	if (next) {
+		*next = rq_entry->vcpu;
+	}
+	if (next_time_slice) {
+		*next_time_slice = time_slice;
+	}
+
+	return VMM_OK;
+}
+
+static int fair_rq_detach(void *rq, struct vmm_vcpu *vcpu)
+{
+	struct vmm_schedalgo_rq_entry *rq_entry;
+	struct vmm_schedalgo_rq *rqi = rq;
+
+	if (!vcpu || !rqi) {
+		return VMM_EFAIL;
+	}
+
+	rq_entry = vcpu->sched_priv;
+	if (!rq_entry) {
+		return VMM_EFAIL;
+	}
+
+	rb_erase(&rq_entry->rb, &rqi->root[vcpu->priority]);
+	RB_CLEAR_NODE(&rq_entry->rb);
+	rqi->count[vcpu->priority]--;
+
+	return VMM_OK;
+}
+
+static bool fair_rq_prempt_needed(void *rq, struct vmm_vcpu *current)
+{
+	int p;
+	bool ret = FALSE;
+	struct vmm_schedalgo_rq *rqi;
+
+	if (!rq || !current) {
+		return FALSE;
+	}
+
+	rqi = rq;
+
+	p = VMM_VCPU_MAX_PRIORITY;
+	while (p > current->priority) {
+		if (rqi->count[p]) {
+			ret = TRUE;
+			break;
+		}
+		p--;
+	}
+
+	return ret;
+}
+
+static void *fair_rq_create(void)
+{
+	int p;
+	struct vmm_schedalgo_rq *rq =
+			vmm_zalloc(sizeof(struct vmm_schedalgo_rq));
+
+	if (!rq) {
+		return NULL;
+	}
+
+	for (p = 0; p <= VMM_VCPU_MAX_PRIORITY; p++) {
+		rq->count[p] = 0;
+		rq->min_vruntime[p] = 0;
+		rq->root[p] = RB_ROOT;
+	}
+
+	return rq;
+}
+
+static int fair_rq_destroy(void *rq)
+{
+	if (!rq) {
+		return VMM_EFAIL;
+	}
+
+	vmm_free(rq);
+	return VMM_OK;
+}
+
+const struct vmm_schedalgo vmm_schedalgo_fair = {
+	.name = "fair",
+	.vcpu_setup = fair_vcpu_setup,
+	.vcpu_cleanup = fair_vcpu_cleanup,
+	.rq_enqueue = fair_rq_enqueue,
+	.rq_dequeue = fair_rq_dequeue,
+	.rq_detach = fair_rq_detach,
+	.rq_prempt_needed = fair_rq_prempt_needed,
+	.rq_create = fair_rq_create,
+	.rq_destroy = fair_rq_destroy,
+	.rq_length = fair_rq_length,
+};
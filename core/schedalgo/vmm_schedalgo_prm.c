@@ -37,7 +37,7 @@ struct vmm_schedalgo_rq {
 	struct rb_root root[VMM_VCPU_MAX_PRIORITY+1];
 };
 
-int vmm_schedalgo_vcpu_setup(struct vmm_vcpu *vcpu)
+static int prm_vcpu_setup(struct vmm_vcpu *vcpu)
 {
 	struct vmm_schedalgo_rq_entry *rq_entry;
 
@@ -58,7 +58,7 @@ int vmm_schedalgo_vcpu_setup(struct vmm_vcpu *vcpu)
 	return VMM_OK;
 }
 
-int vmm_schedalgo_vcpu_cleanup(struct vmm_vcpu *vcpu)
+static int prm_vcpu_cleanup(struct vmm_vcpu *vcpu)
 {
 	if (!vcpu) {
 		return VMM_EFAIL;
@@ -72,7 +72,7 @@ int vmm_schedalgo_vcpu_cleanup(struct vmm_vcpu *vcpu)
 	return VMM_OK;
 }
 
-int vmm_schedalgo_rq_length(void *rq, u8 priority)
+static int prm_rq_length(void *rq, u8 priority)
 {
 	struct vmm_schedalgo_rq *rqi = rq;
 
@@ -83,7 +83,7 @@ int vmm_schedalgo_rq_length(void *rq, u8 priority)
 	return rqi->count[priority];
 }
 
-int vmm_schedalgo_rq_enqueue(void *rq, struct vmm_vcpu *vcpu)
+static int prm_rq_enqueue(void *rq, struct vmm_vcpu *vcpu)
 {
 	struct vmm_schedalgo_rq_entry *rq_entry, *parent_e;
 	struct vmm_schedalgo_rq *rqi = rq;
@@ -118,9 +118,9 @@ int vmm_schedalgo_rq_enqueue(void *rq, struct vmm_vcpu *vcpu)
 	return VMM_OK;
 }
 
-int vmm_schedalgo_rq_dequeue(void *rq,
-			     struct vmm_vcpu **next,
-			     u64 *next_time_slice)
+static int prm_rq_dequeue(void *rq,
+			   struct vmm_vcpu **next,
+			   u64 *next_time_slice)
 {
 	int p;
 	struct rb_node *n;
@@ -166,7 +166,7 @@ int vmm_schedalgo_rq_dequeue(void *rq,
 	return VMM_OK;
 }
 
-int vmm_schedalgo_rq_detach(void *rq, struct vmm_vcpu *vcpu)
+static int prm_rq_detach(void *rq, struct vmm_vcpu *vcpu)
 {
 	struct vmm_schedalgo_rq_entry *rq_entry;
 	struct vmm_schedalgo_rq *rqi = rq;
@@ -187,7 +187,7 @@ int vmm_schedalgo_rq_detach(void *rq, struct vmm_vcpu *vcpu)
 	return VMM_OK;
 }
 
-bool vmm_schedalgo_rq_prempt_needed(void *rq, struct vmm_vcpu *current)
+static bool prm_rq_prempt_needed(void *rq, struct vmm_vcpu *current)
 {
 	int p;
 	bool ret = FALSE;
@@ -213,7 +213,7 @@ bool vmm_schedalgo_rq_prempt_needed(void *rq, struct vmm_vcpu *current)
 	return ret;
 }
 
-void *vmm_schedalgo_rq_create(void)
+static void *prm_rq_create(void)
 {
 	int p;
 	struct vmm_schedalgo_rq *rq =
@@ -231,7 +231,7 @@ void *vmm_schedalgo_rq_create(void)
 	return rq;
 }
 
-int vmm_schedalgo_rq_destroy(void *rq)
+static int prm_rq_destroy(void *rq)
 {
 	if (!rq) {
 		return VMM_EFAIL;
@@ -241,3 +241,15 @@ int vmm_schedalgo_rq_destroy(void *rq)
 	return VMM_OK;
 }
 
+const struct vmm_schedalgo vmm_schedalgo_prm = {
+	.name = "prm",
+	.vcpu_setup = prm_vcpu_setup,
+	.vcpu_cleanup = prm_vcpu_cleanup,
+	.rq_enqueue = prm_rq_enqueue,
+	.rq_dequeue = prm_rq_dequeue,
+	.rq_detach = prm_rq_detach,
+	.rq_prempt_needed = prm_rq_prempt_needed,
+	.rq_create = prm_rq_create,
+	.rq_destroy = prm_rq_destroy,
+	.rq_length = prm_rq_length,
+};
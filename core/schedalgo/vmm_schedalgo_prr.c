@@ -35,7 +35,7 @@ struct vmm_schedalgo_rq {
 	struct dlist list[VMM_VCPU_MAX_PRIORITY+1];
 };
 
-int vmm_schedalgo_vcpu_setup(struct vmm_vcpu *vcpu)
+static int prr_vcpu_setup(struct vmm_vcpu *vcpu)
 {
 	struct vmm_schedalgo_rq_entry *rq_entry;
 
@@ -55,7 +55,7 @@ int vmm_schedalgo_vcpu_setup(struct vmm_vcpu *vcpu)
 	return VMM_OK;
 }
 
-int vmm_schedalgo_vcpu_cleanup(struct vmm_vcpu *vcpu)
+static int prr_vcpu_cleanup(struct vmm_vcpu *vcpu)
 {
 	if (!vcpu) {
 		return VMM_EFAIL;
@@ -69,7 +69,7 @@ int vmm_schedalgo_vcpu_cleanup(struct vmm_vcpu *vcpu)
 	return VMM_OK;
 }
 
-int vmm_schedalgo_rq_length(void *rq, u8 priority)
+static int prr_rq_length(void *rq, u8 priority)
 {
 	struct vmm_schedalgo_rq_entry *rq_entry;
 	struct vmm_schedalgo_rq *rqi;
@@ -88,7 +88,7 @@ int vmm_schedalgo_rq_length(void *rq, u8 priority)
 	return count;
 }
 
-int vmm_schedalgo_rq_enqueue(void *rq, struct vmm_vcpu *vcpu)
+static int prr_rq_enqueue(void *rq, struct vmm_vcpu *vcpu)
 {
 	struct vmm_schedalgo_rq_entry *rq_entry;
 	struct vmm_schedalgo_rq *rqi;
@@ -109,9 +109,9 @@ int vmm_schedalgo_rq_enqueue(void *rq, struct vmm_vcpu *vcpu)
 	return VMM_OK;
 }
 
-int vmm_schedalgo_rq_dequeue(void *rq,
-			     struct vmm_vcpu **next,
-			     u64 *next_time_slice)
+static int prr_rq_dequeue(void *rq,
+			   struct vmm_vcpu **next,
+			   u64 *next_time_slice)
 {
 	int p;
 	struct vmm_schedalgo_rq_entry *rq_entry;
@@ -150,7 +150,7 @@ int vmm_schedalgo_rq_dequeue(void *rq,
 	return VMM_OK;
 }
 
-int vmm_schedalgo_rq_detach(void *rq, struct vmm_vcpu *vcpu)
+static int prr_rq_detach(void *rq, struct vmm_vcpu *vcpu)
 {
 	struct vmm_schedalgo_rq_entry *rq_entry;
 
@@ -169,7 +169,7 @@ int vmm_schedalgo_rq_detach(void *rq, struct vmm_vcpu *vcpu)
 	return VMM_OK;
 }
 
-bool vmm_schedalgo_rq_prempt_needed(void *rq, struct vmm_vcpu *current)
+static bool prr_rq_prempt_needed(void *rq, struct vmm_vcpu *current)
 {
 	int p;
 	bool ret = FALSE;
@@ -193,7 +193,7 @@ bool vmm_schedalgo_rq_prempt_needed(void *rq, struct vmm_vcpu *current)
 	return ret;
 }
 
-void *vmm_schedalgo_rq_create(void)
+static void *prr_rq_create(void)
 {
 	int p;
 	struct vmm_schedalgo_rq *rq = 
@@ -208,7 +208,7 @@ void *vmm_schedalgo_rq_create(void)
 	return rq;
 }
 
-int vmm_schedalgo_rq_destroy(void *rq)
+static int prr_rq_destroy(void *rq)
 {
 	if (rq) {
 		vmm_free(rq);
@@ -218,3 +218,15 @@ int vmm_schedalgo_rq_destroy(void *rq)
 	return VMM_EFAIL;
 }
 
+const struct vmm_schedalgo vmm_schedalgo_prr = {
+	.name = "prr",
+	.vcpu_setup = prr_vcpu_setup,
+	.vcpu_cleanup = prr_vcpu_cleanup,
+	.rq_enqueue = prr_rq_enqueue,
+	.rq_dequeue = prr_rq_dequeue,
+	.rq_detach = prr_rq_detach,
+	.rq_prempt_needed = prr_rq_prempt_needed,
+	.rq_create = prr_rq_create,
+	.rq_destroy = prr_rq_destroy,
+	.rq_length = prr_rq_length,
+};
@@ -46,6 +46,8 @@
 #define	MODULE_INIT			vmm_vdisk_init
 #define	MODULE_EXIT			vmm_vdisk_exit
 
+#define VDISK_BOUNCE_SIZE		CONFIG_VDISK_BOUNCE_SIZE
+
 struct vmm_vdisk_ctrl {
 	struct vmm_mutex vdisk_list_lock;
         struct dlist vdisk_list;
@@ -176,17 +178,16 @@ u32 vmm_vdisk_get_request_len(struct vmm_vdisk_request *vreq)
 }
 VMM_EXPORT_SYMBOL(vmm_vdisk_get_request_len);
 
-int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
-			     struct vmm_vdisk_request *vreq,
-			     enum vmm_vdisk_request_type type,
-			     u64 lba, void *data, u32 data_len)
+static int vdisk_submit_request(struct vmm_vdisk *vdisk,
+				struct vmm_vdisk_request *vreq,
+				enum vmm_vdisk_request_type type,
+				u64 lba, void *data,
+				struct vmm_request_sg *sg, u32 sg_count,
+				u32 data_len)
 {
 	int rc;
 	irq_flags_t flags;
 
-	if (!vdisk || !vreq || !data) {
-		return VMM_EINVALID;
-	}
 	if (data_len < vdisk->block_size) {
 		return VMM_EINVALID;
 	}
@@ -203,6 +204,9 @@ int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
 		vreq->r.bcnt =
 			udiv32(data_len, vdisk->block_size) * vdisk->blk_factor;
 		vreq->r.data = data;
+		vreq->r.sg = sg;
+		vreq->r.sg_count = sg_count;
+		vreq->r.bounce = NULL;
 		vreq->r.completed = vdisk_req_completed;
 		vreq->r.failed = vdisk_req_failed;
 		vreq->r.priv = NULL;
@@ -218,8 +222,36 @@ int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
 
 	return rc;
 }
+
+int vmm_vdisk_submit_request(struct vmm_vdisk *vdisk,
+			     struct vmm_vdisk_request *vreq,
+			     enum vmm_vdisk_request_type type,
+			     u64 lba, void *data, u32 data_len)
+{
+	if (!vdisk || !vreq || !data) {
+		return VMM_EINVALID;
+	}
+
+	return vdisk_submit_request(vdisk, vreq, type, lba,
+				    data, NULL, 0, data_len);
+}
 VMM_EXPORT_SYMBOL(vmm_vdisk_submit_request);
 
+int vmm_vdisk_submit_request_sg(struct vmm_vdisk *vdisk,
+				struct vmm_vdisk_request *vreq,
+				enum vmm_vdisk_request_type type,
+				u64 lba, struct vmm_request_sg *sg,
+				u32 sg_count, u32 data_len)
+{
+	if (!vdisk || !vreq || !sg || !sg_count) {
+		return VMM_EINVALID;
+	}
+
+	return vdisk_submit_request(vdisk, vreq, type, lba,
+				    NULL, sg, sg_count, data_len);
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_submit_request_sg);
+
 int vmm_vdisk_abort_request(struct vmm_vdisk *vdisk,
 			    struct vmm_vdisk_request *vreq)
 {
@@ -248,6 +280,42 @@ int vmm_vdisk_abort_request(struct vmm_vdisk *vdisk,
 }
 VMM_EXPORT_SYMBOL(vmm_vdisk_abort_request);
 
+void vmm_vdisk_plug(struct vmm_vdisk *vdisk)
+{
+	irq_flags_t flags;
+
+	if (!vdisk) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
+	if (!vdisk->plug_count && vdisk->blk) {
+		vmm_blockdev_plug(vdisk->blk);
+	}
+	vdisk->plug_count++;
+	vmm_spin_unlock_irqrestore_lite(&vdisk->blk_lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_plug);
+
+void vmm_vdisk_unplug(struct vmm_vdisk *vdisk)
+{
+	irq_flags_t flags;
+
+	if (!vdisk) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
+	if (vdisk->plug_count) {
+		vdisk->plug_count--;
+		if (!vdisk->plug_count && vdisk->blk) {
+			vmm_blockdev_unplug(vdisk->blk);
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&vdisk->blk_lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_unplug);
+
 int vmm_vdisk_flush_cache(struct vmm_vdisk *vdisk)
 {
 	int rc;
@@ -317,6 +385,26 @@ int vmm_vdisk_current_block_device(struct vmm_vdisk *vdisk,
 }
 VMM_EXPORT_SYMBOL(vmm_vdisk_current_block_device);
 
+void *vmm_vdisk_alloc_buf(struct vmm_vdisk *vdisk, u32 len)
+{
+	return (vdisk) ? vmm_arena_malloc(vdisk->pool, len) : NULL;
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_alloc_buf);
+
+bool vmm_vdisk_owns_buf(struct vmm_vdisk *vdisk, const void *buf)
+{
+	return (vdisk) ? vmm_arena_contains(vdisk->pool, buf) : FALSE;
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_owns_buf);
+
+void vmm_vdisk_free_buf(struct vmm_vdisk *vdisk, void *buf)
+{
+	if (vdisk) {
+		vmm_arena_free(vdisk->pool, buf);
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_vdisk_free_buf);
+
 struct vdisk_attach_priv {
 	struct vmm_vdisk *vdisk;
 	const char *bdev_name;
@@ -339,6 +427,9 @@ static int vdisk_attach_iter(struct vmm_blockdev *dev, void *data)
 			vdisk->blk = dev;
 			vdisk->blk_factor = udiv32(vdisk->block_size,
 					           vdisk->blk->block_size);
+			if (vdisk->plug_count) {
+				vmm_blockdev_plug(vdisk->blk);
+			}
 			attached = TRUE;
 		}
 		vmm_spin_unlock_irqrestore_lite(&vdisk->blk_lock, flags);
@@ -377,6 +468,9 @@ void vmm_vdisk_detach_block_device(struct vmm_vdisk *vdisk)
 	detached = FALSE;
 	vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
 	if (vdisk->blk) {
+		if (vdisk->plug_count) {
+			vmm_blockdev_unplug(vdisk->blk);
+		}
 		vmm_blockdev_flush_cache(vdisk->blk);
 		detached = TRUE;
 	}
@@ -391,6 +485,7 @@ void vmm_vdisk_detach_block_device(struct vmm_vdisk *vdisk)
 VMM_EXPORT_SYMBOL(vmm_vdisk_detach_block_device);
 
 struct vmm_vdisk *vmm_vdisk_create(const char *name, u32 block_size,
+	u32 queue_depth,
 	void (*attached)(struct vmm_vdisk *),
 	void (*detached)(struct vmm_vdisk *),
 	void (*completed)(struct vmm_vdisk *, struct vmm_vdisk_request *),
@@ -443,8 +538,20 @@ struct vmm_vdisk *vmm_vdisk_create(const char *name, u32 block_size,
 	INIT_SPIN_LOCK(&vdisk->blk_lock);
 	vdisk->blk = NULL;
 	vdisk->blk_factor = 1;
+	vdisk->plug_count = 0;
+	vdisk->queue_depth = queue_depth;
 	vdisk->priv = priv;
 
+	/* Bounce buffer pool is sized for queue depth upfront */
+	if (queue_depth) {
+		vdisk->pool = vmm_arena_create(queue_depth * VDISK_BOUNCE_SIZE);
+		if (!vdisk->pool) {
+			vmm_free(vdisk);
+			vmm_mutex_unlock(&vdctrl.vdisk_list_lock);
+			return NULL;
+		}
+	}
+
 	list_add_tail(&vdisk->head, &vdctrl.vdisk_list);
 
 	vmm_mutex_unlock(&vdctrl.vdisk_list_lock);
@@ -504,6 +611,7 @@ int vmm_vdisk_destroy(struct vmm_vdisk *vdisk)
 
 	list_del(&vd->head);
 
+	vmm_arena_destroy(vd->pool);
 	vmm_free(vd);
 
 	vmm_mutex_unlock(&vdctrl.vdisk_list_lock);
@@ -615,6 +723,9 @@ static int vdisk_blk_notification(struct vmm_notifier_block *nb,
 	list_for_each_entry(vdisk, &vdctrl.vdisk_list, head) {
 		vmm_spin_lock_irqsave_lite(&vdisk->blk_lock, flags);
 		if (vdisk->blk == e->bdev) {
+			if (vdisk->plug_count) {
+				vmm_blockdev_unplug(vdisk->blk);
+			}
 			vdisk->blk = NULL;
 			vdisk->blk_factor = 1;
 		}
@@ -26,10 +26,12 @@
 #include <vmm_heap.h>
 #include <vmm_mutex.h>
 #include <vmm_modules.h>
+#include <vmm_host_aspace.h>
 #include <vmm_guest_aspace.h>
 #include <vio/vmm_vdisplay.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
+#include <libs/bitops.h>
 
 #define MODULE_DESC			"Virtual Display Framework"
 #define MODULE_AUTHOR			"Anup Patel"
@@ -185,25 +187,37 @@ void vmm_pixelformat_init_different_endian(struct vmm_pixelformat *pf, int bpp)
 }
 VMM_EXPORT_SYMBOL(vmm_pixelformat_init_different_endian);
 
-void vmm_surface_update(struct vmm_surface *s,
-			struct vmm_guest *guest,
-			physical_addr_t src_gphys,
-			int cols, int rows,
-			int src_width,
-			int dst_row_pitch,
-			int dst_col_pitch,
-			void (*fn)(struct vmm_surface *s,
-				   void *priv, u8 *dst, const u8 *src,
-				   int width, int dststep),
-			void *fn_priv,
-			int *first_row,
-			int *last_row)
+/* Check whether any dirty page overlaps given bytes of source */
+static bool surface_src_dirty(const unsigned long *dirty,
+			      physical_addr_t off, int len)
+{
+	u32 start = off >> VMM_PAGE_SHIFT;
+	u32 end = ((off + len - 1) >> VMM_PAGE_SHIFT) + 1;
+
+	return (find_next_bit(dirty, end, start) < end) ? TRUE : FALSE;
+}
+
+static void surface_update(struct vmm_surface *s,
+			   struct vmm_guest *guest,
+			   physical_addr_t src_gphys,
+			   int cols, int rows,
+			   int src_width,
+			   int dst_row_pitch,
+			   int dst_col_pitch,
+			   void (*fn)(struct vmm_surface *s,
+				      void *priv, u8 *dst, const u8 *src,
+				      int width, int dststep),
+			   void *fn_priv,
+			   const unsigned long *dirty,
+			   int *first_row,
+			   int *last_row)
 {
 #define CHUNK_SIZE		256
 	u32 len;
-	int i, j;
+	int i, j, first = -1, last = -1;
 	int chunk_len, chunk_cols, chunk_dst_row_pitch;
 	u8 *dst, chunk[CHUNK_SIZE];
+	physical_addr_t src_base = src_gphys & ~VMM_PAGE_MASK;
 
 	/* Sanity check */
 	if (!s || !guest || !first_row || !last_row) {
@@ -240,6 +254,19 @@ void vmm_surface_update(struct vmm_surface *s,
 
 	/* Update surface data in chunks */
 	for (i = *first_row; i < rows; i++) {
+		/* Skip rows whose source pages are clean */
+		if (dirty &&
+		    !surface_src_dirty(dirty, src_gphys - src_base,
+				       src_width)) {
+			src_gphys += src_width;
+			dst += dst_row_pitch;
+			continue;
+		}
+		if (first < 0) {
+			first = i;
+		}
+		last = i;
+
 		j = 0;
 		while (j < src_width) {
 			chunk_len = min(src_width - j, CHUNK_SIZE);
@@ -263,10 +290,59 @@ next_chunk:
 		}
 	}
 
-	*last_row = i;
+	if (dirty) {
+		*first_row = first;
+		*last_row = last;
+	} else {
+		*last_row = i;
+	}
+}
+
+void vmm_surface_update(struct vmm_surface *s,
+			struct vmm_guest *guest,
+			physical_addr_t src_gphys,
+			int cols, int rows,
+			int src_width,
+			int dst_row_pitch,
+			int dst_col_pitch,
+			void (*fn)(struct vmm_surface *s,
+				   void *priv, u8 *dst, const u8 *src,
+				   int width, int dststep),
+			void *fn_priv,
+			int *first_row,
+			int *last_row)
+{
+	surface_update(s, guest, src_gphys, cols, rows, src_width,
+		       dst_row_pitch, dst_col_pitch, fn, fn_priv,
+		       NULL, first_row, last_row);
 }
 VMM_EXPORT_SYMBOL(vmm_surface_update);
 
+void vmm_surface_update_dirty(struct vmm_surface *s,
+			      struct vmm_guest *guest,
+			      physical_addr_t src_gphys,
+			      int cols, int rows,
+			      int src_width,
+			      int dst_row_pitch,
+			      int dst_col_pitch,
+			      void (*fn)(struct vmm_surface *s,
+					 void *priv, u8 *dst, const u8 *src,
+					 int width, int dststep),
+			      void *fn_priv,
+			      const unsigned long *dirty,
+			      int *first_row,
+			      int *last_row)
+{
+	if (!dirty) {
+		return;
+	}
+
+	surface_update(s, guest, src_gphys, cols, rows, src_width,
+		       dst_row_pitch, dst_col_pitch, fn, fn_priv,
+		       dirty, first_row, last_row);
+}
+VMM_EXPORT_SYMBOL(vmm_surface_update_dirty);
+
 int vmm_surface_init(struct vmm_surface *s,
 		     const char *name,
 		     void *data, u32 data_size,
@@ -103,6 +103,7 @@ struct vmm_vkeyboard *vmm_vkeyboard_create(const char *name,
 	vkbd->ledstate = 0;
 	INIT_LIST_HEAD(&vkbd->led_handler_list);
 	vkbd->kbd_event = kbd_event;
+	vkbd->kbd_sync = NULL;
 	vkbd->priv = priv;
 
 	list_add_tail(&vkbd->head, &victrl.vkbd_list);
@@ -175,7 +176,16 @@ int vmm_vkeyboard_destroy(struct vmm_vkeyboard *vkbd)
 }
 VMM_EXPORT_SYMBOL(vmm_vkeyboard_destroy);
 
-int vmm_vkeyboard_event(struct vmm_vkeyboard *vkbd, int keycode)
+void vmm_vkeyboard_set_sync(struct vmm_vkeyboard *vkbd,
+			    void (*kbd_sync) (struct vmm_vkeyboard *))
+{
+	if (vkbd) {
+		vkbd->kbd_sync = kbd_sync;
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_vkeyboard_set_sync);
+
+int vmm_vkeyboard_report(struct vmm_vkeyboard *vkbd, int keycode)
 {
 	if (!vkbd || !vkbd->kbd_event) {
 		return VMM_EINVALID;
@@ -185,6 +195,33 @@ int vmm_vkeyboard_event(struct vmm_vkeyboard *vkbd, int keycode)
 
 	return VMM_OK;
 }
+VMM_EXPORT_SYMBOL(vmm_vkeyboard_report);
+
+int vmm_vkeyboard_sync(struct vmm_vkeyboard *vkbd)
+{
+	if (!vkbd) {
+		return VMM_EINVALID;
+	}
+
+	if (vkbd->kbd_sync) {
+		vkbd->kbd_sync(vkbd);
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_vkeyboard_sync);
+
+int vmm_vkeyboard_event(struct vmm_vkeyboard *vkbd, int keycode)
+{
+	int rc;
+
+	rc = vmm_vkeyboard_report(vkbd, keycode);
+	if (rc) {
+		return rc;
+	}
+
+	return vmm_vkeyboard_sync(vkbd);
+}
 VMM_EXPORT_SYMBOL(vmm_vkeyboard_event);
 
 int vmm_vkeyboard_add_led_handler(struct vmm_vkeyboard *vkbd,
@@ -437,6 +474,7 @@ struct vmm_vmouse *vmm_vmouse_create(const char *name,
 	vmou->graphics_height = 0;
 	vmou->graphics_rotation = 0;
 	vmou->mouse_event = mouse_event;
+	vmou->mouse_sync = NULL;
 	vmou->priv = priv;
 
 	list_add_tail(&vmou->head, &victrl.vmou_list);
@@ -498,8 +536,17 @@ int vmm_vmouse_destroy(struct vmm_vmouse *vmou)
 }
 VMM_EXPORT_SYMBOL(vmm_vmouse_destroy);
 
-int vmm_vmouse_event(struct vmm_vmouse *vmou,
-		     int dx, int dy, int dz, int buttons_state)
+void vmm_vmouse_set_sync(struct vmm_vmouse *vmou,
+			 void (*mouse_sync) (struct vmm_vmouse *))
+{
+	if (vmou) {
+		vmou->mouse_sync = mouse_sync;
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_vmouse_set_sync);
+
+int vmm_vmouse_report(struct vmm_vmouse *vmou,
+		      int dx, int dy, int dz, int buttons_state)
 {
 	int w, h;
 
@@ -535,6 +582,34 @@ int vmm_vmouse_event(struct vmm_vmouse *vmou,
 
 	return VMM_OK;
 }
+VMM_EXPORT_SYMBOL(vmm_vmouse_report);
+
+int vmm_vmouse_sync(struct vmm_vmouse *vmou)
+{
+	if (!vmou) {
+		return VMM_EINVALID;
+	}
+
+	if (vmou->mouse_sync) {
+		vmou->mouse_sync(vmou);
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_vmouse_sync);
+
+int vmm_vmouse_event(struct vmm_vmouse *vmou,
+		     int dx, int dy, int dz, int buttons_state)
+{
+	int rc;
+
+	rc = vmm_vmouse_report(vmou, dx, dy, dz, buttons_state);
+	if (rc) {
+		return rc;
+	}
+
+	return vmm_vmouse_sync(vmou);
+}
 VMM_EXPORT_SYMBOL(vmm_vmouse_event);
 
 bool vmm_vmouse_is_absolute(struct vmm_vmouse *vmou)
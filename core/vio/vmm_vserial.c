@@ -63,6 +63,9 @@ u32 vmm_vserial_send(struct vmm_vserial *vser, u8 *src, u32 len)
 	if (!vser || !src) {
 		return 0;
 	}
+	if (vser->send_buf) {
+		return vser->send_buf(vser, src, len);
+	}
 	if (!vser->can_send || !vser->send) {
 		return 0;
 	}
@@ -78,6 +81,21 @@ u32 vmm_vserial_send(struct vmm_vserial *vser, u8 *src, u32 len)
 }
 VMM_EXPORT_SYMBOL(vmm_vserial_send);
 
+static void vserial_deliver(struct vmm_vserial *vser,
+			    struct vmm_vserial_receiver *receiver,
+			    u8 *buf, u32 len)
+{
+	u32 i;
+
+	if (receiver->recv_buf) {
+		receiver->recv_buf(vser, receiver->priv, buf, len);
+	} else {
+		for (i = 0; i < len; i++) {
+			receiver->recv(vser, receiver->priv, buf[i]);
+		}
+	}
+}
+
 u32 vmm_vserial_receive(struct vmm_vserial *vser, u8 *dst, u32 len)
 {
 	u32 i;
@@ -93,34 +111,37 @@ u32 vmm_vserial_receive(struct vmm_vserial *vser, u8 *dst, u32 len)
 	if (list_empty(&vser->receiver_list)) {
 		vmm_spin_unlock_irqrestore(&vser->receiver_list_lock, flags);
 
-		for (i = 0; i < len ; i++) {
+		/* Overwrite oldest bytes only when receive FIFO is full */
+		i = fifo_enqueue_multi(vser->receive_fifo, dst, len);
+		for (; i < len ; i++) {
 			fifo_enqueue(vser->receive_fifo, &dst[i], TRUE);
 		}
 
-		return i;
+		return len;
 	}
 
-	for (i = 0; i < len ; i++) {
-		list_for_each_entry(receiver, &vser->receiver_list, head) {
-			receiver->recv(vser, receiver->priv, dst[i]);
-		}
+	list_for_each_entry(receiver, &vser->receiver_list, head) {
+		vserial_deliver(vser, receiver, dst, len);
 	}
 
 	vmm_spin_unlock_irqrestore(&vser->receiver_list_lock, flags);
 
-	return i;
+	return len;
 }
 VMM_EXPORT_SYMBOL(vmm_vserial_receive);
 
-int vmm_vserial_register_receiver(struct vmm_vserial *vser, 
-		void (*recv) (struct vmm_vserial *, void *, u8), void *priv)
+static int vserial_add_receiver(struct vmm_vserial *vser,
+		void (*recv) (struct vmm_vserial *, void *, u8),
+		void (*recv_buf) (struct vmm_vserial *, void *, u8 *, u32),
+		void *priv)
 {
-	u8 chval;
+	u8 chbuf[64];
+	u32 chcount;
 	bool found;
 	irq_flags_t flags;
 	struct vmm_vserial_receiver *receiver;
 
-	if (!vser || !recv) {
+	if (!vser || (!recv && !recv_buf)) {
 		return VMM_EFAIL;
 	}
 
@@ -130,7 +151,8 @@ int vmm_vserial_register_receiver(struct vmm_vserial *vser,
 	vmm_spin_lock_irqsave(&vser->receiver_list_lock, flags);
 
 	list_for_each_entry(receiver, &vser->receiver_list, head) {
-		if (receiver->recv == recv) {
+		if ((receiver->recv == recv) &&
+		    (receiver->recv_buf == recv_buf)) {
 			found = TRUE;
 			break;
 		}
@@ -149,6 +171,7 @@ int vmm_vserial_register_receiver(struct vmm_vserial *vser,
 
 	INIT_LIST_HEAD(&receiver->head);
 	receiver->recv = recv;
+	receiver->recv_buf = recv_buf;
 	receiver->priv = priv;
 
 	list_add_tail(&receiver->head, &vser->receiver_list);
@@ -156,26 +179,29 @@ int vmm_vserial_register_receiver(struct vmm_vserial *vser,
 	vmm_spin_unlock_irqrestore(&vser->receiver_list_lock, flags);
 
 	while (!fifo_isempty(vser->receive_fifo)) {
-		if (!fifo_dequeue(vser->receive_fifo, &chval)) {
+		chcount = fifo_dequeue_multi(vser->receive_fifo,
+					     chbuf, sizeof(chbuf));
+		if (!chcount) {
 			break;
 		}
 		list_for_each_entry(receiver, &vser->receiver_list, head) {
-			receiver->recv(vser, receiver->priv, chval);
+			vserial_deliver(vser, receiver, chbuf, chcount);
 		}
 	}
 
 	return VMM_OK;
 }
-VMM_EXPORT_SYMBOL(vmm_vserial_register_receiver);
 
-int vmm_vserial_unregister_receiver(struct vmm_vserial *vser, 
-		void (*recv) (struct vmm_vserial *, void *, u8), void *priv)
+static int vserial_del_receiver(struct vmm_vserial *vser,
+		void (*recv) (struct vmm_vserial *, void *, u8),
+		void (*recv_buf) (struct vmm_vserial *, void *, u8 *, u32),
+		void *priv)
 {
 	bool found;
 	irq_flags_t flags;
 	struct vmm_vserial_receiver *receiver;
 
-	if (!vser || !recv) {
+	if (!vser || (!recv && !recv_buf)) {
 		return VMM_EFAIL;
 	}
 
@@ -185,7 +211,9 @@ int vmm_vserial_unregister_receiver(struct vmm_vserial *vser,
 	vmm_spin_lock_irqsave(&vser->receiver_list_lock, flags);
 
 	list_for_each_entry(receiver, &vser->receiver_list, head) {
-		if ((receiver->recv == recv) && (receiver->priv == priv)) {
+		if ((receiver->recv == recv) &&
+		    (receiver->recv_buf == recv_buf) &&
+		    (receiver->priv == priv)) {
 			found = TRUE;
 			break;
 		}
@@ -204,11 +232,58 @@ int vmm_vserial_unregister_receiver(struct vmm_vserial *vser,
 
 	return VMM_OK;
 }
+
+int vmm_vserial_register_receiver(struct vmm_vserial *vser, 
+		void (*recv) (struct vmm_vserial *, void *, u8), void *priv)
+{
+	if (!recv) {
+		return VMM_EFAIL;
+	}
+
+	return vserial_add_receiver(vser, recv, NULL, priv);
+}
+VMM_EXPORT_SYMBOL(vmm_vserial_register_receiver);
+
+int vmm_vserial_unregister_receiver(struct vmm_vserial *vser, 
+		void (*recv) (struct vmm_vserial *, void *, u8), void *priv)
+{
+	if (!recv) {
+		return VMM_EFAIL;
+	}
+
+	return vserial_del_receiver(vser, recv, NULL, priv);
+}
 VMM_EXPORT_SYMBOL(vmm_vserial_unregister_receiver);
 
+int vmm_vserial_register_receiver_buf(struct vmm_vserial *vser,
+		void (*recv_buf) (struct vmm_vserial *, void *, u8 *, u32),
+		void *priv)
+{
+	if (!recv_buf) {
+		return VMM_EFAIL;
+	}
+
+	return vserial_add_receiver(vser, NULL, recv_buf, priv);
+}
+VMM_EXPORT_SYMBOL(vmm_vserial_register_receiver_buf);
+
+int vmm_vserial_unregister_receiver_buf(struct vmm_vserial *vser,
+		void (*recv_buf) (struct vmm_vserial *, void *, u8 *, u32),
+		void *priv)
+{
+	if (!recv_buf) {
+		return VMM_EFAIL;
+	}
+
+	return vserial_del_receiver(vser, NULL, recv_buf, priv);
+}
+VMM_EXPORT_SYMBOL(vmm_vserial_unregister_receiver_buf);
+
 struct vmm_vserial *vmm_vserial_create(const char *name,
 				       bool (*can_send) (struct vmm_vserial *),
 				       int (*send) (struct vmm_vserial *, u8),
+				       u32 (*send_buf) (struct vmm_vserial *,
+							u8 *, u32),
 				       u32 receive_fifo_size, void *priv)
 {
 	bool found;
@@ -259,6 +334,7 @@ struct vmm_vserial *vmm_vserial_create(const char *name,
 	}
 	vser->can_send = can_send;
 	vser->send = send;
+	vser->send_buf = send_buf;
 	INIT_SPIN_LOCK(&vser->receiver_list_lock);
 	INIT_LIST_HEAD(&vser->receiver_list);
 	vser->priv = priv;
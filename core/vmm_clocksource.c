@@ -38,7 +38,8 @@ struct vmm_clocksource_ctrl {
 
 static struct vmm_clocksource_ctrl csctrl;
 
-#if defined(CONFIG_PROFILE)
+#if defined(CONFIG_PROFILE) || defined(CONFIG_HOST_IRQ_STATS) || \
+    defined(CONFIG_VCPU_EXIT_STATS) || defined(CONFIG_LOCKSTAT)
 /**
  * We need to have a special version of vmm_timecounter_read() for
  * profile where we do not modify the vmm_timecounter structure members.
@@ -46,38 +47,42 @@ static struct vmm_clocksource_ctrl csctrl;
  */
 u64 __notrace vmm_timecounter_read_for_profile(struct vmm_timecounter *tc)
 {
-	u64 cycles_now, cycles_delta;
-	u64 ns_offset;
+	u64 ns;
 
 	if (!tc || !tc->cs) {
 		return 0;
 	}
 
-	cycles_now = tc->cs->read(tc->cs);
-	cycles_delta = (cycles_now - tc->cycles_last) & tc->cs->mask;
-	ns_offset = vmm_clocksource_delta2nsecs(cycles_delta,
-						tc->cs->mult, tc->cs->shift);
+	if (vmm_timecounter_read_lockless(tc, &ns)) {
+		return ns;
+	}
 
-	return tc->nsec + ns_offset;
+	/* Counter not updated for too long so return stale value */
+	return tc->nsec;
 }
 #endif
 
 u64 vmm_timecounter_read(struct vmm_timecounter *tc)
 {
-	u64 cycles_now, cycles_delta;
-	u64 ns_offset;
+	u64 cycles_now, cycles_delta, tmp;
 
 	if (!tc || !tc->cs) {
 		return 0;
 	}
 
-	cycles_now = tc->cs->read(tc->cs);
-	cycles_delta = (cycles_now - tc->cycles_last) & tc->cs->mask;
+	cycles_now = vmm_timecounter_cycles(tc);
+	cycles_delta = (cycles_now - tc->cycles_last) & tc->mask;
+
+	tc->seq++;
+	arch_smp_wmb();
+
 	tc->cycles_last = cycles_now;
+	tmp = cycles_delta * tc->mult + tc->frac;
+	tc->nsec += tmp >> tc->shift;
+	tc->frac = tmp & ((1ULL << tc->shift) - 1);
 
-	ns_offset = vmm_clocksource_delta2nsecs(cycles_delta,
-						tc->cs->mult, tc->cs->shift);
-	tc->nsec += ns_offset;
+	arch_smp_wmb();
+	tc->seq++;
 
 	return tc->nsec;
 }
@@ -117,8 +122,19 @@ int vmm_timecounter_init(struct vmm_timecounter *tc,
 	}
 
 	tc->cs = cs;
-	tc->cycles_last = cs->read(cs);
+	tc->seq = 0;
+	tc->mask = cs->mask;
+	tc->mult = cs->mult;
+	tc->shift = cs->shift;
+	tc->read = cs->read;
+	/* Half of cycles which can be scaled without 64bit overflow */
+	tc->max_delta = udiv64(~0ULL - (1ULL << cs->shift), cs->mult) >> 1;
+	if (tc->max_delta > (cs->mask >> 1)) {
+		tc->max_delta = cs->mask >> 1;
+	}
+	tc->cycles_last = vmm_timecounter_cycles(tc);
 	tc->nsec = start_nsec;
+	tc->frac = 0;
 
 	return VMM_OK;
 }
@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_cpuidle.c
+ * @author agent (agent@local)
+ * @brief Host CPU idle states implementation
+ *
+ * The governor is intentionally simple: the time left till next timer
+ * event of a host CPU is the predicted idle time and the deepest idle
+ * state whose target residency fits in it is chosen. While any guest
+ * VCPU waits on the host CPU via WFI (or PSCI standby) only states with
+ * exit latency below CONFIG_CPUIDLE_WFI_LATENCY_US are allowed so that
+ * wakeup latency of such VCPU is not traded for power.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_smp.h>
+#include <vmm_cpumask.h>
+#include <vmm_spinlocks.h>
+#include <vmm_percpu.h>
+#include <vmm_timer.h>
+#include <vmm_rcu.h>
+#include <vmm_modules.h>
+#include <vmm_cpuidle.h>
+#include <arch_atomic.h>
+#include <arch_cpu_irq.h>
+
+#define CPUIDLE_WFI_LATENCY_NS	((u64)CONFIG_CPUIDLE_WFI_LATENCY_US * 1000ULL)
+
+struct vmm_cpuidle_cpu {
+	atomic_t latency_users;
+	u64 usage[VMM_CPUIDLE_MAX_STATES];
+	u64 time_ns[VMM_CPUIDLE_MAX_STATES];
+};
+
+static DEFINE_PER_CPU(struct vmm_cpuidle_cpu, cpuidle_cpu);
+static struct vmm_cpuidle_driver *cpuidle_drv = NULL;
+static DEFINE_SPINLOCK(cpuidle_drv_lock);
+
+static u32 cpuidle_select(struct vmm_cpuidle_driver *drv,
+			  struct vmm_cpuidle_cpu *cic)
+{
+	u32 i, best = 0;
+	u64 predicted, max_latency = ~0ULL;
+	struct vmm_cpuidle_state *st;
+
+	if (arch_atomic_read(&cic->latency_users) > 0) {
+		max_latency = CPUIDLE_WFI_LATENCY_NS;
+	}
+	predicted = vmm_timer_next_event_delta();
+
+	for (i = 1; i < drv->state_count; i++) {
+		st = &drv->states[i];
+		if ((predicted < st->target_residency_ns) ||
+		    (max_latency < st->exit_latency_ns)) {
+			break;
+		}
+		best = i;
+	}
+
+	return best;
+}
+
+void vmm_cpuidle_enter(void)
+{
+	u32 idx;
+	u64 tstamp;
+	struct vmm_cpuidle_state *st;
+	struct vmm_cpuidle_driver *drv;
+	struct vmm_cpuidle_cpu *cic = &this_cpu(cpuidle_cpu);
+
+	vmm_rcu_read_lock();
+
+	drv = vmm_rcu_dereference(cpuidle_drv);
+	if (!drv) {
+		vmm_rcu_read_unlock();
+		arch_cpu_wait_for_irq();
+		return;
+	}
+
+	idx = cpuidle_select(drv, cic);
+	st = &drv->states[idx];
+
+	tstamp = vmm_timer_timestamp();
+	if (!st->enter || st->enter(st)) {
+		/* Failed to enter idle state so fallback to WFI */
+		arch_cpu_wait_for_irq();
+	}
+	cic->time_ns[idx] += vmm_timer_timestamp() - tstamp;
+	cic->usage[idx]++;
+
+	vmm_rcu_read_unlock();
+}
+
+void vmm_cpuidle_latency_get(u32 cpu)
+{
+	if (cpu < CONFIG_CPU_COUNT) {
+		arch_atomic_inc(&per_cpu(cpuidle_cpu, cpu).latency_users);
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_cpuidle_latency_get);
+
+void vmm_cpuidle_latency_put(u32 cpu)
+{
+	if (cpu < CONFIG_CPU_COUNT) {
+		arch_atomic_dec_if_positive(
+				&per_cpu(cpuidle_cpu, cpu).latency_users);
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_cpuidle_latency_put);
+
+int vmm_cpuidle_register_driver(struct vmm_cpuidle_driver *drv)
+{
+	u32 i, cpu;
+	irq_flags_t flags;
+
+	if (!drv || !drv->state_count ||
+	    (VMM_CPUIDLE_MAX_STATES < drv->state_count)) {
+		return VMM_EINVALID;
+	}
+
+	/* States must be ordered from shallowest to deepest */
+	for (i = 1; i < drv->state_count; i++) {
+		if ((drv->states[i].target_residency_ns <
+		     drv->states[i - 1].target_residency_ns) ||
+		    (drv->states[i].exit_latency_ns <
+		     drv->states[i - 1].exit_latency_ns)) {
+			return VMM_EINVALID;
+		}
+	}
+
+	vmm_spin_lock_irqsave(&cpuidle_drv_lock, flags);
+	if (cpuidle_drv) {
+		vmm_spin_unlock_irqrestore(&cpuidle_drv_lock, flags);
+		return VMM_EEXIST;
+	}
+	for_each_possible_cpu(cpu) {
+		for (i = 0; i < VMM_CPUIDLE_MAX_STATES; i++) {
+			per_cpu(cpuidle_cpu, cpu).usage[i] = 0;
+			per_cpu(cpuidle_cpu, cpu).time_ns[i] = 0;
+		}
+	}
+	vmm_rcu_assign_pointer(cpuidle_drv, drv);
+	vmm_spin_unlock_irqrestore(&cpuidle_drv_lock, flags);
+
+	vmm_printf("cpuidle: registered %s driver with %d states\n",
+		   drv->name, drv->state_count);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_cpuidle_register_driver);
+
+int vmm_cpuidle_unregister_driver(struct vmm_cpuidle_driver *drv)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&cpuidle_drv_lock, flags);
+	if (!drv || (cpuidle_drv != drv)) {
+		vmm_spin_unlock_irqrestore(&cpuidle_drv_lock, flags);
+		return VMM_EINVALID;
+	}
+	vmm_rcu_assign_pointer(cpuidle_drv, NULL);
+	vmm_spin_unlock_irqrestore(&cpuidle_drv_lock, flags);
+
+	/* Wait for host CPUs still using idle states of driver */
+	vmm_rcu_synchronize();
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_cpuidle_unregister_driver);
+
+struct vmm_cpuidle_driver *vmm_cpuidle_get_driver(void)
+{
+	return cpuidle_drv;
+}
+VMM_EXPORT_SYMBOL(vmm_cpuidle_get_driver);
+
+int vmm_cpuidle_get_stats(u32 cpu, u32 state, u64 *usage, u64 *time_ns)
+{
+	if ((CONFIG_CPU_COUNT <= cpu) || (VMM_CPUIDLE_MAX_STATES <= state)) {
+		return VMM_EINVALID;
+	}
+
+	if (usage) {
+		*usage = per_cpu(cpuidle_cpu, cpu).usage[state];
+	}
+	if (time_ns) {
+		*time_ns = per_cpu(cpuidle_cpu, cpu).time_ns[state];
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_cpuidle_get_stats);
@@ -26,7 +26,11 @@
  * The original code is licensed under the GPL.
  */
 
+#include <vmm_smp.h>
+#include <vmm_stdio.h>
+#include <vmm_params.h>
 #include <vmm_cpumask.h>
+#include <libs/stringlib.h>
 
 /* Number of possible processor count 
  * Note: SMP secondary core init will update this count
@@ -71,6 +75,19 @@ const struct vmm_cpumask *const cpu_present_mask = to_cpumask(cpu_present_bits);
 static DECLARE_BITMAP(cpu_active_bits, CONFIG_CPU_COUNT) __read_mostly;
 const struct vmm_cpumask *const cpu_active_mask = to_cpumask(cpu_active_bits);
 
+static DECLARE_BITMAP(cpu_isolated_bits, CONFIG_CPU_COUNT) __read_mostly;
+const struct vmm_cpumask *const cpu_isolated_mask = to_cpumask(cpu_isolated_bits);
+
+static DECLARE_BITMAP(cpu_housekeeping_bits, CONFIG_CPU_COUNT) __read_mostly;
+const struct vmm_cpumask *const cpu_housekeeping_mask = to_cpumask(cpu_housekeeping_bits);
+
+static void update_cpu_housekeeping(void)
+{
+	vmm_cpumask_andnot(to_cpumask(cpu_housekeeping_bits),
+			   to_cpumask(cpu_online_bits),
+			   to_cpumask(cpu_isolated_bits));
+}
+
 void vmm_set_cpu_possible(unsigned int cpu, bool possible)
 {
 	if (possible)
@@ -93,6 +110,7 @@ void vmm_set_cpu_online(unsigned int cpu, bool online)
 		vmm_cpumask_set_cpu(cpu, to_cpumask(cpu_online_bits));
 	else
 		vmm_cpumask_clear_cpu(cpu, to_cpumask(cpu_online_bits));
+	update_cpu_housekeeping();
 }
 
 void vmm_set_cpu_active(unsigned int cpu, bool active)
@@ -116,5 +134,51 @@ void vmm_init_cpu_possible(const struct vmm_cpumask *src)
 void vmm_init_cpu_online(const struct vmm_cpumask *src)
 {
 	vmm_cpumask_copy(to_cpumask(cpu_online_bits), src);
+	update_cpu_housekeeping();
+}
+
+void vmm_set_cpu_isolated(unsigned int cpu, bool isolated)
+{
+	/* Boot CPU always does housekeeping */
+	if (isolated && (cpu != vmm_smp_bootcpu_id()))
+		vmm_cpumask_set_cpu(cpu, to_cpumask(cpu_isolated_bits));
+	else
+		vmm_cpumask_clear_cpu(cpu, to_cpumask(cpu_isolated_bits));
+	update_cpu_housekeeping();
+}
+
+/* Parse list of CPUs (for e.g. "1,2-3") to be isolated */
+static int __init isolcpus_setup(char *str)
+{
+	char *end;
+	unsigned long cpu, last;
+
+	while (*str) {
+		cpu = last = strtoul(str, &end, 10);
+		if (end == str) {
+			break;
+		}
+		if (*end == '-') {
+			str = end + 1;
+			last = strtoul(str, &end, 10);
+			if (end == str) {
+				break;
+			}
+		}
+		for (; (cpu <= last) && (cpu < CONFIG_CPU_COUNT); cpu++) {
+			vmm_set_cpu_isolated(cpu, TRUE);
+		}
+		if (*end != ',') {
+			break;
+		}
+		str = end + 1;
+	}
+
+	if (*str && (*end != '\0')) {
+		vmm_printf("%s: invalid CPU list %s\n", __func__, str);
+	}
+
+	return 0;
 }
+vmm_early_param("isolcpus=", isolcpus_setup);
 
@@ -29,6 +29,8 @@
 #include <vmm_devres.h>
 #include <vmm_mutex.h>
 #include <vmm_workqueue.h>
+#include <vmm_waitqueue.h>
+#include <vmm_cpumask.h>
 #include <vmm_devdrv.h>
 #include <libs/stringlib.h>
 
@@ -42,9 +44,26 @@ struct vmm_devdrv_ctrl {
 	struct dlist deferred_probe_list;
 	struct vmm_work deferred_probe_work;
 
+#if defined(CONFIG_DEVDRV_ASYNC_PROBE)
+	struct vmm_mutex async_probe_wq_lock;
+	u32 async_probe_wq_next;
+	struct vmm_workqueue *async_probe_wq[CONFIG_CPU_COUNT];
+	u32 async_probe_count;
+	struct vmm_waitqueue async_probe_waitq;
+#endif
+
 	struct vmm_bus platform_bus;
 };
 
+#if defined(CONFIG_DEVDRV_ASYNC_PROBE)
+struct devdrv_async_probe {
+	struct vmm_work work;
+	struct vmm_bus *bus;
+	struct vmm_device *dev;
+	struct vmm_driver *drv;
+};
+#endif
+
 static struct vmm_devdrv_ctrl ddctrl;
 
 static void __bus_probe_this_device(struct vmm_bus *bus,
@@ -133,6 +152,204 @@ static void deferred_probe_del(struct vmm_device *dev)
 	vmm_mutex_unlock(&ddctrl.deferred_probe_lock);
 }
 
+#if defined(CONFIG_DEVDRV_ASYNC_PROBE)
+
+static struct vmm_workqueue *async_probe_workqueue(void)
+{
+	u32 c, cpu = 0;
+	char name[VMM_FIELD_NAME_SIZE];
+	struct vmm_workqueue *wq = NULL;
+
+	vmm_mutex_lock(&ddctrl.async_probe_wq_lock);
+
+	/* Spread probes over online host CPUs in round-robin order */
+	for (c = 0; c < CONFIG_CPU_COUNT; c++) {
+		cpu = ddctrl.async_probe_wq_next;
+		ddctrl.async_probe_wq_next = (cpu + 1) % CONFIG_CPU_COUNT;
+		if (vmm_cpu_online(cpu)) {
+			break;
+		}
+	}
+	if (c == CONFIG_CPU_COUNT) {
+		goto done;
+	}
+
+	/* Probe workqueue of a host CPU is created upon first use */
+	wq = ddctrl.async_probe_wq[cpu];
+	if (!wq) {
+		vmm_snprintf(name, sizeof(name), "devprobe/%d", cpu);
+		wq = vmm_workqueue_create(name, VMM_THREAD_DEF_PRIORITY);
+		if (wq && vmm_threads_set_affinity(vmm_workqueue_get_thread(wq),
+						   vmm_cpumask_of(cpu))) {
+			vmm_workqueue_destroy(wq);
+			wq = NULL;
+		}
+		ddctrl.async_probe_wq[cpu] = wq;
+	}
+
+done:
+	vmm_mutex_unlock(&ddctrl.async_probe_wq_lock);
+
+	return wq;
+}
+
+static void async_probe_done(struct vmm_device *dev)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&ddctrl.async_probe_waitq.lock, flags);
+
+	dev->async_probe_pending = FALSE;
+	ddctrl.async_probe_count--;
+	__vmm_waitqueue_wakeall(&ddctrl.async_probe_waitq);
+
+	vmm_spin_unlock_irqrestore(&ddctrl.async_probe_waitq.lock, flags);
+}
+
+static void async_probe_work_func(struct vmm_work *work)
+{
+	int rc = VMM_OK;
+	struct devdrv_async_probe *ap =
+			container_of(work, struct devdrv_async_probe, work);
+	struct vmm_bus *bus = ap->bus;
+	struct vmm_device *dev = ap->dev;
+	struct vmm_driver *drv = ap->drv;
+
+	/* Note: We don't hold bus->lock here so that probes of
+	 * different devices on same bus can run in parallel. The
+	 * device is already claimed by dev->driver and removal of
+	 * device waits for async_probe_pending to be cleared.
+	 */
+	if (bus->probe) {
+#if defined(CONFIG_VERBOSE_MODE)
+		vmm_printf("devdrv: bus=\"%s\" device=\"%s\" "
+			   "driver=\"%s\" async bus probe.\n",
+			   bus->name, dev->name, drv->name);
+#endif
+		rc = bus->probe(dev);
+	} else if (drv->probe) {
+#if defined(CONFIG_VERBOSE_MODE)
+		vmm_printf("devdrv: bus=\"%s\" device=\"%s\" "
+			   "driver=\"%s\" async probe.\n",
+			   bus->name, dev->name, drv->name);
+#endif
+		rc = drv->probe(dev, NULL);
+	}
+
+	if (rc) {
+#if defined(CONFIG_VERBOSE_MODE)
+		if (rc != VMM_EPROBE_DEFER) {
+			vmm_printf("devdrv: bus=\"%s\" device=\"%s\" "
+				   "probe error %d\n",
+				   bus->name, dev->name, rc);
+		}
+#endif
+		dev->driver = NULL;
+	} else {
+		/* Notify bus event listeners */
+		vmm_blocking_notifier_call(&bus->event_listeners,
+					   VMM_BUS_NOTIFY_BOUND_DRIVER, dev);
+	}
+
+	async_probe_done(dev);
+
+	if (rc == VMM_EPROBE_DEFER) {
+		/* Add device to deferred list */
+		if (dev->is_registered) {
+			deferred_probe_add(dev);
+		}
+	} else if (!rc) {
+		/* Newly bound device might satisfy deferred devices */
+		deferred_probe_invoke();
+	}
+
+	vmm_devdrv_dref_device(dev);
+	vmm_free(ap);
+}
+
+/* Note: Must be called with bus->lock held */
+static int async_probe_schedule(struct vmm_bus *bus,
+				struct vmm_device *dev,
+				struct vmm_driver *drv)
+{
+	int rc;
+	irq_flags_t flags;
+	struct vmm_workqueue *wq;
+	struct devdrv_async_probe *ap;
+
+	wq = async_probe_workqueue();
+	if (!wq) {
+		return VMM_ENOTAVAIL;
+	}
+
+	ap = vmm_zalloc(sizeof(*ap));
+	if (!ap) {
+		return VMM_ENOMEM;
+	}
+	INIT_WORK(&ap->work, async_probe_work_func);
+	ap->bus = bus;
+	ap->dev = dev;
+	ap->drv = drv;
+	vmm_devdrv_ref_device(dev);
+
+	vmm_spin_lock_irqsave(&ddctrl.async_probe_waitq.lock, flags);
+	dev->async_probe_pending = TRUE;
+	ddctrl.async_probe_count++;
+	vmm_spin_unlock_irqrestore(&ddctrl.async_probe_waitq.lock, flags);
+
+	rc = vmm_workqueue_schedule_work(wq, &ap->work);
+	if (rc) {
+		async_probe_done(dev);
+		vmm_devdrv_dref_device(dev);
+		vmm_free(ap);
+	}
+
+	return rc;
+}
+
+/* Note: Must be called without bus->lock held */
+static void async_probe_wait(struct vmm_device *dev)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&ddctrl.async_probe_waitq.lock, flags);
+
+	while (dev->async_probe_pending) {
+		if (__vmm_waitqueue_sleep(&ddctrl.async_probe_waitq, NULL)) {
+			break;
+		}
+	}
+
+	vmm_spin_unlock_irqrestore(&ddctrl.async_probe_waitq.lock, flags);
+}
+
+void vmm_devdrv_async_probe_sync(void)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&ddctrl.async_probe_waitq.lock, flags);
+
+	while (ddctrl.async_probe_count) {
+		if (__vmm_waitqueue_sleep(&ddctrl.async_probe_waitq, NULL)) {
+			break;
+		}
+	}
+
+	vmm_spin_unlock_irqrestore(&ddctrl.async_probe_waitq.lock, flags);
+}
+
+#else
+
+static inline void async_probe_wait(struct vmm_device *dev)
+{
+}
+
+void vmm_devdrv_async_probe_sync(void)
+{
+}
+
+#endif
+
 static int platform_bus_match(struct vmm_device *dev, struct vmm_driver *drv)
 {
 	const struct vmm_devtree_nodeid *match;
@@ -241,6 +458,15 @@ static int __bus_probe_device_driver(struct vmm_bus *bus,
 	 * probe without failure
 	 */
 	dev->driver = drv;
+#if defined(CONFIG_DEVDRV_ASYNC_PROBE)
+	/* Opted-in drivers are probed in background and if that
+	 * is not possible then we fallback to synchronous probe
+	 */
+	if (drv->async_probe &&
+	    (async_probe_schedule(bus, dev, drv) == VMM_OK)) {
+		return VMM_OK;
+	}
+#endif
 	if (bus->probe) {
 #if defined(CONFIG_VERBOSE_MODE)
 		vmm_printf("devdrv: bus=\"%s\" device=\"%s\" "
@@ -286,6 +512,14 @@ static void __bus_remove_device_driver(struct vmm_bus *bus,
 		return;
 	}
 
+	/* Device still being probed asynchronously is not bound yet */
+	if (dev->async_probe_pending) {
+		vmm_printf("devdrv: bus=\"%s\" device=\"%s\" "
+			   "remove while async probe pending\n",
+			   bus->name, dev->name);
+		return;
+	}
+
 	/* Notify bus event listeners */
 	vmm_blocking_notifier_call(&bus->event_listeners,
 				   VMM_BUS_NOTIFY_UNBIND_DRIVER, dev);
@@ -961,6 +1195,9 @@ int vmm_devdrv_unregister_bus(struct vmm_bus *bus)
 	bool found;
 	struct vmm_bus *b;
 
+	/* Wait for asynchronous probes */
+	vmm_devdrv_async_probe_sync();
+
 	vmm_mutex_lock(&ddctrl.bus_lock);
 
 	if (bus == NULL || list_empty(&ddctrl.bus_list)) {
@@ -1143,6 +1380,9 @@ static int devdrv_bus_unregister_device(struct vmm_bus *bus,
 		return VMM_EFAIL;
 	}
 
+	/* Wait for asynchronous probe of this device */
+	async_probe_wait(dev);
+
 	vmm_mutex_lock(&bus->lock);
 
 	if (list_empty(&bus->device_list)) {
@@ -1351,6 +1591,9 @@ int vmm_devdrv_bus_unregister_driver(struct vmm_bus *bus,
 		return VMM_EFAIL;
 	}
 
+	/* Wait for asynchronous probes */
+	vmm_devdrv_async_probe_sync();
+
 	vmm_mutex_lock(&bus->lock);
 
 	if (list_empty(&bus->driver_list)) {
@@ -1509,6 +1752,7 @@ void vmm_devdrv_initialize_device(struct vmm_device *dev)
 	INIT_SPIN_LOCK(&dev->devres_lock);
 	INIT_LIST_HEAD(&dev->devres_head);
 	INIT_LIST_HEAD(&dev->deferred_head);
+	dev->async_probe_pending = FALSE;
 }
 
 struct vmm_device *vmm_devdrv_ref_device(struct vmm_device *dev)
@@ -1623,6 +1867,9 @@ int vmm_devdrv_dettach_device(struct vmm_device *dev)
 	}
 	bus = dev->bus;
 
+	/* Wait for asynchronous probe of this device */
+	async_probe_wait(dev);
+
 	vmm_mutex_lock(&bus->lock);
 
 	/* Bus remove this device */
@@ -1685,6 +1932,9 @@ int vmm_devdrv_dettach_driver(struct vmm_driver *drv)
 	}
 	bus = drv->bus;
 
+	/* Wait for asynchronous probes */
+	vmm_devdrv_async_probe_sync();
+
 	vmm_mutex_lock(&bus->lock);
 
 	/* Bus remove this driver */
@@ -1717,6 +1967,11 @@ int __init vmm_devdrv_init(void)
 	INIT_LIST_HEAD(&ddctrl.deferred_probe_list);
 	INIT_WORK(&ddctrl.deferred_probe_work, deferred_probe_work_func);
 
+#if defined(CONFIG_DEVDRV_ASYNC_PROBE)
+	INIT_MUTEX(&ddctrl.async_probe_wq_lock);
+	INIT_WAITQUEUE(&ddctrl.async_probe_waitq, NULL);
+#endif
+
 	strcpy(ddctrl.platform_bus.name, "platform");
 	ddctrl.platform_bus.match = platform_bus_match;
 	ddctrl.platform_bus.probe = platform_bus_probe;
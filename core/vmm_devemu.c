@@ -25,28 +25,86 @@
 #include <vmm_stdio.h>
 #include <vmm_heap.h>
 #include <vmm_host_io.h>
+#include <vmm_host_aspace.h>
 #include <vmm_host_irq.h>
 #include <vmm_mutex.h>
+#include <vmm_workqueue.h>
 #include <vmm_guest_aspace.h>
 #include <vmm_devemu.h>
 #include <vmm_devemu_debug.h>
+#include <vmm_trace.h>
 #include <libs/stringlib.h>
 
+#define DEVEMU_COALESCE_MAX_RANGES	4
+#define DEVEMU_COALESCE_RING_SIZE	64
+#define DEVEMU_MATCH_CACHE_SIZE		64
+#define DEVEMU_DOORBELL_HASH_SIZE	16
+
+struct vmm_devemu_coalesce_entry {
+	physical_addr_t offset;
+	u64 data;
+	u32 len;
+	enum vmm_devemu_endianness endian;
+};
+
+struct vmm_devemu_coalesce {
+	vmm_spinlock_t lock;
+	struct vmm_emudev *edev;
+	struct vmm_work flush_work;
+	u32 range_count;
+	physical_addr_t range_start[DEVEMU_COALESCE_MAX_RANGES];
+	physical_addr_t range_end[DEVEMU_COALESCE_MAX_RANGES];
+	u32 head;
+	u32 count;
+	struct vmm_devemu_coalesce_entry ring[DEVEMU_COALESCE_RING_SIZE];
+};
+
 struct vmm_devemu_guest_irq {
 	struct dlist head;
 	struct vmm_devemu_irqchip *chip;
 	void *opaque;
 };
 
+struct vmm_devemu_doorbell {
+	struct dlist head;
+	physical_addr_t gphys_addr;
+	struct vmm_emudev *edev;
+	vmm_devemu_doorbell_t handler;
+};
+
 struct vmm_devemu_guest_context {
 	u32 g_irq_count;
 	struct dlist *g_irq;
+	vmm_rwlock_t db_lock;
+	struct dlist db_hash[DEVEMU_DOORBELL_HASH_SIZE];
+};
+
+/* Cached emulator match of device region attributes */
+struct vmm_devemu_match_entry {
+	struct dlist head;
+	u32 hash;
+	u32 key_len;
+	char *key;
+	struct vmm_emulator *emu;
+	const struct vmm_devtree_nodeid *match;
 };
 
+/*
+ * Device regions of guests are matched against emulators using their
+ * node name (only if some emulator matches by name), 'device_type' and
+ * 'compatible' attributes. The match cache remembers the first matching
+ * emulator for such attribute values so that creating the same guest
+ * again (or many guests with same devices) does not walk all match
+ * tables of all emulators. New emulators are added at the tail of
+ * emulator list hence cached matches only become stale when emulator
+ * is unregistered. The match cache is protected by emu_lock.
+ */
 struct vmm_devemu_ctrl {
 	enum vmm_devemu_endianness host_endian;
 	struct vmm_mutex emu_lock;
         struct dlist emu_list;
+	bool match_by_name;
+	struct dlist match_cache[DEVEMU_MATCH_CACHE_SIZE];
 };
 
 static struct vmm_devemu_ctrl dectrl;
@@ -110,154 +168,284 @@ static inline void debug_write(const struct vmm_emudev *edev,
 	}
 }
 
-static int devemu_doread(struct vmm_emudev *edev,
-			 physical_addr_t offset,
-			 void *dst, u32 dst_len,
-			 enum vmm_devemu_endianness dst_endian)
+#ifdef CONFIG_CPU_BE
+#define devemu_swab16(v)	vmm_cpu_to_le16(v)
+#define devemu_swab32(v)	vmm_cpu_to_le32(v)
+#define devemu_swab64(v)	vmm_cpu_to_le64(v)
+#else
+#define devemu_swab16(v)	vmm_cpu_to_be16(v)
+#define devemu_swab32(v)	vmm_cpu_to_be32(v)
+#define devemu_swab64(v)	vmm_cpu_to_be64(v)
+#endif
+#define devemu_noswab(v)	(v)
+
+/*
+ * Pre-resolved access handlers
+ *
+ * For each access size we have variants with and without byte swapping
+ * and with and without debug prints. The right variant for each access
+ * size and guest endianness is selected once when emulated device is
+ * probed so that trap path is just one indirect call.
+ */
+
+#define DEVEMU_DEFINE_READ(__name, __bits, __swab, __debug)		\
+static int __name(struct vmm_emudev *edev,				\
+		  physical_addr_t offset, void *dst)			\
+{									\
+	int rc;								\
+	u##__bits data = 0;						\
+									\
+	rc = edev->emu->read##__bits(edev, offset, &data);		\
+	if (__debug) {							\
+		debug_read(edev, offset, sizeof(data), data);		\
+	}								\
+	if (!rc) {							\
+		*(u##__bits *)dst = __swab(data);			\
+	}								\
+									\
+	return rc;							\
+}
+
+#define DEVEMU_DEFINE_WRITE(__name, __bits, __swab, __debug)		\
+static int __name(struct vmm_emudev *edev,				\
+		  physical_addr_t offset, void *src)			\
+{									\
+	int rc;								\
+	u##__bits data = __swab(*(u##__bits *)src);			\
+									\
+	rc = edev->emu->write##__bits(edev, offset, data);		\
+	if (__debug) {							\
+		debug_write(edev, offset, sizeof(data), data);		\
+	}								\
+									\
+	return rc;							\
+}
+
+#define DEVEMU_DEFINE_NOTAVAIL(__name, __op)				\
+static int __name(struct vmm_emudev *edev,				\
+		  physical_addr_t offset, void *buf)			\
+{									\
+	vmm_printf("%s: edev=%s does not have " __op "()\n",		\
+		   __func__, edev->node->name);				\
+	return VMM_ENOTAVAIL;						\
+}
+
+DEVEMU_DEFINE_READ(devemu_read8, 8, devemu_noswab, 0)
+DEVEMU_DEFINE_READ(devemu_read16, 16, devemu_noswab, 0)
+DEVEMU_DEFINE_READ(devemu_read32, 32, devemu_noswab, 0)
+DEVEMU_DEFINE_READ(devemu_read64, 64, devemu_noswab, 0)
+DEVEMU_DEFINE_READ(devemu_read16_swab, 16, devemu_swab16, 0)
+DEVEMU_DEFINE_READ(devemu_read32_swab, 32, devemu_swab32, 0)
+DEVEMU_DEFINE_READ(devemu_read64_swab, 64, devemu_swab64, 0)
+DEVEMU_DEFINE_READ(devemu_read8_debug, 8, devemu_noswab, 1)
+DEVEMU_DEFINE_READ(devemu_read16_debug, 16, devemu_noswab, 1)
+DEVEMU_DEFINE_READ(devemu_read32_debug, 32, devemu_noswab, 1)
+DEVEMU_DEFINE_READ(devemu_read64_debug, 64, devemu_noswab, 1)
+DEVEMU_DEFINE_READ(devemu_read16_swab_debug, 16, devemu_swab16, 1)
+DEVEMU_DEFINE_READ(devemu_read32_swab_debug, 32, devemu_swab32, 1)
+DEVEMU_DEFINE_READ(devemu_read64_swab_debug, 64, devemu_swab64, 1)
+
+DEVEMU_DEFINE_WRITE(devemu_write8, 8, devemu_noswab, 0)
+DEVEMU_DEFINE_WRITE(devemu_write16, 16, devemu_noswab, 0)
+DEVEMU_DEFINE_WRITE(devemu_write32, 32, devemu_noswab, 0)
+DEVEMU_DEFINE_WRITE(devemu_write64, 64, devemu_noswab, 0)
+DEVEMU_DEFINE_WRITE(devemu_write16_swab, 16, devemu_swab16, 0)
+DEVEMU_DEFINE_WRITE(devemu_write32_swab, 32, devemu_swab32, 0)
+DEVEMU_DEFINE_WRITE(devemu_write64_swab, 64, devemu_swab64, 0)
+DEVEMU_DEFINE_WRITE(devemu_write8_debug, 8, devemu_noswab, 1)
+DEVEMU_DEFINE_WRITE(devemu_write16_debug, 16, devemu_noswab, 1)
+DEVEMU_DEFINE_WRITE(devemu_write32_debug, 32, devemu_noswab, 1)
+DEVEMU_DEFINE_WRITE(devemu_write64_debug, 64, devemu_noswab, 1)
+DEVEMU_DEFINE_WRITE(devemu_write16_swab_debug, 16, devemu_swab16, 1)
+DEVEMU_DEFINE_WRITE(devemu_write32_swab_debug, 32, devemu_swab32, 1)
+DEVEMU_DEFINE_WRITE(devemu_write64_swab_debug, 64, devemu_swab64, 1)
+
+DEVEMU_DEFINE_NOTAVAIL(devemu_read8_notavail, "read8")
+DEVEMU_DEFINE_NOTAVAIL(devemu_read16_notavail, "read16")
+DEVEMU_DEFINE_NOTAVAIL(devemu_read32_notavail, "read32")
+DEVEMU_DEFINE_NOTAVAIL(devemu_read64_notavail, "read64")
+DEVEMU_DEFINE_NOTAVAIL(devemu_write8_notavail, "write8")
+DEVEMU_DEFINE_NOTAVAIL(devemu_write16_notavail, "write16")
+DEVEMU_DEFINE_NOTAVAIL(devemu_write32_notavail, "write32")
+DEVEMU_DEFINE_NOTAVAIL(devemu_write64_notavail, "write64")
+
+/* Indexed by [debug][swab][access index] */
+static const vmm_devemu_read_t devemu_read_handlers[2][2][VMM_DEVEMU_MAX_ACCESS] = {
+	{ { devemu_read8, devemu_read16,
+	    devemu_read32, devemu_read64 },
+	  { devemu_read8, devemu_read16_swab,
+	    devemu_read32_swab, devemu_read64_swab } },
+	{ { devemu_read8_debug, devemu_read16_debug,
+	    devemu_read32_debug, devemu_read64_debug },
+	  { devemu_read8_debug, devemu_read16_swab_debug,
+	    devemu_read32_swab_debug, devemu_read64_swab_debug } },
+};
+
+static const vmm_devemu_write_t devemu_write_handlers[2][2][VMM_DEVEMU_MAX_ACCESS] = {
+	{ { devemu_write8, devemu_write16,
+	    devemu_write32, devemu_write64 },
+	  { devemu_write8, devemu_write16_swab,
+	    devemu_write32_swab, devemu_write64_swab } },
+	{ { devemu_write8_debug, devemu_write16_debug,
+	    devemu_write32_debug, devemu_write64_debug },
+	  { devemu_write8_debug, devemu_write16_swab_debug,
+	    devemu_write32_swab_debug, devemu_write64_swab_debug } },
+};
+
+static const vmm_devemu_read_t devemu_read_notavail[VMM_DEVEMU_MAX_ACCESS] = {
+	devemu_read8_notavail, devemu_read16_notavail,
+	devemu_read32_notavail, devemu_read64_notavail,
+};
+
+static const vmm_devemu_write_t devemu_write_notavail[VMM_DEVEMU_MAX_ACCESS] = {
+	devemu_write8_notavail, devemu_write16_notavail,
+	devemu_write32_notavail, devemu_write64_notavail,
+};
+
+/* Access length to access index (-1 for invalid length) */
+static const int devemu_len2idx[] = { -1, 0, 1, -1, 2, -1, -1, -1, 3 };
+
+static inline int devemu_access_index(u32 len)
 {
-	int rc;
-	u16 data16;
-	u32 data32;
-	u64 data64;
-	enum vmm_devemu_endianness data_endian;
+	return (len < array_size(devemu_len2idx)) ? devemu_len2idx[len] : -1;
+}
 
-	if (!edev ||
-	    (dst_endian <= VMM_DEVEMU_UNKNOWN_ENDIAN) ||
-	    (VMM_DEVEMU_MAX_ENDIAN <= dst_endian)) {
-		return VMM_EFAIL;
+/* Check whether cpu_to_xx() conversion for given endianness swaps bytes */
+static bool devemu_cpu_swab(enum vmm_devemu_endianness endian)
+{
+	if ((endian != VMM_DEVEMU_LITTLE_ENDIAN) &&
+	    (endian != VMM_DEVEMU_BIG_ENDIAN)) {
+		return FALSE;
 	}
 
-	switch (dst_len) {
-	case 1:
-		if (edev->emu->read8) {
-			rc = edev->emu->read8(edev, offset, dst);
-			debug_read(edev, offset, sizeof(u8), *((u8 *)dst));
-		} else {
-			vmm_printf("%s: edev=%s does not have read8()\n",
-				   __func__, edev->node->name);
-			rc = VMM_ENOTAVAIL;
-		}
+	return (endian != dectrl.host_endian) ? TRUE : FALSE;
+}
+
+static void devemu_setup_handlers(struct vmm_emudev *edev)
+{
+	int i, e;
+	bool has, rswab, wswab;
+	bool rdebug = vmm_devemu_debug_read(edev) ? TRUE : FALSE;
+	bool wdebug = vmm_devemu_debug_write(edev) ? TRUE : FALSE;
+	enum vmm_devemu_endianness data_endian;
+	struct vmm_emulator *emu = edev->emu;
+
+	switch (emu->endian) {
+	case VMM_DEVEMU_LITTLE_ENDIAN:
+	case VMM_DEVEMU_BIG_ENDIAN:
+		data_endian = emu->endian;
 		break;
-	case 2:
-		if (edev->emu->read16) {
-			rc = edev->emu->read16(edev, offset, &data16);
-			debug_read(edev, offset, sizeof(u16), data16);
-		} else {
-			vmm_printf("%s: edev=%s does not have read16()\n",
-				   __func__, edev->node->name);
-			rc = VMM_ENOTAVAIL;
-		}
-		if (!rc) {
-			switch (edev->emu->endian) {
-			case VMM_DEVEMU_LITTLE_ENDIAN:
-				data16 = vmm_cpu_to_le16(data16);
-				data_endian = VMM_DEVEMU_LITTLE_ENDIAN;
-				break;
-			case VMM_DEVEMU_BIG_ENDIAN:
-				data16 = vmm_cpu_to_be16(data16);
-				data_endian = VMM_DEVEMU_BIG_ENDIAN;
-				break;
-			default:
-				data_endian = VMM_DEVEMU_NATIVE_ENDIAN;
-				break;
-			};
-			if (data_endian != dst_endian) {
-				switch (dst_endian) {
-				case VMM_DEVEMU_LITTLE_ENDIAN:
-					data16 = vmm_cpu_to_le16(data16);
-					break;
-				case VMM_DEVEMU_BIG_ENDIAN:
-					data16 = vmm_cpu_to_be16(data16);
-					break;
-				default:
-					break;
-				};
-			}
-			*(u16 *)dst = data16;
-		}
+	default:
+		data_endian = VMM_DEVEMU_NATIVE_ENDIAN;
 		break;
-	case 4:
-		if (edev->emu->read32) {
-			rc = edev->emu->read32(edev, offset, &data32);
-			debug_read(edev, offset, sizeof(u32), data32);
-		} else {
-			vmm_printf("%s: edev=%s does not have read32()\n",
-				   __func__, edev->node->name);
-			rc = VMM_ENOTAVAIL;
+	};
+
+	for (e = VMM_DEVEMU_NATIVE_ENDIAN; e < VMM_DEVEMU_MAX_ENDIAN; e++) {
+		/* Emulator data is converted to emulator endianness
+		 * and then to guest endianness if both differ.
+		 */
+		rswab = devemu_cpu_swab(emu->endian);
+		if (data_endian != e) {
+			rswab = (rswab != devemu_cpu_swab(e)) ? TRUE : FALSE;
 		}
-		if (!rc) {
-			switch (edev->emu->endian) {
-			case VMM_DEVEMU_LITTLE_ENDIAN:
-				data32 = vmm_cpu_to_le32(data32);
-				data_endian = VMM_DEVEMU_LITTLE_ENDIAN;
+		wswab = (devemu_cpu_swab(e) != devemu_cpu_swab(emu->endian)) ?
+								TRUE : FALSE;
+
+		for (i = 0; i < VMM_DEVEMU_MAX_ACCESS; i++) {
+			switch (i) {
+			case 0:
+				has = (emu->read8) ? TRUE : FALSE;
 				break;
-			case VMM_DEVEMU_BIG_ENDIAN:
-				data32 = vmm_cpu_to_be32(data32);
-				data_endian = VMM_DEVEMU_BIG_ENDIAN;
+			case 1:
+				has = (emu->read16) ? TRUE : FALSE;
+				break;
+			case 2:
+				has = (emu->read32) ? TRUE : FALSE;
 				break;
 			default:
-				data_endian = VMM_DEVEMU_NATIVE_ENDIAN;
+				has = (emu->read64) ? TRUE : FALSE;
 				break;
 			};
-			if (data_endian != dst_endian) {
-				switch (dst_endian) {
-				case VMM_DEVEMU_LITTLE_ENDIAN:
-					data32 = vmm_cpu_to_le32(data32);
-					break;
-				case VMM_DEVEMU_BIG_ENDIAN:
-					data32 = vmm_cpu_to_be32(data32);
-					break;
-				default:
-					break;
-				};
-			}
-			*(u32 *)dst = data32;
-		}
-		break;
-	case 8:
-		if (edev->emu->read64) {
-			rc = edev->emu->read64(edev, offset, &data64);
-			debug_read(edev, offset, sizeof(u64), data64);
-		} else {
-			vmm_printf("%s: edev=%s does not have read64()\n",
-				   __func__, edev->node->name);
-			rc = VMM_ENOTAVAIL;
-		}
-		if (!rc) {
-			switch (edev->emu->endian) {
-			case VMM_DEVEMU_LITTLE_ENDIAN:
-				data64 = vmm_cpu_to_le64(data64);
-				data_endian = VMM_DEVEMU_LITTLE_ENDIAN;
+			edev->read[i][e] = (has) ?
+				devemu_read_handlers[rdebug][rswab][i] :
+				devemu_read_notavail[i];
+
+			switch (i) {
+			case 0:
+				has = (emu->write8) ? TRUE : FALSE;
+				break;
+			case 1:
+				has = (emu->write16) ? TRUE : FALSE;
 				break;
-			case VMM_DEVEMU_BIG_ENDIAN:
-				data64 = vmm_cpu_to_be64(data64);
-				data_endian = VMM_DEVEMU_BIG_ENDIAN;
+			case 2:
+				has = (emu->write32) ? TRUE : FALSE;
 				break;
 			default:
-				data_endian = VMM_DEVEMU_NATIVE_ENDIAN;
+				has = (emu->write64) ? TRUE : FALSE;
 				break;
 			};
-			if (data_endian != dst_endian) {
-				switch (dst_endian) {
-				case VMM_DEVEMU_LITTLE_ENDIAN:
-					data64 = vmm_cpu_to_le64(data64);
-					break;
-				case VMM_DEVEMU_BIG_ENDIAN:
-					data64 = vmm_cpu_to_be32(data64);
-					break;
-				default:
-					break;
-				};
-			}
-			*(u64 *)dst = data64;
+			edev->write[i][e] = (has) ?
+				devemu_write_handlers[wdebug][wswab][i] :
+				devemu_write_notavail[i];
 		}
-		break;
-	default:
+	}
+}
+
+int vmm_devemu_set_read_handler(struct vmm_emudev *edev, u32 len,
+				enum vmm_devemu_endianness endian,
+				vmm_devemu_read_t handler)
+{
+	int i = devemu_access_index(len);
+
+	if (!edev || !handler || (i < 0) ||
+	    (endian <= VMM_DEVEMU_UNKNOWN_ENDIAN) ||
+	    (VMM_DEVEMU_MAX_ENDIAN <= endian)) {
+		return VMM_EINVALID;
+	}
+
+	edev->read[i][endian] = handler;
+
+	return VMM_OK;
+}
+
+int vmm_devemu_set_write_handler(struct vmm_emudev *edev, u32 len,
+				 enum vmm_devemu_endianness endian,
+				 vmm_devemu_write_t handler)
+{
+	int i = devemu_access_index(len);
+
+	if (!edev || !handler || (i < 0) ||
+	    (endian <= VMM_DEVEMU_UNKNOWN_ENDIAN) ||
+	    (VMM_DEVEMU_MAX_ENDIAN <= endian)) {
+		return VMM_EINVALID;
+	}
+
+	edev->write[i][endian] = handler;
+
+	return VMM_OK;
+}
+
+static int devemu_doread(struct vmm_emudev *edev,
+			 physical_addr_t offset,
+			 void *dst, u32 dst_len,
+			 enum vmm_devemu_endianness dst_endian)
+{
+	int rc, i;
+
+	if (!edev ||
+	    (dst_endian <= VMM_DEVEMU_UNKNOWN_ENDIAN) ||
+	    (VMM_DEVEMU_MAX_ENDIAN <= dst_endian)) {
+		return VMM_EFAIL;
+	}
+
+	i = devemu_access_index(dst_len);
+	if (i < 0) {
 		vmm_printf("%s: edev=%s invalid len=%d\n",
 			   __func__, edev->node->name, dst_len);
 		rc = VMM_EINVALID;
-		break;
-	};
+	} else {
+		rc = edev->read[i][dst_endian](edev, offset, dst);
+	}
 
 	if (rc) {
 		vmm_printf("%s: edev=%s offset=0x%"PRIPADDR" dst_len=%d "
@@ -273,10 +461,7 @@ static int devemu_dowrite(struct vmm_emudev *edev,
 			  void *src, u32 src_len,
 			  enum vmm_devemu_endianness src_endian)
 {
-	int rc;
-	u16 data16;
-	u32 data32;
-	u64 data64;
+	int rc, i;
 
 	if (!edev ||
 	    (src_endian <= VMM_DEVEMU_UNKNOWN_ENDIAN) ||
@@ -284,116 +469,14 @@ static int devemu_dowrite(struct vmm_emudev *edev,
 		return VMM_EFAIL;
 	}
 
-	switch (src_len) {
-	case 1:		
-		if (edev->emu->write8) {
-			rc = edev->emu->write8(edev, offset, *((u8 *)src));
-			debug_write(edev, offset, sizeof(u8), *((u8 *)src));
-		} else {
-			vmm_printf("%s: edev=%s does not have write8()\n",
-				   __func__, edev->node->name);
-			rc = VMM_ENOTAVAIL;
-		}
-		break;
-	case 2:
-		data16 = *(u16 *)src;
-		switch (src_endian) {
-		case VMM_DEVEMU_LITTLE_ENDIAN:
-			data16 = vmm_le16_to_cpu(data16);
-			break;
-		case VMM_DEVEMU_BIG_ENDIAN:
-			data16 = vmm_be16_to_cpu(data16);
-			break;
-		default:
-			break;
-		};
-		switch (edev->emu->endian) {
-		case VMM_DEVEMU_LITTLE_ENDIAN:
-			data16 = vmm_cpu_to_le16(data16);
-			break;
-		case VMM_DEVEMU_BIG_ENDIAN:
-			data16 = vmm_cpu_to_be16(data16);
-			break;
-		default:
-			break;
-		};
-		if (edev->emu->write16) {
-			rc = edev->emu->write16(edev, offset, data16);
-			debug_write(edev, offset, sizeof(u16), data16);
-		} else {
-			vmm_printf("%s: edev=%s does not have write16()\n",
-				   __func__, edev->node->name);
-			rc = VMM_ENOTAVAIL;
-		}
-		break;
-	case 4:
-		data32 = *(u32 *)src;
-		switch (src_endian) {
-		case VMM_DEVEMU_LITTLE_ENDIAN:
-			data32 = vmm_le32_to_cpu(data32);
-			break;
-		case VMM_DEVEMU_BIG_ENDIAN:
-			data32 = vmm_be32_to_cpu(data32);
-			break;
-		default:
-			break;
-		};
-		switch (edev->emu->endian) {
-		case VMM_DEVEMU_LITTLE_ENDIAN:
-			data32 = vmm_cpu_to_le32(data32);
-			break;
-		case VMM_DEVEMU_BIG_ENDIAN:
-			data32 = vmm_cpu_to_be32(data32);
-			break;
-		default:
-			break;
-		};
-		if (edev->emu->write32) {
-			rc = edev->emu->write32(edev, offset, data32);
-			debug_write(edev, offset, sizeof(u32), data32);
-		} else {
-			vmm_printf("%s: edev=%s does not have write32()\n",
-				   __func__, edev->node->name);
-			rc = VMM_ENOTAVAIL;
-		}
-		break;
-	case 8:
-		data64 = *(u64 *)src;
-		switch (src_endian) {
-		case VMM_DEVEMU_LITTLE_ENDIAN:
-			data64 = vmm_le64_to_cpu(data64);
-			break;
-		case VMM_DEVEMU_BIG_ENDIAN:
-			data64 = vmm_be64_to_cpu(data64);
-			break;
-		default:
-			break;
-		};
-		switch (edev->emu->endian) {
-		case VMM_DEVEMU_LITTLE_ENDIAN:
-			data64 = vmm_cpu_to_le64(data64);
-			break;
-		case VMM_DEVEMU_BIG_ENDIAN:
-			data64 = vmm_cpu_to_be64(data64);
-			break;
-		default:
-			break;
-		};
-		if (edev->emu->write64) {
-			rc = edev->emu->write64(edev, offset, data64);
-			debug_write(edev, offset, sizeof(u64), data64);
-		} else {
-			vmm_printf("%s: edev=%s does not have write64()\n",
-				   __func__, edev->node->name);
-			rc = VMM_ENOTAVAIL;
-		}
-		break;
-	default:
+	i = devemu_access_index(src_len);
+	if (i < 0) {
 		vmm_printf("%s: edev=%s invalid len=%d\n",
 			   __func__, edev->node->name, src_len);
 		rc = VMM_EINVALID;
-		break;
-	};
+	} else {
+		rc = edev->write[i][src_endian](edev, offset, src);
+	}
 
 	if (rc) {
 		vmm_printf("%s: edev=%s offset=0x%"PRIPADDR" src_len=%d "
@@ -404,6 +487,303 @@ static int devemu_dowrite(struct vmm_emudev *edev,
 	return rc;
 }
 
+/* Replay all buffered writes (must be called with coalesce lock held) */
+static void devemu_coalesce_drain(struct vmm_devemu_coalesce *c)
+{
+	struct vmm_devemu_coalesce_entry *e;
+
+	while (c->count) {
+		e = &c->ring[c->head];
+		devemu_dowrite(c->edev, e->offset, &e->data, e->len, e->endian);
+		c->head = (c->head + 1) % DEVEMU_COALESCE_RING_SIZE;
+		c->count--;
+	}
+}
+
+static void devemu_coalesce_flush(struct vmm_devemu_coalesce *c)
+{
+	if (!c || !c->count) {
+		return;
+	}
+
+	vmm_spin_lock(&c->lock);
+	devemu_coalesce_drain(c);
+	vmm_spin_unlock(&c->lock);
+}
+
+static void devemu_coalesce_flush_work(struct vmm_work *work)
+{
+	devemu_coalesce_flush(container_of(work,
+				struct vmm_devemu_coalesce, flush_work));
+}
+
+static bool devemu_coalesce_match(struct vmm_devemu_coalesce *c,
+				  physical_addr_t offset, u32 len)
+{
+	u32 i;
+
+	for (i = 0; i < c->range_count; i++) {
+		if ((c->range_start[i] <= offset) &&
+		    ((offset + len) <= c->range_end[i])) {
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+static int devemu_read(struct vmm_emudev *edev,
+		       physical_addr_t offset,
+		       void *dst, u32 dst_len,
+		       enum vmm_devemu_endianness dst_endian)
+{
+	if (edev) {
+		devemu_coalesce_flush(edev->coalesce);
+	}
+
+	return devemu_doread(edev, offset, dst, dst_len, dst_endian);
+}
+
+static int devemu_write(struct vmm_emudev *edev,
+			physical_addr_t offset,
+			void *src, u32 src_len,
+			enum vmm_devemu_endianness src_endian)
+{
+	bool kick;
+	struct vmm_devemu_coalesce_entry *e;
+	struct vmm_devemu_coalesce *c = (edev) ? edev->coalesce : NULL;
+
+	if (!c) {
+		return devemu_dowrite(edev, offset, src, src_len, src_endian);
+	}
+
+	if ((src_len > sizeof(e->data)) ||
+	    (src_endian <= VMM_DEVEMU_UNKNOWN_ENDIAN) ||
+	    (VMM_DEVEMU_MAX_ENDIAN <= src_endian) ||
+	    !devemu_coalesce_match(c, offset, src_len)) {
+		devemu_coalesce_flush(c);
+		return devemu_dowrite(edev, offset, src, src_len, src_endian);
+	}
+
+	vmm_spin_lock(&c->lock);
+
+	/* Replay in-place when ring is full */
+	if (c->count == DEVEMU_COALESCE_RING_SIZE) {
+		devemu_coalesce_drain(c);
+	}
+
+	e = &c->ring[(c->head + c->count) % DEVEMU_COALESCE_RING_SIZE];
+	e->offset = offset;
+	e->data = 0;
+	memcpy(&e->data, src, src_len);
+	e->len = src_len;
+	e->endian = src_endian;
+	c->count++;
+	kick = (c->count == 1) ? TRUE : FALSE;
+
+	vmm_spin_unlock(&c->lock);
+
+	if (kick) {
+		vmm_workqueue_schedule_work(NULL, &c->flush_work);
+	}
+
+	return VMM_OK;
+}
+
+int vmm_devemu_add_coalesce_range(struct vmm_emudev *edev,
+				  physical_addr_t offset,
+				  physical_size_t size)
+{
+	struct vmm_devemu_coalesce *c;
+
+	if (!edev || !edev->reg || !size ||
+	    (edev->reg->phys_size < offset) ||
+	    ((edev->reg->phys_size - offset) < size)) {
+		return VMM_EINVALID;
+	}
+
+	if (!edev->coalesce) {
+		c = vmm_zalloc(sizeof(struct vmm_devemu_coalesce));
+		if (!c) {
+			return VMM_ENOMEM;
+		}
+		INIT_SPIN_LOCK(&c->lock);
+		c->edev = edev;
+		INIT_WORK(&c->flush_work, devemu_coalesce_flush_work);
+		edev->coalesce = c;
+	}
+	c = edev->coalesce;
+
+	if (c->range_count == DEVEMU_COALESCE_MAX_RANGES) {
+		return VMM_ENOSPC;
+	}
+
+	vmm_spin_lock(&c->lock);
+	c->range_start[c->range_count] = offset;
+	c->range_end[c->range_count] = offset + size;
+	c->range_count++;
+	vmm_spin_unlock(&c->lock);
+
+	return VMM_OK;
+}
+
+int vmm_devemu_add_fifo_range(struct vmm_emudev *edev,
+			      physical_addr_t offset,
+			      physical_size_t size)
+{
+	if (!edev || !edev->reg || !size ||
+	    (edev->reg->phys_size < offset) ||
+	    ((edev->reg->phys_size - offset) < size)) {
+		return VMM_EINVALID;
+	}
+
+	if (edev->fifo_count == VMM_DEVEMU_MAX_FIFO_RANGES) {
+		return VMM_ENOSPC;
+	}
+
+	edev->fifo_start[edev->fifo_count] = offset;
+	edev->fifo_end[edev->fifo_count] = offset + size;
+	edev->fifo_count++;
+
+	return VMM_OK;
+}
+
+int vmm_devemu_flush_coalesced(struct vmm_emudev *edev)
+{
+	if (!edev) {
+		return VMM_EFAIL;
+	}
+
+	devemu_coalesce_flush(edev->coalesce);
+
+	return VMM_OK;
+}
+
+static void devemu_coalesce_free(struct vmm_emudev *edev)
+{
+	struct vmm_devemu_coalesce *c = edev->coalesce;
+
+	if (!c) {
+		return;
+	}
+
+	vmm_workqueue_stop_work(&c->flush_work);
+	edev->coalesce = NULL;
+	vmm_free(c);
+}
+
+static inline u32 devemu_doorbell_hash(physical_addr_t gphys_addr)
+{
+	return (u32)(gphys_addr >> VMM_PAGE_SHIFT) %
+					DEVEMU_DOORBELL_HASH_SIZE;
+}
+
+static struct vmm_devemu_doorbell *devemu_doorbell_find(
+				struct vmm_devemu_guest_context *eg,
+				physical_addr_t gphys_addr)
+{
+	struct vmm_devemu_doorbell *db;
+
+	list_for_each_entry(db,
+		&eg->db_hash[devemu_doorbell_hash(gphys_addr)], head) {
+		if (db->gphys_addr == gphys_addr) {
+			return db;
+		}
+	}
+
+	return NULL;
+}
+
+int vmm_devemu_set_doorbell(struct vmm_emudev *edev,
+			    vmm_devemu_doorbell_t handler)
+{
+	irq_flags_t flags;
+	struct vmm_devemu_doorbell *db;
+	struct vmm_devemu_guest_context *eg;
+
+	if (!edev || !edev->reg || !handler) {
+		return VMM_EINVALID;
+	}
+	eg = edev->reg->aspace->devemu_priv;
+
+	db = vmm_zalloc(sizeof(*db));
+	if (!db) {
+		return VMM_ENOMEM;
+	}
+	INIT_LIST_HEAD(&db->head);
+	db->gphys_addr = edev->reg->gphys_addr;
+	db->edev = edev;
+	db->handler = handler;
+
+	vmm_write_lock_irqsave_lite(&eg->db_lock, flags);
+	if (devemu_doorbell_find(eg, db->gphys_addr)) {
+		vmm_write_unlock_irqrestore_lite(&eg->db_lock, flags);
+		vmm_free(db);
+		return VMM_EEXIST;
+	}
+	list_add_tail(&db->head,
+		      &eg->db_hash[devemu_doorbell_hash(db->gphys_addr)]);
+	vmm_write_unlock_irqrestore_lite(&eg->db_lock, flags);
+
+	return VMM_OK;
+}
+
+static void devemu_doorbell_del(struct vmm_emudev *edev)
+{
+	irq_flags_t flags;
+	struct vmm_devemu_doorbell *db;
+	struct vmm_devemu_guest_context *eg = edev->reg->aspace->devemu_priv;
+
+	if (!eg) {
+		return;
+	}
+
+	vmm_write_lock_irqsave_lite(&eg->db_lock, flags);
+	db = devemu_doorbell_find(eg, edev->reg->gphys_addr);
+	if (db && (db->edev == edev)) {
+		list_del(&db->head);
+	} else {
+		db = NULL;
+	}
+	vmm_write_unlock_irqrestore_lite(&eg->db_lock, flags);
+
+	if (db) {
+		vmm_free(db);
+	}
+}
+
+int vmm_devemu_ring_doorbell(struct vmm_guest *guest,
+			     physical_addr_t gphys_addr, u32 val)
+{
+	irq_flags_t flags;
+	struct vmm_emudev *edev = NULL;
+	vmm_devemu_doorbell_t handler = NULL;
+	struct vmm_devemu_doorbell *db;
+	struct vmm_devemu_guest_context *eg;
+
+	if (!guest) {
+		return VMM_EFAIL;
+	}
+	eg = guest->aspace.devemu_priv;
+
+	vmm_read_lock_irqsave_lite(&eg->db_lock, flags);
+	db = devemu_doorbell_find(eg, gphys_addr);
+	if (db) {
+		edev = db->edev;
+		handler = db->handler;
+	}
+	vmm_read_unlock_irqrestore_lite(&eg->db_lock, flags);
+
+	if (!handler) {
+		return VMM_ENOTAVAIL;
+	}
+
+	/* Doorbell must not overtake buffered MMIO writes */
+	devemu_coalesce_flush(edev->coalesce);
+
+	return handler(edev, val);
+}
+
 int vmm_devemu_emulate_read(struct vmm_vcpu *vcpu,
 			    physical_addr_t gphys_addr,
 			    void *dst, u32 dst_len,
@@ -416,6 +796,8 @@ int vmm_devemu_emulate_read(struct vmm_vcpu *vcpu,
 		return VMM_EFAIL;
 	}
 
+	vmm_manager_guest_boot_mark(vcpu->guest, VMM_GUEST_BOOT_FIRST_MMIO);
+
 	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
 			VMM_REGION_VIRTUAL | VMM_REGION_MEMORY, FALSE);
 	if (!reg) {
@@ -423,10 +805,11 @@ int vmm_devemu_emulate_read(struct vmm_vcpu *vcpu,
 		goto skip;
 	}
 
-	rc = devemu_doread(reg->devemu_priv,
-			   gphys_addr - reg->gphys_addr,
-			   dst, dst_len, dst_endian);
+	rc = devemu_read(reg->devemu_priv,
+			 gphys_addr - reg->gphys_addr,
+			 dst, dst_len, dst_endian);
 skip:
+	vmm_trace(DEVEMU_READ, gphys_addr, dst_len, rc, 0);
 	if (rc) {
 		vmm_printf("%s: vcpu=%s gphys=0x%"PRIPADDR" dst_len=%d "
 			   "failed (error %d)\n", __func__,
@@ -449,6 +832,8 @@ int vmm_devemu_emulate_write(struct vmm_vcpu *vcpu,
 		return VMM_EFAIL;
 	}
 
+	vmm_manager_guest_boot_mark(vcpu->guest, VMM_GUEST_BOOT_FIRST_MMIO);
+
 	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
 			VMM_REGION_VIRTUAL | VMM_REGION_MEMORY, FALSE);
 	if (!reg) {
@@ -456,10 +841,11 @@ int vmm_devemu_emulate_write(struct vmm_vcpu *vcpu,
 		goto skip;
 	}
 
-	rc = devemu_dowrite(reg->devemu_priv,
-			    gphys_addr - reg->gphys_addr,
-			    src, src_len, src_endian);
+	rc = devemu_write(reg->devemu_priv,
+			  gphys_addr - reg->gphys_addr,
+			  src, src_len, src_endian);
 skip:
+	vmm_trace(DEVEMU_WRITE, gphys_addr, src_len, rc, 0);
 	if (rc) {
 		vmm_printf("%s: vcpu=%s gphys=0x%"PRIPADDR" src_len=%d "
 			   "failed (error %d)\n", __func__,
@@ -470,29 +856,134 @@ skip:
 	return rc;
 }
 
-int vmm_devemu_emulate_ioread(struct vmm_vcpu *vcpu,
-			      physical_addr_t gphys_addr,
-			      void *dst, u32 dst_len,
-			      enum vmm_devemu_endianness dst_endian)
+static struct vmm_emudev *devemu_find_fifo(struct vmm_vcpu *vcpu,
+					    physical_addr_t gphys_addr,
+					    u32 len,
+					    physical_addr_t *offset)
 {
-	int rc;
+	u32 i;
 	struct vmm_region *reg;
+	struct vmm_emudev *edev;
 
 	if (!vcpu || !vcpu->guest) {
-		return VMM_EFAIL;
+		return NULL;
 	}
 
 	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
-			VMM_REGION_VIRTUAL | VMM_REGION_IO, FALSE);
+			VMM_REGION_VIRTUAL | VMM_REGION_MEMORY, FALSE);
+	if (!reg || !reg->devemu_priv) {
+		return NULL;
+	}
+	edev = reg->devemu_priv;
+
+	*offset = gphys_addr - reg->gphys_addr;
+	for (i = 0; i < edev->fifo_count; i++) {
+		if ((edev->fifo_start[i] <= *offset) &&
+		    ((*offset + len) <= edev->fifo_end[i])) {
+			return edev;
+		}
+	}
+
+	return NULL;
+}
+
+bool vmm_devemu_is_fifo(struct vmm_vcpu *vcpu,
+			physical_addr_t gphys_addr, u32 len)
+{
+	physical_addr_t offset;
+
+	return (devemu_find_fifo(vcpu, gphys_addr, len, &offset)) ?
+								TRUE : FALSE;
+}
+
+int vmm_devemu_emulate_fifo_read(struct vmm_vcpu *vcpu,
+				 physical_addr_t gphys_addr,
+				 u32 *dst, u32 count,
+				 enum vmm_devemu_endianness dst_endian)
+{
+	int rc = VMM_OK;
+	u32 i;
+	physical_addr_t offset;
+	struct vmm_emudev *edev;
+
+	edev = devemu_find_fifo(vcpu, gphys_addr, sizeof(*dst), &offset);
+	if (!edev || !dst) {
+		return VMM_EINVALID;
+	}
+
+	for (i = 0; i < count; i++) {
+		rc = devemu_read(edev, offset, &dst[i],
+				 sizeof(*dst), dst_endian);
+		vmm_trace(DEVEMU_READ, gphys_addr, sizeof(*dst), rc, 0);
+		if (rc) {
+			break;
+		}
+	}
+	if (rc) {
+		vmm_printf("%s: vcpu=%s gphys=0x%"PRIPADDR" count=%d "
+			   "failed (error %d)\n", __func__,
+			   vcpu->name, gphys_addr, count, rc);
+		vmm_manager_vcpu_halt(vcpu);
+	}
+
+	return rc;
+}
+
+int vmm_devemu_emulate_fifo_write(struct vmm_vcpu *vcpu,
+				  physical_addr_t gphys_addr,
+				  u32 *src, u32 count,
+				  enum vmm_devemu_endianness src_endian)
+{
+	int rc = VMM_OK;
+	u32 i;
+	physical_addr_t offset;
+	struct vmm_emudev *edev;
+
+	edev = devemu_find_fifo(vcpu, gphys_addr, sizeof(*src), &offset);
+	if (!edev || !src) {
+		return VMM_EINVALID;
+	}
+
+	for (i = 0; i < count; i++) {
+		rc = devemu_write(edev, offset, &src[i],
+				  sizeof(*src), src_endian);
+		vmm_trace(DEVEMU_WRITE, gphys_addr, sizeof(*src), rc, 0);
+		if (rc) {
+			break;
+		}
+	}
+	if (rc) {
+		vmm_printf("%s: vcpu=%s gphys=0x%"PRIPADDR" count=%d "
+			   "failed (error %d)\n", __func__,
+			   vcpu->name, gphys_addr, count, rc);
+		vmm_manager_vcpu_halt(vcpu);
+	}
+
+	return rc;
+}
+
+int vmm_devemu_emulate_region_ioread(struct vmm_vcpu *vcpu,
+				     struct vmm_region *reg,
+				     physical_addr_t gphys_addr,
+				     void *dst, u32 dst_len,
+				     enum vmm_devemu_endianness dst_endian)
+{
+	int rc;
+
+	if (!vcpu || !vcpu->guest) {
+		return VMM_EFAIL;
+	}
+
 	if (!reg) {
 		rc = VMM_ENOTAVAIL;
 		goto skip;
 	}
 
-	rc = devemu_doread(reg->devemu_priv,
-			   gphys_addr - reg->gphys_addr,
-			   dst, dst_len, dst_endian);
+	rc = devemu_read(reg->devemu_priv,
+			 gphys_addr - reg->gphys_addr,
+			 dst, dst_len, dst_endian);
 skip:
+	vmm_trace(DEVEMU_READ, gphys_addr, dst_len, rc, 0);
 	if (rc) {
 		vmm_printf("%s: vcpu=%s gphys=0x%"PRIPADDR" dst_len=%d "
 			   "failed (error %d)\n", __func__,
@@ -503,29 +994,28 @@ skip:
 	return rc;
 }
 
-int vmm_devemu_emulate_iowrite(struct vmm_vcpu *vcpu,
-			       physical_addr_t gphys_addr,
-			       void *src, u32 src_len,
-			       enum vmm_devemu_endianness src_endian)
+int vmm_devemu_emulate_region_iowrite(struct vmm_vcpu *vcpu,
+				      struct vmm_region *reg,
+				      physical_addr_t gphys_addr,
+				      void *src, u32 src_len,
+				      enum vmm_devemu_endianness src_endian)
 {
 	int rc;
-	struct vmm_region *reg;
 
 	if (!vcpu || !vcpu->guest) {
 		return VMM_EFAIL;
 	}
 
-	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
-			VMM_REGION_VIRTUAL | VMM_REGION_IO, FALSE);
 	if (!reg) {
 		rc = VMM_ENOTAVAIL;
 		goto skip;
 	}
 
-	rc = devemu_dowrite(reg->devemu_priv,
-			    gphys_addr - reg->gphys_addr,
-			    src, src_len, src_endian);
+	rc = devemu_write(reg->devemu_priv,
+			  gphys_addr - reg->gphys_addr,
+			  src, src_len, src_endian);
 skip:
+	vmm_trace(DEVEMU_WRITE, gphys_addr, src_len, rc, 0);
 	if (rc) {
 		vmm_printf("%s: vcpu=%s gphys=0x%"PRIPADDR" src_len=%d "
 			   "failed (error %d)\n", __func__,
@@ -536,6 +1026,42 @@ skip:
 	return rc;
 }
 
+int vmm_devemu_emulate_ioread(struct vmm_vcpu *vcpu,
+			      physical_addr_t gphys_addr,
+			      void *dst, u32 dst_len,
+			      enum vmm_devemu_endianness dst_endian)
+{
+	struct vmm_region *reg;
+
+	if (!vcpu || !vcpu->guest) {
+		return VMM_EFAIL;
+	}
+
+	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
+			VMM_REGION_VIRTUAL | VMM_REGION_IO, FALSE);
+
+	return vmm_devemu_emulate_region_ioread(vcpu, reg, gphys_addr,
+						dst, dst_len, dst_endian);
+}
+
+int vmm_devemu_emulate_iowrite(struct vmm_vcpu *vcpu,
+			       physical_addr_t gphys_addr,
+			       void *src, u32 src_len,
+			       enum vmm_devemu_endianness src_endian)
+{
+	struct vmm_region *reg;
+
+	if (!vcpu || !vcpu->guest) {
+		return VMM_EFAIL;
+	}
+
+	reg = vmm_guest_find_region(vcpu->guest, gphys_addr,
+			VMM_REGION_VIRTUAL | VMM_REGION_IO, FALSE);
+
+	return vmm_devemu_emulate_region_iowrite(vcpu, reg, gphys_addr,
+						 src, src_len, src_endian);
+}
+
 int __vmm_devemu_emulate_irq(struct vmm_guest *guest,
 			     u32 irq, int cpu, int level)
 {
@@ -711,8 +1237,144 @@ u32 vmm_devemu_count_irqs(struct vmm_guest *guest)
 	return (eg) ? eg->g_irq_count : 0;
 }
 
+static u32 devemu_match_hash(const char *key, u32 key_len)
+{
+	u32 i, hash = 5381;
+
+	for (i = 0; i < key_len; i++) {
+		hash = (hash << 5) + hash + (u8)key[i];
+	}
+
+	return hash;
+}
+
+/* Build match cache key as "name\0device_type\0compatible" */
+static char *devemu_match_key(const struct vmm_devtree_node *node,
+			      u32 *key_len)
+{
+	char *key;
+	const char *name, *type, *compat;
+	u32 name_len, type_len, compat_len;
+
+	name = (dectrl.match_by_name) ? node->name : "";
+	type = vmm_devtree_attrval(node, VMM_DEVTREE_DEVICE_TYPE_ATTR_NAME);
+	if (!type) {
+		type = "";
+	}
+	compat = vmm_devtree_attrval(node, VMM_DEVTREE_COMPATIBLE_ATTR_NAME);
+	compat_len = (compat) ?
+		vmm_devtree_attrlen(node, VMM_DEVTREE_COMPATIBLE_ATTR_NAME) : 0;
+	name_len = strlen(name) + 1;
+	type_len = strlen(type) + 1;
+
+	key = vmm_malloc(name_len + type_len + compat_len);
+	if (!key) {
+		return NULL;
+	}
+	memcpy(key, name, name_len);
+	memcpy(key + name_len, type, type_len);
+	if (compat_len) {
+		memcpy(key + name_len + type_len, compat, compat_len);
+	}
+	*key_len = name_len + type_len + compat_len;
+
+	return key;
+}
+
+/* Note: Must be called with emu_lock held */
+static struct vmm_devemu_match_entry *devemu_match_cache_find(
+					const char *key, u32 key_len, u32 hash)
+{
+	struct vmm_devemu_match_entry *ment;
+
+	list_for_each_entry(ment,
+		&dectrl.match_cache[hash % DEVEMU_MATCH_CACHE_SIZE], head) {
+		if ((ment->hash == hash) && (ment->key_len == key_len) &&
+		    !memcmp(ment->key, key, key_len)) {
+			return ment;
+		}
+	}
+
+	return NULL;
+}
+
+/* Note: Must be called with emu_lock held */
+static void devemu_match_cache_flush(struct vmm_emulator *emu)
+{
+	u32 i;
+	struct vmm_devemu_match_entry *ment, *nment;
+
+	for (i = 0; i < DEVEMU_MATCH_CACHE_SIZE; i++) {
+		list_for_each_entry_safe(ment, nment,
+					 &dectrl.match_cache[i], head) {
+			if (emu && (ment->emu != emu)) {
+				continue;
+			}
+			list_del(&ment->head);
+			vmm_free(ment->key);
+			vmm_free(ment);
+		}
+	}
+}
+
+/* Note: Must be called with emu_lock held */
+static struct vmm_emulator *devemu_match_emulator(
+				const struct vmm_devtree_node *node,
+				const struct vmm_devtree_nodeid **match)
+{
+	u32 key_len = 0, hash = 0;
+	char *key;
+	struct vmm_emulator *emu;
+	struct vmm_devemu_match_entry *ment;
+
+	key = devemu_match_key(node, &key_len);
+	if (key) {
+		hash = devemu_match_hash(key, key_len);
+		ment = devemu_match_cache_find(key, key_len, hash);
+		if (ment) {
+			vmm_free(key);
+			*match = ment->match;
+			return ment->emu;
+		}
+	}
+
+	*match = NULL;
+	list_for_each_entry(emu, &dectrl.emu_list, head) {
+		*match = vmm_devtree_match_node(emu->match_table, node);
+		if (*match) {
+			break;
+		}
+	}
+	if (!*match) {
+		if (key) {
+			vmm_free(key);
+		}
+		return NULL;
+	}
+
+	/* Failing to cache a match is not fatal */
+	if (key) {
+		ment = vmm_zalloc(sizeof(*ment));
+		if (ment) {
+			INIT_LIST_HEAD(&ment->head);
+			ment->hash = hash;
+			ment->key_len = key_len;
+			ment->key = key;
+			ment->emu = emu;
+			ment->match = *match;
+			list_add_tail(&ment->head,
+			&dectrl.match_cache[hash % DEVEMU_MATCH_CACHE_SIZE]);
+		} else {
+			vmm_free(key);
+		}
+	}
+
+	return emu;
+}
+
 int vmm_devemu_register_emulator(struct vmm_emulator *emu)
 {
+	const struct vmm_devtree_nodeid *mid;
 	bool found;
 	struct vmm_emulator *e;
 
@@ -742,6 +1404,16 @@ int vmm_devemu_register_emulator(struct vmm_emulator *emu)
 
 	list_add_tail(&emu->head, &dectrl.emu_list);
 
+	/* Cached matches ignore node name unless some emulator needs it */
+	for (mid = emu->match_table;
+	     mid && (mid->name[0] || mid->type[0] || mid->compatible[0]);
+	     mid++) {
+		if (mid->name[0] && !dectrl.match_by_name) {
+			dectrl.match_by_name = TRUE;
+			devemu_match_cache_flush(NULL);
+		}
+	}
+
 	vmm_mutex_unlock(&dectrl.emu_lock);
 
 	return VMM_OK;
@@ -832,6 +1504,7 @@ int vmm_devemu_unregister_emulator(struct vmm_emulator *emu)
 	}
 
 	list_del(&e->head);
+	devemu_match_cache_flush(e);
 
 	vmm_mutex_unlock(&dectrl.emu_lock);
 
@@ -943,6 +1616,7 @@ int vmm_devemu_reset_region(struct vmm_guest *guest, struct vmm_region *reg)
 
 	edev = (struct vmm_emudev *)reg->devemu_priv;
 	if (edev && edev->emu->reset) {
+		devemu_coalesce_flush(edev->coalesce);
 		debug_reset(edev);
 		return edev->emu->reset(edev);
 	}
@@ -950,6 +1624,61 @@ int vmm_devemu_reset_region(struct vmm_guest *guest, struct vmm_region *reg)
 	return VMM_OK;
 }
 
+int vmm_devemu_save_region(struct vmm_guest *guest, struct vmm_region *reg,
+			   struct vmm_snapshot_state *st)
+{
+	struct vmm_emudev *edev;
+
+	if (!guest || !reg || !st) {
+		return VMM_EFAIL;
+	}
+
+	if (!(reg->flags & VMM_REGION_ISDEVICE) ||
+	    (reg->flags & VMM_REGION_ALIAS)) {
+		return VMM_EINVALID;
+	}
+
+	edev = (struct vmm_emudev *)reg->devemu_priv;
+	if (!edev) {
+		return VMM_ENODEV;
+	}
+	if (!edev->emu->save) {
+		return VMM_ENOTSUPP;
+	}
+
+	devemu_coalesce_flush(edev->coalesce);
+
+	return edev->emu->save(edev, st);
+}
+
+int vmm_devemu_restore_region(struct vmm_guest *guest,
+			      struct vmm_region *reg,
+			      struct vmm_snapshot_state *st)
+{
+	struct vmm_emudev *edev;
+
+	if (!guest || !reg || !st) {
+		return VMM_EFAIL;
+	}
+
+	if (!(reg->flags & VMM_REGION_ISDEVICE) ||
+	    (reg->flags & VMM_REGION_ALIAS)) {
+		return VMM_EINVALID;
+	}
+
+	edev = (struct vmm_emudev *)reg->devemu_priv;
+	if (!edev) {
+		return VMM_ENODEV;
+	}
+	if (!edev->emu->restore) {
+		return VMM_ENOTSUPP;
+	}
+
+	devemu_coalesce_flush(edev->coalesce);
+
+	return edev->emu->restore(edev, st);
+}
+
 static int set_debug_info(struct vmm_emudev *edev)
 {
 	int rc = VMM_OK;
@@ -991,12 +1720,8 @@ int vmm_devemu_probe_region(struct vmm_guest *guest, struct vmm_region *reg)
 	vmm_mutex_lock(&dectrl.emu_lock);
 
 	found = FALSE;
-	list_for_each_entry(emu, &dectrl.emu_list, head) {
-		match = vmm_devtree_match_node(emu->match_table, reg->node);
-		if (!match) {
-			continue;
-		}
-
+	emu = devemu_match_emulator(reg->node, &match);
+	if (emu) {
 		found = TRUE;
 		einst = vmm_zalloc(sizeof(struct vmm_emudev));
 		if (einst == NULL) {
@@ -1011,6 +1736,7 @@ int vmm_devemu_probe_region(struct vmm_guest *guest, struct vmm_region *reg)
 		einst->priv = NULL;
 		reg->devemu_priv = einst;
 		set_debug_info(einst);
+		devemu_setup_handlers(einst);
 #if defined(CONFIG_VERBOSE_MODE)
 		vmm_printf("Probe edevice %s/%s\n",
 			   guest->name, reg->node->name);
@@ -1021,6 +1747,8 @@ int vmm_devemu_probe_region(struct vmm_guest *guest, struct vmm_region *reg)
 		if ((rc = emu->probe(guest, einst, match))) {
 			vmm_printf("%s: %s/%s probe error %d\n",
 			__func__, guest->name, reg->node->name, rc);
+			devemu_doorbell_del(einst);
+			devemu_coalesce_free(einst);
 			vmm_devtree_dref_node(einst->node);
 			einst->node = NULL;
 			vmm_free(einst);
@@ -1031,6 +1759,8 @@ int vmm_devemu_probe_region(struct vmm_guest *guest, struct vmm_region *reg)
 		if ((rc = emu->reset(einst))) {
 			vmm_printf("%s: %s/%s reset error %d\n",
 			__func__, guest->name, reg->node->name, rc);
+			devemu_doorbell_del(einst);
+			devemu_coalesce_free(einst);
 			vmm_devtree_dref_node(einst->node);
 			einst->node = NULL;
 			vmm_free(einst);
@@ -1038,7 +1768,6 @@ int vmm_devemu_probe_region(struct vmm_guest *guest, struct vmm_region *reg)
 			return rc;
 		}
 		vmm_mutex_lock(&dectrl.emu_lock);
-		break;
 	}
 
 	vmm_mutex_unlock(&dectrl.emu_lock);
@@ -1069,10 +1798,13 @@ int vmm_devemu_remove_region(struct vmm_guest *guest, struct vmm_region *reg)
 	if (reg->devemu_priv) {
 		einst = reg->devemu_priv;
 
+		devemu_coalesce_flush(einst->coalesce);
 		debug_remove(einst);
 		if ((rc = einst->emu->remove(einst))) {
 			return rc;
 		}
+		devemu_doorbell_del(einst);
+		devemu_coalesce_free(einst);
 
 		vmm_devtree_dref_node(einst->node);
 		einst->node = NULL;
@@ -1120,6 +1852,10 @@ int vmm_devemu_init_context(struct vmm_guest *guest)
 	for (ite = 0; ite < eg->g_irq_count; ite++) {
 		INIT_LIST_HEAD(&eg->g_irq[ite]);
 	}
+	INIT_RW_LOCK(&eg->db_lock);
+	for (ite = 0; ite < DEVEMU_DOORBELL_HASH_SIZE; ite++) {
+		INIT_LIST_HEAD(&eg->db_hash[ite]);
+	}
 
 	guest->aspace.devemu_priv = eg;
 
@@ -1159,6 +1895,8 @@ int vmm_devemu_deinit_context(struct vmm_guest *guest)
 
 int __init vmm_devemu_init(void)
 {
+	u32 i;
+
 	memset(&dectrl, 0, sizeof(dectrl));
 
 #ifdef CONFIG_CPU_BE
@@ -1169,6 +1907,10 @@ int __init vmm_devemu_init(void)
 
 	INIT_MUTEX(&dectrl.emu_lock);
 	INIT_LIST_HEAD(&dectrl.emu_list);
+	dectrl.match_by_name = FALSE;
+	for (i = 0; i < DEVEMU_MATCH_CACHE_SIZE; i++) {
+		INIT_LIST_HEAD(&dectrl.match_cache[i]);
+	}
 
 	return VMM_OK;
 }
@@ -32,14 +32,145 @@
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
 
+#define DEVTREE_INDEX_HASH_SIZE		256
+
+/* Entry of compatible string index (one per compatible string of node) */
+struct vmm_devtree_compat_entry {
+	struct dlist head;
+	u32 hash;
+	const char *compat;
+	struct vmm_devtree_node *node;
+};
+
+/*
+ * The phandle and compatible string indexes are hash tables updated
+ * whenever 'phandle' or 'compatible' attribute of a node changes. The
+ * node sequence number (order of node creation) is used to return
+ * matches in the same order as a depth-first walk of device tree.
+ */
 struct vmm_devtree_ctrl {
         struct vmm_devtree_node *root;
 	u32 nidtbl_count;
 	struct vmm_devtree_nidtbl_entry *nidtbl;
+	vmm_rwlock_t index_lock;
+	bool compat_index_failed;
+	u32 node_seq;
+	struct dlist phandle_hash[DEVTREE_INDEX_HASH_SIZE];
+	struct dlist compat_hash[DEVTREE_INDEX_HASH_SIZE];
 };
 
 static struct vmm_devtree_ctrl dtree_ctrl;
 
+static u32 devtree_hash_string(const char *str)
+{
+	u32 hash = 5381;
+
+	while (*str) {
+		hash = (hash << 5) + hash + (u8)(*str);
+		str++;
+	}
+
+	return hash;
+}
+
+static inline u32 devtree_hash_phandle(u32 phandle)
+{
+	return (phandle * 2654435761U) >> 24;
+}
+
+static void devtree_unindex_attr(struct vmm_devtree_node *node,
+				 struct vmm_devtree_attr *attr)
+{
+	u32 i, count = 0;
+	irq_flags_t flags;
+	struct vmm_devtree_compat_entry *ents = NULL;
+
+	if (!strcmp(attr->name, VMM_DEVTREE_PHANDLE_ATTR_NAME)) {
+		vmm_write_lock_irqsave_lite(&dtree_ctrl.index_lock, flags);
+		list_del_init(&node->phandle_head);
+		node->phandle = 0;
+		vmm_write_unlock_irqrestore_lite(&dtree_ctrl.index_lock, flags);
+	} else if (!strcmp(attr->name, VMM_DEVTREE_COMPATIBLE_ATTR_NAME)) {
+		vmm_write_lock_irqsave_lite(&dtree_ctrl.index_lock, flags);
+		ents = node->compat_entries;
+		count = node->compat_count;
+		for (i = 0; i < count; i++) {
+			list_del(&ents[i].head);
+		}
+		node->compat_entries = NULL;
+		node->compat_count = 0;
+		vmm_write_unlock_irqrestore_lite(&dtree_ctrl.index_lock, flags);
+		if (ents) {
+			vmm_free(ents);
+		}
+	}
+}
+
+static void devtree_index_attr(struct vmm_devtree_node *node,
+			       struct vmm_devtree_attr *attr)
+{
+	int len, l;
+	u32 i, count, phandle;
+	irq_flags_t flags;
+	const char *cp;
+	struct vmm_devtree_compat_entry *ents;
+
+	if (!attr->value) {
+		return;
+	}
+
+	if (!strcmp(attr->name, VMM_DEVTREE_PHANDLE_ATTR_NAME)) {
+		if (attr->len != sizeof(u32)) {
+			return;
+		}
+		phandle = vmm_be32_to_cpu(*((u32 *)attr->value));
+		vmm_write_lock_irqsave_lite(&dtree_ctrl.index_lock, flags);
+		node->phandle = phandle;
+		list_add_tail(&node->phandle_head,
+			&dtree_ctrl.phandle_hash[devtree_hash_phandle(phandle)]);
+		vmm_write_unlock_irqrestore_lite(&dtree_ctrl.index_lock, flags);
+	} else if (!strcmp(attr->name, VMM_DEVTREE_COMPATIBLE_ATTR_NAME)) {
+		count = 0;
+		cp = attr->value;
+		len = attr->len;
+		while ((len > 0) && cp[len - 1]) {
+			len--;
+		}
+		for (l = 0; l < len; l++) {
+			if (!cp[l]) {
+				count++;
+			}
+		}
+		if (!count) {
+			return;
+		}
+
+		ents = vmm_zalloc(count * sizeof(*ents));
+		if (!ents) {
+			/* Fallback to tree walk for all lookups */
+			dtree_ctrl.compat_index_failed = TRUE;
+			return;
+		}
+		for (i = 0; i < count; i++) {
+			INIT_LIST_HEAD(&ents[i].head);
+			ents[i].hash = devtree_hash_string(cp);
+			ents[i].compat = cp;
+			ents[i].node = node;
+			cp += strlen(cp) + 1;
+		}
+
+		vmm_write_lock_irqsave_lite(&dtree_ctrl.index_lock, flags);
+		for (i = 0; i < count; i++) {
+			list_add_tail(&ents[i].head,
+				&dtree_ctrl.compat_hash[ents[i].hash %
+						DEVTREE_INDEX_HASH_SIZE]);
+		}
+		node->compat_entries = ents;
+		node->compat_count = count;
+		vmm_write_unlock_irqrestore_lite(&dtree_ctrl.index_lock, flags);
+	}
+}
+
 bool vmm_devtree_isliteral(u32 attrtype)
 {
 	bool ret = FALSE;
@@ -154,6 +285,8 @@ u32 vmm_devtree_estimate_attrtype(const char *name)
 		ret = VMM_DEVTREE_ATTRTYPE_PHYSSIZE;
 	} else if (!strcmp(name, VMM_DEVTREE_ALIGN_ORDER_ATTR_NAME)) {
 		ret = VMM_DEVTREE_ATTRTYPE_UINT32;
+	} else if (!strcmp(name, VMM_DEVTREE_PREMAP_ATTR_NAME)) {
+		ret = VMM_DEVTREE_ATTRTYPE_UINT32;
 	} else if (!strcmp(name, VMM_DEVTREE_SWITCH_ATTR_NAME)) {
 		ret = VMM_DEVTREE_ATTRTYPE_STRING;
 	} else if (!strcmp(name, VMM_DEVTREE_CONSOLE_ATTR_NAME)) {
@@ -301,7 +434,9 @@ int vmm_devtree_setattr(struct vmm_devtree_node *node,
 		}
 	}
 
-	if (!found) {
+	if (found) {
+		devtree_unindex_attr(node, attr);
+	} else {
 		attr = vmm_malloc(sizeof(struct vmm_devtree_attr));
 		if (!attr) {
 			return VMM_ENOMEM;
@@ -323,7 +458,9 @@ int vmm_devtree_setattr(struct vmm_devtree_node *node,
 		vmm_write_lock_irqsave_lite(&node->attr_lock, flags);
 		list_add_tail(&attr->head, &node->attr_list);
 		vmm_write_unlock_irqrestore_lite(&node->attr_lock, flags);
-	} else {
+	}
+
+	if (found) {
 		attr->type = type;
 		if (attr->len != len) {
 			if (attr->len) {
@@ -410,6 +547,8 @@ int vmm_devtree_setattr(struct vmm_devtree_node *node,
 		}
 	}
 
+	devtree_index_attr(node, attr);
+
 	return VMM_OK;
 }
 
@@ -446,14 +585,15 @@ int vmm_devtree_delattr(struct vmm_devtree_node *node, const char *name)
 		return VMM_EFAIL;
 	}
 
-	if (attr->value) {
-		vmm_free(attr->value);
-	}
+	devtree_unindex_attr(node, attr);
 
 	vmm_write_lock_irqsave_lite(&node->attr_lock, flags);
 	list_del(&attr->head);
 	vmm_write_unlock_irqrestore_lite(&node->attr_lock, flags);
 
+	if (attr->value) {
+		vmm_free(attr->value);
+	}
 	vmm_free(attr);
 
 	return VMM_OK;
@@ -1246,19 +1386,118 @@ const struct vmm_devtree_nodeid *vmm_devtree_match_node(
 	return NULL;
 }
 
-struct vmm_devtree_node *vmm_devtree_find_matching(
-				struct vmm_devtree_node *node,
-				const struct vmm_devtree_nodeid *matches)
+static bool devtree_node_is_under(const struct vmm_devtree_node *np,
+				  const struct vmm_devtree_node *node)
 {
-	struct vmm_devtree_node *child, *ret;
+	while (np) {
+		if (np == node) {
+			return TRUE;
+		}
+		np = np->parent;
+	}
 
-	if (!matches) {
-		return NULL;
+	return FALSE;
+}
+
+static u32 devtree_collect_compat(const struct vmm_devtree_nodeid *matches,
+				  struct vmm_devtree_node **nodes, u32 max)
+{
+	u32 hash, count = 0;
+	struct vmm_devtree_compat_entry *ent;
+	const struct vmm_devtree_nodeid *mid;
+
+	for (mid = matches;
+	     mid->name[0] || mid->type[0] || mid->compatible[0]; mid++) {
+		hash = devtree_hash_string(mid->compatible);
+		list_for_each_entry(ent,
+			&dtree_ctrl.compat_hash[hash % DEVTREE_INDEX_HASH_SIZE],
+			head) {
+			if ((ent->hash != hash) ||
+			    strcmp(ent->compat, mid->compatible)) {
+				continue;
+			}
+			if (count < max) {
+				nodes[count] = ent->node;
+				vmm_devtree_ref_node(ent->node);
+			}
+			count++;
+		}
 	}
 
-	if (!node) {
-		node = dtree_ctrl.root;
+	return count;
+}
+
+/*
+ * Find candidate nodes for nodeid table using compatible string index.
+ * The candidates are sorted in device tree order without duplicates
+ * and have increased reference count. Returns VMM_ENOTSUPP if some
+ * nodeid table entry has no compatible string (needs tree walk).
+ */
+static int devtree_index_candidates(const struct vmm_devtree_nodeid *matches,
+				    struct vmm_devtree_node ***out_nodes,
+				    u32 *out_count)
+{
+	u32 i, j, count, max;
+	irq_flags_t flags;
+	struct vmm_devtree_node *np, **nodes;
+	const struct vmm_devtree_nodeid *mid;
+
+	if (dtree_ctrl.compat_index_failed) {
+		return VMM_ENOTSUPP;
 	}
+	for (mid = matches;
+	     mid->name[0] || mid->type[0] || mid->compatible[0]; mid++) {
+		if (!mid->compatible[0]) {
+			return VMM_ENOTSUPP;
+		}
+	}
+
+	vmm_read_lock_irqsave_lite(&dtree_ctrl.index_lock, flags);
+	max = devtree_collect_compat(matches, NULL, 0);
+	vmm_read_unlock_irqrestore_lite(&dtree_ctrl.index_lock, flags);
+
+	nodes = NULL;
+	if (max) {
+		nodes = vmm_malloc(max * sizeof(*nodes));
+		if (!nodes) {
+			return VMM_ENOMEM;
+		}
+	}
+
+	vmm_read_lock_irqsave_lite(&dtree_ctrl.index_lock, flags);
+	count = devtree_collect_compat(matches, nodes, max);
+	vmm_read_unlock_irqrestore_lite(&dtree_ctrl.index_lock, flags);
+	if (max < count) {
+		count = max;
+	}
+
+	/* Insertion sort on node sequence number and drop duplicates */
+	for (i = 1; i < count; i++) {
+		np = nodes[i];
+		for (j = i; (0 < j) && (np->seq < nodes[j - 1]->seq); j--) {
+			nodes[j] = nodes[j - 1];
+		}
+		nodes[j] = np;
+	}
+	for (i = 0, j = 0; i < count; i++) {
+		if (j && (nodes[j - 1] == nodes[i])) {
+			vmm_devtree_dref_node(nodes[i]);
+			continue;
+		}
+		nodes[j++] = nodes[i];
+	}
+
+	*out_nodes = nodes;
+	*out_count = j;
+
+	return VMM_OK;
+}
+
+static struct vmm_devtree_node *devtree_find_matching_walk(
+				struct vmm_devtree_node *node,
+				const struct vmm_devtree_nodeid *matches)
+{
+	struct vmm_devtree_node *child, *ret;
 
 	if (vmm_devtree_match_node(matches, node)) {
 		vmm_devtree_ref_node(node);
@@ -1266,7 +1505,7 @@ struct vmm_devtree_node *vmm_devtree_find_matching(
 	}
 
 	vmm_devtree_for_each_child(child, node) {
-		ret = vmm_devtree_find_matching(child, matches);
+		ret = devtree_find_matching_walk(child, matches);
 		if (ret) {
 			vmm_devtree_dref_node(child);
 			return ret;
@@ -1276,7 +1515,42 @@ struct vmm_devtree_node *vmm_devtree_find_matching(
 	return NULL;
 }
 
-void vmm_devtree_iterate_matching(struct vmm_devtree_node *node,
+struct vmm_devtree_node *vmm_devtree_find_matching(
+				struct vmm_devtree_node *node,
+				const struct vmm_devtree_nodeid *matches)
+{
+	u32 i, count;
+	struct vmm_devtree_node *ret, **nodes;
+
+	if (!matches) {
+		return NULL;
+	}
+
+	if (!node) {
+		node = dtree_ctrl.root;
+	}
+
+	if (devtree_index_candidates(matches, &nodes, &count)) {
+		return devtree_find_matching_walk(node, matches);
+	}
+
+	ret = NULL;
+	for (i = 0; i < count; i++) {
+		if (!ret && devtree_node_is_under(nodes[i], node) &&
+		    vmm_devtree_match_node(matches, nodes[i])) {
+			ret = nodes[i];
+			continue;
+		}
+		vmm_devtree_dref_node(nodes[i]);
+	}
+	if (nodes) {
+		vmm_free(nodes);
+	}
+
+	return ret;
+}
+
+static void devtree_iterate_matching_walk(struct vmm_devtree_node *node,
 				  const struct vmm_devtree_nodeid *matches,
 				  void (*found)(struct vmm_devtree_node *node,
 				      const struct vmm_devtree_nodeid *match,
@@ -1286,14 +1560,6 @@ void vmm_devtree_iterate_matching(struct vmm_devtree_node *node,
 	struct vmm_devtree_node *child;
 	const struct vmm_devtree_nodeid *mid;
 
-	if (!found || !matches) {
-		return;
-	}
-
-	if (!node) {
-		node = dtree_ctrl.root;
-	}
-
 	vmm_devtree_ref_node(node);
 
 	mid = vmm_devtree_match_node(matches, node);
@@ -1302,13 +1568,52 @@ void vmm_devtree_iterate_matching(struct vmm_devtree_node *node,
 	}
 
 	vmm_devtree_for_each_child(child, node) {
-		vmm_devtree_iterate_matching(child, matches,
-					     found, found_data);
+		devtree_iterate_matching_walk(child, matches,
+					      found, found_data);
 	}
 
 	vmm_devtree_dref_node(node);
 }
 
+void vmm_devtree_iterate_matching(struct vmm_devtree_node *node,
+				  const struct vmm_devtree_nodeid *matches,
+				  void (*found)(struct vmm_devtree_node *node,
+				      const struct vmm_devtree_nodeid *match,
+				      void *data),
+				  void *found_data)
+{
+	u32 i, count;
+	struct vmm_devtree_node **nodes;
+	const struct vmm_devtree_nodeid *mid;
+
+	if (!found || !matches) {
+		return;
+	}
+
+	if (!node) {
+		node = dtree_ctrl.root;
+	}
+
+	if (devtree_index_candidates(matches, &nodes, &count)) {
+		devtree_iterate_matching_walk(node, matches,
+					      found, found_data);
+		return;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (devtree_node_is_under(nodes[i], node)) {
+			mid = vmm_devtree_match_node(matches, nodes[i]);
+			if (mid) {
+				found(nodes[i], mid, found_data);
+			}
+		}
+		vmm_devtree_dref_node(nodes[i]);
+	}
+	if (nodes) {
+		vmm_free(nodes);
+	}
+}
+
 struct vmm_devtree_node *vmm_devtree_find_compatible(
 				struct vmm_devtree_node *node,
 				const char *device_type,
@@ -1356,49 +1661,35 @@ bool vmm_devtree_is_compatible(const struct vmm_devtree_node *node,
 	return vmm_devtree_match_node(id, node) ? TRUE : FALSE;
 }
 
-static struct vmm_devtree_node *recursive_find_node_by_phandle(
-					struct vmm_devtree_node *node,
-					u32 phandle)
+struct vmm_devtree_node *vmm_devtree_find_node_by_phandle(u32 phandle)
 {
-	int rc;
-	u32 phnd;
-	struct vmm_devtree_node *child, *ret;
+	irq_flags_t flags;
+	struct vmm_devtree_node *np, *ret = NULL;
 
-	if (!node) {
+	if (!dtree_ctrl.root) {
 		return NULL;
 	}
 
-	rc = vmm_devtree_read_u32(node, VMM_DEVTREE_PHANDLE_ATTR_NAME, &phnd);
-	if ((rc == VMM_OK) && (phnd == phandle)) {
-		ret = node;
-		goto done;
-	}
-
-	ret = NULL;
-	vmm_devtree_for_each_child(child, node) {
-		ret = recursive_find_node_by_phandle(child, phandle);
-		if (ret) {
-			vmm_devtree_dref_node(child);
-			break;
+	/* Same phandle may appear in guest device trees so
+	 * prefer the node which comes first in device tree.
+	 */
+	vmm_read_lock_irqsave_lite(&dtree_ctrl.index_lock, flags);
+	list_for_each_entry(np,
+		&dtree_ctrl.phandle_hash[devtree_hash_phandle(phandle)],
+		phandle_head) {
+		if ((np->phandle == phandle) &&
+		    (!ret || (np->seq < ret->seq))) {
+			ret = np;
 		}
 	}
-
-done:
 	if (ret) {
 		vmm_devtree_ref_node(ret);
 	}
+	vmm_read_unlock_irqrestore_lite(&dtree_ctrl.index_lock, flags);
 
 	return ret;
 }
 
-struct vmm_devtree_node *vmm_devtree_find_node_by_phandle(u32 phandle)
-{
-	if (!dtree_ctrl.root) {
-		return NULL;
-	}
-	return recursive_find_node_by_phandle(dtree_ctrl.root, phandle);
-}
-
 static int devtree_parse_phandle_with_args(
 					const struct vmm_devtree_node *np,
 					const char *list_name,
@@ -1727,11 +2018,19 @@ struct vmm_devtree_node *vmm_devtree_addnode(struct vmm_devtree_node *parent,
 	INIT_RW_LOCK(&node->child_lock);
 	INIT_LIST_HEAD(&node->child_list);
 	arch_atomic_write(&node->ref_count, 1);
+	node->phandle = 0;
+	INIT_LIST_HEAD(&node->phandle_head);
+	node->compat_count = 0;
+	node->compat_entries = NULL;
 	strncpy(node->name, name, sizeof(node->name));
 	node->parent = NULL;
 	node->system_data = NULL;
 	node->priv = NULL;
 
+	vmm_write_lock_irqsave_lite(&dtree_ctrl.index_lock, flags);
+	node->seq = dtree_ctrl.node_seq++;
+	vmm_write_unlock_irqrestore_lite(&dtree_ctrl.index_lock, flags);
+
 	if (parent) {
 		vmm_devtree_ref_node(parent);
 		node->parent = parent;
@@ -2002,13 +2301,18 @@ void vmm_devtree_nidtbl_destroy_matches(
 int __init vmm_devtree_init(void)
 {
 	int rc;
-	u32 nidtbl_cnt;
+	u32 i, nidtbl_cnt;
 	virtual_addr_t ca, nidtbl_va;
 	virtual_size_t nidtbl_sz;
 	struct vmm_devtree_nidtbl_entry *nide, *tnide;
 
 	/* Reset the control structure */
 	memset(&dtree_ctrl, 0, sizeof(dtree_ctrl));
+	INIT_RW_LOCK(&dtree_ctrl.index_lock);
+	for (i = 0; i < DEVTREE_INDEX_HASH_SIZE; i++) {
+		INIT_LIST_HEAD(&dtree_ctrl.phandle_hash[i]);
+		INIT_LIST_HEAD(&dtree_ctrl.compat_hash[i]);
+	}
 
 	/* Populate Board Specific Device Tree */
 	rc = arch_devtree_populate(&dtree_ctrl.root);
@@ -0,0 +1,516 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_dmaengine.c
+ * @author agent (agent@local)
+ * @brief DMA engine framework implementation
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_mutex.h>
+#include <vmm_completion.h>
+#include <vmm_modules.h>
+#include <vmm_dmaengine.h>
+#include <libs/stringlib.h>
+
+#define MODULE_DESC			"DMA Engine Framework"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		VMM_DMAENGINE_IPRIORITY
+#define	MODULE_INIT			vmm_dmaengine_init
+#define	MODULE_EXIT			vmm_dmaengine_exit
+
+static DEFINE_MUTEX(ddev_list_lock);
+static LIST_HEAD(ddev_list);
+static u32 ddev_count;
+
+static void dma_tx_finish(struct vmm_dma_tx *tx, int error)
+{
+	if (tx->callback) {
+		tx->callback(tx->param, error);
+	}
+	vmm_free(tx);
+}
+
+/* Start next chunk on channel if it is idle. Transactions which
+ * fail to start are completed here with the error of xfer().
+ */
+static void dma_chan_kick(struct vmm_dma_chan *chan)
+{
+	int rc = VMM_OK;
+	irq_flags_t flags;
+	physical_size_t len;
+	struct vmm_dma_seg *seg;
+	struct vmm_dma_tx *tx, *failed;
+	struct vmm_dma_device *ddev = chan->ddev;
+
+	do {
+		failed = NULL;
+		vmm_spin_lock_irqsave(&chan->lock, flags);
+
+		if (!chan->active && !list_empty(&chan->pending)) {
+			tx = list_first_entry(&chan->pending,
+					      struct vmm_dma_tx, head);
+			list_del(&tx->head);
+			chan->active = tx;
+		}
+
+		tx = chan->active;
+		if (tx && !tx->busy) {
+			seg = &tx->segs[tx->seg_pos];
+			len = seg->len - tx->seg_off;
+			if (ddev->max_len && (ddev->max_len < len)) {
+				len = ddev->max_len;
+			}
+			rc = ddev->xfer(chan, tx->type,
+					seg->dst + tx->seg_off,
+					(tx->type == VMM_DMA_MEMCPY) ?
+					seg->src + tx->seg_off : 0,
+					tx->value, len);
+			if (rc) {
+				chan->active = NULL;
+				failed = tx;
+			} else {
+				tx->xfer_len = len;
+				tx->busy = TRUE;
+			}
+		}
+
+		vmm_spin_unlock_irqrestore(&chan->lock, flags);
+
+		if (failed) {
+			dma_tx_finish(failed, rc);
+		}
+	} while (failed);
+}
+
+void vmm_dma_chan_done(struct vmm_dma_chan *chan, int error)
+{
+	irq_flags_t flags;
+	struct vmm_dma_tx *tx, *done = NULL;
+
+	if (!chan) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&chan->lock, flags);
+
+	tx = chan->active;
+	if (tx && tx->busy) {
+		tx->busy = FALSE;
+		tx->seg_off += tx->xfer_len;
+		if (tx->segs[tx->seg_pos].len <= tx->seg_off) {
+			tx->seg_pos++;
+			tx->seg_off = 0;
+		}
+		if (error || (tx->seg_count <= tx->seg_pos)) {
+			chan->active = NULL;
+			done = tx;
+		}
+	}
+
+	vmm_spin_unlock_irqrestore(&chan->lock, flags);
+
+	/* Start next chunk before invoking callback to keep
+	 * DMA channel busy.
+	 */
+	dma_chan_kick(chan);
+
+	if (done) {
+		dma_tx_finish(done, error);
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_dma_chan_done);
+
+int vmm_dma_register_device(struct vmm_dma_device *ddev)
+{
+	u32 c;
+	struct vmm_dma_chan *chan;
+
+	if (!ddev || !ddev->name || !ddev->chans ||
+	    !ddev->chan_count || !ddev->xfer) {
+		return VMM_EINVALID;
+	}
+	if (!ddev->align) {
+		ddev->align = 1;
+	}
+	if (ddev->align & (ddev->align - 1)) {
+		return VMM_EINVALID;
+	}
+	/* Chunks must keep alignment of remaining bytes */
+	ddev->max_len &= ~((physical_size_t)ddev->align - 1);
+
+	for (c = 0; c < ddev->chan_count; c++) {
+		chan = &ddev->chans[c];
+		chan->ddev = ddev;
+		chan->id = c;
+		INIT_SPIN_LOCK(&chan->lock);
+		chan->in_use = FALSE;
+		INIT_LIST_HEAD(&chan->pending);
+		chan->active = NULL;
+	}
+
+	INIT_LIST_HEAD(&ddev->head);
+
+	vmm_mutex_lock(&ddev_list_lock);
+	list_add_tail(&ddev->head, &ddev_list);
+	ddev_count++;
+	vmm_mutex_unlock(&ddev_list_lock);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_dma_register_device);
+
+int vmm_dma_unregister_device(struct vmm_dma_device *ddev)
+{
+	u32 c;
+
+	if (!ddev) {
+		return VMM_EINVALID;
+	}
+
+	vmm_mutex_lock(&ddev_list_lock);
+
+	for (c = 0; c < ddev->chan_count; c++) {
+		if (ddev->chans[c].in_use) {
+			vmm_mutex_unlock(&ddev_list_lock);
+			return VMM_EBUSY;
+		}
+	}
+
+	list_del(&ddev->head);
+	ddev_count--;
+
+	vmm_mutex_unlock(&ddev_list_lock);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_dma_unregister_device);
+
+u32 vmm_dma_device_count(void)
+{
+	return ddev_count;
+}
+VMM_EXPORT_SYMBOL(vmm_dma_device_count);
+
+struct vmm_dma_chan *vmm_dma_chan_request(u32 caps)
+{
+	u32 c;
+	struct vmm_dma_device *ddev;
+	struct vmm_dma_chan *chan = NULL;
+
+	vmm_mutex_lock(&ddev_list_lock);
+
+	list_for_each_entry(ddev, &ddev_list, head) {
+		if ((ddev->caps & caps) != caps) {
+			continue;
+		}
+		for (c = 0; c < ddev->chan_count; c++) {
+			if (!ddev->chans[c].in_use) {
+				chan = &ddev->chans[c];
+				chan->in_use = TRUE;
+				break;
+			}
+		}
+		if (chan) {
+			break;
+		}
+	}
+
+	vmm_mutex_unlock(&ddev_list_lock);
+
+	return chan;
+}
+VMM_EXPORT_SYMBOL(vmm_dma_chan_request);
+
+void vmm_dma_chan_terminate(struct vmm_dma_chan *chan)
+{
+	irq_flags_t flags;
+	struct vmm_dma_tx *tx, *ntx;
+	LIST_HEAD(aborted);
+
+	if (!chan) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&chan->lock, flags);
+
+	tx = chan->active;
+	if (tx) {
+		if (tx->busy && chan->ddev->terminate) {
+			chan->ddev->terminate(chan);
+		}
+		tx->busy = FALSE;
+		chan->active = NULL;
+		list_add_tail(&tx->head, &aborted);
+	}
+	list_splice_tail_init(&chan->pending, &aborted);
+
+	vmm_spin_unlock_irqrestore(&chan->lock, flags);
+
+	list_for_each_entry_safe(tx, ntx, &aborted, head) {
+		list_del(&tx->head);
+		dma_tx_finish(tx, VMM_ESHUTDOWN);
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_dma_chan_terminate);
+
+void vmm_dma_chan_release(struct vmm_dma_chan *chan)
+{
+	if (!chan) {
+		return;
+	}
+
+	vmm_dma_chan_terminate(chan);
+
+	vmm_mutex_lock(&ddev_list_lock);
+	chan->in_use = FALSE;
+	vmm_mutex_unlock(&ddev_list_lock);
+}
+VMM_EXPORT_SYMBOL(vmm_dma_chan_release);
+
+static bool dma_seg_aligned(struct vmm_dma_device *ddev, u32 type,
+			    struct vmm_dma_seg *seg)
+{
+	physical_addr_t mask = ddev->align - 1;
+
+	if (!seg->len || (seg->len & mask) || (seg->dst & mask)) {
+		return FALSE;
+	}
+	if ((type == VMM_DMA_MEMCPY) && (seg->src & mask)) {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static struct vmm_dma_tx *dma_tx_alloc(struct vmm_dma_chan *chan,
+				u32 type, u32 seg_count,
+				void (*callback)(void *, int), void *param)
+{
+	struct vmm_dma_tx *tx;
+
+	if (!chan || !chan->in_use || !seg_count) {
+		return NULL;
+	}
+
+	tx = vmm_zalloc(sizeof(*tx) + ((seg_count > 1) ?
+			seg_count * sizeof(struct vmm_dma_seg) : 0));
+	if (!tx) {
+		return NULL;
+	}
+
+	INIT_LIST_HEAD(&tx->head);
+	tx->chan = chan;
+	tx->type = type;
+	tx->seg_count = seg_count;
+	tx->segs = (seg_count > 1) ?
+			(struct vmm_dma_seg *)(tx + 1) :
+			&tx->seg;
+	tx->callback = callback;
+	tx->param = param;
+
+	return tx;
+}
+
+struct vmm_dma_tx *vmm_dma_prep_memcpy(struct vmm_dma_chan *chan,
+				physical_addr_t dst, physical_addr_t src,
+				physical_size_t len,
+				void (*callback)(void *, int), void *param)
+{
+	struct vmm_dma_seg seg;
+
+	seg.dst = dst;
+	seg.src = src;
+	seg.len = len;
+
+	return vmm_dma_prep_sg(chan, &seg, 1, callback, param);
+}
+VMM_EXPORT_SYMBOL(vmm_dma_prep_memcpy);
+
+struct vmm_dma_tx *vmm_dma_prep_memset(struct vmm_dma_chan *chan,
+				physical_addr_t dst, u8 value,
+				physical_size_t len,
+				void (*callback)(void *, int), void *param)
+{
+	u32 caps;
+	struct vmm_dma_tx *tx;
+
+	if (!chan) {
+		return NULL;
+	}
+
+	caps = chan->ddev->caps;
+	if (!(caps & VMM_DMA_CAP_MEMSET) &&
+	    (value || !(caps & VMM_DMA_CAP_MEMZERO))) {
+		return NULL;
+	}
+
+	tx = dma_tx_alloc(chan, VMM_DMA_MEMSET, 1, callback, param);
+	if (!tx) {
+		return NULL;
+	}
+
+	tx->value = (u32)value * 0x01010101;
+	tx->seg.dst = dst;
+	tx->seg.len = len;
+	if (!dma_seg_aligned(chan->ddev, VMM_DMA_MEMSET, &tx->seg)) {
+		vmm_free(tx);
+		return NULL;
+	}
+
+	return tx;
+}
+VMM_EXPORT_SYMBOL(vmm_dma_prep_memset);
+
+struct vmm_dma_tx *vmm_dma_prep_sg(struct vmm_dma_chan *chan,
+				struct vmm_dma_seg *segs, u32 seg_count,
+				void (*callback)(void *, int), void *param)
+{
+	u32 s;
+	struct vmm_dma_tx *tx;
+
+	if (!chan || !segs ||
+	    !(chan->ddev->caps & VMM_DMA_CAP_MEMCPY)) {
+		return NULL;
+	}
+
+	for (s = 0; s < seg_count; s++) {
+		if (!dma_seg_aligned(chan->ddev, VMM_DMA_MEMCPY, &segs[s])) {
+			return NULL;
+		}
+	}
+
+	tx = dma_tx_alloc(chan, VMM_DMA_MEMCPY, seg_count, callback, param);
+	if (!tx) {
+		return NULL;
+	}
+
+	memcpy(tx->segs, segs, seg_count * sizeof(*segs));
+
+	return tx;
+}
+VMM_EXPORT_SYMBOL(vmm_dma_prep_sg);
+
+void vmm_dma_tx_free(struct vmm_dma_tx *tx)
+{
+	if (tx) {
+		vmm_free(tx);
+	}
+}
+VMM_EXPORT_SYMBOL(vmm_dma_tx_free);
+
+int vmm_dma_submit(struct vmm_dma_tx *tx)
+{
+	irq_flags_t flags;
+	struct vmm_dma_chan *chan;
+
+	if (!tx || !tx->chan) {
+		return VMM_EINVALID;
+	}
+	chan = tx->chan;
+
+	vmm_spin_lock_irqsave(&chan->lock, flags);
+	list_add_tail(&tx->head, &chan->pending);
+	vmm_spin_unlock_irqrestore(&chan->lock, flags);
+
+	dma_chan_kick(chan);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_dma_submit);
+
+struct dma_sync_wait {
+	struct vmm_completion done;
+	int error;
+};
+
+static void dma_sync_callback(void *param, int error)
+{
+	struct dma_sync_wait *w = param;
+
+	w->error = error;
+	vmm_completion_complete(&w->done);
+}
+
+static int dma_sync_submit(struct vmm_dma_tx *tx, struct dma_sync_wait *w)
+{
+	int rc;
+
+	if (!tx) {
+		return VMM_EINVALID;
+	}
+
+	rc = vmm_dma_submit(tx);
+	if (rc) {
+		vmm_dma_tx_free(tx);
+		return rc;
+	}
+
+	vmm_completion_wait(&w->done);
+
+	return w->error;
+}
+
+int vmm_dma_memcpy_sync(struct vmm_dma_chan *chan,
+			physical_addr_t dst, physical_addr_t src,
+			physical_size_t len)
+{
+	struct dma_sync_wait w;
+
+	INIT_COMPLETION(&w.done);
+	w.error = VMM_OK;
+
+	return dma_sync_submit(vmm_dma_prep_memcpy(chan, dst, src, len,
+						   dma_sync_callback, &w), &w);
+}
+VMM_EXPORT_SYMBOL(vmm_dma_memcpy_sync);
+
+int vmm_dma_memset_sync(struct vmm_dma_chan *chan,
+			physical_addr_t dst, u8 value,
+			physical_size_t len)
+{
+	struct dma_sync_wait w;
+
+	INIT_COMPLETION(&w.done);
+	w.error = VMM_OK;
+
+	return dma_sync_submit(vmm_dma_prep_memset(chan, dst, value, len,
+						   dma_sync_callback, &w), &w);
+}
+VMM_EXPORT_SYMBOL(vmm_dma_memset_sync);
+
+static int __init vmm_dmaengine_init(void)
+{
+	/* Nothing to do here. */
+	return VMM_OK;
+}
+
+static void __exit vmm_dmaengine_exit(void)
+{
+	/* Nothing to do here. */
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
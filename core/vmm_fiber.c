@@ -0,0 +1,350 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_fiber.c
+ * @author agent (agent@local)
+ * @brief Lightweight cooperative fiber implementation
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_fiber.h>
+#include <libs/stringlib.h>
+
+static void fiber_sleep_timeout(struct vmm_timer_event *ev)
+{
+	vmm_fiber_wake(ev->priv);
+}
+
+void vmm_fiber_prepare_wait(struct vmm_fiber *f, struct vmm_waitqueue *wq)
+{
+	irq_flags_t flags;
+
+	BUG_ON(!f || !wq);
+
+	vmm_spin_lock_irqsave(&wq->lock, flags);
+
+	if (!f->wq) {
+		list_add_tail(&f->wq_head, &wq->fiber_list);
+		f->wq = wq;
+	}
+	BUG_ON(f->wq != wq);
+
+	vmm_spin_unlock_irqrestore(&wq->lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_fiber_prepare_wait);
+
+void vmm_fiber_finish_wait(struct vmm_fiber *f)
+{
+	irq_flags_t flags;
+	struct vmm_waitqueue *wq;
+
+	BUG_ON(!f);
+
+	/* Waker removes fiber from waitqueue before setting f->wq to NULL */
+	wq = f->wq;
+	if (!wq) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&wq->lock, flags);
+
+	if (f->wq == wq) {
+		list_del(&f->wq_head);
+		f->wq = NULL;
+	}
+
+	vmm_spin_unlock_irqrestore(&wq->lock, flags);
+}
+VMM_EXPORT_SYMBOL(vmm_fiber_finish_wait);
+
+bool vmm_fiber_completion_try(struct vmm_fiber *f,
+			      struct vmm_completion *cmpl)
+{
+	bool ret = FALSE;
+	irq_flags_t flags;
+
+	BUG_ON(!f || !cmpl);
+
+	vmm_spin_lock_irqsave(&cmpl->wq.lock, flags);
+
+	if (cmpl->done) {
+		cmpl->done--;
+		if (f->wq == &cmpl->wq) {
+			list_del(&f->wq_head);
+			f->wq = NULL;
+		}
+		ret = TRUE;
+	} else if (!f->wq) {
+		list_add_tail(&f->wq_head, &cmpl->wq.fiber_list);
+		f->wq = &cmpl->wq;
+	}
+
+	vmm_spin_unlock_irqrestore(&cmpl->wq.lock, flags);
+
+	return ret;
+}
+VMM_EXPORT_SYMBOL(vmm_fiber_completion_try);
+
+void vmm_fiber_sleep_start(struct vmm_fiber *f, u64 nsecs)
+{
+	BUG_ON(!f);
+
+	vmm_timer_event_start(&f->ev, nsecs);
+}
+VMM_EXPORT_SYMBOL(vmm_fiber_sleep_start);
+
+int __vmm_fiber_waitqueue_wake(struct vmm_fiber *f)
+{
+	BUG_ON(!f || !f->wq);
+
+	list_del(&f->wq_head);
+	f->wq = NULL;
+
+	return vmm_fiber_wake(f);
+}
+
+int vmm_fiber_wake(struct vmm_fiber *f)
+{
+	int rc = VMM_OK;
+	irq_flags_t flags;
+	struct vmm_fiber_group *grp;
+
+	if (!f || !f->grp) {
+		return VMM_EINVALID;
+	}
+	grp = f->grp;
+
+	vmm_spin_lock_irqsave(&grp->lock, flags);
+
+	switch (f->state) {
+	case VMM_FIBER_STATE_WAITING:
+		f->state = VMM_FIBER_STATE_READY;
+		list_add_tail(&f->rq_head, &grp->run_list);
+		vmm_completion_complete_once(&grp->run_avail);
+		break;
+	case VMM_FIBER_STATE_RUNNING:
+		/* Fiber is about to wait so let it run again instead */
+		f->wake_pending = TRUE;
+		break;
+	case VMM_FIBER_STATE_READY:
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	};
+
+	vmm_spin_unlock_irqrestore(&grp->lock, flags);
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vmm_fiber_wake);
+
+void vmm_fiber_init(struct vmm_fiber *f, const char *name,
+		    int (*func)(struct vmm_fiber *f), void *priv)
+{
+	BUG_ON(!f || !name || !func);
+
+	INIT_LIST_HEAD(&f->head);
+	INIT_LIST_HEAD(&f->rq_head);
+	INIT_LIST_HEAD(&f->wq_head);
+	f->wq = NULL;
+	f->grp = NULL;
+	strncpy(f->name, name, sizeof(f->name));
+	f->name[sizeof(f->name) - 1] = '\0';
+	f->state = VMM_FIBER_STATE_IDLE;
+	f->wake_pending = FALSE;
+	f->resume_point = 0;
+	INIT_TIMER_EVENT(&f->ev, fiber_sleep_timeout, f);
+	f->func = func;
+	f->priv = priv;
+}
+VMM_EXPORT_SYMBOL(vmm_fiber_init);
+
+int vmm_fiber_start(struct vmm_fiber_group *grp, struct vmm_fiber *f)
+{
+	irq_flags_t flags;
+
+	if (!grp || !f || !f->func) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave(&grp->lock, flags);
+
+	if ((f->state != VMM_FIBER_STATE_IDLE) &&
+	    (f->state != VMM_FIBER_STATE_EXITED)) {
+		vmm_spin_unlock_irqrestore(&grp->lock, flags);
+		return VMM_EBUSY;
+	}
+
+	f->grp = grp;
+	f->state = VMM_FIBER_STATE_READY;
+	f->wake_pending = FALSE;
+	f->resume_point = 0;
+	list_add_tail(&f->head, &grp->fiber_list);
+	grp->fiber_count++;
+	list_add_tail(&f->rq_head, &grp->run_list);
+	vmm_completion_complete_once(&grp->run_avail);
+
+	vmm_spin_unlock_irqrestore(&grp->lock, flags);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_fiber_start);
+
+u32 vmm_fiber_group_count(struct vmm_fiber_group *grp)
+{
+	return (grp) ? grp->fiber_count : 0;
+}
+VMM_EXPORT_SYMBOL(vmm_fiber_group_count);
+
+static void fiber_group_run(struct vmm_fiber_group *grp, struct vmm_fiber *f)
+{
+	int ret;
+	irq_flags_t flags;
+
+	ret = f->func(f);
+
+	if (ret == VMM_FIBER_EXITED) {
+		vmm_timer_event_stop(&f->ev);
+		vmm_fiber_finish_wait(f);
+	}
+
+	vmm_spin_lock_irqsave(&grp->lock, flags);
+
+	switch (ret) {
+	case VMM_FIBER_WAITING:
+		if (!f->wake_pending) {
+			f->state = VMM_FIBER_STATE_WAITING;
+			break;
+		}
+		/* Fall through */
+	case VMM_FIBER_YIELDED:
+		f->state = VMM_FIBER_STATE_READY;
+		list_add_tail(&f->rq_head, &grp->run_list);
+		break;
+	default:
+		f->state = VMM_FIBER_STATE_EXITED;
+		list_del(&f->head);
+		grp->fiber_count--;
+		break;
+	};
+	f->wake_pending = FALSE;
+
+	vmm_spin_unlock_irqrestore(&grp->lock, flags);
+}
+
+static int fiber_group_main(void *data)
+{
+	irq_flags_t flags;
+	struct vmm_fiber *f;
+	struct vmm_fiber_group *grp = data;
+
+	if (!grp) {
+		return VMM_EFAIL;
+	}
+
+	while (1) {
+		vmm_completion_wait(&grp->run_avail);
+
+		vmm_spin_lock_irqsave(&grp->lock, flags);
+
+		while (!list_empty(&grp->run_list)) {
+			f = list_first_entry(&grp->run_list,
+					     struct vmm_fiber, rq_head);
+			list_del(&f->rq_head);
+			f->state = VMM_FIBER_STATE_RUNNING;
+			vmm_spin_unlock_irqrestore(&grp->lock, flags);
+
+			fiber_group_run(grp, f);
+
+			vmm_spin_lock_irqsave(&grp->lock, flags);
+		}
+
+		vmm_spin_unlock_irqrestore(&grp->lock, flags);
+	}
+
+	return VMM_OK;
+}
+
+struct vmm_fiber_group *vmm_fiber_group_create(const char *name,
+						u8 priority)
+{
+	struct vmm_fiber_group *grp;
+
+	if (!name) {
+		return NULL;
+	}
+
+	grp = vmm_zalloc(sizeof(struct vmm_fiber_group));
+	if (!grp) {
+		return NULL;
+	}
+
+	strncpy(grp->name, name, sizeof(grp->name));
+	grp->name[sizeof(grp->name) - 1] = '\0';
+	INIT_SPIN_LOCK(&grp->lock);
+	INIT_LIST_HEAD(&grp->fiber_list);
+	grp->fiber_count = 0;
+	INIT_LIST_HEAD(&grp->run_list);
+	INIT_COMPLETION(&grp->run_avail);
+
+	grp->thread = vmm_threads_create(grp->name, fiber_group_main, grp,
+					 priority, VMM_THREAD_DEF_TIME_SLICE);
+	if (!grp->thread) {
+		vmm_free(grp);
+		return NULL;
+	}
+
+	if (vmm_threads_start(grp->thread)) {
+		vmm_threads_destroy(grp->thread);
+		vmm_free(grp);
+		return NULL;
+	}
+
+	return grp;
+}
+VMM_EXPORT_SYMBOL(vmm_fiber_group_create);
+
+int vmm_fiber_group_destroy(struct vmm_fiber_group *grp)
+{
+	int rc;
+
+	if (!grp) {
+		return VMM_EINVALID;
+	}
+
+	if (grp->fiber_count) {
+		return VMM_EBUSY;
+	}
+
+	if ((rc = vmm_threads_stop(grp->thread))) {
+		return rc;
+	}
+
+	if ((rc = vmm_threads_destroy(grp->thread))) {
+		return rc;
+	}
+
+	vmm_free(grp);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(vmm_fiber_group_destroy);
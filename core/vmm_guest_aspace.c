@@ -31,11 +31,31 @@
 #include <vmm_devemu.h>
 #include <vmm_host_ram.h>
 #include <vmm_host_aspace.h>
+#include <vmm_host_vapool.h>
 #include <vmm_guest_aspace.h>
 #include <vmm_stdio.h>
 #include <vmm_notifier.h>
+#include <vmm_mutex.h>
+#include <vmm_scheduler.h>
+#include <vmm_wallclock.h>
 #include <arch_guest.h>
+#include <arch_cpu_aspace.h>
+#include <arch_barrier.h>
+#include <arch_config.h>
 #include <libs/stringlib.h>
+#include <libs/bitmap.h>
+#include <libs/buddy.h>
+
+/* Persistent linear map of guest RAM needs a dedicated hypervisor VA
+ * window (64-bit hosts) and huge page mappings from arch.
+ */
+#if defined(CONFIG_GUEST_LINEAR_MAP) && \
+    defined(ARCH_HAS_GUEST_LINEAR_MAP) && defined(ARCH_HAS_HOST_HUGEPAGE)
+#define GUEST_LINEAR_MAP
+#define region_linear_va(reg)	((reg)->linear_va)
+#else
+#define region_linear_va(reg)	0
+#endif
 
 static BLOCKING_NOTIFIER_CHAIN(guest_aspace_notifier_chain);
 
@@ -55,32 +75,59 @@ int vmm_guest_aspace_unregister_client(struct vmm_notifier_block *nb)
 	return rc;
 }
 
-struct vmm_region *vmm_guest_find_region(struct vmm_guest *guest,
-					 physical_addr_t gphys_addr,
-					 u32 reg_flags, bool resolve_alias)
+/* Get current VCPU if its region lookup cache can be used for
+ * given address space. The cache is flushed whenever region trees
+ * of address space changed since last lookup.
+ */
+static struct vmm_vcpu *region_cache_vcpu(struct vmm_guest_aspace *aspace)
 {
-	bool found = FALSE;
-	u32 cmp_flags;
-	irq_flags_t flags;
-	vmm_rwlock_t *root_lock = NULL;
-	struct rb_root *root = NULL;
-	struct rb_node *pos = NULL;
-	struct vmm_region *reg = NULL;
-	struct vmm_guest_aspace *aspace;
+	u32 gen;
+	struct vmm_vcpu *vcpu;
 
-	if (!guest) {
+	if (!vmm_scheduler_normal_context()) {
 		return NULL;
 	}
-	if (!guest->aspace.initialized) {
+
+	vcpu = vmm_scheduler_current_vcpu();
+	if (!vcpu || (vcpu->guest != aspace->guest)) {
 		return NULL;
 	}
-	aspace = &guest->aspace;
 
-	/* Determine flags we need to compare */
-	cmp_flags = reg_flags & ~VMM_REGION_MANIFEST_MASK;
+	gen = arch_atomic_read(&aspace->reg_gen);
+	if (vcpu->reg_cache_gen != gen) {
+		memset(vcpu->reg_cache, 0, sizeof(vcpu->reg_cache));
+		vcpu->reg_cache_next = 0;
+		vcpu->reg_cache_gen = gen;
+	}
+
+	return vcpu;
+}
+
+static struct vmm_region *region_find(struct vmm_guest_aspace *aspace,
+				      struct vmm_vcpu *vcpu, bool is_io,
+				      physical_addr_t gphys_addr)
+{
+	u32 i;
+	irq_flags_t flags;
+	vmm_rwlock_t *root_lock;
+	struct rb_root *root;
+	struct rb_node *pos;
+	struct vmm_region *reg;
+
+	/* Try lock-free lookup in per-VCPU cache */
+	if (vcpu) {
+		for (i = 0; i < VMM_VCPU_REGION_CACHE_SIZE; i++) {
+			reg = vcpu->reg_cache[i];
+			if (reg &&
+			    (is_io == ((reg->flags & VMM_REGION_IO) ? 1 : 0)) &&
+			    (VMM_REGION_GPHYS_START(reg) <= gphys_addr) &&
+			    (gphys_addr < VMM_REGION_GPHYS_END(reg))) {
+				return reg;
+			}
+		}
+	}
 
-	/* Find out region tree root */
-	if (reg_flags & VMM_REGION_IO) {
+	if (is_io) {
 		root = &aspace->reg_iotree;
 		root_lock = &aspace->reg_iotree_lock;
 	} else {
@@ -88,9 +135,7 @@ struct vmm_region *vmm_guest_find_region(struct vmm_guest *guest,
 		root_lock = &aspace->reg_memtree_lock;
 	}
 
-	/* Try to find region ignoring required manifest flags */
 	reg = NULL;
-	found = FALSE;
 	vmm_read_lock_irqsave_lite(root_lock, flags);
 	pos = root->rb_node;
 	while (pos) {
@@ -100,14 +145,50 @@ struct vmm_region *vmm_guest_find_region(struct vmm_guest *guest,
 		} else if (VMM_REGION_GPHYS_END(reg) <= gphys_addr) {
 			pos = pos->rb_right;
 		} else {
-			if ((reg->flags & cmp_flags) == cmp_flags) {
-				found = TRUE;
-			}
 			break;
 		}
+		reg = NULL;
 	}
 	vmm_read_unlock_irqrestore_lite(root_lock, flags);
-	if (!found) {
+
+	/* Replace cache entries in round-robin fashion */
+	if (reg && vcpu) {
+		vcpu->reg_cache[vcpu->reg_cache_next] = reg;
+		vcpu->reg_cache_next =
+			(vcpu->reg_cache_next + 1) % VMM_VCPU_REGION_CACHE_SIZE;
+	}
+
+	return reg;
+}
+
+struct vmm_region *vmm_guest_find_region(struct vmm_guest *guest,
+					 physical_addr_t gphys_addr,
+					 u32 reg_flags, bool resolve_alias)
+{
+	bool is_io;
+	u32 cmp_flags;
+	struct vmm_vcpu *vcpu;
+	struct vmm_region *reg = NULL;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest) {
+		return NULL;
+	}
+	if (!guest->aspace.initialized) {
+		return NULL;
+	}
+	aspace = &guest->aspace;
+	vcpu = region_cache_vcpu(aspace);
+
+	/* Determine flags we need to compare */
+	cmp_flags = reg_flags & ~VMM_REGION_MANIFEST_MASK;
+
+	/* Find out region tree */
+	is_io = (reg_flags & VMM_REGION_IO) ? TRUE : FALSE;
+
+	/* Try to find region ignoring required manifest flags */
+	reg = region_find(aspace, vcpu, is_io, gphys_addr);
+	if (!reg || ((reg->flags & cmp_flags) != cmp_flags)) {
 		return NULL;
 	}
 
@@ -119,25 +200,8 @@ struct vmm_region *vmm_guest_find_region(struct vmm_guest *guest,
 	/* Resolve aliased regions */
 	while (reg->flags & VMM_REGION_ALIAS) {
 		gphys_addr = VMM_REGION_GPHYS_TO_HPHYS(reg, gphys_addr);
-		reg = NULL;
-		found = FALSE;
-		vmm_read_lock_irqsave_lite(root_lock, flags);
-		pos = root->rb_node;
-		while (pos) {
-			reg = rb_entry(pos, struct vmm_region, head);
-			if (gphys_addr < VMM_REGION_GPHYS_START(reg)) {
-				pos = pos->rb_left;
-			} else if (VMM_REGION_GPHYS_END(reg) <= gphys_addr) {
-				pos = pos->rb_right;
-			} else {
-				if ((reg->flags & cmp_flags) == cmp_flags) {
-					found = TRUE;
-				}
-				break;
-			}
-		}
-		vmm_read_unlock_irqrestore_lite(root_lock, flags);
-		if (!found) {
+		reg = region_find(aspace, vcpu, is_io, gphys_addr);
+		if (!reg || ((reg->flags & cmp_flags) != cmp_flags)) {
 			return NULL;
 		}
 	}
@@ -148,6 +212,16 @@ done:
 		return NULL;
 	}
 
+	/* Lazy region gets host RAM upon first lookup */
+	if (unlikely(reg->flags & VMM_REGION_ISLAZY)) {
+		if (!(reg->flags & VMM_REGION_ISHOSTRAM) &&
+		    vmm_guest_populate_region(guest, reg)) {
+			return NULL;
+		}
+		/* Pairs with barrier in vmm_guest_populate_region() */
+		arch_smp_rmb();
+	}
+
 	return reg;
 }
 
@@ -175,8 +249,13 @@ u32 vmm_guest_memory_read(struct vmm_guest *guest,
 		to_read = ((len - bytes_read) < to_read) ? 
 			  (len - bytes_read) : to_read;
 
-		to_read = vmm_host_memory_read(hphys_addr,
-					       dst, to_read, cacheable);
+		if (region_linear_va(reg) && cacheable) {
+			memcpy(dst, (void *)(region_linear_va(reg) +
+				(gphys_addr - reg->gphys_addr)), to_read);
+		} else {
+			to_read = vmm_host_memory_read(hphys_addr,
+						dst, to_read, cacheable);
+		}
 		if (!to_read) {
 			break;
 		}
@@ -204,7 +283,7 @@ u32 vmm_guest_memory_write(struct vmm_guest *guest,
 	while (bytes_written < len) {
 		reg = vmm_guest_find_region(guest, gphys_addr, 
 				VMM_REGION_REAL | VMM_REGION_MEMORY, TRUE);
-		if (!reg) {
+		if (!reg || (reg->flags & VMM_REGION_ISSHARED)) {
 			break;
 		}
 
@@ -213,8 +292,13 @@ u32 vmm_guest_memory_write(struct vmm_guest *guest,
 		to_write = ((len - bytes_written) < to_write) ? 
 			   (len - bytes_written) : to_write;
 
-		to_write = vmm_host_memory_write(hphys_addr,
-						 src, to_write, cacheable);
+		if (region_linear_va(reg) && cacheable) {
+			memcpy((void *)(region_linear_va(reg) +
+				(gphys_addr - reg->gphys_addr)), src, to_write);
+		} else {
+			to_write = vmm_host_memory_write(hphys_addr,
+						src, to_write, cacheable);
+		}
 		if (!to_write) {
 			break;
 		}
@@ -227,6 +311,287 @@ u32 vmm_guest_memory_write(struct vmm_guest *guest,
 	return bytes_written;
 }
 
+#define MAPCACHE_WIN_VA(mc, i)	\
+		((mc)->va + (i) * VMM_GUEST_MAPCACHE_WINDOW_SIZE)
+
+/* Note: Must be called with mc->lock held */
+static void mapcache_unmap(struct vmm_guest_mapcache *mc, u32 i)
+{
+	virtual_addr_t off;
+
+	for (off = 0; off < VMM_GUEST_MAPCACHE_WINDOW_SIZE;
+	     off += VMM_PAGE_SIZE) {
+		arch_cpu_aspace_unmap(MAPCACHE_WIN_VA(mc, i) + off);
+	}
+	mc->win[i].valid = FALSE;
+	mc->win[i].mapped = FALSE;
+}
+
+/* Note: Must be called with mc->lock held */
+static int mapcache_map(struct vmm_guest_mapcache *mc, u32 i,
+			physical_addr_t gphys_addr)
+{
+	physical_addr_t hphys_addr;
+	virtual_addr_t off;
+	struct vmm_region *reg;
+
+	/* Only windows fully inside one real RAM region are cached */
+	reg = vmm_guest_find_region(mc->guest, gphys_addr,
+				    VMM_REGION_REAL | VMM_REGION_MEMORY, TRUE);
+	if (!reg || !(reg->flags & VMM_REGION_ISRAM) ||
+	    (VMM_REGION_GPHYS_END(reg) <
+	     (gphys_addr + VMM_GUEST_MAPCACHE_WINDOW_SIZE))) {
+		return VMM_ENOTAVAIL;
+	}
+	hphys_addr = VMM_REGION_GPHYS_TO_HPHYS(reg, gphys_addr);
+
+	for (off = 0; off < VMM_GUEST_MAPCACHE_WINDOW_SIZE;
+	     off += VMM_PAGE_SIZE) {
+		if (arch_cpu_aspace_map(MAPCACHE_WIN_VA(mc, i) + off,
+					hphys_addr + off,
+					VMM_MEMORY_FLAGS_NORMAL)) {
+			while (off) {
+				off -= VMM_PAGE_SIZE;
+				arch_cpu_aspace_unmap(MAPCACHE_WIN_VA(mc, i) +
+						      off);
+			}
+			return VMM_EFAIL;
+		}
+	}
+
+	mc->win[i].gphys_addr = gphys_addr;
+	mc->win[i].valid = TRUE;
+	mc->win[i].mapped = TRUE;
+
+	return VMM_OK;
+}
+
+static int mapcache_get(struct vmm_guest_mapcache *mc,
+			physical_addr_t gphys_addr, u32 *index)
+{
+	int rc = VMM_ENOTAVAIL;
+	u32 i, gen;
+	irq_flags_t flags;
+
+	gphys_addr &= ~((physical_addr_t)VMM_GUEST_MAPCACHE_WINDOW_SIZE - 1);
+
+	vmm_spin_lock_irqsave_lite(&mc->lock, flags);
+
+	/* Drop all windows if guest regions changed */
+	gen = arch_atomic_read(&mc->guest->aspace.reg_gen);
+	if (mc->reg_gen != gen) {
+		for (i = 0; i < VMM_GUEST_MAPCACHE_WINDOW_COUNT; i++) {
+			mc->win[i].valid = FALSE;
+			if (mc->win[i].mapped && !mc->win[i].ref_count) {
+				mapcache_unmap(mc, i);
+			}
+		}
+		mc->reg_gen = gen;
+	}
+
+	for (i = 0; i < VMM_GUEST_MAPCACHE_WINDOW_COUNT; i++) {
+		if (mc->win[i].valid &&
+		    (mc->win[i].gphys_addr == gphys_addr)) {
+			goto found;
+		}
+	}
+
+	/* Replace windows in round-robin order skipping busy ones */
+	for (i = 0; i < VMM_GUEST_MAPCACHE_WINDOW_COUNT; i++) {
+		if (!mc->win[mc->victim].ref_count) {
+			break;
+		}
+		mc->victim = (mc->victim + 1) % VMM_GUEST_MAPCACHE_WINDOW_COUNT;
+	}
+	if (i == VMM_GUEST_MAPCACHE_WINDOW_COUNT) {
+		goto done;
+	}
+	i = mc->victim;
+	mc->victim = (mc->victim + 1) % VMM_GUEST_MAPCACHE_WINDOW_COUNT;
+
+	if (mc->win[i].mapped) {
+		mapcache_unmap(mc, i);
+	}
+	if (mapcache_map(mc, i, gphys_addr)) {
+		goto done;
+	}
+
+found:
+	mc->win[i].ref_count++;
+	*index = i;
+	rc = VMM_OK;
+done:
+	vmm_spin_unlock_irqrestore_lite(&mc->lock, flags);
+
+	return rc;
+}
+
+static void mapcache_put(struct vmm_guest_mapcache *mc, u32 i)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave_lite(&mc->lock, flags);
+	mc->win[i].ref_count--;
+	if (!mc->win[i].ref_count && !mc->win[i].valid &&
+	    mc->win[i].mapped) {
+		mapcache_unmap(mc, i);
+	}
+	vmm_spin_unlock_irqrestore_lite(&mc->lock, flags);
+}
+
+int vmm_guest_mapcache_get(struct vmm_guest_mapcache *mc,
+			   physical_addr_t gphys_addr, u32 len,
+			   virtual_addr_t *va, u32 *cookie)
+{
+	int rc;
+	u32 i, off;
+
+	if (!mc || !mc->va || !va || !cookie || !len) {
+		return VMM_EINVALID;
+	}
+
+	off = gphys_addr & (VMM_GUEST_MAPCACHE_WINDOW_SIZE - 1);
+	if ((VMM_GUEST_MAPCACHE_WINDOW_SIZE - off) < len) {
+		return VMM_ENOTAVAIL;
+	}
+
+	rc = mapcache_get(mc, gphys_addr, &i);
+	if (rc) {
+		return rc;
+	}
+
+	*va = MAPCACHE_WIN_VA(mc, i) + off;
+	*cookie = i;
+
+	return VMM_OK;
+}
+
+void vmm_guest_mapcache_put(struct vmm_guest_mapcache *mc, u32 cookie)
+{
+	if (!mc || !mc->va || (VMM_GUEST_MAPCACHE_WINDOW_COUNT <= cookie)) {
+		return;
+	}
+
+	mapcache_put(mc, cookie);
+}
+
+int vmm_guest_mapcache_init(struct vmm_guest_mapcache *mc,
+			    struct vmm_guest *guest)
+{
+	int rc;
+
+	if (!mc || !guest) {
+		return VMM_EFAIL;
+	}
+
+	memset(mc, 0, sizeof(*mc));
+	mc->guest = guest;
+	INIT_SPIN_LOCK(&mc->lock);
+	mc->reg_gen = arch_atomic_read(&guest->aspace.reg_gen);
+
+	rc = vmm_host_vapool_alloc(&mc->va, VMM_GUEST_MAPCACHE_WINDOW_SIZE *
+					    VMM_GUEST_MAPCACHE_WINDOW_COUNT);
+	if (rc) {
+		mc->va = 0;
+	}
+
+	return rc;
+}
+
+void vmm_guest_mapcache_exit(struct vmm_guest_mapcache *mc)
+{
+	u32 i;
+	irq_flags_t flags;
+
+	if (!mc || !mc->va) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&mc->lock, flags);
+	for (i = 0; i < VMM_GUEST_MAPCACHE_WINDOW_COUNT; i++) {
+		if (mc->win[i].mapped) {
+			mapcache_unmap(mc, i);
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&mc->lock, flags);
+
+	vmm_host_vapool_free(mc->va, VMM_GUEST_MAPCACHE_WINDOW_SIZE *
+				     VMM_GUEST_MAPCACHE_WINDOW_COUNT);
+	mc->va = 0;
+}
+
+u32 vmm_guest_mapcache_read(struct vmm_guest_mapcache *mc,
+			    physical_addr_t gphys_addr,
+			    void *dst, u32 len)
+{
+	u32 i, off, chunk, bytes_read = 0;
+
+	if (!mc || !mc->guest || !dst) {
+		return 0;
+	}
+
+	while (bytes_read < len) {
+		off = gphys_addr & (VMM_GUEST_MAPCACHE_WINDOW_SIZE - 1);
+		chunk = VMM_GUEST_MAPCACHE_WINDOW_SIZE - off;
+		chunk = ((len - bytes_read) < chunk) ?
+			(len - bytes_read) : chunk;
+
+		if (mc->va && !mapcache_get(mc, gphys_addr, &i)) {
+			memcpy(dst, (void *)MAPCACHE_WIN_VA(mc, i) + off,
+			       chunk);
+			mapcache_put(mc, i);
+		} else {
+			chunk = vmm_guest_memory_read(mc->guest, gphys_addr,
+						      dst, chunk, TRUE);
+			if (!chunk) {
+				break;
+			}
+		}
+
+		gphys_addr += chunk;
+		bytes_read += chunk;
+		dst += chunk;
+	}
+
+	return bytes_read;
+}
+
+u32 vmm_guest_mapcache_write(struct vmm_guest_mapcache *mc,
+			     physical_addr_t gphys_addr,
+			     void *src, u32 len)
+{
+	u32 i, off, chunk, bytes_written = 0;
+
+	if (!mc || !mc->guest || !src) {
+		return 0;
+	}
+
+	while (bytes_written < len) {
+		off = gphys_addr & (VMM_GUEST_MAPCACHE_WINDOW_SIZE - 1);
+		chunk = VMM_GUEST_MAPCACHE_WINDOW_SIZE - off;
+		chunk = ((len - bytes_written) < chunk) ?
+			(len - bytes_written) : chunk;
+
+		if (mc->va && !mapcache_get(mc, gphys_addr, &i)) {
+			memcpy((void *)MAPCACHE_WIN_VA(mc, i) + off, src,
+			       chunk);
+			mapcache_put(mc, i);
+		} else {
+			chunk = vmm_guest_memory_write(mc->guest, gphys_addr,
+						       src, chunk, TRUE);
+			if (!chunk) {
+				break;
+			}
+		}
+
+		gphys_addr += chunk;
+		bytes_written += chunk;
+		src += chunk;
+	}
+
+	return bytes_written;
+}
+
 int vmm_guest_physical_map(struct vmm_guest *guest,
 			   physical_addr_t gphys_addr,
 			   physical_size_t gphys_size,
@@ -428,46 +793,297 @@ static void region_overlap_message(const char *func,
 		   reg_overlap->gphys_addr, overlap_reg_size);
 }
 
-static int region_add(struct vmm_guest *guest,
-		      struct vmm_devtree_node *rnode,
-		      struct vmm_region **new_reg,
-		      void *rpriv,
-		      bool add_probe_list)
+/* Largest alignment order upto which host RAM of a pre-mapped or
+ * lazy region should match its guest physical address so that it
+ * can be mapped using large stage2 blocks.
+ */
+#define REGION_PREMAP_MAX_ORDER		30
+
+static physical_size_t region_alloc_host_ram_order(struct vmm_region *reg,
+						   u32 order, bool zero)
 {
-	int rc;
-	const char *aval;
-	irq_flags_t flags;
-	vmm_rwlock_t *root_lock = NULL;
-	struct dlist *root_plist = NULL;
-	struct rb_root *root = NULL;
-	struct rb_node **new = NULL, *pnode = NULL;
-	struct vmm_region *reg = NULL, *pnode_reg = NULL;
-	struct vmm_guest_aspace *aspace = &guest->aspace;
-	struct vmm_region *reg_overlap = NULL;
+	if (zero) {
+		return vmm_host_ram_alloc_zeroed(&reg->hphys_addr,
+				reg->phys_size, order,
+				(reg->flags & VMM_REGION_CACHEABLE) ? TRUE : FALSE);
+	}
 
-	/* Increment ref count of region node */
-	vmm_devtree_ref_node(rnode);
+	return vmm_host_ram_alloc(&reg->hphys_addr, reg->phys_size, order);
+}
 
-	/* Sanity check on region node */
-	if (!is_region_node_valid(rnode)) {
-		rc = VMM_EINVALID;
-		goto region_fail;
+static physical_size_t region_alloc_host_ram(struct vmm_region *reg,
+					     bool zero)
+{
+	u32 order;
+	physical_size_t ret;
+
+	if (reg->flags & (VMM_REGION_ISPREMAP | VMM_REGION_ISLAZY)) {
+		order = REGION_PREMAP_MAX_ORDER;
+		while ((order > reg->align_order) &&
+		       ((reg->gphys_addr & order_mask(order)) ||
+			(reg->phys_size & order_mask(order)))) {
+			order--;
+		}
+		if (order > reg->align_order) {
+			ret = region_alloc_host_ram_order(reg, order, zero);
+			if (ret) {
+				return ret;
+			}
+		}
 	}
 
-	/* Allocate region instance */
-	reg = vmm_zalloc(sizeof(struct vmm_region));
-	RB_CLEAR_NODE(&reg->head);
-	INIT_LIST_HEAD(&reg->phead);
+	return region_alloc_host_ram_order(reg, reg->align_order, zero);
+}
 
-	/* Fillup region details */
-	reg->node = rnode;
-	reg->aspace = aspace;
-	reg->flags = 0x0;
+#ifdef GUEST_LINEAR_MAP
 
-	rc = vmm_devtree_read_string(reg->node,
-			VMM_DEVTREE_MANIFEST_TYPE_ATTR_NAME, &aval);
+/* Guest RAM linear map window is allocated in units of huge pages
+ * so that it needs few hypervisor page tables. The house-keeping is
+ * only needed per free/allocated area hence it is small.
+ */
+#define LINEAR_MAP_MIN_BIN	ARCH_HOST_HUGEPAGE_SHIFT
+#define LINEAR_MAP_MAX_BIN	30
+#define LINEAR_MAP_HKSIZE	(16 * 1024)
+#define LINEAR_MAP_PAGE_SIZE	(1UL << ARCH_HOST_HUGEPAGE_SHIFT)
+
+static bool linear_map_ready = FALSE;
+static u8 linear_map_hk[LINEAR_MAP_HKSIZE] __aligned(sizeof(unsigned long));
+static struct buddy_allocator linear_map_ba;
+static DEFINE_SPINLOCK(linear_map_lock);
+
+static void region_linear_unmap_pages(virtual_addr_t va, physical_addr_t pa,
+				      virtual_size_t sz)
+{
+	virtual_size_t off = 0;
+
+	while (off < sz) {
+		if (!((va + off) & (LINEAR_MAP_PAGE_SIZE - 1)) &&
+		    !((pa + off) & (LINEAR_MAP_PAGE_SIZE - 1)) &&
+		    (LINEAR_MAP_PAGE_SIZE <= (sz - off)) &&
+		    !arch_cpu_aspace_hugepage_unmap(va + off)) {
+			off += LINEAR_MAP_PAGE_SIZE;
+			continue;
+		}
+		arch_cpu_aspace_unmap(va + off);
+		off += VMM_PAGE_SIZE;
+	}
+}
+
+/* Map host RAM of a region at a persistent hypervisor VA so that
+ * guest memory read/write become plain memcpy. Failure to do so is
+ * not fatal because accesses fall back to per-page temporary maps.
+ */
+static void region_linear_map(struct vmm_region *reg)
+{
+	int rc;
+	irq_flags_t flags;
+	unsigned long va;
+	virtual_size_t sz, off = 0;
+	physical_addr_t pa = reg->hphys_addr;
+
+	if (!(reg->flags & VMM_REGION_CACHEABLE) ||
+	    (pa & VMM_PAGE_MASK) ||
+	    (reg->phys_size & VMM_PAGE_MASK)) {
+		return;
+	}
+	sz = reg->phys_size;
+
+	vmm_spin_lock_irqsave(&linear_map_lock, flags);
+	if (!linear_map_ready) {
+		rc = buddy_allocator_init(&linear_map_ba, linear_map_hk,
+					  sizeof(linear_map_hk),
+					  ARCH_GUEST_LINEAR_MAP_START,
+					  ARCH_GUEST_LINEAR_MAP_SIZE,
+					  LINEAR_MAP_MIN_BIN,
+					  LINEAR_MAP_MAX_BIN);
+		linear_map_ready = (rc) ? FALSE : TRUE;
+	}
+	rc = (linear_map_ready) ?
+		buddy_mem_alloc(&linear_map_ba, sz, &va) : VMM_ENOTAVAIL;
+	vmm_spin_unlock_irqrestore(&linear_map_lock, flags);
 	if (rc) {
-		goto region_free_fail;
+		return;
+	}
+
+	while (off < sz) {
+		if (!((va + off) & (LINEAR_MAP_PAGE_SIZE - 1)) &&
+		    !((pa + off) & (LINEAR_MAP_PAGE_SIZE - 1)) &&
+		    (LINEAR_MAP_PAGE_SIZE <= (sz - off)) &&
+		    !arch_cpu_aspace_hugepage_map(va + off, pa + off,
+						  VMM_MEMORY_FLAGS_NORMAL)) {
+			off += LINEAR_MAP_PAGE_SIZE;
+			continue;
+		}
+		if (arch_cpu_aspace_map(va + off, pa + off,
+					VMM_MEMORY_FLAGS_NORMAL)) {
+			region_linear_unmap_pages(va, pa, off);
+			vmm_spin_lock_irqsave(&linear_map_lock, flags);
+			buddy_mem_free(&linear_map_ba, va);
+			vmm_spin_unlock_irqrestore(&linear_map_lock, flags);
+			return;
+		}
+		off += VMM_PAGE_SIZE;
+	}
+
+	reg->linear_va = va;
+}
+
+static void region_linear_unmap(struct vmm_region *reg)
+{
+	irq_flags_t flags;
+	virtual_addr_t va = reg->linear_va;
+
+	if (!va) {
+		return;
+	}
+	reg->linear_va = 0;
+
+	region_linear_unmap_pages(va, reg->hphys_addr, reg->phys_size);
+
+	vmm_spin_lock_irqsave(&linear_map_lock, flags);
+	buddy_mem_free(&linear_map_ba, va);
+	vmm_spin_unlock_irqrestore(&linear_map_lock, flags);
+}
+
+#else
+
+static inline void region_linear_map(struct vmm_region *reg) { }
+static inline void region_linear_unmap(struct vmm_region *reg) { }
+
+#endif
+
+/* Find alloced RAM/ROM region of template guest matching given region */
+static struct vmm_region *region_template_find(struct vmm_guest *guest,
+						struct vmm_region *reg)
+{
+	struct vmm_region *treg;
+	u32 mask = VMM_REGION_ISRAM | VMM_REGION_ISROM | VMM_REGION_ISALLOCED;
+
+	if (!guest->tmpl ||
+	    !(reg->flags & VMM_REGION_REAL) ||
+	    !(reg->flags & VMM_REGION_ISALLOCED)) {
+		return NULL;
+	}
+
+	treg = vmm_guest_find_region(guest->tmpl, reg->gphys_addr,
+				VMM_REGION_REAL | VMM_REGION_MEMORY, FALSE);
+	if (!treg ||
+	    (treg->gphys_addr != reg->gphys_addr) ||
+	    (treg->phys_size != reg->phys_size) ||
+	    ((treg->flags & mask) != (reg->flags & mask)) ||
+	    !(treg->flags & (VMM_REGION_ISHOSTRAM | VMM_REGION_ISSHARED))) {
+		return NULL;
+	}
+
+	return treg;
+}
+
+/* Copy host RAM contents of template region to given region */
+static int region_template_copy(struct vmm_region *reg,
+				struct vmm_region *treg)
+{
+	void *buf;
+	physical_size_t off;
+	u32 len, chunk = VMM_PAGE_SIZE * 16;
+
+	buf = vmm_malloc(chunk);
+	if (!buf) {
+		return VMM_ENOMEM;
+	}
+
+	for (off = 0; off < reg->phys_size; off += len) {
+		len = ((reg->phys_size - off) < chunk) ?
+					(reg->phys_size - off) : chunk;
+		if ((vmm_host_memory_read(treg->hphys_addr + off,
+					  buf, len, TRUE) != len) ||
+		    (vmm_host_memory_write(reg->hphys_addr + off,
+					   buf, len, TRUE) != len)) {
+			vmm_free(buf);
+			return VMM_EIO;
+		}
+	}
+
+	vmm_free(buf);
+
+	return VMM_OK;
+}
+
+int vmm_guest_populate_region(struct vmm_guest *guest,
+			      struct vmm_region *reg)
+{
+	int rc = VMM_OK;
+	irq_flags_t flags;
+
+	if (!guest || !reg) {
+		return VMM_EFAIL;
+	}
+	if (!(reg->flags & VMM_REGION_ISLAZY)) {
+		return VMM_OK;
+	}
+
+	/* Lookups can happen in any context hence only a spinlock
+	 * and no zeroing (unlike eagerly allocated RAM).
+	 */
+	vmm_spin_lock_irqsave_lite(&guest->aspace.lazy_lock, flags);
+	if (!(reg->flags & VMM_REGION_ISHOSTRAM)) {
+		if (region_alloc_host_ram(reg, FALSE)) {
+			/* Host address must be visible before the flag */
+			arch_smp_wmb();
+			reg->flags |= VMM_REGION_ISHOSTRAM;
+		} else {
+			rc = VMM_ENOMEM;
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&guest->aspace.lazy_lock, flags);
+
+	if (rc) {
+		vmm_printf("%s: Failed to alloc host RAM for %s/%s\n",
+			   __func__, guest->name, reg->node->name);
+	}
+
+	return rc;
+}
+
+static int region_add(struct vmm_guest *guest,
+		      struct vmm_devtree_node *rnode,
+		      struct vmm_region **new_reg,
+		      void *rpriv,
+		      bool add_probe_list)
+{
+	int rc;
+	const char *aval;
+	irq_flags_t flags;
+	vmm_rwlock_t *root_lock = NULL;
+	struct dlist *root_plist = NULL;
+	struct rb_root *root = NULL;
+	struct rb_node **new = NULL, *pnode = NULL;
+	struct vmm_region *reg = NULL, *pnode_reg = NULL;
+	struct vmm_guest_aspace *aspace = &guest->aspace;
+	struct vmm_region *reg_overlap = NULL, *treg;
+
+	/* Increment ref count of region node */
+	vmm_devtree_ref_node(rnode);
+
+	/* Sanity check on region node */
+	if (!is_region_node_valid(rnode)) {
+		rc = VMM_EINVALID;
+		goto region_fail;
+	}
+
+	/* Allocate region instance */
+	reg = vmm_zalloc(sizeof(struct vmm_region));
+	RB_CLEAR_NODE(&reg->head);
+	INIT_LIST_HEAD(&reg->phead);
+
+	/* Fillup region details */
+	reg->node = rnode;
+	reg->aspace = aspace;
+	reg->flags = 0x0;
+
+	rc = vmm_devtree_read_string(reg->node,
+			VMM_DEVTREE_MANIFEST_TYPE_ATTR_NAME, &aval);
+	if (rc) {
+		goto region_free_fail;
 	}
 
 	if (!strcmp(aval, VMM_DEVTREE_MANIFEST_TYPE_VAL_REAL)) {
@@ -565,6 +1181,14 @@ static int region_add(struct vmm_guest *guest,
 		reg->align_order = 0;
 	}
 
+	/* Real RAM/ROM regions can ask for eager stage2 mapping */
+	if ((reg->flags & VMM_REGION_REAL) &&
+	    (reg->flags & VMM_REGION_MEMORY) &&
+	    (reg->flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) &&
+	    vmm_devtree_getattr(reg->node, VMM_DEVTREE_PREMAP_ATTR_NAME)) {
+		reg->flags |= VMM_REGION_ISPREMAP;
+	}
+
 	reg->devemu_priv = NULL;
 	reg->priv = rpriv;
 
@@ -592,13 +1216,71 @@ static int region_add(struct vmm_guest *guest,
 		}
 	}
 
+	/* Alloced ROM region of one page can ask for the hypervisor
+	 * wallclock page which is then shared read-only with guest
+	 */
+	if ((reg->flags & VMM_REGION_REAL) &&
+	    (reg->flags & VMM_REGION_ISROM) &&
+	    (reg->flags & VMM_REGION_ISALLOCED) &&
+	    vmm_devtree_getattr(reg->node, VMM_DEVTREE_WALLCLOCK_ATTR_NAME)) {
+		if (reg->phys_size != VMM_PAGE_SIZE) {
+			vmm_printf("%s: Wallclock page region %s/%s must "
+				   "be one page\n", __func__,
+				   guest->name, reg->node->name);
+			rc = VMM_EINVALID;
+			goto region_free_fail;
+		}
+		reg->hphys_addr = vmm_wallclock_page_hphys();
+		reg->flags |= VMM_REGION_ISSHARED;
+		reg->flags |= VMM_REGION_CACHEABLE;
+		reg->flags |= VMM_REGION_BUFFERABLE;
+		rc = vmm_devtree_setattr(reg->node,
+				VMM_DEVTREE_HOST_PHYS_ATTR_NAME,
+				&reg->hphys_addr,
+				VMM_DEVTREE_ATTRTYPE_PHYSADDR,
+				sizeof(reg->hphys_addr), FALSE);
+		if (rc) {
+			goto region_free_fail;
+		}
+	}
+
+	/* Clones share host RAM of alloced ROM regions with template
+	 * which is mapped read-only in stage2 like any other ROM region
+	 */
+	treg = region_template_find(guest, reg);
+	if (treg && (reg->flags & VMM_REGION_ISROM) &&
+	    !(reg->flags & VMM_REGION_ISSHARED)) {
+		reg->hphys_addr = treg->hphys_addr;
+		reg->flags |= VMM_REGION_ISSHARED;
+		rc = vmm_devtree_setattr(reg->node,
+				VMM_DEVTREE_HOST_PHYS_ATTR_NAME,
+				&reg->hphys_addr,
+				VMM_DEVTREE_ATTRTYPE_PHYSADDR,
+				sizeof(reg->hphys_addr), FALSE);
+		if (rc) {
+			goto region_free_fail;
+		}
+	}
+
+	/* Alloced RAM regions of non-clones can defer host RAM allocation
+	 * till first lookup of region
+	 */
+	if (!treg &&
+	    (reg->flags & VMM_REGION_REAL) &&
+	    (reg->flags & VMM_REGION_ISRAM) &&
+	    (reg->flags & VMM_REGION_ISALLOCED) &&
+	    vmm_devtree_getattr(reg->node, VMM_DEVTREE_LAZY_ATTR_NAME)) {
+		reg->flags |= VMM_REGION_ISLAZY;
+		reg->flags &= ~VMM_REGION_ISPREMAP;
+		reg->hphys_addr = 0x0;
+	}
+
 	/* Allocate host RAM for alloced RAM/ROM regions */
 	if (!(reg->flags & (VMM_REGION_ALIAS | VMM_REGION_VIRTUAL)) &&
 	    (reg->flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) &&
-	    (reg->flags & VMM_REGION_ISALLOCED)) {
-		if (!vmm_host_ram_alloc(&reg->hphys_addr,
-					reg->phys_size,
-					reg->align_order)) {
+	    (reg->flags & VMM_REGION_ISALLOCED) &&
+	    !(reg->flags & (VMM_REGION_ISSHARED | VMM_REGION_ISLAZY))) {
+		if (!region_alloc_host_ram(reg, TRUE)) {
 			vmm_printf("%s: Failed to alloc "
 				   "host RAM for %s/%s\n",
 				   __func__, guest->name,
@@ -619,13 +1301,22 @@ static int region_add(struct vmm_guest *guest,
 					   guest->name, reg->node->name);
 				goto region_free_fail;
 			}
-			if (reg->flags & VMM_REGION_ISROM) {
-				vmm_host_memory_set(reg->hphys_addr, 0,
-						    reg->phys_size, FALSE);
-			}
+		}
+		if (treg && (rc = region_template_copy(reg, treg))) {
+			vmm_printf("%s: Failed to copy template RAM "
+				   "for %s/%s\n", __func__,
+				   guest->name, reg->node->name);
+			goto region_ram_free_fail;
 		}
 	}
 
+	/* Linear map host RAM of real RAM/ROM regions */
+	if ((reg->flags & VMM_REGION_REAL) &&
+	    (reg->flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) &&
+	    (reg->flags & VMM_REGION_ISHOSTRAM)) {
+		region_linear_map(reg);
+	}
+
 	/* Probe device emulation for real & virtual device regions */
 	if ((reg->flags & VMM_REGION_ISDEVICE) &&
 	    !(reg->flags & VMM_REGION_ALIAS)) {
@@ -669,6 +1360,7 @@ static int region_add(struct vmm_guest *guest,
 	}
 	rb_link_node(&reg->head, pnode, new);
 	rb_insert_color(&reg->head, root);
+	arch_atomic_inc(&aspace->reg_gen);
 	if (add_probe_list) {
 		list_add_tail(&reg->phead, root_plist);
 	}
@@ -688,6 +1380,7 @@ region_unprobe_fail:
 		vmm_devemu_remove_region(guest, reg);
 	}
 region_ram_free_fail:
+	region_linear_unmap(reg);
 	if (!(reg->flags & (VMM_REGION_ALIAS | VMM_REGION_VIRTUAL)) &&
 	    (reg->flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) &&
 	    (reg->flags & VMM_REGION_ISHOSTRAM)) {
@@ -698,6 +1391,10 @@ region_ram_free_fail:
 		vmm_host_ram_free(reg->hphys_addr,
 				  reg->phys_size);
 	}
+	if (reg->flags & VMM_REGION_ISSHARED) {
+		vmm_devtree_delattr(reg->node,
+				    VMM_DEVTREE_HOST_PHYS_ATTR_NAME);
+	}
 region_free_fail:
 	vmm_free(reg);
 region_fail:
@@ -728,6 +1425,7 @@ static int region_del(struct vmm_guest *guest,
 		}
 		vmm_write_lock_irqsave_lite(root_lock, flags);
 		rb_erase(&reg->head, root);
+		arch_atomic_inc(&aspace->reg_gen);
 		vmm_write_unlock_irqrestore_lite(root_lock, flags);
 	}
 
@@ -757,6 +1455,9 @@ static int region_del(struct vmm_guest *guest,
 		vmm_devemu_remove_region(guest, reg);
 	}
 
+	/* Remove linear map before host RAM is freed */
+	region_linear_unmap(reg);
+
 	/* Free host RAM if region has alloced/reserved host RAM */
 	if (!(reg->flags & (VMM_REGION_ALIAS | VMM_REGION_VIRTUAL)) &&
 	    (reg->flags & (VMM_REGION_ISRAM | VMM_REGION_ISROM)) &&
@@ -775,6 +1476,12 @@ static int region_del(struct vmm_guest *guest,
 		}
 	}
 
+	/* Shared host RAM belongs to template guest */
+	if (reg->flags & VMM_REGION_ISSHARED) {
+		vmm_devtree_delattr(reg->node,
+				    VMM_DEVTREE_HOST_PHYS_ATTR_NAME);
+	}
+
 	/* Free the region */
 	vmm_free(reg);
 
@@ -844,12 +1551,180 @@ int vmm_guest_aspace_reset(struct vmm_guest *guest)
 	return vmm_devemu_reset_context(guest);
 }
 
+static int guest_iterate_regions(struct vmm_guest *guest, bool is_io,
+			u32 reg_flags,
+			int (*iter)(struct vmm_guest *, struct vmm_region *, void *),
+			void *priv)
+{
+	int rc = VMM_OK;
+	irq_flags_t flags;
+	vmm_rwlock_t *root_lock;
+	struct rb_root *root;
+	struct vmm_guest_aspace *aspace;
+	struct vmm_region *reg = NULL, *next_reg = NULL;
+
+	/* Sanity Check */
+	if (!guest || !iter) {
+		return VMM_EFAIL;
+	}
+	if (!guest->aspace.initialized) {
+		return VMM_ENOTAVAIL;
+	}
+	aspace = &guest->aspace;
+
+	if (is_io) {
+		root = &aspace->reg_iotree;
+		root_lock = &aspace->reg_iotree_lock;
+	} else {
+		root = &aspace->reg_memtree;
+		root_lock = &aspace->reg_memtree_lock;
+	}
+
+	vmm_read_lock_irqsave_lite(root_lock, flags);
+	rbtree_postorder_for_each_entry_safe(reg, next_reg, root, head) {
+		if ((reg->flags & reg_flags) != reg_flags) {
+			continue;
+		}
+		vmm_read_unlock_irqrestore_lite(root_lock, flags);
+		rc = iter(guest, reg, priv);
+		vmm_read_lock_irqsave_lite(root_lock, flags);
+		if (rc) {
+			break;
+		}
+	}
+	vmm_read_unlock_irqrestore_lite(root_lock, flags);
+
+	return rc;
+}
+
+int vmm_guest_iterate_mem_regions(struct vmm_guest *guest, u32 reg_flags,
+			int (*iter)(struct vmm_guest *, struct vmm_region *, void *),
+			void *priv)
+{
+	return guest_iterate_regions(guest, FALSE, reg_flags, iter, priv);
+}
+
+int vmm_guest_iterate_io_regions(struct vmm_guest *guest, u32 reg_flags,
+			int (*iter)(struct vmm_guest *, struct vmm_region *, void *),
+			void *priv)
+{
+	return guest_iterate_regions(guest, TRUE, reg_flags, iter, priv);
+}
+
+/*
+ * Batches of all guests are serialized by one lock which is held by
+ * the batch owner till its outermost commit. The lock cannot live in
+ * struct vmm_guest_aspace because vmm_mutex.h depends on vmm_manager.h
+ */
+static DEFINE_MUTEX(guest_aspace_batch_lock);
+static u32 guest_aspace_batch_nesting;
+
+static bool guest_aspace_batch_owner(void)
+{
+	return (vmm_mutex_owner(&guest_aspace_batch_lock) ==
+		vmm_scheduler_current_vcpu()) ? TRUE : FALSE;
+}
+
+int vmm_guest_aspace_batch_begin(struct vmm_guest *guest)
+{
+	if (!guest) {
+		return VMM_EINVALID;
+	}
+
+	if (!guest_aspace_batch_owner()) {
+		vmm_mutex_lock(&guest_aspace_batch_lock);
+	}
+	guest_aspace_batch_nesting++;
+	guest->aspace.batch_depth++;
+
+	return VMM_OK;
+}
+
+int vmm_guest_aspace_batch_commit(struct vmm_guest *guest)
+{
+	int rc, ret = VMM_OK;
+	struct dlist changes;
+	struct vmm_devtree_node *rnode;
+	struct vmm_guest_aspace *aspace;
+	struct vmm_guest_aspace_event evt;
+	struct vmm_guest_aspace_batch batch;
+	struct vmm_guest_aspace_change *c, *nc;
+
+	if (!guest) {
+		return VMM_EINVALID;
+	}
+	aspace = &guest->aspace;
+	if (!aspace->batch_depth || !guest_aspace_batch_owner()) {
+		return VMM_EINVALID;
+	}
+
+	aspace->batch_depth--;
+	if (aspace->batch_depth || list_empty(&aspace->batch_list)) {
+		goto done;
+	}
+
+	/* Listeners may start their own batch so detach changes first */
+	INIT_LIST_HEAD(&changes);
+	list_splice_init(&aspace->batch_list, &changes);
+
+	batch.add_count = batch.del_count = 0;
+	list_for_each_entry(c, &changes, head) {
+		if (c->type == VMM_GUEST_ASPACE_EVENT_ADD_REGION) {
+			batch.add_count++;
+		} else {
+			batch.del_count++;
+		}
+	}
+	batch.changes = &changes;
+
+	evt.guest = guest;
+	evt.data = &batch;
+	vmm_blocking_notifier_call(&guest_aspace_notifier_chain,
+				   VMM_GUEST_ASPACE_EVENT_BATCH, &evt);
+
+	/* Deleted regions are released after all listeners saw them */
+	list_for_each_entry_safe(c, nc, &changes, head) {
+		list_del(&c->head);
+		if (c->type == VMM_GUEST_ASPACE_EVENT_DEL_REGION) {
+			rnode = c->reg->node;
+			rc = region_del(guest, c->reg, TRUE, FALSE);
+			if (rc) {
+				ret = (ret) ? ret : rc;
+			} else if (c->del_node) {
+				vmm_devtree_delnode(rnode);
+			}
+		}
+		vmm_free(c);
+	}
+
+done:
+	guest_aspace_batch_nesting--;
+	if (!guest_aspace_batch_nesting) {
+		vmm_mutex_unlock(&guest_aspace_batch_lock);
+	}
+
+	return ret;
+}
+
+/* Record dynamically added or deleted region in current batch */
+static void region_batch_record(struct vmm_guest *guest,
+				struct vmm_guest_aspace_change *c,
+				unsigned long type, struct vmm_region *reg,
+				bool del_node)
+{
+	c->type = type;
+	c->reg = reg;
+	c->del_node = del_node;
+	list_add_tail(&c->head, &guest->aspace.batch_list);
+}
+
 int vmm_guest_add_region_from_node(struct vmm_guest *guest,
 				   struct vmm_devtree_node *node,
 				   void *rpriv)
 {
-	int rc;
+	int rc, ret;
 	struct vmm_region *reg = NULL;
+	struct vmm_guest_aspace_change *c;
 
 	/* Sanity checks */
 	if (!guest || !guest->aspace.node || !node) {
@@ -859,35 +1734,51 @@ int vmm_guest_add_region_from_node(struct vmm_guest *guest,
 	/* TODO: Make sure aspace node is not parent of given node */
 	/* TODO: Make sure aspace node is ancestor of given node */
 
+	c = vmm_zalloc(sizeof(*c));
+	if (!c) {
+		return VMM_ENOMEM;
+	}
+
+	vmm_guest_aspace_batch_begin(guest);
+
 	/* Add region */
 	rc = region_add(guest, node, &reg, rpriv, FALSE);
 	if (rc) {
-		return rc;
+		vmm_free(c);
+		goto done;
 	}
 
 	/* Mark this region as dynamically added */
 	reg->flags |= VMM_REGION_ISDYNAMIC;
 
-	return VMM_OK;
+	region_batch_record(guest, c, VMM_GUEST_ASPACE_EVENT_ADD_REGION,
+			    reg, FALSE);
+
+done:
+	ret = vmm_guest_aspace_batch_commit(guest);
+	return (rc) ? rc : ret;
 }
 
-int vmm_guest_add_region(struct vmm_guest *guest,
-			 struct vmm_devtree_node *parent,
-			 const char *name,
-			 const char *device_type,
-			 const char *mainfest_type,
-			 const char *address_type,
-			 const char *compatible,
-			 u32 compatible_len,
-			 physical_addr_t gphys_addr,
-			 physical_addr_t hphys_addr,
-			 physical_size_t phys_size,
-			 u32 align_order,
-			 void *rpriv)
+static int guest_add_region(struct vmm_guest *guest,
+			    struct vmm_devtree_node *parent,
+			    const char *name,
+			    const char *device_type,
+			    const char *mainfest_type,
+			    const char *address_type,
+			    const char *compatible,
+			    u32 compatible_len,
+			    physical_addr_t gphys_addr,
+			    physical_addr_t hphys_addr,
+			    physical_size_t phys_size,
+			    u32 align_order,
+			    void *rpriv,
+			    bool lazy,
+			    struct vmm_region **out_reg)
 {
 	int rc;
 	struct vmm_region *reg = NULL;
 	struct vmm_devtree_node *rnode;
+	struct vmm_guest_aspace_change *c;
 
 	/* Sanity checks */
 	if (!guest || !guest->aspace.node || !parent ||
@@ -1002,16 +1893,45 @@ int vmm_guest_add_region(struct vmm_guest *guest,
 		goto failed_delnode;
 	}
 
+	/* Mark alloced RAM for host RAM allocation upon first lookup */
+	if (lazy) {
+		rc = vmm_devtree_setattr(rnode,
+					 VMM_DEVTREE_LAZY_ATTR_NAME,
+					 NULL,
+					 VMM_DEVTREE_ATTRTYPE_BYTEARRAY,
+					 0, FALSE);
+		if (rc) {
+			goto failed_delnode;
+		}
+	}
+
+	c = vmm_zalloc(sizeof(*c));
+	if (!c) {
+		rc = VMM_ENOMEM;
+		goto failed_delnode;
+	}
+
+	vmm_guest_aspace_batch_begin(guest);
+
 	/* Add region */
 	rc = region_add(guest, rnode, &reg, rpriv, FALSE);
 	if (rc) {
+		vmm_free(c);
+		vmm_guest_aspace_batch_commit(guest);
 		goto failed_delnode;
 	}
 
 	/* Mark this region as dynamically added */
 	reg->flags |= VMM_REGION_ISDYNAMIC;
 
-	return VMM_OK;
+	region_batch_record(guest, c, VMM_GUEST_ASPACE_EVENT_ADD_REGION,
+			    reg, FALSE);
+
+	if (out_reg) {
+		*out_reg = reg;
+	}
+
+	return vmm_guest_aspace_batch_commit(guest);
 
 failed_delnode:
 	vmm_devtree_delnode(rnode);
@@ -1020,12 +1940,52 @@ failed:
 	
 }
 
+int vmm_guest_add_region(struct vmm_guest *guest,
+			 struct vmm_devtree_node *parent,
+			 const char *name,
+			 const char *device_type,
+			 const char *mainfest_type,
+			 const char *address_type,
+			 const char *compatible,
+			 u32 compatible_len,
+			 physical_addr_t gphys_addr,
+			 physical_addr_t hphys_addr,
+			 physical_size_t phys_size,
+			 u32 align_order,
+			 void *rpriv)
+{
+	return guest_add_region(guest, parent, name, device_type,
+				mainfest_type, address_type,
+				compatible, compatible_len,
+				gphys_addr, hphys_addr, phys_size,
+				align_order, rpriv, FALSE, NULL);
+}
+
+int vmm_guest_hotplug_ram(struct vmm_guest *guest,
+			  const char *name,
+			  physical_addr_t gphys_addr,
+			  physical_size_t phys_size,
+			  struct vmm_region **out_reg)
+{
+	if (!guest || !name || !phys_size ||
+	    (gphys_addr & VMM_PAGE_MASK) || (phys_size & VMM_PAGE_MASK)) {
+		return VMM_EINVALID;
+	}
+
+	return guest_add_region(guest, guest->aspace.node, name,
+				VMM_DEVTREE_DEVICE_TYPE_VAL_ALLOCED_RAM,
+				VMM_DEVTREE_MANIFEST_TYPE_VAL_REAL,
+				VMM_DEVTREE_ADDRESS_TYPE_VAL_MEMORY,
+				NULL, 0, gphys_addr, 0x0, phys_size,
+				0, NULL, TRUE, out_reg);
+}
+
 int vmm_guest_del_region(struct vmm_guest *guest,
 			 struct vmm_region *reg,
 			 bool del_node)
 {
-	int rc;
-	struct vmm_devtree_node *rnode;
+	int rc = VMM_OK, ret;
+	struct vmm_guest_aspace_change *c;
 
 	/* Sanity checks */
 	if (!guest || !reg || !reg->node) {
@@ -1037,21 +1997,280 @@ int vmm_guest_del_region(struct vmm_guest *guest,
 	if (!(reg->flags & VMM_REGION_ISDYNAMIC)) {
 		return VMM_EINVALID;
 	}
-	rnode = reg->node;
 
-	/* Delete region */
-	rc = region_del(guest, reg, TRUE, FALSE);
-	if (rc) {
-		return rc;
+	vmm_guest_aspace_batch_begin(guest);
+
+	/* Region is deleted only once by outermost commit */
+	list_for_each_entry(c, &guest->aspace.batch_list, head) {
+		if ((c->reg == reg) &&
+		    (c->type == VMM_GUEST_ASPACE_EVENT_DEL_REGION)) {
+			rc = VMM_EALREADY;
+			goto done;
+		}
 	}
 
-	/* Delete region node if required */
-	if (del_node)
-		vmm_devtree_delnode(rnode);
+	c = vmm_zalloc(sizeof(*c));
+	if (!c) {
+		rc = VMM_ENOMEM;
+		goto done;
+	}
+
+	region_batch_record(guest, c, VMM_GUEST_ASPACE_EVENT_DEL_REGION,
+			    reg, del_node);
+
+done:
+	ret = vmm_guest_aspace_batch_commit(guest);
+	return (rc) ? rc : ret;
+}
+
+int vmm_guest_unplug_ram(struct vmm_guest *guest,
+			 struct vmm_region *reg)
+{
+	const u32 flags = VMM_REGION_REAL | VMM_REGION_MEMORY |
+			  VMM_REGION_ISRAM | VMM_REGION_ISALLOCED;
+
+	if (!reg || ((reg->flags & flags) != flags)) {
+		return VMM_EINVALID;
+	}
+
+	return vmm_guest_del_region(guest, reg, TRUE);
+}
+
+struct guest_dirty_log {
+	struct dlist head;
+	physical_addr_t gphys;
+	u32 page_count;
+	bool wprot;
+	unsigned long *bmap;
+};
+
+#define dirty_log_end(log)	\
+	((log)->gphys + ((physical_addr_t)(log)->page_count << VMM_PAGE_SHIFT))
+
+/* Note: This function must be called with dirty_log_lock held */
+static struct guest_dirty_log *__dirty_log_find(struct vmm_guest_aspace *aspace,
+						physical_addr_t gphys,
+						physical_size_t size)
+{
+	struct guest_dirty_log *log;
+
+	list_for_each_entry(log, &aspace->dirty_log_list, head) {
+		if ((gphys < dirty_log_end(log)) &&
+		    (log->gphys < (gphys + size))) {
+			return log;
+		}
+	}
+
+	return NULL;
+}
+
+int vmm_guest_dirty_log_start(struct vmm_guest *guest,
+			      physical_addr_t gphys,
+			      physical_size_t size)
+{
+	irq_flags_t flags;
+	struct guest_dirty_log *log;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest || !size) {
+		return VMM_EINVALID;
+	}
+	aspace = &guest->aspace;
+
+	log = vmm_zalloc(sizeof(*log));
+	if (!log) {
+		return VMM_ENOMEM;
+	}
+	INIT_LIST_HEAD(&log->head);
+	log->gphys = gphys & ~VMM_PAGE_MASK;
+	log->page_count = VMM_SIZE_TO_PAGE((gphys & VMM_PAGE_MASK) + size);
+	log->wprot = TRUE;
+	log->bmap = vmm_malloc(bitmap_estimate_size(log->page_count));
+	if (!log->bmap) {
+		vmm_free(log);
+		return VMM_ENOMEM;
+	}
+
+	/* Pages are writable until first get hence report all dirty */
+	bitmap_fill(log->bmap, log->page_count);
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_log_lock, flags);
+	if (__dirty_log_find(aspace, log->gphys, dirty_log_end(log) -
+						  log->gphys)) {
+		vmm_spin_unlock_irqrestore_lite(&aspace->dirty_log_lock,
+						flags);
+		vmm_free(log->bmap);
+		vmm_free(log);
+		return VMM_EEXIST;
+	}
+	list_add_tail(&log->head, &aspace->dirty_log_list);
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_log_lock, flags);
+
+	return VMM_OK;
+}
+
+int vmm_guest_dirty_log_stop(struct vmm_guest *guest,
+			     physical_addr_t gphys)
+{
+	irq_flags_t flags;
+	struct guest_dirty_log *log;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest) {
+		return VMM_EINVALID;
+	}
+	aspace = &guest->aspace;
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_log_lock, flags);
+	log = __dirty_log_find(aspace, gphys, 1);
+	if (log) {
+		list_del(&log->head);
+	}
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_log_lock, flags);
+
+	if (!log) {
+		return VMM_ENOTAVAIL;
+	}
+
+	/* Write-protected pages left behind are made writable
+	 * again by arch code upon next guest write.
+	 */
+	vmm_free(log->bmap);
+	vmm_free(log);
+
+	return VMM_OK;
+}
+
+int vmm_guest_dirty_log_get(struct vmm_guest *guest,
+			    physical_addr_t gphys,
+			    unsigned long *bitmap, u32 nbits)
+{
+	int rc;
+	bool wprot;
+	irq_flags_t flags;
+	u32 page_count, start, end;
+	physical_addr_t base;
+	struct guest_dirty_log *log;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest || !bitmap) {
+		return VMM_EINVALID;
+	}
+	aspace = &guest->aspace;
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_log_lock, flags);
+	log = __dirty_log_find(aspace, gphys, 1);
+	if (!log || (nbits < log->page_count)) {
+		vmm_spin_unlock_irqrestore_lite(&aspace->dirty_log_lock,
+						flags);
+		return (log) ? VMM_EINVALID : VMM_ENOTAVAIL;
+	}
+	base = log->gphys;
+	page_count = log->page_count;
+	wprot = log->wprot;
+	bitmap_copy(bitmap, log->bmap, page_count);
+	bitmap_zero(log->bmap, page_count);
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_log_lock, flags);
+
+	if (!wprot) {
+		bitmap_fill(bitmap, page_count);
+		return VMM_OK;
+	}
+
+	/* Write-protect pages reported dirty only after their bits
+	 * are cleared so that a racing guest write is never lost.
+	 */
+	start = find_first_bit(bitmap, page_count);
+	while (start < page_count) {
+		end = find_next_zero_bit(bitmap, page_count, start);
+		rc = arch_guest_write_protect(guest,
+				base + ((physical_addr_t)start << VMM_PAGE_SHIFT),
+				(physical_size_t)(end - start) << VMM_PAGE_SHIFT);
+		if (rc == VMM_ENOTSUPP) {
+			/* Without write-protection every page is dirty */
+			vmm_spin_lock_irqsave_lite(&aspace->dirty_log_lock,
+						   flags);
+			log->wprot = FALSE;
+			vmm_spin_unlock_irqrestore_lite(&aspace->dirty_log_lock,
+							flags);
+			bitmap_fill(bitmap, page_count);
+			break;
+		} else if (rc) {
+			return rc;
+		}
+		start = find_next_bit(bitmap, page_count, end);
+	}
 
 	return VMM_OK;
 }
 
+bool vmm_guest_dirty_log_wprot(struct vmm_guest *guest,
+			       physical_addr_t gphys,
+			       physical_size_t size)
+{
+	bool ret = FALSE;
+	irq_flags_t flags;
+	u32 start, end;
+	struct guest_dirty_log *log;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest) {
+		return FALSE;
+	}
+	aspace = &guest->aspace;
+
+	/* Fast path for stage2 faults when nothing is logged */
+	if (list_empty(&aspace->dirty_log_list)) {
+		return FALSE;
+	}
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_log_lock, flags);
+	list_for_each_entry(log, &aspace->dirty_log_list, head) {
+		if (!log->wprot ||
+		    (dirty_log_end(log) <= gphys) ||
+		    ((gphys + size) <= log->gphys)) {
+			continue;
+		}
+		start = (gphys <= log->gphys) ? 0 :
+			(gphys - log->gphys) >> VMM_PAGE_SHIFT;
+		end = ((gphys + size) >= dirty_log_end(log)) ?
+			log->page_count :
+			VMM_SIZE_TO_PAGE(gphys + size - log->gphys);
+		if (find_next_zero_bit(log->bmap, end, start) < end) {
+			ret = TRUE;
+			break;
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_log_lock, flags);
+
+	return ret;
+}
+
+void vmm_guest_dirty_log_mark(struct vmm_guest *guest,
+			      physical_addr_t gphys)
+{
+	irq_flags_t flags;
+	struct guest_dirty_log *log;
+	struct vmm_guest_aspace *aspace;
+
+	if (!guest) {
+		return;
+	}
+	aspace = &guest->aspace;
+
+	if (list_empty(&aspace->dirty_log_list)) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&aspace->dirty_log_lock, flags);
+	log = __dirty_log_find(aspace, gphys, 1);
+	if (log) {
+		bitmap_setbit(log->bmap,
+			      (gphys - log->gphys) >> VMM_PAGE_SHIFT);
+	}
+	vmm_spin_unlock_irqrestore_lite(&aspace->dirty_log_lock, flags);
+}
+
 int vmm_guest_aspace_init(struct vmm_guest *guest)
 {
 	int rc;
@@ -1086,6 +2305,10 @@ int vmm_guest_aspace_init(struct vmm_guest *guest)
 	INIT_RW_LOCK(&aspace->reg_memtree_lock);
 	aspace->reg_memtree = RB_ROOT;
 	INIT_LIST_HEAD(&aspace->reg_memprobe_list);
+	INIT_SPIN_LOCK(&aspace->dirty_log_lock);
+	INIT_LIST_HEAD(&aspace->dirty_log_list);
+	INIT_SPIN_LOCK(&aspace->lazy_lock);
+	INIT_LIST_HEAD(&aspace->batch_list);
 	guest->aspace.devemu_priv = NULL;
 
 	/* Initialize device emulation context */
@@ -1093,17 +2316,23 @@ int vmm_guest_aspace_init(struct vmm_guest *guest)
 		return rc;
 	}
 
-	/* Create regions */
+	/*
+	 * Create regions. Regions added dynamically while probing
+	 * emulators (such as PCI BARs) are notified as one batch.
+	 */
+	vmm_guest_aspace_batch_begin(guest);
 	vmm_devtree_for_each_child(rnode, aspace->node) {
 		rc = region_add(guest, rnode, NULL, NULL, TRUE);
 		if (rc) {
 			vmm_devtree_dref_node(rnode);
+			vmm_guest_aspace_batch_commit(guest);
 			return rc;
 		}
 	}
 
 	/* Mark address space as initialized */
 	aspace->initialized = TRUE;
+	vmm_guest_aspace_batch_commit(guest);
 
 	/*
 	 * Notify the listeners that init is complete.
@@ -1127,6 +2356,7 @@ int vmm_guest_aspace_deinit(struct vmm_guest *guest)
 	struct dlist *root_plist;
 	struct vmm_guest_aspace *aspace;
 	struct vmm_region *reg = NULL;
+	struct guest_dirty_log *log;
 	struct vmm_guest_aspace_event evt;
 
 	/* Sanity Check */
@@ -1161,6 +2391,7 @@ int vmm_guest_aspace_deinit(struct vmm_guest *guest)
 
 		/* Remove region from tree */
 		rb_erase(&reg->head, root);
+		arch_atomic_inc(&aspace->reg_gen);
 
 		/* Delete the region */
 		vmm_write_unlock_irqrestore_lite(root_lock, flags);
@@ -1182,6 +2413,7 @@ int vmm_guest_aspace_deinit(struct vmm_guest *guest)
 
 		/* Remove region from tree */
 		rb_erase(&reg->head, root);
+		arch_atomic_inc(&aspace->reg_gen);
 
 		/* Delete the region */
 		vmm_write_unlock_irqrestore_lite(root_lock, flags);
@@ -1197,6 +2429,15 @@ int vmm_guest_aspace_deinit(struct vmm_guest *guest)
 	}
 	guest->aspace.devemu_priv = NULL;
 
+	/* Free dirty logs not stopped by their users */
+	while (!list_empty(&aspace->dirty_log_list)) {
+		log = list_first_entry(&aspace->dirty_log_list,
+				       struct guest_dirty_log, head);
+		list_del(&log->head);
+		vmm_free(log->bmap);
+		vmm_free(log);
+	}
+
 	/* De-reference address space node */
 	if (guest->aspace.node) {
 		vmm_devtree_dref_node(guest->aspace.node);
@@ -28,12 +28,23 @@
 #include <vmm_cache.h>
 #include <vmm_heap.h>
 #include <vmm_stdio.h>
+#include <vmm_percpu.h>
+#include <vmm_smp.h>
+#include <vmm_spinlocks.h>
 #include <vmm_host_aspace.h>
+#include <arch_cpu_irq.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 #include <libs/buddy.h>
+#include <libs/tlsf.h>
+#ifdef CONFIG_HEAP_CALLSITE
+#include <libs/kallsyms.h>
+#include <libs/libsort.h>
+#endif
 
 struct vmm_heap_control {
 	struct buddy_allocator ba;
+	struct tlsf *tlsf;
 	void *hk_start;
 	unsigned long hk_size;
 	void *mem_start;
@@ -50,7 +61,7 @@ static struct vmm_heap_control dma_heap;
 #define HEAP_MAX_BIN		(VMM_PAGE_SHIFT)
 
 static void *heap_malloc(struct vmm_heap_control *heap,
-			 virtual_size_t size)
+			 virtual_size_t size, unsigned long caller)
 {
 	int rc;
 	unsigned long addr;
@@ -59,7 +70,12 @@ static void *heap_malloc(struct vmm_heap_control *heap,
 		return NULL;
 	}
 
-	rc = buddy_mem_alloc(&heap->ba, size, &addr);
+	if (heap->tlsf) {
+		addr = (unsigned long)tlsf_malloc(heap->tlsf, size);
+		rc = (addr) ? VMM_OK : VMM_ENOMEM;
+	} else {
+		rc = buddy_mem_alloc_tagged(&heap->ba, size, caller, &addr);
+	}
 	if (rc) {
 		vmm_printf("%s: Failed to alloc size=%"PRISIZE" (error %d)\n",
 			   __func__, size, rc);
@@ -79,6 +95,10 @@ static virtual_size_t heap_alloc_size(struct vmm_heap_control *heap,
 	BUG_ON(ptr < heap->mem_start);
 	BUG_ON((heap->mem_start + heap->mem_size) <= ptr);
 
+	if (heap->tlsf) {
+		return tlsf_alloc_size(heap->tlsf, ptr);
+	}
+
 	rc = buddy_mem_find(&heap->ba, (unsigned long) ptr,
 					&aaddr, NULL, &asize);
 	if (rc) {
@@ -96,13 +116,305 @@ static void heap_free(struct vmm_heap_control *heap, void *ptr)
 	BUG_ON(ptr < heap->mem_start);
 	BUG_ON((heap->mem_start + heap->mem_size) <= ptr);
 
-	rc = buddy_mem_free(&heap->ba, (unsigned long)ptr);
+	if (heap->tlsf) {
+		rc = tlsf_free(heap->tlsf, ptr);
+	} else {
+		rc = buddy_mem_free(&heap->ba, (unsigned long)ptr);
+	}
 	if (rc) {
 		vmm_printf("%s: Failed to free ptr=%p (error %d)\n",
 			   __func__, ptr, rc);
 	}
 }
 
+#ifdef CONFIG_HEAP_CACHE
+
+/* Per-CPU magazines of free objects for each size class from
+ * cache line size to 2 KB in front of normal heap buddy allocator.
+ * Smallest class is one cache line so that objects are cache line
+ * aligned and never share a cache line, same as buddy allocator.
+ *
+ * Magazines are refilled from and flushed to a per-class depot
+ * in batches. Depot gets new objects by carving page sized slabs
+ * out of buddy allocator. The size class of each slab is recorded
+ * in slab map so that free and alloc size can find it.
+ */
+#define HEAP_CACHE_MIN_SHIFT	VMM_CACHE_LINE_SHIFT
+#define HEAP_CACHE_MAX_SHIFT	11
+#define HEAP_CACHE_CLASSES	(HEAP_CACHE_MAX_SHIFT - HEAP_CACHE_MIN_SHIFT + 1)
+#define HEAP_CACHE_MAG_SIZE	16
+#define HEAP_CACHE_BATCH	(HEAP_CACHE_MAG_SIZE / 2)
+#define HEAP_CACHE_SLAB_SHIFT	VMM_PAGE_SHIFT
+#define HEAP_CACHE_SLAB_SIZE	(0x1UL << HEAP_CACHE_SLAB_SHIFT)
+
+struct heap_cache_mag {
+	u32 count;
+	void *objs[HEAP_CACHE_MAG_SIZE];
+	unsigned long alloc_hit;
+	unsigned long alloc_miss;
+	unsigned long free_hit;
+	unsigned long free_miss;
+};
+
+struct heap_cache_depot {
+	vmm_spinlock_t lock;
+	void *free_list;
+	unsigned long free_count;
+	unsigned long slab_count;
+};
+
+struct heap_cache_cpu {
+	struct heap_cache_mag mags[HEAP_CACHE_CLASSES];
+};
+
+struct heap_cache_control {
+	struct vmm_heap_control *heap;
+	unsigned long slab_base;
+	unsigned long slab_map_count;
+	u8 *slab_map;
+	struct heap_cache_depot depots[HEAP_CACHE_CLASSES];
+};
+
+static struct heap_cache_control normal_cache;
+static DEFINE_PER_CPU(struct heap_cache_cpu, hcache);
+
+static inline int heap_cache_class(virtual_size_t size)
+{
+	int c = 0;
+
+	while ((0x1UL << (c + HEAP_CACHE_MIN_SHIFT)) < size) {
+		c++;
+	}
+
+	return c;
+}
+
+/* Returns size class of object or -1 if not from cache slab */
+static inline int heap_cache_find_class(struct heap_cache_control *cache,
+					const void *ptr)
+{
+	unsigned long idx;
+
+	if (!cache->slab_map) {
+		return -1;
+	}
+
+	idx = ((unsigned long)ptr >> HEAP_CACHE_SLAB_SHIFT) - cache->slab_base;
+	if (cache->slab_map_count <= idx) {
+		return -1;
+	}
+
+	return (int)cache->slab_map[idx] - 1;
+}
+
+static int heap_aligned_alloc(struct vmm_heap_control *heap,
+			      unsigned long order, virtual_size_t size,
+			      unsigned long *addr)
+{
+	if (heap->tlsf) {
+		*addr = (unsigned long)tlsf_aligned_malloc(heap->tlsf,
+							  order, size);
+		return (*addr) ? VMM_OK : VMM_ENOMEM;
+	}
+
+	return buddy_mem_aligned_alloc(&heap->ba, order, size, addr);
+}
+
+/* Carve a new slab into free objects. Called with depot lock held. */
+static int heap_cache_grow(struct heap_cache_control *cache, int c)
+{
+	int rc;
+	unsigned long addr, off, osize = 0x1UL << (c + HEAP_CACHE_MIN_SHIFT);
+	struct heap_cache_depot *depot = &cache->depots[c];
+
+	rc = heap_aligned_alloc(cache->heap, HEAP_CACHE_SLAB_SHIFT,
+				HEAP_CACHE_SLAB_SIZE, &addr);
+	if (rc) {
+		return rc;
+	}
+
+	cache->slab_map[(addr >> HEAP_CACHE_SLAB_SHIFT) - cache->slab_base] =
+									c + 1;
+	for (off = 0; off < HEAP_CACHE_SLAB_SIZE; off += osize) {
+		*(void **)(addr + off) = depot->free_list;
+		depot->free_list = (void *)(addr + off);
+		depot->free_count++;
+	}
+	depot->slab_count++;
+
+	return VMM_OK;
+}
+
+/* Move a batch of objects from depot to magazine. Called with
+ * interrupts disabled on current CPU.
+ */
+static void heap_cache_refill(struct heap_cache_control *cache,
+			      struct heap_cache_mag *mag, int c)
+{
+	irq_flags_t flags;
+	struct heap_cache_depot *depot = &cache->depots[c];
+
+	vmm_spin_lock_irqsave_lite(&depot->lock, flags);
+
+	if ((depot->free_count < HEAP_CACHE_BATCH) &&
+	    heap_cache_grow(cache, c) && !depot->free_count) {
+		vmm_spin_unlock_irqrestore_lite(&depot->lock, flags);
+		return;
+	}
+
+	while (depot->free_count && (mag->count < HEAP_CACHE_BATCH)) {
+		mag->objs[mag->count++] = depot->free_list;
+		depot->free_list = *(void **)depot->free_list;
+		depot->free_count--;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&depot->lock, flags);
+}
+
+/* Move a batch of objects from magazine to depot. Called with
+ * interrupts disabled on current CPU.
+ */
+static void heap_cache_flush(struct heap_cache_control *cache,
+			     struct heap_cache_mag *mag, int c)
+{
+	irq_flags_t flags;
+	struct heap_cache_depot *depot = &cache->depots[c];
+
+	vmm_spin_lock_irqsave_lite(&depot->lock, flags);
+
+	while (mag->count > (HEAP_CACHE_MAG_SIZE - HEAP_CACHE_BATCH)) {
+		mag->count--;
+		*(void **)mag->objs[mag->count] = depot->free_list;
+		depot->free_list = mag->objs[mag->count];
+		depot->free_count++;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&depot->lock, flags);
+}
+
+static void *heap_cache_alloc(struct heap_cache_control *cache,
+			      virtual_size_t size)
+{
+	int c;
+	void *ret = NULL;
+	irq_flags_t flags;
+	struct heap_cache_mag *mag;
+
+	if (!cache->slab_map) {
+		return NULL;
+	}
+
+	c = heap_cache_class(size);
+
+	arch_cpu_irq_save(flags);
+
+	mag = &this_cpu(hcache).mags[c];
+	if (mag->count) {
+		mag->alloc_hit++;
+	} else {
+		mag->alloc_miss++;
+		heap_cache_refill(cache, mag, c);
+	}
+	if (mag->count) {
+		ret = mag->objs[--mag->count];
+	}
+
+	arch_cpu_irq_restore(flags);
+
+	return ret;
+}
+
+static void heap_cache_free(struct heap_cache_control *cache,
+			    void *ptr, int c)
+{
+	irq_flags_t flags;
+	struct heap_cache_mag *mag;
+
+	arch_cpu_irq_save(flags);
+
+	mag = &this_cpu(hcache).mags[c];
+	if (mag->count < HEAP_CACHE_MAG_SIZE) {
+		mag->free_hit++;
+	} else {
+		mag->free_miss++;
+		heap_cache_flush(cache, mag, c);
+	}
+	mag->objs[mag->count++] = ptr;
+
+	arch_cpu_irq_restore(flags);
+}
+
+static int heap_cache_print_state(struct heap_cache_control *cache,
+				  struct vmm_chardev *cdev, const char *name)
+{
+	int c;
+	u32 cpu;
+	struct heap_cache_mag *mag;
+	unsigned long cached, ahit, amiss, fhit, fmiss;
+
+	vmm_cprintf(cdev, "%s Heap Cache State\n", name);
+
+	if (!cache->slab_map) {
+		vmm_cprintf(cdev, "  Not available\n");
+		return VMM_OK;
+	}
+
+	for (c = 0; c < HEAP_CACHE_CLASSES; c++) {
+		cached = ahit = amiss = fhit = fmiss = 0;
+		for_each_online_cpu(cpu) {
+			mag = &per_cpu(hcache, cpu).mags[c];
+			cached += mag->count;
+			ahit += mag->alloc_hit;
+			amiss += mag->alloc_miss;
+			fhit += mag->free_hit;
+			fmiss += mag->free_miss;
+		}
+		vmm_cprintf(cdev, "  [CLASS %4dB]: %4lu slab(s), "
+			    "%5lu depot, %4lu cpu, "
+			    "alloc %lu/%lu, free %lu/%lu (hit/miss)\n",
+			    1 << (c + HEAP_CACHE_MIN_SHIFT),
+			    cache->depots[c].slab_count,
+			    cache->depots[c].free_count, cached,
+			    ahit, amiss, fhit, fmiss);
+	}
+
+	return VMM_OK;
+}
+
+static int heap_cache_init(struct heap_cache_control *cache,
+			   struct vmm_heap_control *heap)
+{
+	int c;
+	u8 *slab_map;
+	unsigned long count;
+
+	memset(cache, 0, sizeof(*cache));
+
+	for (c = 0; c < HEAP_CACHE_CLASSES; c++) {
+		INIT_SPIN_LOCK(&cache->depots[c].lock);
+	}
+
+	cache->heap = heap;
+	cache->slab_base = (unsigned long)heap->mem_start >>
+						HEAP_CACHE_SLAB_SHIFT;
+	count = (((unsigned long)heap->mem_start + heap->mem_size) >>
+					HEAP_CACHE_SLAB_SHIFT) - cache->slab_base;
+
+	/* Slab map itself comes from buddy allocator */
+	slab_map = heap_malloc(heap, count, 0);
+	if (!slab_map) {
+		return VMM_ENOMEM;
+	}
+	memset(slab_map, 0, count);
+
+	cache->slab_map_count = count;
+	cache->slab_map = slab_map;
+
+	return VMM_OK;
+}
+
+#endif
+
 static int heap_pa2va(struct vmm_heap_control *heap,
 		      physical_addr_t pa, virtual_addr_t *va)
 {
@@ -134,10 +446,38 @@ static int heap_va2pa(struct vmm_heap_control *heap,
 	return rc;
 }
 
+static int heap_tlsf_print_state(struct vmm_heap_control *heap,
+				 struct vmm_chardev *cdev, const char *name)
+{
+	unsigned long free_sz, max_sz;
+
+	free_sz = tlsf_free_size(heap->tlsf);
+	max_sz = tlsf_max_free_size(heap->tlsf);
+
+	vmm_cprintf(cdev, "%s Heap Usage State (TLSF)\n", name);
+	vmm_cprintf(cdev, "  Used Space  : %lu KB (peak %lu KB)\n",
+		    tlsf_used_size(heap->tlsf) >> 10,
+		    tlsf_used_peak(heap->tlsf) >> 10);
+	vmm_cprintf(cdev, "  Free Space  : %lu KB (largest block %lu KB)\n",
+		    free_sz >> 10, max_sz >> 10);
+	vmm_cprintf(cdev, "  Fragmented  : %lu%%\n",
+		    (free_sz) ? (unsigned long)(100 -
+			udiv64((u64)max_sz * 100, free_sz)) : 0);
+
+	return VMM_OK;
+}
+
 static int heap_print_state(struct vmm_heap_control *heap,
 			    struct vmm_chardev *cdev, const char *name)
 {
-	unsigned long idx;
+	unsigned long idx, blocks, free_sz, bin_sz, max_sz;
+
+	if (heap->tlsf) {
+		return heap_tlsf_print_state(heap, cdev, name);
+	}
+
+	free_sz = buddy_bins_free_space(&heap->ba);
+	max_sz = buddy_bins_max_area_size(&heap->ba);
 
 	vmm_cprintf(cdev, "%s Heap State\n", name);
 
@@ -149,11 +489,25 @@ static int heap_print_state(struct vmm_heap_control *heap,
 		} else {
 			vmm_cprintf(cdev, "  [BLOCK %4dM]: ", 1<<(idx-20));
 		}
-		vmm_cprintf(cdev, "%5lu area(s), %5lu free block(s)\n",
-			    buddy_bins_area_count(&heap->ba, idx),
-			    buddy_bins_block_count(&heap->ba, idx));
+		blocks = buddy_bins_block_count(&heap->ba, idx);
+		bin_sz = blocks << idx;
+		vmm_cprintf(cdev, "%5lu area(s), %5lu free block(s), "
+			    "%3lu%% of free space\n",
+			    buddy_bins_area_count(&heap->ba, idx), blocks,
+			    (free_sz) ? (unsigned long)udiv64((u64)bin_sz * 100,
+							      free_sz) : 0);
 	}
 
+	vmm_cprintf(cdev, "%s Heap Usage State\n", name);
+	vmm_cprintf(cdev, "  Used Space  : %lu KB (peak %lu KB)\n",
+		    buddy_mem_alloc_size(&heap->ba) >> 10,
+		    buddy_mem_alloc_peak(&heap->ba) >> 10);
+	vmm_cprintf(cdev, "  Free Space  : %lu KB (largest area %lu KB)\n",
+		    free_sz >> 10, max_sz >> 10);
+	vmm_cprintf(cdev, "  Fragmented  : %lu%%\n",
+		    (free_sz) ? (unsigned long)(100 -
+			udiv64((u64)max_sz * 100, free_sz)) : 0);
+
 	vmm_cprintf(cdev, "%s Heap House-Keeping State\n", name);
 	vmm_cprintf(cdev, "  Buddy Areas: %lu free out of %lu\n",
 		    buddy_hk_area_free(&heap->ba),
@@ -162,6 +516,137 @@ static int heap_print_state(struct vmm_heap_control *heap,
 	return VMM_OK;
 }
 
+#ifdef CONFIG_HEAP_CALLSITE
+
+/* Open addressing hash table of call-sites filled with buddy
+ * allocator lock held hence it is allocated before iterating.
+ */
+#define HEAP_CALLSITE_TABLE_SIZE	1024
+
+struct heap_callsite {
+	unsigned long caller;
+	unsigned long count;
+	unsigned long size;
+};
+
+struct heap_callsite_table {
+	struct heap_callsite *sites;
+	unsigned long used;
+	unsigned long dropped_count;
+	unsigned long dropped_size;
+};
+
+static int heap_callsite_iter(unsigned long addr, unsigned long size,
+			      unsigned long tag, void *priv)
+{
+	unsigned long i, n;
+	struct heap_callsite *cs;
+	struct heap_callsite_table *t = priv;
+
+	i = (tag >> 2) % HEAP_CALLSITE_TABLE_SIZE;
+	for (n = 0; n < HEAP_CALLSITE_TABLE_SIZE; n++) {
+		cs = &t->sites[i];
+		if (!cs->count) {
+			cs->caller = tag;
+			t->used++;
+			break;
+		}
+		if (cs->caller == tag) {
+			break;
+		}
+		i = (i + 1) % HEAP_CALLSITE_TABLE_SIZE;
+	}
+	if (n == HEAP_CALLSITE_TABLE_SIZE) {
+		t->dropped_count++;
+		t->dropped_size += size;
+		return VMM_OK;
+	}
+
+	cs->count++;
+	cs->size += size;
+
+	return VMM_OK;
+}
+
+/* Biggest call-sites first with empty slots at the end */
+static int heap_callsite_cmp(void *m, size_t a, size_t b)
+{
+	struct heap_callsite *cs = m;
+
+	return (cs[a].size < cs[b].size) ? 1 : 0;
+}
+
+static void heap_callsite_swap(void *m, size_t a, size_t b)
+{
+	struct heap_callsite tmp, *cs = m;
+
+	tmp = cs[a];
+	cs[a] = cs[b];
+	cs[b] = tmp;
+}
+
+static int heap_print_callsites(struct vmm_heap_control *heap,
+				struct vmm_chardev *cdev, const char *name,
+				u32 max_entries)
+{
+	int rc;
+	unsigned long i;
+	char sym[KSYM_NAME_LEN + 64];
+	struct heap_callsite_table t;
+
+	memset(&t, 0, sizeof(t));
+	t.sites = heap_malloc(&normal_heap,
+			      HEAP_CALLSITE_TABLE_SIZE * sizeof(*t.sites), 0);
+	if (!t.sites) {
+		return VMM_ENOMEM;
+	}
+	memset(t.sites, 0, HEAP_CALLSITE_TABLE_SIZE * sizeof(*t.sites));
+
+	rc = buddy_mem_iterate(&heap->ba, heap_callsite_iter, &t);
+	if (rc) {
+		goto done;
+	}
+
+	/* Our own table is not a real user */
+	for (i = 0; (heap == &normal_heap) &&
+		    (i < HEAP_CALLSITE_TABLE_SIZE); i++) {
+		if (t.sites[i].count && !t.sites[i].caller) {
+			t.sites[i].count--;
+			t.sites[i].size -= HEAP_CALLSITE_TABLE_SIZE *
+							sizeof(*t.sites);
+		}
+	}
+
+	libsort_smoothsort(t.sites, 0, HEAP_CALLSITE_TABLE_SIZE,
+			   heap_callsite_cmp, heap_callsite_swap);
+
+	vmm_cprintf(cdev, "%s Heap Call-Sites (%lu found)\n", name, t.used);
+	vmm_cprintf(cdev, "  %-10s %-10s %s\n", "Size(KB)", "Count", "Caller");
+	for (i = 0; (i < HEAP_CALLSITE_TABLE_SIZE) && (i < max_entries); i++) {
+		if (!t.sites[i].count) {
+			break;
+		}
+		if (t.sites[i].caller) {
+			kallsyms_sprint_symbol(sym, t.sites[i].caller);
+		} else {
+			strcpy(sym, "(untracked: heap cache or reserved)");
+		}
+		vmm_cprintf(cdev, "  %-10lu %-10lu %s\n",
+			    t.sites[i].size >> 10, t.sites[i].count, sym);
+	}
+	if (t.dropped_count) {
+		vmm_cprintf(cdev, "  %-10lu %-10lu (call-site table full)\n",
+			    t.dropped_size >> 10, t.dropped_count);
+	}
+
+done:
+	heap_free(&normal_heap, t.sites);
+
+	return rc;
+}
+
+#endif
+
 static int heap_init(struct vmm_heap_control *heap,
 		     bool is_normal, const u32 size_kb, u32 mem_flags)
 {
@@ -183,6 +668,17 @@ static int heap_init(struct vmm_heap_control *heap,
 		return rc;
 	}
 
+#ifdef CONFIG_HEAP_TLSF
+	/* TLSF keeps block headers in-band so no house-keeping area */
+	if (is_normal) {
+		heap->mem_start = heap->heap_start;
+		heap->mem_size = heap->heap_size;
+		heap->tlsf = tlsf_create(heap->mem_start, heap->mem_size,
+					 HEAP_MIN_BIN);
+		return (heap->tlsf) ? VMM_OK : VMM_ENOMEM;
+	}
+#endif
+
 	/* 12.5 percent for house-keeping */
 	heap->hk_size = (heap->heap_size) / 8;
 
@@ -208,14 +704,36 @@ static int heap_init(struct vmm_heap_control *heap,
 			  HEAP_MIN_BIN, HEAP_MAX_BIN);
 }
 
+#ifdef CONFIG_HEAP_CALLSITE
+#define HEAP_CALLER()		((unsigned long)__builtin_return_address(0))
+#else
+#define HEAP_CALLER()		0UL
+#endif
+
+static void *normal_malloc(virtual_size_t size, unsigned long caller)
+{
+#ifdef CONFIG_HEAP_CACHE
+	void *ret;
+
+	if (size && (size <= (0x1UL << HEAP_CACHE_MAX_SHIFT))) {
+		ret = heap_cache_alloc(&normal_cache, size);
+		if (ret) {
+			return ret;
+		}
+	}
+#endif
+
+	return heap_malloc(&normal_heap, size, caller);
+}
+
 void *vmm_malloc(virtual_size_t size)
 {
-	return heap_malloc(&normal_heap, size);
+	return normal_malloc(size, HEAP_CALLER());
 }
 
 void *vmm_zalloc(virtual_size_t size)
 {
-	void *ret = vmm_malloc(size);
+	void *ret = normal_malloc(size, HEAP_CALLER());
 
 	if (ret) {
 		memset(ret, 0, size);
@@ -226,11 +744,30 @@ void *vmm_zalloc(virtual_size_t size)
 
 virtual_size_t vmm_alloc_size(const void *ptr)
 {
+#ifdef CONFIG_HEAP_CACHE
+	int c = heap_cache_find_class(&normal_cache, ptr);
+
+	if (c >= 0) {
+		return (0x1UL << (c + HEAP_CACHE_MIN_SHIFT)) -
+			((unsigned long)ptr &
+			 ((0x1UL << (c + HEAP_CACHE_MIN_SHIFT)) - 1));
+	}
+#endif
+
 	return heap_alloc_size(&normal_heap, ptr);
 }
 
 void vmm_free(void *ptr)
 {
+#ifdef CONFIG_HEAP_CACHE
+	int c = heap_cache_find_class(&normal_cache, ptr);
+
+	if (c >= 0) {
+		heap_cache_free(&normal_cache, ptr, c);
+		return;
+	}
+#endif
+
 	heap_free(&normal_heap, ptr);
 }
 
@@ -251,6 +788,10 @@ virtual_size_t vmm_normal_heap_hksize(void)
 
 virtual_size_t vmm_normal_heap_free_size(void)
 {
+	if (normal_heap.tlsf) {
+		return tlsf_free_size(normal_heap.tlsf);
+	}
+
 	return buddy_bins_free_space(&normal_heap.ba);
 }
 
@@ -259,14 +800,33 @@ int vmm_normal_heap_print_state(struct vmm_chardev *cdev)
 	return heap_print_state(&normal_heap, cdev, "Normal");
 }
 
+int vmm_normal_heap_print_callsites(struct vmm_chardev *cdev,
+				    u32 max_entries)
+{
+#ifdef CONFIG_HEAP_CALLSITE
+	return heap_print_callsites(&normal_heap, cdev, "Normal", max_entries);
+#else
+	return VMM_ENOTAVAIL;
+#endif
+}
+
+int vmm_normal_heap_print_cache_state(struct vmm_chardev *cdev)
+{
+#ifdef CONFIG_HEAP_CACHE
+	return heap_cache_print_state(&normal_cache, cdev, "Normal");
+#else
+	return VMM_ENOTAVAIL;
+#endif
+}
+
 void *vmm_dma_malloc(virtual_size_t size)
 {
-	return heap_malloc(&dma_heap, size);
+	return heap_malloc(&dma_heap, size, HEAP_CALLER());
 }
 
 void *vmm_dma_zalloc(virtual_size_t size)
 {
-	void *ret = vmm_dma_malloc(size);
+	void *ret = heap_malloc(&dma_heap, size, HEAP_CALLER());
 
 	if (ret) {
 		memset(ret, 0, size);
@@ -404,6 +964,110 @@ int vmm_dma_heap_print_state(struct vmm_chardev *cdev)
 	return heap_print_state(&dma_heap, cdev, "DMA");
 }
 
+int vmm_dma_heap_print_callsites(struct vmm_chardev *cdev, u32 max_entries)
+{
+#ifdef CONFIG_HEAP_CALLSITE
+	return heap_print_callsites(&dma_heap, cdev, "DMA", max_entries);
+#else
+	return VMM_ENOTAVAIL;
+#endif
+}
+
+struct vmm_arena {
+	void *mem;
+	struct tlsf *tlsf;
+};
+
+struct vmm_arena *vmm_arena_create(virtual_size_t size)
+{
+	struct vmm_arena *a;
+
+	if (!size) {
+		return NULL;
+	}
+
+	a = vmm_zalloc(sizeof(*a));
+	if (!a) {
+		return NULL;
+	}
+
+	a->mem = vmm_malloc(size);
+	if (!a->mem) {
+		vmm_free(a);
+		return NULL;
+	}
+
+	a->tlsf = tlsf_create(a->mem, size, HEAP_MIN_BIN);
+	if (!a->tlsf) {
+		vmm_free(a->mem);
+		vmm_free(a);
+		return NULL;
+	}
+
+	return a;
+}
+
+void *vmm_arena_malloc(struct vmm_arena *a, virtual_size_t size)
+{
+	return (a) ? tlsf_malloc(a->tlsf, size) : NULL;
+}
+
+void *vmm_arena_zalloc(struct vmm_arena *a, virtual_size_t size)
+{
+	void *ret = vmm_arena_malloc(a, size);
+
+	if (ret) {
+		memset(ret, 0, size);
+	}
+
+	return ret;
+}
+
+bool vmm_arena_contains(struct vmm_arena *a, const void *ptr)
+{
+	return (a) ? tlsf_contains(a->tlsf, ptr) : FALSE;
+}
+
+void vmm_arena_free(struct vmm_arena *a, void *ptr)
+{
+	int rc;
+
+	if (!a || !ptr) {
+		return;
+	}
+
+	rc = tlsf_free(a->tlsf, ptr);
+	if (rc) {
+		vmm_printf("%s: Failed to free ptr=%p (error %d)\n",
+			   __func__, ptr, rc);
+	}
+}
+
+virtual_size_t vmm_arena_free_size(struct vmm_arena *a)
+{
+	return (a) ? tlsf_free_size(a->tlsf) : 0;
+}
+
+void vmm_arena_destroy(struct vmm_arena *a)
+{
+	if (!a) {
+		return;
+	}
+
+	vmm_free(a->mem);
+	vmm_free(a);
+}
+
+void vmm_heap_reset_peak(void)
+{
+	if (normal_heap.tlsf) {
+		tlsf_used_peak_reset(normal_heap.tlsf);
+	} else {
+		buddy_mem_alloc_peak_reset(&normal_heap.ba);
+	}
+	buddy_mem_alloc_peak_reset(&dma_heap.ba);
+}
+
 int __init vmm_heap_init(void)
 {
 	int rc;
@@ -421,6 +1085,14 @@ int __init vmm_heap_init(void)
 		return rc;
 	}
 
+#ifdef CONFIG_HEAP_CACHE
+	/* Create Normal heap cache */
+	rc = heap_cache_init(&normal_cache, &normal_heap);
+	if (rc) {
+		return rc;
+	}
+#endif
+
 	/* Create DMA heap */
 	rc= heap_init(&dma_heap, FALSE,
 			CONFIG_DMA_HEAP_SIZE_KB,
@@ -35,6 +35,16 @@
 #include <libs/stringlib.h>
 #include <libs/rbtree_augmented.h>
 
+/* Per-CPU temporary mapping window for physical read/write. The
+ * arch memory read/write hooks use one page whereas generic code
+ * maps upto HOST_MEM_RW_PAGES pages at a time.
+ */
+#if defined(ARCH_HAS_MEMORY_READWRITE)
+#define HOST_MEM_RW_PAGES		1
+#else
+#define HOST_MEM_RW_PAGES		8
+#endif
+
 static virtual_addr_t host_mem_rw_va[CONFIG_CPU_COUNT];
 
 struct host_mhash_entry {
@@ -48,6 +58,7 @@ struct host_mhash_entry {
 
 struct host_mhash_ctrl {
 	vmm_rwlock_t lock;
+	u32 gen;
 	virtual_addr_t start;
 	virtual_size_t size;
 	u32 count;
@@ -57,6 +68,26 @@ struct host_mhash_ctrl {
 
 static struct host_mhash_ctrl host_mhash;
 
+/* Per-CPU cache of recently translated mappings so that repeated
+ * translations (such as per-packet DMA address conversion) within
+ * same mapping don't take host_mhash.lock or walk the tree. Cached
+ * entries are dropped whenever host_mhash.gen changes.
+ */
+#define HOST_MHASH_CACHE_SIZE		4
+
+struct host_mhash_cache {
+	u32 gen;
+	u32 next;
+	struct {
+		physical_addr_t pa;
+		virtual_addr_t va;
+		virtual_size_t sz;
+		u32 mem_flags;
+	} ent[HOST_MHASH_CACHE_SIZE];
+};
+
+static struct host_mhash_cache host_mhash_cache[CONFIG_CPU_COUNT];
+
 /* NOTE: Must be called with write lock held on host_mhash.lock */
 static struct host_mhash_entry *__host_mhash_alloc(void)
 {
@@ -195,6 +226,7 @@ static int host_mhash_del(physical_addr_t pa,
 	}
 
 	rb_erase(&e->rb, &host_mhash.root);
+	host_mhash.gen++;
 
 	rpa[0] = e->pa;
 	rva[0] = e->va;
@@ -227,33 +259,116 @@ done:
 	return rc;
 }
 
+static bool host_mhash_cache_find(physical_addr_t pa,
+				  virtual_addr_t *va,
+				  virtual_size_t *sz,
+				  u32 *mem_flags)
+{
+	u32 i;
+	bool ret = FALSE;
+	irq_flags_t flags;
+	struct host_mhash_cache *c;
+
+	arch_cpu_irq_save(flags);
+
+	c = &host_mhash_cache[vmm_smp_processor_id()];
+	if (c->gen != host_mhash.gen) {
+		for (i = 0; i < HOST_MHASH_CACHE_SIZE; i++) {
+			c->ent[i].sz = 0;
+		}
+		c->gen = host_mhash.gen;
+	}
+
+	for (i = 0; i < HOST_MHASH_CACHE_SIZE; i++) {
+		if ((c->ent[i].pa <= pa) &&
+		    (pa < (c->ent[i].pa + c->ent[i].sz))) {
+			*va = c->ent[i].va;
+			*sz = c->ent[i].sz;
+			*mem_flags = c->ent[i].mem_flags;
+			pa -= c->ent[i].pa;
+			*va += pa;
+			*sz -= pa;
+			ret = TRUE;
+			break;
+		}
+	}
+
+	arch_cpu_irq_restore(flags);
+
+	return ret;
+}
+
+static void host_mhash_cache_add(u32 gen, struct host_mhash_entry *e)
+{
+	u32 i;
+	irq_flags_t flags;
+	struct host_mhash_cache *c;
+
+	arch_cpu_irq_save(flags);
+
+	c = &host_mhash_cache[vmm_smp_processor_id()];
+	if (c->gen == gen) {
+		i = c->next;
+		c->next = (i + 1) % HOST_MHASH_CACHE_SIZE;
+		c->ent[i].pa = e->pa;
+		c->ent[i].va = e->va;
+		c->ent[i].sz = e->sz;
+		c->ent[i].mem_flags = e->mem_flags;
+	}
+
+	arch_cpu_irq_restore(flags);
+}
+
 static int host_mhash_pa2va(physical_addr_t pa,
 			    virtual_addr_t *va,
 			    virtual_size_t *sz,
 			    u32 *mem_flags)
 {
+	u32 gen;
 	int rc = VMM_ENOTAVAIL;
 	irq_flags_t flags;
-	struct host_mhash_entry *e;
+	struct host_mhash_entry *e, tmp;
+	virtual_addr_t _va;
+	virtual_size_t _sz;
+	u32 _mem_flags;
+
+	if (host_mhash_cache_find(pa, &_va, &_sz, &_mem_flags)) {
+		rc = VMM_OK;
+		goto done;
+	}
 
 	vmm_read_lock_irqsave(&host_mhash.lock, flags);
 
 	e = __host_mhash_find(pa);
 	if (e) {
-		if (va) {
-			*va = e->va + (e->pa - pa);
-		}
-		if (sz) {
-			*sz = e->sz - (e->pa - pa);
-		}
-		if (mem_flags) {
-			*mem_flags = e->mem_flags;
-		}
+		tmp = *e;
 		rc = VMM_OK;
 	}
+	gen = host_mhash.gen;
 
 	vmm_read_unlock_irqrestore(&host_mhash.lock, flags);
 
+	if (rc) {
+		return rc;
+	}
+
+	host_mhash_cache_add(gen, &tmp);
+
+	_va = tmp.va + (pa - tmp.pa);
+	_sz = tmp.sz - (pa - tmp.pa);
+	_mem_flags = tmp.mem_flags;
+
+done:
+	if (va) {
+		*va = _va;
+	}
+	if (sz) {
+		*sz = _sz;
+	}
+	if (mem_flags) {
+		*mem_flags = _mem_flags;
+	}
+
 	return rc;
 }
 
@@ -288,6 +403,21 @@ static int host_mhash_init(virtual_addr_t mhash_start,
 	return VMM_OK;
 }
 
+#if defined(ARCH_HAS_HOST_HUGEPAGE)
+#define HOST_HUGEPAGE_SIZE	(1UL << ARCH_HOST_HUGEPAGE_SHIFT)
+#define HOST_HUGEPAGE_PAGES	(HOST_HUGEPAGE_SIZE >> VMM_PAGE_SHIFT)
+
+/* Both host_memmap() and host_memunmap() decide huge pages this way */
+static inline bool host_hugepage_possible(virtual_addr_t va,
+					  physical_addr_t pa,
+					  virtual_size_t sz)
+{
+	return (!(va & (HOST_HUGEPAGE_SIZE - 1)) &&
+		!(pa & (HOST_HUGEPAGE_SIZE - 1)) &&
+		(HOST_HUGEPAGE_SIZE <= sz)) ? TRUE : FALSE;
+}
+#endif
+
 static virtual_addr_t host_memmap(physical_addr_t pa,
 				  virtual_size_t sz,
 				  u32 mem_flags)
@@ -328,6 +458,18 @@ static virtual_addr_t host_memmap(physical_addr_t pa,
 		}
 
 		for (ite = 0; ite < (sz >> VMM_PAGE_SHIFT); ite++) {
+#if defined(ARCH_HAS_HOST_HUGEPAGE)
+			if (host_hugepage_possible(va + ite * VMM_PAGE_SIZE,
+						   tpa + ite * VMM_PAGE_SIZE,
+						   sz - ite * VMM_PAGE_SIZE) &&
+			    !arch_cpu_aspace_hugepage_map(
+						va + ite * VMM_PAGE_SIZE,
+						tpa + ite * VMM_PAGE_SIZE,
+						mem_flags)) {
+				ite += HOST_HUGEPAGE_PAGES - 1;
+				continue;
+			}
+#endif
 			rc = arch_cpu_aspace_map(va + ite * VMM_PAGE_SIZE,
 						tpa + ite * VMM_PAGE_SIZE,
 						mem_flags);
@@ -369,6 +511,20 @@ static int host_memunmap(virtual_addr_t va, virtual_size_t sz)
 	}
 
 	for (ite = 0; ite < (sz >> VMM_PAGE_SHIFT); ite++) {
+#if defined(ARCH_HAS_HOST_HUGEPAGE)
+		if (host_hugepage_possible(va + ite * VMM_PAGE_SIZE,
+					   pa + ite * VMM_PAGE_SIZE,
+					   sz - ite * VMM_PAGE_SIZE)) {
+			rc = arch_cpu_aspace_hugepage_unmap(
+						va + ite * VMM_PAGE_SIZE);
+			if (rc == VMM_OK) {
+				ite += HOST_HUGEPAGE_PAGES - 1;
+				continue;
+			} else if (rc != VMM_ENOTAVAIL) {
+				return rc;
+			}
+		}
+#endif
 		rc = arch_cpu_aspace_unmap(va + ite * VMM_PAGE_SIZE);
 		if (rc) {
 			return rc;
@@ -407,10 +563,21 @@ int vmm_host_memunmap(virtual_addr_t va)
 virtual_addr_t vmm_host_alloc_pages(u32 page_count, u32 mem_flags)
 {
 	physical_addr_t pa = 0x0;
+	u32 align_order = VMM_PAGE_SHIFT;
+
+#if defined(ARCH_HAS_HOST_HUGEPAGE)
+	/* Let large allocations (such as heap) use huge pages. Only
+	 * multiples of huge page size are aligned so that RAM alloc
+	 * does not round up the size.
+	 */
+	if (page_count && !(page_count & (HOST_HUGEPAGE_PAGES - 1))) {
+		align_order = ARCH_HOST_HUGEPAGE_SHIFT;
+	}
+#endif
 
 	if (!vmm_host_ram_alloc(&pa,
 				page_count * VMM_PAGE_SIZE,
-				VMM_PAGE_SHIFT)) {
+				align_order)) {
 		return 0x0;
 	}
 
@@ -468,54 +635,134 @@ int vmm_host_pa2va(physical_addr_t pa, virtual_addr_t *va)
 	return VMM_OK;
 }
 
-u32 vmm_host_memory_read(physical_addr_t hpa,
-			 void *dst, u32 len, bool cacheable)
+/* Get existing hypervisor mapping of given physical address when its
+ * memory attributes are same as temporary mapping would have. Returns
+ * virtual address and size of mapping from given physical address.
+ */
+static virtual_addr_t host_memory_direct(physical_addr_t hpa,
+					 bool cacheable, bool write,
+					 virtual_size_t *sz)
+{
+	u32 mem_flags;
+	virtual_addr_t va;
+
+	if (host_mhash_pa2va(hpa, &va, sz, &mem_flags)) {
+		return 0x0;
+	}
+
+	if (!(mem_flags & ((write) ? VMM_MEMORY_WRITEABLE :
+				     VMM_MEMORY_READABLE))) {
+		return 0x0;
+	}
+
+	if (cacheable) {
+		mem_flags &= (VMM_MEMORY_CACHEABLE | VMM_MEMORY_BUFFERABLE);
+		if (mem_flags != (VMM_MEMORY_CACHEABLE | VMM_MEMORY_BUFFERABLE)) {
+			return 0x0;
+		}
+	} else if (mem_flags != VMM_MEMORY_FLAGS_NORMAL_NOCACHE) {
+		return 0x0;
+	}
+
+	return va;
+}
+
+/* Read/write upto len bytes in one step and return bytes done. The
+ * existing hypervisor mapping is used when available otherwise the
+ * per-CPU temporary mapping window is used with irqs disabled.
+ */
+static u32 host_memory_rw(physical_addr_t hpa, void *buf, u32 len,
+			  bool cacheable, bool write)
 {
 	int rc;
+	u32 chunk;
 	irq_flags_t flags;
-	u32 bytes_read = 0, page_offset, page_read;
-	virtual_addr_t tmp_va = host_mem_rw_va[vmm_smp_processor_id()];
+	virtual_addr_t va, tmp_va;
+	virtual_size_t sz;
+#if !defined(ARCH_HAS_MEMORY_READWRITE)
+	u32 p, pages;
+#endif
 
-	/* Read one page at time with irqs disabled since, we use
-	 * one virtual address per-host CPU to do read/write.
-	 */
-	while (bytes_read < len) {
-		page_offset = hpa & VMM_PAGE_MASK;
+	va = host_memory_direct(hpa, cacheable, write, &sz);
+	if (va) {
+		chunk = (sz < len) ? sz : len;
+		if (write) {
+			memcpy((void *)va, buf, chunk);
+		} else {
+			memcpy(buf, (void *)va, chunk);
+		}
+		return chunk;
+	}
 
-		page_read = VMM_PAGE_SIZE - page_offset;
-		page_read = (page_read < (len - bytes_read)) ?
-			     page_read : (len - bytes_read);
+	chunk = (HOST_MEM_RW_PAGES * VMM_PAGE_SIZE) - (hpa & VMM_PAGE_MASK);
+	chunk = (chunk < len) ? chunk : len;
 
-		arch_cpu_irq_save(flags);
+	arch_cpu_irq_save(flags);
+
+	tmp_va = host_mem_rw_va[vmm_smp_processor_id()];
 
 #if !defined(ARCH_HAS_MEMORY_READWRITE)
-		rc = arch_cpu_aspace_map(tmp_va, hpa & ~VMM_PAGE_MASK,
+	pages = VMM_SIZE_TO_PAGE((hpa & VMM_PAGE_MASK) + chunk);
+	for (p = 0; p < pages; p++) {
+		rc = arch_cpu_aspace_map(tmp_va + p * VMM_PAGE_SIZE,
+					 (hpa & ~VMM_PAGE_MASK) +
+					 p * VMM_PAGE_SIZE,
 					 (cacheable) ?
 					 VMM_MEMORY_FLAGS_NORMAL :
 					 VMM_MEMORY_FLAGS_NORMAL_NOCACHE);
 		if (rc) {
+			pages = p;
+			chunk = 0;
 			break;
 		}
+	}
 
-		memcpy(dst, (void *)(tmp_va + page_offset), page_read);
+	va = tmp_va + (hpa & VMM_PAGE_MASK);
+	if (write) {
+		memcpy((void *)va, buf, chunk);
+	} else {
+		memcpy(buf, (void *)va, chunk);
+	}
 
-		rc = arch_cpu_aspace_unmap(tmp_va);
+	for (p = 0; p < pages; p++) {
+		rc = arch_cpu_aspace_unmap(tmp_va + p * VMM_PAGE_SIZE);
 		if (rc) {
-			break;
+			chunk = 0;
 		}
+	}
 #else
+	if (write) {
+		rc = arch_cpu_aspace_memory_write(tmp_va, hpa,
+						  buf, chunk, cacheable);
+	} else {
 		rc = arch_cpu_aspace_memory_read(tmp_va, hpa,
-						 dst, page_read, cacheable);
-		if (rc) {
-			break;
-		}
+						 buf, chunk, cacheable);
+	}
+	if (rc) {
+		chunk = 0;
+	}
 #endif
 
-		arch_cpu_irq_restore(flags);
+	arch_cpu_irq_restore(flags);
+
+	return chunk;
+}
+
+u32 vmm_host_memory_read(physical_addr_t hpa,
+			 void *dst, u32 len, bool cacheable)
+{
+	u32 bytes_read = 0, chunk;
+
+	while (bytes_read < len) {
+		chunk = host_memory_rw(hpa, dst,
+				       len - bytes_read, cacheable, FALSE);
+		if (!chunk) {
+			break;
+		}
 
-		hpa += page_read;
-		bytes_read += page_read;
-		dst += page_read;
+		hpa += chunk;
+		bytes_read += chunk;
+		dst += chunk;
 	}
 
 	return bytes_read;
@@ -523,55 +770,81 @@ u32 vmm_host_memory_read(physical_addr_t hpa,
 
 u32 vmm_host_memory_write(physical_addr_t hpa,
 			  void *src, u32 len, bool cacheable)
+{
+	u32 bytes_written = 0, chunk;
+
+	while (bytes_written < len) {
+		chunk = host_memory_rw(hpa, src,
+				       len - bytes_written, cacheable, TRUE);
+		if (!chunk) {
+			break;
+		}
+
+		hpa += chunk;
+		bytes_written += chunk;
+		src += chunk;
+	}
+
+	return bytes_written;
+}
+
+u32 vmm_host_memory_zero(physical_addr_t hpa, u32 len, bool cacheable)
 {
 	int rc;
 	irq_flags_t flags;
-	u32 bytes_written = 0, page_offset, page_write;
+	u32 bytes_zeroed = 0, page_offset, page_zero;
 	virtual_addr_t tmp_va = host_mem_rw_va[vmm_smp_processor_id()];
+#if defined(ARCH_HAS_MEMORY_READWRITE) && !defined(ARCH_HAS_MEMORY_ZERO)
+	static const u8 zero_buf[256] = { 0 };
+	u32 pos;
+#endif
 
-	/* Write one page at time with irqs disabled since, we use
-	 * one virtual address per-host CPU to do read/write.
+	/* Zero one page at time with irqs disabled since, we use
+	 * one virtual address per-host CPU to do zeroing.
 	 */
-	while (bytes_written < len) {
+	while (bytes_zeroed < len) {
 		page_offset = hpa & VMM_PAGE_MASK;
 
-		page_write = VMM_PAGE_SIZE - page_offset;
-		page_write = (page_write < (len - bytes_written)) ?
-			      page_write : (len - bytes_written);
+		page_zero = VMM_PAGE_SIZE - page_offset;
+		page_zero = (page_zero < (len - bytes_zeroed)) ?
+			     page_zero : (len - bytes_zeroed);
 
 		arch_cpu_irq_save(flags);
 
-#if !defined(ARCH_HAS_MEMORY_READWRITE)
+#if defined(ARCH_HAS_MEMORY_ZERO)
+		rc = arch_cpu_aspace_memory_zero(tmp_va, hpa,
+						 page_zero, cacheable);
+#elif !defined(ARCH_HAS_MEMORY_READWRITE)
 		rc = arch_cpu_aspace_map(tmp_va, hpa & ~VMM_PAGE_MASK,
 					 (cacheable) ?
 					 VMM_MEMORY_FLAGS_NORMAL :
 					 VMM_MEMORY_FLAGS_NORMAL_NOCACHE);
-		if (rc) {
-			break;
-		}
-
-		memcpy((void *)(tmp_va + page_offset), src, page_write);
-
-		rc = arch_cpu_aspace_unmap(tmp_va);
-		if (rc) {
-			break;
+		if (!rc) {
+			memset((void *)(tmp_va + page_offset), 0, page_zero);
+			rc = arch_cpu_aspace_unmap(tmp_va);
 		}
 #else
-		rc = arch_cpu_aspace_memory_write(tmp_va, hpa,
-						  src, page_write, cacheable);
-		if (rc) {
-			break;
+		rc = VMM_OK;
+		for (pos = 0; !rc && (pos < page_zero);
+		     pos += sizeof(zero_buf)) {
+			rc = arch_cpu_aspace_memory_write(tmp_va, hpa + pos,
+					(void *)zero_buf,
+					min(page_zero - pos, (u32)sizeof(zero_buf)),
+					cacheable);
 		}
 #endif
 
 		arch_cpu_irq_restore(flags);
 
-		hpa += page_write;
-		bytes_written += page_write;
-		src += page_write;
+		if (rc) {
+			break;
+		}
+
+		hpa += page_zero;
+		bytes_zeroed += page_zero;
 	}
 
-	return bytes_written;
+	return bytes_zeroed;
 }
 
 u32 vmm_host_memory_set(physical_addr_t hpa,
@@ -581,6 +854,10 @@ u32 vmm_host_memory_set(physical_addr_t hpa,
 	u32 to_wr, wr, total_written = 0;
 	physical_addr_t pos, end;
 
+	if (!byte) {
+		return vmm_host_memory_zero(hpa, len, cacheable);
+	}
+
 	memset(buf, byte, sizeof(buf));
 
 	pos = hpa;
@@ -826,7 +1103,7 @@ int __cpuinit vmm_host_aspace_init(void)
 	/* Setup temporary virtual address for physical read/write */
 	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
 		rc = vmm_host_vapool_alloc(&host_mem_rw_va[cpu],
-					   VMM_PAGE_SIZE);
+					   HOST_MEM_RW_PAGES * VMM_PAGE_SIZE);
 		if (rc) {
 			return rc;
 		}
@@ -28,6 +28,8 @@
 #include <vmm_host_irq.h>
 #include <vmm_host_irqext.h>
 #include <vmm_host_irqdomain.h>
+#include <vmm_timer.h>
+#include <vmm_trace.h>
 #include <arch_cpu_irq.h>
 #include <arch_host_irq.h>
 #include <libs/stringlib.h>
@@ -41,23 +43,69 @@ struct vmm_host_irqs_ctrl {
 
 static struct vmm_host_irqs_ctrl hirqctrl;
 
-void vmm_handle_percpu_irq(struct vmm_host_irq *irq, u32 cpu, void *data)
+static void host_irq_thread_work(struct vmm_work *work)
 {
-	irq_flags_t flags;
-	struct vmm_host_irq_action *act;
+	struct vmm_host_irq_action *act =
+		container_of(work, struct vmm_host_irq_action, thread_work);
 
-	if (irq->chip && irq->chip->irq_ack) {
-		irq->chip->irq_ack(irq);
+	act->thread_func(act->hirq, act->dev);
+
+	if (act->thread_unmask) {
+		act->thread_unmask = FALSE;
+		vmm_host_irq_unmask(act->hirq);
 	}
+}
+
+static vmm_irq_return_t host_irq_default_primary(int irq_no, void *dev)
+{
+	return VMM_IRQ_WAKE_THREAD;
+}
+
+/* Call actions of host irq till one of them handles it.
+ * The masked parameter tells whether flow handler itself
+ * keeps the irq masked while actions are called.
+ */
+static vmm_irq_return_t host_irq_handle_actions(struct vmm_host_irq *irq,
+						u32 cpu, bool masked)
+{
+	irq_flags_t flags;
+	vmm_irq_return_t ret = VMM_IRQ_NONE;
+	struct vmm_host_irq_action *act;
 
 	vmm_read_lock_irqsave_lite(&irq->action_lock[cpu], flags);
 	list_for_each_entry(act, &irq->action_list[cpu], head) {
-		if (act->func(irq->num, act->dev) == VMM_IRQ_HANDLED) {
+		ret = act->func(irq->num, act->dev);
+		if (ret == VMM_IRQ_NONE) {
+			continue;
+		}
+		if (ret != VMM_IRQ_WAKE_THREAD || !act->thread_func) {
+			ret = VMM_IRQ_HANDLED;
 			break;
 		}
+
+		/* Keep level irq masked till thread function is done */
+		if (!masked && vmm_host_irq_is_level_type(irq) &&
+		    irq->chip && irq->chip->irq_mask) {
+			irq->chip->irq_mask(irq);
+			masked = TRUE;
+		}
+		act->thread_unmask = masked;
+		vmm_workqueue_schedule_work(act->thread_wq, &act->thread_work);
+		break;
 	}
 	vmm_read_unlock_irqrestore_lite(&irq->action_lock[cpu], flags);
 
+	return ret;
+}
+
+void vmm_handle_percpu_irq(struct vmm_host_irq *irq, u32 cpu, void *data)
+{
+	if (irq->chip && irq->chip->irq_ack) {
+		irq->chip->irq_ack(irq);
+	}
+
+	host_irq_handle_actions(irq, cpu, FALSE);
+
 	if (irq->chip && irq->chip->irq_eoi) {
 		irq->chip->irq_eoi(irq);
 	}
@@ -65,16 +113,7 @@ void vmm_handle_percpu_irq(struct vmm_host_irq *irq, u32 cpu, void *data)
 
 void vmm_handle_fast_eoi(struct vmm_host_irq *irq, u32 cpu, void *data)
 {
-	irq_flags_t flags;
-	struct vmm_host_irq_action *act;
-
-	vmm_read_lock_irqsave_lite(&irq->action_lock[cpu], flags);
-	list_for_each_entry(act, &irq->action_list[cpu], head) {
-		if (act->func(irq->num, act->dev) == VMM_IRQ_HANDLED) {
-			break;
-		}
-	}
-	vmm_read_unlock_irqrestore_lite(&irq->action_lock[cpu], flags);
+	host_irq_handle_actions(irq, cpu, FALSE);
 
 	if (irq->chip && irq->chip->irq_eoi) {
 		irq->chip->irq_eoi(irq);
@@ -83,8 +122,7 @@ void vmm_handle_fast_eoi(struct vmm_host_irq *irq, u32 cpu, void *data)
 
 void vmm_handle_level_irq(struct vmm_host_irq *irq, u32 cpu, void *data)
 {
-	irq_flags_t flags;
-	struct vmm_host_irq_action *act;
+	vmm_irq_return_t ret;
 
 	if (irq->chip) {
 		if (irq->chip->irq_mask_ack) {
@@ -99,13 +137,12 @@ void vmm_handle_level_irq(struct vmm_host_irq *irq, u32 cpu, void *data)
 		}
 	}
 
-	vmm_read_lock_irqsave_lite(&irq->action_lock[cpu], flags);
-	list_for_each_entry(act, &irq->action_list[cpu], head) {
-		if (act->func(irq->num, act->dev) == VMM_IRQ_HANDLED) {
-			break;
-		}
+	ret = host_irq_handle_actions(irq, cpu, TRUE);
+
+	/* Thread function will unmask the irq */
+	if (ret == VMM_IRQ_WAKE_THREAD) {
+		return;
 	}
-	vmm_read_unlock_irqrestore_lite(&irq->action_lock[cpu], flags);
 
 	if (irq->chip && irq->chip->irq_unmask) {
 		irq->chip->irq_unmask(irq);
@@ -121,10 +158,50 @@ struct vmm_host_irq *vmm_host_irq_get(u32 hirq)
 	return __vmm_host_irqext_get(hirq);
 }
 
+#ifdef CONFIG_HOST_IRQ_STATS
+static void host_irq_update_stats(struct vmm_host_irq *irq,
+				  u32 cpu, u64 ns)
+{
+	u32 b = 0;
+	u64 us = ns >> 10;
+	struct vmm_host_irq_stats *st = &irq->stats[cpu];
+
+	st->total_ns += ns;
+	if (st->max_ns < ns) {
+		st->max_ns = ns;
+	}
+
+	while (us && (b < (VMM_HOST_IRQ_HIST_BUCKETS - 1))) {
+		us >>= 1;
+		b++;
+	}
+	st->hist[b]++;
+}
+
+void vmm_host_irq_reset_stats(struct vmm_host_irq *irq)
+{
+	u32 cpu;
+	irq_flags_t flags;
+
+	if (!irq) {
+		return;
+	}
+
+	arch_cpu_irq_save(flags);
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		memset(&irq->stats[cpu], 0, sizeof(irq->stats[cpu]));
+	}
+	arch_cpu_irq_restore(flags);
+}
+#endif
+
 int vmm_host_generic_irq_exec(u32 hirq_no)
 {
 	u32 cpu;
 	struct vmm_host_irq *irq = NULL;
+#ifdef CONFIG_HOST_IRQ_STATS
+	u64 tstamp;
+#endif
 
 	if (NULL == (irq = vmm_host_irq_get(hirq_no)))
 		return VMM_ENOTAVAIL;
@@ -132,9 +209,18 @@ int vmm_host_generic_irq_exec(u32 hirq_no)
 	cpu = vmm_smp_processor_id();
 	irq->count[cpu]++;
 	irq->in_progress[cpu] = TRUE;
+#ifdef CONFIG_HOST_IRQ_STATS
+	tstamp = vmm_timer_timestamp_for_profile();
+#endif
+	vmm_trace(IRQ_ENTRY, hirq_no, 0, 0, 0);
 	if (irq->handler) {
 		irq->handler(irq, cpu, irq->handler_data);
 	}
+	vmm_trace(IRQ_EXIT, hirq_no, 0, 0, 0);
+#ifdef CONFIG_HOST_IRQ_STATS
+	host_irq_update_stats(irq, cpu,
+			      vmm_timer_timestamp_for_profile() - tstamp);
+#endif
 	irq->in_progress[cpu] = FALSE;
 
 	return VMM_OK;
@@ -534,6 +620,8 @@ int vmm_host_irq_find(u32 hirq_start, u32 state_mask, u32 *hirq)
 static int host_irq_register(struct vmm_host_irq *irq,
 			     const char *name,
 			     vmm_host_irq_function_t func,
+			     vmm_host_irq_function_t thread_func,
+			     struct vmm_workqueue *wq,
 			     void *dev, u32 cpu)
 {
 	bool found;
@@ -563,6 +651,11 @@ static int host_irq_register(struct vmm_host_irq *irq,
 	INIT_LIST_HEAD(&act->head);
 	act->func = func;
 	act->dev = dev;
+	act->hirq = irq->num;
+	act->thread_func = thread_func;
+	act->thread_wq = wq;
+	INIT_WORK(&act->thread_work, host_irq_thread_work);
+	act->thread_unmask = FALSE;
 
 	list_add_tail(&act->head, &irq->action_list[cpu]);
 
@@ -571,10 +664,12 @@ static int host_irq_register(struct vmm_host_irq *irq,
 	return VMM_OK;
 }
 
-int vmm_host_irq_register(u32 hirq, 
-			  const char *name,
-			  vmm_host_irq_function_t func,
-			  void *dev)
+static int host_irq_register_common(u32 hirq,
+				    const char *name,
+				    vmm_host_irq_function_t func,
+				    vmm_host_irq_function_t thread_func,
+				    struct vmm_workqueue *wq,
+				    void *dev)
 {
 	int rc;
 	u32 cpu;
@@ -584,15 +679,15 @@ int vmm_host_irq_register(u32 hirq,
 		return VMM_ENOTAVAIL;
 
 	if (vmm_host_irq_is_per_cpu(irq)) {
-		rc = host_irq_register(irq, name, func, dev,
-				       vmm_smp_processor_id());
+		rc = host_irq_register(irq, name, func, thread_func, wq,
+				       dev, vmm_smp_processor_id());
 		if (rc) {
 			return rc;
 		}
 	} else {
 		for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
-			rc = host_irq_register(irq, name, func,
-					       dev, cpu);
+			rc = host_irq_register(irq, name, func, thread_func,
+					       wq, dev, cpu);
 			if (rc) {
 				return rc;
 			}
@@ -601,6 +696,34 @@ int vmm_host_irq_register(u32 hirq,
 	return vmm_host_irq_enable(hirq);
 }
 
+int vmm_host_irq_register(u32 hirq, 
+			  const char *name,
+			  vmm_host_irq_function_t func,
+			  void *dev)
+{
+	if (!func) {
+		return VMM_EINVALID;
+	}
+
+	return host_irq_register_common(hirq, name, func, NULL, NULL, dev);
+}
+
+int vmm_host_irq_register_threaded(u32 hirq,
+				   const char *name,
+				   vmm_host_irq_function_t func,
+				   vmm_host_irq_function_t thread_func,
+				   struct vmm_workqueue *wq,
+				   void *dev)
+{
+	if (!thread_func) {
+		return VMM_EINVALID;
+	}
+
+	return host_irq_register_common(hirq, name,
+			(func) ? func : host_irq_default_primary,
+			thread_func, wq, dev);
+}
+
 static int host_irq_unregister(struct vmm_host_irq *irq, void *dev,
 			       u32 cpu, bool *disable)
 {
@@ -622,13 +745,17 @@ static int host_irq_unregister(struct vmm_host_irq *irq, void *dev,
 	}
 
 	list_del(&act->head);
-	vmm_free(act);
 	if (list_empty(&irq->action_list[cpu])) {
 		*disable = TRUE;
 	}
 
 	vmm_write_unlock_irqrestore_lite(&irq->action_lock[cpu], flags);
 
+	if (act->thread_func) {
+		vmm_workqueue_stop_work(&act->thread_work);
+	}
+	vmm_free(act);
+
 	return VMM_OK;
 }
 
@@ -716,6 +843,9 @@ void __vmm_host_irq_init_desc(struct vmm_host_irq *irq, u32 num, u32 hwirq)
 	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
 		irq->count[cpu] = 0;
 		irq->in_progress[cpu]= FALSE;
+#ifdef CONFIG_HOST_IRQ_STATS
+		memset(&irq->stats[cpu], 0, sizeof(irq->stats[cpu]));
+#endif
 	}
 	irq->chip = NULL;
 	irq->chip_data = NULL;
@@ -30,14 +30,65 @@
 #include <vmm_host_irqext.h>
 #include <vmm_host_irqdomain.h>
 #include <libs/list.h>
+#include <libs/radix-tree.h>
 
 struct vmm_host_irqdomain_ctrl {
 	vmm_rwlock_t lock;
 	struct dlist domains;
+	/* Domain of each host IRQ is directly indexed for host IRQs
+	 * and kept in radix tree for sparse extended host IRQs.
+	 */
+	struct vmm_host_irqdomain *domain_map[CONFIG_HOST_IRQ_COUNT];
+	struct radix_tree_root ext_domain_map;
 };
 
 static struct vmm_host_irqdomain_ctrl idctrl;
 
+/* Map unmapped host IRQs of domain to domain.
+ * Note: Must be called with write lock held
+ */
+static int irqdomain_map_fill(struct vmm_host_irqdomain *domain)
+{
+	int rc;
+	unsigned int hirq;
+
+	for (hirq = domain->base; hirq < domain->end; hirq++) {
+		if (hirq < CONFIG_HOST_IRQ_COUNT) {
+			if (!idctrl.domain_map[hirq]) {
+				idctrl.domain_map[hirq] = domain;
+			}
+			continue;
+		}
+		rc = radix_tree_insert(&idctrl.ext_domain_map, hirq, domain);
+		if (rc && (rc != VMM_EEXIST)) {
+			return rc;
+		}
+	}
+
+	return VMM_OK;
+}
+
+/* Unmap host IRQs mapped to domain.
+ * Note: Must be called with write lock held
+ */
+static void irqdomain_map_clear(struct vmm_host_irqdomain *domain)
+{
+	unsigned int hirq;
+
+	for (hirq = domain->base; hirq < domain->end; hirq++) {
+		if (hirq < CONFIG_HOST_IRQ_COUNT) {
+			if (idctrl.domain_map[hirq] == domain) {
+				idctrl.domain_map[hirq] = NULL;
+			}
+			continue;
+		}
+		if (radix_tree_lookup(&idctrl.ext_domain_map, hirq) ==
+		    domain) {
+			radix_tree_delete(&idctrl.ext_domain_map, hirq);
+		}
+	}
+}
+
 int vmm_host_irqdomain_to_hwirq(struct vmm_host_irqdomain *domain,
 				unsigned int hirq)
 {
@@ -113,20 +164,21 @@ struct vmm_host_irqdomain *vmm_host_irqdomain_get(unsigned int hirq)
 	irq_flags_t flags;
 	struct vmm_host_irqdomain *domain = NULL;
 
-	vmm_read_lock_irqsave_lite(&idctrl.lock, flags);
-
-	list_for_each_entry(domain, &idctrl.domains, head) {
-		if ((hirq >= domain->base) && (hirq < domain->end)) {
-			vmm_read_unlock_irqrestore_lite(&idctrl.lock, flags);
-			return domain;
-		}
+	if (hirq < CONFIG_HOST_IRQ_COUNT) {
+		/* Pointer sized read needs no lock */
+		domain = idctrl.domain_map[hirq];
+	} else {
+		vmm_read_lock_irqsave_lite(&idctrl.lock, flags);
+		domain = radix_tree_lookup(&idctrl.ext_domain_map, hirq);
+		vmm_read_unlock_irqrestore_lite(&idctrl.lock, flags);
 	}
 
-	vmm_read_unlock_irqrestore_lite(&idctrl.lock, flags);
-
-	vmm_printf("%s: Failed to find host IRQ %d domain\n", __func__, hirq);
+	if (!domain) {
+		vmm_printf("%s: Failed to find host IRQ %d domain\n",
+			   __func__, hirq);
+	}
 
-	return NULL;
+	return domain;
 }
 
 int vmm_host_irqdomain_create_mapping(struct vmm_host_irqdomain *domain,
@@ -249,6 +301,13 @@ struct vmm_host_irqdomain *vmm_host_irqdomain_add(
 	newdomain->ops = ops;
 
 	vmm_write_lock_irqsave_lite(&idctrl.lock, flags);
+	if (irqdomain_map_fill(newdomain)) {
+		irqdomain_map_clear(newdomain);
+		vmm_write_unlock_irqrestore_lite(&idctrl.lock, flags);
+		vmm_devtree_dref_node(of_node);
+		vmm_free(newdomain);
+		return NULL;
+	}
 	list_add_tail(&newdomain->head, &idctrl.domains);
 	vmm_write_unlock_irqrestore_lite(&idctrl.lock, flags);
 
@@ -259,12 +318,20 @@ void vmm_host_irqdomain_remove(struct vmm_host_irqdomain *domain)
 {
 	unsigned int pos = 0;
 	irq_flags_t flags;
+	struct vmm_host_irqdomain *d;
 
 	if (!domain)
 		return;
 
+	/* Overlapped host IRQs fall back to remaining domains */
 	vmm_write_lock_irqsave_lite(&idctrl.lock, flags);
 	list_del(&domain->head);
+	irqdomain_map_clear(domain);
+	list_for_each_entry(d, &idctrl.domains, head) {
+		if ((d->base < domain->end) && (domain->base < d->end)) {
+			irqdomain_map_fill(d);
+		}
+	}
 	vmm_write_unlock_irqrestore_lite(&idctrl.lock, flags);
 
 	for (pos = domain->base; pos < domain->end; ++pos) {
@@ -280,6 +347,7 @@ int __cpuinit vmm_host_irqdomain_init(void)
 	memset(&idctrl, 0, sizeof(struct vmm_host_irqdomain_ctrl));
 	INIT_RW_LOCK(&idctrl.lock);
 	INIT_LIST_HEAD(&idctrl.domains);
+	INIT_RADIX_TREE(&idctrl.ext_domain_map, GFP_ATOMIC);
 
 	return VMM_OK;
 }
@@ -27,10 +27,36 @@
 #include <vmm_resource.h>
 #include <vmm_host_aspace.h>
 #include <vmm_host_ram.h>
+#include <vmm_threads.h>
+#include <vmm_completion.h>
+#include <vmm_waitqueue.h>
+#include <vmm_scheduler.h>
 #include <arch_devtree.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
 #include <libs/bitmap.h>
+#include <libs/bitops.h>
+#include <libs/log2.h>
+
+/* Besides the per-frame bitmap (order 0), each bank keeps one bitmap
+ * for every higher frame order where a bit is set when any frame of
+ * the naturally aligned block of that order is in-use. This makes
+ * finding a large or highly aligned free area a word-wise scan of
+ * a much smaller bitmap.
+ */
+#define RAM_MAX_FRAME_ORDER	(30 - VMM_PAGE_SHIFT)
+
+/* When CONFIG_HOST_RAM_PREZERO is enabled, a low priority thread
+ * zeroes free frames in batches of RAM_ZERO_BATCH frames until
+ * CONFIG_HOST_RAM_PREZERO_MB worth of free frames are known to be
+ * zero. Free frames which are zero are marked in per-bank zmap and
+ * allocations asking for zeroed memory only zero remaining frames.
+ * A batch being zeroed is temporarily marked in-use in bmap but is
+ * still accounted as free in bmap_free. An allocation which only fits
+ * over the batch being zeroed fails until the batch is done whereas
+ * a reservation overlapping it sleeps until the batch is done.
+ */
+#define RAM_ZERO_BATCH		16
 
 struct vmm_host_ram_bank {
 	physical_addr_t start;
@@ -42,22 +68,262 @@ struct vmm_host_ram_bank {
 	u32 bmap_sz;
 	u32 bmap_free;
 
+	u32 order_count;
+	unsigned long *omap[RAM_MAX_FRAME_ORDER + 1];
+	u32 omap_bits[RAM_MAX_FRAME_ORDER + 1];
+
+#ifdef CONFIG_HOST_RAM_PREZERO
+	unsigned long *zmap;
+	u32 zmap_count;
+	u32 zscan;
+	u32 zbusy_pos;
+	u32 zbusy_cnt;
+#endif
+
 	struct vmm_resource res;
 };
 
 struct vmm_host_ram_ctrl {
 	u32 bank_count;
 	struct vmm_host_ram_bank banks[CONFIG_MAX_RAM_BANK_COUNT];
+#ifdef CONFIG_HOST_RAM_PREZERO
+	u32 zero_target;
+	struct vmm_completion zero_cmpl;
+	struct vmm_waitqueue zero_wq;
+	struct vmm_thread *zero_thread;
+#endif
 };
 
 static struct vmm_host_ram_ctrl rctrl;
 
-physical_size_t vmm_host_ram_alloc(physical_addr_t *pa,
-				   physical_size_t sz,
-				   u32 align_order)
+/* Update higher order bitmaps for frames [bpos, bpos + bcnt).
+ * Called with bank bmap_lock held.
+ */
+static void host_ram_update_orders(struct vmm_host_ram_bank *bank,
+				   u32 bpos, u32 bcnt, bool used)
+{
+	u32 o, b, bstart, bend, pend;
+	unsigned long *map, *pmap;
+
+	for (o = 1; o < bank->order_count; o++) {
+		map = bank->omap[o];
+		pmap = bank->omap[o - 1];
+		bstart = bpos >> o;
+		bend = (bpos + bcnt - 1) >> o;
+		if (bank->omap_bits[o] <= bend) {
+			bend = bank->omap_bits[o] - 1;
+		}
+		if (bend < bstart) {
+			break;
+		}
+
+		if (used) {
+			bitmap_set(map, bstart, bend - bstart + 1);
+			continue;
+		}
+
+		/* Block stays in-use if any of its two halves is in-use */
+		bitmap_clear(map, bstart, bend - bstart + 1);
+		pend = min(2 * bend + 2, bank->omap_bits[o - 1]);
+		b = 2 * bstart;
+		while ((b = find_next_bit(pmap, pend, b)) < pend) {
+			bitmap_setbit(map, b >> 1);
+			b = (b | 1) + 1;
+		}
+	}
+}
+
+/* Find free frames [bpos, bpos + bcnt) with bpos aligned to
+ * 2^align frames (physically). Called with bank bmap_lock held.
+ */
+static bool host_ram_find_free(struct vmm_host_ram_bank *bank,
+			       u32 bcnt, u32 align, u32 *bpos)
+{
+	int o;
+	u32 pos, count, oalign, sframe;
+
+	if (32 <= align) {
+		return FALSE;
+	}
+	sframe = bank->start >> VMM_PAGE_SHIFT;
+
+	/* Try from the highest usable order down to order 0 */
+	o = ilog2(bcnt);
+	if ((int)bank->order_count <= o) {
+		o = bank->order_count - 1;
+	}
+	for (; o >= 0; o--) {
+		count = (bcnt + order_mask(o)) >> o;
+		oalign = ((u32)o < align) ? (u32)order_size(align - o) : 1;
+		pos = bitmap_find_next_zero_area_off(bank->omap[o],
+						     bank->omap_bits[o], 0,
+						     count, oalign - 1,
+						     sframe >> o);
+		if (pos < bank->omap_bits[o]) {
+			*bpos = pos << o;
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+#ifdef CONFIG_HOST_RAM_PREZERO
+
+static u32 host_ram_zeroed_frames(void)
+{
+	u32 bn, ret = 0;
+
+	for (bn = 0; bn < rctrl.bank_count; bn++) {
+		ret += rctrl.banks[bn].zmap_count;
+	}
+
+	return ret;
+}
+
+/* Wake-up pre-zeroing thread if zeroed frames are below target */
+static void host_ram_zero_kick(void)
+{
+	if (rctrl.zero_thread &&
+	    (host_ram_zeroed_frames() < rctrl.zero_target)) {
+		vmm_completion_complete_once(&rctrl.zero_cmpl);
+	}
+}
+
+/* Forget zeroed state of frames [bpos, bpos + bcnt).
+ * Called with bank bmap_lock held.
+ */
+static void host_ram_clear_zeroed(struct vmm_host_ram_bank *bank,
+				  u32 bpos, u32 bcnt)
+{
+	u32 pos = bpos, next, end = bpos + bcnt;
+
+	while (bank->zmap_count &&
+	       ((pos = find_next_bit(bank->zmap, end, pos)) < end)) {
+		next = find_next_zero_bit(bank->zmap, end, pos);
+		bitmap_clear(bank->zmap, pos, next - pos);
+		bank->zmap_count -= next - pos;
+		pos = next;
+	}
+}
+
+/* Check whether frames [bpos, bpos + bcnt) overlap the batch
+ * being zeroed. Called with bank bmap_lock held.
+ */
+static bool host_ram_zero_busy(struct vmm_host_ram_bank *bank,
+			       u32 bpos, u32 bcnt)
+{
+	return (bank->zbusy_cnt &&
+		(bpos < (bank->zbusy_pos + bank->zbusy_cnt)) &&
+		(bank->zbusy_pos < (bpos + bcnt))) ? TRUE : FALSE;
+}
+
+/* Sleep until the batch being zeroed does not overlap frames
+ * [bpos, bpos + bcnt). The pre-zeroing thread runs at lowest priority
+ * hence spinning for it can livelock when it shares host CPU with us.
+ */
+static int host_ram_zero_wait(struct vmm_host_ram_bank *bank,
+			      u32 bpos, u32 bcnt)
 {
+	bool busy;
+	int rc = VMM_OK;
+	irq_flags_t flags, bflags;
+
+	if (!vmm_scheduler_orphan_context()) {
+		return VMM_EBUSY;
+	}
+
+	vmm_spin_lock_irqsave(&rctrl.zero_wq.lock, flags);
+
+	vmm_spin_lock_irqsave_lite(&bank->bmap_lock, bflags);
+	busy = host_ram_zero_busy(bank, bpos, bcnt);
+	vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, bflags);
+
+	if (busy) {
+		rc = __vmm_waitqueue_sleep(&rctrl.zero_wq, NULL);
+	}
+
+	vmm_spin_unlock_irqrestore(&rctrl.zero_wq.lock, flags);
+
+	return rc;
+}
+
+/* Zero allocated frames [bpos, bpos + bcnt) which are not already
+ * zero. Frames are processed one bitmap word at a time so that
+ * bmap_lock is only held for short durations.
+ */
+static void host_ram_zero_frames(struct vmm_host_ram_bank *bank,
+				 u32 bpos, u32 bcnt, bool cacheable)
+{
+	u32 i, b, e, n;
 	irq_flags_t flags;
-	u32 i, found, bn, binc, bcnt, bpos, bfree;
+	unsigned long clean, dirty;
+
+	for (i = 0; i < bcnt; i += n) {
+		n = min(bcnt - i, (u32)BITS_PER_LONG);
+
+		vmm_spin_lock_irqsave_lite(&bank->bmap_lock, flags);
+		clean = bitmap_read(bank->zmap, bpos + i, n);
+		if (clean) {
+			bitmap_clear(bank->zmap, bpos + i, n);
+			bank->zmap_count -= bitmap_weight(&clean, n);
+		}
+		vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
+		dirty = ~clean & BITMAP_LAST_WORD_MASK(n);
+
+		/* Zero runs of dirty frames */
+		while (dirty) {
+			b = __ffs(dirty);
+			e = (~(dirty >> b)) ? b + ffz(dirty >> b) : BITS_PER_LONG;
+			dirty = (e < BITS_PER_LONG) ? dirty & (~0UL << e) : 0;
+			vmm_host_memory_zero(bank->start +
+				(physical_addr_t)(bpos + i + b) * VMM_PAGE_SIZE,
+				(e - b) * VMM_PAGE_SIZE, cacheable);
+		}
+	}
+}
+
+#else
+
+static void host_ram_zero_kick(void)
+{
+}
+
+static void host_ram_clear_zeroed(struct vmm_host_ram_bank *bank,
+				  u32 bpos, u32 bcnt)
+{
+}
+
+static bool host_ram_zero_busy(struct vmm_host_ram_bank *bank,
+			       u32 bpos, u32 bcnt)
+{
+	return FALSE;
+}
+
+static int host_ram_zero_wait(struct vmm_host_ram_bank *bank,
+			      u32 bpos, u32 bcnt)
+{
+	return VMM_OK;
+}
+
+static void host_ram_zero_frames(struct vmm_host_ram_bank *bank,
+				 u32 bpos, u32 bcnt, bool cacheable)
+{
+	vmm_host_memory_zero(bank->start +
+			     (physical_addr_t)bpos * VMM_PAGE_SIZE,
+			     bcnt * VMM_PAGE_SIZE, cacheable);
+}
+
+#endif
+
+static physical_size_t host_ram_alloc(physical_addr_t *pa,
+				      physical_size_t sz,
+				      u32 align_order, bool zero,
+				      struct vmm_host_ram_bank **bankp,
+				      u32 *bposp)
+{
+	irq_flags_t flags;
+	u32 bn, bcnt, bpos;
 	struct vmm_host_ram_bank *bank;
 
 	if ((sz == 0) ||
@@ -74,51 +340,71 @@ physical_size_t vmm_host_ram_alloc(physical_addr_t *pa,
 
 		vmm_spin_lock_irqsave_lite(&bank->bmap_lock, flags);
 
-		if (bank->bmap_free < bcnt) {
+		if ((bank->bmap_free < bcnt) ||
+		    !host_ram_find_free(bank, bcnt,
+					align_order - VMM_PAGE_SHIFT, &bpos)) {
 			vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
 			continue;
 		}
 
-		found = 0;
-		binc = order_size(align_order) >> VMM_PAGE_SHIFT;
-		bpos = bank->start & order_mask(align_order);
-		if (bpos) {
-			bpos = VMM_SIZE_TO_PAGE(order_size(align_order) - bpos);
-		}
-		for (; bpos < (bank->size >> VMM_PAGE_SHIFT); bpos += binc) {
-			bfree = 0;
-			for (i = bpos; i < (bpos + bcnt); i++) {
-				if (bitmap_isset(bank->bmap, i)) {
-					break;
-				}
-				bfree++;
-			}
-			if (bfree == bcnt) {
-				found = 1;
-				break;
-			}
-		}
-		if (!found) {
-			vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
-			continue;
-		}
-
-		*pa = bank->start + bpos * VMM_PAGE_SIZE;
+		*pa = bank->start + (physical_addr_t)bpos * VMM_PAGE_SIZE;
 		bitmap_set(bank->bmap, bpos, bcnt);
+		host_ram_update_orders(bank, bpos, bcnt, TRUE);
 		bank->bmap_free -= bcnt;
+		/* Zeroed state is consumed later by host_ram_zero_frames() */
+		if (!zero) {
+			host_ram_clear_zeroed(bank, bpos, bcnt);
+		}
 
 		vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
 
+		*bankp = bank;
+		*bposp = bpos;
 		return sz;
 	}
 
 	return 0;
 }
 
+physical_size_t vmm_host_ram_alloc(physical_addr_t *pa,
+				   physical_size_t sz,
+				   u32 align_order)
+{
+	u32 bpos;
+	physical_size_t ret;
+	struct vmm_host_ram_bank *bank;
+
+	ret = host_ram_alloc(pa, sz, align_order, FALSE, &bank, &bpos);
+	if (ret) {
+		host_ram_zero_kick();
+	}
+
+	return ret;
+}
+
+physical_size_t vmm_host_ram_alloc_zeroed(physical_addr_t *pa,
+					  physical_size_t sz,
+					  u32 align_order,
+					  bool cacheable)
+{
+	u32 bpos;
+	physical_size_t ret;
+	struct vmm_host_ram_bank *bank;
+
+	ret = host_ram_alloc(pa, sz, align_order, TRUE, &bank, &bpos);
+	if (ret) {
+		host_ram_zero_frames(bank, bpos, VMM_SIZE_TO_PAGE(ret),
+				     cacheable);
+		host_ram_zero_kick();
+	}
+
+	return ret;
+}
+
 int vmm_host_ram_reserve(physical_addr_t pa, physical_size_t sz)
 {
 	int rc = VMM_EINVALID;
-	u32 i, bn, bcnt, bpos, bfree;
+	u32 bn, bcnt, bpos;
 	irq_flags_t flags;
 	struct vmm_host_ram_bank *bank;
 
@@ -133,30 +419,36 @@ int vmm_host_ram_reserve(physical_addr_t pa, physical_size_t sz)
 		bpos = (pa - bank->start) >> VMM_PAGE_SHIFT;
 		bcnt = VMM_SIZE_TO_PAGE(sz);
 
+retry:
 		vmm_spin_lock_irqsave_lite(&bank->bmap_lock, flags);
 
+		/* Wait for background zeroing of overlapping frames */
+		if (host_ram_zero_busy(bank, bpos, bcnt)) {
+			vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
+			rc = host_ram_zero_wait(bank, bpos, bcnt);
+			if (rc) {
+				break;
+			}
+			goto retry;
+		}
+
 		if (bank->bmap_free < bcnt) {
 			vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
 			rc = VMM_ENOSPC;
 			break;
 		}
 
-		bfree = 0;
-		for (i = bpos; i < (bpos + bcnt); i++) {
-			if (bitmap_isset(bank->bmap, i)) {
-				break;
-			}
-			bfree++;
-		}
-
-		if (bfree != bcnt) {
+		if (find_next_bit(bank->bmap, bpos + bcnt, bpos) <
+							(bpos + bcnt)) {
 			vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
 			rc = VMM_ENOSPC;
 			break;
 		}
 
 		bitmap_set(bank->bmap, bpos, bcnt);
+		host_ram_update_orders(bank, bpos, bcnt, TRUE);
 		bank->bmap_free -= bcnt;
+		host_ram_clear_zeroed(bank, bpos, bcnt);
 
 		vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
 
@@ -188,10 +480,13 @@ int vmm_host_ram_free(physical_addr_t pa, physical_size_t sz)
 		vmm_spin_lock_irqsave_lite(&bank->bmap_lock, flags);
 
 		bitmap_clear(bank->bmap, bpos, bcnt);
+		host_ram_update_orders(bank, bpos, bcnt, FALSE);
 		bank->bmap_free += bcnt;
 
 		vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
 
+		host_ram_zero_kick();
+
 		rc = VMM_OK;
 		break;
 	}
@@ -309,10 +604,147 @@ u32 vmm_host_ram_bank_free_frames(u32 bank)
 	return ret;
 }
 
+u32 vmm_host_ram_total_zeroed_frames(void)
+{
+#ifdef CONFIG_HOST_RAM_PREZERO
+	return host_ram_zeroed_frames();
+#else
+	return 0;
+#endif
+}
+
+#ifdef CONFIG_HOST_RAM_PREZERO
+
+/* Zero one batch of free frames which are not yet zero.
+ * Returns FALSE when there is no such free frame in bank.
+ */
+static bool host_ram_zero_batch(struct vmm_host_ram_bank *bank)
+{
+	irq_flags_t flags;
+	unsigned long w = 0;
+	u32 i, idx = 0, nwords, bpos, bcnt, zeroed;
+
+	nwords = BITS_TO_LONGS(bank->frame_count);
+
+	vmm_spin_lock_irqsave_lite(&bank->bmap_lock, flags);
+
+	for (i = 0; i < nwords; i++) {
+		idx = (bank->zscan + i) % nwords;
+		w = ~(bank->bmap[idx] | bank->zmap[idx]);
+		if (idx == (nwords - 1)) {
+			w &= BITMAP_LAST_WORD_MASK(bank->frame_count);
+		}
+		if (w) {
+			break;
+		}
+	}
+	if (i == nwords) {
+		vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
+		return FALSE;
+	}
+	bank->zscan = idx;
+
+	bpos = __ffs(w);
+	w >>= bpos;
+	bcnt = (~w) ? ffz(w) : BITS_PER_LONG;
+	if (RAM_ZERO_BATCH < bcnt) {
+		bcnt = RAM_ZERO_BATCH;
+	}
+	bpos += idx * BITS_PER_LONG;
+
+	bitmap_set(bank->bmap, bpos, bcnt);
+	host_ram_update_orders(bank, bpos, bcnt, TRUE);
+	bank->zbusy_pos = bpos;
+	bank->zbusy_cnt = bcnt;
+
+	vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
+
+	/* Non-cacheable zeroing so that frames suit any user */
+	zeroed = vmm_host_memory_zero(bank->start +
+				(physical_addr_t)bpos * VMM_PAGE_SIZE,
+				bcnt * VMM_PAGE_SIZE, FALSE);
+
+	vmm_spin_lock_irqsave_lite(&bank->bmap_lock, flags);
+
+	bitmap_clear(bank->bmap, bpos, bcnt);
+	host_ram_update_orders(bank, bpos, bcnt, FALSE);
+	if (zeroed == (bcnt * VMM_PAGE_SIZE)) {
+		bitmap_set(bank->zmap, bpos, bcnt);
+		bank->zmap_count += bcnt;
+	}
+	bank->zbusy_cnt = 0;
+
+	vmm_spin_unlock_irqrestore_lite(&bank->bmap_lock, flags);
+
+	/* Reservations overlapping this batch can proceed now */
+	vmm_waitqueue_wakeall(&rctrl.zero_wq);
+
+	return TRUE;
+}
+
+static int host_ram_zero_main(void *udata)
+{
+	u32 bn;
+	bool progress;
+
+	while (1) {
+		progress = FALSE;
+		for (bn = 0; bn < rctrl.bank_count; bn++) {
+			if (rctrl.zero_target <= host_ram_zeroed_frames()) {
+				break;
+			}
+			if (host_ram_zero_batch(&rctrl.banks[bn])) {
+				progress = TRUE;
+			}
+		}
+
+		if (!progress) {
+			vmm_completion_wait(&rctrl.zero_cmpl);
+		}
+	}
+
+	return VMM_OK;
+}
+
+int __init vmm_host_ram_prezero_init(void)
+{
+	int rc;
+
+	rctrl.zero_target = (u32)CONFIG_HOST_RAM_PREZERO_MB <<
+						(20 - VMM_PAGE_SHIFT);
+	INIT_COMPLETION(&rctrl.zero_cmpl);
+	INIT_WAITQUEUE(&rctrl.zero_wq, NULL);
+
+	rctrl.zero_thread = vmm_threads_create("ramzero", host_ram_zero_main,
+					       NULL, VMM_THREAD_MIN_PRIORITY,
+					       VMM_THREAD_DEF_TIME_SLICE);
+	if (!rctrl.zero_thread) {
+		return VMM_EFAIL;
+	}
+
+	rc = vmm_threads_start(rctrl.zero_thread);
+	if (rc) {
+		vmm_threads_destroy(rctrl.zero_thread);
+		rctrl.zero_thread = NULL;
+		return rc;
+	}
+
+	return VMM_OK;
+}
+
+#else
+
+int __init vmm_host_ram_prezero_init(void)
+{
+	return VMM_OK;
+}
+
+#endif
+
 virtual_size_t vmm_host_ram_estimate_hksize(void)
 {
 	int rc;
-	u32 bn, count;
+	u32 o, bn, count;
 	virtual_size_t ret;
 	physical_size_t size;
 
@@ -329,7 +761,13 @@ virtual_size_t vmm_host_ram_estimate_hksize(void)
 			return ret;
 		}
 
+		for (o = 0; o <= RAM_MAX_FRAME_ORDER; o++) {
+			ret += bitmap_estimate_size(
+					(size >> VMM_PAGE_SHIFT) >> o);
+		}
+#ifdef CONFIG_HOST_RAM_PREZERO
 		ret += bitmap_estimate_size(size >> VMM_PAGE_SHIFT);
+#endif
 	}
 
 	return ret;
@@ -338,7 +776,7 @@ virtual_size_t vmm_host_ram_estimate_hksize(void)
 int __init vmm_host_ram_init(virtual_addr_t hkbase)
 {
 	int rc;
-	u32 bn;
+	u32 o, bn;
 	struct vmm_host_ram_bank *bank;
 
 	memset(&rctrl, 0, sizeof(rctrl));
@@ -378,6 +816,29 @@ int __init vmm_host_ram_init(virtual_addr_t hkbase)
 		bank->bmap_free = bank->frame_count;
 
 		bitmap_zero(bank->bmap, bank->frame_count);
+		hkbase += bank->bmap_sz;
+
+#ifdef CONFIG_HOST_RAM_PREZERO
+		bank->zmap = (unsigned long *)hkbase;
+		bitmap_zero(bank->zmap, bank->frame_count);
+		hkbase += bank->bmap_sz;
+#endif
+
+		/* Higher orders need naturally aligned blocks in bank */
+		bank->omap[0] = bank->bmap;
+		bank->omap_bits[0] = bank->frame_count;
+		bank->order_count = 1;
+		for (o = 1; o <= RAM_MAX_FRAME_ORDER; o++) {
+			if ((bank->start & order_mask(o + VMM_PAGE_SHIFT)) ||
+			    !(bank->frame_count >> o)) {
+				break;
+			}
+			bank->omap[o] = (unsigned long *)hkbase;
+			bank->omap_bits[o] = bank->frame_count >> o;
+			bitmap_zero(bank->omap[o], bank->omap_bits[o]);
+			hkbase += bitmap_estimate_size(bank->omap_bits[o]);
+			bank->order_count++;
+		}
 
 		bank->res.start = bank->start;
 		bank->res.end = bank->start + bank->size - 1;
@@ -387,8 +848,6 @@ int __init vmm_host_ram_init(virtual_addr_t hkbase)
 		if (rc) {
 			return rc;
 		}
-
-		hkbase += bank->bmap_sz;
 	}
 
 	return VMM_OK;
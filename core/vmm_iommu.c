@@ -40,6 +40,7 @@
 #include <vmm_devdrv.h>
 #include <vmm_stdio.h>
 #include <vmm_iommu.h>
+#include <vmm_guest_aspace.h>
 #include <arch_atomic.h>
 #include <libs/bitops.h>
 #include <libs/stringlib.h>
@@ -442,6 +443,9 @@ VMM_EXPORT_SYMBOL(vmm_iommu_domain_alloc);
 
 void vmm_iommu_domain_free(struct vmm_iommu_domain *domain)
 {
+	if (domain->guest)
+		vmm_iommu_guest_unsync(domain);
+
 	if (likely(domain->ops->domain_destroy != NULL))
 		domain->ops->domain_destroy(domain);
 
@@ -616,8 +620,8 @@ int vmm_iommu_map(struct vmm_iommu_domain *domain, unsigned long iova,
 }
 VMM_EXPORT_SYMBOL(vmm_iommu_map);
 
-size_t vmm_iommu_unmap(struct vmm_iommu_domain *domain,
-			unsigned long iova, size_t size)
+size_t vmm_iommu_unmap_fast(struct vmm_iommu_domain *domain,
+			    unsigned long iova, size_t size)
 {
 	size_t unmapped_page, min_pagesz, unmapped = 0;
 
@@ -656,14 +660,239 @@ size_t vmm_iommu_unmap(struct vmm_iommu_domain *domain,
 		pr_debug("unmapped: iova 0x%lx size 0x%lx\n",
 			 iova, (unsigned long)unmapped_page);
 
+		if (domain->ops->iotlb_range_add)
+			domain->ops->iotlb_range_add(domain, iova,
+						     unmapped_page);
+
 		iova += unmapped_page;
 		unmapped += unmapped_page;
 	}
 
 	return unmapped;
 }
+VMM_EXPORT_SYMBOL(vmm_iommu_unmap_fast);
+
+void vmm_iommu_iotlb_sync(struct vmm_iommu_domain *domain)
+{
+	if (domain->ops->iotlb_sync)
+		domain->ops->iotlb_sync(domain);
+}
+VMM_EXPORT_SYMBOL(vmm_iommu_iotlb_sync);
+
+size_t vmm_iommu_unmap(struct vmm_iommu_domain *domain,
+			unsigned long iova, size_t size)
+{
+	size_t unmapped = vmm_iommu_unmap_fast(domain, iova, size);
+
+	vmm_iommu_iotlb_sync(domain);
+
+	return unmapped;
+}
 VMM_EXPORT_SYMBOL(vmm_iommu_unmap);
 
+/*
+ * Guest RAM regions are physically contiguous on host so each one is
+ * mapped as a single range which vmm_iommu_map() splits into largest
+ * pages allowed by alignment of guest and host physical addresses.
+ */
+#define IOMMU_GUEST_RAM_FLAGS	(VMM_REGION_REAL | VMM_REGION_MEMORY | \
+				 VMM_REGION_ISRAM)
+
+static bool iommu_guest_region_ram(struct vmm_region *reg)
+{
+	if ((reg->flags & IOMMU_GUEST_RAM_FLAGS) != IOMMU_GUEST_RAM_FLAGS)
+		return FALSE;
+
+	return (reg->flags & VMM_REGION_ALIAS) ? FALSE : TRUE;
+}
+
+static int iommu_guest_map_region(struct vmm_guest *guest,
+				  struct vmm_region *reg, void *priv)
+{
+	int ret;
+	struct vmm_iommu_domain *domain = priv;
+
+	if (!iommu_guest_region_ram(reg))
+		return VMM_OK;
+
+	/* Devices can access lazy guest RAM anytime */
+	ret = vmm_guest_populate_region(guest, reg);
+	if (ret)
+		return ret;
+
+	ret = vmm_iommu_map(domain, reg->gphys_addr, reg->hphys_addr,
+			    reg->phys_size, domain->guest_prot);
+	if (ret)
+		pr_err("%s: guest=%s gphys=0x%"PRIPADDR" map failed "
+		       "(error %d)\n", __func__, guest->name,
+		       reg->gphys_addr, ret);
+
+	return ret;
+}
+
+static int iommu_guest_unmap_region(struct vmm_guest *guest,
+				    struct vmm_region *reg, void *priv)
+{
+	struct vmm_iommu_domain *domain = priv;
+
+	if (!iommu_guest_region_ram(reg))
+		return VMM_OK;
+
+	vmm_iommu_unmap_fast(domain, reg->gphys_addr, reg->phys_size);
+
+	return VMM_OK;
+}
+
+static void iommu_guest_unmap_all(struct vmm_iommu_domain *domain)
+{
+	vmm_guest_iterate_mem_regions(domain->guest, IOMMU_GUEST_RAM_FLAGS,
+				      iommu_guest_unmap_region, domain);
+	vmm_iommu_iotlb_sync(domain);
+}
+
+struct iommu_guest_run {
+	physical_addr_t gphys;
+	physical_addr_t hphys;
+	physical_size_t size;
+};
+
+static void iommu_guest_run_flush(struct vmm_guest *guest,
+				  struct vmm_iommu_domain *domain,
+				  struct iommu_guest_run *run)
+{
+	int ret;
+
+	if (!run->size)
+		return;
+
+	ret = vmm_iommu_map(domain, run->gphys, run->hphys,
+			    run->size, domain->guest_prot);
+	if (ret)
+		pr_err("%s: guest=%s gphys=0x%"PRIPADDR" map failed "
+		       "(error %d)\n", __func__, guest->name,
+		       run->gphys, ret);
+
+	run->size = 0;
+}
+
+/*
+ * Added regions which are contiguous in both guest and host physical
+ * address space are mapped together so that IOMMU driver can use
+ * larger page sizes and the IOTLB is synced once for whole batch.
+ */
+static void iommu_guest_batch(struct vmm_guest *guest,
+			      struct vmm_iommu_domain *domain,
+			      struct vmm_guest_aspace_batch *batch)
+{
+	struct vmm_region *reg;
+	struct vmm_guest_aspace_change *c;
+	struct iommu_guest_run run = { .size = 0 };
+
+	vmm_guest_aspace_for_each_change(c, batch) {
+		reg = c->reg;
+		if (!iommu_guest_region_ram(reg))
+			continue;
+
+		if (c->type == VMM_GUEST_ASPACE_EVENT_DEL_REGION) {
+			iommu_guest_run_flush(guest, domain, &run);
+			vmm_iommu_unmap_fast(domain, reg->gphys_addr,
+					     reg->phys_size);
+			continue;
+		}
+
+		/* Devices can access lazy guest RAM anytime */
+		if (vmm_guest_populate_region(guest, reg))
+			continue;
+
+		if (run.size &&
+		    (run.gphys + run.size == reg->gphys_addr) &&
+		    (run.hphys + run.size == reg->hphys_addr)) {
+			run.size += reg->phys_size;
+			continue;
+		}
+
+		iommu_guest_run_flush(guest, domain, &run);
+		run.gphys = reg->gphys_addr;
+		run.hphys = reg->hphys_addr;
+		run.size = reg->phys_size;
+	}
+	iommu_guest_run_flush(guest, domain, &run);
+
+	if (batch->del_count)
+		vmm_iommu_iotlb_sync(domain);
+}
+
+static int iommu_guest_aspace_notification(struct vmm_notifier_block *nb,
+					   unsigned long evt, void *data)
+{
+	struct vmm_guest_aspace_event *edata = data;
+	struct vmm_iommu_domain *domain =
+		container_of(nb, struct vmm_iommu_domain, guest_nb);
+
+	if (edata->guest != domain->guest)
+		return NOTIFY_DONE;
+
+	switch (evt) {
+	case VMM_GUEST_ASPACE_EVENT_BATCH:
+		iommu_guest_batch(edata->guest, domain, edata->data);
+		break;
+	case VMM_GUEST_ASPACE_EVENT_DEINIT:
+		iommu_guest_unmap_all(domain);
+		break;
+	default:
+		return NOTIFY_DONE;
+	}
+
+	return NOTIFY_OK;
+}
+
+int vmm_iommu_guest_sync(struct vmm_iommu_domain *domain,
+			 struct vmm_guest *guest, int prot)
+{
+	int ret;
+
+	if (!domain || !guest)
+		return VMM_EINVALID;
+	if (domain->guest)
+		return (domain->guest == guest) ? VMM_OK : VMM_EBUSY;
+
+	domain->guest = guest;
+	domain->guest_prot = prot;
+	domain->guest_nb.notifier_call = iommu_guest_aspace_notification;
+	domain->guest_nb.priority = 0;
+
+	ret = vmm_guest_aspace_register_client(&domain->guest_nb);
+	if (ret)
+		goto out_clear;
+
+	ret = vmm_guest_iterate_mem_regions(guest, IOMMU_GUEST_RAM_FLAGS,
+					    iommu_guest_map_region, domain);
+	if (ret)
+		goto out_unregister;
+
+	return VMM_OK;
+
+out_unregister:
+	vmm_guest_aspace_unregister_client(&domain->guest_nb);
+	iommu_guest_unmap_all(domain);
+out_clear:
+	domain->guest = NULL;
+
+	return ret;
+}
+VMM_EXPORT_SYMBOL(vmm_iommu_guest_sync);
+
+void vmm_iommu_guest_unsync(struct vmm_iommu_domain *domain)
+{
+	if (!domain || !domain->guest)
+		return;
+
+	vmm_guest_aspace_unregister_client(&domain->guest_nb);
+	iommu_guest_unmap_all(domain);
+	domain->guest = NULL;
+}
+VMM_EXPORT_SYMBOL(vmm_iommu_guest_unsync);
+
 int vmm_iommu_domain_window_enable(struct vmm_iommu_domain *domain,
 				   u32 wnd_nr, physical_addr_t paddr,
 				   u64 size, int prot)
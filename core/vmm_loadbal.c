@@ -25,15 +25,19 @@
 #include <vmm_error.h>
 #include <vmm_timer.h>
 #include <vmm_manager.h>
+#include <vmm_scheduler.h>
 #include <vmm_threads.h>
 #include <vmm_mutex.h>
 #include <vmm_completion.h>
 #include <vmm_loadbal.h>
+#include <libs/stringlib.h>
 
 #define LOADBAL_PRIORITY 		VMM_VCPU_DEF_PRIORITY
 #define LOADBAL_TIMESLICE 		VMM_VCPU_DEF_TIME_SLICE
 #define LOADBAL_PERIOD			(CONFIG_LOADBAL_PERIOD_SECS * \
 					 1000000000ULL)
+#define LOADBAL_IDLE_INTERVAL		(CONFIG_LOADBAL_IDLE_PULL_MSECS * \
+					 1000000ULL)
 
 struct vmm_loadbal_ctrl {
 	struct vmm_mutex curr_algo_lock;
@@ -42,6 +46,9 @@ struct vmm_loadbal_ctrl {
 	struct dlist algo_list;
 	struct vmm_completion loadbal_cmpl;
 	struct vmm_thread *loadbal_thread;
+	vmm_spinlock_t idle_lock;
+	struct vmm_cpumask idle_mask;
+	u64 idle_tstamp[CONFIG_CPU_COUNT];
 };
 
 static bool lbctrl_init_done = FALSE;
@@ -55,8 +62,9 @@ u32 vmm_loadbal_good_hcpu(u8 priority)
 	    !vmm_timer_started() ||
 	    (VMM_VCPU_MAX_PRIORITY < priority) ||
 	    (priority < VMM_VCPU_MIN_PRIORITY) ||
-	    (vmm_cpumask_weight(cpu_online_mask) < 2)) {
-		return vmm_smp_processor_id();
+	    (vmm_num_housekeeping_cpus() < 2)) {
+		ret = vmm_smp_processor_id();
+		goto done;
 	}
 
 	vmm_mutex_lock(&lbctrl.curr_algo_lock);
@@ -69,25 +77,115 @@ u32 vmm_loadbal_good_hcpu(u8 priority)
 
 	vmm_mutex_unlock(&lbctrl.curr_algo_lock);
 
+done:
+	/* New VCPUs are never placed on isolated host CPUs */
+	if (vmm_cpu_isolated(ret)) {
+		ret = vmm_cpumask_first(cpu_housekeeping_mask);
+	}
+
 	return ret;
 }
 
-static int loadbal_main(void *data)
+void vmm_loadbal_idle_notify(void)
 {
+	u8 prio;
 	u64 tstamp;
+	irq_flags_t flags;
+	bool pull = FALSE;
+	u32 cpu, hcpu = vmm_smp_processor_id();
+
+	if (!lbctrl_init_done ||
+	    !vmm_timer_started() ||
+	    vmm_cpu_isolated(hcpu) ||
+	    (vmm_num_housekeeping_cpus() < 2)) {
+		return;
+	}
+
+	tstamp = vmm_timer_timestamp();
+	if (tstamp < (lbctrl.idle_tstamp[hcpu] + LOADBAL_IDLE_INTERVAL)) {
+		return;
+	}
+	lbctrl.idle_tstamp[hcpu] = tstamp;
+
+	/* Wakeup load balancer only if some other host CPU has
+	 * READY VCPUs waiting. The lowest priority is skipped
+	 * because idle VCPUs of busy host CPUs are READY at
+	 * lowest priority.
+	 */
+	for_each_housekeeping_cpu(cpu) {
+		if (cpu == hcpu) {
+			continue;
+		}
+		for (prio = VMM_VCPU_MIN_PRIORITY + 1;
+		     prio <= VMM_VCPU_MAX_PRIORITY; prio++) {
+			if (vmm_scheduler_ready_count(cpu, prio)) {
+				pull = TRUE;
+				break;
+			}
+		}
+		if (pull) {
+			break;
+		}
+	}
+	if (!pull) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&lbctrl.idle_lock, flags);
+	vmm_cpumask_set_cpu(hcpu, &lbctrl.idle_mask);
+	vmm_spin_unlock_irqrestore_lite(&lbctrl.idle_lock, flags);
+
+	vmm_completion_complete_once(&lbctrl.loadbal_cmpl);
+}
+
+static void loadbal_idle_pull(void)
+{
+	u32 hcpu;
+	irq_flags_t flags;
+	struct vmm_cpumask idle_mask;
+
+	vmm_spin_lock_irqsave_lite(&lbctrl.idle_lock, flags);
+	vmm_cpumask_copy(&idle_mask, &lbctrl.idle_mask);
+	vmm_cpumask_clear(&lbctrl.idle_mask);
+	vmm_spin_unlock_irqrestore_lite(&lbctrl.idle_lock, flags);
+
+	if (!lbctrl.curr_algo || !lbctrl.curr_algo->idle_pull) {
+		return;
+	}
+
+	for_each_cpu(hcpu, &idle_mask) {
+		lbctrl.curr_algo->idle_pull(lbctrl.curr_algo, hcpu);
+	}
+}
+
+static int loadbal_main(void *data)
+{
+	u64 tstamp, now, next_balance;
+
+	next_balance = vmm_timer_timestamp() + LOADBAL_PERIOD;
 
 	while (1) {
-		tstamp = LOADBAL_PERIOD;
-		vmm_completion_wait_timeout(&lbctrl.loadbal_cmpl, &tstamp);
+		now = vmm_timer_timestamp();
+		tstamp = (now < next_balance) ? (next_balance - now) : 0;
+		if (tstamp) {
+			vmm_completion_wait_timeout(&lbctrl.loadbal_cmpl,
+						    &tstamp);
+		}
 
-		if (vmm_cpumask_weight(cpu_online_mask) < 2) {
+		if (vmm_num_housekeeping_cpus() < 2) {
+			next_balance = vmm_timer_timestamp() + LOADBAL_PERIOD;
 			continue;
 		}
 
 		vmm_mutex_lock(&lbctrl.curr_algo_lock);
 
-		if (lbctrl.curr_algo && lbctrl.curr_algo->balance) {
-			lbctrl.curr_algo->balance(lbctrl.curr_algo);
+		loadbal_idle_pull();
+
+		if (next_balance <= vmm_timer_timestamp()) {
+			if (lbctrl.curr_algo && lbctrl.curr_algo->balance) {
+				lbctrl.curr_algo->balance(lbctrl.curr_algo);
+			}
+			next_balance = vmm_timer_timestamp() + LOADBAL_PERIOD;
 		}
 
 		vmm_mutex_unlock(&lbctrl.curr_algo_lock);
@@ -258,6 +356,11 @@ int __init vmm_loadbal_init(void)
 	/* Initialize loadbal completion */
 	INIT_COMPLETION(&lbctrl.loadbal_cmpl);
 
+	/* Initialize idle pull tracking */
+	INIT_SPIN_LOCK(&lbctrl.idle_lock);
+	vmm_cpumask_clear(&lbctrl.idle_mask);
+	memset(lbctrl.idle_tstamp, 0, sizeof(lbctrl.idle_tstamp));
+
 	/* Create loadbal thread with default time slice */
 	lbctrl.loadbal_thread = vmm_threads_create("loadbal",
 						   loadbal_main, NULL,
@@ -0,0 +1,337 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_lockstat.c
+ * @author agent (agent@local)
+ * @brief Lock contention statistics implementation
+ *
+ * Counters of a lock class are kept per host CPU so that accounting
+ * does not need atomics. The registry of lock classes is protected
+ * by a raw arch spinlock because vmm_spinlock itself is accounted.
+ */
+
+#include <vmm_error.h>
+#include <vmm_compiler.h>
+#include <vmm_smp.h>
+#include <vmm_timer.h>
+#include <vmm_spinlocks.h>
+#include <vmm_lockstat.h>
+#include <arch_cpu_irq.h>
+#include <arch_locks.h>
+#include <libs/stringlib.h>
+
+#define LOCKSTAT_STATIC_COUNT	CONFIG_LOCKSTAT_STATIC_COUNT
+
+struct vmm_lockstat_ctrl {
+	arch_spinlock_t lock;
+	struct vmm_lockstat_class *head;
+	u32 static_used;
+	struct vmm_lockstat_class static_class[LOCKSTAT_STATIC_COUNT];
+	struct vmm_lockstat_class overflow_class;
+};
+
+static struct vmm_lockstat_ctrl lsctrl = {
+	.lock = ARCH_SPIN_LOCK_INITIALIZER,
+	.head = NULL,
+	.static_used = 0,
+	.overflow_class = VMM_LOCKSTAT_CLASS_INITIALIZER("(overflow)",
+						VMM_LOCKSTAT_SPINLOCK),
+};
+
+static const char *const lockstat_type_names[VMM_LOCKSTAT_MAX_TYPES] = {
+	[VMM_LOCKSTAT_SPINLOCK] = "spinlock",
+	[VMM_LOCKSTAT_RWLOCK] = "rwlock",
+	[VMM_LOCKSTAT_MUTEX] = "mutex",
+};
+
+static void lockstat_register(struct vmm_lockstat_class *cls)
+{
+	irq_flags_t flags;
+
+	arch_cpu_irq_save(flags);
+	arch_spin_lock(&lsctrl.lock);
+
+	if (!cls->registered) {
+		cls->next = lsctrl.head;
+		lsctrl.head = cls;
+		cls->registered = TRUE;
+	}
+
+	arch_spin_unlock(&lsctrl.lock);
+	arch_cpu_irq_restore(flags);
+}
+
+struct vmm_lockstat_class *vmm_lockstat_class_get(
+					struct vmm_lockstat_class **clsp,
+					const void *lock, u32 type)
+{
+	irq_flags_t flags;
+	struct vmm_lockstat_class *cls = *clsp;
+
+	if (likely(cls && cls->registered)) {
+		return cls;
+	}
+
+	if (!cls) {
+		/* Statically initialized locks are never freed */
+		arch_cpu_irq_save(flags);
+		arch_spin_lock(&lsctrl.lock);
+
+		cls = *clsp;
+		if (!cls) {
+			if (lsctrl.static_used < LOCKSTAT_STATIC_COUNT) {
+				cls = &lsctrl.static_class[lsctrl.static_used];
+				lsctrl.static_used++;
+				cls->name = NULL;
+				cls->addr = lock;
+				cls->type = type;
+			} else {
+				cls = &lsctrl.overflow_class;
+			}
+			*clsp = cls;
+		}
+
+		arch_spin_unlock(&lsctrl.lock);
+		arch_cpu_irq_restore(flags);
+	}
+
+	lockstat_register(cls);
+
+	return cls;
+}
+
+u64 vmm_lockstat_tstamp(void)
+{
+	return vmm_timer_timestamp_for_profile();
+}
+
+u64 vmm_lockstat_acquired(struct vmm_lockstat_class *cls,
+			  bool contended, u64 wait_tstamp)
+{
+	u64 wait_ns, tstamp = vmm_lockstat_tstamp();
+	struct vmm_lockstat_counters *cnt = &cls->cpu[arch_smp_id()];
+
+	cnt->acquired++;
+	if (contended) {
+		wait_ns = tstamp - wait_tstamp;
+		cnt->contended++;
+		cnt->wait_total_ns += wait_ns;
+		if (cnt->wait_max_ns < wait_ns) {
+			cnt->wait_max_ns = wait_ns;
+		}
+	}
+
+	return tstamp;
+}
+
+void vmm_lockstat_released(struct vmm_lockstat_class *cls,
+			   u64 hold_tstamp)
+{
+	u64 hold_ns;
+	struct vmm_lockstat_counters *cnt;
+
+	if (!cls) {
+		return;
+	}
+
+	cnt = &cls->cpu[arch_smp_id()];
+	hold_ns = vmm_lockstat_tstamp() - hold_tstamp;
+	cnt->hold_total_ns += hold_ns;
+	if (cnt->hold_max_ns < hold_ns) {
+		cnt->hold_max_ns = hold_ns;
+	}
+}
+
+const char *vmm_lockstat_type_name(u32 type)
+{
+	return (type < VMM_LOCKSTAT_MAX_TYPES) ?
+				lockstat_type_names[type] : NULL;
+}
+
+int vmm_lockstat_iterate(int (*iter)(struct vmm_lockstat_class *, void *),
+			 void *priv)
+{
+	int rc;
+	struct vmm_lockstat_class *cls;
+
+	if (!iter) {
+		return VMM_EINVALID;
+	}
+
+	/* Lock classes are only added at head and never removed */
+	for (cls = lsctrl.head; cls; cls = cls->next) {
+		rc = iter(cls, priv);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return VMM_OK;
+}
+
+void vmm_lockstat_get(struct vmm_lockstat_class *cls,
+		      struct vmm_lockstat_counters *cnt)
+{
+	u32 cpu;
+	struct vmm_lockstat_counters *c;
+
+	memset(cnt, 0, sizeof(*cnt));
+	if (!cls) {
+		return;
+	}
+
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		c = &cls->cpu[cpu];
+		cnt->acquired += c->acquired;
+		cnt->contended += c->contended;
+		cnt->wait_total_ns += c->wait_total_ns;
+		if (cnt->wait_max_ns < c->wait_max_ns) {
+			cnt->wait_max_ns = c->wait_max_ns;
+		}
+		cnt->hold_total_ns += c->hold_total_ns;
+		if (cnt->hold_max_ns < c->hold_max_ns) {
+			cnt->hold_max_ns = c->hold_max_ns;
+		}
+	}
+}
+
+void vmm_lockstat_reset(void)
+{
+	struct vmm_lockstat_class *cls;
+
+	for (cls = lsctrl.head; cls; cls = cls->next) {
+		memset(cls->cpu, 0, sizeof(cls->cpu));
+	}
+}
+
+void __vmm_lockstat_spin_lock(vmm_spinlock_t *lock)
+{
+	bool contended = FALSE;
+	u64 wait_tstamp = 0;
+	struct vmm_lockstat_class *cls =
+		vmm_lockstat_class_get(&lock->__class, lock,
+				       VMM_LOCKSTAT_SPINLOCK);
+
+	if (!arch_spin_trylock(&lock->__tlock)) {
+		contended = TRUE;
+		wait_tstamp = vmm_lockstat_tstamp();
+		arch_spin_lock(&lock->__tlock);
+	}
+
+	lock->__hold_tstamp = vmm_lockstat_acquired(cls, contended,
+						    wait_tstamp);
+}
+
+int __vmm_lockstat_spin_trylock(vmm_spinlock_t *lock)
+{
+	struct vmm_lockstat_class *cls;
+
+	if (!arch_spin_trylock(&lock->__tlock)) {
+		return 0;
+	}
+
+	cls = vmm_lockstat_class_get(&lock->__class, lock,
+				     VMM_LOCKSTAT_SPINLOCK);
+	lock->__hold_tstamp = vmm_lockstat_acquired(cls, FALSE, 0);
+
+	return 1;
+}
+
+void __vmm_lockstat_spin_unlock(vmm_spinlock_t *lock)
+{
+	vmm_lockstat_released(lock->__class, lock->__hold_tstamp);
+	arch_spin_unlock(&lock->__tlock);
+}
+
+void __vmm_lockstat_write_lock(vmm_rwlock_t *lock)
+{
+	bool contended = FALSE;
+	u64 wait_tstamp = 0;
+	struct vmm_lockstat_class *cls =
+		vmm_lockstat_class_get(&lock->__class, lock,
+				       VMM_LOCKSTAT_RWLOCK);
+
+	if (!arch_write_trylock(&lock->__tlock)) {
+		contended = TRUE;
+		wait_tstamp = vmm_lockstat_tstamp();
+		arch_write_lock(&lock->__tlock);
+	}
+
+	lock->__hold_tstamp = vmm_lockstat_acquired(cls, contended,
+						    wait_tstamp);
+}
+
+int __vmm_lockstat_write_trylock(vmm_rwlock_t *lock)
+{
+	struct vmm_lockstat_class *cls;
+
+	if (!arch_write_trylock(&lock->__tlock)) {
+		return 0;
+	}
+
+	cls = vmm_lockstat_class_get(&lock->__class, lock,
+				     VMM_LOCKSTAT_RWLOCK);
+	lock->__hold_tstamp = vmm_lockstat_acquired(cls, FALSE, 0);
+
+	return 1;
+}
+
+void __vmm_lockstat_write_unlock(vmm_rwlock_t *lock)
+{
+	vmm_lockstat_released(lock->__class, lock->__hold_tstamp);
+	arch_write_unlock(&lock->__tlock);
+}
+
+/*
+ * Readers share the lock so only acquisitions and waits are
+ * accounted for them, hold time is tracked for writers only.
+ */
+void __vmm_lockstat_read_lock(vmm_rwlock_t *lock)
+{
+	bool contended = FALSE;
+	u64 wait_tstamp = 0;
+	struct vmm_lockstat_class *cls =
+		vmm_lockstat_class_get(&lock->__class, lock,
+				       VMM_LOCKSTAT_RWLOCK);
+
+	if (!arch_read_trylock(&lock->__tlock)) {
+		contended = TRUE;
+		wait_tstamp = vmm_lockstat_tstamp();
+		arch_read_lock(&lock->__tlock);
+	}
+
+	vmm_lockstat_acquired(cls, contended, wait_tstamp);
+}
+
+int __vmm_lockstat_read_trylock(vmm_rwlock_t *lock)
+{
+	if (!arch_read_trylock(&lock->__tlock)) {
+		return 0;
+	}
+
+	vmm_lockstat_acquired(vmm_lockstat_class_get(&lock->__class, lock,
+						     VMM_LOCKSTAT_RWLOCK),
+			      FALSE, 0);
+
+	return 1;
+}
+
+void __vmm_lockstat_read_unlock(vmm_rwlock_t *lock)
+{
+	arch_read_unlock(&lock->__tlock);
+}
@@ -27,6 +27,7 @@
 #include <vmm_stdio.h>
 #include <vmm_version.h>
 #include <vmm_host_aspace.h>
+#include <vmm_host_ram.h>
 #include <vmm_host_irq.h>
 #include <vmm_smp.h>
 #include <vmm_percpu.h>
@@ -49,6 +50,7 @@
 #include <vmm_extable.h>
 #include <arch_cpu.h>
 #include <arch_board.h>
+#include <libs/kallsyms.h>
 
 /* Optional includes */
 #include <drv/rtc.h>
@@ -80,6 +82,12 @@ static void system_postinit_work(struct vmm_work *work)
 #endif
 	struct vmm_devtree_node *node, *node1;
 
+	/* Wait for asynchronous device probing so that console, rtc
+	 * and devices used by boot commands (or guests) are available
+	 */
+	vmm_printf("init: waiting for asynchronous device probing\n");
+	vmm_devdrv_async_probe_sync();
+
 	/* Print status of present host CPUs */
 	for_each_present_cpu(c) {
 		if (vmm_cpu_online(c)) {
@@ -172,6 +180,24 @@ static void system_init_work(struct vmm_work *work)
 	u32 c;
 #endif
 
+#if defined(CONFIG_LOG_ASYNC)
+	/* Start asynchronous log */
+	vmm_printf("init: asynchronous log\n");
+	ret = vmm_stdio_async_init();
+	if (ret) {
+		goto fail;
+	}
+#endif
+
+#if defined(CONFIG_HOST_RAM_PREZERO)
+	/* Start pre-zeroing of free host RAM */
+	vmm_printf("init: host RAM pre-zeroing\n");
+	ret = vmm_host_ram_prezero_init();
+	if (ret) {
+		goto fail;
+	}
+#endif
+
 	/* Initialize wallclock */
 	vmm_printf("init: wallclock subsystem\n");
 	ret = vmm_wallclock_init();
@@ -339,6 +365,13 @@ static void __init init_bootcpu(void)
 		goto init_bootcpu_fail;
 	}
 
+	/* Initialize kernel symbol lookup index */
+	vmm_printf("init: kernel symbols\n");
+	ret = kallsyms_init();
+	if (ret) {
+		goto init_bootcpu_fail;
+	}
+
 	/* Initialize per-cpu area */
 	vmm_printf("init: per-CPU areas\n");
 	ret = vmm_percpu_init();
@@ -33,10 +33,12 @@
 #include <vmm_loadbal.h>
 #include <vmm_waitqueue.h>
 #include <vmm_workqueue.h>
+#include <vmm_completion.h>
 #include <vmm_manager.h>
 #include <arch_vcpu.h>
 #include <arch_guest.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 
 #undef DEBUG
 
@@ -59,12 +61,113 @@ struct vmm_manager_ctrl {
 	bool guest_avail_array[CONFIG_MAX_GUEST_COUNT];
 	struct dlist orphan_vcpu_list;
 	struct dlist guest_list;
+	/* Bandwidth reserved by deadline class VCPUs */
+	vmm_spinlock_t deadline_lock;
+	u64 deadline_bw;
 	/* Work structs to process guest request */
 	struct vmm_work guest_work_array[CONFIG_MAX_GUEST_COUNT];
 };
 
 static struct vmm_manager_ctrl mngr;
 
+/* Bandwidth of one host CPU for deadline class admission */
+#define MANAGER_DEADLINE_BW_SHIFT	20
+#define MANAGER_DEADLINE_BW_ONE		(1ULL << MANAGER_DEADLINE_BW_SHIFT)
+
+static u64 manager_deadline_bw(struct vmm_vcpu *vcpu)
+{
+	if (!vcpu->is_deadline || !vcpu->periodicity) {
+		return 0;
+	}
+
+	return udiv64(vcpu->time_slice << MANAGER_DEADLINE_BW_SHIFT,
+		      vcpu->periodicity);
+}
+
+/* Reserve given bandwidth or fail if total reserved bandwidth
+ * would exceed allowed share of online host CPUs.
+ */
+static int manager_deadline_reserve(u64 bw)
+{
+	irq_flags_t flags;
+	u64 limit;
+
+	if (!bw) {
+		return VMM_OK;
+	}
+
+#ifdef CONFIG_SCHEDALGO_EDF
+	limit = udiv64(MANAGER_DEADLINE_BW_ONE *
+		       CONFIG_SCHEDALGO_EDF_BW_PERCENT, 100);
+#else
+	limit = MANAGER_DEADLINE_BW_ONE;
+#endif
+	limit *= vmm_num_online_cpus();
+
+	vmm_spin_lock_irqsave(&mngr.deadline_lock, flags);
+
+	if (limit < (mngr.deadline_bw + bw)) {
+		vmm_spin_unlock_irqrestore(&mngr.deadline_lock, flags);
+		return VMM_ENOSPC;
+	}
+	mngr.deadline_bw += bw;
+
+	vmm_spin_unlock_irqrestore(&mngr.deadline_lock, flags);
+
+	return VMM_OK;
+}
+
+static int manager_vcpu_deadline_admit(struct vmm_vcpu *vcpu)
+{
+	int rc;
+	u64 bw = manager_deadline_bw(vcpu);
+
+	if ((rc = manager_deadline_reserve(bw))) {
+		return rc;
+	}
+	vcpu->deadline_bw = bw;
+
+	return VMM_OK;
+}
+
+static int manager_guest_deadline_admit(struct vmm_guest *guest)
+{
+	int rc;
+	u64 bw = 0;
+	irq_flags_t flags;
+	struct vmm_vcpu *vcpu;
+
+	vmm_read_lock_irqsave_lite(&guest->vcpu_lock, flags);
+	list_for_each_entry(vcpu, &guest->vcpu_list, head) {
+		bw += manager_deadline_bw(vcpu);
+	}
+	vmm_read_unlock_irqrestore_lite(&guest->vcpu_lock, flags);
+
+	if ((rc = manager_deadline_reserve(bw))) {
+		return rc;
+	}
+
+	vmm_read_lock_irqsave_lite(&guest->vcpu_lock, flags);
+	list_for_each_entry(vcpu, &guest->vcpu_list, head) {
+		vcpu->deadline_bw = manager_deadline_bw(vcpu);
+	}
+	vmm_read_unlock_irqrestore_lite(&guest->vcpu_lock, flags);
+
+	return VMM_OK;
+}
+
+static void manager_deadline_release(struct vmm_vcpu *vcpu)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&mngr.deadline_lock, flags);
+
+	mngr.deadline_bw -= vcpu->deadline_bw;
+	vcpu->deadline_bw = 0;
+
+	vmm_spin_unlock_irqrestore(&mngr.deadline_lock, flags);
+}
+
 void vmm_manager_lock(void)
 {
 	vmm_mutex_lock(&mngr.lock);
@@ -236,6 +339,159 @@ int vmm_manager_vcpu_stats(struct vmm_vcpu *vcpu,
 	return VMM_OK;
 }
 
+#ifdef CONFIG_VCPU_EXIT_STATS
+static const char *const vcpu_exit_names[VMM_VCPU_EXIT_MAX] = {
+	[VMM_VCPU_EXIT_MMIO] = "mmio",
+	[VMM_VCPU_EXIT_WFI] = "wfi",
+	[VMM_VCPU_EXIT_HYPCALL] = "hypcall",
+	[VMM_VCPU_EXIT_SYSREG] = "sysreg",
+	[VMM_VCPU_EXIT_IO] = "io",
+	[VMM_VCPU_EXIT_IRQ] = "irq",
+	[VMM_VCPU_EXIT_OTHER] = "other",
+};
+
+static const char *const vcpu_exit_phase_names[VMM_VCPU_EXIT_PHASE_MAX] = {
+	[VMM_VCPU_EXIT_PHASE_DISPATCH] = "dispatch",
+	[VMM_VCPU_EXIT_PHASE_EMULATE] = "emulate",
+	[VMM_VCPU_EXIT_PHASE_RESTORE] = "restore",
+};
+
+u64 vmm_manager_vcpu_exit_tstamp(void)
+{
+	return vmm_timer_timestamp_for_profile();
+}
+
+void vmm_manager_vcpu_exit_account(struct vmm_vcpu *vcpu, u32 reason,
+				   u64 tstamp, u64 emulate_tstamp)
+{
+	u32 b = 0;
+	u64 ns, t, now;
+	struct vmm_vcpu_exit_stats *st;
+
+	if (!vcpu || (VMM_VCPU_EXIT_MAX <= reason)) {
+		return;
+	}
+
+	/*
+	 * Exits of a VCPU are always handled on the host CPU on which
+	 * it is running hence no locking is required here.
+	 */
+	now = vmm_timer_timestamp_for_profile();
+	ns = now - tstamp;
+	st = &vcpu->exit_stats[reason];
+	st->count++;
+	st->total_ns += ns;
+	if (st->max_ns < ns) {
+		st->max_ns = ns;
+	}
+	st->phase_ns[VMM_VCPU_EXIT_PHASE_DISPATCH] += emulate_tstamp - tstamp;
+	st->phase_ns[VMM_VCPU_EXIT_PHASE_EMULATE] += now - emulate_tstamp;
+	vcpu->exit_last_reason = reason;
+	vcpu->exit_done_tstamp = now;
+
+	t = ns >> 8;
+	while (t && (b < (VMM_VCPU_EXIT_HIST_BUCKETS - 1))) {
+		t >>= 1;
+		b++;
+	}
+	st->hist[b]++;
+}
+
+void vmm_manager_vcpu_exit_return(struct vmm_vcpu *vcpu)
+{
+	struct vmm_vcpu_exit_stats *st;
+
+	if (!vcpu || !vcpu->exit_done_tstamp) {
+		return;
+	}
+
+	st = &vcpu->exit_stats[vcpu->exit_last_reason];
+	st->phase_ns[VMM_VCPU_EXIT_PHASE_RESTORE] +=
+		vmm_timer_timestamp_for_profile() - vcpu->exit_done_tstamp;
+	vcpu->exit_done_tstamp = 0;
+}
+
+const char *vmm_manager_vcpu_exit_name(u32 reason)
+{
+	return (reason < VMM_VCPU_EXIT_MAX) ? vcpu_exit_names[reason] : NULL;
+}
+
+const char *vmm_manager_vcpu_exit_phase_name(u32 phase)
+{
+	return (phase < VMM_VCPU_EXIT_PHASE_MAX) ?
+				vcpu_exit_phase_names[phase] : NULL;
+}
+
+int vmm_manager_vcpu_exit_stats(struct vmm_vcpu *vcpu, u32 reason,
+				struct vmm_vcpu_exit_stats *stats)
+{
+	if (!vcpu || !stats || (VMM_VCPU_EXIT_MAX <= reason)) {
+		return VMM_EINVALID;
+	}
+
+	memcpy(stats, &vcpu->exit_stats[reason], sizeof(*stats));
+
+	return VMM_OK;
+}
+
+int vmm_manager_vcpu_exit_stats_reset(struct vmm_vcpu *vcpu)
+{
+	if (!vcpu) {
+		return VMM_EINVALID;
+	}
+
+	memset(vcpu->exit_stats, 0, sizeof(vcpu->exit_stats));
+	vcpu->exit_done_tstamp = 0;
+
+	return VMM_OK;
+}
+#endif
+
+#ifdef CONFIG_SCHED_LATENCY
+static const char *const vcpu_sched_latency_names[VMM_VCPU_SCHED_MAX] = {
+	[VMM_VCPU_SCHED_WAKEUP] = "wakeup",
+	[VMM_VCPU_SCHED_RQWAIT] = "rqwait",
+	[VMM_VCPU_SCHED_SLICE] = "slice",
+};
+
+const char *vmm_manager_vcpu_sched_latency_name(u32 type)
+{
+	return (type < VMM_VCPU_SCHED_MAX) ?
+				vcpu_sched_latency_names[type] : NULL;
+}
+
+int vmm_manager_vcpu_sched_latency(struct vmm_vcpu *vcpu, u32 type,
+				   struct vmm_vcpu_sched_latency *lat)
+{
+	irq_flags_t flags;
+
+	if (!vcpu || !lat || (VMM_VCPU_SCHED_MAX <= type)) {
+		return VMM_EINVALID;
+	}
+
+	vmm_read_lock_irqsave_lite(&vcpu->sched_lock, flags);
+	memcpy(lat, &vcpu->sched_latency[type], sizeof(*lat));
+	vmm_read_unlock_irqrestore_lite(&vcpu->sched_lock, flags);
+
+	return VMM_OK;
+}
+
+int vmm_manager_vcpu_sched_latency_reset(struct vmm_vcpu *vcpu)
+{
+	irq_flags_t flags;
+
+	if (!vcpu) {
+		return VMM_EINVALID;
+	}
+
+	vmm_write_lock_irqsave_lite(&vcpu->sched_lock, flags);
+	memset(vcpu->sched_latency, 0, sizeof(vcpu->sched_latency));
+	vmm_write_unlock_irqrestore_lite(&vcpu->sched_lock, flags);
+
+	return VMM_OK;
+}
+#endif
+
 u32 vmm_manager_vcpu_get_state(struct vmm_vcpu *vcpu)
 {
 	if (!vcpu) {
@@ -460,7 +716,8 @@ struct vmm_vcpu *vmm_manager_vcpu_orphan_create(const char *name,
 					    u8 priority,
 					    u64 time_slice_nsecs,
 					    u64 deadline,
-					    u64 periodicity)
+					    u64 periodicity,
+					    bool is_deadline)
 {
 	u32 vnum;
 	struct vmm_vcpu *vcpu = NULL;
@@ -547,10 +804,21 @@ struct vmm_vcpu *vmm_manager_vcpu_orphan_create(const char *name,
 	vcpu->reset_tstamp = 0;
 	vcpu->preempt_count = 0;
 	vcpu->resumed = FALSE;
+	vcpu->spinning = FALSE;
+	vcpu->preempt_tstamp = 0;
 	vcpu->sched_priv = NULL;
+#ifdef CONFIG_VCPU_EXIT_STATS
+	memset(vcpu->exit_stats, 0, sizeof(vcpu->exit_stats));
+	vcpu->exit_done_tstamp = 0;
+#endif
+#ifdef CONFIG_SCHED_LATENCY
+	vcpu->sched_woken = FALSE;
+	memset(vcpu->sched_latency, 0, sizeof(vcpu->sched_latency));
+#endif
 
 	/* Intialize static scheduling context */
 	vcpu->priority = priority;
+	vcpu->base_priority = priority;
 	vcpu->time_slice = time_slice_nsecs;
 	vcpu->deadline = deadline;
 	if (vcpu->deadline < vcpu->time_slice) {
@@ -560,11 +828,18 @@ struct vmm_vcpu *vmm_manager_vcpu_orphan_create(const char *name,
 	if (vcpu->periodicity < vcpu->deadline) {
 		vcpu->periodicity = vcpu->deadline;
 	}
+	vcpu->is_deadline = is_deadline;
+	vcpu->deadline_bw = 0;
+
+	/* Admit bandwidth of deadline class VCPU */
+	if (manager_vcpu_deadline_admit(vcpu)) {
+		goto fail_free_stack;
+	}
 
 	/* Initialize architecture specific context */
 	vcpu->arch_priv = NULL;
 	if (arch_vcpu_init(vcpu)) {
-		goto fail_free_stack;
+		goto fail_deadline_release;
 	}
 
 	/* Initialize resource list */
@@ -585,6 +860,8 @@ struct vmm_vcpu *vmm_manager_vcpu_orphan_create(const char *name,
 
 fail_vcpu_deinit:
 	arch_vcpu_deinit(vcpu);
+fail_deadline_release:
+	manager_deadline_release(vcpu);
 fail_free_stack:
 	vmm_free((void *)vcpu->stack_va);
 fail_list_del:
@@ -646,6 +923,9 @@ int vmm_manager_vcpu_orphan_destroy(struct vmm_vcpu *vcpu)
 		vmm_free((void *)vcpu->stack_va);
 	}
 
+	/* Release bandwidth of deadline class VCPU */
+	manager_deadline_release(vcpu);
+
 	/* Acquire manager lock */
 	vmm_manager_lock();
 
@@ -849,6 +1129,87 @@ int vmm_manager_guest_vcpu_iterate(struct vmm_guest *guest,
 	return rc;
 }
 
+#ifdef CONFIG_GUEST_BOOT_STATS
+#define GUEST_BOOT_FAULT_SLOT_NS	\
+			((u64)CONFIG_GUEST_BOOT_FAULT_SLOT_MS * 1000000ULL)
+
+static const char *const guest_boot_phase_names[VMM_GUEST_BOOT_MAX_PHASES] = {
+	[VMM_GUEST_BOOT_CREATE] = "create",
+	[VMM_GUEST_BOOT_VCPUS_CREATED] = "vcpus_created",
+	[VMM_GUEST_BOOT_ASPACE_INIT] = "aspace_init",
+	[VMM_GUEST_BOOT_CREATE_DONE] = "create_done",
+	[VMM_GUEST_BOOT_IMAGE_LOADED] = "image_loaded",
+	[VMM_GUEST_BOOT_KICK] = "kick",
+	[VMM_GUEST_BOOT_FIRST_VCPU_ENTRY] = "first_vcpu_entry",
+	[VMM_GUEST_BOOT_FIRST_MMIO] = "first_mmio",
+	[VMM_GUEST_BOOT_FIRST_VIRTIO_NOTIFY] = "first_virtio_notify",
+};
+
+/* Creation phases are kept whereas everything after is cleared */
+static void guest_boot_stats_reset(struct vmm_guest *guest)
+{
+	u32 i;
+
+	for (i = VMM_GUEST_BOOT_IMAGE_LOADED;
+	     i < VMM_GUEST_BOOT_MAX_PHASES; i++) {
+		guest->boot.tstamp[i] = 0;
+	}
+	arch_atomic_write(&guest->boot.fault_count, 0);
+	for (i = 0; i < VMM_GUEST_BOOT_FAULT_SLOTS; i++) {
+		arch_atomic_write(&guest->boot.fault_slot[i], 0);
+	}
+}
+
+void __vmm_manager_guest_boot_mark(struct vmm_guest *guest, u32 phase)
+{
+	if (phase < VMM_GUEST_BOOT_MAX_PHASES) {
+		guest->boot.tstamp[phase] = vmm_timer_timestamp();
+	}
+}
+
+void vmm_manager_guest_boot_fault(struct vmm_guest *guest)
+{
+	u64 slot, kick;
+
+	if (!guest) {
+		return;
+	}
+
+	kick = guest->boot.tstamp[VMM_GUEST_BOOT_KICK];
+	slot = (kick) ? udiv64(vmm_timer_timestamp() - kick,
+			       GUEST_BOOT_FAULT_SLOT_NS) : 0;
+	if (VMM_GUEST_BOOT_FAULT_SLOTS <= slot) {
+		slot = VMM_GUEST_BOOT_FAULT_SLOTS - 1;
+	}
+
+	arch_atomic_inc(&guest->boot.fault_count);
+	arch_atomic_inc(&guest->boot.fault_slot[slot]);
+}
+
+u64 vmm_manager_guest_boot_fault_slot_nsecs(void)
+{
+	return GUEST_BOOT_FAULT_SLOT_NS;
+}
+
+const char *vmm_manager_guest_boot_phase_name(u32 phase)
+{
+	return (phase < VMM_GUEST_BOOT_MAX_PHASES) ?
+					guest_boot_phase_names[phase] : NULL;
+}
+
+int vmm_manager_guest_boot_stats(struct vmm_guest *guest,
+				 struct vmm_guest_boot_stats *stats)
+{
+	if (!guest || !stats) {
+		return VMM_EINVALID;
+	}
+
+	memcpy(stats, &guest->boot, sizeof(*stats));
+
+	return VMM_OK;
+}
+#endif
+
 static int manager_guest_reset_iter(struct vmm_vcpu *vcpu, void *priv)
 {
 	return vmm_manager_vcpu_reset(vcpu);
@@ -864,6 +1225,9 @@ int vmm_manager_guest_reset(struct vmm_guest *guest)
 
 	guest->reset_count++;
 	guest->reset_tstamp = vmm_timer_timestamp();
+#ifdef CONFIG_GUEST_BOOT_STATS
+	guest_boot_stats_reset(guest);
+#endif
 
 	rc = vmm_manager_guest_vcpu_iterate(guest,
 				manager_guest_reset_iter, NULL);
@@ -883,6 +1247,42 @@ u64 vmm_manager_guest_reset_timestamp(struct vmm_guest *guest)
 	return (guest) ? guest->reset_tstamp : 0;
 }
 
+int vmm_manager_guest_get_sched(struct vmm_guest *guest,
+				u32 *weight, u32 *cap)
+{
+	if (!guest) {
+		return VMM_EFAIL;
+	}
+
+	if (weight) {
+		*weight = guest->sched_weight;
+	}
+	if (cap) {
+		*cap = guest->sched_cap;
+	}
+
+	return VMM_OK;
+}
+
+int vmm_manager_guest_set_sched(struct vmm_guest *guest,
+				u32 weight, u32 cap)
+{
+	if (!guest) {
+		return VMM_EFAIL;
+	}
+
+	if ((weight < VMM_GUEST_MIN_SCHED_WEIGHT) ||
+	    (VMM_GUEST_MAX_SCHED_WEIGHT < weight) ||
+	    (VMM_GUEST_MAX_SCHED_CAP < cap)) {
+		return VMM_EINVALID;
+	}
+
+	guest->sched_weight = weight;
+	guest->sched_cap = cap;
+
+	return VMM_OK;
+}
+
 static int manager_guest_kick_iter(struct vmm_vcpu *vcpu, void *priv)
 {
 	/* Do not kick VCPU with poweroff flag set
@@ -896,6 +1296,8 @@ static int manager_guest_kick_iter(struct vmm_vcpu *vcpu, void *priv)
 
 int vmm_manager_guest_kick(struct vmm_guest *guest)
 {
+	vmm_manager_guest_boot_mark(guest, VMM_GUEST_BOOT_KICK);
+
 	return vmm_manager_guest_vcpu_iterate(guest,
 					manager_guest_kick_iter, NULL);
 }
@@ -1110,7 +1512,7 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 	irq_flags_t flags;
 	struct vmm_devtree_node *vsnode;
 	struct vmm_devtree_node *vnode;
-	struct vmm_guest *guest = NULL;
+	struct vmm_guest *guest = NULL, *tguest;
 	struct vmm_vcpu *vcpu = NULL;
 
 	/* Sanity checks */
@@ -1171,6 +1573,14 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 #endif
 	guest->reset_count = 0;
 	guest->reset_tstamp = vmm_timer_timestamp();
+#ifdef CONFIG_GUEST_BOOT_STATS
+	memset(&guest->boot, 0, sizeof(guest->boot));
+	guest->boot.tstamp[VMM_GUEST_BOOT_CREATE] = guest->reset_tstamp;
+#endif
+	guest->sched_weight = VMM_GUEST_DEF_SCHED_WEIGHT;
+	guest->sched_cap = 0;
+	guest->tmpl = NULL;
+	guest->clone_count = 0;
 	INIT_SPIN_LOCK(&guest->req_lock);
 	INIT_LIST_HEAD(&guest->req_list);
 	INIT_RW_LOCK(&guest->vcpu_lock);
@@ -1194,6 +1604,40 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 		}
 	}
 
+	/* Determine guest scheduling parameters from guest node */
+	if (vmm_devtree_read_u32(gnode,
+			VMM_DEVTREE_SCHED_WEIGHT_ATTR_NAME, &val) == VMM_OK) {
+		if ((VMM_GUEST_MIN_SCHED_WEIGHT <= val) &&
+		    (val <= VMM_GUEST_MAX_SCHED_WEIGHT)) {
+			guest->sched_weight = val;
+		}
+	}
+	if (vmm_devtree_read_u32(gnode,
+			VMM_DEVTREE_SCHED_CAP_ATTR_NAME, &val) == VMM_OK) {
+		if (val <= VMM_GUEST_MAX_SCHED_CAP) {
+			guest->sched_cap = val;
+		}
+	}
+
+	/* Determine template guest from guest node */
+	if (vmm_devtree_read_string(gnode,
+			VMM_DEVTREE_TEMPLATE_ATTR_NAME, &str) == VMM_OK) {
+		list_for_each_entry(tguest, &mngr.guest_list, head) {
+			if ((tguest != guest) &&
+			    (strcmp(tguest->name, str) == 0)) {
+				guest->tmpl = tguest;
+				tguest->clone_count++;
+				break;
+			}
+		}
+		if (!guest->tmpl) {
+			vmm_manager_unlock();
+			vmm_printf("%s: Template Guest %s not found "
+				   "for Guest %s\n", __func__, str, gnode->name);
+			goto fail_destroy_guest;
+		}
+	}
+
 	/* Release manager lock */
 	vmm_manager_unlock();
 
@@ -1271,6 +1715,9 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 		vcpu->is_poweroff = FALSE;
 		vcpu->guest = guest;
 		arch_atomic_write(&vcpu->state, VMM_VCPU_STATE_UNKNOWN);
+		vcpu->reg_cache_gen = 0;
+		vcpu->reg_cache_next = 0;
+		memset(vcpu->reg_cache, 0, sizeof(vcpu->reg_cache));
 
 		/* Increment VCPU count */
 		mngr.vcpu_count++;
@@ -1308,9 +1755,19 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 		vcpu->reset_tstamp = 0;
 		vcpu->preempt_count = 0;
 		vcpu->resumed = FALSE;
+		vcpu->spinning = FALSE;
+		vcpu->preempt_tstamp = 0;
 		vcpu->hcpu = vmm_loadbal_good_hcpu(vcpu->priority);
 		vcpu->cpu_affinity = cpu_online_mask;
 		vcpu->sched_priv = NULL;
+#ifdef CONFIG_VCPU_EXIT_STATS
+		memset(vcpu->exit_stats, 0, sizeof(vcpu->exit_stats));
+	vcpu->exit_done_tstamp = 0;
+#endif
+#ifdef CONFIG_SCHED_LATENCY
+		vcpu->sched_woken = FALSE;
+		memset(vcpu->sched_latency, 0, sizeof(vcpu->sched_latency));
+#endif
 
 		/* Initialize static scheduling context */
 		if (vmm_devtree_read_u32(vnode,
@@ -1325,6 +1782,7 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 		if (vcpu->priority < VMM_VCPU_MIN_PRIORITY) {
 			vcpu->priority = VMM_VCPU_MIN_PRIORITY;
 		}
+		vcpu->base_priority = vcpu->priority;
 		if (vmm_devtree_read_u64(vnode,
 			VMM_DEVTREE_TIME_SLICE_ATTR_NAME, &vcpu->time_slice)) {
 			vcpu->time_slice = VMM_VCPU_DEF_TIME_SLICE;
@@ -1346,6 +1804,9 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 		if (vcpu->periodicity < vcpu->deadline) {
 			vcpu->periodicity = vcpu->deadline;
 		}
+		vcpu->is_deadline = (vmm_devtree_getattr(vnode,
+			VMM_DEVTREE_SCHED_DEADLINE_ATTR_NAME)) ? TRUE : FALSE;
+		vcpu->deadline_bw = 0;
 
 		/* Initialize architecture specific context */
 		vcpu->arch_priv = NULL;
@@ -1496,6 +1957,15 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 	}
 	vmm_read_unlock_irqrestore_lite(&guest->vcpu_lock, flags);
 
+	vmm_manager_guest_boot_mark(guest, VMM_GUEST_BOOT_VCPUS_CREATED);
+
+	/* Admit bandwidth of all deadline class VCPUs at once */
+	if (manager_guest_deadline_admit(guest)) {
+		vmm_printf("%s: Guest %s deadline VCPUs not admitted\n",
+			   __func__, guest->name);
+		goto fail_destroy_guest;
+	}
+
 	/* Initialize arch guest context */
 	if (arch_guest_init(guest)) {
 		goto fail_destroy_guest;
@@ -1505,11 +1975,13 @@ struct vmm_guest *vmm_manager_guest_create(struct vmm_devtree_node *gnode)
 	if (vmm_guest_aspace_init(guest)) {
 		goto fail_destroy_guest;
 	}
+	vmm_manager_guest_boot_mark(guest, VMM_GUEST_BOOT_ASPACE_INIT);
 
 	/* Reset guest address space */
 	if (vmm_guest_aspace_reset(guest)) {
 		goto fail_destroy_guest;
 	}
+	vmm_manager_guest_boot_mark(guest, VMM_GUEST_BOOT_CREATE_DONE);
 
 	return guest;
 
@@ -1520,6 +1992,144 @@ fail_destroy_guest:
 	return NULL;
 }
 
+struct vmm_guest *vmm_manager_guest_clone(struct vmm_guest *tmpl,
+					  const char *name)
+{
+	int rc;
+	irq_flags_t flags;
+	struct vmm_vcpu *vcpu;
+	struct vmm_guest *guest;
+	struct vmm_devtree_node *pnode, *gnode;
+
+	/* Sanity checks */
+	if (!tmpl || !tmpl->node || !name) {
+		return NULL;
+	}
+
+	/* Template RAM is copied so it must not be changing */
+	vmm_read_lock_irqsave_lite(&tmpl->vcpu_lock, flags);
+	list_for_each_entry(vcpu, &tmpl->vcpu_list, head) {
+		if (vmm_manager_vcpu_get_state(vcpu) &
+		    (VMM_VCPU_STATE_READY | VMM_VCPU_STATE_RUNNING)) {
+			vmm_read_unlock_irqrestore_lite(&tmpl->vcpu_lock, flags);
+			vmm_printf("%s: Template Guest %s is running\n",
+				   __func__, tmpl->name);
+			return NULL;
+		}
+	}
+	vmm_read_unlock_irqrestore_lite(&tmpl->vcpu_lock, flags);
+
+	/* Create clone node next to template node */
+	pnode = tmpl->node->parent;
+	if ((rc = vmm_devtree_copynode(pnode, name, tmpl->node))) {
+		vmm_printf("%s: Failed to copy node of Guest %s (error %d)\n",
+			   __func__, tmpl->name, rc);
+		return NULL;
+	}
+	gnode = vmm_devtree_getchild(pnode, name);
+	if (!gnode) {
+		return NULL;
+	}
+
+	rc = vmm_devtree_setattr(gnode, VMM_DEVTREE_TEMPLATE_ATTR_NAME,
+				 tmpl->name, VMM_DEVTREE_ATTRTYPE_STRING,
+				 strlen(tmpl->name) + 1, FALSE);
+	if (rc) {
+		guest = NULL;
+		goto done;
+	}
+
+	guest = vmm_manager_guest_create(gnode);
+
+done:
+	vmm_devtree_dref_node(gnode);
+	if (!guest) {
+		vmm_devtree_delnode(gnode);
+	}
+
+	return guest;
+}
+
+struct manager_create_work {
+	struct vmm_work work;
+	struct vmm_devtree_node *gnode;
+	struct vmm_guest *guest;
+	struct vmm_completion done;
+};
+
+static void manager_create_work_func(struct vmm_work *work)
+{
+	struct manager_create_work *cw =
+			container_of(work, struct manager_create_work, work);
+
+	cw->guest = vmm_manager_guest_create(cw->gnode);
+	vmm_completion_complete(&cw->done);
+}
+
+u32 vmm_manager_guest_create_batch(struct vmm_devtree_node **gnodes,
+				   struct vmm_guest **guests, u32 count)
+{
+	u32 i, phase, ret = 0;
+	bool is_clone;
+	struct manager_create_work *cws, *cw;
+
+	/* Sanity checks */
+	if (!gnodes || !count) {
+		return 0;
+	}
+
+	cws = vmm_zalloc(count * sizeof(*cws));
+	if (!cws) {
+		return 0;
+	}
+
+	/*
+	 * Guests are created concurrently on system workqueues. Guests
+	 * having a template are created after all other guests so that
+	 * templates from the same batch are found.
+	 */
+	for (phase = 0; phase < 2; phase++) {
+		for (i = 0; i < count; i++) {
+			cw = &cws[i];
+			is_clone = (gnodes[i] && vmm_devtree_getattr(gnodes[i],
+				    VMM_DEVTREE_TEMPLATE_ATTR_NAME)) ?
+				    TRUE : FALSE;
+			if (!gnodes[i] || (is_clone != (phase == 1))) {
+				continue;
+			}
+			INIT_WORK(&cw->work, manager_create_work_func);
+			INIT_COMPLETION(&cw->done);
+			cw->gnode = gnodes[i];
+			cw->guest = NULL;
+			if (vmm_workqueue_schedule_work(NULL, &cw->work)) {
+				/* Fallback to creating on calling thread */
+				cw->gnode = NULL;
+				cw->guest = vmm_manager_guest_create(gnodes[i]);
+			}
+		}
+		for (i = 0; i < count; i++) {
+			cw = &cws[i];
+			if (cw->gnode) {
+				vmm_completion_wait(&cw->done);
+				cw->gnode = NULL;
+			}
+		}
+	}
+
+	for (i = 0; i < count; i++) {
+		if (cws[i].guest) {
+			ret++;
+		}
+		if (guests) {
+			guests[i] = cws[i].guest;
+		}
+	}
+
+	vmm_free(cws);
+
+	return ret;
+}
+
 int vmm_manager_guest_destroy(struct vmm_guest *guest)
 {
 	int rc;
@@ -1531,6 +2141,14 @@ int vmm_manager_guest_destroy(struct vmm_guest *guest)
 		return VMM_EFAIL;
 	}
 
+	/* Clones share host RAM of their template */
+	vmm_manager_lock();
+	if (guest->clone_count) {
+		vmm_manager_unlock();
+		return VMM_EBUSY;
+	}
+	vmm_manager_unlock();
+
 	/* For sanity reset guest (ignore reture value) */
 	vmm_manager_guest_reset(guest);
 
@@ -1589,6 +2207,9 @@ int vmm_manager_guest_destroy(struct vmm_guest *guest)
 			vmm_free((void *)vcpu->stack_va);
 		}
 
+		/* Release bandwidth of deadline class VCPU */
+		manager_deadline_release(vcpu);
+
 		/* De-reference VCPU node */
 		vmm_devtree_dref_node(vcpu->node);
 		vcpu->node = NULL;
@@ -1615,6 +2236,12 @@ int vmm_manager_guest_destroy(struct vmm_guest *guest)
 	/* Acquire manager lock */
 	vmm_manager_lock();
 
+	/* Release template guest */
+	if (guest->tmpl) {
+		guest->tmpl->clone_count--;
+		guest->tmpl = NULL;
+	}
+
 	/* Reset guest instance members */
 	vmm_devtree_dref_node(guest->node);
 	guest->node = NULL;
@@ -1650,6 +2277,8 @@ int __init vmm_manager_init(void)
 	mngr.guest_count = 0;
 	INIT_LIST_HEAD(&mngr.orphan_vcpu_list);
 	INIT_LIST_HEAD(&mngr.guest_list);
+	INIT_SPIN_LOCK(&mngr.deadline_lock);
+	mngr.deadline_bw = 0;
 
 	/* Initialze memory for guest instances */
 	for (gnum = 0; gnum < CONFIG_MAX_GUEST_COUNT; gnum++) {
@@ -51,6 +51,8 @@
 # define debug_align(X) (X)
 #endif
 
+#define MODULES_SYMHASH_SIZE		1024
+
 struct load_info {
 	Elf_Ehdr *hdr;
 	unsigned long len;
@@ -63,6 +65,13 @@ struct load_info {
 	} index;
 };
 
+/* Entry of exported symbol index (one per symbol of loaded module) */
+struct module_symhash_entry {
+	struct dlist head;
+	u32 hash;
+	struct vmm_symbol *sym;
+};
+
 /* FIXME: Implement reference counting for loadable modules */
 
 struct module_wrap {
@@ -83,28 +92,114 @@ struct module_wrap {
 	/* Exported symbols */
 	struct vmm_symbol *syms;
 	u32 num_syms;
+	struct module_symhash_entry *sym_ents;
 };
 
+/*
+ * Symbols are resolved using two hash tables. The kallsyms index is
+ * built once at boot-time and never changes afterwards hence it is
+ * looked up without locks. The exported symbol index of loaded modules
+ * is updated under modctrl.lock upon module load/unload. Hash chains
+ * of both tables preserve the search order of a linear lookup.
+ */
 struct vmm_modules_ctrl {
 	vmm_spinlock_t lock;
 	struct dlist mod_list;
 	u32 mod_count;
+	u32 ksym_count;
+	u32 *ksym_hash;
+	u32 *ksym_off;
+	u32 *ksym_next;
+	u32 ksym_bucket[MODULES_SYMHASH_SIZE];
+	struct dlist sym_hash[MODULES_SYMHASH_SIZE];
 };
 
 static struct vmm_modules_ctrl modctrl;
 
+static u32 modules_hash_symbol(const char *symname)
+{
+	u32 hash = 5381;
+
+	while (*symname) {
+		hash = (hash << 5) + hash + (u8)(*symname);
+		symname++;
+	}
+
+	return hash;
+}
+
+static unsigned long modules_ksym_lookup(const char *symname, u32 hash)
+{
+	u32 i;
+	char namebuf[KSYM_NAME_LEN];
+
+	if (!modctrl.ksym_hash) {
+		return kallsyms_lookup_name(symname);
+	}
+
+	/* Chain entries are kallsyms position plus one */
+	i = modctrl.ksym_bucket[hash % MODULES_SYMHASH_SIZE];
+	while (i) {
+		if (modctrl.ksym_hash[i - 1] == hash) {
+			kallsyms_expand_symbol(modctrl.ksym_off[i - 1], namebuf);
+			if (strcmp(namebuf, symname) == 0) {
+				return kallsyms_addresses[i - 1];
+			}
+		}
+		i = modctrl.ksym_next[i - 1];
+	}
+
+	return 0;
+}
+
+static void __init modules_ksym_index_init(void)
+{
+	u32 i, b, count, off;
+	char namebuf[KSYM_NAME_LEN];
+
+	if (!&kallsyms_num_syms || !kallsyms_num_syms) {
+		return;
+	}
+	count = kallsyms_num_syms;
+
+	modctrl.ksym_hash = vmm_malloc(3 * count * sizeof(u32));
+	if (!modctrl.ksym_hash) {
+		vmm_printf("%s: failed to alloc kallsyms index\n", __func__);
+		return;
+	}
+	modctrl.ksym_off = &modctrl.ksym_hash[count];
+	modctrl.ksym_next = &modctrl.ksym_hash[2 * count];
+	modctrl.ksym_count = count;
+
+	/* Expand each symbol name exactly once */
+	for (i = 0, off = 0; i < count; i++) {
+		modctrl.ksym_off[i] = off;
+		off = kallsyms_expand_symbol(off, namebuf);
+		modctrl.ksym_hash[i] = modules_hash_symbol(namebuf);
+	}
+
+	/* Link in reverse so that chains are in kallsyms order */
+	for (i = count; i > 0; i--) {
+		b = modctrl.ksym_hash[i - 1] % MODULES_SYMHASH_SIZE;
+		modctrl.ksym_next[i - 1] = modctrl.ksym_bucket[b];
+		modctrl.ksym_bucket[b] = i;
+	}
+}
+
 int vmm_modules_find_symbol(const char *symname, struct vmm_symbol *sym)
 {
-	u32 s;
+	u32 hash;
 	bool found;
 	irq_flags_t flags;
-	struct module_wrap *mwrap = NULL;
+	struct module_symhash_entry *ent;
 
 	if (!symname || !sym) {
 		return VMM_EFAIL;
 	}
 
-	sym->addr = kallsyms_lookup_name(symname);
+	hash = modules_hash_symbol(symname);
+
+	sym->addr = modules_ksym_lookup(symname, hash);
 	if (sym->addr) {
 		if (strlcpy(sym->name, symname, sizeof(sym->name)) >=
 		    sizeof(sym->name)) {
@@ -117,15 +212,12 @@ int vmm_modules_find_symbol(const char *symname, struct vmm_symbol *sym)
 	vmm_spin_lock_irqsave(&modctrl.lock, flags);
 
 	found = FALSE;
-	list_for_each_entry(mwrap, &modctrl.mod_list, head) {
-		for (s = 0; s < mwrap->num_syms; s++) {
-			if (strcmp(mwrap->syms[s].name, symname) == 0) {
-				memcpy(sym, &mwrap->syms[s], sizeof(*sym));
-				found = TRUE;
-				break;
-			}
-		}
-		if (found) {
+	list_for_each_entry(ent,
+		&modctrl.sym_hash[hash % MODULES_SYMHASH_SIZE], head) {
+		if ((ent->hash == hash) &&
+		    (strcmp(ent->sym->name, symname) == 0)) {
+			memcpy(sym, ent->sym, sizeof(*sym));
+			found = TRUE;
 			break;
 		}
 	}
@@ -306,9 +398,9 @@ static int alloc_and_load_symtbl(struct module_wrap *mwrap,
 	if (!mwrap->syms) {
 		return VMM_ENOMEM;
 	}
-	memcpy(&mwrap->syms, 
-		(void *)info->sechdrs[i].sh_addr, 
-		sizeof(mwrap->mod));
+	memcpy(mwrap->syms,
+		(void *)info->sechdrs[i].sh_addr,
+		info->sechdrs[i].sh_size);
 	mwrap->num_syms = info->sechdrs[i].sh_size / sizeof(struct vmm_symbol);
 
 	info->sechdrs[i].sh_flags &= ~SHF_ALLOC;
@@ -594,6 +686,54 @@ static int apply_relocations(struct module_wrap *mwrap,
 	return err;
 }
 
+static int alloc_symhash(struct module_wrap *mwrap)
+{
+	u32 s;
+	struct module_symhash_entry *ent;
+
+	if (!mwrap->num_syms) {
+		mwrap->sym_ents = NULL;
+		return VMM_OK;
+	}
+
+	mwrap->sym_ents = vmm_zalloc(mwrap->num_syms * sizeof(*ent));
+	if (!mwrap->sym_ents) {
+		return VMM_ENOMEM;
+	}
+
+	for (s = 0; s < mwrap->num_syms; s++) {
+		ent = &mwrap->sym_ents[s];
+		INIT_LIST_HEAD(&ent->head);
+		ent->sym = &mwrap->syms[s];
+		ent->hash = modules_hash_symbol(ent->sym->name);
+	}
+
+	return VMM_OK;
+}
+
+/* Note: Must be called with modctrl.lock held */
+static void add_symhash(struct module_wrap *mwrap)
+{
+	u32 s;
+	struct module_symhash_entry *ent;
+
+	for (s = 0; s < mwrap->num_syms; s++) {
+		ent = &mwrap->sym_ents[s];
+		list_add_tail(&ent->head,
+			&modctrl.sym_hash[ent->hash % MODULES_SYMHASH_SIZE]);
+	}
+}
+
+/* Note: Must be called with modctrl.lock held */
+static void del_symhash(struct module_wrap *mwrap)
+{
+	u32 s;
+
+	for (s = 0; s < mwrap->num_syms; s++) {
+		list_del(&mwrap->sym_ents[s].head);
+	}
+}
+
 int vmm_modules_load(virtual_addr_t load_addr, virtual_size_t load_size)
 {
 	int i, rc;
@@ -659,20 +799,30 @@ int vmm_modules_load(virtual_addr_t load_addr, virtual_size_t load_size)
 	/* Get rid of temporary strmap. */
 	vmm_free(info.strmap);
 
+	/* Prepare exported symbol index entries */
+	if ((rc = alloc_symhash(mwrap))) {
+		goto free_pages;
+	}
+
 	if (mwrap->mod.init) {
 		if ((rc = mwrap->mod.init())) {
-			goto free_pages;
+			goto free_symhash;
 		}
 		mwrap->mod_ret = rc;
 	}
 
 	vmm_spin_lock_irqsave(&modctrl.lock, flags);
 	list_add_tail(&mwrap->head, &modctrl.mod_list);
+	add_symhash(mwrap);
 	modctrl.mod_count++;
 	vmm_spin_unlock_irqrestore(&modctrl.lock, flags);
 
 	return VMM_OK;
 
+free_symhash:
+	if (mwrap->sym_ents) {
+		vmm_free(mwrap->sym_ents);
+	}
 free_pages:
 	vmm_host_free_pages(mwrap->pg_start, mwrap->pg_count);
 free_syms:
@@ -707,7 +857,14 @@ int vmm_modules_unload(struct vmm_module *mod)
 		mwrap->mod.exit();
 	}
 	list_del(&mwrap->head);
+	del_symhash(mwrap);
 	vmm_host_free_pages(mwrap->pg_start, mwrap->pg_count);
+	if (mwrap->sym_ents) {
+		vmm_free(mwrap->sym_ents);
+	}
+	if (mwrap->syms) {
+		vmm_free(mwrap->syms);
+	}
 	vmm_free(mwrap);
 	modctrl.mod_count--;
 
@@ -817,6 +974,7 @@ static int __init cmp_list_element(void *p, struct dlist *a, struct dlist *b)
 int __init vmm_modules_init(void)
 {
 	int ret;
+	u32 i;
 	struct module_wrap *mwrap;
 	struct vmm_module *mod_entry;
 	struct modules_list *ag_mod_list;
@@ -826,6 +984,12 @@ int __init vmm_modules_init(void)
 	INIT_SPIN_LOCK(&modctrl.lock);
 	INIT_LIST_HEAD(&modctrl.mod_list);
 	modctrl.mod_count = 0;
+	for (i = 0; i < MODULES_SYMHASH_SIZE; i++) {
+		INIT_LIST_HEAD(&modctrl.sym_hash[i]);
+	}
+
+	/* Build kallsyms index */
+	modules_ksym_index_init();
 
 	ag_mod_list = aggregate_modules(arch_modtbl_vaddr(), 
 					arch_modtbl_size());
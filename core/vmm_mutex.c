@@ -23,9 +23,91 @@
 
 #include <vmm_error.h>
 #include <vmm_stdio.h>
+#include <vmm_smp.h>
 #include <vmm_scheduler.h>
 #include <vmm_mutex.h>
 #include <arch_cpu_irq.h>
+#include <arch_barrier.h>
+
+#ifdef CONFIG_LOCKSTAT
+#define mutex_lockstat_class(mut)	\
+	vmm_lockstat_class_get(&(mut)->__class, (mut), VMM_LOCKSTAT_MUTEX)
+#define mutex_lockstat_acquired(mut, contended, wait_tstamp) \
+	(mut)->__hold_tstamp = vmm_lockstat_acquired(mutex_lockstat_class(mut), \
+						(contended), (wait_tstamp))
+#define mutex_lockstat_released(mut)	\
+	vmm_lockstat_released((mut)->__class, (mut)->__hold_tstamp)
+#define mutex_lockstat_tstamp()		vmm_lockstat_tstamp()
+#else
+#define mutex_lockstat_acquired(mut, contended, wait_tstamp) \
+	do { (void)(contended); (void)(wait_tstamp); } while (0)
+#define mutex_lockstat_released(mut)	do { } while (0)
+#define mutex_lockstat_tstamp()		0
+#endif
+
+#ifdef CONFIG_MUTEX_PRIO_INHERIT
+/*
+ * Boost priority of mutex owner upto priority of waiting VCPU.
+ * The owner drops back to its base priority when it releases a mutex
+ * so a VCPU holding multiple contended mutexes might lose its boost
+ * before releasing the last of them.
+ */
+static void mutex_prio_boost(struct vmm_mutex *mut, struct vmm_vcpu *waiter)
+{
+	struct vmm_vcpu *owner = mut->owner;
+
+	if (owner && (owner->priority < waiter->priority)) {
+		vmm_scheduler_set_priority(owner, waiter->priority);
+	}
+}
+
+static void mutex_prio_restore(struct vmm_vcpu *owner)
+{
+	if (owner->priority != owner->base_priority) {
+		vmm_scheduler_set_priority(owner, owner->base_priority);
+	}
+}
+#else
+#define mutex_prio_boost(mut, waiter)	do { } while (0)
+#define mutex_prio_restore(owner)	do { } while (0)
+#endif
+
+#if defined(CONFIG_SMP) && (CONFIG_MUTEX_SPIN_LOOPS > 0)
+/*
+ * Spin (with mutex waitqueue lock released) while mutex owner is
+ * running on some other host CPU because it is likely to release
+ * mutex soon. Returns TRUE if mutex owner changed while spinning.
+ * Note: VCPUs are never freed hence reading owner state is safe
+ * even if owner is destroyed meanwhile.
+ */
+static bool mutex_spin_on_owner(struct vmm_mutex *mut, irq_flags_t *flags)
+{
+	u32 loops;
+	struct vmm_vcpu *owner = mut->owner;
+
+	if (!owner || (owner->hcpu == vmm_smp_processor_id()) ||
+	    (arch_atomic_read(&owner->state) != VMM_VCPU_STATE_RUNNING)) {
+		return FALSE;
+	}
+
+	vmm_spin_unlock_irqrestore(&mut->wq.lock, *flags);
+
+	for (loops = 0; loops < CONFIG_MUTEX_SPIN_LOOPS; loops++) {
+		if ((mut->owner != owner) ||
+		    (arch_atomic_read(&owner->state) !=
+					VMM_VCPU_STATE_RUNNING)) {
+			break;
+		}
+		arch_cpu_relax();
+	}
+
+	vmm_spin_lock_irqsave(&mut->wq.lock, *flags);
+
+	return (mut->owner != owner) ? TRUE : FALSE;
+}
+#else
+#define mutex_spin_on_owner(mut, flags)	FALSE
+#endif
 
 void __vmm_mutex_cleanup(struct vmm_vcpu *vcpu,
 			 struct vmm_vcpu_resource *vcpu_res)
@@ -90,9 +172,11 @@ int vmm_mutex_unlock(struct vmm_mutex *mut)
 	if (mut->lock && mut->owner == current_vcpu) {
 		mut->lock--;
 		if (!mut->lock) {
+			mutex_lockstat_released(mut);
 			mut->owner = NULL;
 			vmm_manager_vcpu_resource_remove(current_vcpu,
 							 &mut->res);
+			mutex_prio_restore(current_vcpu);
 			rc = __vmm_waitqueue_wakeall(&mut->wq);
 			if (rc == VMM_ENOENT) {
 				rc = VMM_OK;
@@ -121,6 +205,7 @@ int vmm_mutex_trylock(struct vmm_mutex *mut)
 		mut->lock++;
 		vmm_manager_vcpu_resource_add(current_vcpu, &mut->res);
 		mut->owner = current_vcpu;
+		mutex_lockstat_acquired(mut, FALSE, 0);
 		ret = 1;
 	} else if (mut->owner == current_vcpu) {
 		/*
@@ -140,6 +225,8 @@ static int mutex_lock_common(struct vmm_mutex *mut, u64 *timeout)
 {
 	int rc = VMM_OK;
 	irq_flags_t flags;
+	bool contended = FALSE;
+	u64 wait_tstamp = 0;
 	struct vmm_vcpu *current_vcpu = vmm_scheduler_current_vcpu();
 
 	BUG_ON(!mut);
@@ -147,6 +234,11 @@ static int mutex_lock_common(struct vmm_mutex *mut, u64 *timeout)
 
 	vmm_spin_lock_irqsave(&mut->wq.lock, flags);
 
+	if (mut->lock && (mut->owner != current_vcpu)) {
+		contended = TRUE;
+		wait_tstamp = mutex_lockstat_tstamp();
+	}
+
 	while (mut->lock) {
 		/*
 		 * If VCPU owning the lock try to acquire it again then let
@@ -155,6 +247,10 @@ static int mutex_lock_common(struct vmm_mutex *mut, u64 *timeout)
 		if (mut->owner == current_vcpu) {
 			break;
 		}
+		if (mutex_spin_on_owner(mut, &flags)) {
+			continue;
+		}
+		mutex_prio_boost(mut, current_vcpu);
 		rc = __vmm_waitqueue_sleep(&mut->wq, timeout);
 		if (rc) {
 			/* Timeout or some other failure */
@@ -167,6 +263,7 @@ static int mutex_lock_common(struct vmm_mutex *mut, u64 *timeout)
 			vmm_manager_vcpu_resource_add(current_vcpu,
 						      &mut->res);
 			mut->owner = current_vcpu;
+			mutex_lockstat_acquired(mut, contended, wait_tstamp);
 		} else {
 			mut->lock++;
 		}
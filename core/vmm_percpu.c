@@ -25,8 +25,109 @@
 #include <vmm_cpumask.h>
 #include <vmm_host_aspace.h>
 #include <vmm_percpu.h>
+#include <vmm_spinlocks.h>
 #include <arch_sections.h>
+#include <arch_cpu_irq.h>
 #include <libs/stringlib.h>
+#include <libs/bitmap.h>
+
+#define PCC_COUNT		CONFIG_PERCPU_COUNTER_COUNT
+
+/*
+ * Slots of per-cpu counters live in per-cpu area so that slots of
+ * different host CPUs never share a cache line.
+ */
+static DEFINE_PER_CPU(u64 [PCC_COUNT], pcc_slots);
+static DEFINE_SPINLOCK(pcc_lock);
+static DECLARE_BITMAP(pcc_bmap, PCC_COUNT);
+
+int vmm_percpu_counter_init(struct vmm_percpu_counter *pcc)
+{
+	u32 cpu, slot;
+	irq_flags_t flags;
+
+	if (!pcc) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave(&pcc_lock, flags);
+	for (slot = 0; slot < PCC_COUNT; slot++) {
+		if (!bitmap_isset(pcc_bmap, slot)) {
+			bitmap_setbit(pcc_bmap, slot);
+			break;
+		}
+	}
+	vmm_spin_unlock_irqrestore(&pcc_lock, flags);
+
+	if (slot == PCC_COUNT) {
+		pcc->slot = PCC_COUNT;
+		return VMM_ENOSPC;
+	}
+
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		per_cpu(pcc_slots, cpu)[slot] = 0;
+	}
+	pcc->slot = slot;
+
+	return VMM_OK;
+}
+
+void vmm_percpu_counter_destroy(struct vmm_percpu_counter *pcc)
+{
+	irq_flags_t flags;
+
+	if (!pcc || (PCC_COUNT <= pcc->slot)) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&pcc_lock, flags);
+	bitmap_clearbit(pcc_bmap, pcc->slot);
+	vmm_spin_unlock_irqrestore(&pcc_lock, flags);
+
+	pcc->slot = PCC_COUNT;
+}
+
+void vmm_percpu_counter_add(struct vmm_percpu_counter *pcc, u64 val)
+{
+	irq_flags_t flags;
+
+	if (PCC_COUNT <= pcc->slot) {
+		return;
+	}
+
+	arch_cpu_irq_save(flags);
+	this_cpu(pcc_slots)[pcc->slot] += val;
+	arch_cpu_irq_restore(flags);
+}
+
+u64 vmm_percpu_counter_read(struct vmm_percpu_counter *pcc)
+{
+	u32 cpu;
+	u64 ret = 0;
+
+	if (!pcc || (PCC_COUNT <= pcc->slot)) {
+		return 0;
+	}
+
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		ret += *(volatile u64 *)&per_cpu(pcc_slots, cpu)[pcc->slot];
+	}
+
+	return ret;
+}
+
+void vmm_percpu_counter_reset(struct vmm_percpu_counter *pcc)
+{
+	u32 cpu;
+
+	if (!pcc || (PCC_COUNT <= pcc->slot)) {
+		return;
+	}
+
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		per_cpu(pcc_slots, cpu)[pcc->slot] = 0;
+	}
+}
 
 #ifdef CONFIG_SMP
 
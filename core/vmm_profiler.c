@@ -27,22 +27,46 @@
 #include <vmm_timer.h>
 #include <vmm_stdio.h>
 #include <vmm_smp.h>
+#include <vmm_percpu.h>
+#include <vmm_cpumask.h>
+#include <vmm_spinlocks.h>
+#include <vmm_manager.h>
+#include <vmm_scheduler.h>
 #include <arch_cpu.h>
+#include <arch_vcpu.h>
 #include <arch_atomic.h>
 #include <arch_atomic64.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 #include <libs/kallsyms.h>
 
 typedef void (*vmm_profile_callback_t) (void *, void *);
 
+#define SAMPLE_COUNT		CONFIG_PROFILE_SAMPLE_COUNT
+#define SAMPLE_IPI_TIMEOUT_MSECS	1000
+
 struct vmm_profiler_ctrl {
 	bool is_active;
 	bool is_in_trace[CONFIG_CPU_COUNT];
 	struct vmm_profiler_stat *stat;
+	bool sample_active;
+	u64 sample_period_ns;
 };
 
 static struct vmm_profiler_ctrl pctrl;
 
+/* Per-CPU ring buffer of statistical samples */
+struct vmm_profiler_sampler {
+	vmm_spinlock_t lock;
+	struct vmm_timer_event ev;
+	struct vmm_profiler_sample *buf;
+	u32 head;
+	u32 count;
+	u32 lost;
+};
+
+static DEFINE_PER_CPU(struct vmm_profiler_sampler, psamp);
+
 static __notrace void vmm_profile_none(void *ip, void *parent_ip)
 {
 	// Default NULL function
@@ -210,8 +234,161 @@ struct vmm_profiler_stat *vmm_profiler_get_stat_array(void)
 	return pctrl.stat;
 }
 
+static void __notrace profiler_sample_event(struct vmm_timer_event *ev)
+{
+	irq_flags_t flags;
+	struct vmm_profiler_sample *smp;
+	struct vmm_profiler_sampler *sp = ev->priv;
+	struct vmm_vcpu *vcpu = vmm_scheduler_current_vcpu();
+	arch_regs_t *regs = vmm_scheduler_irq_regs();
+
+	vmm_spin_lock_irqsave_lite(&sp->lock, flags);
+
+	smp = &sp->buf[sp->head];
+	smp->tstamp = vmm_timer_timestamp();
+	smp->host_pc = 0;
+	smp->guest_pc = 0;
+	smp->vcpu_id = (vcpu) ? vcpu->id : VMM_PROFILE_NO_VCPU;
+	if (!vcpu || !regs) {
+		smp->context = VMM_PROFILE_CTX_IRQ;
+	} else if (arch_vcpu_sample_pc(vcpu, regs,
+				       &smp->host_pc, &smp->guest_pc)) {
+		smp->context = VMM_PROFILE_CTX_GUEST;
+	} else {
+		smp->context = (vcpu->is_normal) ?
+			VMM_PROFILE_CTX_NORMAL : VMM_PROFILE_CTX_ORPHAN;
+	}
+
+	sp->head = (sp->head + 1) % SAMPLE_COUNT;
+	if (sp->count < SAMPLE_COUNT) {
+		sp->count++;
+	} else {
+		sp->lost++;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&sp->lock, flags);
+
+	if (pctrl.sample_active) {
+		vmm_timer_event_start(ev, pctrl.sample_period_ns);
+	}
+}
+
+static void profiler_sample_start_ipi(void *a0, void *a1, void *a2)
+{
+	irq_flags_t flags;
+	struct vmm_profiler_sampler *sp = &this_cpu(psamp);
+
+	vmm_spin_lock_irqsave_lite(&sp->lock, flags);
+	sp->head = sp->count = sp->lost = 0;
+	vmm_spin_unlock_irqrestore_lite(&sp->lock, flags);
+
+	vmm_timer_event_start(&sp->ev, pctrl.sample_period_ns);
+}
+
+static void profiler_sample_stop_ipi(void *a0, void *a1, void *a2)
+{
+	vmm_timer_event_stop(&this_cpu(psamp).ev);
+}
+
+bool vmm_profiler_sample_isactive(void)
+{
+	return pctrl.sample_active;
+}
+
+int vmm_profiler_sample_start(u32 freq_hz)
+{
+	u32 cpu;
+	struct vmm_profiler_sampler *sp;
+
+	if (pctrl.sample_active) {
+		return VMM_EBUSY;
+	}
+
+	if (!freq_hz) {
+		freq_hz = CONFIG_PROFILE_SAMPLE_HZ;
+	}
+	if (freq_hz > 1000000) {
+		return VMM_EINVALID;
+	}
+
+	for_each_online_cpu(cpu) {
+		sp = &per_cpu(psamp, cpu);
+		if (sp->buf) {
+			continue;
+		}
+		sp->buf = vmm_malloc(SAMPLE_COUNT * sizeof(*sp->buf));
+		if (!sp->buf) {
+			return VMM_ENOMEM;
+		}
+	}
+
+	pctrl.sample_period_ns = udiv64(1000000000ULL, freq_hz);
+	pctrl.sample_active = TRUE;
+
+	return vmm_smp_ipi_sync_call(cpu_online_mask,
+				     SAMPLE_IPI_TIMEOUT_MSECS,
+				     profiler_sample_start_ipi,
+				     NULL, NULL, NULL);
+}
+
+int vmm_profiler_sample_stop(void)
+{
+	if (!pctrl.sample_active) {
+		return VMM_EFAIL;
+	}
+
+	pctrl.sample_active = FALSE;
+
+	return vmm_smp_ipi_sync_call(cpu_online_mask,
+				     SAMPLE_IPI_TIMEOUT_MSECS,
+				     profiler_sample_stop_ipi,
+				     NULL, NULL, NULL);
+}
+
+u32 vmm_profiler_sample_read(u32 cpu, struct vmm_profiler_sample *buf,
+			     u32 max, u32 *lost)
+{
+	u32 i, first, count;
+	irq_flags_t flags;
+	struct vmm_profiler_sampler *sp;
+
+	if ((CONFIG_CPU_COUNT <= cpu) || !buf) {
+		return 0;
+	}
+	sp = &per_cpu(psamp, cpu);
+
+	vmm_spin_lock_irqsave_lite(&sp->lock, flags);
+
+	count = (sp->buf) ? sp->count : 0;
+	if (max < count) {
+		count = max;
+	}
+	first = (sp->head + SAMPLE_COUNT - sp->count) % SAMPLE_COUNT;
+	for (i = 0; i < count; i++) {
+		buf[i] = sp->buf[(first + i) % SAMPLE_COUNT];
+	}
+	if (lost) {
+		*lost = sp->lost;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&sp->lock, flags);
+
+	return count;
+}
+
 int __init vmm_profiler_init(void)
 {
+	u32 cpu;
+	struct vmm_profiler_sampler *sp;
+
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		sp = &per_cpu(psamp, cpu);
+		INIT_SPIN_LOCK(&sp->lock);
+		INIT_TIMER_EVENT(&sp->ev, profiler_sample_event, sp);
+		sp->buf = NULL;
+		sp->head = sp->count = sp->lost = 0;
+	}
+
 	pctrl.stat =
 	    vmm_zalloc(sizeof(struct vmm_profiler_stat) * kallsyms_num_syms);
 
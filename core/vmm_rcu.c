@@ -0,0 +1,129 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_rcu.c
+ * @author agent (agent@local)
+ * @brief Read-copy-update (RCU) implementation
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_smp.h>
+#include <vmm_percpu.h>
+#include <vmm_delay.h>
+#include <vmm_spinlocks.h>
+#include <vmm_workqueue.h>
+#include <vmm_rcu.h>
+
+/* Poll interval of grace period detection */
+#define RCU_POLL_MSECS		1
+
+static DEFINE_PER_CPU(u32, rcu_qs_count);
+
+static DEFINE_SPINLOCK(rcu_cb_lock);
+static LIST_HEAD(rcu_cb_list);
+
+static void rcu_callbacks_work(struct vmm_work *work);
+static DECLARE_WORK(rcu_cb_work, rcu_callbacks_work);
+
+void vmm_rcu_quiescent_state(void)
+{
+	this_cpu(rcu_qs_count)++;
+}
+
+void vmm_rcu_synchronize(void)
+{
+	u32 cpu;
+	bool pending;
+	u32 snap[CONFIG_CPU_COUNT];
+
+	BUG_ON(!vmm_scheduler_orphan_context());
+
+	/* Order prior updates before sampling quiescent states */
+	arch_smp_mb();
+
+	for_each_online_cpu(cpu) {
+		snap[cpu] = *(volatile u32 *)&per_cpu(rcu_qs_count, cpu);
+	}
+
+	do {
+		vmm_msleep(RCU_POLL_MSECS);
+
+		/* Force scheduler to run on host CPUs not seen quiescent */
+		pending = FALSE;
+		for_each_online_cpu(cpu) {
+			if (snap[cpu] !=
+			    *(volatile u32 *)&per_cpu(rcu_qs_count, cpu)) {
+				continue;
+			}
+			pending = TRUE;
+			vmm_scheduler_force_resched(cpu);
+		}
+	} while (pending);
+
+	arch_smp_mb();
+}
+
+static void rcu_callbacks_work(struct vmm_work *work)
+{
+	bool more;
+	irq_flags_t flags;
+	struct vmm_rcu_head *rhead;
+	LIST_HEAD(cb_list);
+
+	vmm_spin_lock_irqsave(&rcu_cb_lock, flags);
+	while (!list_empty(&rcu_cb_list)) {
+		list_add_tail(list_pop(&rcu_cb_list), &cb_list);
+	}
+	vmm_spin_unlock_irqrestore(&rcu_cb_lock, flags);
+
+	vmm_rcu_synchronize();
+
+	while (!list_empty(&cb_list)) {
+		rhead = list_entry(list_pop(&cb_list),
+				   struct vmm_rcu_head, head);
+		rhead->func(rhead);
+	}
+
+	vmm_spin_lock_irqsave(&rcu_cb_lock, flags);
+	more = !list_empty(&rcu_cb_list);
+	vmm_spin_unlock_irqrestore(&rcu_cb_lock, flags);
+
+	if (more) {
+		vmm_workqueue_schedule_work(vmm_workqueue_unbound(), work);
+	}
+}
+
+void vmm_rcu_call(struct vmm_rcu_head *rhead,
+		  void (*func)(struct vmm_rcu_head *rhead))
+{
+	irq_flags_t flags;
+
+	if (!rhead || !func) {
+		return;
+	}
+
+	INIT_LIST_HEAD(&rhead->head);
+	rhead->func = func;
+
+	vmm_spin_lock_irqsave(&rcu_cb_lock, flags);
+	list_add_tail(&rhead->head, &rcu_cb_list);
+	vmm_spin_unlock_irqrestore(&rcu_cb_lock, flags);
+
+	vmm_workqueue_schedule_work(vmm_workqueue_unbound(), &rcu_cb_work);
+}
@@ -30,6 +30,10 @@
 #include <vmm_timer.h>
 #include <vmm_schedalgo.h>
 #include <vmm_scheduler.h>
+#include <vmm_loadbal.h>
+#include <vmm_cpuidle.h>
+#include <vmm_trace.h>
+#include <vmm_rcu.h>
 #include <vmm_stdio.h>
 #include <arch_regs.h>
 #include <arch_cpu_irq.h>
@@ -44,6 +48,8 @@
 
 #define SAMPLE_EVENT_PERIOD	(CONFIG_IDLE_PERIOD_SECS * 1000000000ULL)
 
+#define TRACE_COUNT		CONFIG_SCHED_TRACE_COUNT
+
 /** Control structure for Scheduler */
 struct vmm_scheduler_ctrl {
 	void *rq;
@@ -56,6 +62,9 @@ struct vmm_scheduler_ctrl {
 	u64 irq_enter_tstamp;
 	u64 irq_process_ns;
 	bool yield_on_irq_exit;
+#ifdef CONFIG_SCHED_DIRECTED_YIELD
+	struct vmm_vcpu *yield_to;
+#endif
 	struct vmm_timer_event ev;
 	struct vmm_timer_event sample_ev;
 	vmm_rwlock_t sample_lock;
@@ -64,6 +73,13 @@ struct vmm_scheduler_ctrl {
 	u64 sample_idle_last_ns;
 	u64 sample_irq_ns;
 	u64 sample_irq_last_ns;
+#ifdef CONFIG_SCHED_LATENCY
+	vmm_spinlock_t trace_lock;
+	u32 trace_head;
+	u32 trace_count;
+	u32 trace_lost;
+	struct vmm_scheduler_trace trace[TRACE_COUNT];
+#endif
 };
 
 static DEFINE_PER_CPU(struct vmm_scheduler_ctrl, sched);
@@ -134,6 +150,164 @@ static u32 rq_length(struct vmm_scheduler_ctrl *schedp, u32 priority)
 	return ret;
 }
 
+#ifdef CONFIG_SCHED_TICKLESS
+/* Check whether any ready VCPU can share host CPU with given VCPU */
+static bool rq_timeslice_needed(struct vmm_scheduler_ctrl *schedp,
+				struct vmm_vcpu *vcpu)
+{
+	u32 p;
+	bool ret = FALSE;
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave_lite(&schedp->rq_lock, flags);
+	for (p = vcpu->priority; p <= VMM_VCPU_MAX_PRIORITY; p++) {
+		if (vmm_schedalgo_rq_length(schedp->rq, p)) {
+			ret = TRUE;
+			break;
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&schedp->rq_lock, flags);
+
+	return ret;
+}
+#endif
+
+#ifdef CONFIG_SCHED_LATENCY
+/* NOTE: Must be called with vcpu->sched_lock held */
+static void scheduler_latency_account(struct vmm_vcpu *vcpu,
+				      u32 type, u64 ns)
+{
+	u32 b = 0;
+	u64 t = ns >> 10;
+	struct vmm_vcpu_sched_latency *lat = &vcpu->sched_latency[type];
+
+	lat->count++;
+	lat->total_ns += ns;
+	if (lat->max_ns < ns) {
+		lat->max_ns = ns;
+	}
+
+	while (t && (b < (VMM_VCPU_SCHED_HIST_BUCKETS - 1))) {
+		t >>= 1;
+		b++;
+	}
+	lat->hist[b]++;
+}
+
+/* NOTE: Must be called with next->sched_lock held */
+static void scheduler_latency_switch(struct vmm_scheduler_ctrl *schedp,
+				     struct vmm_vcpu *prev,
+				     u32 prev_state,
+				     struct vmm_vcpu *next,
+				     u64 tstamp)
+{
+	irq_flags_t flags;
+	struct vmm_scheduler_trace *tr;
+
+	if (next != prev) {
+		scheduler_latency_account(next, VMM_VCPU_SCHED_RQWAIT,
+					  tstamp - next->state_tstamp);
+		if (next->sched_woken) {
+			scheduler_latency_account(next, VMM_VCPU_SCHED_WAKEUP,
+						  tstamp - next->state_tstamp);
+		}
+	}
+	next->sched_woken = FALSE;
+
+	vmm_spin_lock_irqsave_lite(&schedp->trace_lock, flags);
+
+	tr = &schedp->trace[schedp->trace_head];
+	tr->tstamp = tstamp;
+	tr->prev_id = (prev) ? prev->id : VMM_SCHEDULER_TRACE_NO_VCPU;
+	tr->prev_state = prev_state;
+	tr->next_id = next->id;
+	tr->next_priority = next->priority;
+
+	schedp->trace_head = (schedp->trace_head + 1) % TRACE_COUNT;
+	if (schedp->trace_count < TRACE_COUNT) {
+		schedp->trace_count++;
+	} else {
+		schedp->trace_lost++;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&schedp->trace_lock, flags);
+}
+#else
+#define scheduler_latency_account(vcpu, type, ns)	do { } while (0)
+#define scheduler_latency_switch(schedp, prev, prev_state, next, tstamp) \
+							do { } while (0)
+#endif
+
+static void scheduler_timeslice_start(struct vmm_scheduler_ctrl *schedp,
+				      struct vmm_vcpu *next,
+				      u64 next_time_slice)
+{
+#ifdef CONFIG_SCHED_TICKLESS
+	/* If no other ready VCPU can take over the host CPU when
+	 * time slice expires then time slice event is useless so
+	 * we keep it stopped. The clockchip will be programmed
+	 * for the next real timer event instead.
+	 */
+	if (!rq_timeslice_needed(schedp, next)) {
+		vmm_timer_event_stop(&schedp->ev);
+		return;
+	}
+#endif
+	vmm_timer_event_start(&schedp->ev, next_time_slice);
+}
+
+#ifdef CONFIG_SCHED_DIRECTED_YIELD
+/* Ask host CPU of given READY VCPU to run it at next context switch */
+static void scheduler_yield_to(struct vmm_vcpu *vcpu)
+{
+	u32 hcpu = vcpu->hcpu;
+
+	per_cpu(sched, hcpu).yield_to = vcpu;
+	if (hcpu != vmm_smp_processor_id()) {
+		vmm_scheduler_force_resched(hcpu);
+	}
+}
+
+/* Must be called with write lock held on current->sched_lock.
+ * Returns the hinted VCPU detached from ready queue and with its
+ * sched_lock held or NULL if the hint can't be honored.
+ */
+static struct vmm_vcpu *scheduler_yield_to_next(
+					struct vmm_scheduler_ctrl *schedp,
+					struct vmm_vcpu *current,
+					irq_flags_t *nf)
+{
+	u32 prio;
+	struct vmm_vcpu *vcpu = schedp->yield_to;
+
+	if (!vcpu) {
+		return NULL;
+	}
+	schedp->yield_to = NULL;
+
+	if ((vcpu == current) || vcpu->is_deadline) {
+		return NULL;
+	}
+
+	/* Never run hinted VCPU ahead of higher priority ready VCPUs */
+	for (prio = vcpu->priority + 1; prio <= VMM_VCPU_MAX_PRIORITY; prio++) {
+		if (rq_length(schedp, prio)) {
+			return NULL;
+		}
+	}
+
+	vmm_write_lock_irqsave_lite(&vcpu->sched_lock, *nf);
+	if ((arch_atomic_read(&vcpu->state) != VMM_VCPU_STATE_READY) ||
+	    (&per_cpu(sched, vcpu->hcpu) != schedp) ||
+	    rq_detach(schedp, vcpu)) {
+		vmm_write_unlock_irqrestore_lite(&vcpu->sched_lock, *nf);
+		return NULL;
+	}
+
+	return vcpu;
+}
+#endif
+
 /* Should not be called from anywhere else */
 static struct vmm_vcpu *__vmm_scheduler_next1(struct vmm_scheduler_ctrl *schedp,
 					      arch_regs_t *regs)
@@ -153,13 +327,22 @@ static struct vmm_vcpu *__vmm_scheduler_next1(struct vmm_scheduler_ctrl *schedp,
 	vmm_write_lock_irqsave_lite(&next->sched_lock, nf);
 
 	arch_vcpu_switch(NULL, next, regs);
+	vmm_trace(SCHED_SWITCH, VMM_TRACE_NO_VCPU, VMM_VCPU_STATE_UNKNOWN,
+		  next->id, next->priority);
+	if (next->is_normal) {
+		vmm_manager_guest_boot_mark(next->guest,
+					VMM_GUEST_BOOT_FIRST_VCPU_ENTRY);
+	}
+	scheduler_latency_switch(schedp, NULL, VMM_VCPU_STATE_UNKNOWN,
+				 next, tstamp);
 	next->state_ready_nsecs += tstamp - next->state_tstamp;
 	arch_atomic_write(&next->state, VMM_VCPU_STATE_RUNNING);
 	next->resumed = FALSE;
+	next->spinning = FALSE;
 	next->state_tstamp = tstamp;
 	schedp->current_vcpu = next;
 	schedp->current_vcpu_irq_ns = schedp->irq_process_ns;
-	vmm_timer_event_start(&schedp->ev, next_time_slice);
+	scheduler_timeslice_start(schedp, next, next_time_slice);
 
 	vmm_write_unlock_irqrestore_lite(&next->sched_lock, nf);
 
@@ -184,6 +367,9 @@ static struct vmm_vcpu *__vmm_scheduler_next2(struct vmm_scheduler_ctrl *schedp,
 
 	if (current_state & VMM_VCPU_STATE_SAVEABLE) {
 		if (current_state == VMM_VCPU_STATE_RUNNING) {
+			scheduler_latency_account(current,
+					VMM_VCPU_SCHED_SLICE,
+					tstamp - current->state_tstamp);
 			current->state_running_nsecs +=
 				tstamp - current->state_tstamp;
 			current->state_running_nsecs -=
@@ -191,11 +377,21 @@ static struct vmm_vcpu *__vmm_scheduler_next2(struct vmm_scheduler_ctrl *schedp,
 			schedp->current_vcpu_irq_ns = schedp->irq_process_ns;
 			arch_atomic_write(&current->state, VMM_VCPU_STATE_READY);
 			current->state_tstamp = tstamp;
+			current->preempt_tstamp = tstamp;
 			rq_enqueue(schedp, current);
 		}
 		tcurrent = current;
 	}
 
+#ifdef CONFIG_SCHED_DIRECTED_YIELD
+	next = scheduler_yield_to_next(schedp, current, &nf);
+	if (next) {
+		next_time_slice = next->time_slice;
+		arch_vcpu_switch(tcurrent, next, regs);
+		goto switch_done;
+	}
+#endif
+
 dequeue_again:
 	rc = rq_dequeue(schedp, &next, &next_time_slice);
 	if (rc) {
@@ -221,13 +417,24 @@ dequeue_again:
 		arch_vcpu_switch(tcurrent, next, regs);
 	}
 
+#ifdef CONFIG_SCHED_DIRECTED_YIELD
+switch_done:
+#endif
+	vmm_trace(SCHED_SWITCH, current->id, current_state,
+		  next->id, next->priority);
+	if (next->is_normal) {
+		vmm_manager_guest_boot_mark(next->guest,
+					VMM_GUEST_BOOT_FIRST_VCPU_ENTRY);
+	}
+	scheduler_latency_switch(schedp, current, current_state, next, tstamp);
 	next->state_ready_nsecs += tstamp - next->state_tstamp;
 	arch_atomic_write(&next->state, VMM_VCPU_STATE_RUNNING);
 	next->resumed = FALSE;
+	next->spinning = FALSE;
 	next->state_tstamp = tstamp;
 	schedp->current_vcpu = next;
 	schedp->current_vcpu_irq_ns = schedp->irq_process_ns;
-	vmm_timer_event_start(&schedp->ev, next_time_slice);
+	scheduler_timeslice_start(schedp, next, next_time_slice);
 
 	if (next != current) {
 		vmm_write_unlock_irqrestore_lite(&next->sched_lock, nf);
@@ -236,6 +443,36 @@ dequeue_again:
 	return (next != current) ? next : NULL;
 }
 
+#ifdef CONFIG_SCHED_COSCHED
+/* Pull READY sibling VCPUs of given Guest VCPU onto their host CPUs */
+static void scheduler_cosched_siblings(struct vmm_vcpu *vcpu)
+{
+	u32 hcpu, chcpu = vmm_smp_processor_id();
+	irq_flags_t flags;
+	struct vmm_vcpu *sibling;
+	struct vmm_guest *guest = vcpu->guest;
+
+	if (guest->vcpu_count < 2) {
+		return;
+	}
+
+	vmm_read_lock_irqsave_lite(&guest->vcpu_lock, flags);
+	list_for_each_entry(sibling, &guest->vcpu_list, head) {
+		if ((sibling == vcpu) || sibling->is_deadline ||
+		    (arch_atomic_read(&sibling->state) !=
+						VMM_VCPU_STATE_READY)) {
+			continue;
+		}
+		hcpu = sibling->hcpu;
+		if ((hcpu == chcpu) || per_cpu(sched, hcpu).yield_to) {
+			continue;
+		}
+		scheduler_yield_to(sibling);
+	}
+	vmm_read_unlock_irqrestore_lite(&guest->vcpu_lock, flags);
+}
+#endif
+
 static void vmm_scheduler_switch(struct vmm_scheduler_ctrl *schedp,
 				 arch_regs_t *regs)
 {
@@ -253,6 +490,7 @@ static void vmm_scheduler_switch(struct vmm_scheduler_ctrl *schedp,
 		if (current->preempt_count == preempt_min) {
 			irq_flags_t cf;
 
+			vmm_rcu_quiescent_state();
 			vmm_write_lock_irqsave_lite(&current->sched_lock, cf);
 			next = __vmm_scheduler_next2(schedp, current, regs);
 			vmm_write_unlock_irqrestore_lite(&current->sched_lock,
@@ -272,11 +510,19 @@ static void vmm_scheduler_switch(struct vmm_scheduler_ctrl *schedp,
 			next = NULL;
 		}
 	} else {
+		vmm_rcu_quiescent_state();
 		next = __vmm_scheduler_next1(schedp, regs);
 	}
 
 	if (next) {
 		arch_vcpu_post_switch(next, regs);
+#ifdef CONFIG_SCHED_COSCHED
+		/* Gang up VCPUs of a Guest when it gets a host CPU */
+		if (next->is_normal && next->guest &&
+		    (!current || (current->guest != next->guest))) {
+			scheduler_cosched_siblings(next);
+		}
+#endif
 	}
 }
 
@@ -430,6 +676,19 @@ int vmm_scheduler_state_change(struct vmm_vcpu *vcpu, u32 new_state)
 			rc = rq_enqueue(schedp, vcpu);
 			if (!rc && (schedp->current_vcpu != vcpu)) {
 				preempt = rq_prempt_needed(schedp);
+#ifdef CONFIG_SCHED_TICKLESS
+				/* Current VCPU might be running without
+				 * time slice event so force re-scheduling
+				 * if the new ready VCPU has to share the
+				 * host CPU with current VCPU.
+				 */
+				if (!preempt && schedp->current_vcpu &&
+				    (schedp->current_vcpu->priority <=
+							vcpu->priority) &&
+				    !vmm_timer_event_pending(&schedp->ev)) {
+					preempt = TRUE;
+				}
+#endif
 			}
 		} else if (current_state == VMM_VCPU_STATE_RUNNING) {
 			/* Set resumed flag. This means we catch
@@ -483,6 +742,8 @@ int vmm_scheduler_state_change(struct vmm_vcpu *vcpu, u32 new_state)
 					tstamp - vcpu->state_tstamp;
 			break;
 		case VMM_VCPU_STATE_RUNNING:
+			scheduler_latency_account(vcpu, VMM_VCPU_SCHED_SLICE,
+					tstamp - vcpu->state_tstamp);
 			vcpu->state_running_nsecs +=
 					tstamp - vcpu->state_tstamp;
 			break;
@@ -504,6 +765,10 @@ int vmm_scheduler_state_change(struct vmm_vcpu *vcpu, u32 new_state)
 			vcpu->state_halted_nsecs = 0;
 			vcpu->reset_tstamp = tstamp;
 		}
+#ifdef CONFIG_SCHED_LATENCY
+		vcpu->sched_woken = (new_state == VMM_VCPU_STATE_READY) ?
+								TRUE : FALSE;
+#endif
 		arch_atomic_write(&vcpu->state, new_state);
 		vcpu->state_tstamp = tstamp;
 	}
@@ -540,6 +805,52 @@ skip_state_change:
 	return rc;
 }
 
+#ifdef CONFIG_SCHED_LATENCY
+u32 vmm_scheduler_trace_read(u32 hcpu, struct vmm_scheduler_trace *buf,
+			     u32 max, u32 *lost)
+{
+	u32 i, first, count;
+	irq_flags_t flags;
+	struct vmm_scheduler_ctrl *schedp;
+
+	if ((CONFIG_CPU_COUNT <= hcpu) || !buf) {
+		return 0;
+	}
+	schedp = &per_cpu(sched, hcpu);
+
+	vmm_spin_lock_irqsave_lite(&schedp->trace_lock, flags);
+
+	count = (max < schedp->trace_count) ? max : schedp->trace_count;
+	first = (schedp->trace_head + TRACE_COUNT - schedp->trace_count) %
+								TRACE_COUNT;
+	for (i = 0; i < count; i++) {
+		buf[i] = schedp->trace[(first + i) % TRACE_COUNT];
+	}
+	if (lost) {
+		*lost = schedp->trace_lost;
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&schedp->trace_lock, flags);
+
+	return count;
+}
+
+void vmm_scheduler_trace_clear(u32 hcpu)
+{
+	irq_flags_t flags;
+	struct vmm_scheduler_ctrl *schedp;
+
+	if (CONFIG_CPU_COUNT <= hcpu) {
+		return;
+	}
+	schedp = &per_cpu(sched, hcpu);
+
+	vmm_spin_lock_irqsave_lite(&schedp->trace_lock, flags);
+	schedp->trace_head = schedp->trace_count = schedp->trace_lost = 0;
+	vmm_spin_unlock_irqrestore_lite(&schedp->trace_lock, flags);
+}
+#endif
+
 int vmm_scheduler_get_hcpu(struct vmm_vcpu *vcpu, u32 *hcpu)
 {
 	irq_flags_t flags;
@@ -654,6 +965,56 @@ int vmm_scheduler_set_hcpu(struct vmm_vcpu *vcpu, u32 hcpu)
 	return VMM_OK;
 }
 
+int vmm_scheduler_set_priority(struct vmm_vcpu *vcpu, u8 priority)
+{
+	int rc = VMM_OK;
+	u32 state, vhcpu;
+	irq_flags_t flags;
+	bool resched = FALSE;
+	struct vmm_scheduler_ctrl *schedp;
+
+	if (!vcpu ||
+	    (priority < VMM_VCPU_MIN_PRIORITY) ||
+	    (VMM_VCPU_MAX_PRIORITY < priority)) {
+		return VMM_EINVALID;
+	}
+
+	/* Lock VCPU scheduling */
+	vmm_write_lock_irqsave_lite(&vcpu->sched_lock, flags);
+
+	if (vcpu->priority == priority) {
+		goto done;
+	}
+
+	vhcpu = vcpu->hcpu;
+	schedp = &per_cpu(sched, vhcpu);
+	state = arch_atomic_read(&vcpu->state);
+
+	/* Ready queues are indexed by priority so requeue READY VCPU */
+	if ((state == VMM_VCPU_STATE_READY) &&
+	    (schedp->current_vcpu != vcpu)) {
+		if ((rc = rq_detach(schedp, vcpu))) {
+			goto done;
+		}
+		resched = (vcpu->priority < priority) ? TRUE : FALSE;
+		vcpu->priority = priority;
+		rc = rq_enqueue(schedp, vcpu);
+	} else {
+		vcpu->priority = priority;
+	}
+
+done:
+	/* Unlock VCPU scheduling */
+	vmm_write_unlock_irqrestore_lite(&vcpu->sched_lock, flags);
+
+	/* Boosted READY VCPU might have to preempt current VCPU */
+	if (!rc && resched) {
+		vmm_scheduler_force_resched(vhcpu);
+	}
+
+	return rc;
+}
+
 void vmm_scheduler_irq_enter(arch_regs_t *regs, bool vcpu_context)
 {
 	struct vmm_scheduler_ctrl *schedp = &this_cpu(sched);
@@ -712,6 +1073,11 @@ bool vmm_scheduler_irq_context(void)
 	return this_cpu(sched).irq_context;
 }
 
+arch_regs_t *vmm_scheduler_irq_regs(void)
+{
+	return this_cpu(sched).irq_regs;
+}
+
 bool vmm_scheduler_orphan_context(void)
 {
 	bool ret = FALSE;
@@ -895,6 +1261,40 @@ struct vmm_guest *vmm_scheduler_current_guest(void)
 	return (vcpu) ? vcpu->guest : NULL;
 }
 
+#ifdef CONFIG_SCHED_DIRECTED_YIELD
+/* Find the most recently preempted sibling of given Guest VCPU which
+ * is not spinning itself. Such sibling is the likely holder of the
+ * lock (e.g. ticket lock) given VCPU is spinning on.
+ */
+static struct vmm_vcpu *scheduler_preempted_sibling(struct vmm_vcpu *vcpu)
+{
+	irq_flags_t flags;
+	struct vmm_vcpu *sibling, *found = NULL;
+	struct vmm_guest *guest = vcpu->guest;
+
+	if (!guest || (guest->vcpu_count < 2)) {
+		return NULL;
+	}
+
+	vmm_read_lock_irqsave_lite(&guest->vcpu_lock, flags);
+	list_for_each_entry(sibling, &guest->vcpu_list, head) {
+		if ((sibling == vcpu) || sibling->is_deadline ||
+		    sibling->spinning ||
+		    (arch_atomic_read(&sibling->state) !=
+						VMM_VCPU_STATE_READY)) {
+			continue;
+		}
+		if (!found ||
+		    (found->preempt_tstamp < sibling->preempt_tstamp)) {
+			found = sibling;
+		}
+	}
+	vmm_read_unlock_irqrestore_lite(&guest->vcpu_lock, flags);
+
+	return found;
+}
+#endif
+
 void vmm_scheduler_yield(void)
 {
 	struct vmm_scheduler_ctrl *schedp = &this_cpu(sched);
@@ -909,17 +1309,47 @@ void vmm_scheduler_yield(void)
 	}
 
 	if (vmm_manager_vcpu_get_state(vcpu) == VMM_VCPU_STATE_RUNNING) {
+#ifdef CONFIG_SCHED_DIRECTED_YIELD
+		struct vmm_vcpu *sibling;
+
+		/* Guest VCPU yields on spin-loop (WFE/PAUSE) exits so
+		 * hand over to the sibling it is probably waiting for.
+		 */
+		if (vcpu->is_normal &&
+		    (sibling = scheduler_preempted_sibling(vcpu))) {
+			scheduler_yield_to(sibling);
+		}
+#endif
 		vmm_scheduler_state_change(vcpu, VMM_VCPU_STATE_READY);
 	}
 }
 
+void vmm_scheduler_yield_spin(void)
+{
+	struct vmm_vcpu *vcpu = this_cpu(sched).current_vcpu;
+
+	if (vcpu && vcpu->is_normal) {
+		vcpu->spinning = TRUE;
+	}
+
+	vmm_scheduler_yield();
+}
+
 static void idle_orphan(void)
 {
 	struct vmm_scheduler_ctrl *schedp = &this_cpu(sched);
 
 	while (1) {
+#ifdef CONFIG_ISOLCPUS_IDLE_POLL
+		if (vmm_cpu_isolated(vmm_smp_processor_id())) {
+			while (rq_length(schedp, IDLE_VCPU_PRIORITY) == 0) {
+				arch_cpu_relax();
+			}
+		}
+#endif
 		if (rq_length(schedp, IDLE_VCPU_PRIORITY) == 0) {
-			arch_cpu_wait_for_irq();
+			vmm_loadbal_idle_notify();
+			vmm_cpuidle_enter();
 		}
 
 		vmm_scheduler_yield();
@@ -956,6 +1386,9 @@ int __cpuinit vmm_scheduler_init(void)
 
 	/* Initialize yield on exit (Per Host CPU) */
 	schedp->yield_on_irq_exit = FALSE;
+#ifdef CONFIG_SCHED_DIRECTED_YIELD
+	schedp->yield_to = NULL;
+#endif
 
 	/* Initialize timer events (Per Host CPU) */
 	INIT_TIMER_EVENT(&schedp->ev, &scheduler_timer_event, schedp);
@@ -969,6 +1402,12 @@ int __cpuinit vmm_scheduler_init(void)
 	schedp->sample_idle_last_ns = 0;
 	schedp->sample_irq_ns = 0;
 	schedp->sample_irq_last_ns = 0;
+#ifdef CONFIG_SCHED_LATENCY
+	INIT_SPIN_LOCK(&schedp->trace_lock);
+	schedp->trace_head = 0;
+	schedp->trace_count = 0;
+	schedp->trace_lost = 0;
+#endif
 
 	/* Create idle orphan vcpu with default time slice. (Per Host CPU) */
 	vmm_snprintf(vcpu_name, sizeof(vcpu_name), "idle/%d", cpu);
@@ -978,7 +1417,8 @@ int __cpuinit vmm_scheduler_init(void)
 						IDLE_VCPU_PRIORITY,
 						IDLE_VCPU_TIMESLICE,
 						IDLE_VCPU_TIMESLICE,
-						IDLE_VCPU_TIMESLICE);
+						IDLE_VCPU_TIMESLICE,
+						FALSE);
 	if (!schedp->idle_vcpu) {
 		return VMM_EFAIL;
 	}
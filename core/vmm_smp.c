@@ -21,7 +21,10 @@
  * @brief Symetric Multiprocessor Mamagment APIs Implementation
  */
 
+#include <arch_atomic.h>
+#include <arch_barrier.h>
 #include <vmm_error.h>
+#include <vmm_heap.h>
 #include <vmm_limits.h>
 #include <vmm_percpu.h>
 #include <vmm_smp.h>
@@ -30,7 +33,9 @@
 #include <vmm_timer.h>
 #include <vmm_completion.h>
 #include <vmm_manager.h>
-#include <libs/fifo.h>
+#include <libs/list.h>
+#include <libs/log2.h>
+#include <libs/stringlib.h>
 
 /* SMP processor ID for Boot CPU */
 static u32 smp_bootcpu_id = UINT_MAX;
@@ -63,6 +68,7 @@ bool vmm_smp_is_bootcpu(void)
  * simultaneously to a host CPU should not be more than 
  * maximum possible hardware CPUs but, we keep minimum
  * Sync IPIs per host CPU to max possible VCPUs.
+ * (Rounded-up to power of two at init time)
  */
 #define SMP_IPI_MAX_SYNC_PER_CPU	(CONFIG_MAX_VCPU_COUNT)
 
@@ -72,8 +78,7 @@ bool vmm_smp_is_bootcpu(void)
  */
 #define SMP_IPI_MAX_ASYNC_PER_CPU	(64)
 
-#define SMP_IPI_WAIT_TRY_COUNT		100
-#define SMP_IPI_WAIT_UDELAY		1000
+#define SMP_IPI_WAIT_UDELAY		1
 
 #define IPI_VCPU_STACK_SZ 		CONFIG_THREAD_STACK_SIZE
 #define IPI_VCPU_PRIORITY 		VMM_VCPU_MAX_PRIORITY
@@ -90,89 +95,281 @@ struct smp_ipi_call {
 	void *arg2;
 };
 
+/* Multi-producer single-consumer lock-free ring of IPI calls.
+ *
+ * Each slot carries a sequence number: slot N is free for the
+ * producer holding ticket N when seq == N and holds a published
+ * call for the consumer when seq == N + 1. Producers reserve a
+ * ticket by cmpxchg on tail whereas only the destination host CPU
+ * advances head. All positions are 32-bit free running counters.
+ */
+struct smp_ipi_slot {
+	atomic_t seq;
+	struct smp_ipi_call call;
+};
+
+struct smp_ipi_ring {
+	u32 size;
+	atomic_t head;
+	atomic_t tail;
+	struct smp_ipi_slot *slots;
+};
+
+/* Async IPI which did not fit in async ring */
+struct smp_ipi_ovf {
+	struct dlist head;
+	struct smp_ipi_call call;
+};
+
 struct smp_ipi_ctrl {
-	struct fifo *sync_fifo;
-	struct fifo *async_fifo;
+	struct smp_ipi_ring sync_ring;
+	struct smp_ipi_ring async_ring;
+	atomic_t ipi_pending;
+	vmm_spinlock_t ovf_lock;
+	struct dlist ovf_list;
 	struct vmm_completion ipi_avail;
 	struct vmm_vcpu *ipi_vcpu;
 };
 
 static DEFINE_PER_CPU(struct smp_ipi_ctrl, ictl);
 
-static void smp_ipi_sync_submit(struct smp_ipi_ctrl *ictlp, 
-				struct smp_ipi_call *ipic)
+static int smp_ipi_ring_init(struct smp_ipi_ring *r, u32 size)
 {
-	int try;
+	u32 i;
+
+	r->size = roundup_pow_of_two(size);
+	r->slots = vmm_zalloc(r->size * sizeof(*r->slots));
+	if (!r->slots) {
+		return VMM_ENOMEM;
+	}
 
+	for (i = 0; i < r->size; i++) {
+		ARCH_ATOMIC_INIT(&r->slots[i].seq, i);
+	}
+	ARCH_ATOMIC_INIT(&r->head, 0);
+	ARCH_ATOMIC_INIT(&r->tail, 0);
+
+	return VMM_OK;
+}
+
+static void smp_ipi_ring_cleanup(struct smp_ipi_ring *r)
+{
+	if (r->slots) {
+		vmm_free(r->slots);
+		r->slots = NULL;
+	}
+}
+
+/* Returns TRUE and the ticket of enqueued call on success or
+ * FALSE when the ring is full.
+ */
+static bool smp_ipi_ring_enqueue(struct smp_ipi_ring *r,
+				 struct smp_ipi_call *ipic, u32 *ticket)
+{
+	u32 pos, seq;
+	irq_flags_t flags;
+	struct smp_ipi_slot *slot;
+
+	/* Don't get interrupted between reserving and
+	 * publishing a slot because consumer waits for it.
+	 */
+	arch_cpu_irq_save(flags);
+
+	while (1) {
+		pos = (u32)arch_atomic_read(&r->tail);
+		slot = &r->slots[pos & (r->size - 1)];
+		seq = (u32)arch_atomic_read(&slot->seq);
+		if (seq == pos) {
+			if ((u32)arch_atomic_cmpxchg(&r->tail, pos,
+						     pos + 1) == pos) {
+				break;
+			}
+		} else if ((int)(seq - pos) < 0) {
+			arch_cpu_irq_restore(flags);
+			return FALSE;
+		}
+	}
+
+	memcpy(&slot->call, ipic, sizeof(slot->call));
+	arch_smp_wmb();
+	arch_atomic_write(&slot->seq, pos + 1);
+
+	arch_cpu_irq_restore(flags);
+
+	if (ticket) {
+		*ticket = pos;
+	}
+
+	return TRUE;
+}
+
+/* Only called by the consumer host CPU. Returns call at head
+ * without releasing its slot or NULL when the ring is empty.
+ */
+static struct smp_ipi_call *smp_ipi_ring_peek(struct smp_ipi_ring *r)
+{
+	u32 pos = (u32)arch_atomic_read(&r->head);
+	struct smp_ipi_slot *slot = &r->slots[pos & (r->size - 1)];
+
+	if (pos == (u32)arch_atomic_read(&r->tail)) {
+		return NULL;
+	}
+
+	/* Ticket is reserved so wait for producer to publish it */
+	while ((u32)arch_atomic_read(&slot->seq) != (pos + 1)) ;
+	arch_smp_rmb();
+
+	return &slot->call;
+}
+
+/* Only called by the consumer host CPU after smp_ipi_ring_peek() */
+static void smp_ipi_ring_release(struct smp_ipi_ring *r)
+{
+	u32 pos = (u32)arch_atomic_read(&r->head);
+	struct smp_ipi_slot *slot = &r->slots[pos & (r->size - 1)];
+
+	arch_smp_mb();
+	arch_atomic_write(&slot->seq, pos + r->size);
+	arch_atomic_write(&r->head, pos + 1);
+}
+
+/* Check whether call with given ticket was processed */
+static bool smp_ipi_ring_done(struct smp_ipi_ring *r, u32 ticket)
+{
+	return ((int)((u32)arch_atomic_read(&r->head) - ticket) > 0) ?
+								TRUE : FALSE;
+}
+
+/* Mark IPI pending on destination host CPU and return TRUE
+ * if caller has to trigger hardware IPI. Already pending IPIs
+ * are coalesced because destination host CPU clears pending
+ * state before processing its rings.
+ */
+static bool smp_ipi_mark_pending(struct smp_ipi_ctrl *ictlp)
+{
+	if (arch_atomic_read(&ictlp->ipi_pending)) {
+		return FALSE;
+	}
+
+	return (arch_atomic_cmpxchg(&ictlp->ipi_pending, 0, 1) == 0) ?
+								TRUE : FALSE;
+}
+
+static bool smp_ipi_sync_submit(struct smp_ipi_ctrl *ictlp, 
+				struct smp_ipi_call *ipic,
+				u64 timeout_tstamp, u32 *ticket)
+{
 	if (!ipic || !ipic->func) {
-		return;
+		return FALSE;
 	}
 
-	try = SMP_IPI_WAIT_TRY_COUNT;
-	while (!fifo_enqueue(ictlp->sync_fifo, ipic, FALSE) && try) {
+	while (!smp_ipi_ring_enqueue(&ictlp->sync_ring, ipic, ticket)) {
+		/* Ring full so kick destination and wait */
 		arch_smp_ipi_trigger(vmm_cpumask_of(ipic->dst_cpu));
+		if (timeout_tstamp <= vmm_timer_timestamp()) {
+			vmm_printf("CPU%d: IPI sync ring full\n",
+				   ipic->dst_cpu);
+			return FALSE;
+		}
 		vmm_udelay(SMP_IPI_WAIT_UDELAY);
-		try--;
 	}
 
-	if (!try) {
-		vmm_panic("CPU%d: IPI sync fifo full\n", ipic->dst_cpu);
-	}
-
-	arch_smp_ipi_trigger(vmm_cpumask_of(ipic->dst_cpu));
+	return TRUE;
 }
 
 static void smp_ipi_async_submit(struct smp_ipi_ctrl *ictlp, 
 				 struct smp_ipi_call *ipic)
 {
-	int try;
+	irq_flags_t flags;
+	struct smp_ipi_ovf *ovf;
 
 	if (!ipic || !ipic->func) {
 		return;
 	}
 
-	try = SMP_IPI_WAIT_TRY_COUNT;
-	while (!fifo_enqueue(ictlp->async_fifo, ipic, FALSE) && try) {
-		arch_smp_ipi_trigger(vmm_cpumask_of(ipic->dst_cpu));
-		vmm_udelay(SMP_IPI_WAIT_UDELAY);
-		try--;
+	/* Once we overflow, keep using overflow list till
+	 * it drains so that IPIs are not reordered.
+	 */
+	if (list_empty(&ictlp->ovf_list) &&
+	    smp_ipi_ring_enqueue(&ictlp->async_ring, ipic, NULL)) {
+		return;
 	}
 
-	if (!try) {
-		vmm_panic("CPU%d: IPI async fifo full\n", ipic->dst_cpu);
+	ovf = vmm_malloc(sizeof(*ovf));
+	if (!ovf) {
+		/* No memory so wait for space in async ring */
+		while (!smp_ipi_ring_enqueue(&ictlp->async_ring,
+					     ipic, NULL)) {
+			arch_smp_ipi_trigger(vmm_cpumask_of(ipic->dst_cpu));
+			vmm_udelay(SMP_IPI_WAIT_UDELAY);
+		}
+		return;
 	}
+	INIT_LIST_HEAD(&ovf->head);
+	memcpy(&ovf->call, ipic, sizeof(ovf->call));
 
-	arch_smp_ipi_trigger(vmm_cpumask_of(ipic->dst_cpu));
+	vmm_spin_lock_irqsave_lite(&ictlp->ovf_lock, flags);
+	list_add_tail(&ovf->head, &ictlp->ovf_list);
+	vmm_spin_unlock_irqrestore_lite(&ictlp->ovf_lock, flags);
 }
 
 static void smp_ipi_main(void)
 {
-	struct smp_ipi_call ipic;
+	irq_flags_t flags;
+	struct smp_ipi_ovf *ovf;
+	struct smp_ipi_call *ipicp, ipic;
 	struct smp_ipi_ctrl *ictlp = &this_cpu(ictl);
 
 	while (1) {
 		/* Wait for some IPI to be available */
 		vmm_completion_wait(&ictlp->ipi_avail);
 
-		/* Process async IPIs */
-		while (fifo_dequeue(ictlp->async_fifo, &ipic)) {
-			if (ipic.func) {
-				ipic.func(ipic.arg0, ipic.arg1, ipic.arg2);
+		while (1) {
+			/* Process async IPIs */
+			while ((ipicp = smp_ipi_ring_peek(&ictlp->async_ring))) {
+				memcpy(&ipic, ipicp, sizeof(ipic));
+				smp_ipi_ring_release(&ictlp->async_ring);
+				if (ipic.func) {
+					ipic.func(ipic.arg0, ipic.arg1, ipic.arg2);
+				}
+			}
+
+			/* Process overflowed async IPIs */
+			vmm_spin_lock_irqsave_lite(&ictlp->ovf_lock, flags);
+			if (list_empty(&ictlp->ovf_list)) {
+				vmm_spin_unlock_irqrestore_lite(&ictlp->ovf_lock,
+								flags);
+				break;
+			}
+			ovf = list_first_entry(&ictlp->ovf_list,
+					       struct smp_ipi_ovf, head);
+			list_del(&ovf->head);
+			vmm_spin_unlock_irqrestore_lite(&ictlp->ovf_lock, flags);
+
+			if (ovf->call.func) {
+				ovf->call.func(ovf->call.arg0,
+					       ovf->call.arg1, ovf->call.arg2);
 			}
+			vmm_free(ovf);
 		}
 	}
 }
 
 void vmm_smp_ipi_exec(void)
 {
-	struct smp_ipi_call ipic;
+	struct smp_ipi_call *ipicp;
 	struct smp_ipi_ctrl *ictlp = &this_cpu(ictl);
 
+	/* Clear pending state before looking at rings */
+	arch_atomic_write(&ictlp->ipi_pending, 0);
+	arch_smp_mb();
+
 	/* Process Sync IPIs */
-	while (fifo_dequeue(ictlp->sync_fifo, &ipic)) {
-		if (ipic.func) {
-			ipic.func(ipic.arg0, ipic.arg1, ipic.arg2);
+	while ((ipicp = smp_ipi_ring_peek(&ictlp->sync_ring))) {
+		if (ipicp->func) {
+			ipicp->func(ipicp->arg0, ipicp->arg1, ipicp->arg2);
 		}
+		smp_ipi_ring_release(&ictlp->sync_ring);
 	}
 
 	/* Signal IPI available event */
@@ -185,6 +382,8 @@ void vmm_smp_ipi_async_call(const struct vmm_cpumask *dest,
 {
 	u32 c, cpu = vmm_smp_processor_id();
 	struct smp_ipi_call ipic;
+	struct smp_ipi_ctrl *ictlp;
+	struct vmm_cpumask trig_mask = VMM_CPU_MASK_NONE;
 
 	if (!dest || !func) {
 		return;
@@ -204,9 +403,18 @@ void vmm_smp_ipi_async_call(const struct vmm_cpumask *dest,
 			ipic.arg0 = arg0;
 			ipic.arg1 = arg1;
 			ipic.arg2 = arg2;
-			smp_ipi_async_submit(&per_cpu(ictl, c), &ipic);
+			ictlp = &per_cpu(ictl, c);
+			smp_ipi_async_submit(ictlp, &ipic);
+			if (smp_ipi_mark_pending(ictlp)) {
+				vmm_cpumask_set_cpu(c, &trig_mask);
+			}
 		}
 	}
+
+	/* One hardware IPI for whole batch */
+	if (!vmm_cpumask_empty(&trig_mask)) {
+		arch_smp_ipi_trigger(&trig_mask);
+	}
 }
 
 int vmm_smp_ipi_sync_call(const struct vmm_cpumask *dest,
@@ -217,6 +425,8 @@ int vmm_smp_ipi_sync_call(const struct vmm_cpumask *dest,
 	int rc = VMM_OK;
 	u64 timeout_tstamp;
 	u32 c, trig_count, cpu = vmm_smp_processor_id();
+	u32 ticket[CONFIG_CPU_COUNT];
+	struct vmm_cpumask wait_mask = VMM_CPU_MASK_NONE;
 	struct vmm_cpumask trig_mask = VMM_CPU_MASK_NONE;
 	struct smp_ipi_call ipic;
 	struct smp_ipi_ctrl *ictlp;
@@ -225,6 +435,9 @@ int vmm_smp_ipi_sync_call(const struct vmm_cpumask *dest,
 		return VMM_EFAIL;
 	}
 
+	timeout_tstamp = vmm_timer_timestamp();
+	timeout_tstamp += (u64)timeout_msecs * 1000000ULL;
+
 	trig_count = 0;
 	for_each_cpu(c, dest) {
 		if (c == cpu) {
@@ -240,32 +453,44 @@ int vmm_smp_ipi_sync_call(const struct vmm_cpumask *dest,
 			ipic.arg0 = arg0;
 			ipic.arg1 = arg1;
 			ipic.arg2 = arg2;
-			smp_ipi_sync_submit(&per_cpu(ictl, c), &ipic);
-			vmm_cpumask_set_cpu(c, &trig_mask);
+			ictlp = &per_cpu(ictl, c);
+			if (!smp_ipi_sync_submit(ictlp, &ipic,
+						 timeout_tstamp, &ticket[c])) {
+				rc = VMM_ETIMEDOUT;
+				continue;
+			}
+			if (smp_ipi_mark_pending(ictlp)) {
+				vmm_cpumask_set_cpu(c, &trig_mask);
+			}
+			vmm_cpumask_set_cpu(c, &wait_mask);
 			trig_count++;
 		}
 	}
 
-	if (trig_count) {
-		rc = VMM_ETIMEDOUT;
-		timeout_tstamp = vmm_timer_timestamp();
-		timeout_tstamp += (u64)timeout_msecs * 1000000ULL;
-		while (vmm_timer_timestamp() < timeout_tstamp) {
-			for_each_cpu(c, &trig_mask) {
-				ictlp = &per_cpu(ictl, c);
-				if (!fifo_avail(ictlp->sync_fifo)) {
-					vmm_cpumask_clear_cpu(c, &trig_mask);
-					trig_count--;
-				}
-			}
+	/* One hardware IPI for whole batch */
+	if (!vmm_cpumask_empty(&trig_mask)) {
+		arch_smp_ipi_trigger(&trig_mask);
+	}
 
-			if (!trig_count) {
-				rc = VMM_OK;
-				break;
+	while (trig_count) {
+		for_each_cpu(c, &wait_mask) {
+			ictlp = &per_cpu(ictl, c);
+			if (smp_ipi_ring_done(&ictlp->sync_ring, ticket[c])) {
+				vmm_cpumask_clear_cpu(c, &wait_mask);
+				trig_count--;
 			}
+		}
 
-			vmm_udelay(SMP_IPI_WAIT_UDELAY);
+		if (!trig_count) {
+			break;
+		}
+
+		if (timeout_tstamp <= vmm_timer_timestamp()) {
+			rc = VMM_ETIMEDOUT;
+			break;
 		}
+
+		vmm_udelay(SMP_IPI_WAIT_UDELAY);
 	}
 
 	return rc;
@@ -278,22 +503,23 @@ int __cpuinit vmm_smp_ipi_init(void)
 	u32 cpu = vmm_smp_processor_id();
 	struct smp_ipi_ctrl *ictlp = &this_cpu(ictl);
 
-	/* Initialize Sync IPI FIFO */
-	ictlp->sync_fifo = fifo_alloc(sizeof(struct smp_ipi_call), 
-					   SMP_IPI_MAX_SYNC_PER_CPU);
-	if (!ictlp->sync_fifo) {
-		rc = VMM_ENOMEM;
+	/* Initialize Sync IPI ring */
+	rc = smp_ipi_ring_init(&ictlp->sync_ring, SMP_IPI_MAX_SYNC_PER_CPU);
+	if (rc) {
 		goto fail;
 	}
 
-	/* Initialize Async IPI FIFO */
-	ictlp->async_fifo = fifo_alloc(sizeof(struct smp_ipi_call), 
-					   SMP_IPI_MAX_ASYNC_PER_CPU);
-	if (!ictlp->async_fifo) {
-		rc = VMM_ENOMEM;
+	/* Initialize Async IPI ring */
+	rc = smp_ipi_ring_init(&ictlp->async_ring, SMP_IPI_MAX_ASYNC_PER_CPU);
+	if (rc) {
 		goto fail_free_sync;
 	}
 
+	/* Initialize IPI pending state and async overflow list */
+	ARCH_ATOMIC_INIT(&ictlp->ipi_pending, 0);
+	INIT_SPIN_LOCK(&ictlp->ovf_lock);
+	INIT_LIST_HEAD(&ictlp->ovf_list);
+
 	/* Initialize IPI available completion event */
 	INIT_COMPLETION(&ictlp->ipi_avail);
 
@@ -305,7 +531,8 @@ int __cpuinit vmm_smp_ipi_init(void)
 						IPI_VCPU_PRIORITY, 
 						IPI_VCPU_TIMESLICE,
 						IPI_VCPU_DEADLINE,
-						IPI_VCPU_PERIODICITY);
+						IPI_VCPU_PERIODICITY,
+						FALSE);
 	if (!ictlp->ipi_vcpu) {
 		rc = VMM_EFAIL;
 		goto fail_free_async;
@@ -334,9 +561,9 @@ fail_stop_vcpu:
 fail_free_vcpu:
 	vmm_manager_vcpu_orphan_destroy(ictlp->ipi_vcpu);
 fail_free_async:
-	fifo_free(ictlp->async_fifo);
+	smp_ipi_ring_cleanup(&ictlp->async_ring);
 fail_free_sync:
-	fifo_free(ictlp->sync_fifo);
+	smp_ipi_ring_cleanup(&ictlp->sync_ring);
 fail:
 	return rc;
 }
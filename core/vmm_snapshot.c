@@ -0,0 +1,950 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_snapshot.c
+ * @author agent (agent@local)
+ * @brief Guest snapshot implementation
+ *
+ * Guest RAM is restored eagerly before the guest is kicked. Stage2
+ * faults are handled in VCPU context which cannot sleep on the file
+ * or block device I/O needed to fetch a page from the snapshot hence
+ * there is no on-demand loading of guest pages. Zero pages are never
+ * written to the snapshot so restore time scales with populated memory.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_smp.h>
+#include <vmm_manager.h>
+#include <vmm_scheduler.h>
+#include <vmm_completion.h>
+#include <vmm_timer.h>
+#include <vmm_host_aspace.h>
+#include <vmm_guest_aspace.h>
+#include <vmm_devemu.h>
+#include <vmm_snapshot.h>
+#include <arch_vcpu.h>
+#include <libs/bitmap.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+
+#define SNAPSHOT_CHUNK_SIZE		(16 * VMM_PAGE_SIZE)
+
+struct snapshot_ctx {
+	struct vmm_snapshot_stream *stream;
+	struct vmm_snapshot_state st;
+	u32 emudev_flags;
+	u64 ram_bytes;
+	u8 *buf;
+};
+
+int vmm_snapshot_put(struct vmm_snapshot_state *st,
+		     const void *data, size_t len)
+{
+	u8 *nbuf;
+	size_t nsize;
+
+	if (!st || (!data && len)) {
+		return VMM_EINVALID;
+	}
+
+	if (st->size < (st->len + len)) {
+		nsize = (st->size) ? st->size : 256;
+		while (nsize < (st->len + len)) {
+			nsize *= 2;
+		}
+		nbuf = vmm_malloc(nsize);
+		if (!nbuf) {
+			return VMM_ENOMEM;
+		}
+		if (st->buf) {
+			memcpy(nbuf, st->buf, st->len);
+			vmm_free(st->buf);
+		}
+		st->buf = nbuf;
+		st->size = nsize;
+	}
+
+	memcpy(&st->buf[st->len], data, len);
+	st->len += len;
+
+	return VMM_OK;
+}
+
+int vmm_snapshot_get(struct vmm_snapshot_state *st,
+		     void *data, size_t len)
+{
+	if (!st || (!data && len)) {
+		return VMM_EINVALID;
+	}
+
+	if ((st->len - st->pos) < len) {
+		return VMM_EINVALID;
+	}
+
+	memcpy(data, &st->buf[st->pos], len);
+	st->pos += len;
+
+	return VMM_OK;
+}
+
+static int snapshot_write(struct vmm_snapshot_stream *stream,
+			  const void *buf, size_t len)
+{
+	return (stream->write(stream->priv, buf, len) == len) ?
+							VMM_OK : VMM_EIO;
+}
+
+static int snapshot_read(struct vmm_snapshot_stream *stream,
+			 void *buf, size_t len)
+{
+	return (stream->read(stream->priv, buf, len) == len) ?
+							VMM_OK : VMM_EIO;
+}
+
+static int snapshot_write_record(struct vmm_snapshot_stream *stream,
+				 u32 type, u32 flags, u64 addr,
+				 const void *data, u64 len)
+{
+	int rc;
+	struct vmm_snapshot_record rec;
+
+	rec.type = type;
+	rec.flags = flags;
+	rec.addr = addr;
+	rec.len = len;
+	rc = snapshot_write(stream, &rec, sizeof(rec));
+	if (rc || !len) {
+		return rc;
+	}
+
+	return snapshot_write(stream, data, len);
+}
+
+/* Read record data of VCPU or emulated device into ctx->st */
+static int snapshot_read_state(struct snapshot_ctx *ctx, u64 len)
+{
+	ctx->st.len = ctx->st.pos = 0;
+	while (ctx->st.size < len) {
+		if (ctx->st.buf) {
+			vmm_free(ctx->st.buf);
+		}
+		ctx->st.size = (ctx->st.size) ? ctx->st.size * 2 : 256;
+		ctx->st.buf = vmm_malloc(ctx->st.size);
+		if (!ctx->st.buf) {
+			ctx->st.size = 0;
+			return VMM_ENOMEM;
+		}
+	}
+	ctx->st.len = len;
+
+	return (len) ? snapshot_read(ctx->stream, ctx->st.buf, len) : VMM_OK;
+}
+
+static bool snapshot_iszero(const u8 *buf, u32 len)
+{
+	u32 i;
+
+	for (i = 0; (i + sizeof(u64)) <= len; i += sizeof(u64)) {
+		if (*(const u64 *)&buf[i]) {
+			return FALSE;
+		}
+	}
+	for (; i < len; i++) {
+		if (buf[i]) {
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+static int snapshot_save_vcpu(struct snapshot_ctx *ctx,
+			      struct vmm_vcpu *vcpu)
+{
+	int rc;
+	u32 state = vmm_manager_vcpu_get_state(vcpu);
+
+	ctx->st.len = ctx->st.pos = 0;
+	rc = vmm_snapshot_put_var(&ctx->st, state);
+	if (rc) {
+		return rc;
+	}
+
+	rc = arch_vcpu_state_save(vcpu, &ctx->st);
+	if (rc) {
+		vmm_printf("%s: %s: arch state save failed (error %d)\n",
+			   __func__, vcpu->name, rc);
+		return rc;
+	}
+
+	return snapshot_write_record(ctx->stream, VMM_SNAPSHOT_RECORD_VCPU,
+				     0, vcpu->subid, ctx->st.buf, ctx->st.len);
+}
+
+static int snapshot_save_emudev(struct vmm_guest *guest,
+				struct vmm_region *reg, void *priv)
+{
+	int rc;
+	struct snapshot_ctx *ctx = priv;
+
+	if (reg->flags & VMM_REGION_ALIAS) {
+		return VMM_OK;
+	}
+
+	ctx->st.len = ctx->st.pos = 0;
+	rc = vmm_devemu_save_region(guest, reg, &ctx->st);
+	if (rc == VMM_ENOTSUPP) {
+		vmm_printf("%s: %s: %s has no snapshot support\n",
+			   __func__, guest->name, reg->node->name);
+		return VMM_OK;
+	} else if (rc == VMM_ENODEV) {
+		return VMM_OK;
+	} else if (rc) {
+		return rc;
+	}
+
+	return snapshot_write_record(ctx->stream, VMM_SNAPSHOT_RECORD_EMUDEV,
+				     ctx->emudev_flags, reg->gphys_addr,
+				     ctx->st.buf, ctx->st.len);
+}
+
+/* Save guest RAM between gpa and end. Zero pages are skipped only if
+ * receiver is known to have them zeroed already (i.e. never sent before).
+ */
+static int snapshot_save_ram_range(struct snapshot_ctx *ctx,
+				   struct vmm_guest *guest,
+				   physical_addr_t gpa, physical_addr_t end,
+				   bool skip_zero)
+{
+	int rc;
+	u32 len, pos, first, plen;
+
+	while (gpa < end) {
+		len = ((end - gpa) < SNAPSHOT_CHUNK_SIZE) ?
+					(end - gpa) : SNAPSHOT_CHUNK_SIZE;
+		if (vmm_guest_memory_read(guest, gpa, ctx->buf,
+					  len, TRUE) != len) {
+			return VMM_EIO;
+		}
+
+		if (!skip_zero) {
+			rc = snapshot_write_record(ctx->stream,
+						   VMM_SNAPSHOT_RECORD_RAM, 0,
+						   gpa, ctx->buf, len);
+			if (rc) {
+				return rc;
+			}
+			ctx->ram_bytes += len;
+			gpa += len;
+			continue;
+		}
+
+		/* Each run of non-zero pages is written as one record */
+		pos = 0;
+		while (pos < len) {
+			plen = ((len - pos) < VMM_PAGE_SIZE) ?
+						(len - pos) : VMM_PAGE_SIZE;
+			if (snapshot_iszero(&ctx->buf[pos], plen)) {
+				pos += plen;
+				continue;
+			}
+			first = pos;
+			while ((pos < len) &&
+			       !snapshot_iszero(&ctx->buf[pos], plen)) {
+				pos += plen;
+				plen = ((len - pos) < VMM_PAGE_SIZE) ?
+						(len - pos) : VMM_PAGE_SIZE;
+			}
+			rc = snapshot_write_record(ctx->stream,
+						   VMM_SNAPSHOT_RECORD_RAM, 0,
+						   gpa + first,
+						   &ctx->buf[first], pos - first);
+			if (rc) {
+				return rc;
+			}
+			ctx->ram_bytes += pos - first;
+		}
+
+		gpa += len;
+	}
+
+	return VMM_OK;
+}
+
+static int snapshot_save_ram(struct vmm_guest *guest,
+			     struct vmm_region *reg, void *priv)
+{
+	if (reg->flags & VMM_REGION_ALIAS) {
+		return VMM_OK;
+	}
+
+	return snapshot_save_ram_range(priv, guest,
+				       VMM_REGION_GPHYS_START(reg),
+				       VMM_REGION_GPHYS_END(reg), TRUE);
+}
+
+/* Save all VCPUs and emulated devices of a Guest */
+static int snapshot_save_devices(struct snapshot_ctx *ctx,
+				 struct vmm_guest *guest)
+{
+	int rc;
+	struct vmm_vcpu *vcpu;
+
+	vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+		rc = snapshot_save_vcpu(ctx, vcpu);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	ctx->emudev_flags = VMM_REGION_MEMORY;
+	rc = vmm_guest_iterate_mem_regions(guest, VMM_REGION_ISDEVICE,
+					   snapshot_save_emudev, ctx);
+	if (rc) {
+		return rc;
+	}
+	ctx->emudev_flags = VMM_REGION_IO;
+
+	return vmm_guest_iterate_io_regions(guest, VMM_REGION_ISDEVICE,
+					    snapshot_save_emudev, ctx);
+}
+
+static int snapshot_write_header(struct vmm_snapshot_stream *stream,
+				 struct vmm_guest *guest)
+{
+	struct vmm_snapshot_header hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.magic = VMM_SNAPSHOT_MAGIC;
+	hdr.version = VMM_SNAPSHOT_VERSION;
+	hdr.vcpu_count = guest->vcpu_count;
+	strlcpy(hdr.guest_name, guest->name, sizeof(hdr.guest_name));
+
+	return snapshot_write(stream, &hdr, sizeof(hdr));
+}
+
+static void snapshot_vcpu_sync_ipi(void *arg0, void *arg1, void *arg2)
+{
+	vmm_completion_complete(arg0);
+}
+
+/* Wait till a paused VCPU is switched out by its host CPU. Async IPIs
+ * are processed by the highest priority IPI bottom-half VCPU hence the
+ * paused VCPU is not running on its host CPU once this IPI is processed.
+ */
+static void snapshot_vcpu_sync(struct vmm_vcpu *vcpu)
+{
+	u32 hcpu;
+	struct vmm_completion done;
+
+	if (vmm_scheduler_get_hcpu(vcpu, &hcpu) ||
+	    (hcpu == vmm_smp_processor_id())) {
+		return;
+	}
+
+	INIT_COMPLETION(&done);
+	vmm_smp_ipi_async_call(vmm_cpumask_of(hcpu),
+			       snapshot_vcpu_sync_ipi, &done, NULL, NULL);
+	vmm_completion_wait(&done);
+}
+
+int vmm_snapshot_guest_save(struct vmm_guest *guest,
+			    struct vmm_snapshot_stream *stream)
+{
+	int rc;
+	u32 state;
+	struct vmm_vcpu *vcpu;
+	struct snapshot_ctx ctx;
+
+	if (!guest || !stream || !stream->write) {
+		return VMM_EINVALID;
+	}
+
+	/* VCPUs must not change their state while we save it */
+	vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+		state = vmm_manager_vcpu_get_state(vcpu);
+		if (!(state & (VMM_VCPU_STATE_RESET |
+			       VMM_VCPU_STATE_PAUSED |
+			       VMM_VCPU_STATE_HALTED))) {
+			return VMM_EBUSY;
+		}
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.stream = stream;
+	ctx.buf = vmm_malloc(SNAPSHOT_CHUNK_SIZE);
+	if (!ctx.buf) {
+		return VMM_ENOMEM;
+	}
+
+	vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+		snapshot_vcpu_sync(vcpu);
+	}
+
+	rc = snapshot_write_header(stream, guest);
+	if (rc) {
+		goto done;
+	}
+
+	rc = snapshot_save_devices(&ctx, guest);
+	if (rc) {
+		goto done;
+	}
+
+	rc = vmm_guest_iterate_mem_regions(guest,
+				VMM_REGION_REAL | VMM_REGION_MEMORY |
+				VMM_REGION_ISRAM, snapshot_save_ram, &ctx);
+	if (rc) {
+		goto done;
+	}
+
+	rc = snapshot_write_record(stream, VMM_SNAPSHOT_RECORD_END,
+				   0, 0, NULL, 0);
+
+done:
+	if (ctx.st.buf) {
+		vmm_free(ctx.st.buf);
+	}
+	vmm_free(ctx.buf);
+	return rc;
+}
+
+/* Guest RAM region tracked by live save */
+struct snapshot_live_ram {
+	physical_addr_t gphys;
+	physical_addr_t end;
+	u32 page_count;
+	bool logged;
+	unsigned long *dirty;
+};
+
+struct snapshot_live_ctx {
+	u32 ram_count;
+	u32 ram_max;
+	u32 page_max;
+	struct snapshot_live_ram *ram;
+	unsigned long *bmap;
+	bool *paused;
+};
+
+static int snapshot_live_count_ram(struct vmm_guest *guest,
+				   struct vmm_region *reg, void *priv)
+{
+	struct snapshot_live_ctx *lctx = priv;
+
+	if (!(reg->flags & VMM_REGION_ALIAS)) {
+		lctx->ram_max++;
+	}
+
+	return VMM_OK;
+}
+
+static int snapshot_live_add_ram(struct vmm_guest *guest,
+				 struct vmm_region *reg, void *priv)
+{
+	int rc;
+	struct snapshot_live_ram *ram;
+	struct snapshot_live_ctx *lctx = priv;
+
+	/* Regions added after counting are sent by stop-and-copy */
+	if ((reg->flags & VMM_REGION_ALIAS) ||
+	    (lctx->ram_max <= lctx->ram_count)) {
+		return VMM_OK;
+	}
+
+	ram = &lctx->ram[lctx->ram_count];
+	ram->gphys = VMM_REGION_GPHYS_START(reg);
+	ram->end = VMM_REGION_GPHYS_END(reg);
+	ram->page_count = VMM_SIZE_TO_PAGE(ram->end - ram->gphys);
+	ram->dirty = vmm_zalloc(bitmap_estimate_size(ram->page_count));
+	if (!ram->dirty) {
+		return VMM_ENOMEM;
+	}
+	lctx->ram_count++;
+
+	/* A range already dirty logged by someone else (such as
+	 * frame buffer of display emulator) is sent only once by
+	 * the final stop-and-copy round.
+	 */
+	rc = vmm_guest_dirty_log_start(guest, ram->gphys,
+				       ram->end - ram->gphys);
+	if (rc) {
+		vmm_printf("%s: %s: no dirty logging for 0x%"PRIPADDR
+			   " (error %d)\n", __func__, guest->name,
+			   ram->gphys, rc);
+		return VMM_OK;
+	}
+	ram->logged = TRUE;
+	if (lctx->page_max < ram->page_count) {
+		lctx->page_max = ram->page_count;
+	}
+
+	return VMM_OK;
+}
+
+/* Accumulate dirty pages of logged RAM and return their count */
+static int snapshot_live_sync_dirty(struct vmm_guest *guest,
+				    struct snapshot_live_ctx *lctx,
+				    u64 *dirty_pages)
+{
+	int rc;
+	u32 i;
+	struct snapshot_live_ram *ram;
+
+	*dirty_pages = 0;
+	for (i = 0; i < lctx->ram_count; i++) {
+		ram = &lctx->ram[i];
+		if (!ram->logged) {
+			continue;
+		}
+		rc = vmm_guest_dirty_log_get(guest, ram->gphys,
+					     lctx->bmap, ram->page_count);
+		if (rc) {
+			return rc;
+		}
+		bitmap_or(ram->dirty, ram->dirty, lctx->bmap,
+			  ram->page_count);
+		*dirty_pages += bitmap_weight(ram->dirty, ram->page_count);
+	}
+
+	return VMM_OK;
+}
+
+/* Send accumulated dirty pages of logged RAM (or complete RAM region
+ * if it is not logged and final is TRUE)
+ */
+static int snapshot_live_send_dirty(struct snapshot_ctx *ctx,
+				    struct vmm_guest *guest,
+				    struct snapshot_live_ctx *lctx,
+				    bool skip_zero, bool final)
+{
+	int rc;
+	u32 i, start, end;
+	struct snapshot_live_ram *ram;
+
+	for (i = 0; i < lctx->ram_count; i++) {
+		ram = &lctx->ram[i];
+		if (!ram->logged) {
+			if (!final) {
+				continue;
+			}
+			rc = snapshot_save_ram_range(ctx, guest, ram->gphys,
+						     ram->end, TRUE);
+			if (rc) {
+				return rc;
+			}
+			continue;
+		}
+
+		start = find_first_bit(ram->dirty, ram->page_count);
+		while (start < ram->page_count) {
+			end = find_next_zero_bit(ram->dirty,
+						 ram->page_count, start);
+			rc = snapshot_save_ram_range(ctx, guest,
+				ram->gphys + ((physical_addr_t)start << VMM_PAGE_SHIFT),
+				ram->gphys + ((physical_addr_t)end << VMM_PAGE_SHIFT),
+				skip_zero);
+			if (rc) {
+				return rc;
+			}
+			start = find_next_bit(ram->dirty,
+					      ram->page_count, end);
+		}
+		bitmap_zero(ram->dirty, ram->page_count);
+	}
+
+	return VMM_OK;
+}
+
+int vmm_snapshot_guest_save_live(struct vmm_guest *guest,
+				 struct vmm_snapshot_stream *stream,
+				 struct vmm_snapshot_live *live)
+{
+	int rc;
+	u32 i, round = 0;
+	u64 dirty_pages, tstamp, elapsed, bytes_per_ms = 0;
+	struct vmm_vcpu *vcpu;
+	struct snapshot_ctx ctx;
+	struct snapshot_live_ctx lctx;
+
+	if (!guest || !stream || !stream->write || !live) {
+		return VMM_EINVALID;
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	memset(&lctx, 0, sizeof(lctx));
+	ctx.stream = stream;
+	ctx.buf = vmm_malloc(SNAPSHOT_CHUNK_SIZE);
+	if (!ctx.buf) {
+		return VMM_ENOMEM;
+	}
+	lctx.paused = vmm_zalloc(guest->vcpu_count * sizeof(*lctx.paused));
+	if (!lctx.paused) {
+		rc = VMM_ENOMEM;
+		goto done;
+	}
+
+	vmm_guest_iterate_mem_regions(guest,
+			VMM_REGION_REAL | VMM_REGION_MEMORY | VMM_REGION_ISRAM,
+			snapshot_live_count_ram, &lctx);
+	if (lctx.ram_max) {
+		lctx.ram = vmm_zalloc(lctx.ram_max * sizeof(*lctx.ram));
+		if (!lctx.ram) {
+			rc = VMM_ENOMEM;
+			goto done;
+		}
+	}
+	rc = vmm_guest_iterate_mem_regions(guest,
+			VMM_REGION_REAL | VMM_REGION_MEMORY | VMM_REGION_ISRAM,
+			snapshot_live_add_ram, &lctx);
+	if (rc) {
+		goto done;
+	}
+	if (lctx.page_max) {
+		lctx.bmap = vmm_malloc(bitmap_estimate_size(lctx.page_max));
+		if (!lctx.bmap) {
+			rc = VMM_ENOMEM;
+			goto done;
+		}
+	}
+
+	rc = snapshot_write_header(stream, guest);
+	if (rc) {
+		goto done;
+	}
+
+	/* Pre-copy rounds while Guest is running. First round sends
+	 * all non-zero pages and each later round sends pages dirtied
+	 * while previous round was being sent.
+	 */
+	while (1) {
+		rc = snapshot_live_sync_dirty(guest, &lctx, &dirty_pages);
+		if (rc) {
+			goto done;
+		}
+		if (round && ((live->max_rounds <= round) ||
+		    ((dirty_pages << VMM_PAGE_SHIFT) <=
+				(bytes_per_ms * live->downtime_ms)))) {
+			break;
+		}
+		if (!round && !live->max_rounds) {
+			break;
+		}
+
+		tstamp = vmm_timer_timestamp();
+		ctx.ram_bytes = 0;
+		rc = snapshot_live_send_dirty(&ctx, guest, &lctx,
+					      (round) ? FALSE : TRUE, FALSE);
+		if (rc) {
+			goto done;
+		}
+		elapsed = vmm_timer_timestamp() - tstamp;
+		bytes_per_ms = (elapsed) ?
+			udiv64(ctx.ram_bytes * 1000000ULL, elapsed) : 0;
+		round++;
+	}
+
+	/* Stop-and-copy round */
+	tstamp = vmm_timer_timestamp();
+	vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+		if (!(vmm_manager_vcpu_get_state(vcpu) &
+		      (VMM_VCPU_STATE_READY | VMM_VCPU_STATE_RUNNING))) {
+			continue;
+		}
+		rc = vmm_manager_vcpu_pause(vcpu);
+		if (rc) {
+			goto done;
+		}
+		lctx.paused[vcpu->subid] = TRUE;
+	}
+	vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+		snapshot_vcpu_sync(vcpu);
+	}
+
+	rc = snapshot_live_sync_dirty(guest, &lctx, &dirty_pages);
+	if (rc) {
+		goto done;
+	}
+	rc = snapshot_live_send_dirty(&ctx, guest, &lctx,
+				      (round) ? FALSE : TRUE, TRUE);
+	if (rc) {
+		goto done;
+	}
+
+	rc = snapshot_save_devices(&ctx, guest);
+	if (rc) {
+		goto done;
+	}
+
+	rc = snapshot_write_record(stream, VMM_SNAPSHOT_RECORD_END,
+				   0, 0, NULL, 0);
+	if (rc) {
+		goto done;
+	}
+
+	live->rounds = round;
+	live->downtime_ns = vmm_timer_timestamp() - tstamp;
+
+done:
+	/* Guest keeps running here if live save failed */
+	if (rc && lctx.paused) {
+		vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+			if (lctx.paused[vcpu->subid]) {
+				vmm_manager_vcpu_resume(vcpu);
+			}
+		}
+	}
+	for (i = 0; i < lctx.ram_count; i++) {
+		if (lctx.ram[i].logged) {
+			vmm_guest_dirty_log_stop(guest, lctx.ram[i].gphys);
+		}
+		vmm_free(lctx.ram[i].dirty);
+	}
+	if (lctx.ram) {
+		vmm_free(lctx.ram);
+	}
+	if (lctx.bmap) {
+		vmm_free(lctx.bmap);
+	}
+	if (lctx.paused) {
+		vmm_free(lctx.paused);
+	}
+	if (ctx.st.buf) {
+		vmm_free(ctx.st.buf);
+	}
+	vmm_free(ctx.buf);
+	return rc;
+}
+
+static int snapshot_zero_ram(struct vmm_guest *guest,
+			     struct vmm_region *reg, void *priv)
+{
+	u32 len;
+	physical_addr_t hpa, end;
+
+	if (reg->flags & VMM_REGION_ALIAS) {
+		return VMM_OK;
+	}
+
+	hpa = VMM_REGION_HPHYS_START(reg);
+	end = VMM_REGION_HPHYS_END(reg);
+	while (hpa < end) {
+		len = ((end - hpa) < SNAPSHOT_CHUNK_SIZE) ?
+					(end - hpa) : SNAPSHOT_CHUNK_SIZE;
+		if (vmm_host_memory_set(hpa, 0, len, TRUE) != len) {
+			return VMM_EIO;
+		}
+		hpa += len;
+	}
+
+	return VMM_OK;
+}
+
+static int snapshot_restore_vcpu(struct snapshot_ctx *ctx,
+				 struct vmm_guest *guest,
+				 struct vmm_snapshot_record *rec,
+				 bool *kick)
+{
+	int rc;
+	u32 state;
+	struct vmm_vcpu *vcpu;
+
+	vcpu = vmm_manager_guest_vcpu(guest, rec->addr);
+	if (!vcpu) {
+		return VMM_EINVALID;
+	}
+
+	rc = snapshot_read_state(ctx, rec->len);
+	if (rc) {
+		return rc;
+	}
+
+	rc = vmm_snapshot_get_var(&ctx->st, state);
+	if (rc) {
+		return rc;
+	}
+
+	rc = arch_vcpu_state_restore(vcpu, &ctx->st);
+	if (rc) {
+		vmm_printf("%s: %s: arch state restore failed (error %d)\n",
+			   __func__, vcpu->name, rc);
+		return rc;
+	}
+
+	kick[vcpu->subid] = (state != VMM_VCPU_STATE_RESET) ? TRUE : FALSE;
+
+	return VMM_OK;
+}
+
+static int snapshot_restore_emudev(struct snapshot_ctx *ctx,
+				   struct vmm_guest *guest,
+				   struct vmm_snapshot_record *rec)
+{
+	int rc;
+	u32 flags = VMM_REGION_ISDEVICE;
+	struct vmm_region *reg;
+
+	flags |= (rec->flags & VMM_REGION_IO) ?
+				VMM_REGION_IO : VMM_REGION_MEMORY;
+	reg = vmm_guest_find_region(guest, rec->addr, flags, FALSE);
+	if (!reg || (reg->gphys_addr != rec->addr)) {
+		return VMM_EINVALID;
+	}
+
+	rc = snapshot_read_state(ctx, rec->len);
+	if (rc) {
+		return rc;
+	}
+
+	rc = vmm_devemu_restore_region(guest, reg, &ctx->st);
+	if (rc == VMM_ENOTSUPP) {
+		vmm_printf("%s: %s: %s has no snapshot support\n",
+			   __func__, guest->name, reg->node->name);
+		return VMM_OK;
+	}
+
+	return rc;
+}
+
+static int snapshot_restore_ram(struct snapshot_ctx *ctx,
+				struct vmm_guest *guest,
+				struct vmm_snapshot_record *rec)
+{
+	int rc;
+	u32 len;
+	u64 done = 0;
+
+	while (done < rec->len) {
+		len = ((rec->len - done) < SNAPSHOT_CHUNK_SIZE) ?
+				(rec->len - done) : SNAPSHOT_CHUNK_SIZE;
+		rc = snapshot_read(ctx->stream, ctx->buf, len);
+		if (rc) {
+			return rc;
+		}
+		if (vmm_guest_memory_write(guest, rec->addr + done,
+					   ctx->buf, len, TRUE) != len) {
+			return VMM_EINVALID;
+		}
+		done += len;
+	}
+
+	return VMM_OK;
+}
+
+int vmm_snapshot_guest_restore(struct vmm_guest *guest,
+			       struct vmm_snapshot_stream *stream)
+{
+	int rc;
+	bool *kick;
+	struct vmm_vcpu *vcpu;
+	struct snapshot_ctx ctx;
+	struct vmm_snapshot_header hdr;
+	struct vmm_snapshot_record rec;
+
+	if (!guest || !stream || !stream->read) {
+		return VMM_EINVALID;
+	}
+
+	/* Restore only into a Guest which is not running */
+	vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+		if (vmm_manager_vcpu_get_state(vcpu) !=
+						VMM_VCPU_STATE_RESET) {
+			return VMM_EBUSY;
+		}
+	}
+
+	rc = snapshot_read(stream, &hdr, sizeof(hdr));
+	if (rc) {
+		return rc;
+	}
+	if ((hdr.magic != VMM_SNAPSHOT_MAGIC) ||
+	    (hdr.version != VMM_SNAPSHOT_VERSION) ||
+	    (hdr.vcpu_count != guest->vcpu_count)) {
+		return VMM_EINVALID;
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	ctx.stream = stream;
+	ctx.buf = vmm_malloc(SNAPSHOT_CHUNK_SIZE);
+	if (!ctx.buf) {
+		return VMM_ENOMEM;
+	}
+	kick = vmm_zalloc(guest->vcpu_count * sizeof(*kick));
+	if (!kick) {
+		rc = VMM_ENOMEM;
+		goto done;
+	}
+
+	/* Guest RAM not found in snapshot is zero */
+	rc = vmm_guest_iterate_mem_regions(guest,
+				VMM_REGION_REAL | VMM_REGION_MEMORY |
+				VMM_REGION_ISRAM, snapshot_zero_ram, NULL);
+	if (rc) {
+		goto done;
+	}
+
+	while (1) {
+		rc = snapshot_read(stream, &rec, sizeof(rec));
+		if (rc) {
+			goto done;
+		}
+
+		switch (rec.type) {
+		case VMM_SNAPSHOT_RECORD_END:
+			goto kick_vcpus;
+		case VMM_SNAPSHOT_RECORD_VCPU:
+			rc = snapshot_restore_vcpu(&ctx, guest, &rec, kick);
+			break;
+		case VMM_SNAPSHOT_RECORD_EMUDEV:
+			rc = snapshot_restore_emudev(&ctx, guest, &rec);
+			break;
+		case VMM_SNAPSHOT_RECORD_RAM:
+			rc = snapshot_restore_ram(&ctx, guest, &rec);
+			break;
+		default:
+			rc = VMM_EINVALID;
+			break;
+		}
+		if (rc) {
+			goto done;
+		}
+	}
+
+kick_vcpus:
+	vmm_manager_for_each_guest_vcpu(vcpu, guest) {
+		if (!kick[vcpu->subid]) {
+			continue;
+		}
+		rc = vmm_manager_vcpu_kick(vcpu);
+		if (rc) {
+			goto done;
+		}
+	}
+
+done:
+	if (kick) {
+		vmm_free(kick);
+	}
+	if (ctx.st.buf) {
+		vmm_free(ctx.st.buf);
+	}
+	vmm_free(ctx.buf);
+	return rc;
+}
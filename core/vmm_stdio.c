@@ -27,7 +27,13 @@
 #include <vmm_chardev.h>
 #include <vmm_spinlocks.h>
 #include <vmm_stdio.h>
+#include <vmm_smp.h>
+#include <vmm_mutex.h>
+#include <vmm_threads.h>
+#include <vmm_delay.h>
 #include <arch_atomic.h>
+#include <arch_barrier.h>
+#include <arch_cpu_irq.h>
 #include <arch_defterm.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
@@ -187,13 +193,13 @@ static void printc(char **out, u32 *out_len, struct vmm_chardev *cdev, char ch)
 {
 	if (out) {
 		if (*out) {
-			if (out_len && (0 < *out_len)) {
+			if (!out_len) {
 				**out = ch;
 				++(*out);
-				(*out_len)--;
-			} else {
+			} else if (0 < *out_len) {
 				**out = ch;
 				++(*out);
+				(*out_len)--;
 			}
 		}
 	} else {
@@ -462,15 +468,223 @@ int vmm_snprintf(char *out, u32 out_sz, const char *format, ...)
 {
 	va_list args;
 	int retval;
+	/* Keep space for terminating NULL character */
+	if (out_sz) {
+		out_sz--;
+	}
 	va_start(args, format);
 	retval = print(&out, &out_sz, stdio_ctrl.dev, format, args);
 	va_end(args);
 	return retval;
 }
 
+#ifdef CONFIG_LOG_ASYNC
+
+#define LOG_BUF_SZ	CONFIG_LOG_ASYNC_BUFFER_SIZE
+#define LOG_LINE_LEN	256
+
+/*
+ * Per-CPU log ring. Only the owner CPU moves head (with local
+ * interrupts disabled) and only the drainer moves tail hence
+ * queuing a message needs no locks or atomics.
+ */
+struct vmm_stdio_logbuf {
+	u32 head;
+	u32 tail;
+	u32 lost;
+	u32 lost_seen;
+	char buf[LOG_BUF_SZ];
+};
+
+static struct vmm_stdio_logbuf stdio_logbufs[CONFIG_CPU_COUNT];
+static DEFINE_MUTEX(stdio_drain_lock);
+static struct vmm_thread *stdio_drain_thread = NULL;
+static bool stdio_async = FALSE;
+
+static void stdio_log_queue(const char *str, u32 len)
+{
+	irq_flags_t flags;
+	u32 i, head, used, need = len;
+	struct vmm_stdio_logbuf *lb;
+
+	/* Newlines are stored as "\r\n" same as vmm_cputc() */
+	for (i = 0; i < len; i++) {
+		if (str[i] == '\n') {
+			need++;
+		}
+	}
+
+	arch_cpu_irq_save(flags);
+
+	lb = &stdio_logbufs[vmm_smp_processor_id()];
+	head = lb->head;
+	used = (head + LOG_BUF_SZ - lb->tail) % LOG_BUF_SZ;
+	arch_smp_mb();
+	if ((LOG_BUF_SZ - 1 - used) < need) {
+		lb->lost += len;
+		goto done;
+	}
+
+	for (i = 0; i < len; i++) {
+		if (str[i] == '\n') {
+			lb->buf[head] = '\r';
+			head = (head + 1) % LOG_BUF_SZ;
+		}
+		lb->buf[head] = str[i];
+		head = (head + 1) % LOG_BUF_SZ;
+	}
+
+	/* Characters must be visible before the new head */
+	arch_smp_wmb();
+	lb->head = head;
+
+done:
+	arch_cpu_irq_restore(flags);
+}
+
+static void stdio_log_drain(struct vmm_chardev *cdev)
+{
+	int len;
+	char msg[64];
+	u32 cpu, head, tail, lost;
+	struct vmm_stdio_logbuf *lb;
+
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		lb = &stdio_logbufs[cpu];
+
+		head = lb->head;
+		arch_smp_rmb();
+		tail = lb->tail;
+		while (tail != head) {
+			len = (tail < head) ? (head - tail) : (LOG_BUF_SZ - tail);
+			vmm_printchars(cdev, &lb->buf[tail], len, TRUE);
+			tail = (tail + len) % LOG_BUF_SZ;
+		}
+		arch_smp_mb();
+		lb->tail = tail;
+
+		lost = lb->lost;
+		if (lost != lb->lost_seen) {
+			len = vmm_snprintf(msg, sizeof(msg),
+				"\r\n*** vmm_stdio: CPU%d dropped %d chars\r\n",
+				cpu, lost - lb->lost_seen);
+			vmm_printchars(cdev, msg, len, TRUE);
+			lb->lost_seen = lost;
+		}
+	}
+}
+
+/*
+ * Switch to synchronous printing and flush queued messages. This is
+ * used by emergency and panic paths which may run in any context so
+ * it does not wait for drain thread (duplicate output is harmless).
+ */
+static void stdio_log_sync(void)
+{
+	if (!stdio_async) {
+		return;
+	}
+
+	stdio_async = FALSE;
+	arch_smp_mb();
+	stdio_log_drain(stdio_ctrl.dev);
+}
+
+static int stdio_log_vqueue(const char *hdr, const char *prefix,
+			    const char *format, va_list args)
+{
+	int len = 0, pc;
+	u32 out_len;
+	va_list aq;
+	char line[LOG_LINE_LEN], *out;
+
+	if (hdr) {
+		len = vmm_snprintf(line, sizeof(line), "%s%s %s%s",
+				   hdr, VMM_LOG_COLOR_RESET,
+				   (prefix) ? prefix : "",
+				   (prefix) ? ": " : "");
+		if (len >= sizeof(line)) {
+			len = sizeof(line) - 1;
+		}
+	}
+
+	out = &line[len];
+	out_len = sizeof(line) - 1 - len;
+	va_copy(aq, args);
+	pc = print(&out, &out_len, NULL, format, aq);
+	va_end(aq);
+
+	if (pc > (sizeof(line) - 1 - len)) {
+		/* Too long for one log record so print synchronously */
+		if (len) {
+			line[len] = '\0';
+			vmm_cputs(stdio_ctrl.dev, line);
+		}
+		return len + print(NULL, NULL, stdio_ctrl.dev, format, args);
+	}
+
+	stdio_log_queue(line, len + pc);
+
+	return len + pc;
+}
+
+static int stdio_drain_main(void *data)
+{
+	while (1) {
+		vmm_mutex_lock(&stdio_drain_lock);
+		if (stdio_async) {
+			stdio_log_drain(stdio_ctrl.dev);
+		}
+		vmm_mutex_unlock(&stdio_drain_lock);
+
+		vmm_msleep(CONFIG_LOG_ASYNC_DRAIN_MSECS);
+	}
+
+	return VMM_OK;
+}
+
+int __init vmm_stdio_async_init(void)
+{
+	int rc;
+
+	stdio_drain_thread = vmm_threads_create("stdio", stdio_drain_main,
+						NULL, VMM_THREAD_DEF_PRIORITY,
+						VMM_THREAD_DEF_TIME_SLICE);
+	if (!stdio_drain_thread) {
+		return VMM_EFAIL;
+	}
+
+	rc = vmm_threads_start(stdio_drain_thread);
+	if (rc) {
+		vmm_threads_destroy(stdio_drain_thread);
+		stdio_drain_thread = NULL;
+		return rc;
+	}
+
+	arch_smp_mb();
+	stdio_async = TRUE;
+
+	return VMM_OK;
+}
+
+#else
+
+int __init vmm_stdio_async_init(void)
+{
+	return VMM_OK;
+}
+
+#endif
+
 static int vmm_cvprintf(struct vmm_chardev *cdev,
 			const char *format, va_list args)
 {
+#ifdef CONFIG_LOG_ASYNC
+	if (!cdev && stdio_async) {
+		return stdio_log_vqueue(NULL, NULL, format, args);
+	}
+#endif
+
 	return print(NULL, NULL, (cdev) ? cdev : stdio_ctrl.dev, format, args);
 }
 
@@ -491,6 +705,14 @@ static int vmm_lvprintf(enum vmm_print_level level,
 	struct vmm_chardev *const cdev = stdio_ctrl.dev;
 
 	if (vmm_stdio_loglevel() >= level) {
+#ifdef CONFIG_LOG_ASYNC
+		if (level == VMM_LOGLEVEL_EMERGENCY) {
+			stdio_log_sync();
+		} else if (stdio_async) {
+			return stdio_log_vqueue(_log_prefixes[level],
+						prefix, format, args);
+		}
+#endif
 		retval = vmm_cprintf(cdev, "%s%s %s%s",
 				     _log_prefixes[level],
 				     VMM_LOG_COLOR_RESET,
@@ -516,6 +738,9 @@ void __noreturn __vmm_panic(const char *format, ...)
 {
 	va_list args;
 
+#ifdef CONFIG_LOG_ASYNC
+	stdio_log_sync();
+#endif
 	va_start(args, format);
 	vmm_lvprintf(VMM_LOGLEVEL_EMERGENCY, NULL, format, args);
 	va_end(args);
@@ -771,10 +996,22 @@ int vmm_stdio_change_device(struct vmm_chardev *cdev)
 		return VMM_EFAIL;
 	}
 
+#ifdef CONFIG_LOG_ASYNC
+	/* Queued messages go to the old device */
+	vmm_mutex_lock(&stdio_drain_lock);
+	if (stdio_async) {
+		stdio_log_drain(stdio_ctrl.dev);
+	}
+#endif
+
 	vmm_spin_lock(&stdio_ctrl.lock);
 	stdio_ctrl.dev = cdev;
 	vmm_spin_unlock(&stdio_ctrl.lock);
 
+#ifdef CONFIG_LOG_ASYNC
+	vmm_mutex_unlock(&stdio_drain_lock);
+#endif
+
 	return VMM_OK;
 }
 
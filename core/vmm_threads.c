@@ -288,13 +288,14 @@ static void vmm_threads_entry(void)
 	vmm_hang();
 }
 
-struct vmm_thread *vmm_threads_create_rt(const char *thread_name,
+static struct vmm_thread *threads_create(const char *thread_name,
 					 int (*thread_fn) (void *udata),
 					 void *thread_data,
 					 u8 thread_priority,
-				         u64 thread_nsecs,
+					 u64 thread_nsecs,
 					 u64 thread_deadline,
-					 u64 thread_periodicity)
+					 u64 thread_periodicity,
+					 bool is_deadline)
 {
 	irq_flags_t flags;
 	struct vmm_thread *tinfo;
@@ -328,7 +329,8 @@ struct vmm_thread *vmm_threads_create_rt(const char *thread_name,
 	tinfo->tvcpu = vmm_manager_vcpu_orphan_create(thread_name,
 			(virtual_addr_t)&vmm_threads_entry,
 			CONFIG_THREAD_STACK_SIZE, thread_priority,
-			thread_nsecs, thread_deadline, thread_periodicity);
+			thread_nsecs, thread_deadline, thread_periodicity,
+			is_deadline);
 	if (!tinfo->tvcpu) {
 		vmm_free(tinfo);
 		return NULL;
@@ -346,6 +348,32 @@ struct vmm_thread *vmm_threads_create_rt(const char *thread_name,
 	return tinfo;
 }
 
+struct vmm_thread *vmm_threads_create_rt(const char *thread_name,
+					 int (*thread_fn) (void *udata),
+					 void *thread_data,
+					 u8 thread_priority,
+				         u64 thread_nsecs,
+					 u64 thread_deadline,
+					 u64 thread_periodicity)
+{
+	return threads_create(thread_name, thread_fn, thread_data,
+			      thread_priority, thread_nsecs,
+			      thread_deadline, thread_periodicity, FALSE);
+}
+
+struct vmm_thread *vmm_threads_create_deadline(const char *thread_name,
+					int (*thread_fn) (void *udata),
+					void *thread_data,
+					u8 thread_priority,
+					u64 thread_budget,
+					u64 thread_deadline,
+					u64 thread_periodicity)
+{
+	return threads_create(thread_name, thread_fn, thread_data,
+			      thread_priority, thread_budget,
+			      thread_deadline, thread_periodicity, TRUE);
+}
+
 int vmm_threads_destroy(struct vmm_thread *tinfo)
 {
 	int rc = VMM_OK;
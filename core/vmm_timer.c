@@ -29,6 +29,7 @@
 #include <vmm_clocksource.h>
 #include <vmm_clockchip.h>
 #include <vmm_timer.h>
+#include <vmm_trace.h>
 #include <arch_cpu_irq.h>
 #include <libs/stringlib.h>
 
@@ -38,15 +39,152 @@ struct vmm_timer_local_ctrl {
 	struct vmm_clockchip *cc;
 	bool started;
 	bool inprocess;
+	bool armed;
 	u64 next_event;
 	struct vmm_timer_event *curr;
 	vmm_rwlock_t event_list_lock;
+#if defined(CONFIG_TIMER_EVENT_RBTREE)
+	struct rb_root event_root;
+	struct rb_node *event_leftmost;
+#else
 	struct dlist event_list;
+#endif
 };
 
 static DEFINE_PER_CPU(struct vmm_timer_local_ctrl, tlc);
 
-#if defined(CONFIG_PROFILE)
+/*
+ * Active timer event queue helpers
+ *
+ * Note: All helpers must be called with tlcp->event_list_lock held.
+ */
+
+#if defined(CONFIG_TIMER_EVENT_RBTREE)
+
+static inline void __timer_queue_init(struct vmm_timer_local_ctrl *tlcp)
+{
+	tlcp->event_root = RB_ROOT;
+	tlcp->event_leftmost = NULL;
+}
+
+static inline struct vmm_timer_event *__timer_queue_first(
+					struct vmm_timer_local_ctrl *tlcp)
+{
+	if (!tlcp->event_leftmost) {
+		return NULL;
+	}
+
+	return rb_entry(tlcp->event_leftmost,
+			struct vmm_timer_event, active_rb);
+}
+
+static inline struct vmm_timer_event *__timer_queue_next(
+					struct vmm_timer_local_ctrl *tlcp,
+					struct vmm_timer_event *ev)
+{
+	struct rb_node *n = rb_next(&ev->active_rb);
+
+	return (n) ? rb_entry(n, struct vmm_timer_event, active_rb) : NULL;
+}
+
+static void __timer_queue_add(struct vmm_timer_local_ctrl *tlcp,
+			      struct vmm_timer_event *ev)
+{
+	bool leftmost = TRUE;
+	struct vmm_timer_event *e;
+	struct rb_node **new = &tlcp->event_root.rb_node, *parent = NULL;
+
+	/* Events with same expiry are kept in insertion order */
+	while (*new) {
+		parent = *new;
+		e = rb_entry(parent, struct vmm_timer_event, active_rb);
+		if (ev->expiry_tstamp < e->expiry_tstamp) {
+			new = &parent->rb_left;
+		} else {
+			new = &parent->rb_right;
+			leftmost = FALSE;
+		}
+	}
+
+	if (leftmost) {
+		tlcp->event_leftmost = &ev->active_rb;
+	}
+
+	rb_link_node(&ev->active_rb, parent, new);
+	rb_insert_color(&ev->active_rb, &tlcp->event_root);
+}
+
+static void __timer_queue_del(struct vmm_timer_local_ctrl *tlcp,
+			      struct vmm_timer_event *ev)
+{
+	if (tlcp->event_leftmost == &ev->active_rb) {
+		tlcp->event_leftmost = rb_next(&ev->active_rb);
+	}
+
+	rb_erase(&ev->active_rb, &tlcp->event_root);
+	RB_CLEAR_NODE(&ev->active_rb);
+}
+
+#else
+
+static inline void __timer_queue_init(struct vmm_timer_local_ctrl *tlcp)
+{
+	INIT_LIST_HEAD(&tlcp->event_list);
+}
+
+static inline struct vmm_timer_event *__timer_queue_first(
+					struct vmm_timer_local_ctrl *tlcp)
+{
+	if (list_empty(&tlcp->event_list)) {
+		return NULL;
+	}
+
+	return list_entry(list_first(&tlcp->event_list),
+			  struct vmm_timer_event, active_head);
+}
+
+static inline struct vmm_timer_event *__timer_queue_next(
+					struct vmm_timer_local_ctrl *tlcp,
+					struct vmm_timer_event *ev)
+{
+	if (list_is_last(&ev->active_head, &tlcp->event_list)) {
+		return NULL;
+	}
+
+	return list_entry(ev->active_head.next,
+			  struct vmm_timer_event, active_head);
+}
+
+static void __timer_queue_add(struct vmm_timer_local_ctrl *tlcp,
+			      struct vmm_timer_event *ev)
+{
+	bool found_pos = FALSE;
+	struct vmm_timer_event *e = NULL;
+
+	list_for_each_entry(e, &tlcp->event_list, active_head) {
+		if (ev->expiry_tstamp < e->expiry_tstamp) {
+			found_pos = TRUE;
+			break;
+		}
+	}
+
+	if (!found_pos) {
+		list_add_tail(&ev->active_head, &tlcp->event_list);
+	} else {
+		list_add_tail(&ev->active_head, &e->active_head);
+	}
+}
+
+static void __timer_queue_del(struct vmm_timer_local_ctrl *tlcp,
+			      struct vmm_timer_event *ev)
+{
+	list_del(&ev->active_head);
+}
+
+#endif
+
+#if defined(CONFIG_PROFILE) || defined(CONFIG_HOST_IRQ_STATS) || \
+    defined(CONFIG_VCPU_EXIT_STATS) || defined(CONFIG_LOCKSTAT)
 u64 __notrace vmm_timer_timestamp_for_profile(void)
 {
 	return vmm_timecounter_read_for_profile(&this_cpu(tlc).tc);
@@ -58,6 +196,15 @@ u64 vmm_timer_timestamp(void)
 	u64 ret;
 	irq_flags_t flags;
 
+	/* Fast path: Lockless read of timecounter which can be done
+	 * even if we migrate to other CPU because timecounters of
+	 * all CPUs use same clocksource.
+	 */
+	if (likely(vmm_timecounter_read_lockless(&this_cpu(tlc).tc, &ret))) {
+		return ret;
+	}
+
+	/* Slow path: Update timecounter of current CPU */
 	arch_cpu_irq_save(flags);
 	ret = vmm_timecounter_read(&this_cpu(tlc).tc);
 	arch_cpu_irq_restore(flags);
@@ -68,37 +215,74 @@ u64 vmm_timer_timestamp(void)
 /* Note: This function must be called with tlcp->event_list_lock held. */
 static void __timer_schedule_next_event(struct vmm_timer_local_ctrl *tlcp)
 {
-	u64 tstamp;
-	struct vmm_timer_event *e;
+	u64 tstamp, target, deadline;
+	struct vmm_timer_event *e, *n;
 
 	/* If not started yet or still processing events then we give up */
 	if ((tlcp->started == FALSE) || (tlcp->inprocess == TRUE)) {
 		return;
 	}
 
-	/* If no events, we give up */
-	if (list_empty(&tlcp->event_list)) {
+	/* Retrieve first event from active events, if none we give up */
+	e = __timer_queue_first(tlcp);
+	if (!e) {
 		return;
 	}
 
-	/* Retrieve first event from list of active events */
-	e = list_entry(list_first(&tlcp->event_list), 
-		       struct vmm_timer_event,
-		       active_head);
+	/* Coalesce following events which can be served by the same
+	 * interrupt without exceeding slack of any coalesced event.
+	 */
+	target = e->expiry_tstamp;
+	deadline = e->expiry_tstamp + e->slack_nsecs;
+	for (n = __timer_queue_next(tlcp, e);
+	     n && (n->expiry_tstamp <= deadline);
+	     n = __timer_queue_next(tlcp, n)) {
+		target = n->expiry_tstamp;
+		if ((n->expiry_tstamp + n->slack_nsecs) < deadline) {
+			deadline = n->expiry_tstamp + n->slack_nsecs;
+		}
+	}
 
 	/* Configure clockevent device for first event */
 	tlcp->curr = e;
+
+	/* Already armed interrupt serves first event within its slack */
+	if (tlcp->armed &&
+	    (e->expiry_tstamp <= tlcp->next_event) &&
+	    (tlcp->next_event <= deadline)) {
+		return;
+	}
+
 	tstamp = vmm_timer_timestamp();
-	if (tstamp < e->expiry_tstamp) {
-		tlcp->next_event = e->expiry_tstamp;
-		vmm_clockchip_program_event(tlcp->cc, 
-				    tstamp, e->expiry_tstamp);
+	tlcp->armed = TRUE;
+	if (tstamp < target) {
+		tlcp->next_event = target;
+		vmm_clockchip_program_event(tlcp->cc, tstamp, target);
 	} else {
 		tlcp->next_event = tstamp;
 		vmm_clockchip_program_event(tlcp->cc, tstamp, tstamp);
 	}
 }
 
+/* Note: This function must be called with ev->active_lock held. */
+static void __timer_event_forward(struct vmm_timer_event *ev, u64 tstamp)
+{
+	irq_flags_t flags;
+	struct vmm_timer_local_ctrl *tlcp = &per_cpu(tlc, ev->active_hcpu);
+
+	vmm_write_lock_irqsave_lite(&tlcp->event_list_lock, flags);
+
+	/* Keep periodic event in phase unless we missed whole periods */
+	__timer_queue_del(tlcp, ev);
+	ev->expiry_tstamp += ev->period_nsecs;
+	if (ev->expiry_tstamp <= tstamp) {
+		ev->expiry_tstamp = tstamp + ev->period_nsecs;
+	}
+	__timer_queue_add(tlcp, ev);
+
+	vmm_write_unlock_irqrestore_lite(&tlcp->event_list_lock, flags);
+}
+
 /* Note: This function must be called with ev->active_lock held. */
 static void __timer_event_stop(struct vmm_timer_event *ev)
 {
@@ -114,7 +298,7 @@ static void __timer_event_stop(struct vmm_timer_event *ev)
 	vmm_write_lock_irqsave_lite(&tlcp->event_list_lock, flags);
 
 	ev->active_state = FALSE;
-	list_del(&ev->active_head);
+	__timer_queue_del(tlcp, ev);
 	ev->expiry_tstamp = 0;
 
 	vmm_write_unlock_irqrestore_lite(&tlcp->event_list_lock, flags);
@@ -125,29 +309,48 @@ static void __timer_event_stop(struct vmm_timer_event *ev)
  */
 static void timer_clockchip_event_handler(struct vmm_clockchip *cc)
 {
+	u64 tstamp;
+#ifdef CONFIG_TRACE
+	u64 expiry;
+#endif
 	irq_flags_t flags, flags1;
 	struct vmm_timer_event *e;
 	struct vmm_timer_local_ctrl *tlcp = &this_cpu(tlc);
 
+	/* Keep timecounter fresh for lockless timestamp reads */
+	vmm_timecounter_read(&tlcp->tc);
+
 	vmm_read_lock_irqsave_lite(&tlcp->event_list_lock, flags);
 
 	tlcp->inprocess = TRUE;
+	tlcp->armed = FALSE;
 
 	/* Process expired active events */
-	while (!list_empty(&tlcp->event_list)) {
-		e = list_entry(list_first(&tlcp->event_list),
-			       struct vmm_timer_event, active_head);
+	while ((e = __timer_queue_first(tlcp))) {
 		/* Current timestamp */
-		if (e->expiry_tstamp <= vmm_timer_timestamp()) {
+		tstamp = vmm_timer_timestamp();
+		if (e->expiry_tstamp <= tstamp) {
 			/* Unlock event list for processing expired event */
 			vmm_read_unlock_irqrestore_lite(&tlcp->event_list_lock, flags);
 			/* Set current CPU event to NULL */
 			tlcp->curr = NULL;
-			/* Stop expired active event */
+			/* Stop expired active event or re-arm it
+			 * in-place if it is periodic
+			 */
 			vmm_spin_lock_irqsave_lite(&e->active_lock, flags1);
-			__timer_event_stop(e);
+#ifdef CONFIG_TRACE
+			/* Expiry is cleared upon stop hence traced from here */
+			expiry = e->expiry_tstamp;
+#endif
+			if (e->period_nsecs) {
+				__timer_event_forward(e, tstamp);
+			} else {
+				__timer_event_stop(e);
+			}
 			vmm_spin_unlock_irqrestore_lite(&e->active_lock, flags1);
 			/* Call event handler */
+			vmm_trace(TIMER_EXPIRE, (virtual_addr_t)e,
+				  (virtual_addr_t)e->handler, expiry, 0);
 			e->handler(e);
 			/* Lock back event list */
 			vmm_read_lock_irqsave_lite(&tlcp->event_list_lock, flags);
@@ -197,13 +400,12 @@ u64 vmm_timer_event_expiry_time(struct vmm_timer_event *ev)
 	return exp_time;
 }
 
-int vmm_timer_event_start(struct vmm_timer_event *ev, u64 duration_nsecs)
+static int __timer_event_start(struct vmm_timer_event *ev,
+			       u64 duration_nsecs, u64 period_nsecs)
 {
 	u32 hcpu;
 	u64 tstamp;
-	bool found_pos = FALSE;
 	irq_flags_t flags, flags1;
-	struct vmm_timer_event *e = NULL;
 	struct vmm_timer_local_ctrl *tlcp;
 
 	if (!ev) {
@@ -220,23 +422,13 @@ int vmm_timer_event_start(struct vmm_timer_event *ev, u64 duration_nsecs)
 
 	ev->expiry_tstamp = tstamp + duration_nsecs;
 	ev->duration_nsecs = duration_nsecs;
+	ev->period_nsecs = period_nsecs;
 	ev->active_state = TRUE;
 	ev->active_hcpu = hcpu;
 
 	vmm_write_lock_irqsave_lite(&tlcp->event_list_lock, flags1);
 
-	list_for_each_entry(e, &tlcp->event_list, active_head) {
-		if (ev->expiry_tstamp < e->expiry_tstamp) {
-			found_pos = TRUE;
-			break;
-		}
-	}
-
-	if (!found_pos) {
-		list_add_tail(&ev->active_head, &tlcp->event_list);
-	} else {
-		list_add_tail(&ev->active_head, &e->active_head);
-	}
+	__timer_queue_add(tlcp, ev);
 
 	__timer_schedule_next_event(tlcp);
 
@@ -247,13 +439,28 @@ int vmm_timer_event_start(struct vmm_timer_event *ev, u64 duration_nsecs)
 	return VMM_OK;
 }
 
+int vmm_timer_event_start(struct vmm_timer_event *ev, u64 duration_nsecs)
+{
+	return __timer_event_start(ev, duration_nsecs, 0);
+}
+
+int vmm_timer_event_start_periodic(struct vmm_timer_event *ev,
+				   u64 duration_nsecs, u64 period_nsecs)
+{
+	if (!period_nsecs) {
+		return VMM_EINVALID;
+	}
+
+	return __timer_event_start(ev, duration_nsecs, period_nsecs);
+}
+
 int vmm_timer_event_restart(struct vmm_timer_event *ev)
 {
 	if (!ev) {
 		return VMM_EFAIL;
 	}
 
-	return vmm_timer_event_start(ev, ev->duration_nsecs);
+	return __timer_event_start(ev, ev->duration_nsecs, ev->period_nsecs);
 }
 
 int vmm_timer_event_stop(struct vmm_timer_event *ev)
@@ -273,6 +480,25 @@ int vmm_timer_event_stop(struct vmm_timer_event *ev)
 	return VMM_OK;
 }
 
+u64 vmm_timer_next_event_delta(void)
+{
+	u64 tstamp, ret = ~0ULL;
+	irq_flags_t flags;
+	struct vmm_timer_event *e;
+	struct vmm_timer_local_ctrl *tlcp = &this_cpu(tlc);
+
+	vmm_read_lock_irqsave_lite(&tlcp->event_list_lock, flags);
+	e = __timer_queue_first(tlcp);
+	if (e) {
+		tstamp = vmm_timer_timestamp();
+		ret = (tstamp < e->expiry_tstamp) ?
+					(e->expiry_tstamp - tstamp) : 0;
+	}
+	vmm_read_unlock_irqrestore_lite(&tlcp->event_list_lock, flags);
+
+	return ret;
+}
+
 bool vmm_timer_started(void)
 {
 	return this_cpu(tlc).started;
@@ -290,6 +516,7 @@ void vmm_timer_start(void)
 	tlcp->next_event = tstamp + tlcp->cc->min_delta_ns;
 
 	tlcp->started = TRUE;
+	tlcp->armed = TRUE;
 
 	vmm_clockchip_program_event(tlcp->cc, tstamp, tlcp->next_event);
 }
@@ -301,6 +528,7 @@ void vmm_timer_stop(void)
 	vmm_clockchip_set_mode(tlcp->cc, VMM_CLOCKCHIP_MODE_SHUTDOWN);
 
 	tlcp->started = FALSE;
+	tlcp->armed = FALSE;
 }
 
 int __cpuinit vmm_timer_init(void)
@@ -320,9 +548,9 @@ int __cpuinit vmm_timer_init(void)
 	/* Initialize Per CPU current event pointer */
 	tlcp->curr = NULL;
 
-	/* Initialize Per CPU event list */
+	/* Initialize Per CPU active event queue */
 	INIT_RW_LOCK(&tlcp->event_list_lock);
-	INIT_LIST_HEAD(&tlcp->event_list);
+	__timer_queue_init(tlcp);
 
 	/* Bind suitable clockchip to current host CPU */
 	tlcp->cc = vmm_clockchip_bind_best(cpu);
@@ -0,0 +1,293 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vmm_trace.c
+ * @author agent (agent@local)
+ * @brief Static tracepoint implementation
+ *
+ * Each host CPU only writes its own ring buffer with local interrupts
+ * disabled hence recording a trace event needs no locks or atomics.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_smp.h>
+#include <vmm_cpumask.h>
+#include <vmm_timer.h>
+#include <vmm_modules.h>
+#include <vmm_scheduler.h>
+#include <vmm_trace.h>
+#include <arch_cpu_irq.h>
+#include <arch_barrier.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+
+#define TRACE_COUNT		CONFIG_TRACE_BUFFER_COUNT
+
+struct vmm_trace_event_info {
+	const char *name;
+	const char *fmt;
+};
+
+#define __VMM_TRACE_EVENT_INFO(__id, __name, __fmt)	\
+	[VMM_TRACE_##__id] = { .name = __name, .fmt = __fmt },
+
+static const struct vmm_trace_event_info trace_events[] = {
+	VMM_TRACE_EVENT_LIST(__VMM_TRACE_EVENT_INFO)
+};
+
+/* Per-CPU ring buffer of trace records */
+struct vmm_trace_buffer {
+	struct vmm_trace_record *buf;
+	u32 head;
+	u32 count;
+	u32 lost;
+};
+
+static struct vmm_trace_buffer tbufs[CONFIG_CPU_COUNT];
+
+u64 vmm_trace_mask = 0;
+VMM_EXPORT_SYMBOL(vmm_trace_mask);
+
+void __notrace __vmm_trace(u32 event, u64 a0, u64 a1, u64 a2, u64 a3)
+{
+	irq_flags_t flags;
+	struct vmm_vcpu *vcpu;
+	struct vmm_trace_record *r;
+	struct vmm_trace_buffer *tb;
+
+	arch_cpu_irq_save(flags);
+
+	tb = &tbufs[vmm_smp_processor_id()];
+	if (!tb->buf) {
+		goto done;
+	}
+
+	vcpu = vmm_scheduler_current_vcpu();
+	r = &tb->buf[tb->head];
+	r->tstamp = vmm_timer_timestamp();
+	r->event = event;
+	r->vcpu_id = (vcpu) ? vcpu->id : VMM_TRACE_NO_VCPU;
+	r->arg[0] = a0;
+	r->arg[1] = a1;
+	r->arg[2] = a2;
+	r->arg[3] = a3;
+
+	tb->head = (tb->head + 1) % TRACE_COUNT;
+	if (tb->count < TRACE_COUNT) {
+		tb->count++;
+	} else {
+		tb->lost++;
+	}
+
+done:
+	arch_cpu_irq_restore(flags);
+}
+VMM_EXPORT_SYMBOL(__vmm_trace);
+
+const char *vmm_trace_event_name(u32 event)
+{
+	return (event < VMM_TRACE_MAX_EVENTS) ? trace_events[event].name : NULL;
+}
+
+int vmm_trace_event_find(const char *name)
+{
+	u32 e;
+
+	if (!name) {
+		return VMM_EINVALID;
+	}
+
+	for (e = 0; e < VMM_TRACE_MAX_EVENTS; e++) {
+		if (!strcmp(trace_events[e].name, name)) {
+			return e;
+		}
+	}
+
+	return VMM_ENOTAVAIL;
+}
+
+bool vmm_trace_isactive(void)
+{
+	return (vmm_trace_mask) ? TRUE : FALSE;
+}
+
+int vmm_trace_start(u64 mask)
+{
+	u32 cpu;
+	struct vmm_trace_buffer *tb;
+
+	if (vmm_trace_mask) {
+		return VMM_EBUSY;
+	}
+
+	mask &= VMM_TRACE_ALL_EVENTS;
+	if (!mask) {
+		return VMM_EINVALID;
+	}
+
+	for_each_online_cpu(cpu) {
+		tb = &tbufs[cpu];
+		if (!tb->buf) {
+			tb->buf = vmm_malloc(TRACE_COUNT * sizeof(*tb->buf));
+			if (!tb->buf) {
+				return VMM_ENOMEM;
+			}
+		}
+		tb->head = tb->count = tb->lost = 0;
+	}
+
+	arch_smp_mb();
+	vmm_trace_mask = mask;
+
+	return VMM_OK;
+}
+
+int vmm_trace_stop(void)
+{
+	if (!vmm_trace_mask) {
+		return VMM_EFAIL;
+	}
+
+	vmm_trace_mask = 0;
+	arch_smp_mb();
+
+	return VMM_OK;
+}
+
+static inline struct vmm_trace_record *trace_record(struct vmm_trace_buffer *tb,
+						     u32 index)
+{
+	return &tb->buf[(tb->head + TRACE_COUNT - tb->count + index) %
+								TRACE_COUNT];
+}
+
+u32 vmm_trace_read(u32 cpu, struct vmm_trace_record *buf,
+		   u32 max, u32 *lost)
+{
+	u32 i, count;
+	struct vmm_trace_buffer *tb;
+
+	if ((CONFIG_CPU_COUNT <= cpu) || !buf) {
+		return 0;
+	}
+	tb = &tbufs[cpu];
+
+	count = (tb->buf) ? tb->count : 0;
+	if (max < count) {
+		count = max;
+	}
+	for (i = 0; i < count; i++) {
+		buf[i] = *trace_record(tb, i);
+	}
+	if (lost) {
+		*lost = tb->lost;
+	}
+
+	return count;
+}
+
+int vmm_trace_format(void *priv,
+		     size_t (*write)(void *priv, void *buf, size_t len))
+{
+	int len;
+	u64 secs, usecs;
+	u32 cpu, best, pos[CONFIG_CPU_COUNT];
+	char line[256], task[16];
+	struct vmm_trace_buffer *tb;
+	struct vmm_trace_record *r, *br;
+
+	if (!write) {
+		return VMM_EINVALID;
+	}
+	if (vmm_trace_mask) {
+		return VMM_EBUSY;
+	}
+
+#define TRACE_WRITE(__len)						\
+	do {								\
+		if (write(priv, line, (__len)) != (__len)) {		\
+			return VMM_EIO;					\
+		}							\
+	} while (0)
+
+	len = vmm_snprintf(line, sizeof(line), "# tracer: nop\n#\n");
+	TRACE_WRITE(len);
+	for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+		pos[cpu] = 0;
+		tb = &tbufs[cpu];
+		if (tb->buf && tb->lost) {
+			len = vmm_snprintf(line, sizeof(line),
+				"# CPU %d: %d records overwritten\n",
+				cpu, tb->lost);
+			TRACE_WRITE(len);
+		}
+	}
+	len = vmm_snprintf(line, sizeof(line),
+		"#           TASK-PID   CPU#      TIMESTAMP  FUNCTION\n"
+		"#              | |       |          |         |\n");
+	TRACE_WRITE(len);
+
+	/* Merge per-CPU ring buffers in timestamp order */
+	while (1) {
+		best = CONFIG_CPU_COUNT;
+		br = NULL;
+		for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+			tb = &tbufs[cpu];
+			if (!tb->buf || (tb->count <= pos[cpu])) {
+				continue;
+			}
+			r = trace_record(tb, pos[cpu]);
+			if (!br || (r->tstamp < br->tstamp)) {
+				best = cpu;
+				br = r;
+			}
+		}
+		if (!br) {
+			break;
+		}
+		pos[best]++;
+
+		if (br->vcpu_id == VMM_TRACE_NO_VCPU) {
+			strcpy(task, "<irq>-0");
+		} else {
+			vmm_snprintf(task, sizeof(task), "vcpu-%d",
+				     br->vcpu_id);
+		}
+		secs = udiv64(br->tstamp, 1000000000ULL);
+		usecs = udiv64(br->tstamp - secs * 1000000000ULL, 1000);
+		len = vmm_snprintf(line, sizeof(line),
+				   "%22s [%03d] %5"PRIu64".%06"PRIu64": %s: ",
+				   task, best, secs, usecs,
+				   trace_events[br->event].name);
+		len += vmm_snprintf(&line[len], sizeof(line) - len,
+				    trace_events[br->event].fmt,
+				    br->arg[0], br->arg[1],
+				    br->arg[2], br->arg[3]);
+		if (len > (sizeof(line) - 2)) {
+			len = sizeof(line) - 2;
+		}
+		line[len++] = '\n';
+		TRACE_WRITE(len);
+	}
+
+#undef TRACE_WRITE
+
+	return VMM_OK;
+}
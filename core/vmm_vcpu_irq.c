@@ -22,19 +22,26 @@
  */
 
 #include <arch_vcpu.h>
+#include <arch_barrier.h>
 #include <vmm_error.h>
 #include <vmm_heap.h>
 #include <vmm_stdio.h>
+#include <vmm_smp.h>
 #include <vmm_timer.h>
+#include <vmm_cpuidle.h>
 #include <vmm_scheduler.h>
 #include <vmm_devtree.h>
 #include <vmm_vcpu_irq.h>
+#include <libs/bitops.h>
 #include <libs/stringlib.h>
 
 #define DEASSERTED	0
 #define ASSERTED	1
 #define PENDING		2
 
+#define HALT_POLL_MAX_NS	CONFIG_WFI_HALT_POLL_NS
+#define HALT_POLL_START_NS	10000ULL
+
 void vmm_vcpu_irq_process(struct vmm_vcpu *vcpu, arch_regs_t *regs)
 {
 	/* For non-normal vcpu dont do anything */
@@ -50,49 +57,116 @@ void vmm_vcpu_irq_process(struct vmm_vcpu *vcpu, arch_regs_t *regs)
 
 	/* Proceed only if we have pending execute */
 	if (arch_atomic_dec_if_positive(&vcpu->irqs.execute_pending) >= 0) {
-		int irq_no = -1;
-		u32 i, tmp_prio, irq_count = vcpu->irqs.irq_count;
-		u32 irq_prio = 0;
+		u32 slot, irq_no, irq_count = vcpu->irqs.irq_count;
+
+		/* First pending slot is the highest priority irq */
+		while (1) {
+			slot = find_first_bit(vcpu->irqs.pending, irq_count);
+			if (slot >= irq_count) {
+				return;
+			}
+			irq_no = vcpu->irqs.slot_irq[slot];
 
-		/* Find the irq number to process */
-		for (i = 0; i < irq_count; i++) {
-			if (arch_atomic_read(&vcpu->irqs.irq[i].assert) ==
+			/* Zero priority irqs are never executed */
+			if (!vcpu->irqs.irq[irq_no].prio) {
+				return;
+			}
+
+			if (arch_atomic_cmpxchg(&vcpu->irqs.irq[irq_no].assert,
+					ASSERTED, PENDING) == ASSERTED) {
+				break;
+			}
+
+			/* Drop stale slot of irq deasserted meanwhile
+			 * unless it got asserted again.
+			 */
+			clear_bit(slot, vcpu->irqs.pending);
+			if (arch_atomic_read(&vcpu->irqs.irq[irq_no].assert) ==
 			    ASSERTED) {
-				tmp_prio = arch_vcpu_irq_priority(vcpu, i);
-				if (tmp_prio > irq_prio) {
-					irq_no = i;
-					irq_prio = tmp_prio;
-				}
+				set_bit(slot, vcpu->irqs.pending);
+				return;
 			}
 		}
-		if (irq_no == -1) {
-			return;
+		clear_bit(slot, vcpu->irqs.pending);
+
+		/* Execute the irq */
+		if (arch_vcpu_irq_execute(vcpu, regs, irq_no,
+				vcpu->irqs.irq[irq_no].reason) == VMM_OK) {
+			arch_atomic_write(&vcpu->irqs.irq[irq_no].assert,
+					  DEASSERTED);
+			arch_atomic64_inc(&vcpu->irqs.execute_count);
+		} else {
+			/* arch_vcpu_irq_execute failed may be
+			 * because VCPU was already processing
+			 * a VCPU irq hence increment execute
+			 * pending count to try next time.
+			 */
+			arch_atomic_inc(&vcpu->irqs.execute_pending);
+			arch_atomic_write(&vcpu->irqs.irq[irq_no].assert,
+					  ASSERTED);
+			set_bit(slot, vcpu->irqs.pending);
 		}
+	}
+}
 
-		/* If irq number found then execute it */
-		if (arch_atomic_cmpxchg(&vcpu->irqs.irq[irq_no].assert,
-					ASSERTED, PENDING) == ASSERTED) {
-			if (arch_vcpu_irq_execute(vcpu, regs, irq_no,
-			    	vcpu->irqs.irq[irq_no].reason) == VMM_OK) {
-				arch_atomic_write(&vcpu->irqs.
-						  irq[irq_no].assert,
-						  DEASSERTED);
-				arch_atomic64_inc(&vcpu->irqs.
-						  execute_count);
-			} else {
-				/* arch_vcpu_irq_execute failed may be
-				 * because VCPU was already processing
-				 * a VCPU irq hence increment execute
-				 * pending count to try next time.
-				 */
-				arch_atomic_inc(&vcpu->irqs.
-						execute_pending);
-				arch_atomic_write(&vcpu->irqs.
-						  irq[irq_no].assert,
-						  ASSERTED);
-			}
+/* Adjust halt polling window based on how long last wait lasted.
+ * Must be called with wfi lock held.
+ */
+static void vcpu_irq_wfi_poll_adjust(struct vmm_vcpu *vcpu, u64 block_ns)
+{
+	u64 poll_ns = vcpu->irqs.wfi.poll_ns;
+
+	if (!HALT_POLL_MAX_NS) {
+		return;
+	}
+
+	if (block_ns > HALT_POLL_MAX_NS) {
+		/* Long wait so polling would not have helped */
+		poll_ns = poll_ns >> 1;
+		if (poll_ns < HALT_POLL_START_NS) {
+			poll_ns = 0;
+		}
+	} else if (poll_ns < HALT_POLL_MAX_NS) {
+		/* Short wait so polling a bit longer would have caught it */
+		poll_ns = (poll_ns) ? (poll_ns << 1) : HALT_POLL_START_NS;
+		if (poll_ns > HALT_POLL_MAX_NS) {
+			poll_ns = HALT_POLL_MAX_NS;
 		}
 	}
+
+	vcpu->irqs.wfi.poll_ns = poll_ns;
+}
+
+/* Poll for pending IRQ before pausing VCPU in wfi state.
+ * Returns TRUE if an IRQ became pending while polling.
+ */
+static bool vcpu_irq_wfi_poll(struct vmm_vcpu *vcpu)
+{
+	u32 prio;
+	u64 start, poll_ns = vcpu->irqs.wfi.poll_ns;
+
+	if (!poll_ns) {
+		return FALSE;
+	}
+
+	/* Dont steal host CPU from other ready VCPUs */
+	for (prio = vcpu->priority; prio <= VMM_VCPU_MAX_PRIORITY; prio++) {
+		if (vmm_scheduler_ready_count(vcpu->hcpu, prio)) {
+			return FALSE;
+		}
+	}
+
+	start = vmm_timer_timestamp();
+	do {
+		if (arch_atomic_read(&vcpu->irqs.execute_pending)) {
+			vcpu->irqs.wfi.poll_success++;
+			return TRUE;
+		}
+	} while ((vmm_timer_timestamp() - start) < poll_ns);
+
+	vcpu->irqs.wfi.poll_fail++;
+
+	return FALSE;
 }
 
 static void vcpu_irq_wfi_try_resume(struct vmm_vcpu *vcpu, void *data)
@@ -103,6 +177,15 @@ static void vcpu_irq_wfi_try_resume(struct vmm_vcpu *vcpu, void *data)
 	}
 }
 
+/* Must be called with wfi lock held or with VCPU not running. */
+static void vcpu_irq_wfi_latency_put(struct vmm_vcpu *vcpu)
+{
+	if (vcpu->irqs.wfi.idle_cpu < CONFIG_CPU_COUNT) {
+		vmm_cpuidle_latency_put(vcpu->irqs.wfi.idle_cpu);
+		vcpu->irqs.wfi.idle_cpu = CONFIG_CPU_COUNT;
+	}
+}
+
 static int vcpu_irq_wfi_resume(struct vmm_vcpu *vcpu, bool use_async_ipi)
 {
 	int rc;
@@ -116,16 +199,20 @@ static int vcpu_irq_wfi_resume(struct vmm_vcpu *vcpu, bool use_async_ipi)
 	/* Lock VCPU WFI */
 	vmm_spin_lock_irqsave_lite(&vcpu->irqs.wfi.lock, flags);
 
-	/* If VCPU was in wfi state then update state. */
-	if (vcpu->irqs.wfi.state) {
+	/* If VCPU was in wfi state then clear wait for irq state. */
+	if (arch_atomic_cmpxchg(&vcpu->irqs.wfi.state, TRUE, FALSE)) {
 		try_vcpu_resume = TRUE;
 
-		/* Clear wait for irq state */
-		vcpu->irqs.wfi.state = FALSE;
+		/* Tune halt polling using time spent waiting */
+		vcpu_irq_wfi_poll_adjust(vcpu,
+			vmm_timer_timestamp() - vcpu->irqs.wfi.start_tstamp);
 
 		/* Stop wait for irq timeout event */
 		vmm_timer_event_stop(vcpu->irqs.wfi.priv);
 
+		/* Allow deep idle states on host CPU again */
+		vcpu_irq_wfi_latency_put(vcpu);
+
 		rc = VMM_OK;
 	} else {
 		rc = VMM_ENOTAVAIL;
@@ -186,7 +273,7 @@ void vmm_vcpu_irq_assert(struct vmm_vcpu *vcpu, u32 irq_no, u64 reason)
 	}
 
 	/* Check irq number */
-	if (irq_no > vcpu->irqs.irq_count) {
+	if (irq_no >= vcpu->irqs.irq_count) {
 		return;
 	}
 
@@ -195,6 +282,8 @@ void vmm_vcpu_irq_assert(struct vmm_vcpu *vcpu, u32 irq_no, u64 reason)
 				DEASSERTED, ASSERTED) == DEASSERTED) {
 		if (arch_vcpu_irq_assert(vcpu, irq_no, reason) == VMM_OK) {
 			vcpu->irqs.irq[irq_no].reason = reason;
+			set_bit(vcpu->irqs.irq[irq_no].slot,
+				vcpu->irqs.pending);
 			arch_atomic_inc(&vcpu->irqs.execute_pending);
 			arch_atomic64_inc(&vcpu->irqs.assert_count);
 		} else {
@@ -203,8 +292,19 @@ void vmm_vcpu_irq_assert(struct vmm_vcpu *vcpu, u32 irq_no, u64 reason)
 		}
 	}
 
+	/* Order execute pending update before reading wfi state. This
+	 * pairs with the barrier in vmm_vcpu_irq_wait_timeout() so that
+	 * either the waiter sees execute pending or we see wfi state.
+	 * A running VCPU needs nothing more hence assert from remote
+	 * host CPU costs only the cache line transfers without taking
+	 * the wfi lock.
+	 */
+	arch_smp_mb();
+
 	/* Resume VCPU from wfi */
-	vcpu_irq_wfi_resume(vcpu, FALSE);
+	if (arch_atomic_read(&vcpu->irqs.wfi.state)) {
+		vcpu_irq_wfi_resume(vcpu, FALSE);
+	}
 }
 
 void vmm_vcpu_irq_deassert(struct vmm_vcpu *vcpu, u32 irq_no)
@@ -215,7 +315,7 @@ void vmm_vcpu_irq_deassert(struct vmm_vcpu *vcpu, u32 irq_no)
 	}
 
 	/* Check irq number */
-	if (irq_no > vcpu->irqs.irq_count) {
+	if (irq_no >= vcpu->irqs.irq_count) {
 		return;
 	}
 
@@ -225,7 +325,10 @@ void vmm_vcpu_irq_deassert(struct vmm_vcpu *vcpu, u32 irq_no)
 		arch_atomic64_inc(&vcpu->irqs.deassert_count);
 	}
 
-	/* Reset VCPU irq assert state */
+	/* Reset VCPU irq assert state (pending slot is cleared first
+	 * so that a racing assert never leaves irq without its slot)
+	 */
+	clear_bit(vcpu->irqs.irq[irq_no].slot, vcpu->irqs.pending);
 	arch_atomic_write(&vcpu->irqs.irq[irq_no].assert, DEASSERTED);
 
 	/* Ensure irq reason is zeroed */
@@ -243,7 +346,7 @@ int vmm_vcpu_irq_wait_resume(struct vmm_vcpu *vcpu, bool use_async_ipi)
 	return vcpu_irq_wfi_resume(vcpu, use_async_ipi);
 }
 
-int vmm_vcpu_irq_wait_timeout(struct vmm_vcpu *vcpu, u64 nsecs)
+int vmm_vcpu_irq_wait_suspend(struct vmm_vcpu *vcpu, u64 nsecs, bool deep)
 {
 	irq_flags_t flags;
 	bool try_vcpu_pause = FALSE;
@@ -253,21 +356,44 @@ int vmm_vcpu_irq_wait_timeout(struct vmm_vcpu *vcpu, u64 nsecs)
 		return VMM_EFAIL;
 	}
 
+	/* Poll for a while if IRQs usually arrive soon */
+	if (vcpu_irq_wfi_poll(vcpu)) {
+		return VMM_OK;
+	}
+
 	/* Lock VCPU WFI */
 	vmm_spin_lock_irqsave_lite(&vcpu->irqs.wfi.lock, flags);
 
-	if (!vcpu->irqs.wfi.state &&
-	    !arch_atomic_read(&vcpu->irqs.execute_pending)) {
-		try_vcpu_pause = TRUE;
+	if (!arch_atomic_read(&vcpu->irqs.wfi.state)) {
+		/* Set wait for irq state before checking execute pending
+		 * (pairs with the barrier in vmm_vcpu_irq_assert())
+		 */
+		arch_atomic_write(&vcpu->irqs.wfi.state, TRUE);
+		arch_smp_mb();
 
-		/* Set wait for irq state */
-		vcpu->irqs.wfi.state = TRUE;
+		if (arch_atomic_read(&vcpu->irqs.execute_pending)) {
+			/* Undo unless an assert already consumed it */
+			arch_atomic_cmpxchg(&vcpu->irqs.wfi.state,
+					    TRUE, FALSE);
+		} else {
+			try_vcpu_pause = TRUE;
+			vcpu->irqs.wfi.start_tstamp = vmm_timer_timestamp();
 
-		/* Start wait for irq timeout event */
-		if (!nsecs) {
-			nsecs = CONFIG_WFI_TIMEOUT_SECS * 1000000000ULL;
+			/* Start wait for irq timeout event */
+			if (!nsecs) {
+				nsecs = CONFIG_WFI_TIMEOUT_SECS *
+							1000000000ULL;
+			}
+			vmm_timer_event_start(vcpu->irqs.wfi.priv, nsecs);
+
+			/* Shallow wait limits idle states of this host CPU */
+			if (!deep) {
+				vcpu->irqs.wfi.idle_cpu =
+						vmm_smp_processor_id();
+				vmm_cpuidle_latency_get(
+						vcpu->irqs.wfi.idle_cpu);
+			}
 		}
-		vmm_timer_event_start(vcpu->irqs.wfi.priv, nsecs);
 	}
 
 	/* Unlock VCPU WFI */
@@ -283,24 +409,59 @@ int vmm_vcpu_irq_wait_timeout(struct vmm_vcpu *vcpu, u64 nsecs)
 
 bool vmm_vcpu_irq_wait_state(struct vmm_vcpu *vcpu)
 {
-	bool ret = FALSE;
-	irq_flags_t flags;
+	/* Sanity Checks */
+	if (!vcpu || !vcpu->is_normal) {
+		return VMM_EFAIL;
+	}
+
+	/* Read VCPU WFI state */
+	return arch_atomic_read(&vcpu->irqs.wfi.state) ? TRUE : FALSE;
+}
 
+int vmm_vcpu_irq_wait_poll_stats(struct vmm_vcpu *vcpu, u64 *poll_ns,
+				 u64 *poll_success, u64 *poll_fail)
+{
 	/* Sanity Checks */
 	if (!vcpu || !vcpu->is_normal) {
 		return VMM_EFAIL;
 	}
 
-	/* Lock VCPU WFI */
-	vmm_spin_lock_irqsave_lite(&vcpu->irqs.wfi.lock, flags);
+	if (poll_ns) {
+		*poll_ns = vcpu->irqs.wfi.poll_ns;
+	}
+	if (poll_success) {
+		*poll_success = vcpu->irqs.wfi.poll_success;
+	}
+	if (poll_fail) {
+		*poll_fail = vcpu->irqs.wfi.poll_fail;
+	}
 
-	/* Read VCPU WFI state */
-	ret = vcpu->irqs.wfi.state;
+	return VMM_OK;
+}
 
-	/* Unlock VCPU WFI */
-	vmm_spin_unlock_irqrestore_lite(&vcpu->irqs.wfi.lock, flags);
+/* Sort slots by decreasing priority and then by irq number */
+static void vcpu_irq_init_slots(struct vmm_vcpu *vcpu)
+{
+	u32 i, j, prio;
+	struct vmm_vcpu_irqs *irqs = &vcpu->irqs;
+
+	for (i = 0; i < irqs->irq_count; i++) {
+		prio = arch_vcpu_irq_priority(vcpu, i);
+		irqs->irq[i].prio = prio;
+		for (j = i; j > 0; j--) {
+			if (irqs->irq[irqs->slot_irq[j - 1]].prio >= prio) {
+				break;
+			}
+			irqs->slot_irq[j] = irqs->slot_irq[j - 1];
+		}
+		irqs->slot_irq[j] = i;
+	}
+
+	for (i = 0; i < irqs->irq_count; i++) {
+		irqs->irq[irqs->slot_irq[i]].slot = i;
+	}
 
-	return ret;
+	bitmap_zero(irqs->pending, irqs->irq_count);
 }
 
 int vmm_vcpu_irq_init(struct vmm_vcpu *vcpu)
@@ -334,9 +495,27 @@ int vmm_vcpu_irq_init(struct vmm_vcpu *vcpu)
 			return VMM_ENOMEM;
 		}
 
+		/* Allocate memory for pending slots */
+		vcpu->irqs.pending = vmm_zalloc(sizeof(unsigned long) *
+						BITS_TO_LONGS(irq_count));
+		vcpu->irqs.slot_irq = vmm_zalloc(sizeof(u32) * irq_count);
+		if (!vcpu->irqs.pending || !vcpu->irqs.slot_irq) {
+			vmm_free(vcpu->irqs.slot_irq);
+			vcpu->irqs.slot_irq = NULL;
+			vmm_free(vcpu->irqs.pending);
+			vcpu->irqs.pending = NULL;
+			vmm_free(vcpu->irqs.irq);
+			vcpu->irqs.irq = NULL;
+			return VMM_ENOMEM;
+		}
+
 		/* Create wfi_timeout event */
 		ev = vmm_zalloc(sizeof(struct vmm_timer_event));
 		if (!ev) {
+			vmm_free(vcpu->irqs.slot_irq);
+			vcpu->irqs.slot_irq = NULL;
+			vmm_free(vcpu->irqs.pending);
+			vcpu->irqs.pending = NULL;
 			vmm_free(vcpu->irqs.irq);
 			vcpu->irqs.irq = NULL;
 			return VMM_ENOMEM;
@@ -346,6 +525,9 @@ int vmm_vcpu_irq_init(struct vmm_vcpu *vcpu)
 		/* Initialize wfi lock */
 		INIT_SPIN_LOCK(&vcpu->irqs.wfi.lock);
 
+		/* Not limiting idle states of any host CPU */
+		vcpu->irqs.wfi.idle_cpu = CONFIG_CPU_COUNT;
+
 		/* Initialize wfi timeout event */
 		INIT_TIMER_EVENT(ev, vcpu_irq_wfi_timeout, vcpu);
 	}
@@ -366,11 +548,21 @@ int vmm_vcpu_irq_init(struct vmm_vcpu *vcpu)
 		vcpu->irqs.irq[ite].reason = 0;
 		arch_atomic_write(&vcpu->irqs.irq[ite].assert, DEASSERTED);
 	}
+	vcpu_irq_init_slots(vcpu);
 
 	/* Setup wait for irq context */
-	vcpu->irqs.wfi.state = FALSE;
+	arch_atomic_write(&vcpu->irqs.wfi.state, FALSE);
+	vcpu_irq_wfi_latency_put(vcpu);
+	vcpu->irqs.wfi.start_tstamp = 0;
+	vcpu->irqs.wfi.poll_ns = 0;
+	vcpu->irqs.wfi.poll_success = 0;
+	vcpu->irqs.wfi.poll_fail = 0;
 	rc = vmm_timer_event_stop(vcpu->irqs.wfi.priv);
 	if (rc != VMM_OK) {
+		vmm_free(vcpu->irqs.slot_irq);
+		vcpu->irqs.slot_irq = NULL;
+		vmm_free(vcpu->irqs.pending);
+		vcpu->irqs.pending = NULL;
 		vmm_free(vcpu->irqs.irq);
 		vcpu->irqs.irq = NULL;
 		vmm_free(vcpu->irqs.wfi.priv);
@@ -394,11 +586,18 @@ int vmm_vcpu_irq_deinit(struct vmm_vcpu *vcpu)
 
 	/* Stop wfi_timeout event */
 	vmm_timer_event_stop(vcpu->irqs.wfi.priv);
+	vcpu_irq_wfi_latency_put(vcpu);
 
 	/* Free wfi_timeout event */
 	vmm_free(vcpu->irqs.wfi.priv);
 	vcpu->irqs.wfi.priv = NULL;
 
+	/* Free pending slots */
+	vmm_free(vcpu->irqs.slot_irq);
+	vcpu->irqs.slot_irq = NULL;
+	vmm_free(vcpu->irqs.pending);
+	vcpu->irqs.pending = NULL;
+
 	/* Free flags */
 	vmm_free(vcpu->irqs.irq);
 	vcpu->irqs.irq = NULL;
@@ -24,6 +24,7 @@
 #include <vmm_error.h>
 #include <vmm_timer.h>
 #include <vmm_waitqueue.h>
+#include <vmm_fiber.h>
 #include <arch_cpu_irq.h>
 
 u32 vmm_waitqueue_count(struct vmm_waitqueue *wq) 
@@ -235,9 +236,13 @@ int __vmm_waitqueue_wakefirst(struct vmm_waitqueue *wq)
 	/* Sanity checks */
 	BUG_ON(!wq);
 
-	/* We should have atleast one VCPU in waitqueue list */
+	/* Wakeup first fiber if there is no VCPU in waitqueue list */
 	if (!wq->vcpu_count) {
-		return VMM_ENOENT;
+		if (list_empty(&wq->fiber_list)) {
+			return VMM_ENOENT;
+		}
+		return __vmm_fiber_waitqueue_wake(list_first_entry(
+				&wq->fiber_list, struct vmm_fiber, wq_head));
 	}
 
 	/* Get first VCPU from waitqueue list */
@@ -272,15 +277,21 @@ int __vmm_waitqueue_wakeall(struct vmm_waitqueue *wq)
 {
 	int rc;
 	struct vmm_vcpu *vcpu, *nvcpu;
+	struct vmm_fiber *f, *nf;
 
 	/* Sanity checks */
 	BUG_ON(!wq);
 
-	/* We should have atleast one VCPU in waitqueue list */
-	if (!wq->vcpu_count) {
+	/* We should have atleast one VCPU or fiber in waitqueue list */
+	if (!wq->vcpu_count && list_empty(&wq->fiber_list)) {
 		return VMM_ENOENT;
 	}
 
+	/* Wakeup every fiber till empty */
+	list_for_each_entry_safe(f, nf, &wq->fiber_list, wq_head) {
+		__vmm_fiber_waitqueue_wake(f);
+	}
+
 	/* Try resume every VCPU till empty */
 	list_for_each_entry_safe(vcpu, nvcpu, &wq->vcpu_list, wq_head) {
 		/* Try to Resume VCPU */
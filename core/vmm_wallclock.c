@@ -29,20 +29,31 @@
  *			       adjtime
  *
  *  The original code is licensed under the GPL.
+ *
+ *  Current wall time and timezone live in one host page which is
+ *  refreshed every CONFIG_WALLCLOCK_PAGE_PERIOD_MS by a timer event.
+ *  Writers serialize on a spinlock and bump a sequence count around
+ *  each update so readers (hypervisor code as well as guests having
+ *  the page mapped read-only) never take a lock.
  */
 
 #include <vmm_error.h>
 #include <vmm_timer.h>
 #include <vmm_spinlocks.h>
+#include <vmm_host_aspace.h>
 #include <vmm_wallclock.h>
+#include <arch_barrier.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
 
+#define WALLCLOCK_PAGE_PERIOD_NS	\
+			((u64)CONFIG_WALLCLOCK_PAGE_PERIOD_MS * 1000000ULL)
+
 struct vmm_wallclock_ctrl {
 	vmm_spinlock_t lock;
-	struct vmm_timeval tv;
-	struct vmm_timezone tz;
-	u64 last_modify_tstamp;
+	struct vmm_wallclock_page *page;
+	physical_addr_t page_pa;
+	struct vmm_timer_event ev;
 };
 
 static struct vmm_wallclock_ctrl wclk;
@@ -244,19 +255,86 @@ s64 vmm_wallclock_mktime(const unsigned int year0,
 	return (s64)ret;
 }
 
+/* Start update of wallclock page (Note: wclk.lock must be held) */
+static inline void wallclock_write_begin(struct vmm_wallclock_page *p)
+{
+	p->seq++;
+	arch_smp_wmb();
+}
+
+/* End update of wallclock page (Note: wclk.lock must be held) */
+static inline void wallclock_write_end(struct vmm_wallclock_page *p)
+{
+	arch_smp_wmb();
+	p->seq++;
+}
+
+/* Move wall time of page forward to given timestamp
+ * (Note: Must be called between write begin and end)
+ */
+static void wallclock_advance(struct vmm_wallclock_page *p, u64 tstamp)
+{
+	u64 tdiff, tdiv;
+
+	tdiff = tstamp - p->tstamp;
+	tdiv = udiv64(tdiff, NSEC_PER_SEC);
+	p->tv_nsec += tdiff - tdiv * NSEC_PER_SEC;
+	p->tv_sec += tdiv;
+	if (NSEC_PER_SEC <= p->tv_nsec) {
+		p->tv_sec++;
+		p->tv_nsec -= NSEC_PER_SEC;
+	}
+	p->tstamp = tstamp;
+}
+
+static void wallclock_page_update(struct vmm_timer_event *ev)
+{
+	irq_flags_t flags;
+	struct vmm_wallclock_page *p = wclk.page;
+
+	vmm_spin_lock_irqsave(&wclk.lock, flags);
+
+	wallclock_write_begin(p);
+	wallclock_advance(p, vmm_timer_timestamp());
+	wallclock_write_end(p);
+
+	vmm_spin_unlock_irqrestore(&wclk.lock, flags);
+}
+
+/* Lockless snapshot of wallclock page */
+static void wallclock_read(struct vmm_wallclock_page *snap)
+{
+	u32 seq;
+	volatile struct vmm_wallclock_page *p = wclk.page;
+
+	do {
+		seq = p->seq;
+		arch_smp_rmb();
+		snap->tv_sec = p->tv_sec;
+		snap->tv_nsec = p->tv_nsec;
+		snap->tstamp = p->tstamp;
+		snap->tz_minuteswest = p->tz_minuteswest;
+		snap->tz_dsttime = p->tz_dsttime;
+		arch_smp_rmb();
+	} while ((seq & 1) || (seq != p->seq));
+}
+
 int vmm_wallclock_set_local_time(struct vmm_timeval *tv)
 {
 	irq_flags_t flags;
+	struct vmm_wallclock_page *p = wclk.page;
 
-	if (!tv) {
+	if (!tv || !p) {
 		return VMM_EFAIL;
 	}
 
 	vmm_spin_lock_irqsave(&wclk.lock, flags);
 
-	wclk.tv.tv_sec = tv->tv_sec;
-	wclk.tv.tv_nsec = tv->tv_nsec;
-	wclk.last_modify_tstamp = vmm_timer_timestamp();
+	wallclock_write_begin(p);
+	p->tv_sec = tv->tv_sec;
+	p->tv_nsec = tv->tv_nsec;
+	p->tstamp = vmm_timer_timestamp();
+	wallclock_write_end(p);
 
 	vmm_spin_unlock_irqrestore(&wclk.lock, flags);
 
@@ -265,48 +343,53 @@ int vmm_wallclock_set_local_time(struct vmm_timeval *tv)
 
 int vmm_wallclock_get_local_time(struct vmm_timeval *tv)
 {
-	irq_flags_t flags;
-	u64 tdiff, tdiv, tmod;
+	struct vmm_wallclock_page snap;
 
-	if (!tv) {
+	if (!tv || !wclk.page) {
 		return VMM_EFAIL;
 	}
 
-	vmm_spin_lock_irqsave(&wclk.lock, flags);
+	wallclock_read(&snap);
+	wallclock_advance(&snap, vmm_timer_timestamp());
 
-	tv->tv_sec = wclk.tv.tv_sec;
-	tv->tv_nsec = wclk.tv.tv_nsec;
-	tdiff = vmm_timer_timestamp() - wclk.last_modify_tstamp;
+	tv->tv_sec = snap.tv_sec;
+	tv->tv_nsec = snap.tv_nsec;
 
-	vmm_spin_unlock_irqrestore(&wclk.lock, flags);
+	return VMM_OK;
+}
 
-	tdiv = udiv64(tdiff, NSEC_PER_SEC);
-	tmod = tdiff - tdiv * NSEC_PER_SEC;
-	tv->tv_nsec += tmod;
-	while (NSEC_PER_SEC <= tv->tv_nsec) {
-		tv->tv_sec++;
-		tv->tv_nsec -= NSEC_PER_SEC;
+int vmm_wallclock_get_local_time_coarse(struct vmm_timeval *tv)
+{
+	struct vmm_wallclock_page snap;
+
+	if (!tv || !wclk.page) {
+		return VMM_EFAIL;
 	}
-	tv->tv_sec += tdiv;
+
+	wallclock_read(&snap);
+
+	tv->tv_sec = snap.tv_sec;
+	tv->tv_nsec = snap.tv_nsec;
 
 	return VMM_OK;
 }
 
 int vmm_wallclock_set_timezone(struct vmm_timezone *tz)
 {
-	int minuteswest;
 	irq_flags_t flags;
+	struct vmm_wallclock_page *p = wclk.page;
 
-	if (!tz) {
+	if (!tz || !p) {
 		return VMM_EFAIL;
 	}
 
 	vmm_spin_lock_irqsave(&wclk.lock, flags);
 
-	minuteswest = tz->tz_minuteswest - wclk.tz.tz_minuteswest;
-	wclk.tv.tv_sec += minuteswest * 60;
-	wclk.tz.tz_minuteswest = tz->tz_minuteswest;
-	wclk.tz.tz_dsttime = tz->tz_dsttime;
+	wallclock_write_begin(p);
+	p->tv_sec += (tz->tz_minuteswest - p->tz_minuteswest) * 60;
+	p->tz_minuteswest = tz->tz_minuteswest;
+	p->tz_dsttime = tz->tz_dsttime;
+	wallclock_write_end(p);
 
 	vmm_spin_unlock_irqrestore(&wclk.lock, flags);
 
@@ -315,18 +398,16 @@ int vmm_wallclock_set_timezone(struct vmm_timezone *tz)
 
 int vmm_wallclock_get_timezone(struct vmm_timezone *tz)
 {
-	irq_flags_t flags;
+	struct vmm_wallclock_page snap;
 
-	if (!tz) {
+	if (!tz || !wclk.page) {
 		return VMM_EFAIL;
 	}
 
-	vmm_spin_lock_irqsave(&wclk.lock, flags);
-
-	tz->tz_minuteswest = wclk.tz.tz_minuteswest;
-	tz->tz_dsttime = wclk.tz.tz_dsttime;
+	wallclock_read(&snap);
 
-	vmm_spin_unlock_irqrestore(&wclk.lock, flags);
+	tz->tz_minuteswest = snap.tz_minuteswest;
+	tz->tz_dsttime = snap.tz_dsttime;
 
 	return VMM_OK;
 }
@@ -371,20 +452,38 @@ int vmm_wallclock_get_timeofday(struct vmm_timeval *tv,
 	return VMM_OK;
 }
 
+physical_addr_t vmm_wallclock_page_hphys(void)
+{
+	return wclk.page_pa;
+}
+
 int vmm_wallclock_init(void)
 {
+	int rc;
+	virtual_addr_t va;
+
 	memset(&wclk, 0, sizeof(wclk));
 
 	INIT_SPIN_LOCK(&wclk.lock);
+	INIT_TIMER_EVENT(&wclk.ev, wallclock_page_update, NULL);
 
-	wclk.tv.tv_sec = 0;
-	wclk.tv.tv_nsec = 0;
-
-	wclk.tz.tz_minuteswest = 0;
-	wclk.tz.tz_dsttime = 0;
+	va = vmm_host_alloc_pages(1, VMM_MEMORY_FLAGS_NORMAL);
+	if (!va) {
+		return VMM_ENOMEM;
+	}
+	rc = vmm_host_va2pa(va, &wclk.page_pa);
+	if (rc) {
+		vmm_host_free_pages(va, 1);
+		return rc;
+	}
+	memset((void *)va, 0, VMM_PAGE_SIZE);
 
-	wclk.last_modify_tstamp = vmm_timer_timestamp();
+	wclk.page = (struct vmm_wallclock_page *)va;
+	wclk.page->version = VMM_WALLCLOCK_PAGE_VERSION;
+	wclk.page->period_nsecs = WALLCLOCK_PAGE_PERIOD_NS;
+	wclk.page->tstamp = vmm_timer_timestamp();
 
-	return VMM_OK;
+	return vmm_timer_event_start_periodic(&wclk.ev,
+					      WALLCLOCK_PAGE_PERIOD_NS,
+					      WALLCLOCK_PAGE_PERIOD_NS);
 }
-
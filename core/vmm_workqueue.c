@@ -38,13 +38,24 @@ struct vmm_workqueue {
 	struct dlist work_list;
 	struct vmm_completion work_avail;
 	struct vmm_thread *thread;
+	bool system;
+	bool busy;
 };
 
+/*
+ * Per-CPU system workqueues form a pool. A system workqueue thread
+ * with nothing to do steals pending work from system workqueues whose
+ * thread is busy with a work (running or blocked), and scheduling work
+ * on a busy system workqueue wakes up one idle system workqueue thread
+ * to do so. The unbound system workqueue is not part of this pool and
+ * its thread can run on any host CPU.
+ */
 struct vmm_workqueue_ctrl {
 	vmm_spinlock_t lock;
 	struct dlist wq_list;
 	u32 wq_count;
 	struct vmm_workqueue *syswq[CONFIG_CPU_COUNT];
+	struct vmm_workqueue *unbound_wq;
 };
 
 static struct vmm_workqueue_ctrl wqctrl;
@@ -230,9 +241,78 @@ int vmm_workqueue_flush(struct vmm_workqueue *wq)
 	return VMM_OK;
 }
 
+/* System workqueue of current host CPU (Note: isolated host CPUs have
+ * no system workqueue so their work goes to unbound workqueue)
+ */
+static inline struct vmm_workqueue *workqueue_local(void)
+{
+	struct vmm_workqueue *wq = wqctrl.syswq[vmm_smp_processor_id()];
+
+	return (wq) ? wq : wqctrl.unbound_wq;
+}
+
+#ifdef CONFIG_WORKQUEUE_STEAL
+/* Wakeup one idle system workqueue (other than given one) */
+static void workqueue_kick_idle(struct vmm_workqueue *wq)
+{
+	u32 cpu;
+	bool idle;
+	irq_flags_t flags;
+	struct vmm_workqueue *swq;
+
+	for_each_online_cpu(cpu) {
+		swq = wqctrl.syswq[cpu];
+		if (!swq || (swq == wq)) {
+			continue;
+		}
+
+		vmm_spin_lock_irqsave(&swq->lock, flags);
+		idle = (!swq->busy && list_empty(&swq->work_list)) ?
+								TRUE : FALSE;
+		vmm_spin_unlock_irqrestore(&swq->lock, flags);
+
+		if (idle) {
+			vmm_completion_complete(&swq->work_avail);
+			break;
+		}
+	}
+}
+
+/* Steal oldest pending work from some busy system workqueue */
+static struct vmm_work *workqueue_steal(struct vmm_workqueue *wq)
+{
+	u32 cpu;
+	irq_flags_t flags;
+	struct vmm_workqueue *swq;
+	struct vmm_work *work = NULL;
+
+	for_each_online_cpu(cpu) {
+		swq = wqctrl.syswq[cpu];
+		if (!swq || (swq == wq)) {
+			continue;
+		}
+
+		vmm_spin_lock_irqsave(&swq->lock, flags);
+		if (swq->busy && !list_empty(&swq->work_list)) {
+			work = list_first_entry(&swq->work_list,
+						struct vmm_work, head);
+			list_del(&work->head);
+		}
+		vmm_spin_unlock_irqrestore(&swq->lock, flags);
+
+		if (work) {
+			break;
+		}
+	}
+
+	return work;
+}
+#endif
+
 int vmm_workqueue_schedule_work(struct vmm_workqueue *wq, 
 				struct vmm_work *work)
 {
+	bool kick;
 	irq_flags_t flags, flags1;
 
 	if (!work) {
@@ -247,7 +327,7 @@ int vmm_workqueue_schedule_work(struct vmm_workqueue *wq,
 	}
 
 	if (!wq) {
-		wq = wqctrl.syswq[vmm_smp_processor_id()];
+		wq = workqueue_local();
 	}
 
 	work->flags &= ~VMM_WORK_STATE_CREATED;
@@ -256,12 +336,21 @@ int vmm_workqueue_schedule_work(struct vmm_workqueue *wq,
 
 	vmm_spin_lock_irqsave(&wq->lock, flags1);
 	list_add_tail(&work->head, &wq->work_list);
+	kick = (wq->system && wq->busy) ? TRUE : FALSE;
 	vmm_spin_unlock_irqrestore(&wq->lock, flags1);
 
 	vmm_spin_unlock_irqrestore(&work->lock, flags);
 
 	vmm_completion_complete(&wq->work_avail);
 
+#ifdef CONFIG_WORKQUEUE_STEAL
+	if (kick) {
+		workqueue_kick_idle(wq);
+	}
+#else
+	(void)kick;
+#endif
+
 	return VMM_OK;
 }
 
@@ -277,7 +366,7 @@ int vmm_workqueue_schedule_delayed_work(struct vmm_workqueue *wq,
 					u64 nsecs)
 {
 	if (!wq) {
-		wq = wqctrl.syswq[vmm_smp_processor_id()];
+		wq = workqueue_local();
 	}
 
 	if (!work) {
@@ -294,9 +383,29 @@ int vmm_workqueue_schedule_delayed_work(struct vmm_workqueue *wq,
 	return vmm_timer_event_start(&work->event, nsecs);
 }
 
+static void workqueue_run_work(struct vmm_work *work)
+{
+	bool do_work = FALSE;
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&work->lock, flags);
+	if (work->flags & VMM_WORK_STATE_SCHEDULED) {
+		work->flags &= ~VMM_WORK_STATE_SCHEDULED;
+		work->flags |= VMM_WORK_STATE_INPROGRESS;
+		do_work = TRUE;
+	}
+	vmm_spin_unlock_irqrestore(&work->lock, flags);
+
+	if (do_work) {
+		work->func(work);
+		vmm_spin_lock_irqsave(&work->lock, flags);
+		work->flags &= ~VMM_WORK_STATE_INPROGRESS;
+		vmm_spin_unlock_irqrestore(&work->lock, flags);
+	}
+}
+
 static int workqueue_main(void *data)
 {
-	bool do_work;
 	irq_flags_t flags;
 	struct vmm_workqueue *wq = data;
 	struct vmm_work *work = NULL;
@@ -314,33 +423,41 @@ static int workqueue_main(void *data)
 			work = list_first_entry(&wq->work_list,
 						struct vmm_work, head);
 			list_del(&work->head);
+			wq->busy = TRUE;
 			vmm_spin_unlock_irqrestore(&wq->lock, flags);
 
-			do_work = FALSE;
-			vmm_spin_lock_irqsave(&work->lock, flags);
-			if (work->flags & VMM_WORK_STATE_SCHEDULED) {
-				work->flags &= ~VMM_WORK_STATE_SCHEDULED;
-				work->flags |= VMM_WORK_STATE_INPROGRESS;
-				do_work = TRUE;
-			}
-			vmm_spin_unlock_irqrestore(&work->lock, flags);
-
-			if (do_work) {
-				work->func(work);
-				vmm_spin_lock_irqsave(&work->lock, flags);
-				work->flags &= ~VMM_WORK_STATE_INPROGRESS;
-				vmm_spin_unlock_irqrestore(&work->lock, flags);
-			}
+			workqueue_run_work(work);
 
 			vmm_spin_lock_irqsave(&wq->lock, flags);
+			wq->busy = FALSE;
 		}
 
 		vmm_spin_unlock_irqrestore(&wq->lock, flags);
+
+#ifdef CONFIG_WORKQUEUE_STEAL
+		/* Help busy system workqueues when idle */
+		while (wq->system && (work = workqueue_steal(wq))) {
+			vmm_spin_lock_irqsave(&wq->lock, flags);
+			wq->busy = TRUE;
+			vmm_spin_unlock_irqrestore(&wq->lock, flags);
+
+			workqueue_run_work(work);
+
+			vmm_spin_lock_irqsave(&wq->lock, flags);
+			wq->busy = FALSE;
+			vmm_spin_unlock_irqrestore(&wq->lock, flags);
+		}
+#endif
 	}
 
 	return VMM_OK;
 }
 
+struct vmm_workqueue *vmm_workqueue_unbound(void)
+{
+	return wqctrl.unbound_wq;
+}
+
 struct vmm_workqueue *vmm_workqueue_create(const char *name, u8 priority)
 {
 	struct vmm_workqueue *wq;
@@ -359,6 +476,8 @@ struct vmm_workqueue *vmm_workqueue_create(const char *name, u8 priority)
 	INIT_LIST_HEAD(&wq->head);
 	INIT_LIST_HEAD(&wq->work_list);
 	INIT_COMPLETION(&wq->work_avail);
+	wq->system = FALSE;
+	wq->busy = FALSE;
 
 	wq->thread = vmm_threads_create(name, workqueue_main, wq, 
 					priority, VMM_THREAD_DEF_TIME_SLICE);
@@ -429,6 +548,19 @@ int __cpuinit vmm_workqueue_init(void)
 
 		/* Initialize workqueue count */
 		wqctrl.wq_count = 0;
+
+		/* Create unbound system workqueue for long-running work */
+		wqctrl.unbound_wq = vmm_workqueue_create("syswq/unbound",
+						VMM_THREAD_DEF_PRIORITY);
+		if (!wqctrl.unbound_wq) {
+			return VMM_EFAIL;
+		}
+	}
+
+	/* No housekeeping threads on isolated host CPU */
+	if (vmm_cpu_isolated(cpu)) {
+		wqctrl.syswq[cpu] = NULL;
+		return VMM_OK;
 	}
 
 	/* Create one system workqueue with thread priority
@@ -437,9 +569,10 @@ int __cpuinit vmm_workqueue_init(void)
 	vmm_snprintf(syswq_name, sizeof(syswq_name), "syswq/%d", cpu);
 	wqctrl.syswq[cpu] = vmm_workqueue_create(syswq_name,
 						 VMM_THREAD_DEF_PRIORITY);
-	if (!wqctrl.syswq) {
+	if (!wqctrl.syswq[cpu]) {
 		return VMM_EFAIL;
 	}
+	wqctrl.syswq[cpu]->system = TRUE;
 
 	return vmm_threads_set_affinity(wqctrl.syswq[cpu]->thread,
 					vmm_cpumask_of(cpu));
@@ -0,0 +1,209 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file irqbalance.c
+ * @author agent (agent@local)
+ * @brief host IRQ affinity balancing daemon
+ *
+ * The daemon periodically samples per-CPU count of each host IRQ and
+ * per-CPU load as reported by scheduler. An IRQ with rate above the
+ * threshold is moved from the host CPU serving it to the least loaded
+ * host CPU when load difference between them is above the margin.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_heap.h>
+#include <vmm_smp.h>
+#include <vmm_cpumask.h>
+#include <vmm_delay.h>
+#include <vmm_threads.h>
+#include <vmm_scheduler.h>
+#include <vmm_host_irq.h>
+#include <vmm_modules.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+
+#define MODULE_DESC			"Host IRQ Balancing Daemon"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			daemon_irqbalance_init
+#define	MODULE_EXIT			daemon_irqbalance_exit
+
+#define IRQBALANCE_PERIOD_MSECS		CONFIG_IRQBALANCE_PERIOD_MSECS
+#define IRQBALANCE_RATE_THRESHOLD	CONFIG_IRQBALANCE_RATE_THRESHOLD
+#define IRQBALANCE_LOAD_MARGIN		CONFIG_IRQBALANCE_LOAD_MARGIN
+
+static struct irqbalance_ctrl {
+	struct vmm_thread *thread;
+	u32 irq_count;
+	u32 *prev_count;
+	u32 load[CONFIG_CPU_COUNT];
+} ibctrl;
+
+/* Load of host CPU in percent during last scheduler sample period */
+static u32 irqbalance_cpu_load(u32 cpu)
+{
+	u64 period, idle;
+
+	period = vmm_scheduler_get_sample_period(cpu);
+	if (!period) {
+		return 0;
+	}
+	idle = vmm_scheduler_idle_time(cpu);
+	if (idle >= period) {
+		return 0;
+	}
+
+	return (u32)udiv64((period - idle) * 100ULL, period);
+}
+
+static bool irqbalance_can_move(struct vmm_host_irq *irq)
+{
+	if (!irq || !irq->chip || !irq->chip->irq_set_affinity) {
+		return FALSE;
+	}
+
+	if (irq->state & (VMM_IRQ_STATE_PER_CPU |
+			  VMM_IRQ_STATE_IPI |
+			  VMM_IRQ_STATE_DISABLED)) {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+static void irqbalance_sample(void)
+{
+	u64 rate;
+	u32 hirq, cpu, src, dst, delta, total, max_delta;
+	u32 *prev;
+	struct vmm_host_irq *irq;
+
+	for_each_online_cpu(cpu) {
+		ibctrl.load[cpu] = irqbalance_cpu_load(cpu);
+	}
+
+	for (hirq = 0; hirq < ibctrl.irq_count; hirq++) {
+		irq = vmm_host_irq_get(hirq);
+		if (!irq) {
+			continue;
+		}
+
+		/* Count IRQs since last sample and find serving CPU */
+		prev = &ibctrl.prev_count[hirq * CONFIG_CPU_COUNT];
+		src = 0;
+		total = max_delta = 0;
+		for (cpu = 0; cpu < CONFIG_CPU_COUNT; cpu++) {
+			delta = irq->count[cpu] - prev[cpu];
+			prev[cpu] = irq->count[cpu];
+			total += delta;
+			if (delta > max_delta) {
+				max_delta = delta;
+				src = cpu;
+			}
+		}
+
+		if (!total || !irqbalance_can_move(irq)) {
+			continue;
+		}
+
+		rate = udiv64((u64)total * 1000ULL, IRQBALANCE_PERIOD_MSECS);
+		if (rate < IRQBALANCE_RATE_THRESHOLD) {
+			continue;
+		}
+
+		/* Find least loaded online CPU */
+		dst = src;
+		for_each_online_cpu(cpu) {
+			if (ibctrl.load[cpu] < ibctrl.load[dst]) {
+				dst = cpu;
+			}
+		}
+		if ((dst == src) ||
+		    (ibctrl.load[src] <
+		     (ibctrl.load[dst] + IRQBALANCE_LOAD_MARGIN))) {
+			continue;
+		}
+
+		if (vmm_host_irq_set_affinity(hirq,
+					      vmm_cpumask_of(dst), TRUE)) {
+			continue;
+		}
+
+		/* Account moved IRQ so that next IRQ sees updated loads */
+		ibctrl.load[src] -= IRQBALANCE_LOAD_MARGIN / 2;
+		ibctrl.load[dst] += IRQBALANCE_LOAD_MARGIN / 2;
+	}
+}
+
+static int irqbalance_main(void *udata)
+{
+	while (1) {
+		vmm_msleep(IRQBALANCE_PERIOD_MSECS);
+		irqbalance_sample();
+	}
+
+	return VMM_OK;
+}
+
+static int __init daemon_irqbalance_init(void)
+{
+	/* Reset the control structure */
+	memset(&ibctrl, 0, sizeof(ibctrl));
+
+	ibctrl.irq_count = vmm_host_irq_count();
+	ibctrl.prev_count = vmm_zalloc(sizeof(u32) *
+				       ibctrl.irq_count * CONFIG_CPU_COUNT);
+	if (!ibctrl.prev_count) {
+		return VMM_ENOMEM;
+	}
+
+	/* Create irqbalance thread */
+	ibctrl.thread = vmm_threads_create("irqbalance",
+					   &irqbalance_main,
+					   NULL,
+					   VMM_THREAD_DEF_PRIORITY,
+					   VMM_THREAD_DEF_TIME_SLICE);
+	if (!ibctrl.thread) {
+		vmm_free(ibctrl.prev_count);
+		return VMM_EFAIL;
+	}
+
+	/* Start the irqbalance thread */
+	vmm_threads_start(ibctrl.thread);
+
+	return VMM_OK;
+}
+
+static void __exit daemon_irqbalance_exit(void)
+{
+	vmm_threads_stop(ibctrl.thread);
+
+	vmm_threads_destroy(ibctrl.thread);
+
+	vmm_free(ibctrl.prev_count);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
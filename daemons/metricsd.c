@@ -0,0 +1,431 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file metricsd.c
+ * @author agent (agent@local)
+ * @brief Metrics exporter daemon
+ *
+ * Serves host and guest statistics in Prometheus text exposition
+ * format over HTTP. Statistics are sampled from per-CPU counters and
+ * per-object locks only so scraping does not disturb hot paths.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_heap.h>
+#include <vmm_smp.h>
+#include <vmm_cpumask.h>
+#include <vmm_devtree.h>
+#include <vmm_threads.h>
+#include <vmm_manager.h>
+#include <vmm_scheduler.h>
+#include <vmm_modules.h>
+#include <net/vmm_netport.h>
+#include <block/vmm_blockdev.h>
+#include <libs/stringlib.h>
+#include <libs/netstack.h>
+
+#define MODULE_DESC			"Metrics Exporter Daemon"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(NETSTACK_IPRIORITY + 1)
+#define	MODULE_INIT			daemon_metricsd_init
+#define	MODULE_EXIT			daemon_metricsd_exit
+
+#undef METRICSD_DEBUG
+
+#if defined(METRICSD_DEBUG)
+#define METRICSD_DPRINTF(msg...)	vmm_printf(msg)
+#else
+#define METRICSD_DPRINTF(msg...)
+#endif
+
+#define METRICSD_DEFAULT_PORT		9100
+#define METRICSD_RX_TIMEOUT_MSECS	1000
+#define METRICSD_TX_CHUNK_SIZE		1024
+
+static const char metricsd_http_hdr[] =
+	"HTTP/1.0 200 OK\r\n"
+	"Content-Type: text/plain; version=0.0.4\r\n"
+	"Connection: close\r\n\r\n";
+
+static struct metricsd_ctrl {
+	u32 port;
+	struct netstack_socket *sk;
+	struct netstack_socket *active_sk;
+	struct vmm_thread *main_thread;
+
+	/* Response is rendered completely before sending it */
+	char *buf;
+	u32 buf_size;
+	u32 len;
+	bool truncated;
+	char line[256];
+} mdctrl;
+
+static void metricsd_puts(const char *str)
+{
+	u32 len = strlen(str);
+
+	if ((mdctrl.buf_size - mdctrl.len) < len) {
+		mdctrl.truncated = TRUE;
+		return;
+	}
+
+	memcpy(&mdctrl.buf[mdctrl.len], str, len);
+	mdctrl.len += len;
+}
+
+#define metricsd_printf(args...)					\
+	do {								\
+		vmm_snprintf(mdctrl.line, sizeof(mdctrl.line), args);	\
+		metricsd_puts(mdctrl.line);				\
+	} while (0)
+
+static void metricsd_type(const char *name, const char *type)
+{
+	metricsd_printf("# TYPE xvisor_%s %s\n", name, type);
+}
+
+static void metricsd_render_cpus(void)
+{
+	u32 cpu;
+
+	metricsd_type("cpu_sample_period_ns", "gauge");
+	for_each_online_cpu(cpu) {
+		metricsd_printf("xvisor_cpu_sample_period_ns{cpu=\"%d\"} "
+				"%"PRIu64"\n", cpu,
+				vmm_scheduler_get_sample_period(cpu));
+	}
+
+	metricsd_type("cpu_idle_ns", "gauge");
+	for_each_online_cpu(cpu) {
+		metricsd_printf("xvisor_cpu_idle_ns{cpu=\"%d\"} %"PRIu64"\n",
+				cpu, vmm_scheduler_idle_time(cpu));
+	}
+
+	metricsd_type("cpu_irq_ns", "gauge");
+	for_each_online_cpu(cpu) {
+		metricsd_printf("xvisor_cpu_irq_ns{cpu=\"%d\"} %"PRIu64"\n",
+				cpu, vmm_scheduler_irq_time(cpu));
+	}
+}
+
+static void metricsd_render_heap(void)
+{
+	metricsd_type("heap_size_bytes", "gauge");
+	metricsd_printf("xvisor_heap_size_bytes{heap=\"normal\"} %lu\n",
+			(unsigned long)vmm_normal_heap_size());
+	metricsd_printf("xvisor_heap_size_bytes{heap=\"dma\"} %lu\n",
+			(unsigned long)vmm_dma_heap_size());
+
+	metricsd_type("heap_free_bytes", "gauge");
+	metricsd_printf("xvisor_heap_free_bytes{heap=\"normal\"} %lu\n",
+			(unsigned long)vmm_normal_heap_free_size());
+	metricsd_printf("xvisor_heap_free_bytes{heap=\"dma\"} %lu\n",
+			(unsigned long)vmm_dma_heap_free_size());
+}
+
+struct metricsd_vcpu_stats {
+	u32 reset_count;
+	u64 ready_nsecs;
+	u64 running_nsecs;
+	u64 paused_nsecs;
+	u64 halted_nsecs;
+};
+
+static void metricsd_render_vcpus(void)
+{
+	u32 id, max = vmm_manager_max_vcpu_count();
+	struct vmm_vcpu *vcpu;
+	struct metricsd_vcpu_stats s;
+#ifdef CONFIG_VCPU_EXIT_STATS
+	u32 reason;
+	struct vmm_vcpu_exit_stats es;
+#endif
+
+	metricsd_type("vcpu_state_ns_total", "counter");
+	metricsd_type("vcpu_resets_total", "counter");
+#ifdef CONFIG_VCPU_EXIT_STATS
+	metricsd_type("vcpu_exits_total", "counter");
+	metricsd_type("vcpu_exit_ns_total", "counter");
+#endif
+
+	/*
+	 * Manager lock is only taken briefly while looking up each VCPU
+	 * whereas statistics are read under per-VCPU scheduling lock.
+	 */
+	for (id = 0; id < max; id++) {
+		vcpu = vmm_manager_vcpu(id);
+		if (!vcpu || !vcpu->is_normal) {
+			continue;
+		}
+
+		if (vmm_manager_vcpu_stats(vcpu, NULL, NULL, NULL,
+					   &s.reset_count, NULL,
+					   &s.ready_nsecs, &s.running_nsecs,
+					   &s.paused_nsecs, &s.halted_nsecs)) {
+			continue;
+		}
+
+		metricsd_printf("xvisor_vcpu_state_ns_total{vcpu=\"%s\","
+				"state=\"ready\"} %"PRIu64"\n",
+				vcpu->name, s.ready_nsecs);
+		metricsd_printf("xvisor_vcpu_state_ns_total{vcpu=\"%s\","
+				"state=\"running\"} %"PRIu64"\n",
+				vcpu->name, s.running_nsecs);
+		metricsd_printf("xvisor_vcpu_state_ns_total{vcpu=\"%s\","
+				"state=\"paused\"} %"PRIu64"\n",
+				vcpu->name, s.paused_nsecs);
+		metricsd_printf("xvisor_vcpu_state_ns_total{vcpu=\"%s\","
+				"state=\"halted\"} %"PRIu64"\n",
+				vcpu->name, s.halted_nsecs);
+		metricsd_printf("xvisor_vcpu_resets_total{vcpu=\"%s\"} %d\n",
+				vcpu->name, s.reset_count);
+
+#ifdef CONFIG_VCPU_EXIT_STATS
+		for (reason = 0; reason < VMM_VCPU_EXIT_MAX; reason++) {
+			if (vmm_manager_vcpu_exit_stats(vcpu, reason, &es) ||
+			    !es.count) {
+				continue;
+			}
+			metricsd_printf("xvisor_vcpu_exits_total{vcpu=\"%s\","
+					"reason=\"%s\"} %"PRIu64"\n",
+					vcpu->name,
+					vmm_manager_vcpu_exit_name(reason),
+					es.count);
+			metricsd_printf("xvisor_vcpu_exit_ns_total{vcpu=\"%s\","
+					"reason=\"%s\"} %"PRIu64"\n",
+					vcpu->name,
+					vmm_manager_vcpu_exit_name(reason),
+					es.total_ns);
+		}
+#endif
+	}
+}
+
+static int metricsd_netport_iter(struct vmm_netport *port, void *data)
+{
+	metricsd_printf("xvisor_netport_rx_packets_total{port=\"%s\"} "
+			"%"PRIu64"\n", port->name,
+			vmm_percpu_counter_read(&port->stat_ingress_pkts));
+	metricsd_printf("xvisor_netport_rx_bytes_total{port=\"%s\"} "
+			"%"PRIu64"\n", port->name,
+			vmm_percpu_counter_read(&port->stat_ingress_bytes));
+	metricsd_printf("xvisor_netport_rx_drops_total{port=\"%s\"} "
+			"%"PRIu64"\n", port->name,
+			vmm_percpu_counter_read(&port->stat_ingress_drops));
+
+	return VMM_OK;
+}
+
+static int metricsd_blockdev_iter(struct vmm_blockdev *bdev, void *data)
+{
+	metricsd_printf("xvisor_blockdev_requests_total{dev=\"%s\","
+			"op=\"read\"} %"PRIu64"\n", bdev->name,
+			vmm_percpu_counter_read(&bdev->stat_read_reqs));
+	metricsd_printf("xvisor_blockdev_requests_total{dev=\"%s\","
+			"op=\"write\"} %"PRIu64"\n", bdev->name,
+			vmm_percpu_counter_read(&bdev->stat_write_reqs));
+	metricsd_printf("xvisor_blockdev_blocks_total{dev=\"%s\","
+			"op=\"read\"} %"PRIu64"\n", bdev->name,
+			vmm_percpu_counter_read(&bdev->stat_read_blocks));
+	metricsd_printf("xvisor_blockdev_blocks_total{dev=\"%s\","
+			"op=\"write\"} %"PRIu64"\n", bdev->name,
+			vmm_percpu_counter_read(&bdev->stat_write_blocks));
+	metricsd_printf("xvisor_blockdev_failed_total{dev=\"%s\"} "
+			"%"PRIu64"\n", bdev->name,
+			vmm_percpu_counter_read(&bdev->stat_failed_reqs));
+
+	return VMM_OK;
+}
+
+static void metricsd_render(void)
+{
+	mdctrl.len = 0;
+	mdctrl.truncated = FALSE;
+
+	metricsd_puts(metricsd_http_hdr);
+
+	metricsd_render_cpus();
+	metricsd_render_heap();
+	metricsd_render_vcpus();
+
+	metricsd_type("netport_rx_packets_total", "counter");
+	metricsd_type("netport_rx_bytes_total", "counter");
+	metricsd_type("netport_rx_drops_total", "counter");
+	vmm_netport_iterate(NULL, NULL, metricsd_netport_iter);
+
+	metricsd_type("blockdev_requests_total", "counter");
+	metricsd_type("blockdev_blocks_total", "counter");
+	metricsd_type("blockdev_failed_total", "counter");
+	vmm_blockdev_iterate(NULL, NULL, metricsd_blockdev_iter);
+
+	if (mdctrl.truncated) {
+		METRICSD_DPRINTF("%s: response truncated to %d bytes\n",
+				 __func__, mdctrl.len);
+	}
+}
+
+static void metricsd_serve(void)
+{
+	int rc;
+	u32 pos, len;
+	struct netstack_socket_buf buf;
+
+	/* Request content does not matter so just consume it */
+	rc = netstack_socket_recv(mdctrl.active_sk, &buf,
+				  METRICSD_RX_TIMEOUT_MSECS);
+	if (rc == VMM_OK) {
+		do {
+		} while (netstack_socket_nextbuf(&buf) == VMM_OK);
+		netstack_socket_freebuf(&buf);
+	} else if (rc != VMM_ETIMEDOUT) {
+		return;
+	}
+
+	metricsd_render();
+
+	for (pos = 0; pos < mdctrl.len; pos += len) {
+		len = mdctrl.len - pos;
+		if (METRICSD_TX_CHUNK_SIZE < len) {
+			len = METRICSD_TX_CHUNK_SIZE;
+		}
+		rc = netstack_socket_write(mdctrl.active_sk,
+					   &mdctrl.buf[pos], len);
+		if (rc) {
+			METRICSD_DPRINTF("%s: Socket write failed "
+					 "(error %d)\n", __func__, rc);
+			return;
+		}
+	}
+}
+
+static int metricsd_main(void *data)
+{
+	int rc;
+
+	/* Create a new socket. */
+	mdctrl.sk = netstack_socket_alloc(NETSTACK_SOCKET_TCP);
+	if (!mdctrl.sk) {
+		return VMM_ENOMEM;
+	}
+
+	/* Bind socket to port number */
+	rc = netstack_socket_bind(mdctrl.sk, NULL, mdctrl.port);
+	if (rc) {
+		goto fail;
+	}
+
+	/* Tell socket to go into listening mode. */
+	rc = netstack_socket_listen(mdctrl.sk);
+	if (rc) {
+		goto fail1;
+	}
+
+	while (1) {
+		/* Grab new connect request. */
+		rc = netstack_socket_accept(mdctrl.sk, &mdctrl.active_sk);
+		if (rc) {
+			goto fail1;
+		}
+
+		metricsd_serve();
+
+		/* Close and free client connection */
+		netstack_socket_close(mdctrl.active_sk);
+		netstack_socket_free(mdctrl.active_sk);
+		mdctrl.active_sk = NULL;
+	}
+
+fail1:
+	netstack_socket_close(mdctrl.sk);
+fail:
+	netstack_socket_free(mdctrl.sk);
+	mdctrl.sk = NULL;
+	return rc;
+}
+
+static int __init daemon_metricsd_init(void)
+{
+	u32 metricsd_priority;
+	u32 metricsd_time_slice;
+	struct vmm_devtree_node *node;
+
+	/* Reset metricsd control information */
+	memset(&mdctrl, 0, sizeof(mdctrl));
+
+	/* Retrive metricsd configuration */
+	node = vmm_devtree_getnode(VMM_DEVTREE_PATH_SEPARATOR_STRING
+				   VMM_DEVTREE_VMMINFO_NODE_NAME);
+	if (!node) {
+		return VMM_EFAIL;
+	}
+	if (vmm_devtree_read_u32(node,
+				 "metricsd_priority", &metricsd_priority)) {
+		metricsd_priority = VMM_THREAD_DEF_PRIORITY;
+	}
+	if (vmm_devtree_read_u32(node,
+				 "metricsd_time_slice", &metricsd_time_slice)) {
+		metricsd_time_slice = VMM_THREAD_DEF_TIME_SLICE;
+	}
+	if (vmm_devtree_read_u32(node,
+				 "metricsd_port", &mdctrl.port)) {
+		mdctrl.port = METRICSD_DEFAULT_PORT;
+	}
+	vmm_devtree_dref_node(node);
+
+	/* Allocate response buffer */
+	mdctrl.buf_size = CONFIG_METRICSD_BUFFER_SIZE_KB * 1024;
+	mdctrl.buf = vmm_malloc(mdctrl.buf_size);
+	if (!mdctrl.buf) {
+		return VMM_ENOMEM;
+	}
+
+	/* Create metricsd main thread */
+	mdctrl.main_thread = vmm_threads_create("metricsd",
+						&metricsd_main,
+						NULL,
+						metricsd_priority,
+						metricsd_time_slice);
+	if (!mdctrl.main_thread) {
+		vmm_free(mdctrl.buf);
+		return VMM_EFAIL;
+	}
+
+	/* Start metricsd main thread */
+	vmm_threads_start(mdctrl.main_thread);
+
+	return VMM_OK;
+}
+
+static void __exit daemon_metricsd_exit(void)
+{
+	/* Stop and destroy metricsd main thread */
+	vmm_threads_stop(mdctrl.main_thread);
+	vmm_threads_destroy(mdctrl.main_thread);
+
+	vmm_free(mdctrl.buf);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -23,4 +23,8 @@
 
 daemons-objs-$(CONFIG_MTERM)+= mterm.o
 daemons-objs-$(CONFIG_TELNETD)+= telnetd.o
+daemons-objs-$(CONFIG_VNCD)+= vncd.o
+daemons-objs-$(CONFIG_METRICSD)+= metricsd.o
 
+daemons-objs-$(CONFIG_IRQBALANCE)+= irqbalance.o
+daemons-objs-$(CONFIG_SAMEPAGE)+= samepage.o
@@ -0,0 +1,365 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file samepage.c
+ * @author agent (agent@local)
+ * @brief guest RAM samepage scanning daemon
+ *
+ * The daemon periodically hashes every host RAM page backing guest RAM
+ * regions and counts zero pages and pages identical to another page.
+ * These are the pages which samepage merging could share between guests
+ * and the result of last scan round is shown by samepage command.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_heap.h>
+#include <vmm_delay.h>
+#include <vmm_spinlocks.h>
+#include <vmm_threads.h>
+#include <vmm_manager.h>
+#include <vmm_guest_aspace.h>
+#include <vmm_host_aspace.h>
+#include <vmm_modules.h>
+#include <vmm_cmdmgr.h>
+#include <libs/stringlib.h>
+#include <libs/libsort.h>
+
+#define MODULE_DESC			"Samepage Scanning Daemon"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		0
+#define	MODULE_INIT			daemon_samepage_init
+#define	MODULE_EXIT			daemon_samepage_exit
+
+#define SAMEPAGE_PERIOD_MSECS		CONFIG_SAMEPAGE_PERIOD_MSECS
+#define SAMEPAGE_MAX_PAGES		CONFIG_SAMEPAGE_MAX_PAGES
+#define SAMEPAGE_MAX_RANGES		64
+#define SAMEPAGE_BATCH_PAGES		64
+
+struct samepage_range {
+	physical_addr_t hpa;
+	physical_size_t size;
+};
+
+struct samepage_entry {
+	u64 hash;
+	physical_addr_t hpa;
+};
+
+struct samepage_stats {
+	u32 rounds;
+	u32 guests;
+	u64 pages;
+	u64 zero_pages;
+	u64 same_pages;
+	u64 skipped_pages;
+};
+
+static struct samepage_ctrl {
+	struct vmm_thread *thread;
+	u32 range_count;
+	struct samepage_range ranges[SAMEPAGE_MAX_RANGES];
+	u32 entry_count;
+	struct samepage_entry *entries;
+	u64 *page;
+	u64 *cmp_page;
+	vmm_spinlock_t lock;
+	struct samepage_stats stats;
+} spctrl;
+
+/* FNV-1a over page words hence zero page hashes to offset basis */
+static u64 samepage_hash(const u64 *page, bool *is_zero)
+{
+	u32 i;
+	u64 w, any = 0, hash = 0xcbf29ce484222325ULL;
+
+	for (i = 0; i < (VMM_PAGE_SIZE / sizeof(u64)); i++) {
+		w = page[i];
+		any |= w;
+		hash = (hash ^ w) * 0x100000001b3ULL;
+	}
+	*is_zero = (any) ? FALSE : TRUE;
+
+	return hash;
+}
+
+static int samepage_region_iter(struct vmm_guest *guest,
+				struct vmm_region *reg, void *priv)
+{
+	struct samepage_stats *st = priv;
+
+	/* Shared regions are already backed by template pages */
+	if (reg->flags & VMM_REGION_ISSHARED) {
+		return VMM_OK;
+	}
+
+	if (spctrl.range_count < SAMEPAGE_MAX_RANGES) {
+		spctrl.ranges[spctrl.range_count].hpa = reg->hphys_addr;
+		spctrl.ranges[spctrl.range_count].size = reg->phys_size;
+		spctrl.range_count++;
+	} else {
+		st->skipped_pages += reg->phys_size >> VMM_PAGE_SHIFT;
+	}
+
+	return VMM_OK;
+}
+
+static int samepage_guest_iter(struct vmm_guest *guest, void *priv)
+{
+	struct samepage_stats *st = priv;
+
+	st->guests++;
+
+	return vmm_guest_iterate_mem_regions(guest,
+			VMM_REGION_REAL | VMM_REGION_MEMORY |
+			VMM_REGION_ISRAM | VMM_REGION_ISHOSTRAM,
+			samepage_region_iter, priv);
+}
+
+static int samepage_cmp(void *m, size_t a, size_t b)
+{
+	struct samepage_entry *ent = m;
+
+	return (ent[a].hash < ent[b].hash) ? 1 : 0;
+}
+
+static void samepage_swap(void *m, size_t a, size_t b)
+{
+	struct samepage_entry tmp, *ent = m;
+
+	tmp = ent[a];
+	ent[a] = ent[b];
+	ent[b] = tmp;
+}
+
+static bool samepage_read(physical_addr_t hpa, u64 *page)
+{
+	return (vmm_host_memory_read(hpa, page, VMM_PAGE_SIZE, TRUE) ==
+						VMM_PAGE_SIZE) ? TRUE : FALSE;
+}
+
+static void samepage_scan(void)
+{
+	bool is_zero;
+	u32 r, e, first, batch = 0;
+	physical_addr_t hpa, end;
+	struct samepage_stats st;
+	irq_flags_t flags;
+
+	memset(&st, 0, sizeof(st));
+
+	/* Snapshot guest RAM ranges so that no lock is held while hashing.
+	 * A range freed meanwhile only yields stale page contents.
+	 */
+	spctrl.range_count = 0;
+	vmm_manager_guest_iterate(samepage_guest_iter, &st);
+
+	/* Hash all pages of guest RAM ranges */
+	spctrl.entry_count = 0;
+	for (r = 0; r < spctrl.range_count; r++) {
+		hpa = spctrl.ranges[r].hpa;
+		end = hpa + spctrl.ranges[r].size;
+		for (; hpa < end; hpa += VMM_PAGE_SIZE) {
+			if (spctrl.entry_count == SAMEPAGE_MAX_PAGES) {
+				st.skipped_pages += (end - hpa) >> VMM_PAGE_SHIFT;
+				break;
+			}
+			if (!samepage_read(hpa, spctrl.page)) {
+				continue;
+			}
+			st.pages++;
+			spctrl.entries[spctrl.entry_count].hash =
+					samepage_hash(spctrl.page, &is_zero);
+			if (is_zero) {
+				st.zero_pages++;
+			} else {
+				spctrl.entries[spctrl.entry_count].hpa = hpa;
+				spctrl.entry_count++;
+			}
+			if (++batch == SAMEPAGE_BATCH_PAGES) {
+				batch = 0;
+				vmm_msleep(1);
+			}
+		}
+	}
+
+	/* Pages with same hash are compared against first page of the
+	 * run so hash collisions are not counted as same pages.
+	 */
+	libsort_smoothsort(spctrl.entries, 0, spctrl.entry_count,
+			   samepage_cmp, samepage_swap);
+	first = 0;
+	for (e = 1; e < spctrl.entry_count; e++) {
+		if (spctrl.entries[e].hash != spctrl.entries[first].hash) {
+			first = e;
+			continue;
+		}
+		if (!samepage_read(spctrl.entries[first].hpa, spctrl.page) ||
+		    !samepage_read(spctrl.entries[e].hpa, spctrl.cmp_page)) {
+			continue;
+		}
+		if (!memcmp(spctrl.page, spctrl.cmp_page, VMM_PAGE_SIZE)) {
+			st.same_pages++;
+		}
+		if (++batch == SAMEPAGE_BATCH_PAGES) {
+			batch = 0;
+			vmm_msleep(1);
+		}
+	}
+
+	vmm_spin_lock_irqsave(&spctrl.lock, flags);
+	st.rounds = spctrl.stats.rounds + 1;
+	spctrl.stats = st;
+	vmm_spin_unlock_irqrestore(&spctrl.lock, flags);
+}
+
+static int samepage_main(void *udata)
+{
+	while (1) {
+		vmm_msleep(SAMEPAGE_PERIOD_MSECS);
+		samepage_scan();
+	}
+
+	return VMM_OK;
+}
+
+static void cmd_samepage_usage(struct vmm_chardev *cdev)
+{
+	vmm_cprintf(cdev, "Usage:\n");
+	vmm_cprintf(cdev, "   samepage help\n");
+	vmm_cprintf(cdev, "   samepage stats\n");
+}
+
+static int cmd_samepage_stats(struct vmm_chardev *cdev)
+{
+	irq_flags_t flags;
+	struct samepage_stats st;
+
+	vmm_spin_lock_irqsave(&spctrl.lock, flags);
+	st = spctrl.stats;
+	vmm_spin_unlock_irqrestore(&spctrl.lock, flags);
+
+	if (!st.rounds) {
+		vmm_cprintf(cdev, "No scan round completed yet\n");
+		return VMM_OK;
+	}
+
+	vmm_cprintf(cdev, "Scan rounds    : %d\n", st.rounds);
+	vmm_cprintf(cdev, "Guests         : %d\n", st.guests);
+	vmm_cprintf(cdev, "Scanned pages  : %"PRIu64"\n", st.pages);
+	vmm_cprintf(cdev, "Skipped pages  : %"PRIu64"\n", st.skipped_pages);
+	vmm_cprintf(cdev, "Zero pages     : %"PRIu64"\n", st.zero_pages);
+	vmm_cprintf(cdev, "Same pages     : %"PRIu64"\n", st.same_pages);
+	vmm_cprintf(cdev, "Mergeable      : %"PRIu64" KB\n",
+		    ((st.zero_pages + st.same_pages) * VMM_PAGE_SIZE) >> 10);
+
+	return VMM_OK;
+}
+
+static int cmd_samepage_exec(struct vmm_chardev *cdev, int argc, char **argv)
+{
+	if (argc == 2) {
+		if (strcmp(argv[1], "help") == 0) {
+			cmd_samepage_usage(cdev);
+			return VMM_OK;
+		} else if (strcmp(argv[1], "stats") == 0) {
+			return cmd_samepage_stats(cdev);
+		}
+	}
+
+	cmd_samepage_usage(cdev);
+
+	return VMM_EFAIL;
+}
+
+static struct vmm_cmd cmd_samepage = {
+	.name = "samepage",
+	.desc = "guest RAM samepage statistics",
+	.usage = cmd_samepage_usage,
+	.exec = cmd_samepage_exec,
+};
+
+static int __init daemon_samepage_init(void)
+{
+	int rc;
+
+	/* Reset the control structure */
+	memset(&spctrl, 0, sizeof(spctrl));
+	INIT_SPIN_LOCK(&spctrl.lock);
+
+	spctrl.entries = vmm_malloc(sizeof(*spctrl.entries) *
+				    SAMEPAGE_MAX_PAGES);
+	if (!spctrl.entries) {
+		return VMM_ENOMEM;
+	}
+	spctrl.page = vmm_malloc(2 * VMM_PAGE_SIZE);
+	if (!spctrl.page) {
+		rc = VMM_ENOMEM;
+		goto fail_free_entries;
+	}
+	spctrl.cmp_page = spctrl.page + (VMM_PAGE_SIZE / sizeof(u64));
+
+	if ((rc = vmm_cmdmgr_register_cmd(&cmd_samepage))) {
+		goto fail_free_page;
+	}
+
+	/* Create samepage thread */
+	spctrl.thread = vmm_threads_create("samepage",
+					   &samepage_main,
+					   NULL,
+					   VMM_THREAD_MIN_PRIORITY,
+					   VMM_THREAD_DEF_TIME_SLICE);
+	if (!spctrl.thread) {
+		rc = VMM_EFAIL;
+		goto fail_unreg_cmd;
+	}
+
+	/* Start the samepage thread */
+	vmm_threads_start(spctrl.thread);
+
+	return VMM_OK;
+
+fail_unreg_cmd:
+	vmm_cmdmgr_unregister_cmd(&cmd_samepage);
+fail_free_page:
+	vmm_free(spctrl.page);
+fail_free_entries:
+	vmm_free(spctrl.entries);
+	return rc;
+}
+
+static void __exit daemon_samepage_exit(void)
+{
+	vmm_threads_stop(spctrl.thread);
+
+	vmm_threads_destroy(spctrl.thread);
+
+	vmm_cmdmgr_unregister_cmd(&cmd_samepage);
+
+	vmm_free(spctrl.page);
+
+	vmm_free(spctrl.entries);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
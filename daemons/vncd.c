@@ -0,0 +1,1271 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file vncd.c
+ * @author agent (agent@local)
+ * @brief VNC server streaming virtual display surfaces
+ *
+ * The daemon adds its own surface to a virtual display and tracks the
+ * parts updated by display emulator as dirty tiles. On each framebuffer
+ * update request only dirty tiles whose pixels differ from the copy last
+ * sent to client (shadow) are sent, using Raw encoding so that any RFB
+ * client can connect. Key and pointer events of client are passed to
+ * virtual keyboard and virtual mouse.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_heap.h>
+#include <vmm_host_aspace.h>
+#include <vmm_devtree.h>
+#include <vmm_threads.h>
+#include <vmm_spinlocks.h>
+#include <vmm_mutex.h>
+#include <vmm_modules.h>
+#include <vio/vmm_keymaps.h>
+#include <vio/vmm_vinput.h>
+#include <vio/vmm_vdisplay.h>
+#include <libs/stringlib.h>
+#include <libs/bitmap.h>
+#include <libs/netstack.h>
+
+#define MODULE_DESC			"VNC Server Daemon"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(NETSTACK_IPRIORITY + 1)
+#define	MODULE_INIT			daemon_vncd_init
+#define	MODULE_EXIT			daemon_vncd_exit
+
+#undef VNCD_DEBUG
+
+#if defined(VNCD_DEBUG)
+#define VNCD_DPRINTF(msg...)		vmm_printf(msg)
+#else
+#define VNCD_DPRINTF(msg...)
+#endif
+
+#define VNCD_DEFAULT_PORT		5900
+#define VNCD_DEFAULT_WIDTH		800
+#define VNCD_DEFAULT_HEIGHT		600
+#define VNCD_TILE_SIZE			64
+#define VNCD_TX_BUFFER_SIZE		4096
+#define VNCD_RX_BUFFER_SIZE		64
+
+/* RFB client to server messages */
+#define VNCD_MSG_SET_PIXEL_FORMAT	0
+#define VNCD_MSG_SET_ENCODINGS		2
+#define VNCD_MSG_FB_UPDATE_REQUEST	3
+#define VNCD_MSG_KEY_EVENT		4
+#define VNCD_MSG_POINTER_EVENT		5
+#define VNCD_MSG_CLIENT_CUT_TEXT	6
+
+/* RFB server to client messages */
+#define VNCD_MSG_FB_UPDATE		0
+
+#define VNCD_ENCODING_RAW		0
+#define VNCD_SECURITY_NONE		1
+
+enum vncd_state {
+	VNCD_STATE_VERSION = 0,
+	VNCD_STATE_SECURITY,
+	VNCD_STATE_CLIENT_INIT,
+	VNCD_STATE_NORMAL,
+};
+
+/* Pixel format expected by client */
+struct vncd_pixfmt {
+	u8 bpp;
+	bool big_endian;
+	u32 rtab[256];
+	u32 gtab[256];
+	u32 btab[256];
+};
+
+static struct vncd_ctrl {
+	u32 port;
+	u32 refresh_msecs;
+	char display_name[VMM_FIELD_NAME_SIZE];
+	char keyboard_name[VMM_FIELD_NAME_SIZE];
+	char mouse_name[VMM_FIELD_NAME_SIZE];
+	struct netstack_socket *sk;
+	struct netstack_socket *active_sk;
+	struct vmm_thread *main_thread;
+	struct vmm_notifier_block vdis_client;
+	struct vmm_notifier_block vinp_client;
+
+	/* Virtual devices of current connection (protected by dev_lock) */
+	struct vmm_mutex dev_lock;
+	struct vmm_vdisplay *vdis;
+	struct vmm_vkeyboard *vkbd;
+	struct vmm_vmouse *vmou;
+
+	/* Surface of current connection */
+	bool surface_added;
+	struct vmm_surface surface;
+	u8 *data;
+	u32 data_pages;
+	u8 *shadow;
+	u32 shadow_pages;
+
+	/* Dirty tiles of surface (protected by dirty_lock) */
+	vmm_spinlock_t dirty_lock;
+	u32 tiles_x;
+	u32 tiles_y;
+	unsigned long *dirty;
+	unsigned long *pending;
+
+	/* Protocol state of current connection */
+	enum vncd_state state;
+	u32 minor;
+	bool update_requested;
+	bool full_update;
+	u32 buttons;
+	int last_x;
+	int last_y;
+	struct vncd_pixfmt cpf;
+	u32 rx_len;
+	u32 rx_skip;
+	u8 rx_buf[VNCD_RX_BUFFER_SIZE];
+	u32 tx_len;
+	u8 tx_buf[VNCD_TX_BUFFER_SIZE];
+} vnctrl;
+
+/* Map of X11 keysyms (as used by RFB) to virtual keys for US layout.
+ * Shifted characters map to the unshifted key because client sends
+ * shift key events separately.
+ */
+struct vncd_keysym {
+	u32 keysym;
+	int vkey;
+};
+
+#define VNCD_KEY(__sym, __vkey)		{ (__sym), (__vkey) }
+#define VNCD_KEY2(__sym1, __sym2, __vkey)	\
+	{ (__sym1), (__vkey) }, { (__sym2), (__vkey) }
+
+static const struct vncd_keysym vncd_keysyms[] = {
+	VNCD_KEY2('a', 'A', VMM_VKEY_A), VNCD_KEY2('b', 'B', VMM_VKEY_B),
+	VNCD_KEY2('c', 'C', VMM_VKEY_C), VNCD_KEY2('d', 'D', VMM_VKEY_D),
+	VNCD_KEY2('e', 'E', VMM_VKEY_E), VNCD_KEY2('f', 'F', VMM_VKEY_F),
+	VNCD_KEY2('g', 'G', VMM_VKEY_G), VNCD_KEY2('h', 'H', VMM_VKEY_H),
+	VNCD_KEY2('i', 'I', VMM_VKEY_I), VNCD_KEY2('j', 'J', VMM_VKEY_J),
+	VNCD_KEY2('k', 'K', VMM_VKEY_K), VNCD_KEY2('l', 'L', VMM_VKEY_L),
+	VNCD_KEY2('m', 'M', VMM_VKEY_M), VNCD_KEY2('n', 'N', VMM_VKEY_N),
+	VNCD_KEY2('o', 'O', VMM_VKEY_O), VNCD_KEY2('p', 'P', VMM_VKEY_P),
+	VNCD_KEY2('q', 'Q', VMM_VKEY_Q), VNCD_KEY2('r', 'R', VMM_VKEY_R),
+	VNCD_KEY2('s', 'S', VMM_VKEY_S), VNCD_KEY2('t', 'T', VMM_VKEY_T),
+	VNCD_KEY2('u', 'U', VMM_VKEY_U), VNCD_KEY2('v', 'V', VMM_VKEY_V),
+	VNCD_KEY2('w', 'W', VMM_VKEY_W), VNCD_KEY2('x', 'X', VMM_VKEY_X),
+	VNCD_KEY2('y', 'Y', VMM_VKEY_Y), VNCD_KEY2('z', 'Z', VMM_VKEY_Z),
+	VNCD_KEY2('1', '!', VMM_VKEY_1), VNCD_KEY2('2', '@', VMM_VKEY_2),
+	VNCD_KEY2('3', '#', VMM_VKEY_3), VNCD_KEY2('4', '$', VMM_VKEY_4),
+	VNCD_KEY2('5', '%', VMM_VKEY_5), VNCD_KEY2('6', '^', VMM_VKEY_6),
+	VNCD_KEY2('7', '&', VMM_VKEY_7), VNCD_KEY2('8', '*', VMM_VKEY_8),
+	VNCD_KEY2('9', '(', VMM_VKEY_9), VNCD_KEY2('0', ')', VMM_VKEY_0),
+	VNCD_KEY2('-', '_', VMM_VKEY_MINUS),
+	VNCD_KEY2('=', '+', VMM_VKEY_EQUAL),
+	VNCD_KEY2('[', '{', VMM_VKEY_BRACKET_LEFT),
+	VNCD_KEY2(']', '}', VMM_VKEY_BRACKET_RIGHT),
+	VNCD_KEY2(';', ':', VMM_VKEY_SEMICOLON),
+	VNCD_KEY2('\'', '"', VMM_VKEY_APOSTROPHE),
+	VNCD_KEY2('`', '~', VMM_VKEY_GRAVE_ACCENT),
+	VNCD_KEY2('\\', '|', VMM_VKEY_BACKSLASH),
+	VNCD_KEY2(',', '<', VMM_VKEY_COMMA),
+	VNCD_KEY2('.', '>', VMM_VKEY_DOT),
+	VNCD_KEY2('/', '?', VMM_VKEY_SLASH),
+	VNCD_KEY(' ', VMM_VKEY_SPC),
+	VNCD_KEY(0xff08, VMM_VKEY_BACKSPACE),
+	VNCD_KEY(0xff09, VMM_VKEY_TAB),
+	VNCD_KEY(0xff0d, VMM_VKEY_RET),
+	VNCD_KEY(0xff14, VMM_VKEY_SCROLL_LOCK),
+	VNCD_KEY(0xff15, VMM_VKEY_SYSRQ),
+	VNCD_KEY(0xff1b, VMM_VKEY_ESC),
+	VNCD_KEY(0xff50, VMM_VKEY_HOME),
+	VNCD_KEY(0xff51, VMM_VKEY_LEFT),
+	VNCD_KEY(0xff52, VMM_VKEY_UP),
+	VNCD_KEY(0xff53, VMM_VKEY_RIGHT),
+	VNCD_KEY(0xff54, VMM_VKEY_DOWN),
+	VNCD_KEY(0xff55, VMM_VKEY_PGUP),
+	VNCD_KEY(0xff56, VMM_VKEY_PGDN),
+	VNCD_KEY(0xff57, VMM_VKEY_END),
+	VNCD_KEY(0xff61, VMM_VKEY_PRINT),
+	VNCD_KEY(0xff63, VMM_VKEY_INSERT),
+	VNCD_KEY(0xff67, VMM_VKEY_MENU),
+	VNCD_KEY(0xff7f, VMM_VKEY_NUM_LOCK),
+	VNCD_KEY(0xff8d, VMM_VKEY_KP_ENTER),
+	VNCD_KEY(0xff95, VMM_VKEY_KP_7),
+	VNCD_KEY(0xff96, VMM_VKEY_KP_4),
+	VNCD_KEY(0xff97, VMM_VKEY_KP_8),
+	VNCD_KEY(0xff98, VMM_VKEY_KP_6),
+	VNCD_KEY(0xff99, VMM_VKEY_KP_2),
+	VNCD_KEY(0xff9a, VMM_VKEY_KP_9),
+	VNCD_KEY(0xff9b, VMM_VKEY_KP_3),
+	VNCD_KEY(0xff9c, VMM_VKEY_KP_1),
+	VNCD_KEY(0xff9d, VMM_VKEY_KP_5),
+	VNCD_KEY(0xff9e, VMM_VKEY_KP_0),
+	VNCD_KEY(0xff9f, VMM_VKEY_KP_DECIMAL),
+	VNCD_KEY(0xffaa, VMM_VKEY_KP_MULTIPLY),
+	VNCD_KEY(0xffab, VMM_VKEY_KP_ADD),
+	VNCD_KEY(0xffad, VMM_VKEY_KP_SUBTRACT),
+	VNCD_KEY(0xffae, VMM_VKEY_KP_DECIMAL),
+	VNCD_KEY(0xffaf, VMM_VKEY_KP_DIVIDE),
+	VNCD_KEY(0xffb0, VMM_VKEY_KP_0),
+	VNCD_KEY(0xffb1, VMM_VKEY_KP_1),
+	VNCD_KEY(0xffb2, VMM_VKEY_KP_2),
+	VNCD_KEY(0xffb3, VMM_VKEY_KP_3),
+	VNCD_KEY(0xffb4, VMM_VKEY_KP_4),
+	VNCD_KEY(0xffb5, VMM_VKEY_KP_5),
+	VNCD_KEY(0xffb6, VMM_VKEY_KP_6),
+	VNCD_KEY(0xffb7, VMM_VKEY_KP_7),
+	VNCD_KEY(0xffb8, VMM_VKEY_KP_8),
+	VNCD_KEY(0xffb9, VMM_VKEY_KP_9),
+	VNCD_KEY(0xffbe, VMM_VKEY_F1),
+	VNCD_KEY(0xffbf, VMM_VKEY_F2),
+	VNCD_KEY(0xffc0, VMM_VKEY_F3),
+	VNCD_KEY(0xffc1, VMM_VKEY_F4),
+	VNCD_KEY(0xffc2, VMM_VKEY_F5),
+	VNCD_KEY(0xffc3, VMM_VKEY_F6),
+	VNCD_KEY(0xffc4, VMM_VKEY_F7),
+	VNCD_KEY(0xffc5, VMM_VKEY_F8),
+	VNCD_KEY(0xffc6, VMM_VKEY_F9),
+	VNCD_KEY(0xffc7, VMM_VKEY_F10),
+	VNCD_KEY(0xffc8, VMM_VKEY_F11),
+	VNCD_KEY(0xffc9, VMM_VKEY_F12),
+	VNCD_KEY(0xffe1, VMM_VKEY_SHIFT),
+	VNCD_KEY(0xffe2, VMM_VKEY_SHIFT_R),
+	VNCD_KEY(0xffe3, VMM_VKEY_CTRL),
+	VNCD_KEY(0xffe4, VMM_VKEY_CTRL_R),
+	VNCD_KEY(0xffe5, VMM_VKEY_CAPS_LOCK),
+	VNCD_KEY(0xffe7, VMM_VKEY_META_L),
+	VNCD_KEY(0xffe8, VMM_VKEY_META_R),
+	VNCD_KEY(0xffe9, VMM_VKEY_ALT),
+	VNCD_KEY(0xffea, VMM_VKEY_ALT_R),
+	VNCD_KEY(0xffeb, VMM_VKEY_META_L),
+	VNCD_KEY(0xffec, VMM_VKEY_META_R),
+	VNCD_KEY(0xffff, VMM_VKEY_DELETE),
+	VNCD_KEY(0xfe03, VMM_VKEY_ALTGR),
+};
+
+static int vncd_keysym2vkey(u32 keysym)
+{
+	u32 i;
+
+	for (i = 0; i < array_size(vncd_keysyms); i++) {
+		if (vncd_keysyms[i].keysym == keysym) {
+			return vncd_keysyms[i].vkey;
+		}
+	}
+
+	return VMM_ENOTAVAIL;
+}
+
+static inline u16 vncd_get_be16(const u8 *p)
+{
+	return ((u16)p[0] << 8) | p[1];
+}
+
+static inline u32 vncd_get_be32(const u8 *p)
+{
+	return ((u32)p[0] << 24) | ((u32)p[1] << 16) |
+	       ((u32)p[2] << 8) | p[3];
+}
+
+static inline void vncd_put_be16(u8 *p, u16 val)
+{
+	p[0] = val >> 8;
+	p[1] = val;
+}
+
+static inline void vncd_put_be32(u8 *p, u32 val)
+{
+	p[0] = val >> 24;
+	p[1] = val >> 16;
+	p[2] = val >> 8;
+	p[3] = val;
+}
+
+static int vncd_flush_tx_buffer(void)
+{
+	int rc = VMM_OK;
+
+	if (vnctrl.tx_len) {
+		rc = netstack_socket_write(vnctrl.active_sk,
+					   vnctrl.tx_buf, vnctrl.tx_len);
+		vnctrl.tx_len = 0;
+	}
+
+	return rc;
+}
+
+static int vncd_fill_tx_buffer(const void *data, u32 len)
+{
+	int rc;
+	u32 count;
+	const u8 *src = data;
+
+	while (len) {
+		if (vnctrl.tx_len == VNCD_TX_BUFFER_SIZE) {
+			rc = vncd_flush_tx_buffer();
+			if (rc) {
+				return rc;
+			}
+		}
+		count = min(len, (u32)(VNCD_TX_BUFFER_SIZE - vnctrl.tx_len));
+		memcpy(&vnctrl.tx_buf[vnctrl.tx_len], src, count);
+		vnctrl.tx_len += count;
+		src += count;
+		len -= count;
+	}
+
+	return VMM_OK;
+}
+
+/* Send protocol data right away (used for handshake replies) */
+static int vncd_send(const void *data, u32 len)
+{
+	int rc;
+
+	rc = vncd_fill_tx_buffer(data, len);
+	if (rc) {
+		return rc;
+	}
+
+	return vncd_flush_tx_buffer();
+}
+
+static void vncd_set_pixfmt(u8 bpp, bool big_endian,
+			    u16 rmax, u16 gmax, u16 bmax,
+			    u8 rshift, u8 gshift, u8 bshift)
+{
+	u32 i;
+	struct vncd_pixfmt *cpf = &vnctrl.cpf;
+
+	cpf->bpp = bpp;
+	cpf->big_endian = big_endian;
+
+	/* Precompute channel conversion so that sending a
+	 * pixel only needs three table lookups.
+	 */
+	for (i = 0; i < 256; i++) {
+		cpf->rtab[i] = ((i * rmax + 127) / 255) << rshift;
+		cpf->gtab[i] = ((i * gmax + 127) / 255) << gshift;
+		cpf->btab[i] = ((i * bmax + 127) / 255) << bshift;
+	}
+}
+
+/* ===== Surface dirty tracking ===== */
+
+static void vncd_mark_dirty(int x, int y, int w, int h)
+{
+	u32 tx, ty, tx0, ty0, tx1, ty1;
+	irq_flags_t flags;
+
+	if (x < 0) {
+		w += x;
+		x = 0;
+	}
+	if (y < 0) {
+		h += y;
+		y = 0;
+	}
+	if ((w <= 0) || (h <= 0) ||
+	    (vnctrl.surface.width <= x) || (vnctrl.surface.height <= y)) {
+		return;
+	}
+
+	tx0 = x / VNCD_TILE_SIZE;
+	ty0 = y / VNCD_TILE_SIZE;
+	tx1 = min((u32)(x + w - 1) / VNCD_TILE_SIZE, vnctrl.tiles_x - 1);
+	ty1 = min((u32)(y + h - 1) / VNCD_TILE_SIZE, vnctrl.tiles_y - 1);
+
+	vmm_spin_lock_irqsave(&vnctrl.dirty_lock, flags);
+	for (ty = ty0; ty <= ty1; ty++) {
+		for (tx = tx0; tx <= tx1; tx++) {
+			bitmap_setbit(vnctrl.dirty, ty * vnctrl.tiles_x + tx);
+		}
+	}
+	vmm_spin_unlock_irqrestore(&vnctrl.dirty_lock, flags);
+}
+
+static void vncd_mark_all_dirty(void)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&vnctrl.dirty_lock, flags);
+	bitmap_fill(vnctrl.dirty, vnctrl.tiles_x * vnctrl.tiles_y);
+	vmm_spin_unlock_irqrestore(&vnctrl.dirty_lock, flags);
+}
+
+static void vncd_gfx_clear(struct vmm_surface *s)
+{
+	vncd_mark_all_dirty();
+}
+
+static void vncd_gfx_update(struct vmm_surface *s,
+			    int x, int y, int w, int h)
+{
+	vncd_mark_dirty(x, y, w, h);
+}
+
+static void vncd_gfx_resize(struct vmm_surface *s, int w, int h)
+{
+	vncd_mark_all_dirty();
+}
+
+static const struct vmm_surface_ops vncd_surface_ops = {
+	.gfx_clear = vncd_gfx_clear,
+	.gfx_update = vncd_gfx_update,
+	.gfx_resize = vncd_gfx_resize,
+};
+
+/* ===== Framebuffer updates ===== */
+
+static void vncd_tile_rect(u32 tile, u32 *x, u32 *y, u32 *w, u32 *h)
+{
+	*x = (tile % vnctrl.tiles_x) * VNCD_TILE_SIZE;
+	*y = (tile / vnctrl.tiles_x) * VNCD_TILE_SIZE;
+	*w = min((u32)VNCD_TILE_SIZE, (u32)vnctrl.surface.width - *x);
+	*h = min((u32)VNCD_TILE_SIZE, (u32)vnctrl.surface.height - *y);
+}
+
+static bool vncd_tile_changed(u32 tile)
+{
+	u32 x, y, w, h, off, stride = vmm_surface_stride(&vnctrl.surface);
+
+	vncd_tile_rect(tile, &x, &y, &w, &h);
+	off = y * stride + x * vnctrl.surface.pf.bytes_per_pixel;
+	while (h--) {
+		if (memcmp(&vnctrl.data[off], &vnctrl.shadow[off],
+			   w * vnctrl.surface.pf.bytes_per_pixel)) {
+			return TRUE;
+		}
+		off += stride;
+	}
+
+	return FALSE;
+}
+
+static int vncd_send_pixels(const u32 *src, u32 count)
+{
+	int rc;
+	u32 i, p, pos = 0;
+	u8 out[VNCD_TILE_SIZE * 4];
+	struct vmm_pixelformat *pf = &vnctrl.surface.pf;
+	struct vncd_pixfmt *cpf = &vnctrl.cpf;
+
+	for (i = 0; i < count; i++) {
+		p = src[i];
+		p = cpf->rtab[(p >> pf->rshift) & 0xff] |
+		    cpf->gtab[(p >> pf->gshift) & 0xff] |
+		    cpf->btab[(p >> pf->bshift) & 0xff];
+		switch (cpf->bpp) {
+		case 8:
+			out[pos++] = p;
+			break;
+		case 16:
+			if (cpf->big_endian) {
+				out[pos++] = p >> 8;
+				out[pos++] = p;
+			} else {
+				out[pos++] = p;
+				out[pos++] = p >> 8;
+			}
+			break;
+		default:
+			if (cpf->big_endian) {
+				vncd_put_be32(&out[pos], p);
+			} else {
+				out[pos] = p;
+				out[pos + 1] = p >> 8;
+				out[pos + 2] = p >> 16;
+				out[pos + 3] = p >> 24;
+			}
+			pos += 4;
+			break;
+		};
+		if (pos == sizeof(out)) {
+			rc = vncd_fill_tx_buffer(out, pos);
+			if (rc) {
+				return rc;
+			}
+			pos = 0;
+		}
+	}
+
+	return vncd_fill_tx_buffer(out, pos);
+}
+
+static int vncd_send_tile(u32 tile)
+{
+	int rc;
+	u8 hdr[12];
+	u32 x, y, w, h, off, stride = vmm_surface_stride(&vnctrl.surface);
+
+	vncd_tile_rect(tile, &x, &y, &w, &h);
+
+	vncd_put_be16(&hdr[0], x);
+	vncd_put_be16(&hdr[2], y);
+	vncd_put_be16(&hdr[4], w);
+	vncd_put_be16(&hdr[6], h);
+	vncd_put_be32(&hdr[8], VNCD_ENCODING_RAW);
+	rc = vncd_fill_tx_buffer(hdr, sizeof(hdr));
+	if (rc) {
+		return rc;
+	}
+
+	off = y * stride + x * vnctrl.surface.pf.bytes_per_pixel;
+	while (h--) {
+		rc = vncd_send_pixels((u32 *)&vnctrl.data[off], w);
+		if (rc) {
+			return rc;
+		}
+		/* Remember what client has seen */
+		memcpy(&vnctrl.shadow[off], &vnctrl.data[off],
+		       w * vnctrl.surface.pf.bytes_per_pixel);
+		off += stride;
+	}
+
+	return VMM_OK;
+}
+
+static int vncd_send_update(void)
+{
+	int rc;
+	u8 hdr[4];
+	u32 tile, count, ntiles = vnctrl.tiles_x * vnctrl.tiles_y;
+	irq_flags_t flags;
+
+	/* Let display emulator render into our surface */
+	vmm_mutex_lock(&vnctrl.dev_lock);
+	if (vnctrl.vdis) {
+		vmm_vdisplay_one_update(vnctrl.vdis, &vnctrl.surface);
+	}
+	vmm_mutex_unlock(&vnctrl.dev_lock);
+
+	/* Take dirty tiles accumulated so far */
+	vmm_spin_lock_irqsave(&vnctrl.dirty_lock, flags);
+	bitmap_or(vnctrl.pending, vnctrl.pending, vnctrl.dirty, ntiles);
+	bitmap_zero(vnctrl.dirty, ntiles);
+	vmm_spin_unlock_irqrestore(&vnctrl.dirty_lock, flags);
+
+	/* Drop dirty tiles which client already has */
+	count = 0;
+	for (tile = 0; tile < ntiles; tile++) {
+		if (!bitmap_isset(vnctrl.pending, tile)) {
+			continue;
+		}
+		if (!vnctrl.full_update && !vncd_tile_changed(tile)) {
+			bitmap_clearbit(vnctrl.pending, tile);
+			continue;
+		}
+		count++;
+	}
+
+	/* Incremental update request is answered only when
+	 * something changed so keep it pending till then.
+	 */
+	if (!count) {
+		return VMM_OK;
+	}
+
+	hdr[0] = VNCD_MSG_FB_UPDATE;
+	hdr[1] = 0;
+	vncd_put_be16(&hdr[2], count);
+	rc = vncd_fill_tx_buffer(hdr, sizeof(hdr));
+	if (rc) {
+		return rc;
+	}
+
+	for (tile = 0; tile < ntiles; tile++) {
+		if (!bitmap_isset(vnctrl.pending, tile)) {
+			continue;
+		}
+		rc = vncd_send_tile(tile);
+		if (rc) {
+			return rc;
+		}
+	}
+	bitmap_zero(vnctrl.pending, ntiles);
+
+	vnctrl.update_requested = FALSE;
+	vnctrl.full_update = FALSE;
+
+	return vncd_flush_tx_buffer();
+}
+
+/* ===== Connection setup ===== */
+
+static int vncd_find_vdisplay(struct vmm_vdisplay *vdis, void *data)
+{
+	*((struct vmm_vdisplay **)data) = vdis;
+	return 1;
+}
+
+static int vncd_find_vkeyboard(struct vmm_vkeyboard *vkbd, void *data)
+{
+	*((struct vmm_vkeyboard **)data) = vkbd;
+	return 1;
+}
+
+static int vncd_find_vmouse(struct vmm_vmouse *vmou, void *data)
+{
+	*((struct vmm_vmouse **)data) = vmou;
+	return 1;
+}
+
+static int vncd_bind(void)
+{
+	int rc;
+	u8 init[24];
+	u32 width, height, data_size, ntiles, name_len;
+	char name[VMM_FIELD_NAME_SIZE];
+	physical_addr_t pa;
+	struct vmm_pixelformat pf;
+
+	vmm_mutex_lock(&vnctrl.dev_lock);
+
+	vnctrl.vdis = NULL;
+	vnctrl.vkbd = NULL;
+	vnctrl.vmou = NULL;
+	if (vnctrl.display_name[0]) {
+		vnctrl.vdis = vmm_vdisplay_find(vnctrl.display_name);
+	} else {
+		vmm_vdisplay_iterate(NULL, &vnctrl.vdis, vncd_find_vdisplay);
+	}
+	if (vnctrl.keyboard_name[0]) {
+		vnctrl.vkbd = vmm_vkeyboard_find(vnctrl.keyboard_name);
+	} else {
+		vmm_vkeyboard_iterate(NULL, &vnctrl.vkbd, vncd_find_vkeyboard);
+	}
+	if (vnctrl.mouse_name[0]) {
+		vnctrl.vmou = vmm_vmouse_find(vnctrl.mouse_name);
+	} else {
+		vmm_vmouse_iterate(NULL, &vnctrl.vmou, vncd_find_vmouse);
+	}
+	if (!vnctrl.vdis) {
+		vmm_mutex_unlock(&vnctrl.dev_lock);
+		vmm_printf("vncd: no virtual display found\n");
+		return VMM_ENODEV;
+	}
+
+	/* Same resolution as current mode of virtual display */
+	vmm_pixelformat_init_default(&pf, 32);
+	if (vmm_vdisplay_get_pixeldata(vnctrl.vdis, &pf,
+				       &height, &width, &pa)) {
+		width = VNCD_DEFAULT_WIDTH;
+		height = VNCD_DEFAULT_HEIGHT;
+	}
+	vmm_pixelformat_init_default(&pf, 32);
+	strncpy(name, vnctrl.vdis->name, sizeof(name));
+
+	vmm_mutex_unlock(&vnctrl.dev_lock);
+
+	/* Surface and shadow copy sent to client */
+	data_size = width * height * pf.bytes_per_pixel;
+	vnctrl.data_pages = VMM_SIZE_TO_PAGE(data_size);
+	vnctrl.data = (u8 *)vmm_host_alloc_pages(vnctrl.data_pages,
+						VMM_MEMORY_FLAGS_NORMAL);
+	if (!vnctrl.data) {
+		return VMM_ENOMEM;
+	}
+	memset(vnctrl.data, 0, data_size);
+	vnctrl.shadow_pages = VMM_SIZE_TO_PAGE(data_size);
+	vnctrl.shadow = (u8 *)vmm_host_alloc_pages(vnctrl.shadow_pages,
+						VMM_MEMORY_FLAGS_NORMAL);
+	if (!vnctrl.shadow) {
+		return VMM_ENOMEM;
+	}
+	memset(vnctrl.shadow, 0, data_size);
+
+	/* Dirty tile bitmaps */
+	vnctrl.tiles_x = (width + VNCD_TILE_SIZE - 1) / VNCD_TILE_SIZE;
+	vnctrl.tiles_y = (height + VNCD_TILE_SIZE - 1) / VNCD_TILE_SIZE;
+	ntiles = vnctrl.tiles_x * vnctrl.tiles_y;
+	vnctrl.dirty = vmm_zalloc(bitmap_estimate_size(ntiles));
+	vnctrl.pending = vmm_zalloc(bitmap_estimate_size(ntiles));
+	if (!vnctrl.dirty || !vnctrl.pending) {
+		return VMM_ENOMEM;
+	}
+	bitmap_fill(vnctrl.dirty, ntiles);
+
+	rc = vmm_surface_init(&vnctrl.surface, "vncd",
+			      vnctrl.data, data_size, height, width,
+			      0, &pf, &vncd_surface_ops, NULL);
+	if (rc) {
+		return rc;
+	}
+
+	vmm_mutex_lock(&vnctrl.dev_lock);
+	if (vnctrl.vdis) {
+		rc = vmm_vdisplay_add_surface(vnctrl.vdis, &vnctrl.surface);
+		if (!rc) {
+			vnctrl.surface_added = TRUE;
+			vmm_vdisplay_invalidate(vnctrl.vdis);
+		}
+	} else {
+		rc = VMM_ENODEV;
+	}
+	vmm_mutex_unlock(&vnctrl.dev_lock);
+	if (rc) {
+		return rc;
+	}
+
+	/* Client starts with our native pixel format */
+	vncd_set_pixfmt(32, FALSE, 255, 255, 255, 16, 8, 0);
+
+	/* ServerInit */
+	name_len = strlen(name);
+	vncd_put_be16(&init[0], width);
+	vncd_put_be16(&init[2], height);
+	init[4] = 32;
+	init[5] = 24;
+	init[6] = 0;
+	init[7] = 1;
+	vncd_put_be16(&init[8], 255);
+	vncd_put_be16(&init[10], 255);
+	vncd_put_be16(&init[12], 255);
+	init[14] = 16;
+	init[15] = 8;
+	init[16] = 0;
+	init[17] = init[18] = init[19] = 0;
+	vncd_put_be32(&init[20], name_len);
+	rc = vncd_fill_tx_buffer(init, sizeof(init));
+	if (rc) {
+		return rc;
+	}
+
+	return vncd_send(name, name_len);
+}
+
+static void vncd_unbind(void)
+{
+	vmm_mutex_lock(&vnctrl.dev_lock);
+	if (vnctrl.surface_added && vnctrl.vdis) {
+		vmm_vdisplay_del_surface(vnctrl.vdis, &vnctrl.surface);
+	}
+	vnctrl.surface_added = FALSE;
+	vnctrl.vdis = NULL;
+	vnctrl.vkbd = NULL;
+	vnctrl.vmou = NULL;
+	vmm_mutex_unlock(&vnctrl.dev_lock);
+
+	if (vnctrl.dirty) {
+		vmm_free(vnctrl.dirty);
+		vnctrl.dirty = NULL;
+	}
+	if (vnctrl.pending) {
+		vmm_free(vnctrl.pending);
+		vnctrl.pending = NULL;
+	}
+	if (vnctrl.shadow) {
+		vmm_host_free_pages((virtual_addr_t)vnctrl.shadow,
+				    vnctrl.shadow_pages);
+		vnctrl.shadow = NULL;
+	}
+	if (vnctrl.data) {
+		vmm_host_free_pages((virtual_addr_t)vnctrl.data,
+				    vnctrl.data_pages);
+		vnctrl.data = NULL;
+	}
+}
+
+/* ===== Client messages ===== */
+
+static void vncd_key_event(bool down, u32 keysym)
+{
+	int vkey, keycode;
+
+	vkey = vncd_keysym2vkey(keysym);
+	if (vkey < 0) {
+		VNCD_DPRINTF("%s: unknown keysym 0x%x\n", __func__, keysym);
+		return;
+	}
+	keycode = vmm_vkey2keycode(vkey);
+	if (!keycode) {
+		return;
+	}
+
+	vmm_mutex_lock(&vnctrl.dev_lock);
+	if (vnctrl.vkbd) {
+		if (keycode & SCANCODE_GREY) {
+			vmm_vkeyboard_report(vnctrl.vkbd, SCANCODE_EMUL0);
+		}
+		keycode &= SCANCODE_KEYCODEMASK;
+		if (!down) {
+			keycode |= SCANCODE_UP;
+		}
+		vmm_vkeyboard_report(vnctrl.vkbd, keycode);
+		vmm_vkeyboard_sync(vnctrl.vkbd);
+	}
+	vmm_mutex_unlock(&vnctrl.dev_lock);
+}
+
+static void vncd_pointer_event(u8 mask, int x, int y)
+{
+	int dx, dy, dz = 0, w, h;
+	u32 buttons = 0;
+
+	if (mask & 0x01) {
+		buttons |= VMM_MOUSE_LBUTTON;
+	}
+	if (mask & 0x02) {
+		buttons |= VMM_MOUSE_MBUTTON;
+	}
+	if (mask & 0x04) {
+		buttons |= VMM_MOUSE_RBUTTON;
+	}
+	if (mask & 0x08) {
+		dz = -1;
+	} else if (mask & 0x10) {
+		dz = 1;
+	}
+
+	vmm_mutex_lock(&vnctrl.dev_lock);
+	if (vnctrl.vmou) {
+		if (vmm_vmouse_is_absolute(vnctrl.vmou)) {
+			w = max(vnctrl.surface.width - 1, 1);
+			h = max(vnctrl.surface.height - 1, 1);
+			dx = (x * 0x7fff) / w;
+			dy = (y * 0x7fff) / h;
+		} else {
+			dx = x - vnctrl.last_x;
+			dy = y - vnctrl.last_y;
+		}
+		if (dx || dy || dz || (buttons != vnctrl.buttons) ||
+		    vmm_vmouse_is_absolute(vnctrl.vmou)) {
+			vmm_vmouse_report(vnctrl.vmou, dx, dy, dz, buttons);
+			vmm_vmouse_sync(vnctrl.vmou);
+		}
+	}
+	vmm_mutex_unlock(&vnctrl.dev_lock);
+
+	vnctrl.last_x = x;
+	vnctrl.last_y = y;
+	vnctrl.buttons = buttons;
+}
+
+/* Process one complete message from Rx buffer.
+ * Returns number of bytes consumed (zero if incomplete)
+ * or negative error code to drop the connection.
+ */
+static int vncd_process_message(const u8 *msg, u32 len)
+{
+	int rc;
+	u8 reply[8];
+
+	switch (vnctrl.state) {
+	case VNCD_STATE_VERSION:
+		if (len < 12) {
+			return 0;
+		}
+		if (memcmp(msg, "RFB 003.", 8)) {
+			return VMM_EINVALID;
+		}
+		vnctrl.minor = (msg[9] - '0') * 10 + (msg[10] - '0');
+		if (vnctrl.minor >= 8) {
+			vnctrl.minor = 8;
+		} else if (vnctrl.minor != 7) {
+			vnctrl.minor = 3;
+		}
+		if (vnctrl.minor == 3) {
+			/* Server decides security type */
+			vncd_put_be32(reply, VNCD_SECURITY_NONE);
+			rc = vncd_send(reply, 4);
+			vnctrl.state = VNCD_STATE_CLIENT_INIT;
+		} else {
+			reply[0] = 1;
+			reply[1] = VNCD_SECURITY_NONE;
+			rc = vncd_send(reply, 2);
+			vnctrl.state = VNCD_STATE_SECURITY;
+		}
+		return (rc) ? rc : 12;
+	case VNCD_STATE_SECURITY:
+		if (len < 1) {
+			return 0;
+		}
+		if (msg[0] != VNCD_SECURITY_NONE) {
+			return VMM_EINVALID;
+		}
+		rc = VMM_OK;
+		if (vnctrl.minor == 8) {
+			/* SecurityResult OK */
+			vncd_put_be32(reply, 0);
+			rc = vncd_send(reply, 4);
+		}
+		vnctrl.state = VNCD_STATE_CLIENT_INIT;
+		return (rc) ? rc : 1;
+	case VNCD_STATE_CLIENT_INIT:
+		if (len < 1) {
+			return 0;
+		}
+		/* Shared flag is ignored because we serve one client */
+		rc = vncd_bind();
+		vnctrl.state = VNCD_STATE_NORMAL;
+		return (rc) ? rc : 1;
+	default:
+		break;
+	};
+
+	if (len < 1) {
+		return 0;
+	}
+
+	switch (msg[0]) {
+	case VNCD_MSG_SET_PIXEL_FORMAT:
+		if (len < 20) {
+			return 0;
+		}
+		/* Only true colour formats are supported */
+		if (!msg[7] ||
+		    ((msg[4] != 8) && (msg[4] != 16) && (msg[4] != 32))) {
+			return VMM_ENOTSUPP;
+		}
+		vncd_set_pixfmt(msg[4], (msg[6]) ? TRUE : FALSE,
+				vncd_get_be16(&msg[8]),
+				vncd_get_be16(&msg[10]),
+				vncd_get_be16(&msg[12]),
+				msg[14], msg[15], msg[16]);
+		vnctrl.full_update = TRUE;
+		vncd_mark_all_dirty();
+		return 20;
+	case VNCD_MSG_SET_ENCODINGS:
+		if (len < 4) {
+			return 0;
+		}
+		/* Raw encoding is always supported so list is skipped */
+		vnctrl.rx_skip = vncd_get_be16(&msg[2]) * 4;
+		return 4;
+	case VNCD_MSG_FB_UPDATE_REQUEST:
+		if (len < 10) {
+			return 0;
+		}
+		if (!msg[1]) {
+			vnctrl.full_update = TRUE;
+			vncd_mark_all_dirty();
+		}
+		vnctrl.update_requested = TRUE;
+		return 10;
+	case VNCD_MSG_KEY_EVENT:
+		if (len < 8) {
+			return 0;
+		}
+		vncd_key_event((msg[1]) ? TRUE : FALSE, vncd_get_be32(&msg[4]));
+		return 8;
+	case VNCD_MSG_POINTER_EVENT:
+		if (len < 6) {
+			return 0;
+		}
+		vncd_pointer_event(msg[1], vncd_get_be16(&msg[2]),
+				   vncd_get_be16(&msg[4]));
+		return 6;
+	case VNCD_MSG_CLIENT_CUT_TEXT:
+		if (len < 8) {
+			return 0;
+		}
+		vnctrl.rx_skip = vncd_get_be32(&msg[4]);
+		return 8;
+	default:
+		break;
+	};
+
+	VNCD_DPRINTF("%s: unknown message %d\n", __func__, msg[0]);
+
+	return VMM_EINVALID;
+}
+
+static int vncd_process_data(const u8 *data, u32 len)
+{
+	int rc;
+	u32 count, pos;
+
+	while (len) {
+		/* Skip variable length payloads we don't need */
+		if (vnctrl.rx_skip) {
+			count = min(len, vnctrl.rx_skip);
+			vnctrl.rx_skip -= count;
+			data += count;
+			len -= count;
+			continue;
+		}
+
+		count = min(len, (u32)(VNCD_RX_BUFFER_SIZE - vnctrl.rx_len));
+		memcpy(&vnctrl.rx_buf[vnctrl.rx_len], data, count);
+		vnctrl.rx_len += count;
+		data += count;
+		len -= count;
+
+		pos = 0;
+		while (!vnctrl.rx_skip && (pos < vnctrl.rx_len)) {
+			rc = vncd_process_message(&vnctrl.rx_buf[pos],
+						  vnctrl.rx_len - pos);
+			if (rc < 0) {
+				return rc;
+			} else if (!rc) {
+				break;
+			}
+			pos += rc;
+		}
+
+		/* Bytes of skipped payload already in Rx buffer */
+		count = min(vnctrl.rx_len - pos, vnctrl.rx_skip);
+		vnctrl.rx_skip -= count;
+		pos += count;
+
+		vnctrl.rx_len -= pos;
+		memmove(vnctrl.rx_buf, &vnctrl.rx_buf[pos], vnctrl.rx_len);
+	}
+
+	return VMM_OK;
+}
+
+static int vncd_recv(int timeout)
+{
+	int rc;
+	struct netstack_socket_buf buf;
+
+	rc = netstack_socket_recv(vnctrl.active_sk, &buf, timeout);
+	if (rc == VMM_ETIMEDOUT) {
+		return VMM_OK;
+	} else if (rc) {
+		return rc;
+	}
+
+	do {
+		rc = vncd_process_data(buf.data, buf.len);
+		if (rc) {
+			break;
+		}
+	} while (netstack_socket_nextbuf(&buf) == VMM_OK);
+
+	netstack_socket_freebuf(&buf);
+
+	return rc;
+}
+
+static void vncd_serve(void)
+{
+	int rc;
+
+	vnctrl.state = VNCD_STATE_VERSION;
+	vnctrl.update_requested = FALSE;
+	vnctrl.full_update = TRUE;
+	vnctrl.buttons = 0;
+	vnctrl.last_x = vnctrl.last_y = 0;
+	vnctrl.rx_len = vnctrl.rx_skip = vnctrl.tx_len = 0;
+
+	/* ProtocolVersion */
+	rc = vncd_send("RFB 003.008\n", 12);
+
+	while (!rc) {
+		rc = vncd_recv((vnctrl.update_requested) ?
+				vnctrl.refresh_msecs : 0);
+		if (!rc && vnctrl.update_requested) {
+			rc = vncd_send_update();
+		}
+	}
+
+	VNCD_DPRINTF("%s: connection closed (error %d)\n", __func__, rc);
+
+	vncd_unbind();
+}
+
+static int vncd_main(void *data)
+{
+	int rc;
+
+	/* Create a new socket. */
+	vnctrl.sk = netstack_socket_alloc(NETSTACK_SOCKET_TCP);
+	if (!vnctrl.sk) {
+		return VMM_ENOMEM;
+	}
+
+	/* Bind socket to port number */
+	rc = netstack_socket_bind(vnctrl.sk, NULL, vnctrl.port);
+	if (rc) {
+		goto fail;
+	}
+
+	/* Tell socket to go into listening mode. */
+	rc = netstack_socket_listen(vnctrl.sk);
+	if (rc) {
+		goto fail1;
+	}
+
+	while (1) {
+		/* Grab new connect request. */
+		rc = netstack_socket_accept(vnctrl.sk, &vnctrl.active_sk);
+		if (rc) {
+			goto fail1;
+		}
+
+		vncd_serve();
+
+		/* Close and free client connection */
+		netstack_socket_close(vnctrl.active_sk);
+		netstack_socket_free(vnctrl.active_sk);
+		vnctrl.active_sk = NULL;
+	}
+
+fail1:
+	netstack_socket_close(vnctrl.sk);
+fail:
+	netstack_socket_free(vnctrl.sk);
+	vnctrl.sk = NULL;
+	return rc;
+}
+
+static int vncd_vdisplay_notification(struct vmm_notifier_block *nb,
+				      unsigned long evt, void *data)
+{
+	struct vmm_vdisplay_event *event = data;
+
+	if (evt == VMM_VDISPLAY_EVENT_DESTROY) {
+		vmm_mutex_lock(&vnctrl.dev_lock);
+		if (vnctrl.vdis == event->data) {
+			/* Surfaces are removed by virtual display */
+			vnctrl.vdis = NULL;
+			vnctrl.surface_added = FALSE;
+		}
+		vmm_mutex_unlock(&vnctrl.dev_lock);
+		return NOTIFY_OK;
+	}
+
+	return NOTIFY_DONE;
+}
+
+static int vncd_vinput_notification(struct vmm_notifier_block *nb,
+				    unsigned long evt, void *data)
+{
+	struct vmm_vinput_event *event = data;
+
+	if (evt == VMM_VINPUT_EVENT_DESTROY_KEYBOARD) {
+		vmm_mutex_lock(&vnctrl.dev_lock);
+		if (vnctrl.vkbd == event->data) {
+			vnctrl.vkbd = NULL;
+		}
+		vmm_mutex_unlock(&vnctrl.dev_lock);
+		return NOTIFY_OK;
+	} else if (evt == VMM_VINPUT_EVENT_DESTROY_MOUSE) {
+		vmm_mutex_lock(&vnctrl.dev_lock);
+		if (vnctrl.vmou == event->data) {
+			vnctrl.vmou = NULL;
+		}
+		vmm_mutex_unlock(&vnctrl.dev_lock);
+		return NOTIFY_OK;
+	}
+
+	return NOTIFY_DONE;
+}
+
+static void vncd_read_name(struct vmm_devtree_node *node,
+			   const char *attr, char *name)
+{
+	const char *str;
+
+	if (vmm_devtree_read_string(node, attr, &str)) {
+		name[0] = '\0';
+		return;
+	}
+	strncpy(name, str, VMM_FIELD_NAME_SIZE);
+	name[VMM_FIELD_NAME_SIZE - 1] = '\0';
+}
+
+static int __init daemon_vncd_init(void)
+{
+	int rc;
+	u32 vncd_priority;
+	u32 vncd_time_slice;
+	struct vmm_devtree_node *node;
+
+	/* Reset vncd control information */
+	memset(&vnctrl, 0, sizeof(vnctrl));
+	INIT_MUTEX(&vnctrl.dev_lock);
+	INIT_SPIN_LOCK(&vnctrl.dirty_lock);
+
+	/* Retrive vncd configuration */
+	node = vmm_devtree_getnode(VMM_DEVTREE_PATH_SEPARATOR_STRING
+				   VMM_DEVTREE_VMMINFO_NODE_NAME);
+	if (!node) {
+		return VMM_EFAIL;
+	}
+	if (vmm_devtree_read_u32(node,
+				 "vncd_priority", &vncd_priority)) {
+		vncd_priority = VMM_THREAD_DEF_PRIORITY;
+	}
+	if (vmm_devtree_read_u32(node,
+				 "vncd_time_slice", &vncd_time_slice)) {
+		vncd_time_slice = VMM_THREAD_DEF_TIME_SLICE;
+	}
+	if (vmm_devtree_read_u32(node,
+				 "vncd_port", &vnctrl.port)) {
+		vnctrl.port = VNCD_DEFAULT_PORT;
+	}
+	vncd_read_name(node, "vncd_display", vnctrl.display_name);
+	vncd_read_name(node, "vncd_keyboard", vnctrl.keyboard_name);
+	vncd_read_name(node, "vncd_mouse", vnctrl.mouse_name);
+	vmm_devtree_dref_node(node);
+
+	vnctrl.refresh_msecs = 1000 / CONFIG_VNCD_REFRESH_RATE;
+
+	/* Register notifier clients for device destruction */
+	vnctrl.vdis_client.notifier_call = &vncd_vdisplay_notification;
+	vnctrl.vdis_client.priority = 0;
+	rc = vmm_vdisplay_register_client(&vnctrl.vdis_client);
+	if (rc) {
+		return rc;
+	}
+	vnctrl.vinp_client.notifier_call = &vncd_vinput_notification;
+	vnctrl.vinp_client.priority = 0;
+	rc = vmm_vinput_register_client(&vnctrl.vinp_client);
+	if (rc) {
+		vmm_vdisplay_unregister_client(&vnctrl.vdis_client);
+		return rc;
+	}
+
+	/* Create vncd main thread */
+	vnctrl.main_thread = vmm_threads_create("vncd",
+						&vncd_main,
+						NULL,
+						vncd_priority,
+						vncd_time_slice);
+	if (!vnctrl.main_thread) {
+		vmm_panic("vncd: main thread creation failed.\n");
+	}
+
+	/* Start vncd main thread */
+	vmm_threads_start(vnctrl.main_thread);
+
+	return VMM_OK;
+}
+
+static void __exit daemon_vncd_exit(void)
+{
+	/* Stop and destroy vncd main thread */
+	vmm_threads_stop(vnctrl.main_thread);
+	vmm_threads_destroy(vnctrl.main_thread);
+
+	vmm_vinput_unregister_client(&vnctrl.vinp_client);
+	vmm_vdisplay_unregister_client(&vnctrl.vdis_client);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
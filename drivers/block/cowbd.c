@@ -0,0 +1,597 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cowbd.c
+ * @author agent (agent@local)
+ * @brief Copy-on-write overlay block device driver.
+ *
+ * The overlay is a radix tree of page sized chunks indexed by chunk
+ * number. Each chunk has a bitmap of blocks written so far. Reads are
+ * served from base block device into a private buffer which is then
+ * patched with overlay blocks so that an aborted request never has its
+ * buffer touched after abort.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_spinlocks.h>
+#include <vmm_modules.h>
+#include <vmm_notifier.h>
+#include <libs/log2.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+#include <drv/cowbd.h>
+
+#define MODULE_DESC			"Copy-on-write Block Driver"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(COWBD_IPRIORITY)
+#define	MODULE_INIT			cowbd_driver_init
+#define	MODULE_EXIT			cowbd_driver_exit
+
+#define COWBD_MAX_CHUNK_BLOCKS		32
+#define COWBD_FREE_BATCH		16
+
+/* Overlay chunk */
+struct cowbd_chunk {
+	unsigned long index;
+	u32 valid;
+	virtual_addr_t va;
+};
+
+/* Read request sent to base block device */
+struct cowbd_read {
+	struct dlist head;
+	struct vmm_request r;
+	struct vmm_request *orig;
+	struct cowbd *d;
+};
+
+static LIST_HEAD(cowbd_list);
+static DEFINE_SPINLOCK(cowbd_list_lock);
+
+/* Note: Must be called with d->lock held */
+static u32 cowbd_overlay_copy(struct cowbd *d, u64 lba, u32 bcnt,
+			      void *buf, bool write)
+{
+	u32 i, off, n, pos = 0, found = 0;
+	u32 bsize = d->bdev->block_size;
+	struct cowbd_chunk *c;
+
+	while (pos < bcnt) {
+		off = (lba + pos) & (d->chunk_blocks - 1);
+		n = min(d->chunk_blocks - off, bcnt - pos);
+		c = radix_tree_lookup(&d->chunks,
+				(unsigned long)((lba + pos) >> d->chunk_shift));
+		if (!c) {
+			pos += n;
+			continue;
+		}
+		for (i = 0; i < n; i++) {
+			if (write) {
+				memcpy((void *)c->va + (off + i) * bsize,
+				       buf + (pos + i) * bsize, bsize);
+				c->valid |= (1U << (off + i));
+				found++;
+			} else if (c->valid & (1U << (off + i))) {
+				if (buf) {
+					memcpy(buf + (pos + i) * bsize,
+					(void *)c->va + (off + i) * bsize,
+					bsize);
+				}
+				found++;
+			}
+		}
+		pos += n;
+	}
+
+	return found;
+}
+
+/* Note: Must be called with d->lock held */
+static int cowbd_overlay_alloc(struct cowbd *d, u64 lba, u32 bcnt)
+{
+	int rc;
+	unsigned long index, last;
+	struct cowbd_chunk *c;
+
+	index = (unsigned long)(lba >> d->chunk_shift);
+	last = (unsigned long)((lba + bcnt - 1) >> d->chunk_shift);
+	for (; index <= last; index++) {
+		if (radix_tree_lookup(&d->chunks, index)) {
+			continue;
+		}
+
+		c = vmm_zalloc(sizeof(*c));
+		if (!c) {
+			return VMM_ENOMEM;
+		}
+		c->index = index;
+		c->va = vmm_host_alloc_pages(1, VMM_MEMORY_FLAGS_NORMAL);
+		if (!c->va) {
+			vmm_free(c);
+			return VMM_ENOMEM;
+		}
+
+		rc = radix_tree_insert(&d->chunks, index, c);
+		if (rc) {
+			vmm_host_free_pages(c->va, 1);
+			vmm_free(c);
+			return rc;
+		}
+		d->chunk_count++;
+	}
+
+	return VMM_OK;
+}
+
+/* Note: Must be called with d->lock held */
+static void cowbd_overlay_free(struct cowbd *d)
+{
+	u32 i, count;
+	struct cowbd_chunk *batch[COWBD_FREE_BATCH];
+
+	while ((count = radix_tree_gang_lookup(&d->chunks, (void **)batch,
+					       0, COWBD_FREE_BATCH))) {
+		for (i = 0; i < count; i++) {
+			radix_tree_delete(&d->chunks, batch[i]->index);
+			vmm_host_free_pages(batch[i]->va, 1);
+			vmm_free(batch[i]);
+		}
+	}
+	d->chunk_count = 0;
+}
+
+static void cowbd_read_free(struct cowbd_read *cr)
+{
+	vmm_free(cr->r.data);
+	vmm_free(cr);
+}
+
+static void cowbd_read_completed(struct vmm_request *r)
+{
+	irq_flags_t flags;
+	struct cowbd_read *cr = r->priv;
+	struct cowbd *d = cr->d;
+	struct vmm_request *orig;
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	list_del(&cr->head);
+	orig = cr->orig;
+	if (orig) {
+		memcpy(orig->data, r->data, r->bcnt * d->bdev->block_size);
+		cowbd_overlay_copy(d, orig->lba, orig->bcnt,
+				   orig->data, FALSE);
+	}
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	if (orig) {
+		vmm_blockdev_complete_request(orig);
+	}
+
+	cowbd_read_free(cr);
+}
+
+static void cowbd_read_failed(struct vmm_request *r)
+{
+	irq_flags_t flags;
+	struct cowbd_read *cr = r->priv;
+	struct cowbd *d = cr->d;
+	struct vmm_request *orig;
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	list_del(&cr->head);
+	orig = cr->orig;
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	if (orig) {
+		vmm_blockdev_fail_request(orig);
+	}
+
+	cowbd_read_free(cr);
+}
+
+static int cowbd_read(struct cowbd *d, struct vmm_request *r)
+{
+	u32 found;
+	irq_flags_t flags;
+	struct vmm_blockdev *base;
+	struct cowbd_read *cr;
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	found = cowbd_overlay_copy(d, r->lba, r->bcnt, NULL, FALSE);
+	if (found == r->bcnt) {
+		cowbd_overlay_copy(d, r->lba, r->bcnt, r->data, FALSE);
+		vmm_spin_unlock_irqrestore(&d->lock, flags);
+		return vmm_blockdev_complete_request(r);
+	}
+	base = d->base;
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	if (!base) {
+		return vmm_blockdev_fail_request(r);
+	}
+
+	cr = vmm_zalloc(sizeof(*cr));
+	if (!cr) {
+		return vmm_blockdev_fail_request(r);
+	}
+	INIT_LIST_HEAD(&cr->head);
+	cr->orig = r;
+	cr->d = d;
+	cr->r.type = VMM_REQUEST_READ;
+	cr->r.lba = base->start_lba + r->lba;
+	cr->r.bcnt = r->bcnt;
+	cr->r.data = vmm_malloc(r->bcnt * d->bdev->block_size);
+	cr->r.completed = cowbd_read_completed;
+	cr->r.failed = cowbd_read_failed;
+	cr->r.priv = cr;
+	if (!cr->r.data) {
+		vmm_free(cr);
+		return vmm_blockdev_fail_request(r);
+	}
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	list_add_tail(&cr->head, &d->inflight);
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	/* Note: Completion or failure of base request,
+	 * including submit failure, is handled by callbacks.
+	 */
+	vmm_blockdev_submit_request(base, &cr->r);
+
+	return VMM_OK;
+}
+
+static int cowbd_write(struct cowbd *d, struct vmm_request *r)
+{
+	int rc;
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	rc = cowbd_overlay_alloc(d, r->lba, r->bcnt);
+	if (!rc) {
+		cowbd_overlay_copy(d, r->lba, r->bcnt, r->data, TRUE);
+	}
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	if (rc) {
+		return vmm_blockdev_fail_request(r);
+	}
+
+	return vmm_blockdev_complete_request(r);
+}
+
+static int cowbd_make_request(struct vmm_request_queue *rq,
+			      struct vmm_request *r)
+{
+	struct cowbd *d = rq->priv;
+
+	switch (r->type) {
+	case VMM_REQUEST_READ:
+		cowbd_read(d, r);
+		break;
+	case VMM_REQUEST_WRITE:
+		cowbd_write(d, r);
+		break;
+	default:
+		vmm_blockdev_fail_request(r);
+		break;
+	};
+
+	return VMM_OK;
+}
+
+static int cowbd_abort_request(struct vmm_request_queue *rq,
+			       struct vmm_request *r)
+{
+	int rc = VMM_ENOTAVAIL;
+	irq_flags_t flags;
+	struct cowbd *d = rq->priv;
+	struct cowbd_read *cr;
+
+	/* Only base reads are in-flight. The base read itself
+	 * is left running and is freed upon its completion.
+	 */
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	list_for_each_entry(cr, &d->inflight, head) {
+		if (cr->orig == r) {
+			cr->orig = NULL;
+			rc = VMM_OK;
+			break;
+		}
+	}
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	return rc;
+}
+
+struct cowbd *cowbd_create(const char *name, const char *base_name)
+{
+	u32 chunk_blocks;
+	irq_flags_t flags;
+	struct cowbd *d;
+	struct vmm_blockdev *base;
+
+	if (!name || !base_name) {
+		return NULL;
+	}
+
+	base = vmm_blockdev_find(base_name);
+	if (!base || !base->block_size ||
+	    (base->block_size > COWBD_CHUNK_SIZE) ||
+	    (base->block_size & (base->block_size - 1))) {
+		return NULL;
+	}
+	chunk_blocks = COWBD_CHUNK_SIZE / base->block_size;
+	if (chunk_blocks > COWBD_MAX_CHUNK_BLOCKS) {
+		return NULL;
+	}
+
+	d = vmm_zalloc(sizeof(struct cowbd));
+	if (!d) {
+		goto free_nothing;
+	}
+	INIT_LIST_HEAD(&d->head);
+	d->base = base;
+	d->chunk_blocks = chunk_blocks;
+	d->chunk_shift = ilog2(chunk_blocks);
+	INIT_SPIN_LOCK(&d->lock);
+	INIT_RADIX_TREE(&d->chunks, GFP_ATOMIC);
+	d->chunk_count = 0;
+	INIT_LIST_HEAD(&d->inflight);
+
+	d->bdev = vmm_blockdev_alloc();
+	if (!d->bdev) {
+		goto free_cowbd;
+	}
+
+	/* Setup block device instance */
+	strncpy(d->bdev->name, name, VMM_FIELD_NAME_SIZE);
+	strncpy(d->bdev->desc, "Copy-on-write block device",
+		VMM_FIELD_DESC_SIZE);
+	d->bdev->flags = VMM_BLOCKDEV_RW;
+	d->bdev->start_lba = 0;
+	d->bdev->num_blocks = base->num_blocks;
+	d->bdev->block_size = base->block_size;
+
+	/* Setup request queue for block device instance */
+	d->bdev->rq = vmm_zalloc(sizeof(struct vmm_request_queue));
+	if (!d->bdev->rq) {
+		goto free_bdev;
+	}
+	INIT_REQUEST_QUEUE(d->bdev->rq);
+	d->bdev->rq->make_request = cowbd_make_request;
+	d->bdev->rq->abort_request = cowbd_abort_request;
+	d->bdev->rq->priv = d;
+
+	/* Register block device instance */
+	if (vmm_blockdev_register(d->bdev)) {
+		goto free_bdev_rq;
+	}
+
+	/* Add to list of COWBD instances */
+	vmm_spin_lock_irqsave(&cowbd_list_lock, flags);
+	list_add_tail(&d->head, &cowbd_list);
+	vmm_spin_unlock_irqrestore(&cowbd_list_lock, flags);
+
+	return d;
+
+free_bdev_rq:
+	vmm_free(d->bdev->rq);
+free_bdev:
+	vmm_blockdev_free(d->bdev);
+free_cowbd:
+	vmm_free(d);
+free_nothing:
+	return NULL;
+}
+VMM_EXPORT_SYMBOL(cowbd_create);
+
+int cowbd_destroy(struct cowbd *d)
+{
+	bool busy;
+	irq_flags_t flags;
+
+	/* Sanity check */
+	if (!d) {
+		return VMM_EFAIL;
+	}
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	busy = !list_empty(&d->inflight);
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+	if (busy) {
+		return VMM_EBUSY;
+	}
+
+	/* Remove from list of COWBD instances */
+	vmm_spin_lock_irqsave(&cowbd_list_lock, flags);
+	list_del(&d->head);
+	vmm_spin_unlock_irqrestore(&cowbd_list_lock, flags);
+
+	/* Unregister block device */
+	vmm_blockdev_unregister(d->bdev);
+
+	/* Free overlay chunks */
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	cowbd_overlay_free(d);
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	/* Free block device request queue */
+	vmm_free(d->bdev->rq);
+
+	/* Free block device */
+	vmm_blockdev_free(d->bdev);
+
+	/* Free COWBD instance */
+	vmm_free(d);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(cowbd_destroy);
+
+int cowbd_reset(struct cowbd *d)
+{
+	irq_flags_t flags;
+
+	if (!d) {
+		return VMM_EFAIL;
+	}
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	cowbd_overlay_free(d);
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(cowbd_reset);
+
+struct cowbd *cowbd_find(const char *name)
+{
+	bool found;
+	struct dlist *l;
+	struct cowbd *d;
+	irq_flags_t flags;
+
+	if (!name) {
+		return NULL;
+	}
+
+	found = FALSE;
+	d = NULL;
+
+	vmm_spin_lock_irqsave(&cowbd_list_lock, flags);
+
+	list_for_each(l, &cowbd_list) {
+		d = list_entry(l, struct cowbd, head);
+		if (strcmp(d->bdev->name, name) == 0) {
+			found = TRUE;
+			break;
+		}
+	}
+
+	vmm_spin_unlock_irqrestore(&cowbd_list_lock, flags);
+
+	if (!found) {
+		return NULL;
+	}
+
+	return d;
+}
+VMM_EXPORT_SYMBOL(cowbd_find);
+
+struct cowbd *cowbd_get(int index)
+{
+	bool found;
+	struct dlist *l;
+	struct cowbd *retval;
+	irq_flags_t flags;
+
+	if (index < 0) {
+		return NULL;
+	}
+
+	retval = NULL;
+	found = FALSE;
+
+	vmm_spin_lock_irqsave(&cowbd_list_lock, flags);
+
+	list_for_each(l, &cowbd_list) {
+		retval = list_entry(l, struct cowbd, head);
+		if (!index) {
+			found = TRUE;
+			break;
+		}
+		index--;
+	}
+
+	vmm_spin_unlock_irqrestore(&cowbd_list_lock, flags);
+
+	if (!found) {
+		return NULL;
+	}
+
+	return retval;
+}
+VMM_EXPORT_SYMBOL(cowbd_get);
+
+u32 cowbd_count(void)
+{
+	u32 retval = 0;
+	struct dlist *l;
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&cowbd_list_lock, flags);
+
+	list_for_each(l, &cowbd_list) {
+		retval++;
+	}
+
+	vmm_spin_unlock_irqrestore(&cowbd_list_lock, flags);
+
+	return retval;
+}
+VMM_EXPORT_SYMBOL(cowbd_count);
+
+static int cowbd_blockdev_notification(struct vmm_notifier_block *nb,
+				       unsigned long evt, void *data)
+{
+	irq_flags_t flags, dflags;
+	struct cowbd *d;
+	struct vmm_blockdev_event *e = data;
+
+	if (evt != VMM_BLOCKDEV_EVENT_UNREGISTER) {
+		return NOTIFY_DONE;
+	}
+
+	/* Reads not covered by overlay fail once base is gone */
+	vmm_spin_lock_irqsave(&cowbd_list_lock, flags);
+	list_for_each_entry(d, &cowbd_list, head) {
+		vmm_spin_lock_irqsave(&d->lock, dflags);
+		if (d->base == e->bdev) {
+			d->base = NULL;
+		}
+		vmm_spin_unlock_irqrestore(&d->lock, dflags);
+	}
+	vmm_spin_unlock_irqrestore(&cowbd_list_lock, flags);
+
+	return NOTIFY_OK;
+}
+
+static struct vmm_notifier_block cowbd_blockdev_client = {
+	.notifier_call = &cowbd_blockdev_notification,
+	.priority = 0,
+};
+
+static int __init cowbd_driver_init(void)
+{
+	return vmm_blockdev_register_client(&cowbd_blockdev_client);
+}
+
+static void __exit cowbd_driver_exit(void)
+{
+	vmm_blockdev_unregister_client(&cowbd_blockdev_client);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -0,0 +1,872 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file nbd.c
+ * @author agent (agent@local)
+ * @brief Network block device client driver.
+ *
+ * Each NBD instance has one TCP connection to NBD server and two
+ * threads. The TX thread sends queued requests to NBD server as long
+ * as less than CONFIG_BLOCK_NBD_MAX_INFLIGHT requests are waiting for
+ * reply. The RX thread receives replies in whatever order NBD server
+ * sends them, matches them with in-flight requests by handle and
+ * completes them. Read data is received directly into request buffer.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_spinlocks.h>
+#include <vmm_host_io.h>
+#include <vmm_modules.h>
+#include <block/vmm_blockcache.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+#include <drv/nbd.h>
+
+#define MODULE_DESC			"Network Block Device Client"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(NBD_IPRIORITY)
+#define	MODULE_INIT			nbd_driver_init
+#define	MODULE_EXIT			nbd_driver_exit
+
+#define NBD_INIT_MAGIC			0x4e42444d41474943ULL
+#define NBD_OPTS_MAGIC			0x49484156454f5054ULL
+#define NBD_CLISERV_MAGIC		0x0000420281861253ULL
+#define NBD_REQUEST_MAGIC		0x25609513
+#define NBD_REPLY_MAGIC			0x67446698
+
+/* Handshake flags */
+#define NBD_FLAG_FIXED_NEWSTYLE		(1 << 0)
+#define NBD_FLAG_NO_ZEROES		(1 << 1)
+
+/* Transmission flags */
+#define NBD_FLAG_HAS_FLAGS		(1 << 0)
+#define NBD_FLAG_READ_ONLY		(1 << 1)
+#define NBD_FLAG_SEND_FLUSH		(1 << 2)
+
+#define NBD_OPT_EXPORT_NAME		1
+
+#define NBD_CMD_READ			0
+#define NBD_CMD_WRITE			1
+#define NBD_CMD_DISC			2
+#define NBD_CMD_FLUSH			3
+
+#define NBD_MAX_INFLIGHT		CONFIG_BLOCK_NBD_MAX_INFLIGHT
+#define NBD_WRITE_CHUNK			(32 * 1024)
+#define NBD_DISCARD_SIZE		4096
+#define NBD_ZEROES_SIZE			124
+#define NBD_RECV_POLL_MSECS		2000
+
+struct nbd_option_hdr {
+	u64 magic;
+	u32 option;
+	u32 len;
+} __packed;
+
+struct nbd_export_info {
+	u64 size;
+	u16 flags;
+} __packed;
+
+struct nbd_request_hdr {
+	u32 magic;
+	u32 type;
+	u64 handle;
+	u64 from;
+	u32 len;
+} __packed;
+
+struct nbd_reply_hdr {
+	u32 magic;
+	u32 error;
+	u64 handle;
+} __packed;
+
+/* Request queued for or sent to NBD server */
+struct nbd_req {
+	struct dlist head;
+	u64 handle;
+	u32 cmd;
+	u64 from;
+	u32 len;
+	struct vmm_request *r;
+};
+
+static LIST_HEAD(nbd_list);
+static DEFINE_SPINLOCK(nbd_list_lock);
+
+static int nbd_send(struct nbd *d, void *data, u32 len)
+{
+	int rc;
+	u16 wlen;
+	u32 done = 0;
+
+	while (done < len) {
+		wlen = ((len - done) < NBD_WRITE_CHUNK) ?
+					(len - done) : NBD_WRITE_CHUNK;
+		rc = netstack_socket_write(d->sk, (u8 *)data + done, wlen);
+		if (rc) {
+			return rc;
+		}
+		done += wlen;
+	}
+
+	return VMM_OK;
+}
+
+static int nbd_recv(struct nbd *d, void *data, u32 len)
+{
+	int rc;
+	u32 done = 0;
+
+	while (done < len) {
+		rc = netstack_socket_recv_into(d->sk, (u8 *)data + done,
+					       len - done, NBD_RECV_POLL_MSECS);
+		if (rc == VMM_ETIMEDOUT) {
+			/* Only an idle established connection may wait */
+			if (!d->connected || d->stopping) {
+				return VMM_ETIMEDOUT;
+			}
+			continue;
+		} else if (rc <= 0) {
+			return (rc) ? rc : VMM_EIO;
+		}
+		done += rc;
+	}
+
+	return VMM_OK;
+}
+
+static int nbd_recv_discard(struct nbd *d, u32 len)
+{
+	int rc;
+	u32 n;
+
+	while (len) {
+		n = min(len, (u32)NBD_DISCARD_SIZE);
+		rc = nbd_recv(d, d->discard, n);
+		if (rc) {
+			return rc;
+		}
+		len -= n;
+	}
+
+	return VMM_OK;
+}
+
+static int nbd_handshake(struct nbd *d, u64 *size)
+{
+	int rc;
+	u16 hflags;
+	u32 cflags;
+	u64 magic[2];
+	struct nbd_option_hdr opt;
+	struct nbd_export_info info;
+
+	rc = nbd_recv(d, magic, sizeof(magic));
+	if (rc) {
+		return rc;
+	}
+	if (vmm_be64_to_cpu(magic[0]) != NBD_INIT_MAGIC) {
+		return VMM_EPROTO;
+	}
+
+	/* Old-style servers directly describe their only export */
+	if (vmm_be64_to_cpu(magic[1]) == NBD_CLISERV_MAGIC) {
+		rc = nbd_recv(d, &info, sizeof(info));
+		if (rc) {
+			return rc;
+		}
+		*size = vmm_be64_to_cpu(info.size);
+		/* Transmission flags are lower half of 32bit flags */
+		rc = nbd_recv(d, &hflags, sizeof(hflags));
+		if (rc) {
+			return rc;
+		}
+		d->xmit_flags = vmm_be16_to_cpu(hflags);
+		return nbd_recv_discard(d, NBD_ZEROES_SIZE);
+	}
+	if (vmm_be64_to_cpu(magic[1]) != NBD_OPTS_MAGIC) {
+		return VMM_EPROTO;
+	}
+
+	rc = nbd_recv(d, &hflags, sizeof(hflags));
+	if (rc) {
+		return rc;
+	}
+	hflags = vmm_be16_to_cpu(hflags);
+
+	cflags = vmm_cpu_to_be32(hflags &
+			(NBD_FLAG_FIXED_NEWSTYLE | NBD_FLAG_NO_ZEROES));
+	rc = nbd_send(d, &cflags, sizeof(cflags));
+	if (rc) {
+		return rc;
+	}
+
+	opt.magic = vmm_cpu_to_be64(NBD_OPTS_MAGIC);
+	opt.option = vmm_cpu_to_be32(NBD_OPT_EXPORT_NAME);
+	opt.len = vmm_cpu_to_be32(strlen(d->export_name));
+	rc = nbd_send(d, &opt, sizeof(opt));
+	if (!rc && strlen(d->export_name)) {
+		rc = nbd_send(d, d->export_name, strlen(d->export_name));
+	}
+	if (rc) {
+		return rc;
+	}
+
+	/* Server closes connection if export does not exist */
+	rc = nbd_recv(d, &info, sizeof(info));
+	if (rc) {
+		return rc;
+	}
+	*size = vmm_be64_to_cpu(info.size);
+	d->xmit_flags = vmm_be16_to_cpu(info.flags);
+
+	if (!(hflags & NBD_FLAG_NO_ZEROES)) {
+		return nbd_recv_discard(d, NBD_ZEROES_SIZE);
+	}
+
+	return VMM_OK;
+}
+
+/* Fail all requests except one being sent by TX thread */
+static void nbd_fail_all(struct nbd *d)
+{
+	irq_flags_t flags;
+	struct nbd_req *nr, *tnr;
+
+	while (1) {
+		nr = NULL;
+
+		vmm_spin_lock_irqsave(&d->lock, flags);
+		d->connected = FALSE;
+		if (!list_empty(&d->tx_list)) {
+			nr = list_first_entry(&d->tx_list,
+					      struct nbd_req, head);
+		} else {
+			list_for_each_entry(tnr, &d->inflight, head) {
+				if (tnr != d->tx_cur) {
+					nr = tnr;
+					d->inflight_count--;
+					break;
+				}
+			}
+		}
+		if (nr) {
+			list_del(&nr->head);
+		}
+		vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+		if (!nr) {
+			break;
+		}
+
+		if (nr->r) {
+			vmm_blockdev_fail_request(nr->r);
+		}
+		vmm_free(nr);
+	}
+}
+
+static int nbd_tx_next(struct nbd *d)
+{
+	int rc;
+	void *data;
+	bool connected;
+	irq_flags_t flags;
+	struct nbd_req *nr;
+	struct nbd_request_hdr hdr;
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	if (!d->connected || d->stopping || list_empty(&d->tx_list) ||
+	    (NBD_MAX_INFLIGHT <= d->inflight_count)) {
+		vmm_spin_unlock_irqrestore(&d->lock, flags);
+		return VMM_ENOENT;
+	}
+	nr = list_first_entry(&d->tx_list, struct nbd_req, head);
+	list_del(&nr->head);
+	nr->handle = d->next_handle++;
+	list_add_tail(&nr->head, &d->inflight);
+	d->inflight_count++;
+	d->tx_cur = nr;
+
+	/* Reply may free nr as soon as header is sent so
+	 * nothing is taken from nr after this point.
+	 */
+	hdr.magic = vmm_cpu_to_be32(NBD_REQUEST_MAGIC);
+	hdr.type = vmm_cpu_to_be32(nr->cmd);
+	hdr.handle = nr->handle;
+	hdr.from = vmm_cpu_to_be64(nr->from);
+	hdr.len = vmm_cpu_to_be32(nr->len);
+	data = (nr->cmd == NBD_CMD_WRITE) ? nr->r->data : NULL;
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	rc = nbd_send(d, &hdr, sizeof(hdr));
+	if (!rc && data) {
+		rc = nbd_send(d, data, vmm_be32_to_cpu(hdr.len));
+	}
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	d->tx_cur = NULL;
+	if (rc) {
+		d->connected = FALSE;
+	}
+	connected = d->connected;
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	if (!connected) {
+		nbd_fail_all(d);
+		return VMM_EIO;
+	}
+
+	return VMM_OK;
+}
+
+static int nbd_tx_thread(void *tdata)
+{
+	struct nbd *d = tdata;
+	struct nbd_request_hdr hdr;
+
+	while (!d->stopping) {
+		vmm_completion_wait(&d->tx_avail);
+		while (nbd_tx_next(d) == VMM_OK) ;
+	}
+
+	/* Tell NBD server that we are going away */
+	if (d->connected) {
+		hdr.magic = vmm_cpu_to_be32(NBD_REQUEST_MAGIC);
+		hdr.type = vmm_cpu_to_be32(NBD_CMD_DISC);
+		hdr.handle = 0;
+		hdr.from = 0;
+		hdr.len = 0;
+		nbd_send(d, &hdr, sizeof(hdr));
+	}
+
+	vmm_completion_complete(&d->tx_done);
+
+	return VMM_OK;
+}
+
+static int nbd_rx_next(struct nbd *d)
+{
+	int rc;
+	u32 error;
+	irq_flags_t flags;
+	struct vmm_request *r;
+	struct nbd_req *nr, *tnr;
+	struct nbd_reply_hdr hdr;
+
+	rc = nbd_recv(d, &hdr, sizeof(hdr));
+	if (rc) {
+		return rc;
+	}
+	if (vmm_be32_to_cpu(hdr.magic) != NBD_REPLY_MAGIC) {
+		return VMM_EPROTO;
+	}
+	error = vmm_be32_to_cpu(hdr.error);
+
+	/* Once removed from in-flight list the request
+	 * can not be aborted hence r is stable.
+	 */
+	nr = NULL;
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	list_for_each_entry(tnr, &d->inflight, head) {
+		if (tnr->handle == hdr.handle) {
+			nr = tnr;
+			break;
+		}
+	}
+	if (nr) {
+		list_del(&nr->head);
+		d->inflight_count--;
+	}
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	if (!nr) {
+		return VMM_EPROTO;
+	}
+	r = nr->r;
+
+	/* TX thread may send one more request */
+	vmm_completion_complete(&d->tx_avail);
+
+	if ((nr->cmd == NBD_CMD_READ) && !error) {
+		if (r) {
+			rc = nbd_recv(d, r->data, nr->len);
+		} else {
+			rc = nbd_recv_discard(d, nr->len);
+		}
+	}
+
+	if (r) {
+		if (rc || error) {
+			vmm_blockdev_fail_request(r);
+		} else {
+			vmm_blockdev_complete_request(r);
+		}
+	}
+	vmm_free(nr);
+
+	return rc;
+}
+
+static int nbd_rx_thread(void *tdata)
+{
+	int rc;
+	struct nbd *d = tdata;
+
+	while (!(rc = nbd_rx_next(d))) ;
+
+	if (!d->stopping) {
+		vmm_printf("%s: %s lost connection to server (error %d)\n",
+			   __func__, d->bdev->name, rc);
+	}
+
+	nbd_fail_all(d);
+
+	/* Wakeup TX thread so that it notices disconnection */
+	vmm_completion_complete(&d->tx_avail);
+
+	vmm_completion_complete(&d->rx_done);
+
+	return rc;
+}
+
+static int nbd_queue(struct nbd *d, struct nbd_req *nr)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	if (!d->connected || d->stopping) {
+		vmm_spin_unlock_irqrestore(&d->lock, flags);
+		if (nr->r) {
+			vmm_blockdev_fail_request(nr->r);
+		}
+		vmm_free(nr);
+		return VMM_OK;
+	}
+	list_add_tail(&nr->head, &d->tx_list);
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	vmm_completion_complete(&d->tx_avail);
+
+	return VMM_OK;
+}
+
+static int nbd_make_request(struct vmm_request_queue *rq,
+			    struct vmm_request *r)
+{
+	struct nbd_req *nr;
+	struct nbd *d = rq->priv;
+
+	if ((r->type != VMM_REQUEST_READ) &&
+	    (r->type != VMM_REQUEST_WRITE)) {
+		vmm_blockdev_fail_request(r);
+		return VMM_OK;
+	}
+
+	nr = vmm_zalloc(sizeof(*nr));
+	if (!nr) {
+		vmm_blockdev_fail_request(r);
+		return VMM_OK;
+	}
+	INIT_LIST_HEAD(&nr->head);
+	nr->cmd = (r->type == VMM_REQUEST_WRITE) ?
+				NBD_CMD_WRITE : NBD_CMD_READ;
+	nr->from = r->lba * NBD_BLOCK_SIZE;
+	nr->len = r->bcnt * NBD_BLOCK_SIZE;
+	nr->r = r;
+
+	return nbd_queue(d, nr);
+}
+
+static int nbd_abort_request(struct vmm_request_queue *rq,
+			     struct vmm_request *r)
+{
+	int rc = VMM_ENOTAVAIL;
+	irq_flags_t flags;
+	struct nbd *d = rq->priv;
+	struct nbd_req *nr, *fnr = NULL;
+
+	vmm_spin_lock_irqsave(&d->lock, flags);
+
+	/* Queued request is simply dropped */
+	list_for_each_entry(nr, &d->tx_list, head) {
+		if (nr->r == r) {
+			list_del(&nr->head);
+			fnr = nr;
+			rc = VMM_OK;
+			break;
+		}
+	}
+
+	/* In-flight request waits for its reply without request
+	 * unless request buffer is being sent right now.
+	 */
+	if (rc) {
+		list_for_each_entry(nr, &d->inflight, head) {
+			if (nr->r != r) {
+				continue;
+			}
+			if (nr == d->tx_cur) {
+				rc = VMM_EBUSY;
+			} else {
+				nr->r = NULL;
+				rc = VMM_OK;
+			}
+			break;
+		}
+	}
+
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+
+	if (fnr) {
+		vmm_free(fnr);
+	}
+
+	return rc;
+}
+
+static int nbd_flush_cache(struct vmm_request_queue *rq)
+{
+	struct nbd_req *nr;
+	struct nbd *d = rq->priv;
+
+	if (!(d->xmit_flags & NBD_FLAG_SEND_FLUSH)) {
+		return VMM_OK;
+	}
+
+	/* Flush is sent after all requests queued so far */
+	nr = vmm_zalloc(sizeof(*nr));
+	if (!nr) {
+		return VMM_ENOMEM;
+	}
+	INIT_LIST_HEAD(&nr->head);
+	nr->cmd = NBD_CMD_FLUSH;
+
+	return nbd_queue(d, nr);
+}
+
+struct nbd *nbd_create(const char *name, u8 *ipaddr, u16 port,
+		       const char *export_name, u32 cache_kb)
+{
+	int rc;
+	u64 size;
+	char tname[VMM_FIELD_NAME_SIZE];
+	irq_flags_t flags;
+	struct nbd *d;
+
+	if (!name || !ipaddr) {
+		return NULL;
+	}
+
+	d = vmm_zalloc(sizeof(struct nbd));
+	if (!d) {
+		goto free_nothing;
+	}
+	INIT_LIST_HEAD(&d->head);
+	memcpy(d->ipaddr, ipaddr, sizeof(d->ipaddr));
+	d->port = port;
+	if (export_name) {
+		strncpy(d->export_name, export_name, NBD_EXPORT_NAME_SIZE);
+		d->export_name[NBD_EXPORT_NAME_SIZE - 1] = '\0';
+	}
+	INIT_COMPLETION(&d->tx_avail);
+	INIT_COMPLETION(&d->tx_done);
+	INIT_COMPLETION(&d->rx_done);
+	INIT_SPIN_LOCK(&d->lock);
+	d->connected = FALSE;
+	d->stopping = FALSE;
+	d->next_handle = 1;
+	INIT_LIST_HEAD(&d->tx_list);
+	INIT_LIST_HEAD(&d->inflight);
+	d->inflight_count = 0;
+	d->tx_cur = NULL;
+
+	d->discard = vmm_malloc(NBD_DISCARD_SIZE);
+	if (!d->discard) {
+		goto free_nbd;
+	}
+
+	/* Connect to NBD server and select export */
+	d->sk = netstack_socket_alloc(NETSTACK_SOCKET_TCP);
+	if (!d->sk) {
+		goto free_discard;
+	}
+	if (netstack_socket_connect(d->sk, d->ipaddr, d->port)) {
+		goto free_sk;
+	}
+	rc = nbd_handshake(d, &size);
+	if (rc || !udiv64(size, NBD_BLOCK_SIZE)) {
+		vmm_printf("%s: %s handshake failed (error %d)\n",
+			   __func__, name, rc);
+		goto disconnect_sk;
+	}
+	d->connected = TRUE;
+
+	d->bdev = vmm_blockdev_alloc();
+	if (!d->bdev) {
+		goto disconnect_sk;
+	}
+
+	/* Setup block device instance */
+	strncpy(d->bdev->name, name, VMM_FIELD_NAME_SIZE);
+	strncpy(d->bdev->desc, "Network block device",
+		VMM_FIELD_DESC_SIZE);
+	d->bdev->flags = (d->xmit_flags & NBD_FLAG_READ_ONLY) ?
+				VMM_BLOCKDEV_RDONLY : VMM_BLOCKDEV_RW;
+	d->bdev->start_lba = 0;
+	d->bdev->num_blocks = udiv64(size, NBD_BLOCK_SIZE);
+	d->bdev->block_size = NBD_BLOCK_SIZE;
+
+	/* Setup request queue for block device instance */
+	d->bdev->rq = vmm_zalloc(sizeof(struct vmm_request_queue));
+	if (!d->bdev->rq) {
+		goto free_bdev;
+	}
+	INIT_REQUEST_QUEUE(d->bdev->rq);
+	d->bdev->rq->flags = VMM_REQUEST_QUEUE_MERGE;
+	d->bdev->rq->make_request = nbd_make_request;
+	d->bdev->rq->abort_request = nbd_abort_request;
+	d->bdev->rq->flush_cache = nbd_flush_cache;
+	d->bdev->rq->priv = d;
+
+	/* Threads must run before registration because
+	 * partition probing reads the block device.
+	 */
+	vmm_snprintf(tname, sizeof(tname), "%s-tx", name);
+	d->tx_thread = vmm_threads_create(tname, nbd_tx_thread, d,
+					  VMM_THREAD_DEF_PRIORITY,
+					  VMM_THREAD_DEF_TIME_SLICE);
+	if (!d->tx_thread) {
+		goto free_bdev_rq;
+	}
+	vmm_snprintf(tname, sizeof(tname), "%s-rx", name);
+	d->rx_thread = vmm_threads_create(tname, nbd_rx_thread, d,
+					  VMM_THREAD_DEF_PRIORITY,
+					  VMM_THREAD_DEF_TIME_SLICE);
+	if (!d->rx_thread) {
+		goto destroy_tx_thread;
+	}
+	vmm_threads_start(d->tx_thread);
+	vmm_threads_start(d->rx_thread);
+
+	/* Register block device instance */
+	if (vmm_blockdev_register(d->bdev)) {
+		goto stop_threads;
+	}
+
+	/* Serve repeated reads locally */
+	if (cache_kb) {
+		rc = vmm_blockcache_enable(d->bdev, cache_kb,
+					   VMM_BLOCKCACHE_WRITETHROUGH);
+		if (rc) {
+			vmm_printf("%s: %s page cache not enabled "
+				   "(error %d)\n", __func__, name, rc);
+		}
+	}
+
+	/* Add to list of NBD instances */
+	vmm_spin_lock_irqsave(&nbd_list_lock, flags);
+	list_add_tail(&d->head, &nbd_list);
+	vmm_spin_unlock_irqrestore(&nbd_list_lock, flags);
+
+	return d;
+
+stop_threads:
+	d->stopping = TRUE;
+	vmm_completion_complete(&d->tx_avail);
+	vmm_completion_wait(&d->tx_done);
+	vmm_completion_wait(&d->rx_done);
+	vmm_threads_destroy(d->rx_thread);
+destroy_tx_thread:
+	vmm_threads_destroy(d->tx_thread);
+free_bdev_rq:
+	vmm_free(d->bdev->rq);
+free_bdev:
+	vmm_blockdev_free(d->bdev);
+disconnect_sk:
+	netstack_socket_disconnect(d->sk);
+free_sk:
+	netstack_socket_free(d->sk);
+free_discard:
+	vmm_free(d->discard);
+free_nbd:
+	vmm_free(d);
+free_nothing:
+	return NULL;
+}
+VMM_EXPORT_SYMBOL(nbd_create);
+
+int nbd_destroy(struct nbd *d)
+{
+	irq_flags_t flags;
+
+	/* Sanity check */
+	if (!d) {
+		return VMM_EFAIL;
+	}
+
+	/* Remove from list of NBD instances */
+	vmm_spin_lock_irqsave(&nbd_list_lock, flags);
+	list_del(&d->head);
+	vmm_spin_unlock_irqrestore(&nbd_list_lock, flags);
+
+	/* Unregister block device */
+	vmm_blockdev_unregister(d->bdev);
+
+	/* Stop TX thread first so that it can disconnect
+	 * gracefully and then wait for RX thread to notice.
+	 */
+	vmm_spin_lock_irqsave(&d->lock, flags);
+	d->stopping = TRUE;
+	vmm_spin_unlock_irqrestore(&d->lock, flags);
+	vmm_completion_complete(&d->tx_avail);
+	vmm_completion_wait(&d->tx_done);
+	vmm_completion_wait(&d->rx_done);
+	vmm_threads_destroy(d->rx_thread);
+	vmm_threads_destroy(d->tx_thread);
+
+	/* Fail remaining requests and drop page cache */
+	nbd_fail_all(d);
+	vmm_blockcache_disable(d->bdev);
+
+	/* Close connection */
+	netstack_socket_disconnect(d->sk);
+	netstack_socket_free(d->sk);
+
+	/* Free block device request queue */
+	vmm_free(d->bdev->rq);
+
+	/* Free block device */
+	vmm_blockdev_free(d->bdev);
+
+	/* Free NBD instance */
+	vmm_free(d->discard);
+	vmm_free(d);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(nbd_destroy);
+
+struct nbd *nbd_find(const char *name)
+{
+	bool found;
+	struct dlist *l;
+	struct nbd *d;
+	irq_flags_t flags;
+
+	if (!name) {
+		return NULL;
+	}
+
+	found = FALSE;
+	d = NULL;
+
+	vmm_spin_lock_irqsave(&nbd_list_lock, flags);
+
+	list_for_each(l, &nbd_list) {
+		d = list_entry(l, struct nbd, head);
+		if (strcmp(d->bdev->name, name) == 0) {
+			found = TRUE;
+			break;
+		}
+	}
+
+	vmm_spin_unlock_irqrestore(&nbd_list_lock, flags);
+
+	if (!found) {
+		return NULL;
+	}
+
+	return d;
+}
+VMM_EXPORT_SYMBOL(nbd_find);
+
+struct nbd *nbd_get(int index)
+{
+	bool found;
+	struct dlist *l;
+	struct nbd *retval;
+	irq_flags_t flags;
+
+	if (index < 0) {
+		return NULL;
+	}
+
+	retval = NULL;
+	found = FALSE;
+
+	vmm_spin_lock_irqsave(&nbd_list_lock, flags);
+
+	list_for_each(l, &nbd_list) {
+		retval = list_entry(l, struct nbd, head);
+		if (!index) {
+			found = TRUE;
+			break;
+		}
+		index--;
+	}
+
+	vmm_spin_unlock_irqrestore(&nbd_list_lock, flags);
+
+	if (!found) {
+		return NULL;
+	}
+
+	return retval;
+}
+VMM_EXPORT_SYMBOL(nbd_get);
+
+u32 nbd_count(void)
+{
+	u32 retval = 0;
+	struct dlist *l;
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&nbd_list_lock, flags);
+
+	list_for_each(l, &nbd_list) {
+		retval++;
+	}
+
+	vmm_spin_unlock_irqrestore(&nbd_list_lock, flags);
+
+	return retval;
+}
+VMM_EXPORT_SYMBOL(nbd_count);
+
+static int __init nbd_driver_init(void)
+{
+	/* Nothing to be done */
+	return VMM_OK;
+}
+
+static void __exit nbd_driver_exit(void)
+{
+	/* Nothing to be done */
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -22,5 +22,7 @@
 # */
 
 drivers-objs-$(CONFIG_BLOCK_RBD)+= block/rbd.o
+drivers-objs-$(CONFIG_BLOCK_COWBD)+= block/cowbd.o
+drivers-objs-$(CONFIG_BLOCK_NBD)+= block/nbd.o
 drivers-objs-$(CONFIG_BLOCK_INITRD)+= block/initrd.o
 
@@ -76,6 +76,20 @@ static int rbd_abort_request(struct vmm_request_queue *rq,
 	return VMM_OK;
 }
 
+static int rbd_direct_access(struct vmm_request_queue *rq,
+			     u64 lba, u64 bcnt, physical_addr_t *pa)
+{
+	struct rbd *d = rq->priv;
+
+	if (d->size < ((lba + bcnt) * RBD_BLOCK_SIZE)) {
+		return VMM_ERANGE;
+	}
+
+	*pa = d->addr + lba * RBD_BLOCK_SIZE;
+
+	return VMM_OK;
+}
+
 static struct rbd *__rbd_create(struct vmm_device *dev,
 				const char *name,
 				physical_addr_t pa,
@@ -120,6 +134,7 @@ static struct rbd *__rbd_create(struct vmm_device *dev,
 	INIT_REQUEST_QUEUE(d->bdev->rq);
 	d->bdev->rq->make_request = rbd_make_request;
 	d->bdev->rq->abort_request = rbd_abort_request;
+	d->bdev->rq->direct_access = rbd_direct_access;
 	d->bdev->rq->priv = d;
 
 	/* Register block device instance */
@@ -0,0 +1,344 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file bcm2835-dma.c
+ * @author agent (agent@local)
+ * @brief Broadcom BCM2835 DMA controller driver
+ *
+ * Only the full DMA channels (0 to 6) available to ARM as per the
+ * "brcm,dma-channel-mask" attribute are used. Each chunk is described
+ * by a single control block. The DMA controller sees memory via bus
+ * addresses hence "dma-bus-offset" attribute (default 0xC0000000
+ * i.e. uncached alias) is added to host physical addresses.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_host_io.h>
+#include <vmm_host_irq.h>
+#include <vmm_modules.h>
+#include <vmm_devtree.h>
+#include <vmm_devdrv.h>
+#include <vmm_dmaengine.h>
+#include <arch_barrier.h>
+
+#define MODULE_DESC			"BCM2835 DMA Controller Driver"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(VMM_DMAENGINE_IPRIORITY+1)
+#define	MODULE_INIT			bcm2835_dma_driver_init
+#define	MODULE_EXIT			bcm2835_dma_driver_exit
+
+#define BCM2835_DMA_CHAN(n)		((n) << 8)
+#define BCM2835_DMA_CS			0x00
+#define BCM2835_DMA_CS_ACTIVE		(1 << 0)
+#define BCM2835_DMA_CS_END		(1 << 1)
+#define BCM2835_DMA_CS_INT		(1 << 2)
+#define BCM2835_DMA_CS_ERROR		(1 << 8)
+#define BCM2835_DMA_CS_WAIT_WRITES	(1 << 28)
+#define BCM2835_DMA_CS_RESET		(1 << 31)
+#define BCM2835_DMA_ADDR		0x04
+#define BCM2835_DMA_DEBUG		0x20
+#define BCM2835_DMA_ENABLE		0xff0
+
+#define BCM2835_DMA_TI_INT_EN		(1 << 0)
+#define BCM2835_DMA_TI_WAIT_RESP	(1 << 3)
+#define BCM2835_DMA_TI_D_INC		(1 << 4)
+#define BCM2835_DMA_TI_S_INC		(1 << 8)
+#define BCM2835_DMA_TI_S_IGNORE		(1 << 11)
+
+#define BCM2835_DMA_MAX_CHANS		7
+#define BCM2835_DMA_MAX_LEN		0x3fffffe0
+#define BCM2835_DMA_BUS_OFFSET		0xC0000000
+
+/* Control block (must be 32 byte aligned) */
+struct bcm2835_dma_cb {
+	u32 info;
+	u32 src;
+	u32 dst;
+	u32 length;
+	u32 stride;
+	u32 next;
+	u32 pad[2];
+};
+
+struct bcm2835_dma_chan {
+	virtual_addr_t base;
+	u32 irq;
+	void *cb_alloc;
+	struct bcm2835_dma_cb *cb;
+	physical_addr_t cb_pa;
+};
+
+struct bcm2835_dmac {
+	struct vmm_device *dev;
+	virtual_addr_t base;
+	u32 bus_offset;
+	u32 chan_count;
+	struct bcm2835_dma_chan pchans[BCM2835_DMA_MAX_CHANS];
+	struct vmm_dma_chan chans[BCM2835_DMA_MAX_CHANS];
+	struct vmm_dma_device ddev;
+};
+
+static int bcm2835_dma_xfer(struct vmm_dma_chan *chan, u32 type,
+			    physical_addr_t dst, physical_addr_t src,
+			    u32 value, physical_size_t len)
+{
+	struct bcm2835_dma_chan *pch = chan->priv;
+	struct bcm2835_dmac *bd = chan->ddev->priv;
+	struct bcm2835_dma_cb *cb = pch->cb;
+
+	if (vmm_readl((void *)(pch->base + BCM2835_DMA_CS)) &
+						BCM2835_DMA_CS_ACTIVE) {
+		return VMM_EBUSY;
+	}
+
+	cb->info = BCM2835_DMA_TI_INT_EN | BCM2835_DMA_TI_WAIT_RESP |
+		   BCM2835_DMA_TI_D_INC;
+	if (type == VMM_DMA_MEMSET) {
+		/* Only zero memset is supported (see caps) */
+		cb->info |= BCM2835_DMA_TI_S_IGNORE;
+		cb->src = 0;
+	} else {
+		cb->info |= BCM2835_DMA_TI_S_INC;
+		cb->src = (u32)src + bd->bus_offset;
+	}
+	cb->dst = (u32)dst + bd->bus_offset;
+	cb->length = (u32)len;
+	cb->stride = 0;
+	cb->next = 0;
+
+	arch_wmb();
+
+	vmm_writel((u32)pch->cb_pa + bd->bus_offset,
+		   (void *)(pch->base + BCM2835_DMA_ADDR));
+	vmm_writel(BCM2835_DMA_CS_ACTIVE | BCM2835_DMA_CS_WAIT_WRITES,
+		   (void *)(pch->base + BCM2835_DMA_CS));
+
+	return VMM_OK;
+}
+
+static void bcm2835_dma_terminate(struct vmm_dma_chan *chan)
+{
+	struct bcm2835_dma_chan *pch = chan->priv;
+
+	vmm_writel(BCM2835_DMA_CS_RESET,
+		   (void *)(pch->base + BCM2835_DMA_CS));
+}
+
+static vmm_irq_return_t bcm2835_dma_irq_handler(int irq_no, void *dev)
+{
+	u32 cs;
+	struct vmm_dma_chan *chan = dev;
+	struct bcm2835_dma_chan *pch = chan->priv;
+
+	cs = vmm_readl((void *)(pch->base + BCM2835_DMA_CS));
+	if (!(cs & BCM2835_DMA_CS_INT)) {
+		return VMM_IRQ_NONE;
+	}
+
+	/* Acknowledge interrupt and end flag */
+	vmm_writel(BCM2835_DMA_CS_INT | BCM2835_DMA_CS_END,
+		   (void *)(pch->base + BCM2835_DMA_CS));
+
+	if (cs & BCM2835_DMA_CS_ERROR) {
+		/* Error bits of DEBUG register are write-one-to-clear */
+		vmm_writel(vmm_readl((void *)(pch->base + BCM2835_DMA_DEBUG)),
+			   (void *)(pch->base + BCM2835_DMA_DEBUG));
+		vmm_dma_chan_done(chan, VMM_EIO);
+	} else {
+		vmm_dma_chan_done(chan, VMM_OK);
+	}
+
+	return VMM_IRQ_HANDLED;
+}
+
+static void bcm2835_dma_free_chans(struct bcm2835_dmac *bd)
+{
+	u32 c;
+	struct bcm2835_dma_chan *pch;
+
+	for (c = 0; c < bd->chan_count; c++) {
+		pch = &bd->pchans[c];
+		if (pch->irq) {
+			vmm_host_irq_unregister(pch->irq, &bd->chans[c]);
+		}
+		if (pch->cb_alloc) {
+			vmm_dma_free(pch->cb_alloc);
+		}
+	}
+	bd->chan_count = 0;
+}
+
+static int bcm2835_dma_driver_probe(struct vmm_device *dev,
+				    const struct vmm_devtree_nodeid *devid)
+{
+	int rc;
+	u32 i, mask, enable;
+	physical_addr_t pa;
+	struct bcm2835_dmac *bd;
+	struct bcm2835_dma_chan *pch;
+
+	bd = vmm_zalloc(sizeof(*bd));
+	if (!bd) {
+		return VMM_ENOMEM;
+	}
+	bd->dev = dev;
+
+	rc = vmm_devtree_request_regmap(dev->of_node, &bd->base, 0,
+					"BCM2835 DMA");
+	if (rc) {
+		goto free_bd;
+	}
+
+	if (vmm_devtree_read_u32(dev->of_node, "brcm,dma-channel-mask",
+				 &mask)) {
+		mask = (1 << BCM2835_DMA_MAX_CHANS) - 1;
+	}
+	if (vmm_devtree_read_u32(dev->of_node, "dma-bus-offset",
+				 &bd->bus_offset)) {
+		bd->bus_offset = BCM2835_DMA_BUS_OFFSET;
+	}
+
+	enable = vmm_readl((void *)(bd->base + BCM2835_DMA_ENABLE));
+	for (i = 0; i < BCM2835_DMA_MAX_CHANS; i++) {
+		if (!(mask & (1 << i))) {
+			continue;
+		}
+		pch = &bd->pchans[bd->chan_count];
+		pch->base = bd->base + BCM2835_DMA_CHAN(i);
+
+		/* Control block is aligned to 32 bytes */
+		pch->cb_alloc = vmm_dma_zalloc_phy(2 * sizeof(*pch->cb), &pa);
+		if (!pch->cb_alloc) {
+			rc = VMM_ENOMEM;
+			goto free_chans;
+		}
+		pch->cb = (void *)(((virtual_addr_t)pch->cb_alloc +
+				sizeof(*pch->cb) - 1) & ~(sizeof(*pch->cb) - 1));
+		pch->cb_pa = pa + ((virtual_addr_t)pch->cb -
+				   (virtual_addr_t)pch->cb_alloc);
+
+		bd->chans[bd->chan_count].priv = pch;
+		bd->chan_count++;
+
+		/* Interrupts are listed in channel order */
+		pch->irq = vmm_devtree_irq_parse_map(dev->of_node, i);
+		if (!pch->irq) {
+			rc = VMM_ENODEV;
+			goto free_chans;
+		}
+		rc = vmm_host_irq_register(pch->irq, dev->name,
+					   bcm2835_dma_irq_handler,
+					   &bd->chans[bd->chan_count - 1]);
+		if (rc) {
+			pch->irq = 0;
+			goto free_chans;
+		}
+
+		vmm_writel(BCM2835_DMA_CS_RESET,
+			   (void *)(pch->base + BCM2835_DMA_CS));
+		enable |= (1 << i);
+	}
+	if (!bd->chan_count) {
+		rc = VMM_ENODEV;
+		goto free_reg;
+	}
+	vmm_writel(enable, (void *)(bd->base + BCM2835_DMA_ENABLE));
+
+	bd->ddev.name = dev->name;
+	bd->ddev.dev = dev;
+	bd->ddev.caps = VMM_DMA_CAP_MEMCPY | VMM_DMA_CAP_MEMZERO;
+	bd->ddev.align = 4;
+	bd->ddev.max_len = BCM2835_DMA_MAX_LEN;
+	bd->ddev.chan_count = bd->chan_count;
+	bd->ddev.chans = bd->chans;
+	bd->ddev.xfer = bcm2835_dma_xfer;
+	bd->ddev.terminate = bcm2835_dma_terminate;
+	bd->ddev.priv = bd;
+	rc = vmm_dma_register_device(&bd->ddev);
+	if (rc) {
+		goto free_chans;
+	}
+
+	dev->priv = bd;
+
+	vmm_printf("%s: %d channels\n", dev->name, bd->chan_count);
+
+	return VMM_OK;
+
+free_chans:
+	bcm2835_dma_free_chans(bd);
+free_reg:
+	vmm_devtree_regunmap_release(dev->of_node, bd->base, 0);
+free_bd:
+	vmm_free(bd);
+	return rc;
+}
+
+static int bcm2835_dma_driver_remove(struct vmm_device *dev)
+{
+	int rc;
+	struct bcm2835_dmac *bd = dev->priv;
+
+	if (!bd) {
+		return VMM_OK;
+	}
+
+	rc = vmm_dma_unregister_device(&bd->ddev);
+	if (rc) {
+		return rc;
+	}
+
+	bcm2835_dma_free_chans(bd);
+	vmm_devtree_regunmap_release(dev->of_node, bd->base, 0);
+	vmm_free(bd);
+	dev->priv = NULL;
+
+	return VMM_OK;
+}
+
+static struct vmm_devtree_nodeid bcm2835_dma_devid_table[] = {
+	{ .compatible = "brcm,bcm2835-dma" },
+	{ /* end of list */ },
+};
+
+static struct vmm_driver bcm2835_dma_driver = {
+	.name = "bcm2835_dma",
+	.match_table = bcm2835_dma_devid_table,
+	.probe = bcm2835_dma_driver_probe,
+	.remove = bcm2835_dma_driver_remove,
+};
+
+static int __init bcm2835_dma_driver_init(void)
+{
+	return vmm_devdrv_register_driver(&bcm2835_dma_driver);
+}
+
+static void __exit bcm2835_dma_driver_exit(void)
+{
+	vmm_devdrv_unregister_driver(&bcm2835_dma_driver);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -0,0 +1,428 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file pl330.c
+ * @author agent (agent@local)
+ * @brief PrimeCell PL330 DMA controller driver
+ *
+ * Each channel thread runs a small microcode program per chunk which
+ * does 64 byte bursts (16 beats of 4 bytes) followed by single beats
+ * for the remaining bytes and then signals the event (interrupt) of
+ * channel. For memset, source address points to the 32bit pattern
+ * placed at the end of microcode buffer and is not incremented.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_host_io.h>
+#include <vmm_host_irq.h>
+#include <vmm_modules.h>
+#include <vmm_devtree.h>
+#include <vmm_devdrv.h>
+#include <vmm_dmaengine.h>
+#include <arch_barrier.h>
+
+#define MODULE_DESC			"PL330 DMA Controller Driver"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(VMM_DMAENGINE_IPRIORITY+1)
+#define	MODULE_INIT			pl330_driver_init
+#define	MODULE_EXIT			pl330_driver_exit
+
+#define PL330_DS			0x000
+#define PL330_DS_DNS			(1 << 9)
+#define PL330_INTEN			0x020
+#define PL330_INTSTATUS			0x028
+#define PL330_INTCLR			0x02c
+#define PL330_FSC			0x034
+#define PL330_CS(n)			(0x100 + (n) * 0x8)
+#define PL330_CS_STATUS_MASK		0xf
+#define PL330_DBGSTATUS			0xd00
+#define PL330_DBGSTATUS_BUSY		(1 << 0)
+#define PL330_DBGCMD			0xd04
+#define PL330_DBGINST0			0xd08
+#define PL330_DBGINST1			0xd0c
+#define PL330_CR0			0xe00
+#define PL330_CR0_NUM_CHNLS_SHIFT	4
+#define PL330_CR0_NUM_CHNLS_MASK	0x7
+#define PL330_CR0_NUM_EVENTS_SHIFT	17
+#define PL330_CR0_NUM_EVENTS_MASK	0x1f
+
+#define PL330_CCR_SRC_INC		(1 << 0)
+#define PL330_CCR_SRC_BSIZE_SHIFT	1
+#define PL330_CCR_SRC_BLEN_SHIFT	4
+#define PL330_CCR_SRC_PROT_SHIFT	8
+#define PL330_CCR_DST_INC		(1 << 14)
+#define PL330_CCR_DST_BSIZE_SHIFT	15
+#define PL330_CCR_DST_BLEN_SHIFT	18
+#define PL330_CCR_DST_PROT_SHIFT	22
+#define PL330_CCR_PROT_PRIV		(1 << 0)
+#define PL330_CCR_PROT_NS		(1 << 1)
+
+#define PL330_INSN_END			0x00
+#define PL330_INSN_KILL			0x01
+#define PL330_INSN_LD			0x04
+#define PL330_INSN_ST			0x08
+#define PL330_INSN_WMB			0x13
+#define PL330_INSN_LP			0x20
+#define PL330_INSN_SEV			0x34
+#define PL330_INSN_LPEND		0x38
+#define PL330_INSN_GO			0xa0
+#define PL330_INSN_MOV			0xbc
+
+#define PL330_MOV_SAR			0
+#define PL330_MOV_CCR			1
+#define PL330_MOV_DAR			2
+
+#define PL330_BEAT_SIZE			4
+#define PL330_BURST_BEATS		16
+#define PL330_BURST_SIZE		(PL330_BEAT_SIZE * PL330_BURST_BEATS)
+#define PL330_MAX_LOOP			256
+#define PL330_MCODE_SIZE		256
+#define PL330_MCODE_PATTERN		(PL330_MCODE_SIZE - 8)
+
+struct pl330_chan {
+	struct pl330_dmac *pl330;
+	u8 *mcode;
+	physical_addr_t mcode_pa;
+};
+
+struct pl330_dmac {
+	struct vmm_device *dev;
+	virtual_addr_t base;
+	bool ns;
+	u32 irq_count;
+	u32 irqs[32];
+	u32 chan_count;
+	struct pl330_chan *pchans;
+	struct vmm_dma_chan *chans;
+	struct vmm_dma_device ddev;
+};
+
+static u32 pl330_emit_mov(u8 *buf, u8 rd, u32 val)
+{
+	buf[0] = PL330_INSN_MOV;
+	buf[1] = rd;
+	buf[2] = val & 0xff;
+	buf[3] = (val >> 8) & 0xff;
+	buf[4] = (val >> 16) & 0xff;
+	buf[5] = (val >> 24) & 0xff;
+
+	return 6;
+}
+
+static u32 pl330_emit_loop(u8 *buf, bool src_inc, bool ns,
+			   u32 beats, u32 iter)
+{
+	u32 off = 0, body, ccr, prot;
+
+	prot = PL330_CCR_PROT_PRIV | ((ns) ? PL330_CCR_PROT_NS : 0);
+	ccr = PL330_CCR_DST_INC | ((src_inc) ? PL330_CCR_SRC_INC : 0);
+	ccr |= (2 << PL330_CCR_SRC_BSIZE_SHIFT) |
+	       (2 << PL330_CCR_DST_BSIZE_SHIFT);
+	ccr |= ((beats - 1) << PL330_CCR_SRC_BLEN_SHIFT) |
+	       ((beats - 1) << PL330_CCR_DST_BLEN_SHIFT);
+	ccr |= (prot << PL330_CCR_SRC_PROT_SHIFT) |
+	       (prot << PL330_CCR_DST_PROT_SHIFT);
+
+	off += pl330_emit_mov(&buf[off], PL330_MOV_CCR, ccr);
+
+	/* DMALP lc0, iter */
+	buf[off++] = PL330_INSN_LP;
+	buf[off++] = iter - 1;
+	body = off;
+	buf[off++] = PL330_INSN_LD;
+	buf[off++] = PL330_INSN_ST;
+	/* DMALPEND lc0 (backward jump to loop body) */
+	buf[off] = PL330_INSN_LPEND;
+	buf[off + 1] = off - body;
+	off += 2;
+
+	return off;
+}
+
+static void pl330_debug_exec(struct pl330_dmac *pl330, u32 insn0, u32 insn1)
+{
+	while (vmm_readl((void *)(pl330->base + PL330_DBGSTATUS)) &
+						PL330_DBGSTATUS_BUSY) ;
+
+	vmm_writel(insn0, (void *)(pl330->base + PL330_DBGINST0));
+	vmm_writel(insn1, (void *)(pl330->base + PL330_DBGINST1));
+	vmm_writel(0, (void *)(pl330->base + PL330_DBGCMD));
+}
+
+static int pl330_xfer(struct vmm_dma_chan *chan, u32 type,
+		      physical_addr_t dst, physical_addr_t src,
+		      u32 value, physical_size_t len)
+{
+	u32 off = 0, bursts, beats;
+	bool memset = (type == VMM_DMA_MEMSET) ? TRUE : FALSE;
+	struct pl330_chan *pch = chan->priv;
+	struct pl330_dmac *pl330 = pch->pl330;
+	u8 *mc = pch->mcode;
+
+	if ((vmm_readl((void *)(pl330->base + PL330_CS(chan->id))) &
+					PL330_CS_STATUS_MASK)) {
+		return VMM_EBUSY;
+	}
+
+	bursts = len / PL330_BURST_SIZE;
+	beats = (len % PL330_BURST_SIZE) / PL330_BEAT_SIZE;
+
+	if (memset) {
+		*((u32 *)&mc[PL330_MCODE_PATTERN]) = value;
+		src = pch->mcode_pa + PL330_MCODE_PATTERN;
+	}
+
+	off += pl330_emit_mov(&mc[off], PL330_MOV_SAR, src);
+	off += pl330_emit_mov(&mc[off], PL330_MOV_DAR, dst);
+	if (bursts) {
+		off += pl330_emit_loop(&mc[off], !memset, pl330->ns,
+				       PL330_BURST_BEATS, bursts);
+	}
+	if (beats) {
+		off += pl330_emit_loop(&mc[off], !memset, pl330->ns,
+				       1, beats);
+	}
+	mc[off++] = PL330_INSN_WMB;
+	mc[off++] = PL330_INSN_SEV;
+	mc[off++] = chan->id << 3;
+	mc[off++] = PL330_INSN_END;
+
+	arch_wmb();
+
+	/* DMAGO from manager thread */
+	pl330_debug_exec(pl330,
+		(chan->id << 24) |
+		((PL330_INSN_GO | ((pl330->ns) ? 0x2 : 0x0)) << 16),
+		(u32)pch->mcode_pa);
+
+	return VMM_OK;
+}
+
+static void pl330_terminate(struct vmm_dma_chan *chan)
+{
+	struct pl330_chan *pch = chan->priv;
+
+	/* DMAKILL on channel thread */
+	pl330_debug_exec(pch->pl330,
+			 (PL330_INSN_KILL << 16) | (chan->id << 8) | 0x1, 0);
+}
+
+static vmm_irq_return_t pl330_irq_handler(int irq_no, void *dev)
+{
+	u32 c, status, fault;
+	struct pl330_dmac *pl330 = dev;
+
+	status = vmm_readl((void *)(pl330->base + PL330_INTSTATUS));
+	fault = vmm_readl((void *)(pl330->base + PL330_FSC));
+
+	for (c = 0; c < pl330->chan_count; c++) {
+		if (fault & (1 << c)) {
+			pl330_terminate(&pl330->chans[c]);
+			vmm_dma_chan_done(&pl330->chans[c], VMM_EIO);
+		} else if (status & (1 << c)) {
+			vmm_writel(1 << c,
+				   (void *)(pl330->base + PL330_INTCLR));
+			vmm_dma_chan_done(&pl330->chans[c], VMM_OK);
+		}
+	}
+
+	return VMM_IRQ_HANDLED;
+}
+
+static int pl330_driver_probe(struct vmm_device *dev,
+			      const struct vmm_devtree_nodeid *devid)
+{
+	int rc;
+	u32 c, i, cr0, events;
+	struct pl330_dmac *pl330;
+
+	pl330 = vmm_zalloc(sizeof(*pl330));
+	if (!pl330) {
+		return VMM_ENOMEM;
+	}
+	pl330->dev = dev;
+
+	rc = vmm_devtree_request_regmap(dev->of_node, &pl330->base, 0,
+					"PL330 DMAC");
+	if (rc) {
+		goto free_pl330;
+	}
+
+	pl330->ns = (vmm_readl((void *)(pl330->base + PL330_DS)) &
+					PL330_DS_DNS) ? TRUE : FALSE;
+	cr0 = vmm_readl((void *)(pl330->base + PL330_CR0));
+	pl330->chan_count = ((cr0 >> PL330_CR0_NUM_CHNLS_SHIFT) &
+					PL330_CR0_NUM_CHNLS_MASK) + 1;
+	events = ((cr0 >> PL330_CR0_NUM_EVENTS_SHIFT) &
+					PL330_CR0_NUM_EVENTS_MASK) + 1;
+	if (events < pl330->chan_count) {
+		pl330->chan_count = events;
+	}
+
+	pl330->chans = vmm_zalloc(pl330->chan_count * sizeof(*pl330->chans));
+	pl330->pchans = vmm_zalloc(pl330->chan_count * sizeof(*pl330->pchans));
+	if (!pl330->chans || !pl330->pchans) {
+		rc = VMM_ENOMEM;
+		goto free_chans;
+	}
+	for (c = 0; c < pl330->chan_count; c++) {
+		pl330->pchans[c].pl330 = pl330;
+		pl330->pchans[c].mcode = vmm_dma_zalloc_phy(PL330_MCODE_SIZE,
+						&pl330->pchans[c].mcode_pa);
+		if (!pl330->pchans[c].mcode) {
+			rc = VMM_ENOMEM;
+			goto free_mcode;
+		}
+	}
+
+	/* Events of channels signal interrupts */
+	vmm_writel((1 << pl330->chan_count) - 1,
+		   (void *)(pl330->base + PL330_INTEN));
+
+	pl330->irq_count = vmm_devtree_irq_count(dev->of_node);
+	if (!pl330->irq_count) {
+		rc = VMM_ENODEV;
+		goto free_mcode;
+	}
+	if (array_size(pl330->irqs) < pl330->irq_count) {
+		pl330->irq_count = array_size(pl330->irqs);
+	}
+	for (i = 0; i < pl330->irq_count; i++) {
+		pl330->irqs[i] = vmm_devtree_irq_parse_map(dev->of_node, i);
+		if (!pl330->irqs[i]) {
+			rc = VMM_ENODEV;
+			goto free_irqs;
+		}
+		rc = vmm_host_irq_register(pl330->irqs[i], dev->name,
+					   pl330_irq_handler, pl330);
+		if (rc) {
+			goto free_irqs;
+		}
+	}
+
+	pl330->ddev.name = dev->name;
+	pl330->ddev.dev = dev;
+	pl330->ddev.caps = VMM_DMA_CAP_MEMCPY | VMM_DMA_CAP_MEMSET;
+	pl330->ddev.align = PL330_BEAT_SIZE;
+	pl330->ddev.max_len = PL330_MAX_LOOP * PL330_BURST_SIZE;
+	pl330->ddev.chan_count = pl330->chan_count;
+	pl330->ddev.chans = pl330->chans;
+	pl330->ddev.xfer = pl330_xfer;
+	pl330->ddev.terminate = pl330_terminate;
+	pl330->ddev.priv = pl330;
+	for (c = 0; c < pl330->chan_count; c++) {
+		pl330->chans[c].priv = &pl330->pchans[c];
+	}
+	rc = vmm_dma_register_device(&pl330->ddev);
+	if (rc) {
+		goto free_irqs;
+	}
+
+	dev->priv = pl330;
+
+	vmm_printf("%s: %d channels%s\n", dev->name, pl330->chan_count,
+		   (pl330->ns) ? " (non-secure)" : "");
+
+	return VMM_OK;
+
+free_irqs:
+	while (i--) {
+		vmm_host_irq_unregister(pl330->irqs[i], pl330);
+	}
+	vmm_writel(0, (void *)(pl330->base + PL330_INTEN));
+free_mcode:
+	for (c = 0; c < pl330->chan_count; c++) {
+		if (pl330->pchans[c].mcode) {
+			vmm_dma_free(pl330->pchans[c].mcode);
+		}
+	}
+free_chans:
+	if (pl330->pchans) {
+		vmm_free(pl330->pchans);
+	}
+	if (pl330->chans) {
+		vmm_free(pl330->chans);
+	}
+	vmm_devtree_regunmap_release(dev->of_node, pl330->base, 0);
+free_pl330:
+	vmm_free(pl330);
+	return rc;
+}
+
+static int pl330_driver_remove(struct vmm_device *dev)
+{
+	int rc;
+	u32 c, i;
+	struct pl330_dmac *pl330 = dev->priv;
+
+	if (!pl330) {
+		return VMM_OK;
+	}
+
+	rc = vmm_dma_unregister_device(&pl330->ddev);
+	if (rc) {
+		return rc;
+	}
+
+	vmm_writel(0, (void *)(pl330->base + PL330_INTEN));
+	for (i = 0; i < pl330->irq_count; i++) {
+		vmm_host_irq_unregister(pl330->irqs[i], pl330);
+	}
+	for (c = 0; c < pl330->chan_count; c++) {
+		vmm_dma_free(pl330->pchans[c].mcode);
+	}
+	vmm_free(pl330->pchans);
+	vmm_free(pl330->chans);
+	vmm_devtree_regunmap_release(dev->of_node, pl330->base, 0);
+	vmm_free(pl330);
+	dev->priv = NULL;
+
+	return VMM_OK;
+}
+
+static struct vmm_devtree_nodeid pl330_devid_table[] = {
+	{ .compatible = "arm,pl330" },
+	{ /* end of list */ },
+};
+
+static struct vmm_driver pl330_driver = {
+	.name = "pl330_dma",
+	.match_table = pl330_devid_table,
+	.probe = pl330_driver_probe,
+	.remove = pl330_driver_remove,
+};
+
+static int __init pl330_driver_init(void)
+{
+	return vmm_devdrv_register_driver(&pl330_driver);
+}
+
+static void __exit pl330_driver_exit(void)
+{
+	vmm_devdrv_unregister_driver(&pl330_driver);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
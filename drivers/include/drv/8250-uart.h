@@ -26,6 +26,7 @@
 #define __UART_H_
 
 #include <vmm_types.h>
+#include <vmm_spinlocks.h>
 
 #define UART_RBR_OFFSET		0	/* In:  Recieve Buffer Register */
 #define UART_THR_OFFSET		0	/* Out: Transmitter Holding Register */
@@ -41,6 +42,12 @@
 #define UART_SCR_OFFSET		7	/* I/O: Scratch Register */
 #define UART_MDR1_OFFSET	8	/* I/O:  Mode Register */
 
+#define UART_FCR_ENABLE_FIFO	0x01	/* Enable the FIFO */
+#define UART_FCR_CLEAR_RCVR	0x02	/* Clear the RCVR FIFO */
+#define UART_FCR_CLEAR_XMIT	0x04	/* Clear the XMIT FIFO */
+#define UART_FCR_R_TRIG_00	0x00	/* RCVR trigger at 1 byte */
+#define UART_FCR_R_TRIG_10	0x80	/* RCVR trigger at 8 bytes */
+
 #define UART_LSR_FIFOE		0x80    /* Fifo error */
 #define UART_LSR_TEMT		0x40    /* Transmitter empty */
 #define UART_LSR_THRE		0x20    /* Transmit-hold-register empty */
@@ -78,6 +85,8 @@ struct uart_8250_port {
 	u32 irq;
 	u32 ier;
 	u32 lcr_last;
+	u32 fifo_size;
+	vmm_spinlock_t lock;
 };
 
 bool uart_8250_lowlevel_can_getc(struct uart_8250_port *port);
@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file cowbd.h
+ * @author agent (agent@local)
+ * @brief Interface for copy-on-write overlay block device driver.
+ *
+ * A COW block device layers a sparse in-memory write overlay on top
+ * of a shared base block device. Writes only update the overlay and
+ * reads return overlay blocks where present and base blocks elsewhere
+ * hence many Guests can be cloned from one read-only base image.
+ */
+
+#ifndef __COWBD_H_
+#define __COWBD_H_
+
+#include <vmm_types.h>
+#include <vmm_spinlocks.h>
+#include <vmm_host_aspace.h>
+#include <libs/list.h>
+#include <libs/radix-tree.h>
+#include <block/vmm_blockdev.h>
+
+#define COWBD_IPRIORITY			(VMM_BLOCKDEV_CLASS_IPRIORITY+1)
+#define COWBD_CHUNK_SIZE		VMM_PAGE_SIZE
+
+/* Copy-on-write block device (COWBD) context */
+struct cowbd {
+	struct dlist head;
+	struct vmm_blockdev *bdev;
+	struct vmm_blockdev *base;
+	u32 chunk_blocks;
+	u32 chunk_shift;
+
+	vmm_spinlock_t lock;
+	struct radix_tree_root chunks;
+	u32 chunk_count;
+	struct dlist inflight;
+};
+
+/** Create COWBD instance on top of given base block device */
+struct cowbd *cowbd_create(const char *name, const char *base_name);
+
+/** Destroy COWBD instance
+ *  Note: Returns VMM_EBUSY if base reads are in-flight.
+ */
+int cowbd_destroy(struct cowbd *d);
+
+/** Discard all blocks written to COWBD instance */
+int cowbd_reset(struct cowbd *d);
+
+/** Find a COWBD instance with given name */
+struct cowbd *cowbd_find(const char *name);
+
+/** Get COWBD instance with given index */
+struct cowbd *cowbd_get(int index);
+
+/** Count number of COWBD instances */
+u32 cowbd_count(void);
+
+#endif /* __COWBD_H_ */
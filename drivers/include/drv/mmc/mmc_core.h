@@ -149,6 +149,8 @@
 #define EXT_CSD_HC_WP_GRP_SIZE		221	/* RO */
 #define EXT_CSD_HC_ERASE_GRP_SIZE	224	/* RO */
 #define EXT_CSD_BOOT_MULT		226	/* RO */
+#define EXT_CSD_MAX_PACKED_WRITES	500	/* RO */
+#define EXT_CSD_MAX_PACKED_READS	501	/* RO */
 
 /*
  * EXT_CSD field definitions
@@ -228,6 +230,12 @@ struct mmc_data {
 	u32 flags;
 	u32 blocks;
 	u32 blocksize;
+	/* Note: If sg_count is non-zero then data buffer is described
+	 * by sg list (host physical addresses) instead of dest/src.
+	 * Only passed to hosts having MMC_CAP2_SG capability.
+	 */
+	struct vmm_request_sg *sg;
+	u32 sg_count;
 };
 
 struct mmc_request {
@@ -293,6 +301,11 @@ struct mmc_card {
 	u64 capacity_rpmb;
 	u64 capacity_gp[4];
 
+	/* Packed write support (only eMMC 4.5 or higher) */
+	u32 max_packed_writes;
+	u32 *packed_hdr;
+	struct vmm_request_sg *packed_sg;
+
 	struct vmm_blockdev *bdev;
 };
 
@@ -370,12 +383,17 @@ struct mmc_host {
 #define MMC_CAP2_CD_ACTIVE_HIGH	(1 << 10)	/* Card-detect signal active high */
 #define MMC_CAP2_RO_ACTIVE_HIGH	(1 << 11)	/* Write-protect signal active high */
 #define MMC_CAP2_AUTO_CMD12	(1 << 18)
+#define MMC_CAP2_SG		(1 << 19)	/* Data transfer using sg list */
+#define MMC_CAP2_PACKED_WR	(1 << 20)	/* Allow packed write */
 
 	u32 f_min;
 	u32 f_max;
 	u32 b_max;
+	u32 max_segs; /* Max sg list entries per data transfer */
 
 	struct dlist io_list;
+	struct dlist io_free_list; /* Free IO instances of io_pool */
+	void *io_pool;
 	vmm_spinlock_t io_list_lock;
 	
 	struct vmm_thread *io_thread;
@@ -332,6 +332,32 @@ struct sdhci_host;
  */
 #define SDHCI_DEFAULT_BOUNDARY_SIZE	(512 * 1024)
 #define SDHCI_DEFAULT_BOUNDARY_ARG	(7)
+
+/*
+ * ADMA2 32-bit descriptor and its attributes
+ */
+struct sdhci_adma2_desc {
+	u16 cmd;
+	u16 len;
+	u32 addr;
+} __packed;
+
+#define SDHCI_ADMA2_VALID		0x0001
+#define SDHCI_ADMA2_END			0x0002
+#define SDHCI_ADMA2_INT			0x0004
+#define SDHCI_ADMA2_TRAN		0x0020
+
+/* ADMA2 address and length alignment */
+#define SDHCI_ADMA2_ALIGN		4
+
+/* ADMA2 descriptor table entries per host */
+#define SDHCI_ADMA2_DESC_COUNT		128
+
+/* Max ADMA2 transfer and max sg list entries per transfer
+ * chosen such that descriptor table can never overflow
+ */
+#define SDHCI_ADMA2_MAX_BUF		(256 * 1024)
+#define SDHCI_ADMA2_MAX_SEGS		64
 struct sdhci_ops {
 #ifdef CONFIG_MMC_SDHCI_IO_ACCESSORS
 	u32	(*read_l)(struct sdhci_host *host, int reg);
@@ -364,10 +390,19 @@ struct sdhci_host {
 	u32 sdhci_version;
 	u32 sdhci_caps;
 
+	u32 flags; /* host flags */
+#define SDHCI_USE_SDMA		(1 << 0) /* Host is SDMA capable */
+#define SDHCI_USE_ADMA		(1 << 1) /* Host is ADMA2 capable */
+#define SDHCI_USE_DMA		(SDHCI_USE_SDMA | SDHCI_USE_ADMA)
+
 	/* struct mmc_request *mrq; /\* associated request *\/ */
 	struct mmc_cmd *cmd;	/* Current command */
 
 	void *aligned_buffer; /* Used when DMA address has to be 8-byte aligned */
+	bool dma_bounced; /* Current transfer uses aligned_buffer */
+	struct sdhci_adma2_desc *adma_desc; /* ADMA2 descriptor table */
+	physical_addr_t adma_addr; /* ADMA2 descriptor table address */
+	u32 data_intmask; /* Data interrupts of current transfer */
 	struct vmm_completion wait_command;
 	struct vmm_completion wait_dma;
 
@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file nbd.h
+ * @author agent (agent@local)
+ * @brief Interface for network block device client driver.
+ *
+ * A NBD block device forwards block IO requests to a remote NBD server
+ * over TCP using the network stack. Requests are pipelined with upto
+ * CONFIG_BLOCK_NBD_MAX_INFLIGHT requests waiting for reply and reads
+ * can be served locally by the block device page cache.
+ */
+
+#ifndef __NBD_H_
+#define __NBD_H_
+
+#include <vmm_types.h>
+#include <vmm_spinlocks.h>
+#include <vmm_completion.h>
+#include <vmm_threads.h>
+#include <libs/list.h>
+#include <libs/netstack.h>
+#include <block/vmm_blockdev.h>
+
+#define NBD_IPRIORITY			(VMM_BLOCKDEV_CLASS_IPRIORITY+1)
+#define NBD_BLOCK_SIZE			512
+#define NBD_EXPORT_NAME_SIZE		64
+
+struct nbd_req;
+
+/* Network block device (NBD) context */
+struct nbd {
+	struct dlist head;
+	struct vmm_blockdev *bdev;
+	u8 ipaddr[4];
+	u16 port;
+	char export_name[NBD_EXPORT_NAME_SIZE];
+	u16 xmit_flags;
+
+	struct netstack_socket *sk;
+	struct vmm_thread *tx_thread;
+	struct vmm_thread *rx_thread;
+	struct vmm_completion tx_avail;
+	struct vmm_completion tx_done;
+	struct vmm_completion rx_done;
+	void *discard;
+
+	vmm_spinlock_t lock;
+	bool connected;
+	bool stopping;
+	u64 next_handle;
+	struct dlist tx_list;
+	struct dlist inflight;
+	u32 inflight_count;
+	struct nbd_req *tx_cur;
+};
+
+/** Connect to NBD server and create NBD instance for given export
+ *  Note: Empty or NULL export name selects default export of server.
+ *  Note: Non-zero cache_kb enables write-through page cache for reads.
+ *  Note: This function should be called from Orphan (or Thread) context.
+ */
+struct nbd *nbd_create(const char *name, u8 *ipaddr, u16 port,
+		       const char *export_name, u32 cache_kb);
+
+/** Disconnect from NBD server and destroy NBD instance
+ *  Note: Requests not yet completed by NBD server are failed.
+ */
+int nbd_destroy(struct nbd *d);
+
+/** Find a NBD instance with given name */
+struct nbd *nbd_find(const char *name);
+
+/** Get NBD instance with given index */
+struct nbd *nbd_get(int index);
+
+/** Count number of NBD instances */
+u32 nbd_count(void);
+
+#endif /* __NBD_H_ */
@@ -44,6 +44,11 @@ struct serial {
 	vmm_spinlock_t tx_lock;
 	u32 (*tx_func)(struct serial *p, u8 *src, size_t len);
 	void *tx_priv;
+
+	/* Buffered Tx (see serial_enable_tx_fifo()) */
+	struct fifo *tx_fifo;
+	struct vmm_completion tx_space;
+	void (*tx_start)(struct serial *p);
 };
 
 /** Get private context for Serial Port Tx */
@@ -55,6 +60,18 @@ static inline void *serial_tx_priv(struct serial *p)
 /** Receive data on Serial Port */
 void serial_rx(struct serial *p, u8 *data, u32 len);
 
+/** Fetch upto len bytes of buffered Tx data of Serial Port
+ *  (Note: Called by driver when its Tx FIFO has space)
+ */
+u32 serial_tx_fetch(struct serial *p, u8 *dst, u32 len);
+
+/** Enable buffered Tx for Serial Port. Written data is queued in a
+ *  Tx FIFO and tx_start() is called with Tx lock held so that driver
+ *  can enable its Tx interrupt and pull data using serial_tx_fetch().
+ */
+int serial_enable_tx_fifo(struct serial *p, u32 tx_fifo_size,
+			  void (*tx_start)(struct serial *p));
+
 /** Create Serial Port */
 struct serial *serial_create(struct vmm_device *dev,
 			     u32 rx_fifo_size,
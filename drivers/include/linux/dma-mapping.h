@@ -69,12 +69,10 @@ static inline void dma_sync_single(dma_addr_t handle,
 				   enum dma_data_direction dir,
 				   sync_fct fct)
 {
-	virtual_addr_t start = 0;
-	virtual_addr_t end = 0;
+	virtual_addr_t start = vmm_dma_pa2va(handle);
 
-	start = VMM_PAGE_ADDR(vmm_dma_pa2va(handle));
-	end = VMM_PFN_PHYS(VMM_PFN_UP(start + size));
-	fct(start, end, dir);
+	/* Only cache lines of given range need maintenance */
+	fct(start, start + size, dir);
 }
 
 #define dma_sync_single_for_device(d, a, s, r)				\
@@ -71,6 +71,13 @@ struct net_device;
 u32 ethtool_op_get_link(struct net_device *dev);
 int ethtool_op_get_ts_info(struct net_device *dev, struct ethtool_ts_info *eti);
 
+/* Find net device by name (NULL if not a net device) */
+struct net_device *ethtool_netdev_find(const char *name);
+
+/* Get/Set interrupt coalescing parameters of net device */
+int ethtool_get_coalesce(struct net_device *dev, struct ethtool_coalesce *ec);
+int ethtool_set_coalesce(struct net_device *dev, struct ethtool_coalesce *ec);
+
 /**
  * ethtool_rxfh_indir_default - get default value for RX flow hash indirection
  * @index: Index in RX flow hash indirection table
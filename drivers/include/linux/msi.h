@@ -0,0 +1,63 @@
+#ifndef _LINUX_MSI_H
+#define _LINUX_MSI_H
+
+#include <linux/types.h>
+#include <linux/list.h>
+
+struct msi_msg {
+	u32	address_lo;	/* low 32 bits of msi message address */
+	u32	address_hi;	/* high 32 bits of msi message address */
+	u32	data;		/* 16 bits of msi message data */
+};
+
+struct msi_desc {
+	struct {
+		__u8	is_msix	: 1;
+		__u8	multiple: 3;	/* log2 num of messages allocated */
+		__u8	multi_cap : 3;	/* log2 num of messages supported */
+		__u8	maskbit	: 1;	/* mask-pending bit supported ? */
+		__u8	is_64	: 1;	/* Address size: 0=32bit 1=64bit */
+		__u16	entry_nr;	/* specific enabled entry */
+		unsigned default_irq;	/* default pre-assigned irq */
+	} msi_attrib;
+
+	u32 masked;			/* mask bits */
+	unsigned int irq;
+	unsigned int nvec_used;		/* number of messages */
+	struct list_head list;
+
+	union {
+		void __iomem *mask_base;
+		u8 mask_pos;
+	};
+	struct pci_dev *dev;
+
+	/* Last set MSI message */
+	struct msi_msg msg;
+};
+
+/* Helpers to hide struct msi_desc implementation details */
+#define msi_desc_to_dev(desc)		(&(desc)->dev->dev)
+#define dev_to_msi_list(dev)		(&to_pci_dev((dev))->msi_list)
+#define first_msi_entry(dev)		\
+	list_first_entry(dev_to_msi_list((dev)), struct msi_desc, list)
+#define for_each_msi_entry(desc, dev)	\
+	list_for_each_entry((desc), dev_to_msi_list((dev)), list)
+
+/*
+ * MSI controller of a PCI host bridge. The setup_irq() callback
+ * allocates host IRQ for given MSI descriptor and composes the
+ * MSI message (desc->msg) which is then programmed in the device.
+ */
+struct msi_controller {
+	struct module *owner;
+	struct device *dev;
+	struct device_node *of_node;
+	struct list_head list;
+
+	int (*setup_irq)(struct msi_controller *chip, struct pci_dev *dev,
+			 struct msi_desc *desc);
+	void (*teardown_irq)(struct msi_controller *chip, unsigned int irq);
+};
+
+#endif /* _LINUX_MSI_H */
@@ -33,6 +33,7 @@
 #include <net/vmm_netport.h>
 #include <net/vmm_netswitch.h>
 
+#include <linux/bitops.h>
 #include <linux/interrupt.h>
 #include <linux/skbuff.h>
 #include <linux/device.h>
@@ -160,9 +161,11 @@ struct napi_struct {
 	 * can remove from the list right before clearing the bit.
 	 */
 	struct list_head	poll_list;
+#endif /* 0 */
 
 	unsigned long		state;
 	int			weight;
+#if 0
 	unsigned int		gro_count;
 #endif /* 0 */
 	int			(*poll)(struct napi_struct *, int);
@@ -180,10 +183,22 @@ struct napi_struct {
 	struct hlist_node	napi_hash_node;
 	unsigned int		napi_id;
 #else /* 0 */
-	struct vmm_netport_xfer	xfer;
+	/* Packets received in current poll, handed to netswitch
+	 * as one batch when poll returns.
+	 */
+	struct dlist		rx_list;
+	/* Selects netswitch bottom-half running poll
+	 * (-1 means bottom-half of scheduling CPU)
+	 */
+	int			bh_hash;
 #endif /* 0 */
 };
 
+enum {
+	NAPI_STATE_SCHED,	/* Poll is scheduled */
+	NAPI_STATE_DISABLE,	/* Disable pending */
+};
+
 enum gro_result {
 	GRO_MERGED,
 	GRO_MERGED_FREE,
@@ -450,6 +465,19 @@ extern int              netdev_budget;
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight);
 
+/**
+ *	netif_napi_set_bh - steer NAPI poll to netswitch bottom-half
+ *	@napi: napi context
+ *	@hash: bottom-half selector (such as queue number) or -1
+ *
+ * Multi-queue drivers use this to spread the poll of each queue over
+ * netswitch bottom-half threads of different CPUs.
+ */
+static inline void netif_napi_set_bh(struct napi_struct *napi, int hash)
+{
+	napi->bh_hash = hash;
+}
+
 /**
  *  netif_napi_del - remove a napi context
  *  @napi: napi context
@@ -494,10 +522,39 @@ void napi_enable(struct napi_struct *n);
  */
 void napi_schedule(struct napi_struct *n);
 
+/**
+ *	napi_schedule_prep - check if NAPI can be scheduled
+ *	@n: napi context
+ *
+ * Test if NAPI routine is already running, and if not mark
+ * it as running.  This is used as a condition variable to
+ * insure only one NAPI poll instance runs.
+ */
+static inline bool napi_schedule_prep(struct napi_struct *n)
+{
+	return !test_bit(NAPI_STATE_DISABLE, &n->state) &&
+		!test_and_set_bit(NAPI_STATE_SCHED, &n->state);
+}
+
+void __napi_schedule(struct napi_struct *n);
+
+/**
+ *	napi_gro_receive - receive packet from NAPI poll routine
+ *	@napi: napi context
+ *	@skb: received packet
+ *
+ * Packets received while poll is scheduled are batched and handed
+ * to netswitch when poll returns (or upon napi_complete).
+ */
 static inline gro_result_t napi_gro_receive(struct napi_struct *napi,
 					    struct sk_buff *skb)
 {
-	return netif_rx(skb, napi->dev);
+	if (!test_bit(NAPI_STATE_SCHED, &napi->state))
+		return netif_rx(skb, napi->dev);
+
+	list_add_tail(&skb->m_list, &napi->rx_list);
+
+	return GRO_NORMAL;
 }
 
 #endif /* __LINUX_NETDEVICE_H_ */
@@ -0,0 +1,735 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file irq-gic-v3.c
+ * @author agent (agent@local)
+ * @brief Generic Interrupt Controller v3 Implementation
+ *
+ * The source has been largely adapted from Linux
+ * drivers/irqchip/irq-gic-v3.c
+ *
+ * The original code is licensed under the GPL.
+ *
+ * Copyright (C) 2013, 2014 ARM Limited, All Rights Reserved.
+ * Author: Marc Zyngier <marc.zyngier@arm.com>
+ *
+ * Interrupt architecture for the GICv3:
+ *
+ * o There is one Distributor which handles shared peripheral
+ *   interrupts (SPIs) and routes them using affinity (MPIDR) values
+ *   hence there is no limit of 8 CPUs like GICv2.
+ *
+ * o There is one Redistributor per CPU which handles SGIs and PPIs
+ *   of the CPU.
+ *
+ * o The CPU interface is accessed using ICC_xxx system registers.
+ *
+ * Note: LPIs and ITS are not supported.
+ */
+
+#include <vmm_error.h>
+#include <vmm_limits.h>
+#include <vmm_macros.h>
+#include <vmm_smp.h>
+#include <vmm_cpumask.h>
+#include <vmm_delay.h>
+#include <vmm_stdio.h>
+#include <vmm_host_io.h>
+#include <vmm_host_irq.h>
+#include <vmm_host_irqdomain.h>
+#include <arch_barrier.h>
+#include <arch_gicv3.h>
+
+#define GICD_CTLR			0x0000
+#define GICD_TYPER			0x0004
+#define GICD_IGROUPR			0x0080
+#define GICD_ISENABLER			0x0100
+#define GICD_ICENABLER			0x0180
+#define GICD_ISPENDR			0x0200
+#define GICD_ICPENDR			0x0280
+#define GICD_ISACTIVER			0x0300
+#define GICD_ICACTIVER			0x0380
+#define GICD_IPRIORITYR			0x0400
+#define GICD_ICFGR			0x0C00
+#define GICD_IROUTER			0x6000
+#define GICD_PIDR2			0xFFE8
+
+#define GICD_CTLR_RWP			(1U << 31)
+#define GICD_CTLR_ARE_NS		(1U << 4)
+#define GICD_CTLR_ENABLE_G1A		(1U << 1)
+#define GICD_CTLR_ENABLE_G1		(1U << 0)
+
+#define GICD_TYPER_IRQS(typer)		((((typer) & 0x1f) + 1) * 32)
+
+#define GICR_CTLR			0x0000
+#define GICR_TYPER			0x0008
+#define GICR_WAKER			0x0014
+#define GICR_PIDR2			GICD_PIDR2
+
+#define GICR_CTLR_RWP			(1U << 3)
+
+#define GICR_TYPER_VLPIS		(1U << 1)
+#define GICR_TYPER_LAST			(1U << 4)
+
+#define GICR_WAKER_PROCESSOR_SLEEP	(1U << 1)
+#define GICR_WAKER_CHILDREN_ASLEEP	(1U << 2)
+
+#define GIC_PIDR2_ARCH_MASK		0xf0
+#define GIC_PIDR2_ARCH_GICV3		0x30
+#define GIC_PIDR2_ARCH_GICV4		0x40
+
+/* Redistributor SGI_base frame registers */
+#define GICR_SGI_BASE			0x10000
+#define GICR_IGROUPR0			GICD_IGROUPR
+#define GICR_ISENABLER0			GICD_ISENABLER
+#define GICR_ICENABLER0			GICD_ICENABLER
+#define GICR_ISPENDR0			GICD_ISPENDR
+#define GICR_ICPENDR0			GICD_ICPENDR
+#define GICR_ISACTIVER0			GICD_ISACTIVER
+#define GICR_ICACTIVER0			GICD_ICACTIVER
+#define GICR_IPRIORITYR0		GICD_IPRIORITYR
+#define GICR_ICFGR0			GICD_ICFGR
+
+#define GIC_RWP_TIMEOUT_US		1000000
+
+#define GIC_V3_MAX_RDIST_REGIONS	8
+
+struct gic_v3_rdist_region {
+	physical_addr_t base_pa;
+	virtual_addr_t base_va;
+	physical_size_t size;
+};
+
+struct gic_v3_chip_data {
+	bool eoimode;			/* EOImode state */
+	u32 max_irqs;			/* Total IRQs */
+	virtual_addr_t dist_base;
+	u32 rdist_region_count;
+	u64 rdist_stride;
+	struct gic_v3_rdist_region rdist_regions[GIC_V3_MAX_RDIST_REGIONS];
+	virtual_addr_t rdist_base[CONFIG_CPU_COUNT];
+	u64 cpu_mpidr[CONFIG_CPU_COUNT];
+	struct vmm_host_irqdomain *domain;
+};
+
+static struct gic_v3_chip_data gic_v3_data;
+
+#define gic_write(val, addr)	vmm_writel_relaxed((val), (void *)(addr))
+#define gic_read(addr)		vmm_readl_relaxed((void *)(addr))
+#define gic_writeq(val, addr)	vmm_writeq_relaxed((val), (void *)(addr))
+#define gic_readq(addr)		vmm_readq_relaxed((void *)(addr))
+
+#define gic_this_rdist(gic)	((gic)->rdist_base[vmm_smp_processor_id()])
+#define gic_this_sgi_base(gic)	(gic_this_rdist(gic) + GICR_SGI_BASE)
+
+static inline u64 gic_v3_read_mpidr(void)
+{
+	return mrs(mpidr_el1) & 0xFF00FFFFFFULL;
+}
+
+static void gic_v3_do_wait_for_rwp(virtual_addr_t base, u32 bit)
+{
+	u32 count = GIC_RWP_TIMEOUT_US;
+
+	while (gic_read(base) & bit) {
+		count--;
+		if (!count) {
+			vmm_printf("%s: RWP timeout, gone fishing\n",
+				   __func__);
+			return;
+		}
+		vmm_udelay(1);
+	}
+}
+
+static void gic_v3_dist_wait_for_rwp(struct gic_v3_chip_data *gic)
+{
+	gic_v3_do_wait_for_rwp(gic->dist_base + GICD_CTLR, GICD_CTLR_RWP);
+}
+
+static void gic_v3_redist_wait_for_rwp(struct gic_v3_chip_data *gic)
+{
+	gic_v3_do_wait_for_rwp(gic_this_rdist(gic) + GICR_CTLR,
+			       GICR_CTLR_RWP);
+}
+
+/* SGIs and PPIs are banked in Redistributor of each CPU */
+static virtual_addr_t gic_v3_irq_base(struct gic_v3_chip_data *gic,
+				      struct vmm_host_irq *d)
+{
+	return (d->hwirq < 32) ? gic_this_sgi_base(gic) : gic->dist_base;
+}
+
+static void gic_v3_poke_irq(struct gic_v3_chip_data *gic,
+			    struct vmm_host_irq *d, u32 offset)
+{
+	u32 mask = 1 << (d->hwirq % 32);
+	gic_write(mask, gic_v3_irq_base(gic, d) + offset + (d->hwirq / 32) * 4);
+}
+
+static int gic_v3_peek_irq(struct gic_v3_chip_data *gic,
+			   struct vmm_host_irq *d, u32 offset)
+{
+	u32 mask = 1 << (d->hwirq % 32);
+	return !!(gic_read(gic_v3_irq_base(gic, d) + offset +
+			   (d->hwirq / 32) * 4) & mask);
+}
+
+static u32 gic_v3_active_irq(u32 cpu_irq_nr)
+{
+	u32 ret = gic_read_iar();
+
+	if (ret < 1020) {
+		ret = vmm_host_irqdomain_find_mapping(gic_v3_data.domain, ret);
+	} else {
+		ret = UINT_MAX;
+	}
+
+	return ret;
+}
+
+static void gic_v3_mask_irq(struct vmm_host_irq *d)
+{
+	struct gic_v3_chip_data *gic = vmm_host_irq_get_chip_data(d);
+
+	gic_v3_poke_irq(gic, d, GICD_ICENABLER);
+	if (d->hwirq < 32) {
+		gic_v3_redist_wait_for_rwp(gic);
+	} else {
+		gic_v3_dist_wait_for_rwp(gic);
+	}
+}
+
+static void gic_v3_unmask_irq(struct vmm_host_irq *d)
+{
+	gic_v3_poke_irq(vmm_host_irq_get_chip_data(d), d, GICD_ISENABLER);
+}
+
+static void gic_v3_eoi_irq(struct vmm_host_irq *d)
+{
+	struct gic_v3_chip_data *gic = vmm_host_irq_get_chip_data(d);
+
+	gic_write_eoir(d->hwirq);
+	if (gic->eoimode && !vmm_host_irq_is_routed(d)) {
+		gic_write_dir(d->hwirq);
+	}
+}
+
+static int gic_v3_set_type(struct vmm_host_irq *d, u32 type)
+{
+	struct gic_v3_chip_data *gic = vmm_host_irq_get_chip_data(d);
+	virtual_addr_t base = gic_v3_irq_base(gic, d);
+	u32 enablemask = 1 << (d->hwirq % 32);
+	u32 enableoff = (d->hwirq / 32) * 4;
+	u32 confmask = 0x2 << ((d->hwirq % 16) * 2);
+	u32 confoff = (d->hwirq / 16) * 4;
+	bool enabled = FALSE;
+	u32 val;
+
+	/* Interrupt configuration for SGIs can't be changed */
+	if (d->hwirq < 16) {
+		return VMM_EINVALID;
+	}
+
+	if (type != VMM_IRQ_TYPE_LEVEL_HIGH &&
+	    type != VMM_IRQ_TYPE_EDGE_RISING) {
+		return VMM_EINVALID;
+	}
+
+	val = gic_read(base + GICD_ICFGR + confoff);
+	if (type == VMM_IRQ_TYPE_LEVEL_HIGH) {
+		val &= ~confmask;
+	} else if (type == VMM_IRQ_TYPE_EDGE_RISING) {
+		val |= confmask;
+	}
+
+	/*
+	 * As recommended by the spec, disable the interrupt before changing
+	 * the configuration
+	 */
+	if (gic_read(base + GICD_ISENABLER + enableoff) & enablemask) {
+		gic_write(enablemask, base + GICD_ICENABLER + enableoff);
+		if (d->hwirq < 32) {
+			gic_v3_redist_wait_for_rwp(gic);
+		} else {
+			gic_v3_dist_wait_for_rwp(gic);
+		}
+		enabled = TRUE;
+	}
+
+	gic_write(val, base + GICD_ICFGR + confoff);
+
+	if (enabled) {
+		gic_write(enablemask, base + GICD_ISENABLER + enableoff);
+	}
+
+	return 0;
+}
+
+#ifdef CONFIG_SMP
+static void gic_v3_raise(struct vmm_host_irq *d,
+			 const struct vmm_cpumask *mask)
+{
+	u32 cpu;
+	u64 mpidr, cluster, val;
+	u64 tcluster = ~0ULL;
+	u16 tlist = 0;
+
+	/*
+	 * Ensure that stores to Normal memory are visible to the
+	 * other CPUs before issuing the IPI.
+	 */
+	arch_wmb();
+
+	/* One SGI1R write for each cluster (Aff3.Aff2.Aff1) in mask */
+	for_each_cpu(cpu, mask) {
+		mpidr = gic_v3_data.cpu_mpidr[cpu];
+		cluster = mpidr & ~0xFFULL;
+		if (tlist && (cluster != tcluster)) {
+			val = ((tcluster >> 32) & 0xFF) <<
+						ICC_SGI1R_AFFINITY_3_SHIFT;
+			val |= ((tcluster >> 16) & 0xFF) <<
+						ICC_SGI1R_AFFINITY_2_SHIFT;
+			val |= ((tcluster >> 8) & 0xFF) <<
+						ICC_SGI1R_AFFINITY_1_SHIFT;
+			val |= (u64)d->hwirq << ICC_SGI1R_SGI_ID_SHIFT;
+			gic_write_sgi1r(val | tlist);
+			tlist = 0;
+		}
+		tcluster = cluster;
+		tlist |= 1 << (mpidr & 0xF);
+	}
+
+	if (tlist) {
+		val = ((tcluster >> 32) & 0xFF) << ICC_SGI1R_AFFINITY_3_SHIFT;
+		val |= ((tcluster >> 16) & 0xFF) << ICC_SGI1R_AFFINITY_2_SHIFT;
+		val |= ((tcluster >> 8) & 0xFF) << ICC_SGI1R_AFFINITY_1_SHIFT;
+		val |= (u64)d->hwirq << ICC_SGI1R_SGI_ID_SHIFT;
+		gic_write_sgi1r(val | tlist);
+	}
+
+	isb();
+}
+
+static int gic_v3_set_affinity(struct vmm_host_irq *d,
+			       const struct vmm_cpumask *mask_val,
+			       bool force)
+{
+	u32 cpu = vmm_cpumask_first(mask_val);
+	struct gic_v3_chip_data *gic = vmm_host_irq_get_chip_data(d);
+
+	if ((d->hwirq < 32) || (cpu >= CONFIG_CPU_COUNT))
+		return VMM_EINVALID;
+
+	gic_writeq(gic->cpu_mpidr[cpu],
+		   gic->dist_base + GICD_IROUTER + d->hwirq * 8);
+
+	return 0;
+}
+#endif
+
+static u32 gic_v3_irq_get_routed_state(struct vmm_host_irq *d, u32 mask)
+{
+	u32 val = 0;
+	struct gic_v3_chip_data *gic = vmm_host_irq_get_chip_data(d);
+
+	if ((mask & VMM_ROUTED_IRQ_STATE_PENDING) &&
+	    gic_v3_peek_irq(gic, d, GICD_ISPENDR))
+		val |= VMM_ROUTED_IRQ_STATE_PENDING;
+	if ((mask & VMM_ROUTED_IRQ_STATE_ACTIVE) &&
+	    gic_v3_peek_irq(gic, d, GICD_ISACTIVER))
+		val |= VMM_ROUTED_IRQ_STATE_ACTIVE;
+	if ((mask & VMM_ROUTED_IRQ_STATE_MASKED) &&
+	    !gic_v3_peek_irq(gic, d, GICD_ISENABLER))
+		val |= VMM_ROUTED_IRQ_STATE_MASKED;
+
+	return val;
+}
+
+static void gic_v3_irq_set_routed_state(struct vmm_host_irq *d,
+					u32 val, u32 mask)
+{
+	struct gic_v3_chip_data *gic = vmm_host_irq_get_chip_data(d);
+
+	if (mask & VMM_ROUTED_IRQ_STATE_PENDING)
+		gic_v3_poke_irq(gic, d, (val & VMM_ROUTED_IRQ_STATE_PENDING) ?
+				GICD_ISPENDR : GICD_ICPENDR);
+	if (mask & VMM_ROUTED_IRQ_STATE_ACTIVE)
+		gic_v3_poke_irq(gic, d, (val & VMM_ROUTED_IRQ_STATE_ACTIVE) ?
+				GICD_ISACTIVER : GICD_ICACTIVER);
+	if (mask & VMM_ROUTED_IRQ_STATE_MASKED)
+		gic_v3_poke_irq(gic, d, (val & VMM_ROUTED_IRQ_STATE_MASKED) ?
+				GICD_ICENABLER : GICD_ISENABLER);
+}
+
+static struct vmm_host_irq_chip gic_v3_chip = {
+	.name			= "GICv3",
+	.irq_mask		= gic_v3_mask_irq,
+	.irq_unmask		= gic_v3_unmask_irq,
+	.irq_eoi		= gic_v3_eoi_irq,
+	.irq_set_type		= gic_v3_set_type,
+#ifdef CONFIG_SMP
+	.irq_set_affinity	= gic_v3_set_affinity,
+	.irq_raise		= gic_v3_raise,
+#endif
+	.irq_get_routed_state	= gic_v3_irq_get_routed_state,
+	.irq_set_routed_state	= gic_v3_irq_set_routed_state,
+};
+
+static void __init gic_v3_dist_init(struct gic_v3_chip_data *gic)
+{
+	int hirq;
+	unsigned int i;
+	u64 affinity = gic_v3_read_mpidr();
+	virtual_addr_t base = gic->dist_base;
+
+	/* Disable IRQ distribution */
+	gic_write(0, base + GICD_CTLR);
+	gic_v3_dist_wait_for_rwp(gic);
+
+	/*
+	 * Configure SPIs as non-secure Group-1.
+	 */
+	for (i = 32; i < gic->max_irqs; i += 32) {
+		gic_write(~0, base + GICD_IGROUPR + i / 8);
+	}
+
+	/*
+	 * Set all global interrupts to be level triggered, active low.
+	 */
+	for (i = 32; i < gic->max_irqs; i += 16) {
+		gic_write(0, base + GICD_ICFGR + i / 4);
+	}
+
+	/*
+	 * Set priority on all global interrupts.
+	 */
+	for (i = 32; i < gic->max_irqs; i += 4) {
+		gic_write(0xa0a0a0a0, base + GICD_IPRIORITYR + i);
+	}
+
+	/*
+	 * Deactivate and disable all global interrupts.
+	 */
+	for (i = 32; i < gic->max_irqs; i += 32) {
+		gic_write(0xffffffff, base + GICD_ICACTIVER + i / 8);
+		gic_write(0xffffffff, base + GICD_ICENABLER + i / 8);
+	}
+	gic_v3_dist_wait_for_rwp(gic);
+
+	/* Enable IRQ distribution with affinity routing */
+	gic_write(GICD_CTLR_ARE_NS | GICD_CTLR_ENABLE_G1A |
+		  GICD_CTLR_ENABLE_G1, base + GICD_CTLR);
+	gic_v3_dist_wait_for_rwp(gic);
+
+	/*
+	 * Route all global interrupts to this CPU.
+	 */
+	for (i = 32; i < gic->max_irqs; i++) {
+		gic_writeq(affinity, base + GICD_IROUTER + i * 8);
+	}
+
+	/*
+	 * Setup the Host IRQ subsystem.
+	 * Note: We handle all interrupts including SGIs and PPIs via C code.
+	 */
+	for (i = 0; i < gic->max_irqs; i++) {
+		hirq = vmm_host_irqdomain_create_mapping(gic->domain, i);
+		BUG_ON(hirq < 0);
+		vmm_host_irq_set_chip(hirq, &gic_v3_chip);
+		vmm_host_irq_set_chip_data(hirq, gic);
+		if (hirq < 32) {
+			vmm_host_irq_set_handler(hirq, vmm_handle_percpu_irq);
+			if (hirq < 16) {
+				/* Mark SGIs as IPIs */
+				vmm_host_irq_mark_ipi(hirq);
+			}
+			/* Mark SGIs and PPIs as per-CPU IRQs */
+			vmm_host_irq_mark_per_cpu(hirq);
+		} else {
+			vmm_host_irq_set_handler(hirq, vmm_handle_fast_eoi);
+		}
+	}
+}
+
+static int __cpuinit gic_v3_populate_rdist(struct gic_v3_chip_data *gic)
+{
+	u32 i, reg;
+	u64 typer, mpidr = gic_v3_read_mpidr();
+	u32 aff = ((mpidr >> 32) & 0xFF) << 24 | (mpidr & 0xFFFFFF);
+	virtual_addr_t ptr, end;
+
+	for (i = 0; i < gic->rdist_region_count; i++) {
+		ptr = gic->rdist_regions[i].base_va;
+		end = ptr + gic->rdist_regions[i].size;
+
+		reg = gic_read(ptr + GICR_PIDR2) & GIC_PIDR2_ARCH_MASK;
+		if ((reg != GIC_PIDR2_ARCH_GICV3) &&
+		    (reg != GIC_PIDR2_ARCH_GICV4)) {
+			vmm_printf("%s: no redistributor at region %d\n",
+				   __func__, i);
+			break;
+		}
+
+		while (ptr < end) {
+			typer = gic_readq(ptr + GICR_TYPER);
+			if ((typer >> 32) == aff) {
+				gic_this_rdist(gic) = ptr;
+				return VMM_OK;
+			}
+
+			if (gic->rdist_stride) {
+				ptr += gic->rdist_stride;
+			} else {
+				/* RD_base + SGI_base (+ VLPI frames) */
+				ptr += 0x20000;
+				if (typer & GICR_TYPER_VLPIS) {
+					ptr += 0x20000;
+				}
+			}
+
+			if (typer & GICR_TYPER_LAST) {
+				break;
+			}
+		}
+	}
+
+	vmm_printf("%s: CPU%d MPIDR 0x%"PRIx64" has no redistributor\n",
+		   __func__, vmm_smp_processor_id(), mpidr);
+
+	return VMM_ENODEV;
+}
+
+static void __cpuinit gic_v3_redist_wake(struct gic_v3_chip_data *gic)
+{
+	u32 val, count = GIC_RWP_TIMEOUT_US;
+	virtual_addr_t rbase = gic_this_rdist(gic);
+
+	val = gic_read(rbase + GICR_WAKER);
+	val &= ~GICR_WAKER_PROCESSOR_SLEEP;
+	gic_write(val, rbase + GICR_WAKER);
+
+	while (gic_read(rbase + GICR_WAKER) & GICR_WAKER_CHILDREN_ASLEEP) {
+		count--;
+		if (!count) {
+			vmm_printf("%s: redistributor failed to wakeup\n",
+				   __func__);
+			return;
+		}
+		vmm_udelay(1);
+	}
+}
+
+static int __cpuinit gic_v3_cpu_init(struct gic_v3_chip_data *gic)
+{
+	int i, rc;
+	u64 val;
+	virtual_addr_t sbase;
+
+	gic->cpu_mpidr[vmm_smp_processor_id()] = gic_v3_read_mpidr();
+
+	rc = gic_v3_populate_rdist(gic);
+	if (rc) {
+		return rc;
+	}
+
+	gic_v3_redist_wake(gic);
+
+	/*
+	 * Deal with the banked PPI and SGI interrupts - configure them
+	 * as Group-1, disable all PPI interrupts and ensure all SGI
+	 * interrupts are enabled.
+	 */
+	sbase = gic_this_sgi_base(gic);
+	gic_write(~0, sbase + GICR_IGROUPR0);
+	gic_write(0xffffffff, sbase + GICR_ICACTIVER0);
+	gic_write(0xffff0000, sbase + GICR_ICENABLER0);
+	gic_write(0x0000ffff, sbase + GICR_ISENABLER0);
+
+	/*
+	 * Set priority on PPI and SGI interrupts
+	 */
+	for (i = 0; i < 32; i += 4) {
+		gic_write(0xa0a0a0a0, sbase + GICR_IPRIORITYR0 + i);
+	}
+	gic_v3_redist_wait_for_rwp(gic);
+
+	/* Enable system register access for EL2 and EL1 */
+	val = gic_read_sysreg(ICC_SRE_EL2);
+	gic_write_sysreg(ICC_SRE_EL2,
+			 val | ICC_SRE_EL2_SRE | ICC_SRE_EL2_ENABLE);
+	isb();
+	if (!(gic_read_sysreg(ICC_SRE_EL2) & ICC_SRE_EL2_SRE)) {
+		vmm_printf("%s: unable to set SRE (disabled at EL3?)\n",
+			   __func__);
+		return VMM_EFAIL;
+	}
+
+	gic_write_sysreg(ICC_PMR_EL1, 0xf0);
+	gic_write_sysreg(ICC_BPR1_EL1, 0);
+	gic_write_sysreg(ICC_CTLR_EL1,
+			 (gic->eoimode) ? ICC_CTLR_EL1_EOIMODE_DROP : 0);
+	gic_write_sysreg(ICC_IGRPEN1_EL1, 1);
+	isb();
+
+	return VMM_OK;
+}
+
+static int gic_v3_of_xlate(struct vmm_host_irqdomain *d,
+			   struct vmm_devtree_node *controller,
+			   const u32 *intspec, unsigned int intsize,
+			   unsigned long *out_hwirq, unsigned int *out_type)
+{
+	if (d->of_node != controller)
+		return VMM_EINVALID;
+	if (intsize < 3)
+		return VMM_EINVALID;
+
+	/* Get the interrupt number and add 16 to skip over SGIs */
+	*out_hwirq = intspec[1] + 16;
+
+	/* For SPIs, we need to add 16 more to get the GIC irq ID number */
+	if (!intspec[0])
+		*out_hwirq += 16;
+
+	*out_type = intspec[2] & VMM_IRQ_TYPE_SENSE_MASK;
+
+	return VMM_OK;
+}
+
+static struct vmm_host_irqdomain_ops gic_v3_ops = {
+	.xlate = gic_v3_of_xlate,
+};
+
+static int __init gic_v3_devtree_init(struct vmm_devtree_node *node)
+{
+	int rc;
+	u32 i, reg, irq_start = 0;
+	struct gic_v3_chip_data *gic = &gic_v3_data;
+	struct gic_v3_rdist_region *r;
+
+	if (WARN_ON(!node)) {
+		return VMM_ENODEV;
+	}
+
+	/* Hypervisor always splits priority drop and deactivation
+	 * so that routed interrupts can be deactivated by Guest.
+	 */
+	gic->eoimode = TRUE;
+
+	rc = vmm_devtree_request_regmap(node, &gic->dist_base, 0,
+					"GICv3 Dist");
+	if (rc) {
+		vmm_printf("%s: unable to map dist registers\n", __func__);
+		return rc;
+	}
+
+	reg = gic_read(gic->dist_base + GICD_PIDR2) & GIC_PIDR2_ARCH_MASK;
+	if ((reg != GIC_PIDR2_ARCH_GICV3) && (reg != GIC_PIDR2_ARCH_GICV4)) {
+		vmm_printf("%s: no distributor detected, giving up\n",
+			   __func__);
+		rc = VMM_ENODEV;
+		goto fail_unmap_dist;
+	}
+
+	if (vmm_devtree_read_u32(node, "#redistributor-regions",
+				 &gic->rdist_region_count)) {
+		gic->rdist_region_count = 1;
+	}
+	if (!gic->rdist_region_count ||
+	    (GIC_V3_MAX_RDIST_REGIONS < gic->rdist_region_count)) {
+		rc = VMM_EINVALID;
+		goto fail_unmap_dist;
+	}
+
+	for (i = 0; i < gic->rdist_region_count; i++) {
+		r = &gic->rdist_regions[i];
+		rc = vmm_devtree_regaddr(node, &r->base_pa, 1 + i);
+		if (rc) {
+			goto fail_unmap_rdist;
+		}
+		rc = vmm_devtree_regsize(node, &r->size, 1 + i);
+		if (rc) {
+			goto fail_unmap_rdist;
+		}
+		rc = vmm_devtree_request_regmap(node, &r->base_va, 1 + i,
+						"GICv3 Redist");
+		if (rc) {
+			goto fail_unmap_rdist;
+		}
+	}
+
+	if (vmm_devtree_read_u64(node, "redistributor-stride",
+				 &gic->rdist_stride)) {
+		gic->rdist_stride = 0;
+	}
+
+	if (vmm_devtree_read_u32(node, "irq_start", &irq_start)) {
+		irq_start = 0;
+	}
+
+	/*
+	 * Find out how many interrupts are supported.
+	 * Only SGIs, PPIs and SPIs (upto 1020) are supported.
+	 */
+	gic->max_irqs = GICD_TYPER_IRQS(gic_read(gic->dist_base + GICD_TYPER));
+	if (gic->max_irqs > 1020)
+		gic->max_irqs = 1020;
+
+	gic->domain = vmm_host_irqdomain_add(node, (int)irq_start,
+					     gic->max_irqs, &gic_v3_ops, gic);
+	if (!gic->domain) {
+		rc = VMM_EFAIL;
+		goto fail_unmap_rdist;
+	}
+
+	gic_v3_dist_init(gic);
+
+	rc = gic_v3_cpu_init(gic);
+	if (rc) {
+		return rc;
+	}
+
+	vmm_host_irq_set_active_callback(gic_v3_active_irq);
+
+	return VMM_OK;
+
+fail_unmap_rdist:
+	while (i--) {
+		vmm_devtree_regunmap_release(node,
+				gic->rdist_regions[i].base_va, 1 + i);
+	}
+fail_unmap_dist:
+	vmm_devtree_regunmap_release(node, gic->dist_base, 0);
+	return rc;
+}
+
+static int __cpuinit gic_v3_init(struct vmm_devtree_node *node)
+{
+	int rc;
+
+	if (vmm_smp_is_bootcpu()) {
+		rc = gic_v3_devtree_init(node);
+	} else {
+		rc = gic_v3_cpu_init(&gic_v3_data);
+	}
+
+	return rc;
+}
+
+VMM_HOST_IRQ_INIT_DECLARE(gicv3, "arm,gic-v3", gic_v3_init);
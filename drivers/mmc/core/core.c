@@ -36,6 +36,7 @@
 #include <vmm_delay.h>
 #include <vmm_timer.h>
 #include <vmm_host_io.h>
+#include <vmm_host_aspace.h>
 #include <vmm_modules.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
@@ -89,12 +90,28 @@ enum mmc_host_io_type {
  */
 struct mmc_host_io {
 	struct dlist head;
+	bool pooled;
 	enum mmc_host_io_type type;
 	struct vmm_request *r;
 	struct vmm_request_queue *rq;
 	u64 card_change_tstamp;
 };
 
+/*
+ * Number of preallocated IO instances per mmc host. IO instances
+ * are allocated from heap only when all of these are in use.
+ */
+#define MMC_HOST_IO_POOL_SIZE		64
+
+/*
+ * Packed write command (eMMC 4.5 or higher). One header block
+ * followed by data of upto 63 write requests in one CMD23 + CMD25.
+ */
+#define MMC_PACKED_CMD_VER		0x01
+#define MMC_PACKED_CMD_WR		0x02
+#define MMC_PACKED_MAX_ENTRIES		63
+#define MMC_CMD23_ARG_PACKED		(1 << 30)
+
 /* frequency bases */
 /* divided by 10 to be nice to platforms without floating point */
 static const int fbase[] = {
@@ -253,6 +270,8 @@ static int __mmc_send_ext_csd(struct mmc_host *host, u8 *ext_csd)
 	data.blocks = 1;
 	data.blocksize = 512;
 	data.flags = MMC_DATA_READ;
+	data.sg = NULL;
+	data.sg_count = 0;
 
 	return __mmc_send_cmd(host, &cmd, &data);
 }
@@ -521,6 +540,8 @@ static int __sd_switch(struct mmc_host *host,
 	data.blocksize = 64;
 	data.blocks = 1;
 	data.flags = MMC_DATA_READ;
+	data.sg = NULL;
+	data.sg_count = 0;
 
 	return __mmc_send_cmd(host, &cmd, &data);
 }
@@ -561,6 +582,8 @@ retry_scr:
 	data.blocksize = 8;
 	data.blocks = 1;
 	data.flags = MMC_DATA_READ;
+	data.sg = NULL;
+	data.sg_count = 0;
 
 	err = __mmc_send_cmd(host, &cmd, &data);
 	if (err) {
@@ -931,6 +954,11 @@ static int __mmc_startup(struct mmc_host *host, struct mmc_card *card)
 			break;
 		};
 
+		if (!err && (ext_csd[EXT_CSD_REV] >= 6)) {
+			card->max_packed_writes =
+					ext_csd[EXT_CSD_MAX_PACKED_WRITES];
+		}
+
 		/*
 		 * Check whether GROUP_DEF is set, if yes, read out
 		 * group size from ext_csd directly, or calculate
@@ -1084,6 +1112,37 @@ static int __mmc_startup(struct mmc_host *host, struct mmc_card *card)
 	return VMM_OK;
 }
 
+static void __mmc_packed_free(struct mmc_card *card)
+{
+	if (card->packed_hdr) {
+		vmm_free(card->packed_hdr);
+		card->packed_hdr = NULL;
+	}
+	if (card->packed_sg) {
+		vmm_free(card->packed_sg);
+		card->packed_sg = NULL;
+	}
+}
+
+static void __mmc_packed_alloc(struct mmc_host *host, struct mmc_card *card)
+{
+	if (!card->max_packed_writes ||
+	    (card->write_bl_len != 512) ||
+	    !(host->caps2 & MMC_CAP2_PACKED_WR) ||
+	    !(host->caps2 & MMC_CAP2_SG) ||
+	    (host->max_segs < 2) || (host->b_max < 2)) {
+		return;
+	}
+
+	/* Packed writes are only an optimization so ignore failures */
+	card->packed_hdr = vmm_zalloc(512);
+	card->packed_sg = vmm_zalloc(host->max_segs *
+				     sizeof(*card->packed_sg));
+	if (!card->packed_hdr || !card->packed_sg) {
+		__mmc_packed_free(card);
+	}
+}
+
 static int __mmc_detect_card_removed(struct mmc_host *host)
 {
 	int rc = VMM_OK;
@@ -1103,6 +1162,7 @@ static int __mmc_detect_card_removed(struct mmc_host *host)
 	vmm_free(host->card->bdev->rq);
 	vmm_blockdev_free(host->card->bdev);
 
+	__mmc_packed_free(host->card);
 	vmm_free(host->card);
 	host->card = NULL;
 
@@ -1187,6 +1247,9 @@ static int __mmc_detect_card_inserted(struct mmc_host *host)
 		goto detect_freecard_fail;
 	}
 
+	/* Setup packed writes if possible */
+	__mmc_packed_alloc(host, host->card);
+
 	/* Allocate new block device instance */
 	card->bdev = vmm_blockdev_alloc();
 	if (!card->bdev) {
@@ -1223,6 +1286,10 @@ static int __mmc_detect_card_inserted(struct mmc_host *host)
 		goto detect_freebdev_fail;
 	}
 	INIT_REQUEST_QUEUE(bdev->rq);
+	bdev->rq->flags = VMM_REQUEST_QUEUE_MERGE;
+	if (host->caps2 & MMC_CAP2_SG) {
+		bdev->rq->flags |= VMM_REQUEST_QUEUE_SG;
+	}
 	bdev->rq->make_request = mmc_make_request;
 	bdev->rq->abort_request = mmc_abort_request;
 	bdev->rq->priv = host;
@@ -1240,6 +1307,7 @@ detect_freerq_fail:
 detect_freebdev_fail:
 	vmm_blockdev_free(host->card->bdev);
 detect_freecard_fail:
+	__mmc_packed_free(host->card);
 	vmm_free(host->card);
 	host->card = NULL;
 detect_done:
@@ -1271,7 +1339,8 @@ static void __mmc_detect_card_change(struct mmc_host *host)
 }
 
 static u32 __mmc_write_blocks(struct mmc_host *host, struct mmc_card *card,
-			      u64 start, u32 blkcnt, const void *src)
+			      u64 start, u32 blkcnt, const void *src,
+			      struct vmm_request_sg *sg, u32 sg_count)
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
@@ -1297,6 +1366,8 @@ static u32 __mmc_write_blocks(struct mmc_host *host, struct mmc_card *card,
 	data.blocks = blkcnt;
 	data.blocksize = card->write_bl_len;
 	data.flags = MMC_DATA_WRITE;
+	data.sg = sg;
+	data.sg_count = sg_count;
 
 	if (__mmc_send_cmd(host, &cmd, &data)) {
 		return 0;
@@ -1334,7 +1405,8 @@ static u32 __mmc_bwrite(struct mmc_host *host, struct mmc_card *card,
 
 	do {
 		cur = (blocks_todo > host->b_max) ?  host->b_max : blocks_todo;
-		if(__mmc_write_blocks(host, card, start, cur, src) != cur) {
+		if (__mmc_write_blocks(host, card, start, cur,
+				       src, NULL, 0) != cur) {
 			return 0;
 		}
 		blocks_todo -= cur;
@@ -1346,7 +1418,8 @@ static u32 __mmc_bwrite(struct mmc_host *host, struct mmc_card *card,
 }
 
 static u32 __mmc_read_blocks(struct mmc_host *host, struct mmc_card *card,
-			     void *dst, u64 start, u32 blkcnt)
+			     void *dst, struct vmm_request_sg *sg, u32 sg_count,
+			     u64 start, u32 blkcnt)
 {
 	struct mmc_cmd cmd;
 	struct mmc_data data;
@@ -1371,6 +1444,8 @@ static u32 __mmc_read_blocks(struct mmc_host *host, struct mmc_card *card,
 	data.blocks = blkcnt;
 	data.blocksize = card->read_bl_len;
 	data.flags = MMC_DATA_READ;
+	data.sg = sg;
+	data.sg_count = sg_count;
 
 	if (__mmc_send_cmd(host, &cmd, &data)) {
 		return 0;
@@ -1403,7 +1478,8 @@ static u32 __mmc_bread(struct mmc_host *host, struct mmc_card *card,
 
 	do {
 		cur = (blocks_todo > host->b_max) ?  host->b_max : blocks_todo;
-		if (__mmc_read_blocks(host, card, dst, start, cur) != cur) {
+		if (__mmc_read_blocks(host, card, dst, NULL, 0,
+				      start, cur) != cur) {
 			return 0;
 		}
 		blocks_todo -= cur;
@@ -1414,6 +1490,101 @@ static u32 __mmc_bread(struct mmc_host *host, struct mmc_card *card,
 	return blkcnt;
 }
 
+/* Fill chunk with sg entries covering upto max_bytes starting from
+ * byte offset skip of request sg list and return bytes covered
+ */
+static u32 __mmc_sg_chunk(struct vmm_request *r, u32 skip,
+			  struct vmm_request_sg *chunk, u32 *chunk_count,
+			  u32 max_segs, u32 max_bytes)
+{
+	u32 i, l, n = 0, bytes = 0;
+
+	for (i = 0; (i < r->sg_count) && (n < max_segs) &&
+		    (bytes < max_bytes); i++) {
+		if (skip >= r->sg[i].len) {
+			skip -= r->sg[i].len;
+			continue;
+		}
+		l = r->sg[i].len - skip;
+		if ((max_bytes - bytes) < l) {
+			l = max_bytes - bytes;
+		}
+		chunk[n].addr = r->sg[i].addr + skip;
+		chunk[n].len = l;
+		skip = 0;
+		bytes += l;
+		n++;
+	}
+
+	*chunk_count = n;
+
+	return bytes;
+}
+
+/* Transfer sg list of block IO request as few multi-block
+ * commands as allowed by b_max and max_segs of mmc host
+ */
+static u32 __mmc_sg_rw(struct mmc_host *host, struct mmc_card *card,
+		       struct vmm_request *r)
+{
+	bool write = (r->type == VMM_REQUEST_WRITE) ? TRUE : FALSE;
+	u32 bl_len = (write) ? card->write_bl_len : card->read_bl_len;
+	u32 n, t, cur, bytes, done = 0;
+	struct vmm_request_sg *chunk;
+
+	if (!r->bcnt || !host->max_segs) {
+		return 0;
+	}
+
+	if (__mmc_set_blocklen(host, bl_len)) {
+		return 0;
+	}
+
+	chunk = vmm_malloc(host->max_segs * sizeof(*chunk));
+	if (!chunk) {
+		return 0;
+	}
+
+	while (done < r->bcnt) {
+		cur = (r->bcnt - done > host->b_max) ?
+					host->b_max : (r->bcnt - done);
+		bytes = __mmc_sg_chunk(r, done * bl_len, chunk, &n,
+				       host->max_segs, cur * bl_len);
+
+		/* Chunk limited by max_segs must end at block boundary */
+		while (n && (bytes % bl_len)) {
+			t = bytes % bl_len;
+			t = (chunk[n - 1].len < t) ? chunk[n - 1].len : t;
+			chunk[n - 1].len -= t;
+			bytes -= t;
+			if (!chunk[n - 1].len) {
+				n--;
+			}
+		}
+		cur = bytes / bl_len;
+		if (!cur) {
+			break;
+		}
+
+		if (write) {
+			t = __mmc_write_blocks(host, card, r->lba + done,
+					       cur, NULL, chunk, n);
+		} else {
+			t = __mmc_read_blocks(host, card, NULL, chunk, n,
+					      r->lba + done, cur);
+		}
+		if (t != cur) {
+			break;
+		}
+
+		done += cur;
+	}
+
+	vmm_free(chunk);
+
+	return done;
+}
+
 static int __mmc_blockdev_request(struct mmc_host *host,
 				  struct vmm_request_queue *rq, 
 				  struct vmm_request *r)
@@ -1432,7 +1603,12 @@ static int __mmc_blockdev_request(struct mmc_host *host,
 
 	switch (r->type) {
 	case VMM_REQUEST_READ:
-		cnt = __mmc_bread(host, host->card, r->lba, r->bcnt, r->data);
+		if (r->sg_count) {
+			cnt = __mmc_sg_rw(host, host->card, r);
+		} else {
+			cnt = __mmc_bread(host, host->card,
+					  r->lba, r->bcnt, r->data);
+		}
 		if (cnt == r->bcnt) {
 			vmm_blockdev_complete_request(r);
 			rc = VMM_OK;
@@ -1442,7 +1618,12 @@ static int __mmc_blockdev_request(struct mmc_host *host,
 		}
 		break;
 	case VMM_REQUEST_WRITE:
-		cnt = __mmc_bwrite(host, host->card, r->lba, r->bcnt, r->data);
+		if (r->sg_count) {
+			cnt = __mmc_sg_rw(host, host->card, r);
+		} else {
+			cnt = __mmc_bwrite(host, host->card,
+					   r->lba, r->bcnt, r->data);
+		}
 		if (cnt == r->bcnt) {
 			vmm_blockdev_complete_request(r);
 			rc = VMM_OK;
@@ -1460,12 +1641,252 @@ static int __mmc_blockdev_request(struct mmc_host *host,
 	return rc;
 }
 
+static struct mmc_host_io *mmc_host_io_alloc(struct mmc_host *host)
+{
+	irq_flags_t flags;
+	struct mmc_host_io *io = NULL;
+
+	vmm_spin_lock_irqsave(&host->io_list_lock, flags);
+	if (!list_empty(&host->io_free_list)) {
+		io = list_entry(list_pop(&host->io_free_list),
+				struct mmc_host_io, head);
+	}
+	vmm_spin_unlock_irqrestore(&host->io_list_lock, flags);
+
+	if (io) {
+		memset(io, 0, sizeof(*io));
+		io->pooled = TRUE;
+	} else {
+		io = vmm_zalloc(sizeof(struct mmc_host_io));
+		if (!io) {
+			return NULL;
+		}
+	}
+
+	INIT_LIST_HEAD(&io->head);
+
+	return io;
+}
+
+/* Note: Must be called with io_list_lock held */
+static void __mmc_host_io_free(struct mmc_host *host, struct mmc_host_io *io)
+{
+	if (io->pooled) {
+		list_add_tail(&io->head, &host->io_free_list);
+	} else {
+		vmm_free(io);
+	}
+}
+
+static void mmc_host_io_free(struct mmc_host *host, struct mmc_host_io *io)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&host->io_list_lock, flags);
+	__mmc_host_io_free(host, io);
+	vmm_spin_unlock_irqrestore(&host->io_list_lock, flags);
+}
+
+/* Add host physical pages of virtual buffer to sg list */
+static int __mmc_sg_add_va(struct vmm_request_sg *sg, u32 *n, u32 max,
+			   virtual_addr_t va, u32 len)
+{
+	int rc;
+	u32 l;
+	physical_addr_t pa;
+
+	while (len) {
+		l = VMM_PAGE_SIZE - (va & VMM_PAGE_MASK);
+		l = (len < l) ? len : l;
+		rc = vmm_host_va2pa(va, &pa);
+		if (rc) {
+			return rc;
+		}
+		if (*n && ((sg[*n - 1].addr + sg[*n - 1].len) == pa)) {
+			sg[*n - 1].len += l;
+		} else if (*n < max) {
+			sg[*n].addr = pa;
+			sg[*n].len = l;
+			(*n)++;
+		} else {
+			return VMM_ENOSPC;
+		}
+		va += l;
+		len -= l;
+	}
+
+	return VMM_OK;
+}
+
+/* Upper bound on sg list entries needed by write request */
+static u32 __mmc_packed_segs(struct mmc_card *card, struct vmm_request *r)
+{
+	if (r->sg_count) {
+		return r->sg_count;
+	}
+
+	return VMM_SIZE_TO_PAGE(((virtual_addr_t)r->data & VMM_PAGE_MASK) +
+				r->bcnt * card->write_bl_len);
+}
+
+static bool __mmc_packable(struct mmc_host *host, struct mmc_host_io *io)
+{
+	struct mmc_card *card = host->card;
+
+	if (!card || !card->packed_hdr ||
+	    (io->type != MMC_HOST_IO_BLOCKDEV_REQUEST) ||
+	    !io->r || (io->r->type != VMM_REQUEST_WRITE) || !io->r->bcnt ||
+	    !card->bdev || (io->rq != card->bdev->rq)) {
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+/* Pop write requests queued right behind first write request
+ * (never beyond a read, to keep ordering) which fit one packed
+ * write. Note: Must be called with host->lock held.
+ */
+static u32 __mmc_packed_collect(struct mmc_host *host,
+				struct mmc_host_io **pack)
+{
+	irq_flags_t flags;
+	struct mmc_host_io *io;
+	struct mmc_card *card = host->card;
+	u32 count = 1, max, blocks, segs, b, sg;
+
+	max = card->max_packed_writes;
+	max = (MMC_PACKED_MAX_ENTRIES < max) ? MMC_PACKED_MAX_ENTRIES : max;
+	blocks = 1 + pack[0]->r->bcnt;
+	segs = 1 + __mmc_packed_segs(card, pack[0]->r);
+	if ((host->b_max < blocks) || (host->max_segs < segs)) {
+		return 1;
+	}
+
+	vmm_spin_lock_irqsave(&host->io_list_lock, flags);
+	while ((count < max) && !list_empty(&host->io_list)) {
+		io = list_first_entry(&host->io_list, struct mmc_host_io, head);
+		if (!__mmc_packable(host, io)) {
+			break;
+		}
+		b = io->r->bcnt;
+		sg = __mmc_packed_segs(card, io->r);
+		if ((host->b_max < (blocks + b)) ||
+		    (host->max_segs < (segs + sg))) {
+			break;
+		}
+		list_del(&io->head);
+		pack[count++] = io;
+		blocks += b;
+		segs += sg;
+	}
+	vmm_spin_unlock_irqrestore(&host->io_list_lock, flags);
+
+	return count;
+}
+
+static int __mmc_packed_write(struct mmc_host *host,
+			      struct mmc_host_io **pack, u32 count)
+{
+	int rc;
+	u32 i, n = 0, blocks = 1;
+	struct mmc_cmd cmd;
+	struct mmc_data data;
+	struct vmm_request *r;
+	struct mmc_card *card = host->card;
+	u32 *hdr = card->packed_hdr;
+
+	memset(hdr, 0, 512);
+	hdr[0] = vmm_cpu_to_le32((count << 16) |
+				 (MMC_PACKED_CMD_WR << 8) | MMC_PACKED_CMD_VER);
+	rc = __mmc_sg_add_va(card->packed_sg, &n, host->max_segs,
+			     (virtual_addr_t)hdr, 512);
+	if (rc) {
+		return rc;
+	}
+
+	for (i = 0; i < count; i++) {
+		r = pack[i]->r;
+		hdr[(i + 1) * 2] = vmm_cpu_to_le32(r->bcnt);
+		hdr[(i + 1) * 2 + 1] = vmm_cpu_to_le32((card->high_capacity) ?
+					(u32)r->lba : (u32)r->lba * 512);
+		if (r->sg_count) {
+			if (host->max_segs < (n + r->sg_count)) {
+				return VMM_ENOSPC;
+			}
+			memcpy(&card->packed_sg[n], r->sg,
+			       r->sg_count * sizeof(*r->sg));
+			n += r->sg_count;
+		} else {
+			rc = __mmc_sg_add_va(card->packed_sg, &n,
+					     host->max_segs,
+					     (virtual_addr_t)r->data,
+					     r->bcnt * 512);
+			if (rc) {
+				return rc;
+			}
+		}
+		blocks += r->bcnt;
+	}
+
+	if (__mmc_set_blocklen(host, 512)) {
+		return VMM_EIO;
+	}
+
+	cmd.cmdidx = MMC_CMD_SET_BLOCK_COUNT;
+	cmd.cmdarg = MMC_CMD23_ARG_PACKED | blocks;
+	cmd.resp_type = MMC_RSP_R1;
+	rc = __mmc_send_cmd(host, &cmd, NULL);
+	if (rc) {
+		return rc;
+	}
+
+	/* Pre-defined block count so no STOP_TRANSMISSION */
+	r = pack[0]->r;
+	cmd.cmdidx = MMC_CMD_WRITE_MULTIPLE_BLOCK;
+	cmd.cmdarg = (card->high_capacity) ? (u32)r->lba : (u32)r->lba * 512;
+	cmd.resp_type = MMC_RSP_R1;
+	data.src = NULL;
+	data.blocks = blocks;
+	data.blocksize = 512;
+	data.flags = MMC_DATA_WRITE;
+	data.sg = card->packed_sg;
+	data.sg_count = n;
+	rc = __mmc_send_cmd(host, &cmd, &data);
+	if (rc) {
+		return rc;
+	}
+
+	return __mmc_send_status(host, card, 1000);
+}
+
+static void __mmc_blockdev_packed_request(struct mmc_host *host,
+					  struct mmc_host_io **pack,
+					  u32 count)
+{
+	u32 i;
+
+	if (!__mmc_packed_write(host, pack, count)) {
+		for (i = 0; i < count; i++) {
+			vmm_blockdev_complete_request(pack[i]->r);
+		}
+		return;
+	}
+
+	/* Retry each write request on its own */
+	for (i = 0; i < count; i++) {
+		__mmc_blockdev_request(host, pack[i]->rq, pack[i]->r);
+	}
+}
+
 static int mmc_host_thread(void *tdata)
 {
 	u64 tout;
+	u32 i, pcount;
 	irq_flags_t flags;
 	struct dlist *l;
 	struct mmc_host_io *io;
+	struct mmc_host_io *pack[MMC_PACKED_MAX_ENTRIES];
 	struct mmc_host *host = tdata;
 
 	while (1) {
@@ -1504,7 +1925,20 @@ static int mmc_host_thread(void *tdata)
 			__mmc_detect_card_change(host);
 			break;
 		case MMC_HOST_IO_BLOCKDEV_REQUEST:
-			__mmc_blockdev_request(host, io->rq, io->r);
+			pcount = 0;
+			if (__mmc_packable(host, io)) {
+				pack[0] = io;
+				pcount = __mmc_packed_collect(host, pack);
+			}
+			if (pcount > 1) {
+				__mmc_blockdev_packed_request(host,
+							      pack, pcount);
+				for (i = 1; i < pcount; i++) {
+					mmc_host_io_free(host, pack[i]);
+				}
+			} else {
+				__mmc_blockdev_request(host, io->rq, io->r);
+			}
 			break;
 		default:
 			break;
@@ -1512,7 +1946,7 @@ static int mmc_host_thread(void *tdata)
 
 		vmm_mutex_unlock(&host->lock);
 
-		vmm_free(io);
+		mmc_host_io_free(host, io);
 	}
 
 	return VMM_OK;
@@ -1531,12 +1965,11 @@ static int mmc_make_request(struct vmm_request_queue *rq,
 
 	host = rq->priv;
 
-	io = vmm_zalloc(sizeof(struct mmc_host_io));
+	io = mmc_host_io_alloc(host);
 	if (!io) {
 		return VMM_ENOMEM;
 	}
 
-	INIT_LIST_HEAD(&io->head);
 	io->type = MMC_HOST_IO_BLOCKDEV_REQUEST;
 	io->rq = rq;
 	io->r = r;
@@ -1577,7 +2010,7 @@ static int mmc_abort_request(struct vmm_request_queue *rq,
 	}
 	if (found) {
 		list_del(&io->head);
-		vmm_free(io);
+		__mmc_host_io_free(host, io);
 	}
 
 	vmm_spin_unlock_irqrestore(&host->io_list_lock, flags);
@@ -1594,12 +2027,11 @@ int mmc_detect_card_change(struct mmc_host *host, unsigned long msecs)
 		return VMM_EFAIL;
 	}
 
-	io = vmm_zalloc(sizeof(struct mmc_host_io));
+	io = mmc_host_io_alloc(host);
 	if (!io) {
 		return VMM_ENOMEM;
 	}
 
-	INIT_LIST_HEAD(&io->head);
 	io->type = MMC_HOST_IO_DETECT_CARD_CHANGE;
 	io->card_change_tstamp = vmm_timer_timestamp() + 
 					((u64)msecs * 1000000ULL);
@@ -1616,7 +2048,9 @@ VMM_EXPORT_SYMBOL(mmc_detect_card_change);
 
 struct mmc_host *mmc_alloc_host(int extra, struct vmm_device *dev)
 {
+	u32 i;
 	struct mmc_host *host;
+	struct mmc_host_io *pool;
 
 	host = vmm_zalloc(sizeof(struct mmc_host) + extra);
 	if (!host) {
@@ -1627,8 +2061,20 @@ struct mmc_host *mmc_alloc_host(int extra, struct vmm_device *dev)
 	host->dev = dev;
 
 	INIT_LIST_HEAD(&host->io_list);
+	INIT_LIST_HEAD(&host->io_free_list);
 	INIT_SPIN_LOCK(&host->io_list_lock);
 
+	pool = vmm_zalloc(MMC_HOST_IO_POOL_SIZE * sizeof(*pool));
+	if (!pool) {
+		vmm_free(host);
+		return NULL;
+	}
+	for (i = 0; i < MMC_HOST_IO_POOL_SIZE; i++) {
+		INIT_LIST_HEAD(&pool[i].head);
+		list_add_tail(&pool[i].head, &host->io_free_list);
+	}
+	host->io_pool = pool;
+
 	INIT_MUTEX(&host->slot.lock);
 	host->slot.cd_irq = VMM_EINVALID;
 
@@ -1712,6 +2158,7 @@ void mmc_free_host(struct mmc_host *host)
 		return;
 	}
 
+	vmm_free(host->io_pool);
 	vmm_free(host);
 }
 VMM_EXPORT_SYMBOL(mmc_free_host);
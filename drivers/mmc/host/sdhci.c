@@ -148,7 +148,7 @@ static void sdhci_init(struct sdhci_host *host, int soft)
 	sdhci_writel(host, SDHCI_INT_DATA_MASK | SDHCI_INT_CMD_MASK,
 		     SDHCI_INT_ENABLE);
 
-	if (host->sdhci_caps & SDHCI_CAN_DO_SDMA) {
+	if (host->flags & SDHCI_USE_DMA) {
 		/* Mask all sdhci interrupt sources, except commands */
 		sdhci_writel(host, SDHCI_INT_CMD_MASK, SDHCI_SIGNAL_ENABLE);
 	} else {
@@ -180,16 +180,257 @@ static int sdhci_transfer_dma(struct sdhci_host *host,
 	int rc = VMM_OK;
 	u64 timeout = 100000000LL;
 
-	rc = vmm_completion_wait_timeout(&host->wait_dma, &timeout);
-	if (VMM_ETIMEDOUT == rc) {
-		vmm_printf("%s: Transfer data timeout (%"PRId64")\n", __func__,
-			   timeout);
+	/* Wait till transfer complete or data error */
+	do {
+		rc = vmm_completion_wait_timeout(&host->wait_dma, &timeout);
+		if (VMM_ETIMEDOUT == rc) {
+			vmm_printf("%s: Transfer data timeout (%"PRId64")\n",
+				   __func__, timeout);
+			return rc;
+		}
+	} while (!(host->data_intmask &
+		   (SDHCI_INT_DATA_END | SDHCI_INT_ERROR_MASK)));
+
+	if (host->data_intmask & SDHCI_INT_ERROR_MASK) {
+		vmm_printf("%s: Transfer data error (0x%08x)\n",
+			   __func__, host->data_intmask);
+		if (host->data_intmask & SDHCI_INT_ADMA_ERROR) {
+			vmm_printf("%s: ADMA error status 0x%02x\n", __func__,
+				   sdhci_readb(host, SDHCI_ADMA_ERROR));
+		}
+		return VMM_EIO;
+	}
+
+	return VMM_OK;
+}
+
+/* Copy between bounce buffer and data buffer or sg list */
+static void sdhci_bounce_copy(struct sdhci_host *host,
+			      struct mmc_data *data, u32 len, bool to_bounce)
+{
+	u32 i, l, pos = 0;
+	u8 *buf = host->aligned_buffer;
+
+	if (!data->sg_count) {
+		if (to_bounce) {
+			memcpy(buf, data->src, len);
+		} else {
+			memcpy(data->dest, buf, len);
+		}
+		return;
+	}
+
+	for (i = 0; (i < data->sg_count) && (pos < len); i++) {
+		l = ((len - pos) < data->sg[i].len) ?
+					(len - pos) : data->sg[i].len;
+		if (to_bounce) {
+			vmm_host_memory_read(data->sg[i].addr,
+					     buf + pos, l, TRUE);
+		} else {
+			vmm_host_memory_write(data->sg[i].addr,
+					      buf + pos, l, TRUE);
+		}
+		pos += l;
+	}
+}
+
+/* Write back and invalidate cache lines of data buffer or sg list */
+static void sdhci_sync_data(struct mmc_data *data, u32 len)
+{
+	u32 i, l;
+	virtual_addr_t va;
+	physical_addr_t off;
+
+	if (!data->sg_count) {
+		vmm_flush_cache_range((virtual_addr_t)data->dest,
+				      (virtual_addr_t)data->dest + len);
+		return;
+	}
+
+	/* Pages of sg list need not be mapped in host address space */
+	for (i = 0; (i < data->sg_count) && len; i++) {
+		l = (len < data->sg[i].len) ? len : data->sg[i].len;
+		off = data->sg[i].addr & VMM_PAGE_MASK;
+		va = vmm_host_memmap(data->sg[i].addr - off,
+				     VMM_ROUNDUP2_PAGE_SIZE(off + l),
+				     VMM_MEMORY_FLAGS_NORMAL);
+		if (va) {
+			vmm_flush_cache_range(va + off, va + off + l);
+			vmm_host_memunmap(va);
+		}
+		len -= l;
+	}
+}
+
+static int sdhci_adma_add(struct sdhci_host *host, u32 *idx,
+			  physical_addr_t addr, u32 len)
+{
+	u32 l, plen, max;
+	struct sdhci_adma2_desc *desc;
+
+	if ((addr & (SDHCI_ADMA2_ALIGN - 1)) ||
+	    (len & (SDHCI_ADMA2_ALIGN - 1)) ||
+	    (((u64)addr + len) > 0x100000000ULL)) {
+		return VMM_EINVALID;
+	}
+
+	/* Zero length means 64KB unless controller is broken */
+	max = (host->quirks & SDHCI_QUIRK_BROKEN_ADMA_ZEROLEN_DESC) ?
+							0xFFFC : 0x10000;
+
+	/* Extend previous descriptor if physically contiguous */
+	if (*idx) {
+		desc = &host->adma_desc[*idx - 1];
+		plen = vmm_le16_to_cpu(desc->len);
+		plen = (plen) ? plen : 0x10000;
+		if (((vmm_le32_to_cpu(desc->addr) + (u64)plen) == addr) &&
+		    (plen < max)) {
+			l = ((max - plen) < len) ? (max - plen) : len;
+			desc->len = vmm_cpu_to_le16((plen + l) & 0xFFFF);
+			addr += l;
+			len -= l;
+		}
+	}
+
+	while (len) {
+		if (SDHCI_ADMA2_DESC_COUNT <= *idx) {
+			return VMM_ENOSPC;
+		}
+		l = (max < len) ? max : len;
+		desc = &host->adma_desc[*idx];
+		desc->cmd = vmm_cpu_to_le16(SDHCI_ADMA2_TRAN |
+					    SDHCI_ADMA2_VALID);
+		desc->len = vmm_cpu_to_le16(l & 0xFFFF);
+		desc->addr = vmm_cpu_to_le32((u32)addr);
+		(*idx)++;
+		addr += l;
+		len -= l;
+	}
+
+	return VMM_OK;
+}
+
+/* Build ADMA2 descriptor table for data buffer or sg list */
+static int sdhci_adma_table(struct sdhci_host *host,
+			    struct mmc_data *data, u32 len)
+{
+	int rc;
+	u32 i, l, idx = 0;
+	virtual_addr_t va;
+	physical_addr_t pa;
+
+	if (host->dma_bounced) {
+		rc = vmm_host_va2pa((virtual_addr_t)host->aligned_buffer, &pa);
+		if (!rc) {
+			rc = sdhci_adma_add(host, &idx, pa, len);
+		}
+		len = 0;
+	} else if (data->sg_count) {
+		rc = VMM_OK;
+		for (i = 0; !rc && (i < data->sg_count) && len; i++) {
+			l = (len < data->sg[i].len) ? len : data->sg[i].len;
+			rc = sdhci_adma_add(host, &idx, data->sg[i].addr, l);
+			len -= l;
+		}
+	} else {
+		rc = VMM_OK;
+		va = (virtual_addr_t)data->dest;
+		while (!rc && len) {
+			l = VMM_PAGE_SIZE - (va & VMM_PAGE_MASK);
+			l = (len < l) ? len : l;
+			rc = vmm_host_va2pa(va, &pa);
+			if (!rc) {
+				rc = sdhci_adma_add(host, &idx, pa, l);
+			}
+			va += l;
+			len -= l;
+		}
+	}
+	if (rc) {
 		return rc;
 	}
+	if (len || !idx) {
+		return VMM_EINVALID;
+	}
+
+	host->adma_desc[idx - 1].cmd |= vmm_cpu_to_le16(SDHCI_ADMA2_END);
+	vmm_flush_cache_range((virtual_addr_t)host->adma_desc,
+			(virtual_addr_t)&host->adma_desc[idx]);
+
+	return VMM_OK;
+}
+
+static int sdhci_prepare_dma(struct sdhci_host *host,
+			     struct mmc_data *data, u32 trans_bytes)
+{
+	int rc;
+	u32 ctrl;
+	physical_addr_t dma_addr = 0x0;
+
+	ctrl = sdhci_readl(host, SDHCI_HOST_CONTROL);
+	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+
+	/* SDMA always goes through bounce buffer whereas ADMA2
+	 * only needs it for misaligned or above 4GB buffers.
+	 */
+	host->dma_bounced = (host->flags & SDHCI_USE_ADMA) ? FALSE : TRUE;
+	if (host->flags & SDHCI_USE_ADMA) {
+		rc = sdhci_adma_table(host, data, trans_bytes);
+		if ((rc == VMM_EINVALID) &&
+		    (trans_bytes <= SDHCI_DMA_MAX_BUF)) {
+			host->dma_bounced = TRUE;
+			rc = sdhci_adma_table(host, data, trans_bytes);
+		}
+		if (rc) {
+			vmm_printf("%s: Failed to setup ADMA for %d bytes "
+				   "(error %d)\n", __func__, trans_bytes, rc);
+			return rc;
+		}
+		ctrl |= SDHCI_CTRL_ADMA32;
+		sdhci_writel(host, (u32)host->adma_addr, SDHCI_ADMA_ADDRESS);
+	} else {
+		ctrl |= SDHCI_CTRL_SDMA;
+		rc = vmm_host_va2pa((virtual_addr_t)host->aligned_buffer,
+				    &dma_addr);
+		BUG_ON(rc);
+		sdhci_writel(host, (u32)dma_addr, SDHCI_DMA_ADDRESS);
+	}
+
+	if (host->dma_bounced) {
+		if (data->flags != MMC_DATA_READ) {
+			sdhci_bounce_copy(host, data, trans_bytes, TRUE);
+		}
+		vmm_flush_cache_range((virtual_addr_t)host->aligned_buffer,
+				      (virtual_addr_t)host->aligned_buffer +
+				      trans_bytes);
+	} else {
+		sdhci_sync_data(data, trans_bytes);
+	}
+
+	sdhci_unmask_irqs(host, SDHCI_INT_ADMA_ERROR |
+			  SDHCI_INT_ACMD12ERR |
+			  SDHCI_INT_DATA_TIMEOUT |
+			  SDHCI_INT_DMA_END);
+
+	sdhci_writel(host, ctrl, SDHCI_HOST_CONTROL);
 
 	return VMM_OK;
 }
 
+static void sdhci_finish_dma(struct sdhci_host *host,
+			     struct mmc_data *data, u32 trans_bytes)
+{
+	if (data->flags != MMC_DATA_READ) {
+		return;
+	}
+
+	if (host->dma_bounced) {
+		sdhci_bounce_copy(host, data, trans_bytes, FALSE);
+	} else {
+		sdhci_sync_data(data, trans_bytes);
+	}
+}
+
 static void sdhci_transfer_pio(struct sdhci_host *host, struct mmc_data *data)
 {
 	int i;
@@ -253,7 +494,6 @@ int sdhci_send_command(struct mmc_host *mmc,
 	int ret = 0, trans_bytes = 0;
 	u32 retry = 10000, stat = 0;
 	u64 timeout;
-	physical_addr_t dma_addr;
 	struct sdhci_host *host = mmc_priv(mmc);
 
 	/* If polling, assume that the card is always present. */
@@ -328,35 +568,12 @@ int sdhci_send_command(struct mmc_host *mmc,
 			mode |= SDHCI_TRNS_READ;
 		}
 
-		if (host->sdhci_caps & SDHCI_CAN_DO_SDMA) {
-			u32 ctrl;
-
-			if (data->flags != MMC_DATA_READ) {
-				memcpy(host->aligned_buffer,
-				       data->src, trans_bytes);
+		if (host->flags & SDHCI_USE_DMA) {
+			ret = sdhci_prepare_dma(host, data, trans_bytes);
+			if (ret) {
+				return ret;
 			}
-
-			sdhci_unmask_irqs(host, SDHCI_INT_ADMA_ERROR |
-					  SDHCI_INT_ACMD12ERR |
-					  SDHCI_INT_DATA_TIMEOUT |
-					  SDHCI_INT_DMA_END);
-
-			ctrl = sdhci_readl(host, SDHCI_HOST_CONTROL);
-			ctrl &= ~SDHCI_CTRL_DMA_MASK;
-			ctrl |= SDHCI_CTRL_SDMA;
-			sdhci_writel(host, ctrl, SDHCI_HOST_CONTROL);
-
-			dma_addr = 0x0;
-			ret = vmm_host_va2pa(
-					(virtual_addr_t)host->aligned_buffer,
-					&dma_addr);
-			BUG_ON(ret);
-			sdhci_writel(host, (u32)dma_addr, SDHCI_DMA_ADDRESS);
 			mode |= SDHCI_TRNS_DMA;
-
-			vmm_flush_cache_range((u32)host->aligned_buffer,
-					      (u32)host->aligned_buffer +
-					      trans_bytes);
 		}
 
 		sdhci_writew(host, SDHCI_MAKE_BLKSZ(SDHCI_DEFAULT_BOUNDARY_ARG,
@@ -364,13 +581,14 @@ int sdhci_send_command(struct mmc_host *mmc,
 				SDHCI_BLOCK_SIZE);
 		sdhci_writew(host, data->blocks, SDHCI_BLOCK_COUNT);
 		sdhci_writew(host, mode, SDHCI_TRANSFER_MODE);
+		host->data_intmask = 0;
 		REINIT_COMPLETION(&host->wait_dma);
 	}
 
 	sdhci_writel(host, cmd->cmdarg, SDHCI_ARGUMENT);
 
 	sdhci_writew(host, SDHCI_MAKE_CMD(cmd->cmdidx, flags), SDHCI_COMMAND);
-	if (host->sdhci_caps & SDHCI_CAN_DO_SDMA) {
+	if (host->flags & SDHCI_USE_DMA) {
 		/* Wait max 12 ms */
 		timeout = 12000000;
 		ret = vmm_completion_wait_timeout(&host->wait_command, &timeout);
@@ -418,7 +636,7 @@ int sdhci_send_command(struct mmc_host *mmc,
 	}
 
 	if (!ret && data) {
-		if (host->sdhci_caps & SDHCI_CAN_DO_SDMA) {
+		if (host->flags & SDHCI_USE_DMA) {
 			ret = sdhci_transfer_dma(host, data);
 		} else {
 			u32 start_addr = (u32)data->dest;
@@ -436,9 +654,8 @@ int sdhci_send_command(struct mmc_host *mmc,
 	stat = sdhci_readl(host, SDHCI_INT_STATUS);
 	sdhci_writel(host, SDHCI_INT_ALL_MASK, SDHCI_INT_STATUS);
 	if (!ret) {
-		if ((host->sdhci_caps & SDHCI_CAN_DO_SDMA) &&
-		    (data->flags == MMC_DATA_READ)) {
-			memcpy(data->dest, host->aligned_buffer, trans_bytes);
+		if ((host->flags & SDHCI_USE_DMA) && data) {
+			sdhci_finish_dma(host, data, trans_bytes);
 		}
 		return VMM_OK;
 	}
@@ -676,6 +893,7 @@ static void sdhci_cmd_irq(struct sdhci_host *host, u32 intmask)
 
 static void sdhci_data_irq(struct sdhci_host *host, u32 intmask)
 {
+	host->data_intmask |= intmask;
 	vmm_completion_complete(&host->wait_dma);
 }
 
@@ -731,7 +949,8 @@ static vmm_irq_return_t sdhci_irq_handler(int irq_no, void *dev)
 		sdhci_writel(host, intmask & (SDHCI_INT_DATA_MASK |
 					      SDHCI_INT_DMA_END),
 			     SDHCI_INT_STATUS);
-		sdhci_data_irq(host, intmask & SDHCI_INT_DATA_MASK);
+		sdhci_data_irq(host, intmask & (SDHCI_INT_DATA_MASK |
+						SDHCI_INT_DMA_END));
 	}
 
 	intmask &= ~(SDHCI_INT_CMD_MASK | SDHCI_INT_DATA_MASK);
@@ -856,24 +1075,43 @@ int sdhci_add_host(struct sdhci_host *host)
 		mmc->caps |= host->caps;
 	}
 
+	host->flags = 0;
+	if (host->sdhci_caps & SDHCI_CAN_DO_SDMA) {
+		host->flags |= SDHCI_USE_SDMA;
+	}
+	if ((host->sdhci_caps & SDHCI_CAN_DO_ADMA2) &&
+	    !(host->quirks & SDHCI_QUIRK_BROKEN_ADMA)) {
+		host->flags |= SDHCI_USE_ADMA;
+	}
+
+	if (host->flags & SDHCI_USE_ADMA) {
+		host->adma_desc = vmm_dma_zalloc_phy(SDHCI_ADMA2_DESC_COUNT *
+						sizeof(struct sdhci_adma2_desc),
+						&host->adma_addr);
+		if (!host->adma_desc) {
+			vmm_printf("%s: ADMA table alloc failed, "
+				   "using SDMA\n", __func__);
+			host->flags &= ~SDHCI_USE_ADMA;
+		} else if (host->adma_addr & (SDHCI_ADMA2_ALIGN - 1)) {
+			vmm_printf("%s: ADMA table misaligned, "
+				   "using SDMA\n", __func__);
+			vmm_dma_free(host->adma_desc);
+			host->adma_desc = NULL;
+			host->flags &= ~SDHCI_USE_ADMA;
+		}
+	}
+
 	sdhci_init(host, 0);
 
-	if (host->sdhci_caps & SDHCI_CAN_DO_SDMA) {
+	if (host->flags & SDHCI_USE_DMA) {
 		/* Note: host aligned buffer must be 8-byte aligned */
 		host->aligned_buffer = (u8 *)vmm_dma_malloc(
 			VMM_SIZE_TO_PAGE(SDHCI_DMA_MAX_BUF) * VMM_PAGE_SIZE);
-		if (host->mmc->b_max > (SDHCI_DMA_MAX_BUF) / 512) {
-			/*
-			 * FIXME: Avoid hard-coded block size, but we do not
-			 * know the blocksize yet.
-			 */
-			host->mmc->b_max = (SDHCI_DMA_MAX_BUF) / 512;
-		}
 		if (!host->aligned_buffer) {
 			vmm_printf("%s: host buffer alloc failed!!!\n",
 				   __func__);
 			rc = VMM_ENOMEM;
-			goto free_nothing;
+			goto free_host_buffer;
 		}
 		if ((host->quirks & SDHCI_QUIRK_32BIT_DMA_ADDR) &&
 		    (((u32)host->aligned_buffer) & 0x7)) {
@@ -884,6 +1122,25 @@ int sdhci_add_host(struct sdhci_host *host)
 		}
 	}
 
+	/*
+	 * FIXME: Avoid hard-coded block size, but we do not
+	 * know the blocksize yet.
+	 */
+	if (host->flags & SDHCI_USE_ADMA) {
+		/* Multi-block transfers directly from data buffer or
+		 * sg list as one DMA hence one interrupt.
+		 */
+		if (!mmc->b_max || (mmc->b_max > (SDHCI_ADMA2_MAX_BUF / 512))) {
+			mmc->b_max = SDHCI_ADMA2_MAX_BUF / 512;
+		}
+		mmc->max_segs = SDHCI_ADMA2_MAX_SEGS;
+		mmc->caps2 |= MMC_CAP2_SG | MMC_CAP2_PACKED_WR;
+	} else if (host->flags & SDHCI_USE_SDMA) {
+		if (!mmc->b_max || (mmc->b_max > (SDHCI_DMA_MAX_BUF / 512))) {
+			mmc->b_max = SDHCI_DMA_MAX_BUF / 512;
+		}
+	}
+
 	if (host->irq > 0) {
 		if ((rc = vmm_host_irq_register(host->irq, mmc_hostname(mmc),
 						sdhci_irq_handler,
@@ -922,7 +1179,8 @@ int sdhci_add_host(struct sdhci_host *host)
 	vmm_printf("%s: SDHCI controller %s at 0x%llx irq %d [%s]\n",
 		   mmc_hostname(mmc), ver,
 		   (unsigned long long)iopaddr, host->irq,
-		   (host->sdhci_caps & SDHCI_CAN_DO_SDMA) ? "DMA" : "PIO");
+		   (host->flags & SDHCI_USE_ADMA) ? "ADMA2" :
+		   (host->flags & SDHCI_USE_SDMA) ? "SDMA" : "PIO");
 
 	sdhci_enable_card_detection(host);
 
@@ -936,10 +1194,14 @@ free_host_irq:
 		vmm_host_irq_unregister(host->irq, mmc);
 	}
 free_host_buffer:
-	if (host->sdhci_caps & SDHCI_CAN_DO_SDMA) {
+	if (host->aligned_buffer) {
 		vmm_dma_free(host->aligned_buffer);
 		host->aligned_buffer = NULL;
 	}
+	if (host->adma_desc) {
+		vmm_dma_free(host->adma_desc);
+		host->adma_desc = NULL;
+	}
 free_nothing:
 	return rc;
 }
@@ -955,10 +1217,14 @@ void sdhci_remove_host(struct sdhci_host *host, int dead)
 		vmm_host_irq_unregister(host->irq, mmc);
 	}
 
-	if (host->sdhci_caps & SDHCI_CAN_DO_SDMA) {
+	if (host->aligned_buffer) {
 		vmm_dma_free(host->aligned_buffer);
 		host->aligned_buffer = NULL;
 	}
+	if (host->adma_desc) {
+		vmm_dma_free(host->adma_desc);
+		host->adma_desc = NULL;
+	}
 }
 VMM_EXPORT_SYMBOL(sdhci_remove_host);
 
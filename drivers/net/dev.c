@@ -25,105 +25,116 @@
 
 #include <linux/netdevice.h>
 #include <linux/phy.h>
+#include <linux/delay.h>
 
 int netdev_budget __read_mostly = 300;
 
+static void napi_rx_flush(struct napi_struct *n)
+{
+	if (list_empty(&n->rx_list))
+		return;
+
+	/* Hand-off whole batch to netswitch bottom-half in one go */
+	if (n->dev->nsw_priv)
+		vmm_port2switch_xfer_mbuf_list(n->dev->nsw_priv, &n->rx_list);
+
+	while (!list_empty(&n->rx_list))
+		m_freem(m_list_entry(list_pop(&n->rx_list)));
+}
+
 static void lazy_xfer2napi_poll(struct vmm_netport *port, void *arg, int budget)
 {
 	struct napi_struct *napi = arg;
+	int work;
+
+	if (budget > napi->weight)
+		budget = napi->weight;
+
+	work = napi->poll(napi, budget);
+
+	/* Poll completed (i.e. device interrupt re-enabled) */
+	if (!test_bit(NAPI_STATE_SCHED, &napi->state))
+		return;
 
-	napi->poll(napi, budget);
+	napi_rx_flush(napi);
+
+	/* Driver still owns the poll so either it has consumed whole
+	 * budget or it has more work. Give other ports a chance by
+	 * queueing poll again behind them, unless disable is pending.
+	 */
+	if (unlikely(test_bit(NAPI_STATE_DISABLE, &napi->state))) {
+		__napi_complete(napi);
+		return;
+	}
+
+	if (work > budget)
+		pr_err_once("%s: poll returned %d with budget %d\n",
+			    napi->dev->name, work, budget);
+
+	__napi_schedule(napi);
 }
 
 void netif_napi_add(struct net_device *dev, struct napi_struct *napi,
 		    int (*poll)(struct napi_struct *, int), int weight)
 {
-	struct vmm_netport *port = dev->nsw_priv;
-
 	if (weight > NAPI_POLL_WEIGHT)
 		pr_err_once("netif_napi_add() called with weight %d on "
 			    "device %s\n", weight, dev->name);
 	napi->dev = dev;
 	napi->poll = poll;
-	INIT_LIST_HEAD(&napi->xfer.head);
-	napi->xfer.port = port;
-	napi->xfer.type = VMM_NETPORT_XFER_LAZY;
-	napi->xfer.mbuf = NULL;
-	napi->xfer.lazy_budget = netdev_budget;
-	napi->xfer.lazy_arg = NULL;
-	napi->xfer.lazy_xfer = lazy_xfer2napi_poll;
+	napi->weight = weight;
+	INIT_LIST_HEAD(&napi->rx_list);
+	napi->bh_hash = -1;
+	/* NAPI is disabled until napi_enable() */
+	napi->state = 0;
+	set_bit(NAPI_STATE_SCHED, &napi->state);
 }
 EXPORT_SYMBOL(netif_napi_add);
 
 void napi_disable(struct napi_struct *n)
 {
-#if 0
-	might_sleep();
 	set_bit(NAPI_STATE_DISABLE, &n->state);
 	while (test_and_set_bit(NAPI_STATE_SCHED, &n->state))
 		msleep(1);
 	clear_bit(NAPI_STATE_DISABLE, &n->state);
-#endif
 }
 
 void napi_enable(struct napi_struct *n)
 {
-#if 0
 	BUG_ON(!test_bit(NAPI_STATE_SCHED, &n->state));
-	smp_mb__before_clear_bit();
+	arch_smp_mb();
 	clear_bit(NAPI_STATE_SCHED, &n->state);
-#endif
 }
 
 void napi_schedule(struct napi_struct *n)
 {
-	struct vmm_netport *port = n->dev->nsw_priv;
-
-	if (!port) {
-		vmm_printf("%s Net dev %s has no switch attached\n",
-			   __func__, n->dev->name);
-		return;
-	}
-
-	vmm_port2switch_xfer_lazy(port, lazy_xfer2napi_poll, n, n->xfer.lazy_budget);
+	if (napi_schedule_prep(n))
+		__napi_schedule(n);
 }
 
 void netif_napi_del(struct napi_struct *napi)
 {
-	list_del_init(&napi->xfer.head);
+	napi_rx_flush(napi);
 }
 EXPORT_SYMBOL(netif_napi_del);
 
 void __napi_complete(struct napi_struct *n)
 {
-#if 0
 	BUG_ON(!test_bit(NAPI_STATE_SCHED, &n->state));
-	BUG_ON(n->gro_list);
 
-	list_del(&n->poll_list);
-	smp_mb__before_clear_bit();
+	napi_rx_flush(n);
+	arch_smp_mb();
 	clear_bit(NAPI_STATE_SCHED, &n->state);
-#endif
 }
 EXPORT_SYMBOL(__napi_complete);
 
 void napi_complete(struct napi_struct *n)
 {
-#if 0
 	unsigned long flags;
 
-	/*
-	 * don't let napi dequeue from the cpu poll list
-	 * just in case its running on a different cpu
-	 */
-	if (unlikely(test_bit(NAPI_STATE_NPSVC, &n->state)))
-		return;
-
-	napi_gro_flush(n, false);
 	local_irq_save(flags);
 	__napi_complete(n);
 	local_irq_restore(flags);
-#endif
 }
 EXPORT_SYMBOL(napi_complete);
 
@@ -135,12 +146,26 @@ EXPORT_SYMBOL(napi_complete);
  */
 void __napi_schedule(struct napi_struct *n)
 {
-#if 0
-	unsigned long flags;
+	int rc;
+	struct vmm_netport *port = n->dev->nsw_priv;
 
-	local_irq_save(flags);
-	____napi_schedule(&__get_cpu_var(softnet_data), n);
-	local_irq_restore(flags);
-#endif
+	if (!port) {
+		vmm_printf("%s Net dev %s has no switch attached\n",
+			   __func__, n->dev->name);
+		clear_bit(NAPI_STATE_SCHED, &n->state);
+		return;
+	}
+
+	/* Poll runs from netswitch bottom-half of current CPU
+	 * unless driver steered it using netif_napi_set_bh()
+	 */
+	if (n->bh_hash < 0)
+		rc = vmm_port2switch_xfer_lazy(port, lazy_xfer2napi_poll,
+					       n, netdev_budget);
+	else
+		rc = vmm_port2switch_xfer_lazy_hash(port, n->bh_hash,
+					lazy_xfer2napi_poll, n, netdev_budget);
+	if (rc)
+		clear_bit(NAPI_STATE_SCHED, &n->state);
 }
 EXPORT_SYMBOL(__napi_schedule);
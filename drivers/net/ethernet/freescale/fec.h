@@ -19,6 +19,7 @@
 #include <linux/clocksource.h>
 #include <linux/net_tstamp.h>
 #include <linux/ptp_clock_kernel.h>
+#include <libs/mempool.h>
 
 #if defined(CONFIG_M523x) || defined(CONFIG_M527x) || defined(CONFIG_M528x) || \
     defined(CONFIG_M520x) || defined(CONFIG_M532x) || \
@@ -324,6 +325,8 @@ struct bufdesc_ex {
 #define FEC_ENET_RX_FRSIZE	2048
 #define FEC_ENET_RX_FRPPG	(PAGE_SIZE / FEC_ENET_RX_FRSIZE)
 #define RX_RING_SIZE		(FEC_ENET_RX_FRPPG * FEC_ENET_RX_PAGES)
+/* Rx buffers in pool of each Rx queue (ring plus frames in flight) */
+#define FEC_ENET_RX_POOL_SIZE	(2 * RX_RING_SIZE)
 #define FEC_ENET_TX_FRSIZE	2048
 #define FEC_ENET_TX_FRPPG	(PAGE_SIZE / FEC_ENET_TX_FRSIZE)
 #define TX_RING_SIZE		16	/* Must be power of two */
@@ -366,6 +369,14 @@ struct bufdesc_ex {
 #define FEC_ITR_ICTT(X)		((X) & 0xFFFF)
 #define FEC_ITR_ICFT_DEFAULT	200  /* Set 200 frame count threshold */
 #define FEC_ITR_ICTT_DEFAULT	1000 /* Set 1000us timer threshold */
+#define FEC_ITR_SAMPLE_DEFAULT	1    /* Sample Rx packet rate every second */
+#define FEC_RXIC(X)		((X == 0) ? FEC_RXIC0 : \
+				((X == 1) ? FEC_RXIC1 : FEC_RXIC2))
+
+/* Adaptive Rx interrupt coalescing levels */
+#define FEC_ITR_LEVEL_LOW	0 /* packet rate below pkt_rate_low */
+#define FEC_ITR_LEVEL_NORMAL	1
+#define FEC_ITR_LEVEL_HIGH	2 /* packet rate above pkt_rate_high */
 
 #define FEC_VLAN_TAG_LEN       0x04
 #define FEC_ETHTYPE_LEN                0x02
@@ -447,6 +458,21 @@ struct fec_enet_priv_rx_q {
 	uint rx_ring_size;
 
 	struct bufdesc	*cur_rx;
+
+	/* NAPI context of Rx queue, also services Tx queues
+	 * mapped onto this Rx queue. The napi_mask has the
+	 * RXF/TXF interrupt bits handled by this context.
+	 */
+	struct napi_struct napi;
+	uint napi_mask;
+
+	/* Pool of Rx buffers attached as mbuf ext storage */
+	struct mempool *rx_pool;
+
+	/* Adaptive interrupt coalescing state */
+	unsigned long itr_jiffies;
+	u32 itr_pkts;
+	int itr_level;
 };
 
 /* The FEC buffer descriptors track the ring buffers.  The rx_bd_base and
@@ -514,7 +540,7 @@ struct fec_enet_private {
 	int	bufdesc_ex;
 	int	pause_flag;
 
-	struct	napi_struct napi;
+	spinlock_t imask_lock;
 	int	csum_flags;
 
 	struct work_struct tx_timeout_work;
@@ -543,6 +569,16 @@ struct fec_enet_private {
 	unsigned int tx_time_itr;
 	unsigned int itr_clk_rate;
 
+	/* adaptive Rx interrupt coalesce */
+	bool use_adaptive_rx_coalesce;
+	unsigned int pkt_rate_low;
+	unsigned int rx_pkts_itr_low;
+	unsigned int rx_time_itr_low;
+	unsigned int pkt_rate_high;
+	unsigned int rx_pkts_itr_high;
+	unsigned int rx_time_itr_high;
+	unsigned int rate_sample_interval;
+
 	u32 rx_copybreak;
 
 	/* ptp clock period in ns*/
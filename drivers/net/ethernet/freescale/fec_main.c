@@ -75,6 +75,7 @@
 #if 1
 # include <linux/swab.h>
 # include <linux/dma-mapping.h>
+# include <libs/mathlib.h>
 #endif /* 1 */
 #include "fec.h"
 
@@ -83,10 +84,20 @@
 static void set_multicast_list(struct net_device *ndev);
 #endif /* 0 */
 static void fec_enet_itr_coal_init(struct net_device *ndev);
+static void fec_enet_itr_adapt(struct net_device *ndev,
+			       struct fec_enet_priv_rx_q *rxq, int pkts);
+static void fec_enet_napi_enable(struct net_device *ndev);
+static void fec_enet_napi_disable(struct net_device *ndev);
 
 #define DRIVER_NAME	"fec"
 
-#define FEC_ENET_GET_QUQUE(_x) ((_x == 0) ? 1 : ((_x == 1) ? 2 : 0))
+/* Interrupt event bits of each ring */
+static const uint fec_enet_rxf_mask[FEC_ENET_MAX_RX_QS] = {
+	FEC_ENET_RXF_0, FEC_ENET_RXF_1, FEC_ENET_RXF_2,
+};
+static const uint fec_enet_txf_mask[FEC_ENET_MAX_TX_QS] = {
+	FEC_ENET_TXF_0, FEC_ENET_TXF_1, FEC_ENET_TXF_2,
+};
 
 /* Pause frame feild and FIFO threshold */
 #define FEC_ENET_FCE	(1 << 5)
@@ -1332,12 +1343,12 @@ static void fec_enet_timeout_work(struct work_struct *work)
 
 	rtnl_lock();
 	if (netif_device_present(ndev) || netif_running(ndev)) {
-		napi_disable(&fep->napi);
+		fec_enet_napi_disable(ndev);
 		netif_tx_lock_bh(ndev);
 		fec_restart(ndev);
 		netif_wake_queue(ndev);
 		netif_tx_unlock_bh(ndev);
-		napi_enable(&fep->napi);
+		fec_enet_napi_enable(ndev);
 	}
 	rtnl_unlock();
 }
@@ -1373,8 +1384,6 @@ fec_enet_tx_queue(struct net_device *ndev, u16 queue_id)
 
 	fep = netdev_priv(ndev);
 
-	queue_id = FEC_ENET_GET_QUQUE(queue_id);
-
 	txq = fep->tx_queue[queue_id];
 	/* get next bdp of dirty_tx */
 	nq = netdev_get_tx_queue(ndev, queue_id);
@@ -1471,17 +1480,37 @@ fec_enet_tx_queue(struct net_device *ndev, u16 queue_id)
 		writel(0, fep->hwp + FEC_X_DES_ACTIVE(queue_id));
 }
 
-static void
-fec_enet_tx(struct net_device *ndev)
+static void fec_enet_rx_pool_free(struct vmm_mbuf *m, void *buf,
+				  u32 len, void *arg)
 {
-	struct fec_enet_private *fep = netdev_priv(ndev);
-	u16 queue_id;
-	/* First process class A queue, then Class B and Best Effort queue */
-	for_each_set_bit(queue_id, &fep->work_tx, FEC_ENET_MAX_TX_QS) {
-		clear_bit(queue_id, &fep->work_tx);
-		fec_enet_tx_queue(ndev, queue_id);
+	struct fec_enet_priv_rx_q *rxq = arg;
+
+	mempool_free(rxq->rx_pool, buf);
+}
+
+/* Allocate Rx buffer from pool of Rx queue and attach it as mbuf
+ * ext storage so that received frames are passed up without copy.
+ */
+static struct sk_buff *fec_enet_rx_pool_alloc(struct fec_enet_priv_rx_q *rxq)
+{
+	struct sk_buff *skb;
+	void *buf;
+
+	if (!rxq->rx_pool)
+		return NULL;
+
+	buf = mempool_malloc(rxq->rx_pool);
+	if (!buf)
+		return NULL;
+
+	MGETHDR(skb, 0, 0);
+	if (!skb) {
+		mempool_free(rxq->rx_pool, buf);
+		return NULL;
 	}
-	return;
+	MEXTADD(skb, buf, FEC_ENET_RX_FRSIZE, fec_enet_rx_pool_free, rxq);
+
+	return skb;
 }
 
 static int
@@ -1599,7 +1628,6 @@ fec_enet_rx_queue(struct net_device *ndev, int budget, u16 queue_id)
 #ifdef CONFIG_M532x
 	flush_cache_all();
 #endif
-	queue_id = FEC_ENET_GET_QUQUE(queue_id);
 	rxq = fep->rx_queue[queue_id];
 
 	/* First, grab all of the stats for the incoming packet.
@@ -1658,14 +1686,23 @@ fec_enet_rx_queue(struct net_device *ndev, int budget, u16 queue_id)
 		 * include that when passing upstream as it messes up
 		 * bridging applications.
 		 */
-		is_copybreak = fec_enet_copybreak(ndev, &skb, bdp, pkt_len - 4,
-						  need_swap);
+		/* Replacing the buffer from Rx pool is cheaper than
+		 * copying so copybreak is only used when pool is empty.
+		 */
+		skb_new = fec_enet_rx_pool_alloc(rxq);
+		is_copybreak = false;
+		if (!skb_new)
+			is_copybreak = fec_enet_copybreak(ndev, &skb, bdp,
+							  pkt_len - 4,
+							  need_swap);
 		if (!is_copybreak) {
 #if 0
 			skb_new = netdev_alloc_skb(ndev, FEC_ENET_RX_FRSIZE);
 #else
-			skb_new = __netdev_alloc_skb(ndev, FEC_ENET_RX_FRSIZE,
-						     VMM_MBUF_ALLOC_DMA);
+			if (!skb_new)
+				skb_new = __netdev_alloc_skb(ndev,
+							FEC_ENET_RX_FRSIZE,
+							VMM_MBUF_ALLOC_DMA);
 #endif /* 0 */
 			if (unlikely(!skb_new)) {
 				ndev->stats.rx_dropped++;
@@ -1738,7 +1775,7 @@ fec_enet_rx_queue(struct net_device *ndev, int budget, u16 queue_id)
 					       vlan_tag);
 
 #endif /* 0 */
-		napi_gro_receive(&fep->napi, skb);
+		napi_gro_receive(&rxq->napi, skb);
 
 		if (is_copybreak) {
 #if 0
@@ -1784,42 +1821,15 @@ rx_processing_done:
 	return pkt_received;
 }
 
-static int
-fec_enet_rx(struct net_device *ndev, int budget)
-{
-	int     pkt_received = 0;
-	u16	queue_id;
-	struct fec_enet_private *fep = netdev_priv(ndev);
-
-	for_each_set_bit(queue_id, &fep->work_rx, FEC_ENET_MAX_RX_QS) {
-		clear_bit(queue_id, &fep->work_rx);
-		pkt_received += fec_enet_rx_queue(ndev,
-					budget - pkt_received, queue_id);
-	}
-	return pkt_received;
-}
-
-static bool
-fec_enet_collect_events(struct fec_enet_private *fep, uint int_events)
+static void fec_enet_imask_update(struct fec_enet_private *fep,
+				  uint clear, uint set)
 {
-	if (int_events == 0)
-		return false;
-
-	if (int_events & FEC_ENET_RXF)
-		fep->work_rx |= (1 << 2);
-	if (int_events & FEC_ENET_RXF_1)
-		fep->work_rx |= (1 << 0);
-	if (int_events & FEC_ENET_RXF_2)
-		fep->work_rx |= (1 << 1);
-
-	if (int_events & FEC_ENET_TXF)
-		fep->work_tx |= (1 << 2);
-	if (int_events & FEC_ENET_TXF_1)
-		fep->work_tx |= (1 << 0);
-	if (int_events & FEC_ENET_TXF_2)
-		fep->work_tx |= (1 << 1);
+	unsigned long flags;
 
-	return true;
+	spin_lock_irqsave(&fep->imask_lock, flags);
+	writel((readl(fep->hwp + FEC_IMASK) & ~clear) | set,
+	       fep->hwp + FEC_IMASK);
+	spin_unlock_irqrestore(&fep->imask_lock, flags);
 }
 
 static irqreturn_t
@@ -1828,19 +1838,28 @@ fec_enet_interrupt(int irq, void *dev_id)
 	struct net_device *ndev = dev_id;
 	struct fec_enet_private *fep = netdev_priv(ndev);
 	const unsigned napi_mask = FEC_ENET_RXF | FEC_ENET_TXF;
+	struct fec_enet_priv_rx_q *rxq;
 	uint int_events;
 	irqreturn_t ret = IRQ_NONE;
+	int q;
 
 	int_events = readl(fep->hwp + FEC_IEVENT);
 	writel(int_events & ~napi_mask, fep->hwp + FEC_IEVENT);
-	fec_enet_collect_events(fep, int_events);
 
 	if (int_events & napi_mask) {
 		ret = IRQ_HANDLED;
 
-		/* Disable the NAPI interrupts */
-		writel(FEC_ENET_MII, fep->hwp + FEC_IMASK);
-		napi_schedule(&fep->napi);
+		/* Disable the NAPI interrupts of each signalled queue
+		 * and schedule its NAPI context. Contexts of different
+		 * queues run on netswitch bottom-half of different CPUs.
+		 */
+		for (q = 0; q < fep->num_rx_queues; q++) {
+			rxq = fep->rx_queue[q];
+			if (!(int_events & rxq->napi_mask))
+				continue;
+			fec_enet_imask_update(fep, rxq->napi_mask, 0);
+			napi_schedule(&rxq->napi);
+		}
 	}
 
 	if (int_events & FEC_ENET_MII) {
@@ -1860,25 +1879,50 @@ static int fec_enet_rx_napi(struct napi_struct *napi, int budget)
 {
 	struct net_device *ndev = napi->dev;
 	struct fec_enet_private *fep = netdev_priv(ndev);
-	int pkts;
+	struct fec_enet_priv_rx_q *rxq =
+		container_of(napi, struct fec_enet_priv_rx_q, napi);
+	int pkts, q;
 
 	/*
-	 * Clear any pending transmit or receive interrupts before
-	 * processing the rings to avoid racing with the hardware.
+	 * Clear any pending transmit or receive interrupts of
+	 * this context before processing the rings to avoid
+	 * racing with the hardware.
 	 */
-	writel(FEC_ENET_RXF | FEC_ENET_TXF, fep->hwp + FEC_IEVENT);
+	writel(rxq->napi_mask, fep->hwp + FEC_IEVENT);
 
-	pkts = fec_enet_rx(ndev, budget);
+	pkts = fec_enet_rx_queue(ndev, budget, rxq->index);
 
-	fec_enet_tx(ndev);
+	/* Tx queues are spread over Rx queue contexts */
+	for (q = rxq->index; q < fep->num_tx_queues; q += fep->num_rx_queues)
+		fec_enet_tx_queue(ndev, q);
+
+	fec_enet_itr_adapt(ndev, rxq, pkts);
 
 	if (pkts < budget) {
 		napi_complete(napi);
-		writel(FEC_DEFAULT_IMASK, fep->hwp + FEC_IMASK);
+		fec_enet_imask_update(fep, 0, rxq->napi_mask);
 	}
 	return pkts;
 }
 
+static void fec_enet_napi_enable(struct net_device *ndev)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	int q;
+
+	for (q = 0; q < fep->num_rx_queues; q++)
+		napi_enable(&fep->rx_queue[q]->napi);
+}
+
+static void fec_enet_napi_disable(struct net_device *ndev)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	int q;
+
+	for (q = 0; q < fep->num_rx_queues; q++)
+		napi_disable(&fep->rx_queue[q]->napi);
+}
+
 /* ------------------------------------------------------------------------- */
 static void fec_get_mac(struct net_device *ndev)
 {
@@ -1999,20 +2043,20 @@ static void fec_enet_adjust_link(struct net_device *ndev)
 
 		/* if any of the above changed restart the FEC */
 		if (status_change) {
-			napi_disable(&fep->napi);
+			fec_enet_napi_disable(ndev);
 			netif_tx_lock_bh(ndev);
 			fec_restart(ndev);
 			netif_wake_queue(ndev);
 			netif_tx_unlock_bh(ndev);
-			napi_enable(&fep->napi);
+			fec_enet_napi_enable(ndev);
 		}
 	} else {
 		if (fep->link) {
-			napi_disable(&fep->napi);
+			fec_enet_napi_disable(ndev);
 			netif_tx_lock_bh(ndev);
 			fec_stop(ndev);
 			netif_tx_unlock_bh(ndev);
-			napi_enable(&fep->napi);
+			fec_enet_napi_enable(ndev);
 			fep->link = phy_dev->link;
 			status_change = 1;
 		}
@@ -2471,12 +2515,12 @@ static int fec_enet_set_pauseparam(struct net_device *ndev,
 		phy_start_aneg(fep->phy_dev);
 	}
 	if (netif_running(ndev)) {
-		napi_disable(&fep->napi);
+		fec_enet_napi_disable(ndev);
 		netif_tx_lock_bh(ndev);
 		fec_restart(ndev);
 		netif_wake_queue(ndev);
 		netif_tx_unlock_bh(ndev);
-		napi_enable(&fep->napi);
+		fec_enet_napi_enable(ndev);
 	}
 
 	return 0;
@@ -2621,6 +2665,45 @@ static int fec_enet_us_to_itr_clock(struct net_device *ndev, int us)
 	return us * (fep->itr_clk_rate / 64000) / 1000;
 }
 
+static u32 fec_enet_itr_val(struct net_device *ndev,
+			    unsigned int pkts, unsigned int usecs)
+{
+	/* Select enet system clock as Interrupt Coalescing
+	 * timer Clock Source
+	 */
+	u32 itr = FEC_ITR_CLK_SEL;
+
+	/* set ICFT and ICTT */
+	itr |= FEC_ITR_ICFT(pkts);
+	itr |= FEC_ITR_ICTT(fec_enet_us_to_itr_clock(ndev, usecs));
+
+	return itr | FEC_ITR_EN;
+}
+
+/* Set Rx threshold of given queue based on its adaptive level */
+static void fec_enet_itr_coal_set_rxq(struct net_device *ndev, int queue)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	struct fec_enet_priv_rx_q *rxq = fep->rx_queue[queue];
+	unsigned int pkts = fep->rx_pkts_itr;
+	unsigned int usecs = fep->rx_time_itr;
+
+	if (fep->use_adaptive_rx_coalesce) {
+		if (rxq->itr_level == FEC_ITR_LEVEL_LOW &&
+		    fep->rx_pkts_itr_low && fep->rx_time_itr_low) {
+			pkts = fep->rx_pkts_itr_low;
+			usecs = fep->rx_time_itr_low;
+		} else if (rxq->itr_level == FEC_ITR_LEVEL_HIGH &&
+			   fep->rx_pkts_itr_high && fep->rx_time_itr_high) {
+			pkts = fep->rx_pkts_itr_high;
+			usecs = fep->rx_time_itr_high;
+		}
+	}
+
+	writel(fec_enet_itr_val(ndev, pkts, usecs),
+	       fep->hwp + FEC_RXIC(queue));
+}
+
 /* Set threshold for interrupt coalescing */
 static void fec_enet_itr_coal_set(struct net_device *ndev)
 {
@@ -2631,7 +2714,8 @@ static void fec_enet_itr_coal_set(struct net_device *ndev)
 #else /* 0 */
 	const struct platform_device_id *id_entry = fep->id_entry;
 #endif /* 0 */
-	int rx_itr, tx_itr;
+	u32 tx_itr;
+	int i;
 
 	if (!(id_entry->driver_data & FEC_QUIRK_HAS_AVB))
 		return;
@@ -2641,36 +2725,74 @@ static void fec_enet_itr_coal_set(struct net_device *ndev)
 	    !fep->tx_time_itr || !fep->tx_pkts_itr)
 		return;
 
-	/* Select enet system clock as Interrupt Coalescing
-	 * timer Clock Source
-	 */
-	rx_itr = FEC_ITR_CLK_SEL;
-	tx_itr = FEC_ITR_CLK_SEL;
-
-	/* set ICFT and ICTT */
-	rx_itr |= FEC_ITR_ICFT(fep->rx_pkts_itr);
-	rx_itr |= FEC_ITR_ICTT(fec_enet_us_to_itr_clock(ndev, fep->rx_time_itr));
-	tx_itr |= FEC_ITR_ICFT(fep->tx_pkts_itr);
-	tx_itr |= FEC_ITR_ICTT(fec_enet_us_to_itr_clock(ndev, fep->tx_time_itr));
-
-	rx_itr |= FEC_ITR_EN;
-	tx_itr |= FEC_ITR_EN;
+	tx_itr = fec_enet_itr_val(ndev, fep->tx_pkts_itr, fep->tx_time_itr);
 
 	writel(tx_itr, fep->hwp + FEC_TXIC0);
-	writel(rx_itr, fep->hwp + FEC_RXIC0);
 	writel(tx_itr, fep->hwp + FEC_TXIC1);
-	writel(rx_itr, fep->hwp + FEC_RXIC1);
 	writel(tx_itr, fep->hwp + FEC_TXIC2);
-	writel(rx_itr, fep->hwp + FEC_RXIC2);
+	for (i = 0; i < FEC_ENET_MAX_RX_QS; i++) {
+		if (i < fep->num_rx_queues) {
+			fep->rx_queue[i]->itr_level = FEC_ITR_LEVEL_NORMAL;
+			fep->rx_queue[i]->itr_jiffies = jiffies;
+			fep->rx_queue[i]->itr_pkts = 0;
+			fec_enet_itr_coal_set_rxq(ndev, i);
+		} else {
+			writel(fec_enet_itr_val(ndev, fep->rx_pkts_itr,
+						fep->rx_time_itr),
+			       fep->hwp + FEC_RXIC(i));
+		}
+	}
+}
+
+/* Sample Rx packet rate of queue from its NAPI poll and switch
+ * between low latency (low rate) and high throughput (high rate)
+ * thresholds of adaptive interrupt coalescing.
+ */
+static void fec_enet_itr_adapt(struct net_device *ndev,
+			       struct fec_enet_priv_rx_q *rxq, int pkts)
+{
+	struct fec_enet_private *fep = netdev_priv(ndev);
+	unsigned long now = jiffies;
+	unsigned int msecs;
+	u64 rate;
+	int level;
+
+	if (!fep->use_adaptive_rx_coalesce)
+		return;
+
+	rxq->itr_pkts += pkts;
+	if (!time_after(now, rxq->itr_jiffies +
+			     fep->rate_sample_interval * HZ))
+		return;
+
+	msecs = jiffies_to_msecs(now - rxq->itr_jiffies);
+	rate = udiv64((u64)rxq->itr_pkts * 1000, (msecs) ? msecs : 1);
+	rxq->itr_jiffies = now;
+	rxq->itr_pkts = 0;
+
+	if (rate < fep->pkt_rate_low)
+		level = FEC_ITR_LEVEL_LOW;
+	else if (rate > fep->pkt_rate_high)
+		level = FEC_ITR_LEVEL_HIGH;
+	else
+		level = FEC_ITR_LEVEL_NORMAL;
+
+	if (level != rxq->itr_level) {
+		rxq->itr_level = level;
+		fec_enet_itr_coal_set_rxq(ndev, rxq->index);
+	}
 }
 
-#if 0
 static int
 fec_enet_get_coalesce(struct net_device *ndev, struct ethtool_coalesce *ec)
 {
 	struct fec_enet_private *fep = netdev_priv(ndev);
+#if 0
 	const struct platform_device_id *id_entry =
 				platform_get_device_id(fep->pdev);
+#else /* 0 */
+	const struct platform_device_id *id_entry = fep->id_entry;
+#endif /* 0 */
 
 	if (!(id_entry->driver_data & FEC_QUIRK_HAS_AVB))
 		return -EOPNOTSUPP;
@@ -2681,9 +2803,17 @@ fec_enet_get_coalesce(struct net_device *ndev, struct ethtool_coalesce *ec)
 	ec->tx_coalesce_usecs = fep->tx_time_itr;
 	ec->tx_max_coalesced_frames = fep->tx_pkts_itr;
 
+	ec->use_adaptive_rx_coalesce = fep->use_adaptive_rx_coalesce;
+	ec->pkt_rate_low = fep->pkt_rate_low;
+	ec->rx_coalesce_usecs_low = fep->rx_time_itr_low;
+	ec->rx_max_coalesced_frames_low = fep->rx_pkts_itr_low;
+	ec->pkt_rate_high = fep->pkt_rate_high;
+	ec->rx_coalesce_usecs_high = fep->rx_time_itr_high;
+	ec->rx_max_coalesced_frames_high = fep->rx_pkts_itr_high;
+	ec->rate_sample_interval = fep->rate_sample_interval;
+
 	return 0;
 }
-#endif /* 0 */
 
 static int
 fec_enet_set_coalesce(struct net_device *ndev, struct ethtool_coalesce *ec)
@@ -2700,7 +2830,9 @@ fec_enet_set_coalesce(struct net_device *ndev, struct ethtool_coalesce *ec)
 	if (!(id_entry->driver_data & FEC_QUIRK_HAS_AVB))
 		return -EOPNOTSUPP;
 
-	if (ec->rx_max_coalesced_frames > 255) {
+	if (ec->rx_max_coalesced_frames > 255 ||
+	    ec->rx_max_coalesced_frames_low > 255 ||
+	    ec->rx_max_coalesced_frames_high > 255) {
 		pr_err("Rx coalesced frames exceed hardware limitation");
 		return -EINVAL;
 	}
@@ -2710,15 +2842,23 @@ fec_enet_set_coalesce(struct net_device *ndev, struct ethtool_coalesce *ec)
 		return -EINVAL;
 	}
 
-	cycle = fec_enet_us_to_itr_clock(ndev, fep->rx_time_itr);
-	if (cycle > 0xFFFF) {
+	cycle = fec_enet_us_to_itr_clock(ndev, ec->rx_coalesce_usecs);
+	if (cycle > 0xFFFF ||
+	    fec_enet_us_to_itr_clock(ndev, ec->rx_coalesce_usecs_low) > 0xFFFF ||
+	    fec_enet_us_to_itr_clock(ndev, ec->rx_coalesce_usecs_high) > 0xFFFF) {
 		pr_err("Rx coalesed usec exceeed hardware limitation");
 		return -EINVAL;
 	}
 
-	cycle = fec_enet_us_to_itr_clock(ndev, fep->tx_time_itr);
+	cycle = fec_enet_us_to_itr_clock(ndev, ec->tx_coalesce_usecs);
 	if (cycle > 0xFFFF) {
-		pr_err("Rx coalesed usec exceeed hardware limitation");
+		pr_err("Tx coalesed usec exceeed hardware limitation");
+		return -EINVAL;
+	}
+
+	if (ec->use_adaptive_rx_coalesce &&
+	    ec->pkt_rate_low > ec->pkt_rate_high) {
+		pr_err("Rx packet rate low exceeds packet rate high");
 		return -EINVAL;
 	}
 
@@ -2728,6 +2868,16 @@ fec_enet_set_coalesce(struct net_device *ndev, struct ethtool_coalesce *ec)
 	fep->tx_time_itr = ec->tx_coalesce_usecs;
 	fep->tx_pkts_itr = ec->tx_max_coalesced_frames;
 
+	fep->use_adaptive_rx_coalesce = ec->use_adaptive_rx_coalesce;
+	fep->pkt_rate_low = ec->pkt_rate_low;
+	fep->rx_time_itr_low = ec->rx_coalesce_usecs_low;
+	fep->rx_pkts_itr_low = ec->rx_max_coalesced_frames_low;
+	fep->pkt_rate_high = ec->pkt_rate_high;
+	fep->rx_time_itr_high = ec->rx_coalesce_usecs_high;
+	fep->rx_pkts_itr_high = ec->rx_max_coalesced_frames_high;
+	fep->rate_sample_interval = (ec->rate_sample_interval) ?
+			ec->rate_sample_interval : FEC_ITR_SAMPLE_DEFAULT;
+
 	fec_enet_itr_coal_set(ndev);
 
 	return 0;
@@ -2737,6 +2887,8 @@ static void fec_enet_itr_coal_init(struct net_device *ndev)
 {
 	struct ethtool_coalesce ec;
 
+	memset(&ec, 0, sizeof(ec));
+
 	ec.rx_coalesce_usecs = FEC_ITR_ICTT_DEFAULT;
 	ec.rx_max_coalesced_frames = FEC_ITR_ICFT_DEFAULT;
 
@@ -2804,6 +2956,11 @@ static const struct ethtool_ops fec_enet_ethtool_ops = {
 	.get_tunable		= fec_enet_get_tunable,
 	.set_tunable		= fec_enet_set_tunable,
 };
+#else /* 0 */
+static const struct ethtool_ops fec_enet_ethtool_ops = {
+	.get_coalesce		= fec_enet_get_coalesce,
+	.set_coalesce		= fec_enet_set_coalesce,
+};
 #endif /* 0 */
 
 #if 0
@@ -2892,8 +3049,11 @@ static void fec_enet_free_queue(struct net_device *ndev)
 		}
 
 	for (i = 0; i < fep->num_rx_queues; i++)
-		if (fep->rx_queue[i])
+		if (fep->rx_queue[i]) {
+			if (fep->rx_queue[i]->rx_pool)
+				mempool_destroy(fep->rx_queue[i]->rx_pool);
 			kfree(fep->rx_queue[i]);
+		}
 
 	for (i = 0; i < fep->num_tx_queues; i++)
 		if (fep->tx_queue[i])
@@ -2949,6 +3109,11 @@ static int fec_enet_alloc_queue(struct net_device *ndev)
 
 		fep->rx_queue[i]->rx_ring_size = RX_RING_SIZE;
 		fep->total_rx_ring_size += fep->rx_queue[i]->rx_ring_size;
+
+		/* Without pool Rx buffers are allocated from DMA heap */
+		fep->rx_queue[i]->rx_pool =
+			mempool_dma_create(FEC_ENET_RX_FRSIZE,
+					   FEC_ENET_RX_POOL_SIZE);
 	}
 	return ret;
 
@@ -2972,8 +3137,10 @@ fec_enet_alloc_rxq_buffers(struct net_device *ndev, unsigned int queue)
 #if 0
 		skb = netdev_alloc_skb(ndev, FEC_ENET_RX_FRSIZE);
 #else
-		skb = __netdev_alloc_skb(ndev, FEC_ENET_RX_FRSIZE,
-					 VMM_MBUF_ALLOC_DMA);
+		skb = fec_enet_rx_pool_alloc(rxq);
+		if (!skb)
+			skb = __netdev_alloc_skb(ndev, FEC_ENET_RX_FRSIZE,
+						 VMM_MBUF_ALLOC_DMA);
 #endif /* 0 */
 		if (!skb)
 			goto err_alloc;
@@ -3085,7 +3252,7 @@ fec_enet_open(struct net_device *ndev)
 		goto err_enet_mii_probe;
 
 	fec_restart(ndev);
-	napi_enable(&fep->napi);
+	fec_enet_napi_enable(ndev);
 	phy_start(fep->phy_dev);
 	netif_tx_start_all_queues(ndev);
 
@@ -3111,7 +3278,7 @@ fec_enet_close(struct net_device *ndev)
 	phy_stop(fep->phy_dev);
 
 	if (netif_device_present(ndev)) {
-		napi_disable(&fep->napi);
+		fec_enet_napi_disable(ndev);
 		netif_tx_disable(ndev);
 		fec_stop(ndev);
 	}
@@ -3277,14 +3444,14 @@ static int fec_set_features(struct net_device *netdev,
 	netdev_features_t changed = features ^ netdev->features;
 
 	if (netif_running(netdev) && changed & FEATURES_NEED_QUIESCE) {
-		napi_disable(&fep->napi);
+		fec_enet_napi_disable(netdev);
 		netif_tx_lock_bh(netdev);
 		fec_stop(netdev);
 		fec_enet_set_netdev_features(netdev, features);
 		fec_restart(netdev);
 		netif_tx_wake_all_queues(netdev);
 		netif_tx_unlock_bh(netdev);
-		napi_enable(&fep->napi);
+		fec_enet_napi_enable(netdev);
 	} else {
 		fec_enet_set_netdev_features(netdev, features);
 	}
@@ -3401,12 +3568,25 @@ static int fec_enet_init(struct net_device *ndev)
 	ndev->watchdog_timeo = TX_TIMEOUT;
 #endif /* 0 */
 	ndev->netdev_ops = &fec_netdev_ops;
-#if 0
 	ndev->ethtool_ops = &fec_enet_ethtool_ops;
-#endif /* 0 */
 
+	spin_lock_init(&fep->imask_lock);
 	writel(FEC_RX_DISABLED_IMASK, fep->hwp + FEC_IMASK);
-	netif_napi_add(ndev, &fep->napi, fec_enet_rx_napi, NAPI_POLL_WEIGHT);
+
+	/* One NAPI context per Rx queue, each polled from netswitch
+	 * bottom-half selected by its queue number. Tx queues are
+	 * serviced by context of Rx queue (Tx queue % Rx queues).
+	 */
+	for (i = 0; i < fep->num_rx_queues; i++) {
+		rxq = fep->rx_queue[i];
+		rxq->napi_mask = fec_enet_rxf_mask[i];
+		netif_napi_add(ndev, &rxq->napi, fec_enet_rx_napi,
+			       NAPI_POLL_WEIGHT);
+		netif_napi_set_bh(&rxq->napi, i);
+	}
+	for (i = 0; i < fep->num_tx_queues; i++)
+		fep->rx_queue[i % fep->num_rx_queues]->napi_mask |=
+							fec_enet_txf_mask[i];
 
 #if 0
 	if (id_entry->driver_data & FEC_QUIRK_HAS_VLAN)
@@ -3982,7 +4162,7 @@ static int __maybe_unused fec_suspend(struct device *dev)
 	rtnl_lock();
 	if (netif_running(ndev)) {
 		phy_stop(fep->phy_dev);
-		napi_disable(&fep->napi);
+		fec_enet_napi_disable(ndev);
 		netif_tx_lock_bh(ndev);
 		netif_device_detach(ndev);
 		netif_tx_unlock_bh(ndev);
@@ -4022,7 +4202,7 @@ static int __maybe_unused fec_resume(struct device *dev)
 		netif_tx_lock_bh(ndev);
 		netif_device_attach(ndev);
 		netif_tx_unlock_bh(ndev);
-		napi_enable(&fep->napi);
+		fec_enet_napi_enable(ndev);
 		phy_start(fep->phy_dev);
 	}
 	rtnl_unlock();
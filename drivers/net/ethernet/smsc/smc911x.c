@@ -426,7 +426,7 @@ static inline void	 smc911x_rcv(struct net_device *dev)
 		DBG(SMC_DEBUG_PKTS, "%s: Received packet\n", dev->name);
 		PRINT_PKT(data, ((pkt_len - 4) <= 64) ? pkt_len - 4 : 64);
 		//Fixme: skb->protocol = eth_type_trans(skb, dev);
-		netif_rx(skb, dev);
+		napi_gro_receive(&lp->napi, skb);
 		dev->stats.rx_packets++;
 		dev->stats.rx_bytes += pkt_len-4;
 #endif
@@ -1099,8 +1099,14 @@ static vmm_irq_return_t smc911x_interrupt(int irq_no, void *dev_id)
 						dev->name, fifo & 0xff);
 					SMC_SET_FIFO_INT(lp, fifo);
 				} else
+					smc911x_rcv(dev);
+#else
+				/* RX FIFO is drained by NAPI poll with
+				 * RX interrupt masked.
+				 */
+				mask &= ~INT_EN_RSFL_EN_;
+				napi_schedule(&lp->napi);
 #endif
-				smc911x_rcv(dev);
 			}
 			SMC_ACK_INT(lp, INT_STS_RSFL_);
 		}
@@ -1394,6 +1400,50 @@ static void smc911x_set_multicast_list(struct net_device *dev)
 
 #endif
 
+/*
+ * NAPI poll routine which drains RX FIFO with RX interrupt
+ * masked and unmasks it once the FIFO is empty.
+ */
+static int smc911x_poll(struct napi_struct *napi, int budget)
+{
+	struct smc911x_local *lp =
+		container_of(napi, struct smc911x_local, napi);
+	struct net_device *dev = lp->netdev;
+	unsigned int pkts;
+	unsigned long flags;
+	int work = 0;
+
+	DBG(SMC_DEBUG_FUNC | SMC_DEBUG_RX, "%s: --> %s\n",
+		dev->name, __func__);
+
+	spin_lock_irqsave(&lp->lock, flags);
+
+	while (work < budget) {
+		pkts = (SMC_GET_RX_FIFO_INF(lp) & RX_FIFO_INF_RXSUSED_) >> 16;
+		if (!pkts)
+			break;
+		smc911x_rcv(dev);
+		work++;
+	}
+
+	if (work < budget) {
+		napi_complete(napi);
+		SMC_ACK_INT(lp, INT_STS_RSFL_);
+		SMC_ENABLE_INT(lp, INT_EN_RSFL_EN_);
+
+		/* Packet might have arrived before RX interrupt unmask */
+		pkts = (SMC_GET_RX_FIFO_INF(lp) & RX_FIFO_INF_RXSUSED_) >> 16;
+		if (pkts && napi_schedule_prep(napi)) {
+			SMC_DISABLE_INT(lp, INT_EN_RSFL_EN_);
+			__napi_schedule(napi);
+		}
+	}
+
+	spin_unlock_irqrestore(&lp->lock, flags);
+
+	return work;
+}
+
 /*
  * Open and Initialize the board
  *
@@ -1422,6 +1472,8 @@ smc911x_open(struct net_device *dev)
 	/* Configure the PHY, initialize the link state */
 	smc911x_phy_configure(&lp->phy_configure);
 
+	napi_enable(&lp->napi);
+
 	/* Turn on Tx + Rx */
 	smc911x_enable(dev);
 
@@ -1449,6 +1501,8 @@ static int smc911x_close(struct net_device *dev)
 	/* clear everything */
 	smc911x_shutdown(dev);
 
+	napi_disable(&lp->napi);
+
 	if (lp->phy_type != 0) {
 		/* We need to ensure that no calls to
 		 * smc911x_phy_configure are pending.
@@ -1941,6 +1995,7 @@ static int smc911x_probe(struct net_device *dev)
 	dev->watchdog_timeo = msecs_to_jiffies(watchdog);
 #endif
 	dev->ethtool_ops = &smc911x_ethtool_ops;
+	netif_napi_add(dev, &lp->napi, smc911x_poll, NAPI_POLL_WEIGHT);
 #if 0
 	INIT_WORK(&lp->phy_configure, smc911x_phy_configure);
 #endif
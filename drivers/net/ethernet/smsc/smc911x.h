@@ -134,6 +134,8 @@ struct smc911x_local {
 	int tx_throttle;
 	spinlock_t lock;
 
+	struct napi_struct napi;
+
 	struct net_device *netdev;
 
 #ifdef SMC_USE_DMA
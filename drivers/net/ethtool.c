@@ -101,6 +101,44 @@ int ethtool_op_set_flags(struct net_device *dev, u32 data)
 	return 0;
 }
 
+/* Net devices are found through netport created for them */
+struct net_device *ethtool_netdev_find(const char *name)
+{
+	struct vmm_netport *port = vmm_netport_find(name);
+
+	if (!port || port->switch2port_xfer != netdev_switch2port_xfer)
+		return NULL;
+
+	return port->priv;
+}
+EXPORT_SYMBOL(ethtool_netdev_find);
+
+int ethtool_get_coalesce(struct net_device *dev, struct ethtool_coalesce *ec)
+{
+	if (!dev || !ec)
+		return VMM_EINVALID;
+	if (!dev->ethtool_ops || !dev->ethtool_ops->get_coalesce)
+		return VMM_EOPNOTSUPP;
+
+	memset(ec, 0, sizeof(*ec));
+	ec->cmd = ETHTOOL_GCOALESCE;
+
+	return dev->ethtool_ops->get_coalesce(dev, ec);
+}
+EXPORT_SYMBOL(ethtool_get_coalesce);
+
+int ethtool_set_coalesce(struct net_device *dev, struct ethtool_coalesce *ec)
+{
+	if (!dev || !ec)
+		return VMM_EINVALID;
+	if (!dev->ethtool_ops || !dev->ethtool_ops->set_coalesce)
+		return VMM_EOPNOTSUPP;
+
+	ec->cmd = ETHTOOL_SCOALESCE;
+
+	return dev->ethtool_ops->set_coalesce(dev, ec);
+}
+EXPORT_SYMBOL(ethtool_set_coalesce);
 
 #if 0
 /* The main entry point in this file.  Called from net/core/dev.c */
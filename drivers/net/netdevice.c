@@ -66,6 +66,9 @@ static int netdev_register_port(struct net_device *ndev)
         port->switch2port_xfer = netdev_switch2port_xfer;
         port->priv = ndev;
         memcpy(port->macaddr, ndev->dev_addr, ETH_ALEN);
+	if (dev && dev->of_node) {
+		vmm_netport_qos_setup(port, dev->of_node);
+	}
 
         ndev->nsw_priv = port;
 
@@ -147,7 +150,7 @@ void netdev_set_link(struct vmm_netport *port)
 			dev->state |= NETDEV_OPEN;
 		else
 			dev->state &= ~NETDEV_OPEN;
-	} else {
+	} else if (dev->state & NETDEV_OPEN) {
 		dev->netdev_ops->ndo_stop(dev);
 		dev->state &= ~NETDEV_OPEN;
 	}
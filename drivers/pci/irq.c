@@ -18,7 +18,7 @@
  *
  * @file irq.c
  * @author Himanshu Chauhan (hschauhan@nulltrace.org)
- * @brief PCI IRQ  fail handing code.
+ * @brief PCI IRQ fail handing and MSI/MSI-X code.
  *
  * All the work under drivers/pci/ is a derived work from Linux's
  * PCI Framework. The following is the commit ID from which it has
@@ -37,6 +37,10 @@
 #include <linux/kernel.h>
 #include <linux/export.h>
 #include <linux/pci.h>
+#include <linux/slab.h>
+#include <linux/msi.h>
+
+#include "pci.h"
 
 static void pci_note_irq_problem(struct pci_dev *pdev, const char *reason)
 {
@@ -89,3 +93,578 @@ enum pci_lost_interrupt_reason pci_lost_interrupt(struct pci_dev *pdev)
 	return PCI_LOST_IRQ_NO_INFORMATION;
 }
 EXPORT_SYMBOL(pci_lost_interrupt);
+
+#ifdef CONFIG_PCI_MSI
+/*
+ * MSI/MSI-X support derived from Linux drivers/pci/msi.c. Host IRQs
+ * of MSI/MSI-X vectors are allocated by the MSI controller of the
+ * host bridge (bus->msi) which composes the MSI message for each
+ * vector. The message is then programmed in the device here.
+ */
+
+static int pci_msi_enable = 1;
+
+void pci_no_msi(void)
+{
+	pci_msi_enable = 0;
+}
+
+int pci_msi_enabled(void)
+{
+	return pci_msi_enable;
+}
+EXPORT_SYMBOL(pci_msi_enabled);
+
+static void pci_intx_for_msi(struct pci_dev *dev, int enable)
+{
+	if (!(dev->dev_flags & PCI_DEV_FLAGS_MSI_INTX_DISABLE_BUG))
+		pci_intx(dev, enable);
+}
+
+static void msi_set_enable(struct pci_dev *dev, int enable)
+{
+	u16 control;
+
+	pci_read_config_word(dev, dev->msi_cap + PCI_MSI_FLAGS, &control);
+	control &= ~PCI_MSI_FLAGS_ENABLE;
+	if (enable)
+		control |= PCI_MSI_FLAGS_ENABLE;
+	pci_write_config_word(dev, dev->msi_cap + PCI_MSI_FLAGS, control);
+}
+
+static void msix_clear_and_set_ctrl(struct pci_dev *dev, u16 clear, u16 set)
+{
+	u16 ctrl;
+
+	pci_read_config_word(dev, dev->msix_cap + PCI_MSIX_FLAGS, &ctrl);
+	ctrl &= ~clear;
+	ctrl |= set;
+	pci_write_config_word(dev, dev->msix_cap + PCI_MSIX_FLAGS, ctrl);
+}
+
+static inline int msix_table_size(u16 flags)
+{
+	return (flags & PCI_MSIX_FLAGS_QSIZE) + 1;
+}
+
+static void __iomem *msix_entry_base(struct msi_desc *desc)
+{
+	return desc->mask_base + desc->msi_attrib.entry_nr * PCI_MSIX_ENTRY_SIZE;
+}
+
+static void msix_mask_irq(struct msi_desc *desc, u32 flag)
+{
+	u32 mask_bits = desc->masked;
+
+	mask_bits &= ~PCI_MSIX_ENTRY_CTRL_MASKBIT;
+	if (flag)
+		mask_bits |= PCI_MSIX_ENTRY_CTRL_MASKBIT;
+	writel(mask_bits, msix_entry_base(desc) + PCI_MSIX_ENTRY_VECTOR_CTRL);
+	desc->masked = mask_bits;
+}
+
+static void msi_mask_irq(struct msi_desc *desc, u32 mask, u32 flag)
+{
+	if (!desc->msi_attrib.maskbit)
+		return;
+
+	desc->masked &= ~mask;
+	desc->masked |= flag;
+	pci_write_config_dword(desc->dev, desc->mask_pos, desc->masked);
+}
+
+static void pci_write_msi_msg(struct msi_desc *entry, struct msi_msg *msg)
+{
+	struct pci_dev *dev = entry->dev;
+
+	if (entry->msi_attrib.is_msix) {
+		void __iomem *base = msix_entry_base(entry);
+
+		writel(msg->address_lo, base + PCI_MSIX_ENTRY_LOWER_ADDR);
+		writel(msg->address_hi, base + PCI_MSIX_ENTRY_UPPER_ADDR);
+		writel(msg->data, base + PCI_MSIX_ENTRY_DATA);
+	} else {
+		int pos = dev->msi_cap;
+
+		pci_write_config_dword(dev, pos + PCI_MSI_ADDRESS_LO,
+				       msg->address_lo);
+		if (entry->msi_attrib.is_64) {
+			pci_write_config_dword(dev, pos + PCI_MSI_ADDRESS_HI,
+					       msg->address_hi);
+			pci_write_config_word(dev, pos + PCI_MSI_DATA_64,
+					      msg->data);
+		} else {
+			pci_write_config_word(dev, pos + PCI_MSI_DATA_32,
+					      msg->data);
+		}
+	}
+	entry->msg = *msg;
+}
+
+static struct msi_desc *alloc_msi_entry(struct pci_dev *dev)
+{
+	struct msi_desc *desc = kzalloc(sizeof(*desc), GFP_KERNEL);
+
+	if (!desc)
+		return NULL;
+
+	INIT_LIST_HEAD(&desc->list);
+	desc->dev = dev;
+
+	return desc;
+}
+
+static int pci_msi_setup_irqs(struct pci_dev *dev)
+{
+	int ret;
+	struct msi_desc *entry;
+	struct msi_controller *chip = dev->bus->msi;
+
+	if (!chip || !chip->setup_irq)
+		return -EINVAL;
+
+	list_for_each_entry(entry, &dev->msi_list, list) {
+		ret = chip->setup_irq(chip, dev, entry);
+		if (ret < 0)
+			return ret;
+		if (!entry->irq)
+			return -ENOSPC;
+		pci_write_msi_msg(entry, &entry->msg);
+	}
+
+	return 0;
+}
+
+static void free_msi_irqs(struct pci_dev *dev)
+{
+	struct msi_desc *entry, *tmp;
+	struct msi_controller *chip = dev->bus->msi;
+
+	list_for_each_entry_safe(entry, tmp, &dev->msi_list, list) {
+		if (entry->irq && chip && chip->teardown_irq)
+			chip->teardown_irq(chip, entry->irq);
+		if (entry->msi_attrib.is_msix &&
+		    list_is_last(&entry->list, &dev->msi_list))
+			iounmap(entry->mask_base);
+		list_del(&entry->list);
+		kfree(entry);
+	}
+}
+
+static int pci_msi_supported(struct pci_dev *dev, int nvec)
+{
+	if (!pci_msi_enable)
+		return 0;
+	if (!dev || dev->no_msi || dev->current_state != PCI_D0)
+		return 0;
+	if (nvec < 1)
+		return 0;
+	if (dev->bus->bus_flags & PCI_BUS_FLAGS_NO_MSI)
+		return 0;
+	if (!dev->bus->msi)
+		return 0;
+
+	return 1;
+}
+
+/**
+ * pci_msi_init_pci_dev - find MSI/MSI-X capabilities of a new device
+ * @dev: pointer to the pci_dev data structure of the device
+ *
+ * MSI and MSI-X are left disabled until a driver enables them.
+ */
+void pci_msi_init_pci_dev(struct pci_dev *dev)
+{
+	INIT_LIST_HEAD(&dev->msi_list);
+
+	dev->msi_cap = pci_find_capability(dev, PCI_CAP_ID_MSI);
+	if (dev->msi_cap)
+		msi_set_enable(dev, 0);
+
+	dev->msix_cap = pci_find_capability(dev, PCI_CAP_ID_MSIX);
+	if (dev->msix_cap)
+		msix_clear_and_set_ctrl(dev, PCI_MSIX_FLAGS_ENABLE, 0);
+}
+
+/**
+ * pci_msi_vec_count - Return the number of MSI vectors a device can send
+ * @dev: device to report about
+ */
+int pci_msi_vec_count(struct pci_dev *dev)
+{
+	int ret;
+	u16 msgctl;
+
+	if (!dev->msi_cap)
+		return -EINVAL;
+
+	pci_read_config_word(dev, dev->msi_cap + PCI_MSI_FLAGS, &msgctl);
+	ret = 1 << ((msgctl & PCI_MSI_FLAGS_QMASK) >> 1);
+
+	return ret;
+}
+EXPORT_SYMBOL(pci_msi_vec_count);
+
+/*
+ * Only one MSI vector is setup per device because multiple MSI
+ * vectors need a contiguous block of host IRQs from MSI controller.
+ */
+static int msi_capability_init(struct pci_dev *dev)
+{
+	int ret;
+	u16 control;
+	struct msi_desc *entry;
+
+	msi_set_enable(dev, 0);
+
+	pci_read_config_word(dev, dev->msi_cap + PCI_MSI_FLAGS, &control);
+	entry = alloc_msi_entry(dev);
+	if (!entry)
+		return -ENOMEM;
+
+	entry->msi_attrib.is_msix = 0;
+	entry->msi_attrib.is_64 = !!(control & PCI_MSI_FLAGS_64BIT);
+	entry->msi_attrib.entry_nr = 0;
+	entry->msi_attrib.maskbit = !!(control & PCI_MSI_FLAGS_MASKBIT);
+	entry->msi_attrib.default_irq = dev->irq;
+	entry->msi_attrib.multi_cap = (control & PCI_MSI_FLAGS_QMASK) >> 1;
+	entry->msi_attrib.multiple = 0;
+	entry->nvec_used = 1;
+	if (control & PCI_MSI_FLAGS_64BIT)
+		entry->mask_pos = dev->msi_cap + PCI_MSI_MASK_64;
+	else
+		entry->mask_pos = dev->msi_cap + PCI_MSI_MASK_32;
+
+	/* All MSIs are unmasked by default, mask them all */
+	if (entry->msi_attrib.maskbit)
+		pci_read_config_dword(dev, entry->mask_pos, &entry->masked);
+	msi_mask_irq(entry, ~0, ~0);
+
+	list_add_tail(&entry->list, &dev->msi_list);
+
+	ret = pci_msi_setup_irqs(dev);
+	if (ret) {
+		msi_mask_irq(entry, ~0, 0);
+		free_msi_irqs(dev);
+		return ret;
+	}
+
+	msi_mask_irq(entry, ~0, 0);
+	pci_intx_for_msi(dev, 0);
+	msi_set_enable(dev, 1);
+	dev->msi_enabled = 1;
+
+	dev->irq = entry->irq;
+
+	return 0;
+}
+
+/**
+ * pci_enable_msi_range - configure device's MSI capability structure
+ * @dev: device to configure
+ * @minvec: minimal number of interrupts to configure
+ * @maxvec: maximum number of interrupts to configure
+ *
+ * Returns number of vectors allocated (always one) or a negative
+ * errno. On success dev->irq is the host IRQ of the MSI vector.
+ */
+int pci_enable_msi_range(struct pci_dev *dev, int minvec, int maxvec)
+{
+	int rc, nvec;
+
+	if (dev->msi_enabled)
+		return -EINVAL;
+	if (maxvec < minvec)
+		return -ERANGE;
+	if (!dev->msi_cap || (1 < minvec))
+		return -EINVAL;
+	if (!pci_msi_supported(dev, maxvec))
+		return -EINVAL;
+
+	nvec = pci_msi_vec_count(dev);
+	if (nvec < 0)
+		return nvec;
+
+	/* Check whether driver already requested MSI-X irqs */
+	if (dev->msix_enabled) {
+		dev_info(&dev->dev, "can't enable MSI (MSI-X already enabled)\n");
+		return -EINVAL;
+	}
+
+	rc = msi_capability_init(dev);
+	if (rc)
+		return rc;
+
+	return 1;
+}
+EXPORT_SYMBOL(pci_enable_msi_range);
+
+void pci_msi_shutdown(struct pci_dev *dev)
+{
+	struct msi_desc *desc;
+
+	if (!pci_msi_enable || !dev || !dev->msi_enabled)
+		return;
+
+	BUG_ON(list_empty(&dev->msi_list));
+	desc = list_first_entry(&dev->msi_list, struct msi_desc, list);
+
+	msi_set_enable(dev, 0);
+	pci_intx_for_msi(dev, 1);
+	dev->msi_enabled = 0;
+
+	/* Return the device with MSI unmasked as initial state */
+	msi_mask_irq(desc, ~0, 0);
+
+	/* Restore dev->irq to its default pin-assertion irq */
+	dev->irq = desc->msi_attrib.default_irq;
+}
+
+void pci_disable_msi(struct pci_dev *dev)
+{
+	if (!pci_msi_enable || !dev || !dev->msi_enabled)
+		return;
+
+	pci_msi_shutdown(dev);
+	free_msi_irqs(dev);
+}
+EXPORT_SYMBOL(pci_disable_msi);
+
+/**
+ * pci_msix_vec_count - return the number of device's MSI-X table entries
+ * @dev: pointer to the pci_dev data structure of MSI-X device function
+ */
+int pci_msix_vec_count(struct pci_dev *dev)
+{
+	u16 control;
+
+	if (!dev->msix_cap)
+		return -EINVAL;
+
+	pci_read_config_word(dev, dev->msix_cap + PCI_MSIX_FLAGS, &control);
+
+	return msix_table_size(control);
+}
+EXPORT_SYMBOL(pci_msix_vec_count);
+
+static void __iomem *msix_map_region(struct pci_dev *dev, unsigned nr_entries)
+{
+	u8 bir;
+	u32 table_offset;
+	resource_size_t phys_addr;
+
+	pci_read_config_dword(dev, dev->msix_cap + PCI_MSIX_TABLE,
+			      &table_offset);
+	bir = (u8)(table_offset & PCI_MSIX_TABLE_BIR);
+	table_offset &= PCI_MSIX_TABLE_OFFSET;
+	phys_addr = pci_resource_start(dev, bir) + table_offset;
+	if (!pci_resource_start(dev, bir))
+		return NULL;
+
+	return ioremap_nocache(phys_addr, nr_entries * PCI_MSIX_ENTRY_SIZE);
+}
+
+static int msix_capability_init(struct pci_dev *dev,
+				struct msix_entry *entries, int nvec)
+{
+	int ret, i;
+	u16 control;
+	void __iomem *base;
+	struct msi_desc *entry;
+
+	/* Ensure MSI-X is disabled while it is set up */
+	msix_clear_and_set_ctrl(dev, PCI_MSIX_FLAGS_ENABLE, 0);
+
+	pci_read_config_word(dev, dev->msix_cap + PCI_MSIX_FLAGS, &control);
+	base = msix_map_region(dev, msix_table_size(control));
+	if (!base)
+		return -ENOMEM;
+
+	for (i = 0; i < nvec; i++) {
+		entry = alloc_msi_entry(dev);
+		if (!entry) {
+			if (!i)
+				iounmap(base);
+			else
+				free_msi_irqs(dev);
+			return -ENOMEM;
+		}
+
+		entry->msi_attrib.is_msix = 1;
+		entry->msi_attrib.is_64 = 1;
+		entry->msi_attrib.entry_nr = entries[i].entry;
+		entry->msi_attrib.default_irq = dev->irq;
+		entry->mask_base = base;
+		entry->nvec_used = 1;
+
+		list_add_tail(&entry->list, &dev->msi_list);
+	}
+
+	/*
+	 * Some devices require MSI-X to be enabled before we can touch the
+	 * MSI-X registers. We need to mask all the vectors to prevent
+	 * interrupts coming in before they're fully set up.
+	 */
+	msix_clear_and_set_ctrl(dev, 0,
+				PCI_MSIX_FLAGS_MASKALL | PCI_MSIX_FLAGS_ENABLE);
+
+	ret = pci_msi_setup_irqs(dev);
+	if (ret)
+		goto out_free;
+
+	i = 0;
+	list_for_each_entry(entry, &dev->msi_list, list) {
+		entries[i].vector = entry->irq;
+		entry->masked = readl(msix_entry_base(entry) +
+				      PCI_MSIX_ENTRY_VECTOR_CTRL);
+		msix_mask_irq(entry, 0);
+		i++;
+	}
+
+	/* Set MSI-X enabled bits and unmask the function */
+	pci_intx_for_msi(dev, 0);
+	dev->msix_enabled = 1;
+
+	msix_clear_and_set_ctrl(dev, PCI_MSIX_FLAGS_MASKALL, 0);
+
+	return 0;
+
+out_free:
+	msix_clear_and_set_ctrl(dev, PCI_MSIX_FLAGS_ENABLE, 0);
+	free_msi_irqs(dev);
+
+	return ret;
+}
+
+/**
+ * pci_enable_msix - configure device's MSI-X capability structure
+ * @dev: pointer to the pci_dev data structure of MSI-X device function
+ * @entries: pointer to an array of MSI-X entries
+ * @nvec: number of MSI-X irqs requested for allocation by device driver
+ *
+ * Returns 0 on success and host IRQ of each entry is returned in its
+ * vector field. Returns a positive value (number of available table
+ * entries) if fewer entries are available or a negative errno.
+ */
+int pci_enable_msix(struct pci_dev *dev, struct msix_entry *entries, int nvec)
+{
+	int nr_entries;
+	int i, j;
+
+	if (!entries || !dev->msix_cap)
+		return -EINVAL;
+	if (!pci_msi_supported(dev, nvec))
+		return -EINVAL;
+
+	nr_entries = pci_msix_vec_count(dev);
+	if (nr_entries < 0)
+		return nr_entries;
+	if (nvec > nr_entries)
+		return nr_entries;
+
+	/* Check for any invalid entries */
+	for (i = 0; i < nvec; i++) {
+		if (entries[i].entry >= nr_entries)
+			return -EINVAL;		/* invalid entry */
+		for (j = i + 1; j < nvec; j++) {
+			if (entries[i].entry == entries[j].entry)
+				return -EINVAL;	/* duplicate entry */
+		}
+	}
+
+	/* Check whether driver already requested for MSI irq */
+	if (dev->msi_enabled) {
+		dev_info(&dev->dev, "can't enable MSI-X (MSI IRQ already assigned)\n");
+		return -EINVAL;
+	}
+
+	return msix_capability_init(dev, entries, nvec);
+}
+EXPORT_SYMBOL(pci_enable_msix);
+
+/**
+ * pci_enable_msix_range - configure device's MSI-X capability structure
+ * @dev: pointer to the pci_dev data structure of MSI-X device function
+ * @entries: pointer to an array of MSI-X entries
+ * @minvec: minimum number of MSI-X irqs requested
+ * @maxvec: maximum number of MSI-X irqs requested
+ *
+ * Returns number of vectors allocated or a negative errno.
+ */
+int pci_enable_msix_range(struct pci_dev *dev, struct msix_entry *entries,
+			  int minvec, int maxvec)
+{
+	int rc, nvec = maxvec;
+
+	if (maxvec < minvec)
+		return -ERANGE;
+
+	do {
+		rc = pci_enable_msix(dev, entries, nvec);
+		if (rc < 0) {
+			return rc;
+		} else if (rc > 0) {
+			if (rc < minvec)
+				return -ENOSPC;
+			nvec = rc;
+		}
+	} while (rc);
+
+	return nvec;
+}
+EXPORT_SYMBOL(pci_enable_msix_range);
+
+void pci_msix_shutdown(struct pci_dev *dev)
+{
+	struct msi_desc *entry;
+
+	if (!pci_msi_enable || !dev || !dev->msix_enabled)
+		return;
+
+	/* Return the device with MSI-X masked as initial states */
+	list_for_each_entry(entry, &dev->msi_list, list) {
+		msix_mask_irq(entry, 1);
+	}
+
+	msix_clear_and_set_ctrl(dev, PCI_MSIX_FLAGS_ENABLE, 0);
+	pci_intx_for_msi(dev, 1);
+	dev->msix_enabled = 0;
+}
+
+void pci_disable_msix(struct pci_dev *dev)
+{
+	if (!pci_msi_enable || !dev || !dev->msix_enabled)
+		return;
+
+	pci_msix_shutdown(dev);
+	free_msi_irqs(dev);
+}
+EXPORT_SYMBOL(pci_disable_msix);
+
+void pci_restore_msi_state(struct pci_dev *dev)
+{
+	struct msi_desc *entry;
+
+	if (dev->msi_enabled) {
+		entry = list_first_entry(&dev->msi_list,
+					 struct msi_desc, list);
+		pci_intx_for_msi(dev, 0);
+		msi_set_enable(dev, 0);
+		pci_write_msi_msg(entry, &entry->msg);
+		msi_mask_irq(entry, ~0, entry->masked);
+		msi_set_enable(dev, 1);
+	}
+
+	if (dev->msix_enabled) {
+		pci_intx_for_msi(dev, 0);
+		msix_clear_and_set_ctrl(dev, 0,
+				PCI_MSIX_FLAGS_ENABLE | PCI_MSIX_FLAGS_MASKALL);
+		list_for_each_entry(entry, &dev->msi_list, list) {
+			pci_write_msi_msg(entry, &entry->msg);
+			msix_mask_irq(entry, entry->masked);
+		}
+		msix_clear_and_set_ctrl(dev, PCI_MSIX_FLAGS_MASKALL, 0);
+	}
+}
+EXPORT_SYMBOL_GPL(pci_restore_msi_state);
+#endif /* CONFIG_PCI_MSI */
@@ -41,6 +41,10 @@
 #define	MODULE_INIT			uart_8250_driver_init
 #define	MODULE_EXIT			uart_8250_driver_exit
 
+#define UART_8250_RX_BURST		32
+#define UART_8250_TX_FIFO_SIZE		4096
+#define UART_8250_MAX_FIFO_SIZE		64
+
 static u8 uart_8250_in(struct uart_8250_port *port, u32 offset)
 {
 	u8 ret;
@@ -150,6 +154,62 @@ void uart_8250_lowlevel_init(struct uart_8250_port *port)
 	uart_8250_out(port, UART_IER_OFFSET, 0x00);
 }
 
+/* Must be called with port lock held */
+static void uart_8250_tx_chars(struct uart_8250_port *port)
+{
+	u32 i, count;
+	u8 buf[UART_8250_MAX_FIFO_SIZE];
+
+	/* THRE is set only when Tx FIFO is completely empty */
+	if (!(uart_8250_in(port, UART_LSR_OFFSET) & UART_LSR_THRE)) {
+		return;
+	}
+
+	count = serial_tx_fetch(port->p, buf, port->fifo_size);
+	for (i = 0; i < count; i++) {
+		uart_8250_out(port, UART_THR_OFFSET, buf[i]);
+	}
+
+	/* Tx interrupt is required only till Tx data is pending */
+	if (count) {
+		port->ier |= UART_IER_THRI;
+	} else {
+		port->ier &= ~UART_IER_THRI;
+	}
+	uart_8250_out(port, UART_IER_OFFSET, port->ier);
+}
+
+static void uart_8250_tx_start(struct serial *p)
+{
+	irq_flags_t flags;
+	struct uart_8250_port *port = serial_tx_priv(p);
+
+	vmm_spin_lock_irqsave_lite(&port->lock, flags);
+	if (!(port->ier & UART_IER_THRI)) {
+		uart_8250_tx_chars(port);
+	}
+	vmm_spin_unlock_irqrestore_lite(&port->lock, flags);
+}
+
+static void uart_8250_rx_chars(struct uart_8250_port *port, u16 lsr)
+{
+	u32 count = 0;
+	u8 buf[UART_8250_RX_BURST];
+
+	while (lsr & (UART_LSR_DR | UART_LSR_OE)) {
+		buf[count++] = uart_8250_in(port, UART_RBR_OFFSET);
+		if (count == UART_8250_RX_BURST) {
+			serial_rx(port->p, buf, count);
+			count = 0;
+		}
+		lsr = uart_8250_in(port, UART_LSR_OFFSET);
+	}
+
+	if (count) {
+		serial_rx(port->p, buf, count);
+	}
+}
+
 static vmm_irq_return_t uart_8250_irq_handler(int irq_no, void *dev)
 {
 	u16 iir, lsr;
@@ -169,16 +229,18 @@ static vmm_irq_return_t uart_8250_irq_handler(int irq_no, void *dev)
 			uart_8250_clear_errors(port);
 		}
 		if (lsr & UART_LSR_DR) {
-			do {
-				u8 ch = uart_8250_in(port, UART_RBR_OFFSET);
-				serial_rx(port->p, &ch, 1);
-			} while (uart_8250_in(port, UART_LSR_OFFSET) &
-					      (UART_LSR_DR | UART_LSR_OE));
+			uart_8250_rx_chars(port, lsr);
 		} else {
 			while (1);
 		}
 		break;
 
+	case UART_IIR_THRI:
+		vmm_spin_lock_lite(&port->lock);
+		uart_8250_tx_chars(port);
+		vmm_spin_unlock_lite(&port->lock);
+		break;
+
 	case UART_IIR_BUSY:
 		/* This is unallocated IIR value as per generic UART but is
 		 * used by Designware UARTs, we do not expect other UART IPs
@@ -222,6 +284,7 @@ static int uart_8250_driver_probe(struct vmm_device *dev,
 		rc = VMM_ENOMEM;
 		goto free_nothing;
 	}
+	INIT_SPIN_LOCK(&port->lock);
 
 	if (vmm_devtree_read_string(dev->of_node,
 				    VMM_DEVTREE_ADDRESS_TYPE_ATTR_NAME,
@@ -263,6 +326,17 @@ static int uart_8250_driver_probe(struct vmm_device *dev,
 		port->baudrate = 115200;
 	}
 
+	/* UARTs without FIFO are described with fifo-size = <1> */
+	if (vmm_devtree_read_u32(dev->of_node, "fifo-size",
+				 &port->fifo_size)) {
+		port->fifo_size = (devid->data) ? (u32)(long)devid->data : 1;
+	}
+	if (!port->fifo_size) {
+		port->fifo_size = 1;
+	} else if (UART_8250_MAX_FIFO_SIZE < port->fifo_size) {
+		port->fifo_size = UART_8250_MAX_FIFO_SIZE;
+	}
+
 	rc = vmm_devtree_clock_frequency(dev->of_node, &port->input_clock);
 	if (rc) {
 		goto free_reg;
@@ -274,6 +348,15 @@ static int uart_8250_driver_probe(struct vmm_device *dev,
 	 */
 	uart_8250_lowlevel_init(port);
 
+	/* Raise RX interrupt when RX FIFO has 8 bytes (RX timeout
+	 * interrupt takes care of remaining bytes)
+	 */
+	if (16 <= port->fifo_size) {
+		uart_8250_out(port, UART_FCR_OFFSET,
+			      UART_FCR_ENABLE_FIFO | UART_FCR_CLEAR_RCVR |
+			      UART_FCR_CLEAR_XMIT | UART_FCR_R_TRIG_10);
+	}
+
 	/* Setup interrupt handler */
 	port->irq = vmm_devtree_irq_parse_map(dev->of_node, 0);
 	if (!port->irq) {
@@ -292,6 +375,13 @@ static int uart_8250_driver_probe(struct vmm_device *dev,
 		goto free_irq;
 	}
 
+	/* Use interrupt driven Tx */
+	rc = serial_enable_tx_fifo(port->p, UART_8250_TX_FIFO_SIZE,
+				   uart_8250_tx_start);
+	if (rc) {
+		goto free_serial;
+	}
+
 	/* Save port pointer */
 	dev->priv = port;
 
@@ -301,6 +391,8 @@ static int uart_8250_driver_probe(struct vmm_device *dev,
 
 	return VMM_OK;
 
+free_serial:
+	serial_destroy(port->p);
 free_irq:
 	vmm_host_irq_unregister(port->irq, port);
 free_reg:
@@ -321,8 +413,8 @@ static int uart_8250_driver_remove(struct vmm_device *dev)
 		return VMM_OK;
 	}
 
-	/* Mask Rx interrupt */
-	port->ier &= ~(UART_IER_RLSI | UART_IER_RDI);
+	/* Mask Rx and Tx interrupts */
+	port->ier &= ~(UART_IER_RLSI | UART_IER_RDI | UART_IER_THRI);
 	uart_8250_out(port, UART_IER_OFFSET, port->ier);
 
 	/* Free-up resources */
@@ -338,13 +430,13 @@ static int uart_8250_driver_remove(struct vmm_device *dev)
 }
 
 static struct vmm_devtree_nodeid uart_8250_devid_table[] = {
-	{ .compatible = "ns8250" },
-	{ .compatible = "ns16450" },
-	{ .compatible = "ns16550a" },
-	{ .compatible = "ns16550" },
-	{ .compatible = "ns16750" },
-	{ .compatible = "ns16850" },
-	{ .compatible = "snps,dw-apb-uart" },
+	{ .compatible = "ns8250", .data = (void *)1 },
+	{ .compatible = "ns16450", .data = (void *)1 },
+	{ .compatible = "ns16550a", .data = (void *)16 },
+	{ .compatible = "ns16550", .data = (void *)1 },
+	{ .compatible = "ns16750", .data = (void *)16 },
+	{ .compatible = "ns16850", .data = (void *)16 },
+	{ .compatible = "snps,dw-apb-uart", .data = (void *)16 },
 	{ /* end of list */ },
 };
 
@@ -40,6 +40,14 @@
 #define	MODULE_INIT			pl011_driver_init
 #define	MODULE_EXIT			pl011_driver_exit
 
+/* PL011 FIFOs are atleast 16 bytes deep and the Tx interrupt is
+ * raised when Tx FIFO is atmost half full so a Tx burst of 8 bytes
+ * always fits in Tx FIFO.
+ */
+#define PL011_TX_BURST			8
+#define PL011_RX_BURST			32
+#define PL011_TX_FIFO_SIZE		4096
+
 bool pl011_lowlevel_can_getc(virtual_addr_t base)
 {
 	if (vmm_in_8((void *)(base + UART_PL011_FR)) & UART_PL011_FR_RXFE) {
@@ -135,30 +143,82 @@ struct pl011_port {
 	u32 baudrate;
 	u32 input_clock;
 	u32 irq;
+	vmm_spinlock_t lock;
 	u16 mask;
 };
 
+/* Must be called with port lock held */
+static void pl011_tx_chars(struct pl011_port *port)
+{
+	u32 i, count;
+	u8 buf[PL011_TX_BURST];
+
+	count = serial_tx_fetch(port->p, buf, PL011_TX_BURST);
+	for (i = 0; i < count; i++) {
+		pl011_lowlevel_putc(port->base, buf[i]);
+	}
+
+	/* Tx interrupt is required only till Tx data is pending */
+	if (count) {
+		port->mask |= UART_PL011_IMSC_TXIM;
+	} else {
+		port->mask &= ~UART_PL011_IMSC_TXIM;
+	}
+	vmm_out_le16((void *)(port->base + UART_PL011_IMSC), port->mask);
+}
+
+static void pl011_tx_start(struct serial *p)
+{
+	irq_flags_t flags;
+	struct pl011_port *port = serial_tx_priv(p);
+
+	vmm_spin_lock_irqsave_lite(&port->lock, flags);
+
+	/* Tx interrupt is raised only when Tx FIFO level drops
+	 * below threshold so prime Tx FIFO if Tx is idle.
+	 */
+	if (!(port->mask & UART_PL011_IMSC_TXIM)) {
+		pl011_tx_chars(port);
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&port->lock, flags);
+}
+
 static vmm_irq_return_t pl011_irq_handler(int irq_no, void *dev)
 {
-	u8 ch;
+	u32 count;
 	u16 data;
+	u8 buf[PL011_RX_BURST];
 	struct pl011_port *port = (struct pl011_port *)dev;
 
 	/* Get masked interrupt status */
 	data = vmm_in_le16((void *)(port->base + UART_PL011_MIS));
 
-	/* Handle RX FIFO not empty */
+	/* Handle RX FIFO level or RX timeout */
 	if (data & (UART_PL011_MIS_RXMIS | UART_PL011_MIS_RTMIS)) {
-		/* Pull-out bytes from RX FIFO */
-		while (pl011_lowlevel_can_getc(port->base)) {
-			ch = pl011_lowlevel_getc(port->base);
-			serial_rx(port->p, &ch, 1);
-		}
+		/* Pull-out bytes from RX FIFO in bursts */
+		do {
+			count = 0;
+			while ((count < PL011_RX_BURST) &&
+			       pl011_lowlevel_can_getc(port->base)) {
+				buf[count++] = pl011_lowlevel_getc(port->base);
+			}
+			if (count) {
+				serial_rx(port->p, buf, count);
+			}
+		} while (count == PL011_RX_BURST);
 	}
 
 	/* Clear all interrupts */
 	vmm_out_le16((void *)(port->base + UART_PL011_ICR), data);
 
+	/* Handle TX FIFO level */
+	if (data & UART_PL011_MIS_TXMIS) {
+		vmm_spin_lock_lite(&port->lock);
+		pl011_tx_chars(port);
+		vmm_spin_unlock_lite(&port->lock);
+	}
+
 	return VMM_IRQ_HANDLED;
 }
 
@@ -188,6 +248,7 @@ static int pl011_driver_probe(struct vmm_device *dev,
 		rc = VMM_ENOMEM;
 		goto free_nothing;
 	}
+	INIT_SPIN_LOCK(&port->lock);
 
 	rc = vmm_devtree_request_regmap(dev->of_node, &port->base, 0,
 					"PL011 UART");
@@ -218,6 +279,14 @@ static int pl011_driver_probe(struct vmm_device *dev,
 	/* Call low-level init function */
 	pl011_lowlevel_init(port->base, port->baudrate, port->input_clock);
 
+	/* Raise RX interrupt when RX FIFO is 1/2 full (RX timeout
+	 * interrupt takes care of remaining bytes) and TX interrupt
+	 * when TX FIFO is 1/2 empty.
+	 */
+	vmm_out_8((void *)(port->base + UART_PL011_IFLS),
+		  (2 << UART_PL011_IFLS_RXIFL_SHIFT) |
+		  (2 << UART_PL011_IFLS_TXIFL_SHIFT));
+
 	/* Create Serial Port */
 	port->p = serial_create(dev, 256, pl011_tx, port);
 	if (VMM_IS_ERR_OR_NULL(port->p)) {
@@ -225,6 +294,13 @@ static int pl011_driver_probe(struct vmm_device *dev,
 		goto free_irq;
 	}
 
+	/* Use interrupt driven Tx */
+	rc = serial_enable_tx_fifo(port->p, PL011_TX_FIFO_SIZE,
+				   pl011_tx_start);
+	if (rc) {
+		goto free_serial;
+	}
+
 	/* Save port pointer */
 	dev->priv = port;
 
@@ -234,6 +310,8 @@ static int pl011_driver_probe(struct vmm_device *dev,
 
 	return VMM_OK;
 
+free_serial:
+	serial_destroy(port->p);
 free_irq:
 	vmm_host_irq_unregister(port->irq, port);
 free_reg:
@@ -252,8 +330,9 @@ static int pl011_driver_remove(struct vmm_device *dev)
 		return VMM_OK;
 	}
 
-	/* Mask RX interrupts */
-	port->mask &= ~(UART_PL011_IMSC_RXIM | UART_PL011_IMSC_RTIM);
+	/* Mask RX and TX interrupts */
+	port->mask &= ~(UART_PL011_IMSC_RXIM | UART_PL011_IMSC_RTIM |
+			UART_PL011_IMSC_TXIM);
 	vmm_out_le16((void *)(port->base + UART_PL011_IMSC), port->mask);
 
 	/* Free-up resources */
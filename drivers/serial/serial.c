@@ -48,18 +48,10 @@ static u32 serial_read(struct vmm_chardev *cdev,
 	}
 	p = cdev->priv;
 
-	if (sleep) {
-		for (i = 0; i < len; i++) {
-			while (!fifo_dequeue(p->rx_fifo, &dest[i])) {
-				vmm_completion_wait(&p->rx_avail);
-			}
-		}
-	} else {
-		for (i = 0; i < len; i++) {
-			if (!fifo_dequeue(p->rx_fifo, &dest[i])) {
-				break;
-			}
-		}
+	i = fifo_dequeue_multi(p->rx_fifo, dest, len);
+	while (sleep && (i < len)) {
+		vmm_completion_wait(&p->rx_avail);
+		i += fifo_dequeue_multi(p->rx_fifo, &dest[i], len - i);
 	}
 
 	return i;
@@ -77,27 +69,79 @@ static u32 serial_write(struct vmm_chardev *cdev,
 	}
 	p = cdev->priv;
 
-	vmm_spin_lock_irqsave_lite(&p->tx_lock, flags);
-	ret = p->tx_func(p, src, len);
-	vmm_spin_unlock_irqrestore_lite(&p->tx_lock, flags);
+	if (!p->tx_fifo) {
+		vmm_spin_lock_irqsave_lite(&p->tx_lock, flags);
+		ret = p->tx_func(p, src, len);
+		vmm_spin_unlock_irqrestore_lite(&p->tx_lock, flags);
+		return ret;
+	}
+
+	ret = 0;
+	while (1) {
+		ret += fifo_enqueue_multi(p->tx_fifo, &src[ret], len - ret);
+
+		vmm_spin_lock_irqsave_lite(&p->tx_lock, flags);
+		p->tx_start(p);
+		vmm_spin_unlock_irqrestore_lite(&p->tx_lock, flags);
+
+		if (!sleep || (ret >= len)) {
+			break;
+		}
+		vmm_completion_wait(&p->tx_space);
+	}
 
 	return ret;
 }
 
 void serial_rx(struct serial *p, u8 *data, u32 len)
 {
-	u32 i;
-
 	if (!p || !data || !len) {
 		return;
 	}
 
-	for (i = 0; i < len; i++) {
-		fifo_enqueue(p->rx_fifo, &data[i], FALSE);
-	}
+	fifo_enqueue_multi(p->rx_fifo, data, len);
 
 	vmm_completion_complete(&p->rx_avail);
 }
+VMM_EXPORT_SYMBOL(serial_rx);
+
+u32 serial_tx_fetch(struct serial *p, u8 *dst, u32 len)
+{
+	u32 ret;
+
+	if (!p || !p->tx_fifo || !dst || !len) {
+		return 0;
+	}
+
+	ret = fifo_dequeue_multi(p->tx_fifo, dst, len);
+	if (ret) {
+		vmm_completion_complete(&p->tx_space);
+	}
+
+	return ret;
+}
+VMM_EXPORT_SYMBOL(serial_tx_fetch);
+
+int serial_enable_tx_fifo(struct serial *p, u32 tx_fifo_size,
+			  void (*tx_start)(struct serial *p))
+{
+	if (!p || !tx_fifo_size || !tx_start) {
+		return VMM_EINVALID;
+	}
+	if (p->tx_fifo) {
+		return VMM_EEXIST;
+	}
+
+	INIT_COMPLETION(&p->tx_space);
+	p->tx_start = tx_start;
+	p->tx_fifo = fifo_alloc(1, tx_fifo_size);
+	if (!p->tx_fifo) {
+		return VMM_ENOMEM;
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(serial_enable_tx_fifo);
 
 struct serial *serial_create(struct vmm_device *dev,
 			     u32 rx_fifo_size,
@@ -185,8 +229,11 @@ void serial_destroy(struct serial *p)
 	/* Unregister character device */
 	vmm_chardev_unregister(&p->cdev);
 
-	/* Free Rx FIFO */
+	/* Free Rx FIFO and Tx FIFO */
 	fifo_free(p->rx_fifo);
+	if (p->tx_fifo) {
+		fifo_free(p->tx_fifo);
+	}
 
 	/* Free Serial Port */
 	vmm_free(p);
@@ -25,6 +25,8 @@
 #include <vmm_cache.h>
 #include <vmm_delay.h>
 #include <vmm_heap.h>
+#include <vmm_mutex.h>
+#include <vmm_completion.h>
 #include <vmm_spinlocks.h>
 #include <vmm_host_io.h>
 #include <vmm_modules.h>
@@ -44,9 +46,19 @@
 #define	MODULE_EXIT			usb_storage_exit
 
 #define US_MAX_PENDING		128
-#define US_BLKS_PER_XFER	16
+#define US_BLKS_PER_XFER	256
 #define US_MAX_LUNS		4
 
+/*
+ * DATA phase of a bulk-only command is split into URBs of
+ * US_DATA_URB_SIZE bytes. All URBs of a command (CBW, DATA and CSW)
+ * are queued together so the host controller moves from one phase
+ * to the next without waiting for us.
+ */
+#define US_DATA_URB_SIZE	(32 * 1024)
+#define US_MAX_DATA_URBS	32
+#define US_MAX_URBS		(US_MAX_DATA_URBS + 2)
+
 #define US_MAX_DISKS		32
 
 /* Sub STORAGE Classes */
@@ -120,6 +132,13 @@ struct usb_storage {
 
 	u32 CBWTag;
 
+	/* Bulk-only transport state (protected by xfer_lock) */
+	struct vmm_mutex xfer_lock;
+	struct vmm_completion xfer_done;
+	struct urb *urbs[US_MAX_URBS];
+	struct usb_storage_bbb_cbw __cacheline_aligned cbw;
+	struct usb_storage_bbb_csw __cacheline_aligned csw;
+
 	u32 luns_count;
 	struct usb_storate_lun luns[US_MAX_LUNS];
 };
@@ -214,34 +233,21 @@ static int usb_storage_BBB_reset(struct scsi_transport *tr, void *priv)
  * Set up the command for a BBB device. Note that the actual SCSI
  * command is copied into cbw.CBWCDB.
  */
-static int usb_storage_BBB_comdat(struct scsi_request *srb,
-				  struct usb_storage *us)
+static void usb_storage_BBB_comdat(struct scsi_request *srb,
+				   struct usb_storage *us)
 {
-	int actlen;
-	unsigned int pipe;
-	struct usb_storage_bbb_cbw __cacheline_aligned cbw;
+	struct usb_storage_bbb_cbw *cbw = &us->cbw;
 
-	/* sanity checks */
-	if (srb->cmdlen > CBWCDBLENGTH) {
-		return VMM_EINVALID;
-	}
-
-	/* always OUT to the ep */
-	pipe = usb_sndbulkpipe(us->dev, us->ep_out);
-
-	cbw.dCBWSignature = vmm_cpu_to_le32(CBWSIGNATURE);
-	cbw.dCBWTag = vmm_cpu_to_le32(us->CBWTag++);
-	cbw.dCBWDataTransferLength = vmm_cpu_to_le32(srb->datalen);
-	cbw.bCBWFlags = SCSI_CMD_DIRECTION(srb->cmd[0]) ?
+	cbw->dCBWSignature = vmm_cpu_to_le32(CBWSIGNATURE);
+	cbw->dCBWTag = vmm_cpu_to_le32(us->CBWTag++);
+	cbw->dCBWDataTransferLength = vmm_cpu_to_le32(srb->datalen);
+	cbw->bCBWFlags = SCSI_CMD_DIRECTION(srb->cmd[0]) ?
 					CBWFLAGS_IN : CBWFLAGS_OUT;
-	cbw.bCBWLUN = srb->lun;
-	cbw.bCDBLength = srb->cmdlen;
+	cbw->bCBWLUN = srb->lun;
+	cbw->bCDBLength = srb->cmdlen;
 	/* copy the command data into the CBW command data buffer */
 	/* DST SRC LEN!!! */
-	memcpy(cbw.CBWCDB, srb->cmd, srb->cmdlen);
-
-	return usb_bulk_msg(us->dev, pipe, &cbw, UMASS_BBB_CBW_SIZE,
-			    &actlen, USB_CNTL_TIMEOUT * 5);
+	memcpy(cbw->CBWCDB, srb->cmd, srb->cmdlen);
 }
 
 /* clear a stall on an endpoint - special for BBB devices */
@@ -254,94 +260,181 @@ static int usb_storage_BBB_clear_endpt_stall(struct usb_storage *us, u8 endpt)
 			       USB_CNTL_TIMEOUT * 5);
 }
 
+static void usb_storage_BBB_urb_complete(struct urb *u)
+{
+	struct usb_storage *us = u->context;
+
+	vmm_completion_complete(&us->xfer_done);
+}
+
+/*
+ * Submit first nurbs URBs back-to-back and wait for all of them.
+ * The HCD either rejects an URB at submit time or gives it back
+ * exactly once so after a timeout we still drain the remaining
+ * completions before the URBs (and buffers) can be reused.
+ */
+static int usb_storage_BBB_pipeline(struct usb_storage *us, u32 nurbs)
+{
+	int rc = VMM_OK;
+	u32 i, submitted;
+	u64 tout = USB_CNTL_TIMEOUT * 5 * 1000000ULL;
+
+	for (submitted = 0; submitted < nurbs; submitted++) {
+		rc = usb_submit_urb(us->urbs[submitted]);
+		if (rc) {
+			break;
+		}
+	}
+
+	for (i = 0; i < submitted; i++) {
+		if (!rc) {
+			rc = vmm_completion_wait_timeout(&us->xfer_done, &tout);
+			if (!rc) {
+				continue;
+			}
+		}
+		vmm_completion_wait(&us->xfer_done);
+	}
+
+	return rc;
+}
+
 static int usb_storage_BBB_transport(struct scsi_request *srb,
 				     struct scsi_transport *tr, void *priv)
 {
-	int rc, retry;
-	int actlen, data_actlen;
+	int rc;
+	u32 i, ndata, data_actlen, len;
 	unsigned int ep, pipe;
+	struct urb *u, *csw_urb;
 	struct usb_storage *us = priv;
-	struct usb_storage_bbb_csw __cacheline_aligned csw;
+	struct usb_storage_bbb_csw *csw = &us->csw;
 
-	/* COMMAND phase */
-	rc = usb_storage_BBB_comdat(srb, us);
-	if (rc < 0) {
-		usb_storage_BBB_reset(tr, us);
-		return rc;
+	/* sanity checks */
+	if (srb->cmdlen > CBWCDBLENGTH) {
+		return VMM_EINVALID;
+	}
+	ndata = (srb->datalen + US_DATA_URB_SIZE - 1) / US_DATA_URB_SIZE;
+	if (ndata > US_MAX_DATA_URBS) {
+		return VMM_EINVALID;
 	}
 
-	/* Wait here for data to be ready */
-	vmm_msleep(10);
+	vmm_mutex_lock(&us->xfer_lock);
 
-	/* DATA phase + error handling */
-	data_actlen = 0;
-	/* no data, go immediately to the STATUS phase */
-	if (srb->datalen == 0)
-		goto st;
+	/* COMMAND phase (always OUT to the ep) */
+	usb_storage_BBB_comdat(srb, us);
+	usb_fill_bulk_urb(us->urbs[0], us->dev,
+			  usb_sndbulkpipe(us->dev, us->ep_out),
+			  &us->cbw, UMASS_BBB_CBW_SIZE,
+			  usb_storage_BBB_urb_complete, us);
+
+	/* DATA phase */
 	pipe = SCSI_CMD_DIRECTION(srb->cmd[0]) ?
 				usb_rcvbulkpipe(us->dev, us->ep_in) :
 				usb_sndbulkpipe(us->dev, us->ep_out);
 	ep = SCSI_CMD_DIRECTION(srb->cmd[0]) ? us->ep_in : us->ep_out;
-	rc = usb_bulk_msg(us->dev, pipe, srb->data, srb->datalen,
-			  &data_actlen, USB_CNTL_TIMEOUT * 5);
-	/* special handling of STALL in DATA phase */
-	if (rc < 0) {
-		/* clear the STALL on the endpoint */
-		rc = usb_storage_BBB_clear_endpt_stall(us, ep);
-		if (rc >= 0)
-			/* continue on to STATUS phase */
-			goto st;
+	for (i = 0; i < ndata; i++) {
+		len = srb->datalen - i * US_DATA_URB_SIZE;
+		if (len > US_DATA_URB_SIZE) {
+			len = US_DATA_URB_SIZE;
+		}
+		usb_fill_bulk_urb(us->urbs[1 + i], us->dev, pipe,
+				  srb->data + i * US_DATA_URB_SIZE, len,
+				  usb_storage_BBB_urb_complete, us);
 	}
-	if (rc < 0) {
+
+	/* STATUS phase */
+	csw_urb = us->urbs[1 + ndata];
+	usb_fill_bulk_urb(csw_urb, us->dev,
+			  usb_rcvbulkpipe(us->dev, us->ep_in),
+			  csw, UMASS_BBB_CSW_SIZE,
+			  usb_storage_BBB_urb_complete, us);
+
+	/* Queue all phases at once */
+	rc = usb_storage_BBB_pipeline(us, ndata + 2);
+	if (rc) {
 		usb_storage_BBB_reset(tr, us);
-		return rc;
+		goto done;
 	}
 
-	/* STATUS phase + error handling */
-st:
-	retry = 0;
-again:
-	rc = usb_bulk_msg(us->dev, usb_rcvbulkpipe(us->dev, us->ep_in),
-			  &csw, UMASS_BBB_CSW_SIZE,
-			  &actlen, USB_CNTL_TIMEOUT*5);
-	/* special handling of STALL in STATUS phase */
-	if ((rc < 0) && (retry < 1)) {
-		/* clear the STALL on the endpoint */
-		rc = usb_storage_BBB_clear_endpt_stall(us, us->ep_in);
-		if (rc >= 0 && (retry++ < 1))
-			/* do a retry */
-			goto again;
-	}
-	if (rc < 0) {
+	/* COMMAND phase error handling */
+	if (us->urbs[0]->status < 0) {
+		rc = us->urbs[0]->status;
 		usb_storage_BBB_reset(tr, us);
-		return rc;
+		goto done;
 	}
 
-	/* misuse pipe to get the residue */
-	pipe = vmm_le32_to_cpu(csw.dCSWDataResidue);
-	if ((pipe == 0) &&
-	    (srb->datalen != 0) &&
-	    (srb->datalen - data_actlen != 0))
-		pipe = srb->datalen - data_actlen;
-	if (CSWSIGNATURE != vmm_le32_to_cpu(csw.dCSWSignature)) {
+	/* DATA phase error handling */
+	data_actlen = 0;
+	for (i = 0; i < ndata; i++) {
+		u = us->urbs[1 + i];
+		if (u->status < 0) {
+			/* clear the STALL on the endpoint */
+			rc = usb_storage_BBB_clear_endpt_stall(us, ep);
+			if (rc < 0) {
+				usb_storage_BBB_reset(tr, us);
+				goto done;
+			}
+			/* continue on to STATUS phase */
+			break;
+		}
+		data_actlen += u->actual_length;
+		if (u->actual_length < u->transfer_buffer_length) {
+			/*
+			 * Short packet ends DATA phase early hence the
+			 * next IN URB (if any) has consumed the CSW.
+			 */
+			if (((i + 1) < ndata) && (ep == us->ep_in)) {
+				u = us->urbs[2 + i];
+				if ((u->status >= 0) &&
+				    (u->actual_length == UMASS_BBB_CSW_SIZE)) {
+					memcpy(csw, u->transfer_buffer,
+					       UMASS_BBB_CSW_SIZE);
+					csw_urb = u;
+				}
+			}
+			break;
+		}
+	}
+
+	/* STATUS phase error handling */
+	if (csw_urb->status < 0) {
+		/* clear the STALL on the endpoint and do a retry */
+		rc = usb_storage_BBB_clear_endpt_stall(us, us->ep_in);
+		if (rc >= 0) {
+			rc = usb_bulk_msg(us->dev,
+					  usb_rcvbulkpipe(us->dev, us->ep_in),
+					  csw, UMASS_BBB_CSW_SIZE,
+					  NULL, USB_CNTL_TIMEOUT * 5);
+		}
+		if (rc < 0) {
+			usb_storage_BBB_reset(tr, us);
+			goto done;
+		}
+	}
+
+	rc = VMM_OK;
+	if (CSWSIGNATURE != vmm_le32_to_cpu(csw->dCSWSignature)) {
 		usb_storage_BBB_reset(tr, us);
-		return VMM_EIO;
-	} else if ((us->CBWTag - 1) != vmm_le32_to_cpu(csw.dCSWTag)) {
+		rc = VMM_EIO;
+	} else if ((us->CBWTag - 1) != vmm_le32_to_cpu(csw->dCSWTag)) {
 		usb_storage_BBB_reset(tr, us);
-		return VMM_EIO;
-	} else if (csw.bCSWStatus > CSWSTATUS_PHASE) {
+		rc = VMM_EIO;
+	} else if (csw->bCSWStatus > CSWSTATUS_PHASE) {
 		usb_storage_BBB_reset(tr, us);
-		return VMM_EIO;
-	} else if (csw.bCSWStatus == CSWSTATUS_PHASE) {
+		rc = VMM_EIO;
+	} else if (csw->bCSWStatus == CSWSTATUS_PHASE) {
 		usb_storage_BBB_reset(tr, us);
-		return VMM_EIO;
+		rc = VMM_EIO;
 	} else if (data_actlen > srb->datalen) {
-		return VMM_EIO;
-	} else if (csw.bCSWStatus == CSWSTATUS_FAILED) {
-		return VMM_EIO;
+		rc = VMM_EIO;
+	} else if (csw->bCSWStatus == CSWSTATUS_FAILED) {
+		rc = VMM_EIO;
 	}
 
-	return VMM_OK;
+done:
+	vmm_mutex_unlock(&us->xfer_lock);
+
+	return rc;
 }
 
 static void usb_storage_info_fixup(struct scsi_info *info,
@@ -413,6 +506,15 @@ static int usb_storage_probe(struct usb_interface *intf,
 	us->dev = dev;
 	us->intf = intf;
 	us->tr = tr;
+	INIT_MUTEX(&us->xfer_lock);
+	INIT_COMPLETION(&us->xfer_done);
+	for (i = 0; i < US_MAX_URBS; i++) {
+		us->urbs[i] = usb_alloc_urb();
+		if (!us->urbs[i]) {
+			rc = VMM_ENOMEM;
+			goto fail_free_urbs;
+		}
+	}
 
 	/*
 	 * We are expecting a minimum of 2 endpoints - in and out (bulk).
@@ -447,7 +549,7 @@ static int usb_storage_probe(struct usb_interface *intf,
 	if (!us->ep_in || !us->ep_out ||
 	    (intf->desc.bInterfaceProtocol == US_PR_CBI && !us->ep_int)) {
 		rc = VMM_ENODEV;
-		goto fail_free_device;
+		goto fail_free_urbs;
 	}
 
 	/* we had found an interrupt endpoint, prepare irq pipe
@@ -503,7 +605,10 @@ fail_free_disks:
 			us->luns[lun].disk = NULL;
 		}
 	}
-fail_free_device:
+fail_free_urbs:
+	for (i = 0; i < US_MAX_URBS; i++) {
+		usb_free_urb(us->urbs[i]);
+	}
 	usb_dref_device(us->dev);
 	vmm_free(us);
 fail:
@@ -512,7 +617,7 @@ fail:
 
 static void usb_storage_disconnect(struct usb_interface *intf)
 {
-	u32 lun;
+	u32 i, lun;
 	struct usb_storage *us = interface_get_data(intf);
 
 	/* Clear usb interface data */
@@ -527,7 +632,10 @@ static void usb_storage_disconnect(struct usb_interface *intf)
 		}
 	}
 
-	/* Free the USB device */
+	/* Free the URBs and USB device */
+	for (i = 0; i < US_MAX_URBS; i++) {
+		usb_free_urb(us->urbs[i]);
+	}
 	usb_dref_device(us->dev);
 
 	/* Free usb storage instance */
@@ -67,6 +67,9 @@
 #define DWC2_DATA_BUF_SIZE		(64 * 1024)
 #define DWC2_MAX_DEVICE			16
 #define DWC2_MAX_ENDPOINT		16
+#define DWC2_DESC_LIST_COUNT		64
+#define DWC2_DESC_LIST_SIZE		(DWC2_DESC_LIST_COUNT * \
+					 sizeof(struct dwc2_dma_desc))
 
 /**
  * Parameters for configuring the dwc2 driver
@@ -244,6 +247,13 @@ struct dwc2_control {
 	int bulk_data_toggle[DWC2_MAX_DEVICE][DWC2_MAX_ENDPOINT];
 	int control_data_toggle[DWC2_MAX_DEVICE][DWC2_MAX_ENDPOINT];
 
+	/* Descriptor DMA state (protected by urb_process_mutex) */
+	bool desc_dma;
+	struct dwc2_dma_desc *desc_list;
+	physical_addr_t desc_list_pa;
+	u32 desc_count;
+	u32 desc_xfer_len;
+
 	struct vmm_mutex urb_process_mutex;
 
 	vmm_spinlock_t urb_lock;
@@ -395,6 +405,10 @@ static void dwc2_core_host_init(struct dwc2_control *dwc2)
 		vmm_setbits_le32(&dwc2->regs->host_regs.hcfg,
 				 DWC2_HCFG_FSLSSUPP);
 	}
+	if (dwc2->desc_dma) {
+		vmm_setbits_le32(&dwc2->regs->host_regs.hcfg,
+				 DWC2_HCFG_DESCDMA);
+	}
 
 	/* Configure data FIFO sizes */
 	if (dwc2->params->enable_dynamic_fifo &&
@@ -642,6 +656,98 @@ static void dwc2_hc_init(struct dwc2_control *dwc2, u8 hc_num,
 	vmm_writel(0, &hc_regs->hcsplt);
 }
 
+/*
+ * Programs transfer size, PID and buffer of a host channel. In address
+ * DMA mode this is limited by max_transfer_size and max_packet_count
+ * whereas in descriptor DMA mode the whole transfer is described by a
+ * descriptor list so it completes with a single channel halt.
+ *
+ * For IN transfers in descriptor DMA mode each descriptor is rounded
+ * up to max packet size hence buffer must be large enough for that.
+ */
+static int dwc2_hc_setup_xfer(struct dwc2_control *dwc2,
+			      struct dwc2_hc_regs *hc_regs,
+			      void *buffer, u32 xfer_len, u32 num_packets,
+			      u32 max, int is_in, u32 pid)
+{
+	int rc;
+	u32 len, ntd, desc_max;
+	physical_addr_t pa;
+	struct dwc2_dma_desc *desc;
+
+	rc = vmm_host_va2pa((virtual_addr_t)buffer, &pa);
+	if (rc) {
+		vmm_printf("%s: VA2PA error!\n", __func__);
+		return rc;
+	}
+
+	if (!dwc2->desc_dma) {
+		vmm_writel((xfer_len << DWC2_HCTSIZ_XFERSIZE_OFFSET) |
+			   (num_packets << DWC2_HCTSIZ_PKTCNT_OFFSET) |
+			   (pid << DWC2_HCTSIZ_PID_OFFSET),
+			   &hc_regs->hctsiz);
+		vmm_writel((u32)pa, &hc_regs->hcdma);
+		return VMM_OK;
+	}
+
+	/* Only last descriptor of a transfer can be a short packet */
+	desc_max = udiv32(DWC2_HOST_DMA_NBYTES_LIMIT, max) * max;
+
+	ntd = 0;
+	dwc2->desc_xfer_len = 0;
+	do {
+		if (ntd == DWC2_DESC_LIST_COUNT) {
+			return VMM_EINVALID;
+		}
+		len = (xfer_len < desc_max) ? xfer_len : desc_max;
+		xfer_len -= len;
+		if (is_in) {
+			len = (len) ? udiv32(len + max - 1, max) * max : max;
+		}
+		desc = &dwc2->desc_list[ntd++];
+		desc->buf = (u32)pa;
+		desc->status = DWC2_HOST_DMA_A |
+			((len << DWC2_HOST_DMA_NBYTES_OFFSET) &
+			 DWC2_HOST_DMA_NBYTES_MASK);
+		dwc2->desc_xfer_len += len;
+		pa += len;
+	} while (xfer_len);
+	desc->status |= DWC2_HOST_DMA_IOC | DWC2_HOST_DMA_EOL;
+	dwc2->desc_count = ntd;
+
+	vmm_writel(((ntd - 1) << DWC2_HCTSIZ_NTD_OFFSET) |
+		   (pid << DWC2_HCTSIZ_PID_OFFSET),
+		   &hc_regs->hctsiz);
+	vmm_writel((u32)dwc2->desc_list_pa, &hc_regs->hcdma);
+
+	return VMM_OK;
+}
+
+/*
+ * Returns bytes transferred by last transfer of a host channel
+ * given the value of HCTSIZ register after channel halt.
+ */
+static u32 dwc2_hc_xfer_done(struct dwc2_control *dwc2,
+			     u32 hctsiz, u32 xfer_len)
+{
+	u32 i, rem = 0;
+
+	if (!dwc2->desc_dma) {
+		rem = hctsiz & DWC2_HCTSIZ_XFERSIZE_MASK;
+		rem >>= DWC2_HCTSIZ_XFERSIZE_OFFSET;
+		return xfer_len - rem;
+	}
+
+	/* Each descriptor is updated with its remaining byte count */
+	for (i = 0; i < dwc2->desc_count; i++) {
+		rem += (dwc2->desc_list[i].status &
+			DWC2_HOST_DMA_NBYTES_MASK) >>
+				DWC2_HOST_DMA_NBYTES_OFFSET;
+	}
+
+	return dwc2->desc_xfer_len - rem;
+}
+
 /*
  * DWC2 to USB API interface
  */
@@ -974,7 +1080,6 @@ static int dwc2_control_msg(struct dwc2_control *dwc2,
 	int ep = usb_pipeendpoint(u->pipe);
 	u32 hctsiz = 0, tmp, hcint;
 	unsigned int timeout = 1000000;
-	physical_addr_t pa;
 	u8 __cacheline_aligned status_buffer[DWC2_STATUS_BUF_SIZE];
 
 	/* Process root hub control messages differently */
@@ -1007,17 +1112,12 @@ static int dwc2_control_msg(struct dwc2_control *dwc2,
 		     usb_maxpacket(u->dev, u->pipe));
 
 	/* SETUP stage  */
-	vmm_writel((8 << DWC2_HCTSIZ_XFERSIZE_OFFSET) |
-	       (1 << DWC2_HCTSIZ_PKTCNT_OFFSET) |
-	       (DWC2_HC_PID_SETUP << DWC2_HCTSIZ_PID_OFFSET),
-	       &hc_regs->hctsiz);
-
-	rc = vmm_host_va2pa((virtual_addr_t)u->setup_packet, &pa);
+	rc = dwc2_hc_setup_xfer(dwc2, hc_regs, u->setup_packet, 8, 1,
+				usb_maxpacket(u->dev, u->pipe), 0,
+				DWC2_HC_PID_SETUP);
 	if (rc) {
-		vmm_printf("%s: VA2PA error!\n", __func__);
 		goto out;
 	}
-	vmm_writel((u32)pa, &hc_regs->hcdma);
 
 	/* Set host channel enable after all other setup is complete. */
 	vmm_clrsetbits_le32(&hc_regs->hcchar, DWC2_HCCHAR_MULTICNT_MASK |
@@ -1050,18 +1150,13 @@ static int dwc2_control_msg(struct dwc2_control *dwc2,
 
 		/* TODO: check if len < 64 */
 		dwc2->control_data_toggle[devnum][ep] = DWC2_HC_PID_DATA1;
-		vmm_writel((len << DWC2_HCTSIZ_XFERSIZE_OFFSET) |
-			   (1 << DWC2_HCTSIZ_PKTCNT_OFFSET) |
-			   (dwc2->control_data_toggle[devnum][ep] <<
-				DWC2_HCTSIZ_PID_OFFSET),
-			   &hc_regs->hctsiz);
-
-		rc = vmm_host_va2pa((virtual_addr_t)buffer, &pa);
+		rc = dwc2_hc_setup_xfer(dwc2, hc_regs, buffer, len, 1,
+					usb_maxpacket(u->dev, u->pipe),
+					usb_pipein(u->pipe),
+					dwc2->control_data_toggle[devnum][ep]);
 		if (rc) {
-			vmm_printf("%s: VA2PA error!\n", __func__);
 			goto out;
 		}
-		vmm_writel((u32)pa, &hc_regs->hcdma);
 
 		/* Set host channel enable after all other setup is complete */
 		vmm_clrsetbits_le32(&hc_regs->hcchar, DWC2_HCCHAR_MULTICNT_MASK |
@@ -1078,11 +1173,12 @@ static int dwc2_control_msg(struct dwc2_control *dwc2,
 				hctsiz = vmm_readl(&hc_regs->hctsiz);
 				done = len;
 
-				tmp = hctsiz & DWC2_HCTSIZ_XFERSIZE_MASK;
-				tmp >>= DWC2_HCTSIZ_XFERSIZE_OFFSET;
-
-				if (usb_pipein(u->pipe))
-					done -= tmp;
+				if (usb_pipein(u->pipe)) {
+					tmp = dwc2_hc_xfer_done(dwc2,
+								hctsiz, len);
+					if (tmp < len)
+						done = tmp;
+				}
 			}
 
 			if (hcint & DWC2_HCINT_ACK) {
@@ -1118,16 +1214,13 @@ static int dwc2_control_msg(struct dwc2_control *dwc2,
 		     DWC2_HCCHAR_EPTYPE_CONTROL,
 		     usb_maxpacket(u->dev, u->pipe));
 
-	vmm_writel((1 << DWC2_HCTSIZ_PKTCNT_OFFSET) |
-	       (DWC2_HC_PID_DATA1 << DWC2_HCTSIZ_PID_OFFSET),
-	       &hc_regs->hctsiz);
-
-	rc = vmm_host_va2pa((virtual_addr_t)status_buffer, &pa);
+	rc = dwc2_hc_setup_xfer(dwc2, hc_regs, status_buffer, 0, 1,
+				usb_maxpacket(u->dev, u->pipe),
+				((len == 0) || usb_pipeout(u->pipe)) ? 1 : 0,
+				DWC2_HC_PID_DATA1);
 	if (rc) {
-		vmm_printf("%s: VA2PA error!\n", __func__);
 		goto out;
 	}
-	vmm_writel((u32)pa, &hc_regs->hcdma);
 
 	/* Set host channel enable after all other setup is complete. */
 	vmm_clrsetbits_le32(&hc_regs->hcchar,
@@ -1164,7 +1257,6 @@ static int dwc2_bulk_msg(struct dwc2_control *dwc2,
 	int done = 0, rc = VMM_OK, stop_transfer = 0;
 	u32 hctsiz, hcint, tmp, xfer_len, num_packets;
 	struct dwc2_hc_regs *hc_regs;
-	physical_addr_t pa;
 	unsigned int timeout = 1000000;
 
 	/* Reject root hub bulk messages differently */
@@ -1198,13 +1290,18 @@ static int dwc2_bulk_msg(struct dwc2_control *dwc2,
 			     DWC2_HCCHAR_EPTYPE_BULK, max);
 
 		xfer_len = len - done;
-		/* Make sure that xfer_len is a multiple of max packet size. */
-		if (xfer_len > dwc2->params->max_transfer_size)
+		/*
+		 * Make sure that xfer_len is a multiple of max packet size.
+		 * The descriptor list covers DWC2_DATA_BUF_SIZE in one go.
+		 */
+		if (!dwc2->desc_dma &&
+		    (xfer_len > dwc2->params->max_transfer_size))
 			xfer_len = dwc2->params->max_transfer_size - max + 1;
 
 		if (xfer_len > 0) {
 			num_packets = udiv32((xfer_len + max - 1), max);
-			if (num_packets > dwc2->params->max_packet_count) {
+			if (!dwc2->desc_dma &&
+			    (num_packets > dwc2->params->max_packet_count)) {
 				num_packets = dwc2->params->max_packet_count;
 				xfer_len = num_packets * max;
 			}
@@ -1215,18 +1312,13 @@ static int dwc2_bulk_msg(struct dwc2_control *dwc2,
 		if (usb_pipein(u->pipe))
 			xfer_len = num_packets * max;
 
-		vmm_writel((xfer_len << DWC2_HCTSIZ_XFERSIZE_OFFSET) |
-			   (num_packets << DWC2_HCTSIZ_PKTCNT_OFFSET) |
-			   (dwc2->bulk_data_toggle[devnum][ep] <<
-					DWC2_HCTSIZ_PID_OFFSET),
-			   &hc_regs->hctsiz);
-
-		rc = vmm_host_va2pa((virtual_addr_t)buffer, &pa);
+		rc = dwc2_hc_setup_xfer(dwc2, hc_regs, buffer + done,
+					xfer_len, num_packets, max,
+					usb_pipein(u->pipe),
+					dwc2->bulk_data_toggle[devnum][ep]);
 		if (rc) {
-			vmm_printf("%s: VA2PA error!\n", __func__);
 			goto out;
 		}
-		vmm_writel((u32)pa, &hc_regs->hcdma);
 
 		/* Set host channel enable after all other setup is complete. */
 		vmm_clrsetbits_le32(&hc_regs->hcchar,
@@ -1243,15 +1335,15 @@ static int dwc2_bulk_msg(struct dwc2_control *dwc2,
 
 			if (hcint & DWC2_HCINT_XFERCOMP) {
 				hctsiz = vmm_readl(&hc_regs->hctsiz);
-				done += xfer_len;
-
-				tmp = hctsiz & DWC2_HCTSIZ_XFERSIZE_MASK;
-				tmp >>= DWC2_HCTSIZ_XFERSIZE_OFFSET;
 
 				if (usb_pipein(u->pipe)) {
-					done -= tmp;
-					if (hctsiz & DWC2_HCTSIZ_XFERSIZE_MASK)
+					tmp = dwc2_hc_xfer_done(dwc2, hctsiz,
+								xfer_len);
+					done += tmp;
+					if (tmp < xfer_len)
 						stop_transfer = 1;
+				} else {
+					done += xfer_len;
 				}
 
 				tmp = hctsiz & DWC2_HCTSIZ_PID_MASK;
@@ -1271,6 +1363,15 @@ static int dwc2_bulk_msg(struct dwc2_control *dwc2,
 				dwc2->bulk_data_toggle[devnum][ep] =
 							DWC2_HC_PID_DATA0;
 
+				rc = VMM_EIO;
+				stop_transfer = 1;
+				break;
+			}
+
+			if (hcint & (DWC2_HCINT_AHBERR | DWC2_HCINT_BNA)) {
+				vmm_printf("%s: DMA error (HCINT=%08x)\n",
+					   __func__, hcint);
+				rc = VMM_EIO;
 				stop_transfer = 1;
 				break;
 			}
@@ -1538,6 +1639,27 @@ static int dwc2_driver_probe(struct vmm_device *dev,
 		goto fail_unmap_regs;
 	}
 
+	/* Descriptor DMA needs core 2.90a or later with DESC_DMA */
+	if (params->dma_enable && (params->dma_desc_enable > 0) &&
+	    (snpsid >= DWC2_SNPSID_REV_2_90A) &&
+	    (vmm_readl(&dwc2->regs->ghwcfg4) & DWC2_HWCFG4_DESC_DMA)) {
+		dwc2->desc_list = vmm_dma_zalloc_phy(DWC2_DESC_LIST_SIZE,
+						     &dwc2->desc_list_pa);
+		if (!dwc2->desc_list) {
+			rc = VMM_ENOMEM;
+			goto fail_unmap_regs;
+		}
+		/* Descriptor list must be aligned to its size */
+		if (dwc2->desc_list_pa & (DWC2_DESC_LIST_SIZE - 1)) {
+			vmm_dma_free(dwc2->desc_list);
+			dwc2->desc_list = NULL;
+		} else {
+			dwc2->desc_dma = TRUE;
+		}
+	}
+	vmm_printf("%s: Using %s DMA mode\n", dev->name,
+		   (dwc2->desc_dma) ? "descriptor" : "address");
+
 	INIT_MUTEX(&dwc2->urb_process_mutex);
 	INIT_SPIN_LOCK(&dwc2->urb_lock);
 	INIT_LIST_HEAD(&dwc2->urb_pending_list);
@@ -1547,7 +1669,7 @@ static int dwc2_driver_probe(struct vmm_device *dev,
 					      VMM_THREAD_DEF_TIME_SLICE);
 	if (!dwc2->urb_thread) {
 		rc = VMM_ENOSPC;
-		goto fail_unmap_regs;
+		goto fail_free_desc;
 	}
 
 	rc = usb_add_hcd(hcd, dwc2->irq, 0);
@@ -1563,6 +1685,10 @@ static int dwc2_driver_probe(struct vmm_device *dev,
 
 fail_destroy_thread:
 	vmm_threads_destroy(dwc2->urb_thread);
+fail_free_desc:
+	if (dwc2->desc_list) {
+		vmm_dma_free(dwc2->desc_list);
+	}
 fail_unmap_regs:
 	vmm_devtree_regunmap_release(dev->of_node,
 					(virtual_addr_t)dwc2->regs, 0);
@@ -1583,6 +1709,10 @@ static int dwc2_driver_remove(struct vmm_device *dev)
 
 	vmm_threads_destroy(dwc2->urb_thread);
 
+	if (dwc2->desc_list) {
+		vmm_dma_free(dwc2->desc_list);
+	}
+
 	vmm_devtree_regunmap_release(dev->of_node,
 					(virtual_addr_t)dwc2->regs, 0);
 
@@ -1595,7 +1725,7 @@ static const struct dwc2_core_params params_bcm2835 = {
 	.otg_cap			= 0,	/* HNP/SRP capable */
 	.otg_ver			= 0,	/* 1.3 */
 	.dma_enable			= 1,
-	.dma_desc_enable		= 0,
+	.dma_desc_enable		= 1,
 	.dma_burst_size			= 32,
 	.speed				= 0,	/* High Speed */
 	.enable_dynamic_fifo		= 1,
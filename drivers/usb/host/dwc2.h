@@ -755,6 +755,25 @@ struct dwc2_core_regs {
 #define DWC2_SNPSID_DEVID_VER_2xx			(0x4f542 << 12)
 #define DWC2_SNPSID_DEVID_MASK				(0xfffff << 12)
 #define DWC2_SNPSID_DEVID_OFFSET			12
+#define DWC2_SNPSID_REV_2_90A				0x4f54290a
+
+/* Host mode DMA descriptor (non-isochronous) */
+struct dwc2_dma_desc {
+	u32			status;
+	u32			buf;
+} __packed;
+
+#define DWC2_HOST_DMA_NBYTES_MASK			(0x1FFFF << 0)
+#define DWC2_HOST_DMA_NBYTES_OFFSET			0
+#define DWC2_HOST_DMA_NBYTES_LIMIT			131071
+#define DWC2_HOST_DMA_IOC				(1 << 25)
+#define DWC2_HOST_DMA_IOC_OFFSET			25
+#define DWC2_HOST_DMA_EOL				(1 << 26)
+#define DWC2_HOST_DMA_EOL_OFFSET			26
+#define DWC2_HOST_DMA_STS_MASK				(0x3 << 28)
+#define DWC2_HOST_DMA_STS_OFFSET			28
+#define DWC2_HOST_DMA_A					(1 << 31)
+#define DWC2_HOST_DMA_A_OFFSET				31
 
 /* Host controller specific */
 #define DWC2_HC_PID_DATA0		0
@@ -27,6 +27,8 @@
 #include <vmm_spinlocks.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <vmm_manager.h>
+#include <vmm_guest_aspace.h>
 #include <vio/vmm_vdisk.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
@@ -50,104 +52,166 @@
 #define MODULE_EXIT			virtio_blk_exit
 
 #define VIRTIO_BLK_QUEUE_SIZE		128
-#define VIRTIO_BLK_IO_QUEUE		0
-#define VIRTIO_BLK_NUM_QUEUES		1
+#define VIRTIO_BLK_MAX_QUEUES		16
 #define VIRTIO_BLK_SECTOR_SIZE		512
 #define VIRTIO_BLK_DISK_SEG_MAX		(VIRTIO_BLK_QUEUE_SIZE - 2)
+#define VIRTIO_BLK_REQ_SG_MAX		32
+
+struct virtio_blk_queue;
 
 struct virtio_blk_dev_req {
-	struct virtio_queue		*vq;
+	struct virtio_blk_queue		*bq;
 	u16				head;
 	struct virtio_iovec		*read_iov;
 	u32				read_iov_cnt;
 	u32				len;
 	struct virtio_iovec		status_iov;
 	void				*data;
+	u32				sg_count;
+	struct vmm_request_sg		sg[VIRTIO_BLK_REQ_SG_MAX];
 	struct vmm_vdisk_request	r;
 };
 
+/* Each request queue is bound to one VCPU of the Guest and used
+ * ring updates of a request queue are done on host CPU of that VCPU.
+ */
+struct virtio_blk_queue {
+	struct virtio_blk_dev		*vbdev;
+	u32				num;
+	struct vmm_vcpu			*vcpu;
+	vmm_spinlock_t			io_lock;
+	vmm_spinlock_t			used_lock;
+	struct virtio_queue		vq;
+	struct virtio_iovec		iov[VIRTIO_BLK_QUEUE_SIZE];
+	struct virtio_blk_dev_req	reqs[VIRTIO_BLK_QUEUE_SIZE];
+};
+
 struct virtio_blk_dev {
 	struct virtio_device 		*vdev;
 
-	struct virtio_queue 		vqs[VIRTIO_BLK_NUM_QUEUES];
-	struct virtio_iovec		iov[VIRTIO_BLK_QUEUE_SIZE];
-	struct virtio_blk_dev_req	reqs[VIRTIO_BLK_QUEUE_SIZE];
+	u32				num_queues;
+	struct virtio_blk_queue		*queues;
 	struct virtio_blk_config 	config;
-	u32 				features;
+	u64 				features;
 
 	struct vmm_vdisk		*vdisk;
 };
 
-static u32 virtio_blk_get_host_features(struct virtio_device *dev)
+/* Bounce buffers come from bounce pool of virtual disk which is sized
+ * for all requests of all queues. Only a request needing more than its
+ * share of the pool falls back to Normal heap.
+ */
+static void *virtio_blk_buf_alloc(struct virtio_blk_dev *vbdev, u32 len)
 {
-	return	1UL << VIRTIO_BLK_F_SEG_MAX
-		| 1UL << VIRTIO_BLK_F_BLK_SIZE
-		| 1UL << VIRTIO_BLK_F_FLUSH
-		| 1UL << VIRTIO_RING_F_EVENT_IDX;
-#if 0
-		| 1UL << VIRTIO_RING_F_INDIRECT_DESC;
-#endif
+	void *ret = vmm_vdisk_alloc_buf(vbdev->vdisk, len);
+
+	return (ret) ? ret : vmm_malloc(len);
+}
+
+static void virtio_blk_buf_free(struct virtio_blk_dev *vbdev, void *buf)
+{
+	if (vmm_vdisk_owns_buf(vbdev->vdisk, buf)) {
+		vmm_vdisk_free_buf(vbdev->vdisk, buf);
+	} else {
+		vmm_free(buf);
+	}
+}
+
+static u64 virtio_blk_get_host_features(struct virtio_device *dev)
+{
+	struct virtio_blk_dev *vbdev = dev->emu_data;
+	u64 features = 1ULL << VIRTIO_BLK_F_SEG_MAX
+			| 1ULL << VIRTIO_BLK_F_BLK_SIZE
+			| 1ULL << VIRTIO_BLK_F_FLUSH
+			| 1ULL << VIRTIO_RING_F_EVENT_IDX
+			| 1ULL << VIRTIO_RING_F_INDIRECT_DESC
+			| 1ULL << VIRTIO_F_VERSION_1
+			| 1ULL << VIRTIO_F_RING_PACKED;
+
+	if (vbdev->num_queues > 1) {
+		features |= 1UL << VIRTIO_BLK_F_MQ;
+	}
+
+	return features;
 }
 
 static void virtio_blk_set_guest_features(struct virtio_device *dev,
-					  u32 features)
+					  u64 features)
 {
+	u32 i;
 	struct virtio_blk_dev *vbdev = dev->emu_data;
 
 	vbdev->features = features;
+	for (i = 0; i < vbdev->num_queues; i++) {
+		virtio_queue_set_features(&vbdev->queues[i].vq, features);
+	}
+}
+
+static void virtio_blk_bind_vq(struct virtio_device *dev,
+			       struct virtio_blk_queue *bq)
+{
+	u32 vcpu_count;
+
+	/* Spread request queues over VCPUs of Guest */
+	vcpu_count = vmm_manager_guest_vcpu_count(dev->guest);
+	bq->vcpu = (vcpu_count) ?
+		vmm_manager_guest_vcpu(dev->guest, bq->num % vcpu_count) : NULL;
 }
 
 static int virtio_blk_init_vq(struct virtio_device *dev,
 			      u32 vq, u32 page_size, u32 align,
 			      u32 pfn)
 {
-	int rc;
+	struct virtio_blk_queue *bq;
 	struct virtio_blk_dev *vbdev = dev->emu_data;
 
-	switch (vq) {
-	case VIRTIO_BLK_IO_QUEUE:
-		rc = virtio_queue_setup(&vbdev->vqs[vq], dev->guest,
-				pfn, page_size, VIRTIO_BLK_QUEUE_SIZE, align);
-		break;
-	default:
-		rc = VMM_EINVALID;
-		break;
-	};
-
-	return rc;
+	if (vbdev->num_queues <= vq) {
+		return VMM_EINVALID;
+	}
+	bq = &vbdev->queues[vq];
+
+	virtio_blk_bind_vq(dev, bq);
+
+	return virtio_queue_setup(&bq->vq, dev->guest,
+			pfn, page_size, VIRTIO_BLK_QUEUE_SIZE, align);
+}
+
+static int virtio_blk_init_vq_addr(struct virtio_device *dev,
+				   u32 vq, u32 num, physical_addr_t desc,
+				   physical_addr_t driver,
+				   physical_addr_t device)
+{
+	struct virtio_blk_queue *bq;
+	struct virtio_blk_dev *vbdev = dev->emu_data;
+
+	if ((vbdev->num_queues <= vq) || !num ||
+	    (VIRTIO_BLK_QUEUE_SIZE < num)) {
+		return VMM_EINVALID;
+	}
+	bq = &vbdev->queues[vq];
+
+	virtio_blk_bind_vq(dev, bq);
+
+	return virtio_queue_setup_addr(&bq->vq, dev->guest,
+				       num, desc, driver, device);
 }
 
 static int virtio_blk_get_pfn_vq(struct virtio_device *dev, u32 vq)
 {
-	int rc;
 	struct virtio_blk_dev *vbdev = dev->emu_data;
 
-	switch (vq) {
-	case VIRTIO_BLK_IO_QUEUE:
-		rc = virtio_queue_guest_pfn(&vbdev->vqs[vq]);
-		break;
-	default:
-		rc = VMM_EINVALID;
-		break;
-	};
+	if (vbdev->num_queues <= vq) {
+		return VMM_EINVALID;
+	}
 
-	return rc;
+	return virtio_queue_guest_pfn(&vbdev->queues[vq].vq);
 }
 
 static int virtio_blk_get_size_vq(struct virtio_device *dev, u32 vq)
 {
-	int rc;
-
-	switch (vq) {
-	case VIRTIO_BLK_IO_QUEUE:
-		rc = VIRTIO_BLK_QUEUE_SIZE;
-		break;
-	default:
-		rc = 0;
-		break;
-	};
-
-	return rc;
+	struct virtio_blk_dev *vbdev = dev->emu_data;
+
+	return (vq < vbdev->num_queues) ? VIRTIO_BLK_QUEUE_SIZE : 0;
 }
 
 static int virtio_blk_set_size_vq(struct virtio_device *dev, u32 vq, int size)
@@ -156,11 +220,46 @@ static int virtio_blk_set_size_vq(struct virtio_device *dev, u32 vq, int size)
 	return size;
 }
 
+static void virtio_blk_req_push(struct virtio_blk_queue *bq,
+				u16 head, u32 len)
+{
+	irq_flags_t flags;
+	struct virtio_device *dev = bq->vbdev->vdev;
+
+	vmm_spin_lock_irqsave_lite(&bq->used_lock, flags);
+
+	virtio_queue_set_used_elem(&bq->vq, head, len);
+
+	if (virtio_queue_should_signal(&bq->vq)) {
+		dev->tra->notify(dev, bq->num);
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&bq->used_lock, flags);
+}
+
+static void virtio_blk_req_push_func(struct vmm_vcpu *vcpu, void *data)
+{
+	struct virtio_blk_dev_req *req = data;
+
+	virtio_blk_req_push(req->bq, req->head, req->len);
+}
+
+/* Complete request on host CPU of VCPU bound to its request queue */
+static void virtio_blk_req_complete(struct virtio_blk_dev_req *req)
+{
+	struct vmm_vcpu *vcpu = req->bq->vcpu;
+
+	if (!vcpu || vmm_manager_vcpu_check_current_hcpu(vcpu) ||
+	    vmm_manager_vcpu_hcpu_func(vcpu, VMM_VCPU_STATE_ALLMASK,
+				       virtio_blk_req_push_func, req)) {
+		virtio_blk_req_push(req->bq, req->head, req->len);
+	}
+}
+
 static void virtio_blk_req_done(struct virtio_blk_dev *vbdev,
 				struct virtio_blk_dev_req *req, u8 status)
 {
 	struct virtio_device *dev = vbdev->vdev;
-	int queueid = req->vq - vbdev->vqs;
 
 	if (req->read_iov && req->len && req->data &&
 	    (status == VIRTIO_BLK_S_OK) &&
@@ -173,24 +272,20 @@ static void virtio_blk_req_done(struct virtio_blk_dev *vbdev,
 	}
 
 	if (req->read_iov) {
-		vmm_free(req->read_iov);
+		virtio_blk_buf_free(vbdev, req->read_iov);
 		req->read_iov = NULL;
 		req->read_iov_cnt = 0;
 	}
 
 	vmm_vdisk_set_request_type(&req->r, VMM_VDISK_REQUEST_UNKNOWN);
 	if (req->data) {
-		vmm_free(req->data);
+		virtio_blk_buf_free(vbdev, req->data);
 		req->data = NULL;
 	}
 
 	virtio_buf_to_iovec_write(dev, &req->status_iov, 1, &status, 1);
 
-	virtio_queue_set_used_elem(req->vq, req->head, req->len);
-
-	if (virtio_queue_should_signal(req->vq)) {
-		dev->tra->notify(dev, queueid);
-	}
+	virtio_blk_req_complete(req);
 }
 
 static void virtio_blk_attached(struct vmm_vdisk *vdisk)
@@ -239,37 +334,100 @@ static void virtio_blk_req_failed(struct vmm_vdisk *vdisk,
 			    VIRTIO_BLK_S_IOERR);
 }
 
+/* Translate data iovecs of request into scatter-gather list of host
+ * physical address ranges so that block device can directly access
+ * guest RAM. Returns FALSE if some part of data buffer is not backed
+ * by guest RAM or it does not fit in scatter-gather list.
+ */
+static bool virtio_blk_req_map_sg(struct virtio_device *dev,
+				  struct virtio_blk_dev_req *req,
+				  struct virtio_iovec *iov, u32 iov_cnt)
+{
+	u32 i, reg_flags, cnt = 0;
+	physical_addr_t gpa, hpa;
+	physical_size_t len, hsz;
+	struct vmm_request_sg *sg = NULL;
+
+	for (i = 0; i < iov_cnt; i++) {
+		gpa = iov[i].addr;
+		len = iov[i].len;
+		while (len) {
+			if (vmm_guest_physical_map(dev->guest, gpa, len,
+						   &hpa, &hsz, &reg_flags)) {
+				return FALSE;
+			}
+			if (!hsz || !(reg_flags & VMM_REGION_REAL) ||
+			    !(reg_flags & (VMM_REGION_ISRAM |
+					   VMM_REGION_ISROM))) {
+				return FALSE;
+			}
+
+			if (sg && ((sg->addr + sg->len) == hpa)) {
+				sg->len += hsz;
+			} else {
+				if (cnt == VIRTIO_BLK_REQ_SG_MAX) {
+					return FALSE;
+				}
+				sg = &req->sg[cnt++];
+				sg->addr = hpa;
+				sg->len = hsz;
+			}
+
+			gpa += hsz;
+			len -= hsz;
+		}
+	}
+
+	req->sg_count = cnt;
+
+	return TRUE;
+}
+
 static void virtio_blk_do_io(struct virtio_device *dev,
-			     struct virtio_blk_dev *vbdev)
+			     struct virtio_blk_dev *vbdev,
+			     struct virtio_blk_queue *bq)
 {
 	u16 head;
 	u32 i, iov_cnt, len;
-	struct virtio_queue *vq = &vbdev->vqs[VIRTIO_BLK_IO_QUEUE];
+	irq_flags_t flags;
+	struct virtio_queue *vq = &bq->vq;
+	struct virtio_iovec *iov = bq->iov;
 	struct virtio_blk_dev_req *req;
 	struct virtio_blk_outhdr hdr;
 
+	vmm_spin_lock_irqsave_lite(&bq->io_lock, flags);
+
+	/* Batch requests of this drain so that adjacent ones get merged */
+	vmm_vdisk_plug(vbdev->vdisk);
+
 	while (virtio_queue_available(vq)) {
 		head = virtio_queue_pop(vq);
-		req = &vbdev->reqs[head];
-		head = virtio_queue_get_head_iovec(vq, head, vbdev->iov,
+		req = &bq->reqs[head];
+		head = virtio_queue_get_head_iovec(vq, head, iov,
 						   &iov_cnt, &len);
 
-		req->vq = vq;
+		req->bq = bq;
 		req->head = head;
 		req->read_iov = NULL;
 		req->read_iov_cnt = 0;
+		req->sg_count = 0;
 		req->len = 0;
+		if (iov_cnt < 2) {
+			virtio_blk_req_complete(req);
+			continue;
+		}
 		for (i = 1; i < (iov_cnt - 1); i++) {
-			req->len += vbdev->iov[i].len;
+			req->len += iov[i].len;
 		}
-		req->status_iov.addr = vbdev->iov[iov_cnt - 1].addr;
-		req->status_iov.len = vbdev->iov[iov_cnt - 1].len;
+		req->status_iov.addr = iov[iov_cnt - 1].addr;
+		req->status_iov.len = iov[iov_cnt - 1].len;
 		vmm_vdisk_set_request_type(&req->r, VMM_VDISK_REQUEST_UNKNOWN);
 
-		len = virtio_iovec_to_buf_read(dev, &vbdev->iov[0], 1,
+		len = virtio_iovec_to_buf_read(dev, &iov[0], 1,
 						&hdr, sizeof(hdr));
 		if (len < sizeof(hdr)) {
-			virtio_queue_set_used_elem(req->vq, req->head, 0);
+			req->len = 0;
+			virtio_blk_req_complete(req);
 			continue;
 		}
 
@@ -277,14 +435,26 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 		case VIRTIO_BLK_T_IN:
 			vmm_vdisk_set_request_type(&req->r,
 						   VMM_VDISK_REQUEST_READ);
-			req->data = vmm_malloc(req->len);
+			DPRINTF("%s: VIRTIO_BLK_T_IN dev=%s "
+				"hdr.sector=%"PRIu64" req->len=%d\n",
+				__func__, dev->name,
+				(u64)hdr.sector, req->len);
+			if (virtio_blk_req_map_sg(dev, req, &iov[1],
+						  iov_cnt - 2)) {
+				vmm_vdisk_submit_request_sg(vbdev->vdisk,
+						&req->r, VMM_VDISK_REQUEST_READ,
+						hdr.sector, req->sg,
+						req->sg_count, req->len);
+				break;
+			}
+			req->data = virtio_blk_buf_alloc(vbdev, req->len);
 			if (!req->data) {
 				virtio_blk_req_done(vbdev, req,
 						    VIRTIO_BLK_S_IOERR);
 				continue;
 			}
 			len = sizeof(struct virtio_iovec) * (iov_cnt - 2);
-			req->read_iov = vmm_malloc(len);
+			req->read_iov = virtio_blk_buf_alloc(vbdev, len);
 			if (!req->read_iov) {
 				virtio_blk_req_done(vbdev, req,
 						    VIRTIO_BLK_S_IOERR);
@@ -292,13 +462,9 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 			}
 			req->read_iov_cnt = iov_cnt - 2;
 			for (i = 0; i < req->read_iov_cnt; i++) {
-				req->read_iov[i].addr = vbdev->iov[i + 1].addr;
-				req->read_iov[i].len = vbdev->iov[i + 1].len;
+				req->read_iov[i].addr = iov[i + 1].addr;
+				req->read_iov[i].len = iov[i + 1].len;
 			}
-			DPRINTF("%s: VIRTIO_BLK_T_IN dev=%s "
-				"hdr.sector=%"PRIu64" req->len=%d\n",
-				__func__, dev->name,
-				(u64)hdr.sector, req->len);
 			/* Note: We will get failed() or complete() callback
 			 * even when no block device attached to virtual disk
 			 */
@@ -309,22 +475,30 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 		case VIRTIO_BLK_T_OUT:
 			vmm_vdisk_set_request_type(&req->r,
 						   VMM_VDISK_REQUEST_WRITE);
-			req->data = vmm_malloc(req->len);
+			DPRINTF("%s: VIRTIO_BLK_T_OUT dev=%s "
+				"hdr.sector=%"PRIu64" req->len=%d\n",
+				__func__, dev->name,
+				(u64)hdr.sector, req->len);
+			if (virtio_blk_req_map_sg(dev, req, &iov[1],
+						  iov_cnt - 2)) {
+				vmm_vdisk_submit_request_sg(vbdev->vdisk,
+						&req->r, VMM_VDISK_REQUEST_WRITE,
+						hdr.sector, req->sg,
+						req->sg_count, req->len);
+				break;
+			}
+			req->data = virtio_blk_buf_alloc(vbdev, req->len);
 			if (!req->data) {
 				virtio_blk_req_done(vbdev, req,
 						    VIRTIO_BLK_S_IOERR);
 				continue;
 			} else {
 				virtio_iovec_to_buf_read(dev,
-							 &vbdev->iov[1],
+							 &iov[1],
 							 iov_cnt - 2,
 							 req->data,
 							 req->len);
 			}
-			DPRINTF("%s: VIRTIO_BLK_T_OUT dev=%s "
-				"hdr.sector=%"PRIu64" req->len=%d\n",
-				__func__, dev->name,
-				(u64)hdr.sector, req->len);
 			/* Note: We will get failed() or complete() callback
 			 * even when no block device attached to virtual disk
 			 */
@@ -349,21 +523,23 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 			vmm_vdisk_set_request_type(&req->r,
 						   VMM_VDISK_REQUEST_READ);
 			req->len = VIRTIO_BLK_ID_BYTES;
-			req->data = vmm_zalloc(req->len);
+			req->data = virtio_blk_buf_alloc(vbdev, req->len);
 			if (!req->data) {
 				virtio_blk_req_done(vbdev, req,
 						    VIRTIO_BLK_S_IOERR);
 				continue;
 			}
-			req->read_iov = vmm_malloc(sizeof(struct virtio_iovec));
+			memset(req->data, 0, req->len);
+			req->read_iov = virtio_blk_buf_alloc(vbdev,
+						sizeof(struct virtio_iovec));
 			if (!req->read_iov) {
 				virtio_blk_req_done(vbdev, req,
 						    VIRTIO_BLK_S_IOERR);
 				continue;
 			}
 			req->read_iov_cnt = 1;
-			req->read_iov[0].addr = vbdev->iov[1].addr;
-			req->read_iov[0].len = vbdev->iov[1].len;
+			req->read_iov[0].addr = iov[1].addr;
+			req->read_iov[0].len = iov[1].len;
 			DPRINTF("%s: VIRTIO_BLK_T_GET_ID dev=%s req->len=%d\n",
 				__func__, dev->name, req->len);
 			if (vmm_vdisk_current_block_device(vbdev->vdisk,
@@ -379,25 +555,25 @@ static void virtio_blk_do_io(struct virtio_device *dev,
 			break;
 		};
 	}
+
+	vmm_vdisk_unplug(vbdev->vdisk);
+
+	vmm_spin_unlock_irqrestore_lite(&bq->io_lock, flags);
 }
 
 static int virtio_blk_notify_vq(struct virtio_device *dev, u32 vq)
 {
-	int rc = VMM_OK;
 	struct virtio_blk_dev *vbdev = dev->emu_data;
 
 	DPRINTF("%s: dev=%s vq=%d\n", __func__, dev->name, vq);
 
-	switch (vq) {
-	case VIRTIO_BLK_IO_QUEUE:
-		virtio_blk_do_io(dev, vbdev);
-		break;
-	default:
-		rc = VMM_EINVALID;
-		break;
-	};
+	if (vbdev->num_queues <= vq) {
+		return VMM_EINVALID;
+	}
+
+	virtio_blk_do_io(dev, vbdev, &vbdev->queues[vq]);
 
-	return rc;
+	return VMM_OK;
 }
 
 static int virtio_blk_read_config(struct virtio_device *dev,
@@ -437,25 +613,32 @@ static int virtio_blk_write_config(struct virtio_device *dev,
 static int virtio_blk_reset(struct virtio_device *dev)
 {
 	int i, rc;
+	u32 q;
+	struct virtio_blk_queue *bq;
 	struct virtio_blk_dev_req *req;
 	struct virtio_blk_dev *vbdev = dev->emu_data;
 
 	DPRINTF("%s: dev=%s\n", __func__, dev->name);
 
-	for (i = 0; i < VIRTIO_BLK_QUEUE_SIZE; i++) {
-		req = &vbdev->reqs[i];
-		if (vmm_vdisk_get_request_type(&req->r) !=
-					VMM_VDISK_REQUEST_UNKNOWN) {
-			vmm_vdisk_abort_request(vbdev->vdisk, &req->r);
+	for (q = 0; q < vbdev->num_queues; q++) {
+		bq = &vbdev->queues[q];
+
+		for (i = 0; i < VIRTIO_BLK_QUEUE_SIZE; i++) {
+			req = &bq->reqs[i];
+			if (vmm_vdisk_get_request_type(&req->r) !=
+						VMM_VDISK_REQUEST_UNKNOWN) {
+				vmm_vdisk_abort_request(vbdev->vdisk, &req->r);
+			}
+			memset(req, 0, sizeof(*req));
+			vmm_vdisk_set_request_type(&req->r,
+						   VMM_VDISK_REQUEST_UNKNOWN);
 		}
-		memset(req, 0, sizeof(*req));
-		vmm_vdisk_set_request_type(&req->r,
-					   VMM_VDISK_REQUEST_UNKNOWN);
-	}
 
-	rc = virtio_queue_cleanup(&vbdev->vqs[VIRTIO_BLK_IO_QUEUE]);
-	if (rc) {
-		return rc;
+		rc = virtio_queue_cleanup(&bq->vq);
+		if (rc) {
+			return rc;
+		}
+		bq->vcpu = NULL;
 	}
 
 	return VMM_OK;
@@ -464,6 +647,7 @@ static int virtio_blk_reset(struct virtio_device *dev)
 static int virtio_blk_connect(struct virtio_device *dev,
 			      struct virtio_emulator *emu)
 {
+	u32 q;
 	const char *attr;
 	struct virtio_blk_dev *vbdev;
 
@@ -476,17 +660,44 @@ static int virtio_blk_connect(struct virtio_device *dev,
 	}
 	vbdev->vdev = dev;
 
+	if (vmm_devtree_read_u32(dev->edev->node, "num_queues",
+				 &vbdev->num_queues) != VMM_OK) {
+		vbdev->num_queues = 1;
+	}
+	if (!vbdev->num_queues) {
+		vbdev->num_queues = 1;
+	} else if (VIRTIO_BLK_MAX_QUEUES < vbdev->num_queues) {
+		vbdev->num_queues = VIRTIO_BLK_MAX_QUEUES;
+	}
+
+	vbdev->queues = vmm_zalloc(sizeof(struct virtio_blk_queue) *
+				   vbdev->num_queues);
+	if (!vbdev->queues) {
+		vmm_printf("Failed to allocate virtio block queues....\n");
+		vmm_free(vbdev);
+		return VMM_ENOMEM;
+	}
+	for (q = 0; q < vbdev->num_queues; q++) {
+		vbdev->queues[q].vbdev = vbdev;
+		vbdev->queues[q].num = q;
+		INIT_SPIN_LOCK(&vbdev->queues[q].io_lock);
+		INIT_SPIN_LOCK(&vbdev->queues[q].used_lock);
+	}
+
 	vbdev->config.capacity = 0;
+	vbdev->config.num_queues = vbdev->num_queues;
 	vbdev->config.seg_max = VIRTIO_BLK_DISK_SEG_MAX,
 	vbdev->config.blk_size = VIRTIO_BLK_SECTOR_SIZE;
 
 	vbdev->vdisk = vmm_vdisk_create(dev->name, VIRTIO_BLK_SECTOR_SIZE,
+					vbdev->num_queues * VIRTIO_BLK_QUEUE_SIZE,
 					virtio_blk_attached,
 					virtio_blk_detached,
 					virtio_blk_req_completed,
 					virtio_blk_req_failed,
 					vbdev);
 	if (!vbdev->vdisk) {
+		vmm_free(vbdev->queues);
 		vmm_free(vbdev);
 		return VMM_EFAIL;
 	}
@@ -509,6 +720,7 @@ static void virtio_blk_disconnect(struct virtio_device *dev)
 	DPRINTF("%s: dev=%s\n", __func__, dev->name);
 
 	vmm_vdisk_destroy(vbdev->vdisk);
+	vmm_free(vbdev->queues);
 	vmm_free(vbdev);
 }
 
@@ -525,6 +737,7 @@ struct virtio_emulator virtio_blk = {
 	.get_host_features      = virtio_blk_get_host_features,
 	.set_guest_features     = virtio_blk_set_guest_features,
 	.init_vq                = virtio_blk_init_vq,
+	.init_vq_addr           = virtio_blk_init_vq_addr,
 	.get_pfn_vq             = virtio_blk_get_pfn_vq,
 	.get_size_vq            = virtio_blk_get_size_vq,
 	.set_size_vq            = virtio_blk_set_size_vq,
@@ -55,21 +55,21 @@ struct virtio_console_dev {
 	struct virtio_iovec rx_iov[VIRTIO_CONSOLE_QUEUE_SIZE];
 	struct virtio_iovec tx_iov[VIRTIO_CONSOLE_QUEUE_SIZE];
 	struct virtio_console_config config;
-	u32 features;
+	u64 features;
 
 	char name[VIRTIO_DEVICE_MAX_NAME_LEN];
 	struct vmm_vserial *vser;
 	struct fifo *emerg_rd;
 };
 
-static u32 virtio_console_get_host_features(struct virtio_device *dev)
+static u64 virtio_console_get_host_features(struct virtio_device *dev)
 {
 	/* We support emergency write. */
 	return 1UL << VIRTIO_CONSOLE_F_EMERG_WRITE;
 }
 
 static void virtio_console_set_guest_features(struct virtio_device *dev,
-					  u32 features)
+					  u64 features)
 {
 	/* No host features so, ignore it. */
 }
@@ -138,7 +138,7 @@ static int virtio_console_set_size_vq(struct virtio_device *dev, u32 vq, int siz
 static int virtio_console_do_tx(struct virtio_device *dev,
 				struct virtio_console_dev *cdev)
 {
-	u8 buf[8];
+	u8 buf[128];
 	u16 head = 0;
 	u32 i, len, iov_cnt = 0, total_len = 0;
 	struct virtio_queue *vq = &cdev->vqs[VIRTIO_CONSOLE_TX_QUEUE];
@@ -222,6 +222,41 @@ static int virtio_console_vserial_send(struct vmm_vserial *vser, u8 data)
 	return VMM_OK;
 }
 
+static u32 virtio_console_vserial_send_buf(struct vmm_vserial *vser,
+					   u8 *src, u32 len)
+{
+	u16 head = 0;
+	u32 i, count, sent = 0, iov_cnt = 0, total_len = 0;
+	struct virtio_console_dev *cdev = vmm_vserial_priv(vser);
+	struct virtio_queue *vq = &cdev->vqs[VIRTIO_CONSOLE_RX_QUEUE];
+	struct virtio_iovec *iov = cdev->rx_iov;
+	struct virtio_device *dev = cdev->vdev;
+
+	i = fifo_enqueue_multi(cdev->emerg_rd, src, len);
+	for (; i < len; i++) {
+		fifo_enqueue(cdev->emerg_rd, &src[i], TRUE);
+	}
+
+	while ((sent < len) && virtio_queue_available(vq)) {
+		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+		if (!iov_cnt) {
+			continue;
+		}
+
+		count = virtio_buf_to_iovec_write(dev, iov, iov_cnt,
+						  &src[sent], len - sent);
+		virtio_queue_set_used_elem(vq, head, count);
+		sent += count;
+	}
+
+	if (sent && virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, VIRTIO_CONSOLE_RX_QUEUE);
+	}
+
+	/* All bytes are always queued to emergency read fifo */
+	return len;
+}
+
 static int virtio_console_read_config(struct virtio_device *dev, 
 				      u32 offset, void *dst, u32 dst_len)
 {
@@ -325,6 +360,7 @@ static int virtio_console_connect(struct virtio_device *dev,
 	cdev->vser = vmm_vserial_create(cdev->name, 
 					&virtio_console_vserial_can_send, 
 					&virtio_console_vserial_send, 
+					&virtio_console_vserial_send_buf,
 					VIRTIO_CONSOLE_VSERIAL_FIFO_SZ, cdev);
 	if (!cdev->vser) {
 		return VMM_EFAIL;
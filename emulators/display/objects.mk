@@ -22,4 +22,5 @@
 # */
 
 emulators-objs-$(CONFIG_EMU_DISPLAY_PL110)+= display/pl110.o
+emulators-objs-$(CONFIG_EMU_DISPLAY_VIRTIO_GPU)+= display/virtio_gpu.o
 
@@ -36,9 +36,11 @@
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
 #include <vmm_host_io.h>
+#include <vmm_host_aspace.h>
 #include <vmm_guest_aspace.h>
 #include <vio/vmm_pixel_ops.h>
 #include <vio/vmm_vdisplay.h>
+#include <libs/bitmap.h>
 
 #define MODULE_DESC			"PL110 CLCD Emulator"
 #define MODULE_AUTHOR			"Anup Patel"
@@ -95,6 +97,13 @@ struct pl110_state {
 	u32 palette16[256];
 	u32 palette32[256];
 	u32 raw_palette[128];
+	bool fb_redraw;
+
+	/* Dirty logging of frame buffer */
+	vmm_spinlock_t fb_lock;
+	physical_addr_t fb_base;
+	u32 fb_size;
+	struct vmm_surface *fb_surface;
 };
 
 #define BITS 8
@@ -129,11 +138,72 @@ static void pl110_display_invalidate(struct vmm_vdisplay *vdis)
 {
 	struct pl110_state *s = vmm_vdisplay_priv(vdis);
 
+	vmm_spin_lock(&s->lock);
+	s->fb_redraw = TRUE;
+	vmm_spin_unlock(&s->lock);
+
 	if (pl110_enabled(s)) {
 		vmm_vdisplay_surface_gfx_clear(vdis);
 	}
 }
 
+/* Get dirty page bitmap of frame buffer or NULL when whole
+ * frame buffer has to be redrawn.
+ */
+static unsigned long *pl110_fb_dirty(struct pl110_state *s,
+				     struct vmm_surface *sf,
+				     physical_addr_t gphys, u32 size,
+				     bool redraw)
+{
+	int rc = VMM_EFAIL;
+	u32 nbits;
+	unsigned long *dirty;
+
+	if (!size) {
+		return NULL;
+	}
+
+	nbits = VMM_SIZE_TO_PAGE((gphys & VMM_PAGE_MASK) + size);
+	dirty = vmm_malloc(bitmap_estimate_size(nbits));
+	if (!dirty) {
+		return NULL;
+	}
+
+	vmm_spin_lock(&s->fb_lock);
+
+	if ((s->fb_base != gphys) || (s->fb_size != size)) {
+		if (s->fb_size) {
+			vmm_guest_dirty_log_stop(s->guest, s->fb_base);
+		}
+		s->fb_base = gphys;
+		s->fb_size = size;
+		if (vmm_guest_dirty_log_start(s->guest, gphys, size)) {
+			s->fb_size = 0;
+		}
+	}
+
+	if (s->fb_size) {
+		rc = vmm_guest_dirty_log_get(s->guest, gphys, dirty, nbits);
+	}
+
+	/* Dirty log is shared by all surfaces so a surface
+	 * other than last updated one is redrawn completely.
+	 */
+	if (s->fb_surface != sf) {
+		s->fb_surface = sf;
+		redraw = TRUE;
+	}
+
+	vmm_spin_unlock(&s->fb_lock);
+
+	if (rc || redraw) {
+		vmm_free(dirty);
+		return NULL;
+	}
+
+	return dirty;
+}
+
 static int pl110_display_pixeldata(struct vmm_vdisplay *vdis,
 				   struct vmm_pixelformat *pf,
 				   u32 *rows, u32 *cols,
@@ -190,6 +260,8 @@ static void pl110_display_update(struct vmm_vdisplay *vdis,
 	drawfn fn;
 	drawfn *fntable;
 	u32 *palette;
+	bool redraw;
+	unsigned long *dirty;
 	physical_addr_t gphys;
 	int cols, rows, first, last;
 	int dest_width, src_width, bpp_offset;
@@ -304,13 +376,24 @@ static void pl110_display_update(struct vmm_vdisplay *vdis,
 	gphys = s->upbase;
 	cols = s->cols;
 	rows = s->rows;
+	redraw = s->fb_redraw;
+	s->fb_redraw = FALSE;
 
 	vmm_spin_unlock(&s->lock);
 
 	first = 0;
-	vmm_surface_update(sf, s->guest, gphys, cols, rows,
-			   src_width, dest_width, 0, fn, palette,
-			   &first, &last);
+	last = -1;
+	dirty = pl110_fb_dirty(s, sf, gphys, rows * src_width, redraw);
+	if (dirty) {
+		vmm_surface_update_dirty(sf, s->guest, gphys, cols, rows,
+					 src_width, dest_width, 0, fn,
+					 palette, dirty, &first, &last);
+		vmm_free(dirty);
+	} else {
+		vmm_surface_update(sf, s->guest, gphys, cols, rows,
+				   src_width, dest_width, 0, fn, palette,
+				   &first, &last);
+	}
 	if (first >= 0) {
 		vmm_vdisplay_surface_gfx_update(vdis, 0, first, cols,
 						last - first + 1);
@@ -633,6 +716,7 @@ static int pl110_emulator_reset(struct vmm_emudev *edev)
 	memset(s->palette15, 0, sizeof(s->palette15));
 	memset(s->palette16, 0, sizeof(s->palette16));
 	memset(s->palette32, 0, sizeof(s->palette32));
+	s->fb_redraw = TRUE;
 
 	vmm_spin_unlock(&s->lock);
 
@@ -684,6 +768,7 @@ static int pl110_emulator_probe(struct vmm_guest *guest,
 		s->mux_in = UINT_MAX;
 	}
 	INIT_SPIN_LOCK(&s->lock);
+	INIT_SPIN_LOCK(&s->fb_lock);
 
 	strlcpy(name, guest->name, sizeof(name));
 	strlcat(name, "/", sizeof(name));
@@ -727,6 +812,9 @@ static int pl110_emulator_remove(struct vmm_emudev *edev)
 					      &pl110_mux_in_irqchip, s);
 	}
 	vmm_vdisplay_destroy(s->vdis);
+	if (s->fb_size) {
+		vmm_guest_dirty_log_stop(s->guest, s->fb_base);
+	}
 	vmm_free(s);
 
 	return rc;
@@ -47,6 +47,14 @@
 #define glue(x, y) xglue(x, y)
 #endif
 
+/* Whole words are stored directly when surface has no write
+ * callbacks and destination is word aligned.
+ */
+#ifndef DIRECT_WRITE
+#define DIRECT_WRITE(s, d) \
+	(vmm_surface_direct_write(s) && !((virtual_addr_t)(d) & 0x3))
+#endif
+
 #ifndef ORDER
 
 #if BITS == 8
@@ -268,6 +276,29 @@ static void glue(pl110_draw_line8_,NAME)(struct vmm_surface *s,
 {
 	u32 *palette = opaque;
 	u32 data;
+#if BITS == 32
+	u32 *d32 = (u32 *)d;
+	if (DIRECT_WRITE(s, d)) {
+		while (width > 0) {
+			data = *(u32 *)src;
+#ifdef SWAP_WORDS
+			d32[0] = palette[data >> 24];
+			d32[1] = palette[(data >> 16) & 0xff];
+			d32[2] = palette[(data >> 8) & 0xff];
+			d32[3] = palette[data & 0xff];
+#else
+			d32[0] = palette[data & 0xff];
+			d32[1] = palette[(data >> 8) & 0xff];
+			d32[2] = palette[(data >> 16) & 0xff];
+			d32[3] = palette[data >> 24];
+#endif
+			d32 += 4;
+			width -= 4;
+			src += 4;
+		}
+		return;
+	}
+#endif
 	while (width > 0) {
 		data = *(u32 *)src;
 #define FN(x) COPY_PIXEL(s, d, palette[(data >> (x)) & 0xff]);
@@ -294,6 +325,28 @@ static void glue(pl110_draw_line16_,NAME)(struct vmm_surface *s,
 {
 	u32 data;
 	unsigned int r, g, b;
+#if BITS == 32
+	u32 *d32 = (u32 *)d;
+	if (DIRECT_WRITE(s, d)) {
+		while (width > 0) {
+			data = *(u32 *)src;
+#ifdef SWAP_WORDS
+			data = bswap32(data);
+#endif
+#ifdef RGB
+			d32[0] = rgb565_to_pixel32bgr(data & 0xffff);
+			d32[1] = rgb565_to_pixel32bgr(data >> 16);
+#else
+			d32[0] = rgb565_to_pixel32(data & 0xffff);
+			d32[1] = rgb565_to_pixel32(data >> 16);
+#endif
+			d32 += 2;
+			width -= 2;
+			src += 4;
+		}
+		return;
+	}
+#endif
 	while (width > 0) {
 		data = *(u32 *)src;
 #ifdef SWAP_WORDS
@@ -342,6 +395,27 @@ static void glue(pl110_draw_line32_,NAME)(struct vmm_surface *s,
 {
 	u32 data;
 	unsigned int r, g, b;
+#if BITS == 32
+	u32 *d32 = (u32 *)d;
+	if (DIRECT_WRITE(s, d)) {
+		while (width > 0) {
+			data = *(u32 *)src;
+#if !defined(SWAP_WORDS) && defined(RGB)
+			*d32 = pixel32_swap_rb(data);
+#elif !defined(SWAP_WORDS)
+			*d32 = data & 0x00ffffff;
+#elif defined(RGB)
+			*d32 = data >> 8;
+#else
+			*d32 = bswap32(data) & 0x00ffffff;
+#endif
+			d32++;
+			width--;
+			src += 4;
+		}
+		return;
+	}
+#endif
 	while (width > 0) {
 		data = *(u32 *)src;
 #ifdef RGB
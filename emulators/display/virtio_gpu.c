@@ -0,0 +1,1131 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file virtio_gpu.c
+ * @author agent (agent@local)
+ * @brief VirtIO based 2D GPU Emulator.
+ *
+ * Guest declares resources, attaches guest pages as their backing and
+ * explicitly transfers and flushes changed rectangles. Only flushed
+ * rectangles of the scanout resource are converted to surfaces hence
+ * no frame buffer scanning is required.
+ */
+
+#include <vmm_error.h>
+#include <vmm_macros.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_devtree.h>
+#include <vmm_devemu.h>
+#include <vmm_spinlocks.h>
+#include <vmm_host_aspace.h>
+#include <vmm_guest_aspace.h>
+#include <vio/vmm_pixel_ops.h>
+#include <vio/vmm_vdisplay.h>
+#include <libs/list.h>
+#include <libs/mathlib.h>
+#include <libs/stringlib.h>
+
+#include <emu/virtio.h>
+#include <emu/virtio_gpu.h>
+
+#define MODULE_DESC			"VirtIO GPU Emulator"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(VMM_VDISPLAY_IPRIORITY + \
+					 VIRTIO_IPRIORITY + 1)
+#define MODULE_INIT			virtio_gpu_init
+#define MODULE_EXIT			virtio_gpu_exit
+
+#define VIRTIO_GPU_QUEUE_SIZE		256
+#define VIRTIO_GPU_NUM_QUEUES		2
+#define VIRTIO_GPU_CTRL_QUEUE		0
+#define VIRTIO_GPU_CURSOR_QUEUE		1
+
+#define VIRTIO_GPU_NUM_SCANOUTS		1
+#define VIRTIO_GPU_DEFAULT_WIDTH	1024
+#define VIRTIO_GPU_DEFAULT_HEIGHT	768
+#define VIRTIO_GPU_MAX_DIM		8192
+#define VIRTIO_GPU_MAX_ENTRIES		16384
+#define VIRTIO_GPU_BYTES_PER_PIXEL	4
+
+struct virtio_gpu_resource {
+	struct dlist head;
+	u32 id;
+	u32 format;
+	u32 width;
+	u32 height;
+	u32 stride;
+	u32 rshift;
+	u32 gshift;
+	u32 bshift;
+	u32 image_pages;
+	u8 *image;
+	u32 nr_entries;
+	struct virtio_gpu_mem_entry *entries;
+};
+
+struct virtio_gpu_dev {
+	struct virtio_device *vdev;
+
+	struct virtio_queue vqs[VIRTIO_GPU_NUM_QUEUES];
+	struct virtio_iovec iov[VIRTIO_GPU_QUEUE_SIZE];
+	struct virtio_gpu_config config;
+	u32 width;
+	u32 height;
+
+	/* Serializes processing of control queue */
+	vmm_spinlock_t ctrl_lock;
+
+	/* Protects resources, scanout and dirty rectangle */
+	vmm_spinlock_t lock;
+	struct dlist res_list;
+	struct virtio_gpu_resource *scanout;
+	struct virtio_gpu_rect scanout_rect;
+	bool dirty;
+	struct virtio_gpu_rect dirty_rect;
+	struct vmm_surface *last_surface;
+
+	char name[VIRTIO_DEVICE_MAX_NAME_LEN];
+	struct vmm_vdisplay *vdis;
+};
+
+union virtio_gpu_ctrl_cmd {
+	struct virtio_gpu_ctrl_hdr hdr;
+	struct virtio_gpu_resource_create_2d create_2d;
+	struct virtio_gpu_resource_unref unref;
+	struct virtio_gpu_set_scanout set_scanout;
+	struct virtio_gpu_resource_flush flush;
+	struct virtio_gpu_transfer_to_host_2d t2d;
+	struct virtio_gpu_resource_attach_backing attach;
+	struct virtio_gpu_resource_detach_backing detach;
+};
+
+static u64 virtio_gpu_get_host_features(struct virtio_device *dev)
+{
+	/* 2D only so no VIRGL and no EDID */
+	return 0;
+}
+
+static void virtio_gpu_set_guest_features(struct virtio_device *dev,
+					  u64 features)
+{
+	/* No host features so, ignore it. */
+}
+
+static int virtio_gpu_init_vq(struct virtio_device *dev,
+			      u32 vq, u32 page_size, u32 align, u32 pfn)
+{
+	int rc;
+	struct virtio_gpu_dev *gdev = dev->emu_data;
+
+	switch (vq) {
+	case VIRTIO_GPU_CTRL_QUEUE:
+	case VIRTIO_GPU_CURSOR_QUEUE:
+		rc = virtio_queue_setup(&gdev->vqs[vq], dev->guest,
+			pfn, page_size, VIRTIO_GPU_QUEUE_SIZE, align);
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	};
+
+	return rc;
+}
+
+static int virtio_gpu_get_pfn_vq(struct virtio_device *dev, u32 vq)
+{
+	int rc;
+	struct virtio_gpu_dev *gdev = dev->emu_data;
+
+	switch (vq) {
+	case VIRTIO_GPU_CTRL_QUEUE:
+	case VIRTIO_GPU_CURSOR_QUEUE:
+		rc = virtio_queue_guest_pfn(&gdev->vqs[vq]);
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	};
+
+	return rc;
+}
+
+static int virtio_gpu_get_size_vq(struct virtio_device *dev, u32 vq)
+{
+	int rc;
+
+	switch (vq) {
+	case VIRTIO_GPU_CTRL_QUEUE:
+	case VIRTIO_GPU_CURSOR_QUEUE:
+		rc = VIRTIO_GPU_QUEUE_SIZE;
+		break;
+	default:
+		rc = 0;
+		break;
+	};
+
+	return rc;
+}
+
+static int virtio_gpu_set_size_vq(struct virtio_device *dev, u32 vq, int size)
+{
+	/* FIXME: dynamic */
+	return size;
+}
+
+/* Read from iovecs starting at given byte offset */
+static u32 virtio_gpu_iov_read(struct virtio_device *dev,
+			       struct virtio_iovec *iov, u32 iov_cnt,
+			       u32 off, void *buf, u32 buf_len)
+{
+	u32 i, len, pos = 0;
+	struct virtio_iovec tiov;
+
+	for (i = 0; (i < iov_cnt) && (pos < buf_len); i++) {
+		if (iov[i].len <= off) {
+			off -= iov[i].len;
+			continue;
+		}
+		tiov.addr = iov[i].addr + off;
+		tiov.len = iov[i].len - off;
+		tiov.flags = iov[i].flags;
+		off = 0;
+
+		len = virtio_iovec_to_buf_read(dev, &tiov, 1,
+					       buf + pos, buf_len - pos);
+		if (!len) {
+			break;
+		}
+		pos += len;
+	}
+
+	return pos;
+}
+
+/* Read from guest backing of resource starting at given byte offset */
+static u32 virtio_gpu_backing_read(struct virtio_device *dev,
+				   struct virtio_gpu_resource *res,
+				   u64 off, void *buf, u32 buf_len)
+{
+	u32 i, len, pos = 0;
+	struct virtio_gpu_mem_entry *e;
+
+	for (i = 0; (i < res->nr_entries) && (pos < buf_len); i++) {
+		e = &res->entries[i];
+		if (e->length <= off) {
+			off -= e->length;
+			continue;
+		}
+		len = min((u32)(e->length - off), buf_len - pos);
+		len = vmm_guest_mapcache_read(&dev->mcache, e->addr + off,
+					      buf + pos, len);
+		if (!len) {
+			break;
+		}
+		pos += len;
+		off = 0;
+	}
+
+	return pos;
+}
+
+/* Note: This function must be called with lock held */
+static struct virtio_gpu_resource *__virtio_gpu_find_res(
+					struct virtio_gpu_dev *gdev, u32 id)
+{
+	struct virtio_gpu_resource *res;
+
+	list_for_each_entry(res, &gdev->res_list, head) {
+		if (res->id == id) {
+			return res;
+		}
+	}
+
+	return NULL;
+}
+
+static bool virtio_gpu_rect_valid(struct virtio_gpu_resource *res,
+				  struct virtio_gpu_rect *r)
+{
+	return ((r->x <= res->width) && (r->y <= res->height) &&
+		(r->width <= (res->width - r->x)) &&
+		(r->height <= (res->height - r->y))) ? TRUE : FALSE;
+}
+
+/* Note: This function must be called with lock held */
+static void __virtio_gpu_mark_dirty(struct virtio_gpu_dev *gdev,
+				    struct virtio_gpu_rect *r)
+{
+	u32 x1, y1, x2, y2;
+	struct virtio_gpu_rect *s = &gdev->scanout_rect;
+
+	/* Clip to scanout rectangle */
+	x1 = max(r->x, s->x);
+	y1 = max(r->y, s->y);
+	x2 = min(r->x + r->width, s->x + s->width);
+	y2 = min(r->y + r->height, s->y + s->height);
+	if ((x2 <= x1) || (y2 <= y1)) {
+		return;
+	}
+
+	/* Grow bounding box of dirty rectangle */
+	if (gdev->dirty) {
+		x1 = min(x1, gdev->dirty_rect.x);
+		y1 = min(y1, gdev->dirty_rect.y);
+		x2 = max(x2, gdev->dirty_rect.x + gdev->dirty_rect.width);
+		y2 = max(y2, gdev->dirty_rect.y + gdev->dirty_rect.height);
+	}
+	gdev->dirty_rect.x = x1;
+	gdev->dirty_rect.y = y1;
+	gdev->dirty_rect.width = x2 - x1;
+	gdev->dirty_rect.height = y2 - y1;
+	gdev->dirty = TRUE;
+}
+
+static void virtio_gpu_res_free(struct virtio_gpu_resource *res)
+{
+	if (res->image) {
+		vmm_host_free_pages((virtual_addr_t)res->image,
+				    res->image_pages);
+	}
+	if (res->entries) {
+		vmm_free(res->entries);
+	}
+	vmm_free(res);
+}
+
+static u32 virtio_gpu_resource_create_2d(struct virtio_gpu_dev *gdev,
+				struct virtio_gpu_resource_create_2d *c)
+{
+	irq_flags_t flags;
+	struct virtio_gpu_resource *res;
+
+	if (!c->resource_id ||
+	    !c->width || (VIRTIO_GPU_MAX_DIM < c->width) ||
+	    !c->height || (VIRTIO_GPU_MAX_DIM < c->height)) {
+		return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+	}
+
+	res = vmm_zalloc(sizeof(*res));
+	if (!res) {
+		return VIRTIO_GPU_RESP_ERR_OUT_OF_MEMORY;
+	}
+	INIT_LIST_HEAD(&res->head);
+	res->id = c->resource_id;
+	res->format = c->format;
+	res->width = c->width;
+	res->height = c->height;
+	res->stride = c->width * VIRTIO_GPU_BYTES_PER_PIXEL;
+
+	/* Component shifts of 32bit little-endian pixel */
+	switch (c->format) {
+	case VIRTIO_GPU_FORMAT_B8G8R8A8_UNORM:
+	case VIRTIO_GPU_FORMAT_B8G8R8X8_UNORM:
+		res->rshift = 16;
+		res->gshift = 8;
+		res->bshift = 0;
+		break;
+	case VIRTIO_GPU_FORMAT_A8R8G8B8_UNORM:
+	case VIRTIO_GPU_FORMAT_X8R8G8B8_UNORM:
+		res->rshift = 8;
+		res->gshift = 16;
+		res->bshift = 24;
+		break;
+	case VIRTIO_GPU_FORMAT_R8G8B8A8_UNORM:
+	case VIRTIO_GPU_FORMAT_R8G8B8X8_UNORM:
+		res->rshift = 0;
+		res->gshift = 8;
+		res->bshift = 16;
+		break;
+	case VIRTIO_GPU_FORMAT_A8B8G8R8_UNORM:
+	case VIRTIO_GPU_FORMAT_X8B8G8R8_UNORM:
+		res->rshift = 24;
+		res->gshift = 16;
+		res->bshift = 8;
+		break;
+	default:
+		vmm_free(res);
+		return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+	};
+
+	res->image_pages = VMM_SIZE_TO_PAGE(res->stride * res->height);
+	res->image = (u8 *)vmm_host_alloc_pages(res->image_pages,
+						VMM_MEMORY_FLAGS_NORMAL);
+	if (!res->image) {
+		vmm_free(res);
+		return VIRTIO_GPU_RESP_ERR_OUT_OF_MEMORY;
+	}
+
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+	if (__virtio_gpu_find_res(gdev, res->id)) {
+		vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+		virtio_gpu_res_free(res);
+		return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+	}
+	list_add_tail(&res->head, &gdev->res_list);
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+
+	return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static u32 virtio_gpu_resource_unref(struct virtio_gpu_dev *gdev,
+				     struct virtio_gpu_resource_unref *c)
+{
+	irq_flags_t flags;
+	struct virtio_gpu_resource *res;
+
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+	res = __virtio_gpu_find_res(gdev, c->resource_id);
+	if (res) {
+		list_del(&res->head);
+		if (gdev->scanout == res) {
+			gdev->scanout = NULL;
+			gdev->dirty = FALSE;
+		}
+	}
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+
+	if (!res) {
+		return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+	}
+	virtio_gpu_res_free(res);
+
+	return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static u32 virtio_gpu_set_scanout(struct virtio_gpu_dev *gdev,
+				  struct virtio_gpu_set_scanout *c)
+{
+	irq_flags_t flags;
+	bool resize = FALSE;
+	struct virtio_gpu_resource *res;
+
+	if (VIRTIO_GPU_NUM_SCANOUTS <= c->scanout_id) {
+		return VIRTIO_GPU_RESP_ERR_INVALID_SCANOUT_ID;
+	}
+
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+
+	/* Resource zero disables the scanout */
+	if (!c->resource_id) {
+		gdev->scanout = NULL;
+		gdev->dirty = FALSE;
+		vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+		vmm_vdisplay_surface_gfx_clear(gdev->vdis);
+		return VIRTIO_GPU_RESP_OK_NODATA;
+	}
+
+	res = __virtio_gpu_find_res(gdev, c->resource_id);
+	if (!res) {
+		vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+		return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+	}
+	if (!c->r.width || !c->r.height ||
+	    !virtio_gpu_rect_valid(res, &c->r)) {
+		vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+		return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+	}
+
+	if (!gdev->scanout ||
+	    (gdev->scanout_rect.width != c->r.width) ||
+	    (gdev->scanout_rect.height != c->r.height)) {
+		resize = TRUE;
+	}
+	gdev->scanout = res;
+	gdev->scanout_rect = c->r;
+	gdev->dirty = FALSE;
+	__virtio_gpu_mark_dirty(gdev, &c->r);
+
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+
+	if (resize) {
+		vmm_vdisplay_surface_gfx_resize(gdev->vdis,
+						c->r.width, c->r.height);
+	}
+
+	return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static u32 virtio_gpu_resource_flush(struct virtio_gpu_dev *gdev,
+				     struct virtio_gpu_resource_flush *c)
+{
+	u32 ret = VIRTIO_GPU_RESP_OK_NODATA;
+	irq_flags_t flags;
+	struct virtio_gpu_resource *res;
+
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+
+	res = __virtio_gpu_find_res(gdev, c->resource_id);
+	if (!res) {
+		ret = VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+	} else if (!virtio_gpu_rect_valid(res, &c->r)) {
+		ret = VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+	} else if (gdev->scanout == res) {
+		__virtio_gpu_mark_dirty(gdev, &c->r);
+	}
+
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+
+	return ret;
+}
+
+static u32 virtio_gpu_transfer_to_host_2d(struct virtio_device *dev,
+				struct virtio_gpu_dev *gdev,
+				struct virtio_gpu_transfer_to_host_2d *c)
+{
+	u32 h, len;
+	u64 src_off, dst_off;
+	irq_flags_t flags;
+	struct virtio_gpu_resource *res;
+
+	/* Resources are only freed by control queue processing which
+	 * is serialized so the resource remains valid after lookup.
+	 */
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+	res = __virtio_gpu_find_res(gdev, c->resource_id);
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+
+	if (!res || !res->nr_entries) {
+		return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+	}
+	if (!virtio_gpu_rect_valid(res, &c->r)) {
+		return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+	}
+
+	if (!c->offset && !c->r.x && !c->r.y && (c->r.width == res->width)) {
+		/* Whole rows in one go */
+		len = res->stride * c->r.height;
+		virtio_gpu_backing_read(dev, res, 0, res->image, len);
+		return VIRTIO_GPU_RESP_OK_NODATA;
+	}
+
+	len = c->r.width * VIRTIO_GPU_BYTES_PER_PIXEL;
+	for (h = 0; h < c->r.height; h++) {
+		src_off = c->offset + (u64)res->stride * h;
+		dst_off = (u64)(c->r.y + h) * res->stride +
+			  c->r.x * VIRTIO_GPU_BYTES_PER_PIXEL;
+		virtio_gpu_backing_read(dev, res, src_off,
+					res->image + dst_off, len);
+	}
+
+	return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static u32 virtio_gpu_resource_attach_backing(struct virtio_device *dev,
+				struct virtio_gpu_dev *gdev,
+				struct virtio_gpu_resource_attach_backing *c,
+				struct virtio_iovec *out, u32 out_cnt)
+{
+	u32 len;
+	irq_flags_t flags;
+	struct virtio_gpu_mem_entry *entries;
+	struct virtio_gpu_resource *res;
+
+	if (!c->nr_entries || (VIRTIO_GPU_MAX_ENTRIES < c->nr_entries)) {
+		return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+	}
+
+	len = c->nr_entries * sizeof(*entries);
+	entries = vmm_malloc(len);
+	if (!entries) {
+		return VIRTIO_GPU_RESP_ERR_OUT_OF_MEMORY;
+	}
+	if (virtio_gpu_iov_read(dev, out, out_cnt, sizeof(*c),
+				entries, len) != len) {
+		vmm_free(entries);
+		return VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;
+	}
+
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+	res = __virtio_gpu_find_res(gdev, c->resource_id);
+	if (res && !res->entries) {
+		res->entries = entries;
+		res->nr_entries = c->nr_entries;
+		entries = NULL;
+	}
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+
+	if (entries) {
+		vmm_free(entries);
+		return (res) ? VIRTIO_GPU_RESP_ERR_UNSPEC :
+			       VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+	}
+
+	return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static u32 virtio_gpu_resource_detach_backing(struct virtio_gpu_dev *gdev,
+				struct virtio_gpu_resource_detach_backing *c)
+{
+	irq_flags_t flags;
+	struct virtio_gpu_mem_entry *entries = NULL;
+	struct virtio_gpu_resource *res;
+
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+	res = __virtio_gpu_find_res(gdev, c->resource_id);
+	if (res) {
+		entries = res->entries;
+		res->entries = NULL;
+		res->nr_entries = 0;
+	}
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+
+	if (!res) {
+		return VIRTIO_GPU_RESP_ERR_INVALID_RESOURCE_ID;
+	}
+	if (entries) {
+		vmm_free(entries);
+	}
+
+	return VIRTIO_GPU_RESP_OK_NODATA;
+}
+
+static u32 virtio_gpu_process_cmd(struct virtio_device *dev,
+				  struct virtio_gpu_dev *gdev,
+				  struct virtio_iovec *out, u32 out_cnt,
+				  struct virtio_iovec *in, u32 in_cnt)
+{
+	u32 len, resp_len;
+	union virtio_gpu_ctrl_cmd cmd;
+	struct virtio_gpu_resp_display_info resp;
+
+	memset(&cmd, 0, sizeof(cmd));
+	memset(&resp, 0, sizeof(resp));
+	resp_len = sizeof(resp.hdr);
+
+	len = virtio_iovec_to_buf_read(dev, out, out_cnt, &cmd, sizeof(cmd));
+	if (len < sizeof(cmd.hdr)) {
+		resp.hdr.type = VIRTIO_GPU_RESP_ERR_UNSPEC;
+		goto done;
+	}
+
+#define CMD_LEN_CHECK(__c)						\
+	if (len < sizeof(cmd.__c)) {					\
+		resp.hdr.type = VIRTIO_GPU_RESP_ERR_INVALID_PARAMETER;	\
+		break;							\
+	}
+
+	switch (cmd.hdr.type) {
+	case VIRTIO_GPU_CMD_GET_DISPLAY_INFO:
+		resp.hdr.type = VIRTIO_GPU_RESP_OK_DISPLAY_INFO;
+		resp.pmodes[0].r.width = gdev->width;
+		resp.pmodes[0].r.height = gdev->height;
+		resp.pmodes[0].enabled = 1;
+		resp_len = sizeof(resp);
+		break;
+	case VIRTIO_GPU_CMD_RESOURCE_CREATE_2D:
+		CMD_LEN_CHECK(create_2d);
+		resp.hdr.type =
+			virtio_gpu_resource_create_2d(gdev, &cmd.create_2d);
+		break;
+	case VIRTIO_GPU_CMD_RESOURCE_UNREF:
+		CMD_LEN_CHECK(unref);
+		resp.hdr.type = virtio_gpu_resource_unref(gdev, &cmd.unref);
+		break;
+	case VIRTIO_GPU_CMD_SET_SCANOUT:
+		CMD_LEN_CHECK(set_scanout);
+		resp.hdr.type =
+			virtio_gpu_set_scanout(gdev, &cmd.set_scanout);
+		break;
+	case VIRTIO_GPU_CMD_RESOURCE_FLUSH:
+		CMD_LEN_CHECK(flush);
+		resp.hdr.type = virtio_gpu_resource_flush(gdev, &cmd.flush);
+		break;
+	case VIRTIO_GPU_CMD_TRANSFER_TO_HOST_2D:
+		CMD_LEN_CHECK(t2d);
+		resp.hdr.type =
+			virtio_gpu_transfer_to_host_2d(dev, gdev, &cmd.t2d);
+		break;
+	case VIRTIO_GPU_CMD_RESOURCE_ATTACH_BACKING:
+		CMD_LEN_CHECK(attach);
+		resp.hdr.type = virtio_gpu_resource_attach_backing(dev,
+					gdev, &cmd.attach, out, out_cnt);
+		break;
+	case VIRTIO_GPU_CMD_RESOURCE_DETACH_BACKING:
+		CMD_LEN_CHECK(detach);
+		resp.hdr.type =
+			virtio_gpu_resource_detach_backing(gdev, &cmd.detach);
+		break;
+	default:
+		/* No 3D, capsets or EDID */
+		resp.hdr.type = VIRTIO_GPU_RESP_ERR_UNSPEC;
+		break;
+	};
+
+#undef CMD_LEN_CHECK
+
+done:
+	/* Commands are completed synchronously so fences are
+	 * signaled by simply echoing them back.
+	 */
+	if (cmd.hdr.flags & VIRTIO_GPU_FLAG_FENCE) {
+		resp.hdr.flags = VIRTIO_GPU_FLAG_FENCE;
+		resp.hdr.fence_id = cmd.hdr.fence_id;
+		resp.hdr.ctx_id = cmd.hdr.ctx_id;
+	}
+
+	return virtio_buf_to_iovec_write(dev, in, in_cnt, &resp, resp_len);
+}
+
+static int virtio_gpu_do_ctrl(struct virtio_device *dev,
+			      struct virtio_gpu_dev *gdev)
+{
+	u16 head = 0;
+	u32 len, out_cnt, iov_cnt = 0, total_len = 0;
+	struct virtio_queue *vq = &gdev->vqs[VIRTIO_GPU_CTRL_QUEUE];
+	struct virtio_iovec *iov = gdev->iov;
+
+	vmm_spin_lock(&gdev->ctrl_lock);
+
+	while (virtio_queue_available(vq)) {
+		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+
+		/* Device writable iovecs follow the driver readable ones */
+		for (out_cnt = 0; out_cnt < iov_cnt; out_cnt++) {
+			if (iov[out_cnt].flags) {
+				break;
+			}
+		}
+
+		len = virtio_gpu_process_cmd(dev, gdev, iov, out_cnt,
+					     &iov[out_cnt], iov_cnt - out_cnt);
+
+		virtio_queue_set_used_elem(vq, head, len);
+	}
+
+	vmm_spin_unlock(&gdev->ctrl_lock);
+
+	if (virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, VIRTIO_GPU_CTRL_QUEUE);
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_gpu_do_cursor(struct virtio_device *dev,
+				struct virtio_gpu_dev *gdev)
+{
+	u16 head = 0;
+	u32 iov_cnt = 0, total_len = 0;
+	struct virtio_queue *vq = &gdev->vqs[VIRTIO_GPU_CURSOR_QUEUE];
+	struct virtio_iovec *iov = gdev->iov;
+
+	vmm_spin_lock(&gdev->ctrl_lock);
+
+	/* Cursor is not supported so just consume cursor commands */
+	while (virtio_queue_available(vq)) {
+		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+		virtio_queue_set_used_elem(vq, head, 0);
+	}
+
+	vmm_spin_unlock(&gdev->ctrl_lock);
+
+	if (virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, VIRTIO_GPU_CURSOR_QUEUE);
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_gpu_notify_vq(struct virtio_device *dev, u32 vq)
+{
+	int rc = VMM_OK;
+	struct virtio_gpu_dev *gdev = dev->emu_data;
+
+	switch (vq) {
+	case VIRTIO_GPU_CTRL_QUEUE:
+		rc = virtio_gpu_do_ctrl(dev, gdev);
+		break;
+	case VIRTIO_GPU_CURSOR_QUEUE:
+		rc = virtio_gpu_do_cursor(dev, gdev);
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	}
+
+	return rc;
+}
+
+static void virtio_gpu_display_invalidate(struct vmm_vdisplay *vdis)
+{
+	irq_flags_t flags;
+	struct virtio_gpu_dev *gdev = vmm_vdisplay_priv(vdis);
+
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+	if (gdev->scanout) {
+		__virtio_gpu_mark_dirty(gdev, &gdev->scanout_rect);
+	}
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+}
+
+static int virtio_gpu_display_pixeldata(struct vmm_vdisplay *vdis,
+					struct vmm_pixelformat *pf,
+					u32 *rows, u32 *cols,
+					physical_addr_t *pa)
+{
+	int rc = VMM_OK;
+	u32 i, reg_flags;
+	irq_flags_t flags;
+	physical_addr_t gpa, hpa;
+	physical_size_t gsz, hsz;
+	struct virtio_gpu_resource *res;
+	struct virtio_gpu_dev *gdev = vmm_vdisplay_priv(vdis);
+
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+
+	/* Only whole resource with default 32bpp layout and
+	 * contiguous guest backing can be shown directly.
+	 */
+	res = gdev->scanout;
+	if (!res || !res->nr_entries ||
+	    gdev->scanout_rect.x || gdev->scanout_rect.y ||
+	    (gdev->scanout_rect.width != res->width) ||
+	    (gdev->scanout_rect.height != res->height) ||
+	    (res->rshift != 16) || (res->gshift != 8) || (res->bshift != 0)) {
+		rc = VMM_ENOTAVAIL;
+		goto done;
+	}
+
+	gpa = res->entries[0].addr;
+	gsz = res->entries[0].length;
+	for (i = 1; i < res->nr_entries; i++) {
+		if (res->entries[i].addr != (gpa + gsz)) {
+			break;
+		}
+		gsz += res->entries[i].length;
+	}
+	if (gsz < ((physical_size_t)res->stride * res->height)) {
+		rc = VMM_ENOTAVAIL;
+		goto done;
+	}
+	gsz = (physical_size_t)res->stride * res->height;
+
+	rc = vmm_guest_physical_map(gdev->vdev->guest, gpa, gsz,
+				    &hpa, &hsz, &reg_flags);
+	if (rc) {
+		goto done;
+	}
+	if (!(reg_flags & VMM_REGION_REAL) ||
+	    !(reg_flags & VMM_REGION_MEMORY) ||
+	    !(reg_flags & VMM_REGION_ISRAM) ||
+	    (hsz < gsz)) {
+		rc = VMM_EINVALID;
+		goto done;
+	}
+
+	vmm_pixelformat_init_default(pf, 32);
+	*rows = res->height;
+	*cols = res->width;
+	*pa = hpa;
+
+done:
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+
+	return rc;
+}
+
+static void virtio_gpu_convert_row(struct vmm_surface *sf, int bpp,
+				   struct virtio_gpu_resource *res,
+				   u8 *dst, const u32 *src, u32 width)
+{
+	u32 i, p, r, g, b;
+
+	/* Default 32bpp layout matches B8G8R8X8 */
+	if ((bpp == 32) && (res->rshift == 16) &&
+	    (res->gshift == 8) && (res->bshift == 0) &&
+	    vmm_surface_direct_write(sf)) {
+		memcpy(dst, src, width * 4);
+		return;
+	}
+
+	for (i = 0; i < width; i++) {
+		p = src[i];
+		r = (p >> res->rshift) & 0xff;
+		g = (p >> res->gshift) & 0xff;
+		b = (p >> res->bshift) & 0xff;
+		switch (bpp) {
+		case 8:
+			vmm_surface_write8(sf, dst, rgb_to_pixel8(r, g, b));
+			dst += 1;
+			break;
+		case 15:
+			vmm_surface_write16(sf, (u16 *)dst,
+					    rgb_to_pixel15(r, g, b));
+			dst += 2;
+			break;
+		case 16:
+			vmm_surface_write16(sf, (u16 *)dst,
+					    rgb_to_pixel16(r, g, b));
+			dst += 2;
+			break;
+		case 24:
+			p = rgb_to_pixel24(r, g, b);
+			vmm_surface_write8(sf, dst, p);
+			vmm_surface_write8(sf, dst + 1, p >> 8);
+			vmm_surface_write8(sf, dst + 2, p >> 16);
+			dst += 3;
+			break;
+		case 32:
+			vmm_surface_write32(sf, (u32 *)dst,
+					    rgb_to_pixel32(r, g, b));
+			dst += 4;
+			break;
+		default:
+			return;
+		};
+	}
+}
+
+static void virtio_gpu_display_update(struct vmm_vdisplay *vdis,
+				      struct vmm_surface *sf)
+{
+	int bpp;
+	u32 y, x1, y1, w, h;
+	irq_flags_t flags;
+	u8 *dst;
+	const u8 *src;
+	struct virtio_gpu_resource *res;
+	struct virtio_gpu_dev *gdev = vmm_vdisplay_priv(vdis);
+
+	bpp = vmm_surface_bits_per_pixel(sf);
+	if (!bpp) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+
+	res = gdev->scanout;
+	if (!res) {
+		goto unlock;
+	}
+
+	/* Dirty rectangle is shared by all surfaces so a surface
+	 * other than last updated one is redrawn completely.
+	 */
+	if (gdev->last_surface != sf) {
+		gdev->last_surface = sf;
+		__virtio_gpu_mark_dirty(gdev, &gdev->scanout_rect);
+	}
+	if (!gdev->dirty) {
+		goto unlock;
+	}
+	gdev->dirty = FALSE;
+
+	/* Dirty rectangle relative to scanout clipped to surface */
+	x1 = gdev->dirty_rect.x - gdev->scanout_rect.x;
+	y1 = gdev->dirty_rect.y - gdev->scanout_rect.y;
+	if ((vmm_surface_width(sf) <= x1) ||
+	    (vmm_surface_height(sf) <= y1)) {
+		goto unlock;
+	}
+	w = min(gdev->dirty_rect.width, (u32)vmm_surface_width(sf) - x1);
+	h = min(gdev->dirty_rect.height, (u32)vmm_surface_height(sf) - y1);
+
+	for (y = 0; y < h; y++) {
+		src = res->image +
+		      (gdev->dirty_rect.y + y) * res->stride +
+		      gdev->dirty_rect.x * VIRTIO_GPU_BYTES_PER_PIXEL;
+		dst = (u8 *)vmm_surface_data(sf) +
+		      (y1 + y) * vmm_surface_stride(sf) +
+		      x1 * vmm_surface_bytes_per_pixel(sf);
+		virtio_gpu_convert_row(sf, bpp, res, dst,
+				       (const u32 *)src, w);
+	}
+
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+
+	vmm_vdisplay_surface_gfx_update(vdis, x1, y1, w, h);
+
+	return;
+
+unlock:
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+}
+
+static struct vmm_vdisplay_ops virtio_gpu_display_ops = {
+	.invalidate = virtio_gpu_display_invalidate,
+	.gfx_pixeldata = virtio_gpu_display_pixeldata,
+	.gfx_update = virtio_gpu_display_update,
+};
+
+static int virtio_gpu_read_config(struct virtio_device *dev,
+				  u32 offset, void *dst, u32 dst_len)
+{
+	struct virtio_gpu_dev *gdev = dev->emu_data;
+	u8 *src = (u8 *)&gdev->config;
+	u32 i, src_len = sizeof(gdev->config);
+
+	for (i = 0; (i < dst_len) && ((offset + i) < src_len); i++) {
+		*((u8 *)dst + i) = src[offset + i];
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_gpu_write_config(struct virtio_device *dev,
+				   u32 offset, void *src, u32 src_len)
+{
+	struct virtio_gpu_dev *gdev = dev->emu_data;
+
+	if ((offset == offsetof(struct virtio_gpu_config, events_clear)) &&
+	    (src_len == 4)) {
+		gdev->config.events_read &= ~(*(u32 *)src);
+	}
+
+	/* Ignore config writes to other parts of gpu config space */
+
+	return VMM_OK;
+}
+
+static void virtio_gpu_free_resources(struct virtio_gpu_dev *gdev)
+{
+	irq_flags_t flags;
+	struct virtio_gpu_resource *res;
+
+	vmm_spin_lock_irqsave(&gdev->lock, flags);
+
+	gdev->scanout = NULL;
+	gdev->dirty = FALSE;
+	while (!list_empty(&gdev->res_list)) {
+		res = list_first_entry(&gdev->res_list,
+				       struct virtio_gpu_resource, head);
+		list_del(&res->head);
+		vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+		virtio_gpu_res_free(res);
+		vmm_spin_lock_irqsave(&gdev->lock, flags);
+	}
+
+	vmm_spin_unlock_irqrestore(&gdev->lock, flags);
+}
+
+static int virtio_gpu_reset(struct virtio_device *dev)
+{
+	int rc;
+	struct virtio_gpu_dev *gdev = dev->emu_data;
+
+	virtio_gpu_free_resources(gdev);
+	gdev->config.events_read = 0;
+
+	rc = virtio_queue_cleanup(&gdev->vqs[VIRTIO_GPU_CTRL_QUEUE]);
+	if (rc) {
+		return rc;
+	}
+
+	rc = virtio_queue_cleanup(&gdev->vqs[VIRTIO_GPU_CURSOR_QUEUE]);
+	if (rc) {
+		return rc;
+	}
+
+	vmm_vdisplay_surface_gfx_clear(gdev->vdis);
+
+	return VMM_OK;
+}
+
+static int virtio_gpu_connect(struct virtio_device *dev,
+			      struct virtio_emulator *emu)
+{
+	struct virtio_gpu_dev *gdev;
+
+	gdev = vmm_zalloc(sizeof(struct virtio_gpu_dev));
+	if (!gdev) {
+		vmm_printf("Failed to allocate virtio gpu device....\n");
+		return VMM_ENOMEM;
+	}
+	gdev->vdev = dev;
+	INIT_SPIN_LOCK(&gdev->ctrl_lock);
+	INIT_SPIN_LOCK(&gdev->lock);
+	INIT_LIST_HEAD(&gdev->res_list);
+
+	if (vmm_devtree_read_u32(dev->edev->node, "width", &gdev->width) ||
+	    !gdev->width || (VIRTIO_GPU_MAX_DIM < gdev->width)) {
+		gdev->width = VIRTIO_GPU_DEFAULT_WIDTH;
+	}
+	if (vmm_devtree_read_u32(dev->edev->node, "height", &gdev->height) ||
+	    !gdev->height || (VIRTIO_GPU_MAX_DIM < gdev->height)) {
+		gdev->height = VIRTIO_GPU_DEFAULT_HEIGHT;
+	}
+
+	gdev->config.num_scanouts = VIRTIO_GPU_NUM_SCANOUTS;
+
+	vmm_snprintf(gdev->name, VIRTIO_DEVICE_MAX_NAME_LEN, "%s", dev->name);
+	gdev->vdis = vmm_vdisplay_create(gdev->name,
+					 &virtio_gpu_display_ops, gdev);
+	if (!gdev->vdis) {
+		vmm_free(gdev);
+		return VMM_ENOMEM;
+	}
+
+	dev->emu_data = gdev;
+
+	return VMM_OK;
+}
+
+static void virtio_gpu_disconnect(struct virtio_device *dev)
+{
+	struct virtio_gpu_dev *gdev = dev->emu_data;
+
+	vmm_vdisplay_destroy(gdev->vdis);
+	virtio_gpu_free_resources(gdev);
+	vmm_free(gdev);
+}
+
+struct virtio_device_id virtio_gpu_emu_id[] = {
+	{.type = VIRTIO_ID_GPU},
+	{ },
+};
+
+struct virtio_emulator virtio_gpu = {
+	.name = "virtio_gpu",
+	.id_table = virtio_gpu_emu_id,
+
+	/* VirtIO operations */
+	.get_host_features      = virtio_gpu_get_host_features,
+	.set_guest_features     = virtio_gpu_set_guest_features,
+	.init_vq                = virtio_gpu_init_vq,
+	.get_pfn_vq             = virtio_gpu_get_pfn_vq,
+	.get_size_vq            = virtio_gpu_get_size_vq,
+	.set_size_vq            = virtio_gpu_set_size_vq,
+	.notify_vq              = virtio_gpu_notify_vq,
+
+	/* Emulator operations */
+	.read_config = virtio_gpu_read_config,
+	.write_config = virtio_gpu_write_config,
+	.reset = virtio_gpu_reset,
+	.connect = virtio_gpu_connect,
+	.disconnect = virtio_gpu_disconnect,
+};
+
+static int __init virtio_gpu_init(void)
+{
+	return virtio_register_emulator(&virtio_gpu);
+}
+
+static void __exit virtio_gpu_exit(void)
+{
+	virtio_unregister_emulator(&virtio_gpu);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
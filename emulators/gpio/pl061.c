@@ -354,6 +354,43 @@ static int pl061_emulator_reset(struct vmm_emudev *edev)
 	return VMM_OK;
 }
 
+/* Registers from locked till amsel are saved as one block */
+#define PL061_REGS_SIZE		(offsetof(struct pl061_state, irq) - \
+				 offsetof(struct pl061_state, locked))
+
+static int pl061_emulator_save(struct vmm_emudev *edev,
+			       struct vmm_snapshot_state *st)
+{
+	int rc;
+	struct pl061_state *s = edev->priv;
+
+	vmm_spin_lock(&s->lock);
+	rc = vmm_snapshot_put(st, &s->locked, PL061_REGS_SIZE);
+	vmm_spin_unlock(&s->lock);
+
+	return rc;
+}
+
+static int pl061_emulator_restore(struct vmm_emudev *edev,
+				  struct vmm_snapshot_state *st)
+{
+	int rc;
+	struct pl061_state *s = edev->priv;
+
+	vmm_spin_lock(&s->lock);
+
+	rc = vmm_snapshot_get(st, &s->locked, PL061_REGS_SIZE);
+	if (!rc) {
+		/* Force update of all output lines */
+		s->old_data = ~((s->data & s->dir) | ~s->dir);
+		pl061_update(s);
+	}
+
+	vmm_spin_unlock(&s->lock);
+
+	return rc;
+}
+
 /* Process IRQ asserted in device emulation framework */
 static void pl061_irq_handle(u32 irq, int cpu, int level, void *opaque)
 {
@@ -519,6 +556,8 @@ static struct vmm_emulator pl061_emulator = {
 	.read32 = pl061_emulator_read32,
 	.write32 = pl061_emulator_write32,
 	.reset = pl061_emulator_reset,
+	.save = pl061_emulator_save,
+	.restore = pl061_emulator_restore,
 	.remove = pl061_emulator_remove,
 };
 
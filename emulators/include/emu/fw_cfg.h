@@ -65,6 +65,27 @@
 
 #define FW_CFG_INVALID          0xffff
 
+/* FW_CFG_ID feature bits */
+#define FW_CFG_VERSION          0x01
+#define FW_CFG_VERSION_DMA      0x02
+
+/* FW_CFG_DMA signature ("QEMU CFG" read as big-endian) */
+#define FW_CFG_DMA_SIGNATURE    0x51454d5520434647ULL
+
+/* FW_CFG_DMA control bits */
+#define FW_CFG_DMA_CTL_ERROR    0x01
+#define FW_CFG_DMA_CTL_READ     0x02
+#define FW_CFG_DMA_CTL_SKIP     0x04
+#define FW_CFG_DMA_CTL_SELECT   0x08
+#define FW_CFG_DMA_CTL_WRITE    0x10
+
+/* FW_CFG_DMA descriptor in guest memory (all fields big-endian) */
+typedef struct fw_cfg_dma_access {
+	u32 control;
+	u32 length;
+	u64 address;
+} __packed fw_cfg_dma_access_t;
+
 #define FW_CFG_MAX_FILE_PATH    56
 
 typedef struct fw_cfg_file {
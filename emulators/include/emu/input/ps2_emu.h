@@ -117,6 +117,7 @@ struct ps2_emu_mouse {
 	int mouse_dy;
 	int mouse_dz;
 	u8 mouse_buttons;
+	bool mouse_buttons_changed;
 	struct vmm_vmouse *mouse;
 };
 
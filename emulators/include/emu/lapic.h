@@ -51,6 +51,8 @@
 #define APIC_TRIGGER_LEVEL              1
 
 #define APIC_LVT_TIMER_PERIODIC         (1<<17)
+#define APIC_LVT_TIMER_TSCDEADLINE      (2<<17)
+#define APIC_LVT_TIMER_MODE_MASK        (3<<17)
 #define APIC_LVT_MASKED                 (1<<16)
 #define APIC_LVT_LEVEL_TRIGGER          (1<<15)
 #define APIC_LVT_REMOTE_IRR             (1<<14)
@@ -70,6 +72,9 @@
 #define APIC_DEFAULT_ADDRESS		0xfee00000
 #define APIC_SPACE_SIZE			0x100000
 
+#define APIC_X2APIC_MSR_BASE		0x800
+#define APIC_X2APIC_MSR_END		0x8ff
+
 typedef struct apic_state apic_state_t;
 
 struct apic_state {
@@ -94,6 +99,7 @@ struct apic_state {
 	u32 initial_count;
 	s64 initial_count_load_time;
 	s64 next_time;
+	u64 tsc_deadline; /* guest TSC value at which timer fires */
 	int idx;
 	struct vmm_timer_event timer;
 	s64 timer_expiry;
@@ -106,4 +112,23 @@ struct apic_state {
 	struct vmm_spinlock state_lock;
 };
 
+/** LAPIC MSR (APIC base and x2APIC registers) access handlers */
+typedef int (*apic_msr_read_t)(void *opaque, struct vmm_vcpu *vcpu,
+			       u32 msr, u64 *val);
+typedef int (*apic_msr_write_t)(void *opaque, struct vmm_vcpu *vcpu,
+				u32 msr, u64 val);
+
+/** Register LAPIC MSR handlers of guest with architecture code
+ *  Note: Pass NULL handlers to unregister.
+ */
+void arch_set_guest_lapic(struct vmm_guest *guest, void *opaque,
+			  apic_msr_read_t msr_read,
+			  apic_msr_write_t msr_write);
+
+/** Current guest TSC of given VCPU (used by TSC-deadline timer) */
+u64 arch_guest_tsc_read(struct vmm_vcpu *vcpu);
+
+/** Convert guest TSC ticks to nanoseconds */
+u64 arch_guest_tsc_to_ns(u64 tsc);
+
 #endif /* !_APIC_H */
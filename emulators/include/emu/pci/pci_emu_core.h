@@ -70,8 +70,17 @@
 #define PCI_CONFIG_MIN_GNT_OFFS		62
 #define PCI_CONFIG_MAX_LAT_OFFS		63
 
+/* BAR space indicator bit (set for I/O space BARs) */
+#define PCI_CONFIG_BAR_SPACE_IO		0x01
+
+/* Status register bit indicating capability list */
+#define PCI_CONFIG_STATUS_CAP_LIST	0x10
+
+/* Vendor specific capability ID */
+#define PCI_CONFIG_CAP_ID_VNDR		0x09
+
 struct pci_device;
-struct pci_bus;
+struct pci_emu_bus;
 struct pci_host_controller;
 struct pci_conf_header;
 struct pci_class;
@@ -109,6 +118,8 @@ struct pci_conf_header {
 
 struct pci_class {
 	struct pci_conf_header conf_header;
+	/* Writable bits of each byte of conf_header */
+	u8 conf_wmask[PCI_CONFIG_HEADER_SIZE];
 	vmm_spinlock_t lock;
 	pci_config_read_t config_read;
 	pci_config_write_t config_write;
@@ -123,9 +134,12 @@ struct pci_host_controller {
 	struct dlist attached_buses;
 	struct dlist head;
 	struct vmm_guest *guest;
+	/* Dense index of devices by (bus << 8 | devfn) */
+	u32 nr_devs;
+	struct pci_device **devs;
 };
 
-struct pci_bus {
+struct pci_emu_bus {
 	struct dlist head;
 	u16 bus_id;
 	struct vmm_spinlock lock;
@@ -137,7 +151,7 @@ struct pci_device {
 	struct pci_class class;
 	u32 device_id; /* ID for responding to BDF */
 	struct dlist head;
-	struct pci_bus *pci_bus;
+	struct pci_emu_bus *pci_bus;
 	struct vmm_guest *guest;
 	struct vmm_devtree_node *node;
 	struct vmm_spinlock lock;
@@ -157,7 +171,7 @@ struct pci_dev_emulator {
 
 int pci_emu_register_device(struct pci_dev_emulator *emu);
 int pci_emu_unregister_device(struct pci_dev_emulator *emu);
-struct pci_bus *pci_find_bus_by_id(struct pci_host_controller *controller,
+struct pci_emu_bus *pci_find_bus_by_id(struct pci_host_controller *controller,
 				   u32 bus_id);
 struct pci_dev_emulator *pci_emu_find_device(const char *name);
 int pci_emu_find_pci_device(struct pci_host_controller *controller,
@@ -172,7 +186,9 @@ int pci_emu_register_controller(struct vmm_devtree_node *node, struct vmm_guest
 				struct pci_host_controller *controller);
 int pci_emu_attach_new_pci_bus(struct pci_host_controller *controller, u32 bus_id);
 int pci_emu_detach_pci_bus(struct pci_host_controller *controller, u32 bus_id);
-int pci_emu_config_space_write(struct pci_class *class, u32 reg_offs, u32 val);
+void pci_emu_config_space_init(struct pci_class *class);
+int pci_emu_config_space_write(struct pci_class *class, u32 reg_offs,
+			       u32 val, u32 size);
 u32 pci_emu_config_space_read(struct pci_class *class, u32 reg_offs, u32 size);
 int __init pci_devemu_init(void);
 
@@ -24,6 +24,7 @@
 #define __VIRTIO_H__
 
 #include <vmm_types.h>
+#include <vmm_guest_aspace.h>
 #include <libs/list.h>
 
 #include <emu/virtio_queue.h>
@@ -50,6 +51,7 @@ enum virtio_id {
 	VIRTIO_ID_GPU		= 16, /* GPU device */
 	VIRTIO_ID_TIMER		= 17, /* Timer/Clock device */
 	VIRTIO_ID_INPUT		= 18, /* Input device */
+	VIRTIO_ID_MEM		= 24, /* Memory device */
 };
 
 struct virtio_device_id {
@@ -70,12 +72,17 @@ struct virtio_device {
 
 	struct dlist node;
 	struct vmm_guest *guest;
+
+	/* Cached guest RAM mappings used by iovec helpers */
+	struct vmm_guest_mapcache mcache;
 };
 
 struct virtio_transport {
 	const char *name;
 
 	int  (*notify)(struct virtio_device *, u32 vq);
+	/* Optional, signals change of device config space to guest */
+	int  (*notify_config)(struct virtio_device *);
 };
 
 struct virtio_emulator {
@@ -83,10 +90,14 @@ struct virtio_emulator {
 	const struct virtio_device_id *id_table;
 
 	/* VirtIO operations */
-	u32 (*get_host_features) (struct virtio_device *dev);
-	void (*set_guest_features) (struct virtio_device *dev, u32 features);
+	u64 (*get_host_features) (struct virtio_device *dev);
+	void (*set_guest_features) (struct virtio_device *dev, u64 features);
 	int (*init_vq) (struct virtio_device *dev, u32 vq, u32 page_size,
 				u32 align, u32 pfn);
+	/* Optional, required for emulators offering VIRTIO_F_VERSION_1 */
+	int (*init_vq_addr) (struct virtio_device *dev, u32 vq, u32 num,
+				physical_addr_t desc, physical_addr_t driver,
+				physical_addr_t device);
 	int (*get_pfn_vq) (struct virtio_device *dev, u32 vq);
 	int (*get_size_vq) (struct virtio_device *dev, u32 vq);
 	int (*set_size_vq) (struct virtio_device *dev, u32 vq, int size);
@@ -112,6 +123,8 @@ int virtio_config_write(struct virtio_device *dev,
 
 int virtio_reset(struct virtio_device *dev);
 
+struct virtio_device *virtio_find_device(const char *name);
+
 int virtio_register_device(struct virtio_device *dev);
 
 void virtio_unregister_device(struct virtio_device *dev);
@@ -0,0 +1,80 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file virtio_bench.h
+ * @author agent (agent@local)
+ * @brief VirtIO loopback benchmark driver interface
+ *
+ * The benchmark driver stands in for guest driver of a VirtIO device.
+ * It swaps transport of the device with a loopback transport, places
+ * virtqueues and buffers in guest RAM and directly invokes emulator
+ * operations. Guest RAM content is clobbered hence the Guest must be
+ * stopped (i.e. all VCPUs in reset or paused state) and reset after
+ * benchmarking.
+ */
+#ifndef __VIRTIO_BENCH_H__
+#define __VIRTIO_BENCH_H__
+
+#include <vmm_types.h>
+
+/** Maximum requests in flight */
+#define VIRTIO_BENCH_MAX_QDEPTH			64
+
+struct virtio_bench_params {
+	/* Requests kept in flight */
+	u32 qdepth;
+	/* Block size or packet size in bytes */
+	u32 size;
+	/* Total number of requests */
+	u32 count;
+	/* Block: write instead of read */
+	bool write;
+};
+
+struct virtio_bench_stats {
+	/* Completed and failed requests */
+	u32 done;
+	u32 errors;
+	/* Bytes transferred and time taken in nanoseconds */
+	u64 bytes;
+	u64 nsecs;
+	/* Request latency in nanoseconds */
+	u64 lat_min;
+	u64 lat_avg;
+	u64 lat_p50;
+	u64 lat_p90;
+	u64 lat_p99;
+	u64 lat_p999;
+	u64 lat_max;
+};
+
+/** Benchmark VirtIO block device with given name */
+int virtio_bench_blk(const char *name,
+		     const struct virtio_bench_params *params,
+		     struct virtio_bench_stats *stats);
+
+/** Benchmark transmit of VirtIO net device with given name and
+ *  optionally receive of packets by peer VirtIO net device attached
+ *  to same netswitch (peer can be NULL).
+ */
+int virtio_bench_net(const char *name, const char *peer,
+		     const struct virtio_bench_params *params,
+		     struct virtio_bench_stats *tx_stats,
+		     struct virtio_bench_stats *rx_stats);
+
+#endif /* __VIRTIO_BENCH_H__ */
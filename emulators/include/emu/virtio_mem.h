@@ -0,0 +1,155 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file virtio_mem.h
+ * @author agent (agent@local)
+ * @brief VirtIO Memory Device Interface.
+ *
+ * This header has been derived from linux kernel source:
+ * <linux_source>/include/uapi/linux/virtio_mem.h
+ *
+ * The original header is BSD licensed.
+ */
+
+/*
+ * This header is BSD licensed so anyone can use the definitions
+ * to implement compatible drivers/servers:
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of IBM nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL IBM OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL,
+ * SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT
+ * LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF
+ * USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ * ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT
+ * OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+#ifndef __VIRTIO_MEM_H_
+#define __VIRTIO_MEM_H_
+
+#include <vmm_types.h>
+
+/* The feature bitmap for virtio mem */
+#define VIRTIO_MEM_F_ACPI_PXM		0 /* node_id is an ACPI PXM */
+#define VIRTIO_MEM_F_UNPLUGGED_INACCESSIBLE 1 /* unplugged memory is
+						  * not accessible */
+
+/* Request to plug memory blocks */
+#define VIRTIO_MEM_REQ_PLUG		0
+/* Request to unplug memory blocks */
+#define VIRTIO_MEM_REQ_UNPLUG		1
+/* Request to unplug all memory blocks */
+#define VIRTIO_MEM_REQ_UNPLUG_ALL	2
+/* Request information about the plugged state of memory blocks */
+#define VIRTIO_MEM_REQ_STATE		3
+
+struct virtio_mem_req_range {
+	u64 addr;
+	u16 nb_blocks;
+	u16 padding[3];
+} __attribute__((packed));
+
+struct virtio_mem_req {
+	u16 type;
+	u16 padding[3];
+	/* Plug, unplug and state requests share same layout */
+	struct virtio_mem_req_range u;
+} __attribute__((packed));
+
+/* Request processed successfully */
+#define VIRTIO_MEM_RESP_ACK		0
+/* Request denied, e.g. trying to plug more than requested */
+#define VIRTIO_MEM_RESP_NACK		1
+/* Request cannot be processed right now, try again later */
+#define VIRTIO_MEM_RESP_BUSY		2
+/* Error in request (e.g. addresses/alignment) */
+#define VIRTIO_MEM_RESP_ERROR		3
+
+/* State of memory blocks is "plugged" */
+#define VIRTIO_MEM_STATE_PLUGGED	0
+/* State of memory blocks is "unplugged" */
+#define VIRTIO_MEM_STATE_UNPLUGGED	1
+/* State of memory blocks is "mixed" */
+#define VIRTIO_MEM_STATE_MIXED		2
+
+struct virtio_mem_resp {
+	u16 type;
+	u16 padding[3];
+	/* Valid only for state requests */
+	u16 state;
+} __attribute__((packed));
+
+struct virtio_mem_config {
+	/* Block size and alignment. Cannot change. */
+	u64 block_size;
+	/* Valid with VIRTIO_MEM_F_ACPI_PXM. Cannot change. */
+	u16 node_id;
+	u8 padding[6];
+	/* Start address of the memory region. Cannot change. */
+	u64 addr;
+	/* Region size (maximum). Cannot change. */
+	u64 region_size;
+	/* Currently usable region size. Can grow up to region_size. */
+	u64 usable_region_size;
+	/* Currently used size. Changes due to plug/unplug requests. */
+	u64 plugged_size;
+	/* Requested size. New plug requests cannot exceed it. */
+	u64 requested_size;
+} __attribute__((packed));
+
+/** Host view of a VirtIO mem device */
+struct virtio_mem_info {
+	/* Guest physical window of device and its block size */
+	u64 addr;
+	u64 region_size;
+	u64 block_size;
+	/* Memory size requested by host and plugged by guest */
+	u64 requested_size;
+	u64 plugged_size;
+	/* Requests processed since device was connected */
+	u64 plug_count;
+	u64 unplug_count;
+	u64 nack_count;
+	u64 error_count;
+};
+
+/** Set memory size (in bytes) which guest of VirtIO mem device
+ *  should plug (Note: Rounded up to block size of device)
+ */
+int virtio_mem_set_requested(const char *name, u64 size);
+
+/** Get host view of VirtIO mem device */
+int virtio_mem_get_info(const char *name, struct virtio_mem_info *info);
+
+#endif /* __VIRTIO_MEM_H_ */
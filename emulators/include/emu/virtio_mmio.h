@@ -72,6 +72,10 @@
 /* Guest's PFN for the currently selected queue - Read Write */
 #define VIRTIO_MMIO_QUEUE_PFN		0x040
 
+/* Ready bit for the currently selected queue - Read Write
+ * (Only for non-legacy devices i.e. version 2) */
+#define VIRTIO_MMIO_QUEUE_READY		0x044
+
 /* Queue notifier - Write Only */
 #define VIRTIO_MMIO_QUEUE_NOTIFY	0x050
 
@@ -84,6 +88,25 @@
 /* Device status register - Read Write */
 #define VIRTIO_MMIO_STATUS		0x070
 
+/* Selected queue's Descriptor Table address, 64 bits in two halves
+ * (Only for non-legacy devices i.e. version 2) */
+#define VIRTIO_MMIO_QUEUE_DESC_LOW	0x080
+#define VIRTIO_MMIO_QUEUE_DESC_HIGH	0x084
+
+/* Selected queue's Available Ring (or Driver Area) address
+ * (Only for non-legacy devices i.e. version 2) */
+#define VIRTIO_MMIO_QUEUE_AVAIL_LOW	0x090
+#define VIRTIO_MMIO_QUEUE_AVAIL_HIGH	0x094
+
+/* Selected queue's Used Ring (or Device Area) address
+ * (Only for non-legacy devices i.e. version 2) */
+#define VIRTIO_MMIO_QUEUE_USED_LOW	0x0a0
+#define VIRTIO_MMIO_QUEUE_USED_HIGH	0x0a4
+
+/* Configuration atomicity value - Read Only
+ * (Only for non-legacy devices i.e. version 2) */
+#define VIRTIO_MMIO_CONFIG_GENERATION	0x0fc
+
 /* The config space is defined by each driver as
  * the per-driver configuration space - Read Write */
 #define VIRTIO_MMIO_CONFIG		0x100
@@ -132,6 +155,13 @@ struct virtio_mmio_dev {
 	struct virtio_mmio_config config;
 	u32 irq;
 	u32 addr;
+
+	/* Non-legacy (version 2) state */
+	u64 guest_features;
+	u64 queue_ready;
+	u64 queue_desc;
+	u64 queue_driver;
+	u64 queue_device;
 };
 
 #endif
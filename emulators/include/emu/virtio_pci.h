@@ -74,6 +74,58 @@
 #define VIRTIO_PCI_IO_SIZE		VIRTIO_PCI_REGION_SIZE
 #define VIRTIO_PCI_PAGE_SIZE		(0x1UL << VIRTIO_PCI_QUEUE_ADDR_SHIFT)
 
+/* Modern (virtio 1.0) PCI capability types */
+#define VIRTIO_PCI_CAP_COMMON_CFG	1
+#define VIRTIO_PCI_CAP_NOTIFY_CFG	2
+#define VIRTIO_PCI_CAP_ISR_CFG		3
+#define VIRTIO_PCI_CAP_DEVICE_CFG	4
+
+/* Modern common configuration registers */
+#define VIRTIO_PCI_COMMON_DFSELECT	0x00
+#define VIRTIO_PCI_COMMON_DF		0x04
+#define VIRTIO_PCI_COMMON_GFSELECT	0x08
+#define VIRTIO_PCI_COMMON_GF		0x0c
+#define VIRTIO_PCI_COMMON_MSIX		0x10
+#define VIRTIO_PCI_COMMON_NUMQ		0x12
+#define VIRTIO_PCI_COMMON_STATUS	0x14
+#define VIRTIO_PCI_COMMON_CFGGENERATION	0x15
+#define VIRTIO_PCI_COMMON_Q_SELECT	0x16
+#define VIRTIO_PCI_COMMON_Q_SIZE	0x18
+#define VIRTIO_PCI_COMMON_Q_MSIX	0x1a
+#define VIRTIO_PCI_COMMON_Q_ENABLE	0x1c
+#define VIRTIO_PCI_COMMON_Q_NOFF	0x1e
+#define VIRTIO_PCI_COMMON_Q_DESCLO	0x20
+#define VIRTIO_PCI_COMMON_Q_DESCHI	0x24
+#define VIRTIO_PCI_COMMON_Q_AVAILLO	0x28
+#define VIRTIO_PCI_COMMON_Q_AVAILHI	0x2c
+#define VIRTIO_PCI_COMMON_Q_USEDLO	0x30
+#define VIRTIO_PCI_COMMON_Q_USEDHI	0x34
+#define VIRTIO_PCI_COMMON_SIZE		0x38
+
+/* Modern BAR layout (each queue has its own notify doorbell) */
+#define VIRTIO_PCI_MODERN_COMMON_OFFSET	0x000
+#define VIRTIO_PCI_MODERN_ISR_OFFSET	0x040
+#define VIRTIO_PCI_MODERN_ISR_SIZE	0x4
+#define VIRTIO_PCI_MODERN_NOTIFY_OFFSET	0x080
+#define VIRTIO_PCI_MODERN_NOTIFY_MULT	4
+#define VIRTIO_PCI_MODERN_NOTIFY_SIZE	\
+		(VIRTIO_PCI_QUEUE_MAX * VIRTIO_PCI_MODERN_NOTIFY_MULT)
+#define VIRTIO_PCI_MODERN_DEVICE_OFFSET	0x200
+#define VIRTIO_PCI_MODERN_DEVICE_SIZE	0x200
+#define VIRTIO_PCI_MODERN_BAR_SIZE	0x400
+
+/* Modern PCI IDs */
+#define VIRTIO_PCI_VENDOR_ID		0x1af4
+#define VIRTIO_PCI_MODERN_DEVICE_ID_BASE 0x1040
+#define VIRTIO_PCI_NO_VECTOR		0xffff
+
+/* Vendor specific capabilities start right after standard header */
+#define VIRTIO_PCI_CAP_OFFSET		0x40
+#define VIRTIO_PCI_CAP_LEN		16
+#define VIRTIO_PCI_NOTIFY_CAP_LEN	20
+#define VIRTIO_PCI_CAPS_SIZE		(3 * VIRTIO_PCI_CAP_LEN + \
+					 VIRTIO_PCI_NOTIFY_CAP_LEN)
+
 struct virtio_pci_config {
 	u32     host_features;
 	u32	guest_features;
@@ -91,6 +143,17 @@ struct virtio_pci_dev {
 	struct virtio_pci_config config;
 	u32 irq;
 	u32 addr;
+
+	/* Modern (virtio 1.0) state */
+	bool modern;
+	u32 host_features_sel;
+	u32 guest_features_sel;
+	u64 guest_features;
+	u16 queue_num;
+	u64 queue_ready;
+	u64 queue_desc;
+	u64 queue_driver;
+	u64 queue_device;
 };
 
 #endif /* __VIRTIO_PCI_H */
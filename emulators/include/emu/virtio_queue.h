@@ -42,9 +42,23 @@ struct virtio_queue {
 	u16			last_avail_idx;
 	u16			last_used_signalled;
 
+	/* Negotiated VIRTIO_RING_F_xxx and VIRTIO_F_RING_PACKED features */
+	u64			features;
+
 	struct vring		vring;
 
+	/* Packed ring state (only valid when packed is TRUE) */
+	bool			packed;
+	struct vring_packed	pring;
+	bool			avail_wrap;
+	bool			used_wrap;
+	u16			last_used_idx;
+	u16			*buf_head;
+	u16			*buf_count;
+
 	void			*addr;
+	void			*driver_addr;
+	void			*device_addr;
 	struct vmm_guest	*guest;
 	u32			desc_count;
 	u32			align;
@@ -100,8 +114,14 @@ physical_addr_t virtio_queue_host_addr(struct virtio_queue *vq);
  */
 physical_size_t virtio_queue_total_size(struct virtio_queue *vq);
 
+/** Update negotiated vring features of queue
+ *  Note: Should be called from set_guest_features() of emulator
+ */
+void virtio_queue_set_features(struct virtio_queue *vq, u64 features);
+
 /** Pop the index of next available descriptor
  *  Note: works only after queue setup is done
+ *  Note: for packed queue it returns buffer ID of next available buffer
  */
 u16 virtio_queue_pop(struct virtio_queue *vq);
 
@@ -122,6 +142,7 @@ bool virtio_queue_should_signal(struct virtio_queue *vq);
 
 /** Update used element in vring
  *  Note: works only after queue setup is done
+ *  Note: always returns NULL for packed queue
  */
 struct vring_used_elem *virtio_queue_set_used_elem(struct virtio_queue *vq,
 						   u32 head, u32 len);
@@ -143,6 +164,18 @@ int virtio_queue_setup(struct virtio_queue *vq,
 			physical_size_t guest_page_size,
 			u32 desc_count, u32 align);
 
+/** Setup or initialize the queue from separate descriptor, driver and
+ *  device areas as done by non-legacy (virtio 1.0) transports
+ *  Note: Layout is packed if VIRTIO_F_RING_PACKED feature was negotiated
+ *  Note: If queue was already setup then it will cleanup first.
+ */
+int virtio_queue_setup_addr(struct virtio_queue *vq,
+			    struct vmm_guest *guest,
+			    u32 desc_count,
+			    physical_addr_t desc_addr,
+			    physical_addr_t driver_addr,
+			    physical_addr_t device_addr);
+
 /** Get guest IO vectors based on given head
  *  Note: works only after queue setup is done
  */
@@ -60,6 +60,24 @@
   */
 #define VIRTIO_RING_F_EVENT_IDX		29
 
+/* Compliance with virtio 1.0 or later (non-legacy interface) */
+#define VIRTIO_F_VERSION_1		32
+
+/* Support for packed virtqueue layout (requires VIRTIO_F_VERSION_1) */
+#define VIRTIO_F_RING_PACKED		34
+
+/* Packed ring descriptor flags are driver and device wrap counters */
+#define VRING_PACKED_DESC_F_AVAIL	7
+#define VRING_PACKED_DESC_F_USED	15
+
+/* Packed ring event suppression flags */
+#define VRING_PACKED_EVENT_FLAG_ENABLE	0x0
+#define VRING_PACKED_EVENT_FLAG_DISABLE	0x1
+#define VRING_PACKED_EVENT_FLAG_DESC	0x2
+
+/* Wrap counter bit of off_wrap in packed ring event suppression */
+#define VRING_PACKED_EVENT_F_WRAP_CTR	15
+
 /* Virtio ring descriptors: 16 bytes.  These can chain together via "next". */
 struct vring_desc {
 	/* Address (guest-physical). */
@@ -102,6 +120,38 @@ struct vring {
 	struct vring_used *used;
 };
 
+/* Packed ring descriptors: 16 bytes. Chains are consecutive in ring. */
+struct vring_packed_desc {
+	/* Address (guest-physical). */
+	u64 addr;
+	/* Length. */
+	u32 len;
+	/* Buffer ID. */
+	u16 id;
+	/* The flags depending on descriptor type. */
+	u16 flags;
+};
+
+/* Packed ring event suppression area */
+struct vring_packed_desc_event {
+	/* Descriptor ring change event offset and wrap counter */
+	u16 off_wrap;
+	/* Descriptor ring change event flags */
+	u16 flags;
+};
+
+struct vring_packed {
+	unsigned int num;
+
+	struct vring_packed_desc *desc;
+
+	/* Written by driver, read by device */
+	struct vring_packed_desc_event *driver;
+
+	/* Written by device, read by driver */
+	struct vring_packed_desc_event *device;
+};
+
 struct virtio_iovec {
 	/* Address (guest-physical). */
 	u64 addr;
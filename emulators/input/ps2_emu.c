@@ -46,6 +46,7 @@
 
 void ps2_emu_queue(struct ps2_emu_state *s, int b)
 {
+	bool raise;
 	irq_flags_t flags;
 	struct ps2_emu_queue *q;
 
@@ -65,10 +66,12 @@ void ps2_emu_queue(struct ps2_emu_state *s, int b)
 		q->wptr = 0;
 	}
 	q->count++;
+	/* IRQ stays asserted till queue is drained by reads */
+	raise = (q->count == 1) ? TRUE : FALSE;
 
 	vmm_spin_unlock_irqrestore(&s->lock, flags);
 
-	if (s->update_irq) {
+	if (raise && s->update_irq) {
 		s->update_irq(s->update_arg, 1);
 	}
 }
@@ -491,6 +494,11 @@ static void __ps2_emu_mouse_send_packet(struct ps2_emu_mouse *m)
 	m->mouse_dz -= dz1;
 }
 
+/*
+ * Events of one report are only accumulated here and packets are
+ * generated upon report sync so that whole report reaches guest as
+ * one packet (or few packets for big deltas).
+ */
 static void ps2_emu_mouse_event(struct vmm_vmouse *vmou,
 				int dx, int dy, int dz, int buttons_state)
 {
@@ -508,15 +516,35 @@ static void ps2_emu_mouse_event(struct vmm_vmouse *vmou,
 	m->mouse_dx += dx;
 	m->mouse_dy -= dy;
 	m->mouse_dz += dz;
+	if (m->mouse_buttons != buttons_state) {
+		m->mouse_buttons = buttons_state;
+		m->mouse_buttons_changed = TRUE;
+	}
+
+	vmm_spin_unlock_irqrestore(&m->lock, flags);
+}
+
+static void ps2_emu_mouse_sync(struct vmm_vmouse *vmou)
+{
+	irq_flags_t flags;
+	struct ps2_emu_mouse *m = vmm_vmouse_priv(vmou);
+
+	vmm_spin_lock_irqsave(&m->lock, flags);
+
+	if (!(m->mouse_status & MOUSE_STATUS_ENABLED)) {
+		vmm_spin_unlock_irqrestore(&m->lock, flags);
+		return;
+	}
+
 	/* XXX: SDL sometimes generates nul events: we delete them */
 	if (m->mouse_dx == 0 &&
 	    m->mouse_dy == 0 &&
 	    m->mouse_dz == 0 &&
-	    m->mouse_buttons == buttons_state) {
+	    !m->mouse_buttons_changed) {
 		vmm_spin_unlock_irqrestore(&m->lock, flags);
 		return;
 	}
-	m->mouse_buttons = buttons_state;
+	m->mouse_buttons_changed = FALSE;
 
 	if (!(m->mouse_status & MOUSE_STATUS_REMOTE) &&
 	     (ps2_emu_queue_count(&m->state) < (PS2_EMU_QUEUE_SIZE - 16))) {
@@ -562,6 +590,7 @@ struct ps2_emu_mouse *ps2_emu_alloc_mouse(const char *name,
 		vmm_free(m);
 		return NULL;
 	}
+	vmm_vmouse_set_sync(m->mouse, ps2_emu_mouse_sync);
 
 	return m;
 }
@@ -603,6 +632,7 @@ int ps2_emu_reset_mouse(struct ps2_emu_mouse *m)
 	m->mouse_dy = 0;
 	m->mouse_dz = 0;
 	m->mouse_buttons = 0;
+	m->mouse_buttons_changed = FALSE;
 
 	vmm_spin_unlock_irqrestore(&m->lock, flags);
 
@@ -758,6 +788,7 @@ int ps2_emu_mouse_fake_event(struct ps2_emu_mouse *m)
 	}
 
 	ps2_emu_mouse_event(m->mouse, 1, 0, 0, 0);
+	ps2_emu_mouse_sync(m->mouse);
 
 	return VMM_OK;
 }
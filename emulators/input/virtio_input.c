@@ -0,0 +1,708 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file virtio_input.c
+ * @author agent (agent@local)
+ * @brief VirtIO based Input Emulator.
+ *
+ * Virtual keyboard or mouse events of one report are converted to
+ * evdev events and kept pending. Upon report sync, pending events
+ * followed by SYN_REPORT are written to guest event queue and guest
+ * is notified only once for the whole report.
+ */
+
+#include <vmm_error.h>
+#include <vmm_macros.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_devtree.h>
+#include <vmm_devemu.h>
+#include <vmm_spinlocks.h>
+#include <vio/vmm_keymaps.h>
+#include <vio/vmm_vinput.h>
+#include <libs/stringlib.h>
+
+#include <emu/virtio.h>
+#include <emu/virtio_input.h>
+
+#define MODULE_DESC			"VirtIO Input Emulator"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(VMM_VINPUT_IPRIORITY + \
+					 VIRTIO_IPRIORITY + 1)
+#define MODULE_INIT			virtio_input_init
+#define MODULE_EXIT			virtio_input_exit
+
+#define VIRTIO_INPUT_QUEUE_SIZE		64
+#define VIRTIO_INPUT_NUM_QUEUES		2
+#define VIRTIO_INPUT_EVENT_QUEUE	0
+#define VIRTIO_INPUT_STATUS_QUEUE	1
+
+#define VIRTIO_INPUT_MAX_PENDING	32
+
+/* Subset of Linux evdev event types and codes */
+#define EV_SYN				0x00
+#define EV_KEY				0x01
+#define EV_REL				0x02
+#define EV_ABS				0x03
+#define EV_LED				0x11
+#define SYN_REPORT			0
+#define BTN_LEFT			0x110
+#define BTN_RIGHT			0x111
+#define BTN_MIDDLE			0x112
+#define REL_X				0x00
+#define REL_Y				0x01
+#define REL_WHEEL			0x08
+#define ABS_X				0x00
+#define ABS_Y				0x01
+#define LED_NUML			0x00
+#define LED_CAPSL			0x01
+#define LED_SCROLLL			0x02
+#define BUS_VIRTUAL			0x06
+
+/* Last key code without 0xE0 prefix which maps 1:1 to evdev (KEY_F12) */
+#define VIRTIO_INPUT_KEY_DIRECT_MAX	0x58
+#define VIRTIO_INPUT_ABS_MAX		0x7fff
+
+enum virtio_input_type {
+	VIRTIO_INPUT_TYPE_KEYBOARD = 0,
+	VIRTIO_INPUT_TYPE_MOUSE,
+	VIRTIO_INPUT_TYPE_TABLET,
+};
+
+static const char *const virtio_input_type_names[] = {
+	[VIRTIO_INPUT_TYPE_KEYBOARD] = "keyboard",
+	[VIRTIO_INPUT_TYPE_MOUSE] = "mouse",
+	[VIRTIO_INPUT_TYPE_TABLET] = "tablet",
+};
+
+/* Scancodes with 0xE0 prefix and their evdev key codes */
+static const u16 virtio_input_emul0_keys[][2] = {
+	{ 0x1c,  96 },	/* KEY_KPENTER */
+	{ 0x1d,  97 },	/* KEY_RIGHTCTRL */
+	{ 0x35,  98 },	/* KEY_KPSLASH */
+	{ 0x37,  99 },	/* KEY_SYSRQ */
+	{ 0x38, 100 },	/* KEY_RIGHTALT */
+	{ 0x47, 102 },	/* KEY_HOME */
+	{ 0x48, 103 },	/* KEY_UP */
+	{ 0x49, 104 },	/* KEY_PAGEUP */
+	{ 0x4b, 105 },	/* KEY_LEFT */
+	{ 0x4d, 106 },	/* KEY_RIGHT */
+	{ 0x4f, 107 },	/* KEY_END */
+	{ 0x50, 108 },	/* KEY_DOWN */
+	{ 0x51, 109 },	/* KEY_PAGEDOWN */
+	{ 0x52, 110 },	/* KEY_INSERT */
+	{ 0x53, 111 },	/* KEY_DELETE */
+	{ 0x5b, 125 },	/* KEY_LEFTMETA */
+	{ 0x5c, 126 },	/* KEY_RIGHTMETA */
+	{ 0x5d, 127 },	/* KEY_COMPOSE */
+};
+
+static const u16 virtio_input_buttons[][2] = {
+	{ VMM_MOUSE_LBUTTON, BTN_LEFT },
+	{ VMM_MOUSE_RBUTTON, BTN_RIGHT },
+	{ VMM_MOUSE_MBUTTON, BTN_MIDDLE },
+};
+
+struct virtio_input_dev {
+	struct virtio_device *vdev;
+
+	struct virtio_queue vqs[VIRTIO_INPUT_NUM_QUEUES];
+	struct virtio_iovec iov[VIRTIO_INPUT_QUEUE_SIZE];
+	struct virtio_iovec status_iov[VIRTIO_INPUT_QUEUE_SIZE];
+	struct virtio_input_config config;
+	u32 type;
+
+	/* Protects event queue and pending events of current report */
+	vmm_spinlock_t lock;
+	bool kbd_emul0;
+	int mouse_buttons;
+	u32 pending_count;
+	struct virtio_input_event pending[VIRTIO_INPUT_MAX_PENDING];
+
+	char name[VIRTIO_DEVICE_MAX_NAME_LEN];
+	struct vmm_vkeyboard *vkbd;
+	struct vmm_vmouse *vmou;
+};
+
+static u64 virtio_input_get_host_features(struct virtio_device *dev)
+{
+	/* No feature bits defined for input devices */
+	return 0;
+}
+
+static void virtio_input_set_guest_features(struct virtio_device *dev,
+					    u64 features)
+{
+	/* No host features so, ignore it. */
+}
+
+static int virtio_input_init_vq(struct virtio_device *dev,
+				u32 vq, u32 page_size, u32 align, u32 pfn)
+{
+	int rc;
+	struct virtio_input_dev *idev = dev->emu_data;
+
+	switch (vq) {
+	case VIRTIO_INPUT_EVENT_QUEUE:
+	case VIRTIO_INPUT_STATUS_QUEUE:
+		rc = virtio_queue_setup(&idev->vqs[vq], dev->guest,
+			pfn, page_size, VIRTIO_INPUT_QUEUE_SIZE, align);
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	};
+
+	return rc;
+}
+
+static int virtio_input_get_pfn_vq(struct virtio_device *dev, u32 vq)
+{
+	int rc;
+	struct virtio_input_dev *idev = dev->emu_data;
+
+	switch (vq) {
+	case VIRTIO_INPUT_EVENT_QUEUE:
+	case VIRTIO_INPUT_STATUS_QUEUE:
+		rc = virtio_queue_guest_pfn(&idev->vqs[vq]);
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	};
+
+	return rc;
+}
+
+static int virtio_input_get_size_vq(struct virtio_device *dev, u32 vq)
+{
+	int rc;
+
+	switch (vq) {
+	case VIRTIO_INPUT_EVENT_QUEUE:
+	case VIRTIO_INPUT_STATUS_QUEUE:
+		rc = VIRTIO_INPUT_QUEUE_SIZE;
+		break;
+	default:
+		rc = 0;
+		break;
+	};
+
+	return rc;
+}
+
+static int virtio_input_set_size_vq(struct virtio_device *dev,
+				    u32 vq, int size)
+{
+	/* FIXME: dynamic */
+	return size;
+}
+
+/* Note: This function must be called with lock held */
+static void __virtio_input_add(struct virtio_input_dev *idev,
+			       u16 type, u16 code, u32 value)
+{
+	struct virtio_input_event *ev;
+
+	/* Last slot is reserved for SYN_REPORT */
+	if ((VIRTIO_INPUT_MAX_PENDING - 1) <= idev->pending_count) {
+		return;
+	}
+
+	ev = &idev->pending[idev->pending_count];
+	ev->type = type;
+	ev->code = code;
+	ev->value = value;
+	idev->pending_count++;
+}
+
+static void virtio_input_sync(struct virtio_input_dev *idev)
+{
+	u16 head = 0;
+	u32 i, len, iov_cnt = 0, total_len = 0;
+	irq_flags_t flags;
+	struct virtio_device *dev = idev->vdev;
+	struct virtio_queue *vq = &idev->vqs[VIRTIO_INPUT_EVENT_QUEUE];
+	struct virtio_iovec *iov = idev->iov;
+
+	vmm_spin_lock_irqsave(&idev->lock, flags);
+
+	if (!idev->pending_count) {
+		vmm_spin_unlock_irqrestore(&idev->lock, flags);
+		return;
+	}
+
+	idev->pending[idev->pending_count].type = EV_SYN;
+	idev->pending[idev->pending_count].code = SYN_REPORT;
+	idev->pending[idev->pending_count].value = 0;
+	idev->pending_count++;
+
+	/* Events are dropped if guest has not posted enough buffers */
+	for (i = 0; i < idev->pending_count; i++) {
+		if (!virtio_queue_available(vq)) {
+			break;
+		}
+		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+		len = virtio_buf_to_iovec_write(dev, iov, iov_cnt,
+						&idev->pending[i],
+						sizeof(idev->pending[i]));
+		virtio_queue_set_used_elem(vq, head, len);
+	}
+	idev->pending_count = 0;
+
+	vmm_spin_unlock_irqrestore(&idev->lock, flags);
+
+	if (i && virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, VIRTIO_INPUT_EVENT_QUEUE);
+	}
+}
+
+static void virtio_input_keyboard_event(struct vmm_vkeyboard *vkbd,
+					int keycode)
+{
+	u32 i, code;
+	irq_flags_t flags;
+	struct virtio_input_dev *idev = vmm_vkeyboard_priv(vkbd);
+
+	vmm_spin_lock_irqsave(&idev->lock, flags);
+
+	if (keycode == SCANCODE_EMUL0) {
+		idev->kbd_emul0 = TRUE;
+		goto done;
+	}
+
+	code = keycode & SCANCODE_KEYCODEMASK;
+	if (idev->kbd_emul0) {
+		idev->kbd_emul0 = FALSE;
+		for (i = 0; i < array_size(virtio_input_emul0_keys); i++) {
+			if (virtio_input_emul0_keys[i][0] == code) {
+				break;
+			}
+		}
+		if (i == array_size(virtio_input_emul0_keys)) {
+			goto done;
+		}
+		code = virtio_input_emul0_keys[i][1];
+	} else if (!code || (VIRTIO_INPUT_KEY_DIRECT_MAX < code)) {
+		goto done;
+	}
+
+	__virtio_input_add(idev, EV_KEY, code,
+			   (keycode & SCANCODE_UP) ? 0 : 1);
+
+done:
+	vmm_spin_unlock_irqrestore(&idev->lock, flags);
+}
+
+static void virtio_input_keyboard_sync(struct vmm_vkeyboard *vkbd)
+{
+	virtio_input_sync(vmm_vkeyboard_priv(vkbd));
+}
+
+static void virtio_input_mouse_event(struct vmm_vmouse *vmou,
+				     int dx, int dy, int dz,
+				     int buttons_state)
+{
+	u32 i, mask;
+	irq_flags_t flags;
+	struct virtio_input_dev *idev = vmm_vmouse_priv(vmou);
+
+	vmm_spin_lock_irqsave(&idev->lock, flags);
+
+	if (idev->type == VIRTIO_INPUT_TYPE_TABLET) {
+		__virtio_input_add(idev, EV_ABS, ABS_X, dx);
+		__virtio_input_add(idev, EV_ABS, ABS_Y, dy);
+	} else {
+		if (dx) {
+			__virtio_input_add(idev, EV_REL, REL_X, dx);
+		}
+		if (dy) {
+			__virtio_input_add(idev, EV_REL, REL_Y, dy);
+		}
+	}
+	if (dz) {
+		__virtio_input_add(idev, EV_REL, REL_WHEEL, dz);
+	}
+
+	for (i = 0; i < array_size(virtio_input_buttons); i++) {
+		mask = virtio_input_buttons[i][0];
+		if ((idev->mouse_buttons ^ buttons_state) & mask) {
+			__virtio_input_add(idev, EV_KEY,
+					   virtio_input_buttons[i][1],
+					   (buttons_state & mask) ? 1 : 0);
+		}
+	}
+	idev->mouse_buttons = buttons_state;
+
+	vmm_spin_unlock_irqrestore(&idev->lock, flags);
+}
+
+static void virtio_input_mouse_sync(struct vmm_vmouse *vmou)
+{
+	virtio_input_sync(vmm_vmouse_priv(vmou));
+}
+
+static void virtio_input_led_event(struct virtio_input_dev *idev,
+				   struct virtio_input_event *ev)
+{
+	int ledstate, led;
+
+	if (!idev->vkbd || (ev->type != EV_LED)) {
+		return;
+	}
+
+	switch (ev->code) {
+	case LED_NUML:
+		led = VMM_NUM_LOCK_LED;
+		break;
+	case LED_CAPSL:
+		led = VMM_CAPS_LOCK_LED;
+		break;
+	case LED_SCROLLL:
+		led = VMM_SCROLL_LOCK_LED;
+		break;
+	default:
+		return;
+	};
+
+	ledstate = vmm_vkeyboard_get_ledstate(idev->vkbd);
+	if (ev->value) {
+		ledstate |= led;
+	} else {
+		ledstate &= ~led;
+	}
+	vmm_vkeyboard_set_ledstate(idev->vkbd, ledstate);
+}
+
+static int virtio_input_do_status(struct virtio_device *dev,
+				  struct virtio_input_dev *idev)
+{
+	u16 head = 0;
+	u32 len, iov_cnt = 0, total_len = 0;
+	struct virtio_input_event ev;
+	struct virtio_queue *vq = &idev->vqs[VIRTIO_INPUT_STATUS_QUEUE];
+	struct virtio_iovec *iov = idev->status_iov;
+
+	while (virtio_queue_available(vq)) {
+		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+		len = virtio_iovec_to_buf_read(dev, iov, iov_cnt,
+					       &ev, sizeof(ev));
+		if (len == sizeof(ev)) {
+			virtio_input_led_event(idev, &ev);
+		}
+		virtio_queue_set_used_elem(vq, head, 0);
+	}
+
+	if (virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, VIRTIO_INPUT_STATUS_QUEUE);
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_input_notify_vq(struct virtio_device *dev, u32 vq)
+{
+	int rc = VMM_OK;
+	struct virtio_input_dev *idev = dev->emu_data;
+
+	switch (vq) {
+	case VIRTIO_INPUT_EVENT_QUEUE:
+		/* Guest posted event buffers, nothing to do till next report */
+		break;
+	case VIRTIO_INPUT_STATUS_QUEUE:
+		rc = virtio_input_do_status(dev, idev);
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	}
+
+	return rc;
+}
+
+static void virtio_input_config_bit(struct virtio_input_config *cfg,
+				    u32 bit)
+{
+	cfg->u.bitmap[bit / 8] |= 1 << (bit % 8);
+	if (cfg->size < (bit / 8 + 1)) {
+		cfg->size = bit / 8 + 1;
+	}
+}
+
+static void virtio_input_config_ev_bits(struct virtio_input_dev *idev)
+{
+	u32 i;
+	struct virtio_input_config *cfg = &idev->config;
+
+	switch (cfg->subsel) {
+	case EV_KEY:
+		if (idev->type == VIRTIO_INPUT_TYPE_KEYBOARD) {
+			for (i = 1; i <= VIRTIO_INPUT_KEY_DIRECT_MAX; i++) {
+				virtio_input_config_bit(cfg, i);
+			}
+			for (i = 0; i < array_size(virtio_input_emul0_keys); i++) {
+				virtio_input_config_bit(cfg,
+						virtio_input_emul0_keys[i][1]);
+			}
+		} else {
+			for (i = 0; i < array_size(virtio_input_buttons); i++) {
+				virtio_input_config_bit(cfg,
+						virtio_input_buttons[i][1]);
+			}
+		}
+		break;
+	case EV_REL:
+		if (idev->type == VIRTIO_INPUT_TYPE_MOUSE) {
+			virtio_input_config_bit(cfg, REL_X);
+			virtio_input_config_bit(cfg, REL_Y);
+		}
+		if (idev->type != VIRTIO_INPUT_TYPE_KEYBOARD) {
+			virtio_input_config_bit(cfg, REL_WHEEL);
+		}
+		break;
+	case EV_ABS:
+		if (idev->type == VIRTIO_INPUT_TYPE_TABLET) {
+			virtio_input_config_bit(cfg, ABS_X);
+			virtio_input_config_bit(cfg, ABS_Y);
+		}
+		break;
+	case EV_LED:
+		if (idev->type == VIRTIO_INPUT_TYPE_KEYBOARD) {
+			virtio_input_config_bit(cfg, LED_NUML);
+			virtio_input_config_bit(cfg, LED_CAPSL);
+			virtio_input_config_bit(cfg, LED_SCROLLL);
+		}
+		break;
+	default:
+		break;
+	};
+}
+
+/* Update size and payload of config space as per select and subsel */
+static void virtio_input_update_config(struct virtio_input_dev *idev)
+{
+	struct virtio_input_config *cfg = &idev->config;
+
+	cfg->size = 0;
+	memset(&cfg->u, 0, sizeof(cfg->u));
+
+	switch (cfg->select) {
+	case VIRTIO_INPUT_CFG_ID_NAME:
+		cfg->size = strlcpy(cfg->u.string, idev->name,
+				    sizeof(cfg->u.string));
+		if (sizeof(cfg->u.string) <= cfg->size) {
+			cfg->size = sizeof(cfg->u.string) - 1;
+		}
+		break;
+	case VIRTIO_INPUT_CFG_ID_DEVIDS:
+		cfg->u.ids.bustype = BUS_VIRTUAL;
+		cfg->u.ids.vendor = 0x0627;
+		cfg->u.ids.product = idev->type + 1;
+		cfg->u.ids.version = 1;
+		cfg->size = sizeof(cfg->u.ids);
+		break;
+	case VIRTIO_INPUT_CFG_EV_BITS:
+		virtio_input_config_ev_bits(idev);
+		break;
+	case VIRTIO_INPUT_CFG_ABS_INFO:
+		if ((idev->type == VIRTIO_INPUT_TYPE_TABLET) &&
+		    ((cfg->subsel == ABS_X) || (cfg->subsel == ABS_Y))) {
+			cfg->u.abs.min = 0;
+			cfg->u.abs.max = VIRTIO_INPUT_ABS_MAX;
+			cfg->size = sizeof(cfg->u.abs);
+		}
+		break;
+	default:
+		break;
+	};
+}
+
+static int virtio_input_read_config(struct virtio_device *dev,
+				    u32 offset, void *dst, u32 dst_len)
+{
+	struct virtio_input_dev *idev = dev->emu_data;
+	u8 *src = (u8 *)&idev->config;
+	u32 i, src_len = sizeof(idev->config);
+
+	for (i = 0; (i < dst_len) && ((offset + i) < src_len); i++) {
+		*((u8 *)dst + i) = src[offset + i];
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_input_write_config(struct virtio_device *dev,
+				     u32 offset, void *src, u32 src_len)
+{
+	u32 i;
+	struct virtio_input_dev *idev = dev->emu_data;
+	u8 *dst = (u8 *)&idev->config;
+
+	/* Only select and subsel are writeable */
+	for (i = 0; i < src_len; i++) {
+		if ((offset + i) ==
+		    offsetof(struct virtio_input_config, select) ||
+		    (offset + i) ==
+		    offsetof(struct virtio_input_config, subsel)) {
+			dst[offset + i] = *((u8 *)src + i);
+		}
+	}
+
+	virtio_input_update_config(idev);
+
+	return VMM_OK;
+}
+
+static int virtio_input_reset(struct virtio_device *dev)
+{
+	int rc;
+	irq_flags_t flags;
+	struct virtio_input_dev *idev = dev->emu_data;
+
+	idev->config.select = VIRTIO_INPUT_CFG_UNSET;
+	idev->config.subsel = 0;
+	virtio_input_update_config(idev);
+
+	vmm_spin_lock_irqsave(&idev->lock, flags);
+	idev->kbd_emul0 = FALSE;
+	idev->pending_count = 0;
+	rc = virtio_queue_cleanup(&idev->vqs[VIRTIO_INPUT_EVENT_QUEUE]);
+	vmm_spin_unlock_irqrestore(&idev->lock, flags);
+	if (rc) {
+		return rc;
+	}
+
+	return virtio_queue_cleanup(&idev->vqs[VIRTIO_INPUT_STATUS_QUEUE]);
+}
+
+static int virtio_input_connect(struct virtio_device *dev,
+				struct virtio_emulator *emu)
+{
+	u32 t;
+	const char *str = NULL;
+	struct virtio_input_dev *idev;
+
+	idev = vmm_zalloc(sizeof(struct virtio_input_dev));
+	if (!idev) {
+		vmm_printf("Failed to allocate virtio input device....\n");
+		return VMM_ENOMEM;
+	}
+	idev->vdev = dev;
+	INIT_SPIN_LOCK(&idev->lock);
+
+	/* Absolute pointer (tablet) is default input type */
+	idev->type = VIRTIO_INPUT_TYPE_TABLET;
+	if (vmm_devtree_read_string(dev->edev->node,
+				    "input_type", &str) == VMM_OK) {
+		for (t = 0; t < array_size(virtio_input_type_names); t++) {
+			if (!strcmp(str, virtio_input_type_names[t])) {
+				break;
+			}
+		}
+		if (t == array_size(virtio_input_type_names)) {
+			vmm_free(idev);
+			return VMM_EINVALID;
+		}
+		idev->type = t;
+	}
+
+	vmm_snprintf(idev->name, VIRTIO_DEVICE_MAX_NAME_LEN, "%s", dev->name);
+	if (idev->type == VIRTIO_INPUT_TYPE_KEYBOARD) {
+		idev->vkbd = vmm_vkeyboard_create(idev->name,
+					virtio_input_keyboard_event, idev);
+		if (!idev->vkbd) {
+			vmm_free(idev);
+			return VMM_EFAIL;
+		}
+		vmm_vkeyboard_set_sync(idev->vkbd,
+				       virtio_input_keyboard_sync);
+	} else {
+		idev->vmou = vmm_vmouse_create(idev->name,
+				(idev->type == VIRTIO_INPUT_TYPE_TABLET) ?
+				TRUE : FALSE, virtio_input_mouse_event, idev);
+		if (!idev->vmou) {
+			vmm_free(idev);
+			return VMM_EFAIL;
+		}
+		vmm_vmouse_set_sync(idev->vmou, virtio_input_mouse_sync);
+	}
+
+	virtio_input_update_config(idev);
+
+	dev->emu_data = idev;
+
+	return VMM_OK;
+}
+
+static void virtio_input_disconnect(struct virtio_device *dev)
+{
+	struct virtio_input_dev *idev = dev->emu_data;
+
+	if (idev->vkbd) {
+		vmm_vkeyboard_destroy(idev->vkbd);
+	}
+	if (idev->vmou) {
+		vmm_vmouse_destroy(idev->vmou);
+	}
+	vmm_free(idev);
+}
+
+struct virtio_device_id virtio_input_emu_id[] = {
+	{.type = VIRTIO_ID_INPUT},
+	{ },
+};
+
+struct virtio_emulator virtio_input = {
+	.name = "virtio_input",
+	.id_table = virtio_input_emu_id,
+
+	/* VirtIO operations */
+	.get_host_features      = virtio_input_get_host_features,
+	.set_guest_features     = virtio_input_set_guest_features,
+	.init_vq                = virtio_input_init_vq,
+	.get_pfn_vq             = virtio_input_get_pfn_vq,
+	.get_size_vq            = virtio_input_get_size_vq,
+	.set_size_vq            = virtio_input_set_size_vq,
+	.notify_vq              = virtio_input_notify_vq,
+
+	/* Emulator operations */
+	.read_config = virtio_input_read_config,
+	.write_config = virtio_input_write_config,
+	.reset = virtio_input_reset,
+	.connect = virtio_input_connect,
+	.disconnect = virtio_input_disconnect,
+};
+
+static int __init virtio_input_init(void)
+{
+	return virtio_register_emulator(&virtio_input);
+}
+
+static void __exit virtio_input_exit(void)
+{
+	virtio_unregister_emulator(&virtio_input);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
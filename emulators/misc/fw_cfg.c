@@ -39,10 +39,12 @@
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
 #include <vmm_host_io.h>
+#include <vmm_guest_aspace.h>
 #include <emu/fw_cfg.h>
 
 #define FW_CFG_SIZE		2
 #define FW_CFG_DATA_SIZE	1
+#define FW_CFG_DMA_OFFSET	4
 #define FW_CFG_NAME		"fw_cfg"
 #define FW_CFG_PATH		"/machine/" FW_CFG_NAME
 
@@ -62,11 +64,13 @@ typedef struct fw_cfg_entry {
 } fw_cfg_entry_t;
 
 struct fw_cfg_state {
+	struct vmm_guest *guest;
 	u32 ctl_iobase, data_iobase;
 	fw_cfg_entry_t entries[2][FW_CFG_MAX_ENTRY];
 	fw_cfg_files_t *files;
 	u16 cur_entry;
 	u32 cur_offset;
+	u64 dma_addr;
 };
 
 static void fw_cfg_reboot(fw_cfg_state_t *s)
@@ -125,6 +129,136 @@ static u8 fw_cfg_read(fw_cfg_state_t *s)
 	return ret;
 }
 
+/* Zero fill guest memory for reads beyond end of item */
+static bool fw_cfg_dma_zero(fw_cfg_state_t *s, physical_addr_t addr, u32 len)
+{
+	u32 chunk;
+	static const u8 zero_buf[64] = { 0 };
+
+	while (len) {
+		chunk = (len < sizeof(zero_buf)) ? len : sizeof(zero_buf);
+		if (vmm_guest_memory_write(s->guest, addr, (void *)zero_buf,
+					   chunk, TRUE) != chunk) {
+			return FALSE;
+		}
+		addr += chunk;
+		len -= chunk;
+	}
+
+	return TRUE;
+}
+
+/* Process FW_CFG_DMA descriptor at given guest physical address so
+ * that whole item is transferred with one guest memory access instead
+ * of one trap per byte on data port.
+ */
+static void fw_cfg_dma_transfer(fw_cfg_state_t *s, physical_addr_t desc)
+{
+	int arch;
+	bool ok = TRUE;
+	u32 control, length, avail, len;
+	physical_addr_t addr;
+	fw_cfg_entry_t *e;
+	fw_cfg_dma_access_t dma;
+
+	if (vmm_guest_memory_read(s->guest, desc, &dma,
+				  sizeof(dma), TRUE) != sizeof(dma)) {
+		return;
+	}
+	control = vmm_be32_to_cpu(dma.control);
+	length = vmm_be32_to_cpu(dma.length);
+	addr = vmm_be64_to_cpu(dma.address);
+
+	if (control & FW_CFG_DMA_CTL_SELECT) {
+		fw_cfg_select(s, control >> 16);
+	}
+
+	arch = !!(s->cur_entry & FW_CFG_ARCH_LOCAL);
+	e = &s->entries[arch][s->cur_entry & FW_CFG_ENTRY_MASK];
+	if ((s->cur_entry == FW_CFG_INVALID) || !e->data) {
+		avail = 0;
+	} else {
+		avail = (s->cur_offset < e->len) ? (e->len - s->cur_offset) : 0;
+	}
+	len = (length < avail) ? length : avail;
+
+	if (control & FW_CFG_DMA_CTL_READ) {
+		if (len && e->read_callback) {
+			e->read_callback(e->callback_opaque, s->cur_offset);
+		}
+		if (len && (vmm_guest_memory_write(s->guest, addr,
+				&e->data[s->cur_offset], len, TRUE) != len)) {
+			ok = FALSE;
+		}
+		if (ok && (len < length)) {
+			ok = fw_cfg_dma_zero(s, addr + len, length - len);
+		}
+		s->cur_offset += len;
+	} else if (control & FW_CFG_DMA_CTL_WRITE) {
+		/* Write through DMA is not supported (same as QEMU) */
+		ok = FALSE;
+	} else if (control & FW_CFG_DMA_CTL_SKIP) {
+		s->cur_offset += len;
+	}
+
+	dma.control = vmm_cpu_to_be32((ok) ? 0 : FW_CFG_DMA_CTL_ERROR);
+	vmm_guest_memory_write(s->guest, desc, &dma.control,
+			       sizeof(dma.control), TRUE);
+}
+
+/* DMA address register is big-endian and transfer starts when
+ * its low 32-bits (or all 64-bits) are written.
+ */
+static int fw_cfg_dma_mem_write(fw_cfg_state_t *s, physical_addr_t offset,
+				u64 value, u32 size)
+{
+	switch (offset - FW_CFG_DMA_OFFSET) {
+	case 0:
+		if (size == 8) {
+			fw_cfg_dma_transfer(s, vmm_be64_to_cpu(value));
+			s->dma_addr = 0;
+		} else if (size == 4) {
+			s->dma_addr = (u64)vmm_be32_to_cpu((u32)value) << 32;
+		} else {
+			return VMM_EFAIL;
+		}
+		break;
+	case 4:
+		if (size != 4) {
+			return VMM_EFAIL;
+		}
+		s->dma_addr |= vmm_be32_to_cpu((u32)value);
+		fw_cfg_dma_transfer(s, s->dma_addr);
+		s->dma_addr = 0;
+		break;
+	default:
+		return VMM_EFAIL;
+	}
+
+	return VMM_OK;
+}
+
+static u64 fw_cfg_dma_mem_read(physical_addr_t offset, u32 size)
+{
+	u64 sig = vmm_cpu_to_be64(FW_CFG_DMA_SIGNATURE);
+
+	offset -= FW_CFG_DMA_OFFSET;
+	if ((offset + size) > sizeof(sig)) {
+		return 0;
+	}
+
+	switch (size) {
+	case 1:
+		return *((u8 *)&sig + offset);
+	case 2:
+		return *(u16 *)((u8 *)&sig + offset);
+	case 4:
+		return *(u32 *)((u8 *)&sig + offset);
+	default:
+		return sig;
+	};
+}
+
 static u64 fw_cfg_data_mem_read(void *opaque, physical_addr_t addr)
 {
 	return fw_cfg_read(opaque);
@@ -270,8 +404,12 @@ static int fwcfg_emulator_read8(struct vmm_emudev *edev,
 				physical_addr_t offset,
 				u8 *dst)
 {
-	/* Always read zero */
-	*dst = fw_cfg_data_mem_read(edev->priv, offset);
+	if (offset >= FW_CFG_DMA_OFFSET) {
+		*dst = (u8)fw_cfg_dma_mem_read(offset, 1);
+		return VMM_OK;
+	}
+
+	*dst = (u8)fw_cfg_data_mem_read(edev->priv, offset);
 
 	return VMM_OK;
 }
@@ -280,7 +418,11 @@ static int fwcfg_emulator_read16(struct vmm_emudev *edev,
 				 physical_addr_t offset,
 				 u16 *dst)
 {
-	/* Always read zero */
+	if (offset >= FW_CFG_DMA_OFFSET) {
+		*dst = (u16)fw_cfg_dma_mem_read(offset, 2);
+		return VMM_OK;
+	}
+
 	*dst = (u16)fw_cfg_data_mem_read(edev->priv, offset);
 
 	return VMM_OK;
@@ -290,7 +432,11 @@ static int fwcfg_emulator_read32(struct vmm_emudev *edev,
 				 physical_addr_t offset,
 				 u32 *dst)
 {
-	/* Always read zero */
+	if (offset >= FW_CFG_DMA_OFFSET) {
+		*dst = (u32)fw_cfg_dma_mem_read(offset, 4);
+		return VMM_OK;
+	}
+
 	*dst = (u32)fw_cfg_data_mem_read(edev->priv, offset);
 	return VMM_OK;
 }
@@ -345,16 +491,39 @@ static int fwcfg_emulator_write32(struct vmm_emudev *edev,
 		fw_cfg_data_mem_write(edev->priv, src);
 		break;
 	default:
-		return VMM_EFAIL;
+		return fw_cfg_dma_mem_write(edev->priv, offset, src, 4);
 	}
 
 	/* Ignore it. */
 	return VMM_OK;
 }
 
+static int fwcfg_emulator_read64(struct vmm_emudev *edev,
+				 physical_addr_t offset,
+				 u64 *dst)
+{
+	if (offset != FW_CFG_DMA_OFFSET) {
+		return VMM_EFAIL;
+	}
+
+	*dst = fw_cfg_dma_mem_read(offset, 8);
+
+	return VMM_OK;
+}
+
+static int fwcfg_emulator_write64(struct vmm_emudev *edev,
+				  physical_addr_t offset,
+				  u64 src)
+{
+	return fw_cfg_dma_mem_write(edev->priv, offset, src, 8);
+}
+
 static int fwcfg_emulator_reset(struct vmm_emudev *edev)
 {
-	fw_cfg_select(edev->priv, 0);
+	fw_cfg_state_t *s = edev->priv;
+
+	s->dma_addr = 0;
+	fw_cfg_select(s, 0);
 
 	return VMM_OK;
 }
@@ -370,7 +539,10 @@ static int fwcfg_emulator_probe(struct vmm_guest *guest,
 	if (!s)
 		return VMM_ENOMEM;
 
+	s->guest = guest;
+
 	fw_cfg_add_bytes(s, FW_CFG_SIGNATURE, (char *)"QEMU", 4);
+	fw_cfg_add_i32(s, FW_CFG_ID, FW_CFG_VERSION | FW_CFG_VERSION_DMA);
 	fw_cfg_add_i16(s, FW_CFG_NOGRAPHIC, 1);
 
 	/* SMP FIXME: Change when SMP support is added */
@@ -413,6 +585,8 @@ static struct vmm_emulator fwcfg_emulator = {
 	.write16 = fwcfg_emulator_write16,
 	.read32 = fwcfg_emulator_read32,
 	.write32 = fwcfg_emulator_write32,
+	.read64 = fwcfg_emulator_read64,
+	.write64 = fwcfg_emulator_write64,
 	.reset = fwcfg_emulator_reset,
 	.remove = fwcfg_emulator_remove,
 };
@@ -25,6 +25,8 @@ emulators-objs-$(CONFIG_EMU_MISC_ZERO)+= misc/zero.o
 emulators-objs-$(CONFIG_EMU_MISC_A9MPCORE)+= misc/a9mpcore.o
 emulators-objs-$(CONFIG_EMU_MISC_ARM11MPCORE)+= misc/arm11mpcore.o
 emulators-objs-$(CONFIG_EMU_MISC_PSM)+= misc/xpsm.o
+emulators-objs-$(CONFIG_EMU_MISC_VIRTIO_BALLOON)+= misc/virtio_balloon.o
+emulators-objs-$(CONFIG_EMU_MISC_VIRTIO_MEM)+= misc/virtio_mem.o
 emulators-objs-$(CONFIG_EMU_MISC_FW_CFG)+= misc/fw_cfg.o
 emulators-objs-$(CONFIG_EMU_MISC_IMX6_ANATOP)+= misc/imx_anatop.o
 emulators-objs-$(CONFIG_EMU_MISC_IMX6_CCM)+= misc/imx_ccm.o
@@ -0,0 +1,546 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file virtio_balloon.c
+ * @author agent (agent@local)
+ * @brief VirtIO based memory balloon Emulator.
+ *
+ * The host sets balloon size (num_pages) and the guest gives up pages
+ * through inflate queue and takes them back through deflate queue.
+ * Memory statistics of guest and free page reports are collected for
+ * the host through stats queue and page reporting queue.
+ *
+ * Guest RAM regions are backed by contiguous host RAM so pages given
+ * up by guest are only accounted and not returned to host RAM pool.
+ */
+
+#include <vmm_error.h>
+#include <vmm_macros.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_modules.h>
+#include <vmm_devemu.h>
+#include <vmm_spinlocks.h>
+#include <vmm_guest_aspace.h>
+#include <libs/stringlib.h>
+
+#include <emu/virtio.h>
+#include <emu/virtio_balloon.h>
+
+#define MODULE_DESC			"VirtIO Balloon Emulator"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(VIRTIO_IPRIORITY + 1)
+#define MODULE_INIT			virtio_balloon_init
+#define MODULE_EXIT			virtio_balloon_exit
+
+#define VIRTIO_BALLOON_QUEUE_SIZE	128
+#define VIRTIO_BALLOON_ARRAY_PFNS_MAX	256
+
+/* Logical queues (Note: guest numbers negotiated queues contiguously) */
+#define VIRTIO_BALLOON_INFLATE_QUEUE	0
+#define VIRTIO_BALLOON_DEFLATE_QUEUE	1
+#define VIRTIO_BALLOON_STATS_QUEUE	2
+#define VIRTIO_BALLOON_REPORTING_QUEUE	3
+#define VIRTIO_BALLOON_NUM_QUEUES	4
+
+struct virtio_balloon_dev {
+	struct virtio_device *vdev;
+
+	struct virtio_queue vqs[VIRTIO_BALLOON_NUM_QUEUES];
+	struct virtio_iovec iov[VIRTIO_BALLOON_QUEUE_SIZE];
+	struct virtio_balloon_config config;
+	u64 features;
+	u32 vq_map[VIRTIO_BALLOON_NUM_QUEUES];
+	u32 pfns[VIRTIO_BALLOON_ARRAY_PFNS_MAX];
+
+	/* Protects host view and stats buffer held by host */
+	vmm_spinlock_t lock;
+	struct virtio_balloon_info info;
+	bool stats_pending;
+	u16 stats_head;
+};
+
+extern struct virtio_emulator virtio_balloon;
+
+static u64 virtio_balloon_get_host_features(struct virtio_device *dev)
+{
+	return (1UL << VIRTIO_BALLOON_F_MUST_TELL_HOST) |
+	       (1UL << VIRTIO_BALLOON_F_STATS_VQ) |
+	       (1UL << VIRTIO_BALLOON_F_REPORTING);
+}
+
+static void virtio_balloon_set_guest_features(struct virtio_device *dev,
+					      u64 features)
+{
+	u32 q, vq = 0;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	bdev->features = features;
+
+	/* Optional queues not negotiated take no queue number */
+	for (q = 0; q < VIRTIO_BALLOON_NUM_QUEUES; q++) {
+		bdev->vq_map[q] = VIRTIO_BALLOON_NUM_QUEUES;
+	}
+	bdev->vq_map[vq++] = VIRTIO_BALLOON_INFLATE_QUEUE;
+	bdev->vq_map[vq++] = VIRTIO_BALLOON_DEFLATE_QUEUE;
+	if (features & (1UL << VIRTIO_BALLOON_F_STATS_VQ)) {
+		bdev->vq_map[vq++] = VIRTIO_BALLOON_STATS_QUEUE;
+	}
+	if (features & (1UL << VIRTIO_BALLOON_F_REPORTING)) {
+		bdev->vq_map[vq++] = VIRTIO_BALLOON_REPORTING_QUEUE;
+	}
+}
+
+static u32 virtio_balloon_queue(struct virtio_balloon_dev *bdev, u32 vq)
+{
+	return (vq < VIRTIO_BALLOON_NUM_QUEUES) ?
+			bdev->vq_map[vq] : VIRTIO_BALLOON_NUM_QUEUES;
+}
+
+static u32 virtio_balloon_vq_index(struct virtio_balloon_dev *bdev, u32 q)
+{
+	u32 vq;
+
+	for (vq = 0; vq < VIRTIO_BALLOON_NUM_QUEUES; vq++) {
+		if (bdev->vq_map[vq] == q) {
+			break;
+		}
+	}
+
+	return vq;
+}
+
+static int virtio_balloon_init_vq(struct virtio_device *dev,
+				  u32 vq, u32 page_size, u32 align, u32 pfn)
+{
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+	u32 q = virtio_balloon_queue(bdev, vq);
+
+	if (q == VIRTIO_BALLOON_NUM_QUEUES) {
+		return VMM_EINVALID;
+	}
+
+	return virtio_queue_setup(&bdev->vqs[q], dev->guest,
+			pfn, page_size, VIRTIO_BALLOON_QUEUE_SIZE, align);
+}
+
+static int virtio_balloon_get_pfn_vq(struct virtio_device *dev, u32 vq)
+{
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+	u32 q = virtio_balloon_queue(bdev, vq);
+
+	if (q == VIRTIO_BALLOON_NUM_QUEUES) {
+		return VMM_EINVALID;
+	}
+
+	return virtio_queue_guest_pfn(&bdev->vqs[q]);
+}
+
+static int virtio_balloon_get_size_vq(struct virtio_device *dev, u32 vq)
+{
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	if (virtio_balloon_queue(bdev, vq) == VIRTIO_BALLOON_NUM_QUEUES) {
+		return 0;
+	}
+
+	return VIRTIO_BALLOON_QUEUE_SIZE;
+}
+
+static int virtio_balloon_set_size_vq(struct virtio_device *dev,
+				      u32 vq, int size)
+{
+	/* FIXME: dynamic */
+	return size;
+}
+
+/* Count PFNs of inflate/deflate buffer which are backed by guest RAM */
+static u32 virtio_balloon_count_pfns(struct virtio_device *dev,
+				     struct virtio_balloon_dev *bdev,
+				     u32 count)
+{
+	u32 i, valid = 0;
+	struct vmm_region *reg;
+
+	for (i = 0; i < count; i++) {
+		reg = vmm_guest_find_region(dev->guest,
+			(physical_addr_t)bdev->pfns[i] << VIRTIO_BALLOON_PFN_SHIFT,
+			VMM_REGION_REAL | VMM_REGION_MEMORY | VMM_REGION_ISRAM,
+			FALSE);
+		if (reg) {
+			valid++;
+		}
+	}
+
+	return valid;
+}
+
+static int virtio_balloon_do_pfns(struct virtio_device *dev,
+				  struct virtio_balloon_dev *bdev,
+				  u32 q, bool inflate)
+{
+	u16 head = 0;
+	u32 len, count, iov_cnt = 0, total_len = 0;
+	irq_flags_t flags;
+	struct virtio_queue *vq = &bdev->vqs[q];
+
+	while (virtio_queue_available(vq)) {
+		head = virtio_queue_get_iovec(vq, bdev->iov,
+					      &iov_cnt, &total_len);
+		len = virtio_iovec_to_buf_read(dev, bdev->iov, iov_cnt,
+					       bdev->pfns, sizeof(bdev->pfns));
+		count = virtio_balloon_count_pfns(dev, bdev,
+						  len / sizeof(u32));
+
+		vmm_spin_lock_irqsave(&bdev->lock, flags);
+		if (inflate) {
+			bdev->info.inflated_pages += count;
+		} else if (count < bdev->info.inflated_pages) {
+			bdev->info.inflated_pages -= count;
+		} else {
+			bdev->info.inflated_pages = 0;
+		}
+		vmm_spin_unlock_irqrestore(&bdev->lock, flags);
+
+		virtio_queue_set_used_elem(vq, head, 0);
+	}
+
+	if (virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, virtio_balloon_vq_index(bdev, q));
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_balloon_do_stats(struct virtio_device *dev,
+				   struct virtio_balloon_dev *bdev)
+{
+	u16 head = 0;
+	u32 i, len, iov_cnt = 0, total_len = 0;
+	irq_flags_t flags;
+	struct virtio_balloon_stat stats[VIRTIO_BALLOON_S_NR];
+	struct virtio_queue *vq = &bdev->vqs[VIRTIO_BALLOON_STATS_QUEUE];
+
+	/* Guest always has one stats buffer which host holds on to
+	 * until it wants guest to refresh statistics.
+	 */
+	while (virtio_queue_available(vq)) {
+		head = virtio_queue_get_iovec(vq, bdev->iov,
+					      &iov_cnt, &total_len);
+		len = virtio_iovec_to_buf_read(dev, bdev->iov, iov_cnt,
+					       stats, sizeof(stats));
+
+		vmm_spin_lock_irqsave(&bdev->lock, flags);
+		for (i = 0; i < (len / sizeof(stats[0])); i++) {
+			if (stats[i].tag < VIRTIO_BALLOON_S_NR) {
+				bdev->info.stats[stats[i].tag] = stats[i].val;
+			}
+		}
+		bdev->info.stats_tstamp = vmm_timer_timestamp();
+		bdev->stats_pending = TRUE;
+		bdev->stats_head = head;
+		vmm_spin_unlock_irqrestore(&bdev->lock, flags);
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_balloon_do_reporting(struct virtio_device *dev,
+				       struct virtio_balloon_dev *bdev)
+{
+	u16 head = 0;
+	u32 iov_cnt = 0, total_len = 0;
+	irq_flags_t flags;
+	struct virtio_queue *vq = &bdev->vqs[VIRTIO_BALLOON_REPORTING_QUEUE];
+
+	/* Each descriptor of a report is a free guest RAM range */
+	while (virtio_queue_available(vq)) {
+		head = virtio_queue_get_iovec(vq, bdev->iov,
+					      &iov_cnt, &total_len);
+
+		vmm_spin_lock_irqsave(&bdev->lock, flags);
+		bdev->info.reported_bytes += total_len;
+		vmm_spin_unlock_irqrestore(&bdev->lock, flags);
+
+		virtio_queue_set_used_elem(vq, head, 0);
+	}
+
+	if (virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, virtio_balloon_vq_index(bdev,
+					VIRTIO_BALLOON_REPORTING_QUEUE));
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_balloon_notify_vq(struct virtio_device *dev, u32 vq)
+{
+	int rc = VMM_OK;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	switch (virtio_balloon_queue(bdev, vq)) {
+	case VIRTIO_BALLOON_INFLATE_QUEUE:
+		rc = virtio_balloon_do_pfns(dev, bdev,
+				VIRTIO_BALLOON_INFLATE_QUEUE, TRUE);
+		break;
+	case VIRTIO_BALLOON_DEFLATE_QUEUE:
+		rc = virtio_balloon_do_pfns(dev, bdev,
+				VIRTIO_BALLOON_DEFLATE_QUEUE, FALSE);
+		break;
+	case VIRTIO_BALLOON_STATS_QUEUE:
+		rc = virtio_balloon_do_stats(dev, bdev);
+		break;
+	case VIRTIO_BALLOON_REPORTING_QUEUE:
+		rc = virtio_balloon_do_reporting(dev, bdev);
+		break;
+	default:
+		rc = VMM_EINVALID;
+		break;
+	}
+
+	return rc;
+}
+
+static int virtio_balloon_read_config(struct virtio_device *dev,
+				      u32 offset, void *dst, u32 dst_len)
+{
+	u32 i;
+	irq_flags_t flags;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+	u8 *src = (u8 *)&bdev->config;
+
+	vmm_spin_lock_irqsave(&bdev->lock, flags);
+	for (i = 0; (i < dst_len) && ((offset + i) < sizeof(bdev->config));
+	     i++) {
+		*((u8 *)dst + i) = src[offset + i];
+	}
+	vmm_spin_unlock_irqrestore(&bdev->lock, flags);
+
+	return VMM_OK;
+}
+
+static int virtio_balloon_write_config(struct virtio_device *dev,
+				       u32 offset, void *src, u32 src_len)
+{
+	u32 i, start, end;
+	irq_flags_t flags;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+	u8 *dst = (u8 *)&bdev->config;
+
+	/* Guest can only update actual number of pages in balloon */
+	start = offsetof(struct virtio_balloon_config, actual);
+	end = start + sizeof(bdev->config.actual);
+
+	vmm_spin_lock_irqsave(&bdev->lock, flags);
+	for (i = 0; i < src_len; i++) {
+		if ((start <= (offset + i)) && ((offset + i) < end)) {
+			dst[offset + i] = *((u8 *)src + i);
+		}
+	}
+	bdev->info.actual_pages = bdev->config.actual;
+	vmm_spin_unlock_irqrestore(&bdev->lock, flags);
+
+	return VMM_OK;
+}
+
+static int virtio_balloon_reset(struct virtio_device *dev)
+{
+	int rc;
+	u32 q;
+	irq_flags_t flags;
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	/* Balloon is empty after reset but host target is retained */
+	vmm_spin_lock_irqsave(&bdev->lock, flags);
+	bdev->config.actual = 0;
+	bdev->info.actual_pages = 0;
+	bdev->info.inflated_pages = 0;
+	bdev->stats_pending = FALSE;
+	vmm_spin_unlock_irqrestore(&bdev->lock, flags);
+
+	virtio_balloon_set_guest_features(dev, 0);
+
+	for (q = 0; q < VIRTIO_BALLOON_NUM_QUEUES; q++) {
+		rc = virtio_queue_cleanup(&bdev->vqs[q]);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_balloon_connect(struct virtio_device *dev,
+				  struct virtio_emulator *emu)
+{
+	struct virtio_balloon_dev *bdev;
+
+	bdev = vmm_zalloc(sizeof(struct virtio_balloon_dev));
+	if (!bdev) {
+		vmm_printf("Failed to allocate virtio balloon device....\n");
+		return VMM_ENOMEM;
+	}
+	bdev->vdev = dev;
+	INIT_SPIN_LOCK(&bdev->lock);
+
+	dev->emu_data = bdev;
+
+	virtio_balloon_set_guest_features(dev, 0);
+
+	return VMM_OK;
+}
+
+static void virtio_balloon_disconnect(struct virtio_device *dev)
+{
+	struct virtio_balloon_dev *bdev = dev->emu_data;
+
+	vmm_free(bdev);
+}
+
+static struct virtio_balloon_dev *virtio_balloon_find(const char *name)
+{
+	struct virtio_device *dev = virtio_find_device(name);
+
+	if (!dev || (dev->emu != &virtio_balloon) || !dev->emu_data) {
+		return NULL;
+	}
+
+	return dev->emu_data;
+}
+
+int virtio_balloon_set_target(const char *name, u32 num_pages)
+{
+	irq_flags_t flags;
+	struct virtio_device *dev;
+	struct virtio_balloon_dev *bdev = virtio_balloon_find(name);
+
+	if (!bdev) {
+		return VMM_ENOTAVAIL;
+	}
+	dev = bdev->vdev;
+
+	vmm_spin_lock_irqsave(&bdev->lock, flags);
+	bdev->config.num_pages = num_pages;
+	bdev->info.target_pages = num_pages;
+	vmm_spin_unlock_irqrestore(&bdev->lock, flags);
+
+	if (dev->tra->notify_config) {
+		return dev->tra->notify_config(dev);
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(virtio_balloon_set_target);
+
+int virtio_balloon_request_stats(const char *name)
+{
+	u16 head;
+	bool pending;
+	irq_flags_t flags;
+	struct virtio_queue *vq;
+	struct virtio_device *dev;
+	struct virtio_balloon_dev *bdev = virtio_balloon_find(name);
+
+	if (!bdev) {
+		return VMM_ENOTAVAIL;
+	}
+	dev = bdev->vdev;
+	vq = &bdev->vqs[VIRTIO_BALLOON_STATS_QUEUE];
+
+	vmm_spin_lock_irqsave(&bdev->lock, flags);
+	pending = bdev->stats_pending;
+	head = bdev->stats_head;
+	bdev->stats_pending = FALSE;
+	vmm_spin_unlock_irqrestore(&bdev->lock, flags);
+
+	if (!pending) {
+		return VMM_ENOTAVAIL;
+	}
+
+	/* Returning stats buffer makes guest refill and queue it again */
+	virtio_queue_set_used_elem(vq, head, 0);
+	if (virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, virtio_balloon_vq_index(bdev,
+					VIRTIO_BALLOON_STATS_QUEUE));
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(virtio_balloon_request_stats);
+
+int virtio_balloon_get_info(const char *name, struct virtio_balloon_info *info)
+{
+	irq_flags_t flags;
+	struct virtio_balloon_dev *bdev = virtio_balloon_find(name);
+
+	if (!bdev || !info) {
+		return (!bdev) ? VMM_ENOTAVAIL : VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave(&bdev->lock, flags);
+	memcpy(info, &bdev->info, sizeof(*info));
+	vmm_spin_unlock_irqrestore(&bdev->lock, flags);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(virtio_balloon_get_info);
+
+struct virtio_device_id virtio_balloon_emu_id[] = {
+	{.type = VIRTIO_ID_BALLOON},
+	{ },
+};
+
+struct virtio_emulator virtio_balloon = {
+	.name = "virtio_balloon",
+	.id_table = virtio_balloon_emu_id,
+
+	/* VirtIO operations */
+	.get_host_features      = virtio_balloon_get_host_features,
+	.set_guest_features     = virtio_balloon_set_guest_features,
+	.init_vq                = virtio_balloon_init_vq,
+	.get_pfn_vq             = virtio_balloon_get_pfn_vq,
+	.get_size_vq            = virtio_balloon_get_size_vq,
+	.set_size_vq            = virtio_balloon_set_size_vq,
+	.notify_vq              = virtio_balloon_notify_vq,
+
+	/* Emulator operations */
+	.read_config = virtio_balloon_read_config,
+	.write_config = virtio_balloon_write_config,
+	.reset = virtio_balloon_reset,
+	.connect = virtio_balloon_connect,
+	.disconnect = virtio_balloon_disconnect,
+};
+
+static int __init virtio_balloon_init(void)
+{
+	return virtio_register_emulator(&virtio_balloon);
+}
+
+static void __exit virtio_balloon_exit(void)
+{
+	virtio_unregister_emulator(&virtio_balloon);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -0,0 +1,615 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file virtio_mem.c
+ * @author agent (agent@local)
+ * @brief VirtIO based memory device Emulator.
+ *
+ * The device owns a window of guest physical address space which is
+ * divided into blocks. The host sets how much memory guest should have
+ * plugged in the window (requested_size) and the guest plugs/unplugs
+ * blocks through its request queue.
+ *
+ * Each plugged block is a lazy alloced RAM region of guest hence host
+ * RAM is allocated and mapped in stage2 only when guest touches it and
+ * is given back to host as soon as guest unplugs the block. Unplugged
+ * blocks have no region so they are not accessible to guest.
+ *
+ * Plug/unplug requests are processed in Guest request context (not in
+ * VCPU context) because adding and deleting guest regions can sleep.
+ * As mandated by spec, plugged blocks survive device reset and guest
+ * driver unplugs them all when it finds plugged memory upon probe.
+ */
+
+#include <vmm_error.h>
+#include <vmm_macros.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_modules.h>
+#include <vmm_devemu.h>
+#include <vmm_devtree.h>
+#include <vmm_manager.h>
+#include <vmm_spinlocks.h>
+#include <vmm_host_aspace.h>
+#include <vmm_guest_aspace.h>
+#include <libs/stringlib.h>
+
+#include <emu/virtio.h>
+#include <emu/virtio_mem.h>
+
+#define MODULE_DESC			"VirtIO Mem Emulator"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(VIRTIO_IPRIORITY + 1)
+#define MODULE_INIT			virtio_mem_init
+#define MODULE_EXIT			virtio_mem_exit
+
+#define VIRTIO_MEM_QUEUE_SIZE		128
+#define VIRTIO_MEM_DEF_BLOCK_SIZE	0x200000
+
+struct virtio_mem_dev {
+	struct virtio_device *vdev;
+
+	struct virtio_queue vq;
+	struct virtio_iovec iov[VIRTIO_MEM_QUEUE_SIZE];
+	u64 features;
+
+	/* Guest region of each block (NULL if block is unplugged) */
+	u32 block_shift;
+	u32 nr_blocks;
+	struct vmm_region **blocks;
+
+	/* Protects queue, config and info */
+	vmm_spinlock_t lock;
+	struct virtio_mem_config config;
+	struct virtio_mem_info info;
+	bool req_pending;
+};
+
+extern struct virtio_emulator virtio_mem;
+
+static u64 virtio_mem_get_host_features(struct virtio_device *dev)
+{
+	return (1ULL << VIRTIO_F_VERSION_1) |
+	       (1ULL << VIRTIO_MEM_F_UNPLUGGED_INACCESSIBLE);
+}
+
+static void virtio_mem_set_guest_features(struct virtio_device *dev,
+					  u64 features)
+{
+	struct virtio_mem_dev *mdev = dev->emu_data;
+
+	mdev->features = features;
+	virtio_queue_set_features(&mdev->vq, features);
+}
+
+static int virtio_mem_init_vq(struct virtio_device *dev,
+			      u32 vq, u32 page_size, u32 align, u32 pfn)
+{
+	struct virtio_mem_dev *mdev = dev->emu_data;
+
+	if (vq) {
+		return VMM_EINVALID;
+	}
+
+	return virtio_queue_setup(&mdev->vq, dev->guest,
+			pfn, page_size, VIRTIO_MEM_QUEUE_SIZE, align);
+}
+
+static int virtio_mem_init_vq_addr(struct virtio_device *dev,
+				   u32 vq, u32 num, physical_addr_t desc,
+				   physical_addr_t driver,
+				   physical_addr_t device)
+{
+	struct virtio_mem_dev *mdev = dev->emu_data;
+
+	if (vq || !num || (VIRTIO_MEM_QUEUE_SIZE < num)) {
+		return VMM_EINVALID;
+	}
+
+	return virtio_queue_setup_addr(&mdev->vq, dev->guest,
+				       num, desc, driver, device);
+}
+
+static int virtio_mem_get_pfn_vq(struct virtio_device *dev, u32 vq)
+{
+	struct virtio_mem_dev *mdev = dev->emu_data;
+
+	if (vq) {
+		return VMM_EINVALID;
+	}
+
+	return virtio_queue_guest_pfn(&mdev->vq);
+}
+
+static int virtio_mem_get_size_vq(struct virtio_device *dev, u32 vq)
+{
+	return (vq) ? 0 : VIRTIO_MEM_QUEUE_SIZE;
+}
+
+static int virtio_mem_set_size_vq(struct virtio_device *dev,
+				  u32 vq, int size)
+{
+	/* FIXME: dynamic */
+	return size;
+}
+
+/* Convert request range to first block and check it is usable */
+static bool virtio_mem_range_valid(struct virtio_mem_dev *mdev,
+				   u64 addr, u16 nb_blocks, u32 *first)
+{
+	u64 off, usable_blocks;
+
+	usable_blocks = mdev->config.usable_region_size >> mdev->block_shift;
+	if (!nb_blocks || (addr < mdev->config.addr)) {
+		return FALSE;
+	}
+	off = addr - mdev->config.addr;
+	if (off & (mdev->config.block_size - 1)) {
+		return FALSE;
+	}
+	off = off >> mdev->block_shift;
+	if ((usable_blocks <= off) || ((usable_blocks - off) < nb_blocks)) {
+		return FALSE;
+	}
+
+	*first = off;
+
+	return TRUE;
+}
+
+static u32 virtio_mem_count_plugged(struct virtio_mem_dev *mdev,
+				    u32 first, u32 count)
+{
+	u32 b, plugged = 0;
+
+	for (b = first; b < (first + count); b++) {
+		if (mdev->blocks[b]) {
+			plugged++;
+		}
+	}
+
+	return plugged;
+}
+
+static void virtio_mem_unplug_blocks(struct virtio_mem_dev *mdev,
+				     u32 first, u32 count)
+{
+	u32 b;
+	int rc;
+	struct vmm_guest *guest = mdev->vdev->guest;
+
+	/* Unplugged blocks go away together upon commit */
+	vmm_guest_aspace_batch_begin(guest);
+	for (b = first; b < (first + count); b++) {
+		if (!mdev->blocks[b]) {
+			continue;
+		}
+		rc = vmm_guest_unplug_ram(guest, mdev->blocks[b]);
+		if (rc) {
+			vmm_printf("%s: %s failed to unplug block %d "
+				   "(error %d)\n", __func__,
+				   mdev->vdev->name, b, rc);
+		}
+		mdev->blocks[b] = NULL;
+	}
+	vmm_guest_aspace_batch_commit(guest);
+}
+
+static u16 virtio_mem_plug_blocks(struct virtio_mem_dev *mdev,
+				  u32 first, u32 count)
+{
+	u32 b;
+	int rc = VMM_OK;
+	physical_addr_t gphys;
+	char name[VMM_FIELD_NAME_SIZE];
+	struct vmm_guest *guest = mdev->vdev->guest;
+
+	/* Plugged blocks are notified to listeners as one batch */
+	vmm_guest_aspace_batch_begin(guest);
+	for (b = first; b < (first + count); b++) {
+		gphys = mdev->config.addr + ((u64)b << mdev->block_shift);
+		vmm_snprintf(name, sizeof(name), "%s_block%d",
+			     mdev->vdev->edev->node->name, b);
+		rc = vmm_guest_hotplug_ram(guest, name, gphys,
+					   mdev->config.block_size,
+					   &mdev->blocks[b]);
+		if (rc) {
+			vmm_printf("%s: %s failed to plug block %d "
+				   "(error %d)\n", __func__,
+				   mdev->vdev->name, b, rc);
+			mdev->blocks[b] = NULL;
+			break;
+		}
+	}
+	vmm_guest_aspace_batch_commit(guest);
+
+	/* Request is either done completely or not at all */
+	if (rc) {
+		virtio_mem_unplug_blocks(mdev, first, b - first);
+		return VIRTIO_MEM_RESP_NACK;
+	}
+
+	return VIRTIO_MEM_RESP_ACK;
+}
+
+static u16 virtio_mem_do_request(struct virtio_mem_dev *mdev,
+				 struct virtio_mem_req *req,
+				 struct virtio_mem_resp *resp)
+{
+	u16 ret;
+	u32 first = 0, plugged;
+	u64 size, requested_size;
+	irq_flags_t flags;
+
+	if (req->type == VIRTIO_MEM_REQ_UNPLUG_ALL) {
+		virtio_mem_unplug_blocks(mdev, 0, mdev->nr_blocks);
+		vmm_spin_lock_irqsave(&mdev->lock, flags);
+		mdev->config.plugged_size = 0;
+		vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+		return VIRTIO_MEM_RESP_ACK;
+	}
+
+	if (!virtio_mem_range_valid(mdev, req->u.addr,
+				    req->u.nb_blocks, &first)) {
+		return VIRTIO_MEM_RESP_ERROR;
+	}
+	plugged = virtio_mem_count_plugged(mdev, first, req->u.nb_blocks);
+	size = (u64)req->u.nb_blocks << mdev->block_shift;
+
+	switch (req->type) {
+	case VIRTIO_MEM_REQ_PLUG:
+		if (plugged) {
+			return VIRTIO_MEM_RESP_ERROR;
+		}
+		vmm_spin_lock_irqsave(&mdev->lock, flags);
+		requested_size = mdev->config.requested_size;
+		vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+		if (requested_size < (mdev->config.plugged_size + size)) {
+			return VIRTIO_MEM_RESP_NACK;
+		}
+		ret = virtio_mem_plug_blocks(mdev, first, req->u.nb_blocks);
+		if (ret == VIRTIO_MEM_RESP_ACK) {
+			vmm_spin_lock_irqsave(&mdev->lock, flags);
+			mdev->config.plugged_size += size;
+			vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+		}
+		return ret;
+	case VIRTIO_MEM_REQ_UNPLUG:
+		if (plugged != req->u.nb_blocks) {
+			return VIRTIO_MEM_RESP_ERROR;
+		}
+		virtio_mem_unplug_blocks(mdev, first, req->u.nb_blocks);
+		vmm_spin_lock_irqsave(&mdev->lock, flags);
+		mdev->config.plugged_size -= size;
+		vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+		return VIRTIO_MEM_RESP_ACK;
+	case VIRTIO_MEM_REQ_STATE:
+		if (!plugged) {
+			resp->state = VIRTIO_MEM_STATE_UNPLUGGED;
+		} else if (plugged == req->u.nb_blocks) {
+			resp->state = VIRTIO_MEM_STATE_PLUGGED;
+		} else {
+			resp->state = VIRTIO_MEM_STATE_MIXED;
+		}
+		return VIRTIO_MEM_RESP_ACK;
+	default:
+		break;
+	}
+
+	return VIRTIO_MEM_RESP_ERROR;
+}
+
+static void virtio_mem_do_requests(struct vmm_guest *guest, void *data)
+{
+	u16 head;
+	u32 len, iov_cnt, total_len;
+	irq_flags_t flags;
+	struct virtio_mem_req req;
+	struct virtio_mem_resp resp;
+	struct virtio_mem_dev *mdev = data;
+	struct virtio_device *dev = mdev->vdev;
+	struct virtio_queue *vq = &mdev->vq;
+
+	vmm_spin_lock_irqsave(&mdev->lock, flags);
+	mdev->req_pending = FALSE;
+	while (virtio_queue_available(vq)) {
+		iov_cnt = total_len = 0;
+		head = virtio_queue_get_iovec(vq, mdev->iov,
+					      &iov_cnt, &total_len);
+		memset(&req, 0, sizeof(req));
+		len = 0;
+		if (iov_cnt > 1) {
+			len = virtio_iovec_to_buf_read(dev, &mdev->iov[0], 1,
+						       &req, sizeof(req));
+		}
+		vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+
+		/* Device reset in-between makes queue unavailable below */
+		memset(&resp, 0, sizeof(resp));
+		if (len < sizeof(req)) {
+			resp.type = VIRTIO_MEM_RESP_ERROR;
+		} else {
+			resp.type = virtio_mem_do_request(mdev, &req, &resp);
+		}
+
+		vmm_spin_lock_irqsave(&mdev->lock, flags);
+		switch (resp.type) {
+		case VIRTIO_MEM_RESP_ACK:
+			if (req.type == VIRTIO_MEM_REQ_PLUG) {
+				mdev->info.plug_count++;
+			} else if (req.type != VIRTIO_MEM_REQ_STATE) {
+				mdev->info.unplug_count++;
+			}
+			break;
+		case VIRTIO_MEM_RESP_NACK:
+			mdev->info.nack_count++;
+			break;
+		default:
+			mdev->info.error_count++;
+			break;
+		}
+		if (!virtio_queue_setup_done(vq)) {
+			break;
+		}
+		len = 0;
+		if (iov_cnt > 1) {
+			len = virtio_buf_to_iovec_write(dev,
+					&mdev->iov[iov_cnt - 1], 1,
+					&resp, sizeof(resp));
+		}
+		virtio_queue_set_used_elem(vq, head, len);
+	}
+	if (virtio_queue_setup_done(vq) && virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, 0);
+	}
+	vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+}
+
+static int virtio_mem_notify_vq(struct virtio_device *dev, u32 vq)
+{
+	int rc = VMM_OK;
+	irq_flags_t flags;
+	struct virtio_mem_dev *mdev = dev->emu_data;
+
+	if (vq) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave(&mdev->lock, flags);
+	if (!mdev->req_pending) {
+		rc = vmm_manager_guest_request(dev->guest,
+					       virtio_mem_do_requests, mdev);
+		mdev->req_pending = (rc) ? FALSE : TRUE;
+	}
+	vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+
+	return rc;
+}
+
+static int virtio_mem_read_config(struct virtio_device *dev,
+				  u32 offset, void *dst, u32 dst_len)
+{
+	u32 i;
+	irq_flags_t flags;
+	struct virtio_mem_dev *mdev = dev->emu_data;
+	u8 *src = (u8 *)&mdev->config;
+
+	vmm_spin_lock_irqsave(&mdev->lock, flags);
+	for (i = 0; (i < dst_len) && ((offset + i) < sizeof(mdev->config));
+	     i++) {
+		*((u8 *)dst + i) = src[offset + i];
+	}
+	vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+
+	return VMM_OK;
+}
+
+static int virtio_mem_write_config(struct virtio_device *dev,
+				   u32 offset, void *src, u32 src_len)
+{
+	/* Config space is read-only for guest */
+	return VMM_OK;
+}
+
+static int virtio_mem_reset(struct virtio_device *dev)
+{
+	int rc;
+	irq_flags_t flags;
+	struct virtio_mem_dev *mdev = dev->emu_data;
+
+	vmm_spin_lock_irqsave(&mdev->lock, flags);
+	rc = virtio_queue_cleanup(&mdev->vq);
+	vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+
+	return rc;
+}
+
+static int virtio_mem_connect(struct virtio_device *dev,
+			      struct virtio_emulator *emu)
+{
+	physical_addr_t addr;
+	physical_size_t size, block_size, requested_size;
+	struct virtio_mem_dev *mdev;
+	struct vmm_devtree_node *node = dev->edev->node;
+
+	if (vmm_devtree_read_physaddr(node, "mem_addr", &addr) ||
+	    vmm_devtree_read_physsize(node, "mem_size", &size)) {
+		vmm_printf("%s: %s mem_addr or mem_size not available\n",
+			   __func__, dev->name);
+		return VMM_EINVALID;
+	}
+	if (vmm_devtree_read_physsize(node, "block_size", &block_size)) {
+		block_size = VIRTIO_MEM_DEF_BLOCK_SIZE;
+	}
+	if (vmm_devtree_read_physsize(node, "requested_size",
+				      &requested_size)) {
+		requested_size = 0;
+	}
+	if ((block_size < VMM_PAGE_SIZE) ||
+	    (block_size & (block_size - 1)) ||
+	    (addr & (block_size - 1)) || !size ||
+	    (size & (block_size - 1))) {
+		vmm_printf("%s: %s mem_addr, mem_size or block_size "
+			   "not valid\n", __func__, dev->name);
+		return VMM_EINVALID;
+	}
+
+	mdev = vmm_zalloc(sizeof(struct virtio_mem_dev));
+	if (!mdev) {
+		vmm_printf("Failed to allocate virtio mem device....\n");
+		return VMM_ENOMEM;
+	}
+	mdev->vdev = dev;
+	INIT_SPIN_LOCK(&mdev->lock);
+
+	while (((physical_size_t)1 << mdev->block_shift) < block_size) {
+		mdev->block_shift++;
+	}
+	mdev->nr_blocks = size >> mdev->block_shift;
+	mdev->blocks = vmm_zalloc(mdev->nr_blocks * sizeof(*mdev->blocks));
+	if (!mdev->blocks) {
+		vmm_printf("Failed to allocate virtio mem blocks....\n");
+		vmm_free(mdev);
+		return VMM_ENOMEM;
+	}
+
+	mdev->config.block_size = block_size;
+	mdev->config.addr = addr;
+	mdev->config.region_size = size;
+	mdev->config.usable_region_size = size;
+	mdev->config.requested_size = (requested_size < size) ?
+		round_up(requested_size, block_size) : size;
+
+	dev->emu_data = mdev;
+
+	return VMM_OK;
+}
+
+static void virtio_mem_disconnect(struct virtio_device *dev)
+{
+	struct virtio_mem_dev *mdev = dev->emu_data;
+
+	/* Plugged blocks go away with guest address space */
+	vmm_free(mdev->blocks);
+	vmm_free(mdev);
+}
+
+static struct virtio_mem_dev *virtio_mem_find(const char *name)
+{
+	struct virtio_device *dev = virtio_find_device(name);
+
+	if (!dev || (dev->emu != &virtio_mem) || !dev->emu_data) {
+		return NULL;
+	}
+
+	return dev->emu_data;
+}
+
+int virtio_mem_set_requested(const char *name, u64 size)
+{
+	irq_flags_t flags;
+	struct virtio_device *dev;
+	struct virtio_mem_dev *mdev = virtio_mem_find(name);
+
+	if (!mdev) {
+		return VMM_ENOTAVAIL;
+	}
+	dev = mdev->vdev;
+	if (mdev->config.region_size < size) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave(&mdev->lock, flags);
+	mdev->config.requested_size =
+		round_up(size, mdev->config.block_size);
+	vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+
+	if (dev->tra->notify_config) {
+		return dev->tra->notify_config(dev);
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(virtio_mem_set_requested);
+
+int virtio_mem_get_info(const char *name, struct virtio_mem_info *info)
+{
+	irq_flags_t flags;
+	struct virtio_mem_dev *mdev = virtio_mem_find(name);
+
+	if (!mdev || !info) {
+		return (!mdev) ? VMM_ENOTAVAIL : VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave(&mdev->lock, flags);
+	memcpy(info, &mdev->info, sizeof(*info));
+	info->addr = mdev->config.addr;
+	info->region_size = mdev->config.region_size;
+	info->block_size = mdev->config.block_size;
+	info->requested_size = mdev->config.requested_size;
+	info->plugged_size = mdev->config.plugged_size;
+	vmm_spin_unlock_irqrestore(&mdev->lock, flags);
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(virtio_mem_get_info);
+
+struct virtio_device_id virtio_mem_emu_id[] = {
+	{.type = VIRTIO_ID_MEM},
+	{ },
+};
+
+struct virtio_emulator virtio_mem = {
+	.name = "virtio_mem",
+	.id_table = virtio_mem_emu_id,
+
+	/* VirtIO operations */
+	.get_host_features      = virtio_mem_get_host_features,
+	.set_guest_features     = virtio_mem_set_guest_features,
+	.init_vq                = virtio_mem_init_vq,
+	.init_vq_addr           = virtio_mem_init_vq_addr,
+	.get_pfn_vq             = virtio_mem_get_pfn_vq,
+	.get_size_vq            = virtio_mem_get_size_vq,
+	.set_size_vq            = virtio_mem_set_size_vq,
+	.notify_vq              = virtio_mem_notify_vq,
+
+	/* Emulator operations */
+	.read_config = virtio_mem_read_config,
+	.write_config = virtio_mem_write_config,
+	.reset = virtio_mem_reset,
+	.connect = virtio_mem_connect,
+	.disconnect = virtio_mem_disconnect,
+};
+
+static int __init virtio_mem_init(void)
+{
+	return virtio_register_emulator(&virtio_mem);
+}
+
+static void __exit virtio_mem_exit(void)
+{
+	virtio_unregister_emulator(&virtio_mem);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
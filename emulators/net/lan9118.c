@@ -1433,6 +1433,7 @@ static int lan9118_emulator_probe(struct vmm_guest *guest,
 	s->port->can_receive = lan9118_can_receive;
 	s->port->switch2port_xfer = lan9118_switch2port_xfer;
 	s->port->priv = s;
+	vmm_netport_qos_setup(s->port, edev->node);
 
 	rc = vmm_netport_register(s->port);
 	if (rc) {
@@ -1463,6 +1464,10 @@ static int lan9118_emulator_probe(struct vmm_guest *guest,
 	MGETHDR(txp_mbuf(s), 0, 0);
 	MEXTMALLOC(txp_mbuf(s), LAN9118_MTU, 0);
 
+	/* RX and TX data FIFO ports are streamed by guest */
+	vmm_devemu_add_fifo_range(edev, 0x00, 0x20);
+	vmm_devemu_add_fifo_range(edev, 0x20, 0x20);
+
 	goto lan9118_emulator_probe_done;
 
 lan9118_emulator_probe_freeport_failed:
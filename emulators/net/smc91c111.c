@@ -1010,6 +1010,7 @@ static int smc91c111_emulator_probe(struct vmm_guest *guest,
 	s->port->can_receive = smc91c111_can_receive;
 	s->port->switch2port_xfer = smc91c111_switch2port_xfer;
 	s->port->priv = s;
+	vmm_netport_qos_setup(s->port, edev->node);
 
 	rc = vmm_netport_register(s->port);
 	if (rc) {
@@ -1030,6 +1031,9 @@ static int smc91c111_emulator_probe(struct vmm_guest *guest,
 		s->mac[i] = vmm_netport_mac(s->port)[i];
 	}
 
+	/* Bank 2 data register is streamed by guest */
+	vmm_devemu_add_fifo_range(edev, 0x8, 0x4);
+
 	goto smc91c111_probe_done;
 
 smc91c111_probe_netport_failed:
@@ -25,6 +25,9 @@
 #include <vmm_heap.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <vmm_delay.h>
+#include <vmm_spinlocks.h>
+#include <arch_atomic.h>
 
 #include <net/vmm_protocol.h>
 #include <net/vmm_mbuf.h>
@@ -51,9 +54,27 @@
 #define VIRTIO_NET_CTRL_QUEUE		3
 
 #define VIRTIO_NET_MTU			1514
+#define VIRTIO_NET_GSO_MAX_LEN		(0x10000 + ETHER_HLEN + 4)
+#define VIRTIO_NET_RX_MAX_BUFS		64
+#define VIRTIO_NET_RX_HDR_IOVS		2
+
+#define VIRTIO_NET_PORT_OFFLOADS	(VMM_NETPORT_OFFLOAD_CSUM | \
+					 VMM_NETPORT_OFFLOAD_TSO4 | \
+					 VMM_NETPORT_OFFLOAD_TSO6)
 
 #define VIRTIO_NET_TX_LAZY_BUDGET	(VIRTIO_NET_QUEUE_SIZE / 4)
 
+#define VIRTIO_NET_TX_DRAIN_MSECS	1000
+#define VIRTIO_NET_TX_NO_HEAD		0xFFFF
+
+/* TX buffer lent to netswitch without copying */
+struct virtio_net_txbuf {
+	struct virtio_net_queue *q;
+	u16 head;
+	u32 len;
+	u32 cookie;
+};
+
 struct virtio_net_queue {
 	int num;
 	int valid;
@@ -61,6 +82,9 @@ struct virtio_net_queue {
 	struct virtio_queue vq;
 	struct virtio_iovec iov[VIRTIO_NET_QUEUE_SIZE];
 	struct virtio_net_dev *ndev;
+	/* Protects used ring updates of TX queue */
+	vmm_spinlock_t used_lock;
+	struct virtio_net_txbuf txbufs[VIRTIO_NET_QUEUE_SIZE];
 };
 
 struct virtio_net_dev {
@@ -69,42 +93,74 @@ struct virtio_net_dev {
 	struct virtio_net_queue *vqs;
 	u32 cq;		/* Configuration queue number */
 	u32 max_queues;
+	u32 curr_queue_pairs;
+	u32 tx_hash_base;
+	atomic_t tx_inflight;
 	u32 can_receive;
 	struct virtio_net_config config;
-	u32 features;
+	u64 features;
+	u32 hdr_len;
 
 	int mode;
 	struct vmm_netport *port;
 	char name[VIRTIO_DEVICE_MAX_NAME_LEN];
 };
 
-static u32 virtio_net_get_host_features(struct virtio_device *dev)
+/* Spreads TX queues of different devices on netswitch bottom-halves */
+static u32 virtio_net_count;
+
+static u64 virtio_net_get_host_features(struct virtio_device *dev)
 {
 	return 1UL << VIRTIO_NET_F_MAC
-#if 0
 		| 1UL << VIRTIO_NET_F_CSUM
-		| 1UL << VIRTIO_NET_F_HOST_UFO
+		| 1UL << VIRTIO_NET_F_GUEST_CSUM
 		| 1UL << VIRTIO_NET_F_HOST_TSO4
 		| 1UL << VIRTIO_NET_F_HOST_TSO6
-		| 1UL << VIRTIO_NET_F_GUEST_UFO
 		| 1UL << VIRTIO_NET_F_GUEST_TSO4
 		| 1UL << VIRTIO_NET_F_GUEST_TSO6
+		| 1UL << VIRTIO_NET_F_MRG_RXBUF
+#if 0
+		| 1UL << VIRTIO_NET_F_HOST_UFO
+		| 1UL << VIRTIO_NET_F_GUEST_UFO
 #endif
 		| 1UL << VIRTIO_RING_F_EVENT_IDX
-#if 0
 		| 1UL << VIRTIO_RING_F_INDIRECT_DESC
-#endif
 		| 1UL << VIRTIO_NET_F_MQ
 		| 1UL << VIRTIO_NET_F_CTRL_VQ
 		;
 }
 
 static void virtio_net_set_guest_features(struct virtio_device *dev,
-					  u32 features)
+					  u64 features)
 {
+	u32 i;
 	struct virtio_net_dev *ndev = dev->emu_data;
 
 	ndev->features = features;
+	if (!(features & (1UL << VIRTIO_NET_F_MQ))) {
+		ndev->curr_queue_pairs = 1;
+	}
+
+	if (features & (1UL << VIRTIO_NET_F_MRG_RXBUF)) {
+		ndev->hdr_len = sizeof(struct virtio_net_hdr_mrg_rxbuf);
+	} else {
+		ndev->hdr_len = sizeof(struct virtio_net_hdr);
+	}
+
+	/* Packets for guest keep offload metadata if guest can take it */
+	ndev->port->flags &= ~VIRTIO_NET_PORT_OFFLOADS;
+	if (features & (1UL << VIRTIO_NET_F_GUEST_CSUM)) {
+		ndev->port->flags |= VMM_NETPORT_OFFLOAD_CSUM;
+	}
+	if (features & (1UL << VIRTIO_NET_F_GUEST_TSO4)) {
+		ndev->port->flags |= VMM_NETPORT_OFFLOAD_TSO4;
+	}
+	if (features & (1UL << VIRTIO_NET_F_GUEST_TSO6)) {
+		ndev->port->flags |= VMM_NETPORT_OFFLOAD_TSO6;
+	}
+	for (i = 0; i < ndev->max_queues; i++) {
+		virtio_queue_set_features(&ndev->vqs[i].vq, features);
+	}
 }
 
 static int virtio_net_init_vq(struct virtio_device *dev,
@@ -152,41 +208,225 @@ static int virtio_net_set_size_vq(struct virtio_device *dev, u32 vq, int size)
 
 static void virtio_net_tx_poke(struct virtio_net_dev *ndev, u32 vq);
 
+static void virtio_net_iov_skip(struct virtio_iovec **iov, u32 *iov_cnt,
+				u32 skip)
+{
+	while (skip && *iov_cnt) {
+		if ((*iov)->len <= skip) {
+			skip -= (*iov)->len;
+			(*iov)++;
+			(*iov_cnt)--;
+		} else {
+			(*iov)->addr += skip;
+			(*iov)->len -= skip;
+			skip = 0;
+		}
+	}
+}
+
+/* Write to guest IO vectors starting at given byte offset */
+static u32 virtio_net_iov_write(struct virtio_device *dev,
+				struct virtio_iovec *iov, u32 iov_cnt,
+				u32 off, void *buf, u32 len)
+{
+	u32 i, chunk, pos = 0;
+	struct virtio_iovec tmp;
+
+	for (i = 0; (i < iov_cnt) && (pos < len); i++) {
+		if (iov[i].len <= off) {
+			off -= iov[i].len;
+			continue;
+		}
+		tmp = iov[i];
+		tmp.addr += off;
+		tmp.len -= off;
+		off = 0;
+		chunk = ((len - pos) < tmp.len) ? (len - pos) : tmp.len;
+		chunk = virtio_buf_to_iovec_write(dev, &tmp, 1,
+						  buf + pos, chunk);
+		if (!chunk) {
+			break;
+		}
+		pos += chunk;
+	}
+
+	return pos;
+}
+
+/* Convert virtio-net header of TX packet into mbuf offload metadata */
+static int virtio_net_tx_offload(struct virtio_net_dev *ndev,
+				 struct virtio_net_hdr *hdr,
+				 struct vmm_mbuf *mb)
+{
+	switch (hdr->gso_type & ~VIRTIO_NET_HDR_GSO_ECN) {
+	case VIRTIO_NET_HDR_GSO_NONE:
+		mb->m_pkthdr.gso_type = M_GSO_NONE;
+		break;
+	case VIRTIO_NET_HDR_GSO_TCPV4:
+		if (!(ndev->features & (1UL << VIRTIO_NET_F_HOST_TSO4))) {
+			return VMM_EINVALID;
+		}
+		mb->m_pkthdr.gso_type = M_GSO_TCPV4;
+		break;
+	case VIRTIO_NET_HDR_GSO_TCPV6:
+		if (!(ndev->features & (1UL << VIRTIO_NET_F_HOST_TSO6))) {
+			return VMM_EINVALID;
+		}
+		mb->m_pkthdr.gso_type = M_GSO_TCPV6;
+		break;
+	default:
+		return VMM_EINVALID;
+	};
+
+	if (mb->m_pkthdr.gso_type != M_GSO_NONE) {
+		if (!hdr->gso_size ||
+		    !(hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM)) {
+			return VMM_EINVALID;
+		}
+		mb->m_pkthdr.gso_size = hdr->gso_size;
+	}
+
+	if ((hdr->flags & VIRTIO_NET_HDR_F_NEEDS_CSUM) &&
+	    (ndev->features & (1UL << VIRTIO_NET_F_CSUM))) {
+		if (mb->m_pktlen < (hdr->csum_start + hdr->csum_offset + 2)) {
+			return VMM_EINVALID;
+		}
+		mb->m_pkthdr.csum_flags = M_CSUM_PARTIAL;
+		mb->m_pkthdr.csum_start = hdr->csum_start;
+		mb->m_pkthdr.csum_offset = hdr->csum_offset;
+	}
+
+	return VMM_OK;
+}
+
+static void virtio_net_tx_used(struct virtio_net_queue *q,
+			       u16 head, u32 len, bool signal)
+{
+	irq_flags_t flags;
+	struct virtio_device *dev = q->ndev->vdev;
+
+	vmm_spin_lock_irqsave_lite(&q->used_lock, flags);
+	if (q->valid) {
+		if (head != VIRTIO_NET_TX_NO_HEAD) {
+			virtio_queue_set_used_elem(&q->vq, head, len);
+		}
+		if (signal && virtio_queue_should_signal(&q->vq)) {
+			dev->tra->notify(dev, q->num);
+		}
+	}
+	vmm_spin_unlock_irqrestore_lite(&q->used_lock, flags);
+}
+
+static void virtio_net_tx_ext_free(struct vmm_mbuf *mb, void *buf,
+				   u32 size, void *arg)
+{
+	struct virtio_net_txbuf *txb = arg;
+	struct virtio_net_dev *ndev = txb->q->ndev;
+
+	/* Guest TX buffer is released only after last reference */
+	virtio_net_tx_used(txb->q, txb->head, txb->len, TRUE);
+	vmm_guest_mapcache_put(&ndev->vdev->mcache, txb->cookie);
+	arch_atomic_dec(&ndev->tx_inflight);
+}
+
+/* Wrap guest TX buffer in mbuf without copying */
+static struct vmm_mbuf *virtio_net_tx_zerocopy(struct virtio_net_queue *q,
+					       u16 head, u32 total_len,
+					       struct virtio_iovec *iov)
+{
+	u32 cookie;
+	virtual_addr_t va;
+	struct vmm_mbuf *mb;
+	struct virtio_net_txbuf *txb;
+	struct virtio_net_dev *ndev = q->ndev;
+
+	if (VIRTIO_NET_QUEUE_SIZE <= head) {
+		return NULL;
+	}
+
+	if (vmm_guest_mapcache_get(&ndev->vdev->mcache, iov->addr,
+				   iov->len, &va, &cookie)) {
+		return NULL;
+	}
+
+	MGETHDR(mb, 0, 0);
+	if (!mb) {
+		vmm_guest_mapcache_put(&ndev->vdev->mcache, cookie);
+		return NULL;
+	}
+
+	txb = &q->txbufs[head];
+	txb->q = q;
+	txb->head = head;
+	txb->len = total_len;
+	txb->cookie = cookie;
+	arch_atomic_inc(&ndev->tx_inflight);
+
+	MEXTADD(mb, va, iov->len, virtio_net_tx_ext_free, txb);
+	mb->m_len = mb->m_pktlen = iov->len;
+
+	return mb;
+}
+
 static void virtio_net_tx_lazy(struct vmm_netport *port, void *arg, int budget)
 {
 	u16 head = 0;
-	u32 iov_cnt = 0, pkt_len = 0, total_len = 0;
+	u32 iov_cnt = 0, pkt_len = 0, total_len = 0, max_len;
 	struct virtio_net_queue *q = arg;
 	struct virtio_queue *vq = &q->vq;
 	struct virtio_net_dev *ndev = q->ndev;
 	struct virtio_device *dev = ndev->vdev;
-	struct virtio_iovec *iov = q->iov;
+	struct virtio_iovec *iov;
+	struct virtio_net_hdr hdr;
 	struct vmm_mbuf *mb;
 
+	max_len = (ndev->features & ((1UL << VIRTIO_NET_F_HOST_TSO4) |
+				     (1UL << VIRTIO_NET_F_HOST_TSO6))) ?
+		  VIRTIO_NET_GSO_MAX_LEN : VIRTIO_NET_MTU;
+
 	while ((budget > 0) && virtio_queue_available(vq)) {
+		iov = q->iov;
 		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
 
-		/* iov[0] is offload info */
-		pkt_len = total_len - iov[0].len;
+		budget--;
 
-		if (pkt_len <= VIRTIO_NET_MTU) {
+		/* Packet starts with virtio-net header (offload info) */
+		if ((total_len < ndev->hdr_len) ||
+		    ((total_len - ndev->hdr_len) > max_len)) {
+			virtio_net_tx_used(q, head, total_len, FALSE);
+			continue;
+		}
+		memset(&hdr, 0, sizeof(hdr));
+		virtio_iovec_to_buf_read(dev, iov, iov_cnt, &hdr, sizeof(hdr));
+		virtio_net_iov_skip(&iov, &iov_cnt, ndev->hdr_len);
+		pkt_len = total_len - ndev->hdr_len;
+
+		/* Packet in single guest buffer is forwarded without
+		 * copying and completed when netswitch drops the mbuf.
+		 */
+		mb = NULL;
+		if (iov_cnt == 1) {
+			mb = virtio_net_tx_zerocopy(q, head, total_len, iov);
+		}
+		if (!mb) {
 			MGETHDR(mb, 0, 0);
 			MEXTMALLOC(mb, pkt_len, 0);
-			virtio_iovec_to_buf_read(dev, 
-						 &iov[1], iov_cnt - 1,
+			virtio_iovec_to_buf_read(dev, iov, iov_cnt,
 						 M_BUFADDR(mb), pkt_len);
 			mb->m_len = mb->m_pktlen = pkt_len;
-			vmm_port2switch_xfer_mbuf(ndev->port, mb);
+			virtio_net_tx_used(q, head, total_len, FALSE);
 		}
 
-		virtio_queue_set_used_elem(vq, head, total_len);
+		if (virtio_net_tx_offload(ndev, &hdr, mb)) {
+			m_freem(mb);
+			continue;
+		}
 
-		budget--;
+		vmm_port2switch_xfer_mbuf(ndev->port, mb);
 	}
 
-	if (virtio_queue_should_signal(vq)) {
-		dev->tra->notify(dev, q->num);
-	}
+	/* Signal copied TX buffers once per batch */
+	virtio_net_tx_used(q, VIRTIO_NET_TX_NO_HEAD, 0, TRUE);
 
 	virtio_net_tx_poke(ndev, q->num);
 }
@@ -195,9 +435,15 @@ static void virtio_net_tx_poke(struct virtio_net_dev *ndev, u32 vq)
 {
 	struct virtio_net_queue *q = &ndev->vqs[vq];
 
+	/* Guest already steers flows to TX queues so each TX queue is
+	 * always processed by the same netswitch bottom-half which
+	 * also keeps packets of a flow in order.
+	 */
 	if (virtio_queue_available(&q->vq)) {
-		vmm_port2switch_xfer_lazy(ndev->port, virtio_net_tx_lazy, 
-					  q, VIRTIO_NET_TX_LAZY_BUDGET);
+		vmm_port2switch_xfer_lazy_hash(ndev->port,
+					ndev->tx_hash_base + (vq >> 1),
+					virtio_net_tx_lazy,
+					q, VIRTIO_NET_TX_LAZY_BUDGET);
 	}
 }
 
@@ -208,23 +454,48 @@ static void virtio_net_handle_comp(struct virtio_net_dev *ndev, u32 qnum)
 	struct virtio_iovec *iov = q->iov;
 	struct virtio_device *dev = ndev->vdev;
 	struct virtio_net_ctrl_hdr ctrl;
-	virtio_net_ctrl_ack status = VIRTIO_NET_ERR;
+	struct virtio_net_ctrl_mq mq;
+	virtio_net_ctrl_ack status;
 	u16 head = 0;
 	u32 iov_cnt = 0, total_len = 0;
 
-	if (virtio_queue_available(vq)) {
+	while (virtio_queue_available(vq)) {
 		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+		status = VIRTIO_NET_ERR;
 
-		if (total_len < sizeof(status) || total_len < sizeof(ctrl)) {
+		if ((iov_cnt < 2) ||
+		    (total_len < (sizeof(status) + sizeof(ctrl)))) {
 			vmm_printf("%s: virtio-net ctrl missing"
-					" headers", __func__);
+					" headers\n", __func__);
+			virtio_queue_set_used_elem(vq, head, 0);
+			continue;
 		}
 
 		virtio_iovec_to_buf_read(dev, &iov[0], 1, &ctrl, sizeof(ctrl));
 
-		vmm_printf("%s: IOV Class %d is not handled\n", __func__,
-				ctrl.class);
-		virtio_queue_set_used_elem(vq, head, total_len);
+		if ((ctrl.class == VIRTIO_NET_CTRL_MQ) &&
+		    (ctrl.cmd == VIRTIO_NET_CTRL_MQ_VQ_PAIRS_SET) &&
+		    (iov_cnt > 2) &&
+		    (virtio_iovec_to_buf_read(dev, &iov[1], 1,
+					&mq, sizeof(mq)) == sizeof(mq)) &&
+		    (VIRTIO_NET_CTRL_MQ_VQ_PAIRS_MIN <= mq.virtqueue_pairs) &&
+		    (mq.virtqueue_pairs <=
+				ndev->config.max_virtqueue_pairs)) {
+			ndev->curr_queue_pairs = mq.virtqueue_pairs;
+			status = VIRTIO_NET_OK;
+		} else {
+			vmm_printf("%s: IOV Class %d is not handled\n",
+				   __func__, ctrl.class);
+		}
+
+		/* Last descriptor holds the ack */
+		virtio_buf_to_iovec_write(dev, &iov[iov_cnt - 1], 1,
+					  &status, sizeof(status));
+		virtio_queue_set_used_elem(vq, head, sizeof(status));
+	}
+
+	if (virtio_queue_should_signal(vq)) {
+		dev->tra->notify(dev, qnum);
 	}
 }
 
@@ -262,33 +533,143 @@ static int virtio_net_can_receive(struct vmm_netport *p)
 	return ndev->can_receive;
 }
 
+/* Copy packet data from mbuf chain to guest IO vectors */
+static u32 virtio_net_rx_fill(struct virtio_device *dev,
+			      struct virtio_iovec *iov, u32 iov_cnt, u32 off,
+			      struct vmm_mbuf **m, u32 *moff, u32 len)
+{
+	u32 chunk, w, pos = 0;
+
+	while ((pos < len) && *m) {
+		if ((*m)->m_len <= *moff) {
+			*m = (*m)->m_next;
+			*moff = 0;
+			continue;
+		}
+		chunk = (*m)->m_len - *moff;
+		chunk = ((len - pos) < chunk) ? (len - pos) : chunk;
+		w = virtio_net_iov_write(dev, iov, iov_cnt, off + pos,
+					 mtod(*m, u8 *) + *moff, chunk);
+		pos += w;
+		*moff += w;
+		if (w < chunk) {
+			break;
+		}
+	}
+
+	return pos;
+}
+
+static void virtio_net_rx_hdr(struct virtio_net_dev *ndev,
+			      struct vmm_mbuf *mb,
+			      struct virtio_net_hdr_mrg_rxbuf *mhdr)
+{
+	struct virtio_net_hdr *hdr = &mhdr->hdr;
+
+	memset(mhdr, 0, sizeof(*mhdr));
+	mhdr->num_buffers = 1;
+
+	/* Netswitch does software offloads if guest cannot take them */
+	if (mb->m_pkthdr.csum_flags & M_CSUM_PARTIAL) {
+		hdr->flags = VIRTIO_NET_HDR_F_NEEDS_CSUM;
+		hdr->csum_start = mb->m_pkthdr.csum_start;
+		hdr->csum_offset = mb->m_pkthdr.csum_offset;
+	} else if ((mb->m_pkthdr.csum_flags & M_CSUM_VALID) &&
+		   (ndev->features & (1UL << VIRTIO_NET_F_GUEST_CSUM))) {
+		hdr->flags = VIRTIO_NET_HDR_F_DATA_VALID;
+	}
+
+	switch (mb->m_pkthdr.gso_type) {
+	case M_GSO_TCPV4:
+		hdr->gso_type = VIRTIO_NET_HDR_GSO_TCPV4;
+		hdr->gso_size = mb->m_pkthdr.gso_size;
+		break;
+	case M_GSO_TCPV6:
+		hdr->gso_type = VIRTIO_NET_HDR_GSO_TCPV6;
+		hdr->gso_size = mb->m_pkthdr.gso_size;
+		break;
+	default:
+		hdr->gso_type = VIRTIO_NET_HDR_GSO_NONE;
+		break;
+	};
+}
+
 static int virtio_net_switch2port_xfer(struct vmm_netport *p,
 				       struct vmm_mbuf *mb)
 {
-	u16 head = 0;
+	u16 heads[VIRTIO_NET_RX_MAX_BUFS];
+	u32 lens[VIRTIO_NET_RX_MAX_BUFS];
+	u32 i, nbufs = 0, off, moff = 0, w, hdr_iov_cnt = 0;
 	u32 iov_cnt = 0, total_len = 0, pkt_len = 0;
+	bool mergeable;
 	struct virtio_net_dev *ndev = p->priv;
-	/* FIXME: Select correct RX queue here  */
-	struct virtio_net_queue *q = &ndev->vqs[0];
-	struct virtio_queue *vq = &q->vq;
-	struct virtio_iovec *iov = q->iov;
+	struct virtio_net_queue *q;
+	struct virtio_queue *vq;
+	struct virtio_iovec *iov;
+	struct virtio_iovec hdr_iov[VIRTIO_NET_RX_HDR_IOVS];
+	struct virtio_net_hdr_mrg_rxbuf hdr;
 	struct virtio_device *dev = ndev->vdev;
-
-	pkt_len = min(VIRTIO_NET_MTU, mb->m_pktlen);
-
-	if (virtio_queue_available(vq)) {
-		head = virtio_queue_get_iovec(vq, iov, &iov_cnt, &total_len);
+	struct vmm_mbuf *m = mb;
+
+	/* Steer packet to RX queue of the pair selected by flow hash */
+	q = &ndev->vqs[0];
+	if (ndev->curr_queue_pairs > 1) {
+		q = &ndev->vqs[(vmm_netswitch_flow_hash(mb) %
+				ndev->curr_queue_pairs) * 2];
+		if (!q->valid) {
+			q = &ndev->vqs[0];
+		}
 	}
+	vq = &q->vq;
+	iov = q->iov;
+
+	mergeable = (ndev->features & (1UL << VIRTIO_NET_F_MRG_RXBUF)) ?
+								TRUE : FALSE;
+	pkt_len = mb->m_pktlen;
+	if (mb->m_pkthdr.gso_type == M_GSO_NONE) {
+		pkt_len = min((u32)VIRTIO_NET_MTU, pkt_len);
+	}
+	virtio_net_rx_hdr(ndev, mb, &hdr);
 
-	if (iov_cnt > 1) {
-		virtio_iovec_fill_zeros(dev, &iov[0], 1);
-		virtio_buf_to_iovec_write(dev, &iov[1], 1,
-						M_BUFADDR(mb), pkt_len);
-		virtio_queue_set_used_elem(vq, head, iov[0].len + pkt_len);
+	/* Scatter header and packet over one or more (mergeable)
+	 * RX buffers of guest.
+	 */
+	while (virtio_queue_available(vq) && (nbufs < VIRTIO_NET_RX_MAX_BUFS)) {
+		heads[nbufs] = virtio_queue_get_iovec(vq, iov,
+						      &iov_cnt, &total_len);
+		off = 0;
+		if (!nbufs) {
+			off = virtio_net_iov_write(dev, iov, iov_cnt, 0,
+						   &hdr, ndev->hdr_len);
+			hdr_iov_cnt = min(iov_cnt, (u32)VIRTIO_NET_RX_HDR_IOVS);
+			for (i = 0; i < hdr_iov_cnt; i++) {
+				hdr_iov[i] = iov[i];
+			}
+		}
+		w = 0;
+		if (off < total_len) {
+			w = virtio_net_rx_fill(dev, iov, iov_cnt, off, &m, &moff,
+				min(total_len - off, pkt_len));
+		}
+		pkt_len -= w;
+		lens[nbufs++] = off + w;
+		if (!mergeable || !pkt_len) {
+			break;
+		}
+	}
 
+	if (nbufs) {
+		if (nbufs > 1) {
+			hdr.num_buffers = nbufs;
+			virtio_net_iov_write(dev, hdr_iov, hdr_iov_cnt,
+					     sizeof(hdr.hdr), &hdr.num_buffers,
+					     sizeof(hdr.num_buffers));
+		}
+		for (i = 0; i < nbufs; i++) {
+			virtio_queue_set_used_elem(vq, heads[i], lens[i]);
+		}
 		if (virtio_queue_should_signal(vq)) {
-			/* FIXME: Select correct RX queue here  */
-			dev->tra->notify(dev, 0);
+			dev->tra->notify(dev, q->num);
 		}
 	}
 
@@ -328,18 +709,27 @@ static int virtio_net_write_config(struct virtio_device *dev,
 static int virtio_net_reset(struct virtio_device *dev)
 {
 	int rc, i;
+	irq_flags_t flags;
 	struct virtio_net_dev *ndev = dev->emu_data;
 
 	for (i = 0; i < ndev->max_queues; i++) {
+		/* In-flight TX buffers must not touch cleaned queue */
+		vmm_spin_lock_irqsave_lite(&ndev->vqs[i].used_lock, flags);
 		if (ndev->vqs[i].valid) {
 			rc = virtio_queue_cleanup(&ndev->vqs[i].vq);
 			if (rc) {
+				vmm_spin_unlock_irqrestore_lite(
+					&ndev->vqs[i].used_lock, flags);
 				return rc;
 			}
 		}
 		ndev->vqs[i].valid = 0;
+		vmm_spin_unlock_irqrestore_lite(&ndev->vqs[i].used_lock, flags);
 	}
 	ndev->can_receive = 0;
+	ndev->curr_queue_pairs = 1;
+	ndev->hdr_len = sizeof(struct virtio_net_hdr);
+	ndev->port->flags &= ~VIRTIO_NET_PORT_OFFLOADS;
 
 	return VMM_OK;
 }
@@ -370,6 +760,7 @@ static int virtio_net_connect(struct virtio_device *dev,
 	ndev->port->can_receive = virtio_net_can_receive;
 	ndev->port->switch2port_xfer = virtio_net_switch2port_xfer;
 	ndev->port->priv = ndev;
+	vmm_netport_qos_setup(ndev->port, dev->edev->node);
 
 	ndev->config.max_virtqueue_pairs = dev->guest->vcpu_count;
 	/* Total queus: max_virtqueue_pairs * 2 + 1 this is nothing but
@@ -385,12 +776,16 @@ static int virtio_net_connect(struct virtio_device *dev,
 	ndev->config.status = VIRTIO_NET_S_LINK_UP;
 	ndev->cq = ndev->config.max_virtqueue_pairs * 2;
 	ndev->max_queues = ndev->config.max_virtqueue_pairs * 2 + 1;
+	ndev->curr_queue_pairs = 1;
+	ndev->hdr_len = sizeof(struct virtio_net_hdr);
+	ndev->tx_hash_base = virtio_net_count++;
 	dev->emu_data = ndev;
 
 	for (i = 0; i < ndev->max_queues; i++) {
 		ndev->vqs[i].num = i;
 		ndev->vqs[i].valid = 0;
 		ndev->vqs[i].ndev = ndev;
+		INIT_SPIN_LOCK(&ndev->vqs[i].used_lock);
 		if (i == ndev->cq) {
 			ndev->vqs[i].type = VIRTIO_NET_CTRL_QUEUE;
 		} else {
@@ -430,9 +825,19 @@ static int virtio_net_connect(struct virtio_device *dev,
 
 static void virtio_net_disconnect(struct virtio_device *dev)
 {
+	u32 retry = VIRTIO_NET_TX_DRAIN_MSECS;
 	struct virtio_net_dev *ndev = dev->emu_data;
 
 	vmm_netport_unregister(ndev->port);
+
+	/* Wait for mbufs referring to guest TX buffers */
+	while (arch_atomic_read(&ndev->tx_inflight) && retry--) {
+		vmm_msleep(1);
+	}
+	if (arch_atomic_read(&ndev->tx_inflight)) {
+		vmm_printf("%s: %s has in-flight TX buffers\n",
+			   __func__, ndev->name);
+	}
 	vmm_free(ndev->vqs);
 	vmm_netport_free(ndev->port);
 	vmm_free(ndev);
@@ -63,9 +63,14 @@ static int gpex_default_log_lvl = GPEX_LOG_LVL_VERBOSE;
 		}							\
 	}while(0);
 
+/* Config address layout of CAM and ECAM windows */
+#define GPEX_CAM_BUS_SHIFT		16
+#define GPEX_ECAM_BUS_SHIFT		20
+
 struct gpex_state {
 	struct vmm_mutex lock;
 	struct vmm_guest *guest;
+	u32 bus_shift;
 	struct vmm_devtree_node *node;
 	struct pci_host_controller *controller;
 	struct vmm_notifier_block guest_aspace_client;
@@ -83,49 +88,55 @@ static int gpex_config_write(struct pci_class *pci_class, u16 reg_offset,
 	return VMM_OK;
 }
 
+/* Split config window offset into device (in CAM layout which is
+ * used for device lookup) and register offset. ECAM has 4KB of
+ * register space per function whereas CAM has 256 bytes.
+ */
+static struct pci_device *gpex_find_dev(struct gpex_state *s, u32 addr,
+					u32 *config_addr)
+{
+	u32 devid = addr >> (s->bus_shift - 8);
+
+	*config_addr = addr & ((1 << (s->bus_shift - 8)) - 1);
+
+	return pci_emu_pci_dev_find_by_addr(s->controller,
+					    (devid & 0xffff) << 8);
+}
+
 static int gpex_reg_write(struct gpex_state *s, u32 addr,
-			    u32 src_mask, u32 val)
+			  u32 val, u32 size)
 {
 	struct pci_device *pdev;
 	u32 config_addr;
-	int ret = VMM_OK;
 
-	pdev = pci_emu_pci_dev_find_by_addr(s->controller, addr);
+	pdev = gpex_find_dev(s, addr, &config_addr);
 
+	/* Writes to absent functions are ignored */
 	if (!pdev) {
-		ret = VMM_EFAIL;
-		goto exit;
+		return VMM_OK;
 	}
 
-	config_addr = addr & (PCI_CONFIG_SPACE_SIZE - 1);
-
-	ret = pci_emu_config_space_write((struct pci_class *) pdev,
-					 config_addr, val);
-
-exit:
-	return ret;
+	return pci_emu_config_space_write((struct pci_class *) pdev,
+					  config_addr, val, size);
 }
 
 static int gpex_reg_read(struct gpex_state *s, u32 addr, u32 *dst, u32 size)
 {
 	struct pci_device *pdev;
 	u32 config_addr;
-	int ret = VMM_OK;
 
-	pdev = pci_emu_pci_dev_find_by_addr(s->controller, addr);
+	pdev = gpex_find_dev(s, addr, &config_addr);
 
+	/* Absent functions read as all ones */
 	if (!pdev) {
-		*dst = 0xFFFF;
-		ret = VMM_EFAIL;
-		goto exit;
+		*dst = 0xFFFFFFFF;
+		return VMM_OK;
 	}
 
-	config_addr = addr & (PCI_CONFIG_SPACE_SIZE - 1);
 	*dst = pci_emu_config_space_read((struct pci_class *)pdev,
 					 config_addr, size);
 
-exit:
-	return ret;
+	return VMM_OK;
 }
 
 static int gpex_emulator_reset(struct vmm_emudev *edev)
@@ -174,21 +185,21 @@ static int gpex_emulator_write8(struct vmm_emudev *edev,
 				   physical_addr_t offset,
 				   u8 src)
 {
-	return gpex_reg_write(edev->priv, offset, 0xFFFFFF00, src);
+	return gpex_reg_write(edev->priv, offset, src, 1);
 }
 
 static int gpex_emulator_write16(struct vmm_emudev *edev,
 				    physical_addr_t offset,
 				    u16 src)
 {
-	return gpex_reg_write(edev->priv, offset, 0xFFFF0000, src);
+	return gpex_reg_write(edev->priv, offset, src, 2);
 }
 
 static int gpex_emulator_write32(struct vmm_emudev *edev,
 				   physical_addr_t offset,
 				   u32 src)
 {
-	return gpex_reg_write(edev->priv, offset, 0x00000000, src);
+	return gpex_reg_write(edev->priv, offset, src, 4);
 }
 
 static int gpex_guest_aspace_notification(struct vmm_notifier_block *nb,
@@ -242,6 +253,11 @@ static int gpex_emulator_probe(struct vmm_guest *guest,
 
 	s->node = edev->node;
 	s->guest = guest;
+	if (!strcmp(eid->compatible, "pci-host-ecam-generic")) {
+		s->bus_shift = GPEX_ECAM_BUS_SHIFT;
+	} else {
+		s->bus_shift = GPEX_CAM_BUS_SHIFT;
+	}
 	s->controller = vmm_zalloc(sizeof(struct pci_host_controller));
 	if (!s->controller) {
 		GPEX_LOG(LVL_ERR, "Failed to allocate pci host contoller"
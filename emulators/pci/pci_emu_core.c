@@ -53,10 +53,10 @@ struct pci_devemu_ctrl {
 
 static struct pci_devemu_ctrl pci_emu_dectrl;
 
-struct pci_bus *pci_find_bus_by_id(struct pci_host_controller *controller,
+struct pci_emu_bus *pci_find_bus_by_id(struct pci_host_controller *controller,
 					  u32 bus_id)
 {
-	struct pci_bus *bus = NULL;
+	struct pci_emu_bus *bus = NULL;
 	irq_flags_t flags;
 
 	vmm_spin_lock_irqsave(&controller->lock, flags);
@@ -76,7 +76,7 @@ struct pci_bus *pci_find_bus_by_id(struct pci_host_controller *controller,
 int pci_emu_find_pci_device(struct pci_host_controller *controller,
 			    int bus_id, int dev_id, struct pci_device **pdev)
 {
-	struct pci_bus *bus = pci_find_bus_by_id(controller, bus_id);
+	struct pci_emu_bus *bus = pci_find_bus_by_id(controller, bus_id);
 	struct pci_device *ldev;
 	irq_flags_t flags;
 
@@ -104,9 +104,14 @@ struct pci_device *pci_emu_pci_dev_find_by_addr(struct pci_host_controller
 	u8 bus_num = addr >> 16;
 	u8 devfn = addr >> 8;
 	u32 devid = (bus_num << 8 | devfn);
-	struct pci_bus *bus;
+	struct pci_emu_bus *bus;
 	irq_flags_t flags;
-	struct pci_device *pdev = NULL;
+	struct pci_device *pdev;
+
+	/* Fast path for config space accesses */
+	if (devid < controller->nr_devs) {
+		return controller->devs[devid];
+	}
 
 	bus = pci_find_bus_by_id(controller, bus_num);
 
@@ -116,13 +121,15 @@ struct pci_device *pci_emu_pci_dev_find_by_addr(struct pci_host_controller
 	vmm_spin_lock_irqsave(&bus->lock, flags);
 
 	list_for_each_entry(pdev, &bus->attached_devices, head) {
-		if (pdev->device_id == devid)
-			break;
+		if (pdev->device_id == devid) {
+			vmm_spin_unlock_irqrestore(&bus->lock, flags);
+			return pdev;
+		}
 	}
 
 	vmm_spin_unlock_irqrestore(&bus->lock, flags);
 
-	return pdev;
+	return NULL;
 }
 
 struct pci_dev_emulator *pci_emu_find_device(const char *name)
@@ -152,17 +159,30 @@ struct pci_dev_emulator *pci_emu_find_device(const char *name)
 static int pci_emu_attach_pci_device(struct pci_host_controller *controller,
 					 struct pci_device *dev, u32 bus_id)
 {
-	struct pci_bus *bus = pci_find_bus_by_id(controller, bus_id);
+	struct pci_emu_bus *bus = pci_find_bus_by_id(controller, bus_id);
 	irq_flags_t flags;
 
 	if (!bus) {
 		return VMM_ENODEV;
 	}
 
+	if (!controller->devs && controller->nr_buses) {
+		controller->devs = vmm_zalloc(controller->nr_buses * 256 *
+					      sizeof(*controller->devs));
+		if (!controller->devs) {
+			return VMM_ENOMEM;
+		}
+		controller->nr_devs = controller->nr_buses * 256;
+	}
+
 	vmm_spin_lock_irqsave(&bus->lock, flags);
 	list_add_tail(&dev->head, &bus->attached_devices);
 	vmm_spin_unlock_irqrestore(&bus->lock, flags);
 
+	if (dev->device_id < controller->nr_devs) {
+		controller->devs[dev->device_id] = dev;
+	}
+
 	return VMM_OK;
 }
 
@@ -233,17 +253,39 @@ static int pci_emu_register_bar(struct vmm_guest *guest,
 				struct vmm_devtree_node *bar_node)
 {
 	int rc;
+	u32 wmask;
+	const char *atype;
 	physical_addr_t addr;
+	physical_size_t size;
 
 	if (vmm_devtree_read_physaddr(bar_node,
 				      VMM_DEVTREE_GUEST_PHYS_ATTR_NAME, &addr)) {
 		return VMM_EFAIL;
 	}
 
+	if (vmm_devtree_read_physsize(bar_node,
+				      VMM_DEVTREE_PHYS_SIZE_ATTR_NAME, &size) ||
+	    !size || (size & (size - 1))) {
+		return VMM_EINVALID;
+	}
+
 	if ((rc = vmm_guest_add_region_from_node(guest, bar_node, NULL)) != VMM_OK)
 		return rc;
 
-	class->conf_header.bars[barnum] = addr;
+	/* Size of BAR is probed by guest using its writable bits */
+	wmask = ~((u32)size - 1);
+	if (!vmm_devtree_read_string(bar_node,
+				     VMM_DEVTREE_ADDRESS_TYPE_ATTR_NAME,
+				     &atype) &&
+	    !strcmp(atype, VMM_DEVTREE_ADDRESS_TYPE_VAL_IO)) {
+		class->conf_header.bars[barnum] = addr | PCI_CONFIG_BAR_SPACE_IO;
+		wmask &= ~0x3;
+	} else {
+		class->conf_header.bars[barnum] = addr;
+		wmask &= ~0xf;
+	}
+	memcpy(&class->conf_wmask[PCI_CONFIG_BAR0_OFFS + barnum * 4],
+	       &wmask, sizeof(wmask));
 
 	return VMM_OK;
 }
@@ -349,6 +391,7 @@ int pci_emu_probe_devices(struct vmm_guest *guest,
 					return VMM_EFAIL;
 				}
 				INIT_SPIN_LOCK(&pdev->lock);
+				pci_emu_config_space_init(&pdev->class);
 				pdev->node = dev_node;
 				pdev->priv = NULL;
 				rc = vmm_devtree_read_u32(dev_node,
@@ -429,7 +472,7 @@ int pci_emu_register_controller(struct vmm_devtree_node *node, struct vmm_guest
 
 int pci_emu_attach_new_pci_bus(struct pci_host_controller *controller, u32 bus_id)
 {
-	struct pci_bus *nbus = vmm_zalloc(sizeof(struct pci_bus));
+	struct pci_emu_bus *nbus = vmm_zalloc(sizeof(struct pci_emu_bus));
 	irq_flags_t flags;
 
 	if (nbus) {
@@ -450,7 +493,7 @@ int pci_emu_attach_new_pci_bus(struct pci_host_controller *controller, u32 bus_i
 
 int pci_emu_detach_pci_bus(struct pci_host_controller *controller, u32 bus_id)
 {
-	struct pci_bus *bus;
+	struct pci_emu_bus *bus;
 	irq_flags_t flags;
 
 	vmm_spin_lock_irqsave(&controller->lock, flags);
@@ -469,10 +512,30 @@ int pci_emu_detach_pci_bus(struct pci_host_controller *controller, u32 bus_id)
 	return VMM_EFAIL;
 }
 
-int pci_emu_config_space_write(struct pci_class *class, u32 reg_offs, u32 val)
+void pci_emu_config_space_init(struct pci_class *class)
+{
+	u8 *wmask = class->conf_wmask;
+
+	INIT_SPIN_LOCK(&class->lock);
+
+	/* IDs, class codes, header type and capability pointer are
+	 * read-only whereas BARs become writable when registered.
+	 */
+	memset(wmask, 0, sizeof(class->conf_wmask));
+	wmask[PCI_CONFIG_COMMAND_REG_OFFS] = 0xff;
+	wmask[PCI_CONFIG_COMMAND_REG_OFFS + 1] = 0xff;
+	wmask[PCI_CONFIG_CACHE_LINE_OFFS] = 0xff;
+	wmask[PCI_CONFIG_LATENCY_TMR_OFFS] = 0xff;
+	wmask[PCI_CONFIG_INT_LINE_OFFS] = 0xff;
+}
+
+int pci_emu_config_space_write(struct pci_class *class, u32 reg_offs,
+			       u32 val, u32 size)
 {
+	u32 i;
 	int retv = 0;
 	irq_flags_t flags;
+	u8 *hdr = (u8 *)&class->conf_header;
 
 	vmm_spin_lock_irqsave(&class->lock, flags);
 
@@ -490,114 +553,16 @@ int pci_emu_config_space_write(struct pci_class *class, u32 reg_offs, u32 val)
 		}
 	}
 
-	switch(reg_offs) {
-	case PCI_CONFIG_VENDOR_ID_OFFS:
-		class->conf_header.vendor_id = val;
-		break;
-
-	case PCI_CONFIG_DEVICE_ID_OFFS:
-		class->conf_header.device_id = val;
-		break;
-
-	case PCI_CONFIG_COMMAND_REG_OFFS:
-		class->conf_header.command = val;
-		break;
-
-	case PCI_CONFIG_STATUS_REG_OFFS:
-		class->conf_header.status = val;
-		break;
-
-	case PCI_CONFIG_REVISION_ID_OFFS:
-		class->conf_header.revision = val;
-		break;
-
-	case PCI_CONFIG_CLASS_CODE_OFFS:
-		class->conf_header.class = val;
-		break;
-
-	case PCI_CONFIG_SUBCLASS_CODE_OFFS:
-		class->conf_header.sub_class = val;
-		break;
-
-	case PCI_CONFIG_PROG_IF_OFFS:
-		class->conf_header.prog_if = val;
-		break;
-
-	case PCI_CONFIG_CACHE_LINE_OFFS:
-		class->conf_header.cache_line_sz = val;
-		break;
-
-	case PCI_CONFIG_LATENCY_TMR_OFFS:
-		class->conf_header.latency_timer = val;
-		break;
-
-	case PCI_CONFIG_HEADER_TYPE_OFFS:
-		class->conf_header.header_type = val;
-		break;
-
-	case PCI_CONFIG_BIST_OFFS:
-		class->conf_header.bist = val;
-		break;
-
-	case PCI_CONFIG_BAR0_OFFS:
-		class->conf_header.bars[0] = val;
-		break;
-
-	case PCI_CONFIG_BAR1_OFFS:
-		class->conf_header.bars[1] = val;
-		break;
-
-	case PCI_CONFIG_BAR2_OFFS:
-		class->conf_header.bars[2] = val;
-		break;
-
-	case PCI_CONFIG_BAR3_OFFS:
-		class->conf_header.bars[3] = val;
-		break;
-
-	case PCI_CONFIG_BAR4_OFFS:
-		class->conf_header.bars[4] = val;
-		break;
-
-	case PCI_CONFIG_BAR5_OFFS:
-		class->conf_header.bars[5] = val;
-		break;
-
-	case PCI_CONFIG_CARD_BUS_PTR_OFFS:
-		class->conf_header.card_bus_ptr = val;
-		break;
-
-	case PCI_CONFIG_SUBSYS_VID:
-		class->conf_header.subsystem_vendor_id = val;
-		break;
-
-	case PCI_CONFIG_SUBSYS_DID:
-		class->conf_header.subsystem_device_id = val;
-		break;
-
-	case PCI_CONFIG_EROM_OFFS:
-		class->conf_header.expansion_rom_base = val;
-		break;
-
-	case PCI_CONFIG_CAP_PTR_OFFS:
-		class->conf_header.cap_pointer = val;
-		break;
-
-	case PCI_CONFIG_INT_LINE_OFFS:
-		class->conf_header.int_line = val;
-		break;
-
-	case PCI_CONFIG_INT_PIN_OFFS:
-		class->conf_header.int_pin = val;
-		break;
-
-	case PCI_CONFIG_MIN_GNT_OFFS:
-		class->conf_header.min_gnt = val;
-		break;
+	if ((reg_offs + size) > PCI_CONFIG_HEADER_SIZE) {
+		vmm_spin_unlock_irqrestore(&class->lock, flags);
+		return VMM_EINVALID;
+	}
 
-	case PCI_CONFIG_MAX_LAT_OFFS:
-		class->conf_header.max_lat = val;
-		break;
+	/* Header is a shadow array so only writable bits are merged */
+	for (i = 0; i < size; i++) {
+		hdr[reg_offs + i] =
+			(hdr[reg_offs + i] & ~class->conf_wmask[reg_offs + i]) |
+			((val >> (i * 8)) & class->conf_wmask[reg_offs + i]);
 	}
 
 	vmm_spin_unlock_irqrestore(&class->lock, flags);
@@ -944,6 +944,118 @@ static int gic_emulator_reset(struct vmm_emudev *edev)
 	return gic_state_reset(s);
 }
 
+static int gic_cpu_state_save(struct gic_cpu_state *cs,
+			      struct vmm_snapshot_state *st)
+{
+	int rc;
+
+	if ((rc = vmm_snapshot_put_var(st, cs->enabled)) ||
+	    (rc = vmm_snapshot_put_var(st, cs->priority_mask)) ||
+	    (rc = vmm_snapshot_put_var(st, cs->running_irq)) ||
+	    (rc = vmm_snapshot_put_var(st, cs->running_priority)) ||
+	    (rc = vmm_snapshot_put_var(st, cs->current_pending)) ||
+	    (rc = vmm_snapshot_put_var(st, cs->last_active))) {
+		return rc;
+	}
+
+	return vmm_snapshot_put_var(st, cs->priority);
+}
+
+static int gic_cpu_state_restore(struct gic_cpu_state *cs,
+				 struct vmm_snapshot_state *st)
+{
+	int rc;
+
+	if ((rc = vmm_snapshot_get_var(st, cs->enabled)) ||
+	    (rc = vmm_snapshot_get_var(st, cs->priority_mask)) ||
+	    (rc = vmm_snapshot_get_var(st, cs->running_irq)) ||
+	    (rc = vmm_snapshot_get_var(st, cs->running_priority)) ||
+	    (rc = vmm_snapshot_get_var(st, cs->current_pending)) ||
+	    (rc = vmm_snapshot_get_var(st, cs->last_active))) {
+		return rc;
+	}
+
+	return vmm_snapshot_get_var(st, cs->priority);
+}
+
+static int gic_emulator_save(struct vmm_emudev *edev,
+			     struct vmm_snapshot_state *st)
+{
+	int rc;
+	u32 i;
+	irq_flags_t flags;
+	struct gic_cpu_state *cs;
+	struct gic_state *s = edev->priv;
+
+	if ((rc = vmm_snapshot_put_var(st, s->num_cpu)) ||
+	    (rc = vmm_snapshot_put_var(st, s->num_irq))) {
+		return rc;
+	}
+
+	for (i = 0; i < GIC_NUM_CPU(s); i++) {
+		cs = &s->cpu_state[i];
+		vmm_read_lock_irqsave(&cs->cpu_lock, flags);
+		rc = gic_cpu_state_save(cs, st);
+		vmm_read_unlock_irqrestore(&cs->cpu_lock, flags);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	vmm_read_lock_irqsave(&s->dist_lock, flags);
+	if (!(rc = vmm_snapshot_put_var(st, s->enabled))) {
+		rc = vmm_snapshot_put(st, s->irq_state,
+				      GIC_NUM_IRQ(s) * sizeof(s->irq_state[0]));
+	}
+	vmm_read_unlock_irqrestore(&s->dist_lock, flags);
+
+	return rc;
+}
+
+static int gic_emulator_restore(struct vmm_emudev *edev,
+				struct vmm_snapshot_state *st)
+{
+	int rc;
+	u32 i;
+	u8 num_cpu, num_irq;
+	irq_flags_t flags;
+	struct gic_cpu_state *cs;
+	struct gic_state *s = edev->priv;
+
+	if ((rc = vmm_snapshot_get_var(st, num_cpu)) ||
+	    (rc = vmm_snapshot_get_var(st, num_irq))) {
+		return rc;
+	}
+	if ((num_cpu != s->num_cpu) || (num_irq != s->num_irq)) {
+		return VMM_EINVALID;
+	}
+
+	for (i = 0; i < GIC_NUM_CPU(s); i++) {
+		cs = &s->cpu_state[i];
+		vmm_write_lock_irqsave(&cs->cpu_lock, flags);
+		rc = gic_cpu_state_restore(cs, st);
+		vmm_write_unlock_irqrestore(&cs->cpu_lock, flags);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	vmm_write_lock_irqsave(&s->dist_lock, flags);
+	if (!(rc = vmm_snapshot_get_var(st, s->enabled))) {
+		rc = vmm_snapshot_get(st, s->irq_state,
+				      GIC_NUM_IRQ(s) * sizeof(s->irq_state[0]));
+	}
+	vmm_write_unlock_irqrestore(&s->dist_lock, flags);
+	if (rc) {
+		return rc;
+	}
+
+	/* Re-evaluate interrupt lines of all CPU interfaces */
+	gic_update(s);
+
+	return VMM_OK;
+}
+
 static u32 gic_configs[][14] = {
 	{
 		/* num_irq */ 96,
@@ -1204,6 +1316,8 @@ static struct vmm_emulator gic_emulator = {
 	.read32 = gic_emulator_read32,
 	.write32 = gic_emulator_write32,
 	.reset = gic_emulator_reset,
+	.save = gic_emulator_save,
+	.restore = gic_emulator_restore,
 	.remove = gic_emulator_remove,
 };
 
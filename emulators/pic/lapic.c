@@ -77,13 +77,13 @@ static void apic_update_irq(apic_state_t *s);
 static void apic_get_delivery_bitmask(apic_state_t *s, u32 *deliver_bitmask,
                                       u8 dest, u8 dest_mode);
 
-static apic_state_t *cpu_get_current_apic(apic_state_t *apic_base)
+static apic_state_t *apic_find_vcpu_apic(apic_state_t *apic_base,
+					 struct vmm_vcpu *vcpu)
 {
-	struct vmm_vcpu *vcpu = vmm_scheduler_current_vcpu();
 	apic_state_t *apic = NULL;
 	int i;
 
-	for (i = 0; i < MAX_APICS+1; i++) {
+	for (i = 0; i < apic_base->guest->vcpu_count; i++) {
 		apic = apic_base + i;
 		if (apic->vcpu == vcpu) {
 			return apic;
@@ -93,6 +93,11 @@ static apic_state_t *cpu_get_current_apic(apic_state_t *apic_base)
 	return NULL;
 }
 
+static apic_state_t *cpu_get_current_apic(apic_state_t *apic_base)
+{
+	return apic_find_vcpu_apic(apic_base, vmm_scheduler_current_vcpu());
+}
+
 /* Find first bit starting from msb */
 static int apic_fls_bit(u32 value)
 {
@@ -540,10 +545,19 @@ static void apic_deliver(apic_state_t *s, u8 dest, u8 dest_mode,
 	apic_bus_deliver(s, deliver_bitmask, delivery_mode, vector_num, trigger_mode);
 }
 
+static bool apic_timer_tsc_deadline(apic_state_t *s)
+{
+	return ((s->lvt[APIC_LVT_TIMER] & APIC_LVT_TIMER_MODE_MASK) ==
+		APIC_LVT_TIMER_TSCDEADLINE) ? TRUE : FALSE;
+}
+
 static u32 apic_get_current_count(apic_state_t *s)
 {
 	s64 d;
 	u32 val;
+	if (apic_timer_tsc_deadline(s)) {
+		return 0;
+	}
 	d = (vmm_timer_timestamp() - s->initial_count_load_time) >>
 		s->count_shift;
 	if (s->lvt[APIC_LVT_TIMER] & APIC_LVT_TIMER_PERIODIC) {
@@ -561,6 +575,7 @@ static u32 apic_get_current_count(apic_state_t *s)
 bool apic_next_timer(apic_state_t *s, s64 current_time)
 {
 	s64 d;
+	u64 tsc;
 
 	/* We need to store the timer state separately to support APIC
 	 * implementations that maintain a non-QEMU timer, e.g. inside the
@@ -572,6 +587,19 @@ bool apic_next_timer(apic_state_t *s, s64 current_time)
 		return false;
 	}
 
+	if (apic_timer_tsc_deadline(s)) {
+		if (!s->tsc_deadline) {
+			return false;
+		}
+		tsc = arch_guest_tsc_read(s->vcpu);
+		s->next_time = current_time;
+		if (s->tsc_deadline > tsc) {
+			s->next_time += arch_guest_tsc_to_ns(s->tsc_deadline - tsc);
+		}
+		s->timer_expiry = s->next_time;
+		return true;
+	}
+
 	d = (current_time - s->initial_count_load_time) >> s->count_shift;
 
 	if (s->lvt[APIC_LVT_TIMER] & APIC_LVT_TIMER_PERIODIC) {
@@ -594,9 +622,14 @@ bool apic_next_timer(apic_state_t *s, s64 current_time)
 
 static void apic_timer_update(apic_state_t *s, s64 current_time)
 {
+	s64 now;
+
 	if (apic_next_timer(s, current_time)) {
+		/* Timer event takes duration relative to now */
+		now = vmm_timer_timestamp();
 		vmm_timer_event_stop(&s->timer);
-		vmm_timer_event_start(&s->timer, s->next_time);
+		vmm_timer_event_start(&s->timer, (s->next_time > now) ?
+				      (s->next_time - now) : 0);
 	} else {
 		vmm_timer_event_stop(&s->timer);
 	}
@@ -607,22 +640,19 @@ static void apic_timer(struct vmm_timer_event *event)
 	apic_state_t *s = (apic_state_t *)event->priv;
 
 	apic_local_deliver(s, APIC_LVT_TIMER);
+	if (apic_timer_tsc_deadline(s)) {
+		/* Deadline is one-shot and reads zero once fired */
+		s->tsc_deadline = 0;
+		return;
+	}
 	apic_timer_update(s, s->next_time);
 }
 
-static u32 apic_ioport_read(apic_state_t *base, physical_addr_t addr, u32 *dst)
+/* Register index is xAPIC offset / 16 which is also x2APIC MSR - 0x800 */
+static int apic_reg_read(apic_state_t *s, int index, u32 *dst)
 {
-	apic_state_t *s;
 	u32 val;
-	int index;
-
-	s = cpu_get_current_apic(base);
-	if (!s) {
-		APIC_LOG(ERR, "No LAPIC associated with current VCPU!\n");
-		return 0;
-	}
 
-	index = (addr >> 4) & 0xff;
 	switch(index) {
 	case 0x02: /* id */
 		val = s->id << 24;
@@ -691,18 +721,21 @@ static u32 apic_ioport_read(apic_state_t *base, physical_addr_t addr, u32 *dst)
 	return VMM_OK;
 }
 
-static int apic_ioport_write(apic_state_t *s, u32 addr, u32 src_mask, u32 val)
+static u32 apic_ioport_read(apic_state_t *base, physical_addr_t addr, u32 *dst)
 {
-	apic_state_t *apic = cpu_get_current_apic(s);
-	int index;
+	apic_state_t *s;
 
-	if (!apic) {
-		APIC_LOG(ERR, "No LAPIC attached to current VCPU.\n");
+	s = cpu_get_current_apic(base);
+	if (!s) {
+		APIC_LOG(ERR, "No LAPIC associated with current VCPU!\n");
 		return 0;
 	}
 
-	index = (addr >> 4) & 0xff;
+	return apic_reg_read(s, (addr >> 4) & 0xff, dst);
+}
 
+static int apic_reg_write(apic_state_t *s, int index, u32 val)
+{
 	switch(index) {
 	case 0x02:
 		s->id = (val >> 24);
@@ -746,6 +779,12 @@ static int apic_ioport_write(apic_state_t *s, u32 addr, u32 src_mask, u32 val)
 	case 0x32 ... 0x37:
 		{
 			int n = index - 0x32;
+			if ((n == APIC_LVT_TIMER) &&
+			    ((s->lvt[n] ^ val) & APIC_LVT_TIMER_MODE_MASK)) {
+				/* Changing timer mode disarms the timer */
+				s->tsc_deadline = 0;
+				s->initial_count = 0;
+			}
 			s->lvt[n] = val;
 			if (n == APIC_LVT_TIMER) {
 				apic_timer_update(s, vmm_timer_timestamp());
@@ -755,6 +794,10 @@ static int apic_ioport_write(apic_state_t *s, u32 addr, u32 src_mask, u32 val)
 		}
 		break;
 	case 0x38:
+		if (apic_timer_tsc_deadline(s)) {
+			/* Initial count is ignored in TSC-deadline mode */
+			break;
+		}
 		s->initial_count = val;
 		s->initial_count_load_time = vmm_timer_timestamp();
 		apic_timer_update(s, s->initial_count_load_time);
@@ -777,6 +820,128 @@ static int apic_ioport_write(apic_state_t *s, u32 addr, u32 src_mask, u32 val)
 	return VMM_OK;
 }
 
+static int apic_ioport_write(apic_state_t *base, u32 addr, u32 src_mask, u32 val)
+{
+	apic_state_t *s = cpu_get_current_apic(base);
+
+	if (!s) {
+		APIC_LOG(ERR, "No LAPIC attached to current VCPU.\n");
+		return 0;
+	}
+
+	return apic_reg_write(s, (addr >> 4) & 0xff, val);
+}
+
+/* x2APIC logical ID is derived from APIC ID (cluster, bit in cluster) */
+static u32 apic_x2apic_ldr(apic_state_t *s)
+{
+	return ((s->id >> 4) << 16) | (1 << (s->id & 0xf));
+}
+
+static int apic_msr_read(void *opaque, struct vmm_vcpu *vcpu,
+			 u32 msr, u64 *val)
+{
+	apic_state_t *s = apic_find_vcpu_apic(opaque, vcpu);
+	u32 regval;
+	int rc, index;
+
+	if (!s) {
+		return VMM_ENODEV;
+	}
+
+	if (msr == MSR_IA32_APICBASE) {
+		*val = s->apicbase;
+		return VMM_OK;
+	}
+
+	if (msr == MSR_IA32_TSC_DEADLINE) {
+		*val = (apic_timer_tsc_deadline(s)) ? s->tsc_deadline : 0;
+		return VMM_OK;
+	}
+
+	if (!(s->apicbase & MSR_IA32_APICBASE_EXTD)) {
+		return VMM_EINVALID;
+	}
+
+	index = msr - APIC_X2APIC_MSR_BASE;
+	switch (index) {
+	case 0x02:
+		*val = s->id;
+		break;
+	case 0x0d:
+		*val = apic_x2apic_ldr(s);
+		break;
+	case 0x0e: /* No DFR in x2APIC mode */
+		return VMM_EINVALID;
+	case 0x30:
+		*val = ((u64)s->icr[1] << 32) | s->icr[0];
+		break;
+	default:
+		regval = 0;
+		rc = apic_reg_read(s, index, &regval);
+		if (rc) {
+			return rc;
+		}
+		*val = regval;
+		break;
+	}
+
+	return VMM_OK;
+}
+
+static int apic_msr_write(void *opaque, struct vmm_vcpu *vcpu,
+			  u32 msr, u64 val)
+{
+	apic_state_t *s = apic_find_vcpu_apic(opaque, vcpu);
+	u64 mask = MSR_IA32_APICBASE_EXTD | MSR_IA32_APICBASE_ENABLE;
+	int index;
+
+	if (!s) {
+		return VMM_ENODEV;
+	}
+
+	if (msr == MSR_IA32_APICBASE) {
+		/* FIXME: APIC base relocation is not supported */
+		s->apicbase = (s->apicbase & ~mask) | (val & mask);
+		return VMM_OK;
+	}
+
+	if (msr == MSR_IA32_TSC_DEADLINE) {
+		/* Writes are ignored unless timer is in TSC-deadline mode */
+		if (apic_timer_tsc_deadline(s)) {
+			s->tsc_deadline = val;
+			apic_timer_update(s, vmm_timer_timestamp());
+		}
+		return VMM_OK;
+	}
+
+	if (!(s->apicbase & MSR_IA32_APICBASE_EXTD)) {
+		return VMM_EINVALID;
+	}
+
+	index = msr - APIC_X2APIC_MSR_BASE;
+	switch (index) {
+	case 0x02: /* ID and LDR are read-only in x2APIC mode */
+	case 0x0d:
+	case 0x0e:
+		return VMM_EINVALID;
+	case 0x30: /* Single 64-bit ICR write sends IPI */
+		s->icr[1] = (u32)(val >> 32);
+		s->icr[0] = (u32)val;
+		apic_deliver(s, s->icr[1] & 0xff, (s->icr[0] >> 11) & 1,
+			     (s->icr[0] >> 8) & 7, (s->icr[0] & 0xff),
+			     (s->icr[0] >> 15) & 1);
+		break;
+	case 0x3f: /* SELF IPI */
+		apic_set_irq(s, val & 0xff, APIC_TRIGGER_EDGE);
+		break;
+	default:
+		return apic_reg_write(s, index, (u32)val);
+	}
+
+	return VMM_OK;
+}
+
 static int apic_emulator_read8(struct vmm_emudev *edev,
 			       physical_addr_t offset, 
 			       u8 *dst)
@@ -911,6 +1076,7 @@ void apic_init_reset(apic_state_t *s)
 	s->initial_count = 0;
 	s->initial_count_load_time = 0;
 	s->next_time = 0;
+	s->tsc_deadline = 0;
 	s->wait_for_sipi = 1;
 
 	vmm_timer_event_stop(&s->timer);
@@ -950,11 +1116,18 @@ static void apic_reset_common(apic_state_t *s)
 static int apic_emulator_remove(struct vmm_emudev *edev)
 {
 	apic_state_t *s = edev->priv;
+	int i;
 
 	if (!s) {
 		return VMM_EFAIL;
 	}
 
+	arch_set_guest_lapic(s->guest, NULL, NULL, NULL);
+
+	for (i = 0; i < s->guest->vcpu_count; i++) {
+		vmm_timer_event_stop(&s[i].timer);
+	}
+
 	vmm_free(s);
 	edev->priv = NULL;
 
@@ -995,15 +1168,14 @@ static int apic_emulator_probe(struct vmm_guest *guest,
 		e->guest = guest;
 		e->vcpu = vcpu;
 		e->id = i; /* APIC ID  (RO) */
-		INIT_SPIN_LOCK(&s->state_lock);
+		INIT_SPIN_LOCK(&e->state_lock);
+		INIT_TIMER_EVENT(&e->timer, &apic_timer, e);
 		apic_reset_common(e);
 		i++;
 	}
 
 	vmm_read_unlock_irqrestore_lite(&guest->vcpu_lock, flags);
 
-	INIT_TIMER_EVENT(&s->timer, &apic_timer, s);
-
 	if ((rc = vmm_devtree_read_u32(edev->node, "base_irq", &s->base_irq)) != VMM_OK) {
 		APIC_LOG(ERR, "Base IRQ not defined!\n");
 		goto apic_emulator_probe_freestate_fail;
@@ -1020,6 +1192,9 @@ static int apic_emulator_probe(struct vmm_guest *guest,
 
 	edev->priv = s;
 
+	/* x2APIC registers are accessed by guest through MSRs */
+	arch_set_guest_lapic(guest, s, apic_msr_read, apic_msr_write);
+
 	return VMM_OK;
 
  apic_emulator_probe_freestate_fail:
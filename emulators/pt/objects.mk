@@ -22,3 +22,4 @@
 # */
 
 emulators-objs-$(CONFIG_EMU_PT_SIMPLE)+= pt/simple.o
+emulators-objs-$(CONFIG_EMU_PT_PCI)+= pt/pci.o
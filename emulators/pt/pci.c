@@ -0,0 +1,511 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file pci.c
+ * @author agent (agent@local)
+ * @brief PCI pass-through emulator.
+ *
+ * This emulator assigns a physical PCI function of host to a guest.
+ * The host function is isolated using a vmm_iommu domain which maps
+ * guest RAM at guest physical addresses so that device DMA works with
+ * guest physical addresses. BARs are passed-through as real guest
+ * regions described under "bars" node of the guest PCI device.
+ *
+ * Config space beyond the standard header is forwarded to the host
+ * function except MSI and MSI-X capabilities which are hidden from
+ * the guest. MSI-X vectors (or INTx) of host function are delivered
+ * to the guest as wired interrupts because guests do not have any
+ * virtual MSI controller.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_host_irq.h>
+#include <vmm_modules.h>
+#include <vmm_devtree.h>
+#include <vmm_devemu.h>
+#include <vmm_iommu.h>
+#include <libs/stringlib.h>
+#include <emu/pci/pci_emu_core.h>
+#include <linux/pci.h>
+
+#define MODULE_DESC			"PCI Pass-through Emulator"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(PCI_EMU_CORE_IPRIORITY + 1)
+#define	MODULE_INIT			pt_pci_emulator_init
+#define	MODULE_EXIT			pt_pci_emulator_exit
+
+#define PT_PCI_MAX_CAPS			48
+#define PT_PCI_MSI_CAP_SIZE		24
+#define PT_PCI_MSIX_CAP_SIZE		12
+
+struct pt_pci_state;
+
+struct pt_pci_irq {
+	struct pt_pci_state *s;
+	u32 host_irq;
+	u32 guest_irq;
+};
+
+struct pt_pci_state {
+	char name[64];
+	struct vmm_guest *guest;
+	struct pci_device *pdev;
+	struct pci_dev *hdev;
+	struct vmm_iommu_domain *domain;
+	/* Capabilities visible to guest */
+	u32 cap_count;
+	u8 caps[PT_PCI_MAX_CAPS];
+	/* Routed interrupts */
+	bool intx;
+	u32 irq_count;
+	struct pt_pci_irq *irqs;
+	struct msix_entry *msix;
+};
+
+/* Handle host-to-guest routed interrupt generated by device */
+static vmm_irq_return_t pt_pci_routed_irq(int irq, void *dev)
+{
+	int rc;
+	struct pt_pci_irq *pirq = dev;
+	struct pt_pci_state *s = pirq->s;
+
+	/* Lower the interrupt level.
+	 * This will clear previous interrupt state.
+	 */
+	rc = vmm_devemu_emulate_irq(s->guest, pirq->guest_irq, 0);
+	if (rc) {
+		vmm_printf("%s: Emulate Guest=%s irq=%d level=0 failed\n",
+			   __func__, s->guest->name, pirq->guest_irq);
+	}
+
+	/* Elevate the interrupt level.
+	 * This will force interrupt triggering.
+	 */
+	rc = vmm_devemu_emulate_irq(s->guest, pirq->guest_irq, 1);
+	if (rc) {
+		vmm_printf("%s: Emulate Guest=%s irq=%d level=1 failed\n",
+			   __func__, s->guest->name, pirq->guest_irq);
+	}
+
+	return VMM_IRQ_HANDLED;
+}
+
+static bool pt_pci_cap_hidden(struct pt_pci_state *s, u16 offset)
+{
+	u8 msi_cap = s->hdev->msi_cap, msix_cap = s->hdev->msix_cap;
+
+	if (msi_cap && (msi_cap <= offset) &&
+	    (offset < (msi_cap + PT_PCI_MSI_CAP_SIZE))) {
+		return TRUE;
+	}
+	if (msix_cap && (msix_cap <= offset) &&
+	    (offset < (msix_cap + PT_PCI_MSIX_CAP_SIZE))) {
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+static u8 pt_pci_config_read_byte(struct pt_pci_state *s, u16 offset)
+{
+	u32 i;
+	u8 val = 0;
+
+	if (pt_pci_cap_hidden(s, offset)) {
+		return 0;
+	}
+
+	/* Next pointers of visible capabilities skip hidden ones */
+	if (offset < PCI_CONFIG_SPACE_SIZE) {
+		for (i = 0; i < s->cap_count; i++) {
+			if (offset == (s->caps[i] + PCI_CAP_LIST_NEXT)) {
+				return ((i + 1) < s->cap_count) ?
+							s->caps[i + 1] : 0;
+			}
+		}
+	}
+
+	pci_read_config_byte(s->hdev, offset, &val);
+
+	return val;
+}
+
+static u32 pt_pci_config_read(struct pci_class *class, u16 reg_offs)
+{
+	u32 i, val = 0;
+	struct pci_device *pdev = (struct pci_device *)class;
+	struct pt_pci_state *s = pdev->priv;
+
+	for (i = 0; i < 4; i++) {
+		if (PCIE_CONFIG_SPACE_SIZE <= (reg_offs + i)) {
+			break;
+		}
+		val |= (u32)pt_pci_config_read_byte(s, reg_offs + i) << (i * 8);
+	}
+
+	return val;
+}
+
+/*
+ * Size of config write is not passed by PCI emulation core so
+ * natural alignment of offset decides the access size.
+ */
+static int pt_pci_config_write(struct pci_class *class,
+			       u16 reg_offs, u32 data)
+{
+	struct pci_device *pdev = (struct pci_device *)class;
+	struct pt_pci_state *s = pdev->priv;
+
+	if (PCIE_CONFIG_SPACE_SIZE <= reg_offs) {
+		return VMM_EINVALID;
+	}
+	if (pt_pci_cap_hidden(s, reg_offs)) {
+		return VMM_OK;
+	}
+
+	if (!(reg_offs & 0x3)) {
+		pci_write_config_dword(s->hdev, reg_offs, data);
+	} else if (!(reg_offs & 0x1)) {
+		pci_write_config_word(s->hdev, reg_offs, data);
+	} else {
+		pci_write_config_byte(s->hdev, reg_offs, data);
+	}
+
+	return VMM_OK;
+}
+
+static void pt_pci_init_caps(struct pt_pci_state *s)
+{
+	u8 id, pos = 0;
+	u16 status = 0;
+
+	s->cap_count = 0;
+
+	pci_read_config_word(s->hdev, PCI_STATUS, &status);
+	if (status & PCI_STATUS_CAP_LIST) {
+		pci_read_config_byte(s->hdev, PCI_CAPABILITY_LIST, &pos);
+	}
+
+	while ((PCI_CONFIG_HEADER_SIZE <= pos) &&
+	       (s->cap_count < PT_PCI_MAX_CAPS)) {
+		pos &= ~0x3;
+		pci_read_config_byte(s->hdev, pos + PCI_CAP_LIST_ID, &id);
+		if (id == 0xff) {
+			break;
+		}
+		if ((id != PCI_CAP_ID_MSI) && (id != PCI_CAP_ID_MSIX)) {
+			s->caps[s->cap_count++] = pos;
+		}
+		pci_read_config_byte(s->hdev, pos + PCI_CAP_LIST_NEXT, &pos);
+	}
+
+	s->pdev->class.conf_header.cap_pointer =
+				(s->cap_count) ? s->caps[0] : 0;
+	if (s->cap_count) {
+		s->pdev->class.conf_header.status |= PCI_STATUS_CAP_LIST;
+	}
+}
+
+static int pt_pci_emulator_reset(struct pci_device *pdev)
+{
+	u32 i;
+	struct pt_pci_state *s = pdev->priv;
+
+	/* Stop device DMA before guest RAM is re-initialized */
+	pci_clear_master(s->hdev);
+	pci_reset_function(s->hdev);
+	pci_set_master(s->hdev);
+
+	if (s->intx) {
+		for (i = 0; i < s->irq_count; i++) {
+			vmm_devemu_map_host2guest_irq(s->guest,
+						      s->irqs[i].guest_irq,
+						      s->irqs[i].host_irq);
+		}
+	}
+
+	/* Guest RAM regions are known only after guest creation */
+	return vmm_iommu_guest_sync(s->domain, s->guest,
+			VMM_IOMMU_READ | VMM_IOMMU_WRITE | VMM_IOMMU_CACHE);
+}
+
+static void pt_pci_free_irqs(struct pt_pci_state *s, u32 count)
+{
+	u32 i;
+
+	for (i = 0; i < count; i++) {
+		vmm_host_irq_unregister(s->irqs[i].host_irq, &s->irqs[i]);
+		if (s->intx) {
+			vmm_host_irq_unmark_routed(s->irqs[i].host_irq);
+		}
+	}
+
+	if (s->msix) {
+		pci_disable_msix(s->hdev);
+		vmm_free(s->msix);
+		s->msix = NULL;
+	}
+	if (s->irqs) {
+		vmm_free(s->irqs);
+		s->irqs = NULL;
+	}
+}
+
+static int pt_pci_setup_irqs(struct pt_pci_state *s,
+			     struct vmm_devtree_node *node)
+{
+	int rc;
+	u32 i, msix_count = 0, irq_reg_count = 0;
+
+	if (vmm_devtree_read_u32(node, "host-msix-vectors", &msix_count)) {
+		msix_count = 0;
+	}
+
+	if (msix_count) {
+		s->intx = FALSE;
+		s->irq_count = msix_count;
+	} else {
+		s->intx = TRUE;
+		s->irq_count = (s->hdev->pin && s->hdev->irq) ? 1 : 0;
+	}
+	if (!s->irq_count) {
+		return VMM_OK;
+	}
+	if (vmm_devtree_irq_count(node) < s->irq_count) {
+		return VMM_EINVALID;
+	}
+
+	s->irqs = vmm_zalloc(sizeof(*s->irqs) * s->irq_count);
+	if (!s->irqs) {
+		return VMM_ENOMEM;
+	}
+
+	if (msix_count) {
+		s->msix = vmm_zalloc(sizeof(*s->msix) * msix_count);
+		if (!s->msix) {
+			rc = VMM_ENOMEM;
+			goto fail;
+		}
+		for (i = 0; i < msix_count; i++) {
+			s->msix[i].entry = i;
+		}
+		rc = pci_enable_msix_exact(s->hdev, s->msix, msix_count);
+		if (rc) {
+			vmm_free(s->msix);
+			s->msix = NULL;
+			goto fail;
+		}
+	}
+
+	for (i = 0; i < s->irq_count; i++) {
+		s->irqs[i].s = s;
+		s->irqs[i].host_irq = (s->msix) ?
+				s->msix[i].vector : s->hdev->irq;
+
+		rc = vmm_devtree_irq_get(node, &s->irqs[i].guest_irq, i);
+		if (rc) {
+			goto fail;
+		}
+
+		/* Level triggered INTx is routed till guest EOI */
+		if (s->intx) {
+			rc = vmm_host_irq_mark_routed(s->irqs[i].host_irq);
+			if (rc) {
+				goto fail;
+			}
+		}
+
+		rc = vmm_host_irq_register(s->irqs[i].host_irq, s->name,
+					   pt_pci_routed_irq, &s->irqs[i]);
+		if (rc) {
+			if (s->intx) {
+				vmm_host_irq_unmark_routed(s->irqs[i].host_irq);
+			}
+			goto fail;
+		}
+
+		irq_reg_count++;
+	}
+
+	return VMM_OK;
+
+fail:
+	pt_pci_free_irqs(s, irq_reg_count);
+	s->irq_count = 0;
+	return rc;
+}
+
+static int pt_pci_emulator_probe(struct pci_device *pdev,
+				 struct vmm_guest *guest,
+				 const struct vmm_devtree_nodeid *eid)
+{
+	int rc = VMM_OK;
+	u32 bdf[3];
+	struct pt_pci_state *s;
+	struct pci_conf_header *hdr = &pdev->class.conf_header;
+
+	if (!vmm_iommu_present(&pci_bus_type)) {
+		vmm_printf("%s: No IOMMU for PCI bus\n", __func__);
+		return VMM_ENODEV;
+	}
+
+	s = vmm_zalloc(sizeof(struct pt_pci_state));
+	if (!s) {
+		rc = VMM_ENOMEM;
+		goto pt_pci_probe_fail;
+	}
+
+	vmm_snprintf(s->name, sizeof(s->name), "%s/%s",
+		     guest->name, pdev->node->name);
+	s->guest = guest;
+	s->pdev = pdev;
+
+	rc = vmm_devtree_read_u32_array(pdev->node, "host-pci-bdf", bdf, 3);
+	if (rc) {
+		goto pt_pci_probe_freestate_fail;
+	}
+
+	s->hdev = pci_get_domain_bus_and_slot(0, bdf[0],
+					      PCI_DEVFN(bdf[1], bdf[2]));
+	if (!s->hdev) {
+		vmm_printf("%s: %s host PCI %02x:%02x.%x not found\n",
+			   __func__, s->name, bdf[0], bdf[1], bdf[2]);
+		rc = VMM_ENODEV;
+		goto pt_pci_probe_freestate_fail;
+	}
+	if (s->hdev->driver) {
+		vmm_printf("%s: %s host PCI %s in use by host driver\n",
+			   __func__, s->name, pci_name(s->hdev));
+		rc = VMM_EBUSY;
+		goto pt_pci_probe_putdev_fail;
+	}
+
+	rc = pci_enable_device(s->hdev);
+	if (rc) {
+		goto pt_pci_probe_putdev_fail;
+	}
+	pci_set_master(s->hdev);
+
+	s->domain = vmm_iommu_domain_alloc(&pci_bus_type);
+	if (!s->domain) {
+		rc = VMM_ENOMEM;
+		goto pt_pci_probe_disable_fail;
+	}
+
+	rc = vmm_iommu_attach_device(s->domain, &s->hdev->dev);
+	if (rc) {
+		goto pt_pci_probe_freedomain_fail;
+	}
+
+	pdev->priv = s;
+
+	rc = pt_pci_setup_irqs(s, pdev->node);
+	if (rc) {
+		goto pt_pci_probe_detach_fail;
+	}
+
+	/* Guest sees the identity of host function */
+	hdr->vendor_id = s->hdev->vendor;
+	hdr->device_id = s->hdev->devid;
+	hdr->revision = s->hdev->revision;
+	hdr->class = (s->hdev->class >> 16) & 0xff;
+	hdr->sub_class = (s->hdev->class >> 8) & 0xff;
+	hdr->prog_if = s->hdev->class & 0xff;
+	hdr->subsystem_vendor_id = s->hdev->subsystem_vendor;
+	hdr->subsystem_device_id = s->hdev->subsystem_device;
+	hdr->int_pin = (s->irq_count) ? 1 : 0;
+	pt_pci_init_caps(s);
+
+	pdev->class.config_read = pt_pci_config_read;
+	pdev->class.config_write = pt_pci_config_write;
+
+	return VMM_OK;
+
+pt_pci_probe_detach_fail:
+	pdev->priv = NULL;
+	vmm_iommu_detach_device(s->domain, &s->hdev->dev);
+pt_pci_probe_freedomain_fail:
+	vmm_iommu_domain_free(s->domain);
+pt_pci_probe_disable_fail:
+	pci_clear_master(s->hdev);
+	pci_disable_device(s->hdev);
+pt_pci_probe_putdev_fail:
+	pci_dev_put(s->hdev);
+pt_pci_probe_freestate_fail:
+	vmm_free(s);
+pt_pci_probe_fail:
+	return rc;
+}
+
+static int pt_pci_emulator_remove(struct pci_device *pdev)
+{
+	struct pt_pci_state *s = pdev->priv;
+
+	if (!s) {
+		return VMM_EFAIL;
+	}
+
+	pdev->class.config_read = NULL;
+	pdev->class.config_write = NULL;
+
+	pci_clear_master(s->hdev);
+	pt_pci_free_irqs(s, s->irq_count);
+	vmm_iommu_guest_unsync(s->domain);
+	vmm_iommu_detach_device(s->domain, &s->hdev->dev);
+	vmm_iommu_domain_free(s->domain);
+	pci_disable_device(s->hdev);
+	pci_dev_put(s->hdev);
+	vmm_free(s);
+
+	pdev->priv = NULL;
+
+	return VMM_OK;
+}
+
+static struct vmm_devtree_nodeid pt_pci_emuid_table[] = {
+	{ .type = "pt", .compatible = "pci", },
+	{ /* end of list */ },
+};
+
+static struct pci_dev_emulator pt_pci_emulator = {
+	.name = "pt-pci",
+	.match_table = pt_pci_emuid_table,
+	.probe = pt_pci_emulator_probe,
+	.reset = pt_pci_emulator_reset,
+	.remove = pt_pci_emulator_remove,
+};
+
+static int __init pt_pci_emulator_init(void)
+{
+	return pci_emu_register_device(&pt_pci_emulator);
+}
+
+static void __exit pt_pci_emulator_exit(void)
+{
+	pci_emu_unregister_device(&pt_pci_emulator);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -39,33 +39,31 @@
 #define	MODULE_INIT			simple_emulator_init
 #define	MODULE_EXIT			simple_emulator_exit
 
+struct simple_state;
+
+/* Each routed host IRQ is registered with its own context so that
+ * guest IRQ is found without searching in the IRQ hot path.
+ */
+struct simple_irq {
+	struct simple_state *s;
+	u32 host_irq;
+	u32 guest_irq;
+};
+
 struct simple_state {
 	char name[64];
 	struct vmm_guest *guest;
 	u32 irq_count;
-	u32 *host_irqs;
-	u32 *guest_irqs;
+	struct simple_irq *irqs;
 };
 
 /* Handle host-to-guest routed IRQ generated by device */
 static vmm_irq_return_t simple_routed_irq(int irq, void *dev)
 {
 	int rc;
-	bool found = FALSE;
-	u32 i, host_irq = irq, guest_irq = 0;
-	struct simple_state *s = dev;
-
-	/* Find guest irq */
-	for (i = 0; i < s->irq_count; i++) {
-		if (s->host_irqs[i] == host_irq) {
-			guest_irq = s->guest_irqs[i];
-			found = TRUE;
-			break;
-		}
-	}
-	if (!found) {
-		goto done;
-	}
+	struct simple_irq *sirq = dev;
+	struct simple_state *s = sirq->s;
+	u32 guest_irq = sirq->guest_irq;
 
 	/* Lower the interrupt level.
 	 * This will clear previous interrupt state.
@@ -85,7 +83,6 @@ static vmm_irq_return_t simple_routed_irq(int irq, void *dev)
 			   __func__, s->guest->name, guest_irq);
 	}
 
-done:
 	return VMM_IRQ_HANDLED;
 }
 
@@ -96,8 +93,8 @@ static int simple_emulator_reset(struct vmm_emudev *edev)
 
 	for (i = 0; i < s->irq_count; i++) {
 		vmm_devemu_map_host2guest_irq(s->guest,
-					      s->guest_irqs[i],
-					      s->host_irqs[i]);
+					      s->irqs[i].guest_irq,
+					      s->irqs[i].host_irq);
 	}
 
 	return VMM_OK;
@@ -127,8 +124,7 @@ static int simple_emulator_probe(struct vmm_guest *guest,
 
 	s->guest = guest;
 	s->irq_count = vmm_devtree_irq_count(edev->node);
-	s->guest_irqs = NULL;
-	s->host_irqs = NULL;
+	s->irqs = NULL;
 
 	i = vmm_devtree_attrlen(edev->node, "host-interrupts") / sizeof(u32);
 	if (s->irq_count != i) {
@@ -137,41 +133,37 @@ static int simple_emulator_probe(struct vmm_guest *guest,
 	}
 
 	if (s->irq_count) {
-		s->host_irqs = vmm_zalloc(sizeof(u32) * s->irq_count);
-		if (!s->host_irqs) {
+		s->irqs = vmm_zalloc(sizeof(*s->irqs) * s->irq_count);
+		if (!s->irqs) {
 			rc = VMM_ENOMEM;
 			goto simple_emulator_probe_freestate_fail;
 		}
-
-		s->guest_irqs = vmm_zalloc(sizeof(u32) * s->irq_count);
-		if (!s->guest_irqs) {
-			rc = VMM_ENOMEM;
-			goto simple_emulator_probe_freehirqs_fail;
-		}
 	}
 
 	for (i = 0; i < s->irq_count; i++) {
+		s->irqs[i].s = s;
+
 		rc = vmm_devtree_read_u32_atindex(edev->node,
 						  "host-interrupts",
-						  &s->host_irqs[i], i);
+						  &s->irqs[i].host_irq, i);
 		if (rc) {
 			goto simple_emulator_probe_cleanupirqs_fail;
 		}
 
-		rc = vmm_devtree_irq_get(edev->node, &s->guest_irqs[i], i);
+		rc = vmm_devtree_irq_get(edev->node, &s->irqs[i].guest_irq, i);
 		if (rc) {
 			goto simple_emulator_probe_cleanupirqs_fail;
 		}
 
-		rc = vmm_host_irq_mark_routed(s->host_irqs[i]);
+		rc = vmm_host_irq_mark_routed(s->irqs[i].host_irq);
 		if (rc) {
 			goto simple_emulator_probe_cleanupirqs_fail;
 		}
 
-		rc = vmm_host_irq_register(s->host_irqs[i], s->name,
-					   simple_routed_irq, s);
+		rc = vmm_host_irq_register(s->irqs[i].host_irq, s->name,
+					   simple_routed_irq, &s->irqs[i]);
 		if (rc) {
-			vmm_host_irq_unmark_routed(s->host_irqs[i]);
+			vmm_host_irq_unmark_routed(s->irqs[i].host_irq);
 			goto simple_emulator_probe_cleanupirqs_fail;
 		}
 
@@ -184,15 +176,11 @@ static int simple_emulator_probe(struct vmm_guest *guest,
 
 simple_emulator_probe_cleanupirqs_fail:
 	for (i = 0; i < irq_reg_count; i++) {
-		vmm_host_irq_unregister(s->host_irqs[i], s);
-		vmm_host_irq_unmark_routed(s->host_irqs[i]);
+		vmm_host_irq_unregister(s->irqs[i].host_irq, &s->irqs[i]);
+		vmm_host_irq_unmark_routed(s->irqs[i].host_irq);
 	}
-	if (s->guest_irqs) {
-		vmm_free(s->guest_irqs);
-	}
-simple_emulator_probe_freehirqs_fail:
-	if (s->host_irqs) {
-		vmm_free(s->host_irqs);
+	if (s->irqs) {
+		vmm_free(s->irqs);
 	}
 simple_emulator_probe_freestate_fail:
 	vmm_free(s);
@@ -210,14 +198,11 @@ static int simple_emulator_remove(struct vmm_emudev *edev)
 	}
 
 	for (i = 0; i < s->irq_count; i++) {
-		vmm_host_irq_unregister(s->host_irqs[i], s);
-		vmm_host_irq_unmark_routed(s->host_irqs[i]);
-	}
-	if (s->guest_irqs) {
-		vmm_free(s->guest_irqs);
+		vmm_host_irq_unregister(s->irqs[i].host_irq, &s->irqs[i]);
+		vmm_host_irq_unmark_routed(s->irqs[i].host_irq);
 	}
-	if (s->host_irqs) {
-		vmm_free(s->host_irqs);
+	if (s->irqs) {
+		vmm_free(s->irqs);
 	}
 	vmm_free(s);
 
@@ -608,6 +608,7 @@ static int imx_emulator_probe(struct vmm_guest *guest,
 	s->vser = vmm_vserial_create(name,
 				     &imx_vserial_can_send,
 				     &imx_vserial_send,
+				     NULL,
 				     IMX_FIFO_SIZE, s);
 	if (!(s->vser)) {
 		goto imx_emulator_probe_freerbuf_fail;
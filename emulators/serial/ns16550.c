@@ -175,7 +175,9 @@ struct ns16550_state {
 	u8 recv_fifo_itl;
 
 	struct vmm_timer_event fifo_timeout_timer;
+	u64 fifo_timeout_tstamp;        /* time when timeout interrupt is due */
 	int timeout_ipending;           /* timeout interrupt pending state */
+	int irq_level;                  /* last IRQ level passed to guest */
 
 	u64 char_transmit_time;    /* time to transmit a char in ticks */
 	int poll_msl;
@@ -187,12 +189,33 @@ static int ns16550_send(struct vmm_vserial *vser, u8 data);
 
 static void ns16550_irq_raise(struct ns16550_state *s)
 {
-	vmm_devemu_emulate_irq(s->guest, s->irq, 1);
+	if (!s->irq_level) {
+		s->irq_level = 1;
+		vmm_devemu_emulate_irq(s->guest, s->irq, 1);
+	}
 }
 
 static void ns16550_irq_lower(struct ns16550_state *s)
 {
-	vmm_devemu_emulate_irq(s->guest, s->irq, 0);
+	if (s->irq_level) {
+		s->irq_level = 0;
+		vmm_devemu_emulate_irq(s->guest, s->irq, 0);
+	}
+}
+
+/* Push back character timeout to 4 char transmit times from now.
+ * The timer event is only started when not already pending and
+ * ns16550_fifo_timeout_int() re-arms itself for the remaining time
+ * so back-to-back received characters do not reprogram timer.
+ */
+static void ns16550_fifo_timeout_update(struct ns16550_state *s)
+{
+	u64 timeout = s->char_transmit_time * 4;
+
+	s->fifo_timeout_tstamp = vmm_timer_timestamp() + timeout;
+	if (!vmm_timer_event_pending(&s->fifo_timeout_timer)) {
+		vmm_timer_event_start(&s->fifo_timeout_timer, timeout);
+	}
 }
 
 static void ns16550_update_irq(struct ns16550_state *s)
@@ -534,8 +557,7 @@ static int ns16550_reg_read(struct ns16550_state *s, u32 addr, u32 *dst)
 				if (s->recv_fifo->avail_count == 0) {
 					s->lsr &= ~(UART_LSR_DR | UART_LSR_BI);
 				} else {
-					vmm_timer_event_stop(&s->fifo_timeout_timer);
-					vmm_timer_event_start(&s->fifo_timeout_timer, s->char_transmit_time * 4);
+					ns16550_fifo_timeout_update(s);
 				}
 				s->timeout_ipending = 0;
 			} else {
@@ -646,7 +668,14 @@ static void ns16550_receive_break(struct ns16550_state *s)
 /* There's data in recv_fifo and s->rbr has not been read for 4 char transmit times */
 static void ns16550_fifo_timeout_int(struct vmm_timer_event *event)
 {
+	u64 tstamp = vmm_timer_timestamp();
 	struct ns16550_state *s = event->priv;
+
+	if (tstamp < s->fifo_timeout_tstamp) {
+		vmm_timer_event_start(event, s->fifo_timeout_tstamp - tstamp);
+		return;
+	}
+
 	if (s->recv_fifo->avail_count) {
 		s->timeout_ipending = 1;
 		ns16550_update_irq(s);
@@ -672,8 +701,7 @@ static int ns16550_send(struct vmm_vserial *vser, u8 data)
 		s->lsr |= UART_LSR_DR;
 
 		/* call the timeout receive callback in 4 char transmit time */
-		vmm_timer_event_stop(&s->fifo_timeout_timer); 
-		vmm_timer_event_start(&s->fifo_timeout_timer, (s->char_transmit_time * 4));
+		ns16550_fifo_timeout_update(s);
 	} else {
 		if (s->lsr & UART_LSR_DR)
 			s->lsr |= UART_LSR_OE;
@@ -685,6 +713,53 @@ static int ns16550_send(struct vmm_vserial *vser, u8 data)
 	return VMM_OK;
 }
 
+static u32 ns16550_send_buf(struct vmm_vserial *vser, u8 *src, u32 len)
+{
+	u32 count, space;
+	struct ns16550_state *s = vmm_vserial_priv(vser);
+
+	if (!len) {
+		return 0;
+	}
+
+	if (!(s->fcr & UART_FCR_FE)) {
+		if (!ns16550_can_send(vser)) {
+			return 0;
+		}
+		ns16550_send(vser, src[0]);
+		return 1;
+	}
+
+	/* Fill Rx FIFO upto ITL (or till full when above ITL) which is
+	 * same as sending byte-by-byte while ns16550_can_send() is TRUE.
+	 */
+	count = s->recv_fifo->avail_count;
+	if (count >= s->fifo_sz) {
+		return 0;
+	}
+	space = (count <= s->recv_fifo_itl) ?
+		s->recv_fifo_itl - count : s->fifo_sz - count;
+	if (!space) {
+		return 0;
+	}
+	if (space < len) {
+		len = space;
+	}
+
+	count = fifo_enqueue_multi(s->recv_fifo, src, len);
+	if (!count) {
+		return 0;
+	}
+	s->lsr |= UART_LSR_DR;
+
+	/* call the timeout receive callback in 4 char transmit time */
+	ns16550_fifo_timeout_update(s);
+
+	ns16550_update_irq(s);
+
+	return count;
+}
+
 #if 0
 static void ns16550_event(void *opaque, int event)
 {
@@ -721,6 +796,7 @@ static int ns16550_emulator_reset(struct vmm_emudev *edev)
 
 	s->thr_ipending = 0;
 	s->last_break_enable = 0;
+	s->irq_level = 1;
 	ns16550_irq_lower(s);
 
 	vmm_spin_unlock(&s->lock);
@@ -849,6 +925,8 @@ static int ns16550_emulator_probe(struct vmm_guest *guest,
 
 	INIT_TIMER_EVENT(&s->modem_status_poll, ns16550_update_msl, s);
 	INIT_TIMER_EVENT(&s->fifo_timeout_timer, ns16550_fifo_timeout_int, s);
+	s->modem_status_poll.slack_nsecs = VMM_TIMER_GUEST_SLACK_NSECS;
+	s->fifo_timeout_timer.slack_nsecs = VMM_TIMER_GUEST_SLACK_NSECS;
 
 	strlcpy(name, guest->name, sizeof(name));
 	strlcat(name, "/", sizeof(name));
@@ -859,6 +937,7 @@ static int ns16550_emulator_probe(struct vmm_guest *guest,
 	s->vser = vmm_vserial_create(name, 
 				     &ns16550_can_send, 
 				     &ns16550_send, 
+				     &ns16550_send_buf,
 				     2048, s);
 	if (!(s->vser)) {
 		SERIAL_LOG(LVL_ERR, "Failed to create vserial instance.\n");
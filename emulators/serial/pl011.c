@@ -36,6 +36,7 @@
 #include <vmm_modules.h>
 #include <vmm_devtree.h>
 #include <vmm_devemu.h>
+#include <vmm_timer.h>
 #include <vio/vmm_vserial.h>
 #include <libs/fifo.h>
 #include <libs/stringlib.h>
@@ -47,6 +48,7 @@
 #define	MODULE_INIT			pl011_emulator_init
 #define	MODULE_EXIT			pl011_emulator_exit
 
+#define PL011_INT_RT			0x40
 #define PL011_INT_TX			0x20
 #define PL011_INT_RX			0x10
 
@@ -55,6 +57,11 @@
 #define PL011_FLAG_TXFF			0x20
 #define PL011_FLAG_RXFE			0x10
 
+#define PL011_LCRH_FEN			0x10
+
+/* Receive timeout is 32 bit periods (taken at 115200 baud) */
+#define PL011_RT_NSECS			278000ULL
+
 struct pl011_state {
 	struct vmm_guest *guest;
 	struct vmm_vserial *vser;
@@ -74,29 +81,60 @@ struct pl011_state {
 	u32 ifl;
 	int rd_trig;
 	struct fifo *rd_fifo;
+	u32 irq_out;
+	u64 rt_tstamp;
+	struct vmm_timer_event rt_event;
 };
 
-static void pl011_set_irq(struct pl011_state *s, u32 level, u32 enabled)
+static void pl011_set_irq(struct pl011_state *s, u32 level)
 {
-	if (level & enabled) {
-		vmm_devemu_emulate_irq(s->guest, s->irq, 1);
-	} else {
-		vmm_devemu_emulate_irq(s->guest, s->irq, 0);
+	vmm_devemu_emulate_irq(s->guest, s->irq, level);
+}
+
+/* Note: Must be called with lock held. Returns TRUE when
+ * IRQ output has changed and needs to be passed to guest.
+ */
+static bool __pl011_update_irq(struct pl011_state *s, u32 *level)
+{
+	*level = (s->int_level & s->int_enabled) ? 1 : 0;
+	if (*level == s->irq_out) {
+		return FALSE;
 	}
+	s->irq_out = *level;
+
+	return TRUE;
 }
 
 static void pl011_set_read_trigger(struct pl011_state *s)
 {
-#if 0
-    /* The docs say the RX interrupt is triggered when the FIFO exceeds
-       the threshold.  However linux only reads the FIFO in response to an
-       interrupt.  Triggering the interrupt when the FIFO is non-empty seems
-       to make things work.  */
-    if (s->lcr & 0x10)
-        s->read_trigger = (s->ifl >> 1) & 0x1c;
-    else
-#endif
-        s->rd_trig = 1;
+	u32 trig;
+
+	if (!(s->lcr & PL011_LCRH_FEN)) {
+		s->rd_trig = 1;
+		return;
+	}
+
+	/* RX trigger is 1/8, 1/4, 1/2, 3/4 or 7/8 of FIFO depth and
+	 * the receive timeout interrupt takes care of remaining bytes.
+	 */
+	switch ((s->ifl >> 3) & 0x7) {
+	case 0:
+		trig = s->fifo_sz / 8;
+		break;
+	case 1:
+		trig = s->fifo_sz / 4;
+		break;
+	case 2:
+		trig = s->fifo_sz / 2;
+		break;
+	case 3:
+		trig = (s->fifo_sz * 3) / 4;
+		break;
+	default:
+		trig = (s->fifo_sz * 7) / 8;
+		break;
+	};
+	s->rd_trig = (trig) ? trig : 1;
 }
 
 static int pl011_reg_read(struct pl011_state *s, u32 offset, u32 *dst)
@@ -104,7 +142,7 @@ static int pl011_reg_read(struct pl011_state *s, u32 offset, u32 *dst)
 	int rc = VMM_OK;
 	u8 val = 0x0;
 	bool set_irq = FALSE;
-	u32 read_count = 0x0, level, enabled;
+	u32 read_count = 0x0, level;
 
 	vmm_spin_lock(&s->lock);
 
@@ -116,13 +154,12 @@ static int pl011_reg_read(struct pl011_state *s, u32 offset, u32 *dst)
 		read_count = fifo_avail(s->rd_fifo);
 		if (read_count == 0) {
 			s->flags |= PL011_FLAG_RXFE;
+			s->int_level &= ~PL011_INT_RT;
 		}
-		if (read_count == (s->rd_trig - 1)) {
+		if (read_count < s->rd_trig) {
 			s->int_level &= ~PL011_INT_RX;
 		}
-		set_irq = TRUE;
-		level = s->int_level;
-		enabled = s->int_enabled;
+		set_irq = __pl011_update_irq(s, &level);
 		break;
 	case 1: /* UARTCR */
 		*dst = 0;
@@ -172,7 +209,7 @@ static int pl011_reg_read(struct pl011_state *s, u32 offset, u32 *dst)
 	vmm_spin_unlock(&s->lock);
 
 	if (set_irq) {
-		pl011_set_irq(s, level, enabled);
+		pl011_set_irq(s, level);
 	}
 
 	return rc;
@@ -185,7 +222,7 @@ static int pl011_reg_write(struct pl011_state *s, u32 offset,
 	int rc = VMM_OK;
 	bool set_irq = FALSE;
 	bool recv_char = FALSE;
-	u32 level = 0, enabled = 0;
+	u32 level = 0;
 
 	vmm_spin_lock(&s->lock);
 
@@ -195,9 +232,7 @@ static int pl011_reg_write(struct pl011_state *s, u32 offset,
 		val = src;
 		recv_char = TRUE;
 		s->int_level |= PL011_INT_TX;
-		set_irq = TRUE;
-		level = s->int_level;
-		enabled = s->int_enabled;
+		set_irq = __pl011_update_irq(s, &level);
 		break;
 	case 1: /* UARTCR */
 		s->cr = (s->cr & src_mask) | (src & ~src_mask);
@@ -229,15 +264,11 @@ static int pl011_reg_write(struct pl011_state *s, u32 offset,
 	case 14: /* UARTIMSC */
 		s->int_enabled = (s->int_enabled & src_mask) | 
 				 (src & ~src_mask);
-		set_irq = TRUE;
-		level = s->int_level;
-		enabled = s->int_enabled;
+		set_irq = __pl011_update_irq(s, &level);
 		break;
 	case 17: /* UARTICR */
 		s->int_level &= ~(src & ~src_mask);
-		set_irq = TRUE;
-		level = s->int_level;
-		enabled = s->int_enabled;
+		set_irq = __pl011_update_irq(s, &level);
 		break;
 	case 18: /* UARTDMACR */
 		/* ??? DMA not implemented */
@@ -256,7 +287,7 @@ static int pl011_reg_write(struct pl011_state *s, u32 offset,
 	}
 
 	if (set_irq) {
-		pl011_set_irq(s, level, enabled);
+		pl011_set_irq(s, level);
 	}
 
 	return rc;
@@ -278,13 +309,42 @@ static bool pl011_vserial_can_send(struct vmm_vserial *vser)
 	return !fifo_isfull(s->rd_fifo);
 }
 
-static int pl011_vserial_send(struct vmm_vserial *vser, u8 data)
+/* Receive timeout fires 32 bit periods after last received batch
+ * (re-armed lazily so that each received batch does not restart it)
+ */
+static void pl011_rt_event(struct vmm_timer_event *ev)
 {
+	u64 tstamp;
 	bool set_irq = FALSE;
-	u32 rd_count, level, enabled;
-	struct pl011_state *s = vmm_vserial_priv(vser);
+	u32 level;
+	struct pl011_state *s = ev->priv;
+
+	tstamp = vmm_timer_timestamp();
+
+	vmm_spin_lock(&s->lock);
+
+	if (tstamp < s->rt_tstamp) {
+		vmm_timer_event_start(ev, s->rt_tstamp - tstamp);
+	} else if (fifo_avail(s->rd_fifo)) {
+		s->int_level |= PL011_INT_RT;
+		set_irq = __pl011_update_irq(s, &level);
+	}
+
+	vmm_spin_unlock(&s->lock);
+
+	if (set_irq) {
+		pl011_set_irq(s, level);
+	}
+}
+
+/* Update Rx flags and interrupt after adding a batch of bytes to
+ * Rx FIFO hence guest IRQ is evaluated once per batch.
+ */
+static void pl011_rx_update(struct pl011_state *s)
+{
+	bool set_irq = FALSE;
+	u32 rd_count, level;
 
-	fifo_enqueue(s->rd_fifo, &data, TRUE);
 	rd_count = fifo_avail(s->rd_fifo);
 
 	vmm_spin_lock(&s->lock);
@@ -294,19 +354,42 @@ static int pl011_vserial_send(struct vmm_vserial *vser, u8 data)
 	}
 	if (rd_count >= s->rd_trig) {
 		s->int_level |= PL011_INT_RX;
-		set_irq = TRUE;
-		level = s->int_level;
-		enabled = s->int_enabled;
+		set_irq = __pl011_update_irq(s, &level);
+	}
+	s->rt_tstamp = vmm_timer_timestamp() + PL011_RT_NSECS;
+	if (!vmm_timer_event_pending(&s->rt_event)) {
+		vmm_timer_event_start(&s->rt_event, PL011_RT_NSECS);
 	}
 	vmm_spin_unlock(&s->lock);
 
 	if (set_irq) {
-		pl011_set_irq(s, level, enabled);
+		pl011_set_irq(s, level);
 	}
+}
+
+static int pl011_vserial_send(struct vmm_vserial *vser, u8 data)
+{
+	struct pl011_state *s = vmm_vserial_priv(vser);
+
+	fifo_enqueue(s->rd_fifo, &data, TRUE);
+	pl011_rx_update(s);
 
 	return VMM_OK;
 }
 
+static u32 pl011_vserial_send_buf(struct vmm_vserial *vser, u8 *src, u32 len)
+{
+	u32 count;
+	struct pl011_state *s = vmm_vserial_priv(vser);
+
+	count = fifo_enqueue_multi(s->rd_fifo, src, len);
+	if (count) {
+		pl011_rx_update(s);
+	}
+
+	return count;
+}
+
 static int pl011_emulator_read8(struct vmm_emudev *edev,
 				physical_addr_t offset, 
 				u8 *dst)
@@ -369,18 +452,115 @@ static int pl011_emulator_reset(struct vmm_emudev *edev)
 {
 	struct pl011_state *s = edev->priv;
 
+	vmm_timer_event_stop(&s->rt_event);
+
 	vmm_spin_lock(&s->lock);
 
 	s->rd_trig = 1;
 	s->ifl = 0x12;
 	s->cr = 0x300;
 	s->flags = 0x90;
+	s->irq_out = 0;
 
 	vmm_spin_unlock(&s->lock);
 
 	return VMM_OK;
 }
 
+static int pl011_emulator_save(struct vmm_emudev *edev,
+			       struct vmm_snapshot_state *st)
+{
+	int rc;
+	u8 val;
+	u32 i, rd_count;
+	struct pl011_state *s = edev->priv;
+
+	vmm_spin_lock(&s->lock);
+
+	if ((rc = vmm_snapshot_put_var(st, s->flags)) ||
+	    (rc = vmm_snapshot_put_var(st, s->lcr)) ||
+	    (rc = vmm_snapshot_put_var(st, s->cr)) ||
+	    (rc = vmm_snapshot_put_var(st, s->dmacr)) ||
+	    (rc = vmm_snapshot_put_var(st, s->int_enabled)) ||
+	    (rc = vmm_snapshot_put_var(st, s->int_level)) ||
+	    (rc = vmm_snapshot_put_var(st, s->ilpr)) ||
+	    (rc = vmm_snapshot_put_var(st, s->ibrd)) ||
+	    (rc = vmm_snapshot_put_var(st, s->fbrd)) ||
+	    (rc = vmm_snapshot_put_var(st, s->ifl)) ||
+	    (rc = vmm_snapshot_put_var(st, s->rd_trig))) {
+		goto done;
+	}
+
+	/* Save unread receive characters oldest first */
+	rd_count = fifo_avail(s->rd_fifo);
+	if ((rc = vmm_snapshot_put_var(st, rd_count))) {
+		goto done;
+	}
+	for (i = 0; i < rd_count; i++) {
+		if (!fifo_getelement(s->rd_fifo, i, &val)) {
+			rc = VMM_EFAIL;
+			goto done;
+		}
+		if ((rc = vmm_snapshot_put_var(st, val))) {
+			goto done;
+		}
+	}
+
+done:
+	vmm_spin_unlock(&s->lock);
+
+	return rc;
+}
+
+static int pl011_emulator_restore(struct vmm_emudev *edev,
+				  struct vmm_snapshot_state *st)
+{
+	int rc;
+	u8 val;
+	u32 i, rd_count, level;
+	struct pl011_state *s = edev->priv;
+
+	vmm_spin_lock(&s->lock);
+
+	if ((rc = vmm_snapshot_get_var(st, s->flags)) ||
+	    (rc = vmm_snapshot_get_var(st, s->lcr)) ||
+	    (rc = vmm_snapshot_get_var(st, s->cr)) ||
+	    (rc = vmm_snapshot_get_var(st, s->dmacr)) ||
+	    (rc = vmm_snapshot_get_var(st, s->int_enabled)) ||
+	    (rc = vmm_snapshot_get_var(st, s->int_level)) ||
+	    (rc = vmm_snapshot_get_var(st, s->ilpr)) ||
+	    (rc = vmm_snapshot_get_var(st, s->ibrd)) ||
+	    (rc = vmm_snapshot_get_var(st, s->fbrd)) ||
+	    (rc = vmm_snapshot_get_var(st, s->ifl)) ||
+	    (rc = vmm_snapshot_get_var(st, s->rd_trig)) ||
+	    (rc = vmm_snapshot_get_var(st, rd_count))) {
+		goto done;
+	}
+	if (s->fifo_sz < rd_count) {
+		rc = VMM_EINVALID;
+		goto done;
+	}
+
+	fifo_clear(s->rd_fifo);
+	for (i = 0; i < rd_count; i++) {
+		if ((rc = vmm_snapshot_get_var(st, val))) {
+			goto done;
+		}
+		fifo_enqueue(s->rd_fifo, &val, TRUE);
+	}
+
+done:
+	__pl011_update_irq(s, &level);
+
+	vmm_spin_unlock(&s->lock);
+
+	if (!rc) {
+		pl011_set_irq(s, level);
+	}
+
+	return rc;
+}
+
 static int pl011_emulator_probe(struct vmm_guest *guest,
 				struct vmm_emudev *edev,
 				const struct vmm_devtree_nodeid *eid)
@@ -397,6 +577,8 @@ static int pl011_emulator_probe(struct vmm_guest *guest,
 
 	s->guest = guest;
 	INIT_SPIN_LOCK(&s->lock);
+	INIT_TIMER_EVENT(&s->rt_event, pl011_rt_event, s);
+	s->rt_event.slack_nsecs = VMM_TIMER_GUEST_SLACK_NSECS;
 
 	if (eid->data) {
 		s->id[0] = ((u32 *)eid->data)[0];
@@ -434,6 +616,7 @@ static int pl011_emulator_probe(struct vmm_guest *guest,
 	s->vser = vmm_vserial_create(name, 
 				     &pl011_vserial_can_send, 
 				     &pl011_vserial_send, 
+				     &pl011_vserial_send_buf,
 				     s->fifo_sz, s);
 	if (!(s->vser)) {
 		goto pl011_emulator_probe_freerbuf_fail;
@@ -456,6 +639,7 @@ static int pl011_emulator_remove(struct vmm_emudev *edev)
 	struct pl011_state *s = edev->priv;
 
 	if (s) {
+		vmm_timer_event_stop(&s->rt_event);
 		vmm_vserial_destroy(s->vser);
 		fifo_free(s->rd_fifo);
 		vmm_free(s);
@@ -510,6 +694,8 @@ static struct vmm_emulator pl011_emulator = {
 	.read32 = pl011_emulator_read32,
 	.write32 = pl011_emulator_write32,
 	.reset = pl011_emulator_reset,
+	.save = pl011_emulator_save,
+	.restore = pl011_emulator_restore,
 	.remove = pl011_emulator_remove,
 };
 
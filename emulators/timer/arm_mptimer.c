@@ -463,6 +463,7 @@ struct mptimer_state *mptimer_state_alloc(struct vmm_guest *guest,
 		INIT_TIMER_EVENT(&s->timers[i].event, 
 				 &timer_block_event,
 				 &(s->timers[i]));
+		s->timers[i].event.slack_nsecs = VMM_TIMER_GUEST_SLACK_NSECS;
 	}
 
 	goto mptimer_state_alloc_done;
@@ -263,17 +263,20 @@ static void hpet_timer(struct vmm_timer_event *event)
 				t->cmp += period;
 			}
 		}
-		diff = hpet_calculate_diff(t, cur_tick);
-		vmm_timer_event_stop(&t->timer);
-		vmm_timer_event_start(&t->timer,
-				      vmm_timer_timestamp()
-				      + (s64)ticks_to_ns(diff));
-	} else if (t->config & HPET_TN_32BIT && !timer_is_periodic(t)) {
-		if (t->wrap_flag) {
+		/* Periodic timer event is re-armed by timer subsystem */
+		if (t->timer.period_nsecs != ticks_to_ns(period)) {
 			diff = hpet_calculate_diff(t, cur_tick);
+			vmm_timer_event_start_periodic(&t->timer,
+						       ticks_to_ns(diff),
+						       ticks_to_ns(period));
+		}
+	} else {
+		if (t->timer.period_nsecs) {
 			vmm_timer_event_stop(&t->timer);
-			vmm_timer_event_start(&t->timer, vmm_timer_timestamp() +
-					      (s64)ticks_to_ns(diff));
+		}
+		if (t->config & HPET_TN_32BIT && t->wrap_flag) {
+			diff = hpet_calculate_diff(t, cur_tick);
+			vmm_timer_event_start(&t->timer, ticks_to_ns(diff));
 			t->wrap_flag = 0;
 		}
 	}
@@ -301,8 +304,12 @@ static void hpet_set_timer(struct hpet_timer *t)
 		}
 	}
 	vmm_timer_event_stop(&t->timer);
-	vmm_timer_event_start(&t->timer,
-			      vmm_timer_timestamp() + (s64)ticks_to_ns(diff));
+	if (timer_is_periodic(t) && t->period != 0) {
+		vmm_timer_event_start_periodic(&t->timer, ticks_to_ns(diff),
+					       ticks_to_ns(t->period));
+	} else {
+		vmm_timer_event_start(&t->timer, ticks_to_ns(diff));
+	}
 }
 
 static void hpet_del_timer(struct hpet_timer *t)
@@ -730,6 +737,7 @@ static int hpet_emulator_probe(struct vmm_guest *guest,
 	for (i = 0; i < HPET_MAX_TIMERS; i++) {
 		timer = &s->timer[i];
 		INIT_TIMER_EVENT(&timer->timer, hpet_timer, timer);
+		timer->timer.slack_nsecs = VMM_TIMER_GUEST_SLACK_NSECS;
 		timer->tn = i;
 		timer->state = s;
 	}
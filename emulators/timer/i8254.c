@@ -532,6 +532,9 @@ static int i8254_emulator_probe(struct vmm_guest *guest,
 	INIT_TIMER_EVENT(&s->channels[0].irq_timer, pit_irq_timer, &s->channels[0]);
     INIT_TIMER_EVENT(&s->channels[1].irq_timer, pit_irq_timer, &s->channels[1]);
     INIT_TIMER_EVENT(&s->channels[2].irq_timer, pit_irq_timer, &s->channels[2]);
+	s->channels[0].irq_timer.slack_nsecs = VMM_TIMER_GUEST_SLACK_NSECS;
+	s->channels[1].irq_timer.slack_nsecs = VMM_TIMER_GUEST_SLACK_NSECS;
+	s->channels[2].irq_timer.slack_nsecs = VMM_TIMER_GUEST_SLACK_NSECS;
 
 	s->channels[0].guest = guest;
 	s->channels[1].guest = guest;
@@ -436,6 +436,7 @@ static int sp804_timer_init(struct sp804_timer *t,
 			    u32 freq, u32 irq, bool maintain_irq_rate)
 {
 	INIT_TIMER_EVENT(&t->event, &sp804_timer_event, t);
+	t->event.slack_nsecs = VMM_TIMER_GUEST_SLACK_NSECS;
 
 	t->guest = guest;
 	t->ref_freq = freq;
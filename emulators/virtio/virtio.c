@@ -180,6 +180,30 @@ int virtio_reset(struct virtio_device *dev)
 }
 VMM_EXPORT_SYMBOL(virtio_reset);
 
+struct virtio_device *virtio_find_device(const char *name)
+{
+	bool found = FALSE;
+	struct virtio_device *dev;
+
+	if (!name) {
+		return NULL;
+	}
+
+	vmm_mutex_lock(&virtio_mutex);
+
+	list_for_each_entry(dev, &virtio_dev_list, node) {
+		if (strcmp(dev->name, name) == 0) {
+			found = TRUE;
+			break;
+		}
+	}
+
+	vmm_mutex_unlock(&virtio_mutex);
+
+	return (found) ? dev : NULL;
+}
+VMM_EXPORT_SYMBOL(virtio_find_device);
+
 int virtio_register_device(struct virtio_device *dev)
 {
 	int rc = VMM_OK;
@@ -192,6 +216,11 @@ int virtio_register_device(struct virtio_device *dev)
 	dev->emu = NULL;
 	dev->emu_data = NULL;
 
+	/* Failure only disables caching so ignore return value */
+	if (dev->guest) {
+		vmm_guest_mapcache_init(&dev->mcache, dev->guest);
+	}
+
 	vmm_mutex_lock(&virtio_mutex);
 
 	list_add_tail(&dev->node, &virtio_dev_list);
@@ -199,6 +228,10 @@ int virtio_register_device(struct virtio_device *dev)
 
 	vmm_mutex_unlock(&virtio_mutex);
 
+	if (rc) {
+		vmm_guest_mapcache_exit(&dev->mcache);
+	}
+
 	return rc;
 }
 VMM_EXPORT_SYMBOL(virtio_register_device);
@@ -215,6 +248,8 @@ void virtio_unregister_device(struct virtio_device *dev)
 	list_del(&dev->node);
 
 	vmm_mutex_unlock(&virtio_mutex);
+
+	vmm_guest_mapcache_exit(&dev->mcache);
 }
 VMM_EXPORT_SYMBOL(virtio_unregister_device);
 
@@ -0,0 +1,717 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file virtio_bench.c
+ * @author agent (agent@local)
+ * @brief VirtIO loopback benchmark driver
+ *
+ * Each benchmarked VirtIO device gets one legacy virtqueue with only
+ * mandatory features negotiated. Virtqueue and buffers are placed at
+ * the end of largest RAM region of Guest owning the device and the
+ * device transport is swapped with a loopback transport which just
+ * wakes up benchmark driver. Requests are kept in flight upto given
+ * queue depth and latency of each request is recorded so that
+ * percentiles can be computed.
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_macros.h>
+#include <vmm_manager.h>
+#include <vmm_guest_aspace.h>
+#include <vmm_host_aspace.h>
+#include <vmm_host_io.h>
+#include <vmm_completion.h>
+#include <vmm_modules.h>
+#include <arch_barrier.h>
+#include <libs/stringlib.h>
+#include <libs/mathlib.h>
+#include <libs/libsort.h>
+#include <emu/virtio.h>
+#include <emu/virtio_blk.h>
+#include <emu/virtio_net.h>
+#include <emu/virtio_bench.h>
+
+#define MODULE_DESC			"VirtIO Benchmark Driver"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(VIRTIO_IPRIORITY + 1)
+#define	MODULE_INIT			virtio_bench_init
+#define	MODULE_EXIT			virtio_bench_exit
+
+/* Legacy virtqueue page size and alignment */
+#define VBENCH_VRING_PAGE_SIZE		4096
+
+/* Time to wait for device to make progress */
+#define VBENCH_TIMEOUT_NSECS		1000000000ULL
+
+/* Time to wait for packets in flight after last transmit completed */
+#define VBENCH_RX_DRAIN_NSECS		100000000ULL
+
+#define VBENCH_BLK_SECTOR_SIZE		512
+#define VBENCH_BLK_MAX_SIZE		(128 * 1024)
+#define VBENCH_BLK_DESC_PER_REQ		3
+
+#define VBENCH_NET_MIN_PKT		60
+#define VBENCH_NET_MAX_PKT		1514
+#define VBENCH_NET_HDR_LEN		sizeof(struct virtio_net_hdr)
+#define VBENCH_NET_BUF_SIZE		1536
+#define VBENCH_NET_RX_BUFS		(VIRTIO_BENCH_MAX_QDEPTH * 4)
+#define VBENCH_NET_ETHERTYPE		0x88B5
+#define VBENCH_NET_MAGIC		0x4E454256
+
+/* Payload of benchmark packets after ethernet header */
+struct vbench_net_pkt {
+	u8 dst[6];
+	u8 src[6];
+	u16 ethertype;
+	u32 magic;
+	u32 seq;
+} __packed;
+
+/* Benchmark driver state of one VirtIO device */
+struct vbench_dev {
+	struct virtio_device *dev;
+	struct virtio_transport *saved_tra;
+	void *saved_tra_data;
+	struct vmm_completion *notified;
+
+	/* Guest RAM used for virtqueue followed by buffers */
+	physical_addr_t gpa;
+	physical_size_t ring_size;
+	physical_size_t size;
+	virtual_addr_t va;
+
+	/* Virtqueue */
+	u32 vq;
+	struct vring vr;
+	u16 avail_idx;
+	u16 used_idx;
+};
+
+static int vbench_notify(struct virtio_device *dev, u32 vq)
+{
+	struct vbench_dev *d = dev->tra_data;
+
+	vmm_completion_complete(d->notified);
+
+	return VMM_OK;
+}
+
+static struct virtio_transport vbench_tra = {
+	.name = "virtio_bench",
+	.notify = vbench_notify,
+};
+
+static int vbench_vcpu_stopped_iter(struct vmm_vcpu *vcpu, void *priv)
+{
+	u32 state = vmm_manager_vcpu_get_state(vcpu);
+
+	return (state & (VMM_VCPU_STATE_RESET | VMM_VCPU_STATE_PAUSED)) ?
+							VMM_OK : VMM_EBUSY;
+}
+
+/* Find page aligned area of given size at the end of largest RAM region */
+static int vbench_find_ram(struct vmm_guest *guest, physical_size_t size,
+			   physical_addr_t *gpa)
+{
+	irq_flags_t flags;
+	struct rb_node *pos;
+	struct vmm_region *reg, *best = NULL;
+	struct vmm_guest_aspace *aspace = &guest->aspace;
+	u32 ram_flags = VMM_REGION_REAL | VMM_REGION_MEMORY | VMM_REGION_ISRAM;
+
+	vmm_read_lock_irqsave_lite(&aspace->reg_memtree_lock, flags);
+	for (pos = rb_first(&aspace->reg_memtree); pos; pos = rb_next(pos)) {
+		reg = rb_entry(pos, struct vmm_region, head);
+		if ((reg->flags & ram_flags) != ram_flags) {
+			continue;
+		}
+		if (!best || (best->phys_size < reg->phys_size)) {
+			best = reg;
+		}
+	}
+	if (best && ((size + VMM_PAGE_SIZE) <= best->phys_size)) {
+		*gpa = (VMM_REGION_GPHYS_END(best) - size) &
+						~((physical_addr_t)VMM_PAGE_MASK);
+	} else {
+		best = NULL;
+	}
+	vmm_read_unlock_irqrestore_lite(&aspace->reg_memtree_lock, flags);
+
+	return (best) ? VMM_OK : VMM_ENOSPC;
+}
+
+static void vbench_detach(struct vbench_dev *d)
+{
+	if (d->dev) {
+		/* Aborts requests in flight before transport is restored */
+		virtio_reset(d->dev);
+		d->dev->tra = d->saved_tra;
+		d->dev->tra_data = d->saved_tra_data;
+		d->dev = NULL;
+	}
+
+	if (d->va) {
+		vmm_host_memunmap(d->va);
+		d->va = 0;
+	}
+}
+
+static int vbench_attach(struct vbench_dev *d, const char *name, u32 type,
+			 u32 vq, physical_size_t buf_size,
+			 struct vmm_completion *notified)
+{
+	int rc;
+	u32 num, reg_flags;
+	physical_addr_t hpa;
+	physical_size_t avail;
+	struct virtio_device *dev = virtio_find_device(name);
+
+	memset(d, 0, sizeof(*d));
+
+	if (!dev || !dev->emu || !dev->guest || (dev->id.type != type)) {
+		return VMM_ENODEV;
+	}
+
+	/* Benchmark driver owns the device only when Guest is stopped */
+	if (vmm_manager_guest_vcpu_iterate(dev->guest,
+					   vbench_vcpu_stopped_iter, NULL)) {
+		return VMM_EBUSY;
+	}
+
+	num = dev->emu->get_size_vq(dev, vq);
+	if (!num) {
+		return VMM_EINVALID;
+	}
+	d->ring_size = VMM_ROUNDUP2_PAGE_SIZE(
+				vring_size(num, VBENCH_VRING_PAGE_SIZE));
+	d->size = d->ring_size + VMM_ROUNDUP2_PAGE_SIZE(buf_size);
+
+	rc = vbench_find_ram(dev->guest, d->size, &d->gpa);
+	if (rc) {
+		return rc;
+	}
+
+	rc = vmm_guest_physical_map(dev->guest, d->gpa, d->size,
+				    &hpa, &avail, &reg_flags);
+	if (rc || (avail < d->size)) {
+		return VMM_ENOSPC;
+	}
+
+	d->va = vmm_host_memmap(hpa, d->size, VMM_MEMORY_FLAGS_NORMAL);
+	if (!d->va) {
+		return VMM_ENOMEM;
+	}
+	memset((void *)d->va, 0, d->ring_size);
+	vring_init(&d->vr, num, (void *)d->va, VBENCH_VRING_PAGE_SIZE);
+
+	d->vq = vq;
+	d->notified = notified;
+	d->saved_tra = dev->tra;
+	d->saved_tra_data = dev->tra_data;
+
+	virtio_reset(dev);
+	dev->tra_data = d;
+	arch_wmb();
+	dev->tra = &vbench_tra;
+	d->dev = dev;
+
+	dev->emu->set_guest_features(dev, 0);
+	rc = dev->emu->init_vq(dev, vq, VBENCH_VRING_PAGE_SIZE,
+			       VBENCH_VRING_PAGE_SIZE,
+			       d->gpa / VBENCH_VRING_PAGE_SIZE);
+	if (rc) {
+		vbench_detach(d);
+		return rc;
+	}
+
+	return VMM_OK;
+}
+
+static inline physical_addr_t vbench_buf_gpa(struct vbench_dev *d, u32 off)
+{
+	return d->gpa + d->ring_size + off;
+}
+
+static inline void *vbench_buf_va(struct vbench_dev *d, u32 off)
+{
+	return (void *)(d->va + d->ring_size + off);
+}
+
+static void vbench_desc(struct vbench_dev *d, u16 i, u32 off, u32 len,
+			u16 flags, u16 next)
+{
+	struct vring_desc *desc = &d->vr.desc[i];
+
+	desc->addr = vbench_buf_gpa(d, off);
+	desc->len = len;
+	desc->flags = flags;
+	desc->next = next;
+}
+
+static void vbench_add(struct vbench_dev *d, u16 head)
+{
+	d->vr.avail->ring[d->avail_idx % d->vr.num] = head;
+	d->avail_idx++;
+}
+
+static void vbench_kick(struct vbench_dev *d)
+{
+	arch_wmb();
+	*((volatile u16 *)&d->vr.avail->idx) = d->avail_idx;
+	arch_mb();
+	d->dev->emu->notify_vq(d->dev, d->vq);
+}
+
+static bool vbench_get_used(struct vbench_dev *d, u32 *head, u32 *len)
+{
+	struct vring_used_elem *e;
+
+	if (d->used_idx == *((volatile u16 *)&d->vr.used->idx)) {
+		return FALSE;
+	}
+	arch_rmb();
+
+	e = &d->vr.used->ring[d->used_idx % d->vr.num];
+	*head = e->id;
+	*len = e->len;
+	d->used_idx++;
+
+	return TRUE;
+}
+
+static int vbench_wait(struct vmm_completion *notified, u64 nsecs)
+{
+	u64 timeout = nsecs;
+
+	return vmm_completion_wait_timeout(notified, &timeout);
+}
+
+static int vbench_lat_cmp(void *m, size_t a, size_t b)
+{
+	u64 *lat = m;
+
+	return (lat[a] > lat[b]) ? 1 : 0;
+}
+
+static void vbench_lat_swap(void *m, size_t a, size_t b)
+{
+	u64 tmp, *lat = m;
+
+	tmp = lat[a];
+	lat[a] = lat[b];
+	lat[b] = tmp;
+}
+
+static u64 vbench_lat_permille(u64 *lat, u32 count, u32 permille)
+{
+	return lat[udiv64((u64)(count - 1) * permille, 1000)];
+}
+
+static void vbench_stats(struct virtio_bench_stats *s, u64 *lat, u32 count)
+{
+	u32 i;
+	u64 sum = 0;
+
+	if (!count) {
+		return;
+	}
+
+	libsort_smoothsort(lat, 0, count, vbench_lat_cmp, vbench_lat_swap);
+	for (i = 0; i < count; i++) {
+		sum += lat[i];
+	}
+
+	s->lat_min = lat[0];
+	s->lat_avg = udiv64(sum, count);
+	s->lat_p50 = vbench_lat_permille(lat, count, 500);
+	s->lat_p90 = vbench_lat_permille(lat, count, 900);
+	s->lat_p99 = vbench_lat_permille(lat, count, 990);
+	s->lat_p999 = vbench_lat_permille(lat, count, 999);
+	s->lat_max = lat[count - 1];
+}
+
+int virtio_bench_blk(const char *name,
+		     const struct virtio_bench_params *params,
+		     struct virtio_bench_stats *stats)
+{
+	int rc;
+	bool kick;
+	u8 *status;
+	u64 capacity = 0, sector, tstamp;
+	u64 *start = NULL, *lat = NULL;
+	u32 i, head, len, slot, nfree, nsect, submitted = 0;
+	u32 hdr_off, status_off, data_off;
+	u32 free_slots[VIRTIO_BENCH_MAX_QDEPTH];
+	struct vbench_dev d;
+	struct virtio_blk_outhdr *hdr;
+	struct vmm_completion notified;
+
+	if (!name || !params || !stats) {
+		return VMM_EINVALID;
+	}
+	if (!params->qdepth || (VIRTIO_BENCH_MAX_QDEPTH < params->qdepth) ||
+	    !params->count || !params->size ||
+	    (VBENCH_BLK_MAX_SIZE < params->size) ||
+	    (params->size % VBENCH_BLK_SECTOR_SIZE)) {
+		return VMM_EINVALID;
+	}
+	memset(stats, 0, sizeof(*stats));
+	nsect = params->size / VBENCH_BLK_SECTOR_SIZE;
+
+	/* Request headers, then status bytes, then page aligned data */
+	hdr_off = 0;
+	status_off = params->qdepth * sizeof(*hdr);
+	data_off = VMM_ROUNDUP2_PAGE_SIZE(status_off + params->qdepth);
+
+	start = vmm_zalloc(params->qdepth * sizeof(*start));
+	lat = vmm_malloc(params->count * sizeof(*lat));
+	if (!start || !lat) {
+		rc = VMM_ENOMEM;
+		goto done;
+	}
+
+	INIT_COMPLETION(&notified);
+	rc = vbench_attach(&d, name, VIRTIO_ID_BLOCK, 0,
+			   data_off + params->qdepth * params->size,
+			   &notified);
+	if (rc) {
+		goto done;
+	}
+
+	if (d.vr.num < (params->qdepth * VBENCH_BLK_DESC_PER_REQ)) {
+		rc = VMM_EINVALID;
+		goto done_detach;
+	}
+
+	virtio_config_read(d.dev, offsetof(struct virtio_blk_config, capacity),
+			   &capacity, sizeof(capacity));
+	if (capacity < nsect) {
+		rc = VMM_ENOSPC;
+		goto done_detach;
+	}
+
+	for (i = 0; i < params->qdepth; i++) {
+		free_slots[i] = i;
+	}
+	nfree = params->qdepth;
+	status = vbench_buf_va(&d, status_off);
+
+	tstamp = vmm_timer_timestamp();
+	while ((stats->done + stats->errors) < params->count) {
+		kick = FALSE;
+		while (nfree && (submitted < params->count)) {
+			slot = free_slots[--nfree];
+			head = slot * VBENCH_BLK_DESC_PER_REQ;
+
+			sector = umod64((u64)submitted * nsect,
+					capacity - nsect + 1);
+			hdr = vbench_buf_va(&d, hdr_off + slot * sizeof(*hdr));
+			hdr->type = (params->write) ?
+					VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+			hdr->ioprio = 0;
+			hdr->sector = sector;
+			status[slot] = 0xFF;
+
+			vbench_desc(&d, head, hdr_off + slot * sizeof(*hdr),
+				    sizeof(*hdr), VRING_DESC_F_NEXT, head + 1);
+			vbench_desc(&d, head + 1,
+				    data_off + slot * params->size,
+				    params->size, VRING_DESC_F_NEXT |
+				    ((params->write) ? 0 : VRING_DESC_F_WRITE),
+				    head + 2);
+			vbench_desc(&d, head + 2, status_off + slot, 1,
+				    VRING_DESC_F_WRITE, 0);
+
+			start[slot] = vmm_timer_timestamp();
+			vbench_add(&d, head);
+			submitted++;
+			kick = TRUE;
+		}
+		if (kick) {
+			vbench_kick(&d);
+		}
+
+		kick = FALSE;
+		while (vbench_get_used(&d, &head, &len)) {
+			slot = head / VBENCH_BLK_DESC_PER_REQ;
+			if ((params->qdepth <= slot) ||
+			    (head % VBENCH_BLK_DESC_PER_REQ)) {
+				rc = VMM_EIO;
+				goto done_detach;
+			}
+			lat[stats->done + stats->errors] =
+					vmm_timer_timestamp() - start[slot];
+			if (status[slot] == VIRTIO_BLK_S_OK) {
+				stats->done++;
+				stats->bytes += params->size;
+			} else {
+				stats->errors++;
+			}
+			free_slots[nfree++] = slot;
+			kick = TRUE;
+		}
+
+		if (!kick) {
+			rc = vbench_wait(&notified, VBENCH_TIMEOUT_NSECS);
+			if (rc) {
+				goto done_detach;
+			}
+		}
+	}
+	stats->nsecs = vmm_timer_timestamp() - tstamp;
+
+	vbench_stats(stats, lat, stats->done + stats->errors);
+
+done_detach:
+	vbench_detach(&d);
+done:
+	if (lat) {
+		vmm_free(lat);
+	}
+	if (start) {
+		vmm_free(start);
+	}
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(virtio_bench_blk);
+
+static void vbench_net_rx_post(struct vbench_dev *d, u32 head)
+{
+	vbench_desc(d, head, head * VBENCH_NET_BUF_SIZE,
+		    VBENCH_NET_BUF_SIZE, VRING_DESC_F_WRITE, 0);
+	vbench_add(d, head);
+}
+
+/* Account received benchmark packets and repost their buffers */
+static bool vbench_net_rx(struct vbench_dev *rd, u32 count, u64 *tx_start,
+			  u64 *rx_lat, struct virtio_bench_stats *rx_stats)
+{
+	bool progress = FALSE;
+	u32 head, len;
+	struct vbench_net_pkt *pkt;
+
+	while (vbench_get_used(rd, &head, &len)) {
+		progress = TRUE;
+		if ((VBENCH_NET_RX_BUFS <= head) || (rd->vr.num <= head)) {
+			continue;
+		}
+		pkt = vbench_buf_va(rd, head * VBENCH_NET_BUF_SIZE +
+					VBENCH_NET_HDR_LEN);
+		if ((len >= (VBENCH_NET_HDR_LEN + sizeof(*pkt))) &&
+		    (pkt->magic == VBENCH_NET_MAGIC) && (pkt->seq < count) &&
+		    (rx_stats->done < count)) {
+			rx_lat[rx_stats->done] =
+				vmm_timer_timestamp() - tx_start[pkt->seq];
+			rx_stats->done++;
+			rx_stats->bytes += len - VBENCH_NET_HDR_LEN;
+		}
+		vbench_net_rx_post(rd, head);
+	}
+
+	if (progress) {
+		vbench_kick(rd);
+	}
+
+	return progress;
+}
+
+int virtio_bench_net(const char *name, const char *peer,
+		     const struct virtio_bench_params *params,
+		     struct virtio_bench_stats *tx_stats,
+		     struct virtio_bench_stats *rx_stats)
+{
+	int rc;
+	bool progress;
+	u8 dst[6] = { 0x02, 0x00, 0x00, 0x00, 0x00, 0x00 }, src[6];
+	u64 tstamp, *tx_start = NULL, *tx_lat = NULL, *rx_lat = NULL;
+	u32 i, head, len, slot, nfree, submitted = 0;
+	u32 free_slots[VIRTIO_BENCH_MAX_QDEPTH];
+	u32 slot_seq[VIRTIO_BENCH_MAX_QDEPTH];
+	struct vbench_dev td, rd;
+	struct vbench_net_pkt *pkt;
+	struct vmm_completion notified;
+
+	if (!name || !params || !tx_stats || (peer && !rx_stats)) {
+		return VMM_EINVALID;
+	}
+	if (!params->qdepth || (VIRTIO_BENCH_MAX_QDEPTH < params->qdepth) ||
+	    !params->count || (params->size < VBENCH_NET_MIN_PKT) ||
+	    (VBENCH_NET_MAX_PKT < params->size)) {
+		return VMM_EINVALID;
+	}
+	memset(tx_stats, 0, sizeof(*tx_stats));
+	if (rx_stats) {
+		memset(rx_stats, 0, sizeof(*rx_stats));
+	}
+	memset(&td, 0, sizeof(td));
+	memset(&rd, 0, sizeof(rd));
+
+	tx_start = vmm_zalloc(params->count * sizeof(*tx_start));
+	tx_lat = vmm_malloc(params->count * sizeof(*tx_lat));
+	rx_lat = (peer) ? vmm_malloc(params->count * sizeof(*rx_lat)) : NULL;
+	if (!tx_start || !tx_lat || (peer && !rx_lat)) {
+		rc = VMM_ENOMEM;
+		goto done;
+	}
+
+	INIT_COMPLETION(&notified);
+
+	/* Receive queue of peer is filled before first transmit */
+	if (peer) {
+		rc = vbench_attach(&rd, peer, VIRTIO_ID_NET, 0,
+				   VBENCH_NET_RX_BUFS * VBENCH_NET_BUF_SIZE,
+				   &notified);
+		if (rc) {
+			goto done;
+		}
+		for (i = 0; (i < rd.vr.num) && (i < VBENCH_NET_RX_BUFS); i++) {
+			vbench_net_rx_post(&rd, i);
+		}
+		vbench_kick(&rd);
+		virtio_config_read(rd.dev,
+				   offsetof(struct virtio_net_config, mac),
+				   dst, sizeof(dst));
+	}
+
+	rc = vbench_attach(&td, name, VIRTIO_ID_NET, 1,
+			   params->qdepth * VBENCH_NET_BUF_SIZE, &notified);
+	if (rc) {
+		goto done_detach;
+	}
+	virtio_config_read(td.dev, offsetof(struct virtio_net_config, mac),
+			   src, sizeof(src));
+
+	for (i = 0; i < params->qdepth; i++) {
+		free_slots[i] = i;
+		memset(vbench_buf_va(&td, i * VBENCH_NET_BUF_SIZE), 0,
+		       VBENCH_NET_HDR_LEN + params->size);
+		pkt = vbench_buf_va(&td, i * VBENCH_NET_BUF_SIZE +
+					 VBENCH_NET_HDR_LEN);
+		memcpy(pkt->dst, dst, sizeof(pkt->dst));
+		memcpy(pkt->src, src, sizeof(pkt->src));
+		pkt->ethertype = vmm_cpu_to_be16(VBENCH_NET_ETHERTYPE);
+		pkt->magic = VBENCH_NET_MAGIC;
+	}
+	nfree = params->qdepth;
+
+	tstamp = vmm_timer_timestamp();
+	while ((tx_stats->done + tx_stats->errors) < params->count) {
+		progress = FALSE;
+		while (nfree && (submitted < params->count)) {
+			slot = free_slots[--nfree];
+			pkt = vbench_buf_va(&td, slot * VBENCH_NET_BUF_SIZE +
+						 VBENCH_NET_HDR_LEN);
+			pkt->seq = submitted;
+			slot_seq[slot] = submitted;
+			vbench_desc(&td, slot, slot * VBENCH_NET_BUF_SIZE,
+				    VBENCH_NET_HDR_LEN + params->size, 0, 0);
+			tx_start[submitted] = vmm_timer_timestamp();
+			vbench_add(&td, slot);
+			submitted++;
+			progress = TRUE;
+		}
+		if (progress) {
+			vbench_kick(&td);
+		}
+
+		progress = FALSE;
+		while (vbench_get_used(&td, &head, &len)) {
+			if (params->qdepth <= head) {
+				rc = VMM_EIO;
+				goto done_detach;
+			}
+			tx_lat[tx_stats->done + tx_stats->errors] =
+				vmm_timer_timestamp() - tx_start[slot_seq[head]];
+			tx_stats->done++;
+			tx_stats->bytes += params->size;
+			free_slots[nfree++] = head;
+			progress = TRUE;
+		}
+		if (peer && vbench_net_rx(&rd, params->count, tx_start,
+					  rx_lat, rx_stats)) {
+			progress = TRUE;
+		}
+
+		if (!progress) {
+			rc = vbench_wait(&notified, VBENCH_TIMEOUT_NSECS);
+			if (rc) {
+				goto done_detach;
+			}
+		}
+	}
+	tx_stats->nsecs = vmm_timer_timestamp() - tstamp;
+	vbench_stats(tx_stats, tx_lat, tx_stats->done);
+
+	if (peer) {
+		/* Packets not received in drain time are lost */
+		while (rx_stats->done < params->count) {
+			if (vbench_net_rx(&rd, params->count, tx_start,
+					  rx_lat, rx_stats)) {
+				continue;
+			}
+			if (vbench_wait(&notified, VBENCH_RX_DRAIN_NSECS)) {
+				break;
+			}
+		}
+		rx_stats->nsecs = vmm_timer_timestamp() - tstamp;
+		rx_stats->errors = params->count - rx_stats->done;
+		vbench_stats(rx_stats, rx_lat, rx_stats->done);
+	}
+
+	rc = VMM_OK;
+
+done_detach:
+	vbench_detach(&td);
+	vbench_detach(&rd);
+done:
+	if (rx_lat) {
+		vmm_free(rx_lat);
+	}
+	if (tx_lat) {
+		vmm_free(tx_lat);
+	}
+	if (tx_start) {
+		vmm_free(tx_start);
+	}
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(virtio_bench_net);
+
+static int __init virtio_bench_init(void)
+{
+	/* Nothing to be done */
+	return VMM_OK;
+}
+
+static void __exit virtio_bench_exit(void)
+{
+	/* Nothing to be done */
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
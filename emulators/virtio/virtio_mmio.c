@@ -26,6 +26,7 @@
 #include <vmm_stdio.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <vmm_trace.h>
 #include <emu/virtio.h>
 #include <emu/virtio_queue.h>
 #include <emu/virtio_mmio.h>
@@ -48,6 +49,36 @@ static int virtio_mmio_notify(struct virtio_device *dev, u32 vq)
 	return VMM_OK;
 }
 
+static int virtio_mmio_notify_config(struct virtio_device *dev)
+{
+	struct virtio_mmio_dev *m = dev->tra_data;
+
+	m->config.interrupt_state |= VIRTIO_MMIO_INT_CONFIG;
+
+	vmm_devemu_emulate_irq(m->guest, m->irq, 1);
+
+	return VMM_OK;
+}
+
+#define VIRTIO_MMIO_SET_LO(x, val)	\
+	(x) = ((x) & 0xFFFFFFFF00000000ULL) | (u64)(val)
+#define VIRTIO_MMIO_SET_HI(x, val)	\
+	(x) = ((x) & 0xFFFFFFFFULL) | ((u64)(val) << 32)
+
+static u64 virtio_mmio_host_features(struct virtio_mmio_dev *m)
+{
+	u64 features = m->dev.emu->get_host_features(&m->dev);
+
+	/* Legacy interface has only 32 feature bits and
+	 * non-legacy queue setup needs support from emulator.
+	 */
+	if ((m->config.version < 2) || !m->dev.emu->init_vq_addr) {
+		features &= 0xFFFFFFFFULL;
+	}
+
+	return features;
+}
+
 int virtio_mmio_config_read(struct virtio_mmio_dev *m,
 			    u32 offset, void *dst,
 			    u32 dst_len)
@@ -64,7 +95,19 @@ int virtio_mmio_config_read(struct virtio_mmio_dev *m,
 		*(u32 *)dst = (*(u32 *)(((void *)&m->config) + offset));
 		break;
 	case VIRTIO_MMIO_HOST_FEATURES:
-		*(u32 *)dst = m->dev.emu->get_host_features(&m->dev);
+		if (m->config.host_features_sel < 2) {
+			*(u32 *)dst = (u32)(virtio_mmio_host_features(m) >>
+					(32 * m->config.host_features_sel));
+		} else {
+			*(u32 *)dst = 0;
+		}
+		break;
+	case VIRTIO_MMIO_QUEUE_READY:
+		*(u32 *)dst = (m->config.queue_sel < 64) ?
+			(u32)((m->queue_ready >> m->config.queue_sel) & 0x1) : 0;
+		break;
+	case VIRTIO_MMIO_CONFIG_GENERATION:
+		*(u32 *)dst = 0;
 		break;
 	case VIRTIO_MMIO_QUEUE_PFN:
 		*(u32 *)dst = m->dev.emu->get_pfn_vq(&m->dev,
@@ -104,13 +147,61 @@ static int virtio_mmio_config_write(struct virtio_mmio_dev *m,
 	case VIRTIO_MMIO_HOST_FEATURES_SEL:
 	case VIRTIO_MMIO_GUEST_FEATURES_SEL:
 	case VIRTIO_MMIO_QUEUE_SEL:
-	case VIRTIO_MMIO_STATUS:
 		*(u32 *)(((void *)&m->config) + offset) = val;
 		break;
+	case VIRTIO_MMIO_STATUS:
+		m->config.status = val;
+		/* Writing zero resets non-legacy device */
+		if (!val && (m->config.version > 1)) {
+			m->guest_features = 0;
+			m->queue_ready = 0;
+			rc = virtio_reset(&m->dev);
+		}
+		break;
 	case VIRTIO_MMIO_GUEST_FEATURES:
 		if (m->config.guest_features_sel == 0)  {
-			m->dev.emu->set_guest_features(&m->dev, val);
+			VIRTIO_MMIO_SET_LO(m->guest_features, val);
+		} else if ((m->config.guest_features_sel == 1) &&
+			   (m->config.version > 1)) {
+			VIRTIO_MMIO_SET_HI(m->guest_features, val);
+		} else {
+			break;
+		}
+		m->dev.emu->set_guest_features(&m->dev,
+				m->guest_features & virtio_mmio_host_features(m));
+		break;
+	case VIRTIO_MMIO_QUEUE_READY:
+		if (m->config.queue_sel >= 64) {
+			break;
 		}
+		m->queue_ready &= ~(1ULL << m->config.queue_sel);
+		if ((val & 0x1) && m->dev.emu->init_vq_addr &&
+		    !m->dev.emu->init_vq_addr(&m->dev,
+					      m->config.queue_sel,
+					      m->config.queue_num,
+					      (physical_addr_t)m->queue_desc,
+					      (physical_addr_t)m->queue_driver,
+					      (physical_addr_t)m->queue_device)) {
+			m->queue_ready |= (1ULL << m->config.queue_sel);
+		}
+		break;
+	case VIRTIO_MMIO_QUEUE_DESC_LOW:
+		VIRTIO_MMIO_SET_LO(m->queue_desc, val);
+		break;
+	case VIRTIO_MMIO_QUEUE_DESC_HIGH:
+		VIRTIO_MMIO_SET_HI(m->queue_desc, val);
+		break;
+	case VIRTIO_MMIO_QUEUE_AVAIL_LOW:
+		VIRTIO_MMIO_SET_LO(m->queue_driver, val);
+		break;
+	case VIRTIO_MMIO_QUEUE_AVAIL_HIGH:
+		VIRTIO_MMIO_SET_HI(m->queue_driver, val);
+		break;
+	case VIRTIO_MMIO_QUEUE_USED_LOW:
+		VIRTIO_MMIO_SET_LO(m->queue_device, val);
+		break;
+	case VIRTIO_MMIO_QUEUE_USED_HIGH:
+		VIRTIO_MMIO_SET_HI(m->queue_device, val);
 		break;
 	case VIRTIO_MMIO_GUEST_PAGE_SIZE:
 		m->config.guest_page_size = val;
@@ -132,6 +223,9 @@ static int virtio_mmio_config_write(struct virtio_mmio_dev *m,
 				    val);
 		break;
 	case VIRTIO_MMIO_QUEUE_NOTIFY:
+		vmm_trace(VIRTQ_NOTIFY, (virtual_addr_t)&m->dev, val, 0, 0);
+		vmm_manager_guest_boot_mark(m->dev.guest,
+					VMM_GUEST_BOOT_FIRST_VIRTIO_NOTIFY);
 		m->dev.emu->notify_vq(&m->dev, val);
 		break;
 	case VIRTIO_MMIO_INTERRUPT_ACK:
@@ -217,6 +311,17 @@ static int virtio_mmio_write32(struct vmm_emudev *edev,
 	return virtio_mmio_write(edev->priv, offset, 0x00000000, src);
 }
 
+static int virtio_mmio_doorbell(struct vmm_emudev *edev, u32 val)
+{
+	struct virtio_mmio_dev *m = edev->priv;
+
+	vmm_trace(VIRTQ_NOTIFY, (virtual_addr_t)&m->dev, val, 0, 0);
+	vmm_manager_guest_boot_mark(m->dev.guest,
+				VMM_GUEST_BOOT_FIRST_VIRTIO_NOTIFY);
+
+	return m->dev.emu->notify_vq(&m->dev, val);
+}
+
 static int virtio_mmio_reset(struct vmm_emudev *edev)
 {
 	struct virtio_mmio_dev *m = edev->priv;
@@ -224,12 +329,16 @@ static int virtio_mmio_reset(struct vmm_emudev *edev)
 	m->config.interrupt_state = 0x0;
 	vmm_devemu_emulate_irq(m->guest, m->irq, 0);
 
+	m->guest_features = 0;
+	m->queue_ready = 0;
+
 	return virtio_reset(&m->dev);
 }
 
 static struct virtio_transport mmio_tra = {
 	.name = "virtio_mmio",
 	.notify = virtio_mmio_notify,
+	.notify_config = virtio_mmio_notify_config,
 };
 
 static int virtio_mmio_probe(struct vmm_guest *guest,
@@ -267,6 +376,13 @@ static int virtio_mmio_probe(struct vmm_guest *guest,
 		goto virtio_mmio_probe_freestate_fail;
 	}
 
+	/* Non-legacy (virtio 1.0) interface is opt-in */
+	if (vmm_devtree_read_u32(edev->node, "virtio_version",
+				 &m->config.version) ||
+	    (m->config.version < 1) || (m->config.version > 2)) {
+		m->config.version = 1;
+	}
+
 	m->dev.id.type = m->config.device_id;
 
 	rc = vmm_devtree_irq_get(edev->node, &m->irq, 0);
@@ -274,12 +390,28 @@ static int virtio_mmio_probe(struct vmm_guest *guest,
 		goto virtio_mmio_probe_freestate_fail;
 	}
 
+	/* Queue notify is a write-only doorbell so defer it */
+	rc = vmm_devemu_add_coalesce_range(edev, VIRTIO_MMIO_QUEUE_NOTIFY, 4);
+	if (rc) {
+		goto virtio_mmio_probe_freestate_fail;
+	}
+
 	if ((rc = virtio_register_device(&m->dev))) {
 		goto virtio_mmio_probe_freestate_fail;
 	}
 
 	edev->priv = m;
 
+	/* Queue notify can also be done using hypercall doorbell
+	 * which skips MMIO trap, decoding and region lookup.
+	 */
+	rc = vmm_devemu_set_doorbell(edev, virtio_mmio_doorbell);
+	if (rc) {
+		virtio_unregister_device(&m->dev);
+		edev->priv = NULL;
+		goto virtio_mmio_probe_freestate_fail;
+	}
+
 	goto virtio_mmio_probe_done;
 
 virtio_mmio_probe_freestate_fail:
@@ -26,6 +26,7 @@
 #include <vmm_heap.h>
 #include <vmm_modules.h>
 #include <vmm_devemu.h>
+#include <vmm_trace.h>
 #include <emu/virtio.h>
 #include <emu/virtio_queue.h>
 #include <emu/virtio_pci.h>
@@ -53,6 +54,17 @@ static int virtio_pci_notify(struct virtio_device *dev, u32 vq)
 	return VMM_OK;
 }
 
+static int virtio_pci_notify_config(struct virtio_device *dev)
+{
+	struct virtio_pci_dev *m = dev->tra_data;
+
+	m->config.interrupt_state |= VIRTIO_PCI_INT_CONFIG;
+
+	vmm_devemu_emulate_irq(m->guest, m->irq, 1);
+
+	return VMM_OK;
+}
+
 int virtio_pci_config_read(struct virtio_pci_dev *m,
 			   u32 offset, void *dst,
 			   u32 dst_len)
@@ -61,7 +73,8 @@ int virtio_pci_config_read(struct virtio_pci_dev *m,
 
 	switch (offset) {
 	case VIRTIO_PCI_HOST_FEATURES:
-		*(u32 *)dst = m->dev.emu->get_host_features(&m->dev);
+		/* Legacy interface has only 32 feature bits */
+		*(u32 *)dst = (u32)m->dev.emu->get_host_features(&m->dev);
 		break;
 	case VIRTIO_PCI_QUEUE_PFN:
 		*(u32 *)dst = m->dev.emu->get_pfn_vq(&m->dev,
@@ -88,9 +101,18 @@ int virtio_pci_config_read(struct virtio_pci_dev *m,
 	return rc;
 }
 
+static int virtio_pci_modern_read(struct virtio_pci_dev *m,
+				  u32 offset, u32 *dst, u32 size);
+static int virtio_pci_modern_write(struct virtio_pci_dev *m,
+				   u32 offset, u32 src, u32 size);
+
 static int virtio_pci_read(struct virtio_pci_dev *m,
-			   u32 offset, u32 *dst)
+			   u32 offset, u32 *dst, u32 size)
 {
+	if (m->modern) {
+		return virtio_pci_modern_read(m, offset, dst, size);
+	}
+
 	/* Device specific config write */
 	if (offset >= VIRTIO_PCI_CONFIG) {
 		offset -= VIRTIO_PCI_CONFIG;
@@ -124,6 +146,10 @@ static int virtio_pci_config_write(struct virtio_pci_dev *m,
 		break;
 	case VIRTIO_PCI_QUEUE_NOTIFY:
 		if (val < VIRTIO_PCI_QUEUE_MAX) {
+			vmm_trace(VIRTQ_NOTIFY, (virtual_addr_t)&m->dev, val,
+				  0, 0);
+			vmm_manager_guest_boot_mark(m->dev.guest,
+					VMM_GUEST_BOOT_FIRST_VIRTIO_NOTIFY);
 			m->dev.emu->notify_vq(&m->dev, val);
 		}
 		break;
@@ -142,10 +168,14 @@ static int virtio_pci_config_write(struct virtio_pci_dev *m,
 }
 
 static int virtio_pci_write(struct virtio_pci_dev *m,
-			    u32 offset, u32 src_mask, u32 src)
+			    u32 offset, u32 src_mask, u32 src, u32 size)
 {
 	src = src & ~src_mask;
 
+	if (m->modern) {
+		return virtio_pci_modern_write(m, offset, src, size);
+	}
+
 	/* Device specific config write */
 	if (offset >= VIRTIO_PCI_CONFIG) {
 		offset -= VIRTIO_PCI_CONFIG;
@@ -155,9 +185,245 @@ static int virtio_pci_write(struct virtio_pci_dev *m,
 	return virtio_pci_config_write(m, (u32)offset, &src, 4);
 }
 
+#define VIRTIO_PCI_SET_LO(x, val)	\
+	(x) = ((x) & 0xFFFFFFFF00000000ULL) | (u64)(val)
+#define VIRTIO_PCI_SET_HI(x, val)	\
+	(x) = ((x) & 0xFFFFFFFFULL) | ((u64)(val) << 32)
+
+static u64 virtio_pci_modern_host_features(struct virtio_pci_dev *m)
+{
+	/* Non-legacy queue setup needs support from emulator */
+	if (!m->dev.emu->init_vq_addr) {
+		return 0;
+	}
+
+	return m->dev.emu->get_host_features(&m->dev);
+}
+
+static void virtio_pci_modern_select_queue(struct virtio_pci_dev *m, u32 vq)
+{
+	m->config.queue_sel = vq;
+	m->queue_num = (m->dev.emu && (vq < VIRTIO_PCI_QUEUE_MAX)) ?
+			m->dev.emu->get_size_vq(&m->dev, vq) : 0;
+	m->queue_desc = m->queue_driver = m->queue_device = 0;
+}
+
+static int virtio_pci_modern_common_read(struct virtio_pci_dev *m,
+					 u32 offset, u32 *dst)
+{
+	u32 sel = m->config.queue_sel;
+
+	switch (offset) {
+	case VIRTIO_PCI_COMMON_DFSELECT:
+		*dst = m->host_features_sel;
+		break;
+	case VIRTIO_PCI_COMMON_DF:
+		*dst = (m->host_features_sel < 2) ?
+			(u32)(virtio_pci_modern_host_features(m) >>
+			      (32 * m->host_features_sel)) : 0;
+		break;
+	case VIRTIO_PCI_COMMON_GFSELECT:
+		*dst = m->guest_features_sel;
+		break;
+	case VIRTIO_PCI_COMMON_GF:
+		*dst = (m->guest_features_sel < 2) ?
+			(u32)(m->guest_features >>
+			      (32 * m->guest_features_sel)) : 0;
+		break;
+	case VIRTIO_PCI_COMMON_MSIX:
+	case VIRTIO_PCI_COMMON_Q_MSIX:
+		/* No MSI-X so vector assignment never sticks */
+		*dst = VIRTIO_PCI_NO_VECTOR;
+		break;
+	case VIRTIO_PCI_COMMON_NUMQ:
+		*dst = VIRTIO_PCI_QUEUE_MAX;
+		break;
+	case VIRTIO_PCI_COMMON_STATUS:
+		*dst = m->config.status;
+		break;
+	case VIRTIO_PCI_COMMON_CFGGENERATION:
+		*dst = 0;
+		break;
+	case VIRTIO_PCI_COMMON_Q_SELECT:
+		*dst = sel;
+		break;
+	case VIRTIO_PCI_COMMON_Q_SIZE:
+		*dst = m->queue_num;
+		break;
+	case VIRTIO_PCI_COMMON_Q_ENABLE:
+		*dst = (sel < VIRTIO_PCI_QUEUE_MAX) ?
+			(u32)((m->queue_ready >> sel) & 0x1) : 0;
+		break;
+	case VIRTIO_PCI_COMMON_Q_NOFF:
+		/* Queue N uses Nth doorbell of notify region */
+		*dst = sel;
+		break;
+	case VIRTIO_PCI_COMMON_Q_DESCLO:
+		*dst = (u32)m->queue_desc;
+		break;
+	case VIRTIO_PCI_COMMON_Q_DESCHI:
+		*dst = (u32)(m->queue_desc >> 32);
+		break;
+	case VIRTIO_PCI_COMMON_Q_AVAILLO:
+		*dst = (u32)m->queue_driver;
+		break;
+	case VIRTIO_PCI_COMMON_Q_AVAILHI:
+		*dst = (u32)(m->queue_driver >> 32);
+		break;
+	case VIRTIO_PCI_COMMON_Q_USEDLO:
+		*dst = (u32)m->queue_device;
+		break;
+	case VIRTIO_PCI_COMMON_Q_USEDHI:
+		*dst = (u32)(m->queue_device >> 32);
+		break;
+	default:
+		*dst = 0;
+		break;
+	}
+
+	return VMM_OK;
+}
+
+static int virtio_pci_modern_common_write(struct virtio_pci_dev *m,
+					  u32 offset, u32 val)
+{
+	int rc = VMM_OK;
+	u32 sel = m->config.queue_sel;
+
+	switch (offset) {
+	case VIRTIO_PCI_COMMON_DFSELECT:
+		m->host_features_sel = val;
+		break;
+	case VIRTIO_PCI_COMMON_GFSELECT:
+		m->guest_features_sel = val;
+		break;
+	case VIRTIO_PCI_COMMON_GF:
+		if (m->guest_features_sel == 0) {
+			VIRTIO_PCI_SET_LO(m->guest_features, val);
+		} else if (m->guest_features_sel == 1) {
+			VIRTIO_PCI_SET_HI(m->guest_features, val);
+		} else {
+			break;
+		}
+		m->dev.emu->set_guest_features(&m->dev,
+			m->guest_features & virtio_pci_modern_host_features(m));
+		break;
+	case VIRTIO_PCI_COMMON_STATUS:
+		m->config.status = val;
+		/* Writing zero resets device */
+		if (!val) {
+			m->guest_features = 0;
+			m->queue_ready = 0;
+			virtio_pci_modern_select_queue(m, 0);
+			rc = virtio_reset(&m->dev);
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_SELECT:
+		virtio_pci_modern_select_queue(m, val);
+		break;
+	case VIRTIO_PCI_COMMON_Q_SIZE:
+		m->queue_num = val;
+		break;
+	case VIRTIO_PCI_COMMON_Q_ENABLE:
+		if (sel >= VIRTIO_PCI_QUEUE_MAX) {
+			break;
+		}
+		m->queue_ready &= ~(1ULL << sel);
+		if ((val & 0x1) && m->dev.emu->init_vq_addr &&
+		    !m->dev.emu->init_vq_addr(&m->dev, sel, m->queue_num,
+					      (physical_addr_t)m->queue_desc,
+					      (physical_addr_t)m->queue_driver,
+					      (physical_addr_t)m->queue_device)) {
+			m->queue_ready |= (1ULL << sel);
+		}
+		break;
+	case VIRTIO_PCI_COMMON_Q_DESCLO:
+		VIRTIO_PCI_SET_LO(m->queue_desc, val);
+		break;
+	case VIRTIO_PCI_COMMON_Q_DESCHI:
+		VIRTIO_PCI_SET_HI(m->queue_desc, val);
+		break;
+	case VIRTIO_PCI_COMMON_Q_AVAILLO:
+		VIRTIO_PCI_SET_LO(m->queue_driver, val);
+		break;
+	case VIRTIO_PCI_COMMON_Q_AVAILHI:
+		VIRTIO_PCI_SET_HI(m->queue_driver, val);
+		break;
+	case VIRTIO_PCI_COMMON_Q_USEDLO:
+		VIRTIO_PCI_SET_LO(m->queue_device, val);
+		break;
+	case VIRTIO_PCI_COMMON_Q_USEDHI:
+		VIRTIO_PCI_SET_HI(m->queue_device, val);
+		break;
+	default:
+		break;
+	}
+
+	return rc;
+}
+
+static int virtio_pci_modern_read(struct virtio_pci_dev *m,
+				  u32 offset, u32 *dst, u32 size)
+{
+	if (offset < (VIRTIO_PCI_MODERN_COMMON_OFFSET +
+		      VIRTIO_PCI_COMMON_SIZE)) {
+		return virtio_pci_modern_common_read(m,
+				offset - VIRTIO_PCI_MODERN_COMMON_OFFSET, dst);
+	} else if ((VIRTIO_PCI_MODERN_ISR_OFFSET <= offset) &&
+		   (offset < (VIRTIO_PCI_MODERN_ISR_OFFSET +
+			      VIRTIO_PCI_MODERN_ISR_SIZE))) {
+		/* reading from the ISR also clears it. */
+		*dst = m->config.interrupt_state;
+		m->config.interrupt_state = 0;
+		vmm_devemu_emulate_irq(m->guest, m->irq, 0);
+		return VMM_OK;
+	} else if ((VIRTIO_PCI_MODERN_DEVICE_OFFSET <= offset) &&
+		   (offset < (VIRTIO_PCI_MODERN_DEVICE_OFFSET +
+			      VIRTIO_PCI_MODERN_DEVICE_SIZE))) {
+		return virtio_config_read(&m->dev,
+				offset - VIRTIO_PCI_MODERN_DEVICE_OFFSET,
+				dst, size);
+	}
+
+	*dst = 0;
+
+	return VMM_OK;
+}
+
+static int virtio_pci_modern_write(struct virtio_pci_dev *m,
+				   u32 offset, u32 src, u32 size)
+{
+	u32 vq;
+
+	if (offset < (VIRTIO_PCI_MODERN_COMMON_OFFSET +
+		      VIRTIO_PCI_COMMON_SIZE)) {
+		return virtio_pci_modern_common_write(m,
+				offset - VIRTIO_PCI_MODERN_COMMON_OFFSET, src);
+	} else if ((VIRTIO_PCI_MODERN_NOTIFY_OFFSET <= offset) &&
+		   (offset < (VIRTIO_PCI_MODERN_NOTIFY_OFFSET +
+			      VIRTIO_PCI_MODERN_NOTIFY_SIZE))) {
+		/* Queue is identified by doorbell so value is ignored */
+		vq = (offset - VIRTIO_PCI_MODERN_NOTIFY_OFFSET) /
+					VIRTIO_PCI_MODERN_NOTIFY_MULT;
+		vmm_trace(VIRTQ_NOTIFY, (virtual_addr_t)&m->dev, vq, 0, 0);
+		vmm_manager_guest_boot_mark(m->dev.guest,
+					VMM_GUEST_BOOT_FIRST_VIRTIO_NOTIFY);
+		return m->dev.emu->notify_vq(&m->dev, vq);
+	} else if ((VIRTIO_PCI_MODERN_DEVICE_OFFSET <= offset) &&
+		   (offset < (VIRTIO_PCI_MODERN_DEVICE_OFFSET +
+			      VIRTIO_PCI_MODERN_DEVICE_SIZE))) {
+		return virtio_config_write(&m->dev,
+				offset - VIRTIO_PCI_MODERN_DEVICE_OFFSET,
+				&src, size);
+	}
+
+	return VMM_OK;
+}
+
 static struct virtio_transport pci_tra = {
 	.name = "virtio_pci",
 	.notify = virtio_pci_notify,
+	.notify_config = virtio_pci_notify_config,
 };
 
 static int virtio_pci_emulator_reset(struct pci_device *pdev)
@@ -165,24 +431,146 @@ static int virtio_pci_emulator_reset(struct pci_device *pdev)
 	return VMM_OK;
 }
 
+static u32 virtio_pci_caps_read(struct pci_class *class, u16 reg_offset)
+{
+	u32 ret = 0;
+	struct pci_device *pdev = (struct pci_device *)class;
+	u8 *caps = pdev->priv;
+
+	if (caps && (VIRTIO_PCI_CAP_OFFSET <= reg_offset) &&
+	    ((reg_offset + sizeof(ret)) <=
+	     (VIRTIO_PCI_CAP_OFFSET + VIRTIO_PCI_CAPS_SIZE))) {
+		memcpy(&ret, &caps[reg_offset - VIRTIO_PCI_CAP_OFFSET],
+		       sizeof(ret));
+	}
+
+	return ret;
+}
+
+static int virtio_pci_caps_write(struct pci_class *class,
+				 u16 reg_offset, u32 data)
+{
+	/* Capabilities are read-only */
+	return VMM_OK;
+}
+
+/* Add vendor capability at given position of capability list */
+static u32 virtio_pci_caps_add(u8 *caps, u32 pos, u8 type, u8 bar,
+			       u32 offset, u32 length, u8 len, bool last)
+{
+	u8 *cap = &caps[pos];
+
+	cap[0] = PCI_CONFIG_CAP_ID_VNDR;
+	cap[1] = (last) ? 0 : (VIRTIO_PCI_CAP_OFFSET + pos + len);
+	cap[2] = len;
+	cap[3] = type;
+	cap[4] = bar;
+	memcpy(&cap[8], &offset, sizeof(offset));
+	memcpy(&cap[12], &length, sizeof(length));
+
+	return pos + len;
+}
+
+/* Find virtio BAR of PCI device from its "bars" node */
+static struct vmm_devtree_node *virtio_pci_find_bar(struct pci_device *pdev)
+{
+	struct vmm_devtree_node *bars, *bar, *found = NULL;
+
+	bars = vmm_devtree_getchild(pdev->node, "bars");
+	if (!bars) {
+		return NULL;
+	}
+
+	vmm_devtree_for_each_child(bar, bars) {
+		if (vmm_devtree_is_compatible(bar, "virtio,pci,bar")) {
+			found = bar;
+			break;
+		}
+	}
+
+	vmm_devtree_dref_node(bars);
+
+	return found;
+}
+
 static int virtio_pci_emulator_probe(struct pci_device *pdev,
 				     struct vmm_guest *guest,
 				     const struct vmm_devtree_nodeid *eid)
 {
+	u8 *caps;
+	u32 pos, mult, barnum, type, version = 1;
+	struct vmm_devtree_node *bar;
 	struct pci_class *class = (struct pci_class *)pdev;
 
 	/* Virtio device */
-	class->conf_header.vendor_id = 0x1af4;
+	class->conf_header.vendor_id = VIRTIO_PCI_VENDOR_ID;
 	/* Block Device */
 	class->conf_header.device_id = 0x1001;
 
 	pdev->priv = NULL;
 
+	/* Modern (virtio 1.0) interface is opt-in using virtio_version
+	 * of virtio BAR node and is described by vendor capabilities.
+	 */
+	bar = virtio_pci_find_bar(pdev);
+	if (!bar) {
+		return VMM_OK;
+	}
+	if (vmm_devtree_read_u32(bar, "virtio_version", &version) ||
+	    (version != 2) ||
+	    vmm_devtree_read_u32(bar, "barnum", &barnum) ||
+	    vmm_devtree_read_u32(bar, "virtio_type", &type)) {
+		vmm_devtree_dref_node(bar);
+		return VMM_OK;
+	}
+	vmm_devtree_dref_node(bar);
+
+	caps = vmm_zalloc(VIRTIO_PCI_CAPS_SIZE);
+	if (!caps) {
+		return VMM_ENOMEM;
+	}
+
+	pos = virtio_pci_caps_add(caps, 0, VIRTIO_PCI_CAP_COMMON_CFG, barnum,
+				  VIRTIO_PCI_MODERN_COMMON_OFFSET,
+				  VIRTIO_PCI_COMMON_SIZE,
+				  VIRTIO_PCI_CAP_LEN, FALSE);
+	pos = virtio_pci_caps_add(caps, pos, VIRTIO_PCI_CAP_ISR_CFG, barnum,
+				  VIRTIO_PCI_MODERN_ISR_OFFSET,
+				  VIRTIO_PCI_MODERN_ISR_SIZE,
+				  VIRTIO_PCI_CAP_LEN, FALSE);
+	pos = virtio_pci_caps_add(caps, pos, VIRTIO_PCI_CAP_DEVICE_CFG, barnum,
+				  VIRTIO_PCI_MODERN_DEVICE_OFFSET,
+				  VIRTIO_PCI_MODERN_DEVICE_SIZE,
+				  VIRTIO_PCI_CAP_LEN, FALSE);
+	/* Notify capability also has notify_off_multiplier */
+	mult = VIRTIO_PCI_MODERN_NOTIFY_MULT;
+	memcpy(&caps[pos + VIRTIO_PCI_CAP_LEN], &mult, sizeof(mult));
+	virtio_pci_caps_add(caps, pos, VIRTIO_PCI_CAP_NOTIFY_CFG, barnum,
+			    VIRTIO_PCI_MODERN_NOTIFY_OFFSET,
+			    VIRTIO_PCI_MODERN_NOTIFY_SIZE,
+			    VIRTIO_PCI_NOTIFY_CAP_LEN, TRUE);
+
+	class->conf_header.device_id = VIRTIO_PCI_MODERN_DEVICE_ID_BASE + type;
+	class->conf_header.revision = 1;
+	class->conf_header.subsystem_vendor_id = VIRTIO_PCI_VENDOR_ID;
+	class->conf_header.subsystem_device_id = type;
+	class->conf_header.status |= PCI_CONFIG_STATUS_CAP_LIST;
+	class->conf_header.cap_pointer = VIRTIO_PCI_CAP_OFFSET;
+	class->config_read = virtio_pci_caps_read;
+	class->config_write = virtio_pci_caps_write;
+
+	pdev->priv = caps;
+
 	return VMM_OK;
 }
 
 static int virtio_pci_emulator_remove(struct pci_device *pdev)
 {
+	if (pdev->priv) {
+		vmm_free(pdev->priv);
+		pdev->priv = NULL;
+	}
+
 	return VMM_OK;
 }
 
@@ -193,7 +581,7 @@ static int virtio_pci_bar_read8(struct vmm_emudev *edev,
 	int rc;
 	u32 regval = 0x0;
 
-	rc = virtio_pci_read(edev->priv, offset, &regval);
+	rc = virtio_pci_read(edev->priv, offset, &regval, 1);
 	if (!rc) {
 		*dst = regval & 0xFF;
 	}
@@ -208,7 +596,7 @@ static int virtio_pci_bar_read16(struct vmm_emudev *edev,
 	int rc;
 	u32 regval = 0x0;
 
-	rc = virtio_pci_read(edev->priv, offset, &regval);
+	rc = virtio_pci_read(edev->priv, offset, &regval, 2);
 	if (!rc) {
 		*dst = regval & 0xFFFF;
 	}
@@ -220,28 +608,28 @@ static int virtio_pci_bar_read32(struct vmm_emudev *edev,
 				 physical_addr_t offset,
 				 u32 *dst)
 {
-	return virtio_pci_read(edev->priv, offset, dst);
+	return virtio_pci_read(edev->priv, offset, dst, 4);
 }
 
 static int virtio_pci_bar_write8(struct vmm_emudev *edev,
 				 physical_addr_t offset,
 				 u8 src)
 {
-	return virtio_pci_write(edev->priv, offset, 0xFFFFFF00, src);
+	return virtio_pci_write(edev->priv, offset, 0xFFFFFF00, src, 1);
 }
 
 static int virtio_pci_bar_write16(struct vmm_emudev *edev,
 				  physical_addr_t offset,
 				  u16 src)
 {
-	return virtio_pci_write(edev->priv, offset, 0xFFFF0000, src);
+	return virtio_pci_write(edev->priv, offset, 0xFFFF0000, src, 2);
 }
 
 static int virtio_pci_bar_write32(struct vmm_emudev *edev,
 				  physical_addr_t offset,
 				  u32 src)
 {
-	return virtio_pci_write(edev->priv, offset, 0x00000000, src);
+	return virtio_pci_write(edev->priv, offset, 0x00000000, src, 4);
 }
 
 static int virtio_pci_bar_reset(struct vmm_emudev *edev)
@@ -251,9 +639,28 @@ static int virtio_pci_bar_reset(struct vmm_emudev *edev)
 	m->config.interrupt_state = 0x0;
 	vmm_devemu_emulate_irq(m->guest, m->irq, 0);
 
+	m->config.status = 0;
+	m->host_features_sel = m->guest_features_sel = 0;
+	m->guest_features = 0;
+	m->queue_ready = 0;
+	m->config.queue_sel = 0;
+	m->queue_num = 0;
+	m->queue_desc = m->queue_driver = m->queue_device = 0;
+
 	return virtio_reset(&m->dev);
 }
 
+static int virtio_pci_bar_doorbell(struct vmm_emudev *edev, u32 val)
+{
+	struct virtio_pci_dev *m = edev->priv;
+
+	vmm_trace(VIRTQ_NOTIFY, (virtual_addr_t)&m->dev, val, 0, 0);
+	vmm_manager_guest_boot_mark(m->dev.guest,
+				VMM_GUEST_BOOT_FIRST_VIRTIO_NOTIFY);
+
+	return m->dev.emu->notify_vq(&m->dev, val);
+}
+
 static int virtio_pci_bar_remove(struct vmm_emudev *edev)
 {
 	struct virtio_pci_dev *vdev = edev->priv;
@@ -272,6 +679,7 @@ static int virtio_pci_bar_probe(struct vmm_guest *guest,
 				const struct vmm_devtree_nodeid *eid)
 {
 	int rc = VMM_OK;
+	u32 version;
 	struct virtio_pci_dev *vdev;
 
 	vdev = vmm_zalloc(sizeof(struct virtio_pci_dev));
@@ -304,12 +712,42 @@ static int virtio_pci_bar_probe(struct vmm_guest *guest,
 		goto virtio_pci_probe_freestate_fail;
 	}
 
+	/* Non-legacy (virtio 1.0) interface is opt-in */
+	if (!vmm_devtree_read_u32(edev->node, "virtio_version", &version) &&
+	    (version == 2)) {
+		if (edev->reg->phys_size < VIRTIO_PCI_MODERN_BAR_SIZE) {
+			rc = VMM_EINVALID;
+			goto virtio_pci_probe_freestate_fail;
+		}
+		vdev->modern = TRUE;
+
+		/* Per-queue doorbells are write-only so defer them */
+		rc = vmm_devemu_add_coalesce_range(edev,
+					VIRTIO_PCI_MODERN_NOTIFY_OFFSET,
+					VIRTIO_PCI_MODERN_NOTIFY_SIZE);
+		if (rc) {
+			goto virtio_pci_probe_freestate_fail;
+		}
+	}
+
 	if ((rc = virtio_register_device(&vdev->dev))) {
 		goto virtio_pci_probe_freestate_fail;
 	}
 
 	edev->priv = vdev;
 
+	/* Queue notify can also be done using hypercall doorbell
+	 * which skips register decoding and region lookup.
+	 */
+	if (vdev->modern) {
+		rc = vmm_devemu_set_doorbell(edev, virtio_pci_bar_doorbell);
+		if (rc) {
+			virtio_unregister_device(&vdev->dev);
+			edev->priv = NULL;
+			goto virtio_pci_probe_freestate_fail;
+		}
+	}
+
 	goto virtio_pci_probe_done;
 
 virtio_pci_probe_freestate_fail:
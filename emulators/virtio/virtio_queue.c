@@ -88,12 +88,78 @@ physical_size_t virtio_queue_total_size(struct virtio_queue *vq)
 }
 VMM_EXPORT_SYMBOL(virtio_queue_total_size);
 
+void virtio_queue_set_features(struct virtio_queue *vq, u64 features)
+{
+	if (!vq) {
+		return;
+	}
+
+	vq->features = features & ((1ULL << VIRTIO_RING_F_INDIRECT_DESC) |
+				   (1ULL << VIRTIO_RING_F_EVENT_IDX) |
+				   (1ULL << VIRTIO_F_RING_PACKED));
+}
+VMM_EXPORT_SYMBOL(virtio_queue_set_features);
+
+static inline bool packed_desc_is_avail(struct virtio_queue *vq, u16 idx)
+{
+	u16 flags = vq->pring.desc[idx].flags;
+	bool avail = (flags & (1 << VRING_PACKED_DESC_F_AVAIL)) ? TRUE : FALSE;
+	bool used = (flags & (1 << VRING_PACKED_DESC_F_USED)) ? TRUE : FALSE;
+
+	return (avail == vq->avail_wrap) && (used != vq->avail_wrap);
+}
+
+static inline u16 packed_idx_advance(u16 idx, u16 count, u32 num,
+				     bool *wrap)
+{
+	idx += count;
+	if (idx >= num) {
+		idx -= num;
+		*wrap = !(*wrap);
+	}
+
+	return idx;
+}
+
+static u16 packed_queue_pop(struct virtio_queue *vq)
+{
+	u16 id, idx = vq->last_avail_idx;
+	u32 count = 1;
+	struct vring_packed_desc *desc;
+
+	/* Read descriptors only after seeing them available */
+	arch_rmb();
+
+	/* Chain is made of consecutive descriptors in ring and
+	 * the buffer ID is taken from last descriptor of chain.
+	 */
+	desc = &vq->pring.desc[idx];
+	while ((desc->flags & VRING_DESC_F_NEXT) && (count < vq->pring.num)) {
+		idx = (idx + 1 < vq->pring.num) ? idx + 1 : 0;
+		desc = &vq->pring.desc[idx];
+		count++;
+	}
+	id = umod32(desc->id, vq->pring.num);
+
+	vq->buf_head[id] = vq->last_avail_idx;
+	vq->buf_count[id] = count;
+	vq->last_avail_idx = packed_idx_advance(vq->last_avail_idx, count,
+						vq->pring.num,
+						&vq->avail_wrap);
+
+	return id;
+}
+
 u16 virtio_queue_pop(struct virtio_queue *vq)
 {
 	if (!vq || !vq->addr) {
 		return 0;
 	}
 
+	if (vq->packed) {
+		return packed_queue_pop(vq);
+	}
+
 	return vq->vring.avail->ring[
 			umod32(vq->last_avail_idx++, vq->vring.num)];
 }
@@ -101,7 +167,7 @@ VMM_EXPORT_SYMBOL(virtio_queue_pop);
 
 struct vring_desc *virtio_queue_get_desc(struct virtio_queue *vq, u16 indx)
 {
-	if (!vq || !vq->addr) {
+	if (!vq || !vq->addr || vq->packed) {
 		return NULL;
 	}
 
@@ -111,16 +177,69 @@ VMM_EXPORT_SYMBOL(virtio_queue_get_desc);
 
 bool virtio_queue_available(struct virtio_queue *vq)
 {
-	if (!vq || !vq->addr || !vq->vring.avail) {
+	if (!vq || !vq->addr) {
+		return FALSE;
+	}
+
+	if (vq->packed) {
+		if (vq->features & (1ULL << VIRTIO_RING_F_EVENT_IDX)) {
+			/* Guest notifies only after making this slot avail */
+			vq->pring.device->off_wrap = vq->last_avail_idx |
+				(vq->avail_wrap << VRING_PACKED_EVENT_F_WRAP_CTR);
+			vq->pring.device->flags = VRING_PACKED_EVENT_FLAG_DESC;
+			arch_mb();
+		}
+
+		return packed_desc_is_avail(vq, vq->last_avail_idx);
+	}
+
+	if (!vq->vring.avail) {
 		return FALSE;
 	}
 
-	vring_avail_event(&vq->vring) = vq->last_avail_idx;
+	if (vq->features & (1UL << VIRTIO_RING_F_EVENT_IDX)) {
+		/* Guest notifies only after adding beyond this index */
+		vring_avail_event(&vq->vring) = vq->last_avail_idx;
+
+		/* Publish avail event before reading avail idx */
+		arch_mb();
+	}
 
 	return vq->vring.avail->idx !=  vq->last_avail_idx;
 }
 VMM_EXPORT_SYMBOL(virtio_queue_available);
 
+static bool packed_queue_should_signal(struct virtio_queue *vq)
+{
+	int off;
+	u16 off_wrap, old_idx, new_idx;
+
+	switch (vq->pring.driver->flags) {
+	case VRING_PACKED_EVENT_FLAG_ENABLE:
+		return TRUE;
+	case VRING_PACKED_EVENT_FLAG_DESC:
+		if (vq->features & (1ULL << VIRTIO_RING_F_EVENT_IDX)) {
+			break;
+		}
+		return TRUE;
+	default:
+		return FALSE;
+	};
+
+	/* Event offset is relative to used wrap counter of guest */
+	off_wrap = vq->pring.driver->off_wrap;
+	off = off_wrap & ~(1 << VRING_PACKED_EVENT_F_WRAP_CTR);
+	if (vq->used_wrap != (off_wrap >> VRING_PACKED_EVENT_F_WRAP_CTR)) {
+		off -= vq->pring.num;
+	}
+
+	old_idx = vq->last_used_signalled;
+	new_idx = vq->last_used_idx;
+	vq->last_used_signalled = new_idx;
+
+	return vring_need_event(off, new_idx, old_idx) ? TRUE : FALSE;
+}
+
 bool virtio_queue_should_signal(struct virtio_queue *vq)
 {
 	u16 old_idx, new_idx, event_idx;
@@ -129,6 +248,18 @@ bool virtio_queue_should_signal(struct virtio_queue *vq)
 		return FALSE;
 	}
 
+	/* Order used idx update before reading guest flags or event */
+	arch_mb();
+
+	if (vq->packed) {
+		return packed_queue_should_signal(vq);
+	}
+
+	if (!(vq->features & (1UL << VIRTIO_RING_F_EVENT_IDX))) {
+		return (vq->vring.avail->flags &
+			VRING_AVAIL_F_NO_INTERRUPT) ? FALSE : TRUE;
+	}
+
 	old_idx         = vq->last_used_signalled;
 	new_idx         = vq->vring.used->idx;
 	event_idx       = vring_used_event(&vq->vring);
@@ -145,12 +276,35 @@ VMM_EXPORT_SYMBOL(virtio_queue_should_signal);
 struct vring_used_elem *virtio_queue_set_used_elem(struct virtio_queue *vq,
 						   u32 head, u32 len)
 {
+	u16 flags, idx, count;
 	struct vring_used_elem *used_elem;
 
 	if (!vq || !vq->addr) {
 		return NULL;
 	}
 
+	if (vq->packed) {
+		/* Used descriptor overwrites first slot of oldest chain */
+		head = umod32(head, vq->pring.num);
+		idx = vq->last_used_idx;
+		vq->pring.desc[idx].id = head;
+		vq->pring.desc[idx].len = len;
+
+		/* Publish id and len before flipping descriptor flags */
+		arch_wmb();
+		flags = (vq->used_wrap) ?
+			((1 << VRING_PACKED_DESC_F_AVAIL) |
+			 (1 << VRING_PACKED_DESC_F_USED)) : 0;
+		vq->pring.desc[idx].flags = flags;
+		arch_wmb();
+
+		count = (vq->buf_count[head]) ? vq->buf_count[head] : 1;
+		vq->last_used_idx = packed_idx_advance(idx, count,
+						vq->pring.num, &vq->used_wrap);
+
+		return NULL;
+	}
+
 	used_elem       = &vq->vring.used->ring[
 				umod32(vq->vring.used->idx, vq->vring.num)];
 	used_elem->id   = head;
@@ -190,6 +344,25 @@ int virtio_queue_cleanup(struct virtio_queue *vq)
 	}
 
 	rc = vmm_host_memunmap((virtual_addr_t)vq->addr);
+	if (vq->driver_addr) {
+		vmm_host_memunmap((virtual_addr_t)vq->driver_addr);
+		vq->driver_addr = NULL;
+	}
+	if (vq->device_addr) {
+		vmm_host_memunmap((virtual_addr_t)vq->device_addr);
+		vq->device_addr = NULL;
+	}
+
+	if (vq->buf_head) {
+		vmm_free(vq->buf_head);
+		vq->buf_head = NULL;
+		vq->buf_count = NULL;
+	}
+	vq->packed = FALSE;
+	memset(&vq->pring, 0, sizeof(vq->pring));
+	vq->avail_wrap = TRUE;
+	vq->used_wrap = TRUE;
+	vq->last_used_idx = 0;
 
 	vq->last_avail_idx = 0;
 	vq->last_used_signalled = 0;
@@ -270,61 +443,232 @@ int virtio_queue_setup(struct virtio_queue *vq,
 }
 VMM_EXPORT_SYMBOL(virtio_queue_setup);
 
-/*
- * Each buffer in the virtqueues is actually a chain of descriptors.  This
- * function returns the next descriptor in the chain, or vq->vring.num if we're
- * at the end.
- */
-static unsigned next_desc(struct vring_desc *desc, u32 i, u32 max)
+static void *virtio_queue_map(struct vmm_guest *guest,
+			      physical_addr_t gphys_addr,
+			      physical_size_t gphys_size,
+			      physical_addr_t *hphys_addr)
 {
-	u32 next;
+	u32 reg_flags;
+	physical_size_t avail_size;
 
-	if (!(desc[i].flags & VRING_DESC_F_NEXT)) {
-		return max;
+	if (vmm_guest_physical_map(guest, gphys_addr, gphys_size,
+				   hphys_addr, &avail_size, &reg_flags)) {
+		return NULL;
 	}
 
-	next = desc[i].next;
+	if (!(reg_flags & VMM_REGION_ISRAM) || (avail_size < gphys_size)) {
+		return NULL;
+	}
 
-	return next;
+	return (void *)vmm_host_memmap(*hphys_addr, gphys_size,
+				       VMM_MEMORY_FLAGS_NORMAL);
+}
+
+int virtio_queue_setup_addr(struct virtio_queue *vq,
+			    struct vmm_guest *guest,
+			    u32 desc_count,
+			    physical_addr_t desc_addr,
+			    physical_addr_t driver_addr,
+			    physical_addr_t device_addr)
+{
+	int rc;
+	physical_addr_t hphys_addr, tmp;
+	physical_size_t desc_size, driver_size, device_size;
+
+	if (!vq || !guest || !desc_count) {
+		return VMM_EFAIL;
+	}
+
+	if ((rc = virtio_queue_cleanup(vq))) {
+		return rc;
+	}
+
+	if (vq->features & (1ULL << VIRTIO_F_RING_PACKED)) {
+		desc_size = sizeof(struct vring_packed_desc) * desc_count;
+		driver_size = sizeof(struct vring_packed_desc_event);
+		device_size = sizeof(struct vring_packed_desc_event);
+	} else {
+		desc_size = sizeof(struct vring_desc) * desc_count;
+		driver_size = sizeof(u16) * (3 + desc_count);
+		device_size = sizeof(u16) * 3 +
+			      sizeof(struct vring_used_elem) * desc_count;
+	}
+
+	vq->addr = virtio_queue_map(guest, desc_addr, desc_size, &hphys_addr);
+	vq->driver_addr = virtio_queue_map(guest, driver_addr,
+					   driver_size, &tmp);
+	vq->device_addr = virtio_queue_map(guest, device_addr,
+					   device_size, &tmp);
+	if (!vq->addr || !vq->driver_addr || !vq->device_addr) {
+		rc = VMM_EINVALID;
+		goto fail;
+	}
+
+	if (vq->features & (1ULL << VIRTIO_F_RING_PACKED)) {
+		vq->buf_head = vmm_zalloc(2 * desc_count * sizeof(u16));
+		if (!vq->buf_head) {
+			rc = VMM_ENOMEM;
+			goto fail;
+		}
+		vq->buf_count = vq->buf_head + desc_count;
+
+		vq->packed = TRUE;
+		vq->avail_wrap = TRUE;
+		vq->used_wrap = TRUE;
+		vq->last_used_idx = 0;
+		vq->pring.num = desc_count;
+		vq->pring.desc = vq->addr;
+		vq->pring.driver = vq->driver_addr;
+		vq->pring.device = vq->device_addr;
+	} else {
+		vq->vring.num = desc_count;
+		vq->vring.desc = vq->addr;
+		vq->vring.avail = vq->driver_addr;
+		vq->vring.used = vq->device_addr;
+	}
+
+	vq->guest = guest;
+	vq->desc_count = desc_count;
+	vq->align = 0;
+	vq->guest_pfn = 0;
+	vq->guest_page_size = 0;
+
+	vq->guest_addr = desc_addr;
+	vq->host_addr = hphys_addr;
+	vq->total_size = desc_size;
+
+	return VMM_OK;
+
+fail:
+	if (vq->addr) {
+		vmm_host_memunmap((virtual_addr_t)vq->addr);
+		vq->addr = NULL;
+	}
+	if (vq->driver_addr) {
+		vmm_host_memunmap((virtual_addr_t)vq->driver_addr);
+		vq->driver_addr = NULL;
+	}
+	if (vq->device_addr) {
+		vmm_host_memunmap((virtual_addr_t)vq->device_addr);
+		vq->device_addr = NULL;
+	}
+	return rc;
+}
+VMM_EXPORT_SYMBOL(virtio_queue_setup_addr);
+
+static void packed_queue_get_head_iovec(struct virtio_queue *vq,
+					u16 head, struct virtio_iovec *iov,
+					u32 *ret_iov_cnt, u32 *ret_total_len)
+{
+	u32 i, idx, count;
+	bool indirect = FALSE;
+	physical_addr_t table = 0;
+	struct vring_packed_desc *desc, idesc;
+
+	head = umod32(head, vq->pring.num);
+	idx = vq->buf_head[head];
+	count = vq->buf_count[head];
+	desc = &vq->pring.desc[idx];
+
+	/* Indirect buffer is a single descriptor pointing to
+	 * a table of consecutive descriptors in guest memory.
+	 */
+	if ((vq->features & (1ULL << VIRTIO_RING_F_INDIRECT_DESC)) &&
+	    (desc->flags & VRING_DESC_F_INDIRECT)) {
+		indirect = TRUE;
+		table = desc->addr;
+		count = desc->len / sizeof(struct vring_packed_desc);
+		idx = 0;
+	}
+
+	/* Note: Caller IO vectors have space for desc_count entries */
+	for (i = 0; (i < count) && (i < vq->desc_count); i++) {
+		if (indirect) {
+			if (vmm_guest_memory_read(vq->guest,
+					table + i * sizeof(idesc),
+					&idesc, sizeof(idesc),
+					TRUE) != sizeof(idesc)) {
+				break;
+			}
+			desc = &idesc;
+		} else {
+			desc = &vq->pring.desc[idx];
+			idx = (idx + 1 < vq->pring.num) ? idx + 1 : 0;
+		}
+
+		iov[i].addr = desc->addr;
+		iov[i].len = desc->len;
+
+		*ret_total_len += desc->len;
+
+		if (desc->flags & VRING_DESC_F_WRITE) {
+			iov[i].flags = 1;  /* Write */
+		} else {
+			iov[i].flags = 0; /* Read */
+		}
+	}
+
+	*ret_iov_cnt = i;
 }
 
 u16 virtio_queue_get_head_iovec(struct virtio_queue *vq,
 				u16 head, struct virtio_iovec *iov,
 				u32 *ret_iov_cnt, u32 *ret_total_len)
 {
-	int i;
-	u16 idx, max;
-	struct vring_desc *desc;
+	u32 i, idx, max;
+	bool indirect = FALSE;
+	physical_addr_t table = 0;
+	struct vring_desc *desc, idesc;
+
+	*ret_iov_cnt = 0;
+	*ret_total_len = 0;
 
 	if (!vq || !vq->addr) {
-		*ret_iov_cnt = 0;
-		*ret_total_len = 0;
 		return 0;
 	}
 
-	idx = head;
+	if (vq->packed) {
+		packed_queue_get_head_iovec(vq, head, iov,
+					    ret_iov_cnt, ret_total_len);
+		return head;
+	}
 
-	*ret_iov_cnt = 0;
-	*ret_total_len = 0;
+	idx = head;
 	max = vq->vring.num;
-	desc = vq->vring.desc;
+	desc = &vq->vring.desc[idx];
 
-	if (desc[idx].flags & VRING_DESC_F_INDIRECT) {
-#if 0
-		max = desc[idx].len / sizeof(struct vring_desc);
-		desc = guest_flat_to_host(kvm, desc[idx].addr);
+	/* Indirect descriptor points to a table of descriptors
+	 * in guest memory which is walked instead of vring.
+	 */
+	if ((vq->features & (1UL << VIRTIO_RING_F_INDIRECT_DESC)) &&
+	    (desc->flags & VRING_DESC_F_INDIRECT)) {
+		indirect = TRUE;
+		table = desc->addr;
+		max = desc->len / sizeof(struct vring_desc);
 		idx = 0;
-#endif
 	}
 
+	/* Note: Caller IO vectors have space for desc_count entries */
 	i = 0;
-	do {
-		iov[i].addr = desc[idx].addr;
-		iov[i].len = desc[idx].len;
+	while ((idx < max) && (i < vq->desc_count)) {
+		if (indirect) {
+			if (vmm_guest_memory_read(vq->guest,
+					table + idx * sizeof(idesc),
+					&idesc, sizeof(idesc),
+					TRUE) != sizeof(idesc)) {
+				break;
+			}
+			desc = &idesc;
+		} else {
+			desc = &vq->vring.desc[idx];
+		}
 
-		*ret_total_len += desc[idx].len;
+		iov[i].addr = desc->addr;
+		iov[i].len = desc->len;
 
-		if (desc[idx].flags & VRING_DESC_F_WRITE) {
+		*ret_total_len += desc->len;
+
+		if (desc->flags & VRING_DESC_F_WRITE) {
 			iov[i].flags = 1;  /* Write */
 		} else {
 			iov[i].flags = 0; /* Read */
@@ -332,7 +676,11 @@ u16 virtio_queue_get_head_iovec(struct virtio_queue *vq,
 
 		i++;
 
-	} while ((idx = next_desc(desc, idx, max)) != max);
+		if (!(desc->flags & VRING_DESC_F_NEXT)) {
+			break;
+		}
+		idx = desc->next;
+	}
 
 	*ret_iov_cnt = i;
 
@@ -362,8 +710,8 @@ u32 virtio_iovec_to_buf_read(struct virtio_device *dev,
 		len = ((buf_len - pos) < iov[i].len) ?
 						(buf_len - pos) : iov[i].len;
 
-		len = vmm_guest_memory_read(dev->guest, iov[i].addr,
-					    buf + pos, len, TRUE);
+		len = vmm_guest_mapcache_read(&dev->mcache, iov[i].addr,
+					      buf + pos, len);
 		if (!len) {
 			break;
 		}
@@ -386,8 +734,8 @@ u32 virtio_buf_to_iovec_write(struct virtio_device *dev,
 		len = ((buf_len - pos) < iov[i].len) ?
 					(buf_len - pos) : iov[i].len;
 
-		len = vmm_guest_memory_write(dev->guest, iov[i].addr,
-					     buf + pos, len, TRUE);
+		len = vmm_guest_mapcache_write(&dev->mcache, iov[i].addr,
+					       buf + pos, len);
 		if (!len) {
 			break;
 		}
@@ -410,8 +758,8 @@ void virtio_iovec_fill_zeros(struct virtio_device *dev,
 
 	while (i < iov_cnt) {
 		len = (iov[i].len < 16) ? iov[i].len : 16;
-		len = vmm_guest_memory_write(dev->guest, iov[i].addr + pos,
-					     zeros, len, TRUE);
+		len = vmm_guest_mapcache_write(&dev->mcache,
+					       iov[i].addr + pos, zeros, len);
 		if (!len) {
 			break;
 		}
@@ -275,14 +275,99 @@ int __bitmap_weight(const unsigned long *bitmap, int bits)
 	int k, w = 0, lim = bits/BITS_PER_LONG;
 
 	for (k = 0; k < lim; k++)
-		w += __bitmap_sw_hweight32(bitmap[k]);
+		w += __bitmap_sw_hweight_long(bitmap[k]);
 
 	if (bits % BITS_PER_LONG)
-		w += __bitmap_sw_hweight32(bitmap[k] & BITMAP_LAST_WORD_MASK(bits));
+		w += __bitmap_sw_hweight_long(bitmap[k] &
+					      BITMAP_LAST_WORD_MASK(bits));
 
 	return w;
 }
 
+void __bitmap_set(unsigned long *map, int start, int len)
+{
+	unsigned long *p = map + BIT_WORD(start);
+	const int size = start + len;
+	int bits_to_set = BITS_PER_LONG - (start % BITS_PER_LONG);
+	unsigned long mask_to_set = BITMAP_FIRST_WORD_MASK(start);
+
+	while (len - bits_to_set >= 0) {
+		*p |= mask_to_set;
+		len -= bits_to_set;
+		bits_to_set = BITS_PER_LONG;
+		mask_to_set = ~0UL;
+		p++;
+	}
+	if (len) {
+		mask_to_set &= BITMAP_LAST_WORD_MASK(size);
+		*p |= mask_to_set;
+	}
+}
+
+void __bitmap_clear(unsigned long *map, int start, int len)
+{
+	unsigned long *p = map + BIT_WORD(start);
+	const int size = start + len;
+	int bits_to_clear = BITS_PER_LONG - (start % BITS_PER_LONG);
+	unsigned long mask_to_clear = BITMAP_FIRST_WORD_MASK(start);
+
+	while (len - bits_to_clear >= 0) {
+		*p &= ~mask_to_clear;
+		len -= bits_to_clear;
+		bits_to_clear = BITS_PER_LONG;
+		mask_to_clear = ~0UL;
+		p++;
+	}
+	if (len) {
+		mask_to_clear &= BITMAP_LAST_WORD_MASK(size);
+		*p &= ~mask_to_clear;
+	}
+}
+
+/**
+ * bitmap_find_next_zero_area_off - find a contiguous aligned zero area
+ *	@map: The address to base the search on
+ *	@size: The bitmap size in bits
+ *	@start: The bitnumber to start searching at
+ *	@nr: The number of zeroed bits we're looking for
+ *	@align_mask: Alignment mask for zero area
+ *	@align_offset: Alignment offset for zero area.
+ *
+ * The @align_mask should be one less than a power of 2; the effect is
+ * that the bit offset of all zero areas this function finds plus
+ * @align_offset is multiple of that power of 2. Both the zero and the
+ * set bits are skipped one word at a time.
+ *
+ * Returns a value greater than or equal to @size if no area is found.
+ */
+unsigned long bitmap_find_next_zero_area_off(unsigned long *map,
+					     unsigned long size,
+					     unsigned long start,
+					     unsigned int nr,
+					     unsigned long align_mask,
+					     unsigned long align_offset)
+{
+	unsigned long index, end, i;
+
+	while (1) {
+		index = find_next_zero_bit(map, size, start);
+
+		/* Align allocation */
+		index = ((index + align_offset + align_mask) & ~align_mask) -
+			align_offset;
+
+		end = index + nr;
+		if ((size < end) || (end < index)) {
+			return size;
+		}
+		i = find_next_bit(map, end, index);
+		if (i >= end) {
+			return index;
+		}
+		start = i + 1;
+	}
+}
+
 /*
  * Common code for bitmap_*_region() routines.
  *	bitmap: array of unsigned longs corresponding to the bitmap
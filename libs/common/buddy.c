@@ -26,6 +26,7 @@
 #include <vmm_error.h>
 #include <vmm_stdio.h>
 #include <libs/stringlib.h>
+#include <libs/hash.h>
 #include <libs/buddy.h>
 
 #undef DEBUG
@@ -46,15 +47,22 @@
 struct buddy_area {
 	struct dlist hk_head;
 	struct rb_node hk_rb;
+	struct buddy_area *hash_next;
 	unsigned long map;
 	unsigned long blk_count;
 	unsigned long bin_num;
+#ifdef CONFIG_HEAP_CALLSITE
+	unsigned long tag;
+#endif
 };
 
 #define AREA_SIZE(a)			((a)->blk_count * BLOCK_SIZE((a)->bin_num))
 #define AREA_START(a)			((a)->map)
 #define AREA_END(a)			((a)->map + AREA_SIZE(a))
 
+#define ALLOC_HASH(ba, addr)		\
+	(&(ba)->alloc_hash[hash_ptr((void *)(addr), (ba)->alloc_hash_bits)])
+
 unsigned long buddy_estimate_bin(struct buddy_allocator *ba,
 				 unsigned long size)
 {
@@ -115,6 +123,9 @@ static struct buddy_area *buddy_hk_alloc(struct buddy_allocator *ba,
 		a->map = map;
 		a->blk_count = blk_count;
 		a->bin_num = bin_num;
+#ifdef CONFIG_HEAP_CALLSITE
+		a->tag = 0;
+#endif
 		ba->hk_free_count--;
 	}
 
@@ -156,6 +167,7 @@ static struct buddy_area *__buddy_alloc_find(struct buddy_allocator *ba,
 					     unsigned long *alloc_blk_count)
 {
 	struct rb_node *n;
+	struct buddy_area *a;
 
 	if (!ba) {
 		return NULL;
@@ -163,22 +175,21 @@ static struct buddy_area *__buddy_alloc_find(struct buddy_allocator *ba,
 
 	DPRINTF("%s: ba=%p addr=0x%lx\n", __func__, ba, addr);
 
+	/* Most lookups are for start address of alloced area
+	 * (such as free) which are resolved by alloc hash.
+	 */
+	for (a = *ALLOC_HASH(ba, addr); a; a = a->hash_next) {
+		if (AREA_START(a) == addr) {
+			goto found;
+		}
+	}
+
 	n = ba->alloc.rb_node;
-  	while (n) {
-  		struct buddy_area *a = rb_entry(n, struct buddy_area, hk_rb);
+	while (n) {
+		a = rb_entry(n, struct buddy_area, hk_rb);
 
 		if ((AREA_START(a) <= addr) && (addr < AREA_END(a))) {
-			if (alloc_map) {
-				*alloc_map = a->map;
-			}
-			if (alloc_bin) {
-				*alloc_bin = a->bin_num;
-			}
-			if (alloc_blk_count) {
-				*alloc_blk_count = a->blk_count;
-			}
-
-			return a;
+			goto found;
 		}
 
 		if (addr < AREA_START(a)) {
@@ -191,6 +202,19 @@ static struct buddy_area *__buddy_alloc_find(struct buddy_allocator *ba,
 	}
 
 	return NULL;
+
+found:
+	if (alloc_map) {
+		*alloc_map = a->map;
+	}
+	if (alloc_bin) {
+		*alloc_bin = a->bin_num;
+	}
+	if (alloc_blk_count) {
+		*alloc_blk_count = a->blk_count;
+	}
+
+	return a;
 }
 
 static struct buddy_area *buddy_alloc_find(struct buddy_allocator *ba,
@@ -248,6 +272,14 @@ static void __buddy_alloc_add(struct buddy_allocator *ba,
 
 	rb_link_node(&a->hk_rb, parent, new);
 	rb_insert_color(&a->hk_rb, &ba->alloc);
+
+	a->hash_next = *ALLOC_HASH(ba, AREA_START(a));
+	*ALLOC_HASH(ba, AREA_START(a)) = a;
+
+	ba->alloc_size += AREA_SIZE(a);
+	if (ba->alloc_peak < ba->alloc_size) {
+		ba->alloc_peak = ba->alloc_size;
+	}
 }
 
 static void buddy_alloc_add(struct buddy_allocator *ba,
@@ -271,6 +303,8 @@ static void buddy_alloc_add(struct buddy_allocator *ba,
 static void __buddy_alloc_del(struct buddy_allocator *ba,
 			      struct buddy_area *a)
 {
+	struct buddy_area **p;
+
 	if (!ba || !a) {
 		return;
 	}
@@ -279,6 +313,16 @@ static void __buddy_alloc_del(struct buddy_allocator *ba,
 		__func__, ba, a->map, a->bin_num, a->blk_count);
 
 	rb_erase(&a->hk_rb, &ba->alloc);
+
+	for (p = ALLOC_HASH(ba, AREA_START(a)); *p; p = &(*p)->hash_next) {
+		if (*p == a) {
+			*p = a->hash_next;
+			break;
+		}
+	}
+	a->hash_next = NULL;
+
+	ba->alloc_size -= AREA_SIZE(a);
 }
 
 /* NOTE: Don't call this function directly */
@@ -667,9 +711,66 @@ unsigned long buddy_bins_free_space(struct buddy_allocator *ba)
 	return ret;
 }
 
+unsigned long buddy_bins_max_area_size(struct buddy_allocator *ba)
+{
+	irq_flags_t f;
+	unsigned long bin, ret;
+	struct buddy_area *a;
+
+	/* Sanity checks */
+	if (!ba) {
+		return 0;
+	}
+
+	/* Find largest area */
+	ret = 0;
+	for (bin = ba->min_bin; bin <= ba->max_bin; bin++) {
+		vmm_spin_lock_irqsave_lite(&ba->bins_lock[bin], f);
+		list_for_each_entry(a, &ba->bins[bin], hk_head) {
+			if (ret < AREA_SIZE(a)) {
+				ret = AREA_SIZE(a);
+			}
+		}
+		vmm_spin_unlock_irqrestore_lite(&ba->bins_lock[bin], f);
+	}
+
+	return ret;
+}
+
+unsigned long buddy_mem_alloc_size(struct buddy_allocator *ba)
+{
+	return (ba) ? ba->alloc_size : 0;
+}
+
+unsigned long buddy_mem_alloc_peak(struct buddy_allocator *ba)
+{
+	return (ba) ? ba->alloc_peak : 0;
+}
+
+void buddy_mem_alloc_peak_reset(struct buddy_allocator *ba)
+{
+	irq_flags_t f;
+
+	if (!ba) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&ba->alloc_lock, f);
+	ba->alloc_peak = ba->alloc_size;
+	vmm_spin_unlock_irqrestore_lite(&ba->alloc_lock, f);
+}
+
 int buddy_mem_alloc(struct buddy_allocator *ba,
 		    unsigned long size,
 		    unsigned long *addr)
+{
+	return buddy_mem_alloc_tagged(ba, size, 0, addr);
+}
+
+int buddy_mem_alloc_tagged(struct buddy_allocator *ba,
+			   unsigned long size,
+			   unsigned long tag,
+			   unsigned long *addr)
 {
 	struct buddy_area *a, *t;
 	unsigned long bin_num, blk_count;
@@ -715,6 +816,10 @@ int buddy_mem_alloc(struct buddy_allocator *ba,
 	}
 
 skip:
+#ifdef CONFIG_HEAP_CALLSITE
+	a->tag = tag;
+#endif
+
 	/* Add buddy area to alloc tree */
 	buddy_alloc_add(ba, a);
 
@@ -808,6 +913,10 @@ int buddy_mem_aligned_alloc(struct buddy_allocator *ba,
 	}
 
 skip:
+#ifdef CONFIG_HEAP_CALLSITE
+	a->tag = 0;
+#endif
+
 	/* Add buddy area to alloc tree */
 	buddy_alloc_add(ba, a);
 	
@@ -879,6 +988,10 @@ int buddy_mem_reserve(struct buddy_allocator *ba,
 	}
 
 skip:
+#ifdef CONFIG_HEAP_CALLSITE
+	a->tag = 0;
+#endif
+
 	/* Add buddy area to alloc tree */
 	buddy_alloc_add(ba, a);
 
@@ -922,6 +1035,40 @@ int buddy_mem_find(struct buddy_allocator *ba,
 	return VMM_OK;
 }
 
+int buddy_mem_iterate(struct buddy_allocator *ba,
+		      int (*iter)(unsigned long addr, unsigned long size,
+				  unsigned long tag, void *priv),
+		      void *priv)
+{
+	int rc = VMM_OK;
+	irq_flags_t f;
+	struct rb_node *n;
+	struct buddy_area *a;
+
+	/* Sanity checks */
+	if (!ba || !iter) {
+		return VMM_EINVALID;
+	}
+
+	vmm_spin_lock_irqsave_lite(&ba->alloc_lock, f);
+
+	for (n = rb_first(&ba->alloc); n; n = rb_next(n)) {
+		a = rb_entry(n, struct buddy_area, hk_rb);
+#ifdef CONFIG_HEAP_CALLSITE
+		rc = iter(AREA_START(a), AREA_SIZE(a), a->tag, priv);
+#else
+		rc = iter(AREA_START(a), AREA_SIZE(a), 0, priv);
+#endif
+		if (rc) {
+			break;
+		}
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&ba->alloc_lock, f);
+
+	return rc;
+}
+
 int buddy_mem_free(struct buddy_allocator *ba, unsigned long addr)
 {
 	irq_flags_t f;
@@ -1065,6 +1212,23 @@ int buddy_allocator_init(struct buddy_allocator *ba,
 		return VMM_EINVALID;
 	}
 
+	/* Carve alloc hash (about one bucket per four buddy areas)
+	 * from start of house-keeping area.
+	 */
+	count = hk_area_size / sizeof(struct buddy_area);
+	ba->alloc_hash_bits = 1;
+	while ((0x1UL << (ba->alloc_hash_bits + 2)) < count) {
+		ba->alloc_hash_bits++;
+	}
+	count = (0x1UL << ba->alloc_hash_bits) * sizeof(struct buddy_area *);
+	if (hk_area_size < (count + sizeof(struct buddy_area))) {
+		return VMM_EINVALID;
+	}
+	ba->alloc_hash = hk_area;
+	memset(ba->alloc_hash, 0, count);
+	hk_area += count;
+	hk_area_size -= count;
+
 	/* Initialize house-keeping */
 	ba->hk_area = hk_area;
 	ba->hk_area_size = hk_area_size;
@@ -1077,6 +1241,7 @@ int buddy_allocator_init(struct buddy_allocator *ba,
 		memset(a, 0, sizeof(struct buddy_area));
 		INIT_LIST_HEAD(&a->hk_head);
 		RB_CLEAR_NODE(&a->hk_rb);
+		a->hash_next = NULL;
 		list_add_tail(&a->hk_head, &ba->hk_free_list);
 	}
 	DPRINTF("%s: ba=%p hk_total_count=%lu\n",
@@ -1091,6 +1256,8 @@ int buddy_allocator_init(struct buddy_allocator *ba,
 	/* Setup empty alloc tree */
 	INIT_SPIN_LOCK(&ba->alloc_lock);
 	ba->alloc = RB_ROOT;
+	ba->alloc_size = 0;
+	ba->alloc_peak = 0;
 
 	/* Setup empty bins and alloc trees */
 	for (i = 0; i < BUDDY_MAX_SUPPORTED_BIN; i++) {
@@ -203,6 +203,83 @@ bool fifo_dequeue(struct fifo *f, void *dst)
 	return ret;
 }
 
+/* Copy elements in at most two chunks because of FIFO wrap-around */
+u32 fifo_enqueue_multi(struct fifo *f, void *src, u32 count)
+{
+	u32 ret, chunk;
+	irq_flags_t flags;
+
+	if (!f || !src) {
+		return 0;
+	}
+
+	vmm_spin_lock_irqsave_lite(&f->lock, flags);
+
+	ret = f->element_count - f->avail_count;
+	if (count < ret) {
+		ret = count;
+	}
+
+	count = ret;
+	while (count) {
+		chunk = f->element_count - f->write_pos;
+		if (count < chunk) {
+			chunk = count;
+		}
+		memcpy(f->elements + (f->write_pos * f->element_size),
+			src, chunk * f->element_size);
+		src += chunk * f->element_size;
+		f->write_pos += chunk;
+		if (f->element_count <= f->write_pos) {
+			f->write_pos = 0;
+		}
+		count -= chunk;
+	}
+	f->avail_count += ret;
+
+	vmm_spin_unlock_irqrestore_lite(&f->lock, flags);
+
+	return ret;
+}
+
+u32 fifo_dequeue_multi(struct fifo *f, void *dst, u32 count)
+{
+	u32 ret, chunk;
+	irq_flags_t flags;
+
+	if (!f || !dst) {
+		return 0;
+	}
+
+	vmm_spin_lock_irqsave_lite(&f->lock, flags);
+
+	ret = f->avail_count;
+	if (count < ret) {
+		ret = count;
+	}
+
+	count = ret;
+	while (count) {
+		chunk = f->element_count - f->read_pos;
+		if (count < chunk) {
+			chunk = count;
+		}
+		memcpy(dst, f->elements + (f->read_pos * f->element_size),
+			chunk * f->element_size);
+		dst += chunk * f->element_size;
+		f->read_pos += chunk;
+		if (f->element_count <= f->read_pos) {
+			f->read_pos = 0;
+		}
+		count -= chunk;
+	}
+	f->avail_count -= ret;
+
+	vmm_spin_unlock_irqrestore_lite(&f->lock, flags);
+
+	return ret;
+}
+
 bool fifo_clear(struct fifo *f)
 {
 	irq_flags_t flags;
@@ -0,0 +1,408 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file lz4.c
+ * @author agent (agent@local)
+ * @brief Streaming LZ4 decompression
+ *
+ * Implements LZ4 block and frame format decoding as documented in
+ * lz4_Block_format.md and lz4_Frame_format.md of LZ4 project.
+ * Block checksums and header checksum are verified whereas content
+ * checksum is skipped (it needs one more pass over output).
+ */
+
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <libs/stringlib.h>
+#include <libs/hash.h>
+#include <libs/lz4.h>
+
+#define LZ4_FLG_VERSION_MASK		0xC0
+#define LZ4_FLG_VERSION			0x40
+#define LZ4_FLG_B_INDEP			0x20
+#define LZ4_FLG_B_CSUM			0x10
+#define LZ4_FLG_C_SIZE			0x08
+#define LZ4_FLG_C_CSUM			0x04
+#define LZ4_FLG_DICT_ID			0x01
+
+#define LZ4_BD_MAX_SHIFT		4
+#define LZ4_BD_MAX_MASK			0x7
+
+#define LZ4_BLOCK_RAW			0x80000000
+#define LZ4_MIN_MATCH			4
+
+enum lz4_stream_states {
+	LZ4_S_MAGIC = 0,
+	LZ4_S_HEADER,
+	LZ4_S_SKIP_SIZE,
+	LZ4_S_SKIP,
+	LZ4_S_BLOCK_SIZE,
+	LZ4_S_BLOCK,
+	LZ4_S_BLOCK_CSUM,
+	LZ4_S_CONTENT_CSUM,
+};
+
+static inline u32 lz4_rd32(const u8 *p)
+{
+	return (u32)p[0] | ((u32)p[1] << 8) |
+	       ((u32)p[2] << 16) | ((u32)p[3] << 24);
+}
+
+int lz4_decompress_block(const u8 *src, size_t src_len,
+			 u8 *dst, size_t dst_cap, size_t prefix_len)
+{
+	u8 token, b;
+	size_t lit, mlen, off;
+	const u8 *ip = src;
+	const u8 *iend = src + src_len;
+	const u8 *match;
+	u8 *op = dst;
+	u8 *oend = dst + dst_cap;
+
+	while (ip < iend) {
+		token = *ip++;
+
+		/* Literals */
+		lit = token >> 4;
+		if (lit == 15) {
+			do {
+				if (ip >= iend) {
+					return VMM_EINVALID;
+				}
+				b = *ip++;
+				lit += b;
+			} while (b == 255);
+		}
+		if (((size_t)(iend - ip) < lit) ||
+		    ((size_t)(oend - op) < lit)) {
+			return VMM_EINVALID;
+		}
+		memcpy(op, ip, lit);
+		op += lit;
+		ip += lit;
+
+		/* Last sequence has only literals */
+		if (ip >= iend) {
+			break;
+		}
+
+		/* Match */
+		if ((iend - ip) < 2) {
+			return VMM_EINVALID;
+		}
+		off = (size_t)ip[0] | ((size_t)ip[1] << 8);
+		ip += 2;
+		if (!off || ((size_t)(op - dst) + prefix_len) < off) {
+			return VMM_EINVALID;
+		}
+		mlen = token & 0xF;
+		if (mlen == 15) {
+			do {
+				if (ip >= iend) {
+					return VMM_EINVALID;
+				}
+				b = *ip++;
+				mlen += b;
+			} while (b == 255);
+		}
+		mlen += LZ4_MIN_MATCH;
+		if ((size_t)(oend - op) < mlen) {
+			return VMM_EINVALID;
+		}
+		match = op - off;
+		if (mlen <= off) {
+			memcpy(op, match, mlen);
+			op += mlen;
+		} else {
+			/* Overlapping match repeats last off bytes */
+			while (mlen--) {
+				*op++ = *match++;
+			}
+		}
+	}
+
+	return (int)(op - dst);
+}
+
+bool lz4_is_frame(const void *data, size_t len)
+{
+	return (len >= 4) && (lz4_rd32(data) == LZ4_FRAME_MAGIC);
+}
+
+void lz4_stream_init(struct lz4_stream *s,
+		     int (*write)(void *priv, const u8 *buf, size_t len),
+		     void *priv)
+{
+	memset(s, 0, sizeof(*s));
+	s->write = write;
+	s->priv = priv;
+	s->state = LZ4_S_MAGIC;
+	s->need = 4;
+}
+
+static void lz4_stream_expect(struct lz4_stream *s, u32 state, u32 need)
+{
+	s->state = state;
+	s->need = need;
+	s->hdr_len = 0;
+}
+
+static int lz4_stream_alloc(struct lz4_stream *s)
+{
+	if (s->block_max <= s->buf_max) {
+		return VMM_OK;
+	}
+
+	if (s->in_buf) {
+		vmm_free(s->in_buf);
+	}
+	if (s->out_buf) {
+		vmm_free(s->out_buf);
+	}
+	s->buf_max = 0;
+
+	s->in_buf = vmm_malloc(s->block_max);
+	s->out_buf = vmm_malloc(LZ4_HISTORY_SIZE + s->block_max);
+	if (!s->in_buf || !s->out_buf) {
+		return VMM_ENOMEM;
+	}
+	s->buf_max = s->block_max;
+
+	return VMM_OK;
+}
+
+/* Process small field collected in header buffer */
+static int lz4_stream_field(struct lz4_stream *s)
+{
+	u32 val, full;
+	u8 *h = s->hdr;
+
+	switch (s->state) {
+	case LZ4_S_MAGIC:
+		val = lz4_rd32(h);
+		if (val == LZ4_FRAME_MAGIC) {
+			/* Keep magic and collect FLG, BD and HC */
+			s->state = LZ4_S_HEADER;
+			s->need = 7;
+		} else if ((val & LZ4_SKIPPABLE_MASK) == LZ4_SKIPPABLE_MAGIC) {
+			s->state = LZ4_S_SKIP_SIZE;
+			s->need = 8;
+		} else {
+			return VMM_EINVALID;
+		}
+		break;
+	case LZ4_S_HEADER:
+		if ((h[4] & LZ4_FLG_VERSION_MASK) != LZ4_FLG_VERSION) {
+			return VMM_EINVALID;
+		}
+		full = 7;
+		full += (h[4] & LZ4_FLG_C_SIZE) ? 8 : 0;
+		full += (h[4] & LZ4_FLG_DICT_ID) ? 4 : 0;
+		if (s->need < full) {
+			s->need = full;
+			break;
+		}
+		if (h[4] & LZ4_FLG_DICT_ID) {
+			return VMM_ENOTSUPP;
+		}
+		if (((hash32(&h[4], full - 5, 0) >> 8) & 0xFF) != h[full - 1]) {
+			return VMM_EINVALID;
+		}
+		val = (h[5] >> LZ4_BD_MAX_SHIFT) & LZ4_BD_MAX_MASK;
+		if (val < 4) {
+			return VMM_EINVALID;
+		}
+		s->flg = h[4];
+		s->block_max = 1U << (2 * val + 8);
+		s->out_hist = 0;
+		if (lz4_stream_alloc(s)) {
+			return VMM_ENOMEM;
+		}
+		lz4_stream_expect(s, LZ4_S_BLOCK_SIZE, 4);
+		break;
+	case LZ4_S_SKIP_SIZE:
+		val = lz4_rd32(&h[4]);
+		if (val) {
+			lz4_stream_expect(s, LZ4_S_SKIP, val);
+		} else {
+			lz4_stream_expect(s, LZ4_S_MAGIC, 4);
+		}
+		break;
+	case LZ4_S_BLOCK_SIZE:
+		val = lz4_rd32(h);
+		if (!val) {
+			/* End mark */
+			if (s->flg & LZ4_FLG_C_CSUM) {
+				lz4_stream_expect(s, LZ4_S_CONTENT_CSUM, 4);
+			} else {
+				lz4_stream_expect(s, LZ4_S_MAGIC, 4);
+			}
+			break;
+		}
+		s->block_raw = (val & LZ4_BLOCK_RAW) ? TRUE : FALSE;
+		s->block_size = val & ~LZ4_BLOCK_RAW;
+		if (s->block_max < s->block_size) {
+			return VMM_EINVALID;
+		}
+		s->in_len = 0;
+		lz4_stream_expect(s, LZ4_S_BLOCK, s->block_size);
+		break;
+	case LZ4_S_BLOCK_CSUM:
+		if (lz4_rd32(h) != s->block_hash) {
+			return VMM_EINVALID;
+		}
+		lz4_stream_expect(s, LZ4_S_BLOCK_SIZE, 4);
+		break;
+	case LZ4_S_CONTENT_CSUM:
+		lz4_stream_expect(s, LZ4_S_MAGIC, 4);
+		break;
+	default:
+		return VMM_EFAIL;
+	};
+
+	return VMM_OK;
+}
+
+/* Decompress complete block and pass it to write callback */
+static int lz4_stream_block(struct lz4_stream *s, const u8 *src)
+{
+	int rc;
+	u32 n, hist;
+	u8 *dst = s->out_buf + s->out_hist;
+
+	if (s->flg & LZ4_FLG_B_CSUM) {
+		s->block_hash = hash32(src, s->block_size, 0);
+	}
+
+	if (s->block_raw) {
+		memcpy(dst, src, s->block_size);
+		n = s->block_size;
+	} else {
+		rc = lz4_decompress_block(src, s->block_size,
+					  dst, s->block_max, s->out_hist);
+		if (rc < 0) {
+			return rc;
+		}
+		n = rc;
+	}
+
+	rc = s->write(s->priv, dst, n);
+	if (rc) {
+		return rc;
+	}
+	s->total_out += n;
+
+	/* Linked blocks may refer upto 64KB of previous output */
+	if (!(s->flg & LZ4_FLG_B_INDEP)) {
+		hist = s->out_hist + n;
+		if (LZ4_HISTORY_SIZE < hist) {
+			memmove(s->out_buf,
+				s->out_buf + hist - LZ4_HISTORY_SIZE,
+				LZ4_HISTORY_SIZE);
+			hist = LZ4_HISTORY_SIZE;
+		}
+		s->out_hist = hist;
+	}
+
+	s->in_len = 0;
+	if (s->flg & LZ4_FLG_B_CSUM) {
+		lz4_stream_expect(s, LZ4_S_BLOCK_CSUM, 4);
+	} else {
+		lz4_stream_expect(s, LZ4_S_BLOCK_SIZE, 4);
+	}
+
+	return VMM_OK;
+}
+
+int lz4_stream_decompress(struct lz4_stream *s, const void *data, size_t len)
+{
+	int rc;
+	u32 n;
+	const u8 *p = data;
+
+	while (len) {
+		switch (s->state) {
+		case LZ4_S_SKIP:
+			n = (len < s->need) ? len : s->need;
+			s->need -= n;
+			p += n;
+			len -= n;
+			if (!s->need) {
+				lz4_stream_expect(s, LZ4_S_MAGIC, 4);
+			}
+			break;
+		case LZ4_S_BLOCK:
+			/* Whole block in caller buffer needs no copy */
+			if (!s->in_len && (s->block_size <= len)) {
+				n = s->block_size;
+				rc = lz4_stream_block(s, p);
+			} else {
+				n = s->block_size - s->in_len;
+				n = (len < n) ? len : n;
+				memcpy(s->in_buf + s->in_len, p, n);
+				s->in_len += n;
+				rc = (s->in_len < s->block_size) ?
+				     VMM_OK : lz4_stream_block(s, s->in_buf);
+			}
+			if (rc) {
+				return rc;
+			}
+			p += n;
+			len -= n;
+			break;
+		default:
+			n = s->need - s->hdr_len;
+			n = (len < n) ? len : n;
+			memcpy(&s->hdr[s->hdr_len], p, n);
+			s->hdr_len += n;
+			p += n;
+			len -= n;
+			if (s->hdr_len < s->need) {
+				break;
+			}
+			rc = lz4_stream_field(s);
+			if (rc) {
+				return rc;
+			}
+			break;
+		};
+	}
+
+	return VMM_OK;
+}
+
+int lz4_stream_end(struct lz4_stream *s)
+{
+	int rc = VMM_OK;
+
+	if ((s->state != LZ4_S_MAGIC) || s->hdr_len) {
+		rc = VMM_EINVALID;
+	}
+
+	if (s->in_buf) {
+		vmm_free(s->in_buf);
+		s->in_buf = NULL;
+	}
+	if (s->out_buf) {
+		vmm_free(s->out_buf);
+		s->out_buf = NULL;
+	}
+	s->buf_max = 0;
+
+	return rc;
+}
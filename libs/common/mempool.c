@@ -23,7 +23,9 @@
 
 #include <vmm_error.h>
 #include <vmm_heap.h>
+#include <vmm_smp.h>
 #include <vmm_host_aspace.h>
+#include <arch_cpu_irq.h>
 #include <libs/mathlib.h>
 #include <libs/stringlib.h>
 #include <libs/mempool.h>
@@ -50,15 +52,15 @@ struct mempool *mempool_raw_create(u32 entity_size,
 	mp->entity_size = entity_size;
 	mp->entity_count = udiv64(size, entity_size);
 
-	mp->f = fifo_alloc(sizeof(virtual_addr_t), mp->entity_count);
-	if (!mp->f) {
+	mp->r = ring_alloc(mp->entity_count, 0);
+	if (!mp->r) {
 		vmm_free(mp);
 		return NULL;
 	}
 
 	mp->entity_base = vmm_host_memmap(phys, size, mem_flags);
 	if (!mp->entity_base) {
-		fifo_free(mp->f);
+		ring_free(mp->r);
 		vmm_free(mp);
 		return NULL;
 	}
@@ -68,7 +70,7 @@ struct mempool *mempool_raw_create(u32 entity_size,
 
 	for (e = 0; e < mp->entity_count; e++) {
 		va = mp->entity_base + e * entity_size;
-		fifo_enqueue(mp->f, &va, FALSE);
+		ring_enqueue(mp->r, (void *)va);
 	}
 
 	return mp;
@@ -97,15 +99,15 @@ struct mempool *mempool_ram_create(u32 entity_size,
 	mp->entity_count =
 		udiv64((VMM_PAGE_SIZE * page_count), entity_size);
 
-	mp->f = fifo_alloc(sizeof(virtual_addr_t), mp->entity_count);
-	if (!mp->f) {
+	mp->r = ring_alloc(mp->entity_count, 0);
+	if (!mp->r) {
 		vmm_free(mp);
 		return NULL;
 	}
 
 	mp->entity_base = vmm_host_alloc_pages(page_count, mem_flags);
 	if (!mp->entity_base) {
-		fifo_free(mp->f);
+		ring_free(mp->r);
 		vmm_free(mp);
 		return NULL;
 	}
@@ -114,7 +116,7 @@ struct mempool *mempool_ram_create(u32 entity_size,
 
 	for (e = 0; e < mp->entity_count; e++) {
 		va = mp->entity_base + e * entity_size;
-		fifo_enqueue(mp->f, &va, FALSE);
+		ring_enqueue(mp->r, (void *)va);
 	}
 
 	return mp;
@@ -140,8 +142,8 @@ struct mempool *mempool_heap_create(u32 entity_size,
 	mp->entity_size = entity_size;
 	mp->entity_count = entity_count;
 
-	mp->f = fifo_alloc(sizeof(virtual_addr_t), mp->entity_count);
-	if (!mp->f) {
+	mp->r = ring_alloc(mp->entity_count, 0);
+	if (!mp->r) {
 		vmm_free(mp);
 		return NULL;
 	}
@@ -149,19 +151,91 @@ struct mempool *mempool_heap_create(u32 entity_size,
 	mp->entity_base =
 		(virtual_addr_t)vmm_malloc(entity_size * entity_count);
 	if (!mp->entity_base) {
-		fifo_free(mp->f);
+		ring_free(mp->r);
 		vmm_free(mp);
 		return NULL;
 	}
 
 	for (e = 0; e < mp->entity_count; e++) {
 		va = mp->entity_base + e * entity_size;
-		fifo_enqueue(mp->f, &va, FALSE);
+		ring_enqueue(mp->r, (void *)va);
 	}
 
 	return mp;
 }
 
+struct mempool *mempool_dma_create(u32 entity_size,
+				   u32 entity_count)
+{
+	u32 e;
+	virtual_addr_t va;
+	struct mempool *mp;
+
+	if (!entity_size || !entity_count) {
+		return NULL;
+	}
+
+	mp = vmm_zalloc(sizeof(struct mempool));
+	if (!mp) {
+		return NULL;
+	}
+
+	mp->type = MEMPOOL_TYPE_DMA;
+	mp->entity_size = entity_size;
+	mp->entity_count = entity_count;
+
+	mp->r = ring_alloc(mp->entity_count, 0);
+	if (!mp->r) {
+		vmm_free(mp);
+		return NULL;
+	}
+
+	mp->entity_base =
+		(virtual_addr_t)vmm_dma_malloc(entity_size * entity_count);
+	if (!mp->entity_base) {
+		ring_free(mp->r);
+		vmm_free(mp);
+		return NULL;
+	}
+
+	for (e = 0; e < mp->entity_count; e++) {
+		va = mp->entity_base + e * entity_size;
+		ring_enqueue(mp->r, (void *)va);
+	}
+
+	return mp;
+}
+
+int mempool_set_cpu_cache(struct mempool *mp, u32 cache_size)
+{
+	u32 c;
+	void **objs;
+
+	if (!mp || (cache_size < 2) || mp->caches) {
+		return VMM_EINVALID;
+	}
+
+	mp->caches = vmm_zalloc(CONFIG_CPU_COUNT * sizeof(*mp->caches));
+	if (!mp->caches) {
+		return VMM_ENOMEM;
+	}
+
+	objs = vmm_zalloc(CONFIG_CPU_COUNT * cache_size * sizeof(void *));
+	if (!objs) {
+		vmm_free(mp->caches);
+		mp->caches = NULL;
+		return VMM_ENOMEM;
+	}
+
+	for (c = 0; c < CONFIG_CPU_COUNT; c++) {
+		mp->caches[c].count = 0;
+		mp->caches[c].objs = &objs[c * cache_size];
+	}
+	mp->cache_size = cache_size;
+
+	return VMM_OK;
+}
+
 int mempool_destroy(struct mempool *mp)
 {
 	int rc = VMM_OK;
@@ -181,11 +255,18 @@ int mempool_destroy(struct mempool *mp)
 	case MEMPOOL_TYPE_HEAP:
 		vmm_free((void *)mp->entity_base);
 		break;
+	case MEMPOOL_TYPE_DMA:
+		vmm_dma_free((void *)mp->entity_base);
+		break;
 	default:
 		return VMM_EINVALID;
 	};
 
-	fifo_free(mp->f);
+	if (mp->caches) {
+		vmm_free(mp->caches[0].objs);
+		vmm_free(mp->caches);
+	}
+	ring_free(mp->r);
 	vmm_free(mp);
 
 	return rc;
@@ -221,22 +302,50 @@ u32 mempool_total_entities(struct mempool *mp)
 
 u32 mempool_free_entities(struct mempool *mp)
 {
-	return (mp) ? fifo_avail(mp->f) : 0;
+	u32 c, ret;
+
+	if (!mp) {
+		return 0;
+	}
+
+	ret = ring_avail(mp->r);
+	if (mp->caches) {
+		for (c = 0; c < CONFIG_CPU_COUNT; c++) {
+			ret += mp->caches[c].count;
+		}
+	}
+
+	return ret;
 }
 
 void *mempool_malloc(struct mempool *mp)
 {
-	virtual_addr_t entity_va;
+	void *entity = NULL;
+	irq_flags_t flags;
+	struct mempool_cpu_cache *c;
 
 	if (!mp) {
 		return NULL;
 	}
 
-	if (fifo_dequeue(mp->f, &entity_va)) {
-		return (void *)entity_va;
+	if (!mp->caches) {
+		return (ring_dequeue(mp->r, &entity)) ? entity : NULL;
 	}
 
-	return NULL;
+	arch_cpu_irq_save(flags);
+
+	c = &mp->caches[vmm_smp_processor_id()];
+	if (!c->count) {
+		c->count = ring_dequeue_burst(mp->r, c->objs,
+					      mp->cache_size / 2);
+	}
+	if (c->count) {
+		entity = c->objs[--c->count];
+	}
+
+	arch_cpu_irq_restore(flags);
+
+	return entity;
 }
 
 void *mempool_zalloc(struct mempool *mp)
@@ -252,7 +361,10 @@ void *mempool_zalloc(struct mempool *mp)
 
 int mempool_free(struct mempool *mp, void *entity)
 {
-	virtual_addr_t entity_va;
+	u32 batch;
+	int rc = VMM_OK;
+	irq_flags_t flags;
+	struct mempool_cpu_cache *c;
 
 	if (!mp) {
 		return VMM_EFAIL;
@@ -262,8 +374,55 @@ int mempool_free(struct mempool *mp, void *entity)
 		return VMM_EINVALID;
 	}
 
-	entity_va = (virtual_addr_t)entity;
-	if (!fifo_enqueue(mp->f, &entity_va, FALSE)) {
+	if (!mp->caches) {
+		return (ring_enqueue(mp->r, entity)) ? VMM_OK : VMM_ENOSPC;
+	}
+
+	arch_cpu_irq_save(flags);
+
+	c = &mp->caches[vmm_smp_processor_id()];
+	if (c->count == mp->cache_size) {
+		batch = mp->cache_size / 2;
+		if (ring_enqueue_bulk(mp->r,
+				&c->objs[c->count - batch], batch)) {
+			c->count -= batch;
+		}
+	}
+	if (c->count < mp->cache_size) {
+		c->objs[c->count++] = entity;
+	} else {
+		rc = VMM_ENOSPC;
+	}
+
+	arch_cpu_irq_restore(flags);
+
+	return rc;
+}
+
+u32 mempool_malloc_bulk(struct mempool *mp, void **entities, u32 count)
+{
+	if (!mp || !entities) {
+		return 0;
+	}
+
+	return ring_dequeue_burst(mp->r, entities, count);
+}
+
+int mempool_free_bulk(struct mempool *mp, void **entities, u32 count)
+{
+	u32 i;
+
+	if (!mp || !entities) {
+		return VMM_EFAIL;
+	}
+
+	for (i = 0; i < count; i++) {
+		if (!mempool_check_ptr(mp, entities[i])) {
+			return VMM_EINVALID;
+		}
+	}
+
+	if (count && !ring_enqueue_bulk(mp->r, entities, count)) {
 		return VMM_ENOSPC;
 	}
 
@@ -34,13 +34,16 @@ libs-objs-y+= common/smoothsort.o
 libs-objs-y+= common/list_sort.o
 libs-objs-y+= common/fifo.o
 libs-objs-y+= common/lifo.o
+libs-objs-y+= common/ring.o
 libs-objs-y+= common/rbtree.o
 libs-objs-y+= common/radix-tree.o
 libs-objs-y+= common/buddy.o
+libs-objs-y+= common/tlsf.o
 libs-objs-y+= common/mempool.o
 libs-objs-y+= common/libfdt.o
 libs-objs-y+= common/bitrev.o
 libs-objs-y+= common/simple_sort.o
+libs-objs-y+= common/hash.o
 
 libs-objs-$(CONFIG_LIBAUTH)+= common/libauth.o
 libs-objs-$(CONFIG_LIBAUTH_DEFAULT_USER)+= common/libauth_passwd.o
@@ -64,5 +67,6 @@ $(build_dir)/libauth_passwd.o: $(build_dir)/libauth_passwd.c
 endif
 
 libs-objs-$(CONFIG_GENALLOC)+= common/genalloc.o
+libs-objs-$(CONFIG_LZ4)+= common/lz4.o
 libs-objs-$(CONFIG_IMAGE_LOADER)+= common/image_loader.o
 
@@ -0,0 +1,253 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file ring.c
+ * @author agent (agent@local)
+ * @brief source file for lock-free ring of pointers.
+ */
+
+#include <arch_atomic.h>
+#include <arch_barrier.h>
+#include <arch_cpu_irq.h>
+#include <vmm_error.h>
+#include <vmm_heap.h>
+#include <libs/log2.h>
+#include <libs/ring.h>
+
+struct ring *ring_alloc(u32 count, u32 flags)
+{
+	struct ring *r;
+
+	if (!count || (count > (1U << 31))) {
+		return NULL;
+	}
+
+	r = vmm_zalloc(sizeof(struct ring));
+	if (!r) {
+		return NULL;
+	}
+
+	r->flags = flags;
+	r->size = roundup_pow_of_two(count);
+	r->mask = r->size - 1;
+	r->capacity = count;
+
+	r->elements = vmm_zalloc(r->size * sizeof(void *));
+	if (!r->elements) {
+		vmm_free(r);
+		return NULL;
+	}
+
+	ARCH_ATOMIC_INIT(&r->prod.head, 0);
+	ARCH_ATOMIC_INIT(&r->prod.tail, 0);
+	ARCH_ATOMIC_INIT(&r->cons.head, 0);
+	ARCH_ATOMIC_INIT(&r->cons.tail, 0);
+
+	return r;
+}
+
+int ring_free(struct ring *r)
+{
+	if (!r) {
+		return VMM_EFAIL;
+	}
+
+	vmm_free(r->elements);
+	vmm_free(r);
+
+	return VMM_OK;
+}
+
+/* Reserve upto count slots (exactly count when fixed is TRUE) by
+ * moving head of prod (enqueue) or cons (dequeue). Returns number
+ * of slots reserved starting at old_head.
+ */
+static u32 __ring_move_head(struct ring *r, bool enqueue, bool single,
+			    u32 count, bool fixed, u32 *old_head)
+{
+	u32 head, other_tail, avail;
+	struct ring_headtail *ht = (enqueue) ? &r->prod : &r->cons;
+	struct ring_headtail *other = (enqueue) ? &r->cons : &r->prod;
+
+	while (1) {
+		head = (u32)arch_atomic_read(&ht->head);
+		arch_smp_rmb();
+		other_tail = (u32)arch_atomic_read(&other->tail);
+
+		avail = (enqueue) ?
+			r->capacity + other_tail - head : other_tail - head;
+		if (avail < count) {
+			count = (fixed) ? 0 : avail;
+		}
+		if (!count) {
+			break;
+		}
+
+		if (single) {
+			arch_atomic_write(&ht->head, head + count);
+			break;
+		}
+		if ((u32)arch_atomic_cmpxchg(&ht->head, head,
+					     head + count) == head) {
+			break;
+		}
+	}
+
+	*old_head = head;
+
+	return count;
+}
+
+/* Publish reserved slots by moving tail in reservation order */
+static void __ring_update_tail(struct ring_headtail *ht, bool enqueue,
+			       bool single, u32 old_head, u32 count)
+{
+	if (enqueue) {
+		arch_smp_wmb();
+	} else {
+		arch_smp_mb();
+	}
+
+	if (!single) {
+		while ((u32)arch_atomic_read(&ht->tail) != old_head) ;
+	}
+
+	arch_atomic_write(&ht->tail, old_head + count);
+}
+
+static u32 __ring_enqueue(struct ring *r, void **src, u32 count, bool fixed)
+{
+	u32 i, head, idx;
+	irq_flags_t flags;
+	bool single = (r->flags & RING_F_SP_ENQ) ? TRUE : FALSE;
+
+	/* Don't get interrupted between reserving and publishing
+	 * slots because other producers wait for us to publish.
+	 */
+	if (!single) {
+		arch_cpu_irq_save(flags);
+	}
+
+	count = __ring_move_head(r, TRUE, single, count, fixed, &head);
+	if (count) {
+		idx = head & r->mask;
+		for (i = 0; i < count; i++) {
+			r->elements[idx] = src[i];
+			idx = (idx + 1) & r->mask;
+		}
+		__ring_update_tail(&r->prod, TRUE, single, head, count);
+	}
+
+	if (!single) {
+		arch_cpu_irq_restore(flags);
+	}
+
+	return count;
+}
+
+static u32 __ring_dequeue(struct ring *r, void **dst, u32 count, bool fixed)
+{
+	u32 i, head, idx;
+	irq_flags_t flags;
+	bool single = (r->flags & RING_F_SC_DEQ) ? TRUE : FALSE;
+
+	/* Don't get interrupted between reserving and releasing
+	 * slots because other consumers wait for us to release.
+	 */
+	if (!single) {
+		arch_cpu_irq_save(flags);
+	}
+
+	count = __ring_move_head(r, FALSE, single, count, fixed, &head);
+	if (count) {
+		/* Order prod.tail read before reading published slots */
+		arch_smp_rmb();
+		idx = head & r->mask;
+		for (i = 0; i < count; i++) {
+			dst[i] = r->elements[idx];
+			idx = (idx + 1) & r->mask;
+		}
+		__ring_update_tail(&r->cons, FALSE, single, head, count);
+	}
+
+	if (!single) {
+		arch_cpu_irq_restore(flags);
+	}
+
+	return count;
+}
+
+u32 ring_enqueue_bulk(struct ring *r, void **src, u32 count)
+{
+	if (!r || !src) {
+		return 0;
+	}
+
+	return __ring_enqueue(r, src, count, TRUE);
+}
+
+u32 ring_enqueue_burst(struct ring *r, void **src, u32 count)
+{
+	if (!r || !src) {
+		return 0;
+	}
+
+	return __ring_enqueue(r, src, count, FALSE);
+}
+
+u32 ring_dequeue_bulk(struct ring *r, void **dst, u32 count)
+{
+	if (!r || !dst) {
+		return 0;
+	}
+
+	return __ring_dequeue(r, dst, count, TRUE);
+}
+
+u32 ring_dequeue_burst(struct ring *r, void **dst, u32 count)
+{
+	if (!r || !dst) {
+		return 0;
+	}
+
+	return __ring_dequeue(r, dst, count, FALSE);
+}
+
+u32 ring_avail(struct ring *r)
+{
+	u32 count;
+
+	if (!r) {
+		return 0;
+	}
+
+	count = (u32)arch_atomic_read(&r->prod.tail) -
+		(u32)arch_atomic_read(&r->cons.tail);
+
+	return (count > r->capacity) ? r->capacity : count;
+}
+
+bool ring_isempty(struct ring *r)
+{
+	return (ring_avail(r)) ? FALSE : TRUE;
+}
+
+bool ring_isfull(struct ring *r)
+{
+	return (r && (ring_avail(r) == r->capacity)) ? TRUE : FALSE;
+}
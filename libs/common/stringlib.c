@@ -33,6 +33,17 @@
 
 #include <stdarg.h>
 
+/* Word size used by generic memory routines */
+#define MEM_WSIZE		sizeof(unsigned long)
+#define MEM_WMASK		(MEM_WSIZE - 1)
+/* Below this size word copy does not pay for alignment handling */
+#define MEM_SMALL_SIZE		(4 * MEM_WSIZE)
+
+/* Check whether pointers can be word aligned together */
+#define MEM_CO_ALIGNED(p1, p2)	\
+	(!(((unsigned long)(p1) ^ (unsigned long)(p2)) & MEM_WMASK))
+#define MEM_ALIGNED(p)		(!((unsigned long)(p) & MEM_WMASK))
+
 size_t strlen(const char *s)
 {
 	size_t ret = 0;
@@ -407,21 +418,23 @@ char *strsep(char **s, const char *ct)
 void *memcpy(void *dest, const void *src, size_t count)
 {
 	u8 *dst8 = (u8 *) dest;
-	u8 *src8 = (u8 *) src;
+	const u8 *src8 = (const u8 *) src;
 
-	if (count & 1) {
-		dst8[0] = src8[0];
-		dst8 += 1;
-		src8 += 1;
+	if ((MEM_SMALL_SIZE <= count) && MEM_CO_ALIGNED(dst8, src8)) {
+		while (!MEM_ALIGNED(dst8)) {
+			*dst8++ = *src8++;
+			count--;
+		}
+		while (MEM_WSIZE <= count) {
+			*(unsigned long *)dst8 = *(const unsigned long *)src8;
+			dst8 += MEM_WSIZE;
+			src8 += MEM_WSIZE;
+			count -= MEM_WSIZE;
+		}
 	}
 
-	count /= 2;
 	while (count--) {
-		dst8[0] = src8[0];
-		dst8[1] = src8[1];
-
-		dst8 += 2;
-		src8 += 2;
+		*dst8++ = *src8++;
 	}
 
 	return dest;
@@ -477,40 +490,51 @@ void *memcpy_fromio(void *dest, const void *src, size_t count)
 void *memmove(void *dest, const void *src, size_t count)
 {
 	u8 *dst8 = (u8 *) dest;
-	const u8 *src8 = (u8 *) src;
+	const u8 *src8 = (const u8 *) src;
+
+	/* Non-overlapping buffers take the (arch optimized) memcpy */
+	if ((src8 + count <= dst8) || (dst8 + count <= src8)) {
+		return memcpy(dest, src, count);
+	}
 
 	if (src8 > dst8) {
-		if (count & 1) {
-			dst8[0] = src8[0];
-			dst8 += 1;
-			src8 += 1;
+		if ((MEM_SMALL_SIZE <= count) &&
+		    MEM_CO_ALIGNED(dst8, src8)) {
+			while (!MEM_ALIGNED(dst8)) {
+				*dst8++ = *src8++;
+				count--;
+			}
+			while (MEM_WSIZE <= count) {
+				*(unsigned long *)dst8 =
+					*(const unsigned long *)src8;
+				dst8 += MEM_WSIZE;
+				src8 += MEM_WSIZE;
+				count -= MEM_WSIZE;
+			}
 		}
-
-		count /= 2;
 		while (count--) {
-			dst8[0] = src8[0];
-			dst8[1] = src8[1];
-
-			dst8 += 2;
-			src8 += 2;
+			*dst8++ = *src8++;
 		}
-	} else {
+	} else if (src8 < dst8) {
 		dst8 += count;
 		src8 += count;
 
-		if (count & 1) {
-			dst8 -= 1;
-			src8 -= 1;
-			dst8[0] = src8[0];
+		if ((MEM_SMALL_SIZE <= count) &&
+		    MEM_CO_ALIGNED(dst8, src8)) {
+			while (!MEM_ALIGNED(dst8)) {
+				*--dst8 = *--src8;
+				count--;
+			}
+			while (MEM_WSIZE <= count) {
+				dst8 -= MEM_WSIZE;
+				src8 -= MEM_WSIZE;
+				*(unsigned long *)dst8 =
+					*(const unsigned long *)src8;
+				count -= MEM_WSIZE;
+			}
 		}
-
-		count /= 2;
 		while (count--) {
-			dst8 -= 2;
-			src8 -= 2;
-
-			dst8[0] = src8[0];
-			dst8[1] = src8[1];
+			*--dst8 = *--src8;
 		}
 	}
 
@@ -522,17 +546,28 @@ void *memset(void *dest, int c, size_t count)
 {
 	u8 *dst8 = (u8 *) dest;
 	u8 ch = (u8) c;
+	unsigned long w;
 
-	if (count & 1) {
-		dst8[0] = ch;
-		dst8 += 1;
+	if (MEM_SMALL_SIZE <= count) {
+		while (!MEM_ALIGNED(dst8)) {
+			*dst8++ = ch;
+			count--;
+		}
+		w = ch;
+		w |= w << 8;
+		w |= w << 16;
+		if (MEM_WSIZE > 4) {
+			w |= (w << 16) << 16;
+		}
+		while (MEM_WSIZE <= count) {
+			*(unsigned long *)dst8 = w;
+			dst8 += MEM_WSIZE;
+			count -= MEM_WSIZE;
+		}
 	}
 
-	count /= 2;
 	while (count--) {
-		dst8[0] = ch;
-		dst8[1] = ch;
-		dst8 += 2;
+		*dst8++ = ch;
 	}
 
 	return dest;
@@ -561,8 +596,35 @@ void *memset_io(void *dest, int c, size_t count)
 
 int memcmp(const void *s1, const void *s2, size_t n)
 {
-	for (; *(char *)s1 == *(char *)s2 && n;  s1++, s2++, n--);
-	return n == 0 ? 0 : *(char *)s1 - *(char *)s2;
+	const u8 *p1 = (const u8 *) s1;
+	const u8 *p2 = (const u8 *) s2;
+
+	/* Skip equal words and let byte loop find the difference */
+	if ((MEM_SMALL_SIZE <= n) && MEM_CO_ALIGNED(p1, p2)) {
+		while (!MEM_ALIGNED(p1)) {
+			if (*p1 != *p2) {
+				return *p1 - *p2;
+			}
+			p1++;
+			p2++;
+			n--;
+		}
+		while ((MEM_WSIZE <= n) &&
+		       (*(const unsigned long *)p1 ==
+			*(const unsigned long *)p2)) {
+			p1 += MEM_WSIZE;
+			p2 += MEM_WSIZE;
+			n -= MEM_WSIZE;
+		}
+	}
+
+	for (; n; p1++, p2++, n--) {
+		if (*p1 != *p2) {
+			return *p1 - *p2;
+		}
+	}
+
+	return 0;
 }
 
 void *memchr(const void *s, int c, size_t n)
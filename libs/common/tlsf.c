@@ -0,0 +1,475 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file tlsf.c
+ * @author agent (agent@local)
+ * @brief Two-Level Segregated Fit (TLSF) allocator implementation
+ *
+ * Each block starts with a header having pointer to physically
+ * previous block and size of block (including header) with block
+ * free flag in lowest bit. Free blocks additionally have links of
+ * their segregated free list after the header. Block sizes are
+ * multiple of allocator alignment and block headers are placed so
+ * that memory returned after header is always aligned.
+ */
+
+#include <vmm_error.h>
+#include <vmm_spinlocks.h>
+#include <libs/stringlib.h>
+#include <libs/bitops.h>
+#include <libs/tlsf.h>
+
+#define TLSF_SL_SHIFT			4
+#define TLSF_SL_COUNT			(1UL << TLSF_SL_SHIFT)
+#define TLSF_FL_COUNT			(BITS_PER_LONG - TLSF_SL_SHIFT + 1)
+
+#define BLOCK_FREE			0x1UL
+
+struct tlsf_block {
+	struct tlsf_block *prev_phys;
+	unsigned long size;
+	/* Only valid in free blocks */
+	struct tlsf_block *next_free;
+	struct tlsf_block *prev_free;
+};
+
+#define BLOCK_HDR_SIZE			(2 * sizeof(unsigned long))
+#define BLOCK_SIZE(b)			((b)->size & ~BLOCK_FREE)
+#define BLOCK_ISFREE(b)			((b)->size & BLOCK_FREE)
+#define BLOCK_PTR(b)			((void *)((unsigned long)(b) + \
+						  BLOCK_HDR_SIZE))
+#define BLOCK_FROM_PTR(p)		((struct tlsf_block *)		\
+					 ((unsigned long)(p) - BLOCK_HDR_SIZE))
+#define BLOCK_NEXT(b)			((struct tlsf_block *)		\
+					 ((unsigned long)(b) + BLOCK_SIZE(b)))
+
+struct tlsf {
+	vmm_spinlock_t lock;
+	unsigned long align_order;
+	unsigned long min_block;
+	unsigned long blocks_start;
+	unsigned long blocks_end;
+	unsigned long total_size;
+	unsigned long free_size;
+	unsigned long used_peak;
+	unsigned long fl_bitmap;
+	u32 sl_bitmap[TLSF_FL_COUNT];
+	struct tlsf_block *heads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+};
+
+#define ALIGN_UP(x, a)			(((x) + (a) - 1) & ~((a) - 1))
+
+/* Size class of free block with given size */
+static void tlsf_mapping_insert(struct tlsf *t, unsigned long size,
+				unsigned long *fl, unsigned long *sl)
+{
+	unsigned long u = size >> t->align_order, msb;
+
+	if (u < TLSF_SL_COUNT) {
+		*fl = 0;
+		*sl = u;
+	} else {
+		msb = __fls(u);
+		*fl = msb - TLSF_SL_SHIFT + 1;
+		*sl = (u >> (msb - TLSF_SL_SHIFT)) - TLSF_SL_COUNT;
+	}
+}
+
+/* Smallest size class whose every free block fits given size */
+static void tlsf_mapping_search(struct tlsf *t, unsigned long size,
+				unsigned long *fl, unsigned long *sl)
+{
+	unsigned long u = size >> t->align_order;
+
+	if (TLSF_SL_COUNT <= u) {
+		size += (1UL << (__fls(u) - TLSF_SL_SHIFT + t->align_order)) - 1;
+	}
+
+	tlsf_mapping_insert(t, size, fl, sl);
+}
+
+static void tlsf_insert_free(struct tlsf *t, struct tlsf_block *b)
+{
+	unsigned long fl, sl;
+
+	tlsf_mapping_insert(t, BLOCK_SIZE(b), &fl, &sl);
+
+	b->size |= BLOCK_FREE;
+	b->prev_free = NULL;
+	b->next_free = t->heads[fl][sl];
+	if (b->next_free) {
+		b->next_free->prev_free = b;
+	}
+	t->heads[fl][sl] = b;
+	t->sl_bitmap[fl] |= (1U << sl);
+	t->fl_bitmap |= (1UL << fl);
+	t->free_size += BLOCK_SIZE(b);
+}
+
+static void tlsf_remove_free(struct tlsf *t, struct tlsf_block *b)
+{
+	unsigned long fl, sl;
+
+	tlsf_mapping_insert(t, BLOCK_SIZE(b), &fl, &sl);
+
+	if (b->prev_free) {
+		b->prev_free->next_free = b->next_free;
+	} else {
+		t->heads[fl][sl] = b->next_free;
+		if (!t->heads[fl][sl]) {
+			t->sl_bitmap[fl] &= ~(1U << sl);
+			if (!t->sl_bitmap[fl]) {
+				t->fl_bitmap &= ~(1UL << fl);
+			}
+		}
+	}
+	if (b->next_free) {
+		b->next_free->prev_free = b->prev_free;
+	}
+	b->size &= ~BLOCK_FREE;
+	t->free_size -= BLOCK_SIZE(b);
+}
+
+/* Find and remove free block of atleast given size */
+static struct tlsf_block *tlsf_find_free(struct tlsf *t, unsigned long size)
+{
+	u32 sl_map;
+	unsigned long fl, sl, fl_map;
+	struct tlsf_block *b;
+
+	tlsf_mapping_search(t, size, &fl, &sl);
+	if (TLSF_FL_COUNT <= fl) {
+		return NULL;
+	}
+
+	sl_map = t->sl_bitmap[fl] & (~0U << sl);
+	if (!sl_map) {
+		if (TLSF_FL_COUNT <= (fl + 1)) {
+			return NULL;
+		}
+		fl_map = t->fl_bitmap & (~0UL << (fl + 1));
+		if (!fl_map) {
+			return NULL;
+		}
+		fl = __ffs(fl_map);
+		sl_map = t->sl_bitmap[fl];
+	}
+	sl = __ffs(sl_map);
+
+	b = t->heads[fl][sl];
+	tlsf_remove_free(t, b);
+
+	return b;
+}
+
+/* Split used block to given size and free the remaining part */
+static void tlsf_trim(struct tlsf *t, struct tlsf_block *b, unsigned long size)
+{
+	struct tlsf_block *r;
+
+	if ((BLOCK_SIZE(b) - size) < t->min_block) {
+		return;
+	}
+
+	r = (struct tlsf_block *)((unsigned long)b + size);
+	r->prev_phys = b;
+	r->size = BLOCK_SIZE(b) - size;
+	BLOCK_NEXT(r)->prev_phys = r;
+	b->size = size;
+
+	/* Remaining part can be merged with next free block */
+	if (BLOCK_ISFREE(BLOCK_NEXT(r))) {
+		tlsf_remove_free(t, BLOCK_NEXT(r));
+		r->size += BLOCK_SIZE(BLOCK_NEXT(r));
+		BLOCK_NEXT(r)->prev_phys = r;
+	}
+
+	tlsf_insert_free(t, r);
+}
+
+static unsigned long tlsf_block_size(struct tlsf *t, unsigned long size)
+{
+	if ((t->blocks_end - t->blocks_start) < size) {
+		return 0;
+	}
+
+	size = ALIGN_UP(size + BLOCK_HDR_SIZE, 1UL << t->align_order);
+
+	return (size < t->min_block) ? t->min_block : size;
+}
+
+static void tlsf_update_peak(struct tlsf *t)
+{
+	if (t->used_peak < (t->total_size - t->free_size)) {
+		t->used_peak = t->total_size - t->free_size;
+	}
+}
+
+void *tlsf_malloc(struct tlsf *t, unsigned long size)
+{
+	irq_flags_t f;
+	struct tlsf_block *b;
+
+	if (!t || !size) {
+		return NULL;
+	}
+
+	size = tlsf_block_size(t, size);
+	if (!size) {
+		return NULL;
+	}
+
+	vmm_spin_lock_irqsave_lite(&t->lock, f);
+
+	b = tlsf_find_free(t, size);
+	if (b) {
+		tlsf_trim(t, b, size);
+		tlsf_update_peak(t);
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&t->lock, f);
+
+	return (b) ? BLOCK_PTR(b) : NULL;
+}
+
+void *tlsf_aligned_malloc(struct tlsf *t, unsigned long order,
+			  unsigned long size)
+{
+	irq_flags_t f;
+	struct tlsf_block *b, *a;
+	unsigned long gap, ptr, align;
+
+	if (!t || !size || (BITS_PER_LONG <= order)) {
+		return NULL;
+	}
+
+	if (order <= t->align_order) {
+		return tlsf_malloc(t, size);
+	}
+	align = 1UL << order;
+
+	size = tlsf_block_size(t, size);
+	if (!size || !tlsf_block_size(t, size + align + t->min_block)) {
+		return NULL;
+	}
+
+	vmm_spin_lock_irqsave_lite(&t->lock, f);
+
+	/* Leading gap is less than (align + min_block) */
+	b = tlsf_find_free(t, size + align + t->min_block);
+	if (!b) {
+		goto done;
+	}
+
+	ptr = (unsigned long)BLOCK_PTR(b);
+	gap = ALIGN_UP(ptr, align) - ptr;
+	while (gap && (gap < t->min_block)) {
+		gap += align;
+	}
+
+	/* Free leading gap as separate block */
+	if (gap) {
+		a = (struct tlsf_block *)((unsigned long)b + gap);
+		a->prev_phys = b;
+		a->size = BLOCK_SIZE(b) - gap;
+		BLOCK_NEXT(a)->prev_phys = a;
+		b->size = gap;
+		tlsf_insert_free(t, b);
+		b = a;
+	}
+
+	tlsf_trim(t, b, size);
+	tlsf_update_peak(t);
+
+done:
+	vmm_spin_unlock_irqrestore_lite(&t->lock, f);
+
+	return (b) ? BLOCK_PTR(b) : NULL;
+}
+
+bool tlsf_contains(struct tlsf *t, const void *ptr)
+{
+	if (!t) {
+		return FALSE;
+	}
+
+	return ((t->blocks_start < (unsigned long)ptr) &&
+		((unsigned long)ptr < t->blocks_end)) ? TRUE : FALSE;
+}
+
+int tlsf_free(struct tlsf *t, void *ptr)
+{
+	irq_flags_t f;
+	struct tlsf_block *b, *n;
+
+	if (!tlsf_contains(t, ptr)) {
+		return VMM_EINVALID;
+	}
+	b = BLOCK_FROM_PTR(ptr);
+
+	vmm_spin_lock_irqsave_lite(&t->lock, f);
+
+	if (BLOCK_ISFREE(b)) {
+		vmm_spin_unlock_irqrestore_lite(&t->lock, f);
+		return VMM_EINVALID;
+	}
+
+	/* Merge with physically next free block */
+	n = BLOCK_NEXT(b);
+	if (BLOCK_ISFREE(n)) {
+		tlsf_remove_free(t, n);
+		b->size += BLOCK_SIZE(n);
+		BLOCK_NEXT(b)->prev_phys = b;
+	}
+
+	/* Merge with physically previous free block */
+	if (b->prev_phys && BLOCK_ISFREE(b->prev_phys)) {
+		tlsf_remove_free(t, b->prev_phys);
+		b->prev_phys->size += BLOCK_SIZE(b);
+		b = b->prev_phys;
+		BLOCK_NEXT(b)->prev_phys = b;
+	}
+
+	tlsf_insert_free(t, b);
+
+	vmm_spin_unlock_irqrestore_lite(&t->lock, f);
+
+	return VMM_OK;
+}
+
+unsigned long tlsf_alloc_size(struct tlsf *t, const void *ptr)
+{
+	struct tlsf_block *b;
+
+	if (!tlsf_contains(t, ptr)) {
+		return 0;
+	}
+	b = BLOCK_FROM_PTR(ptr);
+
+	return (BLOCK_ISFREE(b)) ? 0 : BLOCK_SIZE(b) - BLOCK_HDR_SIZE;
+}
+
+unsigned long tlsf_free_size(struct tlsf *t)
+{
+	return (t) ? t->free_size : 0;
+}
+
+unsigned long tlsf_max_free_size(struct tlsf *t)
+{
+	irq_flags_t f;
+	unsigned long fl, ret = 0;
+	struct tlsf_block *b;
+
+	if (!t) {
+		return 0;
+	}
+
+	vmm_spin_lock_irqsave_lite(&t->lock, f);
+
+	/* Largest free block is in highest non-empty size class */
+	if (t->fl_bitmap) {
+		fl = __fls(t->fl_bitmap);
+		b = t->heads[fl][__fls(t->sl_bitmap[fl])];
+		for (; b; b = b->next_free) {
+			if (ret < BLOCK_SIZE(b)) {
+				ret = BLOCK_SIZE(b);
+			}
+		}
+	}
+
+	vmm_spin_unlock_irqrestore_lite(&t->lock, f);
+
+	return (ret) ? ret - BLOCK_HDR_SIZE : 0;
+}
+
+unsigned long tlsf_used_size(struct tlsf *t)
+{
+	return (t) ? t->total_size - t->free_size : 0;
+}
+
+unsigned long tlsf_used_peak(struct tlsf *t)
+{
+	return (t) ? t->used_peak : 0;
+}
+
+void tlsf_used_peak_reset(struct tlsf *t)
+{
+	irq_flags_t f;
+
+	if (!t) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave_lite(&t->lock, f);
+	t->used_peak = t->total_size - t->free_size;
+	vmm_spin_unlock_irqrestore_lite(&t->lock, f);
+}
+
+struct tlsf *tlsf_create(void *mem, unsigned long size,
+			 unsigned long align_order)
+{
+	struct tlsf *t;
+	struct tlsf_block *b, *s;
+	unsigned long start, end, align;
+
+	if (!mem || (BITS_PER_LONG <= align_order)) {
+		return NULL;
+	}
+
+	while ((1UL << align_order) < sizeof(void *)) {
+		align_order++;
+	}
+	align = 1UL << align_order;
+
+	/* Control structure at start of memory */
+	start = ALIGN_UP((unsigned long)mem, sizeof(void *));
+	end = (unsigned long)mem + size;
+	if ((end <= start) || ((end - start) < sizeof(struct tlsf))) {
+		return NULL;
+	}
+	t = (struct tlsf *)start;
+	start += sizeof(struct tlsf);
+
+	/* Blocks followed by zero sized used sentinel block */
+	start = ALIGN_UP(start + BLOCK_HDR_SIZE, align) - BLOCK_HDR_SIZE;
+	if ((end <= start) || ((end - start) < BLOCK_HDR_SIZE)) {
+		return NULL;
+	}
+	size = ((end - start - BLOCK_HDR_SIZE) >> align_order) << align_order;
+
+	memset(t, 0, sizeof(*t));
+	INIT_SPIN_LOCK(&t->lock);
+	t->align_order = align_order;
+	t->min_block = ALIGN_UP(sizeof(struct tlsf_block), align);
+	if (size < t->min_block) {
+		return NULL;
+	}
+	t->blocks_start = start;
+	t->blocks_end = start + size;
+	t->total_size = size;
+
+	b = (struct tlsf_block *)start;
+	b->prev_phys = NULL;
+	b->size = size;
+	s = BLOCK_NEXT(b);
+	s->prev_phys = b;
+	s->size = 0;
+	tlsf_insert_free(t, b);
+
+	return t;
+}
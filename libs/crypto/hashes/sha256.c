@@ -29,6 +29,7 @@
 #include <vmm_stdio.h>
 #include <vmm_error.h>
 #include <vmm_types.h>
+#include <vmm_compiler.h>
 #include <libs/stringlib.h>
 #include <libs/sha256.h>
 
@@ -64,7 +65,7 @@ static u32 k[64] = {
 };
 
 
-static void sha256_transform(struct sha256_context *ctx, u8 data[])
+static void sha256_transform(u32 *state, const u8 *data)
 {
 	u32 a,b,c,d,e,f,g,h,i,j,t1,t2,m[64];
 
@@ -73,14 +74,14 @@ static void sha256_transform(struct sha256_context *ctx, u8 data[])
 	for ( ; i < 64; ++i)
 		m[i] = SIG1(m[i-2]) + m[i-7] + SIG0(m[i-15]) + m[i-16];
 
-	a = ctx->state[0];
-	b = ctx->state[1];
-	c = ctx->state[2];
-	d = ctx->state[3];
-	e = ctx->state[4];
-	f = ctx->state[5];
-	g = ctx->state[6];
-	h = ctx->state[7];
+	a = state[0];
+	b = state[1];
+	c = state[2];
+	d = state[3];
+	e = state[4];
+	f = state[5];
+	g = state[6];
+	h = state[7];
 
 	for (i = 0; i < 64; ++i) {
 		t1 = h + EP1(e) + CH(e,f,g) + k[i] + m[i];
@@ -95,14 +96,36 @@ static void sha256_transform(struct sha256_context *ctx, u8 data[])
 		a = t1 + t2;
 	}
 
-	ctx->state[0] += a;
-	ctx->state[1] += b;
-	ctx->state[2] += c;
-	ctx->state[3] += d;
-	ctx->state[4] += e;
-	ctx->state[5] += f;
-	ctx->state[6] += g;
-	ctx->state[7] += h;
+	state[0] += a;
+	state[1] += b;
+	state[2] += c;
+	state[3] += d;
+	state[4] += e;
+	state[5] += f;
+	state[6] += g;
+	state[7] += h;
+}
+
+u32 __weak arch_sha256_blocks(u32 *state, const u8 *data, u32 nblocks)
+{
+	return 0;
+}
+
+static void sha256_blocks(struct sha256_context *ctx,
+			  const u8 *data, u32 nblocks)
+{
+	u32 done;
+	u64 bits;
+
+	done = arch_sha256_blocks(ctx->state, data, nblocks);
+	for ( ; done < nblocks; done++) {
+		sha256_transform(ctx->state, data + done * 64);
+	}
+
+	bits = ((u64)ctx->bitlen[1] << 32) | ctx->bitlen[0];
+	bits += (u64)nblocks * 512;
+	ctx->bitlen[0] = (u32)bits;
+	ctx->bitlen[1] = (u32)(bits >> 32);
 }
 
 void sha256_init(struct sha256_context *ctx)
@@ -122,16 +145,35 @@ void sha256_init(struct sha256_context *ctx)
 
 void sha256_update(struct sha256_context *ctx, u8 data[], u32 len)
 {
-	u32 i;
+	u32 fill;
 
-	for (i=0; i < len; ++i) {
-		ctx->data[ctx->datalen] = data[i];
-		ctx->datalen++;
-		if (ctx->datalen == 64) {
-			sha256_transform(ctx,ctx->data);
-			DBL_INT_ADD(ctx->bitlen[0],ctx->bitlen[1],512);
-			ctx->datalen = 0;
+	/* Complete partially filled block first */
+	if (ctx->datalen) {
+		fill = 64 - ctx->datalen;
+		if (len < fill) {
+			fill = len;
 		}
+		memcpy(&ctx->data[ctx->datalen], data, fill);
+		ctx->datalen += fill;
+		data += fill;
+		len -= fill;
+		if (ctx->datalen < 64) {
+			return;
+		}
+		sha256_blocks(ctx, ctx->data, 1);
+		ctx->datalen = 0;
+	}
+
+	/* Whole blocks are hashed straight from caller buffer */
+	if (len >= 64) {
+		sha256_blocks(ctx, data, len / 64);
+		data += len & ~63U;
+		len &= 63;
+	}
+
+	if (len) {
+		memcpy(ctx->data, data, len);
+		ctx->datalen = len;
 	}
 }
 
@@ -152,7 +194,7 @@ void sha256_final(sha256_digest_t digest, struct sha256_context *ctx)
 		ctx->data[i++] = 0x80;
 		while (i < 64)
 			ctx->data[i++] = 0x00;
-		sha256_transform(ctx,ctx->data);
+		sha256_transform(ctx->state,ctx->data);
 		memset(ctx->data,0,56);
 	}
 
@@ -166,7 +208,7 @@ void sha256_final(sha256_digest_t digest, struct sha256_context *ctx)
 	ctx->data[58] = ctx->bitlen[1] >> 8;
 	ctx->data[57] = ctx->bitlen[1] >> 16;
 	ctx->data[56] = ctx->bitlen[1] >> 24;
-	sha256_transform(ctx,ctx->data);
+	sha256_transform(ctx->state,ctx->data);
 
 	// Since this implementation uses little endian byte ordering and SHA uses big endian,
 	// reverse all the bytes when copying the final state to the output hash.
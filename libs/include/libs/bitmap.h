@@ -65,6 +65,8 @@
  * bitmap_weight(src, nbits)			Hamming Weight: number set bits
  * bitmap_set(dst, pos, nbits)			Set specified bit area
  * bitmap_clear(dst, pos, nbits)		Clear specified bit area
+ * bitmap_find_next_zero_area(buf, len, pos, n, mask)	Find bit free area
+ * bitmap_read(map, start, nbits)		Read nbits (<= BITS_PER_LONG) at start
  * bitmap_shift_right(dst, src, n, nbits)	*dst = *src >> n
  * bitmap_shift_left(dst, src, n, nbits)	*dst = *src << n
  * bitmap_find_free_region(bitmap, bits, order)	Find and allocate bit region
@@ -116,6 +118,14 @@ extern int __bitmap_subset(const unsigned long *bitmap1,
 			const unsigned long *bitmap2, int bits);
 extern u32 __bitmap_sw_hweight32(u32 w);
 extern int __bitmap_weight(const unsigned long *bitmap, int bits);
+extern void __bitmap_set(unsigned long *map, int start, int len);
+extern void __bitmap_clear(unsigned long *map, int start, int len);
+extern unsigned long bitmap_find_next_zero_area_off(unsigned long *map,
+						    unsigned long size,
+						    unsigned long start,
+						    unsigned int nr,
+						    unsigned long align_mask,
+						    unsigned long align_offset);
 extern int bitmap_find_free_region(unsigned long *bitmap, int bits, int order);
 extern void bitmap_release_region(unsigned long *bitmap, int pos, int order);
 extern int bitmap_allocate_region(unsigned long *bitmap, int pos, int order);
@@ -123,6 +133,15 @@ extern int bitmap_allocate_region(unsigned long *bitmap, int pos, int order);
 /*
  * inline functions
  */
+static inline int __bitmap_sw_hweight_long(unsigned long w)
+{
+#if BITS_PER_LONG == 64
+	return __bitmap_sw_hweight32((u32)w) + __bitmap_sw_hweight32(w >> 32);
+#else
+	return __bitmap_sw_hweight32(w);
+#endif
+}
+
 static inline bool bitmap_isset(unsigned long *bmap, int bit)
 {
 	return (bmap[BIT_WORD(bit)] & (0x1UL << BIT_WORD_OFFSET(bit))) ?
@@ -141,18 +160,65 @@ static inline void bitmap_clearbit(unsigned long *bmap, unsigned long bit)
 
 static inline void bitmap_set(unsigned long *bmap, int start, int len)
 {
-	int bit;
-	for (bit = start; bit < (start + len); bit++) {
-		bmap[BIT_WORD(bit)] |= (0x1UL << BIT_WORD_OFFSET(bit));
-	}
+	if (len == 1)
+		bmap[BIT_WORD(start)] |= (0x1UL << BIT_WORD_OFFSET(start));
+	else if (len > 1)
+		__bitmap_set(bmap, start, len);
 }
 
 static inline void bitmap_clear(unsigned long *bmap, int start, int len)
 {
-	int bit;
-	for (bit = start; bit < (start + len); bit++) {
-		bmap[BIT_WORD(bit)] &= ~(0x1UL << BIT_WORD_OFFSET(bit));
-	}
+	if (len == 1)
+		bmap[BIT_WORD(start)] &= ~(0x1UL << BIT_WORD_OFFSET(start));
+	else if (len > 1)
+		__bitmap_clear(bmap, start, len);
+}
+
+/**
+ * bitmap_read - read a value of n-bits from the memory region
+ *	@map: address to the bitmap memory region
+ *	@start: bit offset of the n-bit value
+ *	@nbits: size of value in bits, nonzero, up to BITS_PER_LONG
+ *
+ * Returns zero if nbits is not from 1 to BITS_PER_LONG.
+ */
+static inline unsigned long bitmap_read(const unsigned long *map,
+					unsigned long start,
+					unsigned long nbits)
+{
+	unsigned long index = BIT_WORD(start);
+	unsigned long offset = start % BITS_PER_LONG;
+	unsigned long space = BITS_PER_LONG - offset;
+	unsigned long value_low, value_high;
+
+	if (!nbits || (BITS_PER_LONG < nbits))
+		return 0;
+	if (nbits <= space)
+		return (map[index] >> offset) & BITMAP_LAST_WORD_MASK(nbits);
+
+	value_low = map[index] & BITMAP_FIRST_WORD_MASK(start);
+	value_high = map[index + 1] & BITMAP_LAST_WORD_MASK(start + nbits);
+	return (value_low >> offset) | (value_high << space);
+}
+
+/**
+ * bitmap_find_next_zero_area - find a contiguous aligned zero area
+ *	@map: The address to base the search on
+ *	@size: The bitmap size in bits
+ *	@start: The bitnumber to start searching at
+ *	@nr: The number of zeroed bits we're looking for
+ *	@align_mask: Alignment mask for zero area
+ *
+ * Returns a value greater than or equal to @size if no area is found.
+ */
+static inline unsigned long bitmap_find_next_zero_area(unsigned long *map,
+							unsigned long size,
+							unsigned long start,
+							unsigned int nr,
+							unsigned long align_mask)
+{
+	return bitmap_find_next_zero_area_off(map, size, start, nr,
+					      align_mask, 0);
 }
 
 static inline void bitmap_zero(unsigned long *dst, int nbits)
@@ -274,7 +340,8 @@ static inline int bitmap_full(const unsigned long *src, int nbits)
 static inline int bitmap_weight(const unsigned long *src, int nbits)
 {
 	if (small_const_nbits(nbits))
-		return __bitmap_sw_hweight32(*src & BITMAP_LAST_WORD_MASK(nbits));
+		return __bitmap_sw_hweight_long(*src &
+						BITMAP_LAST_WORD_MASK(nbits));
 	return __bitmap_weight(src, nbits);
 }
 
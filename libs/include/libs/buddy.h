@@ -33,6 +33,8 @@
 
 #define BUDDY_MAX_SUPPORTED_BIN			32
 
+struct buddy_area;
+
 /** Representation of buddy allocator instance */
 struct buddy_allocator {
 	void *hk_area;
@@ -47,6 +49,10 @@ struct buddy_allocator {
 	unsigned long max_bin;
 	vmm_spinlock_t alloc_lock;
 	struct rb_root alloc;
+	unsigned long alloc_hash_bits;
+	struct buddy_area **alloc_hash;
+	unsigned long alloc_size;
+	unsigned long alloc_peak;
 	vmm_spinlock_t bins_lock[BUDDY_MAX_SUPPORTED_BIN];
 	struct dlist bins[BUDDY_MAX_SUPPORTED_BIN];
 };
@@ -72,6 +78,18 @@ unsigned long buddy_bins_block_count(struct buddy_allocator *ba,
 /** Compute available free space in buddy allocator bins */
 unsigned long buddy_bins_free_space(struct buddy_allocator *ba);
 
+/** Size of largest free buddy area in buddy allocator bins */
+unsigned long buddy_bins_max_area_size(struct buddy_allocator *ba);
+
+/** Get size of alloced/reserved memory */
+unsigned long buddy_mem_alloc_size(struct buddy_allocator *ba);
+
+/** Get peak size of alloced/reserved memory */
+unsigned long buddy_mem_alloc_peak(struct buddy_allocator *ba);
+
+/** Reset peak size of alloced/reserved memory to current size */
+void buddy_mem_alloc_peak_reset(struct buddy_allocator *ba);
+
 /** Alloc memory from buddy allocator */
 int buddy_mem_alloc(struct buddy_allocator *ba,
 		    unsigned long size,
@@ -83,6 +101,24 @@ int buddy_mem_aligned_alloc(struct buddy_allocator *ba,
 			    unsigned long size,
 			    unsigned long *addr);
 
+/** Alloc memory from buddy allocator and mark it with owner tag
+ *  (Note: Tags are only kept with CONFIG_HEAP_CALLSITE)
+ */
+int buddy_mem_alloc_tagged(struct buddy_allocator *ba,
+			   unsigned long size,
+			   unsigned long tag,
+			   unsigned long *addr);
+
+/** Iterate over alloced/reserved memory of buddy allocator
+ *  (Note: Iteration callback is called with allocator lock held and
+ *  interrupts disabled so it must be short and must not allocate
+ *  or free memory)
+ */
+int buddy_mem_iterate(struct buddy_allocator *ba,
+		      int (*iter)(unsigned long addr, unsigned long size,
+				  unsigned long tag, void *priv),
+		      void *priv);
+
 /** Reserve memory in buddy allocator */
 int buddy_mem_reserve(struct buddy_allocator *ba,
 		      unsigned long addr,
@@ -0,0 +1,78 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file hash.h
+ * @author agent (agent@local)
+ * @brief Fast non-cryptographic hashes and CRC32C
+ *
+ * Hashes here are for hash tables, duplicate detection and checksums
+ * (not for security). hash32() and hash64() compute xxHash32 and
+ * xxHash64 respectively so values match standard implementations.
+ */
+
+#ifndef __LIBS_HASH_H__
+#define __LIBS_HASH_H__
+
+#include <vmm_types.h>
+
+#define HASH_GOLDEN_RATIO_32		0x61C88647U
+#define HASH_GOLDEN_RATIO_64		0x61C8864680B583EBULL
+
+/** Hash 32-bit value to given number of bits (1 <= bits <= 32) */
+static inline u32 hash_32(u32 val, u32 bits)
+{
+	return (val * HASH_GOLDEN_RATIO_32) >> (32 - bits);
+}
+
+/** Hash 64-bit value to given number of bits (1 <= bits <= 32) */
+static inline u32 hash_64(u64 val, u32 bits)
+{
+	return (u32)((val * HASH_GOLDEN_RATIO_64) >> (64 - bits));
+}
+
+/** Hash pointer value to given number of bits (1 <= bits <= 32) */
+static inline u32 hash_ptr(const void *ptr, u32 bits)
+{
+	return hash_64((u64)(unsigned long)ptr, bits);
+}
+
+/** Hash byte buffer to 32-bit value (xxHash32) */
+u32 hash32(const void *data, size_t len, u32 seed);
+
+/** Hash byte buffer to 64-bit value (xxHash64)
+ *  Note: Preferred for large buffers on 64-bit hosts.
+ */
+u64 hash64(const void *data, size_t len, u64 seed);
+
+/** Hash NUL terminated string to 32-bit value */
+u32 hash_str(const char *str, u32 seed);
+
+/** Update CRC32C (Castagnoli) value with byte buffer
+ *  Note: There is no pre/post inversion here hence standard CRC32C
+ *  of a buffer is ~crc32c(~0, data, len).
+ *  Note: CPU CRC32C instructions are used when available.
+ */
+u32 crc32c(u32 crc, const void *data, size_t len);
+
+/** Update CRC32C value using CPU instructions and return number of
+ *  bytes consumed (zero when host CPU lacks CRC32C instructions).
+ *  Note: Arch code overrides this (weak) function.
+ */
+size_t arch_crc32c(u32 *crc, const u8 *data, size_t len);
+
+#endif /* __LIBS_HASH_H__ */
@@ -41,6 +41,11 @@ extern const unsigned char kallsyms_token_table[] __attribute__ ((weak));
 extern const unsigned short kallsyms_token_index[] __attribute__ ((weak));
 extern const unsigned long kallsyms_markers[] __attribute__ ((weak));
 
+/* Build address to symbol position index used to speed up lookups.
+ * Lookups done before this (or if this fails) search all symbols.
+ */
+int kallsyms_init(void);
+
 /* Lookup the address for a symbol. Returns 0 if not found. */
 unsigned long kallsyms_lookup_name(const char *name);
 
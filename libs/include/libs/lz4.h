@@ -0,0 +1,95 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file lz4.h
+ * @author agent (agent@local)
+ * @brief Streaming LZ4 decompression interface
+ *
+ * Decompresses LZ4 frame format (as produced by lz4 command line tool)
+ * fed in arbitrary sized pieces. Decompressed data is passed to write
+ * callback block by block so that compressed images can be unpacked
+ * directly into their destination while reading them.
+ */
+
+#ifndef __LIBS_LZ4_H__
+#define __LIBS_LZ4_H__
+
+#include <vmm_types.h>
+
+#define LZ4_FRAME_MAGIC			0x184D2204
+#define LZ4_SKIPPABLE_MAGIC		0x184D2A50
+#define LZ4_SKIPPABLE_MASK		0xFFFFFFF0
+#define LZ4_FRAME_HDR_MAX		19
+#define LZ4_HISTORY_SIZE		(64 * 1024)
+
+/** Streaming LZ4 frame decompressor state
+ *  Note: Fields are private to lz4.c
+ */
+struct lz4_stream {
+	int (*write)(void *priv, const u8 *buf, size_t len);
+	void *priv;
+	u32 state;
+	u32 need;
+	u8 hdr[LZ4_FRAME_HDR_MAX];
+	u32 hdr_len;
+	u8 flg;
+	u32 block_max;
+	u32 block_size;
+	bool block_raw;
+	u32 block_hash;
+	u8 *in_buf;
+	u32 in_len;
+	u8 *out_buf;
+	u32 out_hist;
+	u32 buf_max;
+	u64 total_out;
+};
+
+/** Decompress one LZ4 block into dst and return decompressed size
+ *  or negative error code. Matches may refer upto prefix_len bytes
+ *  already present before dst.
+ */
+int lz4_decompress_block(const u8 *src, size_t src_len,
+			 u8 *dst, size_t dst_cap, size_t prefix_len);
+
+/** Check whether data starts with LZ4 frame magic */
+bool lz4_is_frame(const void *data, size_t len);
+
+/** Initialize streaming decompressor */
+void lz4_stream_init(struct lz4_stream *s,
+		     int (*write)(void *priv, const u8 *buf, size_t len),
+		     void *priv);
+
+/** Feed compressed data to streaming decompressor
+ *  Note: Returns VMM_OK or error code of corrupt data, allocation
+ *  failure or write callback failure.
+ */
+int lz4_stream_decompress(struct lz4_stream *s, const void *data, size_t len);
+
+/** Finish streaming decompression and free buffers
+ *  Note: Returns error if input ended in middle of a frame.
+ */
+int lz4_stream_end(struct lz4_stream *s);
+
+/** Total bytes decompressed so far */
+static inline u64 lz4_stream_total_out(struct lz4_stream *s)
+{
+	return s->total_out;
+}
+
+#endif /* __LIBS_LZ4_H__ */
@@ -25,7 +25,8 @@
 #define __MEMPOOL_H__
 
 #include <vmm_types.h>
-#include <libs/fifo.h>
+#include <vmm_cache.h>
+#include <libs/ring.h>
 
 /** MEMPOOL types */
 enum mempool_type {
@@ -33,14 +34,21 @@ enum mempool_type {
 	MEMPOOL_TYPE_RAW,
 	MEMPOOL_TYPE_RAM,
 	MEMPOOL_TYPE_HEAP,
+	MEMPOOL_TYPE_DMA,
 	MEMPOOL_MAX_TYPES
 };
 
+/** Per-CPU cache of free MEMPOOL entities */
+struct mempool_cpu_cache {
+	u32 count;
+	void **objs;
+} __cacheline_aligned;
+
 /** MEMPOOl representation 
  *
  *  A MEMPOOL is a memory allocator for fixed sized entities.
  *  For each MEMPOOL, we create a pool of entities on RAM pages,
- *  RAW/Device memory, or Heap.
+ *  RAW/Device memory, Heap, or DMA Heap.
  */
 struct mempool {
 	/* Type of MEMPOOL */
@@ -51,8 +59,12 @@ struct mempool {
 	u32 entity_count;
 	virtual_addr_t entity_base;
 
-	/* Internal FIFO to manage entities */
-	struct fifo *f;
+	/* Internal lock-free ring of free entities */
+	struct ring *r;
+
+	/* Optional per-CPU caches in front of ring */
+	u32 cache_size;
+	struct mempool_cpu_cache *caches;
 
 	/* Additional fields based on MEMPOOL Type */
 	union {
@@ -85,6 +97,19 @@ struct mempool *mempool_ram_create(u32 entity_size,
 struct mempool *mempool_heap_create(u32 entity_size,
 				    u32 entity_count);
 
+/** Create a MEMPOOL on DMA Heap memory */
+struct mempool *mempool_dma_create(u32 entity_size,
+				   u32 entity_count);
+
+/** Enable per-CPU caches of upto cache_size free entities for MEMPOOL
+ *  (Note: Must be called before first alloc from MEMPOOL. Empty cache
+ *  is refilled and full cache is drained by half of cache_size entities
+ *  at a time so free entities held by caches of other host CPUs are
+ *  not available to a host CPU. Only suitable when entities are mostly
+ *  freed on the host CPU which allocated them.)
+ */
+int mempool_set_cpu_cache(struct mempool *mp, u32 cache_size);
+
 /** Destroy a MEMPOOL */
 int mempool_destroy(struct mempool *mp);
 
@@ -109,4 +134,16 @@ void *mempool_zalloc(struct mempool *mp);
 /** Free a entity to MEMPOOL */
 int mempool_free(struct mempool *mp, void *entity);
 
+/** Alloc upto count entities from MEMPOOL in one go
+ *  (Note: Bypasses per-CPU caches)
+ *  @returns number of entities allocated
+ */
+u32 mempool_malloc_bulk(struct mempool *mp, void **entities, u32 count);
+
+/** Free count entities to MEMPOOL in one go
+ *  (Note: Bypasses per-CPU caches)
+ *  @returns VMM_OK on success and error code on failure
+ */
+int mempool_free_bulk(struct mempool *mp, void **entities, u32 count);
+
 #endif /* __MEMPOOL_H__ */
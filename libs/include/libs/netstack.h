@@ -61,6 +61,9 @@ struct netstack_socket {
 	u16 port;
 	enum netstack_socket_type type;
 	void *priv;
+	/* Partially consumed data of netstack_socket_recv_into() */
+	void *rx_priv;
+	u16 rx_off;
 };
 
 /** 
@@ -279,6 +282,27 @@ int netstack_socket_nextbuf(struct netstack_socket_buf *buf);
  */
 void netstack_socket_freebuf(struct netstack_socket_buf *buf);
 
+/**
+ *  Recieve data from a socket directly into caller buffer.
+ *
+ *  Data is copied once from network stack buffers into caller buffer
+ *  and any remaining data is kept with socket for the next call hence
+ *  this must not be mixed with netstack_socket_recv() on same socket.
+ *
+ *  @sk - pointer to socket
+ *  @data - pointer to caller buffer
+ *  @len - length of caller buffer
+ *  @timeout - timeout in milliseconds (<=0 means wait forever)
+ *
+ *  returns 
+ *    >0 - number of bytes received (less than len only upon
+ *         timeout or connection closed)
+ *    VMM_ETIMEDOUT - upon receive timeout with nothing received
+ *    VMM_Exxxx - failure
+ */
+int netstack_socket_recv_into(struct netstack_socket *sk,
+			      void *data, u32 len, int timeout);
+
 /**
  *  Write data to a socket
  *
@@ -292,5 +316,34 @@ void netstack_socket_freebuf(struct netstack_socket_buf *buf);
  */
 int netstack_socket_write(struct netstack_socket *sk, void *data, u16 len);
 
+/**
+ *  Set readiness notification callback of a socket. The callback
+ *  is called from network stack context (hence must not sleep)
+ *  whenever data or a new connection arrives or the connection
+ *  fails. It is not called after this function returns with NULL
+ *  callback or after the socket is freed.
+ *
+ *  @sk - pointer to socket
+ *  @notify - notification callback (NULL to remove)
+ *  @priv - private argument passed to callback
+ *
+ *  returns 
+ *    VMM_OK - success
+ *    VMM_Exxxx - failure
+ */
+int netstack_socket_set_notify(struct netstack_socket *sk,
+			void (*notify)(struct netstack_socket *sk, void *priv),
+			void *priv);
+
+/**
+ *  Check whether receive (or accept) on a socket will not block.
+ *  Only valid for sockets having notification callback.
+ *
+ *  @sk - pointer to socket
+ *
+ *  returns TRUE if socket is readable else FALSE
+ */
+bool netstack_socket_readable(struct netstack_socket *sk);
+
 #endif  /* __VMM_NETSTACK_H_ */
 
@@ -0,0 +1,112 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file ring.h
+ * @author agent (agent@local)
+ * @brief header file for lock-free ring of pointers.
+ *
+ * The ring is a bounded first-in-first-out queue of pointers with
+ * separate producer and consumer head/tail pairs (on separate cache
+ * lines). Producers and consumers reserve slots by moving their head
+ * and publish them by moving their tail hence no lock is required.
+ * Depending on flags passed to ring_alloc() enqueue and dequeue is
+ * single-producer/single-consumer or multi-producer/multi-consumer.
+ */
+
+#ifndef __RING_H__
+#define __RING_H__
+
+#include <vmm_types.h>
+#include <vmm_cache.h>
+
+/** Only one producer enqueues at a time */
+#define RING_F_SP_ENQ			0x1
+/** Only one consumer dequeues at a time */
+#define RING_F_SC_DEQ			0x2
+
+/** Head/tail pair of ring producer or consumer */
+struct ring_headtail {
+	atomic_t head;
+	atomic_t tail;
+} __cacheline_aligned;
+
+/** Ring representation
+ *  (Note: head/tail are 32-bit free running counters)
+ */
+struct ring {
+	u32 flags;
+	u32 size;
+	u32 mask;
+	u32 capacity;
+	void **elements;
+	struct ring_headtail prod;
+	struct ring_headtail cons;
+};
+
+/** Alloc a new ring which can hold count pointers */
+struct ring *ring_alloc(u32 count, u32 flags);
+
+/** Free a ring */
+int ring_free(struct ring *r);
+
+/** Enqueue either all count pointers to ring or none
+ *  @returns count on success and zero on failure
+ */
+u32 ring_enqueue_bulk(struct ring *r, void **src, u32 count);
+
+/** Enqueue upto count pointers to ring
+ *  @returns number of pointers enqueued
+ */
+u32 ring_enqueue_burst(struct ring *r, void **src, u32 count);
+
+/** Dequeue either all count pointers from ring or none
+ *  @returns count on success and zero on failure
+ */
+u32 ring_dequeue_bulk(struct ring *r, void **dst, u32 count);
+
+/** Dequeue upto count pointers from ring
+ *  @returns number of pointers dequeued
+ */
+u32 ring_dequeue_burst(struct ring *r, void **dst, u32 count);
+
+/** Enqueue a pointer to ring
+ *  @returns TRUE on success and FALSE on failure
+ */
+static inline bool ring_enqueue(struct ring *r, void *src)
+{
+	return (ring_enqueue_bulk(r, &src, 1)) ? TRUE : FALSE;
+}
+
+/** Dequeue a pointer from ring
+ *  @returns TRUE on success and FALSE on failure
+ */
+static inline bool ring_dequeue(struct ring *r, void **dst)
+{
+	return (ring_dequeue_bulk(r, dst, 1)) ? TRUE : FALSE;
+}
+
+/** Get count of available pointers (approximate when ring is busy) */
+u32 ring_avail(struct ring *r);
+
+/** Check if ring is empty */
+bool ring_isempty(struct ring *r);
+
+/** Check if ring is full */
+bool ring_isfull(struct ring *r);
+
+#endif /* __RING_H__ */
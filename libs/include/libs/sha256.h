@@ -37,4 +37,12 @@ void sha256_init(struct sha256_context *ctx);
 void sha256_update(struct sha256_context *ctx, u8 data[], u32 len);
 void sha256_final(sha256_digest_t digest, struct sha256_context *ctx);
 
+/** Hash given number of 64-byte blocks into state using SHA-256
+ *  instructions of host CPU and return number of blocks hashed.
+ *  Note: Arch code overrides this (weak) function and returns zero
+ *  when host CPU lacks SHA-256 instructions so that remaining blocks
+ *  are hashed in C.
+ */
+u32 arch_sha256_blocks(u32 *state, const u8 *data, u32 nblocks);
+
 #endif /* __SHA_256_H_ */
@@ -0,0 +1,76 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file tlsf.h
+ * @author agent (agent@local)
+ * @brief Two-Level Segregated Fit (TLSF) allocator interface
+ *
+ * TLSF manages one contiguous memory region with in-band block
+ * headers. Free blocks are kept in segregated lists indexed by a
+ * two-level (power of two and linear subdivision) size class with
+ * bitmaps of non-empty lists, so malloc and free take bounded time
+ * independent of number of blocks or fragmentation.
+ */
+
+#ifndef __TLSF_H__
+#define __TLSF_H__
+
+#include <vmm_types.h>
+
+struct tlsf;
+
+/** Create TLSF allocator on given memory region where all returned
+ *  pointers are aligned to 2^align_order bytes (at least pointer size)
+ *  (Note: TLSF control structure is placed at start of region)
+ *  @returns TLSF allocator on success and NULL on failure
+ */
+struct tlsf *tlsf_create(void *mem, unsigned long size,
+			 unsigned long align_order);
+
+/** Alloc memory from TLSF allocator */
+void *tlsf_malloc(struct tlsf *t, unsigned long size);
+
+/** Alloc memory aligned to 2^order from TLSF allocator */
+void *tlsf_aligned_malloc(struct tlsf *t, unsigned long order,
+			  unsigned long size);
+
+/** Free memory to TLSF allocator */
+int tlsf_free(struct tlsf *t, void *ptr);
+
+/** Check if given pointer is within memory of TLSF allocator */
+bool tlsf_contains(struct tlsf *t, const void *ptr);
+
+/** Get usable size of memory alloced from TLSF allocator */
+unsigned long tlsf_alloc_size(struct tlsf *t, const void *ptr);
+
+/** Get size of free memory in TLSF allocator */
+unsigned long tlsf_free_size(struct tlsf *t);
+
+/** Get size of largest free block in TLSF allocator */
+unsigned long tlsf_max_free_size(struct tlsf *t);
+
+/** Get size of alloced memory (including block headers) */
+unsigned long tlsf_used_size(struct tlsf *t);
+
+/** Get peak size of alloced memory (including block headers) */
+unsigned long tlsf_used_peak(struct tlsf *t);
+
+/** Reset peak size of alloced memory to current size */
+void tlsf_used_peak_reset(struct tlsf *t);
+
+#endif /* __TLSF_H__ */
@@ -25,9 +25,13 @@
 #define __VFS_H_
 
 #include <vmm_mutex.h>
+#include <vmm_completion.h>
+#include <vmm_workqueue.h>
 #include <block/vmm_blockdev.h>
 #include <libs/list.h>
 
+struct vmm_guest;
+
 #define VFS_IPRIORITY		(VMM_BLOCKDEV_CLASS_IPRIORITY+1)
 #define VFS_MAX_PATH		(256)
 #define	VFS_MAX_NAME		(64)
@@ -135,6 +139,22 @@ struct dirent {
 	char d_name[VFS_MAX_NAME];	/* name must not be longer than this */
 };
 
+/** asynchronous file request structure */
+struct vfs_aio {
+	int fd;				/* open file descriptor */
+	bool write;			/* write request (else read) */
+	loff_t off;			/* position in file */
+	void *buf;			/* data buffer */
+	size_t len;			/* number of bytes */
+	void (*done)(struct vfs_aio *);	/* optional completion callback */
+	void *priv;			/* private data for submitter */
+
+	size_t ret;			/* bytes transferred */
+
+	struct vmm_work work;		/* used internally by vfs */
+	struct vmm_completion cmpl;	/* used internally by vfs */
+};
+
 /** mount flags */
 #define	MOUNT_RDONLY	(0x00000001)	/* read only filesystem */
 #define	MOUNT_RW	(0x00000002)	/* read-write filesystem */
@@ -150,6 +170,7 @@ struct mount {
 	atomic_t m_refcnt;		/* reference count */
 	struct vnode *m_root;		/* root vnode */
 	struct vnode *m_covered;	/* vnode covered on parent fs */
+	bool m_bcache;			/* buffer cache enabled by mount */
 
 	struct vmm_mutex m_lock;	/* lock to protect members below
 					 * m_lock and mount point operations
@@ -176,14 +197,18 @@ enum vnode_type {
 enum vnode_flag {
 	VNONE,				/* default vnode flag */
 	VROOT,	   			/* root of its filesystem */
+	VNEGATIVE,			/* cached lookup failure */
 };
 
 /** vnode structure */
 struct vnode {
 	struct dlist v_link;		/* link for hash list */
+	struct dlist v_lru;		/* link for unused vnode list */
 	struct mount *v_mount;		/* mount point pointer */
+	struct vnode *v_parent;		/* parent directory vnode */
 	atomic_t v_refcnt;		/* reference count */
 	char v_path[VFS_MAX_PATH];	/* pointer to path in fs */
+	const char *v_name;		/* last component of v_path */
 	enum vnode_flag v_flags;	/* vnode flags 
 					 * (used by internally by vfs) 
 					 */
@@ -244,6 +269,10 @@ struct filesystem {
 	int (*mkdir)(struct vnode *, const char *, u32);
 	int (*rmdir)(struct vnode *, struct vnode *, const char *);
 	int (*chmod)(struct vnode *, u32);
+	/* Optional. Map file offset to block device offset and
+	 * number of bytes contiguous on block device from there.
+	 */
+	int (*bmap)(struct vnode *, loff_t, u64 *, size_t *);
 };
 
 /** Create a mount point
@@ -251,6 +280,21 @@ struct filesystem {
  */
 int vfs_mount(const char *dir, const char *fsname, const char *dev, u32 flags);
 
+/** Create a mount point in background
+ *  Note: If fsname is NULL then all registered filesystems are tried.
+ *  Note: Waits upto wait_secs seconds for block device to appear.
+ *  Note: Mounts are done in parallel hence a mount point depending
+ *  on another background mount must be created after waiting.
+ */
+int vfs_mount_async(const char *dir, const char *fsname,
+		    const char *dev, u32 flags, u32 wait_secs);
+
+/** Wait for all background mounts to finish
+ *  Note: Returns first error encountered by background mounts.
+ *  Note: Must be called from Orphan (or Thread) context.
+ */
+int vfs_mount_async_wait(void);
+
 /** Destroy a mount point
  *  Note: Must be called from Orphan (or Thread) context.
  */
@@ -272,6 +316,7 @@ u32 vfs_mount_count(void);
 int vfs_open(const char *path, u32 flags, u32 mode);
 
 /** Close an open file 
+ *  Note: Fails with VMM_EBUSY if asynchronous requests are pending.
  *  Note: Must be called from Orphan (or Thread) context.
  */
 int vfs_close(int fd);
@@ -281,11 +326,62 @@ int vfs_close(int fd);
  */
 size_t vfs_read(int fd, void *buf, size_t len);
 
+/** Read a file directly into host memory
+ *  Note: Host memory is filled using cacheable mapping and data cache
+ *  is flushed once per chunk so that non-cacheable observers (such as
+ *  guest with MMU off) see loaded contents.
+ *  Note: If observe callback is not NULL then it is called for each
+ *  chunk right after reading while the chunk is still in cache (for
+ *  example to compute image digest without another pass over it).
+ *  Note: Must be called from Orphan (or Thread) context.
+ */
+size_t vfs_read_into_host(int fd, physical_addr_t hphys_addr, size_t len,
+			  void (*observe)(void *priv, const void *buf,
+					  size_t len),
+			  void *priv);
+
+/** Read a file directly into guest memory (RAM or ROM regions)
+ *  Note: Avoids bounce buffer by mapping host pages backing guest
+ *  memory and letting filesystem read into them.
+ *  Note: Optional observe callback is same as vfs_read_into_host().
+ *  Note: Must be called from Orphan (or Thread) context.
+ */
+size_t vfs_read_into_guest(int fd, struct vmm_guest *guest,
+			   physical_addr_t gphys_addr, size_t len,
+			   void (*observe)(void *priv, const void *buf,
+					   size_t len),
+			   void *priv);
+
+/** Get host physical address of given byte range of a file
+ *  Note: Only possible when the byte range is contiguous on a block
+ *  device whose blocks are directly addressable host memory (such
+ *  as RAM backed block device) and filesystem supports bmap.
+ *  Note: Returned memory must be treated as read-only.
+ *  Note: Must be called from Orphan (or Thread) context.
+ */
+int vfs_mmap(int fd, loff_t off, size_t len, physical_addr_t *pa);
+
 /** Write a file 
  *  Note: Must be called from Orphan (or Thread) context.
  */
 size_t vfs_write(int fd, void *buf, size_t len);
 
+/** Submit asynchronous read or write of a file
+ *  Note: Requests use their own file position hence current position
+ *  of file is not updated. Requests on same file descriptor complete
+ *  in submission order.
+ *  Note: The done() callback (if any) is called from VFS worker
+ *  thread and the request must not be waited upon in that case.
+ *  Note: Must be called from Orphan (or Thread) context.
+ */
+int vfs_aio_submit(struct vfs_aio *aio);
+
+/** Wait for asynchronous request without done() callback
+ *  Note: Returns number of bytes transferred.
+ *  Note: Must be called from Orphan (or Thread) context.
+ */
+size_t vfs_aio_wait(struct vfs_aio *aio);
+
 /** Set current position of a file 
  *  Note: Must be called from Orphan (or Thread) context.
  */
@@ -27,6 +27,7 @@
 #include <vmm_limits.h>
 #include <vmm_types.h>
 #include <vmm_threads.h>
+#include <vmm_completion.h>
 #include <vio/vmm_vserial.h>
 #include <libs/list.h>
 
@@ -49,6 +50,13 @@ struct vsdaemon_transport {
 	void (*cleanup) (struct vsdaemon *vsd);
 	int (*main_loop) (struct vsdaemon *vsd);
 	void (*receive_char) (struct vsdaemon *vsd, u8 ch);
+	/* optional: preferred over receive_char when available */
+	void (*receive_buf) (struct vsdaemon *vsd, u8 *buf, u32 len);
+	/* optional: event driven alternative of main_loop which must
+	 * not block and is called from vsdaemon worker threads after
+	 * vsdaemon_schedule()
+	 */
+	int (*process) (struct vsdaemon *vsd);
 };
 
 struct vsdaemon {
@@ -64,9 +72,14 @@ struct vsdaemon {
 	/* vserial port */
 	struct vmm_vserial *vser;
 
-	/* underlying thread */
+	/* underlying thread (only for transports without process) */
 	struct vmm_thread *thread;
 
+	/* worker scheduling state (only for transports with process) */
+	struct dlist ready_head;
+	u32 sched_flags;
+	struct vmm_completion sched_idle;
+
 	/* transport specific data */
 	void *trans_data;
 };
@@ -85,6 +98,11 @@ static inline void *vsdaemon_transport_get_data(struct vsdaemon *vsd)
 	return (vsd) ? vsd->trans_data : NULL;
 }
 
+/** Schedule processing of vsdaemon on worker threads
+ *  Note: Can be called from any context
+ */
+void vsdaemon_schedule(struct vsdaemon *vsd);
+
 /** Register vsdaemon transport */
 int vsdaemon_transport_register(struct vsdaemon_transport *trans);
 
@@ -36,6 +36,8 @@
 #define VTEMU_INBUF_SIZE	32
 #define VTEMU_ESCMD_SIZE	(17 * 3)
 #define VTEMU_ESC_NPAR		(16)
+#define VTEMU_GLYPH_COUNT	256
+#define VTEMU_GLYPH_CACHE_SIZE	4
 
 typedef enum {
 	VTEMU_COLOR_BLACK,
@@ -61,6 +63,13 @@ struct vtemu_cell {
 	u32 fc, bc;
 };
 
+/* prerendered glyphs of all characters for a fc and bc pair */
+struct vtemu_glyph_cache {
+	bool valid;
+	u32 fc, bc;
+	u8 *data;
+};
+
 #define VTEMU_KEYFLAG_LEFTCTRL		0x00000001
 #define VTEMU_KEYFLAG_RIGHTCTRL		0x00000002
 #define VTEMU_KEYFLAG_LEFTALT		0x00000004
@@ -98,6 +107,12 @@ struct vtemu {
 	const struct vtemu_font *font;
 	u32 font_img_sz;
 
+	/* glyphs prerendered in frame buffer pixel format */
+	u32 glyph_sz;
+	u32 glyph_pages;
+	u32 glyph_next;
+	struct vtemu_glyph_cache glyph[VTEMU_GLYPH_CACHE_SIZE];
+
 	/* width and height */
 	u32 w, h;
 
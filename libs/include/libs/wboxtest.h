@@ -83,6 +83,10 @@ void wboxtest_run_tests(struct vmm_chardev *cdev, u32 iterations,
 /** Run all wboxtests */
 void wboxtest_run_all(struct vmm_chardev *cdev, u32 iterations);
 
+/** Report benchmark result of a wboxtest as nanoseconds per operation */
+void wboxtest_bench_report(struct vmm_chardev *cdev, struct wboxtest *test,
+			   const char *op, u64 count, u64 nsecs);
+
 /** Register wboxtest */
 int wboxtest_register(const char *group_name, struct wboxtest *test);
 
@@ -28,12 +28,26 @@
  *	Adapted the file to xvisor
  */
 
+#include <vmm_error.h>
+#include <vmm_heap.h>
 #include <vmm_stdio.h>
 #include <libs/stringlib.h>
 #include <libs/kallsyms.h>
 
+extern unsigned char _code_start;
 extern unsigned char _code_end;
 
+/*
+ * Coarse address to symbol position index. Entry i holds position of
+ * the last symbol at or below start of i-th bucket of code so lookup
+ * only has to binary search symbols of one bucket.
+ */
+#define KALLSYMS_BUCKET_SHIFT	12
+
+static unsigned int *kallsyms_buckets;
+static unsigned long kallsyms_bucket_base;
+static unsigned long kallsyms_bucket_count;
+
 /*
  * Expand a compressed symbol data into the resulting uncompressed string,
  * given the offset to where the symbol is in the compressed stream.
@@ -88,10 +102,19 @@ __notrace unsigned long kallsyms_get_symbol_pos(unsigned long addr, unsigned lon
 	/* This kernel should never had been booted. */
 	BUG_ON(!kallsyms_addresses);
 
-	/* Do a binary search on the sorted kallsyms_addresses array. */
+	/* Narrow down the search using bucket index (if available). */
 	low = 0;
 	high = kallsyms_num_syms;
+	if (kallsyms_buckets && (kallsyms_bucket_base <= addr)) {
+		i = (addr - kallsyms_bucket_base) >> KALLSYMS_BUCKET_SHIFT;
+		if (i < kallsyms_bucket_count) {
+			low = kallsyms_buckets[i];
+			if ((kallsyms_buckets[i + 1] + 1) < high)
+				high = kallsyms_buckets[i + 1] + 1;
+		}
+	}
 
+	/* Do a binary search on the sorted kallsyms_addresses array. */
 	while (high - low > 1) {
 		mid = low + (high - low) / 2;
 		if (kallsyms_addresses[mid] <= addr)
@@ -119,7 +142,7 @@ __notrace unsigned long kallsyms_get_symbol_pos(unsigned long addr, unsigned lon
 
 	/* If we found no next symbol, we use the end of the section. */
 	if (!symbol_end) {
-		symbol_end = (unsigned long)_code_end;
+		symbol_end = (unsigned long)&_code_end;
 	}
 
 	if (symbolsize)
@@ -130,6 +153,42 @@ __notrace unsigned long kallsyms_get_symbol_pos(unsigned long addr, unsigned lon
 	return low;
 }
 
+__notrace int kallsyms_init(void)
+{
+	unsigned long i, pos, start, end, count;
+	unsigned int *buckets;
+
+	if (!kallsyms_addresses || !kallsyms_num_syms || kallsyms_buckets)
+		return VMM_OK;
+
+	start = (unsigned long)&_code_start;
+	end = (unsigned long)&_code_end;
+	if (end <= start)
+		return VMM_OK;
+	count = ((end - start) + (1UL << KALLSYMS_BUCKET_SHIFT) - 1) >>
+						KALLSYMS_BUCKET_SHIFT;
+
+	buckets = vmm_malloc(sizeof(*buckets) * (count + 1));
+	if (!buckets)
+		return VMM_ENOMEM;
+
+	/* Symbols are sorted so one pass is enough to fill all buckets */
+	pos = kallsyms_get_symbol_pos(start, NULL, NULL);
+	for (i = 0; i <= count; i++) {
+		while ((pos + 1) < kallsyms_num_syms &&
+		       kallsyms_addresses[pos + 1] <=
+				(start + (i << KALLSYMS_BUCKET_SHIFT)))
+			pos++;
+		buckets[i] = pos;
+	}
+
+	kallsyms_bucket_base = start;
+	kallsyms_bucket_count = count;
+	kallsyms_buckets = buckets;
+
+	return VMM_OK;
+}
+
 /*
  * Find the offset on the compressed stream given and index in the
  * kallsyms array.
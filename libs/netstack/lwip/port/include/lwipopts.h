@@ -82,7 +82,7 @@
  * If the application sends a lot of data out of ROM (or other static memory),
  * this should be set high.
  */
-#define MEMP_NUM_PBUF                   16
+#define MEMP_NUM_PBUF                   32
 
 /**
  * MEMP_NUM_RAW_PCB: Number of raw connection PCBs
@@ -113,7 +113,7 @@
  * MEMP_NUM_TCP_SEG: the number of simultaneously queued TCP segments.
  * (requires the LWIP_TCP option)
  */
-#define MEMP_NUM_TCP_SEG                16
+#define MEMP_NUM_TCP_SEG                TCP_SND_QUEUELEN
 
 /**
  * MEMP_NUM_REASSDATA: the number of simultaneously IP packets queued for
@@ -139,7 +139,7 @@
  * MEMP_NUM_NETBUF: the number of struct netbufs.
  * (only needed if you use the sequential API, like api_lib.c)
  */
-#define MEMP_NUM_NETBUF                 2
+#define MEMP_NUM_NETBUF                 16
 
 /**
  * MEMP_NUM_NETCONN: the number of struct netconns.
@@ -159,12 +159,14 @@
  * for incoming packets. 
  * (only needed if you use tcpip.c)
  */
-#define MEMP_NUM_TCPIP_MSG_INPKT        8
+#define MEMP_NUM_TCPIP_MSG_INPKT        32
 
 /**
  * PBUF_POOL_SIZE: the number of buffers in the pbuf pool. 
+ * Received frames normally wrap netport mbufs without copying so the
+ * pool only backs the copy fallback, but it must still cover TCP_WND.
  */
-#define PBUF_POOL_SIZE                  8
+#define PBUF_POOL_SIZE                  48
 
 /*
    ---------------------------------
@@ -332,6 +334,27 @@
 
 #define LWIP_LISTEN_BACKLOG             0
 
+/**
+ * TCP_MSS: TCP Maximum segment size for standard Ethernet MTU.
+ */
+#define TCP_MSS                         1460
+
+/**
+ * TCP_WND: The size of a TCP window. lwIP-1.4.1 does not implement
+ * window scaling so this must fit in an u16_t.
+ */
+#define TCP_WND                         (40 * TCP_MSS)
+
+/**
+ * TCP_SND_BUF: TCP sender buffer space (bytes).
+ */
+#define TCP_SND_BUF                     (16 * TCP_MSS)
+
+/**
+ * TCP_SND_QUEUELEN: TCP sender buffer space (pbufs).
+ */
+#define TCP_SND_QUEUELEN                (4 * (TCP_SND_BUF) / (TCP_MSS))
+
 /*
    ----------------------------------
    ---------- Pbuf options ----------
@@ -28,6 +28,7 @@
 #include <vmm_devtree.h>
 #include <vmm_mutex.h>
 #include <vmm_completion.h>
+#include <vmm_spinlocks.h>
 #include <vmm_modules.h>
 #include <libs/netstack.h>
 
@@ -61,6 +62,12 @@
 
 #define MAX_FRAME_LEN			1518
 
+/** number of custom pbufs wrapping received mbufs (zero-copy RX) */
+#define RX_PBUF_COUNT			64
+
+/** number of received pbufs waiting for tcpip thread */
+#define RX_QUEUE_LEN			64
+
 #undef PING_USE_SOCKETS
 
 /** ping receive timeout - in milliseconds */
@@ -72,9 +79,34 @@
 /** ping identifier - must fit on a u16_t */
 #define PING_ID				0xAFAF
 
+struct lwip_rx_pbuf {
+	struct pbuf_custom cp;
+	struct vmm_mbuf *mbuf;
+	struct dlist head;
+};
+
+/* Readiness notification state of a socket */
+struct lwip_socket_event {
+	struct dlist head;
+	struct netconn *conn;
+	struct netstack_socket *sk;
+	int rcvevent;
+	void (*notify)(struct netstack_socket *sk, void *priv);
+	void *priv;
+};
+
 struct lwip_netstack {
 	struct netif nif;
 	struct vmm_netport *port;
+	vmm_spinlock_t rx_lock;
+	struct dlist rx_pbuf_free;
+	struct lwip_rx_pbuf rx_pbufs[RX_PBUF_COUNT];
+	struct pbuf *rx_queue[RX_QUEUE_LEN];
+	u32 rx_head;
+	u32 rx_count;
+	bool rx_pending;
+	vmm_spinlock_t sk_event_lock;
+	struct dlist sk_event_list;
 #if !defined(PING_USE_SOCKETS)
 	struct vmm_mutex ping_lock;
 	ip_addr_t ping_addr;
@@ -402,6 +434,140 @@ void netstack_prefetch_arp_mapping(u8 *ipaddr)
 }
 VMM_EXPORT_SYMBOL(netstack_prefetch_arp_mapping);
 
+/* Note: This function must be called with sk_event_lock held */
+static struct lwip_socket_event *__lwip_socket_event_find(struct netconn *conn)
+{
+	struct lwip_socket_event *se;
+
+	list_for_each_entry(se, &lns.sk_event_list, head) {
+		if (se->conn == conn) {
+			return se;
+		}
+	}
+
+	return NULL;
+}
+
+/*
+ * Called by lwIP for every netconn event. Like the lwIP sockets layer,
+ * receive events which arrive before notification is set are counted
+ * in negative conn->socket so that accepted connections do not miss
+ * data which arrived before the socket was handed over.
+ */
+static void lwip_netconn_event(struct netconn *conn,
+			       enum netconn_evt evt, u16_t len)
+{
+	irq_flags_t flags;
+	struct lwip_socket_event *se;
+
+	if ((evt != NETCONN_EVT_RCVPLUS) &&
+	    (evt != NETCONN_EVT_RCVMINUS) &&
+	    (evt != NETCONN_EVT_ERROR)) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&lns.sk_event_lock, flags);
+
+	if (conn->socket < 0) {
+		if (evt == NETCONN_EVT_RCVPLUS) {
+			conn->socket--;
+		}
+		vmm_spin_unlock_irqrestore(&lns.sk_event_lock, flags);
+		return;
+	}
+
+	se = __lwip_socket_event_find(conn);
+	if (se) {
+		if (evt == NETCONN_EVT_RCVPLUS) {
+			se->rcvevent++;
+		} else if (evt == NETCONN_EVT_RCVMINUS) {
+			se->rcvevent--;
+		}
+		/* Called under lock so that notify cannot race
+		 * with removal of notification.
+		 */
+		if (evt != NETCONN_EVT_RCVMINUS) {
+			se->notify(se->sk, se->priv);
+		}
+	}
+
+	vmm_spin_unlock_irqrestore(&lns.sk_event_lock, flags);
+}
+
+int netstack_socket_set_notify(struct netstack_socket *sk,
+			void (*notify)(struct netstack_socket *sk, void *priv),
+			void *priv)
+{
+	irq_flags_t flags;
+	struct netconn *conn;
+	struct lwip_socket_event *se, *nse = NULL;
+
+	if (!sk || !sk->priv) {
+		return VMM_EINVALID;
+	}
+	conn = sk->priv;
+
+	if (notify) {
+		nse = vmm_zalloc(sizeof(*nse));
+		if (!nse) {
+			return VMM_ENOMEM;
+		}
+		INIT_LIST_HEAD(&nse->head);
+		nse->conn = conn;
+		nse->sk = sk;
+		nse->notify = notify;
+		nse->priv = priv;
+	}
+
+	vmm_spin_lock_irqsave(&lns.sk_event_lock, flags);
+
+	se = __lwip_socket_event_find(conn);
+	if (se) {
+		list_del(&se->head);
+		if (nse) {
+			nse->rcvevent = se->rcvevent;
+		} else {
+			conn->socket = -1;
+		}
+	} else if (nse) {
+		nse->rcvevent = -1 - conn->socket;
+	}
+	if (nse) {
+		conn->socket = 0;
+		list_add_tail(&nse->head, &lns.sk_event_list);
+	}
+
+	vmm_spin_unlock_irqrestore(&lns.sk_event_lock, flags);
+
+	if (se) {
+		vmm_free(se);
+	}
+
+	return VMM_OK;
+}
+VMM_EXPORT_SYMBOL(netstack_socket_set_notify);
+
+bool netstack_socket_readable(struct netstack_socket *sk)
+{
+	bool ret = FALSE;
+	irq_flags_t flags;
+	struct lwip_socket_event *se;
+
+	if (!sk || !sk->priv) {
+		return FALSE;
+	}
+
+	vmm_spin_lock_irqsave(&lns.sk_event_lock, flags);
+	se = __lwip_socket_event_find(sk->priv);
+	if (se && (0 < se->rcvevent)) {
+		ret = TRUE;
+	}
+	vmm_spin_unlock_irqrestore(&lns.sk_event_lock, flags);
+
+	return ret;
+}
+VMM_EXPORT_SYMBOL(netstack_socket_readable);
+
 struct netstack_socket *netstack_socket_alloc(enum netstack_socket_type type)
 {
 	struct netstack_socket *sk;
@@ -414,10 +580,12 @@ struct netstack_socket *netstack_socket_alloc(enum netstack_socket_type type)
 
 	switch (type) {
 	case NETSTACK_SOCKET_TCP:
-		conn = netconn_new(NETCONN_TCP);
+		conn = netconn_new_with_callback(NETCONN_TCP,
+						 lwip_netconn_event);
 		break;
 	case NETSTACK_SOCKET_UDP:
-		conn = netconn_new(NETCONN_UDP);
+		conn = netconn_new_with_callback(NETCONN_UDP,
+						 lwip_netconn_event);
 		break;
 	default:
 		conn = NULL;
@@ -555,6 +723,8 @@ int netstack_socket_accept(struct netstack_socket *sk,
 	memcpy(tsk, sk, sizeof(struct netstack_socket));
 
 	tsk->priv = NULL;
+	tsk->rx_priv = NULL;
+	tsk->rx_off = 0;
 
 	err = netconn_accept(sk->priv, &newconn);
 	if (err != ERR_OK) {
@@ -593,6 +763,10 @@ void netstack_socket_free(struct netstack_socket *sk)
 		return;
 	}
 
+	netstack_socket_set_notify(sk, NULL, NULL);
+	if (sk->rx_priv) {
+		netbuf_delete(sk->rx_priv);
+	}
 	netconn_delete(sk->priv);
 	vmm_free(sk);	
 }
@@ -669,6 +843,60 @@ void netstack_socket_freebuf(struct netstack_socket_buf *buf)
 }
 VMM_EXPORT_SYMBOL(netstack_socket_freebuf);
 
+int netstack_socket_recv_into(struct netstack_socket *sk,
+			      void *data, u32 len, int timeout)
+{
+	err_t err;
+	u16 copied;
+	u32 done = 0;
+	int rc = VMM_OK;
+	struct netbuf *nb;
+	struct netconn *conn;
+
+	if (!sk || !sk->priv || !data || !len) {
+		return VMM_EINVALID;
+	}
+	conn = sk->priv;
+
+	if (0 < timeout) {
+		netconn_set_recvtimeout(conn, timeout);
+	} else {
+		netconn_set_recvtimeout(conn, 0);
+	}
+
+	while (done < len) {
+		nb = sk->rx_priv;
+		if (!nb) {
+			err = netconn_recv(conn, &nb);
+			if (err == ERR_TIMEOUT) {
+				rc = VMM_ETIMEDOUT;
+				break;
+			} else if (err != ERR_OK) {
+				rc = VMM_EFAIL;
+				break;
+			}
+			sk->rx_priv = nb;
+			sk->rx_off = 0;
+		}
+
+		/* Copy across whole pbuf chain of netbuf in one go */
+		copied = netbuf_copy_partial(nb, (u8 *)data + done,
+				((len - done) < 0xFFFF) ? (len - done) : 0xFFFF,
+				sk->rx_off);
+		done += copied;
+		sk->rx_off += copied;
+
+		if (netbuf_len(nb) <= sk->rx_off) {
+			netbuf_delete(nb);
+			sk->rx_priv = NULL;
+			sk->rx_off = 0;
+		}
+	}
+
+	return (done) ? (int)done : rc;
+}
+VMM_EXPORT_SYMBOL(netstack_socket_recv_into);
+
 int netstack_socket_write(struct netstack_socket *sk, void *data, u16 len)
 {
 	err_t err;
@@ -705,25 +933,129 @@ static int lwip_can_receive(struct vmm_netport *port)
 	return FALSE;
 }
 
+static void lwip_rx_pbuf_free(struct pbuf *p)
+{
+	irq_flags_t flags;
+	struct lwip_rx_pbuf *rp = (struct lwip_rx_pbuf *)p;
+	struct vmm_mbuf *mbuf = rp->mbuf;
+
+	rp->mbuf = NULL;
+	vmm_spin_lock_irqsave(&lns.rx_lock, flags);
+	list_add_tail(&rp->head, &lns.rx_pbuf_free);
+	vmm_spin_unlock_irqrestore(&lns.rx_lock, flags);
+
+	m_freem(mbuf);
+}
+
+/* Wrap received mbuf in custom pbuf without copying packet data
+ *
+ * Note: lwIP updates some received packets in-place (ARP replies,
+ * IP reassembly, etc) whereas mbuf data might be shared with other
+ * netports hence only non-fragmented unicast IPv4 packets sent to
+ * us are wrapped. Upon success, mbuf is owned by the pbuf.
+ */
+static struct pbuf *lwip_rx_pbuf_wrap(struct lwip_netstack *lns,
+				      struct vmm_mbuf *mbuf)
+{
+	u16 len;
+	u8 *data;
+	irq_flags_t flags;
+	struct pbuf *p;
+	struct lwip_rx_pbuf *rp = NULL;
+
+	if (mbuf->m_next ||
+	    (mbuf->m_len < (SIZEOF_ETH_HDR + IP_HLEN))) {
+		return NULL;
+	}
+	data = mtod(mbuf, u8 *);
+	if (memcmp(data, lns->nif.hwaddr, ETHARP_HWADDR_LEN) ||
+	    (((u16)data[12] << 8 | data[13]) != ETHTYPE_IP) ||
+	    (((u16)data[SIZEOF_ETH_HDR + 6] << 8 |
+	      data[SIZEOF_ETH_HDR + 7]) & (IP_MF | IP_OFFMASK))) {
+		return NULL;
+	}
+
+	vmm_spin_lock_irqsave(&lns->rx_lock, flags);
+	if (!list_empty(&lns->rx_pbuf_free)) {
+		rp = list_entry(list_pop(&lns->rx_pbuf_free),
+				struct lwip_rx_pbuf, head);
+	}
+	vmm_spin_unlock_irqrestore(&lns->rx_lock, flags);
+	if (!rp) {
+		return NULL;
+	}
+
+	len = min(MAX_FRAME_LEN, mbuf->m_len);
+	rp->mbuf = mbuf;
+	rp->cp.custom_free_function = lwip_rx_pbuf_free;
+	p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF,
+				&rp->cp, data, len);
+	if (!p) {
+		rp->mbuf = NULL;
+		vmm_spin_lock_irqsave(&lns->rx_lock, flags);
+		list_add_tail(&rp->head, &lns->rx_pbuf_free);
+		vmm_spin_unlock_irqrestore(&lns->rx_lock, flags);
+	}
+
+	return p;
+}
+
+/* Process batch of received packets from tcpip thread */
+static void lwip_rx_batch(void *arg)
+{
+	irq_flags_t flags;
+	struct pbuf *p;
+	struct lwip_netstack *lns = arg;
+
+	while (1) {
+		vmm_spin_lock_irqsave(&lns->rx_lock, flags);
+		if (!lns->rx_count) {
+			lns->rx_pending = FALSE;
+			vmm_spin_unlock_irqrestore(&lns->rx_lock, flags);
+			break;
+		}
+		p = lns->rx_queue[lns->rx_head];
+		lns->rx_head = (lns->rx_head + 1) % RX_QUEUE_LEN;
+		lns->rx_count--;
+		vmm_spin_unlock_irqrestore(&lns->rx_lock, flags);
+
+		if (lns->nif.input(p, &lns->nif) != ERR_OK) {
+			pbuf_free(p);
+		}
+	}
+}
+
 static int lwip_switch2port_xfer(struct vmm_netport *port,
 			 	 struct vmm_mbuf *mbuf)
 {
 	u32 pbuf_len;
+	bool schedule;
+	irq_flags_t flags;
 	struct eth_hdr *ethhdr;
 	struct pbuf *p, *q;
 	struct lwip_netstack *lns = port->priv;
 	u32 lcopied = 0;
 
-	/* Move received packet into a new pbuf */
-	pbuf_len = min(MAX_FRAME_LEN, mbuf->m_pktlen);
-	p = pbuf_alloc(PBUF_LINK, pbuf_len, PBUF_POOL);
-	if (!p) {
-		return VMM_ENOMEM;
-	}
+	p = lwip_rx_pbuf_wrap(lns, mbuf);
+	if (p) {
+		/* mbuf is now owned by pbuf */
+		mbuf = NULL;
+	} else {
+		/* Move received packet into a new pbuf */
+		pbuf_len = min(MAX_FRAME_LEN, mbuf->m_pktlen);
+		p = pbuf_alloc(PBUF_LINK, pbuf_len, PBUF_POOL);
+		if (!p) {
+			m_freem(mbuf);
+			return VMM_ENOMEM;
+		}
+
+		for (q = p; q != NULL; q = q->next) {
+			m_copydata(mbuf, lcopied, q->len, q->payload);
+			lcopied += q->len;
+		}
 
-	for (q = p; q != NULL; q = q->next) {
-		m_copydata(mbuf, lcopied, q->len, q->payload);
-		lcopied += q->len;
+		/* Free the mbuf */
+		m_freem(mbuf);
 	}
 
 	/* Points to packet ethernet header */
@@ -733,19 +1065,34 @@ static int lwip_switch2port_xfer(struct vmm_netport *port,
 	switch (htons(ethhdr->type)) {
 	case ETHTYPE_IP:
 	case ETHTYPE_ARP:
-		if (lns->nif.input(p, &lns->nif) != ERR_OK) {
-			pbuf_free(p);
-			p = NULL;
-		}
 		break;
 	default:
 		pbuf_free(p);
-		p = NULL;
-		break;
+		return VMM_OK;
 	}
 
-	/* Free the mbuf */
-	m_freem(mbuf);
+	/* Queue packet for tcpip thread which processes all queued
+	 * packets in one go (i.e. one tcpip message per batch).
+	 */
+	vmm_spin_lock_irqsave(&lns->rx_lock, flags);
+	if (lns->rx_count == RX_QUEUE_LEN) {
+		vmm_spin_unlock_irqrestore(&lns->rx_lock, flags);
+		pbuf_free(p);
+		return VMM_OK;
+	}
+	lns->rx_queue[(lns->rx_head + lns->rx_count) % RX_QUEUE_LEN] = p;
+	lns->rx_count++;
+	schedule = !lns->rx_pending;
+	lns->rx_pending = TRUE;
+	vmm_spin_unlock_irqrestore(&lns->rx_lock, flags);
+
+	if (schedule &&
+	    (tcpip_callback_with_block(lwip_rx_batch, lns, 0) != ERR_OK)) {
+		/* Retry upon next received packet */
+		vmm_spin_lock_irqsave(&lns->rx_lock, flags);
+		lns->rx_pending = FALSE;
+		vmm_spin_unlock_irqrestore(&lns->rx_lock, flags);
+	}
 
 	/* Return success */
 	return VMM_OK;
@@ -833,6 +1180,13 @@ static int __init lwip_netstack_init(void)
 
 	/* Clear lwIP state */
 	memset(&lns, 0, sizeof(lns));
+	INIT_SPIN_LOCK(&lns.rx_lock);
+	INIT_LIST_HEAD(&lns.rx_pbuf_free);
+	INIT_SPIN_LOCK(&lns.sk_event_lock);
+	INIT_LIST_HEAD(&lns.sk_event_list);
+	for (rc = 0; rc < RX_PBUF_COUNT; rc++) {
+		list_add_tail(&lns.rx_pbufs[rc].head, &lns.rx_pbuf_free);
+	}
 
 	/* Get netstack device tree node if available */
 	node = vmm_devtree_getnode(VMM_DEVTREE_PATH_SEPARATOR_STRING
@@ -866,13 +1220,11 @@ static int __init lwip_netstack_init(void)
 		vmm_panic("%s: No netswitch found\n", __func__);
 	}
 
-	/* Release netstack device tree node */
-	vmm_devtree_dref_node(node);
-
 	/* Allocate a netport */
 	lns.port = vmm_netport_alloc("lwip-netport", VMM_NETPORT_DEF_QUEUE_SIZE);
 	if (!lns.port) {
 		vmm_printf("%s: vmm_netport_alloc() failed\n", __func__);
+		vmm_devtree_dref_node(node);
 		rc = VMM_ENOMEM;
 		goto fail;
 	}
@@ -883,6 +1235,12 @@ static int __init lwip_netstack_init(void)
 	lns.port->can_receive = lwip_can_receive;
 	lns.port->switch2port_xfer = lwip_switch2port_xfer;
 	lns.port->priv = &lns;
+	if (node) {
+		vmm_netport_qos_setup(lns.port, node);
+	}
+
+	/* Release netstack device tree node */
+	vmm_devtree_dref_node(node);
 
 	/* Register a netport */
 	rc = vmm_netport_register(lns.port);
@@ -28,7 +28,9 @@
  */
 
 #include <vmm_error.h>
+#include <vmm_heap.h>
 #include <vmm_stdio.h>
+#include <vmm_host_aspace.h>
 #include <vmm_modules.h>
 #include <libs/stringlib.h>
 #include <libs/vfs.h>
@@ -57,6 +59,29 @@ struct cpio_newc_header {
 	u8 c_check[8];
 } __packed;
 
+#define CPIO_INDEX_MIN_COUNT		64
+
+/* In-memory index entry for a cpio archive member */
+struct cpiofs_entry {
+	char *path;
+	u32 mode;
+	u32 mtime;
+	u32 size;
+	u64 data_off;
+};
+
+/* Per-mount cpio archive information */
+struct cpiofs_control {
+	/* Index of archive members built at mount time */
+	u32 count;
+	struct cpiofs_entry *ent;
+
+	/* Archive mapped in host memory when block device
+	 * is RAM backed (e.g. initrd) otherwise zero
+	 */
+	virtual_addr_t ram_va;
+};
+
 /* 
  * Helper routines 
  */
@@ -145,21 +170,145 @@ static bool check_path(const char *path, const char *prefix, const char *name)
 	return TRUE;
 }
 
+static u32 cpiofs_hex(const u8 *str)
+{
+	u8 buf[9];
+
+	memcpy(buf, str, 8);
+	buf[8] = '\0';
+
+	return strtoul((const char *)buf, NULL, 16);
+}
+
+static u64 cpiofs_devread(struct mount *m, struct cpiofs_control *ctrl,
+			  u8 *buf, u64 off, u64 len)
+{
+	u64 total = vmm_blockdev_total_size(m->m_dev);
+
+	if (!ctrl->ram_va) {
+		return vmm_blockdev_read(m->m_dev, buf, off, len);
+	}
+
+	/* RAM backed archive is read by pointer */
+	if (total <= off) {
+		return 0;
+	}
+	if ((total - off) < len) {
+		len = total - off;
+	}
+	memcpy(buf, (void *)(ctrl->ram_va + off), len);
+
+	return len;
+}
+
+static void cpiofs_free_index(struct cpiofs_control *ctrl)
+{
+	u32 i;
+
+	for (i = 0; i < ctrl->count; i++) {
+		vmm_free(ctrl->ent[i].path);
+	}
+	if (ctrl->ent) {
+		vmm_free(ctrl->ent);
+	}
+	ctrl->ent = NULL;
+	ctrl->count = 0;
+}
+
+static int cpiofs_build_index(struct mount *m, struct cpiofs_control *ctrl)
+{
+	u64 off = 0;
+	u32 size, name_size, mode, mtime, max = 0;
+	struct cpio_newc_header header;
+	struct cpiofs_entry *ent;
+	char path[VFS_MAX_PATH];
+
+	while (1) {
+		if (cpiofs_devread(m, ctrl, (u8 *)&header, off,
+			sizeof(header)) != sizeof(header)) {
+			return VMM_EIO;
+		}
+
+		if (strncmp((const char *)header.c_magic, "070701", 6) != 0) {
+			return VMM_EINVALID;
+		}
+
+		size = cpiofs_hex(header.c_filesize);
+		name_size = cpiofs_hex(header.c_namesize);
+		mode = cpiofs_hex(header.c_mode);
+		mtime = cpiofs_hex(header.c_mtime);
+
+		if (!name_size || (VFS_MAX_PATH < name_size)) {
+			return VMM_EINVALID;
+		}
+
+		if (cpiofs_devread(m, ctrl, (u8 *)path, off + sizeof(header),
+				   name_size) != name_size) {
+			return VMM_EIO;
+		}
+		path[name_size - 1] = '\0';
+
+		if ((size == 0) && (mode == 0) && (name_size == 11) &&
+		    (strncmp(path, "TRAILER!!!", 10) == 0)) {
+			break;
+		}
+
+		off += sizeof(header);
+		off += (((name_size + 1) & ~3) + 2);
+
+		if (path[0] != '.') {
+			if (ctrl->count == max) {
+				max = (max) ? (max * 2) : CPIO_INDEX_MIN_COUNT;
+				ent = vmm_zalloc(max * sizeof(*ent));
+				if (!ent) {
+					return VMM_ENOMEM;
+				}
+				if (ctrl->ent) {
+					memcpy(ent, ctrl->ent,
+					       ctrl->count * sizeof(*ent));
+					vmm_free(ctrl->ent);
+				}
+				ctrl->ent = ent;
+			}
+
+			ent = &ctrl->ent[ctrl->count];
+			ent->path = vmm_malloc(name_size);
+			if (!ent->path) {
+				return VMM_ENOMEM;
+			}
+			strcpy(ent->path, path);
+			ent->mode = mode;
+			ent->mtime = mtime;
+			ent->size = size;
+			ent->data_off = off;
+			ctrl->count++;
+		}
+
+		off += size;
+		off = (off + 3) & ~0x3;
+	}
+
+	return VMM_OK;
+}
+
 /* 
  * Mount point operations 
  */
 
 static int cpiofs_mount(struct mount *m, const char *dev, u32 flags)
 {
-	u64 read_count;
+	int rc;
+	u64 read_count, total;
+	physical_addr_t pa;
 	struct cpio_newc_header header;
+	struct cpiofs_control *ctrl;
 
 	if (dev == NULL) {
 		return VMM_EINVALID;
 	}
 
-	if (vmm_blockdev_total_size(m->m_dev) <= 
-				sizeof(struct cpio_newc_header)) {
+	total = vmm_blockdev_total_size(m->m_dev);
+	if (total <= sizeof(struct cpio_newc_header)) {
 		return VMM_EFAIL;
 	}
 
@@ -173,15 +322,45 @@ static int cpiofs_mount(struct mount *m, const char *dev, u32 flags)
 		return VMM_EINVALID;
 	}
 
+	ctrl = vmm_zalloc(sizeof(*ctrl));
+	if (!ctrl) {
+		return VMM_ENOMEM;
+	}
+
+	/* Archive on RAM backed block device is accessed in-place */
+	if (vmm_blockdev_direct_access(m->m_dev, 0, total, &pa) == VMM_OK) {
+		ctrl->ram_va = vmm_host_memmap(pa, total,
+					       VMM_MEMORY_FLAGS_NORMAL);
+	}
+
+	rc = cpiofs_build_index(m, ctrl);
+	if (rc) {
+		cpiofs_free_index(ctrl);
+		if (ctrl->ram_va) {
+			vmm_host_memunmap(ctrl->ram_va);
+		}
+		vmm_free(ctrl);
+		return rc;
+	}
+
 	m->m_flags = MOUNT_RDONLY; /* We treat CPIO filesystem as read-only */
 	m->m_root->v_data = NULL;
-	m->m_data = NULL;
+	m->m_data = ctrl;
 
 	return VMM_OK;
 }
 
 static int cpiofs_unmount(struct mount *m)
 {
+	struct cpiofs_control *ctrl = m->m_data;
+
+	if (ctrl) {
+		cpiofs_free_index(ctrl);
+		if (ctrl->ram_va) {
+			vmm_host_memunmap(ctrl->ram_va);
+		}
+		vmm_free(ctrl);
+	}
 	m->m_data = NULL;
 
 	return VMM_OK;
@@ -211,10 +390,10 @@ static int cpiofs_vput(struct mount *m, struct vnode *v)
 
 static size_t cpiofs_read(struct vnode *v, loff_t off, void *buf, size_t len)
 {
-	u64 toff;
 	size_t sz = 0;
+	struct cpiofs_entry *ent = v->v_data;
 
-	if (v->v_type != VREG) {
+	if ((v->v_type != VREG) || !ent) {
 		return 0;
 	}
 
@@ -227,10 +406,8 @@ static size_t cpiofs_read(struct vnode *v, loff_t off, void *buf, size_t len)
 		sz = v->v_size - off;
 	}
 
-	toff = (u64)((u32)(v->v_data));
-	sz = vmm_blockdev_read(v->v_mount->m_dev, (u8 *)buf, (toff + off), sz);
-
-	return sz;
+	return cpiofs_devread(v->v_mount, v->v_mount->m_data,
+			      (u8 *)buf, ent->data_off + off, sz);
 }
 
 static size_t cpiofs_write(struct vnode *v, loff_t off, void *buf, size_t len)
@@ -253,64 +430,24 @@ static int cpiofs_sync(struct vnode *v)
 
 static int cpiofs_readdir(struct vnode *dv, loff_t off, struct dirent *d)
 {
-	struct cpio_newc_header header;
-	char path[VFS_MAX_PATH];
+	u32 e, mode = 0;
 	char name[VFS_MAX_NAME];
-	u32 size, name_size, mode;
-	u64 toff = 0, rd;
-	char buf[9];
+	struct cpiofs_control *ctrl = dv->v_mount->m_data;
 	int i = 0;
 
-	while (1) {
-		rd = vmm_blockdev_read(dv->v_mount->m_dev, (u8 *)&header, 
-				toff, sizeof(struct cpio_newc_header));
-		if (!rd) {
-			return VMM_EIO;
-		}
-
-		if (strncmp((const char *)&header.c_magic, "070701", 6) != 0) {
-			return VMM_ENOENT;
-		}
-
-		buf[8] = '\0';
-
-		memcpy(buf, &header.c_filesize, 8);
-		size = strtoul((const char *)buf, NULL, 16);
-
-		memcpy(buf, &header.c_namesize, 8);
-		name_size = strtoul((const char *)buf, NULL, 16);
-
-		memcpy(buf, &header.c_mode, 8);
-		mode = strtoul((const char *)buf, NULL, 16);
-
-		rd = vmm_blockdev_read(dv->v_mount->m_dev, (u8 *)path, 
-		toff + sizeof(struct cpio_newc_header), name_size);
-		if (!rd) {
-			return VMM_EIO;
-		}
-
-		if ((size == 0) && (mode == 0) && (name_size == 11) && 
-		    (strncmp(path, "TRAILER!!!", 10) == 0)) {
-			return VMM_ENOENT;
-		}
-
-		toff += sizeof(struct cpio_newc_header); 
-		toff += (((name_size + 1) & ~3) + 2) + size;
-		toff = (toff + 3) & ~3;
-
-		if (path[0] == '.') {
-			continue;
-		}
-
-		if (!get_next_token(path, dv->v_path, name)) {
+	for (e = 0; e < ctrl->count; e++) {
+		if (!get_next_token(ctrl->ent[e].path, dv->v_path, name)) {
 			continue;
 		}
 
 		if (i++ == off) {
-			toff = 0;
+			mode = ctrl->ent[e].mode;
 			break;
 		}
 	}
+	if (e == ctrl->count) {
+		return VMM_ENOENT;
+	}
 
 	if ((mode & 00170000) == 0140000) {
 		d->d_type = DT_SOCK;
@@ -341,57 +478,23 @@ static int cpiofs_readdir(struct vnode *dv, loff_t off, struct dirent *d)
 
 static int cpiofs_lookup(struct vnode *dv, const char *name, struct vnode *v)
 {
-	struct cpio_newc_header header;
-	char path[VFS_MAX_PATH];
-	u32 size, name_size, mode, mtime;
-	u64 off = 0, rd;
-	u8 buf[9];
+	u32 e, mode, mtime;
+	struct cpiofs_entry *ent = NULL;
+	struct cpiofs_control *ctrl = dv->v_mount->m_data;
 
-	while (1) {
-		rd = vmm_blockdev_read(dv->v_mount->m_dev, (u8 *)&header, 
-					off, sizeof(struct cpio_newc_header));
-		if (!rd) {
-			return VMM_EIO;
-		}
-
-		if (strncmp((const char *)header.c_magic, "070701", 6) != 0) {
-			return VMM_ENOENT;
-		}
-
-		buf[8] = '\0';
-
-		memcpy(buf, &header.c_filesize, 8);
-		size = strtoul((const char *)buf, NULL, 16);
-
-		memcpy(buf, &header.c_namesize, 8);
-		name_size = strtoul((const char *)buf, NULL, 16);
-
-		memcpy(buf, &header.c_mode, 8);
-		mode = strtoul((const char *)buf, NULL, 16);
-
-		memcpy(buf, &header.c_mtime, 8);
-		mtime = strtoul((const char *)buf, NULL, 16);
-
-		rd = vmm_blockdev_read(dv->v_mount->m_dev, (u8 *)path, 
-			off + sizeof(struct cpio_newc_header), name_size);
-		if (!rd) {
-			return VMM_EIO;
-		}
-
-		if ((size == 0) && (mode == 0) && (name_size == 11) && 
-		    (strncmp(path, "TRAILER!!!", 10) == 0)) {
-			return VMM_ENOENT;
-		}
-
-		if ((path[0] != '.') && check_path(path, dv->v_path, name)) {
+	for (e = 0; e < ctrl->count; e++) {
+		if (check_path(ctrl->ent[e].path, dv->v_path, name)) {
+			ent = &ctrl->ent[e];
 			break;
 		}
-
-		off += sizeof(struct cpio_newc_header);
-		off += (((name_size + 1) & ~3) + 2) + size;
-		off = (off + 3) & ~0x3;
+	}
+	if (!ent) {
+		return VMM_ENOENT;
 	}
 
+	mode = ent->mode;
+	mtime = ent->mtime;
+
 	v->v_atime = mtime;
 	v->v_mtime = mtime;
 	v->v_ctime = mtime;
@@ -433,11 +536,8 @@ static int cpiofs_lookup(struct vnode *dv, const char *name, struct vnode *v)
 	v->v_mode |= (mode & 00002) ? S_IWOTH : 0;
 	v->v_mode |= (mode & 00001) ? S_IXOTH : 0;
 
-	v->v_size = size;
-
-	off += sizeof(struct cpio_newc_header);
-	off += (((name_size + 1) & ~3) + 2);
-	v->v_data = (void *)((u32)off);
+	v->v_size = ent->size;
+	v->v_data = ent;
 
 	return 0;
 }
@@ -479,6 +579,26 @@ static int cpiofs_chmod(struct vnode *v, u32 mode)
 	return VMM_EFAIL;
 }
 
+static int cpiofs_bmap(struct vnode *v, loff_t off,
+		       u64 *dev_off, size_t *len)
+{
+	struct cpiofs_entry *ent = v->v_data;
+
+	if ((v->v_type != VREG) || !ent) {
+		return VMM_EINVALID;
+	}
+
+	if (off >= v->v_size) {
+		return VMM_ERANGE;
+	}
+
+	/* File data is always contiguous in cpio archive */
+	*dev_off = ent->data_off + off;
+	*len = v->v_size - off;
+
+	return VMM_OK;
+}
+
 /* cpiofs filesystem */
 static struct filesystem cpiofs = {
 	.name		= "cpio",
@@ -503,6 +623,7 @@ static struct filesystem cpiofs = {
 	.mkdir		= cpiofs_mkdir,
 	.rmdir		= cpiofs_rmdir,
 	.chmod		= cpiofs_chmod,
+	.bmap		= cpiofs_bmap,
 };
 
 static int __init cpiofs_init(void)
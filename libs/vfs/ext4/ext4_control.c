@@ -34,7 +34,7 @@ u32 ext4fs_current_timestamp(void)
 {
 	struct vmm_timeval tv;
 
-	vmm_wallclock_get_local_time(&tv);
+	vmm_wallclock_get_local_time_coarse(&tv);
 
 	return (u32)tv.tv_sec;
 }
@@ -65,12 +65,103 @@ int ext4fs_devwrite(struct ext4fs_control *ctrl,
 	return (len == buf_len) ? VMM_OK : VMM_EIO;
 }
 
+/* Load group descriptor on first use
+ * Note: Must be called with group lock held
+ */
+static int __ext4fs_control_load_group(struct ext4fs_control *ctrl, u32 g)
+{
+	int rc;
+	u32 blkno, blkoff, desc_per_blk;
+	struct ext4fs_group *group = &ctrl->groups[g];
+
+	if (group->grp_loaded) {
+		return VMM_OK;
+	}
+
+	desc_per_blk = udiv32(ctrl->block_size, 
+					sizeof(struct ext2_block_group));
+	blkno = ctrl->group_table_blkno + udiv32(g, desc_per_blk);
+	blkoff = umod32(g, desc_per_blk) * sizeof(struct ext2_block_group);
+	rc = ext4fs_devread(ctrl, blkno, blkoff, 
+			    sizeof(struct ext2_block_group), 
+			    (char *)&group->grp);
+	if (rc) {
+		return rc;
+	}
+
+	group->grp_loaded = TRUE;
+
+	return VMM_OK;
+}
+
+/* Load group block and inode bitmaps on first use
+ * Note: Must be called with group lock held
+ */
+static int __ext4fs_control_load_bmaps(struct ext4fs_control *ctrl, u32 g)
+{
+	int rc;
+	struct ext4fs_group *group = &ctrl->groups[g];
+
+	rc = __ext4fs_control_load_group(ctrl, g);
+	if (rc) {
+		return rc;
+	}
+
+	if (!group->block_bmap) {
+		group->block_bmap = vmm_zalloc(ctrl->block_size);
+		if (!group->block_bmap) {
+			return VMM_ENOMEM;
+		}
+		rc = ext4fs_devread(ctrl, __le32(group->grp.block_bmap_id),
+				    0, ctrl->block_size,
+				    (char *)group->block_bmap);
+		if (rc) {
+			vmm_free(group->block_bmap);
+			group->block_bmap = NULL;
+			return rc;
+		}
+	}
+
+	if (!group->inode_bmap) {
+		group->inode_bmap = vmm_zalloc(ctrl->block_size);
+		if (!group->inode_bmap) {
+			return VMM_ENOMEM;
+		}
+		rc = ext4fs_devread(ctrl, __le32(group->grp.inode_bmap_id),
+				    0, ctrl->block_size,
+				    (char *)group->inode_bmap);
+		if (rc) {
+			vmm_free(group->inode_bmap);
+			group->inode_bmap = NULL;
+			return rc;
+		}
+	}
+
+	return VMM_OK;
+}
+
+/* Get first block of inode table of a group */
+static int ext4fs_control_inode_table(struct ext4fs_control *ctrl,
+				      u32 g, u32 *blkno)
+{
+	int rc;
+	struct ext4fs_group *group = &ctrl->groups[g];
+
+	vmm_mutex_lock(&group->grp_lock);
+	rc = __ext4fs_control_load_group(ctrl, g);
+	if (!rc) {
+		*blkno = __le32(group->grp.inode_table_id);
+	}
+	vmm_mutex_unlock(&group->grp_lock);
+
+	return rc;
+}
+
 int ext4fs_control_read_inode(struct ext4fs_control *ctrl, 
 			      u32 inode_no, struct ext2_inode *inode)
 {
 	int rc;
-	u32 g, blkno, blkoff;
-	struct ext4fs_group *group;
+	u32 g, blkno, blkoff, table;
 
 	/* inodes are addressed from 1 onwards */
 	inode_no--;
@@ -80,11 +171,14 @@ int ext4fs_control_read_inode(struct ext4fs_control *ctrl,
 	if (g >= ctrl->group_count) {
 		return VMM_EINVALID;
 	}
-	group = &ctrl->groups[g];
+	rc = ext4fs_control_inode_table(ctrl, g, &table);
+	if (rc) {
+		return rc;
+	}
 
 	blkno = umod32(inode_no, __le32(ctrl->sblock.inodes_per_group));
 	blkno = udiv32(blkno, ctrl->inodes_per_block);
-	blkno += __le32(group->grp.inode_table_id);
+	blkno += table;
 	blkoff = umod32(inode_no, ctrl->inodes_per_block) * ctrl->inode_size;
 
 	/* read the inode.  */
@@ -101,8 +195,7 @@ int ext4fs_control_write_inode(struct ext4fs_control *ctrl,
 			       u32 inode_no, struct ext2_inode *inode)
 {
 	int rc;
-	u32 g, blkno, blkoff;
-	struct ext4fs_group *group;
+	u32 g, blkno, blkoff, table;
 
 	/* inodes are addressed from 1 onwards */
 	inode_no--;
@@ -112,11 +205,14 @@ int ext4fs_control_write_inode(struct ext4fs_control *ctrl,
 	if (g >= ctrl->group_count) {
 		return VMM_EINVALID;
 	}
-	group = &ctrl->groups[g];
+	rc = ext4fs_control_inode_table(ctrl, g, &table);
+	if (rc) {
+		return rc;
+	}
 
 	blkno = umod32(inode_no, __le32(ctrl->sblock.inodes_per_group));
 	blkno = udiv32(blkno, ctrl->inodes_per_block);
-	blkno += __le32(group->grp.inode_table_id);
+	blkno += table;
 	blkoff = umod32(inode_no, ctrl->inodes_per_block) * ctrl->inode_size;
 
 	/* write the inode.  */
@@ -152,7 +248,12 @@ int ext4fs_control_alloc_block(struct ext4fs_control *ctrl,
 		group = &ctrl->groups[g];
 
 		vmm_mutex_lock(&group->grp_lock);
-		if (__le16(group->grp.free_blocks)) {
+		if (__ext4fs_control_load_group(ctrl, g)) {
+			vmm_mutex_unlock(&group->grp_lock);
+			goto next_group;
+		}
+		if (__le16(group->grp.free_blocks) &&
+		    !__ext4fs_control_load_bmaps(ctrl, g)) {
 			for (b = 0; b < blocks_per_group; b++) {
 				if (group->block_bmap[b >> 3] &
 				    (1 << (b & 0x7))) {
@@ -201,6 +302,7 @@ next_group:
 
 int ext4fs_control_free_block(struct ext4fs_control *ctrl, u32 blkno) 
 {
+	int rc;
 	u32 g, b;
 	struct ext4fs_group *group;
 
@@ -216,6 +318,13 @@ int ext4fs_control_free_block(struct ext4fs_control *ctrl, u32 blkno)
 	}
 	group = &ctrl->groups[g];
 
+	vmm_mutex_lock(&group->grp_lock);
+	rc = __ext4fs_control_load_bmaps(ctrl, g);
+	vmm_mutex_unlock(&group->grp_lock);
+	if (rc) {
+		return rc;
+	}
+
 	/* update superblock */
 	vmm_mutex_lock(&ctrl->sblock_lock);
 	ctrl->sblock.free_blocks = __le32((__le32(ctrl->sblock.free_blocks) + 1));
@@ -256,7 +365,12 @@ int ext4fs_control_alloc_inode(struct ext4fs_control *ctrl,
 		group = &ctrl->groups[g];
 
 		vmm_mutex_lock(&group->grp_lock);
-		if (__le16(group->grp.free_inodes)) {
+		if (__ext4fs_control_load_group(ctrl, g)) {
+			vmm_mutex_unlock(&group->grp_lock);
+			goto next_group;
+		}
+		if (__le16(group->grp.free_inodes) &&
+		    !__ext4fs_control_load_bmaps(ctrl, g)) {
 			for (i = 0; i < inodes_per_group; i++) {
 				if (group->inode_bmap[i >> 3] & 
 				    (1 << (i & 0x7))) {
@@ -304,6 +418,7 @@ next_group:
 
 int ext4fs_control_free_inode(struct ext4fs_control *ctrl, u32 inode_no)
 {
+	int rc;
 	u32 g, i;
 	struct ext4fs_group *group;
 
@@ -317,6 +432,13 @@ int ext4fs_control_free_inode(struct ext4fs_control *ctrl, u32 inode_no)
 	}
 	group = &ctrl->groups[g];
 
+	vmm_mutex_lock(&group->grp_lock);
+	rc = __ext4fs_control_load_bmaps(ctrl, g);
+	vmm_mutex_unlock(&group->grp_lock);
+	if (rc) {
+		return rc;
+	}
+
 	/* update superblock */
 	vmm_mutex_lock(&ctrl->sblock_lock);
 	ctrl->sblock.free_inodes = 
@@ -425,7 +547,7 @@ int ext4fs_control_init(struct ext4fs_control *ctrl,
 {
 	int rc;
 	u64 sb_read;
-	u32 g, blkno, blkoff, desc_per_blk;
+	u32 g;
 
 	/* Save underlying block device pointer */
 	ctrl->bdev = bdev;
@@ -484,69 +606,18 @@ int ext4fs_control_init(struct ext4fs_control *ctrl,
 		rc = VMM_ENOMEM;
 		goto fail;
 	}
-	desc_per_blk = udiv32(ctrl->block_size, 
-					sizeof(struct ext2_block_group));
+
+	/* Group descriptors and bitmaps are loaded on first use
+	 * so that mounting large filesystems is fast.
+	 */
 	for (g = 0; g < ctrl->group_count; g++) {
-		/* Init group lock */
 		INIT_MUTEX(&ctrl->groups[g].grp_lock);
-
-		/* Load descriptor */
-		blkno = ctrl->group_table_blkno + udiv32(g, desc_per_blk);
-		blkoff = umod32(g, desc_per_blk) * 
-					sizeof(struct ext2_block_group);
-		rc = ext4fs_devread(ctrl, blkno, blkoff, 
-				    sizeof(struct ext2_block_group), 
-				    (char *)&ctrl->groups[g].grp);
-		if (rc) {
-			goto fail1;
-		}
-
-		/* Load group block bitmap */
-		ctrl->groups[g].block_bmap = vmm_zalloc(ctrl->block_size);
-		if (!ctrl->groups[g].block_bmap) {
-			rc = VMM_ENOMEM;
-			goto fail1;
-		}
-		blkno = __le32(ctrl->groups[g].grp.block_bmap_id);
-		blkoff = 0;
-		rc = ext4fs_devread(ctrl, blkno, blkoff, ctrl->block_size, 
-				    (char *)ctrl->groups[g].block_bmap);
-		if (rc) {
-			goto fail1;
-		}
-
-		/* Load group inode bitmap */
-		ctrl->groups[g].inode_bmap = vmm_zalloc(ctrl->block_size);
-		if (!ctrl->groups[g].inode_bmap) {
-			rc = VMM_ENOMEM;
-			goto fail1;
-		}
-		blkno = __le32(ctrl->groups[g].grp.inode_bmap_id);
-		blkoff = 0;
-		rc = ext4fs_devread(ctrl, blkno, blkoff, ctrl->block_size, 
-				    (char *)ctrl->groups[g].inode_bmap);
-		if (rc) {
-			goto fail1;
-		}
-
-		/* Clear grp_dirty flag */
+		ctrl->groups[g].grp_loaded = FALSE;
 		ctrl->groups[g].grp_dirty = FALSE;
 	}
 
 	return VMM_OK;
 
-fail1:
-	for (g = 0; g < ctrl->group_count; g++) {
-		if (ctrl->groups[g].block_bmap) {
-			vmm_free(ctrl->groups[g].block_bmap);
-			ctrl->groups[g].block_bmap = NULL;
-		}
-		if (ctrl->groups[g].inode_bmap) {
-			vmm_free(ctrl->groups[g].inode_bmap);
-			ctrl->groups[g].inode_bmap = NULL;
-		}
-	}
-	vmm_free(ctrl->groups);
 fail:
 	return rc;
 }
@@ -38,6 +38,8 @@ struct ext4fs_group {
 	struct vmm_mutex grp_lock;
 	struct ext2_block_group grp;
 
+	/* Descriptor and bitmaps are loaded on first use */
+	bool grp_loaded;
 	u8 *block_bmap;
 	u8 *inode_bmap;
 
@@ -668,6 +668,27 @@ static int ext4fs_chmod(struct vnode *v, u32 mode)
 	return VMM_OK;
 }
 
+static int ext4fs_bmap(struct vnode *v, loff_t off,
+		       u64 *dev_off, size_t *len)
+{
+	int rc;
+	u64 blen;
+	struct ext4fs_node *node = v->v_data;
+
+	if (!node) {
+		return VMM_EFAIL;
+	}
+
+	rc = ext4fs_node_bmap(node, off, dev_off, &blen);
+	if (rc) {
+		return rc;
+	}
+
+	*len = blen;
+
+	return VMM_OK;
+}
+
 /* ext4fs filesystem */
 static struct filesystem ext4fs = {
 	.name		= "ext4",
@@ -692,6 +713,7 @@ static struct filesystem ext4fs = {
 	.mkdir		= ext4fs_mkdir,
 	.rmdir		= ext4fs_rmdir,
 	.chmod		= ext4fs_chmod,
+	.bmap		= ext4fs_bmap,
 };
 
 static int __init ext4fs_init(void)
@@ -204,6 +204,152 @@ int ext4fs_node_sync(struct ext4fs_node *node)
 	return VMM_OK;
 }
 
+static void ext4fs_node_extent_cache_add(struct ext4fs_node *node,
+					 u32 lblk, u32 len, u32 pblk)
+{
+	struct ext4fs_extent_cache *ec;
+
+	ec = &node->extent_cache[node->extent_victim];
+	ec->lblk = lblk;
+	ec->len = len;
+	ec->pblk = pblk;
+
+	node->extent_victim++;
+	if (node->extent_victim == EXT4_NODE_EXTENT_CACHE_SIZE) {
+		node->extent_victim = 0;
+	}
+}
+
+static void ext4fs_node_extent_cache_flush(struct ext4fs_node *node)
+{
+	int idx;
+
+	node->extent_victim = 0;
+	for (idx = 0; idx < EXT4_NODE_EXTENT_CACHE_SIZE; idx++) {
+		node->extent_cache[idx].len = 0;
+	}
+}
+
+/* Find physical block of given logical block and number of
+ * logical blocks from there onwards which are contiguous on disk
+ * (or hole) by walking extent tree of node.
+ */
+int ext4fs_node_read_extent(struct ext4fs_node *node, u32 blkpos,
+			    u32 *blkno, u32 *blkcnt)
+{
+	int rc, idx;
+	u32 i, depth, leaf, next = 0xFFFFFFFF;
+	struct ext4_extent_header *eh;
+	struct ext4_extent_idx *ei;
+	struct ext4_extent *ex;
+	struct ext4fs_extent_cache *ec;
+	struct ext4fs_control *ctrl = node->ctrl;
+
+	for (idx = 0; idx < EXT4_NODE_EXTENT_CACHE_SIZE; idx++) {
+		ec = &node->extent_cache[idx];
+		if (ec->len && (ec->lblk <= blkpos) &&
+		    ((blkpos - ec->lblk) < ec->len)) {
+			*blkno = (ec->pblk) ? ec->pblk + (blkpos - ec->lblk) : 0;
+			*blkcnt = ec->len - (blkpos - ec->lblk);
+			return VMM_OK;
+		}
+	}
+
+	eh = (struct ext4_extent_header *)node->inode.b.symlink;
+	if (__le16(eh->magic) != EXT4_EXTENT_MAGIC) {
+		return VMM_EINVALID;
+	}
+	depth = __le16(eh->depth);
+
+	while (depth) {
+		/* Last index starting at or before given block */
+		ei = (struct ext4_extent_idx *)(eh + 1);
+		for (i = 0; i < __le16(eh->entries); i++) {
+			if (blkpos < __le32(ei[i].block)) {
+				break;
+			}
+		}
+		if (i < __le16(eh->entries) &&
+		    __le32(ei[i].block) < next) {
+			next = __le32(ei[i].block);
+		}
+		if (!i) {
+			/* Hole before first index */
+			goto hole;
+		}
+		if (__le16(ei[i - 1].leaf_hi)) {
+			return VMM_EINVALID;
+		}
+		leaf = __le32(ei[i - 1].leaf_lo);
+
+		if (!node->extent_block) {
+			node->extent_block = vmm_malloc(ctrl->block_size);
+			if (!node->extent_block) {
+				return VMM_ENOMEM;
+			}
+			node->extent_blkno = 0;
+		}
+		if (node->extent_blkno != leaf) {
+			rc = ext4fs_devread(ctrl, leaf, 0,
+				ctrl->block_size, (char *)node->extent_block);
+			if (rc) {
+				node->extent_blkno = 0;
+				return rc;
+			}
+			node->extent_blkno = leaf;
+		}
+
+		eh = (struct ext4_extent_header *)node->extent_block;
+		if ((__le16(eh->magic) != EXT4_EXTENT_MAGIC) ||
+		    (__le16(eh->depth) != (depth - 1))) {
+			return VMM_EINVALID;
+		}
+		depth--;
+	}
+
+	/* Last extent starting at or before given block */
+	ex = (struct ext4_extent *)(eh + 1);
+	for (i = 0; i < __le16(eh->entries); i++) {
+		if (blkpos < __le32(ex[i].block)) {
+			break;
+		}
+	}
+	if (i < __le16(eh->entries) &&
+	    __le32(ex[i].block) < next) {
+		next = __le32(ex[i].block);
+	}
+	if (i) {
+		u32 lblk = __le32(ex[i - 1].block);
+		u32 len = __le16(ex[i - 1].len);
+		u32 pblk = __le32(ex[i - 1].start_lo);
+		bool uninit = FALSE;
+
+		if (len > EXT4_EXTENT_INIT_MAX_LEN) {
+			len -= EXT4_EXTENT_INIT_MAX_LEN;
+			uninit = TRUE;
+		}
+		if ((blkpos - lblk) < len) {
+			if (__le16(ex[i - 1].start_hi)) {
+				return VMM_EINVALID;
+			}
+			if (uninit) {
+				pblk = 0;
+			}
+			ext4fs_node_extent_cache_add(node, lblk, len, pblk);
+			*blkno = (pblk) ? pblk + (blkpos - lblk) : 0;
+			*blkcnt = len - (blkpos - lblk);
+			return VMM_OK;
+		}
+	}
+
+hole:
+	ext4fs_node_extent_cache_add(node, blkpos, next - blkpos, 0);
+	*blkno = 0;
+	*blkcnt = next - blkpos;
+
+	return VMM_OK;
+}
+
 int ext4fs_node_read_blkno(struct ext4fs_node *node, u32 blkpos, u32 *blkno)
 {
 	int rc;
@@ -211,6 +357,11 @@ int ext4fs_node_read_blkno(struct ext4fs_node *node, u32 blkpos, u32 *blkno)
 	struct ext2_inode *inode = &node->inode;
 	struct ext4fs_control *ctrl = node->ctrl;
 
+	if (__le32(inode->flags) & EXT4_EXTENTS_FL) {
+		u32 blkcnt;
+		return ext4fs_node_read_extent(node, blkpos, blkno, &blkcnt);
+	}
+
 	if (blkpos < ctrl->dir_blklast) {
 		/* Direct blocks.  */
 		*blkno = __le32(inode->b.blocks.dir_blocks[blkpos]);
@@ -292,6 +443,11 @@ int ext4fs_node_write_blkno(struct ext4fs_node *node, u32 blkpos, u32 blkno)
 	struct ext2_inode *inode = &node->inode;
 	struct ext4fs_control *ctrl = node->ctrl;
 
+	/* Allocating blocks in extent tree is not supported */
+	if (__le32(inode->flags) & EXT4_EXTENTS_FL) {
+		return VMM_EOPNOTSUPP;
+	}
+
 	if (blkpos < ctrl->dir_blklast) {
 		/* Direct blocks.  */
 		inode->b.blocks.dir_blocks[blkpos] = __le32(blkno);
@@ -382,12 +538,93 @@ int ext4fs_node_write_blkno(struct ext4fs_node *node, u32 blkpos, u32 blkno)
 	return VMM_OK;
 }
 
+/* Grow readahead window upon sequential reads and asynchronously
+ * read blocks of window into block device page cache whenever less
+ * than half of window is left ahead of current read.
+ */
+static void ext4fs_node_readahead(struct ext4fs_node *node, u64 pos, u32 len)
+{
+	int rc;
+	u64 start, end, filesize = ext4fs_node_get_size(node);
+	u32 i, blkpos, last_blkpos, blkno, blkcnt, nblkno;
+	struct ext4fs_control *ctrl = node->ctrl;
+
+	if (pos != node->ra_next) {
+		node->ra_next = pos + len;
+		node->ra_end = 0;
+		node->ra_size = 0;
+		return;
+	}
+	node->ra_next = pos + len;
+
+	if (!node->ra_size) {
+		node->ra_size = EXT4_NODE_RA_MIN_SIZE;
+	} else if (node->ra_size < EXT4_NODE_RA_MAX_SIZE) {
+		node->ra_size *= 2;
+	}
+
+	start = (node->ra_end < (pos + len)) ? (pos + len) : node->ra_end;
+	end = pos + len + node->ra_size;
+	if (filesize < end) {
+		end = filesize;
+	}
+	if ((end <= start) || ((start - (pos + len)) > (node->ra_size / 2))) {
+		return;
+	}
+
+	/* Note: div result < 32-bit */
+	blkpos = udiv64(start, ctrl->block_size);
+	last_blkpos = udiv64(end + ctrl->block_size - 1, ctrl->block_size);
+
+	while (blkpos < last_blkpos) {
+		if (__le32(node->inode.flags) & EXT4_EXTENTS_FL) {
+			rc = ext4fs_node_read_extent(node, blkpos,
+						     &blkno, &blkcnt);
+			if (rc) {
+				break;
+			}
+			if ((last_blkpos - blkpos) < blkcnt) {
+				blkcnt = last_blkpos - blkpos;
+			}
+		} else {
+			rc = ext4fs_node_read_blkno(node, blkpos, &blkno);
+			if (rc) {
+				break;
+			}
+			for (i = 1; (blkpos + i) < last_blkpos; i++) {
+				rc = ext4fs_node_read_blkno(node, blkpos + i,
+							    &nblkno);
+				if (rc || !blkno || (nblkno != (blkno + i))) {
+					break;
+				}
+			}
+			blkcnt = i;
+		}
+
+		if (blkno) {
+			rc = vmm_blockdev_readahead(ctrl->bdev,
+				(u64)blkno << (ctrl->log2_block_size +
+						EXT2_SECTOR_BITS),
+				(u64)blkcnt * ctrl->block_size);
+			if (rc) {
+				break;
+			}
+		}
+
+		blkpos += blkcnt;
+	}
+
+	node->ra_end = (u64)blkpos * ctrl->block_size;
+}
+
 /* Note: Node position has to be 64-bit */
 u32 ext4fs_node_read(struct ext4fs_node *node, u64 pos, u32 len, char *buf)
 {
 	int rc;
 	u64 filesize = ext4fs_node_get_size(node);
-	u32 i, rlen, blkno, blkoff, blklen;
+	u32 i, rlen, blkno, blkcnt, blkoff, blklen, nblkno, blkrun;
+	bool extents = (__le32(node->inode.flags) & EXT4_EXTENTS_FL) ?
+								TRUE : FALSE;
 	u32 last_blkpos, last_blklen;
 	u32 first_blkpos, first_blkoff, first_blklen;
 	struct ext4fs_control *ctrl = node->ctrl;
@@ -411,10 +648,17 @@ u32 ext4fs_node_read(struct ext4fs_node *node, u64 pos, u32 len, char *buf)
 	last_blkpos = udiv64((len + pos), ctrl->block_size); 
 	last_blklen = (len + pos) - (last_blkpos * ctrl->block_size);
 
+	ext4fs_node_readahead(node, pos, len);
+
 	rlen = len;
 	i = first_blkpos;
 	while (rlen) {
-		rc = ext4fs_node_read_blkno(node, i, &blkno);
+		if (extents) {
+			rc = ext4fs_node_read_extent(node, i, &blkno, &blkcnt);
+		} else {
+			rc = ext4fs_node_read_blkno(node, i, &blkno);
+			blkcnt = 1;
+		}
 		if (rc) {
 			goto done;
 		}
@@ -433,6 +677,56 @@ u32 ext4fs_node_read(struct ext4fs_node *node, u64 pos, u32 len, char *buf)
 			blklen = ctrl->block_size;
 		}
 
+		/* Read middle blocks contiguous on disk directly
+		 * into caller buffer using single device read.
+		 */
+		if (blkno && !blkoff && (blklen == ctrl->block_size) &&
+		    (i < last_blkpos)) {
+			blkrun = 1;
+			if (extents) {
+				/* Whole extent is contiguous on disk */
+				blkrun = last_blkpos - i;
+				if (blkcnt < blkrun) {
+					blkrun = blkcnt;
+				}
+				if (udiv32(rlen, ctrl->block_size) < blkrun) {
+					blkrun = udiv32(rlen, ctrl->block_size);
+				}
+			}
+			while (!extents && ((i + blkrun) < last_blkpos) &&
+			       ((blkrun + 1) * ctrl->block_size <= rlen)) {
+				rc = ext4fs_node_read_blkno(node, i + blkrun,
+							    &nblkno);
+				if (rc || (nblkno != (blkno + blkrun))) {
+					break;
+				}
+				blkrun++;
+			}
+
+			if (node->cached_dirty &&
+			    (blkno <= node->cached_blkno) &&
+			    (node->cached_blkno < (blkno + blkrun))) {
+				rc = ext4fs_devwrite(ctrl, node->cached_blkno,
+						     0, ctrl->block_size,
+						     (char *)node->cached_block);
+				if (rc) {
+					goto done;
+				}
+				node->cached_dirty = FALSE;
+			}
+
+			rc = ext4fs_devread(ctrl, blkno, 0,
+					    blkrun * ctrl->block_size, buf);
+			if (rc) {
+				goto done;
+			}
+
+			buf += blkrun * ctrl->block_size;
+			rlen -= blkrun * ctrl->block_size;
+			i += blkrun;
+			continue;
+		}
+
 		/* Read cached block */
 		rc = ext4fs_node_read_blk(node, blkno, blkoff, blklen, buf);
 		if (rc) {
@@ -481,6 +775,63 @@ static char *ext4fs_node_read_symlink(struct ext4fs_node *node)
 }
 #endif
 
+/* Note: Node position and device offset have to be 64-bit */
+int ext4fs_node_bmap(struct ext4fs_node *node, u64 pos,
+		     u64 *dev_off, u64 *len)
+{
+	int rc;
+	u64 filesize = ext4fs_node_get_size(node);
+	u32 blkpos, blkoff, blkno, blkcnt, nblkno, lastpos;
+	bool extents = (__le32(node->inode.flags) & EXT4_EXTENTS_FL) ?
+								TRUE : FALSE;
+	struct ext4fs_control *ctrl = node->ctrl;
+
+	if (filesize <= pos) {
+		return VMM_ERANGE;
+	}
+
+	/* Note: div result < 32-bit */
+	blkpos = udiv64(pos, ctrl->block_size);
+	blkoff = pos - ((u64)blkpos * ctrl->block_size);
+	lastpos = udiv64(filesize + ctrl->block_size - 1, ctrl->block_size);
+
+	if (extents) {
+		rc = ext4fs_node_read_extent(node, blkpos, &blkno, &blkcnt);
+	} else {
+		rc = ext4fs_node_read_blkno(node, blkpos, &blkno);
+		blkcnt = 1;
+		while (!rc && blkno && ((blkpos + blkcnt) < lastpos)) {
+			if (ext4fs_node_read_blkno(node, blkpos + blkcnt,
+						   &nblkno) ||
+			    (nblkno != (blkno + blkcnt))) {
+				break;
+			}
+			blkcnt++;
+		}
+	}
+	if (rc) {
+		return rc;
+	}
+
+	/* Holes and uninitialized extents have no device blocks */
+	if (!blkno) {
+		return VMM_ENODATA;
+	}
+
+	if ((lastpos - blkpos) < blkcnt) {
+		blkcnt = lastpos - blkpos;
+	}
+
+	*dev_off = ((u64)blkno << (ctrl->log2_block_size + EXT2_SECTOR_BITS));
+	*dev_off += blkoff;
+	*len = (u64)blkcnt * ctrl->block_size - blkoff;
+	if ((filesize - pos) < *len) {
+		*len = filesize - pos;
+	}
+
+	return VMM_OK;
+}
+
 u32 ext4fs_node_write(struct ext4fs_node *node, u64 pos, u32 len, char *buf)
 {
 	int rc;
@@ -651,6 +1002,14 @@ int ext4fs_node_load(struct ext4fs_control *ctrl,
 	node->dindir2_blkno = 0;
 	node->dindir2_dirty = FALSE;
 
+	node->extent_block = NULL;
+	node->extent_blkno = 0;
+	ext4fs_node_extent_cache_flush(node);
+
+	node->ra_next = 0;
+	node->ra_end = 0;
+	node->ra_size = 0;
+
 	return VMM_OK;
 }
 
@@ -677,6 +1036,14 @@ int ext4fs_node_init(struct ext4fs_node *node)
 	node->dindir2_blkno = 0;
 	node->dindir2_dirty = FALSE;
 
+	node->extent_block = NULL;
+	node->extent_blkno = 0;
+	ext4fs_node_extent_cache_flush(node);
+
+	node->ra_next = 0;
+	node->ra_end = 0;
+	node->ra_size = 0;
+
 	node->lookup_victim = 0;
 	for (idx = 0; idx < EXT4_NODE_LOOKUP_SIZE; idx++) {
 		node->lookup_name[idx][0] = '\0';
@@ -703,6 +1070,10 @@ int ext4fs_node_exit(struct ext4fs_node *node)
 		vmm_free(node->dindir2_block);
 	}
 
+	if (node->extent_block) {
+		vmm_free(node->extent_block);
+	}
+
 	return VMM_OK;
 }
 
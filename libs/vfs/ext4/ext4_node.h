@@ -28,6 +28,18 @@
 #include "ext4_common.h"
 
 #define EXT4_NODE_LOOKUP_SIZE		4
+#define EXT4_NODE_EXTENT_CACHE_SIZE	4
+#define EXT4_NODE_RA_MIN_SIZE		(16 * 1024)
+#define EXT4_NODE_RA_MAX_SIZE		(256 * 1024)
+
+/* Logical to physical mapping of contiguous file blocks.
+ * Physical block zero means hole or uninitialized extent.
+ */
+struct ext4fs_extent_cache {
+	u32 lblk;
+	u32 len;
+	u32 pblk;
+};
 
 /* Information for accessing a ext4fs file/directory. */
 struct ext4fs_node {
@@ -67,6 +79,19 @@ struct ext4fs_node {
 	u32 dindir2_blkno;
 	bool dindir2_dirty;
 
+	/* Extent tree block and recently used extents
+	 * Allocated on demand. Must be freed in vput()
+	 */
+	u8 *extent_block;
+	u32 extent_blkno;
+	u32 extent_victim;
+	struct ext4fs_extent_cache extent_cache[EXT4_NODE_EXTENT_CACHE_SIZE];
+
+	/* Sequential read detection and readahead window */
+	u64 ra_next;
+	u64 ra_end;
+	u32 ra_size;
+
 	/* Child directory entry lookup table */
 	u32 lookup_victim;
 	char lookup_name[EXT4_NODE_LOOKUP_SIZE][VFS_MAX_NAME];
@@ -85,6 +110,9 @@ int ext4fs_node_write_blk(struct ext4fs_node *node,
 
 int ext4fs_node_sync(struct ext4fs_node *node);
 
+int ext4fs_node_read_extent(struct ext4fs_node *node, u32 blkpos,
+			    u32 *blkno, u32 *blkcnt);
+
 int ext4fs_node_read_blkno(struct ext4fs_node *node, u32 blkpos, u32 *blkno);
 
 int ext4fs_node_write_blkno(struct ext4fs_node *node, u32 blkpos, u32 blkno);
@@ -93,6 +121,9 @@ u32 ext4fs_node_read(struct ext4fs_node *node, u64 pos, u32 len, char *buf);
 
 u32 ext4fs_node_write(struct ext4fs_node *node, u64 pos, u32 len, char *buf);
 
+int ext4fs_node_bmap(struct ext4fs_node *node, u64 pos,
+		     u64 *dev_off, u64 *len);
+
 int ext4fs_node_truncate(struct ext4fs_node *node, u64 pos);
 
 int ext4fs_node_load(struct ext4fs_control *ctrl, 
@@ -27,6 +27,8 @@
 #include <vmm_modules.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
+#include <libs/bitmap.h>
+#include <libs/bitops.h>
 
 #include "fat_control.h"
 
@@ -235,6 +237,15 @@ static u32 __fatfs_control_last_valid_cluster(struct fatfs_control *ctrl)
 	return 0x0;
 }
 
+/* Last cluster actually backed by data sectors of volume */
+static u32 __fatfs_control_last_data_cluster(struct fatfs_control *ctrl)
+{
+	u32 last = __fatfs_control_last_valid_cluster(ctrl);
+
+	return ((ctrl->data_clusters + 1) < last) ?
+					(ctrl->data_clusters + 1) : last;
+}
+
 static bool __fatfs_control_valid_cluster(struct fatfs_control *ctrl, u32 cl)
 {
 	switch (ctrl->type) {
@@ -380,6 +391,17 @@ static int __fatfs_control_set_next_cluster(struct fatfs_control *ctrl,
 		return VMM_EIO;
 	}
 
+	/* Keep free cluster bitmap in-sync with FAT */
+	if (ctrl->clust_bmap && (clust < ctrl->clust_count)) {
+		if (next && !bitmap_isset(ctrl->clust_bmap, clust)) {
+			bitmap_setbit(ctrl->clust_bmap, clust);
+			ctrl->free_count--;
+		} else if (!next && bitmap_isset(ctrl->clust_bmap, clust)) {
+			bitmap_clearbit(ctrl->clust_bmap, clust);
+			ctrl->free_count++;
+		}
+	}
+
 	return VMM_OK;
 }
 
@@ -445,136 +467,258 @@ static int __fatfs_control_nth_cluster(struct fatfs_control *ctrl,
 	return VMM_OK;
 }
 
-static int __fatfs_control_alloc_first_cluster(struct fatfs_control *ctrl, 
-						u32 *newclust)
+static int __fatfs_control_truncate_clusters(struct fatfs_control *ctrl, 
+					     u32 clust)
 {
 	int rc;
-	bool found;
-	u32 current, next, first, last;
+	u32 current, next = clust;
+
+	while (__fatfs_control_valid_cluster(ctrl, next)) {
+		current = next;
 
-	found = FALSE;
-	first = __fatfs_control_first_valid_cluster(ctrl);
-	last = __fatfs_control_last_valid_cluster(ctrl);
-	for (current = first; current <= last; current++) {
 		rc = __fatfs_control_get_next_cluster(ctrl, current, &next);
 		if (rc) {
 			return rc;
 		}
-
-		if (next == 0x0) {
-			found = TRUE;
-			break;
+	
+		rc = __fatfs_control_set_next_cluster(ctrl, current, 0x0);
+		if (rc) {
+			return rc;
 		}
 	}
 
-	if (!found) {
-		return VMM_ENOTAVAIL;
+	return VMM_OK;
+}
+
+static int __fatfs_control_cluster_is_free(struct fatfs_control *ctrl,
+					   u32 clust, bool *free)
+{
+	int rc;
+	u32 next;
+
+	if (ctrl->clust_bmap) {
+		*free = !bitmap_isset(ctrl->clust_bmap, clust);
+		return VMM_OK;
 	}
 
-	rc = __fatfs_control_set_last_cluster(ctrl, current);
+	rc = __fatfs_control_get_next_cluster(ctrl, clust, &next);
 	if (rc) {
 		return rc;
 	}
-
-	if (newclust) {
-		*newclust = current;
-	}
+	*free = (next == 0x0) ? TRUE : FALSE;
 
 	return VMM_OK;
 }
 
-static int __fatfs_control_append_free_cluster(struct fatfs_control *ctrl, 
-					       u32 clust, u32 *newclust)
+/* Length of free cluster run starting at given free cluster */
+static u32 __fatfs_control_free_run(struct fatfs_control *ctrl,
+				    u32 clust, u32 max)
 {
-	int rc;
-	bool found;
-	u32 current, next, first, last;
+	u32 end, last = __fatfs_control_last_data_cluster(ctrl);
 
-	if (!__fatfs_control_valid_cluster(ctrl, clust)) {
-		return VMM_EINVALID;
+	if (!ctrl->clust_bmap) {
+		return 1;
 	}
 
-	rc = __fatfs_control_get_next_cluster(ctrl, clust, &next);
-	if (rc) {
-		return rc;
+	end = find_next_bit(ctrl->clust_bmap, last + 1, clust);
+	if (last < end) {
+		end = last + 1;
 	}
 
-	while (__fatfs_control_valid_cluster(ctrl, next)) {
-		clust = next;
+	return ((end - clust) < max) ? (end - clust) : max;
+}
 
-		rc = __fatfs_control_get_next_cluster(ctrl, clust, &next);
-		if (rc) {
-			return rc;
-		}
-	}
+/* Find a run of free clusters preferably starting at goal cluster.
+ * The first run having count clusters is returned otherwise the
+ * longest run found.
+ */
+static int __fatfs_control_find_free(struct fatfs_control *ctrl,
+				     u32 goal, u32 count,
+				     u32 *clust, u32 *len)
+{
+	int rc, pass;
+	bool free;
+	u32 cur, start, end, rlen, best = 0, best_clust = 0;
+	u32 first = __fatfs_control_first_valid_cluster(ctrl);
+	u32 last = __fatfs_control_last_data_cluster(ctrl);
 
-	found = FALSE;
-	first = __fatfs_control_first_valid_cluster(ctrl);
-	last = __fatfs_control_last_valid_cluster(ctrl);
-	current = clust + 1;
-	while (1) {
-		if (clust == current) {
-			break;
-		}
+	if (ctrl->clust_bmap && !ctrl->free_count) {
+		return VMM_ENOTAVAIL;
+	}
 
-		rc = __fatfs_control_get_next_cluster(ctrl, current, &next);
+	/* Prefer extending contiguously */
+	if ((first <= goal) && (goal <= last)) {
+		rc = __fatfs_control_cluster_is_free(ctrl, goal, &free);
 		if (rc) {
 			return rc;
 		}
-
-		if (next == 0x0) {
-			found = TRUE;
-			break;
-		}
-
-		current++;
-		if (current > last) {
-			current = first;
+		if (free) {
+			*clust = goal;
+			*len = __fatfs_control_free_run(ctrl, goal, count);
+			return VMM_OK;
 		}
 	}
 
-	if (!found) {
+	/* Without bitmap scan FAT for single free cluster */
+	if (!ctrl->clust_bmap) {
+		for (cur = first; cur <= last; cur++) {
+			rc = __fatfs_control_cluster_is_free(ctrl, cur, &free);
+			if (rc) {
+				return rc;
+			}
+			if (free) {
+				*clust = cur;
+				*len = 1;
+				return VMM_OK;
+			}
+		}
 		return VMM_ENOTAVAIL;
 	}
 
-	rc = __fatfs_control_set_last_cluster(ctrl, current);
-	if (rc) {
-		return rc;
+	/* Scan bitmap from allocation hint and wrap around */
+	if ((ctrl->alloc_hint < first) || (last < ctrl->alloc_hint)) {
+		ctrl->alloc_hint = first;
 	}
-
-	rc = __fatfs_control_set_next_cluster(ctrl, clust, current);
-	if (rc) {
-		return rc;
+	for (pass = 0; pass < 2; pass++) {
+		start = (pass) ? first : ctrl->alloc_hint;
+		end = (pass) ? ctrl->alloc_hint : (last + 1);
+		cur = start;
+		while (cur < end) {
+			cur = find_next_zero_bit(ctrl->clust_bmap, end, cur);
+			if (end <= cur) {
+				break;
+			}
+			rlen = __fatfs_control_free_run(ctrl, cur, count);
+			if (best < rlen) {
+				best = rlen;
+				best_clust = cur;
+				if (rlen == count) {
+					goto found;
+				}
+			}
+			cur += rlen;
+		}
 	}
 
-	if (newclust) {
-		*newclust = clust;
+	if (!best) {
+		return VMM_ENOTAVAIL;
 	}
 
+found:
+	*clust = best_clust;
+	*len = best;
+
 	return VMM_OK;
 }
 
-static int __fatfs_control_truncate_clusters(struct fatfs_control *ctrl, 
-					     u32 clust)
+/* Allocate count free clusters and append them to cluster chain
+ * ending at given cluster (or create new chain if given cluster
+ * is zero). Free clusters are reserved as few contiguous runs.
+ */
+static int __fatfs_control_alloc_clusters(struct fatfs_control *ctrl,
+					  u32 clust, u32 count,
+					  u32 *newclust)
 {
 	int rc;
-	u32 current, next = clust;
+	u32 i, next, prev, first_new = 0, run_clust, run_len;
 
-	while (__fatfs_control_valid_cluster(ctrl, next)) {
-		current = next;
+	if (!count) {
+		return VMM_EINVALID;
+	}
 
-		rc = __fatfs_control_get_next_cluster(ctrl, current, &next);
+	/* Find last cluster of existing chain */
+	if (clust) {
+		if (!__fatfs_control_valid_cluster(ctrl, clust)) {
+			return VMM_EINVALID;
+		}
+
+		rc = __fatfs_control_get_next_cluster(ctrl, clust, &next);
 		if (rc) {
 			return rc;
 		}
-	
-		rc = __fatfs_control_set_next_cluster(ctrl, current, 0x0);
+
+		while (__fatfs_control_valid_cluster(ctrl, next)) {
+			clust = next;
+
+			rc = __fatfs_control_get_next_cluster(ctrl,
+							      clust, &next);
+			if (rc) {
+				return rc;
+			}
+		}
+	}
+
+	prev = clust;
+	while (count) {
+		rc = __fatfs_control_find_free(ctrl,
+				(prev) ? (prev + 1) : ctrl->alloc_hint,
+				count, &run_clust, &run_len);
 		if (rc) {
-			return rc;
+			goto fail;
+		}
+
+		/* Chain clusters of run in order */
+		for (i = 0; i < (run_len - 1); i++) {
+			rc = __fatfs_control_set_next_cluster(ctrl,
+					run_clust + i, run_clust + i + 1);
+			if (rc) {
+				goto fail;
+			}
+		}
+		rc = __fatfs_control_set_last_cluster(ctrl,
+						run_clust + run_len - 1);
+		if (rc) {
+			goto fail;
+		}
+
+		if (prev) {
+			rc = __fatfs_control_set_next_cluster(ctrl,
+							prev, run_clust);
+			if (rc) {
+				goto fail;
+			}
+		}
+		if (!first_new) {
+			first_new = run_clust;
 		}
+
+		prev = run_clust + run_len - 1;
+		count -= run_len;
+		ctrl->alloc_hint = prev + 1;
+	}
+
+	if (newclust) {
+		*newclust = first_new;
 	}
 
 	return VMM_OK;
+
+fail:
+	/* Give back clusters allocated so far */
+	if (first_new) {
+		__fatfs_control_truncate_clusters(ctrl, first_new);
+		if (clust) {
+			__fatfs_control_set_last_cluster(ctrl, clust);
+		}
+	}
+
+	return rc;
+}
+
+static int __fatfs_control_alloc_first_cluster(struct fatfs_control *ctrl, 
+						u32 *newclust)
+{
+	return __fatfs_control_alloc_clusters(ctrl, 0, 1, newclust);
+}
+
+static int __fatfs_control_append_free_cluster(struct fatfs_control *ctrl, 
+					       u32 clust, u32 *newclust)
+{
+	if (!__fatfs_control_valid_cluster(ctrl, clust)) {
+		return VMM_EINVALID;
+	}
+
+	return __fatfs_control_alloc_clusters(ctrl, clust, 1, newclust);
 }
 
 u32 fatfs_pack_timestamp(u32 year, u32 mon, u32 day, 
@@ -590,7 +734,7 @@ void fatfs_current_timestamp(u32 *year, u32 *mon, u32 *day,
 	struct vmm_timeval tv;
 	struct vmm_timeinfo ti;
 
-	vmm_wallclock_get_local_time(&tv);
+	vmm_wallclock_get_local_time_coarse(&tv);
 	vmm_wallclock_mkinfo(tv.tv_sec, 0, &ti);
 
 	if (year) {
@@ -670,6 +814,18 @@ int fatfs_control_append_free_cluster(struct fatfs_control *ctrl,
 	return rc;
 }
 
+int fatfs_control_alloc_clusters(struct fatfs_control *ctrl,
+				 u32 clust, u32 count, u32 *newclust)
+{
+	int rc;
+
+	vmm_mutex_lock(&ctrl->fat_cache_lock);
+	rc = __fatfs_control_alloc_clusters(ctrl, clust, count, newclust);
+	vmm_mutex_unlock(&ctrl->fat_cache_lock);
+
+	return rc;
+}
+
 int fatfs_control_truncate_clusters(struct fatfs_control *ctrl, 
 				    u32 clust)
 {
@@ -708,7 +864,7 @@ int fatfs_control_sync(struct fatfs_control *ctrl)
 
 int fatfs_control_init(struct fatfs_control *ctrl, struct vmm_blockdev *bdev)
 {
-	u32 i;
+	u32 i, next;
 	u64 rlen;
 	struct fat_bootsec *bsec = &ctrl->bsec;
 
@@ -829,11 +985,39 @@ int fatfs_control_init(struct fatfs_control *ctrl, struct vmm_blockdev *bdev)
 		return VMM_EIO;
 	}
 
+	/* Build free cluster bitmap by scanning FAT once.
+	 * Allocation falls back to scanning FAT without bitmap.
+	 */
+	ctrl->clust_count = __fatfs_control_last_data_cluster(ctrl) + 1;
+	ctrl->free_count = 0;
+	ctrl->alloc_hint = __fatfs_control_first_valid_cluster(ctrl);
+	ctrl->clust_bmap =
+		vmm_zalloc(bitmap_estimate_size(ctrl->clust_count));
+	if (ctrl->clust_bmap) {
+		bitmap_set(ctrl->clust_bmap, 0, ctrl->alloc_hint);
+		for (i = ctrl->alloc_hint; i < ctrl->clust_count; i++) {
+			if (__fatfs_control_get_next_cluster(ctrl, i, &next)) {
+				vmm_free(ctrl->clust_bmap);
+				ctrl->clust_bmap = NULL;
+				break;
+			}
+			if (next) {
+				bitmap_setbit(ctrl->clust_bmap, i);
+			} else {
+				ctrl->free_count++;
+			}
+		}
+	}
+
 	return VMM_OK;
 }
 
 int fatfs_control_exit(struct fatfs_control *ctrl)
 {
+	if (ctrl->clust_bmap) {
+		vmm_free(ctrl->clust_bmap);
+		ctrl->clust_bmap = NULL;
+	}
 	vmm_free(ctrl->fat_cache_buf);
 
 	return VMM_OK;
@@ -71,6 +71,15 @@ struct fatfs_control {
 	bool fat_cache_dirty[FAT_TABLE_CACHE_SIZE];
 	u32 fat_cache_num[FAT_TABLE_CACHE_SIZE];
 	u8 *fat_cache_buf;
+
+	/* Free cluster bitmap (set bit means cluster in-use)
+	 * Protected by FAT sector cache lock. May be NULL
+	 * for very large volumes in which case FAT is scanned.
+	 */
+	unsigned long *clust_bmap;
+	u32 clust_count;
+	u32 free_count;
+	u32 alloc_hint;
 };
 
 u32 fatfs_pack_timestamp(u32 year, u32 mon, u32 day, 
@@ -92,6 +101,9 @@ int fatfs_control_alloc_first_cluster(struct fatfs_control *ctrl,
 int fatfs_control_append_free_cluster(struct fatfs_control *ctrl, 
 				      u32 clust, u32 *newclust);
 
+int fatfs_control_alloc_clusters(struct fatfs_control *ctrl,
+				 u32 clust, u32 count, u32 *newclust);
+
 int fatfs_control_truncate_clusters(struct fatfs_control *ctrl, 
 				    u32 clust);
 
@@ -566,6 +566,27 @@ static int fatfs_chmod(struct vnode *v, u32 mode)
 	return VMM_OK;
 }
 
+static int fatfs_bmap(struct vnode *v, loff_t off,
+		      u64 *dev_off, size_t *len)
+{
+	int rc;
+	u32 blen;
+	struct fatfs_node *node = v->v_data;
+
+	if (!node) {
+		return VMM_EFAIL;
+	}
+
+	rc = fatfs_node_bmap(node, (u32)off, dev_off, &blen);
+	if (rc) {
+		return rc;
+	}
+
+	*len = blen;
+
+	return VMM_OK;
+}
+
 /* fatfs filesystem */
 static struct filesystem fatfs = {
 	.name		= "fat",
@@ -590,6 +611,7 @@ static struct filesystem fatfs = {
 	.mkdir		= fatfs_mkdir,
 	.rmdir		= fatfs_rmdir,
 	.chmod		= fatfs_chmod,
+	.bmap		= fatfs_bmap,
 };
 
 static int __init fatfs_init(void)
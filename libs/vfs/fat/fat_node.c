@@ -172,11 +172,86 @@ u32 fatfs_node_get_size(struct fatfs_node *node)
 	return __le32(node->parent_dent.file_size);
 }
 
+/* Grow readahead window upon sequential reads and asynchronously
+ * read clusters of window into block device page cache whenever
+ * less than half of window is left ahead of current read.
+ */
+static void fatfs_node_readahead(struct fatfs_node *node, u32 pos, u32 len)
+{
+	int rc;
+	u64 roff;
+	u32 start, end, filesize = fatfs_node_get_size(node);
+	u32 cl_pos, cl_last, cl_num, cl_next, cl_run;
+	struct fatfs_control *ctrl = node->ctrl;
+
+	if (pos != node->ra_next) {
+		node->ra_next = pos + len;
+		node->ra_end = 0;
+		node->ra_size = 0;
+		return;
+	}
+	node->ra_next = pos + len;
+
+	if (!node->ra_size) {
+		node->ra_size = FAT_NODE_RA_MIN_SIZE;
+	} else if (node->ra_size < FAT_NODE_RA_MAX_SIZE) {
+		node->ra_size *= 2;
+	}
+
+	start = (node->ra_end < (pos + len)) ? (pos + len) : node->ra_end;
+	end = ((filesize - (pos + len)) < node->ra_size) ?
+					filesize : (pos + len + node->ra_size);
+	if ((filesize <= (pos + len)) || (end <= start) ||
+	    ((start - (pos + len)) > (node->ra_size / 2))) {
+		return;
+	}
+
+	cl_pos = udiv32(start, ctrl->bytes_per_cluster);
+	cl_last = udiv32(end + ctrl->bytes_per_cluster - 1,
+			 ctrl->bytes_per_cluster);
+	rc = fatfs_control_nth_cluster(ctrl, node->first_cluster,
+					cl_pos, &cl_num);
+	if (rc) {
+		return;
+	}
+
+	while (cl_pos < cl_last) {
+		/* Find run of clusters contiguous on disk */
+		cl_run = 1;
+		while ((cl_pos + cl_run) < cl_last) {
+			rc = fatfs_control_nth_cluster(ctrl,
+					cl_num + cl_run - 1, 1, &cl_next);
+			if (rc || (cl_next != (cl_num + cl_run))) {
+				break;
+			}
+			cl_run++;
+		}
+
+		roff = (u64)ctrl->first_data_sector * ctrl->bytes_per_sector;
+		roff += (u64)(cl_num - 2) * ctrl->bytes_per_cluster;
+		if (vmm_blockdev_readahead(ctrl->bdev, roff,
+				(u64)cl_run * ctrl->bytes_per_cluster)) {
+			break;
+		}
+
+		cl_pos += cl_run;
+		if (cl_pos < cl_last) {
+			rc = fatfs_control_nth_cluster(ctrl,
+					cl_num + cl_run - 1, 1, &cl_num);
+			if (rc) {
+				break;
+			}
+		}
+	}
+
+	node->ra_end = cl_pos * ctrl->bytes_per_cluster;
+}
+
 u32 fatfs_node_read(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 {
 	int rc;
 	u64 rlen, roff;
-	u32 r, cl_pos, cl_off, cl_num, cl_len;
+	u32 r, cl_pos, cl_off, cl_num, cl_len, cl_next, cl_run;
 	struct fatfs_control *ctrl = node->ctrl;
 
 	if (!node->parent && ctrl->type != FAT_TYPE_32) {
@@ -202,6 +277,8 @@ u32 fatfs_node_read(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 		}
 	}
 
+	fatfs_node_readahead(node, pos, len);
+
 	r = 0;
 	while (r < len) {
 		/* Get the next cluster */
@@ -228,6 +305,42 @@ u32 fatfs_node_read(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 					ctrl->bytes_per_cluster : (len - r);
 		}
 
+		/* Read whole clusters contiguous on disk directly
+		 * into caller buffer using single block device read.
+		 */
+		if (!cl_off && (cl_len == ctrl->bytes_per_cluster)) {
+			cl_run = 1;
+			while ((len - r) >= 
+				((cl_run + 1) * ctrl->bytes_per_cluster)) {
+				rc = fatfs_control_nth_cluster(ctrl, 
+						cl_num + cl_run - 1, 1, &cl_next);
+				if (rc || (cl_next != (cl_num + cl_run))) {
+					break;
+				}
+				cl_run++;
+			}
+
+			if (fatfs_node_sync_cached_cluster(node)) {
+				return r;
+			}
+
+			roff = (u64)ctrl->first_data_sector * 
+						ctrl->bytes_per_sector;
+			roff += (u64)(cl_num - 2) * ctrl->bytes_per_cluster;
+			rlen = vmm_blockdev_read(ctrl->bdev, buf, roff,
+					(u64)cl_run * ctrl->bytes_per_cluster);
+			if (rlen != ((u64)cl_run * ctrl->bytes_per_cluster)) {
+				return r;
+			}
+
+			/* Continue chain walk from last cluster read */
+			cl_num += cl_run - 1;
+			cl_pos += cl_run - 1;
+			r += cl_run * ctrl->bytes_per_cluster;
+			buf += cl_run * ctrl->bytes_per_cluster;
+			continue;
+		}
+
 		/* Make sure cached cluster is updated */
 		if (node->cached_clust != cl_num) {
 			if (fatfs_node_sync_cached_cluster(node)) {
@@ -258,12 +371,54 @@ u32 fatfs_node_read(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 	return r;
 }
 
+int fatfs_node_bmap(struct fatfs_node *node, u32 pos, u64 *dev_off, u32 *len)
+{
+	int rc;
+	u32 cl_pos, cl_off, cl_last, cl_num, cl_next, cl_run;
+	u32 filesize = fatfs_node_get_size(node);
+	struct fatfs_control *ctrl = node->ctrl;
+
+	if (!node->parent || (filesize <= pos)) {
+		return VMM_ERANGE;
+	}
+
+	cl_pos = udiv32(pos, ctrl->bytes_per_cluster);
+	cl_off = pos - cl_pos * ctrl->bytes_per_cluster;
+	cl_last = udiv32(filesize + ctrl->bytes_per_cluster - 1,
+			 ctrl->bytes_per_cluster);
+	rc = fatfs_control_nth_cluster(ctrl, node->first_cluster,
+					cl_pos, &cl_num);
+	if (rc) {
+		return rc;
+	}
+
+	/* Find run of clusters contiguous on disk */
+	cl_run = 1;
+	while ((cl_pos + cl_run) < cl_last) {
+		rc = fatfs_control_nth_cluster(ctrl,
+				cl_num + cl_run - 1, 1, &cl_next);
+		if (rc || (cl_next != (cl_num + cl_run))) {
+			break;
+		}
+		cl_run++;
+	}
+
+	*dev_off = (u64)ctrl->first_data_sector * ctrl->bytes_per_sector;
+	*dev_off += (u64)(cl_num - 2) * ctrl->bytes_per_cluster + cl_off;
+	*len = cl_run * ctrl->bytes_per_cluster - cl_off;
+	if ((filesize - pos) < *len) {
+		*len = filesize - pos;
+	}
+
+	return VMM_OK;
+}
+
 u32 fatfs_node_write(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 {
 	int rc;
 	u64 woff, wlen;
 	u32 w, wstartcl, wendcl;
-	u32 cl_off, cl_num, cl_len;
+	u32 cl_off, cl_num, cl_len, cl_cnt, cl_last, cl_next;
 	u32 year, mon, day, hour, min, sec;
 	struct fatfs_control *ctrl = node->ctrl;
 
@@ -300,51 +455,61 @@ u32 fatfs_node_write(struct fatfs_node *node, u32 pos, u32 len, u8 *buf)
 		memset(node->cached_data, 0, ctrl->bytes_per_cluster);
 	}
 
-	/* If first cluster is zero then allocate first cluster */
-	if (node->first_cluster == 0) {
-		rc = fatfs_control_alloc_first_cluster(ctrl, &cl_num);
+	/* Find last cluster of chain within write range */
+	cl_cnt = 0;
+	cl_last = 0;
+	if (node->first_cluster) {
+		cl_last = node->first_cluster;
+		cl_cnt = 1;
+		while (cl_cnt <= wendcl) {
+			rc = fatfs_control_nth_cluster(ctrl, cl_last, 1, &cl_next);
+			if (rc) {
+				break;
+			}
+			cl_last = cl_next;
+			cl_cnt++;
+		}
+	}
+
+	/* Reserve all missing clusters at once so that they
+	 * are allocated as contiguous runs wherever possible
+	 */
+	if (cl_cnt <= wendcl) {
+		rc = fatfs_control_alloc_clusters(ctrl, cl_last,
+						  wendcl + 1 - cl_cnt, &cl_num);
 		if (rc) {
 			return 0;
 		}
-		node->first_cluster = cl_num;
 
-		/* Update the first cluster */
-		node->parent_dent.first_cluster_hi = 
-				((node->first_cluster >> 16) & 0xFFFF);
-		node->parent_dent.first_cluster_lo = 
-				(node->first_cluster & 0xFFFF);
-	}
+		if (node->first_cluster == 0) {
+			node->first_cluster = cl_num;
 
-	/* Make room for new data by appending free clusters */
-	cl_num = node->first_cluster;
-	for (w = 0; w <= (wendcl - wstartcl); w++) {
-		if (w == 0) {
-			rc = fatfs_control_nth_cluster(ctrl, cl_num,
-							wstartcl, &cl_num);
-			if (!rc) {
-				continue;
-			}
-		} else {
-			rc = fatfs_control_nth_cluster(ctrl, cl_num, 1, &cl_num);
-			if (!rc) {
-				continue;
-			}
+			/* Update the first cluster */
+			node->parent_dent.first_cluster_hi = 
+					((node->first_cluster >> 16) & 0xFFFF);
+			node->parent_dent.first_cluster_lo = 
+					(node->first_cluster & 0xFFFF);
 		}
 
-		/* Add new cluster */
-		rc = fatfs_control_append_free_cluster(ctrl, cl_num, &cl_num);
-		if (rc) {
-			break;
-		}
+		/* Write zeros to new clusters not fully overwritten */
+		for (w = cl_cnt; w <= wendcl; w++) {
+			if (((w * ctrl->bytes_per_cluster) < pos) ||
+			    ((pos + len) < ((w + 1) * ctrl->bytes_per_cluster))) {
+				woff = (u64)ctrl->first_data_sector * 
+							ctrl->bytes_per_sector;
+				woff += (u64)(cl_num - 2) * ctrl->bytes_per_cluster;
+				wlen = vmm_blockdev_write(ctrl->bdev, 
+						node->cached_data, 
+						woff, ctrl->bytes_per_cluster);
+				if (wlen != ctrl->bytes_per_cluster) {
+					break;
+				}
+			}
 
-		/* Write zeros to new cluster */
-		woff = (u64)ctrl->first_data_sector * ctrl->bytes_per_sector;
-		woff += (u64)(cl_num - 2) * ctrl->bytes_per_cluster;
-		wlen = vmm_blockdev_write(ctrl->bdev, 
-					node->cached_data, 
-					woff, ctrl->bytes_per_cluster);
-		if (wlen != ctrl->bytes_per_cluster) {
-			break;
+			if ((w < wendcl) &&
+			    fatfs_control_nth_cluster(ctrl, cl_num, 1, &cl_num)) {
+				break;
+			}
 		}
 	}
 
@@ -506,6 +671,10 @@ int fatfs_node_init(struct fatfs_control *ctrl, struct fatfs_node *node)
 	node->cached_data = NULL;
 	node->cached_dirty = FALSE;
 
+	node->ra_next = 0;
+	node->ra_end = 0;
+	node->ra_size = 0;
+
 	node->lookup_victim = 0;
 	for (idx = 0; idx < FAT_NODE_LOOKUP_SIZE; idx++) {
 		node->lookup_name[idx][0] = '\0';
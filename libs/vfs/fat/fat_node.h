@@ -28,6 +28,8 @@
 #include "fat_common.h"
 
 #define FAT_NODE_LOOKUP_SIZE		4
+#define FAT_NODE_RA_MIN_SIZE		(16 * 1024)
+#define FAT_NODE_RA_MAX_SIZE		(256 * 1024)
 
 /* Information for accessing a FAT file/directory. */
 struct fatfs_node {
@@ -49,6 +51,11 @@ struct fatfs_node {
 	u32 cached_clust;
 	bool cached_dirty;
 
+	/* Sequential read detection and readahead window */
+	u32 ra_next;
+	u32 ra_end;
+	u32 ra_size;
+
 	/* Child directory entry lookup table */
 	u32 lookup_victim;
 	char lookup_name[FAT_NODE_LOOKUP_SIZE][VFS_MAX_NAME];
@@ -63,6 +70,8 @@ u32 fatfs_node_read(struct fatfs_node *node, u32 pos, u32 len, u8 *buf);
 
 u32 fatfs_node_write(struct fatfs_node *node, u32 pos, u32 len, u8 *buf);
 
+int fatfs_node_bmap(struct fatfs_node *node, u32 pos, u64 *dev_off, u32 *len);
+
 int fatfs_node_truncate(struct fatfs_node *node, u32 pos);
 
 int fatfs_node_sync(struct fatfs_node *node);
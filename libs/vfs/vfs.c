@@ -23,12 +23,18 @@
 
 #include <vmm_error.h>
 #include <vmm_heap.h>
+#include <vmm_cache.h>
 #include <vmm_stdio.h>
 #include <vmm_scheduler.h>
+#include <vmm_host_aspace.h>
+#include <vmm_guest_aspace.h>
 #include <vmm_modules.h>
+#include <vmm_delay.h>
 #include <arch_atomic.h>
+#include <block/vmm_blockcache.h>
 #include <libs/stringlib.h>
 #include <libs/bitmap.h>
+#include <libs/hash.h>
 #include <libs/vfs.h>
 
 #define MODULE_DESC			"Light-weight VFS Library"
@@ -44,21 +50,46 @@ struct file {
 	u32 f_flags;			/* open flag */
 	loff_t f_offset;		/* current position in file */
 	struct vnode *f_vnode;		/* vnode */
+	u32 f_aio_count;		/* pending asynchronous requests */
 };
 
 /* size of vnode hash table, must power 2 */
-#define VFS_VNODE_HASH_SIZE		(32)
+#define VFS_VNODE_HASH_SIZE		(256)
+/* maximum number of unused vnodes kept in vnode cache */
+#define VFS_VNODE_CACHE_SIZE		(256)
+#define VFS_GUEST_READ_CHUNK_SZ		(2 * 1024 * 1024)
+/* number of worker threads for asynchronous requests and mounts */
+#define VFS_AIO_WORKER_COUNT		(4)
+
+/** background mount request */
+struct vfs_mount_work {
+	struct vmm_work work;
+	struct dlist head;
+	struct vmm_completion done;
+	char dir[VFS_MAX_PATH];
+	char fsname[VFS_MAX_NAME];
+	char dev[VMM_FIELD_NAME_SIZE];
+	u32 flags;
+	u32 wait_secs;
+	int rc;
+};
 
 struct vfs_ctrl {
 	struct vmm_mutex fs_list_lock;
 	struct dlist fs_list;
 	struct vmm_mutex mnt_list_lock;
 	struct dlist mnt_list;
-	struct vmm_mutex vnode_list_lock[VFS_VNODE_HASH_SIZE];
-	struct list_head vnode_list[VFS_VNODE_HASH_SIZE];
+	struct vmm_mutex vnode_lock;
+	struct dlist vnode_list[VFS_VNODE_HASH_SIZE];
+	struct dlist vnode_lru;
+	u32 vnode_lru_count;
 	struct vmm_mutex fd_bmap_lock;
 	unsigned long *fd_bmap;
 	struct file fd[VFS_MAX_FD];
+	struct vmm_workqueue *aio_wq[VFS_AIO_WORKER_COUNT];
+	struct vmm_mutex mnt_work_lock;
+	struct dlist mnt_work_list;
+	u32 mnt_work_next;
 	struct vmm_notifier_block bdev_client;
 };
 
@@ -156,6 +187,7 @@ static void vfs_fd_free(int fd)
 			vfsc.fd[fd].f_flags = 0;
 			vfsc.fd[fd].f_offset = 0;
 			vfsc.fd[fd].f_vnode = NULL;
+			vfsc.fd[fd].f_aio_count = 0;
 			vmm_mutex_unlock(&vfsc.fd[fd].f_lock);
 			bitmap_clearbit(vfsc.fd_bmap, fd);
 		}
@@ -169,34 +201,34 @@ static struct file *vfs_fd_to_file(int fd)
 	return (-1 < fd && fd < VFS_MAX_FD) ? &vfsc.fd[fd] : NULL;
 }
 
-/** Compute hash value from mount point and path name. */
-static u32 vfs_vnode_hash(struct mount *m, const char *path)
+/** Compute hash value from parent directory vnode and path component. */
+static u32 vfs_vnode_hash(struct vnode *dv, const char *name)
 {
-	u32 val = 0;
+	u32 val = hash_str(name, (u32)((unsigned long)dv >> 4));
 
-	if (path) {
-		while (*path) {
-			val = ((val << 5) + val) + *path++;
-		}
-	}
+	return val & (VFS_VNODE_HASH_SIZE - 1);
+}
 
-	return (val ^ (u32)(unsigned long)m) & (VFS_VNODE_HASH_SIZE - 1);
+static void vfs_vnode_vref(struct vnode *v)
+{
+	arch_atomic_add(&v->v_refcnt, 1);
 }
 
-static struct vnode *vfs_vnode_vget(struct mount *m, const char *path)
+/* Allocate vnode for given path. The vnode holds reference of its
+ * parent directory vnode and it is not added to vnode hash table.
+ */
+static struct vnode *vfs_vnode_vget(struct mount *m, struct vnode *dv,
+				    const char *path)
 {
 	int err;
-	u32 hash;
 	struct vnode *v;
 
-	v = NULL;
-	hash = vfs_vnode_hash(m, path);
-
 	if (!(v = vmm_zalloc(sizeof(struct vnode)))) {
 		return NULL;
 	}
 
 	INIT_LIST_HEAD(&v->v_link);
+	INIT_LIST_HEAD(&v->v_lru);
 	INIT_MUTEX(&v->v_lock);
 	v->v_mount = m;
 	arch_atomic_write(&v->v_refcnt, 1);
@@ -205,6 +237,8 @@ static struct vnode *vfs_vnode_vget(struct mount *m, const char *path)
 		vmm_free(v);
 		return NULL;
 	}
+	v->v_name = strrchr(v->v_path, '/');
+	v->v_name = (v->v_name) ? (v->v_name + 1) : v->v_path;
 
 	/* request to allocate fs specific data for vnode. */
 	vmm_mutex_lock(&m->m_lock);
@@ -217,69 +251,183 @@ static struct vnode *vfs_vnode_vget(struct mount *m, const char *path)
 
 	arch_atomic_add(&m->m_refcnt, 1);
 
-	vmm_mutex_lock(&vfsc.vnode_list_lock[hash]);
-	list_add(&v->v_link, &vfsc.vnode_list[hash]);
-	vmm_mutex_unlock(&vfsc.vnode_list_lock[hash]);
+	if (dv) {
+		vfs_vnode_vref(dv);
+		v->v_parent = dv;
+	}
 
 	return v;
 }
 
-static struct vnode *vfs_vnode_lookup(struct mount *m, const char *path)
+/* Find cached vnode of path component under directory vnode
+ * Note: Must be called with vnode lock held
+ */
+static struct vnode *vfs_vnode_lookup(struct vnode *dv, const char *name)
 {
-	u32 hash;
-	bool found = FALSE;
-	struct vnode *v = NULL;
+	struct vnode *v;
+	u32 hash = vfs_vnode_hash(dv, name);
 
-	hash = vfs_vnode_hash(m, path);
+	list_for_each_entry(v, &vfsc.vnode_list[hash], v_link) {
+		if ((v->v_parent == dv) && !strcmp(v->v_name, name)) {
+			/* unused vnode is back in use */
+			if (!list_empty(&v->v_lru)) {
+				list_del_init(&v->v_lru);
+				vfsc.vnode_lru_count--;
+			}
+			arch_atomic_add(&v->v_refcnt, 1);
+			return v;
+		}
+	}
 
-	vmm_mutex_lock(&vfsc.vnode_list_lock[hash]);
+	return NULL;
+}
 
-	list_for_each_entry(v, &vfsc.vnode_list[hash], v_link) {
-		if ((v->v_mount == m) && 
-		    (!strncmp(v->v_path, path, VFS_MAX_PATH))) {
-			found = TRUE;
+/* Drop reference of vnode. Unused vnode in hash table goes to
+ * vnode cache whereas other unused vnodes (and possibly their
+ * parents) are added to given list for freeing.
+ * Note: Must be called with vnode lock held
+ */
+static void vfs_vnode_put_locked(struct vnode *v, struct dlist *freelist)
+{
+	while (v && !arch_atomic_sub_return(&v->v_refcnt, 1)) {
+		if (!list_empty(&v->v_link)) {
+			list_add(&v->v_lru, &vfsc.vnode_lru);
+			vfsc.vnode_lru_count++;
 			break;
 		}
+		list_add_tail(&v->v_lru, freelist);
+		v = v->v_parent;
 	}
+}
+
+/* Evict unused vnode from vnode cache
+ * Note: Must be called with vnode lock held
+ */
+static void vfs_vnode_evict_locked(struct vnode *v, struct dlist *freelist)
+{
+	list_del_init(&v->v_link);
+	list_del(&v->v_lru);
+	vfsc.vnode_lru_count--;
+	list_add_tail(&v->v_lru, freelist);
+	vfs_vnode_put_locked(v->v_parent, freelist);
+}
 
-	vmm_mutex_unlock(&vfsc.vnode_list_lock[hash]);
+/* Free vnodes collected with vnode lock held */
+static void vfs_vnode_free_list(struct dlist *freelist)
+{
+	struct vnode *v;
 
-	if (!found) {
-		return NULL;
+	while (!list_empty(freelist)) {
+		v = list_first_entry(freelist, struct vnode, v_lru);
+		list_del(&v->v_lru);
+
+		/* deallocate fs specific data from this vnode */
+		if (v->v_flags != VNEGATIVE) {
+			vmm_mutex_lock(&v->v_mount->m_lock);
+			v->v_mount->m_fs->vput(v->v_mount, v);
+			vmm_mutex_unlock(&v->v_mount->m_lock);
+		}
+
+		arch_atomic_sub(&v->v_mount->m_refcnt, 1);
+
+		vmm_free(v);
 	}
+}
 
-	arch_atomic_add(&v->v_refcnt, 1);
+static void vfs_vnode_vput(struct vnode *v)
+{
+	struct vnode *ev;
+	struct dlist freelist;
 
-	return v;
+	INIT_LIST_HEAD(&freelist);
+
+	vmm_mutex_lock(&vfsc.vnode_lock);
+
+	vfs_vnode_put_locked(v, &freelist);
+
+	/* evict least recently used vnodes */
+	while (vfsc.vnode_lru_count > VFS_VNODE_CACHE_SIZE) {
+		ev = list_entry(vfsc.vnode_lru.prev, struct vnode, v_lru);
+		vfs_vnode_evict_locked(ev, &freelist);
+	}
+
+	vmm_mutex_unlock(&vfsc.vnode_lock);
+
+	vfs_vnode_free_list(&freelist);
 }
 
-static void vfs_vnode_vref(struct vnode *v)
+static bool vfs_vnode_is_under(struct vnode *v, struct vnode *dv)
 {
-	arch_atomic_add(&v->v_refcnt, 1);
+	while (v) {
+		if (v->v_parent == dv) {
+			return TRUE;
+		}
+		v = v->v_parent;
+	}
+
+	return FALSE;
 }
 
-static void vfs_vnode_vput(struct vnode *v)
+/* Evict unused vnodes of mount point (or only the ones
+ * under given directory vnode) from vnode cache.
+ */
+static void vfs_vnode_shrink(struct mount *m, struct vnode *dv)
 {
-	u32 hash;
+	bool found;
+	struct vnode *v;
+	struct dlist freelist;
 
-	if (arch_atomic_sub_return(&v->v_refcnt, 1)) {
-		return;
-	}
+	INIT_LIST_HEAD(&freelist);
+
+	vmm_mutex_lock(&vfsc.vnode_lock);
+
+	do {
+		found = FALSE;
+		list_for_each_entry(v, &vfsc.vnode_lru, v_lru) {
+			if ((v->v_mount == m) &&
+			    (!dv || vfs_vnode_is_under(v, dv))) {
+				found = TRUE;
+				break;
+			}
+		}
+		if (found) {
+			vfs_vnode_evict_locked(v, &freelist);
+		}
+	} while (found);
 
-	hash = vfs_vnode_hash(v->v_mount, v->v_path);
+	vmm_mutex_unlock(&vfsc.vnode_lock);
 
-	vmm_mutex_lock(&vfsc.vnode_list_lock[hash]);
-	list_del(&v->v_link);
-	vmm_mutex_unlock(&vfsc.vnode_list_lock[hash]);
+	vfs_vnode_free_list(&freelist);
+}
+
+/* Remove vnode of path component under directory vnode from vnode
+ * cache after it was created, removed or renamed. A vnode which is
+ * in use is freed upon dropping its last reference.
+ */
+static void vfs_vnode_forget(struct vnode *dv, const char *name)
+{
+	struct vnode *v;
+	struct dlist freelist;
+	u32 hash = vfs_vnode_hash(dv, name);
+
+	INIT_LIST_HEAD(&freelist);
 
-	/* deallocate fs specific data from this vnode */
-	vmm_mutex_lock(&v->v_mount->m_lock);
-	v->v_mount->m_fs->vput(v->v_mount, v);
-	vmm_mutex_unlock(&v->v_mount->m_lock);
+	vmm_mutex_lock(&vfsc.vnode_lock);
+
+	list_for_each_entry(v, &vfsc.vnode_list[hash], v_link) {
+		if ((v->v_parent == dv) && !strcmp(v->v_name, name)) {
+			if (list_empty(&v->v_lru)) {
+				list_del_init(&v->v_link);
+			} else {
+				vfs_vnode_evict_locked(v, &freelist);
+			}
+			break;
+		}
+	}
 
-	arch_atomic_sub(&v->v_mount->m_refcnt, 1);
+	vmm_mutex_unlock(&vfsc.vnode_lock);
 
-	vmm_free(v);
+	vfs_vnode_free_list(&freelist);
 }
 
 /** Get stat from vnode pointer. */
@@ -366,52 +514,14 @@ static int vfs_vnode_access(struct vnode *v, u32 mode)
 
 static void vfs_vnode_release(struct vnode *v)
 {
-	char *p;
-	char path[VFS_MAX_PATH];
-	struct mount *m;
-
 	if (!v) {
 		return;
 	}
 
-	m = v->v_mount;
-
-	if (m->m_root == v) {
-		vfs_vnode_vput(v);
-		return;
-	}
-
-	if (strlcpy(path, v->v_path, sizeof(path)) >= sizeof(path)) {
-		return;
-	}
-
+	/* Note: Parent directory vnodes are referenced by
+	 * their child vnodes hence only vput target vnode.
+	 */
 	vfs_vnode_vput(v);
-
-	while (1) {
-		p = strrchr(path, '/');
-		if (!p) {
-			break;
-		}
-		*p = '\0';
-
-		if (path[0] == '\0') {
-			break;
-		}
-
-		v = vfs_vnode_lookup(m, path);
-		if (!v) {
-			continue;
-		}
-
-		/* vput for previous lookup */
-		vfs_vnode_vput(v);
-
-		/* vput for previous acquire */
-		vfs_vnode_vput(v);
-	}
-
-	/* vput for mount point root */
-	vfs_vnode_vput(m->m_root);
 }
 
 static int vfs_vnode_acquire(const char *path, struct vnode **vp)
@@ -419,7 +529,7 @@ static int vfs_vnode_acquire(const char *path, struct vnode **vp)
 	char *p;
 	char node[VFS_MAX_PATH];
 	struct mount *m;
-	struct vnode *dv, *v;
+	struct vnode *dv, *v, *tv;
 	int err, i, j;
 
 	/* convert a full path name to its mount point and
@@ -430,8 +540,9 @@ static int vfs_vnode_acquire(const char *path, struct vnode **vp)
 	}
 
 	/* find target vnode, started from root directory.
-	 * this is done to attach the fs specific data to
-	 * the target vnode.
+	 * each path component is looked up in vnode cache
+	 * using its parent directory vnode and upon miss
+	 * the fs specific data is attached to new vnode.
 	 */
 	if (!m->m_root) {
 		return VMM_ENOSYS;
@@ -453,6 +564,10 @@ static int vfs_vnode_acquire(const char *path, struct vnode **vp)
 		i++;
 		j = i;
 		while (*p != '\0' && *p != '/') {
+			if (i >= (VFS_MAX_PATH - 1)) {
+				vfs_vnode_vput(dv);
+				return VMM_EOVERFLOW;
+			}
 			node[i] = *p;
 			p++;
 			i++;
@@ -460,9 +575,11 @@ static int vfs_vnode_acquire(const char *path, struct vnode **vp)
 		node[i] = '\0';	
 
 		/* get a vnode for the target. */
-		v = vfs_vnode_lookup(m, node);
+		vmm_mutex_lock(&vfsc.vnode_lock);
+		v = vfs_vnode_lookup(dv, &node[j]);
+		vmm_mutex_unlock(&vfsc.vnode_lock);
 		if (v == NULL) {
-			v = vfs_vnode_vget(m, node);
+			v = vfs_vnode_vget(m, dv, node);
 			if (v == NULL) {
 				vfs_vnode_vput(dv);
 				return VMM_ENOMEM;
@@ -474,11 +591,40 @@ static int vfs_vnode_acquire(const char *path, struct vnode **vp)
 			err = dv->v_mount->m_fs->lookup(dv, &node[j], v);
 			vmm_mutex_unlock(&dv->v_lock);
 			vmm_mutex_unlock(&v->v_lock);
-			if (err || (*p == '/' && v->v_type != VDIR)) {
-				/* not found */
-				vfs_vnode_release(v);
+			if (err == VMM_ENOENT) {
+				/* remember that name does not exist */
+				vmm_mutex_lock(&m->m_lock);
+				m->m_fs->vput(m, v);
+				vmm_mutex_unlock(&m->m_lock);
+				v->v_flags = VNEGATIVE;
+			} else if (err) {
+				vfs_vnode_vput(v);
+				vfs_vnode_vput(dv);
 				return err;
 			}
+
+			/* add to vnode cache unless someone else did */
+			vmm_mutex_lock(&vfsc.vnode_lock);
+			tv = vfs_vnode_lookup(dv, &node[j]);
+			if (!tv) {
+				list_add(&v->v_link, &vfsc.vnode_list[
+					vfs_vnode_hash(dv, &node[j])]);
+			}
+			vmm_mutex_unlock(&vfsc.vnode_lock);
+			if (tv) {
+				vfs_vnode_vput(v);
+				v = tv;
+			}
+		}
+
+		/* vnode holds reference of its parent */
+		vfs_vnode_vput(dv);
+
+		if ((v->v_flags == VNEGATIVE) ||
+		    (*p == '/' && v->v_type != VDIR)) {
+			/* not found */
+			vfs_vnode_vput(v);
+			return VMM_ENOENT;
 		}
 
 		dv = v;
@@ -500,8 +646,9 @@ static void vfs_force_unmount(struct mount *m)
 {
 	int i;
 	bool found;
-	struct vnode *v;
+	struct vnode *v, *tv;
 	struct mount *tm;
+	struct dlist freelist;
 
 	/* First flush mount points having 
 	 * covered node under this mount point
@@ -543,36 +690,31 @@ static void vfs_force_unmount(struct mount *m)
 	vmm_mutex_unlock(&vfsc.fd_bmap_lock);
 
 	/* Flush all vnodes from this mount point */
+	INIT_LIST_HEAD(&freelist);
+	vmm_mutex_lock(&vfsc.vnode_lock);
 	for (i = 0; i < VFS_VNODE_HASH_SIZE; i++) {
-		vmm_mutex_lock(&vfsc.vnode_list_lock[i]);
-
-		while (1) {
-			found = FALSE;
-			list_for_each_entry(v, &vfsc.vnode_list[i], v_link) {
-				if (v->v_mount == m) {
-					found = TRUE;
-					break;
-				}
-			}
-			if (!found) {
-				break;
+		list_for_each_entry_safe(v, tv, &vfsc.vnode_list[i], v_link) {
+			if (v->v_mount != m) {
+				continue;
 			}
 
-			/* Remove vnode from hash list */
-			list_del(&v->v_link);
-
-			/* Deallocate fs specific data from this vnode */
-			vmm_mutex_lock(&v->v_mount->m_lock);
-			v->v_mount->m_fs->vput(v->v_mount, v);
-			vmm_mutex_unlock(&v->v_mount->m_lock);
-
-			/* Free vnode */
-			vmm_free(v);
+			/* Remove vnode from hash list and vnode cache */
+			list_del_init(&v->v_link);
+			if (!list_empty(&v->v_lru)) {
+				list_del(&v->v_lru);
+				vfsc.vnode_lru_count--;
+			}
+			list_add_tail(&v->v_lru, &freelist);
 		}
-
-		vmm_mutex_unlock(&vfsc.vnode_list_lock[i]);
+	}
+	vmm_mutex_unlock(&vfsc.vnode_lock);
+	if (m->m_root) {
+		list_add_tail(&m->m_root->v_lru, &freelist);
 	}
 
+	/* Deallocate fs specific data and free vnodes */
+	vfs_vnode_free_list(&freelist);
+
 	/* Call filesytem unmount */
 	vmm_mutex_lock(&m->m_lock);
 	m->m_fs->unmount(m);
@@ -629,6 +771,76 @@ static int vfs_blockdev_notification(struct vmm_notifier_block *nb,
 	return NOTIFY_OK;
 }
 
+#if defined(CONFIG_VFS_BUFFER_CACHE)
+
+#define VFS_BCACHE_DISABLE_RETRY	1000
+
+static struct vmm_blockdev *vfs_bdev_root(struct vmm_blockdev *bdev)
+{
+	while (bdev->parent) {
+		bdev = bdev->parent;
+	}
+
+	return bdev;
+}
+
+/* Enable page cache of mounted block device if not already enabled.
+ * The page cache is shared by all partitions of block device.
+ */
+static void vfs_bcache_attach(struct mount *m)
+{
+	int rc;
+
+	rc = vmm_blockcache_enable(m->m_dev, CONFIG_VFS_BUFFER_CACHE_KB,
+				   (m->m_flags & MOUNT_RW) ?
+				   VMM_BLOCKCACHE_WRITEBACK :
+				   VMM_BLOCKCACHE_WRITETHROUGH);
+	m->m_bcache = (rc == VMM_OK) ? TRUE : FALSE;
+}
+
+/* Disable page cache enabled by mount unless some other mount
+ * uses the same block device in which case it takes over the
+ * page cache.
+ * Note: Must be called with mount list lock held.
+ */
+static void vfs_bcache_detach(struct mount *m)
+{
+	u32 retry = VFS_BCACHE_DISABLE_RETRY;
+	struct mount *tm;
+
+	if (!m->m_bcache) {
+		return;
+	}
+	m->m_bcache = FALSE;
+
+	list_for_each_entry(tm, &vfsc.mnt_list, m_link) {
+		if ((tm != m) && (vfs_bdev_root(tm->m_dev) ==
+				  vfs_bdev_root(m->m_dev))) {
+			tm->m_bcache = TRUE;
+			return;
+		}
+	}
+
+	/* Wait for writeback of dirty pages */
+	while ((vmm_blockcache_disable(m->m_dev) == VMM_EBUSY) && retry) {
+		vmm_msleep(1);
+		retry--;
+	}
+}
+
+#else
+
+static void vfs_bcache_attach(struct mount *m)
+{
+	m->m_bcache = FALSE;
+}
+
+static void vfs_bcache_detach(struct mount *m)
+{
+}
+
+#endif
+
 int vfs_mount(const char *dir, const char *fsname, const char *dev, u32 flags)
 {
 	int err;
@@ -698,7 +910,7 @@ int vfs_mount(const char *dir, const char *fsname, const char *dev, u32 flags)
 	m->m_covered = v_covered;
 
 	/* create a root vnode for this file system. */
-	if (!(v = vfs_vnode_vget(m, "/"))) {
+	if (!(v = vfs_vnode_vget(m, NULL, "/"))) {
 		if (m->m_covered) {
 			vfs_vnode_release(m->m_covered);
 		}
@@ -710,11 +922,17 @@ int vfs_mount(const char *dir, const char *fsname, const char *dev, u32 flags)
 	v->v_mode = S_IFDIR | S_IRWXU | S_IRWXG | S_IRWXO;
 	m->m_root = v;
 
+	/* cache blocks read by file system specific routines. */
+	vfs_bcache_attach(m);
+
 	/* call a file system specific routine. */
 	vmm_mutex_lock(&m->m_lock);
 	err = m->m_fs->mount(m, dev, flags);
 	vmm_mutex_unlock(&m->m_lock);
 	if (err != 0) {
+		vmm_mutex_lock(&vfsc.mnt_list_lock);
+		vfs_bcache_detach(m);
+		vmm_mutex_unlock(&vfsc.mnt_list_lock);
 		vfs_vnode_release(m->m_root);
 		if (m->m_covered) {
 			vfs_vnode_release(m->m_covered);
@@ -737,6 +955,9 @@ int vfs_mount(const char *dir, const char *fsname, const char *dev, u32 flags)
 			vmm_mutex_lock(&m->m_lock);
 			m->m_fs->unmount(m);
 			vmm_mutex_unlock(&m->m_lock);
+			vmm_mutex_lock(&vfsc.mnt_list_lock);
+			vfs_bcache_detach(m);
+			vmm_mutex_unlock(&vfsc.mnt_list_lock);
 			vfs_vnode_release(m->m_root);
 			if (m->m_covered) {
 				vfs_vnode_release(m->m_covered);
@@ -754,6 +975,117 @@ int vfs_mount(const char *dir, const char *fsname, const char *dev, u32 flags)
 }
 VMM_EXPORT_SYMBOL(vfs_mount);
 
+static void vfs_mount_work_func(struct vmm_work *work)
+{
+	int num, count;
+	struct filesystem *fs;
+	struct vfs_mount_work *mw =
+			container_of(work, struct vfs_mount_work, work);
+
+	/* Block device might be probed after boot commands start */
+	while (!vmm_blockdev_find(mw->dev) && mw->wait_secs) {
+		vmm_msleep(1000);
+		mw->wait_secs--;
+	}
+
+	if (mw->fsname[0] != '\0') {
+		mw->rc = vfs_mount(mw->dir, mw->fsname, mw->dev, mw->flags);
+	} else {
+		mw->rc = VMM_ENOSYS;
+		count = vfs_filesystem_count();
+		for (num = 0; num < count; num++) {
+			fs = vfs_filesystem_get(num);
+			if (!fs) {
+				continue;
+			}
+			mw->rc = vfs_mount(mw->dir, fs->name,
+					   mw->dev, mw->flags);
+			if (!mw->rc) {
+				break;
+			}
+		}
+	}
+
+	if (mw->rc) {
+		vmm_printf("vfs: failed to mount %s at %s (error %d)\n",
+			   mw->dev, mw->dir, mw->rc);
+	} else {
+		vmm_printf("vfs: mounted %s at %s\n", mw->dev, mw->dir);
+	}
+
+	vmm_completion_complete(&mw->done);
+}
+
+int vfs_mount_async(const char *dir, const char *fsname,
+		    const char *dev, u32 flags, u32 wait_secs)
+{
+	int rc;
+	struct vfs_mount_work *mw;
+
+	if (!dir || !dev) {
+		return VMM_EINVALID;
+	}
+
+	mw = vmm_zalloc(sizeof(*mw));
+	if (!mw) {
+		return VMM_ENOMEM;
+	}
+
+	INIT_WORK(&mw->work, vfs_mount_work_func);
+	INIT_LIST_HEAD(&mw->head);
+	INIT_COMPLETION(&mw->done);
+	strncpy(mw->dir, dir, sizeof(mw->dir) - 1);
+	if (fsname) {
+		strncpy(mw->fsname, fsname, sizeof(mw->fsname) - 1);
+	}
+	strncpy(mw->dev, dev, sizeof(mw->dev) - 1);
+	mw->flags = flags;
+	mw->wait_secs = wait_secs;
+
+	/* Spread mounts over workers so that they run in parallel */
+	vmm_mutex_lock(&vfsc.mnt_work_lock);
+	list_add_tail(&mw->head, &vfsc.mnt_work_list);
+	rc = vmm_workqueue_schedule_work(
+		vfsc.aio_wq[vfsc.mnt_work_next++ % VFS_AIO_WORKER_COUNT],
+		&mw->work);
+	if (rc) {
+		list_del(&mw->head);
+		vmm_free(mw);
+	}
+	vmm_mutex_unlock(&vfsc.mnt_work_lock);
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vfs_mount_async);
+
+int vfs_mount_async_wait(void)
+{
+	int rc = VMM_OK;
+	struct vfs_mount_work *mw;
+
+	BUG_ON(!vmm_scheduler_orphan_context());
+
+	vmm_mutex_lock(&vfsc.mnt_work_lock);
+	while (!list_empty(&vfsc.mnt_work_list)) {
+		mw = list_first_entry(&vfsc.mnt_work_list,
+				      struct vfs_mount_work, head);
+		list_del(&mw->head);
+		vmm_mutex_unlock(&vfsc.mnt_work_lock);
+
+		vmm_completion_wait(&mw->done);
+		if (!rc) {
+			rc = mw->rc;
+		}
+		vmm_free(mw);
+
+		vmm_mutex_lock(&vfsc.mnt_work_lock);
+	}
+	vmm_mutex_unlock(&vfsc.mnt_work_lock);
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vfs_mount_async_wait);
+
 int vfs_unmount(const char *path)
 {
 	int err;
@@ -778,6 +1110,9 @@ int vfs_unmount(const char *path)
 		return VMM_EINVALID;
 	}
 
+	/* drop unused vnodes of mount point from vnode cache */
+	vfs_vnode_shrink(m, NULL);
+
 	/* mount point reference count should be 1 
 	 * otherwise it is busy.
 	 */
@@ -797,6 +1132,11 @@ int vfs_unmount(const char *path)
 	m->m_fs->unmount(m);
 	vmm_mutex_unlock(&m->m_lock);
 
+	/* write back and release buffer cache */
+	vmm_mutex_lock(&vfsc.mnt_list_lock);
+	vfs_bcache_detach(m);
+	vmm_mutex_unlock(&vfsc.mnt_list_lock);
+
 	/* releae mount point root */
 	vfs_vnode_release(m->m_root);
 
@@ -940,6 +1280,7 @@ int vfs_open(const char *path, u32 flags, u32 mode)
 			vmm_mutex_lock(&dv->v_lock);
 			err = dv->v_mount->m_fs->create(dv, filename, mode);
 			vmm_mutex_unlock(&dv->v_lock);
+			vfs_vnode_forget(dv, filename);
 			vfs_vnode_release(dv);
 			if (err) {
 				return err;
@@ -1030,6 +1371,11 @@ int vfs_close(int fd)
 		return VMM_EINVALID;
 	}
 
+	if (f->f_aio_count) {
+		vmm_mutex_unlock(&f->f_lock);
+		return VMM_EBUSY;
+	}
+
 	vmm_mutex_lock(&v->v_lock);
 	err = v->v_mount->m_fs->sync(v);
 	vmm_mutex_unlock(&v->v_lock);
@@ -1094,6 +1440,164 @@ size_t vfs_read(int fd, void *buf, size_t len)
 }
 VMM_EXPORT_SYMBOL(vfs_read);
 
+size_t vfs_read_into_host(int fd, physical_addr_t hphys_addr, size_t len,
+			  void (*observe)(void *priv, const void *buf,
+					  size_t len),
+			  void *priv)
+{
+	size_t ret = 0, chunk, rd;
+	virtual_addr_t va;
+
+	BUG_ON(!vmm_scheduler_orphan_context());
+
+	while (ret < len) {
+		/* Chunks end at chunk size boundary of host address
+		 * so that they can be mapped using huge pages.
+		 */
+		chunk = VFS_GUEST_READ_CHUNK_SZ -
+			(hphys_addr & (VFS_GUEST_READ_CHUNK_SZ - 1));
+		if ((len - ret) < chunk) {
+			chunk = len - ret;
+		}
+
+		/* Filesystem reads straight into host pages through
+		 * cacheable mapping and whole chunk is flushed at once
+		 * instead of writing through uncached mapping.
+		 */
+		va = vmm_host_memmap(hphys_addr, chunk,
+				     VMM_MEMORY_FLAGS_NORMAL);
+		rd = vfs_read(fd, (void *)va, chunk);
+		if (observe && rd) {
+			observe(priv, (const void *)va, rd);
+		}
+		vmm_flush_dcache_range(va, va + rd);
+		vmm_host_memunmap(va);
+
+		ret += rd;
+		hphys_addr += rd;
+		if (rd != chunk) {
+			break;
+		}
+	}
+
+	return ret;
+}
+VMM_EXPORT_SYMBOL(vfs_read_into_host);
+
+size_t vfs_read_into_guest(int fd, struct vmm_guest *guest,
+			   physical_addr_t gphys_addr, size_t len,
+			   void (*observe)(void *priv, const void *buf,
+					   size_t len),
+			   void *priv)
+{
+	size_t ret = 0, chunk, rd;
+	struct vmm_region *reg;
+
+	BUG_ON(!vmm_scheduler_orphan_context());
+
+	if (!guest || !len) {
+		return 0;
+	}
+
+	while (ret < len) {
+		reg = vmm_guest_find_region(guest, gphys_addr,
+				VMM_REGION_REAL | VMM_REGION_MEMORY, TRUE);
+		if (!reg) {
+			break;
+		}
+
+		chunk = VMM_REGION_GPHYS_END(reg) - gphys_addr;
+		if ((len - ret) < chunk) {
+			chunk = len - ret;
+		}
+
+		rd = vfs_read_into_host(fd,
+				VMM_REGION_GPHYS_TO_HPHYS(reg, gphys_addr), chunk,
+				observe, priv);
+
+		ret += rd;
+		gphys_addr += rd;
+		if (rd != chunk) {
+			break;
+		}
+	}
+
+	return ret;
+}
+VMM_EXPORT_SYMBOL(vfs_read_into_guest);
+
+int vfs_mmap(int fd, loff_t off, size_t len, physical_addr_t *pa)
+{
+	int rc;
+	u64 dev_off, first_dev_off = 0;
+	size_t done, ext_len;
+	struct vnode *v;
+	struct file *f;
+
+	BUG_ON(!vmm_scheduler_orphan_context());
+
+	if (!len || !pa) {
+		return VMM_EINVALID;
+	}
+
+	f = vfs_fd_to_file(fd);
+	if (!f) {
+		return VMM_EINVALID;
+	}
+
+	vmm_mutex_lock(&f->f_lock);
+
+	v = f->f_vnode;
+	if (!v || (v->v_type != VREG)) {
+		vmm_mutex_unlock(&f->f_lock);
+		return VMM_EINVALID;
+	}
+
+	if (!v->v_mount->m_fs->bmap) {
+		vmm_mutex_unlock(&f->f_lock);
+		return VMM_EOPNOTSUPP;
+	}
+
+	vmm_mutex_lock(&v->v_lock);
+
+	if (v->v_size < (off + len)) {
+		rc = VMM_ERANGE;
+		goto done;
+	}
+
+	/* Dirty data cached by filesystem must reach block device */
+	rc = v->v_mount->m_fs->sync(v);
+	if (rc) {
+		goto done;
+	}
+
+	/* Whole byte range must be contiguous on block device */
+	done = 0;
+	while (done < len) {
+		rc = v->v_mount->m_fs->bmap(v, off + done, &dev_off, &ext_len);
+		if (rc) {
+			goto done;
+		}
+		if (!done) {
+			first_dev_off = dev_off;
+		} else if (dev_off != (first_dev_off + done)) {
+			rc = VMM_ENOTAVAIL;
+			goto done;
+		}
+		done += (ext_len < (len - done)) ? ext_len : (len - done);
+	}
+
+	rc = vmm_blockdev_direct_access(v->v_mount->m_dev,
+					first_dev_off, len, pa);
+
+done:
+	vmm_mutex_unlock(&v->v_lock);
+	vmm_mutex_unlock(&f->f_lock);
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vfs_mmap);
+
 size_t vfs_write(int fd, void *buf, size_t len)
 {
 	size_t ret;
@@ -1140,6 +1644,107 @@ size_t vfs_write(int fd, void *buf, size_t len)
 }
 VMM_EXPORT_SYMBOL(vfs_write);
 
+static void vfs_aio_work(struct vmm_work *work)
+{
+	struct vfs_aio *aio = container_of(work, struct vfs_aio, work);
+	struct file *f = vfs_fd_to_file(aio->fd);
+	struct vnode *v;
+
+	/* Pending request keeps file descriptor open
+	 * unless mount point was forcefully unmounted
+	 */
+	vmm_mutex_lock(&f->f_lock);
+	v = f->f_vnode;
+	vmm_mutex_unlock(&f->f_lock);
+
+	if (v) {
+		vmm_mutex_lock(&v->v_lock);
+		if (aio->write) {
+			aio->ret = v->v_mount->m_fs->write(v, aio->off,
+							   aio->buf, aio->len);
+		} else {
+			aio->ret = v->v_mount->m_fs->read(v, aio->off,
+							  aio->buf, aio->len);
+		}
+		vmm_mutex_unlock(&v->v_lock);
+	}
+
+	vmm_mutex_lock(&f->f_lock);
+	if (f->f_aio_count) {
+		f->f_aio_count--;
+	}
+	vmm_mutex_unlock(&f->f_lock);
+
+	if (aio->done) {
+		aio->done(aio);
+	} else {
+		vmm_completion_complete(&aio->cmpl);
+	}
+}
+
+int vfs_aio_submit(struct vfs_aio *aio)
+{
+	int rc;
+	struct vnode *v;
+	struct file *f;
+
+	BUG_ON(!vmm_scheduler_orphan_context());
+
+	if (!aio || !aio->buf || !aio->len) {
+		return VMM_EINVALID;
+	}
+
+	f = vfs_fd_to_file(aio->fd);
+	if (!f) {
+		return VMM_EINVALID;
+	}
+
+	vmm_mutex_lock(&f->f_lock);
+
+	v = f->f_vnode;
+	if (!v || (v->v_type != VREG)) {
+		vmm_mutex_unlock(&f->f_lock);
+		return VMM_EINVALID;
+	}
+
+	if (!(f->f_flags & ((aio->write) ? O_WRONLY : O_RDONLY))) {
+		vmm_mutex_unlock(&f->f_lock);
+		return VMM_EACCESS;
+	}
+
+	aio->ret = 0;
+	INIT_WORK(&aio->work, vfs_aio_work);
+	INIT_COMPLETION(&aio->cmpl);
+
+	/* Same worker for a file descriptor keeps requests ordered */
+	f->f_aio_count++;
+	rc = vmm_workqueue_schedule_work(
+			vfsc.aio_wq[aio->fd % VFS_AIO_WORKER_COUNT],
+			&aio->work);
+	if (rc) {
+		f->f_aio_count--;
+	}
+
+	vmm_mutex_unlock(&f->f_lock);
+
+	return rc;
+}
+VMM_EXPORT_SYMBOL(vfs_aio_submit);
+
+size_t vfs_aio_wait(struct vfs_aio *aio)
+{
+	BUG_ON(!vmm_scheduler_orphan_context());
+
+	if (!aio || aio->done) {
+		return 0;
+	}
+
+	vmm_completion_wait(&aio->cmpl);
+
+	return aio->ret;
+}
+VMM_EXPORT_SYMBOL(vfs_aio_wait);
+
 loff_t vfs_lseek(int fd, loff_t off, int whence)
 {
 	loff_t ret;
@@ -1244,6 +1849,11 @@ int vfs_fsync(int fd)
 	err = v->v_mount->m_fs->sync(v);
 	vmm_mutex_unlock(&v->v_lock);
 
+	/* write back blocks held by buffer cache */
+	if (!err) {
+		err = vmm_blockdev_flush_cache(v->v_mount->m_dev);
+	}
+
 	vmm_mutex_unlock(&f->f_lock);
 
 	return err;
@@ -1501,6 +2111,7 @@ int vfs_mkdir(const char *path, u32 mode)
 	if (err) {
 		goto fail;
 	}
+	vfs_vnode_forget(dv, name);
 
 	err = dv->v_mount->m_fs->sync(dv);
 
@@ -1566,6 +2177,9 @@ int vfs_rmdir(const char *path)
 		return err;
 	}
 
+	/* cached vnodes under directory hold its reference */
+	vfs_vnode_shrink(v->v_mount, v);
+
 	if ((v->v_flags == VROOT) || 
 	    (arch_atomic_read(&v->v_refcnt) >= 2)) {
 		vfs_vnode_release(v);
@@ -1589,6 +2203,7 @@ int vfs_rmdir(const char *path)
 	if (err) {
 		goto fail;
 	}
+	vfs_vnode_forget(dv, name);
 
 	err = v->v_mount->m_fs->sync(v);
 	if (err) {
@@ -1644,6 +2259,9 @@ int vfs_rename(const char *src, const char *dest)
 		goto fail1;
 	}
 
+	/* cached vnodes under source hold its reference */
+	vfs_vnode_shrink(v1->v_mount, v1);
+
 	/* check if source is busy ? */
 	if (arch_atomic_read(&v1->v_refcnt) >= 2) {
 		err = VMM_EBUSY;
@@ -1686,6 +2304,8 @@ int vfs_rename(const char *src, const char *dest)
 	if (err) {
 		goto fail4;
 	}
+	vfs_vnode_forget(sv, sname);
+	vfs_vnode_forget(dv, dname);
 
 	err = sv->v_mount->m_fs->sync(sv);
 	if (err) {
@@ -1771,6 +2391,7 @@ int vfs_unlink(const char *path)
 	if (err) {
 		goto fail2;
 	}
+	vfs_vnode_forget(dv, name);
 
 	err = dv->v_mount->m_fs->sync(dv);
 
@@ -2043,10 +2664,12 @@ static int __init vfs_init(void)
 	INIT_MUTEX(&vfsc.mnt_list_lock);
 	INIT_LIST_HEAD(&vfsc.mnt_list);
 
+	INIT_MUTEX(&vfsc.vnode_lock);
 	for (i = 0; i < VFS_VNODE_HASH_SIZE; i++) {
-		INIT_MUTEX(&vfsc.vnode_list_lock[i]);
 		INIT_LIST_HEAD(&vfsc.vnode_list[i]);
 	};
+	INIT_LIST_HEAD(&vfsc.vnode_lru);
+	vfsc.vnode_lru_count = 0;
 
 	INIT_MUTEX(&vfsc.fd_bmap_lock);
 	vfsc.fd_bmap = vmm_zalloc(bitmap_estimate_size(VFS_MAX_FD));
@@ -2059,6 +2682,22 @@ static int __init vfs_init(void)
 		INIT_MUTEX(&vfsc.fd[i].f_lock);
 	}
 
+	INIT_MUTEX(&vfsc.mnt_work_lock);
+	INIT_LIST_HEAD(&vfsc.mnt_work_list);
+	vfsc.mnt_work_next = 0;
+
+	for (i = 0; i < VFS_AIO_WORKER_COUNT; i++) {
+		vfsc.aio_wq[i] = vmm_workqueue_create("vfs_aio",
+						VMM_THREAD_DEF_PRIORITY);
+		if (!vfsc.aio_wq[i]) {
+			while (i--) {
+				vmm_workqueue_destroy(vfsc.aio_wq[i]);
+			}
+			vmm_free(vfsc.fd_bmap);
+			return VMM_ENOMEM;
+		}
+	}
+
 	vfsc.bdev_client.notifier_call = &vfs_blockdev_notification;
 	vfsc.bdev_client.priority = 0;
 	vmm_blockdev_register_client(&vfsc.bdev_client);
@@ -2068,7 +2707,12 @@ static int __init vfs_init(void)
 
 static void __exit vfs_exit(void)
 {
+	int i;
+
 	vmm_blockdev_unregister_client(&vfsc.bdev_client);
+	for (i = 0; i < VFS_AIO_WORKER_COUNT; i++) {
+		vmm_workqueue_destroy(vfsc.aio_wq[i]);
+	}
 	vmm_free(vfsc.fd_bmap);
 }
 
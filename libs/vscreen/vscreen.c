@@ -30,6 +30,7 @@
 #include <vmm_completion.h>
 #include <vmm_threads.h>
 #include <vmm_workqueue.h>
+#include <vmm_host_aspace.h>
 #include <arch_atomic.h>
 #include <vio/vmm_keymaps.h>
 #include <libs/list.h>
@@ -64,6 +65,8 @@ typedef enum {
 #define VSCREEN_DEFAULT_FC	VSCREEN_COLOR_WHITE
 #define VSCREEN_DEFAULT_BC	VSCREEN_COLOR_BLACK
 
+#define VSCREEN_MAX_DAMAGE	8
+
 typedef enum {
 	VSCREEN_WORK_EXIT,
 	VSCREEN_MAX_WORK,
@@ -74,6 +77,10 @@ struct vscreen_work {
 	u32 type;
 };
 
+struct vscreen_rect {
+	int x, y, w, h;
+};
+
 struct vscreen_context {
 	/* Parameters */
 	bool is_hard;
@@ -109,6 +116,13 @@ struct vscreen_context {
 	struct fb_var_screeninfo hard_var;
 	physical_addr_t hard_smem_start;
 	u32 hard_smem_len;
+	/* Soft bind state */
+	struct vmm_surface soft_surface;
+	void *soft_data;
+	u32 soft_data_pages;
+	vmm_spinlock_t damage_lock;
+	u32 damage_count;
+	struct vscreen_rect damage[VSCREEN_MAX_DAMAGE];
 	/* Work queue */
 	u64 work_timeout;
 	vmm_spinlock_t work_list_lock;
@@ -594,19 +608,20 @@ static void vscreen_keyboard_event(struct vscreen_context *cntx,
 	DPRINTF("%s: vkey=%d vkeycode=%d\n",
 		__func__, vkey, vkeycode);
 
-	/* Inject virtual keyboard event */
+	/* Inject virtual keyboard event as one report */
 	if (value) {
 		if (vkeycode & SCANCODE_GREY) {
-			vmm_vkeyboard_event(cntx->vkbd, SCANCODE_EMUL0);
+			vmm_vkeyboard_report(cntx->vkbd, SCANCODE_EMUL0);
 		}
-		vmm_vkeyboard_event(cntx->vkbd,
+		vmm_vkeyboard_report(cntx->vkbd,
 					vkeycode & SCANCODE_KEYCODEMASK);
 	} else {
 		if (vkeycode & SCANCODE_GREY) {
-			vmm_vkeyboard_event(cntx->vkbd, SCANCODE_EMUL0);
+			vmm_vkeyboard_report(cntx->vkbd, SCANCODE_EMUL0);
 		}
-		vmm_vkeyboard_event(cntx->vkbd, vkeycode | SCANCODE_UP);
+		vmm_vkeyboard_report(cntx->vkbd, vkeycode | SCANCODE_UP);
 	}
+	vmm_vkeyboard_sync(cntx->vkbd);
 }
 
 static void vscreen_mouse_event(struct vscreen_context *cntx,
@@ -725,8 +740,133 @@ done:
 	return VMM_OK;
 }
 
+/* Note: This function must be called with damage_lock held */
+static void __vscreen_damage_add(struct vscreen_context *cntx,
+				 int x, int y, int w, int h)
+{
+	u32 i;
+	int x2, y2;
+	struct vscreen_rect *d;
+	struct vmm_surface *s = &cntx->soft_surface;
+
+	/* Clip to soft surface */
+	x2 = min(x + w, s->width);
+	y2 = min(y + h, s->height);
+	x = max(x, 0);
+	y = max(y, 0);
+	if ((x2 <= x) || (y2 <= y)) {
+		return;
+	}
+
+	/* Merge with all overlapping or touching rectangles */
+	i = 0;
+	while (i < cntx->damage_count) {
+		d = &cntx->damage[i];
+		if ((x2 < d->x) || ((d->x + d->w) < x) ||
+		    (y2 < d->y) || ((d->y + d->h) < y)) {
+			i++;
+			continue;
+		}
+		x2 = max(x2, d->x + d->w);
+		y2 = max(y2, d->y + d->h);
+		x = min(x, d->x);
+		y = min(y, d->y);
+		cntx->damage[i] = cntx->damage[--cntx->damage_count];
+		i = 0;
+	}
+
+	/* Collapse into bounding rectangle when there are too many */
+	if (cntx->damage_count == VSCREEN_MAX_DAMAGE) {
+		for (i = 0; i < cntx->damage_count; i++) {
+			d = &cntx->damage[i];
+			x2 = max(x2, d->x + d->w);
+			y2 = max(y2, d->y + d->h);
+			x = min(x, d->x);
+			y = min(y, d->y);
+		}
+		cntx->damage_count = 0;
+	}
+
+	d = &cntx->damage[cntx->damage_count++];
+	d->x = x;
+	d->y = y;
+	d->w = x2 - x;
+	d->h = y2 - y;
+}
+
+static void vscreen_damage_full(struct vscreen_context *cntx)
+{
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&cntx->damage_lock, flags);
+	cntx->damage_count = 0;
+	__vscreen_damage_add(cntx, 0, 0, cntx->soft_surface.width,
+			     cntx->soft_surface.height);
+	vmm_spin_unlock_irqrestore(&cntx->damage_lock, flags);
+}
+
+static void vscreen_soft_gfx_clear(struct vmm_surface *s)
+{
+	struct vscreen_context *cntx =
+		container_of(s, struct vscreen_context, soft_surface);
+
+	memset(s->data, 0, s->data_size);
+	vscreen_damage_full(cntx);
+}
+
+static void vscreen_soft_gfx_update(struct vmm_surface *s,
+				    int x, int y, int w, int h)
+{
+	irq_flags_t flags;
+	struct vscreen_context *cntx =
+		container_of(s, struct vscreen_context, soft_surface);
+
+	vmm_spin_lock_irqsave(&cntx->damage_lock, flags);
+	__vscreen_damage_add(cntx, x, y, w, h);
+	vmm_spin_unlock_irqrestore(&cntx->damage_lock, flags);
+}
+
+static void vscreen_soft_gfx_resize(struct vmm_surface *s, int w, int h)
+{
+	struct vscreen_context *cntx =
+		container_of(s, struct vscreen_context, soft_surface);
+
+	/* Soft surface always matches frame buffer mode so,
+	 * just redraw whole of it.
+	 */
+	vscreen_damage_full(cntx);
+}
+
+static const struct vmm_surface_ops vscreen_soft_ops = {
+	.gfx_clear = vscreen_soft_gfx_clear,
+	.gfx_update = vscreen_soft_gfx_update,
+	.gfx_resize = vscreen_soft_gfx_resize,
+};
+
+static void vscreen_soft_blit(struct vscreen_context *cntx,
+			      struct vscreen_rect *r)
+{
+	int y, bpp;
+	u8 *src, *dst;
+	struct vmm_surface *s = &cntx->soft_surface;
+
+	bpp = s->pf.bytes_per_pixel;
+	src = (u8 *)s->data + r->y * vmm_surface_stride(s) + r->x * bpp;
+	dst = (u8 *)cntx->info->screen_base +
+	      r->y * cntx->info->fix.line_length + r->x * bpp;
+	for (y = 0; y < r->h; y++) {
+		memcpy(dst, src, r->w * bpp);
+		src += vmm_surface_stride(s);
+		dst += cntx->info->fix.line_length;
+	}
+}
+
 static int vscreen_soft_refresh(struct vscreen_context *cntx)
 {
+	u32 i, count;
+	irq_flags_t flags;
+	struct vscreen_rect damage[VSCREEN_MAX_DAMAGE];
+
 	/* Do nothing if freezed */
 	if (cntx->freeze) {
 		return VMM_OK;
@@ -737,10 +877,89 @@ static int vscreen_soft_refresh(struct vscreen_context *cntx)
 		return VMM_OK;
 	}
 
-	/* TODO: work in progress */
-	vmm_printf("%s: not available\n", __func__);
+	/* Let virtual display update soft surface which
+	 * accumulates damage rectangles via gfx_update()
+	 */
+	vmm_vdisplay_one_update(cntx->vdis, &cntx->soft_surface);
+
+	/* Take merged damage rectangles of this frame */
+	vmm_spin_lock_irqsave(&cntx->damage_lock, flags);
+	count = cntx->damage_count;
+	for (i = 0; i < count; i++) {
+		damage[i] = cntx->damage[i];
+	}
+	cntx->damage_count = 0;
+	vmm_spin_unlock_irqrestore(&cntx->damage_lock, flags);
 
-	return VMM_EFAIL;
+	/* Blit damage rectangles once per frame */
+	for (i = 0; i < count; i++) {
+		vscreen_soft_blit(cntx, &damage[i]);
+	}
+
+	return VMM_OK;
+}
+
+static int vscreen_soft_setup(struct vscreen_context *cntx)
+{
+	int rc;
+	u32 data_size;
+	struct vmm_pixelformat pf;
+
+	INIT_SPIN_LOCK(&cntx->damage_lock);
+	cntx->damage_count = 0;
+
+	/* Shadow surface matching current frame buffer mode */
+	vmm_pixelformat_init_default(&pf, cntx->info->var.bits_per_pixel);
+	data_size = cntx->info->var.xres * cntx->info->var.yres *
+		    pf.bytes_per_pixel;
+	cntx->soft_data_pages = VMM_SIZE_TO_PAGE(data_size);
+	cntx->soft_data = (void *)vmm_host_alloc_pages(cntx->soft_data_pages,
+						VMM_MEMORY_FLAGS_NORMAL);
+	if (!cntx->soft_data) {
+		return VMM_ENOMEM;
+	}
+	memset(cntx->soft_data, 0, data_size);
+
+	rc = vmm_surface_init(&cntx->soft_surface, cntx->name,
+			      cntx->soft_data, data_size,
+			      cntx->info->var.yres, cntx->info->var.xres,
+			      0, &pf, &vscreen_soft_ops, cntx);
+	if (rc) {
+		goto free_data;
+	}
+
+	rc = vmm_vdisplay_add_surface(cntx->vdis, &cntx->soft_surface);
+	if (rc) {
+		goto free_data;
+	}
+
+	/* Force full redraw on first refresh */
+	vmm_vdisplay_invalidate(cntx->vdis);
+	vscreen_damage_full(cntx);
+
+	return VMM_OK;
+
+free_data:
+	vmm_host_free_pages((virtual_addr_t)cntx->soft_data,
+			    cntx->soft_data_pages);
+	cntx->soft_data = NULL;
+	return rc;
+}
+
+static void vscreen_soft_cleanup(struct vscreen_context *cntx)
+{
+	/* Do nothing if soft surface not available */
+	if (!cntx->soft_data) {
+		return;
+	}
+
+	if (cntx->vdis) {
+		vmm_vdisplay_del_surface(cntx->vdis, &cntx->soft_surface);
+	}
+
+	vmm_host_free_pages((virtual_addr_t)cntx->soft_data,
+			    cntx->soft_data_pages);
+	cntx->soft_data = NULL;
 }
 
 static void vscreen_hard_switch_back(struct vscreen_context *cntx)
@@ -971,6 +1190,11 @@ static void vscreen_restore(struct fb_info *info, void *priv)
 	/* Erase display */
 	vscreen_blank_display(cntx);
 
+	/* Redraw whole soft surface on next refresh */
+	if (cntx->soft_data) {
+		vscreen_damage_full(cntx);
+	}
+
 	/* Connect input handler */
 	input_connect_handler(&cntx->hndl);
 
@@ -1170,6 +1394,14 @@ static int vscreen_setup(struct vscreen_context *cntx)
 	/* Make sure hard bind state is off */
 	cntx->hard_vdis = FALSE;
 
+	/* Setup soft surface for soft bind */
+	if (!cntx->is_hard) {
+		rc = vscreen_soft_setup(cntx);
+		if (rc) {
+			goto dealloc_cmap;
+		}
+	}
+
 	/* Setup work queue */
 	cntx->work_timeout = udiv64(1000000000ULL, cntx->refresh_rate);
 	INIT_SPIN_LOCK(&cntx->work_list_lock);
@@ -1181,7 +1413,7 @@ static int vscreen_setup(struct vscreen_context *cntx)
 	cntx->vdis_client.priority = 0;
 	rc = vmm_vdisplay_register_client(&cntx->vdis_client);
 	if (rc) {
-		goto dealloc_cmap;
+		goto soft_cleanup;
 	}
 
 	/* Register vinput notifier client */
@@ -1196,6 +1428,8 @@ static int vscreen_setup(struct vscreen_context *cntx)
 
 unreg_vdisplay_client:
 	vmm_vdisplay_unregister_client(&cntx->vdis_client);
+soft_cleanup:
+	vscreen_soft_cleanup(cntx);
 dealloc_cmap:
 	fb_dealloc_cmap(&cntx->cmap);
 release_fb:
@@ -1221,6 +1455,9 @@ static int vscreen_cleanup(struct vscreen_context *cntx)
 	/* Unregister vdisplay notifier client */
 	vmm_vdisplay_unregister_client(&cntx->vdis_client);
 
+	/* Remove and free soft surface for soft bind */
+	vscreen_soft_cleanup(cntx);
+
 	/* Dealloc color map */
 	fb_dealloc_cmap(&cntx->cmap);
 
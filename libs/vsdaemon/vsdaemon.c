@@ -25,6 +25,8 @@
 #include <vmm_macros.h>
 #include <vmm_heap.h>
 #include <vmm_mutex.h>
+#include <vmm_spinlocks.h>
+#include <vmm_stdio.h>
 #include <vmm_modules.h>
 #include <libs/stringlib.h>
 #include <libs/vsdaemon.h>
@@ -36,11 +38,22 @@
 #define	MODULE_INIT			vsdaemon_init
 #define	MODULE_EXIT			vsdaemon_exit
 
+#define VSDAEMON_WORKER_COUNT		CONFIG_VSDAEMON_WORKER_COUNT
+
+#define VSDAEMON_SCHED_QUEUED		0x1
+#define VSDAEMON_SCHED_RUNNING		0x2
+#define VSDAEMON_SCHED_PENDING		0x4
+#define VSDAEMON_SCHED_DEAD		0x8
+
 struct vsdaemon_control {
 	struct vmm_mutex vsd_list_lock;
 	struct dlist vsd_list;
 	struct dlist vsd_trans_list;
 	struct vmm_notifier_block vser_client;
+	vmm_spinlock_t ready_lock;
+	struct dlist ready_list;
+	struct vmm_completion ready_avail;
+	struct vmm_thread *workers[VSDAEMON_WORKER_COUNT];
 };
 
 static struct vsdaemon_control vsdc;
@@ -190,11 +203,108 @@ u32 vsdaemon_transport_count(void)
 }
 VMM_EXPORT_SYMBOL(vsdaemon_transport_count);
 
-static void vsdaemon_vserial_recv(struct vmm_vserial *vser, void *priv, u8 ch)
+void vsdaemon_schedule(struct vsdaemon *vsd)
+{
+	irq_flags_t flags;
+
+	if (!vsd || !vsd->trans->process) {
+		return;
+	}
+
+	vmm_spin_lock_irqsave(&vsdc.ready_lock, flags);
+
+	if (vsd->sched_flags & VSDAEMON_SCHED_DEAD) {
+		/* Being destroyed so, nothing to do. */
+	} else if (vsd->sched_flags & VSDAEMON_SCHED_RUNNING) {
+		/* Worker will queue it again when done */
+		vsd->sched_flags |= VSDAEMON_SCHED_PENDING;
+	} else if (!(vsd->sched_flags & VSDAEMON_SCHED_QUEUED)) {
+		vsd->sched_flags |= VSDAEMON_SCHED_QUEUED;
+		list_add_tail(&vsd->ready_head, &vsdc.ready_list);
+		vmm_completion_complete(&vsdc.ready_avail);
+	}
+
+	vmm_spin_unlock_irqrestore(&vsdc.ready_lock, flags);
+}
+VMM_EXPORT_SYMBOL(vsdaemon_schedule);
+
+static int vsdaemon_worker(void *data)
+{
+	int rc;
+	irq_flags_t flags;
+	struct vsdaemon *vsd;
+
+	while (1) {
+		vmm_completion_wait(&vsdc.ready_avail);
+
+		vmm_spin_lock_irqsave(&vsdc.ready_lock, flags);
+		if (list_empty(&vsdc.ready_list)) {
+			vmm_spin_unlock_irqrestore(&vsdc.ready_lock, flags);
+			continue;
+		}
+		vsd = list_first_entry(&vsdc.ready_list,
+				       struct vsdaemon, ready_head);
+		list_del_init(&vsd->ready_head);
+		vsd->sched_flags &= ~VSDAEMON_SCHED_QUEUED;
+		vsd->sched_flags |= VSDAEMON_SCHED_RUNNING;
+		vmm_spin_unlock_irqrestore(&vsdc.ready_lock, flags);
+
+		rc = vsd->trans->process(vsd);
+		if (rc) {
+			vmm_printf("%s: %s processing failed (error %d)\n",
+				   __func__, vsd->name, rc);
+		}
+
+		vmm_spin_lock_irqsave(&vsdc.ready_lock, flags);
+		vsd->sched_flags &= ~VSDAEMON_SCHED_RUNNING;
+		if (vsd->sched_flags & VSDAEMON_SCHED_DEAD) {
+			vmm_completion_complete(&vsd->sched_idle);
+		} else if (vsd->sched_flags & VSDAEMON_SCHED_PENDING) {
+			vsd->sched_flags &= ~VSDAEMON_SCHED_PENDING;
+			vsd->sched_flags |= VSDAEMON_SCHED_QUEUED;
+			list_add_tail(&vsd->ready_head, &vsdc.ready_list);
+			vmm_completion_complete(&vsdc.ready_avail);
+		}
+		vmm_spin_unlock_irqrestore(&vsdc.ready_lock, flags);
+	}
+
+	return VMM_OK;
+}
+
+/* Stop scheduling vsdaemon and wait for running worker (if any) */
+static void vsdaemon_unschedule(struct vsdaemon *vsd)
+{
+	bool running;
+	irq_flags_t flags;
+
+	vmm_spin_lock_irqsave(&vsdc.ready_lock, flags);
+	vsd->sched_flags |= VSDAEMON_SCHED_DEAD;
+	if (vsd->sched_flags & VSDAEMON_SCHED_QUEUED) {
+		list_del_init(&vsd->ready_head);
+		vsd->sched_flags &= ~VSDAEMON_SCHED_QUEUED;
+	}
+	running = (vsd->sched_flags & VSDAEMON_SCHED_RUNNING) ? TRUE : FALSE;
+	vmm_spin_unlock_irqrestore(&vsdc.ready_lock, flags);
+
+	if (running) {
+		vmm_completion_wait(&vsd->sched_idle);
+	}
+}
+
+static void vsdaemon_vserial_recv_buf(struct vmm_vserial *vser, void *priv,
+				      u8 *buf, u32 len)
 {
+	u32 i;
 	struct vsdaemon *vsd = priv;
 
-	vsd->trans->receive_char(vsd, ch);
+	if (vsd->trans->receive_buf) {
+		vsd->trans->receive_buf(vsd, buf, len);
+		return;
+	}
+
+	for (i = 0; i < len; i++) {
+		vsd->trans->receive_char(vsd, buf[i]);
+	}
 }
 
 static int vsdaemon_main(void *data)
@@ -255,17 +365,33 @@ int vsdaemon_create(const char *transport_name,
 	strlcpy(vsd->name, daemon_name, sizeof(vsd->name) - 1);
 	vsd->trans = trans;
 	vsd->vser = vser;
+	INIT_LIST_HEAD(&vsd->ready_head);
+	vsd->sched_flags = 0;
+	INIT_COMPLETION(&vsd->sched_idle);
 
 	rc = vsd->trans->setup(vsd, argc, argv);
 	if (rc) {
 		goto fail2;
 	}
 
-	rc = vmm_vserial_register_receiver(vser, &vsdaemon_vserial_recv, vsd);
+	rc = vmm_vserial_register_receiver_buf(vser,
+					       &vsdaemon_vserial_recv_buf, vsd);
 	if (rc) {
 		goto fail3;
 	}
 
+	/* Event driven transports are served by worker threads */
+	if (vsd->trans->process) {
+		list_add_tail(&vsd->head, &vsdc.vsd_list);
+		vsd->trans->use_count++;
+
+		vsdaemon_schedule(vsd);
+
+		vmm_mutex_unlock(&vsdc.vsd_list_lock);
+
+		return VMM_OK;
+	}
+
 	vsd->thread = vmm_threads_create(vsd->name, &vsdaemon_main, vsd, 
 					 VMM_THREAD_DEF_PRIORITY,
 					 VMM_THREAD_DEF_TIME_SLICE);
@@ -284,7 +410,7 @@ int vsdaemon_create(const char *transport_name,
 	return VMM_OK;
 
 fail4:
-	vmm_vserial_unregister_receiver(vser, &vsdaemon_vserial_recv, vsd);
+	vmm_vserial_unregister_receiver_buf(vser, &vsdaemon_vserial_recv_buf, vsd);
 fail3:
 	vsd->trans->cleanup(vsd);
 fail2:
@@ -298,15 +424,21 @@ VMM_EXPORT_SYMBOL(vsdaemon_create);
 /* Note: must be called with vsd_list_lock held */
 static int __vsdaemon_destroy(struct vsdaemon *vsd)
 {
-	vmm_threads_stop(vsd->thread);
+	if (vsd->thread) {
+		vmm_threads_stop(vsd->thread);
+	} else {
+		vsdaemon_unschedule(vsd);
+	}
 
 	vsd->trans->use_count--;
 	list_del(&vsd->head);
 
-	vmm_threads_destroy(vsd->thread);
+	if (vsd->thread) {
+		vmm_threads_destroy(vsd->thread);
+	}
 
-	vmm_vserial_unregister_receiver(vsd->vser, 
-					&vsdaemon_vserial_recv, vsd);
+	vmm_vserial_unregister_receiver_buf(vsd->vser, 
+					    &vsdaemon_vserial_recv_buf, vsd);
 
 	vsd->trans->cleanup(vsd);
 
@@ -446,29 +578,66 @@ again:
 	return NOTIFY_OK;
 }
 
+static void vsdaemon_workers_destroy(void)
+{
+	u32 i;
+
+	for (i = 0; i < VSDAEMON_WORKER_COUNT; i++) {
+		if (!vsdc.workers[i]) {
+			continue;
+		}
+		vmm_threads_stop(vsdc.workers[i]);
+		vmm_threads_destroy(vsdc.workers[i]);
+		vsdc.workers[i] = NULL;
+	}
+}
+
 static int __init vsdaemon_init(void)
 {
 	int rc;
+	u32 i;
+	char name[VMM_FIELD_NAME_SIZE];
 
 	memset(&vsdc, 0, sizeof(vsdc));
 
 	INIT_MUTEX(&vsdc.vsd_list_lock);
 	INIT_LIST_HEAD(&vsdc.vsd_list);
 	INIT_LIST_HEAD(&vsdc.vsd_trans_list);
+	INIT_SPIN_LOCK(&vsdc.ready_lock);
+	INIT_LIST_HEAD(&vsdc.ready_list);
+	INIT_COMPLETION(&vsdc.ready_avail);
+
+	for (i = 0; i < VSDAEMON_WORKER_COUNT; i++) {
+		vmm_snprintf(name, sizeof(name), "vsdaemon/%d", i);
+		vsdc.workers[i] = vmm_threads_create(name, &vsdaemon_worker,
+						     NULL,
+						     VMM_THREAD_DEF_PRIORITY,
+						     VMM_THREAD_DEF_TIME_SLICE);
+		if (!vsdc.workers[i]) {
+			rc = VMM_EFAIL;
+			goto fail;
+		}
+		vmm_threads_start(vsdc.workers[i]);
+	}
 
 	vsdc.vser_client.notifier_call = &vsdaemon_vserial_notification;
 	vsdc.vser_client.priority = 0;
 	rc = vmm_vserial_register_client(&vsdc.vser_client);
 	if (rc) {
-		return rc;
+		goto fail;
 	}
 
 	return VMM_OK;
+
+fail:
+	vsdaemon_workers_destroy();
+	return rc;
 }
 
 static void __exit vsdaemon_exit(void)
 {
 	vmm_vserial_unregister_client(&vsdc.vser_client);
+	vsdaemon_workers_destroy();
 }
 
 VMM_DECLARE_MODULE(MODULE_DESC, 
@@ -49,6 +49,30 @@ static void vsdaemon_chardev_receive_char(struct vsdaemon *vsd, u8 ch)
 	vmm_cputc(vcdev->cdev, ch);
 }
 
+static void vsdaemon_chardev_receive_buf(struct vsdaemon *vsd,
+					 u8 *buf, u32 len)
+{
+	u32 i, start = 0;
+	struct vsdaemon_chardev *vcdev = vsdaemon_transport_get_data(vsd);
+
+	/* Print runs of characters with '\r' added before each '\n' */
+	for (i = 0; i < len; i++) {
+		if (buf[i] != '\n') {
+			continue;
+		}
+		if (start < i) {
+			vmm_printchars(vcdev->cdev, (char *)&buf[start],
+				       i - start, TRUE);
+		}
+		vmm_printchars(vcdev->cdev, "\r", 1, TRUE);
+		start = i;
+	}
+	if (start < len) {
+		vmm_printchars(vcdev->cdev, (char *)&buf[start],
+			       len - start, TRUE);
+	}
+}
+
 static int vsdaemon_chardev_main_loop(struct vsdaemon *vsd)
 {
 	char ch;
@@ -102,6 +126,7 @@ static struct vsdaemon_transport chardev = {
 	.cleanup = vsdaemon_chardev_cleanup,
 	.main_loop = vsdaemon_chardev_main_loop,
 	.receive_char = vsdaemon_chardev_receive_char,
+	.receive_buf = vsdaemon_chardev_receive_buf,
 };
 
 static int __init vsdaemon_chardev_init(void)
@@ -121,6 +121,16 @@ static void vsdaemon_mterm_receive_char(struct vsdaemon *vsd, u8 ch)
 	vmm_completion_complete(&vmterm->rx_avail);
 }
 
+static void vsdaemon_mterm_receive_buf(struct vsdaemon *vsd,
+				       u8 *buf, u32 len)
+{
+	struct vsdaemon_mterm *vmterm = vsdaemon_transport_get_data(vsd);
+
+	fifo_enqueue_multi(vmterm->rx_fifo, buf, len);
+
+	vmm_completion_complete(&vmterm->rx_avail);
+}
+
 static int vsdaemon_mterm_main_loop(struct vsdaemon *vsd)
 {
 	size_t cmds_len;
@@ -210,6 +220,7 @@ static struct vsdaemon_transport mterm = {
 	.cleanup = vsdaemon_mterm_cleanup,
 	.main_loop = vsdaemon_mterm_main_loop,
 	.receive_char = vsdaemon_mterm_receive_char,
+	.receive_buf = vsdaemon_mterm_receive_buf,
 };
 
 static int __init vsdaemon_mterm_init(void)
@@ -53,6 +53,9 @@ struct vsdaemon_telnet {
 	/* active connection */
 	struct netstack_socket *active_sk;
 
+	/* parent vsdaemon */
+	struct vsdaemon *vsd;
+
 	/* tx buffer */
 	u8 tx_buf[VSDAEMON_TXBUF_SIZE];
 	u32 tx_buf_head;
@@ -116,67 +119,111 @@ static void vsdaemon_flush_tx_buffer(struct vsdaemon_telnet *tnet)
 	}
 }
 
-static void vsdaemon_telnet_receive_char(struct vsdaemon *vsd, u8 ch)
+static void vsdaemon_telnet_receive_buf(struct vsdaemon *vsd,
+					u8 *buf, u32 len)
 {
+	u32 drop, chunk;
 	irq_flags_t flags;
 	struct vsdaemon_telnet *tnet = vsdaemon_transport_get_data(vsd);
 
+	/* Only last VSDAEMON_TXBUF_SIZE bytes can be buffered */
+	if (VSDAEMON_TXBUF_SIZE < len) {
+		buf += len - VSDAEMON_TXBUF_SIZE;
+		len = VSDAEMON_TXBUF_SIZE;
+	}
+
 	vmm_spin_lock_irqsave(&tnet->tx_buf_lock, flags);
 
-	if (VSDAEMON_TXBUF_SIZE == tnet->tx_buf_count) {
-		tnet->tx_buf_head++;
-		if (tnet->tx_buf_head >= VSDAEMON_TXBUF_SIZE) {
-			tnet->tx_buf_head = 0;
+	/* Drop oldest bytes when Tx buffer overflows */
+	if (VSDAEMON_TXBUF_SIZE < (tnet->tx_buf_count + len)) {
+		drop = tnet->tx_buf_count + len - VSDAEMON_TXBUF_SIZE;
+		tnet->tx_buf_head = (tnet->tx_buf_head + drop) %
+							VSDAEMON_TXBUF_SIZE;
+		tnet->tx_buf_count -= drop;
+	}
+
+	while (len) {
+		chunk = VSDAEMON_TXBUF_SIZE - tnet->tx_buf_tail;
+		if (len < chunk) {
+			chunk = len;
 		}
-		tnet->tx_buf_count--;
+		memcpy(&tnet->tx_buf[tnet->tx_buf_tail], buf, chunk);
+		tnet->tx_buf_tail = (tnet->tx_buf_tail + chunk) %
+							VSDAEMON_TXBUF_SIZE;
+		tnet->tx_buf_count += chunk;
+		buf += chunk;
+		len -= chunk;
 	}
 
-	tnet->tx_buf[tnet->tx_buf_tail] = ch;
+	vmm_spin_unlock_irqrestore(&tnet->tx_buf_lock, flags);
 
-	tnet->tx_buf_tail++;
-	if (tnet->tx_buf_tail >= VSDAEMON_TXBUF_SIZE) {
-		tnet->tx_buf_tail = 0;
-	}
+	/* Flush from worker thread */
+	vsdaemon_schedule(vsd);
+}
 
-	tnet->tx_buf_count++;
+static void vsdaemon_telnet_receive_char(struct vsdaemon *vsd, u8 ch)
+{
+	vsdaemon_telnet_receive_buf(vsd, &ch, 1);
+}
 
-	vmm_spin_unlock_irqrestore(&tnet->tx_buf_lock, flags);
+static void vsdaemon_telnet_notify(struct netstack_socket *sk, void *priv)
+{
+	vsdaemon_schedule(priv);
 }
 
-static int vsdaemon_telnet_main_loop(struct vsdaemon *vsd)
+static int vsdaemon_telnet_process(struct vsdaemon *vsd)
 {
 	int rc;
+	struct netstack_socket *sk;
 	struct netstack_socket_buf buf;
 	struct vsdaemon_telnet *tnet = vsdaemon_transport_get_data(vsd);
 
-	while (1) {
-		rc = netstack_socket_accept(tnet->sk, &tnet->active_sk);
+	/* Accept pending connection if none is active */
+	if (!tnet->active_sk) {
+		if (!netstack_socket_readable(tnet->sk)) {
+			return VMM_OK;
+		}
+
+		rc = netstack_socket_accept(tnet->sk, &sk);
 		if (rc) {
 			return rc;
 		}
 
-		while (1) {
-			vsdaemon_flush_tx_buffer(tnet);
-
-			rc = netstack_socket_recv(tnet->active_sk, &buf, 
-						  VSDAEMON_RXTIMEOUT_MS);
-			if (rc == VMM_ETIMEDOUT) {
-				continue;
-			} else if (rc) {
-				break;
-			}
+		rc = netstack_socket_set_notify(sk, vsdaemon_telnet_notify,
+						vsd);
+		if (rc) {
+			netstack_socket_close(sk);
+			netstack_socket_free(sk);
+			return rc;
+		}
 
-			do {
-				vmm_vserial_send(vsd->vser, 
-						(u8 *)buf.data, buf.len);
-			} while (!(rc = netstack_socket_nextbuf(&buf)));
+		tnet->active_sk = sk;
+	}
 
-			netstack_socket_freebuf(&buf);
+	vsdaemon_flush_tx_buffer(tnet);
+
+	/* Receive whatever is available without blocking */
+	while (netstack_socket_readable(tnet->active_sk)) {
+		rc = netstack_socket_recv(tnet->active_sk, &buf,
+					  VSDAEMON_RXTIMEOUT_MS);
+		if (rc == VMM_ETIMEDOUT) {
+			break;
+		} else if (rc) {
+			netstack_socket_close(tnet->active_sk);
+			netstack_socket_free(tnet->active_sk);
+			tnet->active_sk = NULL;
+
+			/* Check for more pending connections */
+			vsdaemon_schedule(vsd);
+			break;
 		}
 
-		netstack_socket_close(tnet->active_sk);
-		netstack_socket_free(tnet->active_sk);
-		tnet->active_sk = NULL;
+		do {
+			vmm_vserial_send(vsd->vser, 
+					(u8 *)buf.data, buf.len);
+		} while (!(rc = netstack_socket_nextbuf(&buf)));
+
+		netstack_socket_freebuf(&buf);
 	}
 
 	return VMM_OK;
@@ -221,12 +268,19 @@ static int vsdaemon_telnet_setup(struct vsdaemon *vsd, int argc, char **argv)
 	}
 
 	tnet->active_sk = NULL;
+	tnet->vsd = vsd;
 
 	tnet->tx_buf_head = tnet->tx_buf_tail = tnet->tx_buf_count = 0;
 	INIT_SPIN_LOCK(&tnet->tx_buf_lock);
 
 	vsdaemon_transport_set_data(vsd, tnet);
 
+	rc = netstack_socket_set_notify(tnet->sk, vsdaemon_telnet_notify, vsd);
+	if (rc) {
+		vsdaemon_transport_set_data(vsd, NULL);
+		goto fail3;
+	}
+
 	return VMM_OK;
 
 fail3:
@@ -260,8 +314,9 @@ static struct vsdaemon_transport telnet = {
 	.name = "telnet",
 	.setup = vsdaemon_telnet_setup,
 	.cleanup = vsdaemon_telnet_cleanup,
-	.main_loop = vsdaemon_telnet_main_loop,
+	.process = vsdaemon_telnet_process,
 	.receive_char = vsdaemon_telnet_receive_char,
+	.receive_buf = vsdaemon_telnet_receive_buf,
 };
 
 static int __init vsdaemon_telnet_init(void)
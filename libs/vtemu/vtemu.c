@@ -24,8 +24,10 @@
 #include <vmm_error.h>
 #include <vmm_heap.h>
 #include <vmm_modules.h>
+#include <vmm_host_aspace.h>
 #include <libs/stringlib.h>
 #include <libs/mathlib.h>
+#include <libs/bitmap.h>
 #include <libs/vtemu.h>
 
 #define MODULE_DESC			"VTEMU library"
@@ -423,6 +425,139 @@ static void vtemu_blank_display(struct vtemu *v)
 	}
 }
 
+static u32 vtemu_pixel_color(struct vtemu *v, u32 color)
+{
+	if (v->info->fix.visual == FB_VISUAL_TRUECOLOR ||
+	    v->info->fix.visual == FB_VISUAL_DIRECTCOLOR) {
+		return ((u32 *)(v->info->pseudo_palette))[color];
+	}
+
+	return color;
+}
+
+static void vtemu_glyph_render(struct vtemu *v,
+			       struct vtemu_glyph_cache *gc)
+{
+	u8 *dst = gc->data;
+	const u8 *src;
+	u32 ch, x, y, pix, fg, bg;
+	u32 bpl = v->font_img_sz / v->font->height;
+
+	fg = vtemu_pixel_color(v, gc->fc);
+	bg = vtemu_pixel_color(v, gc->bc);
+
+	for (ch = 0; ch < VTEMU_GLYPH_COUNT; ch++) {
+		src = (const u8 *)v->font->data + v->font_img_sz * ch;
+		for (y = 0; y < v->font->height; y++) {
+			for (x = 0; x < v->font->width; x++) {
+				pix = (src[x >> 3] & (0x80 >> (x & 0x7))) ?
+								fg : bg;
+				switch (v->info->var.bits_per_pixel) {
+				case 8:
+					*dst = pix;
+					dst += 1;
+					break;
+				case 16:
+					*(u16 *)dst = pix;
+					dst += 2;
+					break;
+				default:
+					*(u32 *)dst = pix;
+					dst += 4;
+					break;
+				};
+			}
+			src += bpl;
+		}
+	}
+}
+
+static const u8 *vtemu_glyph_find(struct vtemu *v, u32 fc, u32 bc)
+{
+	u32 i;
+	struct vtemu_glyph_cache *gc;
+
+	for (i = 0; i < VTEMU_GLYPH_CACHE_SIZE; i++) {
+		gc = &v->glyph[i];
+		if (gc->valid && (gc->fc == fc) && (gc->bc == bc)) {
+			return gc->data;
+		}
+	}
+
+	/* Replace cache entries in round-robin fashion */
+	gc = &v->glyph[v->glyph_next];
+	v->glyph_next = (v->glyph_next + 1) % VTEMU_GLYPH_CACHE_SIZE;
+	if (!gc->data) {
+		gc->data = (u8 *)vmm_host_alloc_pages(v->glyph_pages,
+						VMM_MEMORY_FLAGS_NORMAL);
+		if (!gc->data) {
+			return NULL;
+		}
+	}
+	gc->fc = fc;
+	gc->bc = bc;
+	vtemu_glyph_render(v, gc);
+	gc->valid = TRUE;
+
+	return gc->data;
+}
+
+static void vtemu_glyph_invalidate(struct vtemu *v)
+{
+	u32 i;
+
+	for (i = 0; i < VTEMU_GLYPH_CACHE_SIZE; i++) {
+		v->glyph[i].valid = FALSE;
+	}
+}
+
+static void vtemu_glyph_free(struct vtemu *v)
+{
+	u32 i;
+
+	for (i = 0; i < VTEMU_GLYPH_CACHE_SIZE; i++) {
+		if (v->glyph[i].data) {
+			vmm_host_free_pages((virtual_addr_t)v->glyph[i].data,
+					    v->glyph_pages);
+			v->glyph[i].data = NULL;
+		}
+		v->glyph[i].valid = FALSE;
+	}
+}
+
+static bool vtemu_glyph_draw(struct vtemu *v, struct vtemu_cell *vcell,
+			     u32 dx, u32 dy)
+{
+	u32 y, len;
+	u8 *dst;
+	const u8 *src;
+
+	if (!v->glyph_sz) {
+		return FALSE;
+	}
+
+	src = vtemu_glyph_find(v, vcell->fc, vcell->bc);
+	if (!src) {
+		return FALSE;
+	}
+	src += v->glyph_sz * vcell->ch;
+
+	if (v->info->fbops->fb_sync) {
+		v->info->fbops->fb_sync(v->info);
+	}
+
+	len = v->font->width * (v->info->var.bits_per_pixel / 8);
+	dst = (u8 *)v->info->screen_base +
+	      dy * v->info->fix.line_length + dx * (len / v->font->width);
+	for (y = 0; y < v->font->height; y++) {
+		fb_memcpy_tofb(dst, src, len);
+		src += len;
+		dst += v->info->fix.line_length;
+	}
+
+	return TRUE;
+}
+
 static void vtemu_cell_draw(struct vtemu *v, struct vtemu_cell *vcell)
 {
 	struct fb_image img;
@@ -432,6 +567,12 @@ static void vtemu_cell_draw(struct vtemu *v, struct vtemu_cell *vcell)
 		return;
 	}
 
+	if (!v->freeze &&
+	    vtemu_glyph_draw(v, vcell, vcell->x * v->font->width,
+			     (vcell->y - v->start_y) * v->font->height)) {
+		return;
+	}
+
 	img.dx = vcell->x * v->font->width;
 	img.dy = (vcell->y - v->start_y) * v->font->height;
 	img.width = v->font->width;
@@ -548,7 +689,7 @@ static void vtemu_scroll_down(struct vtemu *v, u32 lines)
 
 	reg.dx = 0;
 	reg.dy = 0;
-	reg.width = (v->w - lines) * v->font->width;
+	reg.width = v->w * v->font->width;
 	reg.height = (v->h - lines) * v->font->height;
 	reg.sx = 0;
 	reg.sy = lines * v->font->height;
@@ -584,19 +725,41 @@ static void vtemu_scroll_down(struct vtemu *v, u32 lines)
 
 static void vtemu_redraw_display(struct vtemu *v)
 {
-	u32 c, pos;
+	u32 c, pos, bit;
+	unsigned long *drawn;
+	struct vtemu_cell *vcell;
 
 	/* Blank frame buffer */
 	vtemu_blank_display(v);
 
-	/* Redraw all cells */
-	pos = v->cell_head;
+	/* Redraw visible cells starting from latest so that each
+	 * screen location is drawn only once. Cells overwritten by
+	 * later cells at same location are skipped.
+	 */
+	drawn = vmm_zalloc(BITS_TO_LONGS(v->w * v->h) * sizeof(*drawn));
+	pos = (v->cell_tail) ? v->cell_tail : v->cell_len;
 	for (c = 0; c < v->cell_count; c++) {
-		vtemu_cell_draw(v, &v->cell[pos]);
-		pos++;
-		if (pos == v->cell_len) {
-			pos = 0;
+		pos--;
+		vcell = &v->cell[pos];
+		if (!pos) {
+			pos = v->cell_len;
 		}
+		if ((vcell->y < v->start_y) ||
+		    ((v->start_y + v->h) <= vcell->y) ||
+		    (v->w <= vcell->x)) {
+			continue;
+		}
+		if (drawn) {
+			bit = (vcell->y - v->start_y) * v->w + vcell->x;
+			if (test_bit(bit, drawn)) {
+				continue;
+			}
+			__set_bit(bit, drawn);
+		}
+		vtemu_cell_draw(v, vcell);
+	}
+	if (drawn) {
+		vmm_free(drawn);
 	}
 
 	/* Draw cursor */
@@ -1004,6 +1167,9 @@ static void vtemu_restore(struct fb_info *info, void *priv)
 		fb_set_cmap(&v->cmap, v->info);
 	}
 
+	/* Pixel values of prerendered glyphs might have changed */
+	vtemu_glyph_invalidate(v);
+
 	/* Redraw display */
 	vtemu_redraw_display(v);
 
@@ -1149,6 +1315,23 @@ struct vtemu *vtemu_create(const char *name,
 	}
 	v->font_img_sz *= v->font->height;
 
+	/* Prerendered glyphs only for byte aligned pixels */
+	switch (v->info->var.bits_per_pixel) {
+	case 8:
+	case 16:
+	case 32:
+		v->glyph_sz = v->font->width * v->font->height *
+				(v->info->var.bits_per_pixel / 8);
+		v->glyph_pages =
+			VMM_SIZE_TO_PAGE(v->glyph_sz * VTEMU_GLYPH_COUNT);
+		break;
+	default:
+		v->glyph_sz = 0;
+		v->glyph_pages = 0;
+		break;
+	};
+	v->glyph_next = 0;
+
 	/* Setup screen parameters */
 	v->w = udiv32(v->info->var.xres_virtual, v->font->width);
 	v->h = udiv32(v->info->var.yres_virtual, v->font->height);
@@ -1235,6 +1418,7 @@ int vtemu_destroy(struct vtemu *v)
 	fifo_free(v->in_fifo);
 	vmm_free(v->cursor_bkp);
 	vmm_free(v->cell);
+	vtemu_glyph_free(v);
 
 	/* Dealloc color map (if required) */
 	if (v->info->fix.visual == FB_VISUAL_TRUECOLOR ||
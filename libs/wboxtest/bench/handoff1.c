@@ -0,0 +1,149 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file handoff1.c
+ * @author agent (agent@local)
+ * @brief handoff1 benchmark implementation
+ *
+ * This benchmark measures handoff between two threads of same priority
+ * on test host CPU. The semaphore handoff is a ping-pong over a pair of
+ * semaphores. The mutex handoff alternates ownership of one mutex such
+ * that every lock is contended and every unlock wakes a blocked waiter.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_cpumask.h>
+#include <vmm_timer.h>
+#include <vmm_scheduler.h>
+#include <vmm_threads.h>
+#include <vmm_mutex.h>
+#include <vmm_semaphore.h>
+#include <vmm_completion.h>
+#include <vmm_modules.h>
+#include <libs/wboxtest.h>
+
+#define MODULE_DESC			"handoff1 test"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(WBOXTEST_IPRIORITY+1)
+#define	MODULE_INIT			handoff1_init
+#define	MODULE_EXIT			handoff1_exit
+
+/* Number of round-trips */
+#define BENCH_COUNT			1024
+
+/* Global data */
+static DEFINE_SEMAPHORE(s1, 1, 0);
+static DEFINE_SEMAPHORE(s2, 1, 0);
+static DEFINE_MUTEX(m1);
+static DECLARE_COMPLETION(handoff1_done);
+
+static void handoff1_mutex_loop(void)
+{
+	u32 i;
+
+	for (i = 0; i < BENCH_COUNT; i++) {
+		vmm_mutex_lock(&m1);
+		vmm_scheduler_yield();
+		vmm_mutex_unlock(&m1);
+		vmm_scheduler_yield();
+	}
+}
+
+static int handoff1_worker_thread_main(void *data)
+{
+	u32 i;
+
+	for (i = 0; i < BENCH_COUNT; i++) {
+		vmm_semaphore_down(&s1);
+		vmm_semaphore_up(&s2);
+	}
+
+	handoff1_mutex_loop();
+
+	vmm_completion_complete(&handoff1_done);
+
+	return 0;
+}
+
+static int handoff1_run(struct wboxtest *test, struct vmm_chardev *cdev,
+			u32 test_hcpu)
+{
+	u32 i;
+	u64 tstamp;
+	struct vmm_thread *worker;
+	u8 current_priority = vmm_scheduler_current_priority();
+
+	INIT_SEMAPHORE(&s1, 1, 0);
+	INIT_SEMAPHORE(&s2, 1, 0);
+	INIT_MUTEX(&m1);
+	INIT_COMPLETION(&handoff1_done);
+
+	worker = vmm_threads_create("handoff1_worker",
+				    handoff1_worker_thread_main, NULL,
+				    current_priority,
+				    VMM_THREAD_DEF_TIME_SLICE);
+	if (!worker) {
+		return VMM_EFAIL;
+	}
+	vmm_threads_set_affinity(worker, vmm_cpumask_of(test_hcpu));
+	vmm_threads_start(worker);
+
+	tstamp = vmm_timer_timestamp();
+	for (i = 0; i < BENCH_COUNT; i++) {
+		vmm_semaphore_up(&s1);
+		vmm_semaphore_down(&s2);
+	}
+	tstamp = vmm_timer_timestamp() - tstamp;
+	wboxtest_bench_report(cdev, test, "semaphore_roundtrip",
+			      BENCH_COUNT, tstamp);
+
+	tstamp = vmm_timer_timestamp();
+	handoff1_mutex_loop();
+	vmm_completion_wait(&handoff1_done);
+	tstamp = vmm_timer_timestamp() - tstamp;
+	wboxtest_bench_report(cdev, test, "mutex_handoff",
+			      2 * BENCH_COUNT, tstamp);
+
+	vmm_threads_destroy(worker);
+
+	return VMM_OK;
+}
+
+static struct wboxtest handoff1 = {
+	.name = "handoff1",
+	.run = handoff1_run,
+};
+
+static int __init handoff1_init(void)
+{
+	return wboxtest_register("bench", &handoff1);
+}
+
+static void __exit handoff1_exit(void)
+{
+	wboxtest_unregister(&handoff1);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -0,0 +1,147 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file heap1.c
+ * @author agent (agent@local)
+ * @brief heap1 benchmark implementation
+ *
+ * This benchmark measures vmm_malloc() followed by vmm_free() for
+ * various allocation sizes. It is done from a worker thread bound
+ * to each online host CPU in turn so that per-CPU differences in
+ * heap performance are visible.
+ */
+
+#include <vmm_error.h>
+#include <vmm_macros.h>
+#include <vmm_stdio.h>
+#include <vmm_heap.h>
+#include <vmm_cpumask.h>
+#include <vmm_timer.h>
+#include <vmm_scheduler.h>
+#include <vmm_threads.h>
+#include <vmm_completion.h>
+#include <vmm_modules.h>
+#include <libs/stringlib.h>
+#include <libs/wboxtest.h>
+
+#define MODULE_DESC			"heap1 test"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(WBOXTEST_IPRIORITY+1)
+#define	MODULE_INIT			heap1_init
+#define	MODULE_EXIT			heap1_exit
+
+/* Number of allocations per size */
+#define BENCH_COUNT			1024
+
+static const u32 heap1_sizes[] = {
+	16, 64, 256, 1024, 4096, 16384, 65536,
+};
+
+#define NUM_SIZES			array_size(heap1_sizes)
+
+/* Global data */
+static u64 heap1_nsecs[NUM_SIZES];
+static int heap1_rc;
+static DECLARE_COMPLETION(heap1_done);
+
+static int heap1_worker_thread_main(void *data)
+{
+	u32 s, i;
+	u64 tstamp;
+	void *ptr;
+
+	heap1_rc = VMM_OK;
+	for (s = 0; s < NUM_SIZES; s++) {
+		tstamp = vmm_timer_timestamp();
+		for (i = 0; i < BENCH_COUNT; i++) {
+			ptr = vmm_malloc(heap1_sizes[s]);
+			if (!ptr) {
+				heap1_rc = VMM_ENOMEM;
+				goto done;
+			}
+			vmm_free(ptr);
+		}
+		heap1_nsecs[s] = vmm_timer_timestamp() - tstamp;
+	}
+
+done:
+	vmm_completion_complete(&heap1_done);
+
+	return 0;
+}
+
+static int heap1_run(struct wboxtest *test, struct vmm_chardev *cdev,
+		     u32 test_hcpu)
+{
+	u32 cpu, s;
+	char name[VMM_FIELD_NAME_SIZE];
+	struct vmm_thread *worker;
+	u8 current_priority = vmm_scheduler_current_priority();
+
+	for_each_online_cpu(cpu) {
+		INIT_COMPLETION(&heap1_done);
+
+		worker = vmm_threads_create("heap1_worker",
+					    heap1_worker_thread_main, NULL,
+					    current_priority,
+					    VMM_THREAD_DEF_TIME_SLICE);
+		if (!worker) {
+			return VMM_EFAIL;
+		}
+		vmm_threads_set_affinity(worker, vmm_cpumask_of(cpu));
+		vmm_threads_start(worker);
+		vmm_completion_wait(&heap1_done);
+		vmm_threads_destroy(worker);
+
+		if (heap1_rc) {
+			return heap1_rc;
+		}
+
+		for (s = 0; s < NUM_SIZES; s++) {
+			vmm_snprintf(name, sizeof(name),
+				     "malloc_free_%d_cpu%d", heap1_sizes[s], cpu);
+			wboxtest_bench_report(cdev, test, name,
+					      BENCH_COUNT, heap1_nsecs[s]);
+		}
+	}
+
+	return VMM_OK;
+}
+
+static struct wboxtest heap1 = {
+	.name = "heap1",
+	.run = heap1_run,
+};
+
+static int __init heap1_init(void)
+{
+	return wboxtest_register("bench", &heap1);
+}
+
+static void __exit heap1_exit(void)
+{
+	wboxtest_unregister(&heap1);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
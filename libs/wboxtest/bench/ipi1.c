@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file ipi1.c
+ * @author agent (agent@local)
+ * @brief ipi1 benchmark implementation
+ *
+ * This benchmark measures round-trip time of vmm_smp_ipi_sync_call()
+ * from test host CPU to every other online host CPU.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_smp.h>
+#include <vmm_cpumask.h>
+#include <vmm_timer.h>
+#include <vmm_modules.h>
+#include <libs/wboxtest.h>
+
+#define MODULE_DESC			"ipi1 test"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(WBOXTEST_IPRIORITY+1)
+#define	MODULE_INIT			ipi1_init
+#define	MODULE_EXIT			ipi1_exit
+
+/* Number of IPI round-trips per host CPU */
+#define BENCH_COUNT			1024
+
+/* Timeout of one IPI round-trip */
+#define BENCH_TIMEOUT_MSECS		1000
+
+static void ipi1_func(void *arg0, void *arg1, void *arg2)
+{
+	(*(u32 *)arg0)++;
+}
+
+static int ipi1_run(struct wboxtest *test, struct vmm_chardev *cdev,
+		    u32 test_hcpu)
+{
+	int rc;
+	u64 tstamp;
+	u32 cpu, i, calls, count = 0;
+	char name[VMM_FIELD_NAME_SIZE];
+
+	for_each_online_cpu(cpu) {
+		if (cpu == test_hcpu) {
+			continue;
+		}
+
+		calls = 0;
+		tstamp = vmm_timer_timestamp();
+		for (i = 0; i < BENCH_COUNT; i++) {
+			rc = vmm_smp_ipi_sync_call(vmm_cpumask_of(cpu),
+						   BENCH_TIMEOUT_MSECS,
+						   ipi1_func, &calls,
+						   NULL, NULL);
+			if (rc) {
+				return rc;
+			}
+		}
+		tstamp = vmm_timer_timestamp() - tstamp;
+
+		if (calls != BENCH_COUNT) {
+			vmm_cprintf(cdev, "wboxtest: test=%s cpu%d handled "
+				    "%d of %d calls\n", test->name, cpu,
+				    calls, BENCH_COUNT);
+			return VMM_EFAIL;
+		}
+
+		vmm_snprintf(name, sizeof(name), "ipi_sync_call_cpu%d", cpu);
+		wboxtest_bench_report(cdev, test, name, BENCH_COUNT, tstamp);
+		count++;
+	}
+
+	if (!count) {
+		vmm_cprintf(cdev, "wboxtest: test=%s needs more than one "
+			    "online host CPU\n", test->name);
+	}
+
+	return VMM_OK;
+}
+
+static struct wboxtest ipi1 = {
+	.name = "ipi1",
+	.run = ipi1_run,
+};
+
+static int __init ipi1_init(void)
+{
+	return wboxtest_register("bench", &ipi1);
+}
+
+static void __exit ipi1_exit(void)
+{
+	wboxtest_unregister(&ipi1);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
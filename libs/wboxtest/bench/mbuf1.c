@@ -0,0 +1,113 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file mbuf1.c
+ * @author agent (agent@local)
+ * @brief mbuf1 benchmark implementation
+ *
+ * This benchmark measures m_get() followed by m_freem() for mbufs
+ * with and without packet header, and with external storage.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_modules.h>
+#include <net/vmm_mbuf.h>
+#include <libs/wboxtest.h>
+
+#define MODULE_DESC			"mbuf1 test"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(WBOXTEST_IPRIORITY+1)
+#define	MODULE_INIT			mbuf1_init
+#define	MODULE_EXIT			mbuf1_exit
+
+/* Number of allocations per mbuf kind */
+#define BENCH_COUNT			1024
+
+/* Size of external storage (typical ethernet frame) */
+#define BENCH_EXT_SIZE			1536
+
+static int mbuf1_bench(struct wboxtest *test, struct vmm_chardev *cdev,
+		       const char *op, int flags, u32 ext_size)
+{
+	u32 i;
+	u64 tstamp;
+	struct vmm_mbuf *m;
+
+	tstamp = vmm_timer_timestamp();
+	for (i = 0; i < BENCH_COUNT; i++) {
+		m = m_get(0, flags);
+		if (!m) {
+			return VMM_ENOMEM;
+		}
+		if (ext_size &&
+		    !m_ext_get(m, ext_size, VMM_MBUF_ALLOC_DEFAULT)) {
+			m_freem(m);
+			return VMM_ENOMEM;
+		}
+		m_freem(m);
+	}
+	tstamp = vmm_timer_timestamp() - tstamp;
+
+	wboxtest_bench_report(cdev, test, op, BENCH_COUNT, tstamp);
+
+	return VMM_OK;
+}
+
+static int mbuf1_run(struct wboxtest *test, struct vmm_chardev *cdev,
+		     u32 test_hcpu)
+{
+	int rc;
+
+	rc = mbuf1_bench(test, cdev, "m_get_freem", 0, 0);
+	if (rc) {
+		return rc;
+	}
+
+	rc = mbuf1_bench(test, cdev, "m_gethdr_freem", M_PKTHDR, 0);
+	if (rc) {
+		return rc;
+	}
+
+	return mbuf1_bench(test, cdev, "m_gethdr_ext_freem",
+			   M_PKTHDR, BENCH_EXT_SIZE);
+}
+
+static struct wboxtest mbuf1 = {
+	.name = "mbuf1",
+	.run = mbuf1_run,
+};
+
+static int __init mbuf1_init(void)
+{
+	return wboxtest_register("bench", &mbuf1);
+}
+
+static void __exit mbuf1_exit(void)
+{
+	wboxtest_unregister(&mbuf1);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
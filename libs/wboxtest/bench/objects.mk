@@ -0,0 +1,32 @@
+#/**
+# Copyright (c) 2026 agent.
+# All rights reserved.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+#
+# @file objects.mk
+# @author agent (agent@local)
+# @brief list of benchmark test objects to be build
+# */
+
+libs-objs-$(CONFIG_WBOXTEST_BENCH) += wboxtest/bench/heap1.o
+libs-objs-$(CONFIG_WBOXTEST_BENCH) += wboxtest/bench/timer1.o
+libs-objs-$(CONFIG_WBOXTEST_BENCH) += wboxtest/bench/ipi1.o
+libs-objs-$(CONFIG_WBOXTEST_BENCH) += wboxtest/bench/region1.o
+libs-objs-$(CONFIG_WBOXTEST_BENCH) += wboxtest/bench/handoff1.o
+libs-objs-$(CONFIG_WBOXTEST_BENCH) += wboxtest/bench/switch1.o
+ifdef CONFIG_NET
+libs-objs-$(CONFIG_WBOXTEST_BENCH) += wboxtest/bench/mbuf1.o
+endif
@@ -0,0 +1,176 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file region1.c
+ * @author agent (agent@local)
+ * @brief region1 benchmark implementation
+ *
+ * This benchmark measures vmm_guest_find_region() for addresses
+ * spread over memory and I/O regions of every created guest. There
+ * is nothing to measure when no guest is created.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_manager.h>
+#include <vmm_guest_aspace.h>
+#include <vmm_modules.h>
+#include <libs/rbtree.h>
+#include <libs/wboxtest.h>
+
+#define MODULE_DESC			"region1 test"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(WBOXTEST_IPRIORITY+1)
+#define	MODULE_INIT			region1_init
+#define	MODULE_EXIT			region1_exit
+
+/* Number of lookups per guest region tree */
+#define BENCH_COUNT			4096
+
+/* Maximum addresses looked up per guest region tree */
+#define MAX_ADDRS			32
+
+struct region1_args {
+	struct wboxtest *test;
+	struct vmm_chardev *cdev;
+	u32 count;
+	int rc;
+};
+
+static u32 region1_collect(struct rb_root *root, vmm_rwlock_t *root_lock,
+			   physical_addr_t *addrs)
+{
+	u32 count = 0;
+	irq_flags_t flags;
+	struct rb_node *pos;
+	struct vmm_region *reg;
+
+	vmm_read_lock_irqsave_lite(root_lock, flags);
+	for (pos = rb_first(root); pos && (count < MAX_ADDRS);
+	     pos = rb_next(pos)) {
+		reg = rb_entry(pos, struct vmm_region, head);
+		addrs[count++] = VMM_REGION_GPHYS_START(reg) +
+				 (reg->phys_size >> 1);
+	}
+	vmm_read_unlock_irqrestore_lite(root_lock, flags);
+
+	return count;
+}
+
+static int region1_bench(struct region1_args *args, struct vmm_guest *guest,
+			 bool is_io)
+{
+	u64 tstamp;
+	u32 i, count;
+	char name[VMM_FIELD_NAME_SIZE];
+	physical_addr_t addrs[MAX_ADDRS];
+	struct vmm_guest_aspace *aspace = &guest->aspace;
+	u32 reg_flags = (is_io) ? VMM_REGION_IO : VMM_REGION_MEMORY;
+
+	if (is_io) {
+		count = region1_collect(&aspace->reg_iotree,
+					&aspace->reg_iotree_lock, addrs);
+	} else {
+		count = region1_collect(&aspace->reg_memtree,
+					&aspace->reg_memtree_lock, addrs);
+	}
+	if (!count) {
+		return VMM_OK;
+	}
+
+	tstamp = vmm_timer_timestamp();
+	for (i = 0; i < BENCH_COUNT; i++) {
+		if (!vmm_guest_find_region(guest, addrs[i % count],
+					   reg_flags, FALSE)) {
+			return VMM_ENOTAVAIL;
+		}
+	}
+	tstamp = vmm_timer_timestamp() - tstamp;
+
+	vmm_snprintf(name, sizeof(name), "find_region_%s_%s",
+		     (is_io) ? "io" : "mem", guest->name);
+	wboxtest_bench_report(args->cdev, args->test, name,
+			      BENCH_COUNT, tstamp);
+
+	return VMM_OK;
+}
+
+static int region1_guest_iter(struct vmm_guest *guest, void *priv)
+{
+	struct region1_args *args = priv;
+
+	if (!guest->aspace.initialized) {
+		return VMM_OK;
+	}
+
+	args->count++;
+
+	args->rc = region1_bench(args, guest, FALSE);
+	if (args->rc) {
+		return args->rc;
+	}
+
+	args->rc = region1_bench(args, guest, TRUE);
+
+	return args->rc;
+}
+
+static int region1_run(struct wboxtest *test, struct vmm_chardev *cdev,
+		       u32 test_hcpu)
+{
+	struct region1_args args;
+
+	args.test = test;
+	args.cdev = cdev;
+	args.count = 0;
+	args.rc = VMM_OK;
+
+	/* Guests can not be destroyed while we iterate */
+	vmm_manager_guest_iterate(region1_guest_iter, &args);
+
+	if (!args.count) {
+		vmm_cprintf(cdev, "wboxtest: test=%s needs atleast one "
+			    "guest\n", test->name);
+	}
+
+	return args.rc;
+}
+
+static struct wboxtest region1 = {
+	.name = "region1",
+	.run = region1_run,
+};
+
+static int __init region1_init(void)
+{
+	return wboxtest_register("bench", &region1);
+}
+
+static void __exit region1_exit(void)
+{
+	wboxtest_unregister(&region1);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
@@ -0,0 +1,119 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file switch1.c
+ * @author agent (agent@local)
+ * @brief switch1 benchmark implementation
+ *
+ * This benchmark measures thread context switch by making two threads
+ * of same priority on test host CPU yield to each other.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_cpumask.h>
+#include <vmm_timer.h>
+#include <vmm_scheduler.h>
+#include <vmm_threads.h>
+#include <vmm_completion.h>
+#include <vmm_modules.h>
+#include <libs/wboxtest.h>
+
+#define MODULE_DESC			"switch1 test"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(WBOXTEST_IPRIORITY+1)
+#define	MODULE_INIT			switch1_init
+#define	MODULE_EXIT			switch1_exit
+
+/* Number of yields by each thread */
+#define BENCH_COUNT			4096
+
+/* Global data */
+static DECLARE_COMPLETION(switch1_done);
+
+static int switch1_worker_thread_main(void *data)
+{
+	u32 i;
+
+	for (i = 0; i < BENCH_COUNT; i++) {
+		vmm_scheduler_yield();
+	}
+
+	vmm_completion_complete(&switch1_done);
+
+	return 0;
+}
+
+static int switch1_run(struct wboxtest *test, struct vmm_chardev *cdev,
+		       u32 test_hcpu)
+{
+	u32 i;
+	u64 tstamp;
+	struct vmm_thread *worker;
+	u8 current_priority = vmm_scheduler_current_priority();
+
+	INIT_COMPLETION(&switch1_done);
+
+	worker = vmm_threads_create("switch1_worker",
+				    switch1_worker_thread_main, NULL,
+				    current_priority,
+				    VMM_THREAD_DEF_TIME_SLICE);
+	if (!worker) {
+		return VMM_EFAIL;
+	}
+	vmm_threads_set_affinity(worker, vmm_cpumask_of(test_hcpu));
+
+	tstamp = vmm_timer_timestamp();
+	vmm_threads_start(worker);
+	for (i = 0; i < BENCH_COUNT; i++) {
+		vmm_scheduler_yield();
+	}
+	vmm_completion_wait(&switch1_done);
+	tstamp = vmm_timer_timestamp() - tstamp;
+
+	vmm_threads_destroy(worker);
+
+	/* Each yield switches to the other thread */
+	wboxtest_bench_report(cdev, test, "thread_switch",
+			      2 * BENCH_COUNT, tstamp);
+
+	return VMM_OK;
+}
+
+static struct wboxtest switch1 = {
+	.name = "switch1",
+	.run = switch1_run,
+};
+
+static int __init switch1_init(void)
+{
+	return wboxtest_register("bench", &switch1);
+}
+
+static void __exit switch1_exit(void)
+{
+	wboxtest_unregister(&switch1);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
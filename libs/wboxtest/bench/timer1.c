@@ -0,0 +1,106 @@
+/**
+ * Copyright (c) 2026 agent.
+ * All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+ *
+ * @file timer1.c
+ * @author agent (agent@local)
+ * @brief timer1 benchmark implementation
+ *
+ * This benchmark measures vmm_timer_event_start() followed by
+ * vmm_timer_event_stop() of a timer event which never expires
+ * during the benchmark.
+ */
+
+#include <vmm_error.h>
+#include <vmm_stdio.h>
+#include <vmm_timer.h>
+#include <vmm_modules.h>
+#include <libs/wboxtest.h>
+
+#define MODULE_DESC			"timer1 test"
+#define MODULE_AUTHOR			"agent"
+#define MODULE_LICENSE			"GPL"
+#define MODULE_IPRIORITY		(WBOXTEST_IPRIORITY+1)
+#define	MODULE_INIT			timer1_init
+#define	MODULE_EXIT			timer1_exit
+
+/* Number of start/stop pairs */
+#define BENCH_COUNT			4096
+
+/* Timer duration long enough to never expire during benchmark */
+#define BENCH_DURATION_NSECS		10000000000ULL
+
+static void timer1_event_handler(struct vmm_timer_event *ev)
+{
+	/* Nothing to do here. */
+}
+
+static int timer1_run(struct wboxtest *test, struct vmm_chardev *cdev,
+		      u32 test_hcpu)
+{
+	int rc;
+	u32 i;
+	u64 tstamp, start_nsecs = 0, stop_nsecs = 0;
+	struct vmm_timer_event ev;
+
+	INIT_TIMER_EVENT(&ev, timer1_event_handler, NULL);
+
+	for (i = 0; i < BENCH_COUNT; i++) {
+		tstamp = vmm_timer_timestamp();
+		rc = vmm_timer_event_start(&ev, BENCH_DURATION_NSECS);
+		start_nsecs += vmm_timer_timestamp() - tstamp;
+		if (rc) {
+			return rc;
+		}
+
+		tstamp = vmm_timer_timestamp();
+		rc = vmm_timer_event_stop(&ev);
+		stop_nsecs += vmm_timer_timestamp() - tstamp;
+		if (rc) {
+			return rc;
+		}
+	}
+
+	wboxtest_bench_report(cdev, test, "timer_event_start",
+			      BENCH_COUNT, start_nsecs);
+	wboxtest_bench_report(cdev, test, "timer_event_stop",
+			      BENCH_COUNT, stop_nsecs);
+
+	return VMM_OK;
+}
+
+static struct wboxtest timer1 = {
+	.name = "timer1",
+	.run = timer1_run,
+};
+
+static int __init timer1_init(void)
+{
+	return wboxtest_register("bench", &timer1);
+}
+
+static void __exit timer1_exit(void)
+{
+	wboxtest_unregister(&timer1);
+}
+
+VMM_DECLARE_MODULE(MODULE_DESC,
+			MODULE_AUTHOR,
+			MODULE_LICENSE,
+			MODULE_IPRIORITY,
+			MODULE_INIT,
+			MODULE_EXIT);
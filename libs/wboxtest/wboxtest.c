@@ -30,6 +30,7 @@
 #include <vmm_modules.h>
 #include <vmm_timer.h>
 #include <libs/stringlib.h>
+#include <libs/mathlib.h>
 #include <libs/wboxtest.h>
 
 #define MODULE_DESC			"white-box testing library"
@@ -353,6 +354,25 @@ void wboxtest_run_all(struct vmm_chardev *cdev, u32 iterations)
 }
 VMM_EXPORT_SYMBOL(wboxtest_run_all);
 
+void wboxtest_bench_report(struct vmm_chardev *cdev, struct wboxtest *test,
+			   const char *op, u64 count, u64 nsecs)
+{
+	u64 per_op, frac;
+
+	if (!count) {
+		return;
+	}
+
+	/* Three decimal digits so that sub-nanosecond costs show up */
+	per_op = udiv64(nsecs, count);
+	frac = udiv64((nsecs - per_op * count) * 1000ULL, count);
+
+	vmm_cprintf(cdev, "wboxtest: test=%s bench=%s count=%"PRIu64
+		    " nsecs_per_op=%"PRIu64".%03"PRIu64"\n",
+		    test->name, op, count, per_op, frac);
+}
+VMM_EXPORT_SYMBOL(wboxtest_bench_report);
+
 int wboxtest_register(const char *group_name, struct wboxtest *test)
 {
 	int rc;
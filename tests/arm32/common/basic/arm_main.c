@@ -82,6 +82,12 @@ void arm_cmd_help(int argc, char **argv)
 	arm_puts("dhrystone   - Dhrystone 2.1 benchmark\n");
 	arm_puts("            Usage: dhrystone [<iterations>]\n");
 	arm_puts("\n");
+#if defined(ARM_ARCH_v7ve)
+	arm_puts("wsbench     - World switch round-trip microbenchmark\n");
+	arm_puts("            Usage: wsbench [<iterations>]\n");
+	arm_puts("            <iterations>  = number of round-trips per type\n");
+	arm_puts("\n");
+#endif
 	arm_puts("hexdump     - Dump memory contents in hex format\n");
 	arm_puts("            Usage: hexdump <addr> <count>\n");
 	arm_puts("            <addr>  = memory address in hex\n");
@@ -285,6 +291,97 @@ void arm_cmd_timer(int argc, char **argv)
 	arm_puts("\n");
 }
 
+#if defined(ARM_ARCH_v7ve)
+/* PSCI_VERSION is the cheapest SMC call handled by hypervisor */
+static inline void arm_wsbench_hypcall(void)
+{
+	asm volatile(
+		".arch_extension sec\n\t"
+		"mov	r0, %0\n\t"
+		"smc	#0    \n\t"
+	:
+	: "r" (0x84000000UL)
+	: "r0", "r1", "r2", "r3", "cc", "memory");
+}
+
+/* ACTLR accesses are trapped by hypervisor */
+static inline u32 arm_wsbench_sysreg(void)
+{
+	u32 val;
+
+	asm volatile("mrc	p15, 0, %0, c1, c0, 1" : "=r" (val) :: "memory");
+
+	return val;
+}
+
+static void arm_wsbench_report(const char *name, u64 nsecs, u32 iter)
+{
+	char str[32];
+
+	arm_puts("  ");
+	arm_puts(name);
+	arm_puts(": ");
+	arm_ulonglong2str(str, arm_udiv64(nsecs, iter));
+	arm_puts(str);
+	arm_puts(" nsecs per round-trip\n");
+}
+
+void arm_cmd_wsbench(int argc, char **argv)
+{
+	char str[32];
+	u32 i, iter = 10000, irq;
+	u64 tstamp;
+
+	if (argc > 2) {
+		arm_puts ("wsbench: could provide only <iterations>\n");
+		return;
+	} else if (argc == 2) {
+		iter = arm_str2int(argv[1]);
+		if (!iter) {
+			arm_puts ("wsbench: <iterations> must be non-zero\n");
+			return;
+		}
+	}
+
+	/* Masking an unused interrupt is a harmless emulated MMIO write */
+	irq = arm_board_pic_nr_irqs() - 1;
+
+	/* Timer interrupts would only add noise to round-trip times */
+	arm_board_timer_disable();
+
+	arm_puts("World switch round-trip times ...\n");
+
+	tstamp = arm_board_timer_timestamp();
+	for (i = 0; i < iter; i++) {
+		arm_wsbench_hypcall();
+	}
+	tstamp = arm_board_timer_timestamp() - tstamp;
+	arm_wsbench_report("Hypercall", tstamp, iter);
+
+	tstamp = arm_board_timer_timestamp();
+	for (i = 0; i < iter; i++) {
+		arm_board_pic_mask(irq);
+	}
+	tstamp = arm_board_timer_timestamp() - tstamp;
+	arm_wsbench_report("MMIO     ", tstamp, iter);
+
+	tstamp = arm_board_timer_timestamp();
+	for (i = 0; i < iter; i++) {
+		arm_wsbench_sysreg();
+	}
+	tstamp = arm_board_timer_timestamp() - tstamp;
+	arm_wsbench_report("Sysreg   ", tstamp, iter);
+
+	arm_board_timer_enable();
+
+	/* Timer IRQ delay covers virtual interrupt injection */
+	arm_puts("  IRQ      : ");
+	arm_ulonglong2str(str, arm_board_timer_irqdelay());
+	arm_puts(str);
+	arm_puts(" nsecs average timer IRQ delay\n");
+}
+#endif
+
 void arm_cmd_dhrystone(int argc, char **argv)
 {
 	char str[32];
@@ -780,6 +877,10 @@ void arm_exec(char *line)
 			arm_cmd_timer(argc, argv);
 		} else if (arm_strcmp(argv[0], "dhrystone") == 0) {
 			arm_cmd_dhrystone(argc, argv);
+#if defined(ARM_ARCH_v7ve)
+		} else if (arm_strcmp(argv[0], "wsbench") == 0) {
+			arm_cmd_wsbench(argc, argv);
+#endif
 		} else if (arm_strcmp(argv[0], "hexdump") == 0) {
 			arm_cmd_hexdump(argc, argv);
 		} else if (arm_strcmp(argv[0], "copy") == 0) {
@@ -0,0 +1,263 @@
+#!/bin/bash
+
+# Copyright (c) 2026 agent.
+# All rights reserved.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+#
+# @file perf-arm-guest.sh
+# @author agent (agent@local)
+# @brief Performance regression suite for guest boot and I/O
+#
+# Boots Xvisor images built by build-arm-images.sh under QEMU (or
+# attaches to a real board console), runs fixed guest workloads for
+# a number of iterations, and writes one JSON object per metric to
+# the results file. With a baseline results file, metrics which are
+# worse than baseline by more than the threshold are reported and
+# the script exits with non-zero status.
+
+function usage()
+{
+	echo "Usage:"
+	echo " $0 [options]"
+	echo "Options:"
+	echo "     -h                       Display help or usage (Optional)"
+	echo "     -g <guest_type>          Xvisor Guest type (Mandatory)"
+	echo "                                QEMU is used by default for:"
+	echo "                                  realview-eb-mpcore"
+	echo "                                  realview-pb-a8"
+	echo "                                  versatilepb"
+	echo "                                  vexpress-a9"
+	echo "                                  vexpress-a15"
+	echo "     -o <xvisor_output_path>  Xvisor output path (Optional)"
+	echo "     -q <qemu_command>        Override QEMU command line (Optional)"
+	echo "     -c <console_command>     Real board console command, for example"
+	echo "                                \"picocom -b 115200 /dev/ttyUSB0\" (Optional)"
+	echo "     -n <iterations>          Number of iterations (Optional)"
+	echo "     -w <workloads>           Comma separated list of workloads (Optional)"
+	echo "                                Allowed values:"
+	echo "                                  boot, dd, iperf, hackbench"
+	echo "     -B <host_block_device>   Host block device for guest virtio-blk (Optional)"
+	echo "     -s <iperf_server>        iperf3 server address for iperf workload (Optional)"
+	echo "     -I <guest_ip>            Guest IP address for iperf workload (Optional)"
+	echo "     -r <results_file>        Results file (Optional)"
+	echo "     -b <baseline_file>       Baseline results file to compare (Optional)"
+	echo "     -t <threshold_percent>   Allowed regression from baseline (Optional)"
+	exit 1;
+}
+
+# Command line options
+PERF_GUEST_TYPE=
+PERF_XVISOR_OUTPUT_PATH=`pwd`/build
+PERF_QEMU_CMD=
+PERF_BOARD_CMD=
+PERF_ITERATIONS=3
+PERF_WORKLOADS="boot,dd,iperf,hackbench"
+PERF_RESULTS_FILE=`pwd`/perf-results.json
+PERF_BASELINE_FILE=
+PERF_THRESHOLD=5
+
+# Settings passed to perf-guest.tcl
+export PERF_GUEST="guest0"
+export PERF_BOOT_TIMEOUT=600
+export PERF_HOST_BDEV=
+export PERF_GUEST_BDEV="/dev/vda"
+export PERF_DD_MB=64
+export PERF_GUEST_IP=
+export PERF_IPERF_SERVER=
+export PERF_IPERF_SECS=10
+export PERF_HACKBENCH_ARGS="-g 4 -l 100"
+
+while getopts ":b:c:g:hI:n:o:q:r:s:t:w:B:" o; do
+	case "${o}" in
+	b)
+		PERF_BASELINE_FILE=${OPTARG}
+		;;
+	c)
+		PERF_BOARD_CMD=${OPTARG}
+		;;
+	g)
+		PERF_GUEST_TYPE=${OPTARG}
+		;;
+	h)
+		usage
+		;;
+	I)
+		PERF_GUEST_IP=${OPTARG}
+		;;
+	n)
+		PERF_ITERATIONS=${OPTARG}
+		;;
+	o)
+		PERF_XVISOR_OUTPUT_PATH=${OPTARG}
+		;;
+	q)
+		PERF_QEMU_CMD=${OPTARG}
+		;;
+	r)
+		PERF_RESULTS_FILE=${OPTARG}
+		;;
+	s)
+		PERF_IPERF_SERVER=${OPTARG}
+		;;
+	t)
+		PERF_THRESHOLD=${OPTARG}
+		;;
+	w)
+		PERF_WORKLOADS=${OPTARG}
+		;;
+	B)
+		PERF_HOST_BDEV=${OPTARG}
+		;;
+	*)
+		usage
+		;;
+	esac
+done
+shift $((OPTIND-1))
+
+if [ -z "${PERF_GUEST_TYPE}" ]; then
+	echo "Must specify Guest type"
+	usage
+fi
+
+# Derived options
+PERF_SCRIPT_PATH=`dirname $0`
+PERF_TARGET="qemu"
+PERF_XVISOR_IMAGE=${PERF_XVISOR_OUTPUT_PATH}/vmm.bin
+PERF_XVISOR_DTS_PATH=${PERF_XVISOR_OUTPUT_PATH}/arch/arm/board/generic/dts
+PERF_XVISOR_DISK=${PERF_XVISOR_OUTPUT_PATH}/disk-${PERF_GUEST_TYPE}.ext2
+
+if [ ! -z "${PERF_BOARD_CMD}" ]; then
+	PERF_TARGET="board"
+	export PERF_CONSOLE=${PERF_BOARD_CMD}
+elif [ ! -z "${PERF_QEMU_CMD}" ]; then
+	export PERF_CONSOLE=${PERF_QEMU_CMD}
+else
+	case "${PERF_GUEST_TYPE}" in
+	realview-eb-mpcore)
+		PERF_QEMU_MACHINE="-M realview-eb-mpcore -m 256M"
+		PERF_XVISOR_DTB=${PERF_XVISOR_DTS_PATH}/realview/eb-mpcore/one_guest_ebmp.dtb
+		;;
+	realview-pb-a8)
+		PERF_QEMU_MACHINE="-M realview-pb-a8 -m 256M"
+		PERF_XVISOR_DTB=${PERF_XVISOR_DTS_PATH}/realview/pb-a8/one_guest_pb-a8.dtb
+		;;
+	versatilepb)
+		PERF_QEMU_MACHINE="-M versatilepb -m 256M"
+		PERF_XVISOR_DTB=${PERF_XVISOR_DTS_PATH}/versatile/pb/one_guest_versatile.dtb
+		;;
+	vexpress-a9)
+		PERF_QEMU_MACHINE="-M vexpress-a9 -m 256M"
+		PERF_XVISOR_DTB=${PERF_XVISOR_DTS_PATH}/vexpress/a9/one_guest_vexpress-a9.dtb
+		;;
+	vexpress-a15)
+		PERF_QEMU_MACHINE="-M vexpress-a15 -cpu cortex-a15 -m 256M"
+		PERF_XVISOR_DTB=${PERF_XVISOR_DTS_PATH}/vexpress/a15/one_guest_vexpress-a15.dtb
+		;;
+	*)
+		echo "No QEMU machine for ${PERF_GUEST_TYPE}, use -q or -c"
+		usage
+		;;
+	esac
+	export PERF_CONSOLE="qemu-system-arm ${PERF_QEMU_MACHINE} -display none -serial stdio -kernel ${PERF_XVISOR_IMAGE} -dtb ${PERF_XVISOR_DTB} -initrd ${PERF_XVISOR_DISK}"
+fi
+
+echo "=== Performance configuration ==="
+echo "guest_type = ${PERF_GUEST_TYPE}"
+echo "target = ${PERF_TARGET}"
+echo "console = ${PERF_CONSOLE}"
+echo "iterations = ${PERF_ITERATIONS}"
+echo "workloads = ${PERF_WORKLOADS}"
+echo "host_bdev = ${PERF_HOST_BDEV}"
+echo "iperf_server = ${PERF_IPERF_SERVER}"
+echo "results_file = ${PERF_RESULTS_FILE}"
+echo "baseline_file = ${PERF_BASELINE_FILE}"
+echo "threshold = ${PERF_THRESHOLD}%"
+
+PERF_SAMPLES_FILE=`mktemp`
+trap "rm -f ${PERF_SAMPLES_FILE}" EXIT
+
+for i in `seq 1 ${PERF_ITERATIONS}`; do
+	echo "=== Iteration ${i} of ${PERF_ITERATIONS} ==="
+	expect -f ${PERF_SCRIPT_PATH}/perf-guest.tcl | tee /dev/stderr | \
+		tr -d '\r' | grep "^PERF_RESULT " >> ${PERF_SAMPLES_FILE}
+	if [ ${PIPESTATUS[0]} -ne 0 ]; then
+		echo "Iteration ${i} failed"
+		exit 1
+	fi
+done
+
+echo "=== Write results ==="
+PERF_COMMIT=`git -C ${PERF_SCRIPT_PATH} rev-parse --short HEAD 2>/dev/null`
+PERF_DATE=`date -u +%Y-%m-%dT%H:%M:%SZ`
+awk -v guest="${PERF_GUEST_TYPE}" -v target="${PERF_TARGET}" \
+    -v commit="${PERF_COMMIT}" -v date="${PERF_DATE}" '
+	{
+		if (!($2 in cnt)) {
+			order[n++] = $2;
+			min[$2] = $3;
+			max[$2] = $3;
+		}
+		unit[$2] = $4;
+		cnt[$2]++;
+		sum[$2] += $3;
+		if ($3 < min[$2]) min[$2] = $3;
+		if ($3 > max[$2]) max[$2] = $3;
+	}
+	END {
+		for (i = 0; i < n; i++) {
+			m = order[i];
+			better = (unit[m] == "ms") ? "lower" : "higher";
+			printf("{\"metric\":\"%s\",\"unit\":\"%s\",\"better\":\"%s\",", m, unit[m], better);
+			printf("\"mean\":%.2f,\"min\":%.2f,\"max\":%.2f,\"samples\":%d,", sum[m] / cnt[m], min[m], max[m], cnt[m]);
+			printf("\"guest\":\"%s\",\"target\":\"%s\",\"commit\":\"%s\",\"date\":\"%s\"}\n", guest, target, commit, date);
+		}
+	}' ${PERF_SAMPLES_FILE} > ${PERF_RESULTS_FILE}
+cat ${PERF_RESULTS_FILE}
+
+if [ -z "${PERF_BASELINE_FILE}" ]; then
+	exit 0
+fi
+
+echo "=== Compare with baseline ==="
+awk -v threshold="${PERF_THRESHOLD}" '
+	function field(line, key,    re) {
+		re = "\"" key "\":\"?[^,\"}]*";
+		if (!match(line, re)) return "";
+		line = substr(line, RSTART + length(key) + 3, RLENGTH - length(key) - 3);
+		sub(/^"/, "", line);
+		return line;
+	}
+	FNR == NR {
+		base[field($0, "metric")] = field($0, "mean");
+		next;
+	}
+	{
+		m = field($0, "metric");
+		if (!(m in base) || (base[m] == 0)) {
+			printf("%-16s no baseline\n", m);
+			next;
+		}
+		diff = 100.0 * (field($0, "mean") - base[m]) / base[m];
+		if (field($0, "better") == "lower") diff = -diff;
+		status = (diff < -threshold) ? "REGRESSION" : "OK";
+		if (status == "REGRESSION") failed = 1;
+		printf("%-16s baseline=%s current=%s %s change=%+.2f%% %s\n",
+		       m, base[m], field($0, "mean"), field($0, "unit"), diff, status);
+	}
+	END {
+		exit failed;
+	}' ${PERF_BASELINE_FILE} ${PERF_RESULTS_FILE}
@@ -0,0 +1,151 @@
+#!/usr/bin/expect -f
+package require Expect
+#/**
+# Copyright (c) 2026 agent.
+# All rights reserved.
+#
+# This program is free software; you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation; either version 2, or (at your option)
+# any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 675 Mass Ave, Cambridge, MA 02139, USA.
+#
+# @file perf-guest.tcl
+# @author agent (agent@local)
+# @brief One iteration of guest performance workloads
+#
+# This script is driven by perf-arm-guest.sh and all settings are
+# passed via environment variables. Each measurement is printed as
+# "PERF_RESULT <metric> <value> <unit>" on a line of its own.
+# */
+
+set xvisor_prompt "XVisor#"
+set basic_prompt "basic#"
+set linux_prompt "/ # "
+
+set console $env(PERF_CONSOLE)
+set workloads [split $env(PERF_WORKLOADS) ","]
+set guest $env(PERF_GUEST)
+set boot_timeout $env(PERF_BOOT_TIMEOUT)
+set host_bdev $env(PERF_HOST_BDEV)
+set guest_bdev $env(PERF_GUEST_BDEV)
+set dd_mb $env(PERF_DD_MB)
+set guest_ip $env(PERF_GUEST_IP)
+set iperf_server $env(PERF_IPERF_SERVER)
+set iperf_secs $env(PERF_IPERF_SECS)
+set hackbench_args $env(PERF_HACKBENCH_ARGS)
+
+proc result {metric value unit} {
+	send_user "\nPERF_RESULT $metric $value $unit\n"
+}
+
+proc fail {msg} {
+	send_user "\nPERF_FAIL $msg\n"
+	exit 1
+}
+
+proc has_workload {name} {
+	global workloads
+	return [expr {[lsearch -exact $workloads $name] > -1}]
+}
+
+# Run guest shell command and return its output
+proc guest_cmd {cmd tmo} {
+	global linux_prompt
+	set timeout $tmo
+	send -- "$cmd\r"
+	expect {
+		$linux_prompt { return $expect_out(buffer) }
+		timeout { fail "timeout running '$cmd'" }
+	}
+}
+
+proc elapsed_ms {start} {
+	return [expr {[clock milliseconds] - $start}]
+}
+
+log_user 1
+eval spawn $console
+
+# Wait for Xvisor prompt (real boards may already be at prompt)
+set timeout 60
+send -- "\r"
+expect {
+	$xvisor_prompt { }
+	timeout { fail "no Xvisor prompt" }
+}
+
+if { [string length $host_bdev] > 0 } {
+	send -- "vdisk attach $guest/virtio-blk0 $host_bdev\r"
+	expect $xvisor_prompt
+}
+
+# Boot-to-shell time covers guest firmware and guest Linux boot
+set start [clock milliseconds]
+send -- "guest kick $guest\r"
+expect $xvisor_prompt
+send -- "vserial bind $guest/uart0\r"
+expect {
+	$basic_prompt { }
+	timeout { fail "no guest firmware prompt" }
+}
+send -- "autoexec\r"
+set timeout $boot_timeout
+expect {
+	"Please press Enter to activate this console." {
+		send -- "\r"
+		exp_continue
+	}
+	$linux_prompt { }
+	timeout { fail "guest Linux did not reach shell" }
+}
+if { [has_workload "boot"] } {
+	result boot_to_shell [elapsed_ms $start] ms
+}
+
+if { [has_workload "dd"] } {
+	# Read-only so that disk contents are never modified
+	guest_cmd "echo 3 > /proc/sys/vm/drop_caches" 30
+	set start [clock milliseconds]
+	set out [guest_cmd "dd if=$guest_bdev of=/dev/null bs=1048576 count=$dd_mb" $boot_timeout]
+	set ms [elapsed_ms $start]
+	if { [string first "$dd_mb+0 records in" $out] < 0 } {
+		send_user "\nPERF_SKIP dd\n"
+	} else {
+		result dd_read [expr {($dd_mb * 1000.0) / $ms}] MB/s
+	}
+}
+
+if { [has_workload "iperf"] } {
+	if { ([string length $iperf_server] == 0) ||
+	     ([string length $guest_ip] == 0) } {
+		send_user "\nPERF_SKIP iperf\n"
+	} else {
+		guest_cmd "ifconfig eth0 $guest_ip up" 30
+		set out [guest_cmd "iperf3 -f m -t $iperf_secs -c $iperf_server" [expr {$iperf_secs + 60}]]
+		if { [regexp {([0-9.]+) Mbits/sec[^\n]*sender} $out match bw] } {
+			result iperf_tx $bw Mbit/s
+		} else {
+			send_user "\nPERF_SKIP iperf\n"
+		}
+	}
+}
+
+if { [has_workload "hackbench"] } {
+	set out [guest_cmd "hackbench $hackbench_args" $boot_timeout]
+	if { [regexp {Time: ([0-9.]+)} $out match secs] } {
+		result hackbench [expr {$secs * 1000.0}] ms
+	} else {
+		send_user "\nPERF_SKIP hackbench\n"
+	}
+}
+
+exit 0